@@ -0,0 +1,99 @@
+#include"AllocationCounter.h"
+
+#include<atomic>
+#include<cstddef>
+#include<cstdlib>
+#include<new>
+
+// Counts of the calling thread and of all of them, plain integers so counting never allocates itself
+static thread_local uint64_t threadAllocations = 0;
+static std::atomic<uint64_t> totalAllocations{ 0 };
+// Allowed scopes the calling thread is in
+static thread_local unsigned int allowedDepth = 0;
+
+// Starts an allowed scope
+AllocationCounter::Allowed::Allowed()
+{
+	allowedDepth++;
+}
+
+// Ends an allowed scope
+AllocationCounter::Allowed::~Allowed()
+{
+	allowedDepth--;
+}
+
+// Allocations the calling thread has made so far outside of allowed scopes
+uint64_t AllocationCounter::Thread()
+{
+	return threadAllocations;
+}
+
+// Allocations every thread has made so far
+uint64_t AllocationCounter::Total()
+{
+	return totalAllocations.load(std::memory_order_relaxed);
+}
+
+#ifdef ALLOCATION_COUNTER
+// Counts an allocation and takes its memory from malloc, nullptr once that fails
+static void* countedAllocate(size_t size, size_t alignment)
+{
+	if (allowedDepth == 0)
+		threadAllocations++;
+	totalAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0)
+		size = 1;
+	if (alignment <= alignof(std::max_align_t))
+		return std::malloc(size);
+#ifdef _MSC_VER
+	return _aligned_malloc(size, alignment);
+#else
+	// aligned_alloc wants the size to be a multiple of the alignment
+	return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+}
+
+// Gives memory of countedAllocate back
+static void countedFree(void* pointer, [[maybe_unused]] size_t alignment)
+{
+#ifdef _MSC_VER
+	if (alignment > alignof(std::max_align_t))
+	{
+		_aligned_free(pointer);
+		return;
+	}
+#endif
+	std::free(pointer);
+}
+
+// Allocates like the default operator new, throwing std::bad_alloc when there is no memory
+static void* countedNew(size_t size, size_t alignment)
+{
+	void* pointer = countedAllocate(size, alignment);
+	if (!pointer)
+		throw std::bad_alloc();
+	return pointer;
+}
+
+void* operator new(size_t size) { return countedNew(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size) { return countedNew(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size, alignof(std::max_align_t)); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAllocate(size, alignof(std::max_align_t)); }
+void* operator new(size_t size, std::align_val_t alignment) { return countedNew(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return countedNew(size, (size_t)alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocate(size, (size_t)alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return countedAllocate(size, (size_t)alignment); }
+void operator delete(void* pointer) noexcept { countedFree(pointer, alignof(std::max_align_t)); }
+void operator delete[](void* pointer) noexcept { countedFree(pointer, alignof(std::max_align_t)); }
+void operator delete(void* pointer, size_t) noexcept { countedFree(pointer, alignof(std::max_align_t)); }
+void operator delete[](void* pointer, size_t) noexcept { countedFree(pointer, alignof(std::max_align_t)); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { countedFree(pointer, alignof(std::max_align_t)); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { countedFree(pointer, alignof(std::max_align_t)); }
+void operator delete(void* pointer, std::align_val_t alignment) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete(void* pointer, size_t, std::align_val_t alignment) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete[](void* pointer, size_t, std::align_val_t alignment) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete(void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept { countedFree(pointer, (size_t)alignment); }
+void operator delete[](void* pointer, std::align_val_t alignment, const std::nothrow_t&) noexcept { countedFree(pointer, (size_t)alignment); }
+#endif
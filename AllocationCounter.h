@@ -0,0 +1,41 @@
+#ifndef ALLOCATION_COUNTER_CLASS_H
+#define ALLOCATION_COUNTER_CLASS_H
+
+#include<cstdint>
+
+// Debug builds count heap allocations, release builds leave operator new alone
+#ifndef NDEBUG
+#define ALLOCATION_COUNTER
+#endif
+
+// Counts the heap allocations of every thread, so a frame loop can check that it runs without any once it is steady
+// Debug builds replace the global operator new, so every allocation made through it, the standard containers' and
+// std::function's included, counts on the thread that made it. malloc and whatever drivers and libraries allocate
+// on their own are not seen. Release builds keep the default operator new, Enabled is false and the counts stay 0.
+class AllocationCounter
+{
+public:
+#ifdef ALLOCATION_COUNTER
+	static constexpr bool Enabled = true;
+#else
+	static constexpr bool Enabled = false;
+#endif
+
+	// Allocations made on the calling thread while one of these is alive only count in Total, for the few places a
+	// steady frame allocates on purpose, such as the window title that is formatted once a second
+	class Allowed
+	{
+	public:
+		Allowed();
+		~Allowed();
+		Allowed(const Allowed&) = delete;
+		Allowed& operator=(const Allowed&) = delete;
+	};
+
+	// Allocations the calling thread has made so far outside of Allowed scopes
+	static uint64_t Thread();
+	// Allocations every thread has made so far
+	static uint64_t Total();
+};
+
+#endif
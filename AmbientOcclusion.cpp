@@ -0,0 +1,78 @@
+#include"AmbientOcclusion.h"
+#include"Quadtree.h"
+
+#include<glm/glm.hpp>
+#include<algorithm>
+#include<cmath>
+#include<vector>
+
+// Buildings a worker is handed at least, each casts a few hundred rays
+static const size_t BAKE_GRAIN = 64;
+
+// Casts the rays of every building against a tree of the whole city
+size_t AmbientOcclusion::Bake(const CityGenerator& city, GLfloat* instances, JobSystem& jobs) const
+{
+	size_t count = city.buildingCount();
+	if (count == 0)
+		return 0;
+	float half = std::max(city.halfExtentX(), city.halfExtentZ());
+	Quadtree tree(glm::vec2(-half), 2.0f * half);
+	for (size_t i = 0; i < count; i++)
+	{
+		Building b = city.building(i);
+		tree.Insert((uint32_t)i, glm::vec3(b.minX, 0.0f, b.minZ), glm::vec3(b.maxX, b.height, b.maxZ));
+	}
+	tree.Build();
+	float length = reach > 0.0f ? reach : city.layout.maxHeight;
+
+	// Directions around a wall facing +Z, spread evenly over the hemisphere in front of it by a spherical Fibonacci
+	// spiral and folded above the ground, which hides the half below the same way for every wall
+	glm::vec3 directions[RAYS];
+	float weightSum = 0.0f;
+	for (int r = 0; r < RAYS; r++)
+	{
+		float z = 1.0f - (r + 0.5f) / RAYS;
+		float radius = std::sqrt(1.0f - z * z);
+		float angle = r * 2.39996323f;
+		directions[r] = glm::vec3(radius * std::cos(angle), std::abs(radius * std::sin(angle)), z);
+		weightSum += z;
+	}
+
+	// Walls facing north, east, south and west, with the direction along each of them
+	const glm::vec3 normals[4] = { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(-1.0f, 0.0f, 0.0f) };
+	const glm::vec3 up(0.0f, 1.0f, 0.0f);
+	std::vector<size_t> sliceRays(jobs.Slices(count, BAKE_GRAIN), 0);
+	jobs.ParallelFor(count, BAKE_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			Building b = city.building(i);
+			glm::vec3 center(0.5f * (b.minX + b.maxX), 0.0f, 0.5f * (b.minZ + b.maxZ));
+			glm::vec3 halfSize(0.5f * (b.maxX - b.minX), 0.0f, 0.5f * (b.maxZ - b.minZ));
+			float hidden = 0.0f;
+			for (int wall = 0; wall < 4; wall++)
+			{
+				glm::vec3 normal = normals[wall];
+				glm::vec3 along = glm::cross(up, normal);
+				float width = glm::dot(halfSize, glm::abs(along));
+				// Just off the wall and the ground, so neither the building's own box nor the ground is behind a ray
+				glm::vec3 foot = center + normal * (glm::dot(halfSize, glm::abs(normal)) + 1e-3f) + up * 1e-2f;
+				for (int p = 0; p < POINTS_PER_WALL; p++)
+				{
+					glm::vec3 point = foot + along * (width * ((p + 0.5f) / POINTS_PER_WALL * 2.0f - 1.0f));
+					for (int r = 0; r < RAYS; r++)
+					{
+						glm::vec3 direction = along * directions[r].x + up * directions[r].y + normal * directions[r].z;
+						if (!tree.LineOfSight(point, point + direction * length))
+							hidden += directions[r].z;
+					}
+				}
+			}
+			instances[i * CityGenerator::INSTANCE_FLOATS + 11] = strength * hidden / (weightSum * 4 * POINTS_PER_WALL);
+			sliceRays[slice] += 4 * POINTS_PER_WALL * RAYS;
+		}
+	});
+	size_t rays = 0;
+	for (size_t sliceCount : sliceRays)
+		rays += sliceCount;
+	return rays;
+}
@@ -0,0 +1,33 @@
+#ifndef AMBIENT_OCCLUSION_CLASS_H
+#define AMBIENT_OCCLUSION_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"CityGenerator.h"
+#include"JobSystem.h"
+
+// Bakes how much of the sky the neighbours hide from the foot of every building's walls into float 11 of its
+// instance record, so narrow streets get contact shadowing for nothing at runtime. Points along the foot of each wall
+// cast a fixed set of rays over the quarter sphere above the ground and in front of the wall against a Quadtree of the
+// city, weighted by the cosine to the wall. The scene programs darken the walls by it at their foot, fading out
+// towards the roof, which is where the unit building has its vertices.
+class AmbientOcclusion
+{
+public:
+	// Rays cast from every point
+	static constexpr int RAYS = 32;
+	// Points along the foot of every wall
+	static constexpr int POINTS_PER_WALL = 4;
+
+	// How dark the foot of a wall with the whole sky hidden gets, from 0 to 1
+	float strength = 0.8f;
+	// Farthest a ray looks for a neighbour, the tallest building height of the layout when 0
+	float reach = 0.0f;
+
+	// Writes the occlusion of every building of city into its record in instances, laid out as GenerateInstances
+	// writes them, with the buildings split over the workers of jobs, and returns the number of rays cast
+	size_t Bake(const CityGenerator& city, GLfloat* instances, JobSystem& jobs) const;
+};
+
+#endif
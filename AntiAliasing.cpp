@@ -0,0 +1,265 @@
+#include"AntiAliasing.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+
+// Full screen triangle, every pixel of the target is filtered once
+static const char* fxaaVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+// FXAA as Timothy Lottes first published it: the luma of the four diagonal neighbours gives the direction across the
+// edge, and the pixel is blended with samples along the edge unless they stray outside the neighbourhood's range
+static const char* fxaaFragmentSource = R"(
+#version 330 core
+uniform sampler2D scene;
+
+out vec4 FragColor;
+
+const float EDGE_THRESHOLD = 1.0 / 8.0;
+const float EDGE_THRESHOLD_MIN = 1.0 / 24.0;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+const float SPAN_MAX = 8.0;
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec2 uv = gl_FragCoord.xy * texel;
+    vec4 center = texture(scene, uv);
+    float lumaM = luma(center.rgb);
+    float lumaNW = luma(textureOffset(scene, uv, ivec2(-1, 1)).rgb);
+    float lumaNE = luma(textureOffset(scene, uv, ivec2(1, 1)).rgb);
+    float lumaSW = luma(textureOffset(scene, uv, ivec2(-1, -1)).rgb);
+    float lumaSE = luma(textureOffset(scene, uv, ivec2(1, -1)).rgb);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    // Flat areas are left alone
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+    {
+        FragColor = center;
+        return;
+    }
+
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float scale = 1.0 / (min(abs(direction.x), abs(direction.y)) + reduce);
+    direction = clamp(direction * scale, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texel;
+
+    vec3 near = 0.5 * (texture(scene, uv + direction * (1.0 / 3.0 - 0.5)).rgb + texture(scene, uv + direction * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 far = near * 0.5 + 0.25 * (texture(scene, uv - direction * 0.5).rgb + texture(scene, uv + direction * 0.5).rgb);
+    float lumaFar = luma(far);
+    FragColor = vec4(lumaFar < lumaMin || lumaFar > lumaMax ? near : far, center.a);
+}
+)";
+
+// Parses the name of a mode
+bool AntiAliasing::Parse(const char* name, Mode& mode)
+{
+	static const struct { const char* name; Mode mode; } names[] = {
+		{ "none", NONE }, { "msaa2", MSAA_2X }, { "msaa4", MSAA_4X }, { "msaa8", MSAA_8X }, { "fxaa", FXAA }
+	};
+	for (const auto& entry : names)
+		if (std::strcmp(name, entry.name) == 0)
+		{
+			mode = entry.mode;
+			return true;
+		}
+	return false;
+}
+
+// Constructor that picks the sample count or builds the FXAA program
+AntiAliasing::AntiAliasing(Mode mode)
+	: mode(mode)
+{
+	if (multisampled())
+	{
+		GLsizei wanted = mode == MSAA_2X ? 2 : mode == MSAA_4X ? 4 : 8;
+		GLint maxSamples = 1;
+		glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+		samples = std::min<GLsizei>(wanted, maxSamples);
+		if (samples < wanted)
+			std::cerr << "The context allows " << samples << " samples per pixel at most, drawing with that many" << std::endl;
+		return;
+	}
+	if (mode != FXAA)
+		return;
+
+	fxaaProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, fxaaVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, fxaaFragmentSource, "FRAGMENT") });
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(fxaaProgram);
+	glUniform1i(glGetUniformLocation(fxaaProgram, "scene"), TEXTURE_UNIT);
+	GLState.UseProgram(previousProgram);
+
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+AntiAliasing::~AntiAliasing()
+{
+	Delete();
+}
+
+// Whether the mode draws several samples per pixel
+bool AntiAliasing::multisampled() const
+{
+	return mode == MSAA_2X || mode == MSAA_4X || mode == MSAA_8X;
+}
+
+// Name of the mode
+const char* AntiAliasing::name() const
+{
+	switch (mode)
+	{
+	case MSAA_2X: return "MSAA 2x";
+	case MSAA_4X: return "MSAA 4x";
+	case MSAA_8X: return "MSAA 8x";
+	case FXAA: return "FXAA";
+	default: return "no AA";
+	}
+}
+
+// Binds the target in place of the bound framebuffer
+void AntiAliasing::Begin(GLsizei width, GLsizei height)
+{
+	if (mode == NONE)
+		return;
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	output = (GLuint)previous;
+	if (width != AntiAliasing::width || height != AntiAliasing::height || framebuffer == 0)
+		resize(width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+// Resolves or filters the target into the framebuffer it replaced
+void AntiAliasing::End()
+{
+	if (mode == NONE)
+		return;
+	if (multisampled())
+	{
+		// Blitting from a multisampled framebuffer averages the samples of every pixel
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT | (resolveDepth ? GL_DEPTH_BUFFER_BIT : 0), GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, output);
+		return;
+	}
+
+	GLint previousProgram, previousVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	GLState.Disable(GL_DEPTH_TEST);
+	GLState.UseProgram(fxaaProgram);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, color);
+	GLState.BindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+}
+
+// Reallocates the target for a new size
+void AntiAliasing::resize(GLsizei width, GLsizei height)
+{
+	deleteTarget();
+	AntiAliasing::width = width;
+	AntiAliasing::height = height;
+
+	// Reverse-Z needs a float depth buffer, as in ReverseDepth's own target
+	GLenum depthFormat = reverseDepth ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24;
+	if (multisampled())
+	{
+		glGenRenderbuffers(1, &color);
+		glBindRenderbuffer(GL_RENDERBUFFER, color);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, color, GpuMemoryTracker::ImageBytes(GL_RGBA8, width, height) * samples);
+	}
+	else
+	{
+		// FXAA samples between texels along the edges
+		glGenTextures(1, &color);
+		GLState.BindTexture(GL_TEXTURE_2D, color);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, color, GpuMemoryTracker::ImageBytes(GL_RGBA8, width, height));
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+	}
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, multisampled() ? samples : 0, depthFormat, width, height);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, depth, GpuMemoryTracker::ImageBytes(depthFormat, width, height) * samples);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	if (multisampled())
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	else
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::ANTI_ALIASING::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Deletes the color, depth and framebuffer of the target
+void AntiAliasing::deleteTarget()
+{
+	if (color != 0 && multisampled())
+	{
+		GpuMemory.Untrack(GL_RENDERBUFFER, color);
+		glDeleteRenderbuffers(1, &color);
+	}
+	else if (color != 0)
+	{
+		GLState.DeleteTextures(1, &color);
+	}
+	GpuMemory.Untrack(GL_RENDERBUFFER, depth);
+	if (depth != 0)
+		glDeleteRenderbuffers(1, &depth);
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	color = depth = framebuffer = 0;
+}
+
+// Deletes the GL objects
+void AntiAliasing::Delete()
+{
+	deleteTarget();
+	if (fxaaProgram != 0)
+		GLState.DeleteProgram(fxaaProgram);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	fxaaProgram = emptyVAO = 0;
+}
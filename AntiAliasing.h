@@ -0,0 +1,77 @@
+#ifndef ANTI_ALIASING_CLASS_H
+#define ANTI_ALIASING_CLASS_H
+
+#include<glad/glad.h>
+
+// Smooths the edges of the buildings, either with a multisampled target the scene is drawn into and resolved from,
+// or with FXAA, a post pass over a single sampled target that blends along the edges it finds in the luma.
+// Like ReverseDepth's, the target replaces the bound framebuffer between Begin and End, so it has a float depth buffer
+// for reverse-Z and stands in for ReverseDepth's forward target. Deferred frames draw into a single sampled G-buffer,
+// so only FXAA applies to them. The profiler times End under the mode's name, the cost of drawing every sample falls
+// on the scene zones.
+class AntiAliasing
+{
+public:
+	enum Mode
+	{
+		NONE,
+		MSAA_2X,
+		MSAA_4X,
+		MSAA_8X,
+		FXAA
+	};
+
+	// FXAA samples the target on this texture unit, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 11;
+
+	// Set when the scene is drawn reverse-Z, see ReverseDepth.h, before the first Begin
+	bool reverseDepth = false;
+	// Set when the framebuffer the target replaces has a depth buffer of the same format that a later pass reads,
+	// such as PostProcess's fog, End then resolves the depth along with the color
+	bool resolveDepth = false;
+
+	// Parses "none", "msaa2", "msaa4", "msaa8" or "fxaa", false for anything else
+	static bool Parse(const char* name, Mode& mode);
+
+	// Constructor for a mode, samples beyond GL_MAX_SAMPLES are clamped to it and the target is made by the first Begin
+	AntiAliasing(Mode mode);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~AntiAliasing();
+	// An AntiAliasing owns its GL objects, so it cannot be copied
+	AntiAliasing(const AntiAliasing&) = delete;
+	AntiAliasing& operator=(const AntiAliasing&) = delete;
+
+	// Whether the mode draws several samples per pixel, which a deferred frame cannot
+	bool multisampled() const;
+	// Name of the mode, such as "MSAA 4x", which End is profiled under
+	const char* name() const;
+
+	// Binds a target of width by height in place of the bound framebuffer, reallocated when the size changed
+	void Begin(GLsizei width, GLsizei height);
+	// Resolves or filters the target into the framebuffer it replaced and binds that again
+	void End();
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	Mode mode;
+	GLsizei samples = 1;
+	// Color and depth of the target, the color a texture for FXAA to sample and a renderbuffer otherwise
+	GLuint framebuffer = 0;
+	GLuint color = 0;
+	GLuint depth = 0;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	// Framebuffer the target replaced
+	GLuint output = 0;
+	// FXAA program and the empty VAO its full screen triangle is drawn with
+	GLuint fxaaProgram = 0;
+	GLuint emptyVAO = 0;
+
+	// Reallocates the target for a new size
+	void resize(GLsizei width, GLsizei height);
+	// Deletes the color, depth and framebuffer of the target
+	void deleteTarget();
+};
+
+#endif
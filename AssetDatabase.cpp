@@ -0,0 +1,247 @@
+#include"AssetDatabase.h"
+
+#include<algorithm>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<vector>
+
+namespace fs = std::filesystem;
+
+// Start of the file, followed by the version of the layout and the number of artifact and input records
+static const uint32_t DATABASE_MAGIC = 0x42445341; // "ASDB"
+static const uint32_t DATABASE_VERSION = 1;
+
+// Records as they are laid out in the file, each kind sorted by the hash of its path
+struct ArtifactRecord
+{
+	uint64_t path;
+	uint64_t key;
+};
+struct InputRecord
+{
+	uint64_t path;
+	uint64_t bytes;
+	int64_t modified;
+	uint64_t content;
+};
+
+// 64 bit FNV-1a, the same as ContentCache's
+static uint64_t hashBytes(const unsigned char* bytes, size_t count, uint64_t hash = 0xcbf29ce484222325ull)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// Hash of a path spelled any way that names the same file from the same directory
+static uint64_t hashPath(const std::string& path)
+{
+	std::string normal = fs::path(path).lexically_normal().generic_string();
+	return hashBytes((const unsigned char*)normal.data(), normal.size());
+}
+
+// Records of the mapped file, null when it is not a database of this layout
+static const ArtifactRecord* artifactRecords(const MappedFile& file, uint32_t& count)
+{
+	uint32_t header[4];
+	count = 0;
+	if (!file.isOpen() || file.size() < sizeof(header))
+		return nullptr;
+	std::memcpy(header, file.data(), sizeof(header));
+	if (header[0] != DATABASE_MAGIC || header[1] != DATABASE_VERSION
+		|| file.size() != sizeof(header) + header[2] * sizeof(ArtifactRecord) + header[3] * sizeof(InputRecord))
+		return nullptr;
+	count = header[2];
+	return (const ArtifactRecord*)(file.data() + sizeof(header));
+}
+
+static const InputRecord* inputRecords(const MappedFile& file, uint32_t& count)
+{
+	uint32_t artifacts;
+	const ArtifactRecord* first = artifactRecords(file, artifacts);
+	count = first ? ((const uint32_t*)file.data())[3] : 0;
+	return first ? (const InputRecord*)(first + artifacts) : nullptr;
+}
+
+// Constructor that maps the database
+AssetDatabase::AssetDatabase(const std::string& path)
+	: path(path)
+{
+	// Looked up at random, the OS should not read ahead
+	if (file.Open(path, false))
+	{
+		uint32_t count;
+		if (!artifactRecords(file, count))
+		{
+			std::cerr << "ERROR::ASSET_DATABASE::UNKNOWN_FORMAT " << path << ", cooking everything again" << std::endl;
+			file.Close();
+		}
+	}
+}
+
+// Mixes a value into a key
+uint64_t AssetDatabase::Combine(uint64_t key, uint64_t value)
+{
+	return hashBytes((const unsigned char*)&value, sizeof(value), key);
+}
+
+// Mixes a string into a key, with its length so "ab", "c" and "a", "bc" differ
+uint64_t AssetDatabase::Combine(uint64_t key, const std::string& value)
+{
+	return hashBytes((const unsigned char*)value.data(), value.size(), Combine(key, (uint64_t)value.size()));
+}
+
+// Finds the saved key of an artifact by binary search
+bool AssetDatabase::findArtifact(uint64_t pathHash, uint64_t& key) const
+{
+	uint32_t count;
+	const ArtifactRecord* records = artifactRecords(file, count);
+	if (!records)
+		return false;
+	const ArtifactRecord* found = std::lower_bound(records, records + count, pathHash,
+		[](const ArtifactRecord& record, uint64_t value) { return record.path < value; });
+	if (found == records + count || found->path != pathHash)
+		return false;
+	key = found->key;
+	return true;
+}
+
+// Finds the saved stamp of an input by binary search
+bool AssetDatabase::findInput(uint64_t pathHash, Input& input) const
+{
+	uint32_t count;
+	const InputRecord* records = inputRecords(file, count);
+	if (!records)
+		return false;
+	const InputRecord* found = std::lower_bound(records, records + count, pathHash,
+		[](const InputRecord& record, uint64_t value) { return record.path < value; });
+	if (found == records + count || found->path != pathHash)
+		return false;
+	input = { found->bytes, found->modified, found->content };
+	return true;
+}
+
+// Reuses the recorded hash of an unchanged input, or hashes its content and records it
+uint64_t AssetDatabase::InputHash(const std::string& input)
+{
+	std::error_code error;
+	uint64_t bytes = (uint64_t)fs::file_size(input, error);
+	if (error)
+		return 0;
+	int64_t modified = (int64_t)fs::last_write_time(input, error).time_since_epoch().count();
+	if (error)
+		return 0;
+	uint64_t pathHash = hashPath(input);
+	Input recorded;
+	bool found;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto changed = inputs.find(pathHash);
+		found = changed != inputs.end();
+		if (found)
+			recorded = changed->second;
+	}
+	if (!found)
+		found = findInput(pathHash, recorded);
+	if (found && recorded.bytes == bytes && recorded.modified == modified)
+		return recorded.content;
+
+	MappedFile content;
+	if (!content.Open(input))
+		return 0;
+	// 0 is kept for unreadable inputs, so it is never a valid content hash
+	uint64_t hash = std::max<uint64_t>(1, hashBytes(content.data(), content.size()));
+	std::lock_guard<std::mutex> lock(mutex);
+	inputs[pathHash] = { bytes, modified, hash };
+	return hash;
+}
+
+// Checks the output exists and its key is the same, what was recorded since the last save comes first
+bool AssetDatabase::UpToDate(const std::string& output, uint64_t key)
+{
+	std::error_code error;
+	if (!fs::exists(output, error))
+		return false;
+	uint64_t pathHash = hashPath(output), recorded;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto changed = artifacts.find(pathHash);
+		if (changed != artifacts.end())
+			return changed->second == key;
+	}
+	return findArtifact(pathHash, recorded) && recorded == key;
+}
+
+// Holds the key of an artifact until the next save
+void AssetDatabase::Record(const std::string& output, uint64_t key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	artifacts[hashPath(output)] = key;
+}
+
+// Merges the saved records with the new ones and writes them sorted, under a temporary name first
+bool AssetDatabase::Save()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (artifacts.empty() && inputs.empty())
+		return true;
+	std::vector<ArtifactRecord> artifactList;
+	std::vector<InputRecord> inputList;
+	uint32_t count;
+	if (const ArtifactRecord* records = artifactRecords(file, count))
+		for (uint32_t i = 0; i < count; i++)
+			if (artifacts.count(records[i].path) == 0)
+				artifactList.push_back(records[i]);
+	if (const InputRecord* records = inputRecords(file, count))
+		for (uint32_t i = 0; i < count; i++)
+			if (inputs.count(records[i].path) == 0)
+				inputList.push_back(records[i]);
+	for (const auto& artifact : artifacts)
+		artifactList.push_back({ artifact.first, artifact.second });
+	for (const auto& input : inputs)
+		inputList.push_back({ input.first, input.second.bytes, input.second.modified, input.second.content });
+	std::sort(artifactList.begin(), artifactList.end(), [](const ArtifactRecord& a, const ArtifactRecord& b) { return a.path < b.path; });
+	std::sort(inputList.begin(), inputList.end(), [](const InputRecord& a, const InputRecord& b) { return a.path < b.path; });
+
+	std::error_code error;
+	fs::path target(path);
+	if (target.has_parent_path())
+		fs::create_directories(target.parent_path(), error);
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+		uint32_t header[4] = { DATABASE_MAGIC, DATABASE_VERSION, (uint32_t)artifactList.size(), (uint32_t)inputList.size() };
+		out.write((const char*)header, sizeof(header));
+		out.write((const char*)artifactList.data(), (std::streamsize)(artifactList.size() * sizeof(ArtifactRecord)));
+		out.write((const char*)inputList.data(), (std::streamsize)(inputList.size() * sizeof(InputRecord)));
+		if (!out)
+		{
+			std::cerr << "ERROR::ASSET_DATABASE::WRITE_FAILED " << path << std::endl;
+			return false;
+		}
+	}
+	// The old file has to be unmapped before it can be replaced on every OS
+	file.Close();
+	fs::rename(temporary, path, error);
+	if (error)
+	{
+		fs::remove(path, error);
+		fs::rename(temporary, path, error);
+	}
+	if (error)
+	{
+		// The new records stay on the side for the next try
+		std::cerr << "ERROR::ASSET_DATABASE::WRITE_FAILED " << path << std::endl;
+		file.Open(path, false);
+		return false;
+	}
+	artifacts.clear();
+	inputs.clear();
+	file.Open(path, false);
+	return true;
+}
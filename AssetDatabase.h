@@ -0,0 +1,63 @@
+#ifndef ASSET_DATABASE_CLASS_H
+#define ASSET_DATABASE_CLASS_H
+
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<unordered_map>
+
+#include"MappedFile.h"
+
+// Record of what every cooked artifact was made from, so a cook only redoes the artifacts whose inputs or tool changed
+// Each artifact is stored under the hash of its path with a key, the hashes of its inputs' contents combined with the
+// version of the tool and its settings, and each input with its size, modification time and the hash of its content.
+// An input whose size and time are still those recorded keeps its recorded hash without being read, so checking an
+// untouched tree reads no input at all. The file is mapped and its records sorted, so a check is a binary search in
+// place instead of a parse of the whole file, and what a cook records is held on the side until Save merges it in.
+// Every call but Save is safe from any thread at once, so the cooking workers check and record their own artifacts.
+class AssetDatabase
+{
+public:
+	// Constructor that maps the database at path, a missing or foreign file is an empty database
+	AssetDatabase(const std::string& path);
+	// An AssetDatabase owns its mapping, so it cannot be copied
+	AssetDatabase(const AssetDatabase&) = delete;
+	AssetDatabase& operator=(const AssetDatabase&) = delete;
+
+	// Mixes value into a key, the same way for every tool so keys never depend on where they were made
+	static uint64_t Combine(uint64_t key, uint64_t value);
+	// Mixes the bytes of a string into a key, such as the name of a setting
+	static uint64_t Combine(uint64_t key, const std::string& value);
+	// Hash of the content of input, read only when its size or modification time changed since it was recorded
+	// Returns 0 if it cannot be read
+	uint64_t InputHash(const std::string& input);
+	// Checks if output exists and was last cooked with key
+	bool UpToDate(const std::string& output, uint64_t key);
+	// Records that output was cooked with key
+	void Record(const std::string& output, uint64_t key);
+
+	// Writes the database with everything recorded since it was mapped, false if it cannot be written
+	// The file is mapped again afterwards, so no other call may run at the same time
+	bool Save();
+private:
+	// An input as it was when its content was hashed
+	struct Input
+	{
+		uint64_t bytes;
+		int64_t modified;
+		uint64_t content;
+	};
+
+	std::string path;
+	// The database as it was last saved, and what was recorded since by the hash of the path
+	MappedFile file;
+	std::unordered_map<uint64_t, uint64_t> artifacts;
+	std::unordered_map<uint64_t, Input> inputs;
+	std::mutex mutex;
+
+	// Saved records of an artifact or an input, false if there are none
+	bool findArtifact(uint64_t pathHash, uint64_t& key) const;
+	bool findInput(uint64_t pathHash, Input& input) const;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include"BenchmarkReport.h"
+
+#include<cstdlib>
+#include<fstream>
+#include<iomanip>
+#include<sstream>
+
+// Sets a metric
+void BenchmarkReport::Set(const std::string& name, double value)
+{
+	for (Metric& metric : metrics)
+	{
+		if (metric.name == name)
+		{
+			metric.value = value;
+			return;
+		}
+	}
+	metrics.push_back({ name, value });
+}
+
+// Value of a metric
+const double* BenchmarkReport::Find(const std::string& name) const
+{
+	for (const Metric& metric : metrics)
+		if (metric.name == name)
+			return &metric.value;
+	return nullptr;
+}
+
+// Sets the path of a subsystem
+void BenchmarkReport::SetPath(const std::string& subsystem, const std::string& name)
+{
+	for (Path& path : paths)
+	{
+		if (path.subsystem == subsystem)
+		{
+			path.name = name;
+			return;
+		}
+	}
+	paths.push_back({ subsystem, name });
+}
+
+// Path of a subsystem
+const std::string* BenchmarkReport::FindPath(const std::string& subsystem) const
+{
+	for (const Path& path : paths)
+		if (path.subsystem == subsystem)
+			return &path.name;
+	return nullptr;
+}
+
+// Writes the report
+bool BenchmarkReport::Write(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << std::setprecision(9);
+	file << "{\n  \"scene\": \"" << scene << "\",\n  \"frames\": " << frames << ",\n";
+	// Before the metrics, Read takes the strings of this object for paths
+	if (!paths.empty())
+	{
+		file << "  \"paths\": {\n";
+		for (size_t i = 0; i < paths.size(); i++)
+			file << "    \"" << paths[i].subsystem << "\": \"" << paths[i].name << "\"" << (i + 1 < paths.size() ? "," : "") << "\n";
+		file << "  },\n";
+	}
+	file << "  \"metrics\": {\n";
+	for (size_t i = 0; i < metrics.size(); i++)
+		file << "    \"" << metrics[i].name << "\": " << metrics[i].value << (i + 1 < metrics.size() ? "," : "") << "\n";
+	file << "  }\n}\n";
+	return (bool)file;
+}
+
+// Reads a report written by Write
+bool BenchmarkReport::Read(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string text = buffer.str();
+
+	// Only the layout Write produces is understood: quoted names, each followed by a colon and a string or a number
+	scene.clear();
+	frames = 0;
+	metrics.clear();
+	paths.clear();
+	// Name of the object the parser is in, none of the objects holds another
+	std::string object;
+	size_t position = 0;
+	for (;;)
+	{
+		size_t open = text.find('"', position);
+		if (open == std::string::npos)
+			break;
+		size_t close = text.find('"', open + 1);
+		size_t colon = close == std::string::npos ? std::string::npos : text.find_first_not_of(" \t\r\n", close + 1);
+		if (colon == std::string::npos || text[colon] != ':')
+			break;
+		std::string name = text.substr(open + 1, close - open - 1);
+		size_t value = text.find_first_not_of(" \t\r\n", colon + 1);
+		if (value == std::string::npos)
+			break;
+		position = value;
+		if (text[value] == '"')
+		{
+			size_t end = text.find('"', value + 1);
+			if (end == std::string::npos)
+				break;
+			if (object == "paths")
+				SetPath(name, text.substr(value + 1, end - value - 1));
+			else if (name == "scene")
+				scene = text.substr(value + 1, end - value - 1);
+			position = end + 1;
+		}
+		else if (text[value] == '{')
+		{
+			object = name;
+			position = value + 1;
+		}
+		else
+		{
+			double number = std::strtod(text.c_str() + value, nullptr);
+			if (object == "metrics")
+				Set(name, number);
+			else if (name == "frames")
+				frames = (int)number;
+		}
+	}
+	return !metrics.empty();
+}
+
+// Compares two reports
+std::vector<BenchmarkReport::Difference> BenchmarkReport::Compare(const BenchmarkReport& baseline, const BenchmarkReport& current, double thresholdPercent)
+{
+	std::vector<Difference> differences;
+	for (const Metric& metric : baseline.metrics)
+	{
+		const double* value = current.Find(metric.name);
+		if (!value)
+			continue;
+		Difference difference;
+		difference.name = metric.name;
+		difference.baseline = metric.value;
+		difference.current = *value;
+		if (metric.value != 0.0)
+			difference.percent = (*value - metric.value) / metric.value * 100.0;
+		else
+			difference.percent = *value > 0.0 ? 100.0 : 0.0;
+		difference.regression = difference.percent > thresholdPercent;
+		differences.push_back(difference);
+	}
+	return differences;
+}
@@ -0,0 +1,64 @@
+#ifndef BENCHMARK_REPORT_CLASS_H
+#define BENCHMARK_REPORT_CLASS_H
+
+#include<string>
+#include<vector>
+
+// Numbers measured by one benchmark run, written as a small JSON file so two runs can be compared later
+// Every metric is better when it is lower: frame times, draw calls, triangles and memory
+class BenchmarkReport
+{
+public:
+	// One measured number
+	struct Metric
+	{
+		std::string name;
+		double value;
+	};
+
+	// Path a subsystem took on the machine the report was made on, such as "multi draw indirect" for "draws"
+	struct Path
+	{
+		std::string subsystem;
+		std::string name;
+	};
+
+	// One metric of two reports side by side
+	struct Difference
+	{
+		std::string name;
+		double baseline;
+		double current;
+		// Change relative to the baseline, a metric going up from 0 counts as 100 percent
+		double percent;
+		bool regression;
+	};
+
+	// Name of the benchmark scene and how many frames were measured
+	std::string scene;
+	int frames = 0;
+	// Metrics in the order they were set
+	std::vector<Metric> metrics;
+	// Paths in the order they were set, they explain a difference between two reports but are not compared as metrics
+	std::vector<Path> paths;
+
+	// Sets a metric, replacing an earlier value of the same name
+	void Set(const std::string& name, double value);
+	// Value of a metric, nullptr if the report has none of that name
+	const double* Find(const std::string& name) const;
+	// Sets the path of a subsystem, replacing an earlier one
+	void SetPath(const std::string& subsystem, const std::string& name);
+	// Path of a subsystem, nullptr if the report has none for it
+	const std::string* FindPath(const std::string& subsystem) const;
+
+	// Writes the report, returns false if the file cannot be written
+	bool Write(const std::string& path) const;
+	// Reads a report written by Write, returns false if the file cannot be read or holds no metric
+	bool Read(const std::string& path);
+
+	// Compares the metrics both reports have in the order of the baseline, a metric regressed when it grew by more
+	// than thresholdPercent
+	static std::vector<Difference> Compare(const BenchmarkReport& baseline, const BenchmarkReport& current, double thresholdPercent);
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include"BlockQueries.h"
+#include"GLStateCache.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<glm/gtc/type_ptr.hpp>
+
+// A box as one strip of 14 vertices from gl_VertexID, the bits of each mask pick min or max of one axis per vertex
+static const char* boxVertexSource = R"(
+#version 330 core
+uniform mat4 matrix;
+uniform vec3 boxMin;
+uniform vec3 boxMax;
+
+void main()
+{
+    vec3 corner = vec3((0x287a >> gl_VertexID) & 1, (0x02af >> gl_VertexID) & 1, (0x31e3 >> gl_VertexID) & 1);
+    gl_Position = matrix * vec4(mix(boxMin, boxMax, corner), 1.0);
+}
+)";
+// Nothing is written, the query only counts the samples that pass the depth test
+static const char* boxFragmentSource = R"(
+#version 330 core
+void main()
+{
+}
+)";
+
+// How close to a box the eye may come before the near plane could cut into it
+static const float NEAR_MARGIN = 1.0f;
+
+// Constructor that builds the box program and a query per block
+BlockQueries::BlockQueries(const std::vector<glm::vec3>& min, const std::vector<glm::vec3>& max)
+	: boxMin(min), boxMax(max)
+{
+	boxProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, boxVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, boxFragmentSource, "FRAGMENT") });
+	matrixLocation = glGetUniformLocation(boxProgram, "matrix");
+	minLocation = glGetUniformLocation(boxProgram, "boxMin");
+	maxLocation = glGetUniformLocation(boxProgram, "boxMax");
+	glGenVertexArrays(1, &emptyVAO);
+
+	queries.resize(boxMin.size());
+	if (!queries.empty())
+		glGenQueries((GLsizei)queries.size(), queries.data());
+	queried.assign(boxMin.size(), 0);
+}
+
+// Deletes the GL objects unless Delete was already called
+BlockQueries::~BlockQueries()
+{
+	Delete();
+}
+
+// Renders the block's draws on its last query, a query still in flight lets them through
+void BlockQueries::BeginDraw(uint32_t block)
+{
+	if (queried[block])
+		glBeginConditionalRender(queries[block], GL_QUERY_NO_WAIT);
+}
+
+// Ends the conditional rendering BeginDraw started
+void BlockQueries::EndDraw(uint32_t block)
+{
+	if (queried[block])
+		glEndConditionalRender();
+}
+
+// Draws every box inside its query with nothing written, a block the eye is in is left without one
+void BlockQueries::Issue(const uint32_t* blocks, size_t count, const glm::mat4& matrix, const glm::vec3& eye)
+{
+	GLint previousProgram, previousVAO;
+	GLboolean colorMask[4], depthMask;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	GLState.UseProgram(boxProgram);
+	GLState.BindVertexArray(emptyVAO);
+	glUniformMatrix4fv(matrixLocation, 1, GL_FALSE, glm::value_ptr(matrix));
+	GLState.CountUniforms();
+
+	std::fill(queried.begin(), queried.end(), (uint8_t)0);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t block = blocks[i];
+		const glm::vec3& min = boxMin[block];
+		const glm::vec3& max = boxMax[block];
+		if (glm::all(glm::greaterThanEqual(eye, min - NEAR_MARGIN)) && glm::all(glm::lessThanEqual(eye, max + NEAR_MARGIN)))
+			continue;
+		glUniform3fv(minLocation, 1, glm::value_ptr(min));
+		glUniform3fv(maxLocation, 1, glm::value_ptr(max));
+		GLState.CountUniforms(2);
+		glBeginQuery(GL_ANY_SAMPLES_PASSED, queries[block]);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 14);
+		glEndQuery(GL_ANY_SAMPLES_PASSED);
+		GLState.CountDraw(1, 12);
+		queried[block] = 1;
+	}
+
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+	glDepthMask(depthMask);
+}
+
+// Number of blocks
+size_t BlockQueries::blockCount() const
+{
+	return boxMin.size();
+}
+
+// Deletes the GL objects
+void BlockQueries::Delete()
+{
+	if (!queries.empty())
+		glDeleteQueries((GLsizei)queries.size(), queries.data());
+	queries.clear();
+	queried.clear();
+	if (boxProgram != 0)
+		GLState.DeleteProgram(boxProgram);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	boxProgram = emptyVAO = 0;
+}
@@ -0,0 +1,53 @@
+#ifndef BLOCK_QUERIES_CLASS_H
+#define BLOCK_QUERIES_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstdint>
+#include<vector>
+
+// Occlusion queries on the boxes of whole city blocks, a middle ground that needs nothing beyond GL 3.3
+// After the scene is drawn, Issue draws the box of every block inside the frustum with color and depth writes off,
+// each inside an any samples passed query, the hidden ones too so they come back once they are in sight. The next
+// frame draws each of those blocks between BeginDraw and EndDraw, which wraps it in conditional rendering on the
+// block's query without waiting for the result: the GPU skips the draw if the query is done and no sample passed,
+// and draws it anyway if it is not done yet. The CPU never reads a query back. A block whose box the eye is in or
+// next to gets no query, the near plane could clip its box away.
+class BlockQueries
+{
+public:
+	// Constructor for blocks with the boxes from min to max in model space, one of each per block
+	BlockQueries(const std::vector<glm::vec3>& min, const std::vector<glm::vec3>& max);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~BlockQueries();
+	// A BlockQueries owns its GL objects, so it cannot be copied
+	BlockQueries(const BlockQueries&) = delete;
+	BlockQueries& operator=(const BlockQueries&) = delete;
+
+	// Starts conditional rendering on the block's query of the last frame, if it has one
+	void BeginDraw(uint32_t block);
+	// Ends what BeginDraw started
+	void EndDraw(uint32_t block);
+	// Queries the boxes of count blocks against the depth of the current framebuffer, with matrix taking model space to
+	// clip space and eye the camera in model space
+	void Issue(const uint32_t* blocks, size_t count, const glm::mat4& matrix, const glm::vec3& eye);
+
+	// Number of blocks
+	size_t blockCount() const;
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	std::vector<glm::vec3> boxMin;
+	std::vector<glm::vec3> boxMax;
+	std::vector<GLuint> queries;
+	// 1 for the blocks the last Issue queried, only those have a result to render on
+	std::vector<uint8_t> queried;
+	GLuint boxProgram = 0;
+	GLint matrixLocation = -1;
+	GLint minLocation = -1;
+	GLint maxLocation = -1;
+	GLuint emptyVAO = 0;
+};
+
+#endif
@@ -0,0 +1,606 @@
+#include"BoundingVolumeHierarchy.h"
+
+#include<algorithm>
+#include<cfloat>
+#include<cstring>
+
+static_assert(sizeof(BoundingVolumeHierarchy::Node) == 32, "a node has to match its std430 layout");
+
+// Boxes a slice of the parallel build takes at least
+static constexpr size_t BUILD_GRAIN = 4096;
+// Traversal stacks, the depth of a tree is at most MAX_DEPTH levels of splits plus the halving of what is left
+static constexpr size_t STACK_SIZE = 128;
+
+// Half the surface of a box, 0 for an empty one
+static float halfArea(const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 size = glm::max(max - min, glm::vec3(0.0f));
+	return size.x * size.y + size.y * size.z + size.z * size.x;
+}
+
+// Distance along a ray to where it enters a box, or FLT_MAX if it misses it
+// A ray starting inside the box enters it at 0 if fromInside is set and misses it otherwise
+static float rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance, bool fromInside)
+{
+	glm::vec3 t0 = (min - origin) * inverseDirection;
+	glm::vec3 t1 = (max - origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), tNear.z);
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+	if (enter < 0.0f)
+	{
+		if (!fromInside)
+			return FLT_MAX;
+		enter = 0.0f;
+	}
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+// Constructor that keeps up to leafSize boxes in a leaf
+BoundingVolumeHierarchy::BoundingVolumeHierarchy(uint32_t leafSize)
+{
+	BoundingVolumeHierarchy::leafSize = std::max<uint32_t>(leafSize, 1);
+}
+
+// Splits the top of the tree with the workers, then builds the subtrees below it one worker each
+void BoundingVolumeHierarchy::Build(const BoundingBoxes& source, JobSystem& jobs)
+{
+	size_t count = source.size();
+	nodes.clear();
+	items.resize(count);
+	jobs.ParallelFor(count, BUILD_GRAIN, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			items[i].min = glm::vec3(source.minX[i], source.minY[i], source.minZ[i]);
+			items[i].max = glm::vec3(source.maxX[i], source.maxY[i], source.maxZ[i]);
+			items[i].id = (uint32_t)i;
+		}
+	});
+
+	// A node of the top waits with its items, their bounds and its depth until it is split or handed to a worker.
+	// The bounds of a child come from the partition of its parent, so only the root's take a pass of their own
+	struct Pending
+	{
+		uint32_t node;
+		size_t begin, end;
+		uint32_t depth;
+		Range range;
+	};
+	std::vector<Range> sliceRanges;
+	auto boundInParallel = [&](size_t first, size_t last) {
+		sliceRanges.resize(jobs.Slices(last - first, BUILD_GRAIN));
+		jobs.ParallelFor(last - first, BUILD_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+			sliceRanges[slice] = bound(first + begin, first + end);
+		});
+		Range range = sliceRanges[0];
+		for (size_t slice = 1; slice < sliceRanges.size(); slice++)
+			merge(range, sliceRanges[slice]);
+		scaleBins(range);
+		return range;
+	};
+	std::vector<Pending> pending, subtrees;
+	if (count > 0)
+	{
+		nodes.push_back(Node());
+		pending.push_back({ 0, 0, count, 0, boundInParallel(0, count) });
+	}
+	std::vector<Item> scratch(count);
+	std::vector<Bin> sliceBins;
+	std::vector<size_t> sliceLeft;
+	while (!pending.empty())
+	{
+		Pending p = pending.back();
+		pending.pop_back();
+		size_t itemCount = p.end - p.begin;
+		nodes[p.node].min = p.range.min;
+		nodes[p.node].max = p.range.max;
+		if (itemCount < SUBTREE_ITEMS)
+		{
+			subtrees.push_back(p);
+			continue;
+		}
+
+		// Every slice bins its own part of the items, then the parts are merged
+		size_t slices = jobs.Slices(itemCount, BUILD_GRAIN);
+		sliceBins.resize(slices * 3 * BINS);
+		jobs.ParallelFor(itemCount, BUILD_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+			bin(p.range, p.begin + begin, p.begin + end, (Bin(*)[BINS]) &sliceBins[slice * 3 * BINS]);
+		});
+		Bin bins[3][BINS];
+		std::memcpy(bins, sliceBins.data(), sizeof(bins));
+		for (size_t slice = 1; slice < slices; slice++)
+		{
+			const Bin* other = &sliceBins[slice * 3 * BINS];
+			for (size_t i = 0; i < 3 * BINS; i++)
+			{
+				Bin& merged = bins[i / BINS][i % BINS];
+				merged.min = glm::min(merged.min, other[i].min);
+				merged.max = glm::max(merged.max, other[i].max);
+				merged.count += other[i].count;
+			}
+		}
+		Split split;
+		if (!choose(p.range, bins, itemCount, p.depth, split))
+		{
+			nodes[p.node].first = (uint32_t)p.begin;
+			nodes[p.node].count = (uint32_t)itemCount;
+			continue;
+		}
+
+		// Every slice counts and bounds its items of either side, then writes those that go left after those of the
+		// slices before it and its others after all that go left, so both halves keep their order
+		size_t middle = p.begin + itemCount / 2;
+		Range left, right;
+		if (split.axis >= 0)
+		{
+			sliceLeft.resize(slices);
+			sliceRanges.resize(2 * slices);
+			jobs.ParallelFor(itemCount, BUILD_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+				Range& sliceLeftRange = sliceRanges[2 * slice];
+				Range& sliceRightRange = sliceRanges[2 * slice + 1];
+				sliceLeftRange.min = sliceRightRange.min = sliceLeftRange.centerMin = sliceRightRange.centerMin = glm::vec3(FLT_MAX);
+				sliceLeftRange.max = sliceRightRange.max = sliceLeftRange.centerMax = sliceRightRange.centerMax = glm::vec3(-FLT_MAX);
+				size_t leftCount = 0;
+				for (size_t i = p.begin + begin; i < p.begin + end; i++)
+				{
+					bool goesLeft = binOf(p.range, split.axis, items[i]) < split.bin;
+					grow(items[i], goesLeft ? sliceLeftRange : sliceRightRange);
+					leftCount += goesLeft;
+				}
+				sliceLeft[slice] = leftCount;
+			});
+			size_t leftCount = 0;
+			left = sliceRanges[0];
+			right = sliceRanges[1];
+			for (size_t slice = 0; slice < slices; slice++)
+			{
+				if (slice > 0)
+				{
+					merge(left, sliceRanges[2 * slice]);
+					merge(right, sliceRanges[2 * slice + 1]);
+				}
+				size_t sliceCount = sliceLeft[slice];
+				sliceLeft[slice] = leftCount;
+				leftCount += sliceCount;
+			}
+			jobs.ParallelFor(itemCount, BUILD_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+				size_t toLeft = p.begin + sliceLeft[slice];
+				size_t toRight = p.begin + leftCount + (begin - sliceLeft[slice]);
+				for (size_t i = p.begin + begin; i < p.begin + end; i++)
+				{
+					if (binOf(p.range, split.axis, items[i]) < split.bin)
+						scratch[toLeft++] = items[i];
+					else
+						scratch[toRight++] = items[i];
+				}
+			});
+			jobs.ParallelFor(itemCount, BUILD_GRAIN, [&](size_t, size_t begin, size_t end) {
+				std::copy(scratch.begin() + p.begin + begin, scratch.begin() + p.begin + end, items.begin() + p.begin + begin);
+			});
+			middle = p.begin + leftCount;
+		}
+		else
+		{
+			left = boundInParallel(p.begin, middle);
+			right = boundInParallel(middle, p.end);
+		}
+		scaleBins(left);
+		scaleBins(right);
+		uint32_t children = (uint32_t)nodes.size();
+		nodes[p.node].first = children;
+		nodes[p.node].count = 0;
+		nodes.push_back(Node());
+		nodes.push_back(Node());
+		pending.push_back({ children + 1, middle, p.end, p.depth + 1, right });
+		pending.push_back({ children, p.begin, middle, p.depth + 1, left });
+	}
+
+	// Each subtree goes into nodes of its own, which are then moved behind the top with their children renumbered
+	std::vector<std::vector<Node>> built(subtrees.size());
+	jobs.ParallelFor(subtrees.size(), 1, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			buildSubtree(nodes[subtrees[i].node], subtrees[i].begin, subtrees[i].end, subtrees[i].depth, subtrees[i].range, built[i]);
+	});
+	std::vector<uint32_t> offsets(subtrees.size());
+	size_t total = nodes.size();
+	for (size_t i = 0; i < subtrees.size(); i++)
+	{
+		offsets[i] = (uint32_t)total;
+		total += built[i].size();
+		if (nodes[subtrees[i].node].count == 0)
+			nodes[subtrees[i].node].first += offsets[i];
+	}
+	nodes.resize(total);
+	jobs.ParallelFor(subtrees.size(), 1, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			Node* out = &nodes[offsets[i]];
+			for (const Node& node : built[i])
+			{
+				*out = node;
+				if (out->count == 0)
+					out->first += offsets[i];
+				out++;
+			}
+		}
+	});
+
+	// The leaves test the boxes in the order of the ids
+	ids.resize(count);
+	boxes.minX.resize(count);
+	boxes.minY.resize(count);
+	boxes.minZ.resize(count);
+	boxes.maxX.resize(count);
+	boxes.maxY.resize(count);
+	boxes.maxZ.resize(count);
+	jobs.ParallelFor(count, BUILD_GRAIN, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			ids[i] = items[i].id;
+			boxes.minX[i] = items[i].min.x;
+			boxes.minY[i] = items[i].min.y;
+			boxes.minZ[i] = items[i].min.z;
+			boxes.maxX[i] = items[i].max.x;
+			boxes.maxY[i] = items[i].max.y;
+			boxes.maxZ[i] = items[i].max.z;
+		}
+	});
+	items.clear();
+}
+
+// Children always come after their parent, so going backwards bounds every parent from finished children
+void BoundingVolumeHierarchy::Refit(const BoundingBoxes& source)
+{
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		uint32_t id = ids[i];
+		boxes.minX[i] = source.minX[id];
+		boxes.minY[i] = source.minY[id];
+		boxes.minZ[i] = source.minZ[id];
+		boxes.maxX[i] = source.maxX[id];
+		boxes.maxY[i] = source.maxY[id];
+		boxes.maxZ[i] = source.maxZ[id];
+	}
+	for (size_t node = nodes.size(); node-- > 0;)
+	{
+		Node& n = nodes[node];
+		if (n.count == 0)
+		{
+			n.min = glm::min(nodes[n.first].min, nodes[n.first + 1].min);
+			n.max = glm::max(nodes[n.first].max, nodes[n.first + 1].max);
+			continue;
+		}
+		n.min = glm::vec3(FLT_MAX);
+		n.max = glm::vec3(-FLT_MAX);
+		for (uint32_t i = n.first; i < n.first + n.count; i++)
+		{
+			n.min = glm::min(n.min, glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]));
+			n.max = glm::max(n.max, glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]));
+		}
+	}
+}
+
+// Builds the subtree below a node depth first on the calling thread
+void BoundingVolumeHierarchy::buildSubtree(Node& root, size_t begin, size_t end, uint32_t depth, const Range& range, std::vector<Node>& out)
+{
+	// The root is the caller's node, every other is numbered by its place in out. The bounds of a node come from the
+	// partition of its parent, so every level reads its items only to bin and partition them
+	struct Pending
+	{
+		uint32_t node;
+		size_t begin, end;
+		uint32_t depth;
+		Range range;
+	};
+	Pending stack[STACK_SIZE];
+	size_t top = 0;
+	stack[top++] = { INVALID, begin, end, depth, range };
+	while (top > 0)
+	{
+		Pending p = stack[--top];
+		size_t itemCount = p.end - p.begin;
+		Node node;
+		node.min = p.range.min;
+		node.max = p.range.max;
+		node.first = (uint32_t)p.begin;
+		node.count = (uint32_t)itemCount;
+
+		Bin bins[3][BINS];
+		Split split;
+		if (itemCount > leafSize)
+			bin(p.range, p.begin, p.end, bins);
+		if (itemCount > leafSize && choose(p.range, bins, itemCount, p.depth, split))
+		{
+			size_t middle = p.begin + itemCount / 2;
+			Range left, right;
+			if (split.axis >= 0)
+			{
+				left.min = right.min = left.centerMin = right.centerMin = glm::vec3(FLT_MAX);
+				left.max = right.max = left.centerMax = right.centerMax = glm::vec3(-FLT_MAX);
+				size_t i = p.begin, j = p.end;
+				while (i < j)
+				{
+					if (binOf(p.range, split.axis, items[i]) < split.bin)
+					{
+						grow(items[i], left);
+						i++;
+					}
+					else
+					{
+						grow(items[i], right);
+						std::swap(items[i], items[--j]);
+					}
+				}
+				middle = i;
+				scaleBins(left);
+				scaleBins(right);
+			}
+			else
+			{
+				left = bound(p.begin, middle);
+				right = bound(middle, p.end);
+			}
+			node.first = (uint32_t)out.size();
+			node.count = 0;
+			out.push_back(Node());
+			out.push_back(Node());
+			// The left child is built first, so its subtree comes right after the pair
+			stack[top++] = { node.first + 1, middle, p.end, p.depth + 1, right };
+			stack[top++] = { node.first, p.begin, middle, p.depth + 1, left };
+		}
+		if (p.node == INVALID)
+			root = node;
+		else
+			out[p.node] = node;
+	}
+}
+
+// Bounds of the items from begin to end
+BoundingVolumeHierarchy::Range BoundingVolumeHierarchy::bound(size_t begin, size_t end) const
+{
+	Range range;
+	range.min = range.centerMin = glm::vec3(FLT_MAX);
+	range.max = range.centerMax = glm::vec3(-FLT_MAX);
+	for (size_t i = begin; i < end; i++)
+		grow(items[i], range);
+	scaleBins(range);
+	return range;
+}
+
+// Grows bounds by others, the scale of the bins is left to scaleBins
+void BoundingVolumeHierarchy::merge(Range& range, const Range& other)
+{
+	range.min = glm::min(range.min, other.min);
+	range.max = glm::max(range.max, other.max);
+	range.centerMin = glm::min(range.centerMin, other.centerMin);
+	range.centerMax = glm::max(range.centerMax, other.centerMax);
+}
+
+// Adds the box of an item to bounds
+void BoundingVolumeHierarchy::grow(const Item& item, Range& range)
+{
+	glm::vec3 center = 0.5f * (item.min + item.max);
+	range.min = glm::min(range.min, item.min);
+	range.max = glm::max(range.max, item.max);
+	range.centerMin = glm::min(range.centerMin, center);
+	range.centerMax = glm::max(range.centerMax, center);
+}
+
+// Sets the scale of the bins from the bounds of the centres
+void BoundingVolumeHierarchy::scaleBins(Range& range)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = range.centerMax[axis] - range.centerMin[axis];
+		range.binScale[axis] = extent > 0.0f ? (float)BINS / extent : 0.0f;
+	}
+}
+
+// Adds the items from begin to end to the bins of every axis
+void BoundingVolumeHierarchy::bin(const Range& range, size_t begin, size_t end, Bin bins[3][BINS]) const
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (uint32_t b = 0; b < BINS; b++)
+		{
+			bins[axis][b].min = glm::vec3(FLT_MAX);
+			bins[axis][b].max = glm::vec3(-FLT_MAX);
+			bins[axis][b].count = 0;
+		}
+	}
+	for (size_t i = begin; i < end; i++)
+	{
+		const Item& item = items[i];
+		Bin* axisBins[3] = { &bins[0][binOf(range, 0, item)], &bins[1][binOf(range, 1, item)], &bins[2][binOf(range, 2, item)] };
+		for (Bin* b : axisBins)
+		{
+			b->min = glm::min(b->min, item.min);
+			b->max = glm::max(b->max, item.max);
+			b->count++;
+		}
+	}
+}
+
+// Bin the centre of an item falls into along an axis
+uint32_t BoundingVolumeHierarchy::binOf(const Range& range, int axis, const Item& item)
+{
+	float position = (0.5f * (item.min[axis] + item.max[axis]) - range.centerMin[axis]) * range.binScale[axis];
+	return std::min((uint32_t)std::max(position, 0.0f), BINS - 1);
+}
+
+// Picks the cheapest split of binned ids, a test of a node costs as much as a test of a box
+bool BoundingVolumeHierarchy::choose(const Range& range, const Bin bins[3][BINS], size_t count, uint32_t depth, Split& split) const
+{
+	if (count <= leafSize)
+		return false;
+	// Halves keep the tree from getting deeper than the traversal stacks, and are all there is when every centre is
+	// the same point
+	split.axis = -1;
+	split.bin = 0;
+	if (depth >= MAX_DEPTH)
+		return true;
+	float best = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (range.binScale[axis] == 0.0f)
+			continue;
+		// Areas and counts of everything right of each bin boundary, then a sweep from the left
+		float rightArea[BINS];
+		uint32_t rightCount[BINS];
+		glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+		uint32_t right = 0;
+		for (uint32_t b = BINS - 1; b > 0; b--)
+		{
+			min = glm::min(min, bins[axis][b].min);
+			max = glm::max(max, bins[axis][b].max);
+			right += bins[axis][b].count;
+			rightArea[b] = halfArea(min, max);
+			rightCount[b] = right;
+		}
+		min = glm::vec3(FLT_MAX);
+		max = glm::vec3(-FLT_MAX);
+		uint32_t left = 0;
+		for (uint32_t b = 1; b < BINS; b++)
+		{
+			min = glm::min(min, bins[axis][b - 1].min);
+			max = glm::max(max, bins[axis][b - 1].max);
+			left += bins[axis][b - 1].count;
+			if (left == 0 || rightCount[b] == 0)
+				continue;
+			float cost = halfArea(min, max) * left + rightArea[b] * rightCount[b];
+			if (cost < best)
+			{
+				best = cost;
+				split.axis = axis;
+				split.bin = b;
+			}
+		}
+	}
+	if (split.axis < 0)
+		return true;
+	// A leaf of a few boxes more is kept when testing them all is cheaper than a node and its two children
+	float area = halfArea(range.min, range.max);
+	return count > 4 * (size_t)leafSize || area <= 0.0f || 1.0f + best / area < (float)count;
+}
+
+// Writes the index of every box that is at least partly inside the frustum
+size_t BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, uint32_t* result) const
+{
+	size_t count = 0;
+	if (nodes.empty())
+		return 0;
+	uint32_t stack[STACK_SIZE];
+	size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		uint32_t index = stack[--top];
+		const Node& n = nodes[index];
+		if (!frustum.TestBox(n.min, n.max))
+			continue;
+		// Everything below a node that is fully inside is visible without further tests, and is one run of the ids
+		if (frustum.ContainsBox(n.min, n.max))
+		{
+			uint32_t begin, end;
+			itemRange(index, begin, end);
+			std::memcpy(result + count, ids.data() + begin, (end - begin) * sizeof(uint32_t));
+			count += end - begin;
+			continue;
+		}
+		if (n.count == 0)
+		{
+			stack[top++] = n.first + 1;
+			stack[top++] = n.first;
+			continue;
+		}
+		// Cull writes where the boxes are, which become the ids of what they hold
+		size_t kept = frustum.Cull(boxes, n.first, n.count, result + count);
+		for (size_t i = count; i < count + kept; i++)
+			result[i] = ids[result[i]];
+		count += kept;
+	}
+	return count;
+}
+
+// Run of the ids below a node, from its leftmost leaf to its rightmost one
+void BoundingVolumeHierarchy::itemRange(uint32_t node, uint32_t& begin, uint32_t& end) const
+{
+	uint32_t left = node, right = node;
+	while (nodes[left].count == 0)
+		left = nodes[left].first;
+	while (nodes[right].count == 0)
+		right = nodes[right].first + 1;
+	begin = nodes[left].first;
+	end = nodes[right].first + nodes[right].count;
+}
+
+// Finds the closest box the ray hits within maxDistance
+uint32_t BoundingVolumeHierarchy::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance) const
+{
+	if (nodes.empty())
+		return INVALID;
+	glm::vec3 inverseDirection = 1.0f / direction;
+	uint32_t best = INVALID;
+	float bestDistance = maxDistance;
+	// Nodes are kept with the distance the ray enters them at
+	uint32_t stack[STACK_SIZE];
+	float entered[STACK_SIZE];
+	size_t top = 0;
+	float t = rayBox(origin, inverseDirection, nodes[0].min, nodes[0].max, bestDistance, true);
+	if (t != FLT_MAX)
+	{
+		stack[top] = 0;
+		entered[top++] = t;
+	}
+	while (top > 0)
+	{
+		top--;
+		// Nodes entered after the closest hit so far cannot hold a closer one
+		if (entered[top] > bestDistance)
+			continue;
+		const Node& n = nodes[stack[top]];
+		if (n.count == 0)
+		{
+			// The nearer child goes on top, so its hits prune the other
+			float near = rayBox(origin, inverseDirection, nodes[n.first].min, nodes[n.first].max, bestDistance, true);
+			float far = rayBox(origin, inverseDirection, nodes[n.first + 1].min, nodes[n.first + 1].max, bestDistance, true);
+			uint32_t nearChild = n.first, farChild = n.first + 1;
+			if (far < near)
+			{
+				std::swap(near, far);
+				std::swap(nearChild, farChild);
+			}
+			if (far != FLT_MAX)
+			{
+				stack[top] = farChild;
+				entered[top++] = far;
+			}
+			if (near != FLT_MAX)
+			{
+				stack[top] = nearChild;
+				entered[top++] = near;
+			}
+			continue;
+		}
+		for (uint32_t i = n.first; i < n.first + n.count; i++)
+		{
+			glm::vec3 min(boxes.minX[i], boxes.minY[i], boxes.minZ[i]);
+			glm::vec3 max(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]);
+			float hit = rayBox(origin, inverseDirection, min, max, bestDistance, false);
+			if (hit == FLT_MAX || (best != INVALID && hit >= bestDistance))
+				continue;
+			best = ids[i];
+			bestDistance = hit;
+		}
+	}
+	if (best != INVALID && hitDistance)
+		*hitDistance = bestDistance;
+	return best;
+}
+
+// Number of boxes stored
+size_t BoundingVolumeHierarchy::size() const
+{
+	return ids.size();
+}
@@ -2,117 +2,229 @@
 
 
 
-Camera::Camera(int width, int height, glm::vec3 position)
+Camera::Camera(glm::vec3 position, glm::vec3 worldUp, float yaw, float pitch)
 {
-	Camera::width = width;
-	Camera::height = height;
-	Position = position;
+	Position = glm::dvec3(position);
+	FloatPosition = position;
+	WorldUp = worldUp;
+	Yaw = yaw;
+	Pitch = pitch;
+	updateCameraVectors();
 }
 
-void Camera::updateMatrix(float FOVdeg, float nearPlane, float farPlane)
+void Camera::SetPose(const glm::vec3& position, float yaw, float pitch)
 {
-	// Initializes matrices since otherwise they will be the null matrix
-	glm::mat4 view = glm::mat4(1.0f);
-	glm::mat4 projection = glm::mat4(1.0f);
+	SetPose(glm::dvec3(position), yaw, pitch);
+}
+
+void Camera::SetPose(const glm::dvec3& position, float yaw, float pitch)
+{
+	// A path that holds still, or an interpolation between equal states, leaves the cached matrices valid
+	if (position == Position && yaw == Yaw && pitch == Pitch)
+		return;
+	Position = position;
+	FloatPosition = glm::vec3(position);
+	Yaw = yaw;
+	Pitch = pitch;
+	updateCameraVectors();
+}
 
-	// Makes camera look in the right direction from the right position
-	view = glm::lookAt(Position, Position + Orientation, Up);
+void Camera::SetPerspective(float FOVdeg, float aspect, float nearPlane, float farPlane)
+{
 	// Adds perspective to the scene
-	projection = glm::perspective(glm::radians(FOVdeg), (float)width / height, nearPlane, farPlane);
+	fullProjection = Matrix4(glm::perspective(glm::radians(FOVdeg), aspect, nearPlane, farPlane));
+	updateProjection();
+}
 
-	// Sets new camera matrix
-	cameraMatrix = projection * view;
+void Camera::SetReverseZPerspective(float FOVdeg, float aspect, float nearPlane)
+{
+	// The limit of glm::perspective as the far plane goes away, with the depth row changed to give near / distance
+	float focal = 1.0f / tan(glm::radians(FOVdeg) * 0.5f);
+	glm::mat4 reverse(0.0f);
+	reverse[0][0] = focal / aspect;
+	reverse[1][1] = focal;
+	reverse[2][3] = -1.0f;
+	reverse[3][2] = nearPlane;
+	fullProjection = Matrix4(reverse);
+	updateProjection();
 }
 
-void Camera::Matrix(Shader& shader, const char* uniform)
+void Camera::SetSubFrustum(const glm::vec4& window)
 {
-	// Exports camera matrix
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, uniform), 1, GL_FALSE, glm::value_ptr(cameraMatrix));
+	if (window == subFrustum)
+		return;
+	subFrustum = window;
+	updateProjection();
 }
 
+void Camera::updateProjection()
+{
+	// Scales the window to the NDC square after moving its center to the middle, in front of the projection, so only
+	// x and y change and depth stays as it was, which keeps reverse-Z working and the frustum planes follow
+	glm::vec2 size(subFrustum.z - subFrustum.x, subFrustum.w - subFrustum.y);
+	glm::mat4 crop(1.0f);
+	crop[0][0] = 2.0f / size.x;
+	crop[1][1] = 2.0f / size.y;
+	crop[3][0] = -(subFrustum.x + subFrustum.z) / size.x;
+	crop[3][1] = -(subFrustum.y + subFrustum.w) / size.y;
+	projectionMatrix = Matrix4(crop * glm::mat4(fullProjection));
+	viewProjectionDirty = true;
+}
 
+void Camera::ProcessKeyboard(int direction, float deltaTime)
+{
+	double velocity = MovementSpeed * deltaTime;
+	if (direction == GLFW_KEY_W)
+		Position += glm::dvec3(Front) * velocity;
+	if (direction == GLFW_KEY_S)
+		Position -= glm::dvec3(Front) * velocity;
+	if (direction == GLFW_KEY_A)
+		Position -= glm::dvec3(Right) * velocity;
+	if (direction == GLFW_KEY_D)
+		Position += glm::dvec3(Right) * velocity;
+	if (direction == GLFW_KEY_Q)
+		Position += glm::dvec3(Up) * velocity;
+	if (direction == GLFW_KEY_E)
+		Position -= glm::dvec3(Up) * velocity;
+	FloatPosition = glm::vec3(Position);
+	viewDirty = true;
+}
 
-void Camera::Inputs(GLFWwindow* window)
+void Camera::ProcessMouseMovement(float xoffset, float yoffset)
 {
-	// Handles key inputs
-	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-	{
-		Position += speed * Orientation;
-	}
-	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-	{
-		Position += speed * -glm::normalize(glm::cross(Orientation, Up));
-	}
-	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-	{
-		Position += speed * -Orientation;
-	}
-	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-	{
-		Position += speed * glm::normalize(glm::cross(Orientation, Up));
-	}
-	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-	{
-		Position += speed * Up;
-	}
-	if (glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS)
-	{
-		Position += speed * -Up;
-	}
-	if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-	{
-		speed = 0.4f;
-	}
-	else if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_RELEASE)
+	Yaw += xoffset * MouseSensitivity;
+	Pitch = glm::clamp(Pitch - yoffset * MouseSensitivity, -89.0f, 89.0f);
+	updateCameraVectors();
+}
+
+void Camera::Inputs(const Input::Snapshot& input, float deltaTime)
+{
+	// Handles key inputs, only keys that are held move the camera and make its matrices stale
+	float step = input.Down(GLFW_KEY_LEFT_SHIFT) ? 4.0f * deltaTime : deltaTime;
+	const int keys[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E };
+	for (int key : keys)
 	{
-		speed = 0.1f;
+		if (input.Down(key))
+			ProcessKeyboard(key, step);
 	}
+	if (input.Down(GLFW_KEY_SPACE))
+		ProcessKeyboard(GLFW_KEY_Q, step);
+	if (input.Down(GLFW_KEY_LEFT_CONTROL))
+		ProcessKeyboard(GLFW_KEY_E, step);
+
+	// Handles mouse inputs, the motion was summed while the look button held the cursor captured
+	if (input.mouseDelta != glm::vec2(0.0f))
+		ProcessMouseMovement(input.mouseDelta.x, input.mouseDelta.y);
+}
+
+const glm::vec3& Camera::position() const
+{
+	return FloatPosition;
+}
+
+const glm::dvec3& Camera::precisePosition() const
+{
+	return Position;
+}
+
+const glm::vec3& Camera::front() const
+{
+	return Front;
+}
+
+const glm::vec3& Camera::right() const
+{
+	return Right;
+}
+
+const glm::vec3& Camera::up() const
+{
+	return Up;
+}
+
+float Camera::yaw() const
+{
+	return Yaw;
+}
+
+float Camera::pitch() const
+{
+	return Pitch;
+}
+
+glm::mat4 Camera::view() const
+{
+	update();
+	return glm::mat4(viewMatrix);
+}
+
+glm::mat4 Camera::projection() const
+{
+	return glm::mat4(projectionMatrix);
+}
+
+glm::mat4 Camera::viewProjection() const
+{
+	update();
+	return glm::mat4(viewProjectionMatrix);
+}
+
+glm::mat4 Camera::relativeView() const
+{
+	update();
+	return glm::mat4(relativeViewMatrix);
+}
 
+const Frustum& Camera::frustum() const
+{
+	update();
+	return frustumPlanes;
+}
 
-	// Handles mouse inputs
-	if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+void Camera::Matrix(Shader& shader, const char* uniform) const
+{
+	// Exports camera matrix through the location cached by the shader
+	shader.setMat4(uniform, viewProjection());
+}
+
+void Camera::Export(FrameData& frameData) const
+{
+	// Writes the camera matrices and position into the per frame uniform data
+	update();
+	frameData.camMatrix = glm::mat4(viewProjectionMatrix);
+	frameData.view = glm::mat4(viewMatrix);
+	frameData.projection = glm::mat4(projectionMatrix);
+	frameData.camPos = glm::vec4(FloatPosition, 1.0f);
+}
+
+void Camera::updateCameraVectors()
+{
+	glm::vec3 front;
+	front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
+	front.y = sin(glm::radians(Pitch));
+	front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
+	Front = glm::normalize(front);
+	Right = glm::normalize(glm::cross(Front, WorldUp));
+	Up = glm::normalize(glm::cross(Right, Front));
+	viewDirty = true;
+}
+
+void Camera::update() const
+{
+	if (viewDirty)
 	{
-		// Hides mouse cursor
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
-
-		// Prevents camera from jumping on the first click
-		if (firstClick)
-		{
-			glfwSetCursorPos(window, (width / 2), (height / 2));
-			firstClick = false;
-		}
-
-		// Stores the coordinates of the cursor
-		double mouseX;
-		double mouseY;
-		// Fetches the coordinates of the cursor
-		glfwGetCursorPos(window, &mouseX, &mouseY);
-
-		// Normalizes and shifts the coordinates of the cursor such that they begin in the middle of the screen
-		// and then "transforms" them into degrees 
-		float rotX = sensitivity * (float)(mouseY - (height / 2)) / height;
-		float rotY = sensitivity * (float)(mouseX - (width / 2)) / width;
-
-		// Calculates upcoming vertical change in the Orientation
-		glm::vec3 newOrientation = glm::rotate(Orientation, glm::radians(-rotX), glm::normalize(glm::cross(Orientation, Up)));
-
-		// Decides whether or not the next vertical Orientation is legal or not
-		if (abs(glm::angle(newOrientation, Up) - glm::radians(90.0f)) <= glm::radians(85.0f))
-		{
-			Orientation = newOrientation;
-		}
-
-		// Rotates the Orientation left and right
-		Orientation = glm::rotate(Orientation, glm::radians(-rotY), Up);
-
-		// Sets mouse cursor to the middle of the screen so that it doesn't end up roaming around
-		glfwSetCursorPos(window, (width / 2), (height / 2));
+		// Makes camera look in the right direction from the right position, the translation is taken in double
+		// so the view stays exact however far the camera went
+		relativeViewMatrix = Matrix4(glm::lookAt(glm::vec3(0.0f), Front, Up));
+		viewMatrix = Matrix4(glm::mat4(glm::dmat4(glm::mat4(relativeViewMatrix)) * glm::translate(glm::dmat4(1.0), -Position)));
+		viewDirty = false;
+		viewProjectionDirty = true;
 	}
-	else if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE)
+	if (viewProjectionDirty)
 	{
-		// Unhides cursor since camera is not looking around anymore
-		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-		// Makes sure the next time the camera looks around it doesn't jump
-		firstClick = true;
+		// Sets new camera matrix and keeps the frustum planes in sync with it
+		viewProjectionMatrix = projectionMatrix * viewMatrix;
+		frustumPlanes.Extract(glm::mat4(viewProjectionMatrix));
+		viewProjectionDirty = false;
 	}
 }
\ No newline at end of file
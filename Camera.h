@@ -6,39 +6,109 @@
 #include<glm/glm.hpp>
 #include<glm/gtc/matrix_transform.hpp>
 #include<glm/gtc/type_ptr.hpp>
-#include<glm/gtx/rotate_vector.hpp>
-#include<glm/gtx/vector_angle.hpp>
+#if GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE
+#include<glm/gtc/type_aligned.hpp>
+#endif
 
 #include"shaderClass.h"
+#include"Frustum.h"
+#include"Input.h"
 
+// Fly camera turned by yaw and pitch, the one camera of the program
+// View, projection, their product and its frustum planes are computed the first time they are asked for after the
+// camera moved or the projection changed, so a camera that stands still costs no matrix math at all
+// The position is kept in double precision, so a camera far out in a streamed world still moves by the smallest
+// steps, and relativeView leaves it out for drawing around the camera with offsets worked out in double, see TileStreamer
 class Camera
 {
 public:
-	// Stores the main vectors of the camera
-	glm::vec3 Position;
-	glm::vec3 Orientation = glm::vec3(0.0f, 0.0f, -1.0f);
-	glm::vec3 Up = glm::vec3(0.0f, 1.0f, 0.0f);
-	glm::mat4 cameraMatrix = glm::mat4(1.0f);
+	// The cached matrices are 16 byte aligned glm types when the build allows them (GLM_FORCE_INTRINSICS with
+	// language extensions), glm then multiplies them with SIMD instructions
+#if GLM_CONFIG_ALIGNED_GENTYPES == GLM_ENABLE
+	typedef glm::aligned_mat4 Matrix4;
+#else
+	typedef glm::mat4 Matrix4;
+#endif
 
-	// Prevents the camera from jumping around when first clicking left click
-	bool firstClick = true;
+	// Units per second the camera moves, four times as fast while shift is held
+	float MovementSpeed = 2.5f;
+	// Degrees the camera turns per pixel of mouse motion
+	float MouseSensitivity = 0.1f;
 
-	// Stores the width and height of the window
-	int width;
-	int height;
+	// Camera constructor to set up initial values, yaw and pitch are in degrees and a yaw of -90 looks down -Z
+	Camera(glm::vec3 position, glm::vec3 worldUp = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = -90.0f, float pitch = 0.0f);
 
-	// Adjust the speed of the camera and it's sensitivity when looking around
-	float speed = 0.1f;
-	float sensitivity = 100.0f;
+	// Moves and turns the camera at once, used to replay a recorded path, nothing goes stale if the pose is the same
+	void SetPose(const glm::vec3& position, float yaw, float pitch);
+	void SetPose(const glm::dvec3& position, float yaw, float pitch);
+	// Sets the perspective projection, the field of view is vertical and in degrees
+	void SetPerspective(float FOVdeg, float aspect, float nearPlane, float farPlane);
+	// Sets a reverse-Z perspective projection without a far plane, clip space depth goes from 1 at the near plane
+	// to 0 at infinity, for glClipControl's GL_ZERO_TO_ONE depth and a GL_GREATER depth test, see ReverseDepth.h
+	void SetReverseZPerspective(float FOVdeg, float aspect, float nearPlane);
+	// Narrows the projection to the rectangle from (x, y) to (z, w) of its NDC square, which then fills the viewport,
+	// an off-axis sub-frustum of the same view for one tile of an image larger than any viewport, see Poster
+	// (-1, -1, 1, 1) is the whole projection, it is kept when the perspective is set again
+	void SetSubFrustum(const glm::vec4& window);
 
-	// Camera constructor to set up initial values
-	Camera(int width, int height, glm::vec3 position);
+	// Moves the camera along its axes for deltaTime seconds, W S A D forwards, backwards and sideways, Q E up and down
+	void ProcessKeyboard(int direction, float deltaTime);
+	// Turns the camera by a mouse motion in pixels, y grows downwards, and keeps it from flipping over
+	void ProcessMouseMovement(float xoffset, float yoffset);
+	// Handles one snapshot of camera inputs: the movement keys, space and control as up and down, shift to go
+	// faster and the mouse motion captured while looking around
+	void Inputs(const Input::Snapshot& input, float deltaTime);
+
+	// The pose and the directions it looks along, position rounded to float
+	const glm::vec3& position() const;
+	const glm::dvec3& precisePosition() const;
+	const glm::vec3& front() const;
+	const glm::vec3& right() const;
+	const glm::vec3& up() const;
+	float yaw() const;
+	float pitch() const;
+
+	// Matrices and frustum of the current pose and projection, recomputed only when they went stale
+	glm::mat4 view() const;
+	glm::mat4 projection() const;
+	// Projection * view
+	glm::mat4 viewProjection() const;
+	// View of a camera at the origin that only turns, for geometry placed relative to precisePosition
+	glm::mat4 relativeView() const;
+	const Frustum& frustum() const;
 
-	// Updates the camera matrix to the Vertex Shader
-	void updateMatrix(float FOVdeg, float nearPlane, float farPlane);
 	// Exports the camera matrix to a shader
-	void Matrix(Shader& shader, const char* uniform);
-	// Handles camera inputs
-	void Inputs(GLFWwindow* window);
+	void Matrix(Shader& shader, const char* uniform) const;
+	// Writes the camera matrices and position into the per frame uniform data
+	void Export(FrameData& frameData) const;
+private:
+	glm::dvec3 Position;
+	glm::vec3 FloatPosition;
+	glm::vec3 WorldUp;
+	float Yaw;
+	float Pitch;
+	// Directions derived from yaw and pitch, kept up to date whenever they change
+	glm::vec3 Front;
+	glm::vec3 Right;
+	glm::vec3 Up;
+
+	// Cached results and what went stale since they were computed
+	mutable Matrix4 viewMatrix = Matrix4(1.0f);
+	mutable Matrix4 relativeViewMatrix = Matrix4(1.0f);
+	mutable Matrix4 projectionMatrix = Matrix4(1.0f);
+	// Projection of the whole view and the part of it projectionMatrix shows
+	Matrix4 fullProjection = Matrix4(1.0f);
+	glm::vec4 subFrustum = glm::vec4(-1.0f, -1.0f, 1.0f, 1.0f);
+	mutable Matrix4 viewProjectionMatrix = Matrix4(1.0f);
+	mutable Frustum frustumPlanes;
+	mutable bool viewDirty = true;
+	mutable bool viewProjectionDirty = true;
+
+	// Recomputes the directions from yaw and pitch and marks the view as stale
+	void updateCameraVectors();
+	// Narrows the full projection to the sub-frustum
+	void updateProjection();
+	// Recomputes whatever went stale
+	void update() const;
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include"CameraPath.h"
+
+#include<algorithm>
+#include<cmath>
+#include<fstream>
+#include<sstream>
+
+// Reads a text file with one "time x y z yaw pitch" keyframe per line
+bool CameraPath::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if (!file)
+		return false;
+
+	keyframes.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream in(line);
+		Keyframe keyframe;
+		if (in >> keyframe.time >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z >> keyframe.yaw >> keyframe.pitch)
+			keyframes.push_back(keyframe);
+	}
+	std::stable_sort(keyframes.begin(), keyframes.end(), [](const Keyframe& a, const Keyframe& b) { return a.time < b.time; });
+	return !keyframes.empty();
+}
+
+// Replaces the keyframes with a circle around center looking at it
+void CameraPath::Orbit(const glm::vec3& center, float radius, float height, float duration, unsigned int steps)
+{
+	keyframes.clear();
+	float pitch = glm::degrees(std::atan2(center.y - height, radius));
+	for (unsigned int i = 0; i <= steps; i++)
+	{
+		float angle = 2.0f * 3.14159265f * i / steps;
+		Keyframe keyframe;
+		keyframe.time = duration * i / steps;
+		keyframe.position = glm::vec3(center.x + radius * std::cos(angle), height, center.z + radius * std::sin(angle));
+		// Yaw is measured from +X towards +Z, looking back at the center is the opposite of the angle
+		keyframe.yaw = glm::degrees(angle) + 180.0f;
+		keyframe.pitch = pitch;
+		keyframes.push_back(keyframe);
+	}
+}
+
+// Time of the last keyframe
+float CameraPath::duration() const
+{
+	return keyframes.empty() ? 0.0f : keyframes.back().time;
+}
+
+// Interpolates the keyframes at a time
+CameraPath::Keyframe CameraPath::Sample(float time) const
+{
+	if (keyframes.empty())
+		return Keyframe{ time, glm::vec3(0.0f), -90.0f, 0.0f };
+	if (keyframes.size() == 1 || duration() <= 0.0f)
+		return keyframes[0];
+
+	time = std::fmod(time, duration());
+	if (time < 0.0f)
+		time += duration();
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float t, const Keyframe& k) { return t < k.time; });
+	if (next == keyframes.begin())
+		return keyframes.front();
+	if (next == keyframes.end())
+		return keyframes.back();
+	const Keyframe& a = *(next - 1);
+	const Keyframe& b = *next;
+	float span = b.time - a.time;
+	float f = span > 0.0f ? (time - a.time) / span : 0.0f;
+
+	Keyframe result;
+	result.time = time;
+	result.position = glm::mix(a.position, b.position, f);
+	result.yaw = a.yaw + (b.yaw - a.yaw) * f;
+	result.pitch = a.pitch + (b.pitch - a.pitch) * f;
+	return result;
+}
@@ -0,0 +1,36 @@
+#ifndef CAMERA_PATH_CLASS_H
+#define CAMERA_PATH_CLASS_H
+
+#include<glm/glm.hpp>
+#include<string>
+#include<vector>
+
+// Recorded camera keyframes that can be replayed at any time, used to make benchmark runs repeatable
+class CameraPath
+{
+public:
+	// Camera position and orientation at a point in time
+	struct Keyframe
+	{
+		float time;
+		glm::vec3 position;
+		// Degrees, same convention as the camera in Main.cpp
+		float yaw;
+		float pitch;
+	};
+
+	// Keyframes sorted by time
+	std::vector<Keyframe> keyframes;
+
+	// Reads a text file with one "time x y z yaw pitch" keyframe per line, # starts a comment
+	// Returns false if the file cannot be read or holds no keyframe
+	bool Load(const std::string& path);
+	// Replaces the keyframes with a circle around center looking at it, taking duration seconds
+	void Orbit(const glm::vec3& center, float radius, float height, float duration, unsigned int steps = 64);
+	// Time of the last keyframe
+	float duration() const;
+	// Interpolates the keyframes at a time, times past the end wrap around
+	Keyframe Sample(float time) const;
+};
+
+#endif
@@ -0,0 +1,370 @@
+#include"CityGenerator.h"
+#include"MeshOptimizer.h"
+#include"JobSystem.h"
+
+#include<algorithm>
+
+// Mixes the bits of a number so that neighbouring lots get unrelated values
+static unsigned int hashLot(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+// Turns a hash into a float between 0 and 1
+static float unitFloat(unsigned int hash)
+{
+	return (hash >> 8) * (1.0f / 16777216.0f);
+}
+
+// Constructor that stores the layout of the city
+CityGenerator::CityGenerator(const CityLayout& layout)
+{
+	CityGenerator::layout = layout;
+}
+
+size_t CityGenerator::buildingCount() const
+{
+	return (size_t)layout.blocksX * layout.blocksZ * layout.lotsPerSide * layout.lotsPerSide;
+}
+
+size_t CityGenerator::blockCount() const
+{
+	return (size_t)layout.blocksX * layout.blocksZ;
+}
+
+unsigned int CityGenerator::lotsPerBlock() const
+{
+	return layout.lotsPerSide * layout.lotsPerSide;
+}
+
+size_t CityGenerator::vertexCount() const
+{
+	return GROUND_VERTICES + buildingCount() * BUILDING_VERTICES;
+}
+
+size_t CityGenerator::indexCount() const
+{
+	return GROUND_INDICES + buildingCount() * BUILDING_INDICES;
+}
+
+float CityGenerator::halfExtentX() const
+{
+	float blockPitch = layout.lotsPerSide * layout.lotSize + layout.streetWidth;
+	return 0.5f * (layout.blocksX * blockPitch + layout.streetWidth);
+}
+
+float CityGenerator::halfExtentZ() const
+{
+	float blockPitch = layout.lotsPerSide * layout.lotSize + layout.streetWidth;
+	return 0.5f * (layout.blocksZ * blockPitch + layout.streetWidth);
+}
+
+// Random bits of a lot from the seed and its index
+unsigned int CityGenerator::lotSeed(size_t index) const
+{
+	return hashLot((unsigned int)index * 0x9e3779b9U ^ hashLot(layout.seed));
+}
+
+// Computes the building standing on a lot, without touching any other lot
+Building CityGenerator::building(size_t index) const
+{
+	size_t block = index / lotsPerBlock();
+	unsigned int lot = (unsigned int)(index % lotsPerBlock());
+
+	// Finds the corner of the lot, blocks are laid out row by row with a street around each one
+	float blockPitch = layout.lotsPerSide * layout.lotSize + layout.streetWidth;
+	float lotX = -halfExtentX() + layout.streetWidth + (block % layout.blocksX) * blockPitch + (lot % layout.lotsPerSide) * layout.lotSize;
+	float lotZ = -halfExtentZ() + layout.streetWidth + (block / layout.blocksX) * blockPitch + (lot / layout.lotsPerSide) * layout.lotSize;
+
+	// Every lot gets its own random values from the seed and its index
+	unsigned int hash = lotSeed(index);
+	float height = layout.minHeight + (layout.maxHeight - layout.minHeight) * unitFloat(hash);
+	float width = layout.lotSize * layout.lotCoverage * (0.75f + 0.25f * unitFloat(hashLot(hash)));
+	float depth = layout.lotSize * layout.lotCoverage * (0.75f + 0.25f * unitFloat(hashLot(hash + 1)));
+
+	// Centers the footprint on the lot
+	Building result;
+	result.minX = lotX + 0.5f * (layout.lotSize - width);
+	result.minZ = lotZ + 0.5f * (layout.lotSize - depth);
+	result.maxX = result.minX + width;
+	result.maxZ = result.minZ + depth;
+	result.height = height;
+	result.facade = layout.facadeCount > 1 ? hashLot(hash + 2) % layout.facadeCount : 0;
+	return result;
+}
+
+// Computes the impostor box standing in for a whole block
+Building CityGenerator::block(size_t index) const
+{
+	// Covers the footprints of every building on the block, which all lie inside its lots
+	size_t first = index * lotsPerBlock();
+	Building result = building(first);
+	float heightSum = result.height;
+	for (unsigned int lot = 1; lot < lotsPerBlock(); lot++)
+	{
+		Building b = building(first + lot);
+		result.minX = std::min(result.minX, b.minX);
+		result.minZ = std::min(result.minZ, b.minZ);
+		result.maxX = std::max(result.maxX, b.maxX);
+		result.maxZ = std::max(result.maxZ, b.maxZ);
+		heightSum += b.height;
+	}
+	result.height = heightSum / lotsPerBlock();
+	return result;
+}
+
+// Writes the ground and every building into arrays sized by vertexCount and indexCount
+void CityGenerator::Generate(GLfloat* vertices, GLuint* indices) const
+{
+	GenerateGround(vertices, indices);
+	vertices += GROUND_VERTICES * VERTEX_FLOATS;
+	indices += GROUND_INDICES;
+
+	// Buildings are written straight into their slot of the arrays, so nothing is allocated per building
+	size_t count = buildingCount();
+	for (size_t i = 0; i < count; i++)
+	{
+		GLuint baseVertex = (GLuint)(GROUND_VERTICES + i * BUILDING_VERTICES);
+		writeBuilding
+		(
+			building(i),
+			baseVertex,
+			vertices + i * BUILDING_VERTICES * VERTEX_FLOATS,
+			indices + i * BUILDING_INDICES
+		);
+	}
+}
+
+// Writes only the ground quad
+void CityGenerator::GenerateGround(GLfloat* vertices, GLuint* indices) const
+{
+	// Ground quad covering the whole city
+	float hx = halfExtentX();
+	float hz = halfExtentZ();
+	vertices = writeVertex(vertices, -hx, 0.0f, -hz, 0.0f, 0.0f);
+	vertices = writeVertex(vertices, -hx, 0.0f,  hz, 0.0f, 0.0f);
+	vertices = writeVertex(vertices,  hx, 0.0f,  hz, 0.0f, 0.0f);
+	vertices = writeVertex(vertices,  hx, 0.0f, -hz, 0.0f, 0.0f);
+	const GLuint groundIndices[GROUND_INDICES] = { 0, 1, 2, 2, 3, 0 };
+	for (unsigned int i = 0; i < GROUND_INDICES; i++)
+		indices[i] = groundIndices[i];
+}
+
+// Writes the ground and one box per block, laid out as Generate lays out the buildings
+void CityGenerator::GenerateImpostors(GLfloat* vertices, GLuint* indices) const
+{
+	GenerateGround(vertices, indices);
+	vertices += GROUND_VERTICES * VERTEX_FLOATS;
+	indices += GROUND_INDICES;
+	for (size_t i = 0; i < blockCount(); i++)
+	{
+		GLuint baseVertex = (GLuint)(GROUND_VERTICES + i * BUILDING_VERTICES);
+		writeBuilding(block(i), baseVertex, vertices + i * BUILDING_VERTICES * VERTEX_FLOATS, indices + i * BUILDING_INDICES);
+	}
+}
+
+// Writes one instance record per building
+void CityGenerator::GenerateInstances(GLfloat* instances) const
+{
+	size_t count = buildingCount();
+	for (size_t i = 0; i < count; i++)
+		instances = writeInstance(instances, building(i));
+}
+
+// Writes one instance record per block impostor
+void CityGenerator::GenerateBlockInstances(GLfloat* instances) const
+{
+	size_t count = blockCount();
+	for (size_t i = 0; i < count; i++)
+		instances = writeInstance(instances, block(i));
+}
+
+// Chunks of whole blocks, each writing its buildings from the first vertex and index of its slice
+// Every building takes the same room, so the prefix sum over the sizes of the chunks before one is its first building
+// times the size of a building
+void CityGenerator::Generate(GLfloat* vertices, GLuint* indices, JobSystem& jobs) const
+{
+	GenerateGround(vertices, indices);
+	vertices += GROUND_VERTICES * VERTEX_FLOATS;
+	indices += GROUND_INDICES;
+
+	jobs.ParallelFor(blockCount(), CHUNK_BLOCKS, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin * lotsPerBlock(); i < end * lotsPerBlock(); i++)
+		{
+			GLuint baseVertex = (GLuint)(GROUND_VERTICES + i * BUILDING_VERTICES);
+			writeBuilding(building(i), baseVertex, vertices + i * BUILDING_VERTICES * VERTEX_FLOATS, indices + i * BUILDING_INDICES);
+		}
+	});
+}
+
+// Chunks of whole blocks, each writing the records of its buildings
+void CityGenerator::GenerateInstances(GLfloat* instances, JobSystem& jobs) const
+{
+	jobs.ParallelFor(blockCount(), CHUNK_BLOCKS, [&](size_t, size_t begin, size_t end) {
+		GLfloat* out = instances + begin * lotsPerBlock() * INSTANCE_FLOATS;
+		for (size_t i = begin * lotsPerBlock(); i < end * lotsPerBlock(); i++)
+			out = writeInstance(out, building(i));
+	});
+}
+
+// Chunks of blocks, each writing the records of its impostors
+void CityGenerator::GenerateBlockInstances(GLfloat* instances, JobSystem& jobs) const
+{
+	jobs.ParallelFor(blockCount(), CHUNK_BLOCKS, [&](size_t, size_t begin, size_t end) {
+		GLfloat* out = instances + begin * INSTANCE_FLOATS;
+		for (size_t i = begin; i < end; i++)
+			out = writeInstance(out, block(i));
+	});
+}
+
+// Writes count point lights
+void CityGenerator::GenerateLights(GLfloat* lights, size_t count) const
+{
+	size_t buildings = buildingCount();
+	if (buildings == 0)
+		return;
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int hash = hashLot((unsigned int)i * 0x85ebca6bU ^ hashLot(layout.seed + 1));
+		Building lot = building(hash % buildings);
+		// Which side of the building the light is on and where along it
+		unsigned int side = hashLot(hash + 1) % 4;
+		float along = unitFloat(hashLot(hash + 2));
+		// Every fourth light is a street lamp standing out from the wall, the others are windows on it
+		bool lamp = hashLot(hash + 3) % 4 == 0;
+		float out = lamp ? 0.3f : 0.05f;
+		float x = side < 2 ? lot.minX + (lot.maxX - lot.minX) * along : (side == 2 ? lot.minX - out : lot.maxX + out);
+		float z = side >= 2 ? lot.minZ + (lot.maxZ - lot.minZ) * along : (side == 0 ? lot.minZ - out : lot.maxZ + out);
+		float y = lamp ? 0.6f : lot.height * (0.1f + 0.8f * unitFloat(hashLot(hash + 4)));
+		float radius = lamp ? 2.5f + 0.5f * unitFloat(hashLot(hash + 5)) : 1.5f + 0.5f * unitFloat(hashLot(hash + 5));
+		float warmth = unitFloat(hashLot(hash + 6));
+		GLfloat light[LIGHT_FLOATS] = { x, y, z, radius, 1.0f, lamp ? 0.7f : 0.8f + 0.15f * warmth, lamp ? 0.35f : 0.5f + 0.4f * warmth, 0.0f };
+		std::copy(light, light + LIGHT_FLOATS, lights + i * LIGHT_FLOATS);
+	}
+}
+
+// Writes the unit building every instance is scaled from
+void CityGenerator::GenerateUnitBuilding(GLfloat* vertices, GLuint* indices)
+{
+	Building unit = { 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0 };
+	writeBuilding(unit, 0, vertices, indices);
+}
+
+// Writes one vertex and returns the position right after it
+GLfloat* CityGenerator::writeVertex(GLfloat* out, float x, float y, float z, float u, float v)
+{
+	out[0] = x; out[1] = y; out[2] = z;
+	out[3] = u; out[4] = v;
+	return out + VERTEX_FLOATS;
+}
+
+// Writes the instance record that scales the unit building to a building
+GLfloat* CityGenerator::writeInstance(GLfloat* out, const Building& building)
+{
+	// Translation of the footprint corner
+	out[0] = building.minX;
+	out[1] = 0.0f;
+	out[2] = building.minZ;
+	// Scale of the unit building
+	out[3] = building.maxX - building.minX;
+	out[4] = building.height;
+	out[5] = building.maxZ - building.minZ;
+	// Texture layer of the facade
+	out[6] = (GLfloat)building.facade;
+	// Fully drawn, level of detail crossfades change it per frame
+	out[7] = 0.0f;
+	out[8] = BUILDING_COLOR[0];
+	out[9] = BUILDING_COLOR[1];
+	out[10] = BUILDING_COLOR[2];
+	out[11] = 0.0f;
+	return out + INSTANCE_FLOATS;
+}
+
+// Vertex and index order MeshOptimizer gives the unit building
+// Every building is the same convex box of faces, so the order is found once and fits all of them
+struct BuildingOrder
+{
+	// Face vertex each optimized vertex is taken from
+	GLuint vertices[CityGenerator::BUILDING_VERTICES];
+	GLuint indices[CityGenerator::BUILDING_INDICES];
+};
+
+// Writes the walls and roof of one building starting at vertex baseVertex
+void CityGenerator::writeBuilding(const Building& building, GLuint baseVertex, GLfloat* vertices, GLuint* indices)
+{
+	// Vertices carry their face order number instead of texture coordinates, so the optimized order can be read back from them
+	static const BuildingOrder order = []
+	{
+		GLfloat faces[BUILDING_VERTICES * VERTEX_FLOATS];
+		BuildingOrder result;
+		Building unit = { 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0 };
+		writeFaces(unit, faces, result.indices);
+		for (GLuint v = 0; v < BUILDING_VERTICES; v++)
+			faces[v * VERTEX_FLOATS + 3] = (GLfloat)v;
+		MeshOptimizer::Optimize(faces, BUILDING_VERTICES, VERTEX_FLOATS, result.indices, BUILDING_INDICES);
+		for (GLuint v = 0; v < BUILDING_VERTICES; v++)
+			result.vertices[v] = (GLuint)faces[v * VERTEX_FLOATS + 3];
+		return result;
+	}();
+
+	GLfloat faces[BUILDING_VERTICES * VERTEX_FLOATS];
+	GLuint faceIndices[BUILDING_INDICES];
+	writeFaces(building, faces, faceIndices);
+	for (GLuint v = 0; v < BUILDING_VERTICES; v++)
+		std::copy(faces + order.vertices[v] * VERTEX_FLOATS, faces + (order.vertices[v] + 1) * VERTEX_FLOATS, vertices + v * VERTEX_FLOATS);
+	for (GLuint i = 0; i < BUILDING_INDICES; i++)
+		indices[i] = baseVertex + order.indices[i];
+}
+
+// Writes the walls and roof of one building face by face
+void CityGenerator::writeFaces(const Building& building, GLfloat* vertices, GLuint* indices)
+{
+	// Images are stored bottom row first so the ground floor is v = 0
+	const float texScale = FACADE_TEXTURE_SCALE;
+	float x0 = building.minX, x1 = building.maxX;
+	float z0 = building.minZ, z1 = building.maxZ;
+	float h = building.height;
+	float uX = (x1 - x0) * texScale;
+	float uZ = (z1 - z0) * texScale;
+	float vH = h * texScale;
+
+	// Bottom corners of each wall from left to right when seen from outside, so the faces wind counter-clockwise
+	const float walls[4][4] =
+	{
+		{ x0, z1, x1, z1 },	// front (+Z)
+		{ x1, z1, x1, z0 },	// right (+X)
+		{ x1, z0, x0, z0 },	// back (-Z)
+		{ x0, z0, x0, z1 },	// left (-X)
+	};
+	const float wallU[4] = { uX, uZ, uX, uZ };
+	for (int w = 0; w < 4; w++)
+	{
+		vertices = writeVertex(vertices, walls[w][0], 0.0f, walls[w][1], 0.0f, 0.0f);
+		vertices = writeVertex(vertices, walls[w][2], 0.0f, walls[w][3], wallU[w], 0.0f);
+		vertices = writeVertex(vertices, walls[w][2], h, walls[w][3], wallU[w], vH);
+		vertices = writeVertex(vertices, walls[w][0], h, walls[w][1], 0.0f, vH);
+	}
+	// Roof
+	vertices = writeVertex(vertices, x0, h, z1, 0.0f, 1.0f);
+	vertices = writeVertex(vertices, x1, h, z1, 1.0f, 1.0f);
+	vertices = writeVertex(vertices, x1, h, z0, 1.0f, 0.0f);
+	vertices = writeVertex(vertices, x0, h, z0, 0.0f, 0.0f);
+
+	// Two counter-clockwise triangles per face
+	for (GLuint face = 0; face < 5; face++)
+	{
+		GLuint first = face * 4;
+		indices[0] = first;
+		indices[1] = first + 1;
+		indices[2] = first + 2;
+		indices[3] = first + 2;
+		indices[4] = first + 3;
+		indices[5] = first;
+		indices += 6;
+	}
+}
@@ -0,0 +1,126 @@
+#ifndef CITY_GENERATOR_CLASS_H
+#define CITY_GENERATOR_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+class JobSystem;
+
+// Describes the grid of city blocks that gets generated
+struct CityLayout
+{
+	// Number of blocks along the X and Z axes
+	unsigned int blocksX = 2;
+	unsigned int blocksZ = 2;
+	// Number of building lots along each side of a block
+	unsigned int lotsPerSide = 2;
+	// Width of a single lot and of the streets between blocks
+	float lotSize = 2.0f;
+	float streetWidth = 1.0f;
+	// Range of building heights
+	float minHeight = 1.0f;
+	float maxHeight = 4.0f;
+	// Fraction of a lot covered by the building footprint
+	float lotCoverage = 0.8f;
+	// Number of facade textures buildings pick from
+	unsigned int facadeCount = 1;
+	// Seed for the building variation, the same seed always gives the same city
+	unsigned int seed = 1;
+};
+
+// Footprint and height of one generated building
+struct Building
+{
+	float minX;
+	float minZ;
+	float maxX;
+	float maxZ;
+	float height;
+	// Which facade texture the building wears
+	unsigned int facade;
+};
+
+class CityGenerator
+{
+public:
+	// Layout of the vertices written by Generate: position and texture coordinates, color comes with the instance record
+	static constexpr unsigned int VERTEX_FLOATS = 5;
+	// Texture coordinates per unit of wall, the facade texture repeats every 2 units
+	static constexpr float FACADE_TEXTURE_SCALE = 0.5f;
+	// Every building is four walls and a roof with their own texture coordinates
+	static constexpr unsigned int BUILDING_VERTICES = 20;
+	static constexpr unsigned int BUILDING_INDICES = 30;
+	// First vertex ID of the unit building the scene vertex shader makes up from gl_VertexID, far above any heap vertex
+	// Drawing BUILDING_INDICES vertices from it draws the same triangles as the unit building mesh
+	static constexpr GLint PROCEDURAL_BOX_FIRST = 1 << 24;
+	// The ground is a single quad under the whole city
+	static constexpr unsigned int GROUND_VERTICES = 4;
+	static constexpr unsigned int GROUND_INDICES = 6;
+	// Layout of the per-instance records written by GenerateInstances: translation, scale, texture layer, dither fade, color
+	// and the ambient occlusion at the foot of the walls, 0 until AmbientOcclusion bakes it
+	static constexpr unsigned int INSTANCE_FLOATS = 12;
+	// Colors of the ground record and of every building record, recoloring a building only takes changing its record
+	static constexpr GLfloat GROUND_COLOR[3] = { 0.0f, 1.0f, 0.0f };
+	static constexpr GLfloat BUILDING_COLOR[3] = { 1.0f, 1.0f, 1.0f };
+	// Layout of the point lights written by GenerateLights: position, radius, color and a 0 that ClusteredLights::SetShadow
+	// may replace
+	static constexpr unsigned int LIGHT_FLOATS = 8;
+	// Blocks a chunk of the parallel generators holds at least
+	static constexpr size_t CHUNK_BLOCKS = 16;
+
+	// Layout the city is generated from
+	CityLayout layout;
+
+	// Constructor that stores the layout of the city
+	CityGenerator(const CityLayout& layout);
+
+	// Number of buildings, vertices and indices Generate writes
+	size_t buildingCount() const;
+	// Number of blocks, the buildings of block b are the lotsPerSide * lotsPerSide ones starting at b * lotsPerBlock()
+	size_t blockCount() const;
+	unsigned int lotsPerBlock() const;
+	size_t vertexCount() const;
+	size_t indexCount() const;
+	// Half the size of the city along X and Z, including a street around it
+	float halfExtentX() const;
+	float halfExtentZ() const;
+
+	// Random bits of a lot, every value of its building is drawn from them and hashes of them
+	unsigned int lotSeed(size_t index) const;
+	// Computes the building standing on a lot, without touching any other lot
+	Building building(size_t index) const;
+	// Computes the impostor box standing in for a whole block, as tall as its buildings are on average
+	Building block(size_t index) const;
+	// Writes the ground and every building into arrays sized by vertexCount and indexCount
+	void Generate(GLfloat* vertices, GLuint* indices) const;
+	// Writes only the ground quad, GROUND_VERTICES vertices and GROUND_INDICES indices
+	void GenerateGround(GLfloat* vertices, GLuint* indices) const;
+	// Writes the ground and the box impostor of every block, the coarse mesh that stands in for the city from afar,
+	// GROUND_VERTICES + blockCount() * BUILDING_VERTICES vertices and the matching number of indices
+	void GenerateImpostors(GLfloat* vertices, GLuint* indices) const;
+	// Writes one instance record per building into an array sized by buildingCount * INSTANCE_FLOATS
+	void GenerateInstances(GLfloat* instances) const;
+	// Writes one instance record per block impostor into an array sized by blockCount * INSTANCE_FLOATS
+	void GenerateBlockInstances(GLfloat* instances) const;
+	// Same three split into chunks of whole blocks generated side by side on the workers of jobs
+	// Every lot draws its values from its own seed and every chunk writes only its own slice of the arrays, so the
+	// results are bit for bit those of the single threaded versions whatever the number of workers
+	void Generate(GLfloat* vertices, GLuint* indices, JobSystem& jobs) const;
+	void GenerateInstances(GLfloat* instances, JobSystem& jobs) const;
+	void GenerateBlockInstances(GLfloat* instances, JobSystem& jobs) const;
+	// Writes count point lights into an array sized by count * LIGHT_FLOATS, street lamps beside the buildings and lit windows on their walls
+	void GenerateLights(GLfloat* lights, size_t count) const;
+	// Writes the unit building every instance is scaled from, BUILDING_VERTICES vertices and BUILDING_INDICES indices
+	static void GenerateUnitBuilding(GLfloat* vertices, GLuint* indices);
+private:
+	// Writes one vertex and returns the position right after it
+	static GLfloat* writeVertex(GLfloat* out, float x, float y, float z, float u, float v);
+	// Writes the walls and roof of one building starting at vertex baseVertex, in the order MeshOptimizer picked
+	static void writeBuilding(const Building& building, GLuint baseVertex, GLfloat* vertices, GLuint* indices);
+	// Writes the walls and roof face by face, indices relative to the first vertex
+	static void writeFaces(const Building& building, GLfloat* vertices, GLuint* indices);
+	// Writes the instance record that scales the unit building to a building
+	static GLfloat* writeInstance(GLfloat* out, const Building& building);
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include"ClusteredLights.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<algorithm>
+#include<cmath>
+#include<utility>
+
+// Constructor that copies the lights and creates the buffers
+ClusteredLights::ClusteredLights(const GLfloat* lights, size_t count, float nearPlane, float farPlane)
+	: lights(lights, lights + count * LIGHT_FLOATS)
+{
+	ClusteredLights::nearPlane = nearPlane;
+	ClusteredLights::farPlane = farPlane;
+	grid.resize((size_t)TILES_X * TILES_Y * SLICES * 4);
+
+	const GLenum formats[4] = { GL_RGBA32F, GL_RGBA32UI, GL_R32UI, GL_RGBA32F };
+	glGenBuffers(4, buffers);
+	glGenTextures(4, textures);
+	for (int i = 0; i < 4; i++)
+	{
+		GLState.BindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+		GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, buffers[i], 16);
+		GLState.BindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+	}
+	GLState.BindTexture(GL_TEXTURE_BUFFER, 0);
+	GLState.BindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Deletes the buffers unless Delete was already called
+ClusteredLights::~ClusteredLights()
+{
+	Delete();
+}
+
+// Takes over the buffers of another set of lights
+ClusteredLights::ClusteredLights(ClusteredLights&& other) noexcept
+	: lights(std::move(other.lights)), decals(std::move(other.decals)), nearPlane(other.nearPlane), farPlane(other.farPlane), tileScale(other.tileScale)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		buffers[i] = std::exchange(other.buffers[i], 0);
+		textures[i] = std::exchange(other.textures[i], 0);
+	}
+	grid = std::move(other.grid);
+}
+
+// Deletes the current buffers and takes over the ones of another set of lights
+ClusteredLights& ClusteredLights::operator=(ClusteredLights&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		lights = std::move(other.lights);
+		decals = std::move(other.decals);
+		nearPlane = other.nearPlane;
+		farPlane = other.farPlane;
+		tileScale = other.tileScale;
+		for (int i = 0; i < 4; i++)
+		{
+			buffers[i] = std::exchange(other.buffers[i], 0);
+			textures[i] = std::exchange(other.textures[i], 0);
+		}
+		grid = std::move(other.grid);
+	}
+	return *this;
+}
+
+// Depth slice a view space distance falls into
+float ClusteredLights::slice(float depth) const
+{
+	return std::log(std::max(depth, 1e-6f) / nearPlane) / std::log(farPlane / nearPlane) * (float)SLICES;
+}
+
+// Distance at which a slice starts
+float ClusteredLights::sliceDepth(unsigned int slice) const
+{
+	return nearPlane * std::pow(farPlane / nearPlane, (float)slice / (float)SLICES);
+}
+
+// Uploads one texture buffer, orphaning the storage of the last frame
+static void upload(GLuint buffer, const void* data, size_t bytes)
+{
+	GLState.BindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(bytes, (size_t)16), nullptr, GL_STREAM_DRAW);
+	GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, buffer, (int64_t)std::max(bytes, (size_t)16));
+	if (bytes > 0)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+	GLState.CountUpload(bytes);
+}
+
+// Floats of a decal in view, its four texels of clusterDecals
+static const size_t VIEW_DECAL_FLOATS = 16;
+
+// Copies the decals binned from the next Update on
+void ClusteredLights::SetDecals(const GLfloat* decals, size_t count)
+{
+	ClusteredLights::decals.assign(decals, decals + count * DECAL_FLOATS);
+}
+
+// Adds index to the clusters a view space sphere touches
+bool ClusteredLights::bin(const glm::vec3& center, float radius, const glm::mat4& projection, GLuint index, unsigned int channel, std::vector<GLuint>& out)
+{
+	float depth = -center.z;
+	if (depth + radius < nearPlane || depth - radius > farPlane)
+		return false;
+
+	unsigned int firstSlice = (unsigned int)std::clamp(slice(depth - radius), 0.0f, (float)SLICES - 1.0f);
+	unsigned int lastSlice = (unsigned int)std::clamp(slice(depth + radius), 0.0f, (float)SLICES - 1.0f);
+	bool visible = false;
+	for (unsigned int s = firstSlice; s <= lastSlice; s++)
+	{
+		// The part of the sphere's bounding box inside the slice, projected to tiles
+		float zNear = std::max({ sliceDepth(s), depth - radius, nearPlane });
+		float zFar = std::min(sliceDepth(s + 1), depth + radius);
+		if (zNear > zFar)
+			continue;
+		int tiles[4];
+		const float tileCounts[2] = { (float)TILES_X, (float)TILES_Y };
+		for (int axis = 0; axis < 2; axis++)
+		{
+			float low = center[axis] - radius, high = center[axis] + radius;
+			// An off center projection adds the same shift at every depth, so the bounds stay the outermost ones
+			float scale = projection[axis][axis], shift = -projection[2][axis];
+			float ndcLow = scale * low / (low >= 0.0f ? zFar : zNear) + shift;
+			float ndcHigh = scale * high / (high >= 0.0f ? zNear : zFar) + shift;
+			tiles[axis * 2] = (int)std::floor((ndcLow * 0.5f + 0.5f) * tileCounts[axis]);
+			tiles[axis * 2 + 1] = (int)std::floor((ndcHigh * 0.5f + 0.5f) * tileCounts[axis]);
+			tiles[axis * 2] = std::max(tiles[axis * 2], 0);
+			tiles[axis * 2 + 1] = std::min(tiles[axis * 2 + 1], (int)tileCounts[axis] - 1);
+		}
+		for (int y = tiles[2]; y <= tiles[3]; y++)
+			for (int x = tiles[0]; x <= tiles[1]; x++)
+			{
+				GLuint cell = (GLuint)((s * TILES_Y + y) * TILES_X + x);
+				out.push_back(cell);
+				out.push_back(index);
+				grid[cell * 4 + channel]++;
+				visible = true;
+			}
+	}
+	return visible;
+}
+
+// Bins the lights and the decals for a camera
+void ClusteredLights::Update(const glm::mat4& viewModel, const glm::mat4& projection, int width, int height)
+{
+	tileScale = glm::vec2((float)TILES_X / (float)std::max(width, 1), (float)TILES_Y / (float)std::max(height, 1));
+	viewLights.clear();
+	viewDecals.clear();
+	pairs.clear();
+	decalPairs.clear();
+	std::fill(grid.begin(), grid.end(), 0u);
+
+	const size_t count = lights.size() / LIGHT_FLOATS;
+	for (size_t l = 0; l < count; l++)
+	{
+		const GLfloat* light = &lights[l * LIGHT_FLOATS];
+		glm::vec3 center = glm::vec3(viewModel * glm::vec4(light[0], light[1], light[2], 1.0f));
+		float radius = light[3];
+		if (bin(center, radius, projection, (GLuint)(viewLights.size() / LIGHT_FLOATS), 1, pairs))
+			viewLights.insert(viewLights.end(), { center.x, center.y, center.z, radius, light[4], light[5], light[6], light[7] });
+	}
+
+	// A decal's axes go to view space divided by their squared length, so a dot product with the offset from the
+	// center is the position in the box from -1 to 1
+	const glm::mat3 rotation = glm::mat3(viewModel);
+	const size_t decalCount = decals.size() / DECAL_FLOATS;
+	for (size_t d = 0; d < decalCount; d++)
+	{
+		const GLfloat* decal = &decals[d * DECAL_FLOATS];
+		glm::vec3 width(decal[4], decal[5], decal[6]), height(decal[8], decal[9], decal[10]);
+		float depth = decal[11];
+		glm::vec3 center = glm::vec3(viewModel * glm::vec4(decal[0], decal[1], decal[2], 1.0f));
+		float radius = std::sqrt(glm::dot(width, width) + glm::dot(height, height) + depth * depth);
+		if (!bin(center, radius, projection, (GLuint)(viewDecals.size() / VIEW_DECAL_FLOATS), 3, decalPairs))
+			continue;
+		glm::vec3 across = rotation * (width / glm::dot(width, width));
+		glm::vec3 up = rotation * (height / glm::dot(height, height));
+		glm::vec3 out = rotation * (glm::normalize(glm::cross(width, height)) / depth);
+		viewDecals.insert(viewDecals.end(), { center.x, center.y, center.z, decal[3], across.x, across.y, across.z, decal[7],
+			up.x, up.y, up.z, 0.0f, out.x, out.y, out.z, 0.0f });
+	}
+
+	// Counting sort of the pairs by cluster, the decals of every cluster after all the lights
+	GLuint offset = 0;
+	for (unsigned int channel = 1; channel < 4; channel += 2)
+		for (size_t cell = 0; cell < grid.size() / 4; cell++)
+		{
+			grid[cell * 4 + channel - 1] = offset;
+			offset += grid[cell * 4 + channel];
+			grid[cell * 4 + channel] = 0;
+		}
+	indices.resize((pairs.size() + decalPairs.size()) / 2);
+	for (size_t p = 0; p < pairs.size(); p += 2)
+	{
+		GLuint cell = pairs[p];
+		indices[grid[cell * 4] + grid[cell * 4 + 1]++] = pairs[p + 1];
+	}
+	for (size_t p = 0; p < decalPairs.size(); p += 2)
+	{
+		GLuint cell = decalPairs[p];
+		indices[grid[cell * 4 + 2] + grid[cell * 4 + 3]++] = decalPairs[p + 1];
+	}
+	visibleLights = viewLights.size() / LIGHT_FLOATS;
+	visibleDecals = viewDecals.size() / VIEW_DECAL_FLOATS;
+	assignedIndices = indices.size();
+
+	upload(buffers[0], viewLights.data(), viewLights.size() * sizeof(GLfloat));
+	upload(buffers[1], grid.data(), grid.size() * sizeof(GLuint));
+	upload(buffers[2], indices.data(), indices.size() * sizeof(GLuint));
+	upload(buffers[3], viewDecals.data(), viewDecals.size() * sizeof(GLfloat));
+	GLState.BindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Binds the buffers and sets the cluster uniforms of the program in use
+void ClusteredLights::Apply(GLuint program)
+{
+	const char* names[4] = { "clusterLights", "clusterGrid", "clusterIndices", "clusterDecals" };
+	for (GLuint i = 0; i < 4; i++)
+	{
+		GLuint unit = i < 3 ? TEXTURE_UNIT + i : DECAL_UNIT;
+		GLState.ActiveTexture(GL_TEXTURE0 + unit);
+		GLState.BindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		glUniform1i(glGetUniformLocation(program, names[i]), (GLint)unit);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+	float sliceScale = (float)SLICES / std::log(farPlane / nearPlane);
+	glUniform4f(glGetUniformLocation(program, "clusterScale"), tileScale.x, tileScale.y, sliceScale, -std::log(nearPlane) * sliceScale);
+	glUniform3i(glGetUniformLocation(program, "clusterSize"), TILES_X, TILES_Y, SLICES);
+	GLState.CountUniforms(6);
+}
+
+// Deletes the buffers
+void ClusteredLights::Delete()
+{
+	for (int i = 0; i < 4; i++)
+	{
+		if (textures[i] != 0)
+			GLState.DeleteTextures(1, &textures[i]);
+		if (buffers[i] != 0)
+			GLState.DeleteBuffers(1, &buffers[i]);
+		textures[i] = buffers[i] = 0;
+	}
+}
@@ -0,0 +1,105 @@
+#ifndef CLUSTERED_LIGHTS_CLASS_H
+#define CLUSTERED_LIGHTS_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<vector>
+
+// Clustered forward shading for many point lights
+// The view frustum is split into a grid of clusters, TILES_X by TILES_Y screen tiles and SLICES depth slices that grow
+// exponentially with distance. Every frame the lights are binned on the CPU into the clusters their spheres touch, and a
+// fragment only loops over the lights of its own cluster, so shading cost follows how many lights are nearby, not how many exist.
+// Decals, boxes that project an image of DecalLibrary onto the surfaces inside them, are binned into the same clusters
+// by their bounding spheres, so a fragment only tests the few boxes around it.
+//
+// The result goes to the shaders as four texture buffers, which GL 3.3 already has:
+//   clusterLights    RGBA32F, two texels per light in view: view space position and radius, then color and the
+//                    LightShadows slot it is shadowed from plus 1, 0 when it casts no shadows
+//   clusterGrid      RGBA32UI, one texel per cluster, x fastest then y then slice: first index and light count, then
+//                    first index and decal count
+//   clusterIndices   R32UI, the light numbers of every cluster one after another, then the decal numbers
+//   clusterDecals    RGBA32F, four texels per decal in view: view space center and image layer, then the axes along
+//                    its width, height and depth each divided by its half length, so the box is -1 to 1 along each,
+//                    with the opacity in the first one's w
+class ClusteredLights
+{
+public:
+	// Layout of one light as written by CityGenerator::GenerateLights: position, radius, color and one float that
+	// SetShadow fills in
+	static constexpr unsigned int LIGHT_FLOATS = 8;
+	// Size of the cluster grid
+	static constexpr unsigned int TILES_X = 16;
+	static constexpr unsigned int TILES_Y = 9;
+	static constexpr unsigned int SLICES = 24;
+	// Layout of one decal in model space: center, image layer, half the width as a vector along the surface, opacity,
+	// half the height as a vector, and half the depth along the cross product of the two, which points away from the
+	// surface the decal is projected onto
+	static constexpr unsigned int DECAL_FLOATS = 12;
+	// The light buffers are bound to this texture unit and the two after it, the decals to DECAL_UNIT
+	static constexpr GLuint TEXTURE_UNIT = 4;
+	static constexpr GLuint DECAL_UNIT = 26;
+
+	// Lights and decals in view and indices written by the last Update, for the profiler overlay
+	size_t visibleLights = 0;
+	size_t visibleDecals = 0;
+	size_t assignedIndices = 0;
+
+	// Constructor that copies count lights of LIGHT_FLOATS floats in model space, for a projection from nearPlane to farPlane
+	ClusteredLights(const GLfloat* lights, size_t count, float nearPlane, float farPlane);
+	// Deletes the buffers unless Delete was already called, the context has to still be current
+	~ClusteredLights();
+	// ClusteredLights owns its GL objects, so it can be moved but not copied
+	ClusteredLights(const ClusteredLights&) = delete;
+	ClusteredLights& operator=(const ClusteredLights&) = delete;
+	ClusteredLights(ClusteredLights&& other) noexcept;
+	ClusteredLights& operator=(ClusteredLights&& other) noexcept;
+
+	// Bins the lights for a camera, viewModel takes the lights to view space, projection may
+	// be off center like that of a poster tile
+	// width and height are the size of the framebuffer the clusters cover
+	void Update(const glm::mat4& viewModel, const glm::mat4& projection, int width, int height);
+	// Binds the buffers and sets the cluster uniforms of the program in use, after every Update
+	void Apply(GLuint program);
+	// Copies count decals of DECAL_FLOATS floats in model space, binned from the next Update on instead of the ones before
+	void SetDecals(const GLfloat* decals, size_t count);
+	// Sets the shadow slot a light is looked up in from the next Update on, -1 for none
+	void SetShadow(size_t light, int slot) { lights[light * LIGHT_FLOATS + 7] = (GLfloat)(slot + 1); }
+
+	// Number of lights and the LIGHT_FLOATS floats of one in model space
+	size_t lightCount() const { return lights.size() / LIGHT_FLOATS; }
+	const GLfloat* light(size_t index) const { return &lights[index * LIGHT_FLOATS]; }
+
+	// Deletes the buffers, does nothing if they were already deleted or moved from
+	void Delete();
+private:
+	std::vector<GLfloat> lights;
+	std::vector<GLfloat> decals;
+	float nearPlane;
+	float farPlane;
+	// Pixels to tiles along X and Y, set by Update
+	glm::vec2 tileScale = glm::vec2(0.0f);
+
+	// Buffers and the texture buffer views on them, in the order lights, grid, indices, decals
+	GLuint buffers[4] = { 0, 0, 0, 0 };
+	GLuint textures[4] = { 0, 0, 0, 0 };
+
+	// Scratch space reused every frame
+	std::vector<GLfloat> viewLights;
+	std::vector<GLfloat> viewDecals;
+	std::vector<GLuint> grid;
+	std::vector<GLuint> indices;
+	// Cluster and index of every light and every decal in a cluster
+	std::vector<GLuint> pairs;
+	std::vector<GLuint> decalPairs;
+
+	// Depth slice a view space distance falls into, not clamped
+	float slice(float depth) const;
+	// Distance at which a slice starts
+	float sliceDepth(unsigned int slice) const;
+	// Adds the pairs of index and the clusters a view space sphere touches to out, counted in a channel of the grid,
+	// false if it touches none
+	bool bin(const glm::vec3& center, float radius, const glm::mat4& projection, GLuint index, unsigned int channel, std::vector<GLuint>& out);
+};
+
+#endif
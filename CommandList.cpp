@@ -0,0 +1,76 @@
+#include"CommandList.h"
+
+void CommandList::Begin(Command* storage, size_t storageCapacity)
+{
+	commands = storage;
+	capacity = storageCapacity;
+	count = 0;
+	overflow = 0;
+}
+
+CommandList::Command* CommandList::next()
+{
+	if (count == capacity)
+	{
+		overflow++;
+		return nullptr;
+	}
+	return &commands[count++];
+}
+
+void CommandList::VertexAttrib(GLuint index, GLint components, const GLfloat* values)
+{
+	Command* command = next();
+	if (!command)
+		return;
+	command->op = Command::VERTEX_ATTRIB;
+	command->target = index;
+	command->values[0] = 0.0f;
+	command->values[1] = 0.0f;
+	command->values[2] = 0.0f;
+	command->values[3] = 1.0f;
+	for (GLint c = 0; c < components && c < 4; c++)
+		command->values[c] = values[c];
+}
+
+void CommandList::DrawElementsBaseVertex(GLenum mode, GLsizei indexCount, GLenum type, const void* indices, GLint baseVertex)
+{
+	Command* command = next();
+	if (!command)
+		return;
+	command->op = Command::DRAW_ELEMENTS_BASE_VERTEX;
+	command->target = mode;
+	command->count = indexCount;
+	command->type = type;
+	command->indices = indices;
+	command->baseVertex = baseVertex;
+}
+
+// glVertexAttrib4fv with the defaults filled in sets the same value as the shorter calls would have
+void CommandList::Execute(GLStateCache& state) const
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const Command& command = commands[i];
+		switch (command.op)
+		{
+		case Command::VERTEX_ATTRIB:
+			glVertexAttrib4fv(command.target, command.values);
+			break;
+		case Command::DRAW_ELEMENTS_BASE_VERTEX:
+			glDrawElementsBaseVertex(command.target, command.count, command.type, command.indices, command.baseVertex);
+			state.CountDraw(1, command.target == GL_TRIANGLES ? command.count / 3 : 0);
+			break;
+		}
+	}
+}
+
+size_t CommandList::size() const
+{
+	return count;
+}
+
+size_t CommandList::dropped() const
+{
+	return overflow;
+}
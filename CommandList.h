@@ -0,0 +1,60 @@
+#ifndef COMMAND_LIST_CLASS_H
+#define COMMAND_LIST_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"GLStateCache.h"
+
+// Draws recorded on any thread, without a GL context, and submitted later by the thread that has it
+// GL only takes calls from the thread its context is current on, so a frame's draws can not be issued from the
+// workers. What can be spread over them is working out the draws: each slice of a loop records into a list of its own
+// and the render thread executes the lists in slice order, turning every command into exactly one GL call.
+// Commands live in storage the caller hands to Begin, such as a slice of the frame's arena, nothing is allocated.
+class CommandList
+{
+public:
+	// One recorded call, trivially destructible so it can live in a FrameArena
+	struct Command
+	{
+		enum Op : GLuint
+		{
+			VERTEX_ATTRIB,
+			DRAW_ELEMENTS_BASE_VERTEX
+		};
+		Op op;
+		// Attribute index, or the primitive mode of a draw
+		GLuint target;
+		// Index count and type, where they start in the bound index buffer and the base vertex of a draw
+		GLsizei count;
+		GLenum type;
+		const void* indices;
+		GLint baseVertex;
+		// Value of a constant attribute, the components not given keep GL's defaults of 0, 0 and 1
+		GLfloat values[4];
+	};
+
+	// Starts recording into storage with room for capacity commands, dropping what was recorded before
+	void Begin(Command* storage, size_t capacity);
+	// Records glVertexAttrib for the first components of values, from 1 to 4
+	void VertexAttrib(GLuint index, GLint components, const GLfloat* values);
+	// Records glDrawElementsBaseVertex
+	void DrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLint baseVertex);
+
+	// Issues the commands in the order they were recorded and counts the draws into state, GL thread only
+	void Execute(GLStateCache& state) const;
+
+	// Commands recorded, and those dropped because the storage was full
+	size_t size() const;
+	size_t dropped() const;
+private:
+	Command* commands = nullptr;
+	size_t capacity = 0;
+	size_t count = 0;
+	size_t overflow = 0;
+
+	// Next free command, nullptr when the storage is full
+	Command* next();
+};
+
+#endif
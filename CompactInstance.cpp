@@ -0,0 +1,39 @@
+#include"CompactInstance.h"
+#include"CityGenerator.h"
+
+#include<glm/gtc/packing.hpp>
+
+// Converts records of CityGenerator's layout
+void CompactInstance::Pack(const GLfloat* records, size_t count, CompactInstance* out)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		const GLfloat* record = &records[i * CityGenerator::INSTANCE_FLOATS];
+		// Built on the stack and stored whole, out is usually a mapped stream buffer that is only ever written
+		CompactInstance instance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			instance.translation[axis] = record[axis];
+			instance.scale[axis] = glm::packHalf1x16(record[3 + axis]);
+			instance.color[axis] = (GLbyte)glm::packSnorm1x8(record[8 + axis]);
+		}
+		instance.layer = (GLushort)record[6];
+		instance.fade = glm::packHalf1x16(record[7]);
+		instance.occlusion = glm::packUnorm1x8(record[11]);
+		instance.padding = 0;
+		instance.color[3] = 0;
+		out[i] = instance;
+	}
+}
+
+// Formats the compact record at locations 4 to 8 and 1
+void CompactInstance::Format(VAO& vao, GLuint binding)
+{
+	vao.Format(4, 3, GL_FLOAT, GL_FALSE, offsetof(CompactInstance, translation), binding);
+	vao.Format(5, 3, GL_HALF_FLOAT, GL_FALSE, offsetof(CompactInstance, scale), binding);
+	vao.Format(6, 1, GL_UNSIGNED_SHORT, GL_FALSE, offsetof(CompactInstance, layer), binding);
+	vao.Format(7, 1, GL_HALF_FLOAT, GL_FALSE, offsetof(CompactInstance, fade), binding);
+	vao.Format(1, 3, GL_BYTE, GL_TRUE, offsetof(CompactInstance, color), binding);
+	vao.Format(8, 1, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(CompactInstance, occlusion), binding);
+	vao.Divisor(binding, 1);
+}
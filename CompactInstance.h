@@ -0,0 +1,35 @@
+#ifndef COMPACT_INSTANCE_CLASS_H
+#define COMPACT_INSTANCE_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"VAO.h"
+
+// 28 byte instance record for streaming many instances, instead of the 48 bytes of CityGenerator's float record
+// The translation stays float so far away buildings keep their place, the scale and fade are half floats, the layer
+// a 16 bit integer and the color and ambient occlusion 8 bit fractions. The vertex shader reads it through the same
+// attribute locations as the float record, so only the VAO formatting the records tells them apart.
+class CompactInstance
+{
+public:
+	GLfloat translation[3];
+	// Scale and level of detail fade as GL_HALF_FLOAT
+	GLushort scale[3];
+	GLushort fade;
+	// Texture layer, whole numbers only
+	GLushort layer;
+	// Baked ambient occlusion as an 8 bit fraction, the byte after it only pads the color to 4 bytes
+	GLubyte occlusion;
+	GLubyte padding;
+	// Color as signed 8 bit fractions, live data colors mark themselves with a negative red
+	GLbyte color[4];
+
+	// Converts records of CityGenerator's layout
+	static void Pack(const GLfloat* records, size_t count, CompactInstance* out);
+	// Formats locations 4 to 8 and 1 as the translation, scale, layer, fade, occlusion and color of a binding that
+	// advances once per instance, the VAO has to be bound unless GLExt.directStateAccess
+	static void Format(VAO& vao, GLuint binding);
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include"CompactVertex.h"
+#include"CityGenerator.h"
+
+#include<algorithm>
+#include<cmath>
+#include<vector>
+
+// Rounds a value between 0 and 1 to the nearest 16 bit fraction
+static GLushort unorm16(float value)
+{
+	return (GLushort)std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+// Converts vertices of CityGenerator's layout
+void CompactVertex::Pack(const GLfloat* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, CompactVertex* out, glm::vec3& boxMin, glm::vec3& boxSize)
+{
+	const unsigned int floats = CityGenerator::VERTEX_FLOATS;
+	boxMin = glm::vec3(0.0f);
+	glm::vec3 boxMax(0.0f);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		glm::vec3 position(vertices[i * floats], vertices[i * floats + 1], vertices[i * floats + 2]);
+		boxMin = i == 0 ? position : glm::min(boxMin, position);
+		boxMax = i == 0 ? position : glm::max(boxMax, position);
+	}
+	// A flat side of the box still gets a size, so dividing by it stays finite
+	boxSize = glm::max(boxMax - boxMin, glm::vec3(1e-6f));
+
+	// Faces have their own vertices, so summing the triangle normals gives every vertex its face's normal
+	std::vector<glm::vec3> normals(vertexCount, glm::vec3(0.0f));
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		const GLfloat* a = &vertices[indices[i] * floats];
+		const GLfloat* b = &vertices[indices[i + 1] * floats];
+		const GLfloat* c = &vertices[indices[i + 2] * floats];
+		glm::vec3 normal = glm::cross(glm::vec3(b[0] - a[0], b[1] - a[1], b[2] - a[2]), glm::vec3(c[0] - a[0], c[1] - a[1], c[2] - a[2]));
+		normals[indices[i]] += normal;
+		normals[indices[i + 1]] += normal;
+		normals[indices[i + 2]] += normal;
+	}
+
+	// The vertex shader scales texture coordinates by the instance scale, which here is the box
+	glm::vec2 texScale(std::max(boxSize.x, boxSize.z), boxSize.y);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const GLfloat* v = &vertices[i * floats];
+		CompactVertex& vertex = out[i];
+		for (int axis = 0; axis < 3; axis++)
+			vertex.position[axis] = unorm16((v[axis] - boxMin[axis]) / boxSize[axis]);
+		vertex.position[3] = 0;
+		float length = glm::length(normals[i]);
+		vertex.normal = PackNormal(length > 0.0f ? normals[i] / length : glm::vec3(0.0f, 1.0f, 0.0f));
+		vertex.texCoord[0] = unorm16(v[3] / texScale.x);
+		vertex.texCoord[1] = unorm16(v[4] / texScale.y);
+	}
+}
+
+// Packs a unit vector into GL_INT_2_10_10_10_REV
+GLuint CompactVertex::PackNormal(const glm::vec3& normal)
+{
+	// Signed 10 bit fractions, -1 and 1 become -511 and 511
+	auto snorm10 = [](float value) {
+		return (GLuint)((int)std::lround(std::clamp(value, -1.0f, 1.0f) * 511.0f) & 0x3ff);
+	};
+	return snorm10(normal.x) | (snorm10(normal.y) << 10) | (snorm10(normal.z) << 20);
+}
+
+// Formats the compact attributes at locations 0, 2 and 3 and links a buffer to their binding
+void CompactVertex::Link(VAO& vao, GLuint binding, GLuint buffer)
+{
+	vao.Format(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactVertex, position), binding);
+	vao.Format(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, offsetof(CompactVertex, texCoord), binding);
+	vao.Format(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, offsetof(CompactVertex, normal), binding);
+	vao.LinkBuffer(binding, buffer, 0, sizeof(CompactVertex));
+}
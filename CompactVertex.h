@@ -0,0 +1,33 @@
+#ifndef COMPACT_VERTEX_CLASS_H
+#define COMPACT_VERTEX_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+
+#include"VAO.h"
+
+// 16 byte vertex for large scenes, instead of the 20 bytes of CityGenerator's float layout (32 with a normal)
+// Positions are 16 bit fractions of the mesh's bounding box, which the instance translation and scale turn back into object space.
+// Texture coordinates are divided by the same scale the vertex shader multiplies them with, so they fit 16 bit fractions as well.
+class CompactVertex
+{
+public:
+	// Position within the box, the fourth value only pads the normal to 4 bytes
+	GLushort position[4];
+	// Normal as GL_INT_2_10_10_10_REV, x in the lowest 10 bits
+	GLuint normal;
+	// Texture coordinates as 16 bit fractions
+	GLushort texCoord[2];
+
+	// Converts vertices of CityGenerator's layout, normals are taken from the triangles each vertex belongs to
+	// boxMin and boxSize receive the box the positions are relative to, use them as the mesh's instance translation and scale
+	static void Pack(const GLfloat* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, CompactVertex* out, glm::vec3& boxMin, glm::vec3& boxSize);
+	// Packs a unit vector into GL_INT_2_10_10_10_REV
+	static GLuint PackNormal(const glm::vec3& normal);
+	// Formats locations 0, 2 and 3 as the position, texture coordinates and normal of a binding and links a buffer of
+	// compact vertices to it, the VAO has to be bound unless GLExt.directStateAccess
+	static void Link(VAO& vao, GLuint binding, GLuint buffer);
+};
+
+#endif
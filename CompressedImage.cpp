@@ -0,0 +1,332 @@
+#include"CompressedImage.h"
+
+#include"GLExtensions.h"
+
+#include<algorithm>
+#include<cctype>
+#include<cstdint>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<string>
+
+// Reads a little endian integer at an offset of the file
+template<typename T>
+static T read(const std::vector<unsigned char>& data, size_t offset)
+{
+	T value = 0;
+	if (offset + sizeof(T) <= data.size())
+		memcpy(&value, &data[offset], sizeof(T));
+	return value;
+}
+
+// Size in texels of a format's blocks and bytes per block, 0 bytes for formats that are not block compressed
+static unsigned int blockInfo(GLenum format, int& blockWidth, int& blockHeight)
+{
+	blockWidth = 4;
+	blockHeight = 4;
+	switch (format)
+	{
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RED_RGTC1:
+	case GL_COMPRESSED_SIGNED_RED_RGTC1:
+		return 8;
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_SIGNED_RG_RGTC2:
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+	case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+	case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+		return 16;
+	}
+
+	// ASTC block sizes in the order of their format enums
+	static const int astcBlocks[14][2] =
+	{
+		{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+		{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 }
+	};
+	GLenum astc = 0;
+	if (format >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR && format < GL_COMPRESSED_RGBA_ASTC_4x4_KHR + 14)
+		astc = GL_COMPRESSED_RGBA_ASTC_4x4_KHR;
+	else if (format >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR && format < GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR + 14)
+		astc = GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR;
+	if (astc == 0)
+		return 0;
+	blockWidth = astcBlocks[format - astc][0];
+	blockHeight = astcBlocks[format - astc][1];
+	return 16;
+}
+
+// Bytes of one level of a block compressed format, 0 for other formats
+size_t CompressedImage::LevelSize(GLenum format, int width, int height)
+{
+	int blockWidth, blockHeight;
+	size_t bytes = blockInfo(format, blockWidth, blockHeight);
+	size_t blocksX = (width + blockWidth - 1) / blockWidth;
+	size_t blocksY = (height + blockHeight - 1) / blockHeight;
+	return std::max<size_t>(1, blocksX) * std::max<size_t>(1, blocksY) * bytes;
+}
+
+// Checks if a path names a DDS or KTX2 file by its extension
+bool CompressedImage::IsCompressedFile(const char* path)
+{
+	std::string name = path;
+	size_t dot = name.rfind('.');
+	if (dot == std::string::npos)
+		return false;
+	std::string extension = name.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return extension == "dds" || extension == "ktx2";
+}
+
+// Reads a DDS or KTX2 file
+bool CompressedImage::Load(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Failed to open compressed texture " << path << std::endl;
+		return false;
+	}
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	levels.clear();
+	format = 0;
+
+	static const unsigned char ktx2Magic[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+	bool parsed;
+	if (data.size() >= 12 && memcmp(data.data(), ktx2Magic, 12) == 0)
+		parsed = parseKTX2(path);
+	else if (data.size() >= 4 && memcmp(data.data(), "DDS ", 4) == 0)
+		parsed = parseDDS(path);
+	else
+	{
+		std::cerr << "Not a DDS or KTX2 file " << path << std::endl;
+		parsed = false;
+	}
+	if (!parsed)
+	{
+		data.clear();
+		levels.clear();
+	}
+	return parsed;
+}
+
+// Fills the levels of a format from the first one at offset
+bool CompressedImage::layoutLevels(size_t offset, unsigned int levelCount)
+{
+	int levelWidth = width, levelHeight = height;
+	for (unsigned int i = 0; i < levelCount; i++)
+	{
+		Level level;
+		level.offset = offset;
+		level.size = LevelSize(format, levelWidth, levelHeight);
+		level.width = levelWidth;
+		level.height = levelHeight;
+		if (level.offset + level.size > data.size())
+			return false;
+		levels.push_back(level);
+		offset += level.size;
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+	return true;
+}
+
+// Reads the legacy DDS header or the DX10 one that follows it
+bool CompressedImage::parseDDS(const char* path)
+{
+	if (data.size() < 128 || read<uint32_t>(data, 4) != 124)
+	{
+		std::cerr << "Broken DDS header in " << path << std::endl;
+		return false;
+	}
+	height = (int)read<uint32_t>(data, 12);
+	width = (int)read<uint32_t>(data, 16);
+	unsigned int levelCount = std::max<uint32_t>(1, read<uint32_t>(data, 28));
+	uint32_t pixelFlags = read<uint32_t>(data, 80);
+	uint32_t fourCC = read<uint32_t>(data, 84);
+	uint32_t caps2 = read<uint32_t>(data, 112);
+	size_t offset = 128;
+
+	auto code = [](const char* c) { return (uint32_t)c[0] | ((uint32_t)c[1] << 8) | ((uint32_t)c[2] << 16) | ((uint32_t)c[3] << 24); };
+	if (!(pixelFlags & 0x4) || (caps2 & 0x200))
+	{
+		std::cerr << "Only block compressed 2D DDS textures are supported: " << path << std::endl;
+		return false;
+	}
+	if (fourCC == code("DXT1")) format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	else if (fourCC == code("DXT3")) format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+	else if (fourCC == code("DXT5")) format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	else if (fourCC == code("ATI1") || fourCC == code("BC4U")) format = GL_COMPRESSED_RED_RGTC1;
+	else if (fourCC == code("BC4S")) format = GL_COMPRESSED_SIGNED_RED_RGTC1;
+	else if (fourCC == code("ATI2") || fourCC == code("BC5U")) format = GL_COMPRESSED_RG_RGTC2;
+	else if (fourCC == code("BC5S")) format = GL_COMPRESSED_SIGNED_RG_RGTC2;
+	else if (fourCC == code("DX10"))
+	{
+		if (data.size() < 148 || read<uint32_t>(data, 140) > 1)
+		{
+			std::cerr << "Only single layer DDS textures are supported: " << path << std::endl;
+			return false;
+		}
+		offset = 148;
+		switch (read<uint32_t>(data, 128))
+		{
+		case 71: format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+		case 72: format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT; break;
+		case 74: format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
+		case 75: format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT; break;
+		case 77: format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+		case 78: format = GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT; break;
+		case 80: format = GL_COMPRESSED_RED_RGTC1; break;
+		case 81: format = GL_COMPRESSED_SIGNED_RED_RGTC1; break;
+		case 83: format = GL_COMPRESSED_RG_RGTC2; break;
+		case 84: format = GL_COMPRESSED_SIGNED_RG_RGTC2; break;
+		case 95: format = GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT; break;
+		case 96: format = GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT; break;
+		case 98: format = GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+		case 99: format = GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM; break;
+		}
+	}
+	if (format == 0)
+	{
+		std::cerr << "Unsupported DDS format in " << path << std::endl;
+		return false;
+	}
+	if (width <= 0 || height <= 0 || !layoutLevels(offset, levelCount))
+	{
+		std::cerr << "Truncated DDS file " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Reads a KTX2 file without supercompression
+bool CompressedImage::parseKTX2(const char* path)
+{
+	if (data.size() < 80)
+	{
+		std::cerr << "Broken KTX2 header in " << path << std::endl;
+		return false;
+	}
+	uint32_t vkFormat = read<uint32_t>(data, 12);
+	width = (int)read<uint32_t>(data, 20);
+	height = (int)read<uint32_t>(data, 24);
+	uint32_t depth = read<uint32_t>(data, 28);
+	uint32_t layers = read<uint32_t>(data, 32);
+	uint32_t faces = read<uint32_t>(data, 36);
+	unsigned int levelCount = std::max<uint32_t>(1, read<uint32_t>(data, 40));
+	uint32_t supercompression = read<uint32_t>(data, 44);
+	if (depth > 1 || layers > 1 || faces != 1 || supercompression != 0)
+	{
+		std::cerr << "Only plain 2D KTX2 textures without supercompression are supported: " << path << std::endl;
+		return false;
+	}
+
+	// Vulkan formats 131 to 146 are BC1 to BC7, 157 to 184 are ASTC in unorm/sRGB pairs
+	static const GLenum bcFormats[16] =
+	{
+		GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT,
+		GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,
+		GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,
+		GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,
+		GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_SIGNED_RED_RGTC1,
+		GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_SIGNED_RG_RGTC2,
+		GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT,
+		GL_COMPRESSED_RGBA_BPTC_UNORM, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+	};
+	if (vkFormat >= 131 && vkFormat <= 146)
+		format = bcFormats[vkFormat - 131];
+	else if (vkFormat >= 157 && vkFormat <= 184)
+		format = ((vkFormat - 157) % 2 == 0 ? GL_COMPRESSED_RGBA_ASTC_4x4_KHR : GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR) + (vkFormat - 157) / 2;
+	if (format == 0 || width <= 0 || height <= 0)
+	{
+		std::cerr << "Unsupported KTX2 format in " << path << std::endl;
+		return false;
+	}
+
+	// The level index follows the 80 byte header, every level has its own offset
+	size_t index = 80;
+	int levelWidth = width, levelHeight = height;
+	for (unsigned int i = 0; i < levelCount; i++)
+	{
+		Level level;
+		level.offset = (size_t)read<uint64_t>(data, index + i * 24);
+		level.size = (size_t)read<uint64_t>(data, index + i * 24 + 8);
+		level.width = levelWidth;
+		level.height = levelHeight;
+		if (index + (i + 1) * 24 > data.size() || level.offset + level.size > data.size() || level.size != LevelSize(format, levelWidth, levelHeight))
+		{
+			std::cerr << "Truncated KTX2 file " << path << std::endl;
+			return false;
+		}
+		levels.push_back(level);
+		levelWidth = std::max(1, levelWidth / 2);
+		levelHeight = std::max(1, levelHeight / 2);
+	}
+	return true;
+}
+
+// Checks if the current context can sample the format
+bool CompressedImage::Supported() const
+{
+	switch (format)
+	{
+	case GL_COMPRESSED_RED_RGTC1:
+	case GL_COMPRESSED_SIGNED_RED_RGTC1:
+	case GL_COMPRESSED_RG_RGTC2:
+	case GL_COMPRESSED_SIGNED_RG_RGTC2:
+		return true;
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		return GLExt.textureS3TC;
+	case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+	case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		return GLExt.textureS3TCsRGB;
+	case GL_COMPRESSED_RGBA_BPTC_UNORM:
+	case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+	case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+	case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+		return GLExt.textureBPTC;
+	}
+	return GLExt.textureASTC && format != 0;
+}
+
+// Uploads every level into the bound texture
+void CompressedImage::Upload(GLenum target, const unsigned char* source, bool allocate) const
+{
+	if (allocate)
+	{
+		glTexStorage2D(target, (GLsizei)levels.size(), format, width, height);
+		for (size_t i = 0; i < levels.size(); i++)
+			glCompressedTexSubImage2D(target, (GLint)i, 0, 0, levels[i].width, levels[i].height, format, (GLsizei)levels[i].size, source + levels[i].offset);
+	}
+	else
+	{
+		for (size_t i = 0; i < levels.size(); i++)
+			glCompressedTexImage2D(target, (GLint)i, format, levels[i].width, levels[i].height, 0, (GLsizei)levels[i].size, source + levels[i].offset);
+	}
+	// Sampling stops at the last level in the file instead of expecting a full chain
+	glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, (GLint)levels.size() - 1);
+}
+
+// Bytes of GPU memory the image takes
+size_t CompressedImage::byteSize() const
+{
+	size_t total = 0;
+	for (const Level& level : levels)
+		total += level.size;
+	return total;
+}
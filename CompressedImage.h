@@ -0,0 +1,51 @@
+#ifndef COMPRESSED_IMAGE_CLASS_H
+#define COMPRESSED_IMAGE_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<vector>
+
+// A block compressed 2D image with its whole mip chain, read from a DDS or KTX2 file
+// Supports BC1-BC7 and ASTC LDR. The blocks are uploaded as stored, so files are expected to be written bottom row first
+class CompressedImage
+{
+public:
+	// Where one mip level lives inside data
+	struct Level
+	{
+		size_t offset;
+		size_t size;
+		int width;
+		int height;
+	};
+
+	// Compressed internal format such as GL_COMPRESSED_RGBA_BPTC_UNORM
+	GLenum format = 0;
+	int width = 0;
+	int height = 0;
+	// Level 0 is the full size image
+	std::vector<Level> levels;
+	// The whole file, levels point into it
+	std::vector<unsigned char> data;
+
+	// Bytes of one level of a block compressed format, 0 for other formats
+	static size_t LevelSize(GLenum format, int width, int height);
+	// Checks if a path names a DDS or KTX2 file by its extension
+	static bool IsCompressedFile(const char* path);
+	// Reads a DDS or KTX2 file, returns false and prints why if it cannot be used
+	bool Load(const char* path);
+	// Checks if the current context can sample the format
+	bool Supported() const;
+	// Uploads every level into the bound texture, source is data.data() or the offset of a copy of data in a bound pixel buffer
+	// allocate gives a texture without storage yet immutable storage of exactly the levels in the file, needs GLExt.textureStorage
+	void Upload(GLenum target, const unsigned char* source, bool allocate = false) const;
+	// Bytes of GPU memory the image takes
+	size_t byteSize() const;
+private:
+	// Fills the levels of a format from the first one at offset, returns false if the file is too short
+	bool layoutLevels(size_t offset, unsigned int levelCount);
+	bool parseDDS(const char* path);
+	bool parseKTX2(const char* path);
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include"ContentCache.h"
+
+#include<algorithm>
+#include<cstdio>
+#include<cstdlib>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+
+namespace fs = std::filesystem;
+
+// Start of the index file, followed by the number of keys and a key hash and content hash for each
+static const uint32_t INDEX_MAGIC = 0x58444943; // "CIDX"
+// Extension of the content files, whose names are the hex hash of their bytes
+static const char* CONTENT_EXTENSION = ".blob";
+
+// 64 bit FNV-1a, the same for keys and contents
+static uint64_t hashBytes(const char* bytes, size_t count)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < count; i++)
+	{
+		hash ^= (unsigned char)bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// Constructor that lists the content files, oldest first, and reads the index of keys pointing at them
+ContentCache::ContentCache(const std::string& directory, uint64_t capacityBytes)
+	: directory(directory), capacity(capacityBytes)
+{
+	std::error_code error;
+	fs::create_directories(directory, error);
+	std::vector<std::pair<fs::file_time_type, uint64_t>> found;
+	for (const fs::directory_entry& file : fs::directory_iterator(directory, error))
+	{
+		if (file.path().extension() != CONTENT_EXTENSION)
+			continue;
+		uint64_t content = std::strtoull(file.path().stem().string().c_str(), nullptr, 16);
+		uint64_t bytes = (uint64_t)file.file_size(error);
+		found.push_back({ file.last_write_time(error), content });
+		entries[content] = { bytes, 0 };
+		totalBytes += bytes;
+	}
+	// Modification times carry the order of use over from the last launch
+	std::sort(found.begin(), found.end());
+	for (const auto& file : found)
+		entries[file.second].lastUsed = ++useCounter;
+	loadIndex();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		evict();
+	}
+	thread = std::thread(&ContentCache::run, this);
+}
+
+// Finishes the queued writes unless Delete was already called
+ContentCache::~ContentCache()
+{
+	Delete();
+}
+
+std::string ContentCache::path(uint64_t content) const
+{
+	char name[17];
+	std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)content);
+	return directory + "/" + name + CONTENT_EXTENSION;
+}
+
+// Maps the content of a key and marks it as used
+bool ContentCache::Read(const std::string& key, MappedFile& file)
+{
+	std::string contentPath;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto found = keys.find(hashBytes(key.data(), key.size()));
+		auto entry = found == keys.end() ? entries.end() : entries.find(found->second);
+		if (entry == entries.end())
+		{
+			missCount++;
+			return false;
+		}
+		entry->second.lastUsed = ++useCounter;
+		touched.push_back(entry->first);
+		contentPath = path(entry->first);
+	}
+	// Deleted behind the cache's back counts as a miss, the next write of the key stores it again
+	// A file evicted while mapped stays readable until it is unmapped, where the OS does not refuse to delete it
+	bool mapped = file.Open(contentPath);
+	(mapped ? hitCount : missCount)++;
+	return mapped;
+}
+
+// Queues a write for the thread
+void ContentCache::Write(const std::string& key, std::vector<char> data)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopped)
+			return;
+		writes.push_back({ key, std::move(data) });
+	}
+	wake.notify_one();
+}
+
+// Waits until the queue is empty and the thread is done with the last write
+void ContentCache::Flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [&] { return stopped || (writes.empty() && !writing); });
+}
+
+uint64_t ContentCache::size()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return totalBytes;
+}
+
+uint64_t ContentCache::hits() const
+{
+	return hitCount.load(std::memory_order_relaxed);
+}
+
+uint64_t ContentCache::misses() const
+{
+	return missCount.load(std::memory_order_relaxed);
+}
+
+// Loop of the thread
+void ContentCache::run()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	for (;;)
+	{
+		wake.wait(lock, [&] { return stopping || !writes.empty() || !touched.empty(); });
+		if (writes.empty() && touched.empty() && stopping)
+			break;
+		writing = true;
+		std::vector<uint64_t> marks;
+		marks.swap(touched);
+		std::deque<std::pair<std::string, std::vector<char>>> batch;
+		batch.swap(writes);
+		lock.unlock();
+		// A read moves its file to the back of the order the next launch starts from
+		std::error_code error;
+		for (uint64_t content : marks)
+			fs::last_write_time(path(content), fs::file_time_type::clock::now(), error);
+		for (const auto& write : batch)
+			store(write.first, write.second);
+		if (!batch.empty())
+			saveIndex();
+		lock.lock();
+		writing = false;
+		idle.notify_all();
+	}
+}
+
+// Writes the content under a temporary name first, so a launch that dies halfway never leaves a torn file behind
+void ContentCache::store(const std::string& key, const std::vector<char>& data)
+{
+	uint64_t content = hashBytes(data.data(), data.size());
+	bool exists;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		exists = entries.count(content) != 0;
+	}
+	if (!exists)
+	{
+		std::string target = path(content);
+		std::string temporary = target + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.write(data.data(), (std::streamsize)data.size());
+			if (!file)
+			{
+				std::cerr << "ERROR::CONTENT_CACHE::WRITE_FAILED " << temporary << std::endl;
+				return;
+			}
+		}
+		std::error_code error;
+		fs::rename(temporary, target, error);
+		if (error)
+		{
+			fs::remove(temporary, error);
+			return;
+		}
+	}
+	std::lock_guard<std::mutex> lock(mutex);
+	Entry& entry = entries[content];
+	if (!exists)
+	{
+		entry.bytes = data.size();
+		totalBytes += data.size();
+	}
+	entry.lastUsed = ++useCounter;
+	keys[hashBytes(key.data(), key.size())] = content;
+	evict();
+}
+
+// Deletes the least recently used contents and every key pointing at them
+void ContentCache::evict()
+{
+	while (totalBytes > capacity && !entries.empty())
+	{
+		auto oldest = entries.begin();
+		for (auto it = entries.begin(); it != entries.end(); ++it)
+			if (it->second.lastUsed < oldest->second.lastUsed)
+				oldest = it;
+		std::error_code error;
+		fs::remove(path(oldest->first), error);
+		totalBytes -= oldest->second.bytes;
+		uint64_t content = oldest->first;
+		entries.erase(oldest);
+		for (auto it = keys.begin(); it != keys.end();)
+			it = it->second == content ? keys.erase(it) : std::next(it);
+	}
+}
+
+// Reads the keys, dropping those whose content is gone
+void ContentCache::loadIndex()
+{
+	std::ifstream file(directory + "/index.bin", std::ios::binary);
+	uint32_t header[2] = {};
+	file.read((char*)header, sizeof(header));
+	if (!file || header[0] != INDEX_MAGIC)
+		return;
+	for (uint32_t i = 0; i < header[1]; i++)
+	{
+		uint64_t pair[2];
+		if (!file.read((char*)pair, sizeof(pair)))
+			break;
+		if (entries.count(pair[1]) != 0)
+			keys[pair[0]] = pair[1];
+	}
+}
+
+// Writes the keys under a temporary name first, like the contents
+void ContentCache::saveIndex()
+{
+	std::vector<uint64_t> pairs;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pairs.reserve(2 * keys.size());
+		for (const auto& key : keys)
+		{
+			pairs.push_back(key.first);
+			pairs.push_back(key.second);
+		}
+	}
+	std::string target = directory + "/index.bin";
+	{
+		std::ofstream file(target + ".tmp", std::ios::binary | std::ios::trunc);
+		uint32_t header[2] = { INDEX_MAGIC, (uint32_t)(pairs.size() / 2) };
+		file.write((const char*)header, sizeof(header));
+		file.write((const char*)pairs.data(), (std::streamsize)(pairs.size() * sizeof(uint64_t)));
+		if (!file)
+			return;
+	}
+	std::error_code error;
+	fs::rename(target + ".tmp", target, error);
+}
+
+// Finishes the queued writes and stops the thread
+void ContentCache::Delete()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopped)
+			return;
+		stopping = true;
+	}
+	wake.notify_one();
+	if (thread.joinable())
+		thread.join();
+	std::lock_guard<std::mutex> lock(mutex);
+	stopped = true;
+	idle.notify_all();
+}
@@ -0,0 +1,91 @@
+#ifndef CONTENT_CACHE_CLASS_H
+#define CONTENT_CACHE_CLASS_H
+
+#include<atomic>
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<deque>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<unordered_map>
+#include<utility>
+#include<vector>
+
+#include"MappedFile.h"
+
+// On disk cache of downloaded and generated content, such as streamed tiles, kept across launches
+// Content is stored once per hash of its bytes, and an index maps the keys it was stored under, such as the url it
+// came from, to that hash, so the same tile under two names takes the space once. Reads map the stored file, writes
+// are queued and done by a thread of their own so a loading job never waits for the disk. When the files outgrow the
+// size cap, those read or written longest ago, across launches too, are deleted first.
+class ContentCache
+{
+public:
+	// Constructor that picks up what earlier launches left in directory and keeps it under capacityBytes
+	ContentCache(const std::string& directory, uint64_t capacityBytes);
+	// Finishes the queued writes and stops the thread unless Delete was already called
+	~ContentCache();
+	// The thread points back at the cache, so it can be neither copied nor moved
+	ContentCache(const ContentCache&) = delete;
+	ContentCache& operator=(const ContentCache&) = delete;
+
+	// Maps the content stored under key into file, false on a miss, safe to call from any thread
+	bool Read(const std::string& key, MappedFile& file);
+	// Queues data to be stored under key, replacing what was stored under it, safe to call from any thread
+	void Write(const std::string& key, std::vector<char> data);
+	// Waits until every queued write is on disk
+	void Flush();
+
+	// Bytes of content on disk, and reads that hit and missed so far
+	uint64_t size();
+	uint64_t hits() const;
+	uint64_t misses() const;
+
+	// Finishes the queued writes, saves the index and stops the thread, does nothing if that was already done
+	void Delete();
+private:
+	// A stored file, named after the hash of its content
+	struct Entry
+	{
+		uint64_t bytes;
+		// Order of the last read or write, higher is more recent
+		uint64_t lastUsed;
+	};
+
+	std::string directory;
+	uint64_t capacity;
+	// Hash of every key to the hash of its content
+	std::unordered_map<uint64_t, uint64_t> keys;
+	std::unordered_map<uint64_t, Entry> entries;
+	uint64_t totalBytes = 0;
+	uint64_t useCounter = 0;
+	std::atomic<uint64_t> hitCount{ 0 };
+	std::atomic<uint64_t> missCount{ 0 };
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::deque<std::pair<std::string, std::vector<char>>> writes;
+	// Contents read since the thread last marked them on disk as recently used
+	std::vector<uint64_t> touched;
+	bool writing = false;
+	bool stopping = false;
+	bool stopped = false;
+	std::thread thread;
+
+	// Loop of the thread, stores the queued writes and saves the index after each batch
+	void run();
+	// Writes one content file and points key at it
+	void store(const std::string& key, const std::vector<char>& data);
+	// Deletes the least recently used contents until the rest fits the cap, the mutex has to be held
+	void evict();
+	// Reads and writes the index of keys
+	void loadIndex();
+	void saveIndex();
+	// File a content is stored in
+	std::string path(uint64_t content) const;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include"DebugDraw.h"
+
+DebugDraw Debug;
+
+#ifdef DEBUG_DRAW
+
+#include"GLStateCache.h"
+#include"StreamBuffer.h"
+#include"VAO.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+#include<cmath>
+#include<cstring>
+
+static const char* debugVertexSource = R"(
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec4 aColor;
+
+uniform mat4 matrix;
+
+out vec4 Color;
+
+void main()
+{
+    Color = aColor;
+    gl_Position = matrix * vec4(aPos, 1.0);
+}
+)";
+static const char* debugFragmentSource = R"(
+#version 330 core
+in vec4 Color;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = Color;
+}
+)";
+
+// Nothing is made before Init, the global exists before any context does
+DebugDraw::DebugDraw()
+{
+}
+
+// The context is gone by the time globals are destroyed, Delete has to be called before
+DebugDraw::~DebugDraw()
+{
+}
+
+void DebugDraw::Init(size_t maxLines, FrameScheduler* scheduler)
+{
+	Delete();
+	DebugDraw::maxLines = maxLines;
+	program = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, debugVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, debugFragmentSource, "FRAGMENT") });
+
+	stream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, (GLsizeiptr)(maxLines * 2 * VERTEX_BYTES));
+	stream->scheduler = scheduler;
+	vao = std::make_unique<VAO>();
+	vao->Bind();
+	vao->Format(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	vao->Format(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 3 * sizeof(float), 0);
+	vao->Unbind();
+}
+
+// The region is mapped by the frame's first line, a frame without any maps nothing
+void DebugDraw::Line(const glm::vec3& a, const glm::vec3& b, uint32_t color)
+{
+	if (lineCount >= maxLines)
+	{
+		droppedLines++;
+		return;
+	}
+	if (!vertices)
+		vertices = (unsigned char*)stream->Map();
+	unsigned char* end = vertices + lineCount++ * 2 * VERTEX_BYTES;
+	std::memcpy(end, glm::value_ptr(a), 3 * sizeof(float));
+	std::memcpy(end + 3 * sizeof(float), &color, sizeof(color));
+	std::memcpy(end + VERTEX_BYTES, glm::value_ptr(b), 3 * sizeof(float));
+	std::memcpy(end + VERTEX_BYTES + 3 * sizeof(float), &color, sizeof(color));
+}
+
+void DebugDraw::Box(const glm::vec3& min, const glm::vec3& max, uint32_t color)
+{
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+		corners[i] = glm::vec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+	// Corners i and j share an edge when their indices differ in one bit
+	for (int i = 0; i < 8; i++)
+		for (int bit = 1; bit < 8; bit <<= 1)
+			if (!(i & bit))
+				Line(corners[i], corners[i | bit], color);
+}
+
+// The corners of the NDC cube taken back through the inverse, in the order Box numbers them
+void DebugDraw::Frustum(const glm::mat4& viewProjection, uint32_t color)
+{
+	glm::mat4 inverse = glm::inverse(viewProjection);
+	glm::vec3 corners[8];
+	for (int i = 0; i < 8; i++)
+	{
+		glm::vec4 corner = inverse * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f, i & 4 ? 1.0f : -1.0f, 1.0f);
+		corners[i] = glm::vec3(corner) / corner.w;
+	}
+	for (int i = 0; i < 8; i++)
+		for (int bit = 1; bit < 8; bit <<= 1)
+			if (!(i & bit))
+				Line(corners[i], corners[i | bit], color);
+}
+
+void DebugDraw::Sphere(const glm::vec3& center, float radius, uint32_t color)
+{
+	const float step = 6.2831853f / SPHERE_SEGMENTS;
+	for (int s = 0; s < SPHERE_SEGMENTS; s++)
+	{
+		float c0 = radius * std::cos(s * step), s0 = radius * std::sin(s * step);
+		float c1 = radius * std::cos((s + 1) * step), s1 = radius * std::sin((s + 1) * step);
+		Line(center + glm::vec3(c0, s0, 0.0f), center + glm::vec3(c1, s1, 0.0f), color);
+		Line(center + glm::vec3(c0, 0.0f, s0), center + glm::vec3(c1, 0.0f, s1), color);
+		Line(center + glm::vec3(0.0f, c0, s0), center + glm::vec3(0.0f, c1, s1), color);
+	}
+}
+
+void DebugDraw::Flush(const glm::mat4& matrix)
+{
+	if (!vertices)
+		return;
+	stream->Unmap((GLsizeiptr)(lineCount * 2 * VERTEX_BYTES));
+
+	GLint previousProgram, previousVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	GLboolean depthMask;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+
+	glDepthMask(GL_FALSE);
+	GLState.UseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "matrix"), 1, GL_FALSE, glm::value_ptr(matrix));
+	GLState.CountUniforms();
+	vao->Bind();
+	vao->LinkBuffer(0, stream->ID, stream->Offset(), (GLsizei)VERTEX_BYTES);
+	glDrawArrays(GL_LINES, 0, (GLsizei)(lineCount * 2));
+	GLState.CountDraw(1, 0);
+	stream->Fence();
+	glDepthMask(depthMask);
+
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	vertices = nullptr;
+	lineCount = 0;
+}
+
+void DebugDraw::Delete()
+{
+	// A frame left mapped is given back empty
+	if (vertices)
+		stream->Unmap(0);
+	vertices = nullptr;
+	lineCount = 0;
+	if (program)
+		GLState.DeleteProgram(program);
+	program = 0;
+	vao.reset();
+	stream.reset();
+}
+
+#endif
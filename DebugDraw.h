@@ -0,0 +1,93 @@
+#ifndef DEBUG_DRAW_CLASS_H
+#define DEBUG_DRAW_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<memory>
+
+#include"FrameScheduler.h"
+
+// Debug builds draw debug lines, release builds compile every call away
+#ifndef NDEBUG
+#define DEBUG_DRAW
+#endif
+
+class StreamBuffer;
+class VAO;
+
+// Immediate mode lines for looking at bounds, spatial index nodes, frusta and lights: every call appends its lines
+// straight into the frame's region of a StreamBuffer, persistently mapped where the driver can, and Flush draws all
+// of them with one GL_LINES draw. Lines past the capacity are counted and dropped. Calls come from the thread the
+// context is current on, between the frame's first call and its Flush. Release builds have Enabled false and
+// empty inline calls, so neither the buffer nor the program exist there and callers can test Enabled to compile
+// out the loops feeding it as well.
+class DebugDraw
+{
+public:
+#ifdef DEBUG_DRAW
+	static constexpr bool Enabled = true;
+#else
+	static constexpr bool Enabled = false;
+#endif
+	// Bytes of a line's end: its position and an RGBA8 color
+	static constexpr size_t VERTEX_BYTES = 4 * sizeof(float);
+	// Segments of each of the three circles a sphere is drawn with
+	static constexpr int SPHERE_SEGMENTS = 16;
+
+	// Packs a color with components from 0 to 1 into the RGBA8 the vertices hold
+	static uint32_t Color(float r, float g, float b, float a = 1.0f)
+	{
+		auto byte = [](float v) { return (uint32_t)(glm::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+		return byte(r) | byte(g) << 8 | byte(b) << 16 | byte(a) << 24;
+	}
+
+#ifdef DEBUG_DRAW
+	DebugDraw();
+	~DebugDraw();
+	DebugDraw(const DebugDraw&) = delete;
+	DebugDraw& operator=(const DebugDraw&) = delete;
+
+	// Makes the program and a stream with room for maxLines lines a frame, recycled on scheduler's fences
+	void Init(size_t maxLines, FrameScheduler* scheduler);
+	// A line from a to b
+	void Line(const glm::vec3& a, const glm::vec3& b, uint32_t color);
+	// The 12 edges of an axis aligned box
+	void Box(const glm::vec3& min, const glm::vec3& max, uint32_t color);
+	// The 12 edges of the volume a projection and view matrix sees, for a depth range of -1 to 1 in NDC
+	void Frustum(const glm::mat4& viewProjection, uint32_t color);
+	// A circle around each axis
+	void Sphere(const glm::vec3& center, float radius, uint32_t color);
+	// Draws the frame's lines through matrix over what the framebuffer bound holds, tested against its depth without
+	// writing it, and starts the next frame. The program and VAO are put back
+	void Flush(const glm::mat4& matrix);
+	// Lines dropped for want of room since Init
+	size_t dropped() const { return droppedLines; }
+	// Deletes the GL objects, does nothing if they were already deleted or never made
+	void Delete();
+private:
+	GLuint program = 0;
+	std::unique_ptr<VAO> vao;
+	std::unique_ptr<StreamBuffer> stream;
+	size_t maxLines = 0;
+	// The frame's region while it is mapped, and the lines written into it
+	unsigned char* vertices = nullptr;
+	size_t lineCount = 0;
+	size_t droppedLines = 0;
+#else
+	void Init(size_t, FrameScheduler*) {}
+	void Line(const glm::vec3&, const glm::vec3&, uint32_t) {}
+	void Box(const glm::vec3&, const glm::vec3&, uint32_t) {}
+	void Frustum(const glm::mat4&, uint32_t) {}
+	void Sphere(const glm::vec3&, float, uint32_t) {}
+	void Flush(const glm::mat4&) {}
+	size_t dropped() const { return 0; }
+	void Delete() {}
+#endif
+};
+
+// The debug lines of the one context the engine renders with
+extern DebugDraw Debug;
+
+#endif
@@ -0,0 +1,310 @@
+#include"DecalLibrary.h"
+#include"ClusteredLights.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<glm/glm.hpp>
+#include<algorithm>
+#include<cmath>
+#include<vector>
+
+// Mixes the bits of a number so that neighbouring decals get unrelated values, as CityGenerator does for its lots
+static unsigned int hashDecal(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+// Turns a hash into a float between 0 and 1
+static float unitFloat(unsigned int hash)
+{
+	return (hash >> 8) * (1.0f / 16777216.0f);
+}
+
+// Smoothly interpolated value noise of a seed at a point, one lattice cell per unit
+static float valueNoise(float x, float y, unsigned int seed)
+{
+	float cellX = std::floor(x), cellY = std::floor(y);
+	float fx = x - cellX, fy = y - cellY;
+	fx = fx * fx * (3.0f - 2.0f * fx);
+	fy = fy * fy * (3.0f - 2.0f * fy);
+	auto corner = [&](int dx, int dy) {
+		return unitFloat(hashDecal(seed ^ hashDecal((unsigned int)((int)cellX + dx) * 0x27d4eb2dU ^ (unsigned int)((int)cellY + dy))));
+	};
+	float bottom = corner(0, 0) + (corner(1, 0) - corner(0, 0)) * fx;
+	float top = corner(0, 1) + (corner(1, 1) - corner(0, 1)) * fx;
+	return bottom + (top - bottom) * fy;
+}
+
+// Four octaves of value noise, from 0 to 1
+static float fractalNoise(float x, float y, unsigned int seed)
+{
+	float sum = 0.0f, amplitude = 0.5f, total = 0.0f;
+	for (int octave = 0; octave < 4; octave++)
+	{
+		sum += valueNoise(x, y, seed + (unsigned int)octave) * amplitude;
+		total += amplitude;
+		x *= 2.0f;
+		y *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return sum / total;
+}
+
+// Stores a color and its coverage as a texel
+static void writeTexel(unsigned char* texel, const glm::vec3& color, float alpha)
+{
+	glm::vec4 value = glm::clamp(glm::vec4(color, alpha), 0.0f, 1.0f) * 255.0f + 0.5f;
+	for (int c = 0; c < 4; c++)
+		texel[c] = (unsigned char)value[c];
+}
+
+// A panel of a color with a light border and two rows of made up letters, each a random 3 by 5 pattern of blocks
+static void generateSign(const glm::vec3& background, unsigned int seed, unsigned char* texels)
+{
+	const float size = (float)DecalLibrary::IMAGE_SIZE;
+	const glm::vec3 lettering(0.95f, 0.92f, 0.8f);
+	for (int y = 0; y < DecalLibrary::IMAGE_SIZE; y++)
+		for (int x = 0; x < DecalLibrary::IMAGE_SIZE; x++)
+		{
+			// Distance outside the rounded rectangle four texels in from the edge, negative inside
+			glm::vec2 p = glm::abs(glm::vec2((float)x + 0.5f, (float)y + 0.5f) - 0.5f * size);
+			glm::vec2 q = p - (0.5f * size - 4.0f - 10.0f);
+			float edge = glm::length(glm::max(q, 0.0f)) + std::min(std::max(q.x, q.y), 0.0f) - 10.0f;
+			float alpha = glm::clamp(0.5f - edge, 0.0f, 1.0f);
+			glm::vec3 color = edge > -4.0f ? lettering : background;
+			// Letters of 12 by 20 texels with 4 between them, in rows between 28 and 48 and between 68 and 88
+			int row = y >= 28 && y < 48 ? 0 : (y >= 68 && y < 88 ? 1 : -1);
+			int column = (x - 14) / 16, inLetter = (x - 14) % 16;
+			if (row >= 0 && x >= 14 && column < 6 && inLetter < 12)
+			{
+				unsigned int letter = hashDecal(seed + (unsigned int)(row * 8 + column));
+				int bit = (4 - ((y - (row ? 68 : 28)) / 4)) * 3 + inLetter / 4;
+				// The lower row is shorter, a line of smaller print under the name
+				if ((letter >> bit & 1) && (row == 1 || column < 4))
+					color = lettering;
+			}
+			writeTexel(texels + (y * DecalLibrary::IMAGE_SIZE + x) * 4, color, alpha);
+		}
+}
+
+// Three fat strokes along sine curves outlined in black, in two colors mixed by noise, with spray around them
+static void generateGraffiti(const glm::vec3& first, const glm::vec3& second, unsigned int seed, unsigned char* texels)
+{
+	const float size = (float)DecalLibrary::IMAGE_SIZE;
+	float centers[3], amplitudes[3], frequencies[3], phases[3];
+	for (int k = 0; k < 3; k++)
+	{
+		unsigned int hash = hashDecal(seed + (unsigned int)k * 17u);
+		centers[k] = 0.3f + 0.4f * unitFloat(hash);
+		amplitudes[k] = 0.08f + 0.12f * unitFloat(hashDecal(hash + 1));
+		frequencies[k] = 6.0f + 10.0f * unitFloat(hashDecal(hash + 2));
+		phases[k] = 6.283f * unitFloat(hashDecal(hash + 3));
+	}
+	for (int y = 0; y < DecalLibrary::IMAGE_SIZE; y++)
+		for (int x = 0; x < DecalLibrary::IMAGE_SIZE; x++)
+		{
+			float u = ((float)x + 0.5f) / size, v = ((float)y + 0.5f) / size;
+			float distance = 1.0f;
+			for (int k = 0; k < 3; k++)
+				distance = std::min(distance, std::abs(v - centers[k] - amplitudes[k] * std::sin(frequencies[k] * u + phases[k])));
+			// Strokes thin out towards the ends of the tag
+			float width = 0.07f * glm::clamp(std::min(u, 1.0f - u) * 8.0f, 0.0f, 1.0f);
+			glm::vec3 color = glm::mix(first, second, glm::smoothstep(0.35f, 0.65f, fractalNoise(u * 6.0f, v * 6.0f, seed)));
+			float alpha = 0.0f;
+			if (distance < width)
+				alpha = 1.0f;
+			else if (distance < width + 0.02f && width > 0.0f)
+			{
+				color = glm::vec3(0.05f);
+				alpha = 1.0f;
+			}
+			else
+			{
+				// Overspray, sparse dots fading with the distance from the strokes
+				float spray = unitFloat(hashDecal(seed ^ (unsigned int)(y * DecalLibrary::IMAGE_SIZE + x)));
+				if (spray > 0.6f + 8.0f * distance)
+					alpha = 0.6f;
+			}
+			writeTexel(texels + (y * DecalLibrary::IMAGE_SIZE + x) * 4, color, alpha);
+		}
+}
+
+// Blotches of a color where noise is high, fading out towards the edge of the image
+static void generateStain(const glm::vec3& color, float threshold, float strength, unsigned int seed, unsigned char* texels)
+{
+	const float size = (float)DecalLibrary::IMAGE_SIZE;
+	for (int y = 0; y < DecalLibrary::IMAGE_SIZE; y++)
+		for (int x = 0; x < DecalLibrary::IMAGE_SIZE; x++)
+		{
+			glm::vec2 p = (glm::vec2((float)x, (float)y) + 0.5f) / size * 2.0f - 1.0f;
+			float falloff = glm::clamp(1.0f - glm::dot(p, p), 0.0f, 1.0f);
+			float noise = fractalNoise(p.x * 4.0f, p.y * 4.0f, seed);
+			float alpha = glm::smoothstep(threshold, threshold + 0.25f, noise * (0.6f + 0.4f * falloff)) * falloff * strength;
+			writeTexel(texels + (y * DecalLibrary::IMAGE_SIZE + x) * 4, color * (0.8f + 0.4f * noise), alpha);
+		}
+}
+
+// Grime washed down from the top edge, columns of random strength and length
+static void generateStreaks(unsigned int seed, unsigned char* texels)
+{
+	const float size = (float)DecalLibrary::IMAGE_SIZE;
+	for (int y = 0; y < DecalLibrary::IMAGE_SIZE; y++)
+		for (int x = 0; x < DecalLibrary::IMAGE_SIZE; x++)
+		{
+			float u = ((float)x + 0.5f) / size, fromTop = 1.0f - ((float)y + 0.5f) / size;
+			float strength = valueNoise(u * 24.0f, 0.0f, seed);
+			float length = 0.3f + 0.7f * valueNoise(u * 11.0f, 7.0f, seed + 1);
+			float sides = glm::clamp(std::min(u, 1.0f - u) * 6.0f, 0.0f, 1.0f);
+			float alpha = strength * strength * glm::clamp(1.0f - fromTop / length, 0.0f, 1.0f) * sides * 0.8f;
+			writeTexel(texels + (y * DecalLibrary::IMAGE_SIZE + x) * 4, glm::vec3(0.12f, 0.12f, 0.11f), alpha);
+		}
+}
+
+// Writes the texels of an image
+void DecalLibrary::GenerateImage(Image image, unsigned char* texels)
+{
+	switch (image)
+	{
+	case SIGN_RED:
+		generateSign(glm::vec3(0.72f, 0.12f, 0.1f), 11u, texels);
+		break;
+	case SIGN_BLUE:
+		generateSign(glm::vec3(0.1f, 0.24f, 0.62f), 23u, texels);
+		break;
+	case SIGN_GREEN:
+		generateSign(glm::vec3(0.1f, 0.46f, 0.24f), 37u, texels);
+		break;
+	case GRAFFITI_WARM:
+		generateGraffiti(glm::vec3(0.95f, 0.45f, 0.1f), glm::vec3(0.9f, 0.2f, 0.5f), 41u, texels);
+		break;
+	case GRAFFITI_COOL:
+		generateGraffiti(glm::vec3(0.1f, 0.75f, 0.85f), glm::vec3(0.5f, 0.25f, 0.8f), 53u, texels);
+		break;
+	case DIRT:
+		generateStain(glm::vec3(0.22f, 0.18f, 0.14f), 0.45f, 0.85f, 61u, texels);
+		break;
+	case GRIME:
+		generateStain(glm::vec3(0.15f, 0.15f, 0.15f), 0.35f, 0.6f, 71u, texels);
+		break;
+	default:
+		generateStreaks(83u, texels);
+		break;
+	}
+}
+
+// Constructor that generates the images into a mipmapped texture array
+DecalLibrary::DecalLibrary()
+{
+	std::vector<unsigned char> texels((size_t)IMAGE_SIZE * IMAGE_SIZE * 4 * IMAGE_COUNT);
+	for (int image = 0; image < IMAGE_COUNT; image++)
+		GenerateImage((Image)image, texels.data() + (size_t)image * IMAGE_SIZE * IMAGE_SIZE * 4);
+
+	glGenTextures(1, &texture);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, IMAGE_SIZE, IMAGE_SIZE, IMAGE_COUNT, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, texture, GpuMemoryTracker::ImageBytes(GL_RGBA8, IMAGE_SIZE, IMAGE_SIZE, IMAGE_COUNT,
+		GpuMemoryTracker::MipLevels(IMAGE_SIZE, IMAGE_SIZE)));
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Deletes the texture unless Delete was already called
+DecalLibrary::~DecalLibrary()
+{
+	Delete();
+}
+
+// Binds the images and points the sampler of the program in use at them
+void DecalLibrary::Apply(GLuint program)
+{
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, "decalImages"), (GLint)TEXTURE_UNIT);
+	GLState.CountUniforms(1);
+}
+
+// Writes decals on the walls of the buildings, each on a lot and side drawn from its own hash
+void DecalLibrary::Scatter(const CityGenerator& city, GLfloat* decals, size_t count)
+{
+	size_t buildings = city.buildingCount();
+	if (buildings == 0)
+		return;
+	const glm::vec3 up(0.0f, 1.0f, 0.0f);
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int hash = hashDecal((unsigned int)i * 0x9e3779b9U ^ hashDecal(city.layout.seed + 7));
+		Building lot = city.building(hash % buildings);
+		// Sides -Z, +Z, -X and +X as CityGenerator::GenerateLights numbers them, the decal faces out of the wall
+		unsigned int side = hashDecal(hash + 1) % 4;
+		glm::vec3 out = side < 2 ? glm::vec3(0.0f, 0.0f, side == 0 ? -1.0f : 1.0f) : glm::vec3(side == 2 ? -1.0f : 1.0f, 0.0f, 0.0f);
+		glm::vec3 across = glm::cross(up, out);
+		float wallLength = side < 2 ? lot.maxX - lot.minX : lot.maxZ - lot.minZ;
+
+		// A kind by weight, then its size and height on the wall
+		float kind = unitFloat(hashDecal(hash + 2));
+		float a = unitFloat(hashDecal(hash + 3)), b = unitFloat(hashDecal(hash + 4));
+		Image image;
+		float halfWidth, halfHeight, y;
+		if (kind < 0.3f)
+		{
+			image = (Image)(SIGN_RED + hashDecal(hash + 5) % 3);
+			halfWidth = 0.15f + 0.15f * a;
+			halfHeight = halfWidth * 0.5f;
+			y = std::min(0.45f + 0.4f * b, lot.height - halfHeight);
+		}
+		else if (kind < 0.55f)
+		{
+			image = (Image)(GRAFFITI_WARM + hashDecal(hash + 5) % 2);
+			halfWidth = 0.25f + 0.35f * a;
+			halfHeight = halfWidth * (0.35f + 0.15f * b);
+			y = halfHeight + 0.02f;
+		}
+		else if (kind < 0.85f)
+		{
+			image = (Image)(DIRT + hashDecal(hash + 5) % 2);
+			halfWidth = 0.3f + 0.45f * a;
+			halfHeight = halfWidth * (0.7f + 0.3f * b);
+			y = halfHeight + (lot.height - 2.0f * halfHeight) * unitFloat(hashDecal(hash + 6));
+		}
+		else
+		{
+			image = STREAKS;
+			halfWidth = 0.2f + 0.3f * a;
+			halfHeight = 0.5f * lot.height * (0.3f + 0.3f * b);
+			y = lot.height - halfHeight;
+		}
+		halfWidth = std::min(halfWidth, 0.5f * wallLength);
+		halfHeight = std::min(halfHeight, 0.5f * lot.height);
+		y = glm::clamp(y, halfHeight, lot.height - halfHeight);
+
+		// Anywhere along the wall it fits on, its box straddling the wall
+		float along = halfWidth + (wallLength - 2.0f * halfWidth) * unitFloat(hashDecal(hash + 7));
+		glm::vec3 center = side < 2 ? glm::vec3(lot.minX + along, y, side == 0 ? lot.minZ : lot.maxZ)
+			: glm::vec3(side == 2 ? lot.minX : lot.maxX, y, lot.minZ + along);
+		glm::vec3 width = across * halfWidth, height = up * halfHeight;
+		float opacity = 0.6f + 0.4f * unitFloat(hashDecal(hash + 8));
+		GLfloat decal[ClusteredLights::DECAL_FLOATS] = { center.x, center.y, center.z, (GLfloat)image, width.x, width.y, width.z, opacity,
+			height.x, height.y, height.z, 0.1f };
+		std::copy(decal, decal + ClusteredLights::DECAL_FLOATS, decals + i * ClusteredLights::DECAL_FLOATS);
+	}
+}
+
+// Deletes the texture
+void DecalLibrary::Delete()
+{
+	if (texture != 0)
+	{
+		GLState.DeleteTextures(1, &texture);
+		texture = 0;
+	}
+}
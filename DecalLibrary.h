@@ -0,0 +1,58 @@
+#ifndef DECAL_LIBRARY_CLASS_H
+#define DECAL_LIBRARY_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"CityGenerator.h"
+
+// Signs, graffiti and wear put on the facades as decals instead of unique textures or geometry. The images are
+// generated once into a small texture array, and Scatter places decals on the walls of a generated city, the same seed
+// always giving the same ones. A decal is a box in ClusteredLights' decal layout, binned into the light clusters every
+// frame; the lit scene programs built with SHADER_DECALS and the deferred resolve project the images of the boxes
+// around a fragment onto it along the box's depth, before the fragment is lit.
+class DecalLibrary
+{
+public:
+	// Layers of the image array, a few variations of every kind
+	enum Image
+	{
+		SIGN_RED,
+		SIGN_BLUE,
+		SIGN_GREEN,
+		GRAFFITI_WARM,
+		GRAFFITI_COOL,
+		DIRT,
+		GRIME,
+		STREAKS,
+		IMAGE_COUNT
+	};
+	// Texels a side of every image
+	static constexpr GLsizei IMAGE_SIZE = 128;
+	// The image array is bound to this texture unit while the decals are drawn, next to ClusteredLights' decal buffer
+	static constexpr GLuint TEXTURE_UNIT = 27;
+
+	// Constructor that generates the images into a mipmapped texture array
+	DecalLibrary();
+	// Deletes the texture unless Delete was already called, the context has to still be current
+	~DecalLibrary();
+	// A DecalLibrary owns its GL objects, so it cannot be copied
+	DecalLibrary(const DecalLibrary&) = delete;
+	DecalLibrary& operator=(const DecalLibrary&) = delete;
+
+	// Binds the images and points the decalImages sampler of a program at them, which has to be in use
+	void Apply(GLuint program);
+
+	// Writes count decals on the walls of city's buildings into an array sized by count * ClusteredLights::DECAL_FLOATS:
+	// signs at shop height, graffiti near the ground, dirt anywhere and streaks running down from the roof
+	static void Scatter(const CityGenerator& city, GLfloat* decals, size_t count);
+	// Writes the IMAGE_SIZE by IMAGE_SIZE RGBA8 texels of an image, bottom row first
+	static void GenerateImage(Image image, unsigned char* texels);
+
+	// Deletes the texture, does nothing if it was already deleted
+	void Delete();
+private:
+	GLuint texture = 0;
+};
+
+#endif
@@ -0,0 +1,373 @@
+#include"DeferredRenderer.h"
+#include"DecalLibrary.h"
+#include"LightShadows.h"
+#include"ScreenSpaceOcclusion.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+#include<iostream>
+#include<utility>
+
+// Full screen triangle, every pixel of the G-buffer is resolved once
+static const char* resolveVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+static const char* resolveFragmentSource = R"(
+#version 330 core
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 inverseProjection;
+// 1 when the scene was drawn reverse-Z, its depth is then already the clip space depth
+uniform int reverseZ;
+// 0 copies the albedo through, 1 lights it with the clusters
+uniform int clustered;
+// 1 darkens the ambient light by ScreenSpaceOcclusion's half resolution occlusion and view depth
+uniform int occluded;
+uniform sampler2D occlusion;
+// Size of the occlusion, its texture may be larger while the window is being resized
+uniform ivec2 occlusionSize;
+
+// Point lights binned by ClusteredLights, looked up the same way as the CLUSTERED scene programs do
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform vec4 clusterScale;
+uniform ivec3 clusterSize;
+// Shadows of the lights LightShadows gave a slot, the same lookup as the LIGHT_SHADOWS scene programs
+uniform sampler2DShadow lightShadowAtlas;
+uniform samplerBuffer lightShadowTiles;
+uniform mat3 lightShadowToModel;
+// 1 projects the decals binned into the clusters onto the albedo, with their images from DecalLibrary
+uniform int decaled;
+uniform samplerBuffer clusterDecals;
+uniform sampler2DArray decalImages;
+// Size of a pixel at a view depth of 1
+uniform float pixelFootprint;
+
+out vec4 FragColor;
+
+// Upsamples the occlusion from the four half resolution texels nearest to the pixel, bilinearly weighted and faded out
+// with the difference of their view depth to the pixel's, so it does not bleed across edges
+float ambientOcclusion(ivec2 pixel, float viewZ)
+{
+    ivec2 center = pixel / 2;
+    ivec2 toward = (pixel & 1) * 2 - 1;
+    ivec2 last = occlusionSize - 1;
+    const vec4 bilinear = vec4(9.0, 3.0, 3.0, 1.0) / 16.0;
+    ivec2 offsets[4] = ivec2[](ivec2(0), ivec2(toward.x, 0), ivec2(0, toward.y), toward);
+    float sum = 0.0;
+    float total = 1e-4;
+    for (int i = 0; i < 4; i++)
+    {
+        vec2 tap = texelFetch(occlusion, clamp(center + offsets[i], ivec2(0), last), 0).rg;
+        float weight = bilinear[i] / (1e-3 + abs(tap.g - viewZ));
+        sum += tap.r * weight;
+        total += weight;
+    }
+    return sum / total;
+}
+
+// Part of a light shadowed from slot that reaches the point toPoint away from it in view space
+float lightShadow(int slot, vec3 toPoint)
+{
+    vec3 d = lightShadowToModel * toPoint;
+    vec3 a = abs(d);
+    int face;
+    float major;
+    vec2 st;
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = d.x > 0.0 ? 0 : 1;
+        major = a.x;
+        st = vec2(d.x > 0.0 ? d.z : -d.z, d.y);
+    }
+    else if (a.y >= a.z)
+    {
+        face = d.y > 0.0 ? 2 : 3;
+        major = a.y;
+        st = vec2(d.y > 0.0 ? d.x : -d.x, d.z);
+    }
+    else
+    {
+        face = d.z > 0.0 ? 4 : 5;
+        major = a.z;
+        st = vec2(d.z > 0.0 ? -d.x : d.x, d.y);
+    }
+    vec4 tile = texelFetch(lightShadowTiles, slot * 4 + 3);
+    vec4 corners = texelFetch(lightShadowTiles, slot * 4 + face / 2);
+    vec2 uv = ((face & 1) == 0 ? corners.xy : corners.zw) + clamp(st / major * 0.5 + 0.5, tile.w, 1.0 - tile.w) * tile.x;
+    float distance = max(major * (1.0 - 6.0 * tile.w), tile.y);
+    float depth = (tile.z + tile.y - 2.0 * tile.z * tile.y / distance) / (tile.z - tile.y) * 0.5 + 0.5;
+    return texture(lightShadowAtlas, vec3(uv, depth));
+}
+
+// Projects the decals of a cluster onto the albedo like the DECALS scene programs, but a full screen pass has no
+// derivatives of the surface, so the mip level comes from the size of a pixel at the point instead
+vec3 applyDecals(vec3 albedo, vec3 viewPos, vec3 normal, uvec2 cluster)
+{
+    float footprint = -viewPos.z * pixelFootprint * 0.5 * float(textureSize(decalImages, 0).x);
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        int index = int(texelFetch(clusterIndices, int(cluster.x + i)).x);
+        vec4 center = texelFetch(clusterDecals, index * 4);
+        vec4 across = texelFetch(clusterDecals, index * 4 + 1);
+        vec4 up = texelFetch(clusterDecals, index * 4 + 2);
+        vec3 forward = texelFetch(clusterDecals, index * 4 + 3).xyz;
+        vec3 offset = viewPos - center.xyz;
+        vec3 box = vec3(dot(offset, across.xyz), dot(offset, up.xyz), dot(offset, forward));
+        if (any(greaterThan(abs(box), vec3(1.0))))
+            continue;
+        float facing = smoothstep(0.3, 0.7, dot(normal, normalize(forward)));
+        float lod = log2(max(footprint * max(length(across.xyz), length(up.xyz)), 1e-6));
+        vec4 image = textureLod(decalImages, vec3(box.xy * 0.5 + 0.5, center.w), lod);
+        albedo = mix(albedo, image.rgb, image.a * across.w * facing * (1.0 - box.z * box.z));
+    }
+    return albedo;
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 albedo = texelFetch(gAlbedo, pixel, 0);
+    vec4 normal = texelFetch(gNormal, pixel, 0);
+    if ((clustered == 0 && occluded == 0) || normal.w == 0.0)
+    {
+        FragColor = albedo;
+        return;
+    }
+
+    // View space position from the depth and the inverse of the projection the scene was drawn with
+    vec2 uv = (gl_FragCoord.xy) / vec2(textureSize(gDepth, 0));
+    float depth = texelFetch(gDepth, pixel, 0).r;
+    vec4 clip = vec4(uv * 2.0 - 1.0, reverseZ != 0 ? depth : depth * 2.0 - 1.0, 1.0);
+    vec4 view = inverseProjection * clip;
+    vec3 viewPos = view.xyz / view.w;
+    float visible = occluded != 0 ? ambientOcclusion(pixel, viewPos.z) : 1.0;
+    // Without lights the albedo is all ambient
+    if (clustered == 0)
+    {
+        FragColor = vec4(albedo.rgb * visible, albedo.a);
+        return;
+    }
+
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScale.xy), clusterSize.xy - 1);
+    int slice = clamp(int(log(-viewPos.z) * clusterScale.z + clusterScale.w), 0, clusterSize.z - 1);
+    uvec4 cluster = texelFetch(clusterGrid, (slice * clusterSize.y + tile.y) * clusterSize.x + tile.x);
+    if (decaled != 0)
+        albedo.rgb = applyDecals(albedo.rgb, viewPos, normal.xyz, cluster.zw);
+    vec3 light = vec3(0.08 * visible);
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        int index = int(texelFetch(clusterIndices, int(cluster.x + i)).x);
+        vec4 position = texelFetch(clusterLights, index * 2);
+        vec3 toLight = position.xyz - viewPos;
+        float distance = length(toLight);
+        float falloff = clamp(1.0 - distance / position.w, 0.0, 1.0);
+        vec4 color = texelFetch(clusterLights, index * 2 + 1);
+        float shadow = color.w > 0.0 ? lightShadow(int(color.w) - 1, -toLight) : 1.0;
+        light += color.rgb * shadow * falloff * falloff * max(dot(normal.xyz, toLight / max(distance, 1e-4)), 0.0);
+    }
+    FragColor = vec4(albedo.rgb * light, albedo.a);
+}
+)";
+
+// Constructor that builds the resolve program
+DeferredRenderer::DeferredRenderer()
+{
+	resolveProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, resolveVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, resolveFragmentSource, "FRAGMENT") });
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(resolveProgram);
+	glUniform1i(glGetUniformLocation(resolveProgram, "gAlbedo"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(resolveProgram, "gNormal"), TEXTURE_UNIT + 1);
+	glUniform1i(glGetUniformLocation(resolveProgram, "gDepth"), TEXTURE_UNIT + 2);
+	// Samplers of different types must not share a unit even while no light is shadowed
+	glUniform1i(glGetUniformLocation(resolveProgram, "lightShadowAtlas"), LightShadows::TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(resolveProgram, "lightShadowTiles"), LightShadows::TEXTURE_UNIT + 1);
+	glUniform1i(glGetUniformLocation(resolveProgram, "clusterDecals"), ClusteredLights::DECAL_UNIT);
+	glUniform1i(glGetUniformLocation(resolveProgram, "decalImages"), DecalLibrary::TEXTURE_UNIT);
+	GLState.UseProgram(previousProgram);
+
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+DeferredRenderer::~DeferredRenderer()
+{
+	Delete();
+}
+
+// Takes over the GL objects of another renderer
+DeferredRenderer::DeferredRenderer(DeferredRenderer&& other) noexcept
+	: reverseDepth(other.reverseDepth), framebuffer(std::exchange(other.framebuffer, 0)), albedo(std::exchange(other.albedo, 0)), normal(std::exchange(other.normal, 0)), depth(std::exchange(other.depth, 0)),
+	width(std::exchange(other.width, 0)), height(std::exchange(other.height, 0)), resolveProgram(std::exchange(other.resolveProgram, 0)), emptyVAO(std::exchange(other.emptyVAO, 0))
+{
+}
+
+// Deletes the current GL objects and takes over the ones of another renderer
+DeferredRenderer& DeferredRenderer::operator=(DeferredRenderer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		reverseDepth = other.reverseDepth;
+		framebuffer = std::exchange(other.framebuffer, 0);
+		albedo = std::exchange(other.albedo, 0);
+		normal = std::exchange(other.normal, 0);
+		depth = std::exchange(other.depth, 0);
+		width = std::exchange(other.width, 0);
+		height = std::exchange(other.height, 0);
+		resolveProgram = std::exchange(other.resolveProgram, 0);
+		emptyVAO = std::exchange(other.emptyVAO, 0);
+	}
+	return *this;
+}
+
+// Binds and clears the G-buffer, reallocating it when the size changed
+void DeferredRenderer::Begin(GLsizei width, GLsizei height)
+{
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	output = (GLuint)previous;
+	if (width != DeferredRenderer::width || height != DeferredRenderer::height || framebuffer == 0)
+		resize(width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, attachments);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	// The normal target is cleared to a zero w, which marks pixels the scene never covered
+	const GLfloat noNormal[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 1, noNormal);
+}
+
+// Stops writing normals
+void DeferredRenderer::DisableNormals()
+{
+	const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_NONE };
+	glDrawBuffers(2, attachments);
+}
+
+// Lights the G-buffer into the framebuffer that was bound at Begin
+void DeferredRenderer::Resolve(const glm::mat4& projection, ClusteredLights* lights, ScreenSpaceOcclusion* occlusion, LightShadows* shadows, DecalLibrary* decals)
+{
+	GLint previousProgram, previousVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	GLState.Disable(GL_DEPTH_TEST);
+	GLState.UseProgram(resolveProgram);
+	glUniformMatrix4fv(glGetUniformLocation(resolveProgram, "inverseProjection"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+	glUniform1i(glGetUniformLocation(resolveProgram, "clustered"), lights ? 1 : 0);
+	glUniform1i(glGetUniformLocation(resolveProgram, "reverseZ"), reverseDepth ? 1 : 0);
+	GLState.CountUniforms(3);
+	if (lights)
+		lights->Apply(resolveProgram);
+	if (lights && shadows)
+		shadows->Apply(resolveProgram);
+	glUniform1i(glGetUniformLocation(resolveProgram, "decaled"), lights && decals ? 1 : 0);
+	if (lights && decals)
+	{
+		decals->Apply(resolveProgram);
+		glUniform1f(glGetUniformLocation(resolveProgram, "pixelFootprint"), 2.0f / ((float)height * projection[1][1]));
+		GLState.CountUniforms(2);
+	}
+	else
+		GLState.CountUniforms(1);
+	if (occlusion)
+		occlusion->Apply(resolveProgram);
+	else
+		glUniform1i(glGetUniformLocation(resolveProgram, "occluded"), 0);
+	const GLuint targets[3] = { albedo, normal, depth };
+	for (GLuint i = 0; i < 3; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, targets[i]);
+	}
+	GLState.BindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+	for (GLuint i = 0; i < 3; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+}
+
+// Reallocates the attachments for a new framebuffer size
+void DeferredRenderer::resize(GLsizei width, GLsizei height)
+{
+	deleteTargets();
+	DeferredRenderer::width = width;
+	DeferredRenderer::height = height;
+
+	// Texels are only ever fetched at their own pixel, never filtered, reverse-Z depth needs a float target
+	const GLenum formats[3][3] = {
+		{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+		{ GL_RGBA16F, GL_RGBA, GL_FLOAT },
+		{ reverseDepth ? (GLenum)GL_DEPTH_COMPONENT32F : (GLenum)GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, reverseDepth ? (GLenum)GL_FLOAT : (GLenum)GL_UNSIGNED_INT }
+	};
+	GLuint* targets[3] = { &albedo, &normal, &depth };
+	for (int i = 0; i < 3; i++)
+	{
+		glGenTextures(1, targets[i]);
+		GLState.BindTexture(GL_TEXTURE_2D, *targets[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, formats[i][0], width, height, 0, formats[i][1], formats[i][2], nullptr);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, *targets[i], GpuMemoryTracker::ImageBytes(formats[i][0], width, height));
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::DEFERRED::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Deletes the attachments and the framebuffer
+void DeferredRenderer::deleteTargets()
+{
+	GLuint targets[] = { albedo, normal, depth };
+	for (GLuint target : targets)
+		if (target != 0)
+			GLState.DeleteTextures(1, &target);
+	albedo = normal = depth = 0;
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = 0;
+	width = height = 0;
+}
+
+// Deletes the GL objects
+void DeferredRenderer::Delete()
+{
+	deleteTargets();
+	if (resolveProgram != 0)
+		GLState.DeleteProgram(resolveProgram);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	resolveProgram = emptyVAO = 0;
+}
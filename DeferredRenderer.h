@@ -0,0 +1,73 @@
+#ifndef DEFERRED_RENDERER_CLASS_H
+#define DEFERRED_RENDERER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+#include"ClusteredLights.h"
+
+class DecalLibrary;
+class LightShadows;
+class ScreenSpaceOcclusion;
+
+// Deferred shading as an alternative to lighting every fragment while it is drawn
+// The scene is drawn once into a G-buffer of albedo, view space normal and depth, using the DEFERRED permutation of the
+// scene programs. Resolve then lights every pixel exactly once with a full screen pass that looks its lights up in the
+// clusters of ClusteredLights, so overdraw costs one texture fetch per layer instead of a loop over lights.
+// Pixels whose normal was never written, the background and the billboards, are copied through unlit.
+class DeferredRenderer
+{
+public:
+	// The G-buffer is bound to this texture unit and the two after it while it is resolved, clear of the facades and the lights
+	static constexpr GLuint TEXTURE_UNIT = 1;
+
+	// Set when the scene is drawn reverse-Z, see ReverseDepth.h, before the first Begin
+	bool reverseDepth = false;
+
+	// Framebuffer the scene is drawn into and its attachments
+	GLuint framebuffer = 0;
+	GLuint albedo = 0;
+	GLuint normal = 0;
+	GLuint depth = 0;
+
+	// Constructor that builds the resolve program, the attachments are made by the first Begin
+	DeferredRenderer();
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~DeferredRenderer();
+	// A DeferredRenderer owns its GL objects, so it can be moved but not copied
+	DeferredRenderer(const DeferredRenderer&) = delete;
+	DeferredRenderer& operator=(const DeferredRenderer&) = delete;
+	DeferredRenderer(DeferredRenderer&& other) noexcept;
+	DeferredRenderer& operator=(DeferredRenderer&& other) noexcept;
+
+	// Binds and clears the G-buffer for a framebuffer of width by height, reallocating it when the size changed
+	// The framebuffer bound before is the one Resolve lights the pixels into
+	// The albedo is cleared to the clear color, the caller then draws the scene with the DEFERRED programs
+	void Begin(GLsizei width, GLsizei height);
+	// Stops writing normals, so what is drawn after it is copied through unlit
+	void DisableNormals();
+	// Lights the G-buffer into the framebuffer bound at Begin, with the clusters of lights or only the albedo if there are none
+	// The ambient light is darkened by occlusion, worked out from this G-buffer, unless it is null, and the lights given
+	// a slot by shadows are shadowed from its atlas. The decals binned with the lights are put on the albedo with the
+	// images of decals, unless it is null
+	// projection is the one the scene was drawn with, the program, VAO and depth test in use are restored afterwards
+	void Resolve(const glm::mat4& projection, ClusteredLights* lights, ScreenSpaceOcclusion* occlusion = nullptr, LightShadows* shadows = nullptr,
+		DecalLibrary* decals = nullptr);
+
+	// Deletes the GL objects, does nothing if they were already deleted or moved from
+	void Delete();
+private:
+	GLsizei width = 0;
+	GLsizei height = 0;
+	// Framebuffer that was bound at Begin
+	GLuint output = 0;
+	GLuint resolveProgram = 0;
+	GLuint emptyVAO = 0;
+
+	// Reallocates the attachments for a new framebuffer size
+	void resize(GLsizei width, GLsizei height);
+	// Deletes the attachments and the framebuffer
+	void deleteTargets();
+};
+
+#endif
@@ -0,0 +1,287 @@
+#include"DepthPyramid.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<utility>
+
+// Full screen triangle whose fragments each reduce a block of the level above into one texel
+static const char* reduceVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+static const char* reduceFragmentSource = R"(
+#version 330 core
+// The depth copy for level 0, otherwise the pyramid limited to the level above
+uniform sampler2D source;
+// 0 copies level 0, 1 reduces 2x2 texels into one
+uniform int reduce;
+// 1 for a reverse-Z depth buffer, where the farthest depth is the smallest
+uniform int reverseZ;
+
+out float Depth;
+
+void main()
+{
+    ivec2 size = textureSize(source, 0);
+    ivec2 base = ivec2(gl_FragCoord.xy) << reduce;
+    // The last texel of an odd sized level also covers the row or column that does not fit into a pair
+    ivec2 extent = reduce == 0 ? ivec2(1) : ivec2(2) + ivec2(equal(base + 3, size));
+    float depth = float(reverseZ);
+    for (int y = 0; y < extent.y; y++)
+        for (int x = 0; x < extent.x; x++)
+        {
+            float texel = texelFetch(source, min(base + ivec2(x, y), size - 1), 0).r;
+            depth = reverseZ != 0 ? min(depth, texel) : max(depth, texel);
+        }
+    Depth = depth;
+}
+)";
+
+const char* const DepthPyramid::TEST_SOURCE = R"(
+uniform sampler2D pyramid;
+// 1 for reverse-Z, clip space depth then runs from 1 at the near plane to 0 at infinity and needs no remapping
+uniform int reverseZ;
+
+// Checks if a box is behind the farthest depth of every pyramid texel its screen rectangle touches
+bool occluded(mat4 matrix, vec3 low, vec3 high)
+{
+    vec2 screenLow = vec2(1.0), screenHigh = vec2(0.0);
+    float nearest = reverseZ != 0 ? 0.0 : 1.0;
+    for (int i = 0; i < 8; i++)
+    {
+        vec4 clip = matrix * vec4(mix(low, high, vec3(i & 1, (i >> 1) & 1, (i >> 2) & 1)), 1.0);
+        // A corner behind the camera could project anywhere
+        if (clip.w <= 0.0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        screenLow = min(screenLow, ndc.xy * 0.5 + 0.5);
+        screenHigh = max(screenHigh, ndc.xy * 0.5 + 0.5);
+        float depth = reverseZ != 0 ? ndc.z : ndc.z * 0.5 + 0.5;
+        nearest = reverseZ != 0 ? max(nearest, depth) : min(nearest, depth);
+    }
+    ivec2 size = textureSize(pyramid, 0);
+    ivec2 pixelLow = min(ivec2(clamp(screenLow, 0.0, 1.0) * vec2(size)), size - 1);
+    ivec2 pixelHigh = min(ivec2(clamp(screenHigh, 0.0, 1.0) * vec2(size)), size - 1);
+    // The level where the rectangle spans at most two texels, texel i of level l covers pixels i << l and up
+    ivec2 extent = pixelHigh - pixelLow;
+    int level = min(findMSB(max(max(extent.x, extent.y), 1)) + 1, textureQueryLevels(pyramid) - 1);
+    // Every level halves the one above rounding down, the same as textureSize at a per invocation level
+    ivec2 levelSize = max(size >> level, ivec2(1));
+    ivec2 texelLow = min(pixelLow >> level, levelSize - 1);
+    ivec2 texelHigh = min(pixelHigh >> level, levelSize - 1);
+    float farthest = float(reverseZ);
+    for (int y = texelLow.y; y <= texelHigh.y; y++)
+        for (int x = texelLow.x; x <= texelHigh.x; x++)
+        {
+            float texel = texelFetch(pyramid, ivec2(x, y), level).r;
+            farthest = reverseZ != 0 ? min(farthest, texel) : max(farthest, texel);
+        }
+    return reverseZ != 0 ? nearest < farthest : nearest > farthest;
+}
+)";
+
+// Constructor that builds the reduction program
+DepthPyramid::DepthPyramid()
+{
+	glGenFramebuffers(1, &framebuffer);
+	glGenVertexArrays(1, &emptyVAO);
+
+	reduceProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, reduceVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, reduceFragmentSource, "FRAGMENT") });
+	GLState.UseProgram(reduceProgram);
+	glUniform1i(glGetUniformLocation(reduceProgram, "source"), TEXTURE_UNIT);
+	GLState.UseProgram(0);
+}
+
+// Deletes the GL objects unless Delete was already called
+DepthPyramid::~DepthPyramid()
+{
+	Delete();
+}
+
+// Takes over the GL objects of another pyramid, which is left empty
+DepthPyramid::DepthPyramid(DepthPyramid&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+// Deletes the current GL objects and takes over the ones of another pyramid
+DepthPyramid& DepthPyramid::operator=(DepthPyramid&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		reverseDepth = other.reverseDepth;
+		depthCopy = std::exchange(other.depthCopy, 0);
+		pyramid = std::exchange(other.pyramid, 0);
+		framebuffer = std::exchange(other.framebuffer, 0);
+		width = std::exchange(other.width, 0);
+		height = std::exchange(other.height, 0);
+		levels = std::exchange(other.levels, 0);
+		reduceProgram = std::exchange(other.reduceProgram, 0);
+		emptyVAO = std::exchange(other.emptyVAO, 0);
+	}
+	return *this;
+}
+
+// Copies the depth and renders every level from the one above it
+bool DepthPyramid::Build(GLsizei width, GLsizei height)
+{
+	if (width <= 0 || height <= 0)
+		return false;
+	if (width != DepthPyramid::width || height != DepthPyramid::height)
+		resize(width, height);
+
+	GLint previousFramebuffer, previousProgram, previousVAO, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	// The pyramid is rendered as color, which a depth only pass may have masked off
+	GLboolean colorMask[4];
+	glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+	// Copies the depth of the framebuffer being drawn, GL 3.3 cannot sample it directly
+	// A multisampled one cannot be copied from, blitting its depth into the copy takes one sample per pixel instead
+	GLint sampleBuffers = 0;
+	glGetIntegerv(GL_SAMPLE_BUFFERS, &sampleBuffers);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	if (sampleBuffers > 0)
+	{
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, 0);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthCopy, 0);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+	}
+	else
+	{
+		GLState.BindTexture(GL_TEXTURE_2D, depthCopy);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+	}
+
+	// Each level is rendered from the one above it, which is the only level the pass may sample
+	GLState.Disable(GL_DEPTH_TEST);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	GLState.UseProgram(reduceProgram);
+	GLState.BindVertexArray(emptyVAO);
+	GLint reduceLoc = glGetUniformLocation(reduceProgram, "reduce");
+	glUniform1i(glGetUniformLocation(reduceProgram, "reverseZ"), reverseDepth ? 1 : 0);
+	GLState.CountUniforms();
+	for (GLsizei level = 0; level < levels; level++)
+	{
+		if (level == 0)
+		{
+			GLState.BindTexture(GL_TEXTURE_2D, depthCopy);
+		}
+		else
+		{
+			GLState.BindTexture(GL_TEXTURE_2D, pyramid);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+		}
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, level);
+		glViewport(0, 0, std::max(1, width >> level), std::max(1, height >> level));
+		glUniform1i(reduceLoc, level == 0 ? 0 : 1);
+		GLState.CountUniforms();
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		GLState.CountDraw(1, 1);
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, pyramid);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLState.BindVertexArray(previousVAO);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+	glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+	GLState.UseProgram(previousProgram);
+	return true;
+}
+
+// Unbinds the pyramid from its unit
+void DepthPyramid::Unbind()
+{
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+}
+
+// Sets the uniforms of TEST_SOURCE
+void DepthPyramid::SetUniforms(GLuint program) const
+{
+	glUniform1i(glGetUniformLocation(program, "pyramid"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "reverseZ"), reverseDepth ? 1 : 0);
+	GLState.CountUniforms(2);
+}
+
+// Reallocates the depth copy and pyramid for a new framebuffer size
+void DepthPyramid::resize(GLsizei width, GLsizei height)
+{
+	DepthPyramid::width = width;
+	DepthPyramid::height = height;
+	levels = 1;
+	while ((width >> levels) > 0 || (height >> levels) > 0)
+		levels++;
+
+	if (depthCopy)
+		GLState.DeleteTextures(1, &depthCopy);
+	if (pyramid)
+		GLState.DeleteTextures(1, &pyramid);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	glGenTextures(1, &depthCopy);
+	GLState.BindTexture(GL_TEXTURE_2D, depthCopy);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	// The copy keeps the format of a reverse-Z float depth buffer, so none of its precision is lost
+	if (reverseDepth)
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, depthCopy, GpuMemoryTracker::ImageBytes(reverseDepth ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24, width, height));
+
+	// Texels are only ever fetched, never filtered
+	glGenTextures(1, &pyramid);
+	GLState.BindTexture(GL_TEXTURE_2D, pyramid);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	for (GLsizei level = 0; level < levels; level++)
+		glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, width >> level), std::max(1, height >> level), 0, GL_RED, GL_FLOAT, nullptr);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, pyramid, GpuMemoryTracker::ImageBytes(GL_R32F, width, height, 1, levels));
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+}
+
+// Deletes the GL objects
+void DepthPyramid::Delete()
+{
+	GLuint textures[] = { depthCopy, pyramid };
+	for (GLuint texture : textures)
+		if (texture != 0)
+			GLState.DeleteTextures(1, &texture);
+	depthCopy = pyramid = 0;
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	framebuffer = emptyVAO = 0;
+	if (reduceProgram != 0)
+		GLState.DeleteProgram(reduceProgram);
+	reduceProgram = 0;
+	width = height = levels = 0;
+}
@@ -0,0 +1,57 @@
+#ifndef DEPTH_PYRAMID_CLASS_H
+#define DEPTH_PYRAMID_CLASS_H
+
+#include<glad/glad.h>
+
+// Hierarchical depth buffer that GPU culling tests boxes against, every texel holds the farthest depth below it
+// Build copies the depth of the framebuffer being drawn and reduces it level by level with a full screen triangle.
+// Compute shaders that test against it include TEST_SOURCE and sample the pyramid on TEXTURE_UNIT.
+class DepthPyramid
+{
+public:
+	// Texture unit the pyramid is bound to while it is built and tested, so the scene's bindings stay untouched
+	static constexpr GLuint TEXTURE_UNIT = 7;
+	// GLSL declaring the pyramid and reverseZ uniforms and bool occluded(mat4 matrix, vec3 low, vec3 high), which
+	// checks if a box taken to clip space by matrix is behind the farthest depth of every texel it covers
+	static const char* const TEST_SOURCE;
+
+	// Set when the depth buffer is reverse-Z, see ReverseDepth.h, before the first Build
+	bool reverseDepth = false;
+
+	// Constructor that builds the reduction program, the textures are allocated by the first Build
+	DepthPyramid();
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~DepthPyramid();
+	// A DepthPyramid owns its GL objects, so it can be moved but not copied
+	DepthPyramid(const DepthPyramid&) = delete;
+	DepthPyramid& operator=(const DepthPyramid&) = delete;
+	DepthPyramid(DepthPyramid&& other) noexcept;
+	DepthPyramid& operator=(DepthPyramid&& other) noexcept;
+
+	// Reduces the depth of the current framebuffer, which is width by height, and leaves the pyramid bound to
+	// TEXTURE_UNIT, every other binding and state it touches is put back; false for an empty framebuffer
+	bool Build(GLsizei width, GLsizei height);
+	// Unbinds the pyramid from TEXTURE_UNIT once the tests are done
+	void Unbind();
+	// Sets the uniforms of TEST_SOURCE in a program that is in use
+	void SetUniforms(GLuint program) const;
+
+	// Deletes the GL objects, does nothing if they were already deleted or moved from
+	void Delete();
+private:
+	// Copy of the depth buffer and the pyramid reduced from it, with the framebuffer that renders the levels
+	GLuint depthCopy = 0;
+	GLuint pyramid = 0;
+	GLuint framebuffer = 0;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	GLsizei levels = 0;
+	// Reduction program and the empty VAO its full screen triangle is drawn with
+	GLuint reduceProgram = 0;
+	GLuint emptyVAO = 0;
+
+	// Reallocates the depth copy and pyramid for a new framebuffer size
+	void resize(GLsizei width, GLsizei height);
+};
+
+#endif
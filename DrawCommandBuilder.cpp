@@ -0,0 +1,106 @@
+#include"DrawCommandBuilder.h"
+#include"GLStateCache.h"
+
+#include<cstring>
+#include<cstdint>
+
+// Constructor that takes the vertex layout shared by every mesh
+DrawCommandBuilder::DrawCommandBuilder(unsigned int vertexFloats)
+{
+	DrawCommandBuilder::vertexFloats = vertexFloats;
+}
+
+// Appends a mesh to the arena and returns its index
+unsigned int DrawCommandBuilder::AddMesh(const GLfloat* meshVertices, size_t vertexCount, const GLuint* meshIndices, size_t indexCount)
+{
+	Mesh mesh;
+	mesh.firstIndex = (GLuint)indices.size();
+	mesh.indexCount = (GLuint)indexCount;
+	mesh.baseVertex = (GLint)(vertices.size() / vertexFloats);
+	mesh.vertexCount = (GLuint)vertexCount;
+	vertices.insert(vertices.end(), meshVertices, meshVertices + vertexCount * vertexFloats);
+	indices.insert(indices.end(), meshIndices, meshIndices + indexCount);
+	meshes.push_back(mesh);
+	return (unsigned int)meshes.size() - 1;
+}
+
+// Removes every command
+void DrawCommandBuilder::Clear()
+{
+	commands.clear();
+}
+
+// Draws instanceCount instances of a mesh using the instance records starting at baseInstance
+void DrawCommandBuilder::Add(unsigned int mesh, GLuint instanceCount, GLuint baseInstance)
+{
+	Add(meshes[mesh], instanceCount, baseInstance);
+}
+
+// Same for a mesh placed somewhere else
+void DrawCommandBuilder::Add(const Mesh& mesh, GLuint instanceCount, GLuint baseInstance)
+{
+	if (instanceCount == 0)
+		return;
+	DrawElementsIndirectCommand command;
+	command.count = mesh.indexCount;
+	command.instanceCount = instanceCount * views;
+	command.firstIndex = mesh.firstIndex;
+	command.baseVertex = mesh.baseVertex;
+	command.baseInstance = baseInstance;
+	commands.push_back(command);
+}
+
+// Draws every command with the arena VAO bound
+void DrawCommandBuilder::Draw(StreamBuffer* indirectBuffer, const std::function<void(GLuint baseInstance)>& bindInstances, GLenum indexType) const
+{
+	if (commands.empty())
+		return;
+
+	if (indirectBuffer)
+	{
+		// The base instance of each command offsets the instanced attributes, so they only get pointed at the start once
+		// Array commands are the same without the base vertex, rewritten in their own shorter layout
+		GLsizeiptr bytes = commands.size() * (arrays ? sizeof(DrawArraysIndirectCommand) : sizeof(DrawElementsIndirectCommand));
+		void* mapped = indirectBuffer->Map();
+		if (arrays)
+		{
+			DrawArraysIndirectCommand* out = (DrawArraysIndirectCommand*)mapped;
+			for (const DrawElementsIndirectCommand& command : commands)
+				*out++ = { command.count, command.instanceCount, command.firstIndex, command.baseInstance };
+		}
+		else
+			memcpy(mapped, commands.data(), bytes);
+		indirectBuffer->Unmap(bytes);
+		bindInstances(0);
+		indirectBuffer->Bind();
+		if (arrays)
+			glMultiDrawArraysIndirect(GL_TRIANGLES, (void*)(intptr_t)indirectBuffer->Offset(), (GLsizei)commands.size(), 0);
+		else
+			glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)(intptr_t)indirectBuffer->Offset(), (GLsizei)commands.size(), 0);
+		size_t instances = 0, triangles = 0;
+		for (const DrawElementsIndirectCommand& command : commands)
+		{
+			instances += command.instanceCount;
+			triangles += (size_t)command.count / 3 * command.instanceCount;
+		}
+		GLState.CountDraw(instances, triangles);
+		indirectBuffer->Unbind();
+		indirectBuffer->Fence();
+		return;
+	}
+
+	// GL 3.3 has base vertices but no base instances, so the attributes move to each command's records instead
+	GLsizeiptr indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+	for (const DrawElementsIndirectCommand& command : commands)
+	{
+		bindInstances(command.baseInstance);
+		if (arrays)
+		{
+			glDrawArraysInstanced(GL_TRIANGLES, (GLint)command.firstIndex, command.count, command.instanceCount);
+			GLState.CountDraw(command.instanceCount, (size_t)command.count / 3 * command.instanceCount);
+			continue;
+		}
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, indexType, (void*)(command.firstIndex * indexSize), command.instanceCount, command.baseVertex);
+		GLState.CountDraw(command.instanceCount, (size_t)command.count / 3 * command.instanceCount);
+	}
+}
@@ -0,0 +1,76 @@
+#ifndef DRAW_COMMAND_BUILDER_CLASS_H
+#define DRAW_COMMAND_BUILDER_CLASS_H
+
+#include<glad/glad.h>
+#include<functional>
+#include<vector>
+
+#include"StreamBuffer.h"
+
+// Layout of one command in a GL_DRAW_INDIRECT_BUFFER, fixed by the GL specification
+struct DrawElementsIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+// Same for glDrawArraysIndirect, which draws no index buffer
+struct DrawArraysIndirectCommand
+{
+	GLuint count;
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance;
+};
+
+// Packs every mesh of a vertex format into one shared vertex and index arena and turns
+// per-frame draw requests into indirect commands that are submitted with a single call
+class DrawCommandBuilder
+{
+public:
+	// Where a mesh lives inside the arena
+	struct Mesh
+	{
+		GLuint firstIndex;
+		GLuint indexCount;
+		GLint baseVertex;
+		GLuint vertexCount;
+	};
+
+	// Number of floats per vertex, every mesh in the arena shares it
+	unsigned int vertexFloats;
+	// Vertices and indices of every mesh, indices stay relative to their own mesh
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	// Meshes in the order they were added
+	std::vector<Mesh> meshes;
+	// Commands built since the last Clear
+	std::vector<DrawElementsIndirectCommand> commands;
+	// Instances drawn per record, 2 when every record is drawn once for each eye by a VAO with a divisor of 2
+	GLuint views = 1;
+	// Whether the commands draw without an index buffer, each one the indexCount vertices from firstIndex of its mesh,
+	// such as the meshlets of GpuMeshCodec whose vertex IDs are their corners
+	bool arrays = false;
+
+	// Constructor that takes the vertex layout shared by every mesh
+	DrawCommandBuilder(unsigned int vertexFloats);
+
+	// Appends a mesh to the arena and returns its index for Add
+	unsigned int AddMesh(const GLfloat* meshVertices, size_t vertexCount, const GLuint* meshIndices, size_t indexCount);
+	// Removes every command, the meshes stay
+	void Clear();
+	// Draws instanceCount instances of a mesh using the instance records starting at baseInstance
+	void Add(unsigned int mesh, GLuint instanceCount, GLuint baseInstance);
+	// Same for a mesh placed somewhere else, such as a GpuBufferHeap
+	void Add(const Mesh& mesh, GLuint instanceCount, GLuint baseInstance);
+	// Draws every command with the arena VAO bound. With multi draw indirect the commands are written into
+	// indirectBuffer and drawn with one call, without it (indirectBuffer null) they are drawn one by one and
+	// bindInstances is asked to point the instance attributes at each command's first instance record
+	// indexType is the type of the bound index buffer, GL_UNSIGNED_INT for the arena, GpuBufferHeap::indexType for a heap,
+	// and is ignored with arrays
+	void Draw(StreamBuffer* indirectBuffer, const std::function<void(GLuint baseInstance)>& bindInstances, GLenum indexType = GL_UNSIGNED_INT) const;
+};
+
+#endif
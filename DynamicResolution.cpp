@@ -0,0 +1,237 @@
+#include"DynamicResolution.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<cmath>
+#include<iostream>
+
+// Full screen triangle over the viewport of the output
+static const char* upscaleVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+static const char* upscaleFragmentSource = R"(
+#version 330 core
+uniform sampler2D scene;
+// Origin and size of the output viewport in pixels
+uniform vec4 viewport;
+// 0 when bilinear filtering is all there is
+uniform float sharpness;
+
+out vec4 FragColor;
+
+void main()
+{
+    vec2 uv = (gl_FragCoord.xy - viewport.xy) / viewport.zw;
+    vec4 center = texture(scene, uv);
+    if (sharpness <= 0.0)
+    {
+        FragColor = center;
+        return;
+    }
+    // The neighbours one scene texel away, whatever the center differs from them by is made stronger
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec4 left = texture(scene, uv - vec2(texel.x, 0.0));
+    vec4 right = texture(scene, uv + vec2(texel.x, 0.0));
+    vec4 down = texture(scene, uv - vec2(0.0, texel.y));
+    vec4 up = texture(scene, uv + vec2(0.0, texel.y));
+    vec4 sharpened = center + sharpness * (4.0 * center - left - right - down - up) * 0.25;
+    vec4 low = min(center, min(min(left, right), min(down, up)));
+    vec4 high = max(center, max(max(left, right), max(down, up)));
+    FragColor = clamp(sharpened, low, high);
+}
+)";
+
+// Constructor that builds the upscale program
+DynamicResolution::DynamicResolution(float targetMilliseconds)
+	: targetMilliseconds(targetMilliseconds)
+{
+	upscaleProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, upscaleVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, upscaleFragmentSource, "FRAGMENT") });
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(upscaleProgram);
+	glUniform1i(glGetUniformLocation(upscaleProgram, "scene"), TEXTURE_UNIT);
+	GLState.UseProgram(previousProgram);
+
+	glGenVertexArrays(1, &emptyVAO);
+	glGenQueries(LATENCY * 2, &queries[0][0]);
+}
+
+// Deletes the GL objects unless Delete was already called
+DynamicResolution::~DynamicResolution()
+{
+	Delete();
+}
+
+// Adjusts the scale and binds the target of the scene
+void DynamicResolution::Begin(GLsizei outputWidth, GLsizei outputHeight)
+{
+	// The queries of this slot were issued LATENCY frames ago
+	if (pending[slot])
+	{
+		GLint available = 0;
+		glGetQueryObjectiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available)
+		{
+			GLuint64 start, end;
+			glGetQueryObjectui64v(queries[slot][0], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(queries[slot][1], GL_QUERY_RESULT, &end);
+			adjust((float)((end - start) / 1.0e6));
+		}
+		pending[slot] = false;
+	}
+
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	output = (GLuint)previous;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	width = std::max(1, (GLsizei)std::lround(outputWidth * currentScale));
+	height = std::max(1, (GLsizei)std::lround(outputHeight * currentScale));
+	if (width != targetWidth || height != targetHeight || framebuffer == 0)
+		resize(width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+	glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+}
+
+// Stops timing and scales the scene up into the output
+void DynamicResolution::End()
+{
+	glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+	pending[slot] = true;
+	slot = (slot + 1) % LATENCY;
+
+	// At full size there is nothing to filter, the scene is copied as it is
+	if (width == viewport[2] && height == viewport[3])
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output);
+		glBlitFramebuffer(0, 0, width, height, viewport[0], viewport[1], viewport[0] + width, viewport[1] + height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, output);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		return;
+	}
+
+	GLint previousProgram, previousVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLState.Disable(GL_DEPTH_TEST);
+	GLState.UseProgram(upscaleProgram);
+	glUniform4f(glGetUniformLocation(upscaleProgram, "viewport"), (float)viewport[0], (float)viewport[1], (float)viewport[2], (float)viewport[3]);
+	glUniform1f(glGetUniformLocation(upscaleProgram, "sharpness"), filter == SHARPEN ? sharpness : 0.0f);
+	GLState.CountUniforms(2);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, color);
+	GLState.BindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+}
+
+// Scale of each side of the scene this frame
+float DynamicResolution::scale() const
+{
+	return currentScale;
+}
+
+// Moves the scale towards the target time
+void DynamicResolution::adjust(float milliseconds)
+{
+	// Frames still in flight when the scale changed were drawn at the old one and say nothing about the new
+	if (settling > 0)
+	{
+		settling--;
+		return;
+	}
+	averageMilliseconds = averageMilliseconds <= 0.0f ? milliseconds : averageMilliseconds + 0.2f * (milliseconds - averageMilliseconds);
+	if (averageMilliseconds <= 0.0f || targetMilliseconds <= 0.0f)
+		return;
+	// The time goes with the pixel count, so each side goes with the square root of the time
+	float wanted = std::clamp(currentScale * std::sqrt(targetMilliseconds / averageMilliseconds), minScale, maxScale);
+	if (std::abs(wanted - currentScale) < STEP)
+		return;
+	float stepped = std::clamp(std::round(wanted / STEP) * STEP, minScale, maxScale);
+	// The average is scaled along, so it does not pull the scale on while the new times come in
+	averageMilliseconds *= (stepped * stepped) / (currentScale * currentScale);
+	currentScale = stepped;
+	settling = LATENCY;
+}
+
+// Reallocates the target for a new size
+void DynamicResolution::resize(GLsizei width, GLsizei height)
+{
+	deleteTarget();
+	targetWidth = width;
+	targetHeight = height;
+
+	// Filtered linearly, so the upscale samples between texels
+	glGenTextures(1, &color);
+	GLState.BindTexture(GL_TEXTURE_2D, color);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, color, GpuMemoryTracker::ImageBytes(GL_RGBA8, width, height));
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, depth, GpuMemoryTracker::ImageBytes(GL_DEPTH_COMPONENT24, width, height));
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::DYNAMIC_RESOLUTION::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Deletes the color, depth and framebuffer of the target
+void DynamicResolution::deleteTarget()
+{
+	if (color != 0)
+		GLState.DeleteTextures(1, &color);
+	GpuMemory.Untrack(GL_RENDERBUFFER, depth);
+	if (depth != 0)
+		glDeleteRenderbuffers(1, &depth);
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	color = depth = framebuffer = 0;
+}
+
+// Deletes the GL objects
+void DynamicResolution::Delete()
+{
+	deleteTarget();
+	if (queries[0][0] != 0)
+		glDeleteQueries(LATENCY * 2, &queries[0][0]);
+	queries[0][0] = 0;
+	if (upscaleProgram != 0)
+		GLState.DeleteProgram(upscaleProgram);
+	upscaleProgram = 0;
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	emptyVAO = 0;
+}
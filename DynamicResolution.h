@@ -0,0 +1,91 @@
+#ifndef DYNAMIC_RESOLUTION_CLASS_H
+#define DYNAMIC_RESOLUTION_CLASS_H
+
+#include<glad/glad.h>
+
+// Draws the scene into a target smaller than the output and scales it up, so the GPU time of the scene holds a target.
+// Begin binds a target of the output size times scale, End times the passes drawn into it with timestamp queries and
+// upscales it into the framebuffer that was bound before. The scale follows the times LATENCY frames later, assuming
+// they go with the pixel count, and moves in steps of STEP so the targets sized from it are not reallocated every frame.
+class DynamicResolution
+{
+public:
+	// Frames between issuing the timestamps and reading them, by then they are ready and reading them never stalls
+	static constexpr int LATENCY = 3;
+	// Smallest change of the scale
+	static constexpr float STEP = 0.05f;
+	// The scene is bound to this texture unit while it is upscaled, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 10;
+
+	// How the scene is scaled up, a temporal filter reading the previous output with a jittered projection would be added here
+	enum Filter
+	{
+		BILINEAR,
+		// Bilinear then sharpened by sharpness, limited to the neighbouring texels so edges do not ring
+		SHARPEN
+	};
+
+	// GPU time in milliseconds the scene should take
+	float targetMilliseconds;
+	// Range the scale of each side is kept in
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	Filter filter = SHARPEN;
+	// From 0 for none to 1
+	float sharpness = 0.5f;
+
+	// Size of the scene this frame, set by Begin
+	GLsizei width = 0;
+	GLsizei height = 0;
+
+	// Constructor that builds the upscale program, the target is made by the first Begin
+	DynamicResolution(float targetMilliseconds);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~DynamicResolution();
+	// A DynamicResolution owns its GL objects, so it cannot be copied
+	DynamicResolution(const DynamicResolution&) = delete;
+	DynamicResolution& operator=(const DynamicResolution&) = delete;
+
+	// Adjusts the scale from the times that are ready, then binds the target of the scene for an output of
+	// outputWidth by outputHeight, reallocated when its size changed, and starts timing
+	void Begin(GLsizei outputWidth, GLsizei outputHeight);
+	// Stops timing and scales the scene up into the framebuffer and viewport that were bound at Begin
+	void End();
+	// Scale of each side of the scene this frame
+	float scale() const;
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	// Color of the scene, a texture so it is filtered while scaled up, and its depth
+	GLuint framebuffer = 0;
+	GLuint color = 0;
+	GLuint depth = 0;
+	GLsizei targetWidth = 0;
+	GLsizei targetHeight = 0;
+	// Framebuffer and viewport the target replaced
+	GLuint output = 0;
+	GLint viewport[4] = {};
+
+	float currentScale = 1.0f;
+	// Scene time averaged over the last frames
+	float averageMilliseconds = 0.0f;
+	// Frames left whose times were measured at a scale that changed since
+	int settling = 0;
+	// Begin and end timestamps of the last LATENCY frames
+	GLuint queries[LATENCY][2] = {};
+	bool pending[LATENCY] = {};
+	int slot = 0;
+
+	GLuint upscaleProgram = 0;
+	GLuint emptyVAO = 0;
+
+	// Moves the scale towards the target time after a frame took milliseconds
+	void adjust(float milliseconds);
+	// Reallocates the target for a new size
+	void resize(GLsizei width, GLsizei height);
+	// Deletes the color, depth and framebuffer of the target
+	void deleteTarget();
+};
+
+#endif
@@ -1,27 +1,101 @@
 #include"EBO.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLDebugOutput.h"
+
+#include<algorithm>
+#include<vector>
 
 // Constructor that generates a Elements Buffer Object and links it to indices
-EBO::EBO(GLuint* indices, GLsizeiptr size)
+EBO::EBO(const GLuint* indices, GLsizeiptr size)
+{
+	size_t count = (size_t)size / sizeof(GLuint);
+	GLuint largest = count > 0 ? *std::max_element(indices, indices + count) : 0;
+	type = IndexType((size_t)largest + 1);
+
+	std::vector<GLushort> narrow;
+	const void* data = indices;
+	if (type == GL_UNSIGNED_SHORT)
+	{
+		narrow.assign(indices, indices + count);
+		data = narrow.data();
+	}
+	GLsizeiptr bytes = (GLsizeiptr)(count * IndexSize(type));
+	// Indices never change, so the storage is immutable and takes no flags
+	if (GLExt.directStateAccess)
+	{
+		glCreateBuffers(1, &ID);
+		glNamedBufferStorage(ID, bytes, data, 0);
+	}
+	else
+	{
+		glGenBuffers(1, &ID);
+		GLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+	}
+	GpuMemory.Track(GPU_MEMORY_GEOMETRY, GL_BUFFER, ID, (int64_t)bytes);
+}
+
+// Index type for a mesh of vertexCount vertices
+GLenum EBO::IndexType(size_t vertexCount)
+{
+	return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+// Size in bytes of one index of a type
+GLsizeiptr EBO::IndexSize(GLenum type)
+{
+	return type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : type == GL_UNSIGNED_BYTE ? sizeof(GLubyte) : sizeof(GLuint);
+}
+
+// Deletes the buffer unless Delete was already called
+EBO::~EBO()
 {
-	glGenBuffers(1, &ID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
+	Delete();
+}
+
+// Takes over the buffer of another EBO, which is left empty
+EBO::EBO(EBO&& other) noexcept
+	: ID(other.ID)
+{
+	other.ID = 0;
+}
+
+// Deletes the current buffer and takes over the one of another EBO
+EBO& EBO::operator=(EBO&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
+}
+
+// Names the buffer in GPU captures and debug messages
+void EBO::Label(const char* name)
+{
+	GLDebug.Label(GL_BUFFER, ID, name);
 }
 
 // Binds the EBO
 void EBO::Bind()
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+	GLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
 }
 
 // Unbinds the EBO
 void EBO::Unbind()
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	GLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 // Deletes the EBO
 void EBO::Delete()
 {
-	glDeleteBuffers(1, &ID);
-}
\ No newline at end of file
+	if (ID != 0)
+		GLState.DeleteBuffers(1, &ID);
+	ID = 0;
+}
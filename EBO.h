@@ -2,20 +2,38 @@
 #define EBO_CLASS_H
 
 #include<glad/glad.h>
+#include<cstddef>
 
 class EBO
 {
 public:
 	// ID reference of Elements Buffer Object
-	GLuint ID;
-	// Constructor that generates a Elements Buffer Object and links it to indices
-	EBO(GLuint* indices, GLsizeiptr size);
+	GLuint ID = 0;
+	// GL_UNSIGNED_SHORT when every index fits 16 bits, otherwise GL_UNSIGNED_INT, pass it to glDrawElements
+	GLenum type = GL_UNSIGNED_INT;
+	// Constructor that generates a Elements Buffer Object and links it to indices, size is in bytes of GLuint
+	// Indices below 65536 are stored as 16 bit, which halves the buffer and the index fetch of every draw
+	EBO(const GLuint* indices, GLsizeiptr size);
 
+	// Index type for a mesh of vertexCount vertices whose indices are relative to its first vertex
+	static GLenum IndexType(size_t vertexCount);
+	// Size in bytes of one index of a type, to turn first indices into buffer offsets
+	static GLsizeiptr IndexSize(GLenum type);
+	// Deletes the buffer unless Delete was already called, the context has to still be current
+	~EBO();
+	// A EBO owns its GL object, so it can be moved but not copied
+	EBO(const EBO&) = delete;
+	EBO& operator=(const EBO&) = delete;
+	EBO(EBO&& other) noexcept;
+	EBO& operator=(EBO&& other) noexcept;
+
+	// Names the buffer in GPU captures and debug messages
+	void Label(const char* name);
 	// Binds the EBO
 	void Bind();
 	// Unbinds the EBO
 	void Unbind();
-	// Deletes the EBO
+	// Deletes the EBO, does nothing if it was already deleted or moved from
 	void Delete();
 };
 
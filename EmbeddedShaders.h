@@ -0,0 +1,197 @@
+// Generated from the shader files next to it by the pre-build step of OpenGL.vcxproj, edit those instead
+#ifndef EMBEDDED_SHADERS_H
+#define EMBEDDED_SHADERS_H
+
+// Source of a shader file built into the executable, found by its file name
+struct EmbeddedShader
+{
+	const char* name;
+	const char* source;
+};
+
+constexpr EmbeddedShader embeddedShaders[] =
+{
+	{ "default.frag", R"glsl(#version 330 core
+
+// Specialized by Shader::Specialize, LIGHTING, TEXTURE and SPECULAR are defined for the features the program has
+// Strengths of the ambient and specular terms, a permutation can define its own before this point
+#ifndef AMBIENT_STRENGTH
+#define AMBIENT_STRENGTH 0.20f
+#endif
+#ifndef SPECULAR_STRENGTH
+#define SPECULAR_STRENGTH 0.50f
+#endif
+
+// Outputs colors in RGBA
+out vec4 FragColor;
+
+
+// Imports the color from the Vertex Shader
+in vec3 color;
+// Imports the texture coordinates from the Vertex Shader
+in vec2 texCoord;
+// Imports the normal from the Vertex Shader
+in vec3 Normal;
+// Imports the current position from the Vertex Shader
+in vec3 crntPos;
+
+// Gets the Texture Unit from the main function
+uniform sampler2D tex0;
+// Gets the camera and light from the main function
+#include "frame_data.glsl"
+
+void main()
+{
+#ifdef TEXTURE
+	vec4 baseColor = texture(tex0, texCoord);
+#else
+	vec4 baseColor = vec4(color, 1.0f);
+#endif
+
+#ifdef LIGHTING
+	// ambient lighting
+	float ambient = AMBIENT_STRENGTH;
+
+	// diffuse lighting
+	vec3 normal = normalize(Normal);
+	vec3 lightDirection = normalize(lightPos.xyz - crntPos);
+	float diffuse = max(dot(normal, lightDirection), 0.0f);
+
+	float light = diffuse + ambient;
+#ifdef SPECULAR
+	// specular lighting
+	vec3 viewDirection = normalize(camPos.xyz - crntPos);
+	vec3 reflectionDirection = reflect(-lightDirection, normal);
+	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 8);
+	light += specAmount * SPECULAR_STRENGTH;
+#endif
+
+	// outputs final color
+	FragColor = baseColor * lightColor * light;
+#else
+	FragColor = baseColor;
+#endif
+})glsl" },
+	{ "default.vert", R"glsl(#version 330 core
+
+// Positions/Coordinates
+layout (location = 0) in vec3 aPos;
+// Colors
+layout (location = 1) in vec3 aColor;
+// Texture Coordinates
+layout (location = 2) in vec2 aTex;
+// Normals (not necessarily normalized)
+layout (location = 3) in vec3 aNormal;
+
+
+// Outputs the color for the Fragment Shader
+out vec3 color;
+// Outputs the texture coordinates to the Fragment Shader
+out vec2 texCoord;
+// Outputs the normal for the Fragment Shader
+out vec3 Normal;
+// Outputs the current position for the Fragment Shader
+out vec3 crntPos;
+
+#include "frame_data.glsl"
+// Imports the model matrix from the main function
+uniform mat4 model;
+
+
+void main()
+{
+	// calculates current position
+	crntPos = vec3(model * vec4(aPos, 1.0f));
+	// Outputs the positions/coordinates of all vertices
+	gl_Position = camMatrix * vec4(crntPos, 1.0);
+
+	// Assigns the colors from the Vertex Data to "color"
+	color = aColor;
+	// Assigns the texture coordinates from the Vertex Data to "texCoord"
+	texCoord = aTex;
+	// Assigns the normal from the Vertex Data to "Normal"
+	Normal = aNormal;
+})glsl" },
+	{ "frame_data.glsl", R"glsl(// Per frame values shared by every program, laid out like FrameData.h
+layout (std140) uniform FrameData
+{
+	mat4 camMatrix;
+	mat4 view;
+	mat4 projection;
+	vec4 camPos;
+	vec4 lightPos;
+	vec4 lightColor;
+	mat4 sceneModel;
+	vec4 fogColor;
+	vec4 fogParams;
+	vec4 weather;
+	vec4 particleParams;
+	mat4 eyeMatrices[2];
+	vec4 sunDirection;
+	vec4 sunColor;
+};
+
+// Height fog over a color seen along a ray from the camera in world space, the density is averaged along the ray
+// since it falls off exponentially with height
+vec3 heightFog(vec3 color, vec3 ray)
+{
+	float rise = fogParams.x * ray.y;
+	float density = fogColor.w * exp(-fogParams.x * (camPos.y - fogParams.y)) * (abs(rise) > 1e-4 ? (1.0 - exp(-rise)) / rise : 1.0);
+	return mix(fogColor.rgb, color, exp(-density * length(ray)));
+}
+)glsl" },
+	{ "light.frag", R"glsl(#version 330 core
+
+out vec4 FragColor;
+
+#ifdef LIGHT_MARKERS
+in vec3 markerColor;
+#endif
+#include "frame_data.glsl"
+
+void main()
+{
+#ifdef LIGHT_MARKERS
+	FragColor = vec4(markerColor, 1.0f);
+#else
+	FragColor = lightColor;
+#endif
+})glsl" },
+	{ "light.vert", R"glsl(#version 330 core
+
+#ifdef LIGHT_MARKERS
+// Lights in view written by ClusteredLights, two texels each: view space position and radius, then color
+uniform samplerBuffer clusterLights;
+// Half the side of a marker in world units, and the fewest pixels of framebuffer height it has to cover to be drawn
+uniform float markerSize;
+uniform float minPixels;
+uniform float viewportHeight;
+
+out vec3 markerColor;
+#else
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+#endif
+#include "frame_data.glsl"
+
+void main()
+{
+#ifdef LIGHT_MARKERS
+	// Corners of a cube as one triangle strip of 14 vertices, no vertex buffer needed
+	vec3 corner = vec3((0x287A >> gl_VertexID) & 1, (0x02AF >> gl_VertexID) & 1, (0x31E3 >> gl_VertexID) & 1) * 2.0f - 1.0f;
+	vec4 light = texelFetch(clusterLights, gl_InstanceID * 2);
+	markerColor = texelFetch(clusterLights, gl_InstanceID * 2 + 1).rgb;
+	// Markers too small to see collapse outside the clip volume and rasterize nothing
+	float pixels = markerSize * projection[1][1] * viewportHeight / max(-light.z, 1e-4f);
+	if (pixels < minPixels)
+		gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+	else
+		gl_Position = projection * vec4(light.xyz + corner * markerSize, 1.0f);
+#else
+	gl_Position = camMatrix * model * vec4(aPos, 1.0f);
+#endif
+})glsl" },
+};
+
+#endif
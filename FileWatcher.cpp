@@ -0,0 +1,104 @@
+#include"FileWatcher.h"
+
+#include<chrono>
+
+// Constructor that starts the thread
+FileWatcher::FileWatcher(unsigned int intervalMs)
+{
+	FileWatcher::intervalMs = intervalMs;
+	thread = std::thread(&FileWatcher::watch, this);
+}
+
+// Stops the thread unless Delete was already called
+FileWatcher::~FileWatcher()
+{
+	Delete();
+}
+
+// Starts watching a file
+size_t FileWatcher::Watch(const std::string& path)
+{
+	// Read before taking the lock, so the watch that counts as unchanged is the one at this moment
+	std::filesystem::file_time_type time = modified(path);
+	std::lock_guard<std::mutex> lock(mutex);
+	File file;
+	file.path = path;
+	file.reported = file.seen = time;
+	files.push_back(file);
+	return files.size() - 1;
+}
+
+// Indices of the files that changed since the last call
+std::vector<size_t> FileWatcher::Changed()
+{
+	std::vector<size_t> changed;
+	std::lock_guard<std::mutex> lock(mutex);
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (files[i].changed)
+		{
+			changed.push_back(i);
+			files[i].changed = false;
+		}
+	}
+	return changed;
+}
+
+// Path of a watched file
+std::string FileWatcher::path(size_t file)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return files[file].path;
+}
+
+// Loop of the thread
+void FileWatcher::watch()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopRequested.wait_for(lock, std::chrono::milliseconds(intervalMs), [this] { return stopping; }))
+	{
+		// The files are looked at without the lock, Watch may add more meanwhile
+		std::vector<std::string> paths;
+		for (const File& file : files)
+			paths.push_back(file.path);
+		lock.unlock();
+		std::vector<std::filesystem::file_time_type> times;
+		for (const std::string& path : paths)
+			times.push_back(modified(path));
+		lock.lock();
+
+		for (size_t i = 0; i < times.size(); i++)
+		{
+			File& file = files[i];
+			// A missing file keeps its old time, an editor may be replacing it
+			if (times[i] == std::filesystem::file_time_type::min())
+				continue;
+			if (times[i] == file.seen && times[i] != file.reported)
+			{
+				file.reported = times[i];
+				file.changed = true;
+			}
+			file.seen = times[i];
+		}
+	}
+}
+
+// Modification time of a file
+std::filesystem::file_time_type FileWatcher::modified(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::file_time_type time = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type::min() : time;
+}
+
+// Stops the thread
+void FileWatcher::Delete()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	stopRequested.notify_all();
+	if (thread.joinable())
+		thread.join();
+}
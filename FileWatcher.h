@@ -0,0 +1,59 @@
+#ifndef FILE_WATCHER_CLASS_H
+#define FILE_WATCHER_CLASS_H
+
+#include<condition_variable>
+#include<filesystem>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+// Watches files for changes on a thread of its own, which compares their modification times a few times a second
+// Polling works the same on every platform and file system, and an editor that saves by replacing the file is seen
+// like one that writes it in place. A change is reported once the time has stayed the same for a whole interval,
+// so a file is not picked up while it is still being written
+class FileWatcher
+{
+public:
+	// Constructor that starts the thread, which looks at the files every intervalMs milliseconds
+	FileWatcher(unsigned int intervalMs = 250);
+	// Stops the thread unless Delete was already called
+	~FileWatcher();
+	// The thread points back at the watcher, so it can be neither copied nor moved
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Starts watching a file, returns the index Changed reports it by, a file that does not exist yet counts once it appears
+	size_t Watch(const std::string& path);
+	// Indices of the files that changed since the last call, each at most once
+	std::vector<size_t> Changed();
+	// Path of a watched file
+	std::string path(size_t file);
+
+	// Stops the thread, does nothing if it was already stopped
+	void Delete();
+private:
+	// One watched file, the time it was last reported with and the time seen by the last look
+	struct File
+	{
+		std::string path;
+		std::filesystem::file_time_type reported;
+		std::filesystem::file_time_type seen;
+		bool changed = false;
+	};
+
+	std::vector<File> files;
+	std::mutex mutex;
+	// Wakes the thread early when it has to stop
+	std::condition_variable stopRequested;
+	bool stopping = false;
+	unsigned int intervalMs;
+	std::thread thread;
+
+	// Loop of the thread
+	void watch();
+	// Modification time of a file, the minimum time if it does not exist
+	static std::filesystem::file_time_type modified(const std::string& path);
+};
+
+#endif
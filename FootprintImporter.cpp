@@ -0,0 +1,990 @@
+#include"FootprintImporter.h"
+#include"JsonValue.h"
+#include"MappedFile.h"
+#include"TileStreamer.h"
+
+#include<stb/stb_image.h>
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cctype>
+#include<cstdlib>
+#include<cstring>
+#include<filesystem>
+#include<iostream>
+#include<iterator>
+#include<limits>
+#include<memory>
+
+namespace fs = std::filesystem;
+
+// Length of a degree of latitude, and of longitude at the equator, the projection is equirectangular around the
+// center of the data, which is within centimeters over the size of a city
+static const double METERS_PER_DEGREE = 111320.0;
+static const double PI = 3.14159265358979323846;
+// Features of a GeoJSON file every parse job gets at least
+static const size_t FEATURE_GRAIN = 256;
+// Footprints every extrusion job gets at least
+static const size_t EXTRUDE_GRAIN = 64;
+
+// Constructor that reads and extrudes on the workers of jobs
+FootprintImporter::FootprintImporter(JobSystem& jobs) : jobs(jobs) {}
+
+// Reads the footprints of a .geojson, .json or .pbf file
+bool FootprintImporter::Read(const std::string& path)
+{
+	footprints.clear();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::string extension = fs::path(path).extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	std::vector<GeoFootprint> read;
+	bool ok = extension == ".pbf" ? readPbf(path, read) : readGeoJson(path, read);
+	if (!ok)
+		return false;
+	project(read);
+	if (footprints.empty())
+	{
+		std::cerr << "Map " << path << " has no building footprints" << std::endl;
+		return false;
+	}
+	std::cout << "Read " << footprints.size() << " footprints from " << path << " in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+	return true;
+}
+
+// Height in meters of a building from its height or its level count, either 0 where unknown
+double FootprintImporter::height(double meters, double levels) const
+{
+	if (meters > 0.0)
+		return meters;
+	if (levels > 0.0)
+		return levels * levelHeight;
+	return defaultHeight;
+}
+
+// Number in a tag or property, "12", "12.5 m" or a JSON number, 0 if there is none
+static double parseMeasure(const char* text, size_t length)
+{
+	std::string copy(text, length);
+	return std::max(0.0, std::strtod(copy.c_str(), nullptr));
+}
+
+static double parseMeasure(const JsonValue& value)
+{
+	if (value.type == JsonValue::JSON_STRING)
+		return parseMeasure(value.string.c_str(), value.string.size());
+	return std::max(0.0, value.Number(0.0));
+}
+
+// Byte ranges of the features of a feature collection, found without parsing anything else
+static bool findFeatures(const char* text, size_t size, std::vector<std::pair<size_t, size_t>>& features)
+{
+	// Depth counts the brackets open before a character, members of the collection are at 1 and features start at 2
+	int depth = 0;
+	bool inFeatures = false;
+	size_t featureStart = 0;
+	std::string key;
+	for (size_t i = 0; i < size; i++)
+	{
+		char c = text[i];
+		if (c == '"')
+		{
+			size_t begin = ++i;
+			while (i < size && text[i] != '"')
+				i += text[i] == '\\' ? 2 : 1;
+			if (depth == 1)
+				key.assign(text + begin, std::min(i, size) - begin);
+			continue;
+		}
+		if (c == '{' || c == '[')
+		{
+			if (depth == 1 && c == '[' && key == "features")
+				inFeatures = true;
+			else if (depth == 2 && inFeatures && c == '{')
+				featureStart = i;
+			depth++;
+		}
+		else if (c == '}' || c == ']')
+		{
+			depth--;
+			if (depth == 2 && inFeatures && c == '}')
+				features.push_back({ featureStart, i + 1 });
+			else if (depth == 1)
+				inFeatures = false;
+			if (depth < 0)
+				return false;
+		}
+	}
+	return depth == 0;
+}
+
+// Rings of a GeoJSON polygon as longitude and latitude
+static std::vector<std::vector<glm::dvec2>> readPolygon(const JsonValue& coordinates)
+{
+	std::vector<std::vector<glm::dvec2>> rings;
+	for (size_t r = 0; r < coordinates.size(); r++)
+	{
+		const JsonValue& ring = coordinates[r];
+		rings.emplace_back();
+		rings.back().reserve(ring.size());
+		for (size_t p = 0; p < ring.size(); p++)
+			rings.back().push_back(glm::dvec2(ring[p][0].Number(0.0), ring[p][1].Number(0.0)));
+	}
+	return rings;
+}
+
+// Reads the Polygon and MultiPolygon features of a GeoJSON feature collection
+bool FootprintImporter::readGeoJson(const std::string& path, std::vector<GeoFootprint>& read)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		std::cerr << "Failed to map " << path << std::endl;
+		return false;
+	}
+	const char* text = (const char*)file.data();
+	std::vector<std::pair<size_t, size_t>> features;
+	if (!findFeatures(text, file.size(), features) || features.empty())
+	{
+		std::cerr << "Map " << path << " is not a GeoJSON feature collection" << std::endl;
+		return false;
+	}
+
+	// Every slice parses its own features, which are small, so no document of the whole file is ever built
+	size_t slices = jobs.Slices(features.size(), FEATURE_GRAIN);
+	std::vector<std::vector<GeoFootprint>> sliceFootprints(slices);
+	std::vector<size_t> sliceErrors(slices, 0);
+	jobs.ParallelFor(features.size(), FEATURE_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			JsonValue feature;
+			if (!JsonValue::Parse(text + features[i].first, features[i].second - features[i].first, feature))
+			{
+				sliceErrors[slice]++;
+				continue;
+			}
+			const JsonValue& geometry = feature["geometry"];
+			const JsonValue& properties = feature["properties"];
+			double levels = parseMeasure(properties.has("building:levels") ? properties["building:levels"] : properties["levels"]);
+			double meters = parseMeasure(properties.has("height") ? properties["height"] : properties["building:height"]);
+			double buildingHeight = height(meters, levels);
+			const std::string& type = geometry["type"].string;
+			const JsonValue& coordinates = geometry["coordinates"];
+			if (type == "Polygon")
+				sliceFootprints[slice].push_back({ readPolygon(coordinates), buildingHeight });
+			else if (type == "MultiPolygon")
+				for (size_t p = 0; p < coordinates.size(); p++)
+					sliceFootprints[slice].push_back({ readPolygon(coordinates[p]), buildingHeight });
+		}
+	});
+
+	size_t errors = 0;
+	for (size_t slice = 0; slice < slices; slice++)
+	{
+		errors += sliceErrors[slice];
+		std::move(sliceFootprints[slice].begin(), sliceFootprints[slice].end(), std::back_inserter(read));
+	}
+	if (errors > 0)
+		std::cerr << "Skipped " << errors << " malformed features of " << path << std::endl;
+	return true;
+}
+
+// Reads the fields of a protocol buffer message one after the other
+class ProtoReader
+{
+public:
+	uint32_t field = 0;
+	uint32_t wire = 0;
+	bool failed = false;
+
+	ProtoReader(const unsigned char* data, size_t size) : at(data), end(data + size) {}
+
+	// Moves to the next field, false at the end of the message or if it is malformed
+	bool Next()
+	{
+		if (at >= end || failed)
+			return false;
+		uint64_t key = Varint();
+		field = (uint32_t)(key >> 3);
+		wire = (uint32_t)(key & 7);
+		return !failed;
+	}
+	uint64_t Varint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			if (at >= end)
+				break;
+			unsigned char byte = *at++;
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+				return value;
+		}
+		failed = true;
+		return 0;
+	}
+	// A zigzag encoded sint64
+	int64_t Signed()
+	{
+		uint64_t value = Varint();
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+	// A length delimited field
+	std::pair<const unsigned char*, size_t> Bytes()
+	{
+		uint64_t length = Varint();
+		if (failed || length > (uint64_t)(end - at))
+		{
+			failed = true;
+			return { at, 0 };
+		}
+		std::pair<const unsigned char*, size_t> bytes(at, (size_t)length);
+		at += length;
+		return bytes;
+	}
+	bool Done() const
+	{
+		return at >= end || failed;
+	}
+	// Skips the value of the current field
+	void Skip()
+	{
+		switch (wire)
+		{
+		case 0: Varint(); break;
+		case 1: advance(8); break;
+		case 2: Bytes(); break;
+		case 5: advance(4); break;
+		default: failed = true; break;
+		}
+	}
+private:
+	const unsigned char* at;
+	const unsigned char* end;
+
+	void advance(size_t bytes)
+	{
+		if (bytes > (size_t)(end - at))
+			failed = true;
+		else
+			at += bytes;
+	}
+};
+
+// Block of an OSM PBF file, decompressed, with the offsets its coordinates are stored against
+struct PbfBlock
+{
+	// Holds the decompressed bytes, the views below point into it
+	std::unique_ptr<unsigned char, void (*)(void*)> data{ nullptr, stbi_image_free };
+	std::vector<std::pair<const char*, size_t>> strings;
+	std::vector<std::pair<const unsigned char*, size_t>> groups;
+	int64_t granularity = 100;
+	int64_t latOffset = 0;
+	int64_t lonOffset = 0;
+
+	bool is(uint64_t index, const char* text) const
+	{
+		return index < strings.size() && strings[index].second == strlen(text) && memcmp(strings[index].first, text, strings[index].second) == 0;
+	}
+	glm::dvec2 coordinates(int64_t lon, int64_t lat) const
+	{
+		return glm::dvec2(1e-9 * (lonOffset + granularity * lon), 1e-9 * (latOffset + granularity * lat));
+	}
+};
+
+// Decompresses a blob and reads the string table and groups of the primitive block in it
+static bool readBlock(const unsigned char* blob, size_t size, PbfBlock& block)
+{
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+	ProtoReader reader(blob, size);
+	int64_t rawSize = 0;
+	std::pair<const unsigned char*, size_t> compressed(nullptr, 0);
+	while (reader.Next())
+	{
+		if (reader.field == 1 && reader.wire == 2)
+		{
+			std::pair<const unsigned char*, size_t> raw = reader.Bytes();
+			bytes = raw.first;
+			length = raw.second;
+		}
+		else if (reader.field == 2 && reader.wire == 0)
+			rawSize = (int64_t)reader.Varint();
+		else if (reader.field == 3 && reader.wire == 2)
+			compressed = reader.Bytes();
+		else
+			reader.Skip();
+	}
+	if (reader.failed)
+		return false;
+	// stb_image carries the zlib decoder every PNG needs, so PBF files need no library of their own
+	if (compressed.first)
+	{
+		int decoded = 0;
+		block.data.reset((unsigned char*)stbi_zlib_decode_malloc_guesssize_headerflag((const char*)compressed.first, (int)compressed.second,
+			(int)std::max<int64_t>(rawSize, 1), &decoded, 1));
+		if (!block.data)
+			return false;
+		bytes = block.data.get();
+		length = (size_t)decoded;
+	}
+	if (!bytes)
+		return false;
+
+	ProtoReader primitive(bytes, length);
+	while (primitive.Next())
+	{
+		if (primitive.field == 1 && primitive.wire == 2)
+		{
+			std::pair<const unsigned char*, size_t> table = primitive.Bytes();
+			ProtoReader strings(table.first, table.second);
+			while (strings.Next())
+			{
+				if (strings.field == 1 && strings.wire == 2)
+				{
+					std::pair<const unsigned char*, size_t> text = strings.Bytes();
+					block.strings.push_back({ (const char*)text.first, text.second });
+				}
+				else
+					strings.Skip();
+			}
+		}
+		else if (primitive.field == 2 && primitive.wire == 2)
+			block.groups.push_back(primitive.Bytes());
+		else if (primitive.field == 17 && primitive.wire == 0)
+			block.granularity = (int64_t)primitive.Varint();
+		else if (primitive.field == 19 && primitive.wire == 0)
+			block.latOffset = (int64_t)primitive.Varint();
+		else if (primitive.field == 20 && primitive.wire == 0)
+			block.lonOffset = (int64_t)primitive.Varint();
+		else
+			primitive.Skip();
+	}
+	return !primitive.failed;
+}
+
+// Way tagged as a building, with the nodes of its outline
+struct PbfWay
+{
+	std::vector<int64_t> refs;
+	double meters;
+	double levels;
+};
+
+// Reads the closed building ways of a block and tells if it holds any nodes
+static void readWays(const PbfBlock& block, std::vector<PbfWay>& ways, bool& hasNodes)
+{
+	for (const std::pair<const unsigned char*, size_t>& group : block.groups)
+	{
+		ProtoReader reader(group.first, group.second);
+		while (reader.Next())
+		{
+			if ((reader.field == 1 || reader.field == 2) && reader.wire == 2)
+			{
+				hasNodes = true;
+				reader.Skip();
+				continue;
+			}
+			if (reader.field != 3 || reader.wire != 2)
+			{
+				reader.Skip();
+				continue;
+			}
+			std::pair<const unsigned char*, size_t> message = reader.Bytes();
+			ProtoReader way(message.first, message.second);
+			std::vector<uint64_t> keys, values;
+			PbfWay result = { {}, 0.0, 0.0 };
+			while (way.Next())
+			{
+				if ((way.field == 2 || way.field == 3 || way.field == 8) && way.wire == 2)
+				{
+					std::pair<const unsigned char*, size_t> packed = way.Bytes();
+					ProtoReader items(packed.first, packed.second);
+					int64_t ref = 0;
+					while (!items.Done())
+					{
+						if (way.field == 2)
+							keys.push_back(items.Varint());
+						else if (way.field == 3)
+							values.push_back(items.Varint());
+						else
+							result.refs.push_back(ref += items.Signed());
+					}
+				}
+				else
+					way.Skip();
+			}
+			bool building = false;
+			for (size_t i = 0; i < keys.size() && i < values.size(); i++)
+			{
+				if (block.is(keys[i], "building"))
+					building = !block.is(values[i], "no");
+				else if (block.is(keys[i], "height") && values[i] < block.strings.size())
+					result.meters = parseMeasure(block.strings[values[i]].first, block.strings[values[i]].second);
+				else if (block.is(keys[i], "building:levels") && values[i] < block.strings.size())
+					result.levels = parseMeasure(block.strings[values[i]].first, block.strings[values[i]].second);
+			}
+			if (building && result.refs.size() >= 4 && result.refs.front() == result.refs.back())
+				ways.push_back(std::move(result));
+		}
+	}
+}
+
+// Writes the coordinates of the nodes of a block that are in needed, sorted ids, into the same slot of coordinates
+static void readNodes(const PbfBlock& block, const std::vector<int64_t>& needed, std::vector<glm::dvec2>& coordinates)
+{
+	auto store = [&](int64_t id, int64_t lat, int64_t lon) {
+		auto found = std::lower_bound(needed.begin(), needed.end(), id);
+		if (found != needed.end() && *found == id)
+			coordinates[found - needed.begin()] = block.coordinates(lon, lat);
+	};
+	for (const std::pair<const unsigned char*, size_t>& group : block.groups)
+	{
+		ProtoReader reader(group.first, group.second);
+		while (reader.Next())
+		{
+			if (reader.field == 1 && reader.wire == 2)
+			{
+				// Plain nodes, rare but allowed
+				std::pair<const unsigned char*, size_t> message = reader.Bytes();
+				ProtoReader node(message.first, message.second);
+				int64_t id = 0, lat = 0, lon = 0;
+				while (node.Next())
+				{
+					if (node.field == 1 && node.wire == 0)
+						id = node.Signed();
+					else if (node.field == 8 && node.wire == 0)
+						lat = node.Signed();
+					else if (node.field == 9 && node.wire == 0)
+						lon = node.Signed();
+					else
+						node.Skip();
+				}
+				store(id, lat, lon);
+			}
+			else if (reader.field == 2 && reader.wire == 2)
+			{
+				// Dense nodes, ids and coordinates delta coded in three packed arrays of the same length
+				std::pair<const unsigned char*, size_t> message = reader.Bytes();
+				ProtoReader dense(message.first, message.second);
+				std::pair<const unsigned char*, size_t> ids(nullptr, 0), lats(nullptr, 0), lons(nullptr, 0);
+				while (dense.Next())
+				{
+					if (dense.field == 1 && dense.wire == 2)
+						ids = dense.Bytes();
+					else if (dense.field == 8 && dense.wire == 2)
+						lats = dense.Bytes();
+					else if (dense.field == 9 && dense.wire == 2)
+						lons = dense.Bytes();
+					else
+						dense.Skip();
+				}
+				ProtoReader idReader(ids.first, ids.second), latReader(lats.first, lats.second), lonReader(lons.first, lons.second);
+				int64_t id = 0, lat = 0, lon = 0;
+				while (!idReader.Done() && !latReader.Done() && !lonReader.Done())
+				{
+					id += idReader.Signed();
+					lat += latReader.Signed();
+					lon += lonReader.Signed();
+					store(id, lat, lon);
+				}
+			}
+			else
+				reader.Skip();
+		}
+	}
+}
+
+// Reads the closed ways tagged building of an OSM PBF file
+bool FootprintImporter::readPbf(const std::string& path, std::vector<GeoFootprint>& read)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		std::cerr << "Failed to map " << path << std::endl;
+		return false;
+	}
+
+	// Blobs are listed first, each one a big endian header length, a BlobHeader and the blob it describes
+	std::vector<std::pair<const unsigned char*, size_t>> blobs;
+	const unsigned char* data = file.data();
+	size_t at = 0;
+	while (at + 4 <= file.size())
+	{
+		uint32_t headerSize = ((uint32_t)data[at] << 24) | ((uint32_t)data[at + 1] << 16) | ((uint32_t)data[at + 2] << 8) | data[at + 3];
+		at += 4;
+		if (headerSize > file.size() - at)
+			break;
+		ProtoReader header(data + at, headerSize);
+		bool osmData = false;
+		uint64_t blobSize = 0;
+		while (header.Next())
+		{
+			if (header.field == 1 && header.wire == 2)
+			{
+				std::pair<const unsigned char*, size_t> type = header.Bytes();
+				osmData = type.second == 7 && memcmp(type.first, "OSMData", 7) == 0;
+			}
+			else if (header.field == 3 && header.wire == 0)
+				blobSize = header.Varint();
+			else
+				header.Skip();
+		}
+		at += headerSize;
+		if (header.failed || blobSize > file.size() - at)
+			break;
+		if (osmData)
+			blobs.push_back({ data + at, (size_t)blobSize });
+		at += (size_t)blobSize;
+	}
+	if (at != file.size() || blobs.empty())
+	{
+		std::cerr << "Map " << path << " is not an OSM PBF file" << std::endl;
+		return false;
+	}
+
+	// First pass finds the building ways, every blob decompressed by its own job
+	std::vector<std::vector<PbfWay>> blobWays(blobs.size());
+	std::vector<char> blobNodes(blobs.size(), 0), blobFailed(blobs.size(), 0);
+	jobs.ParallelFor(blobs.size(), 1, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			PbfBlock block;
+			bool hasNodes = false;
+			if (!readBlock(blobs[i].first, blobs[i].second, block))
+			{
+				blobFailed[i] = 1;
+				continue;
+			}
+			readWays(block, blobWays[i], hasNodes);
+			blobNodes[i] = hasNodes;
+		}
+	});
+	size_t failed = (size_t)std::count(blobFailed.begin(), blobFailed.end(), 1);
+	if (failed > 0)
+		std::cerr << "Skipped " << failed << " blocks of " << path << " that are not zlib or raw" << std::endl;
+
+	// Second pass keeps only the nodes those ways use, a whole planet of nodes would not fit into memory
+	std::vector<int64_t> needed;
+	for (const std::vector<PbfWay>& ways : blobWays)
+		for (const PbfWay& way : ways)
+			needed.insert(needed.end(), way.refs.begin(), way.refs.end() - 1);
+	std::sort(needed.begin(), needed.end());
+	needed.erase(std::unique(needed.begin(), needed.end()), needed.end());
+	const double missing = std::numeric_limits<double>::quiet_NaN();
+	std::vector<glm::dvec2> coordinates(needed.size(), glm::dvec2(missing));
+	jobs.ParallelFor(blobs.size(), 1, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			PbfBlock block;
+			if (blobNodes[i] && readBlock(blobs[i].first, blobs[i].second, block))
+				readNodes(block, needed, coordinates);
+		}
+	});
+
+	size_t incomplete = 0;
+	for (const std::vector<PbfWay>& ways : blobWays)
+	{
+		for (const PbfWay& way : ways)
+		{
+			GeoFootprint footprint;
+			footprint.heightMeters = height(way.meters, way.levels);
+			footprint.rings.emplace_back();
+			for (size_t i = 0; i + 1 < way.refs.size(); i++)
+			{
+				size_t slot = std::lower_bound(needed.begin(), needed.end(), way.refs[i]) - needed.begin();
+				footprint.rings.back().push_back(coordinates[slot]);
+			}
+			// Extracts cut at their border keep the ways that cross it without the nodes outside
+			bool complete = std::none_of(footprint.rings.back().begin(), footprint.rings.back().end(), [](const glm::dvec2& p) { return std::isnan(p.x); });
+			if (complete)
+				read.push_back(std::move(footprint));
+			else
+				incomplete++;
+		}
+	}
+	if (incomplete > 0)
+		std::cerr << "Skipped " << incomplete << " buildings of " << path << " whose nodes are missing" << std::endl;
+	return true;
+}
+
+// Twice the signed area of a ring, positive if it runs counter-clockwise
+static double signedArea(const std::vector<glm::dvec2>& ring)
+{
+	double area = 0.0;
+	for (size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++)
+		area += (ring[j].x - ring[i].x) * (ring[j].y + ring[i].y);
+	return area;
+}
+
+// Projects the footprints around the center of their bounds, drops degenerate ones and fixes the winding
+void FootprintImporter::project(std::vector<GeoFootprint>& read)
+{
+	glm::dvec2 min(INFINITY), max(-INFINITY);
+	for (const GeoFootprint& footprint : read)
+	{
+		if (footprint.rings.empty())
+			continue;
+		for (const glm::dvec2& point : footprint.rings[0])
+		{
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+	}
+	glm::dvec2 center = 0.5 * (min + max);
+	double unitsPerDegree = METERS_PER_DEGREE / metersPerUnit;
+	double lonScale = std::cos(center.y * PI / 180.0) * unitsPerDegree;
+
+	std::vector<Footprint> projected(read.size());
+	jobs.ParallelFor(read.size(), EXTRUDE_GRAIN, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			Footprint& footprint = projected[i];
+			footprint.height = read[i].heightMeters / metersPerUnit;
+			for (size_t r = 0; r < read[i].rings.size(); r++)
+			{
+				// The closing point and repeated points are dropped, rings are then wound in the plane of x and -z
+				std::vector<glm::dvec2> ring;
+				for (const glm::dvec2& point : read[i].rings[r])
+				{
+					glm::dvec2 north((point.x - center.x) * lonScale, (point.y - center.y) * unitsPerDegree);
+					if (ring.empty() || ring.back() != north)
+						ring.push_back(north);
+				}
+				while (ring.size() > 1 && ring.front() == ring.back())
+					ring.pop_back();
+				double area = ring.size() >= 3 ? signedArea(ring) : 0.0;
+				if (area == 0.0)
+				{
+					// A broken outer ring makes the whole footprint unusable, a broken hole is left out
+					if (r == 0)
+						break;
+					continue;
+				}
+				if ((area > 0.0) != (r == 0))
+					std::reverse(ring.begin(), ring.end());
+				for (glm::dvec2& point : ring)
+					point.y = -point.y;
+				if (r == 0)
+					footprint.outer = std::move(ring);
+				else
+					footprint.holes.push_back(std::move(ring));
+			}
+		}
+	});
+	for (Footprint& footprint : projected)
+		if (!footprint.outer.empty() && footprint.height > 0.0)
+			footprints.push_back(std::move(footprint));
+}
+
+// Twice the signed area of a triangle, positive if it is counter-clockwise
+static double cross(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c)
+{
+	return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// Checks if p lies inside or on a counter-clockwise triangle
+static bool inTriangle(const glm::dvec2& a, const glm::dvec2& b, const glm::dvec2& c, const glm::dvec2& p)
+{
+	return cross(a, b, p) >= 0.0 && cross(b, c, p) >= 0.0 && cross(c, a, p) >= 0.0;
+}
+
+// Joins a clockwise hole to the polygon at its rightmost point, by a bridge to a polygon point it can see
+static bool bridgeHole(const std::vector<glm::dvec2>& points, size_t begin, size_t end, std::vector<GLuint>& polygon)
+{
+	size_t rightmost = begin;
+	for (size_t i = begin; i < end; i++)
+		if (points[i].x > points[rightmost].x)
+			rightmost = i;
+	const glm::dvec2& m = points[rightmost];
+
+	// The nearest polygon edge a ray to the right of the hole hits
+	size_t n = polygon.size();
+	double hitX = INFINITY;
+	size_t edge = n;
+	for (size_t i = 0; i < n; i++)
+	{
+		const glm::dvec2& a = points[polygon[i]];
+		const glm::dvec2& b = points[polygon[(i + 1) % n]];
+		if (a.y == b.y || (a.y > m.y) == (b.y > m.y))
+			continue;
+		double x = a.x + (m.y - a.y) * (b.x - a.x) / (b.y - a.y);
+		if (x >= m.x && x < hitX)
+		{
+			hitX = x;
+			edge = i;
+		}
+	}
+	if (edge == n)
+		return false;
+	// The end of that edge further right is the bridge, unless a point of the polygon lies in the triangle between the
+	// ray and that end, then the one of those closest in angle to the ray is, it cannot be hidden behind another
+	size_t bridge = points[polygon[edge]].x > points[polygon[(edge + 1) % n]].x ? edge : (edge + 1) % n;
+	glm::dvec2 hit(hitX, m.y);
+	const glm::dvec2 end0 = points[polygon[bridge]];
+	glm::dvec2 a = m, b = hit, c = end0;
+	if (cross(a, b, c) < 0.0)
+		std::swap(b, c);
+	// A ray that hits the end exactly leaves no triangle to look into
+	double bestSlope = INFINITY;
+	for (size_t i = 0; i < n && cross(a, b, c) != 0.0; i++)
+	{
+		const glm::dvec2& p = points[polygon[i]];
+		if (i == bridge || p.x <= m.x || p == end0 || !inTriangle(a, b, c, p))
+			continue;
+		double slope = std::abs(p.y - m.y) / (p.x - m.x);
+		if (slope < bestSlope)
+		{
+			bestSlope = slope;
+			bridge = i;
+		}
+	}
+
+	// The polygon walks over to the hole, around it and back over the same bridge
+	std::vector<GLuint> joined(polygon.begin(), polygon.begin() + bridge + 1);
+	for (size_t i = 0; i < end - begin; i++)
+		joined.push_back((GLuint)(begin + (rightmost - begin + i) % (end - begin)));
+	joined.push_back((GLuint)rightmost);
+	joined.insert(joined.end(), polygon.begin() + bridge, polygon.end());
+	polygon.swap(joined);
+	return true;
+}
+
+// Triangulates a polygon by ear clipping
+bool FootprintImporter::Triangulate(const std::vector<glm::dvec2>& points, const std::vector<size_t>& ringEnds, std::vector<GLuint>& triangles)
+{
+	if (ringEnds.empty() || ringEnds[0] < 3)
+		return false;
+	std::vector<GLuint> polygon(ringEnds[0]);
+	for (GLuint i = 0; i < (GLuint)ringEnds[0]; i++)
+		polygon[i] = i;
+
+	// Holes reaching further right are bridged first, so later bridges never cross earlier ones
+	std::vector<std::pair<size_t, size_t>> holes;
+	for (size_t r = 1; r < ringEnds.size(); r++)
+		if (ringEnds[r] - ringEnds[r - 1] >= 3)
+			holes.push_back({ ringEnds[r - 1], ringEnds[r] });
+	auto maxX = [&](const std::pair<size_t, size_t>& hole) {
+		double x = -INFINITY;
+		for (size_t i = hole.first; i < hole.second; i++)
+			x = std::max(x, points[i].x);
+		return x;
+	};
+	std::sort(holes.begin(), holes.end(), [&](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) { return maxX(a) > maxX(b); });
+	for (const std::pair<size_t, size_t>& hole : holes)
+		bridgeHole(points, hole.first, hole.second, polygon);
+
+	// The polygon is a ring of corners linked both ways, clipped ears are unlinked
+	size_t n = polygon.size();
+	std::vector<size_t> previous(n), next(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		previous[i] = (i + n - 1) % n;
+		next[i] = (i + 1) % n;
+	}
+	// A corner is an ear if it is convex and no other corner lies in the triangle it cuts off, the ends of bridges
+	// appear twice and do not count as inside
+	auto isEar = [&](size_t corner) {
+		const glm::dvec2& a = points[polygon[previous[corner]]];
+		const glm::dvec2& b = points[polygon[corner]];
+		const glm::dvec2& c = points[polygon[next[corner]]];
+		if (cross(a, b, c) <= 0.0)
+			return false;
+		for (size_t i = next[next[corner]]; i != previous[corner]; i = next[i])
+		{
+			const glm::dvec2& p = points[polygon[i]];
+			if (p != a && p != b && p != c && inTriangle(a, b, c, p))
+				return false;
+		}
+		return true;
+	};
+
+	size_t remaining = n, corner = 0, stalled = 0;
+	while (remaining > 3)
+	{
+		// A polygon that crosses itself may have no ear left, the corner is cut anyway so the loop always ends
+		if (isEar(corner) || stalled >= remaining)
+		{
+			triangles.push_back(polygon[previous[corner]]);
+			triangles.push_back(polygon[corner]);
+			triangles.push_back(polygon[next[corner]]);
+			next[previous[corner]] = next[corner];
+			previous[next[corner]] = previous[corner];
+			corner = next[corner];
+			remaining--;
+			stalled = 0;
+			continue;
+		}
+		corner = next[corner];
+		stalled++;
+	}
+	triangles.push_back(polygon[previous[corner]]);
+	triangles.push_back(polygon[corner]);
+	triangles.push_back(polygon[next[corner]]);
+	return true;
+}
+
+// Writes the walls and roof of a footprint
+bool FootprintImporter::Extrude(const Footprint& footprint, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, const glm::dvec2& origin)
+{
+	// The roof is triangulated as seen from above with north up, so -z takes the place of y
+	// Points are moved to the origin in double, only the small offsets from it are rounded to float
+	std::vector<glm::dvec2> points;
+	std::vector<size_t> ringEnds;
+	auto addRing = [&](const std::vector<glm::dvec2>& ring) {
+		for (const glm::dvec2& point : ring)
+			points.push_back(glm::dvec2(point.x - origin.x, origin.y - point.y));
+		ringEnds.push_back(points.size());
+	};
+	addRing(footprint.outer);
+	for (const std::vector<glm::dvec2>& hole : footprint.holes)
+		addRing(hole);
+	std::vector<GLuint> roof;
+	if (!Triangulate(points, ringEnds, roof))
+		return false;
+
+	const size_t first = vertices.size() / CityGenerator::VERTEX_FLOATS;
+	auto vertex = [&](const glm::dvec2& point, double y, double u, double v) {
+		GLfloat out[CityGenerator::VERTEX_FLOATS] = { (GLfloat)point.x, (GLfloat)y, (GLfloat)-point.y, (GLfloat)u, (GLfloat)v };
+		vertices.insert(vertices.end(), out, out + CityGenerator::VERTEX_FLOATS);
+	};
+	const double scale = CityGenerator::FACADE_TEXTURE_SCALE;
+	const double h = footprint.height;
+
+	// Every wall is a quad wound like the generated ones, the outer ring is counter-clockwise from above so they face
+	// out, holes are clockwise so theirs face into the hole. The facade runs on around corners instead of restarting.
+	size_t ringBegin = 0;
+	for (size_t ringEnd : ringEnds)
+	{
+		double u = 0.0;
+		for (size_t i = ringBegin; i < ringEnd; i++)
+		{
+			const glm::dvec2& a = points[i];
+			const glm::dvec2& b = points[i + 1 < ringEnd ? i + 1 : ringBegin];
+			double length = glm::length(b - a);
+			GLuint base = (GLuint)(vertices.size() / CityGenerator::VERTEX_FLOATS - first);
+			vertex(a, 0.0, u * scale, 0.0);
+			vertex(b, 0.0, (u + length) * scale, 0.0);
+			vertex(b, h, (u + length) * scale, h * scale);
+			vertex(a, h, u * scale, h * scale);
+			const GLuint quad[6] = { 0, 1, 2, 2, 3, 0 };
+			for (GLuint index : quad)
+				indices.push_back(base + index);
+			u += length;
+		}
+		ringBegin = ringEnd;
+	}
+
+	// The roof spans its texture once like the generated roofs
+	glm::dvec2 min(INFINITY), max(-INFINITY);
+	for (const glm::dvec2& point : footprint.outer)
+	{
+		min = glm::min(min, point - origin);
+		max = glm::max(max, point - origin);
+	}
+	glm::dvec2 size = glm::max(max - min, glm::dvec2(1e-9));
+	GLuint roofBase = (GLuint)(vertices.size() / CityGenerator::VERTEX_FLOATS - first);
+	for (const glm::dvec2& point : points)
+		vertex(point, h, (point.x - min.x) / size.x, (-point.y - min.y) / size.y);
+	for (GLuint index : roof)
+		indices.push_back(roofBase + index);
+	return true;
+}
+
+// Writes every tile of the grid into directory
+int FootprintImporter::WriteTiles(const CityLayout& tileLayout, int tilesX, int tilesZ, const std::string& directory)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	CityGenerator city(tileLayout);
+	glm::dvec2 tileSize(2.0 * city.halfExtentX(), 2.0 * city.halfExtentZ());
+
+	// Footprints go to the tile their center is in, the grid is centered on the origin like the streamer's
+	std::vector<std::vector<size_t>> tileFootprints((size_t)tilesX * tilesZ);
+	size_t outside = 0;
+	for (size_t i = 0; i < footprints.size(); i++)
+	{
+		glm::dvec2 min(INFINITY), max(-INFINITY);
+		for (const glm::dvec2& point : footprints[i].outer)
+		{
+			min = glm::min(min, point);
+			max = glm::max(max, point);
+		}
+		glm::dvec2 center = 0.5 * (min + max);
+		int x = (int)std::floor(center.x / tileSize.x + 0.5 * tilesX);
+		int z = (int)std::floor(center.y / tileSize.y + 0.5 * tilesZ);
+		if (x < 0 || x >= tilesX || z < 0 || z >= tilesZ)
+		{
+			outside++;
+			continue;
+		}
+		tileFootprints[(size_t)z * tilesX + x].push_back(i);
+	}
+	if (outside > 0)
+		std::cerr << outside << " footprints lie outside the " << tilesX << "x" << tilesZ << " tiles of " << tileSize.x << " by " << tileSize.y
+			<< " units, raise --stream or --meters-per-unit to take them in" << std::endl;
+
+	std::error_code error;
+	fs::create_directories(directory, error);
+	int failed = 0;
+	size_t largest = 0, degenerate = 0, written = 0;
+	std::vector<std::vector<GLfloat>> meshVertices;
+	std::vector<std::vector<GLuint>> meshIndices;
+	std::vector<char> extruded;
+	for (int z = 0; z < tilesZ; z++)
+	{
+		for (int x = 0; x < tilesX; x++)
+		{
+			// Every footprint of the tile is extruded by its own job around the tile's center, which the streamer draws
+			// it relative to, then the meshes are joined behind the ground quad
+			const std::vector<size_t>& inside = tileFootprints[(size_t)z * tilesX + x];
+			glm::dvec3 tileCenter = TileStreamer::center(glm::vec2(tileSize), tilesX, tilesZ, x, z);
+			glm::dvec2 center(tileCenter.x, tileCenter.z);
+			meshVertices.assign(inside.size(), std::vector<GLfloat>());
+			meshIndices.assign(inside.size(), std::vector<GLuint>());
+			extruded.assign(inside.size(), 0);
+			if (!inside.empty())
+			{
+				jobs.ParallelFor(inside.size(), EXTRUDE_GRAIN, [&](size_t, size_t begin, size_t end) {
+					for (size_t i = begin; i < end; i++)
+						extruded[i] = Extrude(footprints[inside[i]], meshVertices[i], meshIndices[i], center);
+				});
+			}
+
+			std::vector<GLfloat> vertices(CityGenerator::GROUND_VERTICES * CityGenerator::VERTEX_FLOATS);
+			std::vector<GLuint> indices(CityGenerator::GROUND_INDICES);
+			city.GenerateGround(vertices.data(), indices.data());
+			for (size_t i = 0; i < inside.size(); i++)
+			{
+				if (!extruded[i])
+				{
+					degenerate++;
+					continue;
+				}
+				GLuint base = (GLuint)(vertices.size() / CityGenerator::VERTEX_FLOATS);
+				vertices.insert(vertices.end(), meshVertices[i].begin(), meshVertices[i].end());
+				for (GLuint index : meshIndices[i])
+					indices.push_back(base + index);
+				written++;
+			}
+			largest = std::max(largest, vertices.size() / CityGenerator::VERTEX_FLOATS);
+
+			std::string path = TileStreamer::path(directory, x, z);
+			if (!TileStreamer::WriteTile(path, vertices, indices))
+			{
+				std::cerr << "Failed to write tile " << path << std::endl;
+				failed++;
+			}
+		}
+	}
+	if (degenerate > 0)
+		std::cerr << "Skipped " << degenerate << " footprints that could not be triangulated" << std::endl;
+	std::cout << "Extruded " << written << " buildings into " << tilesX * tilesZ << " tiles in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms, the largest has "
+		<< largest << " vertices" << std::endl;
+	// The streamer's heap takes the index size of a generated tile, 16 bit indices cannot reach past 65536 vertices
+	if (EBO::IndexType(city.vertexCount()) == GL_UNSIGNED_SHORT && largest > 65536)
+		std::cerr << "Tiles with more than 65536 vertices are generated instead when streamed with this layout, "
+			"use smaller tiles or a layout of more buildings per tile" << std::endl;
+	return failed;
+}
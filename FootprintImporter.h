@@ -0,0 +1,78 @@
+#ifndef FOOTPRINT_IMPORTER_CLASS_H
+#define FOOTPRINT_IMPORTER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<string>
+#include<vector>
+
+#include"CityGenerator.h"
+#include"JobSystem.h"
+
+// Outline and height of one real building, in world units on the ground plane
+struct Footprint
+{
+	// Outer ring counter-clockwise and holes clockwise seen from above, as x and z, without repeating the first point
+	std::vector<glm::dvec2> outer;
+	std::vector<std::vector<glm::dvec2>> holes;
+	double height = 0.0;
+};
+
+// Turns building footprints from a map into tiles the TileStreamer reads instead of generating them
+// GeoJSON feature collections of Polygon and MultiPolygon features and OSM PBF extracts, whose closed ways tagged
+// building become footprints, are read on the workers of the job system, a GeoJSON file one slice of features per job
+// and a PBF file one blob per job. Heights come from the height tag or property, from building:levels, or a default.
+// Longitude and latitude are projected around the center of the data, east is +X and north is -Z, so the roofs
+// come out counter-clockwise from above like the generated ones.
+// Every footprint is extruded by its own job: its walls get facade texture coordinates running around the outline
+// at CityGenerator::FACADE_TEXTURE_SCALE so the facade repeats exactly as on generated buildings, and its roof is
+// triangulated by ear clipping, with holes bridged into the outer ring first.
+// Footprints go to the tile their center lies in, and every tile of the grid is written with its ground quad first,
+// tiles without buildings too, so the streamed world shows only the map. Relations, building parts and roof shapes
+// are not read, multipolygon buildings with holes only come from GeoJSON.
+class FootprintImporter
+{
+public:
+	// Meters of the map one world unit stands for, generated lots are 2 units wide
+	double metersPerUnit = 10.0;
+	// Height of buildings that have no height, and of every level of those that only give a level count
+	double defaultHeight = 10.0;
+	double levelHeight = 3.0;
+	// Footprints read by the last Read, projected into world units
+	std::vector<Footprint> footprints;
+
+	// Constructor that reads and extrudes on the workers of jobs, which has to outlive the importer
+	FootprintImporter(JobSystem& jobs);
+
+	// Reads the footprints of a .geojson, .json or .pbf file, false with the reason on stderr if nothing could be read
+	bool Read(const std::string& path);
+	// Writes every tile of a grid of tilesX by tilesZ tiles the size of a tileLayout city, centered on the origin
+	// like the TileStreamer's, into directory, returns how many could not be written
+	int WriteTiles(const CityLayout& tileLayout, int tilesX, int tilesZ, const std::string& directory);
+
+	// Writes the walls and roof of a footprint around origin, indices relative to the first vertex written, false if
+	// the outline is degenerate, in which case nothing is written
+	static bool Extrude(const Footprint& footprint, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices, const glm::dvec2& origin = glm::dvec2(0.0));
+	// Triangulates a polygon by ear clipping, points is the outer ring followed by the holes, each ring ending where
+	// the next starts in ringEnds, and the triangles index into points
+	static bool Triangulate(const std::vector<glm::dvec2>& points, const std::vector<size_t>& ringEnds, std::vector<GLuint>& triangles);
+private:
+	// Outline read from the file before projection, as longitude and latitude in degrees
+	struct GeoFootprint
+	{
+		std::vector<std::vector<glm::dvec2>> rings;
+		double heightMeters;
+	};
+
+	JobSystem& jobs;
+
+	bool readGeoJson(const std::string& path, std::vector<GeoFootprint>& read);
+	bool readPbf(const std::string& path, std::vector<GeoFootprint>& read);
+	// Height in meters of a building from its height or its level count, either 0 where unknown
+	double height(double meters, double levels) const;
+	// Projects the footprints around the center of their bounds, drops degenerate ones and fixes the winding
+	void project(std::vector<GeoFootprint>& read);
+};
+
+#endif
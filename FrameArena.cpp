@@ -0,0 +1,86 @@
+#include"FrameArena.h"
+
+#include<algorithm>
+#include<cstdint>
+#include<new>
+
+// Constructor that allocates the first block
+FrameArena::FrameArena(size_t capacity)
+{
+	if (capacity > 0)
+		block = (char*)::operator new(capacity);
+	size = capacity;
+}
+
+// Frees every block
+FrameArena::~FrameArena()
+{
+	freeOverflow();
+	::operator delete(block);
+}
+
+// Bumps the offset, or takes an overflow block once the frame outgrew the block
+void* FrameArena::Allocate(size_t bytes, size_t alignment)
+{
+	uintptr_t start = ((uintptr_t)block + offset + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	size_t end = (size_t)(start - (uintptr_t)block) + bytes;
+	if (block && end <= size)
+	{
+		offset = end;
+		return (void*)start;
+	}
+	// Room for the link and for aligning the memory behind it
+	size_t total = sizeof(Overflow) + alignment + bytes;
+	Overflow* extra = (Overflow*)::operator new(total);
+	extra->previous = overflow;
+	overflow = extra;
+	overflowBytes += total;
+	uintptr_t memory = ((uintptr_t)(extra + 1) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	return (void*)memory;
+}
+
+// Rewinds the block, a frame that overflowed gets a block large enough for it
+void FrameArena::Reset()
+{
+	size_t frameBytes = offset + overflowBytes;
+	peakBytes = std::max(peakBytes, frameBytes);
+	if (overflow)
+	{
+		freeOverflow();
+		::operator delete(block);
+		// Frames tend to grow a little further, the new block leaves them a quarter more
+		size = frameBytes + frameBytes / 4;
+		block = (char*)::operator new(size);
+	}
+	offset = 0;
+}
+
+// Bytes allocated since the last Reset
+size_t FrameArena::used() const
+{
+	return offset + overflowBytes;
+}
+
+// Bytes the arena can hand out before it overflows
+size_t FrameArena::capacity() const
+{
+	return size;
+}
+
+// Most bytes a frame has used so far
+size_t FrameArena::peak() const
+{
+	return std::max(peakBytes, used());
+}
+
+// Frees the overflow blocks
+void FrameArena::freeOverflow()
+{
+	while (overflow)
+	{
+		Overflow* previous = overflow->previous;
+		::operator delete(overflow);
+		overflow = previous;
+	}
+	overflowBytes = 0;
+}
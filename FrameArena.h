@@ -0,0 +1,53 @@
+#ifndef FRAME_ARENA_CLASS_H
+#define FRAME_ARENA_CLASS_H
+
+#include<cstddef>
+
+// Linear allocator for data that only lives for one frame, such as culling results, staged records and sort keys
+// Allocate bumps an offset into one block and Reset rewinds it, so a frame costs no heap allocations at all once the
+// block is as large as the largest frame so far. A frame that does not fit takes overflow blocks from the heap, and
+// the next Reset replaces everything with one block of the size that frame needed.
+// Memory is never constructed or destroyed, only put trivially destructible data into it. Not thread safe, workers
+// get slices the owning thread allocated for them.
+class FrameArena
+{
+public:
+	// Constructor that allocates the first block, none for a capacity of 0
+	FrameArena(size_t capacity = 0);
+	// Frees every block
+	~FrameArena();
+	// A FrameArena owns its blocks, so it cannot be copied
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// Memory for bytes bytes at a multiple of alignment, which has to be a power of two, valid until the next Reset
+	void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+	// Gives back everything allocated since the last Reset
+	void Reset();
+
+	// Bytes allocated since the last Reset, alignment padding included
+	size_t used() const;
+	// Bytes the arena can hand out before it overflows
+	size_t capacity() const;
+	// Most bytes a frame has used so far
+	size_t peak() const;
+private:
+	// Heap block with the previous overflow block in front of its memory
+	struct Overflow
+	{
+		Overflow* previous;
+	};
+
+	char* block = nullptr;
+	size_t size = 0;
+	size_t offset = 0;
+	// Overflow blocks of the current frame, newest first, and the bytes they hold
+	Overflow* overflow = nullptr;
+	size_t overflowBytes = 0;
+	size_t peakBytes = 0;
+
+	// Frees the overflow blocks
+	void freeOverflow();
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef FRAME_DATA_CLASS_H
+#define FRAME_DATA_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+// Per frame values shared by every Shader Program through one uniform buffer
+// Mirrors the std140 block "FrameData" in the shaders, so members must stay 16 byte aligned and in the same order
+struct FrameData
+{
+	// Binding point the uniform buffer and every program's FrameData block are attached to
+	static constexpr GLuint BINDING = 0;
+
+	// Projection * view
+	glm::mat4 camMatrix;
+	glm::mat4 view;
+	glm::mat4 projection;
+	// Camera position in xyz, w is unused
+	glm::vec4 camPos;
+	// Light position in xyz, w is unused
+	glm::vec4 lightPos;
+	glm::vec4 lightColor;
+	// Model matrix of the scene programs, the city's turn in the camera's passes and identity in the shadow and impostor
+	// views, which are rendered in model space. Per object transforms come with the instance records instead
+	glm::mat4 sceneModel = glm::mat4(1.0f);
+	// Height fog color in xyz and its density per unit at fogParams.y in w, 0 draws no fog
+	glm::vec4 fogColor = glm::vec4(0.0f);
+	// How fast the fog thins per unit of height, the height it has its density at, and in z the distance beyond
+	// which it hides everything, which the culling takes as its far plane, 0 without fog. w is unused
+	glm::vec4 fogParams = glm::vec4(0.0f);
+	// Emitters of the ParticleSystem: the weather falling around the camera in x, 0 for none, 1 rain and 2 snow, how many
+	// particles of it start per second in y and the wind in the world's x and z in zw
+	glm::vec4 weather = glm::vec4(0.0f);
+	// Smoke particles every chimney starts per second, the seconds the particles move this frame and a number that
+	// changes every frame for their random starts, and in w the height of the ground relative to the drawing origin
+	glm::vec4 particleParams = glm::vec4(0.0f);
+	// Projection * view of the left and the right eye in stereo, each for its half of the framebuffer
+	glm::mat4 eyeMatrices[2] = { glm::mat4(1.0f), glm::mat4(1.0f) };
+	// Direction towards the sun in world space in xyz, from TimeOfDay, w is unused
+	glm::vec4 sunDirection = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+	// Daylight the lit facades are scaled by in xyz, 1 keeps their baked colors, w is unused
+	glm::vec4 sunColor = glm::vec4(1.0f);
+};
+
+#endif
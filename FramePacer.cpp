@@ -0,0 +1,52 @@
+#include"FramePacer.h"
+
+#include<iostream>
+#include<thread>
+
+// Constructor that sets the present mode
+FramePacer::FramePacer(int swapInterval, double targetRate)
+{
+	FramePacer::swapInterval = swapInterval;
+	FramePacer::targetRate = targetRate;
+}
+
+// Sets the swap interval of the current context
+int FramePacer::Apply()
+{
+	// Negative intervals are only allowed with the tear extension of WGL or GLX, drivers reject them otherwise
+	if (swapInterval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") && !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+	{
+		std::cerr << "Adaptive vsync is not supported, using vsync" << std::endl;
+		swapInterval = 1;
+	}
+	glfwSwapInterval(swapInterval);
+	return swapInterval;
+}
+
+// Waits until the next frame is due
+void FramePacer::Wait()
+{
+	if (targetRate <= 0.0)
+		return;
+	Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetRate));
+	Clock::time_point now = Clock::now();
+	// A frame that is already late starts the schedule over instead of letting the next ones catch up
+	if (!started || now > nextFrame + period)
+	{
+		nextFrame = now;
+		started = true;
+	}
+	Clock::time_point wakeUp = nextFrame - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(spinSeconds));
+	if (now < wakeUp)
+		std::this_thread::sleep_for(wakeUp - now);
+	while (Clock::now() < nextFrame)
+	{
+	}
+	nextFrame += period;
+}
+
+// Time from reading the input of a frame until now
+float FramePacer::Presented(Clock::time_point inputTime) const
+{
+	return std::chrono::duration<float, std::milli>(Clock::now() - inputTime).count();
+}
@@ -0,0 +1,39 @@
+#ifndef FRAME_PACER_CLASS_H
+#define FRAME_PACER_CLASS_H
+
+#include<GLFW/glfw3.h>
+#include<chrono>
+
+// Decides how frames reach the display: the swap interval picks vsync, adaptive vsync or uncapped presents, and an
+// optional limiter holds a steady frame rate below the refresh rate. The limiter sleeps until shortly before a frame
+// is due and spins the rest, since sleeps wake up late by about a scheduler tick
+// It also measures the time from reading the input of a frame to presenting it, the latency a user feels
+class FramePacer
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// 0 presents at once, 1 or more waits for that many refreshes, -1 waits unless the frame is late (adaptive vsync)
+	int swapInterval;
+	// Frames per second the limiter holds, 0 turns it off
+	double targetRate;
+	// Time before a frame is due that the limiter stops sleeping and spins
+	double spinSeconds = 0.002;
+
+	// Constructor that sets the present mode, nothing changes before Apply
+	FramePacer(int swapInterval = 1, double targetRate = 0.0);
+
+	// Sets the swap interval of the current context, returns the one set
+	// Adaptive vsync needs EXT_swap_control_tear, without it the interval is 1
+	int Apply();
+	// Waits until the next frame is due, call right before presenting, returns at once without a limiter
+	void Wait();
+	// Time from reading the input of a frame until now, call right after presenting it, in milliseconds
+	float Presented(Clock::time_point inputTime) const;
+private:
+	// When the limiter lets the next frame through
+	Clock::time_point nextFrame;
+	bool started = false;
+};
+
+#endif
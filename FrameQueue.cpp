@@ -0,0 +1,31 @@
+#include"FrameQueue.h"
+
+// The slot to fill next, nullptr while the ring is full
+FramePacket* FrameQueue::Acquire()
+{
+	size_t head = published.load(std::memory_order_relaxed);
+	if (head - released.load(std::memory_order_acquire) >= CAPACITY)
+		return nullptr;
+	return &packets[head % CAPACITY];
+}
+
+// Makes the filled slot visible to the consumer
+void FrameQueue::Publish()
+{
+	published.store(published.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// The oldest published packet, nullptr while the ring is empty
+const FramePacket* FrameQueue::Peek()
+{
+	size_t tail = released.load(std::memory_order_relaxed);
+	if (published.load(std::memory_order_acquire) == tail)
+		return nullptr;
+	return &packets[tail % CAPACITY];
+}
+
+// Lets the producer reuse the packet that was read
+void FrameQueue::Release()
+{
+	released.store(released.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
@@ -0,0 +1,111 @@
+#ifndef FRAME_QUEUE_CLASS_H
+#define FRAME_QUEUE_CLASS_H
+
+#include<glm/glm.hpp>
+#include<atomic>
+#include<chrono>
+#include<cstddef>
+#include<cstdint>
+
+#include"CommandList.h"
+#include"FrameArena.h"
+#include"LabelLayout.h"
+#include"SceneSync.h"
+#include"TrafficSimulation.h"
+
+// Everything the render thread needs to know about one frame, filled by the simulation thread and only read once published
+struct FramePacket
+{
+	// Set on the last packet, the render thread stops when it reaches it
+	bool quit = false;
+	int frameIndex = 0;
+	// Seconds on the simulation clock the frame shows, and since the previous packet
+	double time = 0.0;
+	float deltaTime = 0.0f;
+	// When the simulation read the input the frame reacts to, the render thread measures the latency up to the present
+	std::chrono::steady_clock::time_point inputTime;
+	int framebufferWidth = 0;
+	int framebufferHeight = 0;
+	// Image of a batch export written from this frame, -1 for none
+	int image = -1;
+	// Set when the frame is saved as a screenshot once it is drawn
+	bool screenshot = false;
+	// Framebuffer pixel from the bottom left whose object the frame picks, negative for none
+	glm::ivec2 pick = glm::ivec2(-1);
+
+	// Camera and the city's model matrix
+	glm::vec3 position = glm::vec3(0.0f);
+	glm::vec3 front = glm::vec3(0.0f, 0.0f, -1.0f);
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 model = glm::mat4(1.0f);
+	// Projection of the frame, the same for every frame but those of poster tiles, which each show their own part of it
+	glm::mat4 projection = glm::mat4(1.0f);
+	// Point of the world the frame is drawn relative to, the camera itself for the streamed world, whose view then
+	// leaves out the camera's position, and the world's origin otherwise
+	glm::dvec3 origin = glm::dvec3(0.0);
+
+	// Switches the keys toggle
+	bool lightOn = true;
+	bool deferred = false;
+	bool ssao = false;
+	bool showProfiler = false;
+
+	// Transient data of the frame, reset when the simulation takes the packet again, so the render thread reads one
+	// packet's arena while the next frame fills the other
+	FrameArena arena;
+
+	// Buildings left after culling, in the order the render queue put them, allocated from the arena with room for all
+	// of them, only the first visibleCount are valid
+	uint32_t* visibleBuildings = nullptr;
+	size_t visibleCount = 0;
+	// Draws of the batches left after culling in the render queue's order, recorded by the workers into one list per
+	// slice from the arena
+	const CommandList* batchCommands = nullptr;
+	size_t batchCommandListCount = 0;
+	// Distance beyond which the height fog hides everything and nothing was kept, 0 when the frame has no fog
+	float fogDistance = 0.0f;
+	// Distance from the camera to the nearest of them in model space, set only when facades are streamed
+	float nearestBuilding = 0.0f;
+	// Time the simulation thread spent culling and sorting them, for the profiler
+	float cullMilliseconds = 0.0f;
+	float sortMilliseconds = 0.0f;
+	// Records of the traffic simulation's vehicles from the arena, the near ones drawn whole and the far ones as their
+	// body, in one run per slice of the loop that wrote them
+	const CompactInstance* nearVehicles = nullptr;
+	const CompactInstance* farVehicles = nullptr;
+	const TrafficSimulation::Slice* vehicleSlices = nullptr;
+	size_t vehicleSliceCount = 0;
+	// Building labels on the screen of the frame from the arena
+	const LabelLayout::Label* labels = nullptr;
+	size_t labelCount = 0;
+	// Buildings a collaborative session edited since the last frame from the arena, with every field set to where the
+	// building is now, already applied to the scene storage and the quadtree
+	const SceneSync::Edit* edits = nullptr;
+	size_t editCount = 0;
+};
+
+// Lock-free single producer, single consumer ring of frame packets between the simulation and the render thread
+// The producer fills the slot Acquire hands out and publishes it, the consumer reads the oldest published packet
+// and releases it when the frame is submitted. Packets are reused, so their arenas stop growing after a few frames.
+class FrameQueue
+{
+public:
+	// Packets the simulation may be ahead of the frame being rendered
+	static constexpr size_t CAPACITY = 2;
+
+	// Producer side: the slot to fill next, nullptr while every slot is still waiting to be rendered
+	FramePacket* Acquire();
+	// Producer side: hands the slot returned by Acquire to the consumer
+	void Publish();
+	// Consumer side: the oldest published packet, nullptr while there is none
+	const FramePacket* Peek();
+	// Consumer side: gives the packet returned by Peek back to the producer
+	void Release();
+private:
+	FramePacket packets[CAPACITY];
+	// Packets ever published and released, written by one side each and on their own cache lines
+	alignas(64) std::atomic<size_t> published{ 0 };
+	alignas(64) std::atomic<size_t> released{ 0 };
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include"FrameScheduler.h"
+
+#include<algorithm>
+#include<chrono>
+
+// Blocks on a fence until it is signaled, flushing the commands before it first
+static void waitFence(GLsync fence)
+{
+	GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	while (result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+}
+
+FrameScheduler::FrameScheduler(int framesInFlight)
+	: inFlight(std::clamp(framesInFlight, 1, MAX_FRAMES))
+{
+}
+
+// Deletes the fences unless Delete was already called
+FrameScheduler::~FrameScheduler()
+{
+	Delete();
+}
+
+// The frame framesInFlight back has to be done, so at most framesInFlight - 1 are left running beside this one
+void FrameScheduler::BeginFrame()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	if (current > (uint64_t)inFlight)
+		Wait(current - inFlight);
+	waited = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void FrameScheduler::EndFrame()
+{
+	GLsync& fence = fences[current % MAX_FRAMES];
+	// The frame MAX_FRAMES back was waited for by BeginFrame already, its fence is only still here if nothing asked
+	if (fence)
+		glDeleteSync(fence);
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	current++;
+}
+
+// The GPU finishes frames in order, so the fence of the frame asked for covers every frame before it
+void FrameScheduler::Wait(uint64_t frame)
+{
+	if (frame <= completed)
+		return;
+	if (frame >= current)
+	{
+		GLsync now = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		waitFence(now);
+		glDeleteSync(now);
+		frame = current - 1;
+	}
+	else if (frame + MAX_FRAMES >= current && fences[frame % MAX_FRAMES])
+		waitFence(fences[frame % MAX_FRAMES]);
+	for (uint64_t done = std::max(completed + 1, current > (uint64_t)MAX_FRAMES ? current - MAX_FRAMES : 1); done <= frame; done++)
+	{
+		GLsync& fence = fences[done % MAX_FRAMES];
+		if (fence)
+		{
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+	completed = std::max(completed, frame);
+}
+
+uint64_t FrameScheduler::frame() const
+{
+	return current;
+}
+
+int FrameScheduler::framesInFlight() const
+{
+	return inFlight;
+}
+
+float FrameScheduler::waitMilliseconds() const
+{
+	return waited;
+}
+
+// Deletes the fences
+void FrameScheduler::Delete()
+{
+	for (GLsync& fence : fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef FRAME_SCHEDULER_CLASS_H
+#define FRAME_SCHEDULER_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+
+// Bounds how many frames the CPU may have submitted that the GPU has not finished, with one fence per frame
+// Without it the driver queues frames as deep as it likes and a frame's input waits behind all of them, until it
+// blocks somewhere unpredictable such as a buffer map. BeginFrame waits for the frame framesInFlight frames back
+// instead, so 1 keeps the latency lowest and 3 lets the CPU run furthest ahead for the most throughput.
+// StreamBuffers handed the scheduler recycle their regions on its fences instead of fencing every region themselves.
+class FrameScheduler
+{
+public:
+	// Most frames in flight, the frames whose fences are kept
+	static constexpr int MAX_FRAMES = 3;
+
+	// Constructor for 1 to MAX_FRAMES frames in flight, nothing is fenced before the first EndFrame
+	FrameScheduler(int framesInFlight);
+	// Deletes the fences unless Delete was already called, the context has to still be current
+	~FrameScheduler();
+	// A FrameScheduler owns its fences, so it cannot be copied
+	FrameScheduler(const FrameScheduler&) = delete;
+	FrameScheduler& operator=(const FrameScheduler&) = delete;
+
+	// Waits until fewer than framesInFlight frames are on the GPU, call before the frame's first command
+	void BeginFrame();
+	// Fences the frame, call after its last command and before it is presented
+	void EndFrame();
+	// Blocks until the GPU finished a frame, at once for one already finished. The frame being recorded is fenced
+	// on the spot, which drains the GPU, so only a ring that wrapped within one frame ends up there
+	void Wait(uint64_t frame);
+
+	// Number of the frame being recorded, the first is 1
+	uint64_t frame() const;
+	int framesInFlight() const;
+	// Milliseconds BeginFrame blocked in the last frame
+	float waitMilliseconds() const;
+
+	// Deletes the fences, does nothing if they were already deleted
+	void Delete();
+private:
+	int inFlight;
+	uint64_t current = 1;
+	// Last frame the GPU is known to have finished
+	uint64_t completed = 0;
+	// Fence of every frame still in flight, by frame number modulo MAX_FRAMES
+	GLsync fences[MAX_FRAMES] = {};
+	float waited = 0.0f;
+};
+
+#endif
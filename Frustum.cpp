@@ -0,0 +1,162 @@
+#include"Frustum.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE 1
+#include<emmintrin.h>
+#endif
+
+// Adds a box and returns its index
+size_t BoundingBoxes::Add(const glm::vec3& min, const glm::vec3& max)
+{
+	minX.push_back(min.x); minY.push_back(min.y); minZ.push_back(min.z);
+	maxX.push_back(max.x); maxY.push_back(max.y); maxZ.push_back(max.z);
+	return minX.size() - 1;
+}
+
+// Removes every box
+void BoundingBoxes::Clear()
+{
+	minX.clear(); minY.clear(); minZ.clear();
+	maxX.clear(); maxY.clear(); maxZ.clear();
+}
+
+size_t BoundingBoxes::size() const
+{
+	return minX.size();
+}
+
+// Extracts the planes from a projection * view (* model) matrix
+void Frustum::Extract(const glm::mat4& matrix)
+{
+	// glm is column major, so row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+	glm::vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+	glm::vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+	glm::vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+	glm::vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+
+	planes[0] = row3 + row0;
+	planes[1] = row3 - row0;
+	planes[2] = row3 + row1;
+	planes[3] = row3 - row1;
+	planes[4] = row3 + row2;
+	planes[5] = row3 - row2;
+
+	// Normalizes the planes so that their distances are in world units
+	for (int i = 0; i < 6; i++)
+		planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+// Replaces the far plane with one distance ahead of the eye
+void Frustum::LimitDistance(const glm::vec3& eye, const glm::vec3& front, float distance)
+{
+	planes[5] = glm::vec4(-front, glm::dot(front, eye) + distance);
+}
+
+// Checks if a box is at least partly inside the frustum
+bool Frustum::TestBox(const glm::vec3& min, const glm::vec3& max) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		// The corner furthest along the plane normal is the last one to leave the plane
+		glm::vec3 corner
+		(
+			planes[i].x > 0.0f ? max.x : min.x,
+			planes[i].y > 0.0f ? max.y : min.y,
+			planes[i].z > 0.0f ? max.z : min.z
+		);
+		if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+// Checks if a box is completely inside the frustum
+bool Frustum::ContainsBox(const glm::vec3& min, const glm::vec3& max) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		// The corner closest along the plane normal is the first one to leave the plane
+		glm::vec3 corner
+		(
+			planes[i].x > 0.0f ? min.x : max.x,
+			planes[i].y > 0.0f ? min.y : max.y,
+			planes[i].z > 0.0f ? min.z : max.z
+		);
+		if (glm::dot(glm::vec3(planes[i]), corner) + planes[i].w < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+// Writes the index of every box that is at least partly inside the frustum
+size_t Frustum::Cull(const BoundingBoxes& boxes, uint32_t* visible) const
+{
+	return Cull(boxes, 0, boxes.size(), visible);
+}
+
+// Same for the boxes from first to first + count, such as one slice of them per worker
+size_t Frustum::Cull(const BoundingBoxes& boxes, size_t first, size_t count, uint32_t* visible) const
+{
+	size_t end = first + count;
+	size_t visibleCount = 0;
+	size_t i = first;
+
+	// Which corner is furthest along a plane only depends on the plane, so for every plane
+	// the same array is picked for all boxes and four boxes are tested with one instruction
+	const float* cornerX[6];
+	const float* cornerY[6];
+	const float* cornerZ[6];
+	for (int p = 0; p < 6; p++)
+	{
+		cornerX[p] = planes[p].x > 0.0f ? boxes.maxX.data() : boxes.minX.data();
+		cornerY[p] = planes[p].y > 0.0f ? boxes.maxY.data() : boxes.minY.data();
+		cornerZ[p] = planes[p].z > 0.0f ? boxes.maxZ.data() : boxes.minZ.data();
+	}
+
+#ifdef FRUSTUM_SSE
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= end; i += 4)
+	{
+		// Lanes stay set while the box is inside every plane tested so far
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps
+			(
+				_mm_add_ps(_mm_mul_ps(planeX[p], _mm_loadu_ps(cornerX[p] + i)), _mm_mul_ps(planeY[p], _mm_loadu_ps(cornerY[p] + i))),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], _mm_loadu_ps(cornerZ[p] + i)), planeW[p])
+			);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+		}
+		int mask = _mm_movemask_ps(inside);
+		// Compacts the visible lanes into the output without branching on each one
+		visible[visibleCount] = (uint32_t)i;
+		visibleCount += mask & 1;
+		visible[visibleCount] = (uint32_t)i + 1;
+		visibleCount += (mask >> 1) & 1;
+		visible[visibleCount] = (uint32_t)i + 2;
+		visibleCount += (mask >> 2) & 1;
+		visible[visibleCount] = (uint32_t)i + 3;
+		visibleCount += (mask >> 3) & 1;
+	}
+#endif
+
+	// Scalar path for the remaining boxes, or all of them without SSE
+	for (; i < end; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++)
+			inside = planes[p].x * cornerX[p][i] + planes[p].y * cornerY[p][i] + planes[p].z * cornerZ[p][i] + planes[p].w >= 0.0f;
+		if (inside)
+			visible[visibleCount++] = (uint32_t)i;
+	}
+	return visibleCount;
+}
@@ -0,0 +1,46 @@
+#ifndef FRUSTUM_CLASS_H
+#define FRUSTUM_CLASS_H
+
+#include<glm/glm.hpp>
+#include<vector>
+#include<cstddef>
+#include<cstdint>
+
+// Axis aligned bounding boxes stored as a structure of arrays so culling can test several at once
+class BoundingBoxes
+{
+public:
+	std::vector<float> minX, minY, minZ;
+	std::vector<float> maxX, maxY, maxZ;
+
+	// Adds a box and returns its index
+	size_t Add(const glm::vec3& min, const glm::vec3& max);
+	// Removes every box
+	void Clear();
+	// Number of boxes stored
+	size_t size() const;
+};
+
+// The six planes of a view frustum, a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+class Frustum
+{
+public:
+	// Left, right, bottom, top, near and far planes
+	glm::vec4 planes[6];
+
+	// Extracts the planes from a projection * view (* model) matrix, they end up in the space the matrix transforms from
+	void Extract(const glm::mat4& matrix);
+	// Replaces the far plane with one distance ahead of eye along the unit direction front, in the space of the planes
+	// With a reverse-Z projection that plane is the near one, nothing is lost since the side planes meet at the eye
+	void LimitDistance(const glm::vec3& eye, const glm::vec3& front, float distance);
+	// Checks if a box is at least partly inside the frustum
+	bool TestBox(const glm::vec3& min, const glm::vec3& max) const;
+	// Checks if a box is completely inside the frustum
+	bool ContainsBox(const glm::vec3& min, const glm::vec3& max) const;
+	// Writes the index of every box that is at least partly inside the frustum and returns how many there are
+	size_t Cull(const BoundingBoxes& boxes, uint32_t* visible) const;
+	// Same for the boxes from first to first + count, the indices written are still those of the whole set
+	size_t Cull(const BoundingBoxes& boxes, size_t first, size_t count, uint32_t* visible) const;
+};
+
+#endif
@@ -0,0 +1,226 @@
+#include"GLDebugOutput.h"
+#include"GLStateCache.h"
+
+#include<algorithm>
+#include<iostream>
+#include<sstream>
+
+GLDebugOutput GLDebug;
+
+// Installs the callback
+bool GLDebugOutput::Enable(bool synchronous)
+{
+	if (!GLExt.debugOutput)
+		return false;
+	glEnable(GL_DEBUG_OUTPUT);
+	if (synchronous)
+		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glDebugMessageCallback(callback, this);
+	// Notifications include the groups pushed below, they would drown everything else
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+	enabled = true;
+	return true;
+}
+
+// Removes the callback
+void GLDebugOutput::Disable()
+{
+	if (!enabled)
+		return;
+	glDebugMessageCallback(nullptr, nullptr);
+	glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glDisable(GL_DEBUG_OUTPUT);
+	enabled = false;
+}
+
+// Names an object
+void GLDebugOutput::Label(GLenum identifier, GLuint name, const char* label)
+{
+	if (GLExt.debugOutput && name != 0)
+		glObjectLabel(identifier, name, -1, label);
+}
+
+void GLDebugOutput::Label(GLenum identifier, GLuint name, const std::string& label)
+{
+	Label(identifier, name, label.c_str());
+}
+
+// Opens a named group of calls
+void GLDebugOutput::PushGroup(const char* name)
+{
+	if (enabled)
+		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+}
+
+// Closes the group opened last
+void GLDebugOutput::PopGroup()
+{
+	if (enabled)
+		glPopDebugGroup();
+}
+
+// Copies of the latest messages, oldest first
+std::vector<GLDebugOutput::Message> GLDebugOutput::Messages()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (ring.size() < HISTORY)
+		return ring;
+	std::vector<Message> ordered(ring.begin() + next, ring.end());
+	ordered.insert(ordered.end(), ring.begin(), ring.begin() + next);
+	return ordered;
+}
+
+// Copies of the counts, most frequent first
+std::vector<GLDebugOutput::Count> GLDebugOutput::Counts()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<Count> sorted = counts;
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Count& a, const Count& b) { return a.count > b.count; });
+	return sorted;
+}
+
+// Number of errors reported so far
+size_t GLDebugOutput::errors()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return errorCount;
+}
+
+// Number of performance warnings reported so far
+size_t GLDebugOutput::performanceWarnings()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return performanceCount;
+}
+
+// Short line with the number of errors and performance warnings
+std::string GLDebugOutput::Summary()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (errorCount == 0 && performanceCount == 0)
+		return std::string();
+	std::ostringstream out;
+	out << errorCount << " GL errors, " << performanceCount << " performance warnings";
+	return out.str();
+}
+
+// Draws a block per message ID along the bottom left of the framebuffer
+void GLDebugOutput::DrawOverlay(int width, int height)
+{
+	std::vector<Count> sorted = Counts();
+	if (sorted.empty())
+		return;
+	// Scissored clears like the profiler's bars
+	GLfloat clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+	GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+	GLState.Enable(GL_SCISSOR_TEST);
+
+	const int blockHeight = 8;
+	int x = 10;
+	for (const Count& count : sorted)
+	{
+		int blockWidth = 4;
+		for (size_t n = count.count; n > 1 && blockWidth < 64; n /= 2)
+			blockWidth += 4;
+		if (x + blockWidth > width - 10 || blockHeight + 10 > height)
+			break;
+		if (count.latest.type == GL_DEBUG_TYPE_ERROR)
+			glClearColor(1.0f, 0.15f, 0.1f, 1.0f);
+		else if (count.latest.type == GL_DEBUG_TYPE_PERFORMANCE)
+			glClearColor(1.0f, 0.85f, 0.1f, 1.0f);
+		else
+			glClearColor(0.6f, 0.6f, 0.6f, 1.0f);
+		glScissor(x, 10, blockWidth, blockHeight);
+		glClear(GL_COLOR_BUFFER_BIT);
+		x += blockWidth + 2;
+	}
+
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	if (!scissor)
+		GLState.Disable(GL_SCISSOR_TEST);
+}
+
+// Forgets every message and count
+void GLDebugOutput::Clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	ring.clear();
+	next = 0;
+	counts.clear();
+	errorCount = performanceCount = 0;
+}
+
+// Name of a message source
+const char* GLDebugOutput::SourceName(GLenum source)
+{
+	switch (source)
+	{
+	case GL_DEBUG_SOURCE_API: return "api";
+	case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+	case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+	case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+	case GL_DEBUG_SOURCE_APPLICATION: return "application";
+	default: return "other";
+	}
+}
+
+// Name of a message type
+const char* GLDebugOutput::TypeName(GLenum type)
+{
+	switch (type)
+	{
+	case GL_DEBUG_TYPE_ERROR: return "error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+	case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+	case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+	case GL_DEBUG_TYPE_MARKER: return "marker";
+	default: return "other";
+	}
+}
+
+// Called by the driver for every message
+void APIENTRY GLDebugOutput::callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* user)
+{
+	std::string text = length < 0 ? std::string(message) : std::string(message, (size_t)length);
+	// The callback was installed with the collector itself, which is not const
+	((GLDebugOutput*)user)->record(source, type, id, severity, text);
+}
+
+// Files a message
+void GLDebugOutput::record(GLenum source, GLenum type, GLuint id, GLenum severity, const std::string& text)
+{
+	Message entry = { source, type, id, severity, text };
+	bool first = false;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (ring.size() < HISTORY)
+			ring.push_back(entry);
+		else
+			ring[next] = entry;
+		next = (next + 1) % HISTORY;
+		if (type == GL_DEBUG_TYPE_ERROR)
+			errorCount++;
+		else if (type == GL_DEBUG_TYPE_PERFORMANCE)
+			performanceCount++;
+
+		auto it = std::find_if(counts.begin(), counts.end(), [&](const Count& count) {
+			return count.latest.id == id && count.latest.source == source && count.latest.type == type;
+		});
+		if (it == counts.end())
+		{
+			counts.push_back({ entry, 1 });
+			first = true;
+		}
+		else
+		{
+			it->latest = entry;
+			it->count++;
+		}
+	}
+	// Each ID is printed once, the counts keep track of how often it came after that
+	if (first && (type == GL_DEBUG_TYPE_ERROR || severity == GL_DEBUG_SEVERITY_HIGH || severity == GL_DEBUG_SEVERITY_MEDIUM || type == GL_DEBUG_TYPE_PERFORMANCE))
+		std::cerr << "GL " << SourceName(source) << " " << TypeName(type) << " " << id << ": " << text << std::endl;
+}
@@ -0,0 +1,90 @@
+#ifndef GL_DEBUG_OUTPUT_CLASS_H
+#define GL_DEBUG_OUTPUT_CLASS_H
+
+#include<glad/glad.h>
+#include<mutex>
+#include<string>
+#include<vector>
+
+#include"GLExtensions.h"
+
+// Collects what the driver reports through KHR_debug: API errors, performance warnings such as buffers moved between
+// memory kinds, shaders recompiled for new state or implicit syncs, and whatever else it has to say
+// The driver may call back from a thread of its own, so messages land in a ring of the latest ones under a lock, next
+// to a count per message ID. Labels and debug groups name the objects and passes in GPU captures and messages.
+// Everything does nothing without GLExt.debugOutput.
+class GLDebugOutput
+{
+public:
+	// Number of latest messages kept
+	static constexpr size_t HISTORY = 64;
+
+	// One message as the driver reported it
+	struct Message
+	{
+		GLenum source;
+		GLenum type;
+		GLuint id;
+		GLenum severity;
+		std::string text;
+	};
+	// Number of times a message ID of a source and type came, with the latest text it came with
+	struct Count
+	{
+		Message latest;
+		size_t count;
+	};
+
+	// Set while the callback is installed, debug groups are only pushed then
+	bool enabled = false;
+
+	// Installs the callback for everything but notifications, synchronous delivers every message inside the call
+	// that caused it so a debugger stops there, at the cost of the driver's threading. Returns false without KHR_debug
+	// Only debug contexts are guaranteed to report anything
+	bool Enable(bool synchronous = false);
+	// Removes the callback
+	void Disable();
+
+	// Names an object for debuggers and messages, labels are applied whenever the extension is there
+	void Label(GLenum identifier, GLuint name, const char* label);
+	void Label(GLenum identifier, GLuint name, const std::string& label);
+	// Opens and closes a named group of calls
+	void PushGroup(const char* name);
+	void PopGroup();
+
+	// Copies of the latest messages, oldest first, and of the counts, most frequent first
+	std::vector<Message> Messages();
+	std::vector<Count> Counts();
+	// Number of errors and of performance warnings reported so far
+	size_t errors();
+	size_t performanceWarnings();
+	// Short line with the numbers above, empty while nothing was reported
+	std::string Summary();
+	// Draws a block per message ID along the bottom left of the framebuffer, red for errors, yellow for
+	// performance warnings and gray for the rest, 4 pixels wider for every doubling of its count
+	void DrawOverlay(int width, int height);
+	// Forgets every message and count
+	void Clear();
+
+	// Names of message enums for printing
+	static const char* SourceName(GLenum source);
+	static const char* TypeName(GLenum type);
+private:
+	std::mutex mutex;
+	// Ring of the latest messages, next is where the one after them goes
+	std::vector<Message> ring;
+	size_t next = 0;
+	std::vector<Count> counts;
+	size_t errorCount = 0;
+	size_t performanceCount = 0;
+
+	// Called by the driver for every message
+	static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* user);
+	// Files a message, and prints an error or warning the first time its ID comes
+	void record(GLenum source, GLenum type, GLuint id, GLenum severity, const std::string& text);
+};
+
+// The driver's messages of the one context the engine renders with
+extern GLDebugOutput GLDebug;
+
+#endif
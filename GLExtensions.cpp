@@ -0,0 +1,240 @@
+#include"GLExtensions.h"
+
+#include<string>
+#include<unordered_set>
+
+PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary = nullptr;
+PFNGLPROGRAMBINARYPROC glext_glProgramBinary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri = nullptr;
+PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR = nullptr;
+PFNGLCREATESHADERPROGRAMVPROC glext_glCreateShaderProgramv = nullptr;
+PFNGLGENPROGRAMPIPELINESPROC glext_glGenProgramPipelines = nullptr;
+PFNGLDELETEPROGRAMPIPELINESPROC glext_glDeleteProgramPipelines = nullptr;
+PFNGLBINDPROGRAMPIPELINEPROC glext_glBindProgramPipeline = nullptr;
+PFNGLUSEPROGRAMSTAGESPROC glext_glUseProgramStages = nullptr;
+PFNGLPROGRAMUNIFORM1IPROC glext_glProgramUniform1i = nullptr;
+PFNGLPROGRAMUNIFORM1FPROC glext_glProgramUniform1f = nullptr;
+PFNGLPROGRAMUNIFORM3FVPROC glext_glProgramUniform3fv = nullptr;
+PFNGLPROGRAMUNIFORM4FVPROC glext_glProgramUniform4fv = nullptr;
+PFNGLPROGRAMUNIFORMMATRIX4FVPROC glext_glProgramUniformMatrix4fv = nullptr;
+PFNGLSHADERBINARYPROC glext_glShaderBinary = nullptr;
+PFNGLSPECIALIZESHADERPROC glext_glSpecializeShader = nullptr;
+PFNGLTEXSTORAGE2DPROC glext_glTexStorage2D = nullptr;
+PFNGLTEXSTORAGE3DPROC glext_glTexStorage3D = nullptr;
+PFNGLBUFFERSTORAGEPROC glext_glBufferStorage = nullptr;
+PFNGLDRAWARRAYSINDIRECTPROC glext_glDrawArraysIndirect = nullptr;
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glext_glMultiDrawElementsIndirect = nullptr;
+PFNGLMULTIDRAWARRAYSINDIRECTPROC glext_glMultiDrawArraysIndirect = nullptr;
+PFNGLDISPATCHCOMPUTEPROC glext_glDispatchCompute = nullptr;
+PFNGLDISPATCHCOMPUTEINDIRECTPROC glext_glDispatchComputeIndirect = nullptr;
+PFNGLMEMORYBARRIERPROC glext_glMemoryBarrier = nullptr;
+PFNGLBINDIMAGETEXTUREPROC glext_glBindImageTexture = nullptr;
+PFNGLVERTEXATTRIBFORMATPROC glext_glVertexAttribFormat = nullptr;
+PFNGLVERTEXATTRIBBINDINGPROC glext_glVertexAttribBinding = nullptr;
+PFNGLBINDVERTEXBUFFERPROC glext_glBindVertexBuffer = nullptr;
+PFNGLVERTEXBINDINGDIVISORPROC glext_glVertexBindingDivisor = nullptr;
+PFNGLCREATEBUFFERSPROC glext_glCreateBuffers = nullptr;
+PFNGLNAMEDBUFFERSTORAGEPROC glext_glNamedBufferStorage = nullptr;
+PFNGLNAMEDBUFFERSUBDATAPROC glext_glNamedBufferSubData = nullptr;
+PFNGLCREATEVERTEXARRAYSPROC glext_glCreateVertexArrays = nullptr;
+PFNGLVERTEXARRAYVERTEXBUFFERPROC glext_glVertexArrayVertexBuffer = nullptr;
+PFNGLVERTEXARRAYATTRIBFORMATPROC glext_glVertexArrayAttribFormat = nullptr;
+PFNGLVERTEXARRAYATTRIBBINDINGPROC glext_glVertexArrayAttribBinding = nullptr;
+PFNGLVERTEXARRAYBINDINGDIVISORPROC glext_glVertexArrayBindingDivisor = nullptr;
+PFNGLENABLEVERTEXARRAYATTRIBPROC glext_glEnableVertexArrayAttrib = nullptr;
+PFNGLVERTEXARRAYELEMENTBUFFERPROC glext_glVertexArrayElementBuffer = nullptr;
+PFNGLCLIPCONTROLPROC glext_glClipControl = nullptr;
+PFNGLDEBUGMESSAGECALLBACKPROC glext_glDebugMessageCallback = nullptr;
+PFNGLDEBUGMESSAGECONTROLPROC glext_glDebugMessageControl = nullptr;
+PFNGLOBJECTLABELPROC glext_glObjectLabel = nullptr;
+PFNGLPUSHDEBUGGROUPPROC glext_glPushDebugGroup = nullptr;
+PFNGLPOPDEBUGGROUPPROC glext_glPopDebugGroup = nullptr;
+PFNGLGETTEXTUREHANDLEARBPROC glext_glGetTextureHandleARB = nullptr;
+PFNGLGETTEXTURESAMPLERHANDLEARBPROC glext_glGetTextureSamplerHandleARB = nullptr;
+PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glext_glMakeTextureHandleResidentARB = nullptr;
+PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glext_glMakeTextureHandleNonResidentARB = nullptr;
+PFNGLBINDSHADINGRATEIMAGENVPROC glext_glBindShadingRateImageNV = nullptr;
+PFNGLSHADINGRATEIMAGEPALETTENVPROC glext_glShadingRateImagePaletteNV = nullptr;
+
+GLExtensions GLExt;
+
+// Checks if the context is at least a given version
+static bool hasVersion(int major, int minor)
+{
+	return GLExt.major > major || (GLExt.major == major && GLExt.minor >= minor);
+}
+
+// Names the driver reported when GLExt was filled, glGetStringi is asked once per extension rather than once per check
+static std::unordered_set<std::string> extensions;
+
+// Checks if the driver reports an extension
+bool HasGLExtension(const char* name)
+{
+	return extensions.count(name) > 0;
+}
+
+// Loads the entry points and fills GLExt
+void LoadGLExtensions(GLADloadproc load)
+{
+	GLExt = GLExtensions();
+	GLExt.major = GLVersion.major;
+	GLExt.minor = GLVersion.minor;
+	extensions.clear();
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+	for (GLint i = 0; i < count; i++)
+	{
+		const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+		if (extension)
+			extensions.insert(extension);
+	}
+
+	// Drivers may expose the entry points but no format they can save programs in
+	if (hasVersion(4, 1) || HasGLExtension("GL_ARB_get_program_binary"))
+	{
+		glext_glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)load("glGetProgramBinary");
+		glext_glProgramBinary = (PFNGLPROGRAMBINARYPROC)load("glProgramBinary");
+		glext_glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)load("glProgramParameteri");
+	}
+	GLint binaryFormats = 0;
+	if (glext_glGetProgramBinary && glext_glProgramBinary && glext_glProgramParameteri)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+	GLExt.programBinary = binaryFormats > 0;
+
+	if (HasGLExtension("GL_KHR_parallel_shader_compile"))
+		glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsKHR");
+	else if (HasGLExtension("GL_ARB_parallel_shader_compile"))
+		glext_glMaxShaderCompilerThreadsKHR = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)load("glMaxShaderCompilerThreadsARB");
+	GLExt.parallelShaderCompile = glext_glMaxShaderCompilerThreadsKHR != nullptr;
+	// Lets the driver pick how many compiler threads to use
+	if (GLExt.parallelShaderCompile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+
+	if (hasVersion(4, 1) || HasGLExtension("GL_ARB_separate_shader_objects"))
+	{
+		glext_glCreateShaderProgramv = (PFNGLCREATESHADERPROGRAMVPROC)load("glCreateShaderProgramv");
+		glext_glGenProgramPipelines = (PFNGLGENPROGRAMPIPELINESPROC)load("glGenProgramPipelines");
+		glext_glDeleteProgramPipelines = (PFNGLDELETEPROGRAMPIPELINESPROC)load("glDeleteProgramPipelines");
+		glext_glBindProgramPipeline = (PFNGLBINDPROGRAMPIPELINEPROC)load("glBindProgramPipeline");
+		glext_glUseProgramStages = (PFNGLUSEPROGRAMSTAGESPROC)load("glUseProgramStages");
+		glext_glProgramUniform1i = (PFNGLPROGRAMUNIFORM1IPROC)load("glProgramUniform1i");
+		glext_glProgramUniform1f = (PFNGLPROGRAMUNIFORM1FPROC)load("glProgramUniform1f");
+		glext_glProgramUniform3fv = (PFNGLPROGRAMUNIFORM3FVPROC)load("glProgramUniform3fv");
+		glext_glProgramUniform4fv = (PFNGLPROGRAMUNIFORM4FVPROC)load("glProgramUniform4fv");
+		glext_glProgramUniformMatrix4fv = (PFNGLPROGRAMUNIFORMMATRIX4FVPROC)load("glProgramUniformMatrix4fv");
+	}
+	GLExt.separateShaderObjects = glext_glCreateShaderProgramv && glext_glGenProgramPipelines && glext_glDeleteProgramPipelines
+		&& glext_glBindProgramPipeline && glext_glUseProgramStages && glext_glProgramUniform1i && glext_glProgramUniform1f
+		&& glext_glProgramUniform3fv && glext_glProgramUniform4fv && glext_glProgramUniformMatrix4fv;
+
+	// The ARB entry point of glSpecializeShader carries the suffix
+	if (hasVersion(4, 6))
+	{
+		glext_glShaderBinary = (PFNGLSHADERBINARYPROC)load("glShaderBinary");
+		glext_glSpecializeShader = (PFNGLSPECIALIZESHADERPROC)load("glSpecializeShader");
+	}
+	else if (HasGLExtension("GL_ARB_gl_spirv"))
+	{
+		glext_glShaderBinary = (PFNGLSHADERBINARYPROC)load("glShaderBinary");
+		glext_glSpecializeShader = (PFNGLSPECIALIZESHADERPROC)load("glSpecializeShaderARB");
+	}
+	GLExt.spirv = glext_glShaderBinary && glext_glSpecializeShader;
+
+	if (hasVersion(4, 2) || HasGLExtension("GL_ARB_texture_storage"))
+	{
+		glext_glTexStorage2D = (PFNGLTEXSTORAGE2DPROC)load("glTexStorage2D");
+		glext_glTexStorage3D = (PFNGLTEXSTORAGE3DPROC)load("glTexStorage3D");
+	}
+	GLExt.textureStorage = glext_glTexStorage2D && glext_glTexStorage3D;
+
+	if (hasVersion(4, 4) || HasGLExtension("GL_ARB_buffer_storage"))
+		glext_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+	GLExt.bufferStorage = glext_glBufferStorage != nullptr;
+
+	// The extension alone is not enough, base instances in the commands also need GL 4.2 or ARB_base_instance
+	if (hasVersion(4, 3) || (HasGLExtension("GL_ARB_multi_draw_indirect") && (hasVersion(4, 2) || HasGLExtension("GL_ARB_base_instance"))))
+	{
+		glext_glDrawArraysIndirect = (PFNGLDRAWARRAYSINDIRECTPROC)load("glDrawArraysIndirect");
+		glext_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+		glext_glMultiDrawArraysIndirect = (PFNGLMULTIDRAWARRAYSINDIRECTPROC)load("glMultiDrawArraysIndirect");
+	}
+	GLExt.multiDrawIndirect = glext_glDrawArraysIndirect && glext_glMultiDrawElementsIndirect && glext_glMultiDrawArraysIndirect;
+
+	GLExt.shaderStorage = hasVersion(4, 3) || HasGLExtension("GL_ARB_shader_storage_buffer_object");
+
+	if (hasVersion(4, 3))
+	{
+		glext_glDispatchCompute = (PFNGLDISPATCHCOMPUTEPROC)load("glDispatchCompute");
+		glext_glDispatchComputeIndirect = (PFNGLDISPATCHCOMPUTEINDIRECTPROC)load("glDispatchComputeIndirect");
+		glext_glMemoryBarrier = (PFNGLMEMORYBARRIERPROC)load("glMemoryBarrier");
+		glext_glBindImageTexture = (PFNGLBINDIMAGETEXTUREPROC)load("glBindImageTexture");
+	}
+	GLExt.computeShader = glext_glDispatchCompute && glext_glDispatchComputeIndirect && glext_glMemoryBarrier && glext_glBindImageTexture;
+
+	if (hasVersion(4, 3) || HasGLExtension("GL_ARB_vertex_attrib_binding"))
+	{
+		glext_glVertexAttribFormat = (PFNGLVERTEXATTRIBFORMATPROC)load("glVertexAttribFormat");
+		glext_glVertexAttribBinding = (PFNGLVERTEXATTRIBBINDINGPROC)load("glVertexAttribBinding");
+		glext_glBindVertexBuffer = (PFNGLBINDVERTEXBUFFERPROC)load("glBindVertexBuffer");
+		glext_glVertexBindingDivisor = (PFNGLVERTEXBINDINGDIVISORPROC)load("glVertexBindingDivisor");
+	}
+	GLExt.vertexAttribBinding = glext_glVertexAttribFormat && glext_glVertexAttribBinding && glext_glBindVertexBuffer && glext_glVertexBindingDivisor;
+
+	// Named buffer storage only exists next to glBufferStorage
+	if (GLExt.bufferStorage && (hasVersion(4, 5) || HasGLExtension("GL_ARB_direct_state_access")))
+	{
+		glext_glCreateBuffers = (PFNGLCREATEBUFFERSPROC)load("glCreateBuffers");
+		glext_glNamedBufferStorage = (PFNGLNAMEDBUFFERSTORAGEPROC)load("glNamedBufferStorage");
+		glext_glNamedBufferSubData = (PFNGLNAMEDBUFFERSUBDATAPROC)load("glNamedBufferSubData");
+		glext_glCreateVertexArrays = (PFNGLCREATEVERTEXARRAYSPROC)load("glCreateVertexArrays");
+		glext_glVertexArrayVertexBuffer = (PFNGLVERTEXARRAYVERTEXBUFFERPROC)load("glVertexArrayVertexBuffer");
+		glext_glVertexArrayAttribFormat = (PFNGLVERTEXARRAYATTRIBFORMATPROC)load("glVertexArrayAttribFormat");
+		glext_glVertexArrayAttribBinding = (PFNGLVERTEXARRAYATTRIBBINDINGPROC)load("glVertexArrayAttribBinding");
+		glext_glVertexArrayBindingDivisor = (PFNGLVERTEXARRAYBINDINGDIVISORPROC)load("glVertexArrayBindingDivisor");
+		glext_glEnableVertexArrayAttrib = (PFNGLENABLEVERTEXARRAYATTRIBPROC)load("glEnableVertexArrayAttrib");
+		glext_glVertexArrayElementBuffer = (PFNGLVERTEXARRAYELEMENTBUFFERPROC)load("glVertexArrayElementBuffer");
+	}
+	GLExt.directStateAccess = glext_glCreateBuffers && glext_glNamedBufferStorage && glext_glNamedBufferSubData && glext_glCreateVertexArrays && glext_glVertexArrayVertexBuffer
+		&& glext_glVertexArrayAttribFormat && glext_glVertexArrayAttribBinding && glext_glVertexArrayBindingDivisor && glext_glEnableVertexArrayAttrib && glext_glVertexArrayElementBuffer;
+
+	if (hasVersion(4, 5) || HasGLExtension("GL_ARB_clip_control"))
+		glext_glClipControl = (PFNGLCLIPCONTROLPROC)load("glClipControl");
+	GLExt.clipControl = glext_glClipControl != nullptr;
+
+	if (hasVersion(4, 3) || HasGLExtension("GL_KHR_debug"))
+	{
+		glext_glDebugMessageCallback = (PFNGLDEBUGMESSAGECALLBACKPROC)load("glDebugMessageCallback");
+		glext_glDebugMessageControl = (PFNGLDEBUGMESSAGECONTROLPROC)load("glDebugMessageControl");
+		glext_glObjectLabel = (PFNGLOBJECTLABELPROC)load("glObjectLabel");
+		glext_glPushDebugGroup = (PFNGLPUSHDEBUGGROUPPROC)load("glPushDebugGroup");
+		glext_glPopDebugGroup = (PFNGLPOPDEBUGGROUPPROC)load("glPopDebugGroup");
+	}
+	GLExt.debugOutput = glext_glDebugMessageCallback && glext_glDebugMessageControl && glext_glObjectLabel && glext_glPushDebugGroup && glext_glPopDebugGroup;
+
+	// Handles are only useful when a shader can read them from a storage buffer
+	if (GLExt.shaderStorage && HasGLExtension("GL_ARB_bindless_texture"))
+	{
+		glext_glGetTextureHandleARB = (PFNGLGETTEXTUREHANDLEARBPROC)load("glGetTextureHandleARB");
+		glext_glGetTextureSamplerHandleARB = (PFNGLGETTEXTURESAMPLERHANDLEARBPROC)load("glGetTextureSamplerHandleARB");
+		glext_glMakeTextureHandleResidentARB = (PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)load("glMakeTextureHandleResidentARB");
+		glext_glMakeTextureHandleNonResidentARB = (PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)load("glMakeTextureHandleNonResidentARB");
+	}
+	GLExt.bindlessTexture = glext_glGetTextureHandleARB && glext_glGetTextureSamplerHandleARB && glext_glMakeTextureHandleResidentARB && glext_glMakeTextureHandleNonResidentARB;
+
+	GLExt.textureS3TC = HasGLExtension("GL_EXT_texture_compression_s3tc");
+	GLExt.textureS3TCsRGB = GLExt.textureS3TC && (HasGLExtension("GL_EXT_texture_sRGB") || HasGLExtension("GL_EXT_texture_compression_s3tc_srgb"));
+	GLExt.textureBPTC = hasVersion(4, 2) || HasGLExtension("GL_ARB_texture_compression_bptc");
+	GLExt.textureASTC = HasGLExtension("GL_KHR_texture_compression_astc_ldr");
+	GLExt.anisotropicFilter = hasVersion(4, 6) || HasGLExtension("GL_EXT_texture_filter_anisotropic") || HasGLExtension("GL_ARB_texture_filter_anisotropic");
+
+	GLExt.nvxMemoryInfo = HasGLExtension("GL_NVX_gpu_memory_info");
+	GLExt.atiMemInfo = HasGLExtension("GL_ATI_meminfo");
+	GLExt.pipelineStatistics = hasVersion(4, 6) || HasGLExtension("GL_ARB_pipeline_statistics_query");
+
+	if (GLExt.computeShader && GLExt.textureStorage && HasGLExtension("GL_NV_shading_rate_image"))
+	{
+		glext_glBindShadingRateImageNV = (PFNGLBINDSHADINGRATEIMAGENVPROC)load("glBindShadingRateImageNV");
+		glext_glShadingRateImagePaletteNV = (PFNGLSHADINGRATEIMAGEPALETTENVPROC)load("glShadingRateImagePaletteNV");
+	}
+	GLExt.shadingRateImage = glext_glBindShadingRateImageNV && glext_glShadingRateImagePaletteNV;
+}
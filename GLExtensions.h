@@ -0,0 +1,411 @@
+#ifndef GL_EXTENSIONS_CLASS_H
+#define GL_EXTENSIONS_CLASS_H
+
+#include<glad/glad.h>
+
+// glad was generated for the GL 3.3 core profile, newer entry points used by the engine are declared here
+// and loaded at runtime. They stay null when the driver does not provide them, so anything using them
+// has to check the matching flag in GLExt and keep a GL 3.3 path.
+
+#ifndef GL_VERSION_4_1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+#endif
+extern PFNGLGETPROGRAMBINARYPROC glext_glGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC glext_glProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC glext_glProgramParameteri;
+#define glGetProgramBinary glext_glGetProgramBinary
+#define glProgramBinary glext_glProgramBinary
+#define glProgramParameteri glext_glProgramParameteri
+
+// Shaders handed to the driver as SPIR-V instead of GLSL text (GL 4.6 or ARB_gl_spirv), glShaderBinary itself is GL 4.1
+#ifndef GL_VERSION_4_1
+typedef void (APIENTRYP PFNGLSHADERBINARYPROC)(GLsizei count, const GLuint* shaders, GLenum binaryformat, const void* binary, GLsizei length);
+#endif
+#ifndef GL_VERSION_4_6
+#define GL_SHADER_BINARY_FORMAT_SPIR_V 0x9551
+#define GL_SPIR_V_BINARY 0x9552
+typedef void (APIENTRYP PFNGLSPECIALIZESHADERPROC)(GLuint shader, const GLchar* pEntryPoint, GLuint numSpecializationConstants, const GLuint* pConstantIndex, const GLuint* pConstantValue);
+#endif
+extern PFNGLSHADERBINARYPROC glext_glShaderBinary;
+extern PFNGLSPECIALIZESHADERPROC glext_glSpecializeShader;
+#define glShaderBinary glext_glShaderBinary
+#define glSpecializeShader glext_glSpecializeShader
+
+// Separable programs of single stages combined in program pipelines (GL 4.1 or ARB_separate_shader_objects)
+#ifndef GL_VERSION_4_1
+#define GL_VERTEX_SHADER_BIT 0x00000001
+#define GL_FRAGMENT_SHADER_BIT 0x00000002
+#define GL_PROGRAM_SEPARABLE 0x8258
+typedef GLuint (APIENTRYP PFNGLCREATESHADERPROGRAMVPROC)(GLenum type, GLsizei count, const GLchar* const* strings);
+typedef void (APIENTRYP PFNGLGENPROGRAMPIPELINESPROC)(GLsizei n, GLuint* pipelines);
+typedef void (APIENTRYP PFNGLDELETEPROGRAMPIPELINESPROC)(GLsizei n, const GLuint* pipelines);
+typedef void (APIENTRYP PFNGLBINDPROGRAMPIPELINEPROC)(GLuint pipeline);
+typedef void (APIENTRYP PFNGLUSEPROGRAMSTAGESPROC)(GLuint pipeline, GLbitfield stages, GLuint program);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM1IPROC)(GLuint program, GLint location, GLint v0);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM1FPROC)(GLuint program, GLint location, GLfloat v0);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM3FVPROC)(GLuint program, GLint location, GLsizei count, const GLfloat* value);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORM4FVPROC)(GLuint program, GLint location, GLsizei count, const GLfloat* value);
+typedef void (APIENTRYP PFNGLPROGRAMUNIFORMMATRIX4FVPROC)(GLuint program, GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+#endif
+extern PFNGLCREATESHADERPROGRAMVPROC glext_glCreateShaderProgramv;
+extern PFNGLGENPROGRAMPIPELINESPROC glext_glGenProgramPipelines;
+extern PFNGLDELETEPROGRAMPIPELINESPROC glext_glDeleteProgramPipelines;
+extern PFNGLBINDPROGRAMPIPELINEPROC glext_glBindProgramPipeline;
+extern PFNGLUSEPROGRAMSTAGESPROC glext_glUseProgramStages;
+extern PFNGLPROGRAMUNIFORM1IPROC glext_glProgramUniform1i;
+extern PFNGLPROGRAMUNIFORM1FPROC glext_glProgramUniform1f;
+extern PFNGLPROGRAMUNIFORM3FVPROC glext_glProgramUniform3fv;
+extern PFNGLPROGRAMUNIFORM4FVPROC glext_glProgramUniform4fv;
+extern PFNGLPROGRAMUNIFORMMATRIX4FVPROC glext_glProgramUniformMatrix4fv;
+#define glCreateShaderProgramv glext_glCreateShaderProgramv
+#define glGenProgramPipelines glext_glGenProgramPipelines
+#define glDeleteProgramPipelines glext_glDeleteProgramPipelines
+#define glBindProgramPipeline glext_glBindProgramPipeline
+#define glUseProgramStages glext_glUseProgramStages
+#define glProgramUniform1i glext_glProgramUniform1i
+#define glProgramUniform1f glext_glProgramUniform1f
+#define glProgramUniform3fv glext_glProgramUniform3fv
+#define glProgramUniform4fv glext_glProgramUniform4fv
+#define glProgramUniformMatrix4fv glext_glProgramUniformMatrix4fv
+
+// Background shader compilation, the ARB version of the extension uses the same values
+#ifndef GL_KHR_parallel_shader_compile
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+#endif
+extern PFNGLMAXSHADERCOMPILERTHREADSKHRPROC glext_glMaxShaderCompilerThreadsKHR;
+#define glMaxShaderCompilerThreadsKHR glext_glMaxShaderCompilerThreadsKHR
+
+// Cube map arrays, a slice of six faces per layer (GL 4.0 or ARB_texture_cube_map_array)
+#ifndef GL_VERSION_4_0
+#define GL_TEXTURE_CUBE_MAP_ARRAY 0x9009
+#endif
+
+// Immutable texture storage, every level allocated once with a fixed format and size
+#ifndef GL_VERSION_4_2
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+typedef void (APIENTRYP PFNGLTEXSTORAGE3DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height, GLsizei depth);
+#endif
+extern PFNGLTEXSTORAGE2DPROC glext_glTexStorage2D;
+extern PFNGLTEXSTORAGE3DPROC glext_glTexStorage3D;
+#define glTexStorage2D glext_glTexStorage2D
+#define glTexStorage3D glext_glTexStorage3D
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+#endif
+extern PFNGLBUFFERSTORAGEPROC glext_glBufferStorage;
+#define glBufferStorage glext_glBufferStorage
+
+#ifndef GL_VERSION_4_0
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+typedef void (APIENTRYP PFNGLDRAWARRAYSINDIRECTPROC)(GLenum mode, const void* indirect);
+#endif
+#ifndef GL_VERSION_4_3
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+typedef void (APIENTRYP PFNGLMULTIDRAWARRAYSINDIRECTPROC)(GLenum mode, const void* indirect, GLsizei drawcount, GLsizei stride);
+#endif
+extern PFNGLDRAWARRAYSINDIRECTPROC glext_glDrawArraysIndirect;
+extern PFNGLMULTIDRAWELEMENTSINDIRECTPROC glext_glMultiDrawElementsIndirect;
+extern PFNGLMULTIDRAWARRAYSINDIRECTPROC glext_glMultiDrawArraysIndirect;
+#define glDrawArraysIndirect glext_glDrawArraysIndirect
+#define glMultiDrawElementsIndirect glext_glMultiDrawElementsIndirect
+#define glMultiDrawArraysIndirect glext_glMultiDrawArraysIndirect
+
+#ifndef GL_VERSION_4_3
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS 0x90D6
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+
+// Compute shaders and the barriers that make their writes visible to later draws
+#ifndef GL_VERSION_4_3
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_DISPATCH_INDIRECT_BUFFER 0x90EE
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEPROC)(GLuint numGroupsX, GLuint numGroupsY, GLuint numGroupsZ);
+typedef void (APIENTRYP PFNGLDISPATCHCOMPUTEINDIRECTPROC)(GLintptr indirect);
+#endif
+#ifndef GL_VERSION_4_2
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_ELEMENT_ARRAY_BARRIER_BIT 0x00000002
+#define GL_TEXTURE_FETCH_BARRIER_BIT 0x00000008
+#define GL_SHADER_IMAGE_ACCESS_BARRIER_BIT 0x00000020
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#define GL_FRAMEBUFFER_BARRIER_BIT 0x00000400
+typedef void (APIENTRYP PFNGLMEMORYBARRIERPROC)(GLbitfield barriers);
+typedef void (APIENTRYP PFNGLBINDIMAGETEXTUREPROC)(GLuint unit, GLuint texture, GLint level, GLboolean layered, GLint layer, GLenum access, GLenum format);
+#endif
+extern PFNGLDISPATCHCOMPUTEPROC glext_glDispatchCompute;
+extern PFNGLDISPATCHCOMPUTEINDIRECTPROC glext_glDispatchComputeIndirect;
+extern PFNGLMEMORYBARRIERPROC glext_glMemoryBarrier;
+extern PFNGLBINDIMAGETEXTUREPROC glext_glBindImageTexture;
+#define glDispatchCompute glext_glDispatchCompute
+#define glDispatchComputeIndirect glext_glDispatchComputeIndirect
+#define glMemoryBarrier glext_glMemoryBarrier
+#define glBindImageTexture glext_glBindImageTexture
+
+// Vertex formats separate from the buffers they read, switched by binding a buffer to a binding index (GL 4.3 or ARB_vertex_attrib_binding)
+#ifndef GL_VERSION_4_3
+typedef void (APIENTRYP PFNGLVERTEXATTRIBFORMATPROC)(GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+typedef void (APIENTRYP PFNGLVERTEXATTRIBBINDINGPROC)(GLuint attribindex, GLuint bindingindex);
+typedef void (APIENTRYP PFNGLBINDVERTEXBUFFERPROC)(GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+typedef void (APIENTRYP PFNGLVERTEXBINDINGDIVISORPROC)(GLuint bindingindex, GLuint divisor);
+#endif
+extern PFNGLVERTEXATTRIBFORMATPROC glext_glVertexAttribFormat;
+extern PFNGLVERTEXATTRIBBINDINGPROC glext_glVertexAttribBinding;
+extern PFNGLBINDVERTEXBUFFERPROC glext_glBindVertexBuffer;
+extern PFNGLVERTEXBINDINGDIVISORPROC glext_glVertexBindingDivisor;
+#define glVertexAttribFormat glext_glVertexAttribFormat
+#define glVertexAttribBinding glext_glVertexAttribBinding
+#define glBindVertexBuffer glext_glBindVertexBuffer
+#define glVertexBindingDivisor glext_glVertexBindingDivisor
+
+// Direct state access, objects created and edited by name without binding them (GL 4.5 or ARB_direct_state_access)
+#ifndef GL_VERSION_4_5
+typedef void (APIENTRYP PFNGLCREATEBUFFERSPROC)(GLsizei n, GLuint* buffers);
+typedef void (APIENTRYP PFNGLNAMEDBUFFERSTORAGEPROC)(GLuint buffer, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (APIENTRYP PFNGLNAMEDBUFFERSUBDATAPROC)(GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data);
+typedef void (APIENTRYP PFNGLCREATEVERTEXARRAYSPROC)(GLsizei n, GLuint* arrays);
+typedef void (APIENTRYP PFNGLVERTEXARRAYVERTEXBUFFERPROC)(GLuint vaobj, GLuint bindingindex, GLuint buffer, GLintptr offset, GLsizei stride);
+typedef void (APIENTRYP PFNGLVERTEXARRAYATTRIBFORMATPROC)(GLuint vaobj, GLuint attribindex, GLint size, GLenum type, GLboolean normalized, GLuint relativeoffset);
+typedef void (APIENTRYP PFNGLVERTEXARRAYATTRIBBINDINGPROC)(GLuint vaobj, GLuint attribindex, GLuint bindingindex);
+typedef void (APIENTRYP PFNGLVERTEXARRAYBINDINGDIVISORPROC)(GLuint vaobj, GLuint bindingindex, GLuint divisor);
+typedef void (APIENTRYP PFNGLENABLEVERTEXARRAYATTRIBPROC)(GLuint vaobj, GLuint index);
+typedef void (APIENTRYP PFNGLVERTEXARRAYELEMENTBUFFERPROC)(GLuint vaobj, GLuint buffer);
+#endif
+extern PFNGLCREATEBUFFERSPROC glext_glCreateBuffers;
+extern PFNGLNAMEDBUFFERSTORAGEPROC glext_glNamedBufferStorage;
+extern PFNGLNAMEDBUFFERSUBDATAPROC glext_glNamedBufferSubData;
+extern PFNGLCREATEVERTEXARRAYSPROC glext_glCreateVertexArrays;
+extern PFNGLVERTEXARRAYVERTEXBUFFERPROC glext_glVertexArrayVertexBuffer;
+extern PFNGLVERTEXARRAYATTRIBFORMATPROC glext_glVertexArrayAttribFormat;
+extern PFNGLVERTEXARRAYATTRIBBINDINGPROC glext_glVertexArrayAttribBinding;
+extern PFNGLVERTEXARRAYBINDINGDIVISORPROC glext_glVertexArrayBindingDivisor;
+extern PFNGLENABLEVERTEXARRAYATTRIBPROC glext_glEnableVertexArrayAttrib;
+extern PFNGLVERTEXARRAYELEMENTBUFFERPROC glext_glVertexArrayElementBuffer;
+#define glCreateBuffers glext_glCreateBuffers
+#define glNamedBufferStorage glext_glNamedBufferStorage
+#define glNamedBufferSubData glext_glNamedBufferSubData
+#define glCreateVertexArrays glext_glCreateVertexArrays
+#define glVertexArrayVertexBuffer glext_glVertexArrayVertexBuffer
+#define glVertexArrayAttribFormat glext_glVertexArrayAttribFormat
+#define glVertexArrayAttribBinding glext_glVertexArrayAttribBinding
+#define glVertexArrayBindingDivisor glext_glVertexArrayBindingDivisor
+#define glEnableVertexArrayAttrib glext_glEnableVertexArrayAttrib
+#define glVertexArrayElementBuffer glext_glVertexArrayElementBuffer
+
+// Clip space depth from 0 to 1 instead of -1 to 1, for reverse-Z
+#ifndef GL_VERSION_4_5
+#define GL_LOWER_LEFT 0x8CA1
+#define GL_NEGATIVE_ONE_TO_ONE 0x935E
+#define GL_ZERO_TO_ONE 0x935F
+typedef void (APIENTRYP PFNGLCLIPCONTROLPROC)(GLenum origin, GLenum depth);
+#endif
+extern PFNGLCLIPCONTROLPROC glext_glClipControl;
+#define glClipControl glext_glClipControl
+
+// Debug messages from the driver, object labels and debug groups (GL 4.3 or KHR_debug, whose entry points have no suffix on desktop GL)
+#ifndef GL_VERSION_4_3
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_SOURCE_OTHER 0x824B
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_OTHER 0x8251
+#define GL_DEBUG_TYPE_MARKER 0x8268
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_BUFFER 0x82E0
+#define GL_SHADER 0x82E1
+#define GL_PROGRAM 0x82E2
+#define GL_VERTEX_ARRAY 0x8074
+#define GL_QUERY 0x82E3
+#define GL_MAX_LABEL_LENGTH 0x82E8
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+typedef void (APIENTRYP PFNGLDEBUGMESSAGECALLBACKPROC)(GLDEBUGPROC callback, const void* userParam);
+typedef void (APIENTRYP PFNGLDEBUGMESSAGECONTROLPROC)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint* ids, GLboolean enabled);
+typedef void (APIENTRYP PFNGLOBJECTLABELPROC)(GLenum identifier, GLuint name, GLsizei length, const GLchar* label);
+typedef void (APIENTRYP PFNGLPUSHDEBUGGROUPPROC)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+typedef void (APIENTRYP PFNGLPOPDEBUGGROUPPROC)(void);
+#endif
+extern PFNGLDEBUGMESSAGECALLBACKPROC glext_glDebugMessageCallback;
+extern PFNGLDEBUGMESSAGECONTROLPROC glext_glDebugMessageControl;
+extern PFNGLOBJECTLABELPROC glext_glObjectLabel;
+extern PFNGLPUSHDEBUGGROUPPROC glext_glPushDebugGroup;
+extern PFNGLPOPDEBUGGROUPPROC glext_glPopDebugGroup;
+#define glDebugMessageCallback glext_glDebugMessageCallback
+#define glDebugMessageControl glext_glDebugMessageControl
+#define glObjectLabel glext_glObjectLabel
+#define glPushDebugGroup glext_glPushDebugGroup
+#define glPopDebugGroup glext_glPopDebugGroup
+
+// Bindless textures are an extension in every GL version
+#ifndef GL_ARB_bindless_texture
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTURESAMPLERHANDLEARBPROC)(GLuint texture, GLuint sampler);
+#endif
+extern PFNGLGETTEXTUREHANDLEARBPROC glext_glGetTextureHandleARB;
+extern PFNGLGETTEXTURESAMPLERHANDLEARBPROC glext_glGetTextureSamplerHandleARB;
+extern PFNGLMAKETEXTUREHANDLERESIDENTARBPROC glext_glMakeTextureHandleResidentARB;
+extern PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC glext_glMakeTextureHandleNonResidentARB;
+#define glGetTextureHandleARB glext_glGetTextureHandleARB
+#define glGetTextureSamplerHandleARB glext_glGetTextureSamplerHandleARB
+#define glMakeTextureHandleResidentARB glext_glMakeTextureHandleResidentARB
+#define glMakeTextureHandleNonResidentARB glext_glMakeTextureHandleNonResidentARB
+
+// Compressed texture formats, S3TC and ASTC are extensions in every GL version, BPTC is core since 4.2
+#ifndef GL_EXT_texture_compression_s3tc
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_EXT_texture_sRGB
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_VERSION_4_2
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#define GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
+#define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
+#endif
+#ifndef GL_KHR_texture_compression_astc_ldr
+// The 14 block sizes from 4x4 to 12x12 follow each other, sRGB variants start at 0x93D0
+#define GL_COMPRESSED_RGBA_ASTC_4x4_KHR 0x93B0
+#define GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR 0x93D0
+#endif
+#ifndef GL_NVX_gpu_memory_info
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#endif
+#ifndef GL_ATI_meminfo
+#define GL_VBO_FREE_MEMORY_ATI 0x87FB
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#define GL_RENDERBUFFER_FREE_MEMORY_ATI 0x87FD
+#endif
+// Anisotropic filtering, core in GL 4.6 with the same values as EXT_texture_filter_anisotropic
+#ifndef GL_VERSION_4_6
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+// Pipeline statistics query targets (GL 4.6 or ARB_pipeline_statistics_query), queried like any other query
+#ifndef GL_ARB_pipeline_statistics_query
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#define GL_CLIPPING_INPUT_PRIMITIVES_ARB 0x82F6
+#define GL_CLIPPING_OUTPUT_PRIMITIVES_ARB 0x82F7
+#endif
+// Coarse shading, a palette index per tile of pixels in an R8UI rate image picks how many pixels share one fragment
+// shader invocation (NV_shading_rate_image)
+#ifndef GL_NV_shading_rate_image
+#define GL_SHADING_RATE_IMAGE_BINDING_NV 0x955B
+#define GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV 0x955C
+#define GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV 0x955D
+#define GL_SHADING_RATE_IMAGE_PALETTE_SIZE_NV 0x955E
+#define GL_SHADING_RATE_IMAGE_NV 0x9563
+#define GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV 0x9565
+#define GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV 0x9568
+#define GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV 0x956B
+typedef void (APIENTRYP PFNGLBINDSHADINGRATEIMAGENVPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLSHADINGRATEIMAGEPALETTENVPROC)(GLuint viewport, GLuint first, GLsizei count, const GLenum* rates);
+#endif
+extern PFNGLBINDSHADINGRATEIMAGENVPROC glext_glBindShadingRateImageNV;
+extern PFNGLSHADINGRATEIMAGEPALETTENVPROC glext_glShadingRateImagePaletteNV;
+#define glBindShadingRateImageNV glext_glBindShadingRateImageNV
+#define glShadingRateImagePaletteNV glext_glShadingRateImagePaletteNV
+
+// Core context versions asked for newest first, the first one the driver creates is used so the entry points above
+// come with the version rather than only through extensions, glad needs at least the last
+static const int GL_CONTEXT_VERSIONS[][2] = { { 4, 6 }, { 4, 5 }, { 4, 4 }, { 4, 3 }, { 4, 2 }, { 4, 1 }, { 4, 0 }, { 3, 3 } };
+
+// Which of the features above the current context supports
+struct GLExtensions
+{
+	// Version of the context that was actually created
+	int major = 0;
+	int minor = 0;
+	// glGetProgramBinary and glProgramBinary with at least one binary format (GL 4.1 or ARB_get_program_binary)
+	bool programBinary = false;
+	// GL_COMPLETION_STATUS_KHR can be polled without waiting for the compiler (KHR or ARB_parallel_shader_compile)
+	bool parallelShaderCompile = false;
+	// Separable programs, program pipelines and glProgramUniform (GL 4.1 or ARB_separate_shader_objects)
+	bool separateShaderObjects = false;
+	// glShaderBinary with SPIR-V and glSpecializeShader (GL 4.6 or ARB_gl_spirv)
+	bool spirv = false;
+	// glTexStorage2D and glTexStorage3D (GL 4.2 or ARB_texture_storage)
+	bool textureStorage = false;
+	// glBufferStorage with persistent and coherent mapping (GL 4.4 or ARB_buffer_storage)
+	bool bufferStorage = false;
+	// glMultiDrawElementsIndirect and glMultiDrawArraysIndirect with base instances read from the command buffer (GL 4.3 or
+	// ARB_multi_draw_indirect), and glDrawArraysIndirect
+	bool multiDrawIndirect = false;
+	// Shader storage buffers (GL 4.3 or ARB_shader_storage_buffer_object)
+	bool shaderStorage = false;
+	// glDispatchCompute, glDispatchComputeIndirect, glMemoryBarrier and glBindImageTexture, only with GL 4.3 since compute shaders are written as #version 430
+	bool computeShader = false;
+	// glVertexAttribFormat, glVertexAttribBinding, glBindVertexBuffer and glVertexBindingDivisor (GL 4.3 or ARB_vertex_attrib_binding)
+	bool vertexAttribBinding = false;
+	// Buffers and vertex arrays created, filled and linked by name, buffer storage included (GL 4.5 or ARB_direct_state_access)
+	bool directStateAccess = false;
+	// glClipControl (GL 4.5 or ARB_clip_control)
+	bool clipControl = false;
+	// Debug message callback, object labels and debug groups (GL 4.3 or KHR_debug)
+	bool debugOutput = false;
+	// Texture handles sampled straight from buffers without binding (ARB_bindless_texture together with shader storage)
+	bool bindlessTexture = false;
+	// Compressed texture families, RGTC (BC4/BC5) is core in GL 3.3 and always there
+	bool textureS3TC = false;
+	bool textureS3TCsRGB = false;
+	bool textureBPTC = false;
+	bool textureASTC = false;
+	// GL_TEXTURE_MAX_ANISOTROPY on textures and samplers (GL 4.6 or EXT/ARB_texture_filter_anisotropic)
+	bool anisotropicFilter = false;
+	// Video memory the driver has and has left, in kilobytes (NVX_gpu_memory_info, ATI_meminfo)
+	bool nvxMemoryInfo = false;
+	bool atiMemInfo = false;
+	// Shader invocation and clipper primitive counts per query (GL 4.6 or ARB_pipeline_statistics_query)
+	bool pipelineStatistics = false;
+	// A rate image of R8UI palette indices coarsening the fragment shading per tile (NV_shading_rate_image), written by
+	// compute shaders into immutable storage, so only together with both
+	bool shadingRateImage = false;
+};
+
+// Filled by LoadGLExtensions
+extern GLExtensions GLExt;
+
+// Loads the entry points above and fills GLExt, needs a current context and a loaded glad
+void LoadGLExtensions(GLADloadproc load);
+// Checks if the driver reported an extension, such as "GL_ARB_buffer_storage", when LoadGLExtensions ran
+bool HasGLExtension(const char* name);
+
+#endif
@@ -0,0 +1,340 @@
+#include"GLStateCache.h"
+#include"GLExtensions.h"
+#include"GpuMemory.h"
+
+#include<algorithm>
+
+GLStateCache GLState;
+
+// Constructor that starts with every entry unknown
+GLStateCache::GLStateCache()
+{
+	Invalidate();
+}
+
+// Slot of a texture target
+int GLStateCache::textureSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D: return 0;
+	case GL_TEXTURE_2D_ARRAY: return 1;
+	case GL_TEXTURE_BUFFER: return 2;
+	case GL_TEXTURE_3D: return 3;
+	case GL_TEXTURE_CUBE_MAP: return 4;
+	default: return -1;
+	}
+}
+
+// Slot of a buffer target, the element array buffer is slot 0
+int GLStateCache::bufferSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ELEMENT_ARRAY_BUFFER: return 0;
+	case GL_ARRAY_BUFFER: return 1;
+	case GL_UNIFORM_BUFFER: return 2;
+	case GL_SHADER_STORAGE_BUFFER: return 3;
+	case GL_DRAW_INDIRECT_BUFFER: return 4;
+	case GL_TEXTURE_BUFFER: return 5;
+	case GL_PIXEL_UNPACK_BUFFER: return 6;
+	case GL_PIXEL_PACK_BUFFER: return 7;
+	case GL_COPY_READ_BUFFER: return 8;
+	case GL_COPY_WRITE_BUFFER: return 9;
+	default: return -1;
+	}
+}
+
+// Slot of a capability
+int GLStateCache::capabilitySlot(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_DEPTH_TEST: return 0;
+	case GL_CULL_FACE: return 1;
+	case GL_BLEND: return 2;
+	case GL_POLYGON_OFFSET_FILL: return 3;
+	case GL_SCISSOR_TEST: return 4;
+	case GL_STENCIL_TEST: return 5;
+	case GL_FRAMEBUFFER_SRGB: return 6;
+	case GL_MULTISAMPLE: return 7;
+	default: return -1;
+	}
+}
+
+// Sets an entry and reports whether the call has to reach the driver
+bool GLStateCache::change(GLuint& entry, GLuint value)
+{
+	if (entry == value)
+	{
+		frame.skipped++;
+		return false;
+	}
+	entry = value;
+	frame.issued++;
+	return true;
+}
+
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (change(GLStateCache::program, program))
+	{
+		frame.programBinds++;
+		glUseProgram(program);
+	}
+}
+
+void GLStateCache::BindProgramPipeline(GLuint pipeline)
+{
+	UseProgram(0);
+	if (change(GLStateCache::pipeline, pipeline))
+	{
+		frame.programBinds++;
+		glBindProgramPipeline(pipeline);
+	}
+}
+
+void GLStateCache::BindVertexArray(GLuint array)
+{
+	if (change(vertexArray, array))
+	{
+		frame.vertexArrayBinds++;
+		glBindVertexArray(array);
+		buffers[0] = UNKNOWN;
+	}
+}
+
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+	if (change(activeUnit, unit))
+		glActiveTexture(unit);
+}
+
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+	int slot = textureSlot(target);
+	GLuint unit = activeUnit - GL_TEXTURE0;
+	if (slot < 0 || activeUnit == UNKNOWN || unit >= TEXTURE_UNITS)
+	{
+		frame.issued++;
+		frame.textureBinds++;
+		glBindTexture(target, texture);
+		return;
+	}
+	if (change(textures[unit][slot], texture))
+	{
+		frame.textureBinds++;
+		glBindTexture(target, texture);
+	}
+}
+
+void GLStateCache::BindSampler(GLuint unit, GLuint sampler)
+{
+	if (unit >= TEXTURE_UNITS)
+	{
+		frame.issued++;
+		frame.textureBinds++;
+		glBindSampler(unit, sampler);
+		return;
+	}
+	if (change(samplers[unit], sampler))
+	{
+		frame.textureBinds++;
+		glBindSampler(unit, sampler);
+	}
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	int slot = bufferSlot(target);
+	if (slot < 0)
+	{
+		frame.issued++;
+		frame.bufferBinds++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+	if (change(buffers[slot], buffer))
+	{
+		frame.bufferBinds++;
+		glBindBuffer(target, buffer);
+	}
+}
+
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	frame.issued++;
+	frame.bufferBinds++;
+	glBindBufferBase(target, index, buffer);
+	int slot = bufferSlot(target);
+	if (slot >= 0)
+		buffers[slot] = buffer;
+}
+
+void GLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	frame.issued++;
+	frame.bufferBinds++;
+	glBindBufferRange(target, index, buffer, offset, size);
+	int slot = bufferSlot(target);
+	if (slot >= 0)
+		buffers[slot] = buffer;
+}
+
+void GLStateCache::VertexArrayElementBuffer(GLuint array, GLuint buffer)
+{
+	frame.issued++;
+	glVertexArrayElementBuffer(array, buffer);
+	if (vertexArray == array)
+		buffers[0] = buffer;
+}
+
+void GLStateCache::Enable(GLenum capability)
+{
+	int slot = capabilitySlot(capability);
+	if (slot < 0 || change(capabilities[slot], GL_TRUE))
+	{
+		if (slot < 0)
+			frame.issued++;
+		glEnable(capability);
+	}
+}
+
+void GLStateCache::Disable(GLenum capability)
+{
+	int slot = capabilitySlot(capability);
+	if (slot < 0 || change(capabilities[slot], GL_FALSE))
+	{
+		if (slot < 0)
+			frame.issued++;
+		glDisable(capability);
+	}
+}
+
+void GLStateCache::DeleteBuffers(GLsizei count, const GLuint* buffers)
+{
+	for (GLsizei i = 0; i < count; i++)
+		for (GLuint& entry : GLStateCache::buffers)
+			if (buffers[i] != 0 && entry == buffers[i])
+				entry = 0;
+	for (GLsizei i = 0; i < count; i++)
+		GpuMemory.Untrack(GL_BUFFER, buffers[i]);
+	glDeleteBuffers(count, buffers);
+}
+
+void GLStateCache::DeleteTextures(GLsizei count, const GLuint* textures)
+{
+	for (GLsizei i = 0; i < count; i++)
+		for (GLuint (&unit)[TEXTURE_TARGETS] : GLStateCache::textures)
+			for (GLuint& entry : unit)
+				if (textures[i] != 0 && entry == textures[i])
+					entry = 0;
+	for (GLsizei i = 0; i < count; i++)
+		GpuMemory.Untrack(GL_TEXTURE, textures[i]);
+	glDeleteTextures(count, textures);
+}
+
+void GLStateCache::DeleteSamplers(GLsizei count, const GLuint* samplers)
+{
+	for (GLsizei i = 0; i < count; i++)
+		for (GLuint& entry : GLStateCache::samplers)
+			if (samplers[i] != 0 && entry == samplers[i])
+				entry = 0;
+	glDeleteSamplers(count, samplers);
+}
+
+void GLStateCache::DeleteVertexArrays(GLsizei count, const GLuint* arrays)
+{
+	for (GLsizei i = 0; i < count; i++)
+		if (arrays[i] != 0 && vertexArray == arrays[i])
+		{
+			vertexArray = 0;
+			buffers[0] = UNKNOWN;
+		}
+	glDeleteVertexArrays(count, arrays);
+}
+
+void GLStateCache::DeleteProgram(GLuint program)
+{
+	// A program in use is only flagged for deletion, its name is not trusted afterwards
+	if (program != 0 && GLStateCache::program == program)
+		GLStateCache::program = UNKNOWN;
+	glDeleteProgram(program);
+}
+
+void GLStateCache::DeleteProgramPipelines(GLsizei count, const GLuint* pipelines)
+{
+	for (GLsizei i = 0; i < count; i++)
+		if (pipelines[i] != 0 && pipeline == pipelines[i])
+			pipeline = 0;
+	glDeleteProgramPipelines(count, pipelines);
+}
+
+// Forgets everything
+void GLStateCache::Invalidate()
+{
+	program = pipeline = vertexArray = activeUnit = UNKNOWN;
+	for (GLuint (&unit)[TEXTURE_TARGETS] : textures)
+		std::fill(unit, unit + TEXTURE_TARGETS, UNKNOWN);
+	std::fill(samplers, samplers + TEXTURE_UNITS, UNKNOWN);
+	std::fill(buffers, buffers + BUFFER_TARGETS, UNKNOWN);
+	std::fill(capabilities, capabilities + CAPABILITIES, UNKNOWN);
+}
+
+// Adds the counts of another frame
+void GLStateCache::Counters::Add(const Counters& other)
+{
+	draws += other.draws;
+	instances += other.instances;
+	triangles += other.triangles;
+	programBinds += other.programBinds;
+	vertexArrayBinds += other.vertexArrayBinds;
+	textureBinds += other.textureBinds;
+	bufferBinds += other.bufferBinds;
+	uniforms += other.uniforms;
+	uploads += other.uploads;
+	uploadBytes += other.uploadBytes;
+	issued += other.issued;
+	skipped += other.skipped;
+}
+
+void GLStateCache::CountDraw(size_t instances, size_t triangles)
+{
+	frame.draws++;
+	frame.instances += instances;
+	frame.triangles += triangles;
+}
+
+void GLStateCache::CountUniforms(size_t count)
+{
+	frame.uniforms += count;
+}
+
+void GLStateCache::CountUpload(size_t bytes)
+{
+	frame.uploads++;
+	frame.uploadBytes += bytes;
+}
+
+// Ends the counts of a frame
+void GLStateCache::EndFrame()
+{
+	total.Add(frame);
+	lastFrame = frame;
+	frame = Counters();
+}
+
+// One line of the last frame's counts
+std::string GLStateCache::Summary() const
+{
+	const Counters& c = lastFrame;
+	return std::to_string(c.draws) + " draws, " + std::to_string(c.instances) + " instances, " + std::to_string(c.triangles) + " tris, "
+		+ std::to_string(c.programBinds) + "/" + std::to_string(c.vertexArrayBinds) + "/" + std::to_string(c.textureBinds) + "/" + std::to_string(c.bufferBinds)
+		+ " program/VAO/texture/buffer binds, " + std::to_string(c.uniforms) + " uniforms, "
+		+ std::to_string(c.uploads) + " uploads " + std::to_string(c.uploadBytes / 1024) + " KB";
+}
+
+void GLStateCache::ResetCounters()
+{
+	frame = lastFrame = total = Counters();
+}
@@ -0,0 +1,124 @@
+#ifndef GL_STATE_CACHE_CLASS_H
+#define GL_STATE_CACHE_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<string>
+
+// Shadows the GL state that is changed most often and drops calls that would set what is already set
+// Every bind, enable, disable and delete of the kinds below goes through GLState, including the save and restore
+// around passes that query the real state, so the shadow copy never goes stale. Nothing is assumed about the
+// state before the first call: every entry starts out unknown and the first call of each kind always reaches the driver.
+//   program, program pipeline, vertex array, active texture unit
+//   the texture of each target on each unit, for the targets the engine binds
+//   the buffer of each target, the element array buffer is forgotten whenever the vertex array changes since it belongs to it
+//   enable bits of the capabilities the engine switches
+// Indexed buffer bindings are passed straight through, apart from updating the generic binding they also set.
+// It also counts what every frame asks of the driver: the binds it makes itself, and the draws, uniforms and uploads
+// the code issuing them reports, so a change that breaks batching shows up as a jump in the counts.
+class GLStateCache
+{
+public:
+	static constexpr unsigned int TEXTURE_UNITS = 16;
+
+	// Work handed to the driver
+	struct Counters
+	{
+		// Draw calls, a multi-draw is one, with the instances and triangles they draw
+		// Triangles and instances of indirect draws whose commands the GPU writes are not known and not counted
+		size_t draws = 0;
+		size_t instances = 0;
+		size_t triangles = 0;
+		// Binds that reached the driver
+		size_t programBinds = 0;
+		size_t vertexArrayBinds = 0;
+		size_t textureBinds = 0;
+		size_t bufferBinds = 0;
+		size_t uniforms = 0;
+		// Buffer and texture uploads and their bytes
+		size_t uploads = 0;
+		size_t uploadBytes = 0;
+		// State changes that reached the driver and the ones dropped because they would set what is already set
+		size_t issued = 0;
+		size_t skipped = 0;
+
+		void Add(const Counters& other);
+	};
+
+	// Counts of the frame being issued, of the last finished one, and of every frame since the last ResetCounters
+	Counters frame;
+	Counters lastFrame;
+	Counters total;
+
+	// Constructor that starts with every entry unknown
+	GLStateCache();
+
+	void UseProgram(GLuint program);
+	// Binds a program pipeline and leaves no program active, which would take precedence over it
+	void BindProgramPipeline(GLuint pipeline);
+	void BindVertexArray(GLuint array);
+	void ActiveTexture(GLenum unit);
+	// Binds to the active unit
+	void BindTexture(GLenum target, GLuint texture);
+	// Binds a sampler object to a unit, counted as a texture bind
+	void BindSampler(GLuint unit, GLuint sampler);
+	void BindBuffer(GLenum target, GLuint buffer);
+	void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	// Sets the element array buffer of a vertex array by name, which is the bound one when that array is bound
+	void VertexArrayElementBuffer(GLuint array, GLuint buffer);
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+
+	// Deleting unbinds an object everywhere in the context, so the entries holding it are cleared too, and takes its
+	// memory out of GpuMemory
+	void DeleteBuffers(GLsizei count, const GLuint* buffers);
+	void DeleteTextures(GLsizei count, const GLuint* textures);
+	void DeleteSamplers(GLsizei count, const GLuint* samplers);
+	void DeleteVertexArrays(GLsizei count, const GLuint* arrays);
+	void DeleteProgram(GLuint program);
+	void DeleteProgramPipelines(GLsizei count, const GLuint* pipelines);
+
+	// Reports a draw call with the instances and triangles it draws
+	void CountDraw(size_t instances, size_t triangles);
+	// Reports uniforms set outside of the Shader setters
+	void CountUniforms(size_t count = 1);
+	// Reports a buffer or texture upload of a number of bytes
+	void CountUpload(size_t bytes);
+	// Ends the counts of a frame, adding them to the total
+	void EndFrame();
+	// One line of the last frame's counts, short enough for a window title
+	std::string Summary() const;
+
+	// Forgets everything, for after code that changes the state without going through GLState
+	void Invalidate();
+	// Starts the counts over, including the ones of the frame being issued
+	void ResetCounters();
+private:
+	// Entry value that never matches a real name or capability state
+	static constexpr GLuint UNKNOWN = 0xffffffffu;
+	static constexpr unsigned int TEXTURE_TARGETS = 5;
+	static constexpr unsigned int BUFFER_TARGETS = 10;
+	static constexpr unsigned int CAPABILITIES = 8;
+
+	GLuint program;
+	GLuint pipeline;
+	GLuint vertexArray;
+	GLuint activeUnit;
+	GLuint textures[TEXTURE_UNITS][TEXTURE_TARGETS];
+	GLuint samplers[TEXTURE_UNITS];
+	GLuint buffers[BUFFER_TARGETS];
+	GLuint capabilities[CAPABILITIES];
+
+	// Slot of a target or capability in the arrays above, -1 for the ones that are not cached
+	static int textureSlot(GLenum target);
+	static int bufferSlot(GLenum target);
+	static int capabilitySlot(GLenum capability);
+	// Sets an entry and reports whether the call has to reach the driver
+	bool change(GLuint& entry, GLuint value);
+};
+
+// The state of the one context the engine renders with
+extern GLStateCache GLState;
+
+#endif
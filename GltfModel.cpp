@@ -0,0 +1,665 @@
+#include"GltfModel.h"
+#include"JsonValue.h"
+
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/quaternion.hpp>
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<functional>
+#include<iostream>
+#include<iterator>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLTF_SSE 1
+#include<emmintrin.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Start of a .glb file and the types of its chunks
+static const uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+static const uint32_t GLB_JSON = 0x4E4F534A; // "JSON"
+static const uint32_t GLB_BIN = 0x004E4942; // "BIN\0"
+// Component types of accessors
+static const int GLTF_BYTE = 5120;
+static const int GLTF_UNSIGNED_BYTE = 5121;
+static const int GLTF_SHORT = 5122;
+static const int GLTF_UNSIGNED_SHORT = 5123;
+static const int GLTF_UNSIGNED_INT = 5125;
+static const int GLTF_FLOAT = 5126;
+// Primitive mode of triangle lists
+static const int GLTF_TRIANGLES = 4;
+// Nodes deeper than this are taken for a cycle
+static const int MAX_NODE_DEPTH = 64;
+
+// Elements of an accessor where they lie in memory
+struct AccessorView
+{
+	const unsigned char* data = nullptr;
+	size_t stride = 0;
+	size_t count = 0;
+	int componentType = 0;
+	int components = 0;
+	bool normalized = false;
+	// Buffer view the accessor reads and its offset into it, to tell if two accessors interleave
+	int64_t bufferView = -1;
+	size_t offset = 0;
+	// Bounds the file states, POSITION accessors are required to have them
+	bool hasBounds = false;
+	glm::vec3 min = glm::vec3(0.0f);
+	glm::vec3 max = glm::vec3(0.0f);
+};
+
+static size_t componentSize(int componentType)
+{
+	switch (componentType)
+	{
+	case GLTF_BYTE:
+	case GLTF_UNSIGNED_BYTE:
+		return 1;
+	case GLTF_SHORT:
+	case GLTF_UNSIGNED_SHORT:
+		return 2;
+	case GLTF_UNSIGNED_INT:
+	case GLTF_FLOAT:
+		return 4;
+	}
+	return 0;
+}
+
+static int componentCount(const std::string& type)
+{
+	if (type == "SCALAR")
+		return 1;
+	if (type == "VEC2")
+		return 2;
+	if (type == "VEC3")
+		return 3;
+	if (type == "VEC4")
+		return 4;
+	return 0;
+}
+
+// Reads one component as a float, normalized integers become fractions the way GL turns them into floats
+static float readComponent(const unsigned char* at, int componentType, bool normalized)
+{
+	switch (componentType)
+	{
+	case GLTF_FLOAT:
+	{
+		float value;
+		memcpy(&value, at, sizeof(value));
+		return value;
+	}
+	case GLTF_UNSIGNED_BYTE:
+		return normalized ? *at / 255.0f : (float)*at;
+	case GLTF_BYTE:
+		return normalized ? std::max(*(const int8_t*)at / 127.0f, -1.0f) : (float)*(const int8_t*)at;
+	case GLTF_UNSIGNED_SHORT:
+	{
+		uint16_t value;
+		memcpy(&value, at, sizeof(value));
+		return normalized ? value / 65535.0f : (float)value;
+	}
+	case GLTF_SHORT:
+	{
+		int16_t value;
+		memcpy(&value, at, sizeof(value));
+		return normalized ? std::max(value / 32767.0f, -1.0f) : (float)value;
+	}
+	case GLTF_UNSIGNED_INT:
+	{
+		uint32_t value;
+		memcpy(&value, at, sizeof(value));
+		return (float)value;
+	}
+	}
+	return 0.0f;
+}
+
+// Reads one index
+static GLuint readIndex(const unsigned char* at, int componentType)
+{
+	if (componentType == GLTF_UNSIGNED_BYTE)
+		return *at;
+	if (componentType == GLTF_UNSIGNED_SHORT)
+	{
+		uint16_t value;
+		memcpy(&value, at, sizeof(value));
+		return value;
+	}
+	uint32_t value;
+	memcpy(&value, at, sizeof(value));
+	return value;
+}
+
+// Decodes the base64 payload of a data URI
+static bool decodeBase64(const std::string& text, std::vector<unsigned char>& out)
+{
+	unsigned int bits = 0;
+	int count = 0;
+	for (char c : text)
+	{
+		int value;
+		if (c >= 'A' && c <= 'Z')
+			value = c - 'A';
+		else if (c >= 'a' && c <= 'z')
+			value = c - 'a' + 26;
+		else if (c >= '0' && c <= '9')
+			value = c - '0' + 52;
+		else if (c == '+' || c == '-')
+			value = 62;
+		else if (c == '/' || c == '_')
+			value = 63;
+		else if (c == '=')
+			break;
+		else
+			return false;
+		bits = (bits << 6) | (unsigned int)value;
+		count += 6;
+		if (count >= 8)
+		{
+			count -= 8;
+			out.push_back((unsigned char)(bits >> count));
+		}
+	}
+	return true;
+}
+
+// Bytes a URI refers to, a data URI or a file relative to the model
+static bool readUri(const std::string& uri, const fs::path& directory, std::vector<unsigned char>& out)
+{
+	if (uri.compare(0, 5, "data:") == 0)
+	{
+		size_t comma = uri.find(',');
+		return comma != std::string::npos && uri.rfind(";base64", comma) != std::string::npos && decodeBase64(uri.substr(comma + 1), out);
+	}
+	// Spaces and other characters may be percent encoded
+	std::string decoded;
+	for (size_t i = 0; i < uri.size(); i++)
+	{
+		if (uri[i] == '%' && i + 2 < uri.size())
+		{
+			decoded += (char)strtoul(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+			i += 2;
+		}
+		else
+			decoded += uri[i];
+	}
+	std::ifstream file(directory / fs::u8path(decoded), std::ios::binary);
+	if (!file)
+		return false;
+	out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// Matrix of a node, its matrix or its translation, rotation and scale
+static glm::mat4 nodeTransform(const JsonValue& node)
+{
+	const JsonValue& matrix = node["matrix"];
+	if (matrix.size() == 16)
+	{
+		// Column major like glm
+		glm::mat4 result;
+		for (int i = 0; i < 16; i++)
+			glm::value_ptr(result)[i] = (float)matrix[i].Number(0.0);
+		return result;
+	}
+	glm::mat4 result(1.0f);
+	const JsonValue& translation = node["translation"];
+	if (translation.size() == 3)
+		result = glm::translate(result, glm::vec3((float)translation[0].Number(0.0), (float)translation[1].Number(0.0), (float)translation[2].Number(0.0)));
+	const JsonValue& rotation = node["rotation"];
+	if (rotation.size() == 4)
+	{
+		// glTF stores x, y, z, w, glm's constructor takes w first
+		glm::quat quaternion((float)rotation[3].Number(1.0), (float)rotation[0].Number(0.0), (float)rotation[1].Number(0.0), (float)rotation[2].Number(0.0));
+		result = result * glm::mat4_cast(quaternion);
+	}
+	const JsonValue& scale = node["scale"];
+	if (scale.size() == 3)
+		result = glm::scale(result, glm::vec3((float)scale[0].Number(1.0), (float)scale[1].Number(1.0), (float)scale[2].Number(1.0)));
+	return result;
+}
+
+// Writes positions transformed by transform and texture coordinates in CityGenerator's layout, in one pass
+static void convertVertices(const AccessorView& positions, const AccessorView* texcoords, const glm::mat4& transform, GLfloat* out)
+{
+	const unsigned int stride = CityGenerator::VERTEX_FLOATS;
+	size_t i = 0;
+#ifdef GLTF_SSE
+	// Each position is the sum of the matrix columns scaled by its coordinates, four lanes at once
+	__m128 column0 = _mm_loadu_ps(glm::value_ptr(transform[0]));
+	__m128 column1 = _mm_loadu_ps(glm::value_ptr(transform[1]));
+	__m128 column2 = _mm_loadu_ps(glm::value_ptr(transform[2]));
+	__m128 column3 = _mm_loadu_ps(glm::value_ptr(transform[3]));
+	if (positions.componentType == GLTF_FLOAT)
+	{
+		for (; i < positions.count; i++)
+		{
+			float xyz[3];
+			memcpy(xyz, positions.data + i * positions.stride, sizeof(xyz));
+			__m128 position = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(column0, _mm_set1_ps(xyz[0])), _mm_mul_ps(column1, _mm_set1_ps(xyz[1]))),
+				_mm_add_ps(_mm_mul_ps(column2, _mm_set1_ps(xyz[2])), column3));
+			// The fourth lane lands on u, which is written right after
+			GLfloat* vertex = out + i * stride;
+			_mm_storeu_ps(vertex, position);
+			vertex[3] = 0.0f;
+			vertex[4] = 0.0f;
+			if (texcoords)
+			{
+				const unsigned char* uv = texcoords->data + i * texcoords->stride;
+				vertex[3] = readComponent(uv, texcoords->componentType, texcoords->normalized);
+				vertex[4] = readComponent(uv + componentSize(texcoords->componentType), texcoords->componentType, texcoords->normalized);
+			}
+		}
+	}
+#endif
+
+	// Scalar path for positions of other component types, or all of them without SSE
+	size_t size = componentSize(positions.componentType);
+	for (; i < positions.count; i++)
+	{
+		const unsigned char* at = positions.data + i * positions.stride;
+		glm::vec3 position(readComponent(at, positions.componentType, positions.normalized),
+			readComponent(at + size, positions.componentType, positions.normalized),
+			readComponent(at + 2 * size, positions.componentType, positions.normalized));
+		glm::vec3 moved = glm::vec3(transform * glm::vec4(position, 1.0f));
+		GLfloat* vertex = out + i * stride;
+		vertex[0] = moved.x;
+		vertex[1] = moved.y;
+		vertex[2] = moved.z;
+		vertex[3] = 0.0f;
+		vertex[4] = 0.0f;
+		if (texcoords)
+		{
+			const unsigned char* uv = texcoords->data + i * texcoords->stride;
+			vertex[3] = readComponent(uv, texcoords->componentType, texcoords->normalized);
+			vertex[4] = readComponent(uv + componentSize(texcoords->componentType), texcoords->componentType, texcoords->normalized);
+		}
+	}
+}
+
+// Loads a model
+bool GltfModel::Load(const std::string& path)
+{
+	images.clear();
+	externalBuffers.clear();
+	decodedBuffers.clear();
+	buffers.clear();
+	convertedVertices.clear();
+	convertedIndices.clear();
+	vertexData = nullptr;
+	indexData = nullptr;
+	meshVertices = meshIndices = 0;
+	zeroCopyVertices = zeroCopyIndices = false;
+
+	if (!file.Open(path))
+	{
+		std::cerr << "Failed to map model " << path << std::endl;
+		return false;
+	}
+	fs::path directory = fs::path(path).parent_path();
+
+	// A .glb is a header, a JSON chunk and an optional binary chunk that is buffer 0, anything else is plain JSON
+	const unsigned char* json = file.data();
+	size_t jsonSize = file.size();
+	const unsigned char* binary = nullptr;
+	size_t binarySize = 0;
+	uint32_t magic = 0;
+	if (file.size() >= 4)
+		memcpy(&magic, file.data(), 4);
+	if (magic == GLB_MAGIC)
+	{
+		uint32_t header[5] = {};
+		if (file.size() < sizeof(header))
+		{
+			std::cerr << "Model " << path << " is cut short" << std::endl;
+			return false;
+		}
+		memcpy(header, file.data(), sizeof(header));
+		if (header[1] != 2 || header[4] != GLB_JSON || 20 + (size_t)header[3] > file.size())
+		{
+			std::cerr << "Model " << path << " is not a glTF 2.0 binary" << std::endl;
+			return false;
+		}
+		json = file.data() + 20;
+		jsonSize = header[3];
+		// Chunks are padded to 4 bytes, the binary chunk starts with its own length and type
+		size_t next = 20 + ((size_t)header[3] + 3) / 4 * 4;
+		if (next + 8 <= file.size())
+		{
+			uint32_t chunk[2];
+			memcpy(chunk, file.data() + next, sizeof(chunk));
+			if (chunk[1] == GLB_BIN && next + 8 + (size_t)chunk[0] <= file.size())
+			{
+				binary = file.data() + next + 8;
+				binarySize = chunk[0];
+			}
+		}
+	}
+
+	JsonValue root;
+	if (!JsonValue::Parse((const char*)json, jsonSize, root) || root.type != JsonValue::JSON_OBJECT)
+	{
+		std::cerr << "Model " << path << " has no valid JSON" << std::endl;
+		return false;
+	}
+
+	// Every buffer is found before anything points into it, decodedBuffers never grows after that
+	const JsonValue& bufferList = root["buffers"];
+	decodedBuffers.reserve(bufferList.size());
+	externalBuffers.reserve(bufferList.size());
+	for (size_t i = 0; i < bufferList.size(); i++)
+	{
+		const JsonValue& buffer = bufferList[i];
+		size_t byteLength = (size_t)buffer["byteLength"].Integer(0);
+		if (!buffer.has("uri"))
+		{
+			if (i != 0 || !binary || binarySize < byteLength)
+			{
+				std::cerr << "Model " << path << " has a buffer without data" << std::endl;
+				return false;
+			}
+			buffers.push_back({ binary, byteLength });
+			continue;
+		}
+		const std::string& uri = buffer["uri"].string;
+		if (uri.compare(0, 5, "data:") != 0)
+		{
+			// External buffers are mapped too, so their vertices can be drawn without a copy as well
+			MappedFile external;
+			if (external.Open((directory / fs::u8path(uri)).string()) && external.size() >= byteLength)
+			{
+				buffers.push_back({ external.data(), byteLength });
+				externalBuffers.push_back(std::move(external));
+				continue;
+			}
+		}
+		decodedBuffers.emplace_back();
+		if (!readUri(uri, directory, decodedBuffers.back()) || decodedBuffers.back().size() < byteLength)
+		{
+			std::cerr << "Model " << path << " refers to buffer " << uri.substr(0, 64) << " which cannot be read" << std::endl;
+			return false;
+		}
+		buffers.push_back({ decodedBuffers.back().data(), byteLength });
+	}
+
+	// Start and size of a buffer view, false if it does not fit its buffer
+	const JsonValue& views = root["bufferViews"];
+	auto bufferView = [&](int64_t index, const unsigned char*& data, size_t& size, size_t& stride) {
+		const JsonValue& view = views[(size_t)index];
+		int64_t buffer = view["buffer"].Integer(-1);
+		size_t offset = (size_t)view["byteOffset"].Integer(0);
+		size = (size_t)view["byteLength"].Integer(0);
+		stride = (size_t)view["byteStride"].Integer(0);
+		if (index < 0 || buffer < 0 || (size_t)buffer >= buffers.size() || offset + size > buffers[(size_t)buffer].second)
+			return false;
+		data = buffers[(size_t)buffer].first + offset;
+		return true;
+	};
+	// Elements of an accessor, false if it is sparse, has no buffer view or reads past it
+	const JsonValue& accessors = root["accessors"];
+	auto accessor = [&](int64_t index, AccessorView& out) {
+		const JsonValue& source = accessors[(size_t)index];
+		if (index < 0 || source.type != JsonValue::JSON_OBJECT || source.has("sparse") || !source.has("bufferView"))
+			return false;
+		out.componentType = (int)source["componentType"].Integer(0);
+		out.components = componentCount(source["type"].string);
+		out.count = (size_t)source["count"].Integer(0);
+		out.normalized = source["normalized"].boolean;
+		out.bufferView = source["bufferView"].Integer(-1);
+		out.offset = (size_t)source["byteOffset"].Integer(0);
+		size_t elementSize = componentSize(out.componentType) * out.components;
+		const unsigned char* data;
+		size_t size, stride;
+		if (elementSize == 0 || !bufferView(out.bufferView, data, size, stride))
+			return false;
+		out.stride = stride ? stride : elementSize;
+		out.data = data + out.offset;
+		if (out.count > 0 && out.offset + out.stride * (out.count - 1) + elementSize > size)
+			return false;
+		const JsonValue& min = source["min"];
+		const JsonValue& max = source["max"];
+		out.hasBounds = min.size() >= 3 && max.size() >= 3;
+		for (int i = 0; out.hasBounds && i < 3; i++)
+		{
+			out.min[i] = (float)min[i].Number(0.0);
+			out.max[i] = (float)max[i].Number(0.0);
+		}
+		return true;
+	};
+
+	// The meshes of the default scene with the transforms of the nodes they hang from, every mesh once if there is no scene
+	struct Placed
+	{
+		size_t mesh;
+		glm::mat4 transform;
+	};
+	std::vector<Placed> placed;
+	const JsonValue& nodes = root["nodes"];
+	const JsonValue& meshes = root["meshes"];
+	std::function<void(int64_t, const glm::mat4&, int)> visit = [&](int64_t index, const glm::mat4& parent, int depth) {
+		const JsonValue& node = nodes[(size_t)index];
+		if (index < 0 || node.type != JsonValue::JSON_OBJECT || depth > MAX_NODE_DEPTH)
+			return;
+		glm::mat4 transform = parent * nodeTransform(node);
+		int64_t mesh = node["mesh"].Integer(-1);
+		if (mesh >= 0 && (size_t)mesh < meshes.size())
+			placed.push_back({ (size_t)mesh, transform });
+		const JsonValue& children = node["children"];
+		for (size_t i = 0; i < children.size(); i++)
+			visit(children[i].Integer(-1), transform, depth + 1);
+	};
+	const JsonValue& scenes = root["scenes"];
+	const JsonValue& scene = scenes[(size_t)root["scene"].Integer(0)];
+	if (scene.has("nodes"))
+	{
+		for (size_t i = 0; i < scene["nodes"].size(); i++)
+			visit(scene["nodes"][i].Integer(-1), glm::mat4(1.0f), 0);
+	}
+	else
+	{
+		for (size_t i = 0; i < meshes.size(); i++)
+			placed.push_back({ i, glm::mat4(1.0f) });
+	}
+
+	// The triangle primitives of every placed mesh, with their positions, texture coordinates and indices
+	struct Primitive
+	{
+		AccessorView positions;
+		AccessorView texcoords;
+		bool hasTexcoords;
+		AccessorView indices;
+		bool hasIndices;
+		glm::mat4 transform;
+	};
+	std::vector<Primitive> primitives;
+	size_t totalVertices = 0, totalIndices = 0;
+	for (const Placed& instance : placed)
+	{
+		const JsonValue& list = meshes[instance.mesh]["primitives"];
+		for (size_t i = 0; i < list.size(); i++)
+		{
+			const JsonValue& source = list[i];
+			if (source["mode"].Integer(GLTF_TRIANGLES) != GLTF_TRIANGLES)
+				continue;
+			Primitive primitive;
+			primitive.transform = instance.transform;
+			const JsonValue& attributes = source["attributes"];
+			if (!accessor(attributes["POSITION"].Integer(-1), primitive.positions) || primitive.positions.components != 3)
+			{
+				std::cerr << "Model " << path << " has a primitive without readable positions" << std::endl;
+				return false;
+			}
+			primitive.hasTexcoords = attributes.has("TEXCOORD_0") && accessor(attributes["TEXCOORD_0"].Integer(-1), primitive.texcoords)
+				&& primitive.texcoords.components == 2 && primitive.texcoords.count == primitive.positions.count;
+			primitive.hasIndices = source.has("indices");
+			if (primitive.hasIndices && (!accessor(source["indices"].Integer(-1), primitive.indices) || primitive.indices.components != 1
+				|| primitive.indices.componentType == GLTF_FLOAT || primitive.indices.componentType == GLTF_BYTE || primitive.indices.componentType == GLTF_SHORT))
+			{
+				std::cerr << "Model " << path << " has a primitive with unreadable indices" << std::endl;
+				return false;
+			}
+			totalVertices += primitive.positions.count;
+			totalIndices += primitive.hasIndices ? primitive.indices.count : primitive.positions.count;
+			primitives.push_back(primitive);
+		}
+	}
+	if (primitives.empty() || totalIndices < 3 || totalVertices > 0xFFFFFFFFu || totalIndices > 0xFFFFFFFFu)
+	{
+		std::cerr << "Model " << path << " has no triangles" << std::endl;
+		return false;
+	}
+
+	// Bounds of the whole model from the corners of every primitive's stated bounds, scanned where there are none
+	glm::vec3 min(INFINITY), max(-INFINITY);
+	for (Primitive& primitive : primitives)
+	{
+		AccessorView& positions = primitive.positions;
+		if (!positions.hasBounds)
+		{
+			size_t size = componentSize(positions.componentType);
+			positions.min = glm::vec3(INFINITY);
+			positions.max = glm::vec3(-INFINITY);
+			for (size_t i = 0; i < positions.count; i++)
+			{
+				const unsigned char* at = positions.data + i * positions.stride;
+				glm::vec3 position(readComponent(at, positions.componentType, positions.normalized),
+					readComponent(at + size, positions.componentType, positions.normalized),
+					readComponent(at + 2 * size, positions.componentType, positions.normalized));
+				positions.min = glm::min(positions.min, position);
+				positions.max = glm::max(positions.max, position);
+			}
+		}
+		for (int corner = 0; corner < 8; corner++)
+		{
+			glm::vec3 local((corner & 1) ? positions.max.x : positions.min.x, (corner & 2) ? positions.max.y : positions.min.y, (corner & 4) ? positions.max.z : positions.min.z);
+			glm::vec3 moved = glm::vec3(primitive.transform * glm::vec4(local, 1.0f));
+			min = glm::min(min, moved);
+			max = glm::max(max, moved);
+		}
+	}
+	// Flat models keep a zero extent instead of dividing by it
+	glm::vec3 extent = max - min;
+	glm::vec3 scale(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+	glm::mat4 normalize = glm::scale(glm::mat4(1.0f), scale) * glm::translate(glm::mat4(1.0f), -min);
+
+	// A single primitive already in the vertex layout and the unit cube is used where it lies
+	if (primitives.size() == 1)
+	{
+		const Primitive& primitive = primitives[0];
+		glm::mat4 transform = normalize * primitive.transform;
+		bool identity = true;
+		for (int column = 0; column < 4; column++)
+			for (int row = 0; row < 4; row++)
+				identity = identity && std::abs(transform[column][row] - (column == row ? 1.0f : 0.0f)) < 1e-6f;
+		const AccessorView& positions = primitive.positions;
+		const AccessorView& texcoords = primitive.texcoords;
+		zeroCopyVertices = identity && primitive.hasTexcoords
+			&& positions.componentType == GLTF_FLOAT && texcoords.componentType == GLTF_FLOAT
+			&& positions.stride == CityGenerator::VERTEX_FLOATS * sizeof(GLfloat) && texcoords.stride == positions.stride
+			&& positions.bufferView == texcoords.bufferView && texcoords.offset == positions.offset + 3 * sizeof(GLfloat)
+			&& (uintptr_t)positions.data % alignof(GLfloat) == 0;
+		if (zeroCopyVertices)
+			vertexData = (const GLfloat*)positions.data;
+		const AccessorView& source = primitive.indices;
+		zeroCopyIndices = primitive.hasIndices && source.componentType == GLTF_UNSIGNED_INT && source.stride == sizeof(GLuint)
+			&& (uintptr_t)source.data % alignof(GLuint) == 0;
+		if (zeroCopyIndices)
+			indexData = (const GLuint*)source.data;
+	}
+
+	// Everything else is converted, each primitive's indices offset by the vertices before it
+	if (!zeroCopyVertices)
+		convertedVertices.resize(totalVertices * CityGenerator::VERTEX_FLOATS);
+	if (!zeroCopyIndices)
+		convertedIndices.reserve(totalIndices);
+	size_t baseVertex = 0;
+	for (const Primitive& primitive : primitives)
+	{
+		if (!zeroCopyVertices)
+			convertVertices(primitive.positions, primitive.hasTexcoords ? &primitive.texcoords : nullptr, normalize * primitive.transform,
+				&convertedVertices[baseVertex * CityGenerator::VERTEX_FLOATS]);
+		if (!zeroCopyIndices)
+		{
+			size_t count = primitive.hasIndices ? primitive.indices.count : primitive.positions.count;
+			for (size_t i = 0; i < count; i++)
+			{
+				GLuint index = primitive.hasIndices ? readIndex(primitive.indices.data + i * primitive.indices.stride, primitive.indices.componentType) : (GLuint)i;
+				if (index >= primitive.positions.count)
+				{
+					std::cerr << "Model " << path << " has an index past its vertices" << std::endl;
+					return false;
+				}
+				convertedIndices.push_back((GLuint)(baseVertex + index));
+			}
+		}
+		baseVertex += primitive.positions.count;
+	}
+	if (zeroCopyIndices)
+	{
+		// Indices read from the file are trusted no more than converted ones
+		for (size_t i = 0; i < totalIndices; i++)
+		{
+			if (indexData[i] >= totalVertices)
+			{
+				std::cerr << "Model " << path << " has an index past its vertices" << std::endl;
+				return false;
+			}
+		}
+	}
+	else
+		indexData = convertedIndices.data();
+	if (!zeroCopyVertices)
+		vertexData = convertedVertices.data();
+	meshVertices = (GLuint)totalVertices;
+	// Whole triangles only
+	meshIndices = (GLuint)(totalIndices / 3 * 3);
+
+	// Images come out as their encoded bytes, the loader decodes them on its workers
+	const JsonValue& imageList = root["images"];
+	for (size_t i = 0; i < imageList.size(); i++)
+	{
+		const JsonValue& image = imageList[i];
+		std::shared_ptr<std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>();
+		const unsigned char* data;
+		size_t size, stride;
+		if (image.has("bufferView") && bufferView(image["bufferView"].Integer(-1), data, size, stride))
+			bytes->assign(data, data + size);
+		else if (!image.has("uri") || !readUri(image["uri"].string, directory, *bytes))
+			bytes->clear();
+		if (bytes->empty())
+		{
+			std::cerr << "Model " << path << " has image " << i << " which cannot be read, skipping it" << std::endl;
+			continue;
+		}
+		images.push_back(bytes);
+	}
+	return true;
+}
+
+const GLfloat* GltfModel::vertices() const
+{
+	return vertexData;
+}
+
+const GLuint* GltfModel::indices() const
+{
+	return indexData;
+}
+
+GLuint GltfModel::vertexCount() const
+{
+	return meshVertices;
+}
+
+GLuint GltfModel::indexCount() const
+{
+	return meshIndices;
+}
@@ -0,0 +1,55 @@
+#ifndef GLTF_MODEL_CLASS_H
+#define GLTF_MODEL_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+#include"CityGenerator.h"
+#include"MappedFile.h"
+#include"TextureLoader.h"
+
+// Mesh read from a glTF 2.0 file, .gltf with its buffers next to it or in data URIs, or a single .glb, fitted into the
+// unit cube so it can stand in for the unit building every building instance is scaled from
+// Every triangle primitive of the default scene is flattened into one mesh of CityGenerator::VERTEX_FLOATS vertices
+// with its node's transform. A buffer view that already holds such vertices, POSITION and TEXCOORD_0 as floats
+// interleaved 20 bytes apart inside the unit cube, is drawn straight out of the mapped file without any copy. Other
+// layouts are converted in one pass that transforms the positions with SSE where the CPU has it.
+// The images the file embeds come out as encoded bytes for TextureLoader to decode on its workers.
+// Normals, materials other than the image order, skins, morph targets and sparse accessors are not read.
+class GltfModel
+{
+public:
+	// Images the file embeds or refers to, in the order of its images array
+	std::vector<TextureLoader::Encoded> images;
+	// Set if the vertices or indices are read straight out of the mapped file
+	bool zeroCopyVertices = false;
+	bool zeroCopyIndices = false;
+
+	// Loads a model, false with the reason on stderr if the file is missing or not a usable model
+	bool Load(const std::string& path);
+	// Vertices in the layout of CityGenerator::Generate and the triangles over them, valid while the model lives
+	const GLfloat* vertices() const;
+	const GLuint* indices() const;
+	GLuint vertexCount() const;
+	GLuint indexCount() const;
+private:
+	// The file and the external buffers it refers to
+	MappedFile file;
+	std::vector<MappedFile> externalBuffers;
+	// Buffers that came out of data URIs
+	std::vector<std::vector<unsigned char>> decodedBuffers;
+	// Start and size of every buffer, wherever it lives
+	std::vector<std::pair<const unsigned char*, size_t>> buffers;
+	// Converted vertices and indices, empty when they are read from the file
+	std::vector<GLfloat> convertedVertices;
+	std::vector<GLuint> convertedIndices;
+	const GLfloat* vertexData = nullptr;
+	const GLuint* indexData = nullptr;
+	GLuint meshVertices = 0;
+	GLuint meshIndices = 0;
+};
+
+#endif
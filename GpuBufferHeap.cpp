@@ -0,0 +1,339 @@
+#include"GpuBufferHeap.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<algorithm>
+#include<utility>
+
+// Constructor that starts out with the whole capacity free
+RangeAllocator::RangeAllocator(uint32_t capacity)
+{
+	total = capacity;
+	Reset(0);
+}
+
+// Takes the smallest free range that fits
+uint32_t RangeAllocator::Allocate(uint32_t size)
+{
+	if (size == 0)
+		return 0;
+	// Best fit keeps large ranges around for large meshes
+	auto best = ranges.end();
+	for (auto it = ranges.begin(); it != ranges.end(); ++it)
+	{
+		if (it->second >= size && (best == ranges.end() || it->second < best->second))
+		{
+			best = it;
+			if (it->second == size)
+				break;
+		}
+	}
+	if (best == ranges.end())
+		return INVALID;
+
+	uint32_t offset = best->first;
+	uint32_t remaining = best->second - size;
+	ranges.erase(best);
+	if (remaining > 0)
+		ranges.emplace(offset + size, remaining);
+	freeTotal -= size;
+	return offset;
+}
+
+// Returns a range, merging it with free ranges right before and after it
+void RangeAllocator::Free(uint32_t offset, uint32_t size)
+{
+	if (size == 0)
+		return;
+	freeTotal += size;
+	auto next = ranges.lower_bound(offset);
+	if (next != ranges.end() && offset + size == next->first)
+	{
+		size += next->second;
+		next = ranges.erase(next);
+	}
+	if (next != ranges.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			previous->second += size;
+			return;
+		}
+	}
+	ranges.emplace(offset, size);
+}
+
+// Marks everything up to used as taken and the rest as one free range
+void RangeAllocator::Reset(uint32_t used)
+{
+	ranges.clear();
+	freeTotal = total - used;
+	if (freeTotal > 0)
+		ranges.emplace(used, freeTotal);
+}
+
+uint32_t RangeAllocator::freeSize() const
+{
+	return freeTotal;
+}
+
+uint32_t RangeAllocator::largestFree() const
+{
+	uint32_t largest = 0;
+	for (const auto& range : ranges)
+		largest = std::max(largest, range.second);
+	return largest;
+}
+
+uint32_t RangeAllocator::capacity() const
+{
+	return total;
+}
+
+// Constructor that reserves room for vertexCapacity vertices and indexCapacity indices
+GpuBufferHeap::GpuBufferHeap(GLsizei vertexStride, GLuint vertexCapacity, GLuint indexCapacity, GLenum indexType)
+	: vertexRanges(vertexCapacity), indexRanges(indexCapacity)
+{
+	GpuBufferHeap::vertexStride = vertexStride;
+	GpuBufferHeap::indexType = indexType;
+
+	glGenBuffers(1, &vertexBuffer);
+	GLState.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * vertexStride, nullptr, GL_STATIC_DRAW);
+	GpuMemory.Track(GPU_MEMORY_GEOMETRY, GL_BUFFER, vertexBuffer, (int64_t)vertexCapacity * vertexStride);
+	GLState.BindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// Bound as a copy target so creating it never changes the index buffer of whatever VAO is bound
+	glGenBuffers(1, &indexBuffer);
+	GLState.BindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)indexCapacity * EBO::IndexSize(indexType), nullptr, GL_STATIC_DRAW);
+	GpuMemory.Track(GPU_MEMORY_GEOMETRY, GL_BUFFER, indexBuffer, (int64_t)indexCapacity * EBO::IndexSize(indexType));
+	GLState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Deletes the buffers unless Delete was already called
+GpuBufferHeap::~GpuBufferHeap()
+{
+	Delete();
+}
+
+// Takes over the buffers and ranges of another heap, which is left empty
+GpuBufferHeap::GpuBufferHeap(GpuBufferHeap&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+// Deletes the current buffers and takes over the ones of another heap
+GpuBufferHeap& GpuBufferHeap::operator=(GpuBufferHeap&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		vertexBuffer = std::exchange(other.vertexBuffer, 0);
+		indexBuffer = std::exchange(other.indexBuffer, 0);
+		vertexStride = other.vertexStride;
+		indexType = other.indexType;
+		vertexRanges = other.vertexRanges;
+		indexRanges = other.indexRanges;
+		meshes = std::move(other.meshes);
+		live = std::move(other.live);
+		freeHandles = std::move(other.freeHandles);
+	}
+	return *this;
+}
+
+// Copies a mesh into the heap and returns its handle
+uint32_t GpuBufferHeap::Allocate(const void* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount)
+{
+	if (vertexCount > vertexRanges.freeSize() || indexCount > indexRanges.freeSize())
+		return INVALID;
+	// Indices are relative to the mesh, so it is the mesh's own size that has to fit 16 bits
+	if (indexType == GL_UNSIGNED_SHORT && EBO::IndexType(vertexCount) != GL_UNSIGNED_SHORT)
+		return INVALID;
+	// Enough space in total but no single range that fits, packing the meshes together makes one
+	if (vertexCount > vertexRanges.largestFree() || indexCount > indexRanges.largestFree())
+		Defragment();
+
+	uint32_t firstVertex = vertexRanges.Allocate(vertexCount);
+	uint32_t firstIndex = indexRanges.Allocate(indexCount);
+	if (firstVertex == RangeAllocator::INVALID || firstIndex == RangeAllocator::INVALID)
+	{
+		if (firstVertex != RangeAllocator::INVALID)
+			vertexRanges.Free(firstVertex, vertexCount);
+		if (firstIndex != RangeAllocator::INVALID)
+			indexRanges.Free(firstIndex, indexCount);
+		return INVALID;
+	}
+
+	if (vertexCount > 0)
+	{
+		GLState.BindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstVertex * vertexStride, (GLsizeiptr)vertexCount * vertexStride, vertices);
+		GLState.CountUpload((size_t)vertexCount * vertexStride);
+	}
+	if (indexCount > 0)
+	{
+		GLState.BindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+		GLsizeiptr indexSize = EBO::IndexSize(indexType);
+		if (indexType == GL_UNSIGNED_SHORT)
+		{
+			std::vector<GLushort> narrow(indices, indices + indexCount);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * indexSize, (GLsizeiptr)indexCount * indexSize, narrow.data());
+		}
+		else
+			glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)firstIndex * indexSize, (GLsizeiptr)indexCount * indexSize, indices);
+		GLState.CountUpload((size_t)indexCount * indexSize);
+	}
+	GLState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	DrawCommandBuilder::Mesh placed;
+	placed.firstIndex = firstIndex;
+	placed.indexCount = indexCount;
+	placed.baseVertex = (GLint)firstVertex;
+	placed.vertexCount = vertexCount;
+
+	uint32_t handle;
+	if (!freeHandles.empty())
+	{
+		handle = freeHandles.back();
+		freeHandles.pop_back();
+		meshes[handle] = placed;
+		live[handle] = true;
+	}
+	else
+	{
+		handle = (uint32_t)meshes.size();
+		meshes.push_back(placed);
+		live.push_back(true);
+	}
+	return handle;
+}
+
+// Gives the ranges of a mesh back
+void GpuBufferHeap::Free(uint32_t handle)
+{
+	if (handle >= meshes.size() || !live[handle])
+		return;
+	vertexRanges.Free((uint32_t)meshes[handle].baseVertex, meshes[handle].vertexCount);
+	indexRanges.Free(meshes[handle].firstIndex, meshes[handle].indexCount);
+	live[handle] = false;
+	freeHandles.push_back(handle);
+}
+
+// Where a mesh currently lives
+const DrawCommandBuilder::Mesh& GpuBufferHeap::mesh(uint32_t handle) const
+{
+	return meshes[handle];
+}
+
+// Byte offset of an index in indexBuffer
+const void* GpuBufferHeap::indexOffset(GLuint firstIndex) const
+{
+	return (const void*)((GLsizeiptr)firstIndex * EBO::IndexSize(indexType));
+}
+
+// Moves every mesh to the front of the buffers
+void GpuBufferHeap::Defragment()
+{
+	compact(vertexBuffer, vertexStride, true);
+	compact(indexBuffer, EBO::IndexSize(indexType), false);
+}
+
+// Copies the live ranges of one buffer packed together into the front of it
+void GpuBufferHeap::compact(GLuint buffer, GLsizeiptr elementSize, bool vertices)
+{
+	auto offsetOf = [&](uint32_t handle) { return vertices ? (uint32_t)meshes[handle].baseVertex : meshes[handle].firstIndex; };
+	auto sizeOf = [&](uint32_t handle) { return vertices ? meshes[handle].vertexCount : meshes[handle].indexCount; };
+	RangeAllocator& ranges = vertices ? vertexRanges : indexRanges;
+
+	// Packing in offset order means every range only ever moves towards the front
+	std::vector<uint32_t> order;
+	uint32_t used = 0;
+	for (uint32_t handle = 0; handle < meshes.size(); handle++)
+	{
+		if (live[handle])
+		{
+			order.push_back(handle);
+			used += sizeOf(handle);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return offsetOf(a) < offsetOf(b); });
+
+	// Nothing to copy when the live ranges already start at 0 and follow each other
+	uint32_t expected = 0;
+	bool packed = true;
+	for (uint32_t handle : order)
+	{
+		// Empty meshes sit at offset 0 and never move
+		packed = packed && (sizeOf(handle) == 0 || offsetOf(handle) == expected);
+		expected += sizeOf(handle);
+	}
+	if (packed)
+	{
+		ranges.Reset(used);
+		return;
+	}
+
+	// Copies within one buffer may not overlap, so the packed ranges go through a scratch buffer and back in one copy
+	GLuint scratch;
+	glGenBuffers(1, &scratch);
+	GLState.BindBuffer(GL_COPY_WRITE_BUFFER, scratch);
+	glBufferData(GL_COPY_WRITE_BUFFER, used * elementSize, nullptr, GL_STREAM_COPY);
+	GLState.BindBuffer(GL_COPY_READ_BUFFER, buffer);
+	uint32_t offset = 0;
+	for (uint32_t handle : order)
+	{
+		uint32_t size = sizeOf(handle);
+		if (size == 0)
+			continue;
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offsetOf(handle) * elementSize, offset * elementSize, size * elementSize);
+		if (vertices)
+			meshes[handle].baseVertex = (GLint)offset;
+		else
+			meshes[handle].firstIndex = offset;
+		offset += size;
+	}
+	GLState.BindBuffer(GL_COPY_READ_BUFFER, scratch);
+	GLState.BindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used * elementSize);
+	GLState.BindBuffer(GL_COPY_READ_BUFFER, 0);
+	GLState.BindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	GLState.DeleteBuffers(1, &scratch);
+
+	ranges.Reset(used);
+}
+
+// Free vertices and indices
+GLuint GpuBufferHeap::freeVertices() const
+{
+	return vertexRanges.freeSize();
+}
+
+GLuint GpuBufferHeap::freeIndices() const
+{
+	return indexRanges.freeSize();
+}
+
+GLuint GpuBufferHeap::largestFreeVertices() const
+{
+	return vertexRanges.largestFree();
+}
+
+GLuint GpuBufferHeap::largestFreeIndices() const
+{
+	return indexRanges.largestFree();
+}
+
+// Deletes the buffers
+void GpuBufferHeap::Delete()
+{
+	if (vertexBuffer != 0)
+		GLState.DeleteBuffers(1, &vertexBuffer);
+	if (indexBuffer != 0)
+		GLState.DeleteBuffers(1, &indexBuffer);
+	vertexBuffer = indexBuffer = 0;
+	meshes.clear();
+	live.clear();
+	freeHandles.clear();
+}
@@ -0,0 +1,104 @@
+#ifndef GPU_BUFFER_HEAP_CLASS_H
+#define GPU_BUFFER_HEAP_CLASS_H
+
+#include<glad/glad.h>
+#include<map>
+#include<vector>
+#include<cstdint>
+
+#include"DrawCommandBuilder.h"
+#include"EBO.h"
+
+// Hands out ranges of a fixed capacity, free ranges are kept sorted by offset and merged with their neighbours
+class RangeAllocator
+{
+public:
+	// Returned when no free range is large enough
+	static constexpr uint32_t INVALID = 0xffffffffu;
+
+	// Constructor that starts out with the whole capacity free
+	RangeAllocator(uint32_t capacity = 0);
+
+	// Takes the smallest free range that fits and returns its offset, a size of 0 always succeeds at offset 0
+	uint32_t Allocate(uint32_t size);
+	// Returns a range, merging it with free ranges right before and after it
+	void Free(uint32_t offset, uint32_t size);
+	// Marks everything up to used as taken and the rest as one free range, used after compacting
+	void Reset(uint32_t used);
+	// Total free space and the largest single free range
+	uint32_t freeSize() const;
+	uint32_t largestFree() const;
+	uint32_t capacity() const;
+private:
+	uint32_t total;
+	uint32_t freeTotal;
+	// Offset to size of every free range
+	std::map<uint32_t, uint32_t> ranges;
+};
+
+// One large vertex buffer and one large index buffer that many meshes of the same vertex layout are placed into,
+// so all of them are drawn with a single VAO bound. Indices stay relative to their own mesh and are drawn with
+// the mesh's base vertex, which lets Defragment move meshes around without touching their indices.
+class GpuBufferHeap
+{
+public:
+	// Returned when a mesh does not fit
+	static constexpr uint32_t INVALID = 0xffffffffu;
+	// Storage buffer binding vertex shaders that pull their vertices read vertexBuffer from, above the ones the
+	// culling passes bind between draws
+	static constexpr GLuint PULL_BINDING = 7;
+
+	// Shared buffers, format one VAO for them, link vertexBuffer with VAO::LinkBuffer and indexBuffer with VAO::LinkElements
+	GLuint vertexBuffer = 0;
+	GLuint indexBuffer = 0;
+	// Size in bytes of one vertex
+	GLsizei vertexStride = 0;
+	// Type of the indices in indexBuffer, draws from the heap have to pass it on
+	GLenum indexType = GL_UNSIGNED_INT;
+
+	// Constructor that reserves room for vertexCapacity vertices and indexCapacity indices
+	// With GL_UNSIGNED_SHORT indices are stored as 16 bit, which only holds meshes of up to 65536 vertices
+	GpuBufferHeap(GLsizei vertexStride, GLuint vertexCapacity, GLuint indexCapacity, GLenum indexType = GL_UNSIGNED_INT);
+	// Deletes the buffers unless Delete was already called, the context has to still be current
+	~GpuBufferHeap();
+	// A GpuBufferHeap owns its buffers, so it can be moved but not copied
+	GpuBufferHeap(const GpuBufferHeap&) = delete;
+	GpuBufferHeap& operator=(const GpuBufferHeap&) = delete;
+	GpuBufferHeap(GpuBufferHeap&& other) noexcept;
+	GpuBufferHeap& operator=(GpuBufferHeap&& other) noexcept;
+
+	// Copies a mesh into the heap and returns its handle, defragments once if the free space is too scattered
+	// Indices are narrowed to 16 bit for a GL_UNSIGNED_SHORT heap
+	// Returns INVALID when the mesh does not fit at all, or has too many vertices for 16 bit indices
+	uint32_t Allocate(const void* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount);
+	// Gives the ranges of a mesh back, the handle may be reused by a later Allocate
+	void Free(uint32_t handle);
+	// Where a mesh currently lives, the ranges change when the heap is defragmented
+	const DrawCommandBuilder::Mesh& mesh(uint32_t handle) const;
+	// Byte offset of an index in indexBuffer, for the pointer argument of glDrawElements
+	const void* indexOffset(GLuint firstIndex) const;
+	// Moves every mesh to the front of the buffers so the free space becomes one range at the end
+	void Defragment();
+
+	// Free vertices and indices, in total and in the largest range
+	GLuint freeVertices() const;
+	GLuint freeIndices() const;
+	GLuint largestFreeVertices() const;
+	GLuint largestFreeIndices() const;
+
+	// Deletes the buffers, does nothing if they were already deleted or moved from
+	void Delete();
+private:
+	RangeAllocator vertexRanges;
+	RangeAllocator indexRanges;
+	// Ranges of every handle and whether it is in use
+	std::vector<DrawCommandBuilder::Mesh> meshes;
+	std::vector<bool> live;
+	// Handles given back by Free
+	std::vector<uint32_t> freeHandles;
+
+	// Copies the live ranges of one buffer packed together into the front of it
+	void compact(GLuint buffer, GLsizeiptr elementSize, bool vertices);
+};
+
+#endif
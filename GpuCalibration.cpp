@@ -0,0 +1,323 @@
+#include"GpuCalibration.h"
+#include"GLStateCache.h"
+#include"LogQueue.h"
+
+#include<algorithm>
+#include<chrono>
+#include<fstream>
+#include<iostream>
+#include<sstream>
+#include<vector>
+
+std::string GpuCalibration::path = "gpucalibration.txt";
+
+const GpuCalibration::Tier GpuCalibration::TIERS[GpuCalibration::TIER_COUNT] = {
+	{ "ultra", 1.0f, 4096, true, AntiAliasing::MSAA_4X, 1.0f },
+	{ "high", 1.0f, 2048, true, AntiAliasing::FXAA, 1.0f },
+	{ "medium", 1.0f, 1024, false, AntiAliasing::FXAA, 1.5f },
+	{ "low", 0.75f, 1024, false, AntiAliasing::NONE, 2.0f },
+	{ "lowest", 0.5f, 0, false, AntiAliasing::NONE, 3.0f }
+};
+
+// Side of the offscreen target the passes draw into
+static const GLsizei TARGET_SIZE = 1024;
+// Full screen triangles of the fill pass
+static const GLsizei FILL_LAYERS = 64;
+// Vertices of the vertex pass, a million triangles
+static const GLsizei VERTEX_COUNT = 3 << 20;
+// Side of the texture the texture pass fetches from, 16 MB is more than the caches of any GPU hold
+static const GLsizei TEXTURE_SIZE = 2048;
+// Fetches per pixel of the texture pass, as in its shader, and how often the pass covers the target
+static const int TEXTURE_TAPS = 8;
+static const GLsizei TEXTURE_LAYERS = 4;
+// Timed rounds of each pass after the one that warms it up
+static const int ROUNDS = 3;
+
+// The frame the tiers are estimated for: the city covers the screen this many times over
+static const float OVERDRAW = 2.5f;
+// Vertices the scene transforms at a level of detail bias of 1, half again with shadows for their casters
+static const float SCENE_VERTICES = 3.0e6f;
+// Texels each drawn pixel fetches, the measured bandwidth is of scattered fetches so this errs on the slow side
+static const float PIXEL_TEXELS = 4.0f;
+// Texels per pixel of SSAO with its blur, of FXAA, and of the upscale of a scaled scene
+static const float SSAO_TEXELS = 20.0f;
+static const float FXAA_TEXELS = 9.0f;
+static const float UPSCALE_TEXELS = 5.0f;
+// Cached cascades are drawn again only when the view moved far enough, a frame pays for about one of the three
+static const float SHADOW_CASCADES_PER_FRAME = 1.0f;
+
+// Full screen triangle, once per instance
+static const char* screenVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+static const char* fillFragmentSource = R"(
+#version 330 core
+uniform vec4 color;
+out vec4 FragColor;
+void main()
+{
+    FragColor = color;
+}
+)";
+// The three vertices of a triangle land on the same point, so it has no area and none of it is rasterized
+static const char* pointsVertexSource = R"(
+#version 330 core
+uniform mat4 transform;
+void main()
+{
+    int triangle = gl_VertexID / 3;
+    gl_Position = transform * vec4(float(triangle & 1023), float(triangle >> 10), 0.0, 1.0);
+}
+)";
+// Fetches from a PCG sequence seeded by the pixel, neighbouring pixels share no cache line
+static const char* textureFragmentSource = R"(
+#version 330 core
+uniform sampler2D noise;
+out vec4 FragColor;
+void main()
+{
+    uint mask = uint(textureSize(noise, 0).x - 1);
+    uint state = uint(gl_FragCoord.x) * 1973u + uint(gl_FragCoord.y) * 9277u;
+    vec4 sum = vec4(0.0);
+    for (int i = 0; i < 8; i++)
+    {
+        state = state * 747796405u + 2891336453u;
+        sum += texelFetch(noise, ivec2(int(state & mask), int((state >> 16) & mask)), 0);
+    }
+    FragColor = sum;
+}
+)";
+
+// Compiles and links a program of two stages, 0 with the errors logged if either fails
+static GLuint buildProgram(const char* vertexSource, const char* fragmentSource, const char* name)
+{
+	GLuint program = glCreateProgram();
+	const char* sources[2] = { vertexSource, fragmentSource };
+	const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	for (int i = 0; i < 2; i++)
+	{
+		GLuint shader = glCreateShader(types[i]);
+		glShaderSource(shader, 1, &sources[i], nullptr);
+		glCompileShader(shader);
+		glAttachShader(program, shader);
+		glDeleteShader(shader);
+	}
+	glLinkProgram(program);
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		GLchar infoLog[512];
+		glGetProgramInfoLog(program, 512, nullptr, infoLog);
+		LOG_MESSAGE(LOG_ERROR, "SHADER_LINKING_ERROR for:%s\n%s", name, infoLog);
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+// Seconds of the fastest timed round of a pass
+template<typename Draw>
+static double timePass(GLuint query, Draw draw)
+{
+	double best = 1e9;
+	for (int round = 0; round <= ROUNDS; round++)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		draw();
+		glEndQuery(GL_TIME_ELAPSED);
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		if (round > 0)
+			best = std::min(best, nanoseconds * 1e-9);
+	}
+	return std::max(best, 1e-6);
+}
+
+// The cache is read unless forced
+void GpuCalibration::Run(bool force)
+{
+	std::string key = driver();
+	cached = !force && load(key);
+	if (cached)
+		return;
+	auto start = std::chrono::steady_clock::now();
+	measure();
+	float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "Calibrated the GPU in " << milliseconds << " ms: " << fillGigapixels << " Gpixels/s, " << vertexMillions
+		<< " Mvertices/s, " << textureGigabytes << " GB/s of texels" << std::endl;
+	store(key);
+}
+
+// Each part of the frame takes what its pixels, vertices and texels cost at the measured rates
+float GpuCalibration::Estimate(const Tier& tier, int width, int height, bool deferred) const
+{
+	if (fillGigapixels <= 0.0f || vertexMillions <= 0.0f || textureGigabytes <= 0.0f)
+		return 1e9f;
+	float output = (float)width * (float)height;
+	float pixels = output * tier.resolutionScale * tier.resolutionScale;
+	// Deferred frames draw into a single sampled G-buffer of three targets, forward frames into every sample
+	int samples = tier.antiAliasing == AntiAliasing::MSAA_2X ? 2 : tier.antiAliasing == AntiAliasing::MSAA_4X ? 4
+		: tier.antiAliasing == AntiAliasing::MSAA_8X ? 8 : 1;
+	if (deferred)
+		samples = 1;
+	float written = pixels * OVERDRAW * (deferred ? 3.0f : 1.0f + 0.25f * (samples - 1));
+	written += (float)tier.shadowSize * (float)tier.shadowSize * SHADOW_CASCADES_PER_FRAME;
+	float vertices = SCENE_VERTICES / tier.lodBias * (tier.shadowSize > 0 ? 1.5f : 1.0f);
+	float texels = pixels * OVERDRAW * PIXEL_TEXELS + pixels * (samples > 1 ? (float)samples : 0.0f);
+	if (deferred && tier.ssao)
+		texels += pixels * SSAO_TEXELS;
+	if (tier.antiAliasing == AntiAliasing::FXAA)
+		texels += pixels * FXAA_TEXELS;
+	if (tier.resolutionScale < 1.0f)
+		texels += output * UPSCALE_TEXELS;
+	return 1e3f * (written / (fillGigapixels * 1e9f) + vertices / (vertexMillions * 1e6f) + texels * 4.0f / (textureGigabytes * 1e9f));
+}
+
+// The tiers go from the most expensive down
+const GpuCalibration::Tier& GpuCalibration::Pick(float targetMilliseconds, int width, int height, bool deferred) const
+{
+	for (const Tier& tier : TIERS)
+		if (Estimate(tier, width, height, deferred) <= targetMilliseconds)
+			return tier;
+	return TIERS[TIER_COUNT - 1];
+}
+
+// Vendor, renderer and version of the driver
+std::string GpuCalibration::driver()
+{
+	std::string key;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+	{
+		const char* text = (const char*)glGetString(name);
+		key += (key.empty() ? "" : " | ") + std::string(text ? text : "");
+	}
+	return key;
+}
+
+// Each line holds the three numbers and the driver
+bool GpuCalibration::load(const std::string& key)
+{
+	std::ifstream file(path);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields(line);
+		float fill, vertex, texture;
+		std::string name;
+		if (fields >> fill >> vertex >> texture && std::getline(fields >> std::ws, name) && name == key)
+		{
+			fillGigapixels = fill;
+			vertexMillions = vertex;
+			textureGigabytes = texture;
+			return true;
+		}
+	}
+	return false;
+}
+
+// The lines of other drivers are kept, the whole file is written again
+void GpuCalibration::store(const std::string& key) const
+{
+	std::vector<std::string> lines;
+	{
+		std::ifstream file(path);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			size_t at = line.find(key);
+			if (!line.empty() && (at == std::string::npos || at + key.size() != line.size()))
+				lines.push_back(line);
+		}
+	}
+	std::ofstream file(path, std::ios::trunc);
+	for (const std::string& line : lines)
+		file << line << "\n";
+	file << fillGigapixels << " " << vertexMillions << " " << textureGigabytes << " " << key << "\n";
+	if (!file)
+		std::cerr << "Could not write the GPU calibration to " << path << std::endl;
+}
+
+// The passes draw into a target of their own, with the state they change put back afterwards
+void GpuCalibration::measure()
+{
+	GLint previousFramebuffer;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	GLuint color, framebuffer;
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, TARGET_SIZE, TARGET_SIZE);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glViewport(0, 0, TARGET_SIZE, TARGET_SIZE);
+
+	// Noise, so no driver can tell the texture is uniform and compress it
+	std::vector<uint32_t> noise((size_t)TEXTURE_SIZE * TEXTURE_SIZE);
+	uint32_t state = 0x9E3779B9u;
+	for (uint32_t& texel : noise)
+	{
+		state = state * 1664525u + 1013904223u;
+		texel = state;
+	}
+	GLuint texture;
+	glGenTextures(1, &texture);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	GLState.BindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, TEXTURE_SIZE, TEXTURE_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, noise.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	GLuint fillProgram = buildProgram(screenVertexSource, fillFragmentSource, "FILL");
+	GLuint pointsProgram = buildProgram(pointsVertexSource, fillFragmentSource, "VERTICES");
+	GLuint textureProgram = buildProgram(screenVertexSource, textureFragmentSource, "TEXTURE");
+	GLuint vao, query;
+	glGenVertexArrays(1, &vao);
+	glGenQueries(1, &query);
+	GLState.BindVertexArray(vao);
+
+	if (fillProgram)
+	{
+		GLState.UseProgram(fillProgram);
+		glUniform4f(glGetUniformLocation(fillProgram, "color"), 0.2f, 0.4f, 0.6f, 1.0f);
+		double seconds = timePass(query, []() { glDrawArraysInstanced(GL_TRIANGLES, 0, 3, FILL_LAYERS); });
+		fillGigapixels = (float)((double)TARGET_SIZE * TARGET_SIZE * FILL_LAYERS / seconds * 1e-9);
+	}
+	if (pointsProgram)
+	{
+		// Every point lands off the target
+		const GLfloat transform[16] = { 1e-4f, 0, 0, 0, 0, 1e-4f, 0, 0, 0, 0, 1, 0, 2, 2, 0, 1 };
+		GLState.UseProgram(pointsProgram);
+		glUniformMatrix4fv(glGetUniformLocation(pointsProgram, "transform"), 1, GL_FALSE, transform);
+		double seconds = timePass(query, []() { glDrawArrays(GL_TRIANGLES, 0, VERTEX_COUNT); });
+		vertexMillions = (float)(VERTEX_COUNT / seconds * 1e-6);
+	}
+	if (textureProgram)
+	{
+		GLState.UseProgram(textureProgram);
+		glUniform1i(glGetUniformLocation(textureProgram, "noise"), 0);
+		double seconds = timePass(query, []() { glDrawArraysInstanced(GL_TRIANGLES, 0, 3, TEXTURE_LAYERS); });
+		textureGigabytes = (float)((double)TARGET_SIZE * TARGET_SIZE * TEXTURE_LAYERS * TEXTURE_TAPS * 4.0 / seconds * 1e-9);
+	}
+
+	GLState.UseProgram(0);
+	GLState.BindVertexArray(0);
+	GLState.DeleteVertexArrays(1, &vao);
+	glDeleteQueries(1, &query);
+	GLState.DeleteProgram(fillProgram);
+	GLState.DeleteProgram(pointsProgram);
+	GLState.DeleteProgram(textureProgram);
+	GLState.DeleteTextures(1, &texture);
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &color);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
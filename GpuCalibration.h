@@ -0,0 +1,67 @@
+#ifndef GPU_CALIBRATION_CLASS_H
+#define GPU_CALIBRATION_CLASS_H
+
+#include<glad/glad.h>
+#include<string>
+
+#include"AntiAliasing.h"
+
+// Measures what the GPU can do in a few hundred milliseconds on a canned load and picks the quality tier that should
+// hold a target frame time. Three passes into an offscreen target are timed with timer queries, the fastest of a few
+// rounds counting: full screen triangles for the fill rate, degenerate triangles for the vertex throughput and
+// scattered texel fetches from a texture larger than the caches for the texture bandwidth. A coarse model of a frame
+// turns them into the GPU time of each tier, the highest one within the target wins. The measurements are kept in a
+// text file with one line per vendor, renderer and driver version, so only the first run on a GPU or after a driver
+// update measures.
+class GpuCalibration
+{
+public:
+	// What a tier turns on, from the most expensive to the cheapest
+	struct Tier
+	{
+		const char* name;
+		// Largest scale of each side of the scene, below 1 the scene is drawn smaller and scaled up
+		float resolutionScale;
+		// Texels a side of the sun shadow maps, 0 for no shadows
+		int shadowSize;
+		// Screen space ambient occlusion, which only deferred frames have
+		bool ssao;
+		AntiAliasing::Mode antiAliasing;
+		// Multiplies the projected sizes blocks switch to impostors and billboards at, so more of the city is simplified
+		float lodBias;
+	};
+
+	static constexpr int TIER_COUNT = 5;
+	static const Tier TIERS[TIER_COUNT];
+
+	// File the measurements are cached in, relative to the working directory
+	static std::string path;
+
+	// Opaque pixels written per second, in billions
+	float fillGigapixels = 0.0f;
+	// Vertices transformed per second, in millions
+	float vertexMillions = 0.0f;
+	// Bytes of scattered texel fetches per second, in billions
+	float textureGigabytes = 0.0f;
+	// True when the numbers came from the cache rather than a measurement
+	bool cached = false;
+
+	// Reads the numbers of the current GPU and driver from the cache, or measures and caches them, needs a current
+	// context. With force the cache is not read
+	void Run(bool force = false);
+	// Estimated GPU milliseconds of a frame drawn at a tier into an output of width by height
+	float Estimate(const Tier& tier, int width, int height, bool deferred) const;
+	// Highest tier whose estimate is within targetMilliseconds, the cheapest one when none is
+	const Tier& Pick(float targetMilliseconds, int width, int height, bool deferred) const;
+private:
+	// Vendor, renderer and version of the current driver, the key of its line in the cache
+	static std::string driver();
+	// Reads the line of the driver, false if there is none
+	bool load(const std::string& key);
+	// Replaces the line of the driver, or adds it
+	void store(const std::string& key) const;
+	// Runs the three passes
+	void measure();
+};
+
+#endif
@@ -0,0 +1,265 @@
+#include"GpuCityGenerator.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLExtensions.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+
+// One invocation per lot, the hashes are CityGenerator's so the same seed gives the same building
+static const char* generateSource = R"(
+#version 430 core
+layout(local_size_x = 64) in;
+
+struct Lot
+{
+    float minX;
+    float minZ;
+    float maxX;
+    float maxZ;
+    float minHeight;
+    float maxHeight;
+    uint roof;
+    uint seed;
+};
+layout(std430, binding = 0) readonly buffer Lots { Lot lots[]; };
+// Instance records, or vertices of VERTEX_FLOATS floats
+layout(std430, binding = 1) writeonly buffer Output { float outputs[]; };
+layout(std430, binding = 2) writeonly buffer Indices { uint indices[]; };
+
+uniform uint mode;
+uniform uint first;
+uniform uint count;
+uniform uint firstVertex;
+uniform uint firstIndex;
+uniform float lotCoverage;
+uniform uint facadeCount;
+uniform float textureScale;
+uniform vec3 buildingColor;
+
+uint hashLot(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float unitFloat(uint hash)
+{
+    return float(hash >> 8) * (1.0 / 16777216.0);
+}
+
+void writeVertex(uint vertex, vec3 position, vec2 uv)
+{
+    uint at = vertex * 5u;
+    outputs[at] = position.x;
+    outputs[at + 1u] = position.y;
+    outputs[at + 2u] = position.z;
+    outputs[at + 3u] = uv.x;
+    outputs[at + 4u] = uv.y;
+}
+
+void main()
+{
+    if (gl_GlobalInvocationID.x >= count)
+        return;
+    uint index = first + gl_GlobalInvocationID.x;
+    Lot lot = lots[index];
+
+    // The footprint is centered on the lot, as CityGenerator::building places it
+    uint hash = lot.seed;
+    float height = lot.minHeight + (lot.maxHeight - lot.minHeight) * unitFloat(hash);
+    float width = (lot.maxX - lot.minX) * lotCoverage * (0.75 + 0.25 * unitFloat(hashLot(hash)));
+    float depth = (lot.maxZ - lot.minZ) * lotCoverage * (0.75 + 0.25 * unitFloat(hashLot(hash + 1u)));
+    float x0 = lot.minX + 0.5 * (lot.maxX - lot.minX - width);
+    float z0 = lot.minZ + 0.5 * (lot.maxZ - lot.minZ - depth);
+    float x1 = x0 + width, z1 = z0 + depth;
+    uint facade = facadeCount > 1u ? hashLot(hash + 2u) % facadeCount : 0u;
+
+    if (mode == 0u)
+    {
+        uint at = index * 12u;
+        outputs[at] = x0;
+        outputs[at + 1u] = 0.0;
+        outputs[at + 2u] = z0;
+        outputs[at + 3u] = width;
+        outputs[at + 4u] = height;
+        outputs[at + 5u] = depth;
+        outputs[at + 6u] = float(facade);
+        outputs[at + 7u] = 0.0;
+        outputs[at + 8u] = buildingColor.r;
+        outputs[at + 9u] = buildingColor.g;
+        outputs[at + 10u] = buildingColor.b;
+        outputs[at + 11u] = 0.0;
+        return;
+    }
+
+    // Walls and roof face by face as CityGenerator::writeFaces writes them, a shed roof raises the +Z edge
+    float rise = lot.roof == 1u ? 0.25 * depth : 0.0;
+    vec2 walls[8] = vec2[8](vec2(x0, z1), vec2(x1, z1), vec2(x1, z1), vec2(x1, z0),
+        vec2(x1, z0), vec2(x0, z0), vec2(x0, z0), vec2(x0, z1));
+    uint base = firstVertex + index * 20u;
+    for (uint w = 0u; w < 4u; w++)
+    {
+        vec2 a = walls[w * 2u], b = walls[w * 2u + 1u];
+        float u = length(b - a) * textureScale;
+        float topA = height + rise * (a.y - z0) / depth;
+        float topB = height + rise * (b.y - z0) / depth;
+        writeVertex(base + w * 4u, vec3(a.x, 0.0, a.y), vec2(0.0, 0.0));
+        writeVertex(base + w * 4u + 1u, vec3(b.x, 0.0, b.y), vec2(u, 0.0));
+        writeVertex(base + w * 4u + 2u, vec3(b.x, topB, b.y), vec2(u, topB * textureScale));
+        writeVertex(base + w * 4u + 3u, vec3(a.x, topA, a.y), vec2(0.0, topA * textureScale));
+    }
+    writeVertex(base + 16u, vec3(x0, height + rise, z1), vec2(0.0, 1.0));
+    writeVertex(base + 17u, vec3(x1, height + rise, z1), vec2(1.0, 1.0));
+    writeVertex(base + 18u, vec3(x1, height, z0), vec2(1.0, 0.0));
+    writeVertex(base + 19u, vec3(x0, height, z0), vec2(0.0, 0.0));
+
+    // Two counter-clockwise triangles per face
+    uint at = firstIndex + index * 30u;
+    for (uint face = 0u; face < 5u; face++)
+    {
+        uint corner = base + face * 4u;
+        indices[at] = corner;
+        indices[at + 1u] = corner + 1u;
+        indices[at + 2u] = corner + 2u;
+        indices[at + 3u] = corner + 2u;
+        indices[at + 4u] = corner + 3u;
+        indices[at + 5u] = corner;
+        at += 6u;
+    }
+}
+)";
+
+// Checks if the context has what the generator needs
+bool GpuCityGenerator::Supported()
+{
+	return GLExt.computeShader && GLExt.shaderStorage;
+}
+
+// Constructor that allocates the lot buffer and builds the program
+GpuCityGenerator::GpuCityGenerator(GLuint lotCapacity)
+{
+	GpuCityGenerator::lotCapacity = lotCapacity;
+	GLsizeiptr lotBytes = (GLsizeiptr)std::max<GLuint>(lotCapacity, 1) * sizeof(Lot);
+	glGenBuffers(1, &lots);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, lots);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, lotBytes, nullptr, GL_DYNAMIC_DRAW);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, lots, (int64_t)lotBytes);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	program = Shader::LinkCompute(generateSource);
+	GLState.UseProgram(program);
+	glUniform1f(glGetUniformLocation(program, "textureScale"), CityGenerator::FACADE_TEXTURE_SCALE);
+	glUniform3fv(glGetUniformLocation(program, "buildingColor"), 1, CityGenerator::BUILDING_COLOR);
+	GLState.UseProgram(0);
+}
+
+// Deletes the GL objects unless Delete was already called
+GpuCityGenerator::~GpuCityGenerator()
+{
+	Delete();
+}
+
+// Lays the lots out as CityGenerator::building finds their corners, every one with the seed the CPU would draw from
+void GpuCityGenerator::SetLots(const CityGenerator& city)
+{
+	const CityLayout& layout = city.layout;
+	lotCoverage = layout.lotCoverage;
+	facadeCount = layout.facadeCount;
+	GLuint count = (GLuint)std::min<size_t>(city.buildingCount(), lotCapacity);
+	std::vector<Lot> cityLots(count);
+	float blockPitch = layout.lotsPerSide * layout.lotSize + layout.streetWidth;
+	for (GLuint i = 0; i < count; i++)
+	{
+		size_t block = i / city.lotsPerBlock();
+		unsigned int lot = i % city.lotsPerBlock();
+		Lot& out = cityLots[i];
+		out.minX = -city.halfExtentX() + layout.streetWidth + (block % layout.blocksX) * blockPitch + (lot % layout.lotsPerSide) * layout.lotSize;
+		out.minZ = -city.halfExtentZ() + layout.streetWidth + (block / layout.blocksX) * blockPitch + (lot / layout.lotsPerSide) * layout.lotSize;
+		out.maxX = out.minX + layout.lotSize;
+		out.maxZ = out.minZ + layout.lotSize;
+		out.minHeight = layout.minHeight;
+		out.maxHeight = layout.maxHeight;
+		out.roof = FLAT_ROOF;
+		out.seed = city.lotSeed(i);
+	}
+	lotsSet = 0;
+	Update(0, count, cityLots.data());
+}
+
+// Uploads a range of lots
+void GpuCityGenerator::Update(GLuint first, GLuint count, const Lot* source)
+{
+	if (first >= lotCapacity)
+		return;
+	count = std::min(count, lotCapacity - first);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, lots);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)first * sizeof(Lot), (GLsizeiptr)count * sizeof(Lot), source);
+	GLState.CountUpload((size_t)count * sizeof(Lot));
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	lotsSet = std::max(lotsSet, first + count);
+}
+
+// Writes instance records
+void GpuCityGenerator::GenerateRecords(GLuint buffer, GLuint first, GLuint count)
+{
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, buffer);
+	dispatch(0, first, count, 0, 0);
+}
+
+// Writes vertices and indices
+void GpuCityGenerator::GenerateMesh(GLuint vertexBuffer, GLuint indexBuffer, GLuint firstVertex, GLuint firstIndex, GLuint first, GLuint count)
+{
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, vertexBuffer);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, indexBuffer);
+	dispatch(1, first, count, firstVertex, firstIndex);
+}
+
+GLuint GpuCityGenerator::capacity() const
+{
+	return lotCapacity;
+}
+
+GLuint GpuCityGenerator::lotCount() const
+{
+	return lotsSet;
+}
+
+// Dispatches the program over the lots of a range that were set
+void GpuCityGenerator::dispatch(GLuint mode, GLuint first, GLuint count, GLuint firstVertex, GLuint firstIndex)
+{
+	if (first >= lotsSet)
+		return;
+	count = std::min(count, lotsSet - first);
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lots);
+	GLState.UseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "mode"), mode);
+	glUniform1ui(glGetUniformLocation(program, "first"), first);
+	glUniform1ui(glGetUniformLocation(program, "count"), count);
+	glUniform1ui(glGetUniformLocation(program, "firstVertex"), firstVertex);
+	glUniform1ui(glGetUniformLocation(program, "firstIndex"), firstIndex);
+	glUniform1f(glGetUniformLocation(program, "lotCoverage"), lotCoverage);
+	glUniform1ui(glGetUniformLocation(program, "facadeCount"), facadeCount);
+	GLState.CountUniforms(7);
+	glDispatchCompute((count + 63) / 64, 1, 1);
+	// The results are read as instance attributes, vertices and indices, or by a culler's storage buffer reads
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	GLState.UseProgram(previousProgram);
+}
+
+// Deletes the GL objects
+void GpuCityGenerator::Delete()
+{
+	if (lots != 0)
+		GLState.DeleteBuffers(1, &lots);
+	lots = 0;
+	if (program != 0)
+		GLState.DeleteProgram(program);
+	program = 0;
+}
@@ -0,0 +1,81 @@
+#ifndef GPU_CITY_GENERATOR_CLASS_H
+#define GPU_CITY_GENERATOR_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<vector>
+
+#include"CityGenerator.h"
+
+// Builds the buildings of lots with a compute shader, straight into GPU buffers, instead of CityGenerator on the CPU
+// Every lot is a small record of its footprint, height range, roof and seed in a storage buffer, one invocation per
+// lot draws its building from the seed exactly as CityGenerator::building does and writes either its instance record
+// or its vertices and indices. Only the lot records ever cross the bus, so a district whose lots change is rebuilt by
+// uploading them and dispatching again. Meshes are written face by face, not in the order MeshOptimizer picks.
+class GpuCityGenerator
+{
+public:
+	// Roofs a lot can have, only meshes show them, an instance record scales the unit building which is always flat
+	static constexpr GLuint FLAT_ROOF = 0;
+	// Slopes up towards +Z by a quarter of the footprint's depth, the walls follow it
+	static constexpr GLuint SHED_ROOF = 1;
+
+	// One lot as the shader reads it, 32 bytes
+	struct Lot
+	{
+		// Corners of the lot the footprint is centered on
+		float minX;
+		float minZ;
+		float maxX;
+		float maxZ;
+		// Range the height is picked from
+		float minHeight;
+		float maxHeight;
+		GLuint roof;
+		// Random bits every value of the building is drawn from, such as CityGenerator::lotSeed
+		GLuint seed;
+	};
+
+	// Fraction of a lot covered by the building footprint and number of facade textures, as in CityLayout
+	float lotCoverage = 0.8f;
+	GLuint facadeCount = 1;
+
+	// Checks if the context has compute shaders and storage buffers
+	static bool Supported();
+
+	// Constructor for up to lotCapacity lots
+	GpuCityGenerator(GLuint lotCapacity);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~GpuCityGenerator();
+	// A GpuCityGenerator owns its GL objects, so it cannot be copied
+	GpuCityGenerator(const GpuCityGenerator&) = delete;
+	GpuCityGenerator& operator=(const GpuCityGenerator&) = delete;
+
+	// Takes the lots, coverage and facades of a city, lot i standing for building i, and uploads them
+	void SetLots(const CityGenerator& city);
+	// Replaces count lots from first, the only upload a rebuild of them needs
+	void Update(GLuint first, GLuint count, const Lot* lots);
+	// Writes the instance record of every lot from first on into buffer, lot i's at record i
+	void GenerateRecords(GLuint buffer, GLuint first, GLuint count);
+	// Writes BUILDING_VERTICES vertices of every lot from first on into vertexBuffer, lot i's from vertex
+	// firstVertex + i * BUILDING_VERTICES, and its BUILDING_INDICES indices into indexBuffer from index
+	// firstIndex + i * BUILDING_INDICES, counting from vertex 0 as CityGenerator::Generate does after the ground
+	void GenerateMesh(GLuint vertexBuffer, GLuint indexBuffer, GLuint firstVertex, GLuint firstIndex, GLuint first, GLuint count);
+
+	// Number of lots there is room for and of lots set
+	GLuint capacity() const;
+	GLuint lotCount() const;
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLuint lotCapacity = 0;
+	GLuint lots = 0;
+	GLuint lotsSet = 0;
+	GLuint program = 0;
+
+	// Dispatches one invocation per lot of a range in a mode, 0 for records and 1 for meshes
+	void dispatch(GLuint mode, GLuint first, GLuint count, GLuint firstVertex, GLuint firstIndex);
+};
+
+#endif
@@ -0,0 +1,364 @@
+#include"GpuCuller.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLExtensions.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<string>
+#include<vector>
+
+// One invocation per building, its block's impostor is handled by the invocation that claims it first
+// The declarations come first, then DepthPyramid::TEST_SOURCE and the main function
+static const char* cullSource = R"(
+#version 430 core
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) readonly buffer Buildings { float buildings[]; };
+layout(std430, binding = 1) readonly buffer Blocks { float blocks[]; };
+layout(std430, binding = 2) buffer Visibility { uint visible[]; };
+layout(std430, binding = 3) buffer Claims { uint claims[]; };
+layout(std430, binding = 4) writeonly buffer Survivors { float survivors[]; };
+// Laid out like DrawElementsIndirectCommand, buildings then impostors of phase 0, then the same of phase 1
+struct Command
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+layout(std430, binding = 5) buffer Commands { Command commands[]; };
+// Running total of the buildings dropped for their projected size
+layout(std430, binding = 6) buffer Dropped { uint dropped; };
+// Per frame values shared by every program, laid out like FrameData.h
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 camMatrix;
+    mat4 view;
+    mat4 projection;
+    vec4 camPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    mat4 sceneModel;
+    vec4 fogColor;
+    vec4 fogParams;
+};
+
+uniform uint phase;
+uniform uint stamp;
+uniform uint buildingCount;
+uniform uint lotsPerBlock;
+uniform uint recordFloats;
+uniform mat4 model;
+// Level of detail as LevelOfDetail picks it, lod is 0 to keep every building
+uniform int lod;
+uniform float viewportHeight;
+uniform float impostorPixels;
+uniform float fadePixels;
+// Buildings smaller than this many pixels on screen are dropped, 0 keeps them all
+uniform float cullPixels;
+
+// Frustum planes, model space eye and pixels per unit at a distance of one, worked out once per work group
+shared vec4 planes[6];
+shared vec3 eye;
+shared float pixelsPerUnit;
+
+// Checks if a box is at least partly inside the frustum, testing the corner furthest along every plane normal
+bool inside(vec3 low, vec3 high)
+{
+    for (int p = 0; p < 6; p++)
+        if (dot(planes[p].xyz, mix(low, high, greaterThan(planes[p].xyz, vec3(0.0)))) + planes[p].w < 0.0)
+            return false;
+    return true;
+}
+
+// Diameter in pixels of the bounding sphere of a box, as LevelOfDetail::ProjectedSize measures it
+float projectedSize(vec3 low, vec3 high)
+{
+    float radius = 0.5 * length(high - low);
+    float distance = length(0.5 * (low + high) - eye);
+    // From inside the sphere the box fills the screen
+    if (distance <= radius)
+        return 3.402823e38;
+    return 2.0 * radius * pixelsPerUnit / distance;
+}
+
+// How far a block has faded towards its impostor, from its projected size
+float impostorBlend(vec3 low, vec3 high)
+{
+    float size = projectedSize(low, high);
+    if (size >= impostorPixels + fadePixels)
+        return 0.0;
+    if (size <= impostorPixels || fadePixels <= 0.0)
+        return 1.0;
+    return (impostorPixels + fadePixels - size) / fadePixels;
+}
+
+// Copies a record behind the ones a list already holds, with its dither fade
+void append(uint command, bool block, uint record, float fade)
+{
+    uint slot = (commands[command].baseInstance + atomicAdd(commands[command].instanceCount, 1u)) * recordFloats;
+    for (uint f = 0u; f < recordFloats; f++)
+        survivors[slot + f] = block ? blocks[record + f] : buildings[record + f];
+    survivors[slot + 7u] = fade;
+}
+)";
+static const char* cullMainSource = R"(
+// Runs one building or impostor through the phase, list 0 is the buildings and list 1 the impostors
+void cull(uint id, uint list, bool block, uint record, float fade)
+{
+    vec3 low = block ? vec3(blocks[record], blocks[record + 1u], blocks[record + 2u])
+        : vec3(buildings[record], buildings[record + 1u], buildings[record + 2u]);
+    vec3 high = low + (block ? vec3(blocks[record + 3u], blocks[record + 4u], blocks[record + 5u])
+        : vec3(buildings[record + 3u], buildings[record + 4u], buildings[record + 5u]));
+    bool drawn = visible[id] != 0u;
+    if (!inside(low, high))
+    {
+        // Whatever comes back into view goes through the occlusion test first
+        if (phase == 1u)
+            visible[id] = 0u;
+        return;
+    }
+    // A building covering next to no pixels goes the same way, counted once a frame in phase two
+    if (!block && cullPixels > 0.0 && projectedSize(low, high) < cullPixels)
+    {
+        if (phase == 1u)
+        {
+            visible[id] = 0u;
+            atomicAdd(dropped, 1u);
+        }
+        return;
+    }
+    if (phase == 0u)
+    {
+        if (drawn)
+            append(list, block, record, fade);
+        return;
+    }
+    bool visibleNow = !occluded(camMatrix * model, low, high);
+    visible[id] = visibleNow ? 1u : 0u;
+    if (visibleNow && !drawn)
+        append(2u + list, block, record, fade);
+}
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0u)
+    {
+        // Rows of the matrix taking model space to clip space, as Frustum::Extract takes them
+        mat4 rows = transpose(camMatrix * model);
+        planes[0] = rows[3] + rows[0];
+        planes[1] = rows[3] - rows[0];
+        planes[2] = rows[3] + rows[1];
+        planes[3] = rows[3] - rows[1];
+        planes[4] = rows[3] + rows[2];
+        planes[5] = rows[3] - rows[2];
+        eye = vec3(inverse(model) * vec4(camPos.xyz, 1.0));
+        // Nothing is seen through the fog beyond its distance, which then stands in for the far plane as in
+        // Frustum::LimitDistance, the rows of view * model give the model space direction the camera looks along
+        if (fogParams.z > 0.0)
+        {
+            vec3 front = -transpose(view * model)[2].xyz;
+            planes[5] = vec4(-front, dot(front, eye) + fogParams.z);
+        }
+        // projection[1][1] is the cotangent of half the vertical field of view
+        pixelsPerUnit = projection[1][1] * 0.5 * viewportHeight;
+    }
+    barrier();
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= buildingCount)
+        return;
+    uint block = i / lotsPerBlock;
+    float blend = 0.0;
+    if (lod != 0)
+    {
+        uint record = block * recordFloats;
+        vec3 low = vec3(blocks[record], blocks[record + 1u], blocks[record + 2u]);
+        blend = impostorBlend(low, low + vec3(blocks[record + 3u], blocks[record + 4u], blocks[record + 5u]));
+    }
+    // The fades of LevelOfDetail::DetailFade and ImpostorFade
+    if (blend < 1.0)
+        cull(i, 0u, false, i * recordFloats, blend);
+    if (blend > 0.0 && atomicExchange(claims[block], stamp) != stamp)
+        cull(buildingCount + block, 1u, true, block * recordFloats, blend >= 1.0 ? 0.0 : blend - 1.0);
+}
+)";
+
+// Checks if the context has what the culler needs
+bool GpuCuller::Supported()
+{
+	return GLExt.computeShader && GLExt.shaderStorage && GLExt.multiDrawIndirect;
+}
+
+// Constructor that allocates every buffer and builds the program
+GpuCuller::GpuCuller(GLuint buildingCount, GLuint lotsPerBlock, GLuint recordFloats)
+{
+	GpuCuller::buildingCount = buildingCount;
+	GpuCuller::blockCount = (buildingCount + lotsPerBlock - 1) / std::max<GLuint>(lotsPerBlock, 1);
+	GpuCuller::recordFloats = recordFloats;
+
+	// Room for every building and impostor in each phase, phase one from the start and phase two behind it
+	GLsizeiptr survivorBytes = 2 * (GLsizeiptr)std::max<GLuint>(buildingCount + blockCount, 1) * recordFloats * sizeof(float);
+	glGenBuffers(1, &recordBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, recordBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, survivorBytes, nullptr, GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, recordBuffer, (int64_t)survivorBytes);
+
+	// Everything counts as visible before the first test, so the first frame draws it all in phase one
+	std::vector<GLuint> allVisible(std::max<GLuint>(buildingCount + blockCount, 1), 1u);
+	glGenBuffers(1, &visibility);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, visibility);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, allVisible.size() * sizeof(GLuint), allVisible.data(), GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, visibility, (int64_t)(allVisible.size() * sizeof(GLuint)));
+
+	// Stamps start at 1, so no block counts as claimed before the first dispatch
+	std::vector<GLuint> unclaimed(std::max<GLuint>(blockCount, 1), 0u);
+	glGenBuffers(1, &claims);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, claims);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, unclaimed.size() * sizeof(GLuint), unclaimed.data(), GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, claims, (int64_t)(unclaimed.size() * sizeof(GLuint)));
+
+	glGenBuffers(1, &commandBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, commandBuffer, 4 * sizeof(DrawElementsIndirectCommand));
+	GLuint none = 0;
+	glGenBuffers(1, &droppedBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, droppedBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &none, GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, droppedBuffer, sizeof(GLuint));
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	std::string source = std::string(cullSource) + DepthPyramid::TEST_SOURCE + cullMainSource;
+	program = Shader::LinkCompute(source.c_str());
+	GLState.UseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "buildingCount"), buildingCount);
+	glUniform1ui(glGetUniformLocation(program, "lotsPerBlock"), std::max<GLuint>(lotsPerBlock, 1));
+	glUniform1ui(glGetUniformLocation(program, "recordFloats"), recordFloats);
+	GLState.UseProgram(0);
+}
+
+// Deletes the GL objects unless Delete was already called
+GpuCuller::~GpuCuller()
+{
+	Delete();
+}
+
+// Phase one: resets the commands and keeps what was visible last frame
+void GpuCuller::Begin(GLuint buildings, GLuint blocks, const DrawCommandBuilder::Mesh& mesh, const glm::mat4& model, const LevelOfDetail* lod, float viewportHeight)
+{
+	GpuCuller::buildings = buildings;
+	GpuCuller::blocks = blocks;
+
+	// Every command starts out empty, the program counts their instances up
+	GLuint listStart[4] = { 0, buildingCount, buildingCount + blockCount, 2 * buildingCount + blockCount };
+	DrawElementsIndirectCommand commands[4];
+	for (int list = 0; list < 4; list++)
+	{
+		commands[list].count = mesh.indexCount;
+		commands[list].instanceCount = 0;
+		commands[list].firstIndex = mesh.firstIndex;
+		commands[list].baseVertex = mesh.baseVertex;
+		commands[list].baseInstance = listStart[list];
+	}
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(commands), commands);
+	GLState.CountUpload(sizeof(commands));
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(program);
+	glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	glUniform1i(glGetUniformLocation(program, "lod"), lod ? 1 : 0);
+	glUniform1f(glGetUniformLocation(program, "viewportHeight"), viewportHeight);
+	glUniform1f(glGetUniformLocation(program, "impostorPixels"), lod ? lod->impostorPixels : 0.0f);
+	glUniform1f(glGetUniformLocation(program, "fadePixels"), lod ? lod->fadePixels : 0.0f);
+	glUniform1f(glGetUniformLocation(program, "cullPixels"), cullPixels);
+	GLState.CountUniforms(6);
+	GLState.UseProgram(previousProgram);
+
+	dispatch(0);
+}
+
+// Draws both lists of a phase
+void GpuCuller::Draw(int phase, GLenum indexType)
+{
+	GLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)(2 * phase * sizeof(DrawElementsIndirectCommand)), 2, 0);
+	GLState.CountDraw(0, 0);
+	GLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Phase two: builds the pyramid and tests everything again
+void GpuCuller::Test(GLsizei width, GLsizei height)
+{
+	pyramid.reverseDepth = reverseDepth;
+	if (!pyramid.Build(width, height))
+		return;
+	dispatch(1);
+	pyramid.Unbind();
+}
+
+// Dispatches the program for a phase, each with a stamp of its own for the claims
+void GpuCuller::dispatch(GLuint phase)
+{
+	if (buildingCount == 0)
+		return;
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buildings);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, blocks);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visibility);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, claims);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, recordBuffer);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, commandBuffer);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, droppedBuffer);
+
+	// 0 is what the claims start at, a stamp that wraps around skips it
+	if (++stamp == 0)
+		stamp = 1;
+	GLState.UseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "phase"), phase);
+	glUniform1ui(glGetUniformLocation(program, "stamp"), stamp);
+	GLState.CountUniforms(2);
+	if (phase == 1)
+	{
+		pyramid.SetUniforms(program);
+	}
+	glDispatchCompute((buildingCount + 63) / 64, 1, 1);
+	// The survivors are read as instance attributes, the counts as draw commands and the visibility by the next dispatch
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	GLState.UseProgram(previousProgram);
+}
+
+// Reads the running total back, which waits for every dispatch so far
+GLuint GpuCuller::droppedCount() const
+{
+	GLuint count = 0;
+	if (droppedBuffer == 0)
+		return count;
+	// The program's atomic writes have to land before the buffer is read like any other
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, droppedBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return count;
+}
+
+// Deletes the GL objects
+void GpuCuller::Delete()
+{
+	GLuint buffers[] = { recordBuffer, visibility, claims, commandBuffer, droppedBuffer };
+	for (GLuint buffer : buffers)
+		if (buffer != 0)
+			GLState.DeleteBuffers(1, &buffer);
+	recordBuffer = visibility = claims = commandBuffer = droppedBuffer = 0;
+	pyramid.Delete();
+	if (program != 0)
+		GLState.DeleteProgram(program);
+	program = 0;
+}
@@ -0,0 +1,81 @@
+#ifndef GPU_CULLER_CLASS_H
+#define GPU_CULLER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+#include"DepthPyramid.h"
+#include"DrawCommandBuilder.h"
+#include"LevelOfDetail.h"
+
+// Whole visibility pipeline of the instanced city on the GPU, so the CPU does no per building work at all.
+// One invocation per building reads its record and its block's impostor record from storage buffers, tests them
+// against the frustum planes of the FrameData camera, picks the level of detail from the block's projected size and
+// appends the survivors to a list per level: buildings, and block impostors appended once by whichever of their
+// buildings gets there first. Around the switch both are appended with the crossfade of LevelOfDetail.
+// Occlusion works in two phases like OcclusionCuller: phase one keeps what was visible last frame, phase two tests
+// everything against a DepthPyramid of what phase one drew. Each list of each phase counts its instances into an
+// indirect command, so nothing is ever read back. Billboards need the blocks CPU culling saw, so blocks keep their boxes.
+class GpuCuller
+{
+public:
+	// Records the phases let through, point the instance attributes at offset 0 of it when drawing
+	GLuint recordBuffer = 0;
+	// Set when the depth buffer is reverse-Z, see ReverseDepth.h, before the first Test
+	bool reverseDepth = false;
+	// Projected size in pixels below which a building is dropped like one outside the frustum, 0 keeps them all
+	// Block impostors are never dropped, they are what stands in for the small buildings far away
+	float cullPixels = 0.0f;
+
+	// Checks if the context has compute shaders, storage buffers and multi draw indirect
+	static bool Supported();
+
+	// Constructor for buildingCount building records and a record per lotsPerBlock buildings for their block's
+	// impostor, records of recordFloats floats laid out as CityGenerator writes them
+	GpuCuller(GLuint buildingCount, GLuint lotsPerBlock, GLuint recordFloats);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~GpuCuller();
+	// A GpuCuller owns its GL objects, so it cannot be copied
+	GpuCuller(const GpuCuller&) = delete;
+	GpuCuller& operator=(const GpuCuller&) = delete;
+
+	// Phase one: tests the records of every building in buildings and of every block in blocks against the camera of
+	// the bound FrameData and model, with levels of detail picked as lod does for a viewport viewportHeight pixels
+	// high, or none without it, and keeps what was visible last frame; both mesh kinds are drawn with mesh
+	void Begin(GLuint buildings, GLuint blocks, const DrawCommandBuilder::Mesh& mesh, const glm::mat4& model, const LevelOfDetail* lod, float viewportHeight);
+	// Draws both lists of phase 0 or 1, with the mesh's VAO bound and its instance attributes on recordBuffer
+	// indexType is the type of the bound index buffer, such as GpuBufferHeap::indexType
+	void Draw(int phase, GLenum indexType = GL_UNSIGNED_INT);
+	// Phase two: builds the pyramid from the depth of the current framebuffer, which is width by height, and tests everything again
+	void Test(GLsizei width, GLsizei height);
+
+	// Number of buildings dropped for their projected size over every frame so far, read back from the GPU, so it
+	// stalls until the last dispatch is done and is only meant for statistics at the end of a run
+	GLuint droppedCount() const;
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLuint buildingCount = 0;
+	GLuint blockCount = 0;
+	GLuint recordFloats = 0;
+	// Records of the current frame
+	GLuint buildings = 0;
+	GLuint blocks = 0;
+	// Whether every building, then every block, passed the last test
+	GLuint visibility = 0;
+	// Stamp of the last dispatch that appended each block's impostor, so it is appended once per phase
+	GLuint claims = 0;
+	GLuint stamp = 0;
+	// One DrawElementsIndirectCommand per list of each phase
+	GLuint commandBuffer = 0;
+	// One counter the program adds the buildings it drops for their size to
+	GLuint droppedBuffer = 0;
+	GLuint program = 0;
+	DepthPyramid pyramid;
+
+	// Dispatches the program for a phase
+	void dispatch(GLuint phase);
+};
+
+#endif
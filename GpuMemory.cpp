@@ -0,0 +1,205 @@
+#include"GpuMemory.h"
+#include"CompressedImage.h"
+#include"GLStateCache.h"
+
+#include<algorithm>
+#include<iomanip>
+#include<sstream>
+
+GpuMemoryTracker GpuMemory;
+
+// Records the size of an object
+void GpuMemoryTracker::Track(GpuMemoryCategory category, GLenum kind, GLuint name, int64_t bytes)
+{
+	if (name == 0)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	Entry& entry = objects[key(kind, name)];
+	// A fresh entry starts at 0 bytes of the first category and takes nothing away
+	totals[entry.category] -= entry.bytes;
+	entry.category = category;
+	entry.bytes = bytes;
+	totals[category] += bytes;
+}
+
+// Forgets an object
+void GpuMemoryTracker::Untrack(GLenum kind, GLuint name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = objects.find(key(kind, name));
+	if (it == objects.end())
+		return;
+	totals[it->second.category] -= it->second.bytes;
+	objects.erase(it);
+}
+
+// Bytes of a category
+int64_t GpuMemoryTracker::bytes(GpuMemoryCategory category)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return totals[category];
+}
+
+// Bytes of every category
+int64_t GpuMemoryTracker::total()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	int64_t sum = 0;
+	for (int64_t bytes : totals)
+		sum += bytes;
+	return sum;
+}
+
+// Reads the driver's numbers
+GpuMemoryTracker::DriverMemory GpuMemoryTracker::Driver() const
+{
+	DriverMemory memory;
+	if (GLExt.nvxMemoryInfo)
+	{
+		GLint total = 0, available = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &total);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+		memory.totalKB = total;
+		memory.availableKB = available;
+	}
+	else if (GLExt.atiMemInfo)
+	{
+		// Total free, largest free block, then the same for auxiliary memory, textures share the pool with the rest
+		GLint free[4] = { 0, 0, 0, 0 };
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, free);
+		memory.availableKB = free[0];
+	}
+	return memory;
+}
+
+// Bytes of an image with its mip chain
+int64_t GpuMemoryTracker::ImageBytes(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth, GLsizei levels)
+{
+	int64_t texel;
+	switch (internalFormat)
+	{
+	case GL_R8: texel = 1; break;
+	case GL_RG8: case GL_R16: case GL_R16F: case GL_DEPTH_COMPONENT16: texel = 2; break;
+	case GL_RGB8: case GL_RGB: texel = 3; break;
+	case GL_RGBA16F: case GL_RG32F: case GL_DEPTH32F_STENCIL8: texel = 8; break;
+	case GL_RGBA32F: case GL_RGBA32UI: texel = 16; break;
+	case GL_RGB16F: texel = 6; break;
+	case GL_RGB32F: texel = 12; break;
+	default: texel = 4; break;
+	}
+	// Compressed formats have a block size, the rest none
+	bool compressed = CompressedImage::LevelSize(internalFormat, 1, 1) > 0;
+	int64_t bytes = 0;
+	for (GLsizei level = 0; level < levels; level++)
+	{
+		GLsizei levelWidth = std::max(1, width >> level);
+		GLsizei levelHeight = std::max(1, height >> level);
+		if (compressed)
+			bytes += (int64_t)CompressedImage::LevelSize(internalFormat, levelWidth, levelHeight) * depth;
+		else
+			bytes += texel * levelWidth * levelHeight * depth;
+	}
+	return bytes;
+}
+
+// Number of levels of a full mip chain
+GLsizei GpuMemoryTracker::MipLevels(GLsizei width, GLsizei height)
+{
+	GLsizei levels = 1;
+	while ((width >> levels) > 0 || (height >> levels) > 0)
+		levels++;
+	return levels;
+}
+
+// Short name of a category
+const char* GpuMemoryTracker::CategoryName(GpuMemoryCategory category)
+{
+	switch (category)
+	{
+	case GPU_MEMORY_GEOMETRY: return "geometry";
+	case GPU_MEMORY_STREAMING: return "streaming";
+	case GPU_MEMORY_TEXTURES: return "textures";
+	case GPU_MEMORY_TARGETS: return "targets";
+	default: return "other";
+	}
+}
+
+// Total and every category in megabytes
+std::string GpuMemoryTracker::Summary()
+{
+	const double megabyte = 1024.0 * 1024.0;
+	int64_t categories[GPU_MEMORY_CATEGORIES];
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::copy(totals, totals + GPU_MEMORY_CATEGORIES, categories);
+	}
+	int64_t sum = 0;
+	for (int64_t bytes : categories)
+		sum += bytes;
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(1) << "GPU " << sum / megabyte << " MB (";
+	for (int i = 0; i < GPU_MEMORY_CATEGORIES; i++)
+		out << (i > 0 ? ", " : "") << CategoryName((GpuMemoryCategory)i) << " " << categories[i] / megabyte;
+	out << ")";
+	DriverMemory driver = Driver();
+	if (driver.availableKB >= 0)
+	{
+		out << ", driver " << driver.availableKB / 1024.0 << " MB free";
+		if (driver.totalKB >= 0)
+			out << " of " << driver.totalKB / 1024.0;
+	}
+	return out.str();
+}
+
+// Draws a bar of the categories along the bottom of the framebuffer
+void GpuMemoryTracker::DrawOverlay(int width, int height)
+{
+	const int barHeight = 6;
+	const int y = 24;
+	if (y + barHeight > height)
+		return;
+	int64_t categories[GPU_MEMORY_CATEGORIES];
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::copy(totals, totals + GPU_MEMORY_CATEGORIES, categories);
+	}
+	// Scissored clears like the profiler's bars
+	GLfloat clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+	GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+	GLState.Enable(GL_SCISSOR_TEST);
+
+	static const GLfloat colors[GPU_MEMORY_CATEGORIES][3] =
+	{
+		{ 0.2f, 0.6f, 1.0f }, { 0.9f, 0.5f, 0.2f }, { 0.3f, 0.9f, 0.4f }, { 0.8f, 0.3f, 0.9f }, { 0.6f, 0.6f, 0.6f }
+	};
+	const int64_t megabyte = 1024 * 1024;
+	int x = 10;
+	for (int i = 0; i < GPU_MEMORY_CATEGORIES && x < width - 10; i++)
+	{
+		int barWidth = std::min(width - 10 - x, (int)(categories[i] / megabyte));
+		if (barWidth <= 0)
+			continue;
+		glScissor(x, y, barWidth, barHeight);
+		glClearColor(colors[i][0], colors[i][1], colors[i][2], 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		x += barWidth;
+	}
+	DriverMemory driver = Driver();
+	if (driver.totalKB > 0 && 10 + driver.totalKB / 1024 < width)
+	{
+		glScissor(10 + (int)(driver.totalKB / 1024), y - 2, 1, barHeight + 4);
+		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+	}
+
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	if (!scissor)
+		GLState.Disable(GL_SCISSOR_TEST);
+}
+
+// Key of an object
+uint64_t GpuMemoryTracker::key(GLenum kind, GLuint name)
+{
+	return ((uint64_t)kind << 32) | name;
+}
@@ -0,0 +1,84 @@
+#ifndef GPU_MEMORY_CLASS_H
+#define GPU_MEMORY_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<unordered_map>
+
+#include"GLExtensions.h"
+
+// What an allocation is for
+enum GpuMemoryCategory
+{
+	// Vertices and indices of meshes, including the buffer heaps
+	GPU_MEMORY_GEOMETRY,
+	// Buffers rewritten every frame: streamed instances and commands, uniform and staging buffers
+	GPU_MEMORY_STREAMING,
+	// Images sampled by the scene, with their mip chains
+	GPU_MEMORY_TEXTURES,
+	// Framebuffer attachments: G-buffer, shadow maps, depth copies, offscreen targets
+	GPU_MEMORY_TARGETS,
+	// Everything else, such as light and culling buffers
+	GPU_MEMORY_OTHER,
+	GPU_MEMORY_CATEGORIES
+};
+
+// Adds up the memory the engine's buffers, textures and renderbuffers take on the GPU, per category
+// Every allocation reports its size in bytes for the object it went to, a new size replaces the old one, and the
+// deletes of GLState forget it again. The sizes are what GL was asked for, drivers pad and align on top of that.
+// Drivers that tell how much memory is left (NVX_gpu_memory_info, ATI_meminfo) are read next to it.
+class GpuMemoryTracker
+{
+public:
+	// What the driver says about its memory in kilobytes, -1 where it says nothing
+	struct DriverMemory
+	{
+		int64_t totalKB = -1;
+		int64_t availableKB = -1;
+	};
+
+	// Records the size of a buffer, texture or renderbuffer, kind is GL_BUFFER, GL_TEXTURE or GL_RENDERBUFFER
+	void Track(GpuMemoryCategory category, GLenum kind, GLuint name, int64_t bytes);
+	// Forgets an object, does nothing for one that was never tracked
+	void Untrack(GLenum kind, GLuint name);
+
+	// Bytes of a category and of all of them
+	int64_t bytes(GpuMemoryCategory category);
+	int64_t total();
+	// Reads the driver's numbers, asks GL so only call it on the thread the context is current on
+	DriverMemory Driver() const;
+
+	// Bytes of an image with a mip chain of levels levels, depth is the number of layers of an array, compressed
+	// formats are counted by their blocks
+	static int64_t ImageBytes(GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth = 1, GLsizei levels = 1);
+	// Number of levels of a full mip chain down to 1x1
+	static GLsizei MipLevels(GLsizei width, GLsizei height);
+	// Short name of a category
+	static const char* CategoryName(GpuMemoryCategory category);
+
+	// Total and every category in megabytes, with the driver's numbers when there are any, on the GL thread
+	std::string Summary();
+	// Draws a bar along the bottom of the framebuffer, one pixel per megabyte, colored by category, with a white
+	// marker at the driver's total if it has one, on the GL thread
+	void DrawOverlay(int width, int height);
+private:
+	struct Entry
+	{
+		GpuMemoryCategory category;
+		int64_t bytes;
+	};
+
+	std::mutex mutex;
+	std::unordered_map<uint64_t, Entry> objects;
+	int64_t totals[GPU_MEMORY_CATEGORIES] = {};
+
+	// Key of an object, kinds have names of their own
+	static uint64_t key(GLenum kind, GLuint name);
+};
+
+// Every allocation of the one context the engine renders with
+extern GpuMemoryTracker GpuMemory;
+
+#endif
@@ -0,0 +1,215 @@
+#include"GpuMeshCodec.h"
+#include"CityGenerator.h"
+
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+
+static constexpr unsigned int FLOATS = CityGenerator::VERTEX_FLOATS;
+// Words of the first chunk in use: the minimum and step of every vertex component and the number of meshlets
+static constexpr unsigned int GRID_WORDS = 2 * FLOATS + 1;
+static_assert(GRID_WORDS <= GpuMeshCodec::MESHLET_WORDS, "the grid has to fit the first chunk");
+
+// Bits a value up to maximum takes, 0 for 0
+static uint32_t bitsFor(uint32_t maximum)
+{
+	uint32_t bits = 0;
+	while (bits < 32 && (maximum >> bits) != 0)
+		bits++;
+	return bits;
+}
+
+// Appends the lowest bits of value at bit of words, which grows as needed
+static void writeBits(std::vector<uint32_t>& words, size_t bit, uint32_t value, uint32_t bits)
+{
+	if (bits == 0)
+		return;
+	size_t word = bit / 32, shift = bit % 32;
+	if (words.size() < word + 2)
+		words.resize(word + 2, 0);
+	words[word] |= value << shift;
+	if (shift + bits > 32)
+		words[word + 1] |= value >> (32 - shift);
+}
+
+// Reads bits bits at bit of the words starting at first, the same as the vertex shader
+static uint32_t readBits(const std::vector<uint32_t>& words, size_t first, size_t bit, uint32_t bits)
+{
+	if (bits == 0)
+		return 0;
+	size_t word = first + bit / 32, shift = bit % 32;
+	uint32_t value = words[word] >> shift;
+	if (shift + bits > 32)
+		value |= words[word + 1] << (32 - shift);
+	return value & ((1u << bits) - 1u);
+}
+
+uint32_t GpuMeshCodec::Encoded::chunks() const
+{
+	return (uint32_t)(words.size() / MESHLET_WORDS);
+}
+
+// Meshlets follow the chunk of the grid
+GLuint GpuMeshCodec::Encoded::firstSlot(GLint base, uint32_t meshlet)
+{
+	return ((GLuint)base + 1 + meshlet) * MESHLET_SLOTS;
+}
+
+// Quantizes the mesh, cuts it into meshlets in index order, then writes the headers and each meshlet's vertex bits
+GpuMeshCodec::Encoded GpuMeshCodec::Encode(const GLfloat* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, size_t splitIndex)
+{
+	float minimum[FLOATS], maximum[FLOATS], step[FLOATS];
+	for (unsigned int c = 0; c < FLOATS; c++)
+	{
+		minimum[c] = vertexCount > 0 ? vertices[c] : 0.0f;
+		maximum[c] = minimum[c];
+	}
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		for (unsigned int c = 0; c < FLOATS; c++)
+		{
+			minimum[c] = std::min(minimum[c], vertices[i * FLOATS + c]);
+			maximum[c] = std::max(maximum[c], vertices[i * FLOATS + c]);
+		}
+	}
+	for (unsigned int c = 0; c < FLOATS; c++)
+		step[c] = (maximum[c] - minimum[c]) / 65535.0f;
+	std::vector<uint16_t> grid(vertexCount * FLOATS);
+	for (size_t i = 0; i < grid.size(); i++)
+	{
+		unsigned int c = (unsigned int)(i % FLOATS);
+		float fraction = step[c] > 0.0f ? (vertices[i] - minimum[c]) / step[c] : 0.0f;
+		grid[i] = (uint16_t)std::lround(std::clamp(fraction, 0.0f, 65535.0f));
+	}
+
+	// Each meshlet is its triangles' corners as indices into its own vertex list
+	struct Meshlet
+	{
+		std::vector<uint32_t> vertices;
+		std::vector<uint8_t> corners;
+	};
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> owner(vertexCount, UINT32_MAX), local(vertexCount, 0);
+	Encoded encoded;
+	indexCount = vertexCount > 0 ? indexCount - indexCount % 3 : 0;
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		if (meshlets.empty() || meshlets.back().corners.size() == MESHLET_SLOTS || i == splitIndex)
+			meshlets.emplace_back();
+		if (i < splitIndex)
+			encoded.splitMeshlets = (uint32_t)meshlets.size();
+		Meshlet& meshlet = meshlets.back();
+		uint32_t id = (uint32_t)meshlets.size() - 1;
+		for (size_t corner = 0; corner < 3; corner++)
+		{
+			GLuint vertex = std::min<GLuint>(indices[i + corner], (GLuint)vertexCount - 1);
+			if (owner[vertex] != id)
+			{
+				owner[vertex] = id;
+				local[vertex] = (uint32_t)meshlet.vertices.size();
+				meshlet.vertices.push_back(vertex);
+			}
+			meshlet.corners.push_back((uint8_t)local[vertex]);
+		}
+	}
+	encoded.meshlets = (uint32_t)meshlets.size();
+
+	// The grid, then the headers and corners, padded corners pointing at the first vertex make degenerate triangles
+	std::vector<uint32_t>& words = encoded.words;
+	words.assign((size_t)(1 + meshlets.size()) * MESHLET_WORDS, 0);
+	std::memcpy(&words[0], minimum, sizeof(minimum));
+	std::memcpy(&words[FLOATS], step, sizeof(step));
+	words[2 * FLOATS] = encoded.meshlets;
+	std::vector<uint32_t> bits;
+	for (size_t m = 0; m < meshlets.size(); m++)
+	{
+		const Meshlet& meshlet = meshlets[m];
+		uint32_t low[FLOATS], width[FLOATS], stride = 0;
+		for (unsigned int c = 0; c < FLOATS; c++)
+		{
+			uint32_t high = 0;
+			low[c] = 65535;
+			for (uint32_t vertex : meshlet.vertices)
+			{
+				low[c] = std::min<uint32_t>(low[c], grid[vertex * FLOATS + c]);
+				high = std::max<uint32_t>(high, grid[vertex * FLOATS + c]);
+			}
+			width[c] = bitsFor(high - low[c]);
+			stride += width[c];
+		}
+		bits.assign(1, 0);
+		for (size_t v = 0; v < meshlet.vertices.size(); v++)
+		{
+			size_t bit = v * stride;
+			for (unsigned int c = 0; c < FLOATS; c++)
+			{
+				writeBits(bits, bit, grid[meshlet.vertices[v] * FLOATS + c] - low[c], width[c]);
+				bit += width[c];
+			}
+		}
+		bits.resize((meshlet.vertices.size() * stride + 31) / 32);
+
+		size_t start = (1 + m) * MESHLET_WORDS;
+		words[start] = (uint32_t)(words.size() - start);
+		words[start + 1] = low[0] | low[1] << 16;
+		words[start + 2] = low[2] | low[3] << 16;
+		words[start + 3] = low[4] | width[0] << 16 | width[1] << 21 | width[2] << 26;
+		words[start + 4] = width[3] | width[4] << 5 | (uint32_t)(1 + m) << 10;
+		for (size_t corner = 0; corner < meshlet.corners.size(); corner++)
+			words[start + HEADER_WORDS + corner / 4] |= (uint32_t)meshlet.corners[corner] << (corner % 4 * 8);
+		words.insert(words.end(), bits.begin(), bits.end());
+	}
+	words.resize((words.size() + MESHLET_WORDS - 1) / MESHLET_WORDS * MESHLET_WORDS, 0);
+	return encoded;
+}
+
+// Decodes every slot like the vertex shader and keeps the triangles that are not the padding
+bool GpuMeshCodec::Decode(const std::vector<uint32_t>& words, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+{
+	vertices.clear();
+	indices.clear();
+	if (words.size() < MESHLET_WORDS)
+		return false;
+	float minimum[FLOATS], step[FLOATS];
+	std::memcpy(minimum, &words[0], sizeof(minimum));
+	std::memcpy(step, &words[FLOATS], sizeof(step));
+	uint32_t meshlets = words[2 * FLOATS];
+	if (words.size() < (size_t)(1 + meshlets) * MESHLET_WORDS)
+		return false;
+	for (uint32_t m = 0; m < meshlets; m++)
+	{
+		size_t start = (size_t)(1 + m) * MESHLET_WORDS;
+		const uint32_t* header = &words[start];
+		uint32_t low[FLOATS] = { header[1] & 0xffff, header[1] >> 16, header[2] & 0xffff, header[2] >> 16, header[3] & 0xffff };
+		uint32_t width[FLOATS] = { header[3] >> 16 & 31, header[3] >> 21 & 31, header[3] >> 26 & 31, header[4] & 31, header[4] >> 5 & 31 };
+		uint32_t stride = 0;
+		for (unsigned int c = 0; c < FLOATS; c++)
+			stride += width[c];
+		size_t data = start + header[0];
+		for (unsigned int triangle = 0; triangle < MESHLET_TRIANGLES; triangle++)
+		{
+			uint32_t corners[3];
+			for (unsigned int corner = 0; corner < 3; corner++)
+			{
+				unsigned int slot = triangle * 3 + corner;
+				corners[corner] = header[HEADER_WORDS + slot / 4] >> (slot % 4 * 8) & 255;
+			}
+			if (corners[0] == corners[1] && corners[1] == corners[2])
+				continue;
+			for (uint32_t corner : corners)
+			{
+				size_t bit = (size_t)corner * stride;
+				if (data + (bit + stride + 31) / 32 > words.size())
+					return false;
+				for (unsigned int c = 0; c < FLOATS; c++)
+				{
+					uint32_t value = low[c] + readBits(words, data, bit, width[c]);
+					vertices.push_back(minimum[c] + step[c] * (float)value);
+					bit += width[c];
+				}
+				indices.push_back((GLuint)indices.size());
+			}
+		}
+	}
+	return true;
+}
@@ -0,0 +1,55 @@
+#ifndef GPU_MESH_CODEC_CLASS_H
+#define GPU_MESH_CODEC_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+// Compression of meshes in CityGenerator's vertex layout that stays compressed on the GPU, decoded by the vertex shader
+// A mesh becomes meshlets of up to MESHLET_TRIANGLES triangles, each with its own list of the vertices it uses, so
+// its indices are 8 bit offsets into that list and a vertex shared with another meshlet is stored once for each. Every
+// component of a vertex is first put on a 16 bit grid over the range it spans in the whole mesh, so vertices shared
+// between meshlets land on the same point and no cracks open, and a meshlet then stores only the difference of its
+// vertices to its smallest values, in as many bits as its largest difference needs. A box of CityGenerator's takes
+// about half the bytes of its float vertices and 16 bit indices.
+// The mesh is a stream of words in chunks of MESHLET_WORDS: the grid first, one meshlet per chunk after it, then the
+// vertex bits of the meshlets. Every offset is relative to the meshlet or the mesh, so the stream can be moved as a
+// whole, such as by GpuBufferHeap::Defragment, with a chunk as the heap's vertex.
+// Meshlets are drawn without an index buffer, vertex ID i being corner i % MESHLET_SLOTS of the meshlet in chunk
+// i / MESHLET_SLOTS of the buffer, and a meshlet with fewer triangles fills the rest with degenerate ones.
+class GpuMeshCodec
+{
+public:
+	// Triangles of a meshlet and the vertex IDs drawn for it
+	static constexpr unsigned int MESHLET_TRIANGLES = 32;
+	static constexpr unsigned int MESHLET_SLOTS = MESHLET_TRIANGLES * 3;
+	// Words of a meshlet, its header and its indices four to a word, and of every chunk of a stream
+	static constexpr unsigned int HEADER_WORDS = 5;
+	static constexpr unsigned int MESHLET_WORDS = HEADER_WORDS + MESHLET_SLOTS / 4;
+	static constexpr GLsizei CHUNK_BYTES = MESHLET_WORDS * sizeof(uint32_t);
+
+	// A mesh as the GPU keeps it
+	struct Encoded
+	{
+		// The stream, a whole number of chunks
+		std::vector<uint32_t> words;
+		// Meshlets, in the chunks right after the first
+		uint32_t meshlets = 0;
+		// Meshlets made of the indices before the split Encode was given, the rest come after them
+		uint32_t splitMeshlets = 0;
+
+		// Chunks of the stream
+		uint32_t chunks() const;
+		// First vertex ID of a meshlet of the stream placed at chunk base, each meshlet draws MESHLET_SLOTS of them
+		static GLuint firstSlot(GLint base, uint32_t meshlet);
+	};
+
+	// Compresses a mesh, the indices before splitIndex and those after never share a meshlet, such as the ground of a tile
+	static Encoded Encode(const GLfloat* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, size_t splitIndex = 0);
+	// Turns a stream back into the triangles the vertex shader draws, one unshared vertex for each corner of every
+	// triangle that is not degenerate, false if the stream is cut short
+	static bool Decode(const std::vector<uint32_t>& words, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices);
+};
+
+#endif
@@ -0,0 +1,397 @@
+#include"HeadlessContext.h"
+#include"GLExtensions.h"
+
+#include<algorithm>
+#include<cstdint>
+#include<cstring>
+#include<iostream>
+#include<vector>
+#ifdef _WIN32
+#include<windows.h>
+#else
+#include<dlfcn.h>
+#endif
+
+// The few EGL and OSMesa declarations used here, so neither header is needed to build
+typedef int32_t EGLint;
+typedef unsigned int EGLBoolean;
+typedef unsigned int EGLenum;
+typedef void* EGLDisplay;
+typedef void* EGLConfig;
+typedef void* EGLContext;
+typedef void* EGLSurface;
+typedef void* EGLDeviceEXT;
+#define EGL_NONE 0x3038
+#define EGL_EXTENSIONS 0x3055
+#define EGL_RED_SIZE 0x3024
+#define EGL_GREEN_SIZE 0x3023
+#define EGL_BLUE_SIZE 0x3022
+#define EGL_ALPHA_SIZE 0x3021
+#define EGL_DEPTH_SIZE 0x3025
+#define EGL_SURFACE_TYPE 0x3033
+#define EGL_RENDERABLE_TYPE 0x3040
+#define EGL_OPENGL_BIT 0x0008
+#define EGL_OPENGL_API 0x30A2
+#define EGL_CONTEXT_MAJOR_VERSION 0x3098
+#define EGL_CONTEXT_MINOR_VERSION 0x30FB
+#define EGL_CONTEXT_OPENGL_PROFILE_MASK 0x30FD
+#define EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT 0x00000001
+#define EGL_CONTEXT_OPENGL_DEBUG 0x31B0
+#define EGL_PLATFORM_DEVICE_EXT 0x313F
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#ifdef _WIN32
+#define EGLAPIENTRY __stdcall
+#else
+#define EGLAPIENTRY
+#endif
+typedef void* (EGLAPIENTRY* PFNEGLGETPROCADDRESS)(const char* name);
+typedef const char* (EGLAPIENTRY* PFNEGLQUERYSTRING)(EGLDisplay display, EGLint name);
+typedef EGLDisplay (EGLAPIENTRY* PFNEGLGETDISPLAY)(void* nativeDisplay);
+typedef EGLDisplay (EGLAPIENTRY* PFNEGLGETPLATFORMDISPLAYEXT)(EGLenum platform, void* nativeDisplay, const EGLint* attributes);
+typedef EGLBoolean (EGLAPIENTRY* PFNEGLQUERYDEVICESEXT)(EGLint maxDevices, EGLDeviceEXT* devices, EGLint* count);
+typedef EGLBoolean (EGLAPIENTRY* PFNEGLINITIALIZE)(EGLDisplay display, EGLint* major, EGLint* minor);
+typedef EGLBoolean (EGLAPIENTRY* PFNEGLTERMINATE)(EGLDisplay display);
+typedef EGLBoolean (EGLAPIENTRY* PFNEGLBINDAPI)(EGLenum api);
+typedef EGLBoolean (EGLAPIENTRY* PFNEGLCHOOSECONFIG)(EGLDisplay display, const EGLint* attributes, EGLConfig* configs, EGLint size, EGLint* count);
+typedef EGLContext (EGLAPIENTRY* PFNEGLCREATECONTEXT)(EGLDisplay display, EGLConfig config, EGLContext share, const EGLint* attributes);
+typedef EGLBoolean (EGLAPIENTRY* PFNEGLDESTROYCONTEXT)(EGLDisplay display, EGLContext context);
+typedef EGLBoolean (EGLAPIENTRY* PFNEGLMAKECURRENT)(EGLDisplay display, EGLSurface draw, EGLSurface read, EGLContext context);
+
+typedef void* OSMesaContext;
+#define OSMESA_FORMAT 0x22
+#define OSMESA_RGBA 0x1908
+#define OSMESA_DEPTH_BITS 0x30
+#define OSMESA_PROFILE 0x33
+#define OSMESA_CORE_PROFILE 0x34
+#define OSMESA_CONTEXT_MAJOR_VERSION 0x36
+#define OSMESA_CONTEXT_MINOR_VERSION 0x37
+#define OSMESA_UNSIGNED_BYTE 0x1401
+typedef OSMesaContext (*PFNOSMESACREATECONTEXTATTRIBS)(const int* attributes, OSMesaContext share);
+typedef void (*PFNOSMESADESTROYCONTEXT)(OSMesaContext context);
+typedef unsigned char (*PFNOSMESAMAKECURRENT)(OSMesaContext context, void* buffer, unsigned int type, int width, int height);
+typedef void* (*PFNOSMESAGETPROCADDRESS)(const char* name);
+
+// Size of the memory OSMesa renders the default framebuffer into
+static const int OSMESA_SIZE = 16;
+
+// Entry points of the loaded library, one headless context per process
+static PFNEGLGETPROCADDRESS eglGetProcAddress = nullptr;
+static PFNEGLQUERYSTRING eglQueryString = nullptr;
+static PFNEGLGETDISPLAY eglGetDisplay = nullptr;
+static PFNEGLINITIALIZE eglInitialize = nullptr;
+static PFNEGLTERMINATE eglTerminate = nullptr;
+static PFNEGLBINDAPI eglBindAPI = nullptr;
+static PFNEGLCHOOSECONFIG eglChooseConfig = nullptr;
+static PFNEGLCREATECONTEXT eglCreateContext = nullptr;
+static PFNEGLDESTROYCONTEXT eglDestroyContext = nullptr;
+static PFNEGLMAKECURRENT eglMakeCurrent = nullptr;
+static PFNOSMESACREATECONTEXTATTRIBS OSMesaCreateContextAttribs = nullptr;
+static PFNOSMESADESTROYCONTEXT OSMesaDestroyContext = nullptr;
+static PFNOSMESAMAKECURRENT OSMesaMakeCurrent = nullptr;
+static PFNOSMESAGETPROCADDRESS OSMesaGetProcAddress = nullptr;
+
+// Opens the first library of a list that exists
+static void* openLibrary(std::initializer_list<const char*> names)
+{
+	for (const char* name : names)
+	{
+#ifdef _WIN32
+		void* library = (void*)LoadLibraryA(name);
+#else
+		void* library = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+#endif
+		if (library)
+			return library;
+	}
+	return nullptr;
+}
+
+static void* librarySymbol(void* library, const char* name)
+{
+#ifdef _WIN32
+	return (void*)GetProcAddress((HMODULE)library, name);
+#else
+	return dlsym(library, name);
+#endif
+}
+
+static void closeLibrary(void* library)
+{
+#ifdef _WIN32
+	FreeLibrary((HMODULE)library);
+#else
+	dlclose(library);
+#endif
+}
+
+// Checks if a space separated extension string holds an extension
+static bool hasExtension(const char* extensions, const char* name)
+{
+	if (!extensions)
+		return false;
+	size_t length = strlen(name);
+	for (const char* start = extensions; (start = strstr(start, name)) != nullptr; start += length)
+		if ((start == extensions || start[-1] == ' ') && (start[length] == ' ' || start[length] == '\0'))
+			return true;
+	return false;
+}
+
+// Opens the EGL library of the platform
+static void* openEGL()
+{
+	return openLibrary({
+#ifdef _WIN32
+		"libEGL.dll"
+#else
+		"libEGL.so.1", "libEGL.so"
+#endif
+	});
+}
+
+// Asks EGL for its devices, without a display and without keeping the library loaded
+int HeadlessContext::DeviceCount()
+{
+	void* egl = openEGL();
+	if (!egl)
+		return 0;
+	EGLint count = 0;
+	PFNEGLGETPROCADDRESS getProcAddress = (PFNEGLGETPROCADDRESS)librarySymbol(egl, "eglGetProcAddress");
+	PFNEGLQUERYSTRING queryString = (PFNEGLQUERYSTRING)librarySymbol(egl, "eglQueryString");
+	if (getProcAddress && queryString && hasExtension(queryString(nullptr, EGL_EXTENSIONS), "EGL_EXT_platform_device"))
+	{
+		PFNEGLQUERYDEVICESEXT queryDevices = (PFNEGLQUERYDEVICESEXT)getProcAddress("eglQueryDevicesEXT");
+		if (!queryDevices || !queryDevices(0, nullptr, &count))
+			count = 0;
+	}
+	closeLibrary(egl);
+	return (int)count;
+}
+
+// Constructor, nothing is loaded until Create
+HeadlessContext::HeadlessContext()
+{
+}
+
+// Destroys the context unless Delete was already called
+HeadlessContext::~HeadlessContext()
+{
+	Delete();
+}
+
+// Creates the context with the preferred backend or the first that works
+bool HeadlessContext::Create(const std::string& preferred, int device)
+{
+	Delete();
+	if ((preferred == "auto" || preferred == "egl") && createEGL(device))
+		backend = "egl";
+	else if ((preferred == "auto" || preferred == "osmesa") && createOSMesa())
+		backend = "osmesa";
+	else
+	{
+		std::cerr << "Failed to create a headless " << (preferred == "auto" ? "EGL or OSMesa" : preferred) << " context" << std::endl;
+		return false;
+	}
+	MakeCurrent();
+	return true;
+}
+
+// Makes the context current on the calling thread
+void HeadlessContext::MakeCurrent()
+{
+	if (backend == "egl")
+		eglMakeCurrent(display, nullptr, nullptr, context);
+	else if (backend == "osmesa")
+		OSMesaMakeCurrent(context, buffer, OSMESA_UNSIGNED_BYTE, OSMESA_SIZE, OSMESA_SIZE);
+}
+
+// Releases the context from the calling thread
+void HeadlessContext::ReleaseCurrent()
+{
+	if (backend == "egl")
+		eglMakeCurrent(display, nullptr, nullptr, nullptr);
+	else if (backend == "osmesa")
+		OSMesaMakeCurrent(nullptr, nullptr, 0, 0, 0);
+}
+
+// Looks up a GL function
+void* HeadlessContext::GetProcAddress(const char* name)
+{
+	if (OSMesaGetProcAddress)
+		return OSMesaGetProcAddress(name);
+	if (eglGetProcAddress)
+		return eglGetProcAddress(name);
+	return nullptr;
+}
+
+// Creates an EGL context current on no surface
+bool HeadlessContext::createEGL(int device)
+{
+	library = openEGL();
+	if (!library)
+		return false;
+	eglGetProcAddress = (PFNEGLGETPROCADDRESS)librarySymbol(library, "eglGetProcAddress");
+	eglQueryString = (PFNEGLQUERYSTRING)librarySymbol(library, "eglQueryString");
+	eglGetDisplay = (PFNEGLGETDISPLAY)librarySymbol(library, "eglGetDisplay");
+	eglInitialize = (PFNEGLINITIALIZE)librarySymbol(library, "eglInitialize");
+	eglTerminate = (PFNEGLTERMINATE)librarySymbol(library, "eglTerminate");
+	eglBindAPI = (PFNEGLBINDAPI)librarySymbol(library, "eglBindAPI");
+	eglChooseConfig = (PFNEGLCHOOSECONFIG)librarySymbol(library, "eglChooseConfig");
+	eglCreateContext = (PFNEGLCREATECONTEXT)librarySymbol(library, "eglCreateContext");
+	eglDestroyContext = (PFNEGLDESTROYCONTEXT)librarySymbol(library, "eglDestroyContext");
+	eglMakeCurrent = (PFNEGLMAKECURRENT)librarySymbol(library, "eglMakeCurrent");
+	if (!eglGetProcAddress || !eglQueryString || !eglGetDisplay || !eglInitialize || !eglTerminate || !eglBindAPI
+		|| !eglChooseConfig || !eglCreateContext || !eglDestroyContext || !eglMakeCurrent)
+	{
+		Delete();
+		return false;
+	}
+
+	// Client extensions are queried without a display, the platforms below need them
+	const char* clientExtensions = eglQueryString(nullptr, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXT eglGetPlatformDisplayEXT = nullptr;
+	if (hasExtension(clientExtensions, "EGL_EXT_platform_base"))
+		eglGetPlatformDisplayEXT = (PFNEGLGETPLATFORMDISPLAYEXT)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	std::vector<EGLDisplay> candidates;
+	if (eglGetPlatformDisplayEXT && hasExtension(clientExtensions, "EGL_EXT_platform_device"))
+	{
+		PFNEGLQUERYDEVICESEXT eglQueryDevicesEXT = (PFNEGLQUERYDEVICESEXT)eglGetProcAddress("eglQueryDevicesEXT");
+		std::vector<EGLDeviceEXT> devices((size_t)std::max(device + 1, 1));
+		EGLint count = 0;
+		if (eglQueryDevicesEXT && eglQueryDevicesEXT((EGLint)devices.size(), devices.data(), &count) && count > device)
+			candidates.push_back(eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, devices[(size_t)std::max(device, 0)], nullptr));
+	}
+	// Any GPU but the first has to be a device, the other displays could be on any of them
+	if (device > 0 && candidates.empty())
+	{
+		std::cerr << "EGL has no device " << device << std::endl;
+		Delete();
+		return false;
+	}
+	if (device <= 0 && eglGetPlatformDisplayEXT && hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+		candidates.push_back(eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, nullptr, nullptr));
+	if (device <= 0)
+		candidates.push_back(eglGetDisplay(nullptr));
+
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, 0,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		// The list ends before the debug attribute when it is not wanted, it needs EGL 1.5
+		debug ? EGL_CONTEXT_OPENGL_DEBUG : EGL_NONE, 1,
+		EGL_NONE
+	};
+	for (EGLDisplay candidate : candidates)
+	{
+		if (!candidate || !eglInitialize(candidate, nullptr, nullptr))
+			continue;
+		EGLConfig config = nullptr;
+		EGLint configs = 0;
+		EGLContext created = nullptr;
+		if (hasExtension(eglQueryString(candidate, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context") && eglBindAPI(EGL_OPENGL_API)
+			&& eglChooseConfig(candidate, configAttributes, &config, 1, &configs) && configs > 0)
+		{
+			for (const int* version : GL_CONTEXT_VERSIONS)
+			{
+				contextAttributes[1] = version[0];
+				contextAttributes[3] = version[1];
+				created = eglCreateContext(candidate, config, nullptr, contextAttributes);
+				if (created)
+					break;
+			}
+		}
+		if (created)
+		{
+			display = candidate;
+			context = created;
+			return true;
+		}
+		eglTerminate(candidate);
+	}
+	Delete();
+	return false;
+}
+
+// Creates an OSMesa context rendering into memory
+bool HeadlessContext::createOSMesa()
+{
+	library = openLibrary({
+#ifdef _WIN32
+		"osmesa.dll"
+#else
+		"libOSMesa.so.8", "libOSMesa.so.6", "libOSMesa.so"
+#endif
+	});
+	if (!library)
+		return false;
+	OSMesaCreateContextAttribs = (PFNOSMESACREATECONTEXTATTRIBS)librarySymbol(library, "OSMesaCreateContextAttribs");
+	OSMesaDestroyContext = (PFNOSMESADESTROYCONTEXT)librarySymbol(library, "OSMesaDestroyContext");
+	OSMesaMakeCurrent = (PFNOSMESAMAKECURRENT)librarySymbol(library, "OSMesaMakeCurrent");
+	OSMesaGetProcAddress = (PFNOSMESAGETPROCADDRESS)librarySymbol(library, "OSMesaGetProcAddress");
+	if (OSMesaCreateContextAttribs && OSMesaDestroyContext && OSMesaMakeCurrent && OSMesaGetProcAddress)
+	{
+		int attributes[] = {
+			OSMESA_FORMAT, OSMESA_RGBA,
+			OSMESA_DEPTH_BITS, 24,
+			OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+			OSMESA_CONTEXT_MAJOR_VERSION, 3,
+			OSMESA_CONTEXT_MINOR_VERSION, 3,
+			0
+		};
+		for (const int* version : GL_CONTEXT_VERSIONS)
+		{
+			attributes[7] = version[0];
+			attributes[9] = version[1];
+			context = OSMesaCreateContextAttribs(attributes, nullptr);
+			if (context)
+				break;
+		}
+	}
+	if (!context)
+	{
+		Delete();
+		return false;
+	}
+	buffer = new unsigned char[OSMESA_SIZE * OSMESA_SIZE * 4];
+	return true;
+}
+
+// Destroys the context and unloads the library
+void HeadlessContext::Delete()
+{
+	if (context && backend == "egl")
+	{
+		eglMakeCurrent(display, nullptr, nullptr, nullptr);
+		eglDestroyContext(display, context);
+	}
+	else if (context && OSMesaDestroyContext)
+		OSMesaDestroyContext(context);
+	if (display && eglTerminate)
+		eglTerminate(display);
+	delete[] buffer;
+	if (library)
+		closeLibrary(library);
+	library = display = context = nullptr;
+	buffer = nullptr;
+	backend.clear();
+	eglGetProcAddress = nullptr;
+	eglQueryString = nullptr;
+	eglGetDisplay = nullptr;
+	eglInitialize = nullptr;
+	eglTerminate = nullptr;
+	eglBindAPI = nullptr;
+	eglChooseConfig = nullptr;
+	eglCreateContext = nullptr;
+	eglDestroyContext = nullptr;
+	eglMakeCurrent = nullptr;
+	OSMesaCreateContextAttribs = nullptr;
+	OSMesaDestroyContext = nullptr;
+	OSMesaMakeCurrent = nullptr;
+	OSMesaGetProcAddress = nullptr;
+}
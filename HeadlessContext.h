@@ -0,0 +1,55 @@
+#ifndef HEADLESS_CONTEXT_CLASS_H
+#define HEADLESS_CONTEXT_CLASS_H
+
+#include<string>
+
+// OpenGL core context without a window, for GPU servers and containers that have no display, the newest version
+// from 4.6 down to 3.3 the driver creates.
+// EGL comes first: the display of a GPU device (EGL_EXT_platform_device), else Mesa's surfaceless platform,
+// else the default display, with the context made current on no surface at all (EGL_KHR_surfaceless_context).
+// OSMesa's software renderer is the fallback. Both libraries are loaded when the context is created, so neither is
+// needed to build or to run with a window. There is no default framebuffer to draw into, every pass needs a
+// framebuffer object such as RenderTarget.
+class HeadlessContext
+{
+public:
+	// Name of the backend that created the context, "egl" or "osmesa", empty before Create succeeded
+	std::string backend;
+	// Asks EGL for a debug context, whose driver reports everything through KHR_debug, set before Create
+	bool debug = false;
+
+	// Constructor, nothing is loaded until Create
+	HeadlessContext();
+	// Destroys the context unless Delete was already called
+	~HeadlessContext();
+	// A HeadlessContext owns its context and libraries, so it can not be copied
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	// Number of GPU devices EGL can create contexts on, 0 without EGL_EXT_platform_device
+	static int DeviceCount();
+
+	// Creates the context with "egl", "osmesa" or "auto" for the first that works, and makes it current
+	// device picks the GPU of an EGL context, counted as DeviceCount counts them
+	// Returns false and prints why if none could be created
+	bool Create(const std::string& preferred = "auto", int device = 0);
+	// Makes the context current on the calling thread, or releases it from the calling thread
+	void MakeCurrent();
+	void ReleaseCurrent();
+	// Looks up a GL function of the current headless context, for gladLoadGLLoader and LoadGLExtensions
+	static void* GetProcAddress(const char* name);
+
+	// Destroys the context and unloads the libraries, does nothing if they were already
+	void Delete();
+private:
+	void* library = nullptr;
+	void* display = nullptr;
+	void* context = nullptr;
+	// OSMesa has to be given memory to render into even though nothing is drawn there
+	unsigned char* buffer = nullptr;
+
+	bool createEGL(int device);
+	bool createOSMesa();
+};
+
+#endif
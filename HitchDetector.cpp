@@ -0,0 +1,119 @@
+#include"HitchDetector.h"
+#include"AllocationCounter.h"
+#include"GLDebugOutput.h"
+
+#include<algorithm>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+
+namespace fs = std::filesystem;
+
+HitchDetector::HitchDetector(size_t frames, float thresholdMilliseconds, std::string directory)
+	: thresholdMilliseconds(thresholdMilliseconds), ring(std::max<size_t>(frames, 1)), directory(std::move(directory))
+{
+	allocationsBefore = AllocationCounter::Total();
+	errorsBefore = GLDebug.errors();
+	warningsBefore = GLDebug.performanceWarnings();
+}
+
+// The frame's time is the "frame" zone's, which BeginFrame ends, nothing is kept before it has one
+void HitchDetector::Record(const Profiler& profiler, uint64_t frameIndex, const Activity& activity)
+{
+	float frameMs = -1.0f;
+	Frame& frame = ring[next];
+	frame.zoneCount = std::min(profiler.zoneCount(), MAX_ZONES);
+	for (size_t i = 0; i < frame.zoneCount; i++)
+	{
+		frame.cpu[i] = profiler.LastCpu(i);
+		frame.gpu[i] = profiler.LastGpu(i);
+		if (profiler.zoneName(i) == "frame")
+			frameMs = frame.cpu[i];
+	}
+	if (frameMs < 0.0f)
+		return;
+
+	uint64_t allocations = AllocationCounter::Total();
+	size_t errors = GLDebug.errors();
+	size_t warnings = GLDebug.performanceWarnings();
+	frame.index = frameIndex;
+	frame.milliseconds = frameMs;
+	frame.allocations = allocations - allocationsBefore;
+	frame.errors = errors - errorsBefore;
+	frame.performanceWarnings = warnings - warningsBefore;
+	frame.activity = activity;
+	allocationsBefore = allocations;
+	errorsBefore = errors;
+	warningsBefore = warnings;
+	next = (next + 1) % ring.size();
+	filled = std::min(filled + 1, ring.size());
+
+	if (frameMs <= thresholdMilliseconds)
+		return;
+	hitchCount++;
+	if (filled < ring.size() && dumpCount > 0)
+		return;
+	if (dumpCount >= maxDumps)
+		return;
+	if (!dump(profiler, frameIndex))
+		std::cerr << "Could not write the frames around hitch " << frameIndex << " into " << directory << std::endl;
+	dumpCount++;
+	filled = 0;
+	// What the dump allocated is not the next frame's
+	allocationsBefore = AllocationCounter::Total();
+}
+
+bool HitchDetector::dump(const Profiler& profiler, uint64_t frameIndex)
+{
+	std::error_code error;
+	fs::create_directories(directory, error);
+	std::string path = (fs::path(directory) / ("hitch_" + std::to_string(frameIndex) + ".json")).string();
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << "{\n  \"hitch\": " << frameIndex << ",\n  \"threshold_ms\": " << thresholdMilliseconds << ",\n  \"zones\": [";
+	size_t zoneCount = std::min(profiler.zoneCount(), MAX_ZONES);
+	for (size_t i = 0; i < zoneCount; i++)
+		file << (i > 0 ? ", " : "") << "\"" << profiler.zoneName(i) << "\"";
+	file << "],\n  \"frames\": [\n";
+	// The whole ring, filled or not, oldest first
+	size_t count = 0;
+	for (size_t k = 0; k < ring.size(); k++)
+	{
+		const Frame& frame = ring[(next + k) % ring.size()];
+		if (frame.index == 0 && frame.milliseconds == 0.0f)
+			continue;
+		file << (count++ > 0 ? ",\n" : "") << "    { \"frame\": " << frame.index << ", \"ms\": " << frame.milliseconds
+			<< ", \"allocations\": " << frame.allocations << ", \"gl_errors\": " << frame.errors
+			<< ", \"gl_performance_warnings\": " << frame.performanceWarnings
+			<< ", \"textures_uploaded\": " << frame.activity.texturesUploaded << ", \"textures_pending\": " << frame.activity.texturesPending
+			<< ", \"tiles_uploaded\": " << frame.activity.tilesUploaded << ", \"tiles_pending\": " << frame.activity.tilesPending
+			<< ", \"cpu\": [";
+		for (size_t i = 0; i < frame.zoneCount; i++)
+			file << (i > 0 ? ", " : "") << frame.cpu[i];
+		file << "], \"gpu\": [";
+		for (size_t i = 0; i < frame.zoneCount; i++)
+			file << (i > 0 ? ", " : "") << frame.gpu[i];
+		file << "] }";
+	}
+	file << "\n  ],\n  \"gl_messages\": [\n";
+	std::vector<GLDebugOutput::Message> messages = GLDebug.Messages();
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		// Quotes and backslashes would end the string, control characters are dropped
+		std::string text;
+		for (char c : messages[i].text)
+		{
+			if (c == '"' || c == '\\')
+				text += '\\';
+			if ((unsigned char)c >= 32)
+				text += c;
+		}
+		file << "    { \"type\": \"" << GLDebugOutput::TypeName(messages[i].type) << "\", \"id\": " << messages[i].id
+			<< ", \"text\": \"" << text << "\" }" << (i + 1 < messages.size() ? "," : "") << "\n";
+	}
+	file << "  ]\n}\n";
+	std::cout << "Hitch of " << ring[(next + ring.size() - 1) % ring.size()].milliseconds << " ms at frame " << frameIndex
+		<< ", wrote " << path << std::endl;
+	return (bool)file;
+}
@@ -0,0 +1,78 @@
+#ifndef HITCH_DETECTOR_CLASS_H
+#define HITCH_DETECTOR_CLASS_H
+
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+#include"Profiler.h"
+
+// Keeps the last frames of the render thread in a ring: the CPU and GPU time of every profiler zone, the heap
+// allocations, the GL errors and performance warnings and what the texture loader and the tile streamer uploaded.
+// When a frame takes longer than a threshold the whole ring is written to a JSON file named after the frame, along
+// with the driver's latest messages, so a stutter seen once in the field can be looked at afterwards. The ring is
+// allocated once and filling it allocates nothing, only a dump does. After a dump the ring has to fill again before
+// the next, so a burst of slow frames makes one file rather than one each.
+class HitchDetector
+{
+public:
+	// Zones kept per frame, those after them are left out
+	static constexpr size_t MAX_ZONES = 64;
+
+	// Streaming done in a frame, filled in by the caller while the frame runs
+	struct Activity
+	{
+		size_t texturesUploaded = 0;
+		size_t texturesPending = 0;
+		size_t tilesUploaded = 0;
+		size_t tilesPending = 0;
+	};
+
+	// Milliseconds of the profiler's "frame" zone past which a frame is a hitch
+	float thresholdMilliseconds;
+	// Most files written, later hitches are only counted
+	size_t maxDumps = 16;
+
+	// Constructor that keeps the last frames frames and writes into directory, which is created on the first dump
+	HitchDetector(size_t frames, float thresholdMilliseconds, std::string directory);
+
+	// Takes the frame profiler's BeginFrame just ended, with the streaming it did, and writes the ring if it was a
+	// hitch. Call on the render thread right after BeginFrame
+	void Record(const Profiler& profiler, uint64_t frameIndex, const Activity& activity);
+
+	// Frames over the threshold so far and files written for them
+	size_t hitches() const { return hitchCount; }
+	size_t dumps() const { return dumpCount; }
+private:
+	// One frame of the ring, a zone's times are negative where it had none
+	struct Frame
+	{
+		uint64_t index = 0;
+		float milliseconds = 0.0f;
+		uint64_t allocations = 0;
+		size_t errors = 0;
+		size_t performanceWarnings = 0;
+		Activity activity;
+		size_t zoneCount = 0;
+		float cpu[MAX_ZONES];
+		float gpu[MAX_ZONES];
+	};
+
+	std::vector<Frame> ring;
+	// Slot the next frame goes into and how many are filled, which restarts from 0 after a dump
+	size_t next = 0;
+	size_t filled = 0;
+	std::string directory;
+	// Totals at the last frame, the frames keep what was added since
+	uint64_t allocationsBefore = 0;
+	size_t errorsBefore = 0;
+	size_t warningsBefore = 0;
+	size_t hitchCount = 0;
+	size_t dumpCount = 0;
+
+	// Writes the ring oldest first, returns false if the file cannot be written
+	bool dump(const Profiler& profiler, uint64_t frameIndex);
+};
+
+#endif
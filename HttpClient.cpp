@@ -0,0 +1,221 @@
+#include"HttpClient.h"
+
+#include<algorithm>
+#include<cctype>
+#include<cstdlib>
+#include<cstring>
+#include<iostream>
+
+#ifdef _WIN32
+#include<winsock2.h>
+#include<ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET NativeSocket;
+static const intptr_t INVALID_HANDLE = (intptr_t)INVALID_SOCKET;
+static void closeSocket(intptr_t handle) { closesocket((NativeSocket)handle); }
+#else
+#include<netdb.h>
+#include<sys/socket.h>
+#include<sys/time.h>
+#include<unistd.h>
+typedef int NativeSocket;
+static const intptr_t INVALID_HANDLE = -1;
+static void closeSocket(intptr_t handle) { close((NativeSocket)handle); }
+#endif
+
+// Bytes read from the socket at once
+static const size_t RECEIVE_BYTES = 64 * 1024;
+
+// Constructor that splits the url into host, port and base path
+HttpClient::HttpClient(const std::string& url)
+	: socket(INVALID_HANDLE)
+{
+	if (!IsUrl(url))
+		return;
+	std::string rest = url.substr(7);
+	size_t slash = rest.find('/');
+	std::string authority = rest.substr(0, slash);
+	basePath = slash == std::string::npos ? std::string() : rest.substr(slash);
+	while (!basePath.empty() && basePath.back() == '/')
+		basePath.pop_back();
+	size_t colon = authority.find(':');
+	host = authority.substr(0, colon);
+	port = colon == std::string::npos ? "80" : authority.substr(colon + 1);
+	valid = !host.empty() && !port.empty();
+#ifdef _WIN32
+	// Every client holds a reference to Winsock, which counts them
+	WSADATA data;
+	if (valid && WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		std::cerr << "ERROR::HTTP::WSASTARTUP_FAILED" << std::endl;
+		valid = false;
+	}
+#endif
+}
+
+// Closes the connection unless Close was already called
+HttpClient::~HttpClient()
+{
+	Close();
+#ifdef _WIN32
+	if (valid)
+		WSACleanup();
+#endif
+}
+
+bool HttpClient::IsUrl(const std::string& url)
+{
+	return url.compare(0, 7, "http://") == 0;
+}
+
+bool HttpClient::isValid() const
+{
+	return valid;
+}
+
+int HttpClient::status() const
+{
+	return lastStatus;
+}
+
+// Closes the connection
+void HttpClient::Close()
+{
+	if (socket != INVALID_HANDLE)
+		closeSocket(socket);
+	socket = INVALID_HANDLE;
+	pending.clear();
+}
+
+// Opens the connection to the first address of the host that answers
+bool HttpClient::connect()
+{
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addresses = nullptr;
+	if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+	{
+		std::cerr << "ERROR::HTTP::RESOLVE_FAILED " << host << std::endl;
+		return false;
+	}
+	for (addrinfo* address = addresses; address && socket == INVALID_HANDLE; address = address->ai_next)
+	{
+		socket = (intptr_t)::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (socket == INVALID_HANDLE)
+			continue;
+		if (::connect((NativeSocket)socket, address->ai_addr, (int)address->ai_addrlen) != 0)
+			Close();
+	}
+	freeaddrinfo(addresses);
+	if (socket == INVALID_HANDLE)
+	{
+		std::cerr << "ERROR::HTTP::CONNECT_FAILED " << host << ":" << port << std::endl;
+		return false;
+	}
+	// A server that stops answering fails the request instead of holding the worker forever
+#ifdef _WIN32
+	DWORD timeout = TIMEOUT_SECONDS * 1000;
+#else
+	timeval timeout{ TIMEOUT_SECONDS, 0 };
+#endif
+	setsockopt((NativeSocket)socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	setsockopt((NativeSocket)socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+	return true;
+}
+
+// Receives more bytes into pending
+bool HttpClient::receive()
+{
+	char buffer[RECEIVE_BYTES];
+	int received = recv((NativeSocket)socket, buffer, (int)sizeof(buffer), 0);
+	if (received <= 0)
+		return false;
+	pending.append(buffer, (size_t)received);
+	return true;
+}
+
+// Gets a file or a range of it, once more on a new connection if the kept one turned out to be closed
+bool HttpClient::Get(const std::string& path, std::vector<char>& body, size_t offset, size_t length)
+{
+	lastStatus = 0;
+	if (!valid)
+		return false;
+	std::string request = "GET " + basePath + "/" + path + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: keep-alive\r\n";
+	if (length > 0)
+		request += "Range: bytes=" + std::to_string(offset) + "-" + std::to_string(offset + length - 1) + "\r\n";
+	request += "\r\n";
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		bool reused = socket != INVALID_HANDLE;
+		if (!reused && !connect())
+			return false;
+		bool retry = false;
+		if (exchange(request, body, retry))
+			return lastStatus == 200 || (length > 0 && lastStatus == 206 && body.size() == length);
+		Close();
+		if (!retry || !reused)
+			return false;
+	}
+	return false;
+}
+
+// Sends the request, then reads the header and a body of Content-Length bytes
+bool HttpClient::exchange(const std::string& request, std::vector<char>& body, bool& retry)
+{
+	for (size_t sent = 0; sent < request.size();)
+	{
+		int count = send((NativeSocket)socket, request.data() + sent, (int)(request.size() - sent), 0);
+		if (count <= 0)
+		{
+			retry = true;
+			return false;
+		}
+		sent += (size_t)count;
+	}
+	size_t headerEnd;
+	while ((headerEnd = pending.find("\r\n\r\n")) == std::string::npos)
+	{
+		if (!receive())
+		{
+			retry = pending.empty();
+			return false;
+		}
+	}
+	std::string header = pending.substr(0, headerEnd);
+	pending.erase(0, headerEnd + 4);
+	// Header names are matched in lower case, values are read as they are
+	std::string lower = header;
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return (char)std::tolower((unsigned char)c); });
+	if (lower.compare(0, 5, "http/") != 0 || lower.find(' ') == std::string::npos)
+		return false;
+	lastStatus = std::atoi(header.c_str() + header.find(' ') + 1);
+	auto field = [&](const char* name) {
+		size_t at = lower.find(std::string("\r\n") + name + ":");
+		if (at == std::string::npos)
+			return std::string();
+		at += std::strlen(name) + 3;
+		size_t end = lower.find("\r\n", at);
+		std::string value = lower.substr(at, end == std::string::npos ? std::string::npos : end - at);
+		value.erase(0, value.find_first_not_of(' '));
+		return value;
+	};
+	if (field("transfer-encoding").find("chunked") != std::string::npos)
+	{
+		std::cerr << "ERROR::HTTP::CHUNKED_BODY_UNSUPPORTED" << std::endl;
+		return false;
+	}
+	std::string contentLength = field("content-length");
+	if (contentLength.empty())
+		return false;
+	size_t size = (size_t)std::strtoull(contentLength.c_str(), nullptr, 10);
+	while (pending.size() < size)
+		if (!receive())
+			return false;
+	body.assign(pending.begin(), pending.begin() + size);
+	pending.erase(0, size);
+	// A server that ends the connection after this response gets a new one on the next request
+	if (field("connection") == "close" || lower.compare(0, 8, "http/1.0") == 0)
+		Close();
+	return true;
+}
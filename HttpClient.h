@@ -0,0 +1,62 @@
+#ifndef HTTP_CLIENT_CLASS_H
+#define HTTP_CLIENT_CLASS_H
+
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+// Plain HTTP/1.1 GET requests to one server over a connection kept alive between them
+// The connection is opened on the first request and reused for every later one, so fetching many small files
+// costs one round trip each instead of a new TCP handshake too. A server that closed the idle connection meanwhile
+// gets the request once more on a fresh one. Bodies have to come with a Content-Length, as static file servers send
+// them, chunked bodies fail. There is no TLS, and one client serves one thread at a time, keep one per worker.
+class HttpClient
+{
+public:
+	// Seconds a request waits for the server before it fails
+	static constexpr int TIMEOUT_SECONDS = 5;
+
+	// Constructor for the server and base path of url, http://host[:port][/path], isValid tells if it could be parsed
+	HttpClient(const std::string& url);
+	// Closes the connection unless Close was already called
+	~HttpClient();
+	// A client owns its connection, so it cannot be copied
+	HttpClient(const HttpClient&) = delete;
+	HttpClient& operator=(const HttpClient&) = delete;
+
+	// Checks if url starts with http://, as a directory that is a server instead of a folder does
+	static bool IsUrl(const std::string& url);
+	// Whether the url could be parsed
+	bool isValid() const;
+	// Status code of the last response, 0 if none arrived
+	int status() const;
+
+	// Gets the file at path below the base path into body, or only length bytes of it from offset when length is
+	// not 0, with a Range request. False unless the whole body arrived with status 200 or, for a range, 206
+	// A server without ranges answers a range with the whole file, status() is then 200 and body holds all of it
+	bool Get(const std::string& path, std::vector<char>& body, size_t offset = 0, size_t length = 0);
+
+	// Closes the connection, the next request opens a new one
+	void Close();
+private:
+	std::string host;
+	std::string port;
+	std::string basePath;
+	bool valid = false;
+	int lastStatus = 0;
+	// Native socket handle, invalid while not connected
+	intptr_t socket;
+	// Bytes received past the end of the last response
+	std::string pending;
+
+	// Opens the connection to the server, false if it could not be reached
+	bool connect();
+	// Sends the request and reads its response over the open connection, sets retry if the connection was found closed
+	// before any of the response arrived
+	bool exchange(const std::string& request, std::vector<char>& body, bool& retry);
+	// Receives more bytes into pending, false once the connection closed or timed out
+	bool receive();
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include"ImageConvert.h"
+
+#include<cstring>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define IMAGE_CONVERT_SSSE3 1
+#include<tmmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define IMAGE_CONVERT_NEON 1
+#include<arm_neon.h>
+#endif
+
+// Widens one row of RGB pixels to RGBA with opaque alpha
+static void expandRGB(const uint8_t* rgb, int width, uint8_t* rgba)
+{
+	int x = 0;
+#if IMAGE_CONVERT_SSSE3
+	// 16 bytes hold 5 whole pixels, loads advance by 4 so the 16th byte is never read past the row
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32((int)0xFF000000u);
+	for (; x + 6 <= width; x += 4)
+	{
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(rgb + x * 3));
+		_mm_storeu_si128((__m128i*)(rgba + x * 4), _mm_or_si128(_mm_shuffle_epi8(pixels, shuffle), alpha));
+	}
+#elif IMAGE_CONVERT_NEON
+	for (; x + 16 <= width; x += 16)
+	{
+		uint8x16x3_t pixels = vld3q_u8(rgb + x * 3);
+		uint8x16x4_t wide;
+		wide.val[0] = pixels.val[0];
+		wide.val[1] = pixels.val[1];
+		wide.val[2] = pixels.val[2];
+		wide.val[3] = vdupq_n_u8(0xFF);
+		vst4q_u8(rgba + x * 4, wide);
+	}
+#endif
+	for (; x < width; x++)
+	{
+		rgba[x * 4 + 0] = rgb[x * 3 + 0];
+		rgba[x * 4 + 1] = rgb[x * 3 + 1];
+		rgba[x * 4 + 2] = rgb[x * 3 + 2];
+		rgba[x * 4 + 3] = 0xFF;
+	}
+}
+
+// Widens one row of gray or gray and alpha pixels to RGBA
+static void expandGray(const uint8_t* gray, int width, int channels, uint8_t* rgba)
+{
+	for (int x = 0; x < width; x++)
+	{
+		uint8_t value = gray[x * channels];
+		rgba[x * 4 + 0] = value;
+		rgba[x * 4 + 1] = value;
+		rgba[x * 4 + 2] = value;
+		rgba[x * 4 + 3] = channels == 2 ? gray[x * 2 + 1] : 0xFF;
+	}
+}
+
+// Converts to RGBA8 and flips in one pass
+void ImageConvert::ToRGBA(const uint8_t* pixels, int width, int height, int channels, bool flip, uint8_t* rgba)
+{
+	size_t sourceStride = (size_t)width * channels;
+	size_t targetStride = (size_t)width * 4;
+	for (int y = 0; y < height; y++)
+	{
+		const uint8_t* source = pixels + (flip ? height - 1 - y : y) * sourceStride;
+		uint8_t* target = rgba + y * targetStride;
+		if (channels == 4)
+			std::memcpy(target, source, targetStride);
+		else if (channels == 3)
+			expandRGB(source, width, target);
+		else
+			expandGray(source, width, channels, target);
+	}
+}
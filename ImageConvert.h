@@ -0,0 +1,17 @@
+#ifndef IMAGE_CONVERT_CLASS_H
+#define IMAGE_CONVERT_CLASS_H
+
+#include<cstdint>
+
+// Turns decoded 8 bit images of 1 to 4 channels into RGBA8, flipping them vertically in the same pass
+// stb_image would otherwise expand the channels and flip the rows in two passes of its own, a byte at a time.
+// Three channel rows are widened with SSSE3 shuffles or NEON interleaved stores where the compiler targets them and
+// four bytes at a time elsewhere, rows that are RGBA already are copied as they are.
+class ImageConvert
+{
+public:
+	// Writes width * height * 4 bytes to rgba, flip makes the last source row the first one written
+	static void ToRGBA(const uint8_t* pixels, int width, int height, int channels, bool flip, uint8_t* rgba);
+};
+
+#endif
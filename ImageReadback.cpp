@@ -0,0 +1,144 @@
+#include"ImageReadback.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"ImageWriter.h"
+
+#include<cstdint>
+#include<cstring>
+#include<utility>
+#include<vector>
+
+// Constructor, the buffers are allocated by the first Read of a size
+ImageReadback::ImageReadback(JobSystem& jobs)
+	: jobs(jobs)
+{
+}
+
+// Finishes everything unless Delete was already called
+ImageReadback::~ImageReadback()
+{
+	Delete();
+}
+
+// Starts reading a framebuffer into the next buffer of the ring
+void ImageReadback::Read(GLuint framebuffer, GLsizei width, GLsizei height, const std::string& path)
+{
+	Slot& slot = slots[next];
+	next = (next + 1) % SLOTS;
+	if (slot.fence)
+		complete(slot, true);
+
+	slot.width = width;
+	slot.height = height;
+	slot.hdr = ImageWriter::IsEXRFile(path);
+	slot.path = path;
+	GLsizeiptr size = (GLsizeiptr)width * height * 4 * (slot.hdr ? sizeof(float) : 1);
+	if (slot.buffer == 0)
+		glGenBuffers(1, &slot.buffer);
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	if (size > slot.capacity)
+	{
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, slot.buffer, size);
+		slot.capacity = size;
+	}
+
+	// With a pack buffer bound glReadPixels only queues the copy and returns
+	GLint previous;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, slot.hdr ? GL_FLOAT : GL_UNSIGNED_BYTE, nullptr);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Hands every finished read to a writer job
+void ImageReadback::Poll()
+{
+	for (int i = 0; i < SLOTS; i++)
+	{
+		Slot& slot = slots[(next + i) % SLOTS];
+		if (slot.fence)
+			complete(slot, false);
+	}
+}
+
+// Waits for every read and every file
+void ImageReadback::Finish()
+{
+	for (int i = 0; i < SLOTS; i++)
+	{
+		Slot& slot = slots[(next + i) % SLOTS];
+		if (slot.fence)
+			complete(slot, true);
+	}
+	jobs.Wait(writing);
+}
+
+size_t ImageReadback::written() const
+{
+	return writtenCount.load();
+}
+
+size_t ImageReadback::failed() const
+{
+	return failedCount.load();
+}
+
+// Copies the pixels of a finished read out and submits the writer job
+void ImageReadback::complete(Slot& slot, bool wait)
+{
+	GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0);
+	while (wait && result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	if (result == GL_TIMEOUT_EXPIRED)
+		return;
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	// The copy frees the buffer for the next read before the slow part, encoding, even starts
+	size_t size = (size_t)slot.width * slot.height * 4 * (slot.hdr ? sizeof(float) : 1);
+	std::vector<uint8_t> pixels(size);
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	void* mapping = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+	bool mapped = mapping != nullptr;
+	if (mapped)
+	{
+		std::memcpy(pixels.data(), mapping, size);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (!mapped)
+	{
+		failedCount++;
+		return;
+	}
+
+	int width = slot.width, height = slot.height;
+	bool hdr = slot.hdr;
+	std::string path = slot.path;
+	jobs.Submit([this, pixels = std::move(pixels), width, height, hdr, path]() {
+		bool ok = hdr ? ImageWriter::WriteEXR(path, width, height, (const float*)pixels.data())
+			: ImageWriter::WritePNG(path, width, height, pixels.data());
+		if (ok)
+			writtenCount++;
+		else
+			failedCount++;
+	}, &writing);
+}
+
+// Finishes everything and deletes the buffers
+void ImageReadback::Delete()
+{
+	Finish();
+	for (Slot& slot : slots)
+	{
+		if (slot.buffer != 0)
+			GLState.DeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+		slot.capacity = 0;
+	}
+}
@@ -0,0 +1,69 @@
+#ifndef IMAGE_READBACK_CLASS_H
+#define IMAGE_READBACK_CLASS_H
+
+#include<glad/glad.h>
+#include<atomic>
+#include<cstddef>
+#include<string>
+
+#include"JobSystem.h"
+
+// Reads rendered images back to the CPU without stalling the GPU, and writes them to disk on the job pool
+// Read starts an asynchronous glReadPixels into one of a ring of pixel pack buffers and fences it, so the GPU goes
+// on with the next frames while the copy finishes. Poll maps the buffers whose fence has passed, copies the pixels
+// out and hands them to a writer job, which encodes them with ImageWriter. Only a Read that finds every buffer still
+// in flight waits, for the oldest one.
+class ImageReadback
+{
+public:
+	// Pixel buffers in the ring, reads of as many frames can be in flight at once
+	static constexpr int SLOTS = 3;
+
+	// Constructor, the buffers are allocated by the first Read of a size
+	ImageReadback(JobSystem& jobs);
+	// Finishes every read and file and deletes the buffers unless Delete was already called, the context has to still be current
+	~ImageReadback();
+	// An ImageReadback is referenced by the jobs it submitted, so it can neither be copied nor moved
+	ImageReadback(const ImageReadback&) = delete;
+	ImageReadback& operator=(const ImageReadback&) = delete;
+
+	// Starts reading the color of a framebuffer of width by height, the image is written to path once it arrived,
+	// as 32 bit float EXR if path ends in .exr and as 8 bit PNG otherwise
+	void Read(GLuint framebuffer, GLsizei width, GLsizei height, const std::string& path);
+	// Hands every read the GPU has finished to a writer job, never waits
+	void Poll();
+	// Waits for every read and every file to be written
+	void Finish();
+
+	// Files written and files that could not be, so far
+	size_t written() const;
+	size_t failed() const;
+
+	// Finishes everything and deletes the buffers, does nothing if they were already deleted
+	void Delete();
+private:
+	// A read in flight, or a free buffer when fence is null
+	struct Slot
+	{
+		GLuint buffer = 0;
+		GLsizeiptr capacity = 0;
+		GLsync fence = nullptr;
+		GLsizei width = 0;
+		GLsizei height = 0;
+		bool hdr = false;
+		std::string path;
+	};
+
+	JobSystem& jobs;
+	JobSystem::Counter writing;
+	Slot slots[SLOTS];
+	// Slot the next Read uses, the oldest read in flight when every slot is busy
+	int next = 0;
+	std::atomic<size_t> writtenCount{ 0 };
+	std::atomic<size_t> failedCount{ 0 };
+
+	// Copies the pixels of a finished read out of its buffer and submits the writer job, waiting for the GPU with wait set
+	void complete(Slot& slot, bool wait);
+};
+
+#endif
@@ -0,0 +1,455 @@
+#include"ImageWriter.h"
+
+#include<algorithm>
+#include<array>
+#include<cctype>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<sstream>
+#include<vector>
+
+// Length and distance codes of deflate, each a base and how many extra bits follow it
+static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+// Deflate's bit stream, values go in least significant bit first and Huffman codes most significant bit first
+class BitStream
+{
+public:
+	std::vector<uint8_t> bytes;
+
+	void Put(uint32_t value, int bits)
+	{
+		buffer |= value << count;
+		count += bits;
+		while (count >= 8)
+		{
+			bytes.push_back((uint8_t)buffer);
+			buffer >>= 8;
+			count -= 8;
+		}
+	}
+	void PutCode(uint32_t code, int bits)
+	{
+		uint32_t reversed = 0;
+		for (int i = 0; i < bits; i++)
+			reversed |= ((code >> i) & 1u) << (bits - 1 - i);
+		Put(reversed, bits);
+	}
+	void Flush()
+	{
+		if (count > 0)
+			bytes.push_back((uint8_t)buffer);
+		buffer = 0;
+		count = 0;
+	}
+private:
+	uint32_t buffer = 0;
+	int count = 0;
+};
+
+// Writes a literal or the end of block with the fixed Huffman codes
+static void putSymbol(BitStream& stream, unsigned int symbol)
+{
+	if (symbol < 144)
+		stream.PutCode(0x30 + symbol, 8);
+	else if (symbol < 256)
+		stream.PutCode(0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		stream.PutCode(symbol - 256, 7);
+	else
+		stream.PutCode(0xC0 + symbol - 280, 8);
+}
+
+// Writes a match of length bytes that starts distance bytes back
+static void putMatch(BitStream& stream, unsigned int length, unsigned int distance)
+{
+	int code = 28;
+	while (lengthBase[code] > length)
+		code--;
+	putSymbol(stream, 257 + code);
+	stream.Put(length - lengthBase[code], lengthExtra[code]);
+	code = 29;
+	while (distanceBase[code] > distance)
+		code--;
+	stream.PutCode(code, 5);
+	stream.Put(distance - distanceBase[code], distanceExtra[code]);
+}
+
+// Compresses size bytes into one fixed Huffman block of stream, matches reach back no further than the start of data
+static void deflateBlock(BitStream& stream, const uint8_t* data, size_t size, bool final)
+{
+	const size_t window = 32768, minMatch = 3, maxMatch = 258;
+	const unsigned int hashBits = 15;
+	std::vector<int64_t> last((size_t)1 << hashBits, -1);
+	auto hash = [&](size_t i) {
+		uint32_t value = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+		return (value * 2654435761u) >> (32 - hashBits);
+	};
+
+	stream.Put(final ? 1 : 0, 1);
+	stream.Put(1, 2);
+	size_t i = 0;
+	while (i < size)
+	{
+		size_t length = 0, distance = 0;
+		if (i + minMatch <= size)
+		{
+			uint32_t h = hash(i);
+			int64_t candidate = last[h];
+			last[h] = (int64_t)i;
+			if (candidate >= 0 && i - (size_t)candidate <= window)
+			{
+				size_t limit = std::min(maxMatch, size - i);
+				while (length < limit && data[(size_t)candidate + length] == data[i + length])
+					length++;
+				distance = i - (size_t)candidate;
+			}
+		}
+		if (length >= minMatch)
+		{
+			putMatch(stream, (unsigned int)length, (unsigned int)distance);
+			// The positions the match covers are still remembered for later matches
+			for (size_t j = i + 1; j < i + length && j + minMatch <= size; j++)
+				last[hash(j)] = (int64_t)j;
+			i += length;
+		}
+		else
+		{
+			putSymbol(stream, data[i]);
+			i++;
+		}
+	}
+	putSymbol(stream, 256);
+}
+
+// Adler-32 of the uncompressed data, continued from the value of the data before it
+static uint32_t adler32(const uint8_t* data, size_t size, uint32_t adler = 1)
+{
+	uint32_t a = adler & 0xFFFF, b = adler >> 16;
+	for (size_t i = 0; i < size; i++)
+	{
+		a = (a + data[i]) % 65521;
+		b = (b + a) % 65521;
+	}
+	return (b << 16) | a;
+}
+
+// Appends the Adler-32 that ends a zlib stream, most significant byte first
+static void putAdler(std::vector<uint8_t>& bytes, uint32_t adler)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+		bytes.push_back((uint8_t)(adler >> shift));
+}
+
+// zlib header for deflate with a 32 KB window, the check bits make it a multiple of 31
+static const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+
+// Compresses data into a zlib stream of one fixed Huffman block
+static std::vector<uint8_t> deflate(const std::vector<uint8_t>& data)
+{
+	BitStream stream;
+	stream.bytes.assign(zlibHeader, zlibHeader + 2);
+	deflateBlock(stream, data.data(), data.size(), true);
+	stream.Flush();
+	putAdler(stream.bytes, adler32(data.data(), data.size()));
+	return stream.bytes;
+}
+
+// Table of the CRC-32 PNG chunks use, built once
+static std::array<uint32_t, 256> crcTable()
+{
+	std::array<uint32_t, 256> table;
+	for (uint32_t n = 0; n < 256; n++)
+	{
+		uint32_t c = n;
+		for (int k = 0; k < 8; k++)
+			c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		table[n] = c;
+	}
+	return table;
+}
+
+// CRC-32 as PNG chunks use it, safe to call from several writer threads at once
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0xFFFFFFFFu)
+{
+	static const std::array<uint32_t, 256> table = crcTable();
+	for (size_t i = 0; i < size; i++)
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+// Writes a big endian 32 bit integer
+static void writeBig32(std::ostream& file, uint32_t value)
+{
+	const uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+	file.write((const char*)bytes, 4);
+}
+
+// Writes a PNG chunk with its length and CRC
+static void writeChunk(std::ostream& file, const char* type, const std::vector<uint8_t>& data)
+{
+	writeBig32(file, (uint32_t)data.size());
+	file.write(type, 4);
+	file.write((const char*)data.data(), data.size());
+	uint32_t crc = crc32((const uint8_t*)type, 4);
+	crc = crc32(data.data(), data.size(), crc);
+	writeBig32(file, crc ^ 0xFFFFFFFFu);
+}
+
+// Checks if a path names an EXR file
+bool ImageWriter::IsEXRFile(const std::string& path)
+{
+	if (path.size() < 4)
+		return false;
+	std::string extension = path.substr(path.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+	return extension == ".exr";
+}
+
+// Filters a row of RGBA pixels into out, which starts with its filter, Sub predicts each byte from the pixel to its left
+static void filterRow(const uint8_t* row, size_t rowBytes, uint8_t* out)
+{
+	out[0] = 1;
+	for (size_t x = 0; x < rowBytes; x++)
+		out[1 + x] = (uint8_t)(row[x] - (x >= 4 ? row[x - 4] : 0));
+}
+
+// Writes the signature and the header of an 8 bit RGBA PNG
+static void writePNGHeader(std::ostream& file, int width, int height)
+{
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	file.write((const char*)signature, 8);
+	// Size, 8 bits per channel, RGBA, deflate, adaptive filtering, no interlacing
+	std::vector<uint8_t> header = {
+		(uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+		(uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+		8, 6, 0, 0, 0
+	};
+	writeChunk(file, "IHDR", header);
+}
+
+// Files are written under a temporary name and renamed once complete, so a file that exists is always whole, which
+// the processes of a render farm rely on when they look for each other's images
+static std::string partialPath(const std::string& path)
+{
+	return path + ".part";
+}
+
+// Closes a file written under its temporary name and gives it its own, false with a message if either failed
+static bool finishFile(std::ofstream& file, const std::string& path)
+{
+	file.close();
+	std::error_code error;
+	if (!file.fail())
+		std::filesystem::rename(partialPath(path), path, error);
+	if (file.fail() || error)
+	{
+		std::cerr << "Failed to write " << path << std::endl;
+		std::filesystem::remove(partialPath(path), error);
+		return false;
+	}
+	return true;
+}
+
+// Writes the chunks of an 8 bit RGBA PNG
+static void writePNG(std::ostream& out, int width, int height, const uint8_t* pixels)
+{
+	size_t rowBytes = (size_t)width * 4;
+	std::vector<uint8_t> filtered((rowBytes + 1) * height);
+	for (int y = 0; y < height; y++)
+		filterRow(pixels + (size_t)(height - 1 - y) * rowBytes, rowBytes, &filtered[(rowBytes + 1) * y]);
+	writePNGHeader(out, width, height);
+	writeChunk(out, "IDAT", deflate(filtered));
+	writeChunk(out, "IEND", {});
+}
+
+// Writes an 8 bit RGBA PNG
+bool ImageWriter::WritePNG(const std::string& path, int width, int height, const uint8_t* pixels)
+{
+	std::ofstream file(partialPath(path), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+	writePNG(file, width, height, pixels);
+	return finishFile(file, path);
+}
+
+// Encodes an 8 bit RGBA PNG in memory
+std::vector<uint8_t> ImageWriter::EncodePNG(int width, int height, const uint8_t* pixels)
+{
+	std::ostringstream out(std::ios::binary);
+	writePNG(out, width, height, pixels);
+	const std::string bytes = out.str();
+	return std::vector<uint8_t>(bytes.begin(), bytes.end());
+}
+
+ImageWriter::PNGStream::~PNGStream()
+{
+	// A stream given up on leaves no file behind
+	if (file.is_open())
+	{
+		file.close();
+		std::error_code error;
+		std::filesystem::remove(partialPath(path), error);
+	}
+}
+
+bool ImageWriter::PNGStream::Open(const std::string& path, int width, int height)
+{
+	this->path = path;
+	this->width = width;
+	this->height = height;
+	rows = 0;
+	adler = 1;
+	file.open(partialPath(path), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+	writePNGHeader(file, width, height);
+	return true;
+}
+
+bool ImageWriter::PNGStream::Write(const uint8_t* pixels, int count)
+{
+	if (!file.is_open())
+		return false;
+	count = std::min(count, height - rows);
+	if (count <= 0)
+		return (bool)file;
+	size_t rowBytes = (size_t)width * 4;
+	filtered.resize((rowBytes + 1) * count);
+	for (int y = 0; y < count; y++)
+		filterRow(pixels + (size_t)y * rowBytes, rowBytes, &filtered[(rowBytes + 1) * y]);
+	adler = adler32(filtered.data(), filtered.size(), adler);
+
+	// The band's block, then an empty stored block as zlib's sync flush writes it, which ends on a byte boundary so
+	// the chunk holds whole bytes and the next band's block starts a new one
+	BitStream stream;
+	if (rows == 0)
+		stream.bytes.assign(zlibHeader, zlibHeader + 2);
+	deflateBlock(stream, filtered.data(), filtered.size(), false);
+	stream.Put(0, 3);
+	stream.Flush();
+	stream.bytes.insert(stream.bytes.end(), { 0x00, 0x00, 0xFF, 0xFF });
+	writeChunk(file, "IDAT", stream.bytes);
+	rows += count;
+	return (bool)file;
+}
+
+bool ImageWriter::PNGStream::Close()
+{
+	if (!file.is_open())
+		return false;
+	if (rows < height)
+	{
+		std::cerr << path << " got " << rows << " of its " << height << " rows" << std::endl;
+		return false;
+	}
+	// An empty final block ends the deflate stream
+	BitStream stream;
+	stream.Put(1, 1);
+	stream.Put(1, 2);
+	putSymbol(stream, 256);
+	stream.Flush();
+	putAdler(stream.bytes, adler);
+	writeChunk(file, "IDAT", stream.bytes);
+	writeChunk(file, "IEND", {});
+	return finishFile(file, path);
+}
+
+// Appends a little endian value of any plain type
+template<typename T>
+static void append(std::vector<uint8_t>& bytes, T value)
+{
+	size_t offset = bytes.size();
+	bytes.resize(offset + sizeof(T));
+	std::memcpy(&bytes[offset], &value, sizeof(T));
+}
+
+// Appends an EXR header attribute
+static void appendAttribute(std::vector<uint8_t>& bytes, const char* name, const char* type, const std::vector<uint8_t>& value)
+{
+	bytes.insert(bytes.end(), name, name + strlen(name) + 1);
+	bytes.insert(bytes.end(), type, type + strlen(type) + 1);
+	append<int32_t>(bytes, (int32_t)value.size());
+	bytes.insert(bytes.end(), value.begin(), value.end());
+}
+
+// Writes an uncompressed float RGBA EXR
+bool ImageWriter::WriteEXR(const std::string& path, int width, int height, const float* pixels)
+{
+	std::vector<uint8_t> header;
+	// Magic number, then version 2 of a single part scanline file
+	append<uint32_t>(header, 20000630u);
+	append<uint32_t>(header, 2u);
+
+	// Channels are stored in alphabetical order, each as 32 bit float, not perceptually linear, sampled every pixel
+	const char* channels = "ABGR";
+	std::vector<uint8_t> list;
+	for (int c = 0; c < 4; c++)
+	{
+		list.push_back((uint8_t)channels[c]);
+		list.push_back(0);
+		append<int32_t>(list, 2);
+		append<uint32_t>(list, 0u);
+		append<int32_t>(list, 1);
+		append<int32_t>(list, 1);
+	}
+	list.push_back(0);
+	appendAttribute(header, "channels", "chlist", list);
+	appendAttribute(header, "compression", "compression", { 0 });
+	std::vector<uint8_t> window;
+	append<int32_t>(window, 0);
+	append<int32_t>(window, 0);
+	append<int32_t>(window, width - 1);
+	append<int32_t>(window, height - 1);
+	appendAttribute(header, "dataWindow", "box2i", window);
+	appendAttribute(header, "displayWindow", "box2i", window);
+	appendAttribute(header, "lineOrder", "lineOrder", { 0 });
+	std::vector<uint8_t> one, center;
+	append<float>(one, 1.0f);
+	append<float>(center, 0.0f);
+	append<float>(center, 0.0f);
+	appendAttribute(header, "pixelAspectRatio", "float", one);
+	appendAttribute(header, "screenWindowCenter", "v2f", center);
+	appendAttribute(header, "screenWindowWidth", "float", one);
+	header.push_back(0);
+
+	// One scanline per block: its y, its byte count, then every channel's row
+	uint32_t lineBytes = (uint32_t)width * 4 * sizeof(float);
+	uint64_t firstLine = header.size() + (uint64_t)height * sizeof(uint64_t);
+	for (int y = 0; y < height; y++)
+		append<uint64_t>(header, firstLine + (uint64_t)y * (8 + lineBytes));
+
+	std::ofstream file(partialPath(path), std::ios::binary | std::ios::trunc);
+	if (!file)
+	{
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+	file.write((const char*)header.data(), header.size());
+	// RGBA index of each channel in the order above
+	const int source[4] = { 3, 2, 1, 0 };
+	std::vector<uint8_t> line;
+	for (int y = 0; y < height; y++)
+	{
+		const float* row = pixels + (size_t)(height - 1 - y) * width * 4;
+		line.clear();
+		append<int32_t>(line, y);
+		append<uint32_t>(line, lineBytes);
+		for (int c = 0; c < 4; c++)
+			for (int x = 0; x < width; x++)
+				append<float>(line, row[x * 4 + source[c]]);
+		file.write((const char*)line.data(), line.size());
+	}
+	return finishFile(file, path);
+}
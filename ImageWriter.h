@@ -0,0 +1,57 @@
+#ifndef IMAGE_WRITER_CLASS_H
+#define IMAGE_WRITER_CLASS_H
+
+#include<cstddef>
+#include<cstdint>
+#include<fstream>
+#include<string>
+#include<vector>
+
+// Writes rendered images to disk, self contained so exports need no image library beside stb_image
+// Pixels are RGBA in the order glReadPixels returns them, bottom row first, and written top row first as the formats
+// expect. PNG is 8 bits per channel, deflated with fixed Huffman codes and a single probe LZ77 search. EXR is the
+// uncompressed scanline layout with 32 bit float channels, which every EXR reader accepts. Files are written under a
+// temporary name and renamed once complete.
+class ImageWriter
+{
+public:
+	// Checks if a path names an EXR file by its extension, anything else is written as PNG
+	static bool IsEXRFile(const std::string& path);
+	// Writes width by height RGBA pixels, returns false and prints why if the file cannot be written
+	static bool WritePNG(const std::string& path, int width, int height, const uint8_t* pixels);
+	static bool WriteEXR(const std::string& path, int width, int height, const float* pixels);
+	// Encodes the same PNG as WritePNG into memory, for files that hold many images such as virtual textures
+	static std::vector<uint8_t> EncodePNG(int width, int height, const uint8_t* pixels);
+
+	// Writes a PNG a band of rows at a time, for images such as stitched posters that are too large to be held whole
+	// Each band is deflated into a block of its own, whose matches reach back no further than the band, and goes out as
+	// an IDAT chunk, while the checksum of the zlib stream is kept running across them
+	class PNGStream
+	{
+	public:
+		PNGStream() = default;
+		// Removes the file of a stream that was not closed
+		~PNGStream();
+		PNGStream(const PNGStream&) = delete;
+		PNGStream& operator=(const PNGStream&) = delete;
+
+		// Creates the file and writes its header, false with a message if it cannot be created
+		bool Open(const std::string& path, int width, int height);
+		// Appends count rows of width RGBA pixels, top row first unlike the pixels WritePNG takes
+		bool Write(const uint8_t* pixels, int count);
+		// Ends the image after its last row, false with a message if rows are missing or the file could not be written
+		bool Close();
+	private:
+		std::ofstream file;
+		std::string path;
+		int width = 0;
+		int height = 0;
+		// Rows written so far and the Adler-32 of their filtered bytes
+		int rows = 0;
+		uint32_t adler = 1;
+		// Filtered rows of the band being written, kept to reuse its memory
+		std::vector<uint8_t> filtered;
+	};
+};
+
+#endif
@@ -0,0 +1,145 @@
+#include"ImpostorAtlas.h"
+#include"GpuMemory.h"
+
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/constants.hpp>
+#include<cmath>
+#include<iostream>
+#include<utility>
+
+// Radius of the vertical cylinder around a box, which every view has to fit
+static float cylinderRadius(const glm::vec3& min, const glm::vec3& max)
+{
+	return 0.5f * glm::length(glm::vec2(max.x - min.x, max.z - min.z));
+}
+
+// Constructor that allocates the atlas and a framebuffer to render into it
+ImpostorAtlas::ImpostorAtlas(GLsizei cellSize, GLsizei views, GLsizei layers)
+	: atlas(cellSize * views, cellSize, layers)
+{
+	ImpostorAtlas::cellSize = cellSize;
+	ImpostorAtlas::views = views;
+
+	// One depth buffer the size of a layer is shared by every bake
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlas.width, atlas.height);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, depthBuffer, GpuMemoryTracker::ImageBytes(GL_DEPTH_COMPONENT24, atlas.width, atlas.height));
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint previous;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, atlas.ID, 0, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "Impostor framebuffer is incomplete" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+// Deletes the framebuffer and atlas unless Delete was already called
+ImpostorAtlas::~ImpostorAtlas()
+{
+	Delete();
+}
+
+// Takes over the GL objects of another atlas, which is left empty
+ImpostorAtlas::ImpostorAtlas(ImpostorAtlas&& other) noexcept
+	: atlas(std::move(other.atlas)), cellSize(other.cellSize), views(other.views),
+	framebuffer(std::exchange(other.framebuffer, 0)), depthBuffer(std::exchange(other.depthBuffer, 0))
+{
+}
+
+// Deletes the current GL objects and takes over the ones of another atlas
+ImpostorAtlas& ImpostorAtlas::operator=(ImpostorAtlas&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		atlas = std::move(other.atlas);
+		cellSize = other.cellSize;
+		views = other.views;
+		framebuffer = std::exchange(other.framebuffer, 0);
+		depthBuffer = std::exchange(other.depthBuffer, 0);
+	}
+	return *this;
+}
+
+// Renders every view of a box into a layer
+bool ImpostorAtlas::Bake(GLsizei layer, const glm::vec3& min, const glm::vec3& max, const std::function<void(const glm::mat4& projection, const glm::mat4& view)>& draw)
+{
+	if (layer < 0 || layer >= atlas.layers || framebuffer == 0)
+		return false;
+
+	GLint previous, viewport[4];
+	GLfloat clearColor[4];
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, atlas.ID, 0, layer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, previous);
+		return false;
+	}
+	// Cells never overlap, so one clear of the whole layer is enough for every view
+	glViewport(0, 0, atlas.width, atlas.height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// The camera circles the bounding cylinder at mid height, which the billboard's quad covers exactly
+	float radius = cylinderRadius(min, max);
+	float halfHeight = 0.5f * (max.y - min.y);
+	glm::vec3 center = 0.5f * (min + max);
+	glm::mat4 projection = glm::ortho(-radius, radius, -halfHeight, halfHeight, 0.5f, 2.0f * radius + 1.5f);
+	for (GLsizei v = 0; v < views; v++)
+	{
+		float azimuth = v * glm::two_pi<float>() / views;
+		glm::vec3 eye = center + glm::vec3(sin(azimuth), 0.0f, cos(azimuth)) * (radius + 1.0f);
+		glViewport(v * cellSize, 0, cellSize, cellSize);
+		draw(projection, glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f)));
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	return true;
+}
+
+// Rebuilds the mip chain
+void ImpostorAtlas::Finish()
+{
+	atlas.Bind();
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	atlas.Unbind();
+}
+
+// Writes the record of the billboard that shows a baked box
+GLfloat* ImpostorAtlas::WriteRecord(GLfloat* out, const glm::vec3& min, const glm::vec3& max, GLsizei layer)
+{
+	// Bottom center of the bounding cylinder
+	out[0] = 0.5f * (min.x + max.x);
+	out[1] = min.y;
+	out[2] = 0.5f * (min.z + max.z);
+	// Half the width and the height of the quad
+	out[3] = cylinderRadius(min, max);
+	out[4] = max.y - min.y;
+	// Layer holding its views
+	out[5] = (GLfloat)layer;
+	return out + RECORD_FLOATS;
+}
+
+// Deletes the framebuffer and atlas
+void ImpostorAtlas::Delete()
+{
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	GpuMemory.Untrack(GL_RENDERBUFFER, depthBuffer);
+	if (depthBuffer != 0)
+		glDeleteRenderbuffers(1, &depthBuffer);
+	framebuffer = depthBuffer = 0;
+	atlas.Delete();
+}
@@ -0,0 +1,51 @@
+#ifndef IMPOSTOR_ATLAS_CLASS_H
+#define IMPOSTOR_ATLAS_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<functional>
+
+#include"TextureArray.h"
+
+// Pre-rendered views of boxes such as whole city blocks, so far away ones are drawn as a single camera facing quad.
+// Every box gets one layer holding views cells side by side, cell v shows it from the azimuth v * 360 / views degrees
+// around the Y axis through an orthographic camera that frames the box's bounding cylinder.
+class ImpostorAtlas
+{
+public:
+	// Floats per billboard record written by WriteRecord: bottom center, radius, height and layer
+	static constexpr unsigned int RECORD_FLOATS = 6;
+
+	// Views of every box, cleared to transparent around them
+	// Neighbouring cells show other views, so it is sampled with SamplerSet::TRILINEAR_CLAMP and nothing wraps into them
+	TextureArray atlas;
+	// Size in pixels of one view and number of views around the Y axis
+	GLsizei cellSize;
+	GLsizei views;
+
+	// Constructor that allocates layers layers of views cells of cellSize by cellSize pixels
+	ImpostorAtlas(GLsizei cellSize, GLsizei views, GLsizei layers);
+	// Deletes the framebuffer and atlas unless Delete was already called, the context has to still be current
+	~ImpostorAtlas();
+	// An ImpostorAtlas owns its GL objects, so it can be moved but not copied
+	ImpostorAtlas(const ImpostorAtlas&) = delete;
+	ImpostorAtlas& operator=(const ImpostorAtlas&) = delete;
+	ImpostorAtlas(ImpostorAtlas&& other) noexcept;
+	ImpostorAtlas& operator=(ImpostorAtlas&& other) noexcept;
+
+	// Renders every view of a box into a layer, draw is called once per view with the viewport set to its cell
+	// and has to render the box with the given projection and view matrix. The framebuffer and viewport are restored after
+	bool Bake(GLsizei layer, const glm::vec3& min, const glm::vec3& max, const std::function<void(const glm::mat4& projection, const glm::mat4& view)>& draw);
+	// Rebuilds the mip chain, call once after baking every layer
+	void Finish();
+	// Writes the record of the billboard that shows a baked box
+	static GLfloat* WriteRecord(GLfloat* out, const glm::vec3& min, const glm::vec3& max, GLsizei layer);
+
+	// Deletes the framebuffer and atlas, does nothing if they were already deleted or moved from
+	void Delete();
+private:
+	GLuint framebuffer = 0;
+	GLuint depthBuffer = 0;
+};
+
+#endif
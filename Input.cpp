@@ -0,0 +1,131 @@
+#include"Input.h"
+
+// Checks if a key is held
+bool Input::Snapshot::Down(int key) const
+{
+	return key >= 0 && key < KEY_COUNT && keys[key];
+}
+
+// Checks if a key went down since the previous snapshot
+bool Input::Snapshot::Pressed(int key) const
+{
+	return key >= 0 && key < KEY_COUNT && pressed[key];
+}
+
+// Checks if a mouse button went down since the previous snapshot
+bool Input::Snapshot::Clicked(int button) const
+{
+	return button >= 0 && button < BUTTON_COUNT && clicked[button];
+}
+
+// Constructor that installs the callbacks on window
+Input::Input(GLFWwindow* window)
+{
+	Input::window = window;
+	if (!window)
+		return;
+	glfwSetWindowUserPointer(window, this);
+	glfwSetKeyCallback(window, keyCallback);
+	glfwSetMouseButtonCallback(window, buttonCallback);
+	glfwSetCursorPosCallback(window, cursorCallback);
+	glfwSetWindowFocusCallback(window, focusCallback);
+}
+
+// Removes the callbacks unless Delete was already called
+Input::~Input()
+{
+	Delete();
+}
+
+// The state since the previous snapshot
+Input::Snapshot Input::Take()
+{
+	Snapshot snapshot;
+	snapshot.keys = keys;
+	snapshot.buttons = buttons;
+	snapshot.pressed = pressed;
+	snapshot.clicked = clicked;
+	snapshot.cursor = glm::vec2(lastCursor);
+	snapshot.mouseDelta = glm::vec2(delta);
+	pressed.reset();
+	clicked.reset();
+	delta = glm::dvec2(0.0);
+	return snapshot;
+}
+
+// Whether the next snapshot would be empty
+bool Input::Idle() const
+{
+	return keys.none() && buttons.none() && pressed.none() && clicked.none() && delta == glm::dvec2(0.0);
+}
+
+// Captures or releases the cursor
+void Input::capture(bool enable)
+{
+	if (enable == captured)
+		return;
+	captured = enable;
+	// A disabled cursor is hidden and never stops at the window border, raw motion skips the pointer acceleration
+	glfwSetInputMode(window, GLFW_CURSOR, enable ? GLFW_CURSOR_DISABLED : GLFW_CURSOR_NORMAL);
+	if (glfwRawMouseMotionSupported())
+		glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, enable ? GLFW_TRUE : GLFW_FALSE);
+	// The first position after switching may jump, motion is counted from the next one
+	hasLastCursor = false;
+}
+
+void Input::keyCallback(GLFWwindow* window, int key, int /*scancode*/, int action, int /*mods*/)
+{
+	Input* input = (Input*)glfwGetWindowUserPointer(window);
+	if (key < 0 || key >= KEY_COUNT || action == GLFW_REPEAT)
+		return;
+	input->keys[key] = action == GLFW_PRESS;
+	if (action == GLFW_PRESS)
+		input->pressed[key] = true;
+}
+
+void Input::buttonCallback(GLFWwindow* window, int button, int action, int /*mods*/)
+{
+	Input* input = (Input*)glfwGetWindowUserPointer(window);
+	if (button < 0 || button >= BUTTON_COUNT)
+		return;
+	input->buttons[button] = action == GLFW_PRESS;
+	if (action == GLFW_PRESS)
+		input->clicked[button] = true;
+	if (button == input->lookButton)
+		input->capture(action == GLFW_PRESS);
+}
+
+void Input::cursorCallback(GLFWwindow* window, double x, double y)
+{
+	Input* input = (Input*)glfwGetWindowUserPointer(window);
+	glm::dvec2 cursor(x, y);
+	if (input->captured && input->hasLastCursor)
+		input->delta += cursor - input->lastCursor;
+	input->lastCursor = cursor;
+	input->hasLastCursor = true;
+}
+
+// Keys let go while another window had the focus never send a release, so everything counts as released
+void Input::focusCallback(GLFWwindow* window, int focused)
+{
+	Input* input = (Input*)glfwGetWindowUserPointer(window);
+	if (focused)
+		return;
+	input->keys.reset();
+	input->buttons.reset();
+	input->capture(false);
+}
+
+// Removes the callbacks and gives the cursor back
+void Input::Delete()
+{
+	if (!window)
+		return;
+	capture(false);
+	glfwSetKeyCallback(window, nullptr);
+	glfwSetMouseButtonCallback(window, nullptr);
+	glfwSetCursorPosCallback(window, nullptr);
+	glfwSetWindowFocusCallback(window, nullptr);
+	glfwSetWindowUserPointer(window, nullptr);
+	window = nullptr;
+}
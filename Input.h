@@ -0,0 +1,80 @@
+#ifndef INPUT_CLASS_H
+#define INPUT_CLASS_H
+
+#include<GLFW/glfw3.h>
+#include<glm/glm.hpp>
+#include<bitset>
+
+// Keeps the keyboard and mouse state up to date from GLFW callbacks, so reading it costs no call into GLFW
+// The callbacks run inside glfwPollEvents on the thread that polls, which has to be the one taking snapshots
+// Holding the look button captures the cursor once and sums its motion, raw and unaccelerated where supported,
+// until the button is released
+class Input
+{
+public:
+	static constexpr int KEY_COUNT = GLFW_KEY_LAST + 1;
+	static constexpr int BUTTON_COUNT = GLFW_MOUSE_BUTTON_LAST + 1;
+
+	// The input one simulation tick sees
+	struct Snapshot
+	{
+		// Keys and buttons held at the time of the snapshot
+		std::bitset<KEY_COUNT> keys;
+		std::bitset<BUTTON_COUNT> buttons;
+		// Keys that went down since the previous snapshot, even if they were let go again
+		std::bitset<KEY_COUNT> pressed;
+		// Buttons that went down since the previous snapshot, even if they were let go again
+		std::bitset<BUTTON_COUNT> clicked;
+		// Cursor position in window coordinates from the top left, where it was at the time of the snapshot
+		glm::vec2 cursor = glm::vec2(0.0f);
+		// Pixels the captured cursor moved since the previous snapshot, y grows downwards
+		glm::vec2 mouseDelta = glm::vec2(0.0f);
+
+		// Checks if a key is held
+		bool Down(int key) const;
+		// Checks if a key went down since the previous snapshot
+		bool Pressed(int key) const;
+		// Checks if a mouse button went down since the previous snapshot
+		bool Clicked(int button) const;
+	};
+
+	// Mouse button that captures the cursor for looking around
+	int lookButton = GLFW_MOUSE_BUTTON_LEFT;
+
+	// Constructor that installs the callbacks on window, which takes its user pointer
+	// Without a window, as in a headless run, every snapshot is empty
+	Input(GLFWwindow* window);
+	// Removes the callbacks unless Delete was already called
+	~Input();
+	// The callbacks point to the object, so it can not be copied
+	Input(const Input&) = delete;
+	Input& operator=(const Input&) = delete;
+
+	// The state since the previous snapshot, the mouse motion and the presses start over
+	Snapshot Take();
+	// Whether nothing is held and nothing happened since the last snapshot, so the next one would change nothing
+	bool Idle() const;
+
+	// Removes the callbacks and gives the cursor back, call before glfwTerminate
+	void Delete();
+private:
+	GLFWwindow* window;
+	std::bitset<KEY_COUNT> keys;
+	std::bitset<KEY_COUNT> pressed;
+	std::bitset<BUTTON_COUNT> buttons;
+	std::bitset<BUTTON_COUNT> clicked;
+	// Cursor position of the last motion event and the motion summed since the last snapshot
+	glm::dvec2 lastCursor = glm::dvec2(0.0);
+	bool hasLastCursor = false;
+	glm::dvec2 delta = glm::dvec2(0.0);
+	bool captured = false;
+
+	// Captures or releases the cursor, only when that changes
+	void capture(bool enable);
+	static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+	static void buttonCallback(GLFWwindow* window, int button, int action, int mods);
+	static void cursorCallback(GLFWwindow* window, double x, double y);
+	static void focusCallback(GLFWwindow* window, int focused);
+};
+
+#endif
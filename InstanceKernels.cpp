@@ -0,0 +1,196 @@
+#include"InstanceKernels.h"
+
+#include<glm/gtc/packing.hpp>
+#include<cstring>
+#include<utility>
+
+// The AVX2 kernel is built into every x64 build and picked when the processor runs it, the projects target plain x64
+#if defined(_M_X64) || defined(__x86_64__)
+#define INSTANCE_KERNELS_AVX2 1
+#include<immintrin.h>
+#ifdef _MSC_VER
+#include<intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define INSTANCE_KERNELS_NEON 1
+#include<arm_neon.h>
+#endif
+
+#if INSTANCE_KERNELS_AVX2
+static constexpr size_t BATCH_LANES = 8;
+#elif INSTANCE_KERNELS_NEON
+static constexpr size_t BATCH_LANES = 4;
+#else
+static constexpr size_t BATCH_LANES = 1;
+#endif
+
+#if INSTANCE_KERNELS_AVX2
+// MSVC compiles the intrinsics of any instruction set, GCC and Clang only in functions that target it
+#if defined(_MSC_VER) && !defined(__clang__)
+#define INSTANCE_KERNELS_TARGET_AVX2
+#else
+#define INSTANCE_KERNELS_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+
+// Checks if the processor has AVX2 and F16C and the OS keeps the 256 bit registers across thread switches
+static bool hasAvx2()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	const int avx = 1 << 28, osxsave = 1 << 27, f16c = 1 << 29;
+	if ((info[2] & (avx | osxsave | f16c)) != (avx | osxsave | f16c) || (_xgetbv(0) & 6) != 6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#endif
+}
+
+const size_t InstanceKernels::LANES = hasAvx2() ? BATCH_LANES : 1;
+#else
+const size_t InstanceKernels::LANES = BATCH_LANES;
+#endif
+
+// The values of a batch the records take as they are, the corner of the footprint the unit building starts at and the
+// scale and fade as half floats, one row per component so the vectors store them whole
+struct Batch
+{
+	float translation[3][BATCH_LANES];
+	uint16_t scale[3][BATCH_LANES];
+	uint16_t fade[BATCH_LANES];
+};
+
+// Converts instance i into lane of a batch, for the instances past the last whole batch
+static void convertOne(const InstanceKernels::Arrays& arrays, size_t i, size_t lane, Batch& batch)
+{
+	float width = arrays.width ? arrays.width[i] : arrays.size.x;
+	float height = arrays.height ? arrays.height[i] : arrays.size.y;
+	float depth = arrays.depth ? arrays.depth[i] : arrays.size.z;
+	if (arrays.turns && (arrays.turns[i] & 1))
+		std::swap(width, depth);
+	batch.translation[0][lane] = arrays.x[i] - 0.5f * width;
+	batch.translation[1][lane] = arrays.y ? arrays.y[i] : 0.0f;
+	batch.translation[2][lane] = arrays.z[i] - 0.5f * depth;
+	batch.scale[0][lane] = glm::packHalf1x16(width);
+	batch.scale[1][lane] = glm::packHalf1x16(height);
+	batch.scale[2][lane] = glm::packHalf1x16(depth);
+	batch.fade[lane] = glm::packHalf1x16(arrays.fade ? arrays.fade[i] : 0.0f);
+}
+
+#if INSTANCE_KERNELS_AVX2
+// Converts the eight instances from i into a batch
+INSTANCE_KERNELS_TARGET_AVX2 static void convertBatch(const InstanceKernels::Arrays& arrays, size_t i, Batch& batch)
+{
+	__m256 width = arrays.width ? _mm256_loadu_ps(arrays.width + i) : _mm256_set1_ps(arrays.size.x);
+	__m256 height = arrays.height ? _mm256_loadu_ps(arrays.height + i) : _mm256_set1_ps(arrays.size.y);
+	__m256 depth = arrays.depth ? _mm256_loadu_ps(arrays.depth + i) : _mm256_set1_ps(arrays.size.z);
+	if (arrays.turns)
+	{
+		// Eight turns widened to one per lane, the odd ones select the other size
+		const __m256i one = _mm256_set1_epi32(1);
+		__m256i turns = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(arrays.turns + i)));
+		__m256 odd = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(turns, one), one));
+		__m256 turnedWidth = _mm256_blendv_ps(width, depth, odd);
+		depth = _mm256_blendv_ps(depth, width, odd);
+		width = turnedWidth;
+	}
+	const __m256 half = _mm256_set1_ps(0.5f);
+	_mm256_storeu_ps(batch.translation[0], _mm256_sub_ps(_mm256_loadu_ps(arrays.x + i), _mm256_mul_ps(half, width)));
+	_mm256_storeu_ps(batch.translation[1], arrays.y ? _mm256_loadu_ps(arrays.y + i) : _mm256_setzero_ps());
+	_mm256_storeu_ps(batch.translation[2], _mm256_sub_ps(_mm256_loadu_ps(arrays.z + i), _mm256_mul_ps(half, depth)));
+	_mm_storeu_si128((__m128i*)batch.scale[0], _mm256_cvtps_ph(width, _MM_FROUND_TO_NEAREST_INT));
+	_mm_storeu_si128((__m128i*)batch.scale[1], _mm256_cvtps_ph(height, _MM_FROUND_TO_NEAREST_INT));
+	_mm_storeu_si128((__m128i*)batch.scale[2], _mm256_cvtps_ph(depth, _MM_FROUND_TO_NEAREST_INT));
+	__m256 fade = arrays.fade ? _mm256_loadu_ps(arrays.fade + i) : _mm256_setzero_ps();
+	_mm_storeu_si128((__m128i*)batch.fade, _mm256_cvtps_ph(fade, _MM_FROUND_TO_NEAREST_INT));
+}
+#elif INSTANCE_KERNELS_NEON
+// Converts the four instances from i into a batch
+static void convertBatch(const InstanceKernels::Arrays& arrays, size_t i, Batch& batch)
+{
+	float32x4_t width = arrays.width ? vld1q_f32(arrays.width + i) : vdupq_n_f32(arrays.size.x);
+	float32x4_t height = arrays.height ? vld1q_f32(arrays.height + i) : vdupq_n_f32(arrays.size.y);
+	float32x4_t depth = arrays.depth ? vld1q_f32(arrays.depth + i) : vdupq_n_f32(arrays.size.z);
+	if (arrays.turns)
+	{
+		const uint32_t turns[4] = { arrays.turns[i], arrays.turns[i + 1], arrays.turns[i + 2], arrays.turns[i + 3] };
+		uint32x4_t odd = vtstq_u32(vld1q_u32(turns), vdupq_n_u32(1));
+		float32x4_t turnedWidth = vbslq_f32(odd, depth, width);
+		depth = vbslq_f32(odd, width, depth);
+		width = turnedWidth;
+	}
+	vst1q_f32(batch.translation[0], vsubq_f32(vld1q_f32(arrays.x + i), vmulq_n_f32(width, 0.5f)));
+	vst1q_f32(batch.translation[1], arrays.y ? vld1q_f32(arrays.y + i) : vdupq_n_f32(0.0f));
+	vst1q_f32(batch.translation[2], vsubq_f32(vld1q_f32(arrays.z + i), vmulq_n_f32(depth, 0.5f)));
+	vst1_u16(batch.scale[0], vreinterpret_u16_f16(vcvt_f16_f32(width)));
+	vst1_u16(batch.scale[1], vreinterpret_u16_f16(vcvt_f16_f32(height)));
+	vst1_u16(batch.scale[2], vreinterpret_u16_f16(vcvt_f16_f32(depth)));
+	float32x4_t fade = arrays.fade ? vld1q_f32(arrays.fade + i) : vdupq_n_f32(0.0f);
+	vst1_u16(batch.fade, vreinterpret_u16_f16(vcvt_f16_f32(fade)));
+}
+#endif
+
+// Stores the records of count instances of a batch, the first of them instance first, each built whole on the stack
+static void store(const InstanceKernels::Arrays& arrays, const Batch& batch, size_t first, size_t count, CompactInstance* out)
+{
+	for (size_t lane = 0; lane < count; lane++)
+	{
+		size_t i = first + lane;
+		CompactInstance instance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			instance.translation[axis] = batch.translation[axis][lane];
+			instance.scale[axis] = batch.scale[axis][lane];
+		}
+		instance.fade = batch.fade[lane];
+		instance.layer = arrays.layer ? arrays.layer[i] : 0;
+		instance.occlusion = arrays.occlusion ? arrays.occlusion[i] : 0;
+		instance.padding = 0;
+		uint32_t color = arrays.colors ? arrays.colors[i] : arrays.color;
+		std::memcpy(instance.color, &color, sizeof(color));
+		out[lane] = instance;
+	}
+}
+
+// Whole batches first, then the rest one at a time
+void InstanceKernels::Pack(const Arrays& arrays, size_t begin, size_t end, CompactInstance* out)
+{
+	Batch batch;
+	size_t i = begin;
+#if INSTANCE_KERNELS_AVX2 || INSTANCE_KERNELS_NEON
+	// LANES is 1 on processors without AVX2
+	if (LANES == BATCH_LANES)
+		for (; i + BATCH_LANES <= end; i += BATCH_LANES)
+		{
+			convertBatch(arrays, i, batch);
+			store(arrays, batch, i, BATCH_LANES, out + (i - begin));
+		}
+#endif
+	for (; i < end; i++)
+	{
+		convertOne(arrays, i, 0, batch);
+		store(arrays, batch, i, 1, out + (i - begin));
+	}
+}
+
+// Slices of the instances side by side, each writes its own part of out
+void InstanceKernels::Pack(JobSystem& jobs, const Arrays& arrays, size_t count, CompactInstance* out)
+{
+	jobs.ParallelFor(count, GRAIN, [&](size_t, size_t begin, size_t end) {
+		Pack(arrays, begin, end, out + begin);
+	});
+}
+
+// Signed 8 bit fractions in the bytes of red, green and blue, the fourth byte stays 0
+uint32_t InstanceKernels::PackColor(const GLfloat* rgb)
+{
+	GLbyte bytes[4] = { (GLbyte)glm::packSnorm1x8(rgb[0]), (GLbyte)glm::packSnorm1x8(rgb[1]), (GLbyte)glm::packSnorm1x8(rgb[2]), 0 };
+	uint32_t color;
+	std::memcpy(&color, bytes, sizeof(color));
+	return color;
+}
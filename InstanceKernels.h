@@ -0,0 +1,59 @@
+#ifndef INSTANCE_KERNELS_CLASS_H
+#define INSTANCE_KERNELS_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+
+#include"CompactInstance.h"
+#include"JobSystem.h"
+
+// Batch kernels that turn instances kept as arrays of each of their values, like TrafficSimulation keeps its cars, into
+// CompactInstance records, written straight into a mapped stream buffer or an arena the render thread copies from.
+// The records scale the unit building into a box standing on its footprint, so an instance is the center of its
+// footprint, the height of its base, its size and a turn about the vertical in quarter turns, all the rotation a box
+// that stays aligned with the axes can have. LANES instances are worked out at once with AVX2 and F16C, which convert
+// the scales to half floats eight at a time, or with NEON, and one at a time without either. x64 builds carry the AVX2
+// kernel and pick it when the processor has it. The records are then stored whole, as the buffers they go into are
+// only ever written.
+class InstanceKernels
+{
+public:
+	// Instances at once, 8 with AVX2, 4 with NEON and 1 without either, known once the program has started
+	static const size_t LANES;
+	// Smallest number of instances a worker gets
+	static constexpr size_t GRAIN = 4096;
+
+	// The values of every instance, one array each, null where every instance has the same
+	struct Arrays
+	{
+		// Center of the footprint, x and z are needed, no y stands every instance on 0
+		const float* x = nullptr;
+		const float* y = nullptr;
+		const float* z = nullptr;
+		// Size along the x, y and z of the instance before it turns, without them every instance has size
+		const float* width = nullptr;
+		const float* height = nullptr;
+		const float* depth = nullptr;
+		glm::vec3 size = glm::vec3(1.0f);
+		// Quarter turns about the vertical, odd ones swap the width and the depth
+		const uint8_t* turns = nullptr;
+		// Texture layer, level of detail fade and baked ambient occlusion as an 8 bit fraction
+		const uint16_t* layer = nullptr;
+		const float* fade = nullptr;
+		const uint8_t* occlusion = nullptr;
+		// Colors as PackColor makes them, without them every instance has color
+		const uint32_t* colors = nullptr;
+		uint32_t color = 0;
+	};
+
+	// Writes the records of the instances from begin to end, the one of begin into out[0]
+	static void Pack(const Arrays& arrays, size_t begin, size_t end, CompactInstance* out);
+	// Writes the records of count instances into out, in slices of at least GRAIN on the job system's workers
+	static void Pack(JobSystem& jobs, const Arrays& arrays, size_t count, CompactInstance* out);
+	// Packs a color of three fractions from -1 to 1 the way CompactInstance holds it
+	static uint32_t PackColor(const GLfloat* rgb);
+};
+
+#endif
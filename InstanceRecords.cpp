@@ -0,0 +1,75 @@
+#include"InstanceRecords.h"
+
+#include<algorithm>
+
+// Constructor that reads the records from source until the first edit
+InstanceRecords::InstanceRecords(const GLfloat* source, size_t count, unsigned int floatsPerRecord)
+	: source(source), count(count), floatsPerRecord(floatsPerRecord)
+{
+}
+
+// Records of every instance
+const GLfloat* InstanceRecords::data() const
+{
+	return copy.empty() ? source : copy.data();
+}
+
+// Number of records
+size_t InstanceRecords::size() const
+{
+	return count;
+}
+
+// Copies the records on the first edit and marks the record dirty
+GLfloat* InstanceRecords::Edit(size_t index)
+{
+	if (copy.empty())
+	{
+		copy.assign(source, source + count * floatsPerRecord);
+		dirtyFlags.assign(count, 0);
+	}
+	if (!dirtyFlags[index])
+	{
+		dirtyFlags[index] = 1;
+		dirtyRecords.push_back((uint32_t)index);
+	}
+	return &copy[index * floatsPerRecord];
+}
+
+// Whether any record was edited since the last ClearDirty
+bool InstanceRecords::dirty() const
+{
+	return !dirtyRecords.empty();
+}
+
+// Sorts the dirty records and joins them into runs, a short gap costs less to upload than another call
+const std::vector<InstanceRecords::Range>& InstanceRecords::Coalesce(uint32_t mergeGap)
+{
+	ranges.clear();
+	std::sort(dirtyRecords.begin(), dirtyRecords.end());
+	for (uint32_t record : dirtyRecords)
+	{
+		if (!ranges.empty() && record - (ranges.back().first + ranges.back().count) <= mergeGap)
+			ranges.back().count = record - ranges.back().first + 1;
+		else
+			ranges.push_back({ record, 1 });
+	}
+	return ranges;
+}
+
+// Writes every range of the last Coalesce
+void InstanceRecords::Upload(VBO& buffer, GLintptr offset) const
+{
+	GLsizeiptr stride = (GLsizeiptr)(floatsPerRecord * sizeof(GLfloat));
+	for (const Range& range : ranges)
+		buffer.Update(&copy[(size_t)range.first * floatsPerRecord], range.count * stride, offset + range.first * stride);
+}
+
+// Forgets the dirty records
+void InstanceRecords::ClearDirty()
+{
+	for (uint32_t record : dirtyRecords)
+		dirtyFlags[record] = 0;
+	dirtyRecords.clear();
+	ranges.clear();
+}
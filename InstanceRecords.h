@@ -0,0 +1,54 @@
+#ifndef INSTANCE_RECORDS_CLASS_H
+#define INSTANCE_RECORDS_CLASS_H
+
+#include<glad/glad.h>
+#include<vector>
+#include<cstddef>
+#include<cstdint>
+
+#include"VBO.h"
+
+// The instance record of every building, with the records edited since the last upload marked dirty
+// Buffers that hold a copy of all records only get the dirty ones again: Coalesce sorts them into ranges, merging
+// ranges that only a few clean records keep apart, and Upload writes each range with one glBufferSubData. Records
+// start out read from the source, such as a scene file's mapping, and are only copied the first time one is edited.
+class InstanceRecords
+{
+public:
+	// Run of dirty records
+	struct Range
+	{
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// Constructor that reads count records of floatsPerRecord floats from source, which has to outlive it until an edit
+	InstanceRecords(const GLfloat* source, size_t count, unsigned int floatsPerRecord);
+
+	// Records of every instance, moves once the first record is edited
+	const GLfloat* data() const;
+	// Number of records
+	size_t size() const;
+	// Writable record of an instance, marked dirty until the next ClearDirty
+	GLfloat* Edit(size_t index);
+	// Whether any record was edited since the last ClearDirty
+	bool dirty() const;
+
+	// Sorts the dirty records into ranges, runs apart by at most mergeGap clean records become one upload
+	const std::vector<Range>& Coalesce(uint32_t mergeGap = 16);
+	// Writes the ranges of the last Coalesce into a buffer whose first record starts at offset
+	void Upload(VBO& buffer, GLintptr offset) const;
+	// Forgets the dirty records, once every buffer has them
+	void ClearDirty();
+private:
+	const GLfloat* source;
+	std::vector<GLfloat> copy;
+	size_t count;
+	unsigned int floatsPerRecord;
+	// Dirty records in the order they were edited, each once, and a flag for every record
+	std::vector<uint32_t> dirtyRecords;
+	std::vector<uint8_t> dirtyFlags;
+	std::vector<Range> ranges;
+};
+
+#endif
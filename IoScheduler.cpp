@@ -0,0 +1,746 @@
+#include"IoScheduler.h"
+
+#include<algorithm>
+#include<cerrno>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<memory>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define IO_SCHEDULER_URING
+#include<linux/io_uring.h>
+#include<sys/mman.h>
+#include<sys/syscall.h>
+#include<sys/uio.h>
+#endif
+#endif
+#endif
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+typedef HANDLE FileHandle;
+static const FileHandle NO_FILE = INVALID_HANDLE_VALUE;
+#else
+typedef int FileHandle;
+static const FileHandle NO_FILE = -1;
+#endif
+
+// Largest single read the OS is asked for, longer ranges are read in several
+static const uint64_t MAX_READ = 1u << 30;
+
+struct IoScheduler::Operation
+{
+	std::string path;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	// Bytes read into the buffer so far, which holds the range from offset
+	uint64_t done = 0;
+	std::vector<char> buffer;
+	std::vector<Request> requests;
+	FileHandle file = NO_FILE;
+};
+
+// Reads in flight of one thread through the OS's asynchronous interface, each known by a tag of the caller's
+class AsyncReads
+{
+public:
+	AsyncReads() = default;
+	// Closes the interface unless Close was already called
+	~AsyncReads()
+	{
+		Close();
+	}
+	// AsyncReads owns the queues the OS reads into, so it cannot be copied
+	AsyncReads(const AsyncReads&) = delete;
+	AsyncReads& operator=(const AsyncReads&) = delete;
+
+	// Sets up for depth reads in flight, false where the OS has no such interface or refuses it
+	bool Open(unsigned int depth);
+	// Opens a file for reads through the interface and gets its size, false if it is missing
+	bool OpenFile(const std::string& path, FileHandle& file, uint64_t& size);
+	static void CloseFile(FileHandle file);
+	// Starts reading size bytes at offset of a file into buffer, false if the read could not be started
+	bool Start(void* tag, FileHandle file, char* buffer, uint64_t size, uint64_t offset);
+	// Waits for at least one started read and adds every finished one with the bytes it read, negative if it failed
+	// False if the interface itself failed, the reads not added never finish then
+	bool Wait(std::vector<std::pair<void*, int64_t>>& finished);
+	// Tears the interface down, the reads in flight have to be finished
+	void Close();
+private:
+#ifdef _WIN32
+	// A read in flight, the OVERLAPPED first so the one a completion hands back is the read
+	struct Pending
+	{
+		OVERLAPPED overlapped;
+		void* tag;
+	};
+	HANDLE port = nullptr;
+#elif defined(IO_SCHEDULER_URING)
+	// A read in flight, its vector has to stay where it is until the kernel is done with it
+	struct Pending
+	{
+		iovec vector;
+		void* tag;
+	};
+	int ring = -1;
+	void* submissionRing = nullptr;
+	size_t submissionBytes = 0;
+	void* completionRing = nullptr;
+	size_t completionBytes = 0;
+	io_uring_sqe* entries = nullptr;
+	size_t entryBytes = 0;
+	unsigned* submissionTail = nullptr;
+	unsigned* submissionMask = nullptr;
+	unsigned* submissionArray = nullptr;
+	unsigned* completionHead = nullptr;
+	unsigned* completionTail = nullptr;
+	unsigned* completionMask = nullptr;
+	io_uring_cqe* completions = nullptr;
+	// Entries written since the kernel was last entered
+	unsigned unsubmitted = 0;
+#endif
+};
+
+#ifdef _WIN32
+
+// One completion port per thread, every file it reads is bound to it
+bool AsyncReads::Open(unsigned int depth)
+{
+	port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+	return port != nullptr;
+}
+
+bool AsyncReads::OpenFile(const std::string& path, FileHandle& file, uint64_t& size)
+{
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || !CreateIoCompletionPort(file, port, 0, 0))
+	{
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	size = (uint64_t)fileSize.QuadPart;
+	return true;
+}
+
+void AsyncReads::CloseFile(FileHandle file)
+{
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+// A read that completes at once still posts its completion to the port
+bool AsyncReads::Start(void* tag, FileHandle file, char* buffer, uint64_t size, uint64_t offset)
+{
+	Pending* pending = new Pending{};
+	pending->tag = tag;
+	pending->overlapped.Offset = (DWORD)offset;
+	pending->overlapped.OffsetHigh = (DWORD)(offset >> 32);
+	if (!ReadFile(file, buffer, (DWORD)std::min(size, MAX_READ), nullptr, &pending->overlapped) && GetLastError() != ERROR_IO_PENDING)
+	{
+		delete pending;
+		return false;
+	}
+	return true;
+}
+
+// Blocks for the first completion and takes whatever else finished meanwhile
+bool AsyncReads::Wait(std::vector<std::pair<void*, int64_t>>& finished)
+{
+	for (DWORD timeout = INFINITE;; timeout = 0)
+	{
+		DWORD bytes = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED* overlapped = nullptr;
+		BOOL ok = GetQueuedCompletionStatus(port, &bytes, &key, &overlapped, timeout);
+		if (!overlapped)
+			return timeout == 0;
+		Pending* pending = (Pending*)overlapped;
+		finished.push_back({ pending->tag, ok ? (int64_t)bytes : GetLastError() == ERROR_HANDLE_EOF ? 0 : -1 });
+		delete pending;
+	}
+}
+
+void AsyncReads::Close()
+{
+	if (port)
+		CloseHandle(port);
+	port = nullptr;
+}
+
+#elif defined(IO_SCHEDULER_URING)
+
+// Sets up a ring of depth entries and maps its queues, liburing is not needed for the few calls made here
+bool AsyncReads::Open(unsigned int depth)
+{
+	io_uring_params parameters;
+	std::memset(&parameters, 0, sizeof(parameters));
+	ring = (int)syscall(__NR_io_uring_setup, depth, &parameters);
+	if (ring < 0)
+		return false;
+	submissionBytes = parameters.sq_off.array + parameters.sq_entries * sizeof(unsigned);
+	completionBytes = parameters.cq_off.cqes + parameters.cq_entries * sizeof(io_uring_cqe);
+	bool single = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+	single = (parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+#endif
+	if (single)
+		submissionBytes = completionBytes = std::max(submissionBytes, completionBytes);
+	submissionRing = mmap(nullptr, submissionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+	if (submissionRing == MAP_FAILED)
+	{
+		submissionRing = nullptr;
+		Close();
+		return false;
+	}
+	completionRing = single ? submissionRing : mmap(nullptr, completionBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+	entryBytes = parameters.sq_entries * sizeof(io_uring_sqe);
+	void* mappedEntries = mmap(nullptr, entryBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+	entries = mappedEntries == MAP_FAILED ? nullptr : (io_uring_sqe*)mappedEntries;
+	if (completionRing == MAP_FAILED || !entries)
+	{
+		if (completionRing == MAP_FAILED)
+			completionRing = nullptr;
+		Close();
+		return false;
+	}
+	char* submission = (char*)submissionRing;
+	char* completion = (char*)completionRing;
+	submissionTail = (unsigned*)(submission + parameters.sq_off.tail);
+	submissionMask = (unsigned*)(submission + parameters.sq_off.ring_mask);
+	submissionArray = (unsigned*)(submission + parameters.sq_off.array);
+	completionHead = (unsigned*)(completion + parameters.cq_off.head);
+	completionTail = (unsigned*)(completion + parameters.cq_off.tail);
+	completionMask = (unsigned*)(completion + parameters.cq_off.ring_mask);
+	completions = (io_uring_cqe*)(completion + parameters.cq_off.cqes);
+	return true;
+}
+
+bool AsyncReads::OpenFile(const std::string& path, FileHandle& file, uint64_t& size)
+{
+	file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) != 0)
+	{
+		close(file);
+		file = -1;
+		return false;
+	}
+	size = (uint64_t)status.st_size;
+	return true;
+}
+
+void AsyncReads::CloseFile(FileHandle file)
+{
+	if (file >= 0)
+		close(file);
+}
+
+// Only writes the entry, Wait hands every entry written since to the kernel in one call
+// READV rather than READ, it is there since the first kernels with io_uring
+bool AsyncReads::Start(void* tag, FileHandle file, char* buffer, uint64_t size, uint64_t offset)
+{
+	Pending* pending = new Pending{};
+	pending->tag = tag;
+	pending->vector.iov_base = buffer;
+	pending->vector.iov_len = (size_t)std::min(size, MAX_READ);
+	unsigned tail = *submissionTail;
+	unsigned index = tail & *submissionMask;
+	io_uring_sqe& entry = entries[index];
+	std::memset(&entry, 0, sizeof(entry));
+	entry.opcode = IORING_OP_READV;
+	entry.fd = file;
+	entry.addr = (uint64_t)(uintptr_t)&pending->vector;
+	entry.len = 1;
+	entry.off = offset;
+	entry.user_data = (uint64_t)(uintptr_t)pending;
+	submissionArray[index] = index;
+	__atomic_store_n(submissionTail, tail + 1, __ATOMIC_RELEASE);
+	unsubmitted++;
+	return true;
+}
+
+// Submits what Start wrote and blocks until at least one read completed, then takes every completion there is
+bool AsyncReads::Wait(std::vector<std::pair<void*, int64_t>>& finished)
+{
+	for (;;)
+	{
+		int entered = (int)syscall(__NR_io_uring_enter, ring, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+		if (entered >= 0)
+		{
+			unsubmitted -= std::min((unsigned)entered, unsubmitted);
+			break;
+		}
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+			return false;
+	}
+	unsigned head = *completionHead;
+	unsigned tail = __atomic_load_n(completionTail, __ATOMIC_ACQUIRE);
+	for (; head != tail; head++)
+	{
+		const io_uring_cqe& completion = completions[head & *completionMask];
+		Pending* pending = (Pending*)(uintptr_t)completion.user_data;
+		finished.push_back({ pending->tag, (int64_t)completion.res });
+		delete pending;
+	}
+	__atomic_store_n(completionHead, head, __ATOMIC_RELEASE);
+	return true;
+}
+
+void AsyncReads::Close()
+{
+	if (entries)
+		munmap(entries, entryBytes);
+	if (completionRing && completionRing != submissionRing)
+		munmap(completionRing, completionBytes);
+	if (submissionRing)
+		munmap(submissionRing, submissionBytes);
+	if (ring >= 0)
+		close(ring);
+	entries = nullptr;
+	completionRing = nullptr;
+	submissionRing = nullptr;
+	ring = -1;
+}
+
+#else
+
+// Without an asynchronous interface the threads read with blocking calls
+bool AsyncReads::Open(unsigned int depth)
+{
+	return false;
+}
+
+bool AsyncReads::OpenFile(const std::string& path, FileHandle& file, uint64_t& size)
+{
+	return false;
+}
+
+void AsyncReads::CloseFile(FileHandle file)
+{
+}
+
+bool AsyncReads::Start(void* tag, FileHandle file, char* buffer, uint64_t size, uint64_t offset)
+{
+	return false;
+}
+
+bool AsyncReads::Wait(std::vector<std::pair<void*, int64_t>>& finished)
+{
+	return false;
+}
+
+void AsyncReads::Close()
+{
+}
+
+#endif
+
+// Reads the range of an operation with blocking calls, for threads without the asynchronous interface
+// The range is cut at the end of the file, complete fails the requests that reach past it
+static bool readBlocking(const std::string& path, uint64_t& offset, uint64_t& size, bool toEnd, std::vector<char>& buffer)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return false;
+	uint64_t fileSize = (uint64_t)file.tellg();
+	if (fileSize < offset)
+		return false;
+	size = toEnd ? fileSize - offset : std::min(size, fileSize - offset);
+	buffer.resize((size_t)size);
+	file.seekg((std::streamoff)offset);
+	file.read(buffer.data(), (std::streamsize)size);
+	return (bool)file;
+}
+
+// Constructor that starts the threads, what the OS offers is tried once here to report it
+IoScheduler::IoScheduler(unsigned int threads, unsigned int depth)
+	: depth(std::max(depth, 1u))
+{
+	{
+		AsyncReads probe;
+#ifdef _WIN32
+		if (probe.Open(IoScheduler::depth))
+			backendName = "overlapped";
+#else
+		if (probe.Open(IoScheduler::depth))
+			backendName = "io_uring";
+#endif
+	}
+	for (unsigned int i = 0; i < std::max(threads, 1u); i++)
+		IoScheduler::threads.emplace_back(&IoScheduler::run, this);
+}
+
+// Stops the threads unless Delete was already called
+IoScheduler::~IoScheduler()
+{
+	Delete();
+}
+
+// Queues a read
+uint64_t IoScheduler::Read(const std::string& path, uint64_t offset, uint64_t size, Priority priority, double order, ReadCallback callback)
+{
+	uint64_t ticket;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping)
+			return 0;
+		ticket = nextTicket++;
+		queue.push_back({ ticket, false, path, offset, size, priority, order, std::move(callback), nullptr, {} });
+		active++;
+	}
+	wake.notify_one();
+	return ticket;
+}
+
+// Queues a write
+uint64_t IoScheduler::Write(const std::string& path, std::vector<char> data, Priority priority, WriteCallback done)
+{
+	uint64_t ticket;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping)
+			return 0;
+		ticket = nextTicket++;
+		queue.push_back({ ticket, true, path, 0, (uint64_t)data.size(), priority, 0.0, nullptr, std::move(done), std::move(data) });
+		active++;
+	}
+	wake.notify_one();
+	return ticket;
+}
+
+// Changes the class and order of a queued request
+bool IoScheduler::Reprioritize(uint64_t ticket, Priority priority, double order)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Request& request : queue)
+	{
+		if (request.ticket != ticket)
+			continue;
+		request.priority = priority;
+		request.order = order;
+		return true;
+	}
+	return false;
+}
+
+// Drops a queued request, or marks a started one so its callback is skipped
+bool IoScheduler::Cancel(uint64_t ticket)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto it = queue.begin(); it != queue.end(); ++it)
+	{
+		if (it->ticket != ticket)
+			continue;
+		queue.erase(it);
+		active--;
+		idle.notify_all();
+		return true;
+	}
+	auto found = started.find(ticket);
+	if (found == started.end())
+		return false;
+	found->second = true;
+	return true;
+}
+
+// Waits until nothing is queued or in flight
+void IoScheduler::Flush()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [&] { return active == 0; });
+}
+
+size_t IoScheduler::pending()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return active;
+}
+
+uint64_t IoScheduler::coalesced() const
+{
+	return coalescedCount;
+}
+
+uint64_t IoScheduler::bytesRead() const
+{
+	return readBytes;
+}
+
+const char* IoScheduler::backend() const
+{
+	return backendName;
+}
+
+// Takes the request of the lowest class and order, and merges the reads of the same file around it
+bool IoScheduler::take(Operation& operation, Request& write)
+{
+	size_t best = 0;
+	for (size_t i = 1; i < queue.size(); i++)
+		if (queue[i].priority < queue[best].priority || (queue[i].priority == queue[best].priority && queue[i].order < queue[best].order))
+			best = i;
+	Request request = std::move(queue[best]);
+	queue.erase(queue.begin() + best);
+	started[request.ticket] = false;
+	if (request.write)
+	{
+		write = std::move(request);
+		return false;
+	}
+	operation.path = request.path;
+	operation.offset = request.offset;
+	operation.size = request.size;
+	operation.requests.push_back(std::move(request));
+	// A read to the end of the file has no end to merge at before the file is open
+	if (operation.size == 0)
+		return true;
+	// Merging a read of a later class pulls it forward, which costs nothing since the disk reads the bytes anyway
+	for (bool merged = true; merged;)
+	{
+		merged = false;
+		for (size_t i = 0; i < queue.size(); i++)
+		{
+			const Request& other = queue[i];
+			if (other.write || other.size == 0 || other.path != operation.path)
+				continue;
+			uint64_t first = std::min(operation.offset, other.offset);
+			uint64_t last = std::max(operation.offset + operation.size, other.offset + other.size);
+			if (other.offset > operation.offset + operation.size + COALESCE_GAP || other.offset + other.size + COALESCE_GAP < operation.offset
+				|| last - first > MAX_COALESCED)
+				continue;
+			operation.offset = first;
+			operation.size = last - first;
+			started[other.ticket] = false;
+			operation.requests.push_back(std::move(queue[i]));
+			queue.erase(queue.begin() + i);
+			coalescedCount++;
+			merged = true;
+			break;
+		}
+	}
+	return true;
+}
+
+// Forgets a started request, a canceled one's callback is skipped
+bool IoScheduler::finish(uint64_t ticket)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto found = started.find(ticket);
+	bool wanted = found != started.end() && !found->second;
+	if (found != started.end())
+		started.erase(found);
+	return wanted;
+}
+
+// Cuts the range of every request out of the operation's buffer, the only request of a read takes the buffer itself
+// The operation's range was cut at the end of the file, so only the requests reaching past it fail
+void IoScheduler::complete(Operation& operation, bool ok)
+{
+	if (ok)
+		readBytes += operation.size;
+	for (Request& request : operation.requests)
+	{
+		std::vector<char> bytes;
+		uint64_t start = request.offset - operation.offset;
+		uint64_t size = request.size != 0 ? request.size : operation.size;
+		bool read = ok && start + size <= operation.size;
+		if (read)
+		{
+			if (operation.requests.size() == 1 && start == 0)
+				bytes = std::move(operation.buffer);
+			else
+				bytes.assign(operation.buffer.begin() + (ptrdiff_t)start, operation.buffer.begin() + (ptrdiff_t)(start + size));
+		}
+		// The request counts as active until its callback returned, so Flush also waits for the callbacks
+		if (finish(request.ticket) && request.read)
+			request.read(read, std::move(bytes));
+		std::lock_guard<std::mutex> lock(mutex);
+		active--;
+	}
+	idle.notify_all();
+}
+
+void IoScheduler::complete(Request& write, bool ok)
+{
+	if (finish(write.ticket) && write.written)
+		write.written(ok);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		active--;
+	}
+	idle.notify_all();
+}
+
+// Writes under a temporary name first so a crash never leaves half a file under the real one
+bool IoScheduler::writeFile(const std::string& path, const std::vector<char>& data)
+{
+	std::error_code error;
+	fs::path target(path);
+	if (target.has_parent_path())
+		fs::create_directories(target.parent_path(), error);
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		file.write(data.data(), (std::streamsize)data.size());
+		if (!file)
+			return false;
+	}
+	fs::rename(temporary, path, error);
+	if (error)
+	{
+		fs::remove(path, error);
+		fs::rename(temporary, path, error);
+	}
+	if (error)
+		fs::remove(temporary, error);
+	return !error;
+}
+
+// Keeps the queue depth filled with the best requests and completes reads as the OS finishes them
+void IoScheduler::run()
+{
+	AsyncReads reads;
+	bool asynchronous = reads.Open(depth);
+	std::vector<std::unique_ptr<Operation>> inFlight;
+	std::vector<std::pair<void*, int64_t>> finished;
+	for (;;)
+	{
+		std::vector<std::unique_ptr<Operation>> starting;
+		Request write;
+		bool writing = false;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (inFlight.empty())
+				wake.wait(lock, [&] { return stopping || !queue.empty(); });
+			if (stopping && queue.empty() && inFlight.empty())
+				break;
+			// Without the asynchronous interface a thread reads one range at a time
+			size_t room = asynchronous ? depth : 1;
+			while (!queue.empty() && !writing && inFlight.size() + starting.size() < room)
+			{
+				std::unique_ptr<Operation> operation = std::make_unique<Operation>();
+				if (take(*operation, write))
+					starting.push_back(std::move(operation));
+				else
+					writing = true;
+			}
+		}
+
+		for (std::unique_ptr<Operation>& operation : starting)
+		{
+			bool toEnd = operation->size == 0;
+			if (!asynchronous)
+			{
+				complete(*operation, readBlocking(operation->path, operation->offset, operation->size, toEnd, operation->buffer));
+				continue;
+			}
+			uint64_t fileSize = 0;
+			bool opened = reads.OpenFile(operation->path, operation->file, fileSize);
+			if (!opened || fileSize < operation->offset)
+			{
+				AsyncReads::CloseFile(operation->file);
+				complete(*operation, false);
+				continue;
+			}
+			// A merged read is cut at the end of the file instead of failing the requests that fit before it
+			operation->size = toEnd ? fileSize - operation->offset : std::min(operation->size, fileSize - operation->offset);
+			operation->buffer.resize((size_t)operation->size);
+			if (operation->size == 0)
+			{
+				AsyncReads::CloseFile(operation->file);
+				complete(*operation, true);
+				continue;
+			}
+			if (!reads.Start(operation.get(), operation->file, operation->buffer.data(), operation->size, operation->offset))
+			{
+				AsyncReads::CloseFile(operation->file);
+				complete(*operation, false);
+				continue;
+			}
+			inFlight.push_back(std::move(operation));
+		}
+		if (writing)
+			complete(write, writeFile(write.path, write.data));
+
+		if (inFlight.empty())
+			continue;
+		finished.clear();
+		if (!reads.Wait(finished))
+		{
+			// The interface broke down, what it did not finish fails and the thread reads with blocking calls from now on
+			for (std::unique_ptr<Operation>& operation : inFlight)
+			{
+				AsyncReads::CloseFile(operation->file);
+				complete(*operation, false);
+			}
+			inFlight.clear();
+			asynchronous = false;
+			continue;
+		}
+		for (const std::pair<void*, int64_t>& result : finished)
+		{
+			auto found = std::find_if(inFlight.begin(), inFlight.end(), [&](const std::unique_ptr<Operation>& operation) { return operation.get() == result.first; });
+			if (found == inFlight.end())
+				continue;
+			Operation& operation = **found;
+			// A read may stop short of its range, the rest is asked for again until the file runs out
+			bool failed = result.second <= 0;
+			if (!failed)
+				operation.done += (uint64_t)result.second;
+			if (!failed && operation.done < operation.size)
+			{
+				failed = !reads.Start(&operation, operation.file, operation.buffer.data() + operation.done, operation.size - operation.done,
+					operation.offset + operation.done);
+				if (!failed)
+					continue;
+			}
+			AsyncReads::CloseFile(operation.file);
+			complete(operation, !failed);
+			inFlight.erase(found);
+		}
+	}
+	reads.Close();
+}
+
+// Drops the queued reads, the threads finish the writes and the reads in flight before they stop
+void IoScheduler::Delete()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopped)
+			return;
+		stopped = true;
+		stopping = true;
+		for (auto it = queue.begin(); it != queue.end();)
+		{
+			if (it->write)
+			{
+				++it;
+				continue;
+			}
+			it = queue.erase(it);
+			active--;
+		}
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+	idle.notify_all();
+}
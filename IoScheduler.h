@@ -0,0 +1,130 @@
+#ifndef IO_SCHEDULER_CLASS_H
+#define IO_SCHEDULER_CLASS_H
+
+#include<atomic>
+#include<condition_variable>
+#include<cstddef>
+#include<cstdint>
+#include<functional>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<unordered_map>
+#include<vector>
+
+// Reads and writes of the streaming systems, run by a few threads of its own in the order of what the frame needs most
+// Every request has a priority class and an order inside it, lower first, which the caller may change while it waits,
+// such as every frame as the camera moves, and a request nobody needs any more is canceled before it reaches the disk.
+// Queued reads of the same file whose ranges touch, or are only a little apart, are merged into one read and split
+// again when it completes. Each thread keeps up to a queue depth of reads in flight through the OS's asynchronous
+// interface, io_uring on Linux and overlapped reads on a completion port on Windows, so a couple of threads keep an
+// NVMe drive busy. Where that interface is missing or refused, such as io_uring in a sandbox, the threads read with
+// plain blocking calls instead. Writes are whole files, written under a temporary name and renamed like ContentCache's,
+// and only ever started when no read of a higher class is waiting.
+// Callbacks run on the I/O threads, so they should only hand the bytes on, such as to a job of the JobSystem.
+class IoScheduler
+{
+public:
+	// Classes of requests, every queued request of a class goes before any of the next
+	enum Priority
+	{
+		// What the frame on screen is missing right now
+		URGENT,
+		// What the view needs soon, such as finer levels of what is already shown
+		NORMAL,
+		// What the view may need later, such as tiles ahead of the camera
+		PREFETCH,
+		// What nobody waits for, such as writes to a cache
+		BACKGROUND,
+		PRIORITIES
+	};
+	// Gets whether a read succeeded and the bytes read, a missing file, or one that ends before the range does, fails
+	typedef std::function<void(bool ok, std::vector<char> bytes)> ReadCallback;
+	// Gets whether a write succeeded
+	typedef std::function<void(bool ok)> WriteCallback;
+
+	// Reads of a file at most this far apart are merged, the bytes in between are read and thrown away
+	static constexpr uint64_t COALESCE_GAP = 64 * 1024;
+	// Largest read merging makes
+	static constexpr uint64_t MAX_COALESCED = 8 * 1024 * 1024;
+
+	// Constructor that starts threads I/O threads with up to depth reads in flight each
+	IoScheduler(unsigned int threads = 2, unsigned int depth = 32);
+	// Drops the queued reads, finishes the queued writes and stops the threads unless Delete was already called
+	~IoScheduler();
+	// The threads point back at the scheduler, so it can be neither copied nor moved
+	IoScheduler(const IoScheduler&) = delete;
+	IoScheduler& operator=(const IoScheduler&) = delete;
+
+	// Queues a read of size bytes at offset of path, 0 bytes reads to the end of the file. Returns the ticket to cancel
+	// or reorder it with, 0 once the scheduler was deleted and nothing is queued. Every call is safe from any thread
+	uint64_t Read(const std::string& path, uint64_t offset, uint64_t size, Priority priority, double order, ReadCallback callback);
+	// Queues a write of the whole file at path, done is called when it is on disk and may be null
+	uint64_t Write(const std::string& path, std::vector<char> data, Priority priority = BACKGROUND, WriteCallback done = nullptr);
+	// Moves a queued request to another class and order, false if it already started
+	bool Reprioritize(uint64_t ticket, Priority priority, double order);
+	// Makes sure the callback of a request is not called, false if it is already running or done
+	// A queued request never reaches the disk, a read in flight completes but its bytes are dropped
+	bool Cancel(uint64_t ticket);
+	// Waits until every queued request has completed
+	void Flush();
+
+	// Requests queued or in flight
+	size_t pending();
+	// Reads that were merged into the read of another one, and bytes read so far
+	uint64_t coalesced() const;
+	uint64_t bytesRead() const;
+	// Interface the threads read through, "io_uring", "overlapped" or "blocking"
+	const char* backend() const;
+
+	// Drops the queued reads, finishes the queued writes and stops the threads, does nothing if that was already done
+	void Delete();
+private:
+	// A read or write waiting for a thread
+	struct Request
+	{
+		uint64_t ticket;
+		bool write;
+		std::string path;
+		uint64_t offset;
+		uint64_t size;
+		Priority priority;
+		double order;
+		ReadCallback read;
+		WriteCallback written;
+		std::vector<char> data;
+	};
+	// One read of a thread, the requests merged into it and the bytes read so far, and what the OS needs of it
+	struct Operation;
+
+	unsigned int depth;
+	const char* backendName = "blocking";
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	std::vector<Request> queue;
+	// Requests a thread took, by ticket, and whether they were canceled since
+	std::unordered_map<uint64_t, bool> started;
+	uint64_t nextTicket = 1;
+	size_t active = 0;
+	std::atomic<uint64_t> coalescedCount{ 0 };
+	std::atomic<uint64_t> readBytes{ 0 };
+	bool stopping = false;
+	bool stopped = false;
+	std::vector<std::thread> threads;
+
+	// Loop of a thread, starts the best requests while it has room in flight and completes the reads that finished
+	void run();
+	// Takes the best queued request and, for a read, every queued read of the same file it can be merged with, the
+	// mutex has to be held. Returns false when the best is a write, which goes into write instead
+	bool take(Operation& operation, Request& write);
+	// Hands the bytes of a finished read to the callbacks of its requests, and the result of a write to its callback
+	void complete(Operation& operation, bool ok);
+	void complete(Request& write, bool ok);
+	// Marks a started request done, true if its callback is still wanted
+	bool finish(uint64_t ticket);
+	// Writes a file under a temporary name and renames it
+	static bool writeFile(const std::string& path, const std::vector<char>& data);
+};
+
+#endif
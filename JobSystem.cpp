@@ -0,0 +1,323 @@
+#include"JobSystem.h"
+#include"TraceRecorder.h"
+
+#include<algorithm>
+#include<new>
+
+// Worker the calling thread is, for the pool it belongs to, workers of no pool have none
+static thread_local const JobSystem* currentPool = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+// Checks if every job counted has finished
+bool JobSystem::Counter::Done() const
+{
+	return value.load() == 0;
+}
+
+// Constructor that starts the worker threads
+JobSystem::JobSystem(unsigned int threads)
+{
+	for (unsigned int i = 0; i < threads; i++)
+		queues.push_back(std::make_unique<JobQueue>());
+	for (unsigned int i = 0; i < threads; i++)
+		workers.emplace_back(&JobSystem::work, this, i);
+}
+
+// Stops the workers unless Delete was already called
+JobSystem::~JobSystem()
+{
+	Delete();
+}
+
+// One less than the number of cores, at least one
+unsigned int JobSystem::DefaultThreads()
+{
+	unsigned int cores = std::thread::hardware_concurrency();
+	return cores > 1 ? cores - 1 : 1;
+}
+
+// Number of slices count items are split into
+size_t JobSystem::Slices(size_t count, size_t grain) const
+{
+	if (count == 0)
+		return 0;
+	size_t bySize = std::max<size_t>(1, count / std::max<size_t>(grain, 1));
+	return std::min(bySize, workers.size() + 1);
+}
+
+// First item of a slice
+size_t JobSystem::SliceStart(size_t count, size_t slices, size_t slice)
+{
+	return count * slice / slices;
+}
+
+// Runs function over the slices and waits for all of them
+void JobSystem::parallelFor(size_t count, size_t grain, const void* function, SliceCall call)
+{
+	size_t slices = Slices(count, grain);
+	if (slices <= 1)
+	{
+		if (count > 0)
+			call(function, 0, 0, count);
+		return;
+	}
+
+	// Workers that get to a helper after every slice was claimed find nothing to do, the loop stays alive for them
+	Loop* loop;
+	{
+		std::lock_guard<std::mutex> lock(loopMutex);
+		loop = new (loops.Allocate()) Loop();
+	}
+	loop->function = function;
+	loop->call = call;
+	loop->count = count;
+	loop->slices = slices;
+	loop->references = slices;
+	for (size_t i = 1; i < slices; i++)
+	{
+		// Two pointers fit into std::function without allocating
+		Job helper;
+		helper.function = [this, loop]() { runSlices(*loop); release(loop); };
+		push(std::move(helper), true);
+	}
+	runSlices(*loop);
+	{
+		std::unique_lock<std::mutex> lock(loop->mutex);
+		loop->finished.wait(lock, [loop, slices] { return loop->done.load() == slices; });
+	}
+	release(loop);
+}
+
+// Lets go of a loop
+void JobSystem::release(Loop* loop)
+{
+	if (loop->references.fetch_sub(1) != 1)
+		return;
+	loop->~Loop();
+	std::lock_guard<std::mutex> lock(loopMutex);
+	loops.Free(loop);
+}
+
+// Queues a job
+void JobSystem::Submit(Function function, Counter* counter)
+{
+	if (counter)
+		counter->value++;
+	Job job;
+	job.function = std::move(function);
+	job.counter = counter;
+	push(std::move(job), false);
+}
+
+// Queues a job that only starts once dependency is done
+void JobSystem::SubmitAfter(Counter& dependency, Function function, Counter* counter)
+{
+	if (counter)
+		counter->value++;
+	{
+		// The last job of the dependency counts down under this lock
+		std::lock_guard<std::mutex> lock(dependency.mutex);
+		if (dependency.value.load() > 0)
+		{
+			dependency.waiting.push_back({ std::move(function), counter });
+			return;
+		}
+	}
+	Job job;
+	job.function = std::move(function);
+	job.counter = counter;
+	push(std::move(job), false);
+}
+
+// Blocks until counter is done, running queued jobs meanwhile
+void JobSystem::Wait(Counter& counter)
+{
+	while (!counter.Done())
+	{
+		Job job;
+		if (take(job))
+			run(job);
+		else
+			std::this_thread::yield();
+	}
+	// The job that finished the counter may still hold its lock
+	std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+// Puts a job into a queue
+void JobSystem::push(Job job, bool isUrgent)
+{
+	// Without workers the thread that submits a job runs it
+	if (!isUrgent && queues.empty())
+	{
+		run(job);
+		return;
+	}
+	JobQueue* queue = &urgent;
+	if (!isUrgent)
+		queue = queues[currentPool == this ? currentWorker : nextQueue++ % queues.size()].get();
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queuedJobs++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->PushBack(std::move(job));
+	}
+	queuedChanged.notify_one();
+}
+
+// Adds a job at the back of the ring
+void JobSystem::JobQueue::PushBack(Job job)
+{
+	if (count == ring.size())
+	{
+		// The jobs move over in order, starting at the front
+		std::vector<Job> grown(std::max<size_t>(ring.size() * 2, 16));
+		for (size_t i = 0; i < count; i++)
+			grown[i] = std::move(ring[(first + i) % ring.size()]);
+		ring.swap(grown);
+		first = 0;
+	}
+	ring[(first + count) % ring.size()] = std::move(job);
+	count++;
+}
+
+// Takes the oldest job of the ring
+bool JobSystem::JobQueue::PopFront(Job& job)
+{
+	if (count == 0)
+		return false;
+	job = std::move(ring[first]);
+	first = (first + 1) % ring.size();
+	count--;
+	return true;
+}
+
+// Takes the newest job of the ring
+bool JobSystem::JobQueue::PopBack(Job& job)
+{
+	if (count == 0)
+		return false;
+	job = std::move(ring[(first + count - 1) % ring.size()]);
+	count--;
+	return true;
+}
+
+// Takes a job
+bool JobSystem::take(Job& job)
+{
+	bool found = false;
+	{
+		std::lock_guard<std::mutex> lock(urgent.mutex);
+		found = urgent.PopFront(job);
+	}
+	size_t first = currentPool == this ? currentWorker : 0;
+	if (!found && currentPool == this)
+	{
+		JobQueue& own = *queues[first];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		found = own.PopBack(job);
+	}
+	for (size_t i = 0; !found && i < queues.size(); i++)
+	{
+		JobQueue& other = *queues[(first + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		found = other.PopFront(job);
+	}
+	if (found)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queuedJobs--;
+	}
+	return found;
+}
+
+// Runs a job and finishes its counter
+void JobSystem::run(Job& job)
+{
+	job.function();
+	Counter* counter = job.counter;
+	if (!counter)
+		return;
+	// The lock is the last thing done with the counter, Wait takes it too before the counter may be destroyed
+	std::vector<std::pair<Function, Counter*>> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->value.fetch_sub(1) != 1)
+			return;
+		// The jobs held back by the counter can start now
+		released.swap(counter->waiting);
+	}
+	for (std::pair<Function, Counter*>& waiting : released)
+	{
+		Job next;
+		next.function = std::move(waiting.first);
+		next.counter = waiting.second;
+		push(std::move(next), false);
+	}
+}
+
+// Loop run by every worker thread
+void JobSystem::work(unsigned int index)
+{
+	currentPool = this;
+	currentWorker = index;
+	Tracer.NameThread("worker " + std::to_string(index));
+	for (;;)
+	{
+		Job job;
+		if (take(job))
+		{
+			run(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		queuedChanged.wait(lock, [this] { return stopping || queuedJobs > 0; });
+		if (stopping && queuedJobs == 0)
+			return;
+	}
+}
+
+// Claims and runs slices of a loop until none are left
+void JobSystem::runSlices(Loop& loop)
+{
+	for (;;)
+	{
+		size_t slice = loop.next.fetch_add(1);
+		if (slice >= loop.slices)
+			return;
+		loop.call(loop.function, slice, SliceStart(loop.count, loop.slices, slice), SliceStart(loop.count, loop.slices, slice + 1));
+		if (loop.done.fetch_add(1) + 1 == loop.slices)
+		{
+			// Taking the lock orders the notification after the caller started waiting
+			std::lock_guard<std::mutex> lock(loop.mutex);
+			loop.finished.notify_all();
+		}
+	}
+}
+
+// Number of worker threads
+unsigned int JobSystem::threadCount() const
+{
+	return (unsigned int)workers.size();
+}
+
+// Runs what is still queued and stops the workers
+void JobSystem::Delete()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	queuedChanged.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+	// Jobs pushed to a worker's deque after it stopped are run here, later ones run where they are submitted
+	Job job;
+	while (take(job))
+		run(job);
+	queues.clear();
+	stopping = false;
+}
@@ -0,0 +1,149 @@
+#ifndef JOB_SYSTEM_CLASS_H
+#define JOB_SYSTEM_CLASS_H
+
+#include<atomic>
+#include<condition_variable>
+#include<cstddef>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+#include"PoolAllocator.h"
+
+// The engine's one pool of worker threads, shared by the renderer and the asset loaders so cores are not oversubscribed
+// Every worker has a deque of its own: jobs it submits go to the back and it takes them from there, idle workers
+// steal from the front of the others. Jobs submitted from outside the pool are dealt to the workers in turn.
+// Counters count unfinished jobs, a job can be held back until a counter is done, and Wait runs jobs while it waits.
+// ParallelFor cuts a loop into at most one slice per worker plus one for the calling thread, which works on its own
+// loop too and returns once every slice is done. Its slices go to a queue every worker looks at first, since a frame
+// waits for them, and the caller never runs anything but its own slices. Each slice gets its index, so it can write
+// into storage of its own that the caller prepared. Several threads may call ParallelFor at once.
+// Once the queues and the pool of loops have grown to what a frame needs, submitting and running jobs and loops does
+// not allocate, as long as the functions fit into std::function without a heap allocation of their own.
+class JobSystem
+{
+public:
+	typedef std::function<void()> Function;
+	// Runs the items from begin to end of slice number slice of the loop function points to, so ParallelFor never
+	// copies the loop's function into a std::function
+	typedef void (*SliceCall)(const void* function, size_t slice, size_t begin, size_t end);
+
+	// Number of jobs submitted with it that have not finished, and the jobs held back until that is zero
+	// Wait for it before it is destroyed, Done alone does not tell if the last job let go of it
+	class Counter
+	{
+	public:
+		// Checks if every job counted has finished
+		bool Done() const;
+	private:
+		friend class JobSystem;
+		std::atomic<size_t> value{ 0 };
+		std::mutex mutex;
+		std::vector<std::pair<Function, Counter*>> waiting;
+	};
+
+	// Constructor that starts the worker threads, with 0 every job runs on the thread that submits it
+	JobSystem(unsigned int threads);
+	// Stops the workers unless Delete was already called
+	~JobSystem();
+	// JobSystem owns its threads, so it can not be copied
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// One less than the number of cores, at least one
+	static unsigned int DefaultThreads();
+	// Number of slices ParallelFor splits count items into, none of them smaller than grain unless there is only one
+	size_t Slices(size_t count, size_t grain) const;
+	// First item of a slice, slice number slices is the end of the range
+	static size_t SliceStart(size_t count, size_t slices, size_t slice);
+	// Runs function over Slices(count, grain) slices of the items from 0 to count and waits for all of them
+	// Any callable taking (slice, begin, end) works, it is called where it is without being copied or allocated
+	template<typename Function>
+	void ParallelFor(size_t count, size_t grain, const Function& function)
+	{
+		parallelFor(count, grain, &function, [](const void* callable, size_t slice, size_t begin, size_t end) {
+			(*(const Function*)callable)(slice, begin, end);
+		});
+	}
+
+	// Queues a job, counter counts it until it has run
+	void Submit(Function function, Counter* counter = nullptr);
+	// Queues a job that only starts once dependency is done
+	void SubmitAfter(Counter& dependency, Function function, Counter* counter = nullptr);
+	// Blocks until counter is done, running queued jobs of any kind meanwhile, so it is meant for loading and shutdown
+	void Wait(Counter& counter);
+
+	// Number of worker threads
+	unsigned int threadCount() const;
+
+	// Runs what is still queued and stops the workers, jobs run on the thread that submits them afterwards
+	void Delete();
+private:
+	// A queued job and the counter it finishes
+	struct Job
+	{
+		Function function;
+		Counter* counter = nullptr;
+	};
+	// Deque of one worker, or the shared one for ParallelFor slices, a ring that grows but never shrinks
+	struct JobQueue
+	{
+		std::mutex mutex;
+		std::vector<Job> ring;
+		size_t first = 0;
+		size_t count = 0;
+
+		// Adds a job at the back, doubling the ring when it is full
+		void PushBack(Job job);
+		// Takes the job at the front or the back, false if there is none
+		bool PopFront(Job& job);
+		bool PopBack(Job& job);
+	};
+	// One ParallelFor in progress, slices are claimed by whoever gets to them first
+	// Helpers may get to a loop after every slice was claimed, the last of them and the caller to let go of it frees it
+	struct Loop
+	{
+		const void* function;
+		SliceCall call;
+		size_t count;
+		size_t slices;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::atomic<size_t> references{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<JobQueue>> queues;
+	JobQueue urgent;
+	// Loops in progress come from a pool, so a frame's loops cost no heap allocations
+	std::mutex loopMutex;
+	PoolAllocator loops{ sizeof(Loop), alignof(Loop) };
+	// Next worker a job from outside the pool is dealt to
+	std::atomic<size_t> nextQueue{ 0 };
+	// Jobs in every queue, idle workers sleep while it is 0
+	std::mutex sleepMutex;
+	std::condition_variable queuedChanged;
+	size_t queuedJobs = 0;
+	bool stopping = false;
+
+	// Loop run by every worker thread
+	void work(unsigned int index);
+	// Puts a job into a queue, the urgent one or the calling worker's own deque or the next worker's
+	void push(Job job, bool isUrgent);
+	// Takes a job, urgent ones first, then the own deque's newest, then the oldest of another, false if there is none
+	bool take(Job& job);
+	// Runs a job and finishes its counter
+	void run(Job& job);
+	// Runs the slices of ParallelFor
+	void parallelFor(size_t count, size_t grain, const void* function, SliceCall call);
+	// Claims and runs slices of a loop until none are left
+	static void runSlices(Loop& loop);
+	// Lets go of a loop, the last one to do so gives it back to the pool
+	void release(Loop* loop);
+};
+
+#endif
@@ -0,0 +1,217 @@
+#include"JsonValue.h"
+
+#include<cstdlib>
+#include<cstring>
+
+// Values nested deeper than this are refused instead of overflowing the stack
+static const int MAX_DEPTH = 256;
+
+// Recursive descent parser
+class JsonParser
+{
+public:
+	JsonParser(const char* text, size_t size) : at(text), end(text + size) {}
+
+	// Parses the one value of the text, false if it is not valid JSON
+	bool Parse(JsonValue& value)
+	{
+		return parseValue(value, 0) && (skipSpaces(), at == end);
+	}
+private:
+	const char* at;
+	const char* end;
+
+	void skipSpaces()
+	{
+		while (at < end && (*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n'))
+			at++;
+	}
+	bool literal(const char* word)
+	{
+		size_t length = strlen(word);
+		if ((size_t)(end - at) < length || memcmp(at, word, length) != 0)
+			return false;
+		at += length;
+		return true;
+	}
+	bool parseValue(JsonValue& value, int depth)
+	{
+		if (depth > MAX_DEPTH)
+			return false;
+		skipSpaces();
+		if (at >= end)
+			return false;
+		switch (*at)
+		{
+		case '{':
+			value.type = JsonValue::JSON_OBJECT;
+			at++;
+			skipSpaces();
+			if (at < end && *at == '}')
+				return ++at, true;
+			for (;;)
+			{
+				std::pair<std::string, JsonValue> member;
+				skipSpaces();
+				if (!parseString(member.first))
+					return false;
+				skipSpaces();
+				if (at >= end || *at++ != ':' || !parseValue(member.second, depth + 1))
+					return false;
+				value.members.push_back(std::move(member));
+				skipSpaces();
+				if (at < end && *at == ',')
+				{
+					at++;
+					continue;
+				}
+				return at < end && *at++ == '}';
+			}
+		case '[':
+			value.type = JsonValue::JSON_ARRAY;
+			at++;
+			skipSpaces();
+			if (at < end && *at == ']')
+				return ++at, true;
+			for (;;)
+			{
+				value.items.emplace_back();
+				if (!parseValue(value.items.back(), depth + 1))
+					return false;
+				skipSpaces();
+				if (at < end && *at == ',')
+				{
+					at++;
+					continue;
+				}
+				return at < end && *at++ == ']';
+			}
+		case '"':
+			value.type = JsonValue::JSON_STRING;
+			return parseString(value.string);
+		case 't':
+			value.type = JsonValue::JSON_BOOLEAN;
+			value.boolean = true;
+			return literal("true");
+		case 'f':
+			value.type = JsonValue::JSON_BOOLEAN;
+			return literal("false");
+		case 'n':
+			return literal("null");
+		default:
+			value.type = JsonValue::JSON_NUMBER;
+			return parseNumber(value.number);
+		}
+	}
+	bool parseNumber(double& number)
+	{
+		// The JSON is small next to the buffers, strtod on a copy is fast enough and needs no terminator in the file
+		const char* start = at;
+		while (at < end && (strchr("+-.eE", *at) || (*at >= '0' && *at <= '9')))
+			at++;
+		if (at == start)
+			return false;
+		std::string text(start, at);
+		char* parsed = nullptr;
+		number = strtod(text.c_str(), &parsed);
+		return parsed == text.c_str() + text.size();
+	}
+	bool parseString(std::string& out)
+	{
+		if (at >= end || *at != '"')
+			return false;
+		for (at++; at < end && *at != '"'; at++)
+		{
+			if (*at != '\\')
+			{
+				out += *at;
+				continue;
+			}
+			if (++at >= end)
+				return false;
+			switch (*at)
+			{
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				// Code points are written back as UTF-8, surrogate pairs are not joined since they only occur in names that are never shown
+				if (end - at < 5)
+					return false;
+				unsigned int code = (unsigned int)strtoul(std::string(at + 1, at + 5).c_str(), nullptr, 16);
+				at += 4;
+				if (code < 0x80)
+					out += (char)code;
+				else if (code < 0x800)
+				{
+					out += (char)(0xC0 | (code >> 6));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+				else
+				{
+					out += (char)(0xE0 | (code >> 12));
+					out += (char)(0x80 | ((code >> 6) & 0x3F));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			default: out += *at; break;
+			}
+		}
+		return at < end && *at++ == '"';
+	}
+};
+
+// Parses text that holds exactly one value
+bool JsonValue::Parse(const char* text, size_t size, JsonValue& value)
+{
+	JsonParser parser(text, size);
+	return parser.Parse(value);
+}
+
+// Member of an object, a null value if there is none
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+	static const JsonValue none;
+	for (const std::pair<std::string, JsonValue>& member : members)
+		if (member.first == key)
+			return member.second;
+	return none;
+}
+
+// Item of an array, a null value if there is none
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+	static const JsonValue none;
+	return index < items.size() ? items[index] : none;
+}
+
+const JsonValue& JsonValue::operator[](int index) const
+{
+	return (*this)[index < 0 ? items.size() : (size_t)index];
+}
+
+// Checks if an object has a member that is not null
+bool JsonValue::has(const char* key) const
+{
+	return (*this)[key].type != JSON_NULL;
+}
+
+size_t JsonValue::size() const
+{
+	return items.size();
+}
+
+// The number, or fallback if this is not one
+double JsonValue::Number(double fallback) const
+{
+	return type == JSON_NUMBER ? number : fallback;
+}
+
+int64_t JsonValue::Integer(int64_t fallback) const
+{
+	return type == JSON_NUMBER ? (int64_t)number : fallback;
+}
@@ -0,0 +1,48 @@
+#ifndef JSON_VALUE_CLASS_H
+#define JSON_VALUE_CLASS_H
+
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<utility>
+#include<vector>
+
+// One value of a parsed JSON document, objects keep their members in file order
+// Made for the JSON of model and map files, which is read once, so lookups are linear and missing members or items
+// come back as a null value instead of failing, which lets chains of lookups run without checks in between
+class JsonValue
+{
+public:
+	enum Type
+	{
+		JSON_NULL,
+		JSON_BOOLEAN,
+		JSON_NUMBER,
+		JSON_STRING,
+		JSON_ARRAY,
+		JSON_OBJECT
+	};
+	Type type = JSON_NULL;
+	bool boolean = false;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> items;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	// Parses text that holds exactly one value, false if it is not valid JSON
+	static bool Parse(const char* text, size_t size, JsonValue& value);
+
+	// Member of an object or item of an array, a null value if there is none
+	const JsonValue& operator[](const char* key) const;
+	const JsonValue& operator[](size_t index) const;
+	const JsonValue& operator[](int index) const;
+	// Checks if an object has a member that is not null
+	bool has(const char* key) const;
+	// Number of items of an array
+	size_t size() const;
+	// The number, or fallback if this is not one
+	double Number(double fallback) const;
+	int64_t Integer(int64_t fallback) const;
+};
+
+#endif
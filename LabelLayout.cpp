@@ -0,0 +1,141 @@
+#include"LabelLayout.h"
+
+#include<algorithm>
+#include<cmath>
+
+// Names of the streets along the rows of blocks, repeated with a number once they run out
+static const char* streetNames[] = { "ELM", "OAK", "PINE", "MAPLE", "CEDAR", "BIRCH", "ASH", "WALNUT", "CHESTNUT", "WILLOW",
+	"SPRUCE", "POPLAR", "HICKORY", "LINDEN", "ALDER", "LAUREL" };
+
+LabelLayout::LabelLayout(JobSystem& jobs, std::vector<std::string> texts)
+	: jobs(jobs), texts(std::move(texts))
+{
+}
+
+// Waits for the job still running
+LabelLayout::~LabelLayout()
+{
+	jobs.Wait(placing);
+}
+
+// Block b is in column b % blocksX and row b / blocksX, its lots are numbered two apart along the column
+std::vector<std::string> LabelLayout::Addresses(const CityLayout& layout, size_t buildingCount)
+{
+	const size_t streetCount = sizeof(streetNames) / sizeof(streetNames[0]);
+	const size_t lotsPerBlock = (size_t)layout.lotsPerSide * layout.lotsPerSide;
+	std::vector<std::string> addresses(buildingCount);
+	for (size_t i = 0; i < buildingCount; i++)
+	{
+		size_t block = i / lotsPerBlock;
+		size_t row = block / layout.blocksX;
+		std::string street = streetNames[row % streetCount];
+		if (row >= streetCount)
+			street += " " + std::to_string(row / streetCount + 1);
+		addresses[i] = std::to_string((block % layout.blocksX + 1) * 100 + (i % lotsPerBlock) * 2 + 1) + " " + street + " ST";
+	}
+	return addresses;
+}
+
+// The job is only ever started here, so nothing else touches its inputs while it runs
+void LabelLayout::Start(const glm::mat4& matrix, const glm::vec3& eye, int width, int height, const BoundingBoxes& bounds, const uint32_t* visible, size_t count)
+{
+	if (running)
+	{
+		if (!placing.Done())
+			return;
+		shown.swap(placed);
+		running = false;
+	}
+	candidates.clear();
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t b = visible[i];
+		glm::vec3 anchor(0.5f * (bounds.minX[b] + bounds.maxX[b]), bounds.maxY[b], 0.5f * (bounds.minZ[b] + bounds.maxZ[b]));
+		float distance = glm::length(anchor - eye);
+		if (distance <= maxDistance && b < texts.size())
+			candidates.push_back({ distance, b });
+	}
+	LabelLayout::matrix = matrix;
+	LabelLayout::width = width;
+	LabelLayout::height = height;
+	running = true;
+	jobs.Submit([this, &bounds] { place(bounds); }, &placing);
+}
+
+// Projects the anchors again for the frame, the sizes stay those the job gave them
+size_t LabelLayout::Project(const glm::mat4& matrix, int width, int height, const BoundingBoxes& bounds, Label* labels) const
+{
+	size_t count = 0;
+	for (const std::pair<uint32_t, float>& entry : shown)
+	{
+		if (count >= maxLabels)
+			break;
+		uint32_t b = entry.first;
+		glm::vec4 clip = matrix * glm::vec4(0.5f * (bounds.minX[b] + bounds.maxX[b]), bounds.maxY[b], 0.5f * (bounds.minZ[b] + bounds.maxZ[b]), 1.0f);
+		if (clip.w <= 0.0f)
+			continue;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		float size = entry.second;
+		Label& label = labels[count++];
+		label.position = glm::vec2((ndc.x * 0.5f + 0.5f) * width - 0.5f * textWidth(texts[b], size), (ndc.y * 0.5f + 0.5f) * height + 0.5f * size);
+		label.depth = ndc.z;
+		label.size = size;
+		label.text = b;
+	}
+	return count;
+}
+
+const std::string& LabelLayout::text(uint32_t building) const
+{
+	return texts[building];
+}
+
+// Nearest first, a label is kept when none of the cells under it and a margin of half a cell was claimed
+void LabelLayout::place(const BoundingBoxes& bounds)
+{
+	placed.clear();
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.distance < b.distance; });
+	int columns = std::max(1, (width + CELL_PIXELS - 1) / CELL_PIXELS);
+	int rows = std::max(1, (height + CELL_PIXELS - 1) / CELL_PIXELS);
+	grid.assign((size_t)columns * rows, 0);
+	const float margin = 0.5f * CELL_PIXELS;
+	for (const Candidate& candidate : candidates)
+	{
+		if (placed.size() >= maxLabels)
+			break;
+		uint32_t b = candidate.building;
+		glm::vec4 clip = matrix * glm::vec4(0.5f * (bounds.minX[b] + bounds.maxX[b]), bounds.maxY[b], 0.5f * (bounds.minZ[b] + bounds.maxZ[b]), 1.0f);
+		if (clip.w <= 0.0f)
+			continue;
+		glm::vec2 ndc = glm::vec2(clip) / clip.w;
+		if (std::abs(ndc.x) > 1.0f || std::abs(ndc.y) > 1.0f)
+			continue;
+		float size = std::max(minPixels, pixelSize * std::min(1.0f, fullSizeDistance / std::max(candidate.distance, 1e-3f)));
+		float halfWidth = 0.5f * textWidth(texts[b], size);
+		float x = (ndc.x * 0.5f + 0.5f) * width;
+		float y = (ndc.y * 0.5f + 0.5f) * height;
+		int left = std::max(0, (int)std::floor((x - halfWidth - margin) / CELL_PIXELS));
+		int right = std::min(columns - 1, (int)std::floor((x + halfWidth + margin) / CELL_PIXELS));
+		int bottom = std::max(0, (int)std::floor((y + 0.5f * size - margin) / CELL_PIXELS));
+		int top = std::min(rows - 1, (int)std::floor((y + 1.5f * size + margin) / CELL_PIXELS));
+		bool free = true;
+		for (int row = bottom; row <= top && free; row++)
+			for (int column = left; column <= right; column++)
+				if (grid[(size_t)row * columns + column])
+				{
+					free = false;
+					break;
+				}
+		if (!free)
+			continue;
+		for (int row = bottom; row <= top; row++)
+			std::fill(grid.begin() + (size_t)row * columns + left, grid.begin() + (size_t)row * columns + right + 1, (uint8_t)1);
+		placed.push_back({ b, size });
+	}
+}
+
+// Every glyph is one font pixel wider than its columns, the last one's gap included
+float LabelLayout::textWidth(const std::string& text, float size)
+{
+	return text.size() * size * (GLYPH_COLUMNS + 1) / GLYPH_ROWS;
+}
@@ -0,0 +1,98 @@
+#ifndef LABEL_LAYOUT_CLASS_H
+#define LABEL_LAYOUT_CLASS_H
+
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+#include"CityGenerator.h"
+#include"Frustum.h"
+#include"JobSystem.h"
+
+// Picks which buildings get a text label on the screen, so thousands of them do not pile up on top of each other
+// The candidates nearest to the camera go first, each label claims the cells of a coarse screen grid under its text
+// and a label that finds any of its cells claimed already is left out. That runs as a job on a worker while the
+// frame goes on, Start hands it the visible buildings of a frame and takes the labels of the last job that finished,
+// so which labels show can lag a frame or two behind the camera. Where they show does not, Project puts them on the
+// screen of the frame it is called for. Labels sit above the middle of their building's roof.
+class LabelLayout
+{
+public:
+	// A label on the screen of a frame
+	struct Label
+	{
+		// Pixel of the left end of the text's baseline from the bottom left of the framebuffer, and its depth in NDC
+		glm::vec2 position;
+		float depth;
+		// Pixel height of the letters
+		float size;
+		// Index of its text, which is the building's
+		uint32_t text;
+	};
+	// Glyphs are GLYPH_ROWS pixels of the font high and one more than GLYPH_COLUMNS apart, see LabelRenderer
+	static constexpr int GLYPH_COLUMNS = 5;
+	static constexpr int GLYPH_ROWS = 7;
+	// Side of a cell of the decluttering grid in pixels
+	static constexpr int CELL_PIXELS = 8;
+
+	// Most labels placed at once
+	size_t maxLabels = 256;
+	// Buildings further away than this get no label
+	float maxDistance = 40.0f;
+	// Pixel height of the letters of a label up to fullSizeDistance away, further ones shrink down to minPixels
+	float pixelSize = 14.0f;
+	float minPixels = 7.0f;
+	float fullSizeDistance = 8.0f;
+
+	// Constructor that takes the text of every building, in the order of the building indices
+	LabelLayout(JobSystem& jobs, std::vector<std::string> texts);
+	// Waits for the job still running
+	~LabelLayout();
+	// The job points back at the layout, so it can be neither copied nor moved
+	LabelLayout(const LabelLayout&) = delete;
+	LabelLayout& operator=(const LabelLayout&) = delete;
+
+	// Street addresses for the buildings of a generated city, a number along the block's column and a street per row
+	static std::vector<std::string> Addresses(const CityLayout& layout, size_t buildingCount);
+
+	// Takes the labels of the job that finished, if one did, and starts another on count visible buildings seen
+	// through matrix, the projection, view and model, from eye in model space on a screen of width by height pixels.
+	// Nothing is started while the last job is still running
+	void Start(const glm::mat4& matrix, const glm::vec3& eye, int width, int height, const BoundingBoxes& bounds, const uint32_t* visible, size_t count);
+	// Writes the labels taken by Start as they fall on the screen of matrix, up to maxLabels, and returns how many
+	// there are. Those behind the camera are left out
+	size_t Project(const glm::mat4& matrix, int width, int height, const BoundingBoxes& bounds, Label* labels) const;
+
+	// Text of a building
+	const std::string& text(uint32_t building) const;
+private:
+	JobSystem& jobs;
+	std::vector<std::string> texts;
+	JobSystem::Counter placing;
+
+	// What the job works from, only touched by Start while no job runs
+	struct Candidate
+	{
+		float distance;
+		uint32_t building;
+	};
+	std::vector<Candidate> candidates;
+	glm::mat4 matrix = glm::mat4(1.0f);
+	int width = 0;
+	int height = 0;
+	// Cells of the grid claimed by a label so far
+	std::vector<uint8_t> grid;
+	// Buildings the job placed with the pixel height of their letters, and the ones Start took from the last job
+	std::vector<std::pair<uint32_t, float>> placed;
+	std::vector<std::pair<uint32_t, float>> shown;
+	bool running = false;
+
+	// Runs on a worker, places the candidates nearest first
+	void place(const BoundingBoxes& bounds);
+	// Pixel width of a text whose letters are size pixels high
+	static float textWidth(const std::string& text, float size);
+};
+
+#endif
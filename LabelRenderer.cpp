@@ -0,0 +1,285 @@
+#include"LabelRenderer.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<cctype>
+#include<cmath>
+#include<vector>
+
+// First character of the font and how many follow it, from the space to Z
+static const int FIRST_CHARACTER = 32;
+static const int CHARACTER_COUNT = 59;
+// Rows of every glyph from the top, the bit 16 is the left column, characters left out are zero
+static const unsigned char font[CHARACTER_COUNT][LabelLayout::GLYPH_ROWS] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // space
+	{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 }, // !
+	{}, // "
+	{ 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A }, // #
+	{}, // $
+	{}, // %
+	{ 0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D }, // &
+	{ 0x0C, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 }, // '
+	{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 }, // (
+	{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 }, // )
+	{}, // *
+	{ 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 }, // +
+	{ 0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08 }, // ,
+	{ 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 }, // -
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C }, // .
+	{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 }, // /
+	{ 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E }, // 0
+	{ 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E }, // 1
+	{ 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F }, // 2
+	{ 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E }, // 3
+	{ 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 }, // 4
+	{ 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E }, // 5
+	{ 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E }, // 6
+	{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 }, // 7
+	{ 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E }, // 8
+	{ 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C }, // 9
+	{ 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 }, // :
+	{}, // ;
+	{}, // <
+	{}, // =
+	{}, // >
+	{}, // ?
+	{}, // @
+	{ 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 }, // A
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E }, // B
+	{ 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E }, // C
+	{ 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C }, // D
+	{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F }, // E
+	{ 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 }, // F
+	{ 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F }, // G
+	{ 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 }, // H
+	{ 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E }, // I
+	{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C }, // J
+	{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 }, // K
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F }, // L
+	{ 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 }, // M
+	{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 }, // N
+	{ 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // O
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 }, // P
+	{ 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D }, // Q
+	{ 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 }, // R
+	{ 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E }, // S
+	{ 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 }, // T
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E }, // U
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 }, // V
+	{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A }, // W
+	{ 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 }, // X
+	{ 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 }, // Y
+	{ 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F }, // Z
+};
+// Cells of the atlas along each side, and the texels of a cell, the glyph with SPREAD texels of field around it
+static const int ATLAS_COLUMNS = 8;
+static const int ATLAS_ROWS = (CHARACTER_COUNT + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS;
+static const int CELL_WIDTH = LabelLayout::GLYPH_COLUMNS * LabelRenderer::TEXELS_PER_PIXEL + 2 * LabelRenderer::SPREAD;
+static const int CELL_HEIGHT = LabelLayout::GLYPH_ROWS * LabelRenderer::TEXELS_PER_PIXEL + 2 * LabelRenderer::SPREAD;
+
+// One quad per glyph record, its corners from gl_VertexID, covering the glyph's cell of the atlas
+static const char* labelVertexSource = R"(
+#version 330 core
+layout(location = 0) in vec2 aCorner;
+layout(location = 1) in float aDepth;
+layout(location = 2) in float aSize;
+layout(location = 3) in float aGlyph;
+
+uniform vec2 viewport;
+// Cells of the atlas along each side, the cell's size in font pixels and the font pixels the field adds on each side
+uniform vec2 cells;
+uniform vec2 cellPixels;
+uniform float spreadPixels;
+
+out vec2 TexCoord;
+
+void main()
+{
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    // A font pixel is a seventh of the letters' height
+    float pixel = aSize / 7.0;
+    vec2 position = aCorner + (corner * cellPixels - spreadPixels) * pixel;
+    gl_Position = vec4(position / viewport * 2.0 - 1.0, aDepth, 1.0);
+    float glyph = aGlyph;
+    TexCoord = (vec2(mod(glyph, cells.x), floor(glyph / cells.x)) + corner) / cells;
+}
+)";
+// The field is 0.5 on the outline, the text is white and the band just outside it dark
+static const char* labelFragmentSource = R"(
+#version 330 core
+in vec2 TexCoord;
+out vec4 FragColor;
+
+uniform sampler2D atlas;
+
+void main()
+{
+    float field = texture(atlas, TexCoord).r;
+    float edge = max(fwidth(field), 1e-4) * 0.7;
+    float fill = smoothstep(0.5 - edge, 0.5 + edge, field);
+    float outline = smoothstep(0.3 - edge, 0.3 + edge, field);
+    if (outline <= 0.0)
+        discard;
+    FragColor = vec4(vec3(fill), 1.0) * outline;
+}
+)";
+
+LabelRenderer::LabelRenderer(size_t maxGlyphs, FrameScheduler* scheduler)
+	: stream(GL_ARRAY_BUFFER, (GLsizeiptr)(maxGlyphs * RECORD_FLOATS * sizeof(float))), maxGlyphs(maxGlyphs)
+{
+	stream.scheduler = scheduler;
+	program = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, labelVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, labelFragmentSource, "FRAGMENT") });
+	GLState.UseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "atlas"), TEXTURE_UNIT);
+	glUniform2f(glGetUniformLocation(program, "cells"), (GLfloat)ATLAS_COLUMNS, (GLfloat)ATLAS_ROWS);
+	glUniform2f(glGetUniformLocation(program, "cellPixels"), (GLfloat)CELL_WIDTH / TEXELS_PER_PIXEL, (GLfloat)CELL_HEIGHT / TEXELS_PER_PIXEL);
+	glUniform1f(glGetUniformLocation(program, "spreadPixels"), (GLfloat)SPREAD / TEXELS_PER_PIXEL);
+	GLState.CountUniforms(4);
+	GLState.UseProgram(0);
+
+	// Every attribute is per glyph, the quad's corners come from gl_VertexID
+	vao.Bind();
+	vao.Format(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	vao.Format(1, 1, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
+	vao.Format(2, 1, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+	vao.Format(3, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
+	vao.Divisor(0, 1);
+	vao.Unbind();
+
+	buildAtlas();
+}
+
+// Deletes the GL objects unless Delete was already called
+LabelRenderer::~LabelRenderer()
+{
+	Delete();
+}
+
+// One record per glyph that is not a gap, the labels are in the order LabelLayout placed them
+void LabelRenderer::Draw(const LabelLayout& layout, const LabelLayout::Label* labels, size_t count, int width, int height)
+{
+	if (count == 0)
+		return;
+	GLfloat* records = (GLfloat*)stream.Map();
+	size_t glyphs = 0;
+	for (size_t i = 0; i < count && glyphs < maxGlyphs; i++)
+	{
+		const LabelLayout::Label& label = labels[i];
+		const std::string& text = layout.text(label.text);
+		float advance = label.size * (LabelLayout::GLYPH_COLUMNS + 1) / LabelLayout::GLYPH_ROWS;
+		for (size_t c = 0; c < text.size() && glyphs < maxGlyphs; c++)
+		{
+			int glyph = std::toupper((unsigned char)text[c]) - FIRST_CHARACTER;
+			if (glyph <= 0 || glyph >= CHARACTER_COUNT)
+				continue;
+			GLfloat* record = records + glyphs++ * RECORD_FLOATS;
+			record[0] = label.position.x + c * advance;
+			record[1] = label.position.y;
+			record[2] = label.depth;
+			record[3] = label.size;
+			record[4] = (GLfloat)glyph;
+		}
+	}
+	stream.Unmap((GLsizeiptr)(glyphs * RECORD_FLOATS * sizeof(float)));
+
+	GLint previousProgram, previousVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	GLboolean depthMask;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+
+	glDepthMask(GL_FALSE);
+	GLState.Enable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	GLState.UseProgram(program);
+	glUniform2f(glGetUniformLocation(program, "viewport"), (GLfloat)width, (GLfloat)height);
+	GLState.CountUniforms();
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, atlas);
+	vao.Bind();
+	vao.LinkBuffer(0, stream.ID, stream.Offset(), RECORD_FLOATS * sizeof(float));
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)glyphs);
+	GLState.CountDraw(glyphs, 2 * glyphs);
+	stream.Fence();
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	GLState.Disable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ZERO);
+	glDepthMask(depthMask);
+
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+}
+
+// Every texel holds the distance to the outline of the font pixels, in texels, positive inside, mapped so that
+// SPREAD texels out is 0 and SPREAD texels in is 1. A pixel of the font is a box of TEXELS_PER_PIXEL texels, so the
+// distance to the nearest box of the other kind is exact, the space around the glyph counting as unlit
+void LabelRenderer::buildAtlas()
+{
+	const int atlasWidth = ATLAS_COLUMNS * CELL_WIDTH;
+	const int atlasHeight = ATLAS_ROWS * CELL_HEIGHT;
+	std::vector<unsigned char> texels((size_t)atlasWidth * atlasHeight, 0);
+	const float columns = (float)LabelLayout::GLYPH_COLUMNS;
+	const float rows = (float)LabelLayout::GLYPH_ROWS;
+	for (int glyph = 0; glyph < CHARACTER_COUNT; glyph++)
+	{
+		// Font pixel x, y with y up is lit when bit 4 - x of row 6 - y is set
+		auto lit = [&](int x, int y) {
+			return x >= 0 && y >= 0 && x < LabelLayout::GLYPH_COLUMNS && y < LabelLayout::GLYPH_ROWS
+				&& (font[glyph][LabelLayout::GLYPH_ROWS - 1 - y] >> (LabelLayout::GLYPH_COLUMNS - 1 - x) & 1);
+		};
+		int cellX = glyph % ATLAS_COLUMNS * CELL_WIDTH;
+		int cellY = glyph / ATLAS_COLUMNS * CELL_HEIGHT;
+		for (int ty = 0; ty < CELL_HEIGHT; ty++)
+			for (int tx = 0; tx < CELL_WIDTH; tx++)
+			{
+				// Center of the texel in font pixels
+				float px = (tx - SPREAD + 0.5f) / TEXELS_PER_PIXEL;
+				float py = (ty - SPREAD + 0.5f) / TEXELS_PER_PIXEL;
+				bool inside = lit((int)std::floor(px), (int)std::floor(py));
+				float nearest = inside ? std::min(std::min(px, columns - px), std::min(py, rows - py)) : 1e9f;
+				for (int y = 0; y < LabelLayout::GLYPH_ROWS; y++)
+					for (int x = 0; x < LabelLayout::GLYPH_COLUMNS; x++)
+					{
+						if (lit(x, y) == inside)
+							continue;
+						float dx = std::max(std::max(x - px, px - (x + 1)), 0.0f);
+						float dy = std::max(std::max(y - py, py - (y + 1)), 0.0f);
+						nearest = std::min(nearest, std::sqrt(dx * dx + dy * dy));
+					}
+				float distance = std::min(nearest * TEXELS_PER_PIXEL, (float)SPREAD) * (inside ? 1.0f : -1.0f);
+				texels[(size_t)(cellY + ty) * atlasWidth + cellX + tx] = (unsigned char)std::lround((0.5f + 0.5f * distance / SPREAD) * 255.0f);
+			}
+	}
+
+	glGenTextures(1, &atlas);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, atlas);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	// Bilinear filtering of the field is what keeps the outline smooth when it is magnified
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, atlas, GpuMemoryTracker::ImageBytes(GL_R8, atlasWidth, atlasHeight));
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+}
+
+// Deletes the GL objects
+void LabelRenderer::Delete()
+{
+	if (atlas)
+		GLState.DeleteTextures(1, &atlas);
+	if (program)
+		GLState.DeleteProgram(program);
+	atlas = program = 0;
+	vao.Delete();
+	stream.Delete();
+}
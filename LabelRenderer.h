@@ -0,0 +1,54 @@
+#ifndef LABEL_RENDERER_CLASS_H
+#define LABEL_RENDERER_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"FrameScheduler.h"
+#include"LabelLayout.h"
+#include"StreamBuffer.h"
+#include"VAO.h"
+
+// Draws the labels LabelLayout placed, every glyph of every label from one stream of glyph records in one
+// instanced draw of a quad. The glyphs come from a signed distance field atlas of a built in 5 by 7 pixel font,
+// made once at startup, so the letters stay sharp at any size and get their dark outline from the same texel.
+// Labels are tested against the depth of the scene at their anchor without writing it, a building in front hides
+// the label of one behind it. Lowercase letters are drawn as capitals, characters the font lacks as gaps.
+class LabelRenderer
+{
+public:
+	// Texture unit the atlas is bound to while labels are drawn
+	static constexpr GLuint TEXTURE_UNIT = 23;
+	// Floats of a glyph record: the pixel of its bottom left corner, its depth, its height in pixels and its glyph
+	static constexpr unsigned int RECORD_FLOATS = 5;
+	// Texels of the atlas per pixel of the font, and the distance in texels the field runs from the outline to 0 or 1
+	static constexpr int TEXELS_PER_PIXEL = 4;
+	static constexpr int SPREAD = 4;
+
+	// Constructor that makes the atlas and the program and a stream for up to maxGlyphs glyphs a frame, recycled
+	// on scheduler's fences
+	LabelRenderer(size_t maxGlyphs, FrameScheduler* scheduler);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~LabelRenderer();
+	// A LabelRenderer owns its GL objects, so it cannot be copied
+	LabelRenderer(const LabelRenderer&) = delete;
+	LabelRenderer& operator=(const LabelRenderer&) = delete;
+
+	// Draws count labels with the texts of layout into the framebuffer bound, width by height, over the depth of
+	// the scene drawn into it with the depth function in use. The program, VAO, blending and depth writes are put back
+	void Draw(const LabelLayout& layout, const LabelLayout::Label* labels, size_t count, int width, int height);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLuint atlas = 0;
+	GLuint program = 0;
+	VAO vao;
+	StreamBuffer stream;
+	size_t maxGlyphs;
+
+	// Rasterizes the font into the distance field atlas
+	void buildAtlas();
+};
+
+#endif
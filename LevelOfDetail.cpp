@@ -0,0 +1,63 @@
+#include"LevelOfDetail.h"
+
+#include<cfloat>
+
+// Sets the camera the projected sizes are measured for
+void LevelOfDetail::SetView(const glm::vec3& position, const glm::mat4& projection, float viewportHeight)
+{
+	LevelOfDetail::position = position;
+	// projection[1][1] is the cotangent of half the vertical field of view
+	pixelsPerUnit = projection[1][1] * 0.5f * viewportHeight;
+}
+
+// Diameter in pixels of the bounding sphere of a box
+float LevelOfDetail::ProjectedSize(const glm::vec3& min, const glm::vec3& max) const
+{
+	glm::vec3 center = 0.5f * (min + max);
+	float radius = 0.5f * glm::length(max - min);
+	float distance = glm::length(center - position);
+	// From inside the sphere the box fills the screen
+	if (distance <= radius)
+		return FLT_MAX;
+	return 2.0f * radius * pixelsPerUnit / distance;
+}
+
+// How far a box has faded towards its impostor
+float LevelOfDetail::ImpostorBlend(const glm::vec3& min, const glm::vec3& max) const
+{
+	return ImpostorBlend(ProjectedSize(min, max));
+}
+
+// Same for a size ProjectedSize already measured
+float LevelOfDetail::ImpostorBlend(float size) const
+{
+	if (size >= impostorPixels + fadePixels)
+		return 0.0f;
+	if (size <= impostorPixels || fadePixels <= 0.0f)
+		return 1.0f;
+	return (impostorPixels + fadePixels - size) / fadePixels;
+}
+
+// Checks if a block of a projected size is small enough for its billboard
+bool LevelOfDetail::Billboard(float projectedSize) const
+{
+	return projectedSize < billboardPixels;
+}
+
+// Checks if an object of a projected size is too small to be drawn
+bool LevelOfDetail::TooSmall(float projectedSize) const
+{
+	return projectedSize < cullPixels;
+}
+
+// The detailed instances drop the pixels below the blend
+float LevelOfDetail::DetailFade(float blend)
+{
+	return blend;
+}
+
+// The impostor keeps exactly the pixels the detailed instances dropped, a fully blended impostor draws everything
+float LevelOfDetail::ImpostorFade(float blend)
+{
+	return blend >= 1.0f ? 0.0f : blend - 1.0f;
+}
@@ -0,0 +1,44 @@
+#ifndef LEVEL_OF_DETAIL_CLASS_H
+#define LEVEL_OF_DETAIL_CLASS_H
+
+#include<glm/glm.hpp>
+
+// Chooses between the buildings of a block and the one impostor box standing in for all of them from how large
+// the block appears on screen. Around the switch both are drawn with complementary dither masks: an instance with
+// a fade f > 0 keeps the pixels whose dither value is at least f, one with f < 0 keeps those below 1 + f, so the
+// buildings at DetailFade(blend) and the impostor at ImpostorFade(blend) cover every pixel exactly once.
+class LevelOfDetail
+{
+public:
+	// Projected size in pixels below which a block is only drawn as its impostor
+	float impostorPixels = 48.0f;
+	// Width in pixels of the band above impostorPixels over which the buildings and the impostor crossfade
+	float fadePixels = 24.0f;
+	// Projected size in pixels below which a block with a baked ImpostorAtlas view is drawn as a billboard instead
+	float billboardPixels = 32.0f;
+	// Projected size in pixels below which an object of this level of detail's kind is not drawn at all, 0 draws every one
+	float cullPixels = 0.0f;
+
+	// Sets the camera position in the space the bounds are given in, and the projection and viewport height it renders with
+	void SetView(const glm::vec3& position, const glm::mat4& projection, float viewportHeight);
+	// Diameter in pixels of the bounding sphere of a box
+	float ProjectedSize(const glm::vec3& min, const glm::vec3& max) const;
+	// How far a box has faded towards its impostor, 0 is fully detailed and 1 fully the impostor
+	float ImpostorBlend(const glm::vec3& min, const glm::vec3& max) const;
+	// Same for a size ProjectedSize already measured
+	float ImpostorBlend(float projectedSize) const;
+	// Checks if a block of a projected size is small enough for its billboard
+	bool Billboard(float projectedSize) const;
+	// Checks if an object of a projected size is too small to be drawn
+	bool TooSmall(float projectedSize) const;
+
+	// Dither fades of the detailed instances and of the impostor at a blend
+	static float DetailFade(float blend);
+	static float ImpostorFade(float blend);
+private:
+	glm::vec3 position = glm::vec3(0.0f);
+	// Pixels covered by one unit of size at a distance of one unit
+	float pixelsPerUnit = 1.0f;
+};
+
+#endif
@@ -0,0 +1,496 @@
+#include"LightShadows.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<glm/gtc/matrix_access.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/packing.hpp>
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<cmath>
+#include<iostream>
+
+// Near plane of every face, casters closer to the light than this are cut off
+static const float NEAR_PLANE = 0.05f;
+// Side of the cells of the grid the dynamic casters find the lights around them in, about a lamp's diameter
+static const float CELL_SIZE = 4.0f;
+// Every face of a slot, a bit each
+static const uint8_t ALL_FACES = (1 << LightShadows::FACES) - 1;
+// Direction and up vector of the faces +X, -X, +Y, -Y, +Z and -Z, the shaders pick the face and its texture
+// coordinates to match these views
+static const glm::vec3 FACE_FRONTS[LightShadows::FACES] = {
+	glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+	glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f) };
+static const glm::vec3 FACE_UPS[LightShadows::FACES] = {
+	glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f),
+	glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f) };
+
+// Largest level whose tiles are at least size texels a side
+static int levelOf(GLsizei atlasSize, GLsizei size)
+{
+	int level = 0;
+	while ((atlasSize >> (level + 1)) >= size)
+		level++;
+	return level;
+}
+
+// Far plane of a light's faces
+static float farPlane(const GLfloat* light)
+{
+	return std::max(light[3], 2.0f * NEAR_PLANE);
+}
+
+// Constructor that creates the atlas compared in hardware, the framebuffer it is rendered through and the buffers
+LightShadows::LightShadows(ClusteredLights& lights, GLsizei atlasSize, unsigned int maxLights, GLsizei maxFace)
+	: lights(lights), atlasSize(atlasSize), maxLights(std::clamp(maxLights, 1u, MAX_LIGHTS))
+{
+	firstLevel = levelOf(atlasSize, std::min(maxFace, atlasSize / 4));
+	lastLevel = std::max(levelOf(atlasSize, MIN_FACE), firstLevel);
+	slots.resize(LightShadows::maxLights);
+	lightSlots.assign(lights.lightCount(), NONE);
+	freeTiles.resize((size_t)lastLevel + 1);
+	freeTiles[0].insert(tileKey(0, 0, 0));
+	tileData.assign((size_t)LightShadows::maxLights * 16, 0.0f);
+
+	// Lamps reach a few units, 16 bits of depth between the near and the far plane are plenty
+	glGenTextures(1, &atlas);
+	GLState.BindTexture(GL_TEXTURE_2D, atlas);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, atlasSize, atlasSize, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_SHORT, nullptr);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, atlas, GpuMemoryTracker::ImageBytes(GL_DEPTH_COMPONENT16, atlasSize, atlasSize, 1));
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+
+	GLint previousFramebuffer;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, atlas, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::LIGHT_SHADOWS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+	glGenBuffers(1, &tileBuffer);
+	GLState.BindBuffer(GL_TEXTURE_BUFFER, tileBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, (GLsizeiptr)(tileData.size() * sizeof(GLfloat)), tileData.data(), GL_DYNAMIC_DRAW);
+	GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, tileBuffer, (int64_t)(tileData.size() * sizeof(GLfloat)));
+	GLState.BindBuffer(GL_TEXTURE_BUFFER, 0);
+	glGenTextures(1, &tileTexture);
+	GLState.BindTexture(GL_TEXTURE_BUFFER, tileTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, tileBuffer);
+	GLState.BindTexture(GL_TEXTURE_BUFFER, 0);
+	glGenBuffers(1, &dynamicBuffer);
+}
+
+// Deletes the GL objects unless Delete was already called
+LightShadows::~LightShadows()
+{
+	Delete();
+}
+
+// Takes a free tile of a level, splitting a larger one if there is none
+bool LightShadows::allocate(int level, uint32_t& key)
+{
+	std::set<uint32_t>& free = freeTiles[level];
+	if (!free.empty())
+	{
+		key = *free.begin();
+		free.erase(free.begin());
+		return true;
+	}
+	uint32_t parent;
+	if (level == 0 || !allocate(level - 1, parent))
+		return false;
+	// The parent's first quarter is taken, the other three are free
+	uint32_t x = (parent & 0x3FFF) * 2, y = (parent >> 14 & 0x3FFF) * 2;
+	free.insert({ tileKey(level, x + 1, y), tileKey(level, x, y + 1), tileKey(level, x + 1, y + 1) });
+	key = tileKey(level, x, y);
+	return true;
+}
+
+// Gives a tile back, merging it with its three siblings when they are free too
+void LightShadows::release(uint32_t key)
+{
+	int level = (int)(key >> 28);
+	uint32_t x = key & 0x3FFF, y = key >> 14 & 0x3FFF;
+	std::set<uint32_t>& free = freeTiles[level];
+	const uint32_t siblings[3] = { tileKey(level, x ^ 1, y), tileKey(level, x, y ^ 1), tileKey(level, x ^ 1, y ^ 1) };
+	if (level == 0 || !std::all_of(siblings, siblings + 3, [&](uint32_t sibling) { return free.count(sibling) > 0; }))
+	{
+		free.insert(key);
+		return;
+	}
+	for (uint32_t sibling : siblings)
+		free.erase(sibling);
+	release(tileKey(level - 1, x / 2, y / 2));
+}
+
+// Gives six tiles of a level to a slot, giving back the ones taken if there is no room for all of them
+bool LightShadows::allocateFaces(Slot& slot, int level)
+{
+	for (unsigned int face = 0; face < FACES; face++)
+		if (!allocate(level, slot.tiles[face]))
+		{
+			for (unsigned int taken = 0; taken < face; taken++)
+				release(slot.tiles[taken]);
+			return false;
+		}
+	slot.level = level;
+	slot.pending = ALL_FACES;
+	slot.complete = false;
+	slot.dynamicDrawn = false;
+	tilesDirty = true;
+	return true;
+}
+
+// Gives back a slot's tiles and the slot itself
+void LightShadows::freeSlot(uint32_t index)
+{
+	Slot& slot = slots[index];
+	if (slot.light == NONE)
+		return;
+	for (uint32_t tile : slot.tiles)
+		release(tile);
+	lights.SetShadow(slot.light, -1);
+	lightSlots[slot.light] = NONE;
+	slot = Slot();
+	tilesDirty = true;
+}
+
+// Frees the slot of the light out of view the longest, or else of the least important candidate after candidate
+bool LightShadows::evict(size_t candidate)
+{
+	uint32_t victim = NONE;
+	for (uint32_t i = 0; i < (uint32_t)slots.size(); i++)
+		if (slots[i].light != NONE && slots[i].lastSeen != updates && (victim == NONE || slots[i].lastSeen < slots[victim].lastSeen))
+			victim = i;
+	for (size_t j = candidates.size(); victim == NONE && j-- > candidate + 1;)
+		victim = lightSlots[candidates[j].light];
+	if (victim == NONE)
+		return false;
+	freeSlot(victim);
+	return true;
+}
+
+// Adds records of dynamic casters for the next Update
+void LightShadows::AddDynamic(const CompactInstance* records, size_t count)
+{
+	if (count > 0)
+		spans.push_back({ records, count });
+}
+
+// Finds the lights the dynamic casters are inside of, through a grid of the shadowed lights in view
+void LightShadows::gatherDynamic()
+{
+	dynamicRecords.clear();
+	cells.clear();
+	auto cellKey = [](int x, int z) { return (uint64_t)(uint32_t)x << 32 | (uint32_t)z; };
+	bool any = false;
+	for (uint32_t i = 0; i < (uint32_t)slots.size(); i++)
+	{
+		slots[i].dynamicInside = false;
+		if (slots[i].light == NONE || slots[i].lastSeen != updates)
+			continue;
+		const GLfloat* light = lights.light(slots[i].light);
+		int x0 = (int)std::floor((light[0] - light[3]) / CELL_SIZE), x1 = (int)std::floor((light[0] + light[3]) / CELL_SIZE);
+		int z0 = (int)std::floor((light[2] - light[3]) / CELL_SIZE), z1 = (int)std::floor((light[2] + light[3]) / CELL_SIZE);
+		for (int z = z0; z <= z1; z++)
+			for (int x = x0; x <= x1; x++)
+				cells[cellKey(x, z)].push_back(i);
+		any = true;
+	}
+
+	for (const Span& span : spans)
+	{
+		if (!any)
+			break;
+		for (size_t r = 0; r < span.count; r++)
+		{
+			const CompactInstance& record = span.records[r];
+			glm::vec3 min(record.translation[0], record.translation[1], record.translation[2]);
+			glm::vec3 max = min + glm::vec3(glm::unpackHalf1x16(record.scale[0]), glm::unpackHalf1x16(record.scale[1]), glm::unpackHalf1x16(record.scale[2]));
+			bool inside = false;
+			for (int z = (int)std::floor(min.z / CELL_SIZE); z <= (int)std::floor(max.z / CELL_SIZE); z++)
+				for (int x = (int)std::floor(min.x / CELL_SIZE); x <= (int)std::floor(max.x / CELL_SIZE); x++)
+				{
+					auto cell = cells.find(cellKey(x, z));
+					if (cell == cells.end())
+						continue;
+					for (uint32_t i : cell->second)
+					{
+						// The box touches the sphere when its point nearest to the light is within the radius
+						const GLfloat* light = lights.light(slots[i].light);
+						glm::vec3 center(light[0], light[1], light[2]);
+						glm::vec3 offset = glm::clamp(center, min, max) - center;
+						if (glm::dot(offset, offset) < light[3] * light[3])
+							inside = slots[i].dynamicInside = true;
+					}
+				}
+			if (inside)
+				dynamicRecords.push_back(record);
+		}
+	}
+	spans.clear();
+
+	if (!dynamicRecords.empty())
+	{
+		GLsizeiptr bytes = (GLsizeiptr)(dynamicRecords.size() * sizeof(CompactInstance));
+		GLState.BindBuffer(GL_ARRAY_BUFFER, dynamicBuffer);
+		glBufferData(GL_ARRAY_BUFFER, bytes, dynamicRecords.data(), GL_STREAM_DRAW);
+		GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, dynamicBuffer, (int64_t)bytes);
+		GLState.BindBuffer(GL_ARRAY_BUFFER, 0);
+		GLState.CountUpload((size_t)bytes);
+	}
+}
+
+// Renders one face of a slot into its tile
+void LightShadows::renderFace(const Slot& slot, unsigned int face, const DrawFunction& drawStatic, const DynamicFunction& drawDynamic)
+{
+	GLsizei size = atlasSize >> slot.level;
+	GLint x = (GLint)(slot.tiles[face] & 0x3FFF) * size, y = (GLint)(slot.tiles[face] >> 14 & 0x3FFF) * size;
+	glViewport(x, y, size, size);
+	glScissor(x, y, size, size);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	const GLfloat* light = lights.light(slot.light);
+	glm::vec3 position(light[0], light[1], light[2]);
+	glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, NEAR_PLANE, farPlane(light));
+	glm::mat4 view = glm::lookAt(position, position + FACE_FRONTS[face], FACE_UPS[face]);
+	drawStatic(projection, view);
+	if (slot.dynamicInside && drawDynamic)
+		drawDynamic(dynamicBuffer, (GLsizei)dynamicRecords.size());
+}
+
+// Picks the lights to shadow, allocates their tiles and renders the faces that need it
+void LightShadows::Update(const glm::mat4& viewModel, const glm::mat4& projection, int height, const DrawFunction& drawStatic, const DynamicFunction& drawDynamic)
+{
+	updates++;
+	toModel = glm::inverse(glm::mat3(viewModel));
+
+	// The lights whose sphere is inside the four sides of the frustum and in front of the camera, ranked by the pixels
+	// their radius covers, which an off center projection does not change
+	const glm::vec4 x = glm::row(projection, 0), y = glm::row(projection, 1), w = glm::row(projection, 3);
+	const glm::vec4 planes[4] = { w + x, w - x, w + y, w - y };
+	float pixelsPerUnit = projection[1][1] * 0.5f * (float)std::max(height, 1);
+	candidates.clear();
+	for (uint32_t l = 0; l < (uint32_t)lightSlots.size(); l++)
+	{
+		const GLfloat* light = lights.light(l);
+		glm::vec4 center = viewModel * glm::vec4(light[0], light[1], light[2], 1.0f);
+		float radius = light[3];
+		if (radius <= 0.0f || -center.z + radius <= 0.0f)
+			continue;
+		bool inside = true;
+		for (const glm::vec4& plane : planes)
+			inside = inside && glm::dot(plane, center) >= -radius * glm::length(glm::vec3(plane));
+		if (inside)
+			candidates.push_back({ l, radius * pixelsPerUnit / std::max(-center.z, radius) });
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.importance > b.importance || (a.importance == b.importance && a.light < b.light);
+	});
+	if (candidates.size() > maxLights)
+		candidates.resize(maxLights);
+	for (const Candidate& candidate : candidates)
+		if (lightSlots[candidate.light] != NONE)
+			slots[lightSlots[candidate.light]].lastSeen = updates;
+
+	// A face of about the light's diameter on screen, kept until it is off by more than a factor of 2 so a light moving
+	// slowly towards the camera does not trade its tiles back and forth
+	for (size_t k = 0; k < candidates.size(); k++)
+	{
+		uint32_t light = candidates[k].light;
+		float texels = std::clamp(2.0f * candidates[k].importance, (float)MIN_FACE, (float)(atlasSize >> firstLevel));
+		float wanted = std::log2((float)atlasSize / texels);
+		uint32_t index = lightSlots[light];
+		if (index != NONE)
+		{
+			if (std::abs(wanted - (float)slots[index].level) < 1.0f)
+				continue;
+			for (uint32_t tile : slots[index].tiles)
+				release(tile);
+		}
+		else
+		{
+			auto isFree = [](const Slot& slot) { return slot.light == NONE; };
+			auto free = std::find_if(slots.begin(), slots.end(), isFree);
+			if (free == slots.end() && evict(k))
+				free = std::find_if(slots.begin(), slots.end(), isFree);
+			if (free == slots.end())
+				continue;
+			index = (uint32_t)(free - slots.begin());
+			free->light = light;
+			free->lastSeen = updates;
+			lightSlots[light] = index;
+		}
+		int level = std::clamp((int)std::lround(wanted), firstLevel, lastLevel);
+		bool placed;
+		while (!(placed = allocateFaces(slots[index], level)))
+		{
+			if (evict(k))
+				continue;
+			if (level < lastLevel)
+			{
+				level++;
+				continue;
+			}
+			break;
+		}
+		// Without room even for the smallest faces the light stays unshadowed, its slot holds no tiles to give back
+		if (!placed)
+		{
+			lights.SetShadow(light, -1);
+			lightSlots[light] = NONE;
+			slots[index] = Slot();
+			tilesDirty = true;
+		}
+	}
+
+	gatherDynamic();
+
+	// The most important lights first, with the faces they are missing, all of them again while a car is inside and
+	// once more after it left
+	GLint previousFramebuffer, viewport[4], scissorBox[4];
+	GLboolean colorMask[4];
+	GLboolean scissor = GL_FALSE;
+	bool begun = false;
+	renderedFaces = 0;
+	for (const Candidate& candidate : candidates)
+	{
+		uint32_t index = lightSlots[candidate.light];
+		if (index == NONE)
+			continue;
+		Slot& slot = slots[index];
+		if (slot.dynamicInside || (slot.dynamicDrawn && slot.pending == 0))
+			slot.pending = ALL_FACES;
+		for (unsigned int face = 0; face < FACES && renderedFaces < faceBudget; face++)
+		{
+			if (!(slot.pending & (1 << face)))
+				continue;
+			if (!begun)
+			{
+				glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+				glGetIntegerv(GL_VIEWPORT, viewport);
+				glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+				scissor = glIsEnabled(GL_SCISSOR_TEST);
+				glGetIntegerv(GL_SCISSOR_BOX, scissorBox);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+				GLState.Enable(GL_DEPTH_TEST);
+				GLState.Enable(GL_SCISSOR_TEST);
+				// Surfaces facing away from the light would otherwise shadow themselves
+				GLState.Enable(GL_POLYGON_OFFSET_FILL);
+				glPolygonOffset(2.0f, 4.0f);
+				begun = true;
+			}
+			renderFace(slot, face, drawStatic, drawDynamic);
+			slot.pending &= (uint8_t)~(1 << face);
+			if (slot.dynamicInside)
+				slot.dynamicDrawn = true;
+			renderedFaces++;
+		}
+		if (slot.pending == 0)
+		{
+			if (!slot.complete)
+				tilesDirty = true;
+			slot.complete = true;
+			slot.dynamicDrawn = slot.dynamicInside;
+		}
+	}
+	if (begun)
+	{
+		GLState.Disable(GL_POLYGON_OFFSET_FILL);
+		if (!scissor)
+			GLState.Disable(GL_SCISSOR_TEST);
+		glScissor(scissorBox[0], scissorBox[1], scissorBox[2], scissorBox[3]);
+		glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	}
+
+	// Only lights with all six faces in are shadowed, the others are lit as if nothing was in the way
+	shadowedLights = dynamicLights = 0;
+	for (uint32_t i = 0; i < (uint32_t)slots.size(); i++)
+	{
+		const Slot& slot = slots[i];
+		if (slot.light == NONE)
+			continue;
+		lights.SetShadow(slot.light, slot.complete ? (int)i : -1);
+		shadowedLights += slot.complete ? 1 : 0;
+		dynamicLights += slot.dynamicInside ? 1 : 0;
+	}
+	if (tilesDirty)
+	{
+		std::fill(tileData.begin(), tileData.end(), 0.0f);
+		for (size_t i = 0; i < slots.size(); i++)
+		{
+			const Slot& slot = slots[i];
+			if (slot.light == NONE || !slot.complete)
+				continue;
+			GLfloat* texels = &tileData[i * 16];
+			GLsizei size = atlasSize >> slot.level;
+			for (unsigned int face = 0; face < FACES; face++)
+			{
+				texels[face * 2] = (float)((slot.tiles[face] & 0x3FFF) * size) / (float)atlasSize;
+				texels[face * 2 + 1] = (float)((slot.tiles[face] >> 14 & 0x3FFF) * size) / (float)atlasSize;
+			}
+			texels[12] = (float)size / (float)atlasSize;
+			texels[13] = NEAR_PLANE;
+			texels[14] = farPlane(lights.light(slot.light));
+			texels[15] = 0.5f / (float)size;
+		}
+		GLState.BindBuffer(GL_TEXTURE_BUFFER, tileBuffer);
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, (GLsizeiptr)(tileData.size() * sizeof(GLfloat)), tileData.data());
+		GLState.BindBuffer(GL_TEXTURE_BUFFER, 0);
+		GLState.CountUpload(tileData.size() * sizeof(GLfloat));
+		tilesDirty = false;
+	}
+}
+
+// Renders every shadowed light again
+void LightShadows::Invalidate()
+{
+	for (Slot& slot : slots)
+		if (slot.light != NONE)
+			slot.pending = ALL_FACES;
+}
+
+// Binds the atlas and the tiles and sets the shadow uniforms of the program in use
+void LightShadows::Apply(GLuint program)
+{
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, atlas);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + 1);
+	GLState.BindTexture(GL_TEXTURE_BUFFER, tileTexture);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, "lightShadowAtlas"), (GLint)TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "lightShadowTiles"), (GLint)(TEXTURE_UNIT + 1));
+	glUniformMatrix3fv(glGetUniformLocation(program, "lightShadowToModel"), 1, GL_FALSE, glm::value_ptr(toModel));
+	GLState.CountUniforms(3);
+}
+
+// Deletes the GL objects
+void LightShadows::Delete()
+{
+	GLuint textures[] = { atlas, tileTexture };
+	for (GLuint texture : textures)
+		if (texture != 0)
+			GLState.DeleteTextures(1, &texture);
+	atlas = tileTexture = 0;
+	GLuint buffers[] = { tileBuffer, dynamicBuffer };
+	for (GLuint buffer : buffers)
+		if (buffer != 0)
+			GLState.DeleteBuffers(1, &buffer);
+	tileBuffer = dynamicBuffer = 0;
+	if (framebuffer != 0)
+	{
+		glDeleteFramebuffers(1, &framebuffer);
+		framebuffer = 0;
+	}
+}
@@ -0,0 +1,157 @@
+#ifndef LIGHT_SHADOWS_CLASS_H
+#define LIGHT_SHADOWS_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<functional>
+#include<set>
+#include<unordered_map>
+#include<vector>
+
+#include"ClusteredLights.h"
+#include"CompactInstance.h"
+
+// Shadows of the point lights ClusteredLights shades with, kept in one depth atlas. Every shadowed light has six
+// square tiles, the faces of a cube around it, of a size picked by how large its sphere is on screen, from MIN_FACE
+// to the largest a side the constructor allows. The tiles come from a quadtree of the atlas, so a light that needs
+// larger or smaller faces gives its tiles back to be merged again. The lights in view are ranked by that size and the
+// first maxLights of them keep or get tiles, the most important first, taking them from lights out of view and then
+// from less important ones when the atlas is full.
+// A light's faces only hold the static city and are kept while it has its tiles. Dynamic casters, the cars, are handed
+// to every Update, and only the lights one of them is inside of are rendered again with them on top, and once more
+// after the last one left. At most faceBudget faces are rendered an Update, every one drawing the casters again, the
+// most important lights first, and a light is only shadowed once all six of its faces are in.
+// The lights are in the city's model space, the shaders turn the view space vector from a light to the point they
+// shade back into it and pick the face and its tile from a texture buffer with four texels a slot:
+//   0 to 2   bottom left corner of the tiles of faces +X and -X, +Y and -Y, +Z and -Z, in atlas coordinates
+//   3        side of a tile in atlas coordinates, near and far plane of the faces, half a texel of a face
+class LightShadows
+{
+public:
+	// The atlas is bound to this texture unit and the tiles to the one after it, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 24;
+	// Lights that are shadowed at once at most, and the smallest and default largest texels a side of a face
+	static constexpr unsigned int MAX_LIGHTS = 256;
+	static constexpr GLsizei MIN_FACE = 32;
+	static constexpr GLsizei MAX_FACE = 512;
+	static constexpr unsigned int FACES = 6;
+
+	// Most faces an Update renders
+	unsigned int faceBudget = 12;
+	// Lights shadowed with all their faces in, faces rendered and lights a car was inside of, by the last Update
+	size_t shadowedLights = 0;
+	unsigned int renderedFaces = 0;
+	size_t dynamicLights = 0;
+
+	// Draws the static casters into the bound face with its projection and view, in model space
+	typedef std::function<void(const glm::mat4& projection, const glm::mat4& view)> DrawFunction;
+	// Draws count records of dynamic casters from a buffer of CompactInstance, with the face of the last DrawFunction
+	typedef std::function<void(GLuint records, GLsizei count)> DynamicFunction;
+
+	// Constructor for an atlas of atlasSize texels a side shadowing up to maxLights of lights at once, with faces of at
+	// most maxFace texels a side. The lights have to outlive it
+	LightShadows(ClusteredLights& lights, GLsizei atlasSize = 4096, unsigned int maxLights = 128, GLsizei maxFace = MAX_FACE);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~LightShadows();
+	// A LightShadows owns its GL objects, so it cannot be copied
+	LightShadows(const LightShadows&) = delete;
+	LightShadows& operator=(const LightShadows&) = delete;
+
+	// Adds count records of dynamic casters in model space for the next Update, they have to stay valid until then
+	void AddDynamic(const CompactInstance* records, size_t count);
+	// Picks the lights to shadow for a camera, allocates their tiles and renders the faces that are missing or that the
+	// dynamic casters added since the last Update are in, then tells the lights which slot they are shadowed from.
+	// viewModel and projection are the ones the lights are binned with, height the framebuffer's height in pixels.
+	// The draw functions get a bound depth only framebuffer and GL's default depth convention, the framebuffer,
+	// viewport, scissor and color mask are restored afterwards
+	void Update(const glm::mat4& viewModel, const glm::mat4& projection, int height, const DrawFunction& drawStatic, const DynamicFunction& drawDynamic = nullptr);
+	// Renders every shadowed light again, such as after the static geometry changed
+	void Invalidate();
+	// Binds the atlas and the tiles and sets the shadow uniforms of a program, which has to be in use
+	void Apply(GLuint program);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	static constexpr uint32_t NONE = UINT32_MAX;
+
+	// A slot of the tile buffer and the light it shadows, NONE when it is free
+	struct Slot
+	{
+		uint32_t light = NONE;
+		// Quadtree level of its tiles, a face is atlasSize >> level texels a side
+		int level = 0;
+		uint32_t tiles[FACES] = {};
+		// Faces still to render, a bit each, and whether all six were rendered since the tiles were allocated
+		uint8_t pending = 0;
+		bool complete = false;
+		// The faces hold dynamic casters, and one is inside the light this Update
+		bool dynamicDrawn = false;
+		bool dynamicInside = false;
+		// Update the light was last in view
+		uint64_t lastSeen = 0;
+	};
+	// A light in view and how many pixels its sphere's radius covers
+	struct Candidate
+	{
+		uint32_t light;
+		float importance;
+	};
+	// Records handed to AddDynamic
+	struct Span
+	{
+		const CompactInstance* records;
+		size_t count;
+	};
+
+	ClusteredLights& lights;
+	GLsizei atlasSize;
+	unsigned int maxLights;
+	// Levels of the largest and smallest faces
+	int firstLevel;
+	int lastLevel;
+	uint64_t updates = 0;
+	glm::mat3 toModel = glm::mat3(1.0f);
+
+	GLuint atlas = 0;
+	GLuint framebuffer = 0;
+	GLuint tileBuffer = 0;
+	GLuint tileTexture = 0;
+	GLuint dynamicBuffer = 0;
+	bool tilesDirty = true;
+
+	std::vector<Slot> slots;
+	// Slot of every light, NONE when it has none
+	std::vector<uint32_t> lightSlots;
+	// Free tiles of every level of the quadtree by key, the lowest first
+	std::vector<std::set<uint32_t>> freeTiles;
+
+	// Scratch space reused every Update
+	std::vector<Candidate> candidates;
+	std::vector<Span> spans;
+	std::vector<CompactInstance> dynamicRecords;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+	std::vector<GLfloat> tileData;
+
+	// Key of a tile of a level, its level in the top 4 bits and its row and column in 14 bits each
+	static uint32_t tileKey(int level, uint32_t x, uint32_t y) { return (uint32_t)level << 28 | y << 14 | x; }
+	// Takes a free tile of a level, splitting a larger one if there is none, false if the atlas has no room
+	bool allocate(int level, uint32_t& key);
+	// Gives a tile back, merging it with its three siblings when they are free too
+	void release(uint32_t key);
+	// Gives six tiles of a level to a slot, false with none taken if the atlas has no room for all of them
+	bool allocateFaces(Slot& slot, int level);
+	// Gives back a slot's tiles and the slot itself, the light is no longer shadowed
+	void freeSlot(uint32_t slot);
+	// Frees the slot of the light out of view the longest, or else of the least important candidate after candidate,
+	// false if there is neither
+	bool evict(size_t candidate);
+	// Finds the lights the dynamic casters are inside of and gathers the casters inside any of them
+	void gatherDynamic();
+	// Renders one face of a slot
+	void renderFace(const Slot& slot, unsigned int face, const DrawFunction& drawStatic, const DynamicFunction& drawDynamic);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include"LiveDataReceiver.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+
+#ifdef _WIN32
+#include<winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET NativeSocket;
+static const intptr_t INVALID_HANDLE = (intptr_t)INVALID_SOCKET;
+static void closeSocket(intptr_t handle) { closesocket((NativeSocket)handle); }
+#else
+#include<netinet/in.h>
+#include<sys/socket.h>
+#include<sys/time.h>
+#include<unistd.h>
+typedef int NativeSocket;
+static const intptr_t INVALID_HANDLE = -1;
+static void closeSocket(intptr_t handle) { close((NativeSocket)handle); }
+#endif
+
+// Largest datagram the thread reads, UDP cannot carry more
+static const size_t DATAGRAM_BYTES = 65536;
+
+// Constructor that binds the port and starts the thread
+LiveDataReceiver::LiveDataReceiver(unsigned short port)
+	: ring(new Update[CAPACITY])
+{
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		socket = INVALID_HANDLE;
+		std::cerr << "ERROR::LIVE_DATA::WSASTARTUP_FAILED" << std::endl;
+		return;
+	}
+	socket = (intptr_t)::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#else
+	socket = (intptr_t)::socket(AF_INET, SOCK_DGRAM, 0);
+#endif
+	if (socket == INVALID_HANDLE)
+	{
+		std::cerr << "ERROR::LIVE_DATA::SOCKET_FAILED" << std::endl;
+		return;
+	}
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind((NativeSocket)socket, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		std::cerr << "ERROR::LIVE_DATA::BIND_FAILED port " << port << std::endl;
+		closeSocket(socket);
+		socket = INVALID_HANDLE;
+		return;
+	}
+	// Receiving gives up every 100 ms, so the thread sees a request to stop without the socket being closed under it
+#ifdef _WIN32
+	DWORD timeout = 100;
+#else
+	timeval timeout{ 0, 100000 };
+#endif
+	setsockopt((NativeSocket)socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	// A large receive buffer rides out the frames the render thread takes to drain the ring
+	int bufferBytes = 4 * 1024 * 1024;
+	setsockopt((NativeSocket)socket, SOL_SOCKET, SO_RCVBUF, (const char*)&bufferBytes, sizeof(bufferBytes));
+	thread = std::thread(&LiveDataReceiver::receive, this);
+}
+
+// Stops the thread unless Delete was already called
+LiveDataReceiver::~LiveDataReceiver()
+{
+	Delete();
+}
+
+// Whether the socket could be bound
+bool LiveDataReceiver::isOpen() const
+{
+	return socket != INVALID_HANDLE;
+}
+
+// Copies the oldest updates out of the ring, then lets the thread reuse their slots
+size_t LiveDataReceiver::Drain(Update* out, size_t max)
+{
+	size_t tail = read.load(std::memory_order_relaxed);
+	size_t count = std::min(max, written.load(std::memory_order_acquire) - tail);
+	for (size_t i = 0; i < count; i++)
+		out[i] = ring[(tail + i) % CAPACITY];
+	read.store(tail + count, std::memory_order_release);
+	return count;
+}
+
+// Updates waiting to be drained
+size_t LiveDataReceiver::pending() const
+{
+	return written.load(std::memory_order_acquire) - read.load(std::memory_order_acquire);
+}
+
+// Updates received so far
+uint64_t LiveDataReceiver::received() const
+{
+	return receivedCount.load(std::memory_order_relaxed);
+}
+
+// Updates dropped so far because the ring was full
+uint64_t LiveDataReceiver::dropped() const
+{
+	return droppedCount.load(std::memory_order_relaxed);
+}
+
+// Stops the thread and closes the socket
+void LiveDataReceiver::Delete()
+{
+	if (socket == INVALID_HANDLE)
+		return;
+	stopping = true;
+	if (thread.joinable())
+		thread.join();
+	closeSocket(socket);
+	socket = INVALID_HANDLE;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+// Reads datagrams and publishes each of them with one store
+void LiveDataReceiver::receive()
+{
+	std::unique_ptr<char[]> datagram(new char[DATAGRAM_BYTES]);
+	while (!stopping)
+	{
+		int bytes = (int)recv((NativeSocket)socket, datagram.get(), (int)DATAGRAM_BYTES, 0);
+		if (bytes <= 0)
+			continue;
+		size_t updates = (size_t)bytes / sizeof(Update);
+		size_t head = written.load(std::memory_order_relaxed);
+		size_t room = CAPACITY - (head - read.load(std::memory_order_acquire));
+		size_t kept = std::min(updates, room);
+		// Updates are little endian on the wire like on every platform this runs on, so they are copied as they are
+		for (size_t i = 0; i < kept; i++)
+			std::memcpy(&ring[(head + i) % CAPACITY], datagram.get() + i * sizeof(Update), sizeof(Update));
+		written.store(head + kept, std::memory_order_release);
+		receivedCount.fetch_add(updates, std::memory_order_relaxed);
+		droppedCount.fetch_add(updates - kept, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,63 @@
+#ifndef LIVE_DATA_RECEIVER_CLASS_H
+#define LIVE_DATA_RECEIVER_CLASS_H
+
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<memory>
+#include<thread>
+
+// Receives live per-building metrics, such as energy use or occupancy, as UDP datagrams on a thread of its own
+// A datagram is a packed array of 8 byte updates, a little endian uint32 building index followed by a float32 value
+// the sender scales to 0 to 1. The thread puts a whole datagram into a lock-free single producer, single consumer
+// ring at once and the render thread drains it between frames, so neither ever waits for the other. Updates that
+// arrive while the ring is full are dropped and counted, a later update of the same building replaces them anyway.
+class LiveDataReceiver
+{
+public:
+	// One metric of one building
+	struct Update
+	{
+		uint32_t building;
+		float value;
+	};
+	// Updates the ring holds, more than a frame's worth at tens of thousands a second
+	static constexpr size_t CAPACITY = 1 << 16;
+
+	// Constructor that binds the port on every interface and starts the thread, isOpen tells if that worked
+	LiveDataReceiver(unsigned short port);
+	// Stops the thread unless Delete was already called
+	~LiveDataReceiver();
+	// The thread points back at the receiver, so it can be neither copied nor moved
+	LiveDataReceiver(const LiveDataReceiver&) = delete;
+	LiveDataReceiver& operator=(const LiveDataReceiver&) = delete;
+
+	// Whether the socket could be bound
+	bool isOpen() const;
+	// Consumer side: moves up to max of the oldest updates into out and returns how many
+	size_t Drain(Update* out, size_t max);
+	// Updates waiting to be drained, may be asked from any thread
+	size_t pending() const;
+	// Updates received and dropped so far
+	uint64_t received() const;
+	uint64_t dropped() const;
+
+	// Stops the thread and closes the socket, does nothing if that was already done
+	void Delete();
+private:
+	std::unique_ptr<Update[]> ring;
+	// Updates ever written and read, written by one side each and on their own cache lines
+	alignas(64) std::atomic<size_t> written{ 0 };
+	alignas(64) std::atomic<size_t> read{ 0 };
+	std::atomic<uint64_t> receivedCount{ 0 };
+	std::atomic<uint64_t> droppedCount{ 0 };
+	std::atomic<bool> stopping{ false };
+	// Native socket handle, invalid when it could not be opened
+	intptr_t socket;
+	std::thread thread;
+
+	// Loop of the thread, wakes up a few times a second to see if it has to stop
+	void receive();
+};
+
+#endif
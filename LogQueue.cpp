@@ -0,0 +1,181 @@
+#include"LogQueue.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cstdio>
+#include<iostream>
+
+LogQueue Log;
+
+// Constructor that numbers the slots for the first round
+LogQueue::LogQueue()
+	: slots(new Slot[CAPACITY])
+{
+	static_assert((CAPACITY & (CAPACITY - 1)) == 0, "the ring's capacity has to be a power of two");
+	for (size_t i = 0; i < CAPACITY; i++)
+		slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+LogQueue::~LogQueue()
+{
+	Stop();
+}
+
+// Starts the writer thread
+void LogQueue::Start()
+{
+	if (running.load())
+		return;
+	running.store(true);
+	writer = std::thread(&LogQueue::run, this);
+}
+
+// Stops the writer thread, what was published after its last look is printed here
+void LogQueue::Stop()
+{
+	if (!running.exchange(false))
+		return;
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+	}
+	wake.notify_all();
+	writer.join();
+	drain();
+	if (droppedCount.load() > 0)
+		print(LOG_WARNING, ("Log: " + std::to_string(droppedCount.load()) + " messages dropped with the queue full").c_str());
+	std::cout.flush();
+}
+
+// Waits for the writer thread to print up to the last slot claimed
+void LogQueue::Flush()
+{
+	size_t target = head.load(std::memory_order_acquire);
+	while (running.load() && printed.load(std::memory_order_acquire) < target)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void LogQueue::Write(LogLevel messageLevel, const char* format, ...)
+{
+	if ((int)messageLevel < level.load(std::memory_order_relaxed))
+		return;
+	va_list arguments;
+	va_start(arguments, format);
+	write(messageLevel, 0, format, arguments);
+	va_end(arguments);
+}
+
+void LogQueue::Write(LogSite& site, LogLevel messageLevel, const char* format, ...)
+{
+	if ((int)messageLevel < level.load(std::memory_order_relaxed))
+		return;
+	uint32_t heldBack = 0;
+	if (!allow(site, heldBack))
+		return;
+	va_list arguments;
+	va_start(arguments, format);
+	write(messageLevel, heldBack, format, arguments);
+	va_end(arguments);
+}
+
+// The thread that sees a new second first starts the site's count over and takes what the last one held back
+bool LogQueue::allow(LogSite& site, uint32_t& heldBack)
+{
+	uint32_t rate = siteRate.load(std::memory_order_relaxed);
+	if (rate == 0)
+		return true;
+	int64_t second = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	int64_t siteSecond = site.second.load(std::memory_order_relaxed);
+	if (siteSecond != second && site.second.compare_exchange_strong(siteSecond, second, std::memory_order_relaxed))
+	{
+		site.written.store(1, std::memory_order_relaxed);
+		heldBack = site.suppressed.exchange(0, std::memory_order_relaxed);
+		return true;
+	}
+	if (site.written.fetch_add(1, std::memory_order_relaxed) < rate)
+		return true;
+	site.suppressed.fetch_add(1, std::memory_order_relaxed);
+	suppressedCount.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+// A slot is free for the writer claiming position pos when its sequence is pos, published when it is pos + 1, and
+// free again for the next round when the writer thread sets it to pos + CAPACITY
+void LogQueue::write(LogLevel messageLevel, uint32_t heldBack, const char* format, va_list arguments)
+{
+	if (!running.load(std::memory_order_relaxed))
+	{
+		char text[MESSAGE_BYTES];
+		std::vsnprintf(text, MESSAGE_BYTES, format, arguments);
+		print(messageLevel, text);
+		return;
+	}
+	size_t pos = head.load(std::memory_order_relaxed);
+	Slot* slot;
+	while (true)
+	{
+		slot = &slots[pos & (CAPACITY - 1)];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		if (sequence == pos)
+		{
+			if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (sequence < pos)
+		{
+			droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		else
+			pos = head.load(std::memory_order_relaxed);
+	}
+	slot->level = messageLevel;
+	int length = std::vsnprintf(slot->text, MESSAGE_BYTES, format, arguments);
+	if (heldBack > 0 && length >= 0)
+	{
+		size_t end = std::min((size_t)length, MESSAGE_BYTES - 1);
+		std::snprintf(slot->text + end, MESSAGE_BYTES - end, " (%u more from here suppressed)", heldBack);
+	}
+	slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+// Prints the published slots in order
+size_t LogQueue::drain()
+{
+	size_t count = 0;
+	while (true)
+	{
+		Slot& slot = slots[tail & (CAPACITY - 1)];
+		if (slot.sequence.load(std::memory_order_acquire) != tail + 1)
+			break;
+		print(slot.level, slot.text);
+		slot.sequence.store(tail + CAPACITY, std::memory_order_release);
+		tail++;
+		count++;
+	}
+	if (count > 0)
+		printed.fetch_add(count, std::memory_order_release);
+	return count;
+}
+
+// Looks at the ring every few milliseconds, the standard output is flushed once per batch rather than per message
+void LogQueue::run()
+{
+	while (running.load())
+	{
+		if (drain() > 0)
+		{
+			std::cout.flush();
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wake.wait_for(lock, std::chrono::milliseconds(5), [this] { return !running.load(); });
+	}
+}
+
+void LogQueue::print(LogLevel messageLevel, const char* text)
+{
+	if (messageLevel >= LOG_WARNING)
+		std::cerr << text << '\n';
+	else
+		std::cout << text << '\n';
+}
@@ -0,0 +1,112 @@
+#ifndef LOG_QUEUE_CLASS_H
+#define LOG_QUEUE_CLASS_H
+
+#include<atomic>
+#include<condition_variable>
+#include<cstdarg>
+#include<cstddef>
+#include<cstdint>
+#include<memory>
+#include<mutex>
+#include<thread>
+
+// Severity of a message, messages below the queue's level are dropped where they are written
+enum LogLevel
+{
+	LOG_DEBUG,
+	LOG_INFO,
+	LOG_WARNING,
+	LOG_ERROR
+};
+
+// Where a message is written from, one per call site of LOG_MESSAGE, counts what the site wrote in the current second
+struct LogSite
+{
+	std::atomic<int64_t> second{ -1 };
+	std::atomic<uint32_t> written{ 0 };
+	std::atomic<uint32_t> suppressed{ 0 };
+};
+
+// Messages of every thread go into a fixed ring of slots without a lock and a writer thread of its own prints them,
+// so a thread that logs never waits for the console. A writer claims a slot by moving the head on, formats its
+// message straight into the slot and publishes it through the slot's sequence number. The writer thread takes the
+// slots in order as they are published. A full ring drops the message and counts it rather than blocking, and a
+// call site writing more than siteRate messages a second has the rest counted and reported with its next one.
+// Info and debug messages go to standard output, warnings and errors to standard error. Until Start and after Stop
+// messages are printed on the thread writing them.
+class LogQueue
+{
+public:
+	// Slots of the ring, a power of two, and the longest message with its terminating zero
+	static constexpr size_t CAPACITY = 512;
+	static constexpr size_t MESSAGE_BYTES = 1024;
+
+	// Least severe level written
+	std::atomic<int> level{ LOG_INFO };
+	// Messages a call site may write per second, 0 for no limit
+	std::atomic<uint32_t> siteRate{ 10 };
+
+	LogQueue();
+	// Stops the writer thread, printing what is queued
+	~LogQueue();
+	// LogQueue owns its thread, so it can not be copied
+	LogQueue(const LogQueue&) = delete;
+	LogQueue& operator=(const LogQueue&) = delete;
+
+	// Starts the writer thread
+	void Start();
+	// Prints what is queued and stops the writer thread
+	void Stop();
+	// Blocks until every message written so far is printed
+	void Flush();
+
+	// Queues a printf style message, use LOG_MESSAGE to have it rate limited by its call site
+	void Write(LogLevel level, const char* format, ...);
+	// Same for a call site, whose messages past siteRate in a second are counted instead
+	void Write(LogSite& site, LogLevel level, const char* format, ...);
+
+	// Messages dropped because the ring was full, and those held back by their call site
+	uint64_t dropped() const { return droppedCount.load(); }
+	uint64_t suppressed() const { return suppressedCount.load(); }
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence;
+		LogLevel level;
+		char text[MESSAGE_BYTES];
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	// Next slot a writer claims, and the next one the writer thread prints, which only it touches
+	std::atomic<size_t> head{ 0 };
+	size_t tail = 0;
+	// Slots printed so far, for Flush
+	std::atomic<size_t> printed{ 0 };
+	std::atomic<uint64_t> droppedCount{ 0 };
+	std::atomic<uint64_t> suppressedCount{ 0 };
+
+	std::thread writer;
+	std::atomic<bool> running{ false };
+	// Wakes the writer thread early when it is stopped, it looks at the ring every few milliseconds anyway
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+
+	// Whether a message of a level gets through the call site's limit, a first message after a limited second
+	// reports how many were held back
+	bool allow(LogSite& site, uint32_t& heldBack);
+	// Formats into a claimed slot and publishes it, or prints at once without the writer thread
+	void write(LogLevel level, uint32_t heldBack, const char* format, va_list arguments);
+	// Prints the published slots in order, returns how many
+	size_t drain();
+	// Writer thread
+	void run();
+	static void print(LogLevel level, const char* text);
+};
+
+// The one log of the program
+extern LogQueue Log;
+
+// Writes a printf style message rate limited by the line it is written from
+#define LOG_MESSAGE(level, ...) do { static LogSite logSite; Log.Write(logSite, level, __VA_ARGS__); } while (0)
+
+#endif
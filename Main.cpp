@@ -6,127 +6,1299 @@
 
 #include "stb/stb_image.h"  // Include the header without defining STB_IMAGE_IMPLEMENTATION here
 #include "shaderClass.h"
+#include "CityGenerator.h"
+#include "VAO.h"
+#include "EBO.h"
+#include "GpuBufferHeap.h"
+#include "Frustum.h"
+#include "GLStateCache.h"
+#include "RenderGraph.h"
+#include "RenderQueue.h"
+#include "RenderTargetPool.h"
+#include "Quadtree.h"
+#include "BoundingVolumeHierarchy.h"
+#include "SceneStorage.h"
+#include "InstanceRecords.h"
+#include "LiveDataReceiver.h"
+#include "SceneSync.h"
+#include "LevelOfDetail.h"
+#include "ImpostorAtlas.h"
+#include "OcclusionCuller.h"
+#include "GpuCuller.h"
+#include "GpuCityGenerator.h"
+#include "MeshletCuller.h"
+#include "MeshOptimizer.h"
+#include "TileStreamer.h"
+#include "IoScheduler.h"
+#include "UBO.h"
+#include "StreamBuffer.h"
+#include "CommandList.h"
+#include "DrawCommandBuilder.h"
+#include "Profiler.h"
+#include "Camera.h"
+#include "CameraPath.h"
+#include "Texture.h"
+#include "TextureCache.h"
+#include "SamplerSet.h"
+#include "TextureArray.h"
+#include "TextureLoader.h"
+#include "TextureCooker.h"
+#include "TextureStreamer.h"
+#include "VirtualTexture.h"
+#include "GLExtensions.h"
+#include "ProgramCache.h"
+#include "SpirvShaders.h"
+#include "SceneFile.h"
+#include "AmbientOcclusion.h"
+#include "ObjModel.h"
+#include "GltfModel.h"
+#include "FootprintImporter.h"
+#include "CompactInstance.h"
+#include "CompactVertex.h"
+#include "MeshBatcher.h"
+#include "ClusteredLights.h"
+#include "DeferredRenderer.h"
+#include "ScreenSpaceOcclusion.h"
+#include "TemporalCache.h"
+#include "ShadingRateImage.h"
+#include "PipelineWarmup.h"
+#include "HitchDetector.h"
+#include "MetricsServer.h"
+#include "SessionLog.h"
+#include "StartupTimer.h"
+#include "LogQueue.h"
+#include "LabelLayout.h"
+#include "LabelRenderer.h"
+#include "ReverseDepth.h"
+#include "RenderTarget.h"
+#include "DynamicResolution.h"
+#include "AntiAliasing.h"
+#include "PostProcess.h"
+#include "VolumetricFog.h"
+#include "ImageReadback.h"
+#include "VideoEncoder.h"
+#include "Poster.h"
+#include "HeadlessContext.h"
+#include "FileWatcher.h"
+#include "GLDebugOutput.h"
+#include "GpuMemory.h"
+#include "GpuCalibration.h"
+#include "TraceRecorder.h"
+#include "BenchmarkReport.h"
+#include "Microbenchmark.h"
+#include "FrameQueue.h"
+#include "FramePacer.h"
+#include "FrameScheduler.h"
+#include "Input.h"
+#include "JobSystem.h"
+#include "SimulationClock.h"
+#include "TimeOfDay.h"
+#include "ShadowCascades.h"
+#include "LightShadows.h"
+#include "DecalLibrary.h"
+#include "Terrain.h"
+#include "ObjectPicker.h"
+#include "FrameData.h"
+#include "MaterialTable.h"
+#include "TransparencyPass.h"
+#include "SkyRenderer.h"
+#include "PlanarReflection.h"
+#include "ReflectionProbes.h"
+#include "PropScatter.h"
+#include "RoadNetwork.h"
+#include "RoofLibrary.h"
+#include "TrafficSimulation.h"
+#include "ParticleSystem.h"
+#include "FrameArena.h"
+#include "AllocationCounter.h"
+#include "DebugDraw.h"
+#include "SoftwareOcclusion.h"
+#include "ViewportWindow.h"
+#include "VisibilitySets.h"
+#include "BlockQueries.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <thread>
 #include <vector>
 
 // Settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// Fewest buildings a worker is handed, smaller loops are not worth waking threads for
+const size_t JOB_GRAIN = 4096;
+// Fewest batches a worker records the draws of, each draw is a few commands instead of a building's bounds test
+const size_t RECORD_GRAIN = 256;
+// Frames an on demand run still draws after the last change, temporal effects and queries of the frame before settle
+const int ON_DEMAND_SETTLE_FRAMES = 8;
+// Seconds an idle run sleeps between looks at what GLFW does not wake it for, the live data and the render thread
+const double ON_DEMAND_POLL = 0.1;
+// Chunk every program below includes, so the uniform block is declared once
+const char* frameDataShaderSource = R"(
+// Per frame values shared by every program, laid out like FrameData.h
+layout(std140) uniform FrameData
+{
+    mat4 camMatrix;
+    mat4 view;
+    mat4 projection;
+    vec4 camPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    mat4 sceneModel;
+    vec4 fogColor;
+    vec4 fogParams;
+    vec4 weather;
+    vec4 particleParams;
+    mat4 eyeMatrices[2];
+    vec4 sunDirection;
+    vec4 sunColor;
+};
+
+// Height fog over a color seen along a ray from the camera in world space, the density is averaged along the ray
+// since it falls off exponentially with height
+vec3 heightFog(vec3 color, vec3 ray)
+{
+    float rise = fogParams.x * ray.y;
+    float density = fogColor.w * exp(-fogParams.x * (camPos.y - fogParams.y)) * (abs(rise) > 1e-4 ? (1.0 - exp(-rise)) / rise : 1.0);
+    return mix(fogColor.rgb, color, exp(-density * length(ray)));
+}
+)";
 const char* vertexShaderSource = R"(
 #version 330 core
+#ifdef VERTEX_PULLING
+// The scene heap's vertex buffer at GpuBufferHeap::PULL_BINDING, read by gl_VertexID, which includes the base vertex of the draw
+// With PACKED_MESHLETS it is the tile heap of GpuMeshCodec streams instead, drawn without indices
+layout(std430, binding = 7) readonly buffer Vertices
+{
+    uint vertexWords[];
+};
+#else
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aColor;
 layout(location = 2) in vec2 aTexCoord;
+#endif
+// Per-instance translation, scale, facade layer, level of detail fade and color of a building
+layout(location = 1) in vec3 aColor;
+layout(location = 4) in vec3 aOffset;
+layout(location = 5) in vec3 aScale;
+layout(location = 6) in float aLayer;
+layout(location = 7) in float aFade;
+// Ambient occlusion at the foot of the walls baked by AmbientOcclusion, location 3 is taken by compact normals
+layout(location = 8) in float aOcclusion;
 
 out vec3 ourColor;
 out vec2 TexCoord;
+flat out float Layer;
+flat out float Fade;
+// Every permutation computes the same depth, so a depth pre-pass with one of them lets the shading pass test for GL_EQUAL
+invariant gl_Position;
+#if defined(CLUSTERED) || defined(DEFERRED) || defined(SHADOWS) || defined(GLASS)
+out vec3 ViewPos;
+#endif
+#ifdef SHADOWS
+out vec3 ModelPos;
+#endif
+#ifdef PICKING
+flat out int Instance;
+#endif
+#ifdef STEREO
+out float gl_ClipDistance[1];
+#endif
+#ifdef FOG
+// From the camera to the vertex in world space
+out vec3 FogRay;
+#endif
+#ifdef MATERIALS
+// Where the building stands, which seeds its lit windows, and how far up the wall a vertex is, which stays the same
+// across a roof
+flat out vec2 Building;
+out float Height;
+// From the camera to the vertex in model space, the rooms behind lit windows are traced along it
+out vec3 EyeRay;
+#endif
+
+#include "frame_data.glsl"
+
+#ifdef TERRAIN
+// Heightmap of Terrain, over a square at terrainArea.xy of side terrainArea.z, its white texels terrainArea.w high
+uniform sampler2D heightmap;
+uniform vec4 terrainArea;
+
+float terrainHeight(vec2 position)
+{
+    return textureLod(heightmap, (position - terrainArea.xy) / terrainArea.z, 0.0).r * terrainArea.w;
+}
+#endif
+
+#ifdef PACKED_MESHLETS
+// GpuMeshCodec::MESHLET_SLOTS, MESHLET_WORDS and HEADER_WORDS
+const uint MESHLET_SLOTS = 96u;
+const uint MESHLET_WORDS = 29u;
+const uint HEADER_WORDS = 5u;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// The width lowest bits at bit of the words from word on, a value may run into the next word
+uint readBits(uint word, uint bit, uint width)
+{
+    word += bit >> 5u;
+    bit &= 31u;
+    uint value = vertexWords[word] >> bit;
+    if (bit + width > 32u)
+        value |= vertexWords[word + 1u] << (32u - bit);
+    return value & ((1u << width) - 1u);
+}
+#endif
+
+#ifdef VERTEX_PULLING
+void pullVertex(int vertex, out vec3 position, out vec2 texCoord)
+{
+#if defined(PACKED_MESHLETS)
+    // The vertex ID is a corner of the meshlet in its chunk, its byte of the indices picks a vertex of the meshlet's own
+    // list, whose components are stored as their differences to the meshlet's smallest in as many bits as it needs
+    uint meshlet = uint(vertex) / MESHLET_SLOTS * MESHLET_WORDS;
+    uint slot = uint(vertex) % MESHLET_SLOTS;
+    uint corner = (vertexWords[meshlet + HEADER_WORDS + slot / 4u] >> (slot % 4u * 8u)) & 255u;
+    uvec4 header = uvec4(vertexWords[meshlet + 1u], vertexWords[meshlet + 2u], vertexWords[meshlet + 3u], vertexWords[meshlet + 4u]);
+    uvec3 widths = (header.zzz >> uvec3(16u, 21u, 26u)) & 31u;
+    uvec2 texWidths = (header.ww >> uvec2(0u, 5u)) & 31u;
+    uint data = meshlet + vertexWords[meshlet];
+    uint bit = corner * (widths.x + widths.y + widths.z + texWidths.x + texWidths.y);
+    uvec3 grid = uvec3(header.x & 0xffffu, header.x >> 16u, header.y & 0xffffu);
+    grid.x += readBits(data, bit, widths.x);
+    grid.y += readBits(data, bit + widths.x, widths.y);
+    grid.z += readBits(data, bit + widths.x + widths.y, widths.z);
+    bit += widths.x + widths.y + widths.z;
+    uvec2 texGrid = uvec2(header.y >> 16u, header.z & 0xffffu);
+    texGrid.x += readBits(data, bit, texWidths.x);
+    texGrid.y += readBits(data, bit + texWidths.x, texWidths.y);
+    // The first chunk of the mesh holds the minimum and step of the grid every component was put on
+    uint mesh = meshlet - (header.w >> 10u) * MESHLET_WORDS;
+    position = uintBitsToFloat(uvec3(vertexWords[mesh], vertexWords[mesh + 1u], vertexWords[mesh + 2u]))
+        + uintBitsToFloat(uvec3(vertexWords[mesh + 5u], vertexWords[mesh + 6u], vertexWords[mesh + 7u])) * vec3(grid);
+    texCoord = uintBitsToFloat(uvec2(vertexWords[mesh + 3u], vertexWords[mesh + 4u]))
+        + uintBitsToFloat(uvec2(vertexWords[mesh + 8u], vertexWords[mesh + 9u])) * vec2(texGrid);
+#elif defined(COMPACT_VERTICES)
+    // CompactVertex is four words: the position fractions and their padding, the packed normal, the texture coordinates
+    uint word = uint(vertex) * 4u;
+    position = vec3(unpackUnorm2x16(vertexWords[word]), unpackUnorm2x16(vertexWords[word + 1u]).x);
+    texCoord = unpackUnorm2x16(vertexWords[word + 3u]);
+#else
+    uint word = uint(vertex) * 5u;
+    position = uintBitsToFloat(uvec3(vertexWords[word], vertexWords[word + 1u], vertexWords[word + 2u]));
+    texCoord = uintBitsToFloat(uvec2(vertexWords[word + 3u], vertexWords[word + 4u]));
+#endif
+}
+#endif
+
+#ifdef PROCEDURAL_BOXES
+// CityGenerator::PROCEDURAL_BOX_FIRST
+const int BOX_FIRST = 16777216;
+// Footprint corners of the unit building counter-clockwise from above, each wall runs from one to the next
+const vec2 footprint[4] = vec2[4](vec2(0.0, 1.0), vec2(1.0, 1.0), vec2(1.0, 0.0), vec2(0.0, 0.0));
+
+// Corner of the unit building of CityGenerator: four walls and a roof, two triangles each on the corners 0 1 2 2 3 0
+void boxVertex(int vertex, out vec3 position, out vec2 texCoord)
+{
+    int face = vertex / 6;
+    int corner = (0x032210 >> (vertex % 6 * 4)) & 15;
+    if (face == 4) {
+        position = vec3(footprint[corner].x, 1.0, footprint[corner].y);
+        texCoord = footprint[corner];
+        return;
+    }
+    // Bottom left, bottom right, top right, top left of the wall seen from outside, the facade repeats every 2 units
+    bool right = corner == 1 || corner == 2;
+    bool top = corner >= 2;
+    vec2 ground = footprint[right ? (face + 1) % 4 : face];
+    position = vec3(ground.x, top ? 1.0 : 0.0, ground.y);
+    texCoord = vec2(right ? 0.5 : 0.0, top ? 0.5 : 0.0);
+}
+#endif
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef VERTEX_PULLING
+    vec3 aPos;
+    vec2 aTexCoord;
+#ifdef PROCEDURAL_BOXES
+    if (gl_VertexID >= BOX_FIRST)
+        boxVertex(gl_VertexID - BOX_FIRST, aPos, aTexCoord);
+    else
+#endif
+    pullVertex(gl_VertexID, aPos, aTexCoord);
+#endif
+    vec3 position = aPos * aScale + aOffset;
     ourColor = aColor;
-    TexCoord = aTexCoord;
+    // A record with a negative red carries a live metric from 0 to 1 in green instead, shown from blue to red
+    if (aColor.r < 0.0) {
+        float ramp = clamp(aColor.g, 0.0, 1.0) * 4.0;
+        ourColor = clamp(vec3(ramp - 2.0, ramp < 2.0 ? ramp : 4.0 - ramp, 2.0 - ramp), 0.0, 1.0);
+    }
+    // Darkest at the foot of the walls, gone at the roof
+    ourColor *= 1.0 - aOcclusion * (1.0 - aPos.y);
+    // The unit building repeats the facade once per unit, scaling keeps buildings at the same texel density
+    TexCoord = aTexCoord * vec2(max(aScale.x, aScale.z), aScale.y);
+    Layer = aLayer;
+    Fade = aFade;
+#ifdef TERRAIN
+    // A terrain patch carries its quads a side as Y scale and the range of its level as fade, see Terrain.h
+    if (aLayer < 0.0) {
+        // Compact positions are not exact, the grid vertex is rounded
+        vec2 cell = floor(aPos.xz * aScale.y + 0.5);
+        position.xz = aOffset.xz + cell / aScale.y * aScale.xz;
+        position.y = terrainHeight(position.xz);
+        // Over the last fifth of the range odd vertices slide onto the next coarser grid, the model matrix is rigid
+        // so the view space distance is the distance in the heightmap's space the patches were picked in
+        float morph = clamp(length(vec3(view * sceneModel * vec4(position, 1.0))) / aFade * 5.0 - 4.0, 0.0, 1.0);
+        cell -= mod(cell, 2.0) * morph;
+        position.xz = aOffset.xz + cell / aScale.y * aScale.xz;
+        position.y = terrainHeight(position.xz);
+        // The ground has no normals and is unlit in the forward path, slopes are darkened to show the relief
+        float texel = terrainArea.z / float(textureSize(heightmap, 0).x);
+        vec3 normal = normalize(vec3(terrainHeight(position.xz - vec2(texel, 0.0)) - terrainHeight(position.xz + vec2(texel, 0.0)), 2.0 * texel,
+            terrainHeight(position.xz - vec2(0.0, texel)) - terrainHeight(position.xz + vec2(0.0, texel))));
+        ourColor = aColor * (0.4 + 0.6 * normal.y);
+        TexCoord = vec2(0.0);
+        Layer = 0.0;
+        Fade = 0.0;
+    }
+#endif
+    gl_Position = projection * view * sceneModel * vec4(position, 1.0);
+#ifdef STEREO
+    // Each eye is squeezed into its half of the framebuffer, the clip distance cuts off what would spill into the other
+    float eye = float(gl_InstanceID & 1);
+    gl_Position = eyeMatrices[gl_InstanceID & 1] * sceneModel * vec4(position, 1.0);
+    gl_Position.x = 0.5 * gl_Position.x + (eye - 0.5) * gl_Position.w;
+    gl_ClipDistance[0] = (eye * 2.0 - 1.0) * gl_Position.x;
+#endif
+#if defined(CLUSTERED) || defined(DEFERRED) || defined(SHADOWS) || defined(GLASS)
+    ViewPos = vec3(view * sceneModel * vec4(position, 1.0));
+#endif
+#ifdef SHADOWS
+    // The cascades are rendered in model space, so they stay valid while the city turns
+    ModelPos = position;
+#endif
+#ifdef PICKING
+    Instance = gl_InstanceID;
+#endif
+#ifdef FOG
+    FogRay = vec3(sceneModel * vec4(position, 1.0)) - camPos.xyz;
+#endif
+#ifdef MATERIALS
+    Building = aOffset.xz;
+    Height = aPos.y;
+    // The model matrix is rigid, so the camera is taken into model space by the transposed rotation
+    EyeRay = position - transpose(mat3(sceneModel)) * (camPos.xyz - vec3(sceneModel[3]));
+#endif
 }
 )";
 const char* fragmentShaderSource = R"(
 #version 330 core
 in vec3 ourColor;
 in vec2 TexCoord;
+flat in float Layer;
+flat in float Fade;
+
+layout(location = 0) out vec4 FragColor;
+
+// Every facade is one layer of the same array, so buildings with different facades still share a draw
+uniform sampler2DArray texture1;
+#ifdef MATERIALS
+// Laid out like MaterialData.h, the layer selects the material
+struct Material
+{
+    uvec2 facade;
+    float layer;
+    float specular;
+    vec4 tint;
+    vec4 windows;
+};
+layout(std430, binding = 6) readonly buffer Materials
+{
+    Material materials[];
+};
+#endif
+#ifdef MATERIALS
+flat in vec2 Building;
+in float Height;
+in vec3 EyeRay;
+
+// Window grid of a procedural material, unlit panes are dark, walls between them are the tint
+// Roofs keep the plain wall, their height does not change across them
+// A lit window shows a room behind it without any geometry: the view ray enters a box one cell wide, one cell high
+// and one cell width deep at the pane and the face it leaves through is shaded flat, back wall, side walls, floor
+// or ceiling, dimmer the deeper it is
+vec3 proceduralFacade(Material material, vec2 texCoord)
+{
+    // Derivatives are taken before any branch, the wall's texture coordinate gradients give the tangent frame
+    vec3 dx = dFdx(EyeRay);
+    vec3 dy = dFdy(EyeRay);
+    vec2 uvx = dFdx(texCoord);
+    vec2 uvy = dFdy(texCoord);
+    float wall = fwidth(Height);
+    vec2 cell = texCoord / material.windows.xy;
+    vec2 margin = vec2(0.5 - 0.5 * material.windows.z);
+    vec2 inCell = fract(cell);
+    if (wall == 0.0 || any(lessThan(inCell, margin)) || any(greaterThan(inCell, 1.0 - margin)))
+        return vec3(0.75, 0.72, 0.68);
+    float hash = fract(sin(dot(floor(cell) + Building, vec2(12.9898, 78.233))) * 43758.5453);
+    if (hash >= material.windows.w)
+        return vec3(0.12, 0.15, 0.2);
+
+    vec3 normal = normalize(cross(dx, dy));
+    vec3 xPerp = cross(normal, dx);
+    vec3 yPerp = cross(dy, normal);
+    float area = dot(dx, yPerp);
+    vec3 gradientU = (yPerp * uvx.x + xPerp * uvy.x) / area;
+    vec3 gradientV = (yPerp * uvx.y + xPerp * uvy.y) / area;
+    // The ray in cell units, across, up and into the building
+    vec3 ray = vec3(dot(EyeRay, gradientU), dot(EyeRay, gradientV) * material.windows.x / material.windows.y,
+        abs(dot(EyeRay, normal)) * length(gradientU)) / material.windows.x;
+    vec3 start = vec3(inCell, 0.0);
+    vec3 exits = (step(0.0, ray) - start) / ray;
+    float travel = min(min(exits.x, exits.y), exits.z);
+    float depth = start.z + ray.z * travel;
+    float face = travel == exits.z ? 0.9 : (travel == exits.x ? 0.7 : (ray.y > 0.0 ? 1.0 : 0.45));
+    // Rooms differ in how bright and warm their light is
+    vec3 light = mix(vec3(1.0, 0.86, 0.58), vec3(1.0, 0.95, 0.85), fract(hash * 17.0));
+    return light * face * (1.0 - 0.4 * depth);
+}
+#endif
+#ifdef VIRTUAL_TEXTURE
+// Facade imagery paged in by VirtualTexture, see VirtualTexture.h, a layer picks the slot of its image
+uniform sampler2D virtualCache;
+uniform usampler2D virtualIndirection;
+// Slots a side, texels a side of a slot, images and levels
+uniform vec4 virtualLayout;
+// Texels a side of a page and of its border, and of the cache
+uniform vec4 virtualPages;
+// Pixel of every 8x8 block that asks for its page this frame
+uniform ivec2 virtualCell;
+layout(r32ui, binding = 0) writeonly uniform uimage2D virtualFeedback;
+
+vec4 virtualTexture(float layer, vec2 texCoord)
+{
+    float slots = virtualLayout.x;
+    float slot = mod(floor(layer), virtualLayout.z);
+    vec2 uv = (vec2(mod(slot, slots), floor(slot / slots)) + fract(texCoord)) / slots;
+    // The level comes from the coordinate before it wraps, fract would jump a whole slot at every repeat
+    vec2 dx = dFdx(texCoord) * virtualLayout.y;
+    vec2 dy = dFdy(texCoord) * virtualLayout.y;
+    int level = int(clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))), 0.0, virtualLayout.w - 1.0));
+    int pagesWide = int(slots * virtualLayout.y / virtualPages.x);
+    ivec2 page = min(ivec2(uv * float(pagesWide)) >> level, ivec2(max(pagesWide >> level, 1) - 1));
+    if ((ivec2(gl_FragCoord.xy) & 7) == virtualCell)
+        imageStore(virtualFeedback, ivec2(gl_FragCoord.xy) >> 3, uvec4(uint(level) << 28 | uint(page.y) << 14 | uint(page.x)));
+    // The entry is the page's place in the cache, or that of the nearest ancestor resident
+    uvec4 entry = texelFetch(virtualIndirection, page, level);
+    vec2 inPage = fract(uv * float(max(pagesWide >> int(entry.z), 1)));
+    vec2 texel = vec2(entry.xy) * (virtualPages.x + 2.0 * virtualPages.y) + virtualPages.y + inPage * virtualPages.x;
+    return textureLod(virtualCache, texel / virtualPages.zw, 0.0);
+}
+#endif
+#if defined(CLUSTERED) || defined(DEFERRED) || defined(SHADOWS)
+in vec3 ViewPos;
+#endif
+#ifdef FOG
+in vec3 FogRay;
+#include "frame_data.glsl"
+#endif
+#ifdef CLUSTERED
+// Point lights binned by ClusteredLights, see ClusteredLights.h for the layout of the buffers
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform vec4 clusterScale;
+uniform ivec3 clusterSize;
+#ifdef LIGHT_SHADOWS
+// Shadows of the point lights from LightShadows' atlas, see LightShadows.h for the layout of the tiles
+uniform sampler2DShadow lightShadowAtlas;
+uniform samplerBuffer lightShadowTiles;
+uniform mat3 lightShadowToModel;
+
+// Part of a light shadowed from slot that reaches the point toPoint away from it in view space
+float lightShadow(int slot, vec3 toPoint)
+{
+    // The face is the axis the offset is longest along, its coordinates follow the views LightShadows renders
+    vec3 d = lightShadowToModel * toPoint;
+    vec3 a = abs(d);
+    int face;
+    float major;
+    vec2 st;
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = d.x > 0.0 ? 0 : 1;
+        major = a.x;
+        st = vec2(d.x > 0.0 ? d.z : -d.z, d.y);
+    }
+    else if (a.y >= a.z)
+    {
+        face = d.y > 0.0 ? 2 : 3;
+        major = a.y;
+        st = vec2(d.y > 0.0 ? d.x : -d.x, d.z);
+    }
+    else
+    {
+        face = d.z > 0.0 ? 4 : 5;
+        major = a.z;
+        st = vec2(d.z > 0.0 ? -d.x : d.x, d.y);
+    }
+    vec4 tile = texelFetch(lightShadowTiles, slot * 4 + 3);
+    vec4 corners = texelFetch(lightShadowTiles, slot * 4 + face / 2);
+    // Half a texel inside the tile, filtering never reads the one next to it
+    vec2 uv = ((face & 1) == 0 ? corners.xy : corners.zw) + clamp(st / major * 0.5 + 0.5, tile.w, 1.0 - tile.w) * tile.x;
+    // Compared a texel and a half closer to the light, so lit surfaces do not shadow themselves
+    float distance = max(major * (1.0 - 6.0 * tile.w), tile.y);
+    float depth = (tile.z + tile.y - 2.0 * tile.z * tile.y / distance) / (tile.z - tile.y) * 0.5 + 0.5;
+    return texture(lightShadowAtlas, vec3(uv, depth));
+}
+#endif
+
+// Lights a color, adding the highlights of the lights at a strength
+vec3 clusterLighting(vec3 albedo, float specular)
+{
+    // Vertices carry no normals, the flat normal of the face comes from the screen space derivatives
+    vec3 normal = normalize(cross(dFdx(ViewPos), dFdy(ViewPos)));
+    vec3 toEye = normalize(-ViewPos);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScale.xy), clusterSize.xy - 1);
+    int slice = clamp(int(log(-ViewPos.z) * clusterScale.z + clusterScale.w), 0, clusterSize.z - 1);
+    uvec2 cluster = texelFetch(clusterGrid, (slice * clusterSize.y + tile.y) * clusterSize.x + tile.x).xy;
+    vec3 light = vec3(0.08);
+    vec3 highlight = vec3(0.0);
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        int index = int(texelFetch(clusterIndices, int(cluster.x + i)).x);
+        vec4 position = texelFetch(clusterLights, index * 2);
+        vec3 toLight = position.xyz - ViewPos;
+        float distance = length(toLight);
+        vec3 direction = toLight / max(distance, 1e-4);
+        float falloff = clamp(1.0 - distance / position.w, 0.0, 1.0);
+        vec4 color = texelFetch(clusterLights, index * 2 + 1);
+        vec3 radiance = color.rgb * falloff * falloff;
+#ifdef LIGHT_SHADOWS
+        if (color.w > 0.0)
+            radiance *= lightShadow(int(color.w) - 1, -toLight);
+#endif
+        light += radiance * max(dot(normal, direction), 0.0);
+        highlight += radiance * pow(max(dot(reflect(-direction, normal), toEye), 0.0), 8.0);
+    }
+    return albedo * light + highlight * specular;
+}
+#ifdef DECALS
+// Decals binned into the same clusters, see ClusteredLights.h for the layout, with their images from DecalLibrary
+uniform samplerBuffer clusterDecals;
+uniform sampler2DArray decalImages;
+
+// Projects the decals whose boxes hold the fragment onto its color, in the order they were binned
+vec3 applyDecals(vec3 albedo)
+{
+    // Derivatives are taken before the loop, the fragment's footprint in a box picks the mip level of its image
+    vec3 dx = dFdx(ViewPos);
+    vec3 dy = dFdy(ViewPos);
+    vec3 normal = normalize(cross(dx, dy));
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScale.xy), clusterSize.xy - 1);
+    int slice = clamp(int(log(-ViewPos.z) * clusterScale.z + clusterScale.w), 0, clusterSize.z - 1);
+    uvec4 cluster = texelFetch(clusterGrid, (slice * clusterSize.y + tile.y) * clusterSize.x + tile.x);
+    for (uint i = 0u; i < cluster.w; i++)
+    {
+        int index = int(texelFetch(clusterIndices, int(cluster.z + i)).x);
+        vec4 center = texelFetch(clusterDecals, index * 4);
+        vec4 across = texelFetch(clusterDecals, index * 4 + 1);
+        vec4 up = texelFetch(clusterDecals, index * 4 + 2);
+        vec3 forward = texelFetch(clusterDecals, index * 4 + 3).xyz;
+        vec3 offset = ViewPos - center.xyz;
+        vec3 box = vec3(dot(offset, across.xyz), dot(offset, up.xyz), dot(offset, forward));
+        if (any(greaterThan(abs(box), vec3(1.0))))
+            continue;
+        // Only the surfaces facing the way the decal does take it, not the walls around a corner
+        float facing = smoothstep(0.3, 0.7, dot(normal, normalize(forward)));
+        vec2 gradX = vec2(dot(dx, across.xyz), dot(dx, up.xyz)) * 0.5;
+        vec2 gradY = vec2(dot(dy, across.xyz), dot(dy, up.xyz)) * 0.5;
+        vec4 image = textureGrad(decalImages, vec3(box.xy * 0.5 + 0.5, center.w), gradX, gradY);
+        albedo = mix(albedo, image.rgb, image.a * across.w * facing * (1.0 - box.z * box.z));
+    }
+    return albedo;
+}
+#endif
+#endif
+#ifdef DEFERRED
+// The second target of DeferredRenderer's G-buffer, the color above becomes the unlit albedo
+layout(location = 1) out vec4 Normal;
+#endif
+#ifdef SHADOWS
+// Sun shadows from ShadowCascades, the cascade is picked by the view depth
+in vec3 ModelPos;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[3];
+uniform vec4 cascadeSplits;
+
+float sunShadow()
+{
+    float depth = -ViewPos.z;
+    if (depth >= cascadeSplits.z)
+        return 1.0;
+    int cascade = depth < cascadeSplits.x ? 0 : (depth < cascadeSplits.y ? 1 : 2);
+    vec4 coord = shadowMatrices[cascade] * vec4(ModelPos, 1.0);
+    return mix(0.5, 1.0, texture(shadowMap, vec4(coord.xy, float(cascade), coord.z)));
+}
+#endif
+
+// LIGHTING is defined for the lit permutation, the unlit one never samples the facade
+// MATERIALS looks the facade layer, tint and highlights up in MaterialTable, without it the layer is the facade's
+// GLASS leaves the materials that are not opaque to the glass program
+// CLUSTERED is added on top of it when the city has point lights, which then light the facade instead of the ambient
+// LIGHT_SHADOWS shadows the point lights that LightShadows gave a slot of its atlas
+// DECALS projects the decals binned into the same clusters onto the facade color before it is lit
+// DEFERRED writes the same color unlit into DeferredRenderer's G-buffer together with the face normal
+// SHADOWS darkens the lit color where the sun is blocked, before any point light is added
+// VIRTUAL_TEXTURE takes the facade from VirtualTexture's cache instead of the array and writes the feedback
+void main()
+{
+    // Crossfading levels of detail keep complementary halves of the dither pattern, see LevelOfDetail.h
+    float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    if (Fade > 0.0 ? dither < Fade : (Fade < 0.0 && dither >= 1.0 + Fade))
+        discard;
+#ifdef MATERIALS
+    Material material = materials[min(int(Layer), materials.length() - 1)];
+#ifdef GLASS
+    // Glass is drawn by TransparencyPass after everything opaque
+    if (material.tint.a < 1.0)
+        discard;
+#endif
+    float layer = material.layer;
+    vec3 tint = material.tint.rgb;
+    float specular = material.specular;
+#else
+    float layer = Layer;
+    vec3 tint = vec3(1.0);
+    float specular = 0.0;
+#endif
+#ifdef LIGHTING
+#ifdef MATERIALS
+    if (material.windows.x > 0.0)
+        FragColor = vec4(proceduralFacade(material, TexCoord) * ourColor * tint, 1.0);
+    else
+#endif
+#ifdef VIRTUAL_TEXTURE
+    FragColor = virtualTexture(layer, TexCoord) * vec4(ourColor * tint, 1.0);
+#else
+    FragColor = texture(texture1, vec3(TexCoord, layer)) * vec4(ourColor * tint, 1.0);
+#endif
+#ifdef DECALS
+    FragColor.rgb = applyDecals(FragColor.rgb);
+#endif
+#ifdef SHADOWS
+    FragColor.rgb *= sunShadow();
+#endif
+#ifndef CLUSTERED
+    // The daylight of the time of day, the point lights light the facades on their own
+    FragColor.rgb *= sunColor.rgb;
+#endif
+#else
+    FragColor = vec4(ourColor, 1.0);
+#endif
+#ifdef CLUSTERED
+    FragColor.rgb = clusterLighting(FragColor.rgb, specular);
+#endif
+#ifdef FOG
+    FragColor.rgb = heightFog(FragColor.rgb, FogRay);
+#endif
+#ifdef DEFERRED
+    Normal = vec4(normalize(cross(dFdx(ViewPos), dFdy(ViewPos))), 1.0);
+#endif
+}
+)";
+// Same as above but the facade comes from a bindless handle in the material buffer, nothing is bound per texture
+const char* bindlessFragmentShaderSource = R"(
+#version 430 core
+#extension GL_ARB_bindless_texture : require
+in vec3 ourColor;
+in vec2 TexCoord;
+flat in float Layer;
+flat in float Fade;
+
+layout(location = 0) out vec4 FragColor;
+
+// Laid out like MaterialData.h, the layer selects the material
+struct Material
+{
+    uvec2 facade;
+    float layer;
+    float specular;
+    vec4 tint;
+    vec4 windows;
+};
+layout(std430, binding = 6) readonly buffer Materials
+{
+    Material materials[];
+};
+#ifdef MATERIALS
+flat in vec2 Building;
+in float Height;
+in vec3 EyeRay;
+
+// Window grid of a procedural material, unlit panes are dark, walls between them are the tint
+// Roofs keep the plain wall, their height does not change across them
+// A lit window shows a room behind it without any geometry: the view ray enters a box one cell wide, one cell high
+// and one cell width deep at the pane and the face it leaves through is shaded flat, back wall, side walls, floor
+// or ceiling, dimmer the deeper it is
+vec3 proceduralFacade(Material material, vec2 texCoord)
+{
+    // Derivatives are taken before any branch, the wall's texture coordinate gradients give the tangent frame
+    vec3 dx = dFdx(EyeRay);
+    vec3 dy = dFdy(EyeRay);
+    vec2 uvx = dFdx(texCoord);
+    vec2 uvy = dFdy(texCoord);
+    float wall = fwidth(Height);
+    vec2 cell = texCoord / material.windows.xy;
+    vec2 margin = vec2(0.5 - 0.5 * material.windows.z);
+    vec2 inCell = fract(cell);
+    if (wall == 0.0 || any(lessThan(inCell, margin)) || any(greaterThan(inCell, 1.0 - margin)))
+        return vec3(0.75, 0.72, 0.68);
+    float hash = fract(sin(dot(floor(cell) + Building, vec2(12.9898, 78.233))) * 43758.5453);
+    if (hash >= material.windows.w)
+        return vec3(0.12, 0.15, 0.2);
+
+    vec3 normal = normalize(cross(dx, dy));
+    vec3 xPerp = cross(normal, dx);
+    vec3 yPerp = cross(dy, normal);
+    float area = dot(dx, yPerp);
+    vec3 gradientU = (yPerp * uvx.x + xPerp * uvy.x) / area;
+    vec3 gradientV = (yPerp * uvx.y + xPerp * uvy.y) / area;
+    // The ray in cell units, across, up and into the building
+    vec3 ray = vec3(dot(EyeRay, gradientU), dot(EyeRay, gradientV) * material.windows.x / material.windows.y,
+        abs(dot(EyeRay, normal)) * length(gradientU)) / material.windows.x;
+    vec3 start = vec3(inCell, 0.0);
+    vec3 exits = (step(0.0, ray) - start) / ray;
+    float travel = min(min(exits.x, exits.y), exits.z);
+    float depth = start.z + ray.z * travel;
+    float face = travel == exits.z ? 0.9 : (travel == exits.x ? 0.7 : (ray.y > 0.0 ? 1.0 : 0.45));
+    // Rooms differ in how bright and warm their light is
+    vec3 light = mix(vec3(1.0, 0.86, 0.58), vec3(1.0, 0.95, 0.85), fract(hash * 17.0));
+    return light * face * (1.0 - 0.4 * depth);
+}
+#endif
+#if defined(CLUSTERED) || defined(DEFERRED) || defined(SHADOWS)
+in vec3 ViewPos;
+#endif
+#ifdef FOG
+in vec3 FogRay;
+#include "frame_data.glsl"
+#endif
+#ifdef CLUSTERED
+// Point lights binned by ClusteredLights, see ClusteredLights.h for the layout of the buffers
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform vec4 clusterScale;
+uniform ivec3 clusterSize;
+#ifdef LIGHT_SHADOWS
+// Shadows of the point lights from LightShadows' atlas, see LightShadows.h for the layout of the tiles
+uniform sampler2DShadow lightShadowAtlas;
+uniform samplerBuffer lightShadowTiles;
+uniform mat3 lightShadowToModel;
+
+// Part of a light shadowed from slot that reaches the point toPoint away from it in view space
+float lightShadow(int slot, vec3 toPoint)
+{
+    // The face is the axis the offset is longest along, its coordinates follow the views LightShadows renders
+    vec3 d = lightShadowToModel * toPoint;
+    vec3 a = abs(d);
+    int face;
+    float major;
+    vec2 st;
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = d.x > 0.0 ? 0 : 1;
+        major = a.x;
+        st = vec2(d.x > 0.0 ? d.z : -d.z, d.y);
+    }
+    else if (a.y >= a.z)
+    {
+        face = d.y > 0.0 ? 2 : 3;
+        major = a.y;
+        st = vec2(d.y > 0.0 ? d.x : -d.x, d.z);
+    }
+    else
+    {
+        face = d.z > 0.0 ? 4 : 5;
+        major = a.z;
+        st = vec2(d.z > 0.0 ? -d.x : d.x, d.y);
+    }
+    vec4 tile = texelFetch(lightShadowTiles, slot * 4 + 3);
+    vec4 corners = texelFetch(lightShadowTiles, slot * 4 + face / 2);
+    // Half a texel inside the tile, filtering never reads the one next to it
+    vec2 uv = ((face & 1) == 0 ? corners.xy : corners.zw) + clamp(st / major * 0.5 + 0.5, tile.w, 1.0 - tile.w) * tile.x;
+    // Compared a texel and a half closer to the light, so lit surfaces do not shadow themselves
+    float distance = max(major * (1.0 - 6.0 * tile.w), tile.y);
+    float depth = (tile.z + tile.y - 2.0 * tile.z * tile.y / distance) / (tile.z - tile.y) * 0.5 + 0.5;
+    return texture(lightShadowAtlas, vec3(uv, depth));
+}
+#endif
+
+// Lights a color, adding the highlights of the lights at a strength
+vec3 clusterLighting(vec3 albedo, float specular)
+{
+    // Vertices carry no normals, the flat normal of the face comes from the screen space derivatives
+    vec3 normal = normalize(cross(dFdx(ViewPos), dFdy(ViewPos)));
+    vec3 toEye = normalize(-ViewPos);
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScale.xy), clusterSize.xy - 1);
+    int slice = clamp(int(log(-ViewPos.z) * clusterScale.z + clusterScale.w), 0, clusterSize.z - 1);
+    uvec2 cluster = texelFetch(clusterGrid, (slice * clusterSize.y + tile.y) * clusterSize.x + tile.x).xy;
+    vec3 light = vec3(0.08);
+    vec3 highlight = vec3(0.0);
+    for (uint i = 0u; i < cluster.y; i++)
+    {
+        int index = int(texelFetch(clusterIndices, int(cluster.x + i)).x);
+        vec4 position = texelFetch(clusterLights, index * 2);
+        vec3 toLight = position.xyz - ViewPos;
+        float distance = length(toLight);
+        vec3 direction = toLight / max(distance, 1e-4);
+        float falloff = clamp(1.0 - distance / position.w, 0.0, 1.0);
+        vec4 color = texelFetch(clusterLights, index * 2 + 1);
+        vec3 radiance = color.rgb * falloff * falloff;
+#ifdef LIGHT_SHADOWS
+        if (color.w > 0.0)
+            radiance *= lightShadow(int(color.w) - 1, -toLight);
+#endif
+        light += radiance * max(dot(normal, direction), 0.0);
+        highlight += radiance * pow(max(dot(reflect(-direction, normal), toEye), 0.0), 8.0);
+    }
+    return albedo * light + highlight * specular;
+}
+#ifdef DECALS
+// Decals binned into the same clusters, see ClusteredLights.h for the layout, with their images from DecalLibrary
+uniform samplerBuffer clusterDecals;
+uniform sampler2DArray decalImages;
+
+// Projects the decals whose boxes hold the fragment onto its color, in the order they were binned
+vec3 applyDecals(vec3 albedo)
+{
+    // Derivatives are taken before the loop, the fragment's footprint in a box picks the mip level of its image
+    vec3 dx = dFdx(ViewPos);
+    vec3 dy = dFdy(ViewPos);
+    vec3 normal = normalize(cross(dx, dy));
+    ivec2 tile = min(ivec2(gl_FragCoord.xy * clusterScale.xy), clusterSize.xy - 1);
+    int slice = clamp(int(log(-ViewPos.z) * clusterScale.z + clusterScale.w), 0, clusterSize.z - 1);
+    uvec4 cluster = texelFetch(clusterGrid, (slice * clusterSize.y + tile.y) * clusterSize.x + tile.x);
+    for (uint i = 0u; i < cluster.w; i++)
+    {
+        int index = int(texelFetch(clusterIndices, int(cluster.z + i)).x);
+        vec4 center = texelFetch(clusterDecals, index * 4);
+        vec4 across = texelFetch(clusterDecals, index * 4 + 1);
+        vec4 up = texelFetch(clusterDecals, index * 4 + 2);
+        vec3 forward = texelFetch(clusterDecals, index * 4 + 3).xyz;
+        vec3 offset = ViewPos - center.xyz;
+        vec3 box = vec3(dot(offset, across.xyz), dot(offset, up.xyz), dot(offset, forward));
+        if (any(greaterThan(abs(box), vec3(1.0))))
+            continue;
+        // Only the surfaces facing the way the decal does take it, not the walls around a corner
+        float facing = smoothstep(0.3, 0.7, dot(normal, normalize(forward)));
+        vec2 gradX = vec2(dot(dx, across.xyz), dot(dx, up.xyz)) * 0.5;
+        vec2 gradY = vec2(dot(dy, across.xyz), dot(dy, up.xyz)) * 0.5;
+        vec4 image = textureGrad(decalImages, vec3(box.xy * 0.5 + 0.5, center.w), gradX, gradY);
+        albedo = mix(albedo, image.rgb, image.a * across.w * facing * (1.0 - box.z * box.z));
+    }
+    return albedo;
+}
+#endif
+#endif
+#ifdef DEFERRED
+// The second target of DeferredRenderer's G-buffer, the color above becomes the unlit albedo
+layout(location = 1) out vec4 Normal;
+#endif
+#ifdef SHADOWS
+// Sun shadows from ShadowCascades, the cascade is picked by the view depth
+in vec3 ModelPos;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[3];
+uniform vec4 cascadeSplits;
+
+float sunShadow()
+{
+    float depth = -ViewPos.z;
+    if (depth >= cascadeSplits.z)
+        return 1.0;
+    int cascade = depth < cascadeSplits.x ? 0 : (depth < cascadeSplits.y ? 1 : 2);
+    vec4 coord = shadowMatrices[cascade] * vec4(ModelPos, 1.0);
+    return mix(0.5, 1.0, texture(shadowMap, vec4(coord.xy, float(cascade), coord.z)));
+}
+#endif
+
+void main()
+{
+    float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    if (Fade > 0.0 ? dither < Fade : (Fade < 0.0 && dither >= 1.0 + Fade))
+        discard;
+    Material material = materials[min(int(Layer), materials.length() - 1)];
+#ifdef GLASS
+    if (material.tint.a < 1.0)
+        discard;
+#endif
+#ifdef LIGHTING
+#ifdef MATERIALS
+    // Procedural materials have no texture and a handle of 0
+    if (material.windows.x > 0.0)
+        FragColor = vec4(proceduralFacade(material, TexCoord) * ourColor * material.tint.rgb, 1.0);
+    else
+#endif
+    FragColor = texture(sampler2D(material.facade), TexCoord) * vec4(ourColor * material.tint.rgb, 1.0);
+#ifdef DECALS
+    FragColor.rgb = applyDecals(FragColor.rgb);
+#endif
+#ifdef SHADOWS
+    FragColor.rgb *= sunShadow();
+#endif
+#ifndef CLUSTERED
+    // The daylight of the time of day, the point lights light the facades on their own
+    FragColor.rgb *= sunColor.rgb;
+#endif
+#else
+    FragColor = vec4(ourColor, 1.0);
+#endif
+#ifdef CLUSTERED
+    FragColor.rgb = clusterLighting(FragColor.rgb, material.specular);
+#endif
+#ifdef FOG
+    FragColor.rgb = heightFog(FragColor.rgb, FogRay);
+#endif
+#ifdef DEFERRED
+    Normal = vec4(normalize(cross(dFdx(ViewPos), dFdy(ViewPos))), 1.0);
+#endif
+}
+)";
+// Far blocks as a quad turned towards the camera around the Y axis, showing the baked view closest to the camera's azimuth
+const char* billboardVertexShaderSource = R"(
+#version 330 core
+// Per-billboard bottom center, half width, height and atlas layer of a block, laid out like ImpostorAtlas::WriteRecord
+layout(location = 0) in vec3 aBase;
+layout(location = 1) in vec2 aSize;
+layout(location = 2) in float aLayer;
+
+out vec3 TexCoord;
+#ifdef FOG
+out vec3 FogRay;
+#endif
+
+// Number of views baked around every block
+uniform int views;
+#include "frame_data.glsl"
+
+void main()
+{
+    // Corners of a triangle strip from the vertex index, no vertex buffer needed
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    vec3 base = vec3(sceneModel * vec4(aBase, 1.0));
+    vec3 toCamera = vec3(camPos.x - base.x, 0.0, camPos.z - base.z);
+    vec3 right = normalize(cross(vec3(0.0, 1.0, 0.0), toCamera));
+    vec3 position = base + right * (corner.x * 2.0 - 1.0) * aSize.x + vec3(0.0, corner.y * aSize.y, 0.0);
+    gl_Position = camMatrix * vec4(position, 1.0);
+#ifdef FOG
+    FogRay = position - camPos.xyz;
+#endif
+
+    // Views were baked in model space, the azimuth is offset by a full turn so the modulo never sees a negative value
+    vec3 local = transpose(mat3(sceneModel)) * toCamera;
+    int cell = int(floor(atan(local.x, local.z) * float(views) / 6.28318531 + 0.5 + float(views))) % views;
+    TexCoord = vec3((float(cell) + corner.x) / float(views), corner.y, aLayer);
+}
+)";
+const char* billboardFragmentShaderSource = R"(
+#version 330 core
+in vec3 TexCoord;
 
 out vec4 FragColor;
 
-uniform sampler2D texture1;
-uniform bool lightOn;
+uniform sampler2DArray impostors;
+// Added to the mip level, the water's reflection reads the atlas blurrier than the camera does
+uniform float lodBias;
+#ifdef FOG
+in vec3 FogRay;
+#include "frame_data.glsl"
+#endif
 
 void main()
 {
-    vec4 texColor = texture(texture1, TexCoord);
-    if (lightOn) {
-        FragColor = texColor * vec4(ourColor, 1.0);
-    } else {
-        FragColor = vec4(ourColor, 1.0);
+    // Cells are cleared to transparent around the block
+    vec4 color = texture(impostors, TexCoord, lodBias);
+    if (color.a < 0.5)
+        discard;
+    FragColor = vec4(color.rgb, 1.0);
+#ifdef FOG
+    FragColor.rgb = heightFog(FragColor.rgb, FogRay);
+#endif
+}
+)";
+// Writes the ID of what is drawn into ObjectPicker's target, with the scene vertex shader specialized for PICKING
+const char* pickFragmentShaderSource = R"(
+#version 330 core
+flat in int Instance;
+
+layout(location = 0) out uint ObjectId;
+
+// 0 is nothing or the ground, instances are numbered from firstId and firstId 0 draws them all as 0
+// With idTriangles set a merged mesh is numbered instead, idTriangles triangles per ID after skipTriangles that are 0
+uniform int firstId;
+uniform int idTriangles;
+uniform int skipTriangles;
+
+void main()
+{
+    if (idTriangles > 0)
+        ObjectId = gl_PrimitiveID < skipTriangles ? 0u : uint(firstId + (gl_PrimitiveID - skipTriangles) / idTriangles);
+    else
+        ObjectId = firstId == 0 ? 0u : uint(firstId + Instance);
+}
+)";
+// Glass facades into TransparencyPass's targets, with the scene vertex shader specialized for GLASS and MATERIALS
+const char* glassFragmentShaderSource = R"(
+#version 430 core
+in vec3 ourColor;
+in vec2 TexCoord;
+flat in float Layer;
+flat in float Fade;
+in vec3 ViewPos;
+
+// Weighted color and what is let through, and the weight, summed by TransparencyPass's blending
+layout(location = 0) out vec4 Accumulation;
+layout(location = 1) out vec4 Weight;
+
+// Laid out like MaterialData.h, the layer selects the material, the tint's alpha is the glass's
+struct Material
+{
+    uvec2 facade;
+    float layer;
+    float specular;
+    vec4 tint;
+    vec4 windows;
+};
+layout(std430, binding = 6) readonly buffer Materials
+{
+    Material materials[];
+};
+// Depth of the opaque scene copied by TransparencyPass, glass behind it is dropped here instead of by a depth test
+uniform sampler2D opaqueDepth;
+uniform int reverseZ;
+
+#ifdef PROBES
+// ReflectionProbes' cube maps with the centers and boxes of the ones that are ready, and the camera, all in model space
+in vec3 EyeRay;
+uniform samplerCubeArray probes;
+uniform int probeCount;
+uniform float probeLevels;
+uniform vec3 probeEye;
+uniform vec3 probeCenters[16];
+uniform vec3 probeMin[16];
+uniform vec3 probeMax[16];
+
+// What the nearest probe sees along a reflected ray, which is cut off where it leaves the probe's box so the
+// reflection lines up with the buildings around it, blurrier the rougher the glass
+vec3 probeReflection(vec3 position, vec3 ray, float roughness, vec3 sky)
+{
+    if (probeCount == 0)
+        return sky;
+    int nearest = 0;
+    float nearestDistance = 1e30;
+    for (int i = 0; i < probeCount; i++)
+    {
+        vec3 offset = position - probeCenters[i];
+        if (dot(offset, offset) < nearestDistance)
+        {
+            nearestDistance = dot(offset, offset);
+            nearest = i;
+        }
     }
+    vec3 exits = max((probeMax[nearest] - position) / ray, (probeMin[nearest] - position) / ray);
+    float travel = max(min(min(exits.x, exits.y), exits.z), 0.0);
+    vec3 direction = position + ray * travel - probeCenters[nearest];
+    return textureLod(probes, vec4(direction, float(nearest)), roughness * (probeLevels - 1.0)).rgb;
+}
+#endif
+
+void main()
+{
+    // The flat normal of the face, taken before any fragment of the quad is discarded
+    vec3 normal = normalize(cross(dFdx(ViewPos), dFdy(ViewPos)));
+#ifdef PROBES
+    vec3 modelNormal = normalize(cross(dFdx(EyeRay), dFdy(EyeRay)));
+    if (dot(modelNormal, EyeRay) > 0.0)
+        modelNormal = -modelNormal;
+#endif
+    float dither = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    if (Fade > 0.0 ? dither < Fade : (Fade < 0.0 && dither >= 1.0 + Fade))
+        discard;
+    Material material = materials[min(int(Layer), materials.length() - 1)];
+    float opaque = texelFetch(opaqueDepth, ivec2(gl_FragCoord.xy), 0).r;
+    if (material.tint.a >= 1.0 || (reverseZ != 0 ? gl_FragCoord.z <= opaque : gl_FragCoord.z >= opaque))
+        discard;
+
+    // Panes reflect more of the sky the more grazing they are seen, as much as the material's highlights allow
+    float fresnel = pow(1.0 - abs(dot(normal, normalize(-ViewPos))), 5.0) * material.specular;
+    vec3 sky = vec3(0.75, 0.82, 0.9);
+#ifdef PROBES
+    // The glossier the glass, the sharper its reflection
+    sky = probeReflection(probeEye + EyeRay, reflect(normalize(EyeRay), modelNormal), 1.0 - material.specular, sky);
+#endif
+    vec3 color = mix(ourColor * material.tint.rgb, sky, fresnel);
+    float alpha = mix(material.tint.a, 1.0, fresnel);
+    // Near panes outweigh far ones, so the unsorted sum still looks like the front pane over the ones behind
+    float distance = abs(ViewPos.z);
+    float weight = alpha * clamp(10.0 / (1e-5 + pow(distance / 5.0, 2.0) + pow(distance / 200.0, 6.0)), 1e-2, 3e3);
+    Accumulation = vec4(color * alpha * weight, alpha);
+    Weight = vec4(alpha * weight);
 }
 )";
-GLuint createShaderProgram() {
-    // Vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
-    glCompileShader(vertexShader);
+// The built in sources of the programs below, with --hot-reload each is kept in a file of this name and read from it
+// The chunk they include is registered with Shader::AddInclude under its file name
+// The light markers are the exception, their built in source is light.vert and light.frag as shaderClass embeds them
+enum ShaderFile { SCENE_VERTEX, SCENE_FRAGMENT, BINDLESS_FRAGMENT, BILLBOARD_VERTEX, BILLBOARD_FRAGMENT, PICK_FRAGMENT, GLASS_FRAGMENT, LIGHT_VERTEX, LIGHT_FRAGMENT, FRAME_DATA_INCLUDE, SHADER_FILE_COUNT };
+const char* shaderFileNames[SHADER_FILE_COUNT] = { "scene.vert", "scene.frag", "bindless.frag", "billboard.vert", "billboard.frag", "pick.frag", "glass.frag", "light.vert", "light.frag", "frame_data.glsl" };
+
+// A program handed to the driver whose compile results have not been asked for yet
+struct ProgramBuild {
+    GLuint program = 0;
+    GLuint vertexShader = 0;
+    GLuint fragmentShader = 0;
+    // Sources after their includes are resolved and they are specialized, which is also what the program cache is keyed by
+    std::string vertexSource;
+    std::string fragmentSource;
+};
+
+// Starts compiling and linking a program specialized for a ShaderFeature mask, nothing waits for the compiler until finishShaderProgram
+ProgramBuild submitShaderProgram(const char* fragmentSource, unsigned int features, const char* vertexSource = vertexShaderSource) {
+    ProgramBuild build;
+    build.vertexSource = Shader::Specialize(Shader::Preprocess(vertexSource, ""), features);
+    build.fragmentSource = Shader::Specialize(Shader::Preprocess(fragmentSource, ""), features);
+    SpirvShaders::Dump(build.vertexSource, build.fragmentSource);
+    // A binary linked by an earlier launch on the same driver skips compiling altogether
+    build.program = ProgramCache::Load(build.vertexSource, build.fragmentSource);
+    if (build.program)
+        return build;
+
+    // SPIR-V compiled offline from these exact sources skips the GLSL compiler, the GLSL is the fallback
+    if (!SpirvShaders::Load(build.vertexSource, build.fragmentSource, build.vertexShader, build.fragmentShader)) {
+        // Vertex shader
+        const char* vertexCode = build.vertexSource.c_str();
+        build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(build.vertexShader, 1, &vertexCode, nullptr);
+        glCompileShader(build.vertexShader);
+
+        // Fragment shader
+        const char* fragmentCode = build.fragmentSource.c_str();
+        build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(build.fragmentShader, 1, &fragmentCode, nullptr);
+        glCompileShader(build.fragmentShader);
+    }
+
+    // Link shaders, the driver queues this behind the compiles
+    build.program = glCreateProgram();
+    glAttachShader(build.program, build.vertexShader);
+    glAttachShader(build.program, build.fragmentShader);
+    ProgramCache::PrepareLink(build.program);
+    glLinkProgram(build.program);
+    return build;
+}
+
+// Waits for a submitted program, reports its errors and caches it
+GLuint finishShaderProgram(ProgramBuild& build) {
+    if (!build.vertexShader)
+        return build.program;
 
-    // Check for vertex shader compilation errors
+    // Check for compilation errors
     GLint success;
     GLchar infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(build.vertexShader, GL_COMPILE_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glGetShaderInfoLog(build.vertexShader, 512, nullptr, infoLog);
+        LOG_MESSAGE(LOG_ERROR, "SHADER_COMPILATION_ERROR for:VERTEX\n%s", infoLog);
     }
-
-    // Fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    // Check for fragment shader compilation errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(build.fragmentShader, GL_COMPILE_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glGetShaderInfoLog(build.fragmentShader, 512, nullptr, infoLog);
+        LOG_MESSAGE(LOG_ERROR, "SHADER_COMPILATION_ERROR for:FRAGMENT\n%s", infoLog);
     }
 
-    // Link shaders
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
     // Check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    glGetProgramiv(build.program, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+        glGetProgramInfoLog(build.program, 512, nullptr, infoLog);
+        LOG_MESSAGE(LOG_ERROR, "SHADER_LINKING_ERROR for:PROGRAM\n%s", infoLog);
+    } else {
+        ProgramCache::Store(build.program, build.vertexSource, build.fragmentSource);
     }
 
     // Clean up shaders as they're linked into our program now and no longer needed
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    glDeleteShader(build.vertexShader);
+    glDeleteShader(build.fragmentShader);
+    build.vertexShader = build.fragmentShader = 0;
+    return build.program;
+}
 
-    return shaderProgram;
+// Checks if the driver is done with a submitted program, only KHR_parallel_shader_compile can tell without waiting
+bool shaderProgramReady(const ProgramBuild& build) {
+    if (!build.vertexShader || !GLExt.parallelShaderCompile)
+        return true;
+    GLint completed = GL_FALSE;
+    glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed != GL_FALSE;
 }
 
-GLFWwindow* initGLFWandGLAD() {
+GLFWwindow* initGLFWandGLAD(bool hidden, bool debug, StartupTimer& startup) {
     // Initialize GLFW
     if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW" << std::endl;
+        Log.Write(LOG_ERROR, "Failed to initialize GLFW");
         exit(EXIT_FAILURE);
     }
+    startup.Mark("glfw init");
 
-    // Set GLFW to use OpenGL 3.3 core profile
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    // Core profile, the version is picked below
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Benchmarks render into a window that is never shown
+    if (hidden)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    // Debug contexts are the only ones the driver is obliged to report everything from
+    if (debug)
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
 
-    // Create a windowed mode window and its OpenGL context
-    GLFWwindow* window = glfwCreateWindow(800, 600, "OpenGL 3D Surface with Buildings", nullptr, nullptr);
+    // Create a windowed mode window and the newest OpenGL context the driver has, down to 3.3
+    GLFWwindow* window = nullptr;
+    for (const int* version : GL_CONTEXT_VERSIONS) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        window = glfwCreateWindow(800, 600, "OpenGL 3D Surface with Buildings", nullptr, nullptr);
+        if (window)
+            break;
+    }
     if (!window) {
-        std::cerr << "Failed to create GLFW window" << std::endl;
+        Log.Write(LOG_ERROR, "Failed to create GLFW window");
         glfwTerminate();
         exit(EXIT_FAILURE);
     }
 
     // Make the window's context current
     glfwMakeContextCurrent(window);
+    startup.Mark("window");
 
     // Load OpenGL functions using GLAD
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cerr << "Failed to initialize GLAD" << std::endl;
+        Log.Write(LOG_ERROR, "Failed to initialize GLAD");
         exit(EXIT_FAILURE);
     }
+    // Entry points newer than GL 3.3, used when the driver has them
+    LoadGLExtensions((GLADloadproc)glfwGetProcAddress);
+    Log.Write(LOG_INFO, "OpenGL %d.%d on %s", GLExt.major, GLExt.minor, (const char*)glGetString(GL_RENDERER));
+    startup.Mark("gl loader");
 
     // Set the viewport
     int width, height;
@@ -135,247 +1307,5088 @@ GLFWwindow* initGLFWandGLAD() {
 
     return window;
 }
-class Camera {
-public:
-    glm::vec3 Position;
-    glm::vec3 Front;
-    glm::vec3 Up;
-    glm::vec3 Right;
-    glm::vec3 WorldUp;
-
-    float Yaw;
-    float Pitch;
-    float MovementSpeed;
-    float MouseSensitivity;
-    float Zoom;
-
-    Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch)
-        : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(2.5f), MouseSensitivity(0.1f), Zoom(45.0f) {
-        Position = position;
-        WorldUp = up;
-        Yaw = yaw;
-        Pitch = pitch;
-        updateCameraVectors();
-    }
-
-    glm::mat4 GetViewMatrix() {
-        return glm::lookAt(Position, Position + Front, Up);
-    }
-
-    void ProcessKeyboard(int direction, float deltaTime) {
-        float velocity = MovementSpeed * deltaTime;
-        if (direction == GLFW_KEY_W)
-            Position += Front * velocity;
-        if (direction == GLFW_KEY_S)
-            Position -= Front * velocity;
-        if (direction == GLFW_KEY_A)
-            Position -= Right * velocity;
-        if (direction == GLFW_KEY_D)
-            Position += Right * velocity;
-        if (direction == GLFW_KEY_Q)
-            Position += Up * velocity;
-        if (direction == GLFW_KEY_E)
-            Position -= Up * velocity;
-    }
-
-private:
-    void updateCameraVectors() {
-        glm::vec3 front;
-        front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        front.y = sin(glm::radians(Pitch));
-        front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        Front = glm::normalize(front);
-        Right = glm::normalize(glm::cross(Front, WorldUp));
-        Up = glm::normalize(glm::cross(Right, Front));
-    }
-};
 
-int main() {
-    // Initialize GLFW and GLAD
-    GLFWwindow* window = initGLFWandGLAD();
-
-    // Define the vertices and colors of the surface and buildings
-    GLfloat vertices[] = {
-        // positions          // colors           // texture coords
-        // Surface
-         // Surface (without texture coordinates)
-    -5.0f, 0.0f, -5.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
-     5.0f, 0.0f, -5.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
-     5.0f, 0.0f,  5.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
-    -5.0f, 0.0f,  5.0f,  0.0f, 1.0f, 0.0f,  0.0f, 0.0f,
-
-    // Building 1 (with texture coordinates)
-    -1.0f, 0.0f, -1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f,
-    -1.0f, 2.0f, -1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 0.0f,
-     1.0f, 2.0f, -1.0f,  1.0f, 1.0f, 1.0f,  1.0f, 0.0f,
-     1.0f, 0.0f, -1.0f,  1.0f, 1.0f, 1.0f,  1.0f, 1.0f,
-    -1.0f, 0.0f,  1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f,
-    -1.0f, 2.0f,  1.0f,  1.0f, 1.0f, 1.0f,  0.0f, 0.0f,
-     1.0f, 2.0f,  1.0f,  1.0f, 1.0f, 1.0f,  1.0f, 0.0f,
-     1.0f, 0.0f,  1.0f,  1.0f, 1.0f, 1.0f,  1.0f, 1.0f,
-
-     // Building 2
-      2.0f, 0.0f,  2.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f,
-      2.0f, 3.0f,  2.0f,  1.0f, 1.0f, 1.0f,  0.0f, 0.0f,
-      4.0f, 3.0f,  2.0f,  1.0f, 1.0f, 1.0f,  1.0f, 0.0f,
-      4.0f, 0.0f,  2.0f,  1.0f, 1.0f, 1.0f,  1.0f, 1.0f,
-      2.0f, 0.0f,  4.0f,  1.0f, 1.0f, 1.0f,  0.0f, 1.0f,
-      2.0f, 3.0f,  4.0f,  1.0f, 1.0f, 1.0f,  0.0f, 0.0f,
-      4.0f, 3.0f,  4.0f,  1.0f, 1.0f, 1.0f,  1.0f, 0.0f,
-      4.0f, 0.0f,  4.0f,  1.0f, 1.0f, 1.0f,  1.0f, 1.0f,
-    };
+// Creates a context without a window and loads the GL functions through it
+bool initHeadlessAndGLAD(HeadlessContext& context, const std::string& backend, int device) {
+    if (!context.Create(backend, device))
+        return false;
+    if (!gladLoadGLLoader((GLADloadproc)HeadlessContext::GetProcAddress)) {
+        Log.Write(LOG_ERROR, "Failed to initialize GLAD");
+        return false;
+    }
+    LoadGLExtensions((GLADloadproc)HeadlessContext::GetProcAddress);
+    std::cout << "Rendering headless with " << context.backend << ", OpenGL " << GLExt.major << "." << GLExt.minor << " on "
+              << (const char*)glGetString(GL_RENDERER) << std::endl;
+    return true;
+}
 
-    GLuint indices[] = {
-        // Surface
-        0, 1, 2, 2, 3, 0,
-
-        // Building 1
-        4, 5, 6, 6, 7, 4,
-        4, 5, 9, 9, 8, 4,
-        5, 6, 10, 10, 9, 5,
-        6, 7, 11, 11, 10, 6,
-        7, 4, 8, 8, 11, 7,
-        8, 9, 10, 10, 11, 8,
-
-        // Building 2
-        12, 13, 14, 14, 15, 12,
-        12, 13, 17, 17, 16, 12,
-        13, 14, 18, 18, 17, 13,
-        14, 15, 19, 19, 18, 14,
-        15, 12, 16, 16, 19, 15,
-        16, 17, 18, 18, 19, 16,
-    };
+// Quotes an argument for the shell std::system runs commands with
+std::string shellQuote(const std::string& arg) {
+#ifdef _WIN32
+    return "\"" + arg + "\"";
+#else
+    std::string quoted = "'";
+    for (char c : arg) {
+        if (c == '\'')
+            quoted += "'\\''";
+        else
+            quoted += c;
+    }
+    return quoted + "'";
+#endif
+}
 
-    // Generate and bind VAO, VBO, and EBO
-    GLuint VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    // Color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    // Texture coordinate attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
-
-    // Create and compile the shaders
-    GLuint shaderProgram = createShaderProgram();
-    glUseProgram(shaderProgram);
-
-    // Load and create a texture
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    // Set texture wrapping parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // Set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // Load image, create texture, and generate mipmaps
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load("res_wall_01_color.jpg", &width, &height, &nrChannels, 0);
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+// Renders a batch export with one headless process per GPU, each on its own EGL device, the processes claim the
+// views one at a time from the claims directory of the output so a GPU that finishes early takes more of them
+int renderFarm(int argc, char** argv, int processes, const std::string& output) {
+    std::filesystem::path claims = std::filesystem::path(output) / "claims";
+    std::error_code error;
+    std::filesystem::remove_all(claims, error);
+    std::filesystem::create_directories(claims, error);
+    if (error) {
+        std::cerr << "Failed to create " << claims.string() << std::endl;
+        return EXIT_FAILURE;
     }
-    else {
-        std::cerr << "Failed to load texture" << std::endl;
+    // The cores are split between the processes, each keeps one for its render thread
+    int cores = (int)std::thread::hardware_concurrency();
+    int jobs = std::max(1, cores / processes - 1);
+    std::string base = shellQuote(argv[0]) + " --jobs " + std::to_string(jobs);
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--gpus" && i + 1 < argc) {
+            i++;
+            continue;
+        }
+        base += " " + shellQuote(arg);
     }
-    stbi_image_free(data);
-
-    // Define transformations
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    std::cout << "Rendering views on " << processes << " GPUs" << std::endl;
+    std::vector<int> results(processes, 0);
+    std::vector<std::thread> children;
+    for (int gpu = 0; gpu < processes; gpu++) {
+        std::string command = base + " --headless egl --gpu " + std::to_string(gpu) + " --claim-views";
+        children.emplace_back([&results, gpu, command]() { results[gpu] = std::system(command.c_str()); });
+    }
+    for (std::thread& child : children)
+        child.join();
+    std::filesystem::remove_all(claims, error);
+    bool failed = false;
+    for (int gpu = 0; gpu < processes; gpu++) {
+        if (results[gpu] != 0) {
+            std::cerr << "Rendering on GPU " << gpu << " failed" << std::endl;
+            failed = true;
+        }
+    }
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-    GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLuint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLuint projLoc = glGetUniformLocation(shaderProgram, "projection");
-    GLuint lightOnLoc = glGetUniformLocation(shaderProgram, "lightOn");
+// Benchmark scenes by name, or "BXxBZxL" for BX by BZ blocks of L by L lots
+bool parseScene(const std::string& name, CityLayout& layout) {
+    unsigned int blocksX, blocksZ, lots;
+    if (name == "small") {
+        blocksX = 2; blocksZ = 2; lots = 2;
+    }
+    else if (name == "medium") {
+        blocksX = 10; blocksZ = 10; lots = 4;
+    }
+    else if (name == "large") {
+        blocksX = 40; blocksZ = 40; lots = 5;
+    }
+    else if (sscanf(name.c_str(), "%ux%ux%u", &blocksX, &blocksZ, &lots) != 3) {
+        return false;
+    }
+    layout.blocksX = blocksX;
+    layout.blocksZ = blocksZ;
+    layout.lotsPerSide = lots;
+    return true;
+}
 
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+// Scenes of the benchmark suite, each a city for --benchmark orbited by the camera and the options that make it
+// stress what it is named after
+struct SuiteScene {
+    const char* name;
+    const char* city;
+    const char* options;
+};
+const SuiteScene suiteScenes[] = {
+    { "1k", "8x8x4", "" },
+    { "10k", "25x25x4", "" },
+    { "100k", "80x80x4", "" },
+    { "1m", "500x500x4", "" },
+    // One unique merged mesh per building instead of instances of the unit building
+    { "downtown", "20x20x4", "--merged" },
+    { "night", "10x10x4", "--lights 1024" },
+    // Eight facade layers of 2048 texels a side, the images repeat
+    { "facades", "10x10x4", "--facades 8 2048" },
+};
 
-    // Set initial light state
-    bool lightOn = true;
-    glUniform1i(lightOnLoc, lightOn);
+// Prints the metrics of two reports side by side and returns how many regressed by more than threshold percent
+size_t printComparison(const BenchmarkReport& baseline, const BenchmarkReport& current, double threshold) {
+    size_t regressions = 0;
+    // A path that changed explains the metrics that follow rather than being a regression itself
+    for (const BenchmarkReport::Path& path : baseline.paths) {
+        const std::string* name = current.FindPath(path.subsystem);
+        if (name && *name != path.name)
+            std::cout << "  " << path.subsystem << " path changed from " << path.name << " to " << *name << std::endl;
+    }
+    for (const BenchmarkReport::Difference& difference : BenchmarkReport::Compare(baseline, current, threshold)) {
+        std::cout << "  " << std::left << std::setw(24) << difference.name << std::right << std::setw(14) << difference.baseline
+                  << std::setw(14) << difference.current << std::setw(9) << std::fixed << std::setprecision(1) << difference.percent << "%"
+                  << std::defaultfloat << std::setprecision(6) << (difference.regression ? "  REGRESSION" : "") << std::endl;
+        if (difference.regression)
+            regressions++;
+    }
+    return regressions;
+}
 
-    // Initialize camera
-    Camera camera(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+// Runs the scenes of the benchmark suite one after the other, each in a process of its own so no two share the GPU
+// or any state, and writes one report per scene into output, compared against the report of the same scene in
+// baseline when there is one, only is a comma separated list of scenes or empty for all of them
+int benchmarkSuite(int argc, char** argv, const std::string& output, const std::string& only, const std::string& baseline, double threshold) {
+    std::error_code error;
+    std::filesystem::create_directories(output, error);
+    if (error) {
+        std::cerr << "Failed to create " << output << std::endl;
+        return EXIT_FAILURE;
+    }
+    // The options of the suite itself are left out, everything else, such as --headless or --frames, goes to every scene
+    std::string base = shellQuote(argv[0]);
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if ((arg == "--benchmark-suite" || arg == "--suite" || arg == "--baseline" || arg == "--threshold") && i + 1 < argc) {
+            i++;
+            continue;
+        }
+        base += " " + shellQuote(arg);
+    }
+    bool failed = false;
+    size_t regressions = 0;
+    for (const SuiteScene& scene : suiteScenes) {
+        if (!only.empty() && ("," + only + ",").find(std::string(",") + scene.name + ",") == std::string::npos)
+            continue;
+        std::string reportPath = (std::filesystem::path(output) / (std::string(scene.name) + ".json")).string();
+        std::string command = base + " --benchmark " + scene.city + " orbit " + scene.options + " --report " + shellQuote(reportPath);
+        std::cout << "Suite: running " << scene.name << std::endl;
+        BenchmarkReport report;
+        if (std::system(command.c_str()) != 0 || !report.Read(reportPath)) {
+            std::cerr << "Benchmark scene " << scene.name << " failed" << std::endl;
+            failed = true;
+            continue;
+        }
+        report.scene = scene.name;
+        BenchmarkReport previous;
+        if (!baseline.empty() && previous.Read((std::filesystem::path(baseline) / (std::string(scene.name) + ".json")).string())) {
+            std::cout << "Suite: " << scene.name << " against " << baseline << std::endl;
+            regressions += printComparison(previous, report, threshold);
+        }
+    }
+    if (regressions > 0)
+        std::cout << "Suite: " << regressions << " metrics regressed by more than " << threshold << "%" << std::endl;
+    return failed || regressions > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
 
-    float deltaTime = 0.0f; // Time between current frame and last frame
-    float lastFrame = 0.0f; // Time of last frame
+// Counts the hours of sun on every facade of a generated city with line of sight casts against its building index,
+// analytics that only need the CPU: the middle of each wall looks for the sun once every hour of a day at the
+// equinox, when the sun is up from 6 to 18 and stands south at noon for a city at the given northern latitude
+int sunHours(const CityLayout& layout, float latitude, unsigned int threads) {
+    CityGenerator city(layout);
+    float half = std::max(city.halfExtentX(), city.halfExtentZ());
+    Quadtree tree(glm::vec2(-half), 2.0f * half);
+    float highest = 0.0f;
+    for (size_t i = 0; i < city.buildingCount(); i++) {
+        Building b = city.building(i);
+        tree.Insert((uint32_t)i, glm::vec3(b.minX, 0.0f, b.minZ), glm::vec3(b.maxX, b.height, b.maxZ));
+        highest = std::max(highest, b.height);
+    }
+    tree.Build();
 
-    // Main loop
-    while (!glfwWindowShouldClose(window)) {
-        // Calculate delta time
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+    // Directions towards the sun in the middle of each hour it is up, east is +X and north is -Z
+    const int HOURS = 12;
+    glm::vec3 sun[HOURS];
+    float phi = glm::radians(latitude);
+    for (int hour = 0; hour < HOURS; hour++) {
+        float angle = glm::radians(15.0f * (hour + 6.5f - 12.0f));
+        sun[hour] = glm::normalize(glm::vec3(-std::sin(angle), std::cos(phi) * std::cos(angle), std::sin(phi) * std::cos(angle)));
+    }
+    // Walls facing north, east, south and west, a ray long enough to leave the city from anywhere
+    const glm::vec3 normals[4] = { glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(-1.0f, 0.0f, 0.0f) };
+    const char* wallNames[4] = { "north", "east", "south", "west" };
+    float reach = 4.0f * half + highest;
 
-        // Input
-        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-            glfwSetWindowShouldClose(window, true);
+    // Every slice sums its own hours per wall direction, walls facing away from the sun cast no ray
+    JobSystem jobs(threads);
+    std::vector<std::vector<size_t>> sliceHours(jobs.Slices(city.buildingCount(), 256), std::vector<size_t>(6, 0));
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    jobs.ParallelFor(city.buildingCount(), 256, [&](size_t slice, size_t begin, size_t end) {
+        std::vector<size_t>& totals = sliceHours[slice];
+        for (size_t i = begin; i < end; i++) {
+            Building b = city.building(i);
+            glm::vec3 center(0.5f * (b.minX + b.maxX), 0.5f * b.height, 0.5f * (b.minZ + b.maxZ));
+            glm::vec3 halfSize(0.5f * (b.maxX - b.minX), 0.0f, 0.5f * (b.maxZ - b.minZ));
+            for (int wall = 0; wall < 4; wall++) {
+                // Just off the wall, so the building's own box is behind the ray
+                glm::vec3 point = center + normals[wall] * (glm::dot(halfSize, glm::abs(normals[wall])) + 1e-3f);
+                size_t hours = 0;
+                for (int hour = 0; hour < HOURS; hour++) {
+                    if (glm::dot(normals[wall], sun[hour]) <= 0.0f)
+                        continue;
+                    totals[5]++;
+                    if (tree.LineOfSight(point, point + sun[hour] * reach))
+                        hours++;
+                }
+                totals[wall] += hours;
+                if (hours == 0)
+                    totals[4]++;
+            }
         }
+    });
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-        // Camera controls
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            camera.ProcessKeyboard(GLFW_KEY_W, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            camera.ProcessKeyboard(GLFW_KEY_S, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-            camera.ProcessKeyboard(GLFW_KEY_A, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-            camera.ProcessKeyboard(GLFW_KEY_D, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
-            camera.ProcessKeyboard(GLFW_KEY_Q, deltaTime);
-        if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
-            camera.ProcessKeyboard(GLFW_KEY_E, deltaTime);
+    std::vector<size_t> sums(6, 0);
+    for (const std::vector<size_t>& totals : sliceHours)
+        for (size_t k = 0; k < sums.size(); k++)
+            sums[k] += totals[k];
+    size_t buildings = std::max<size_t>(city.buildingCount(), 1);
+    std::cout << "Sun hours of the facades of " << city.buildingCount() << " buildings at " << latitude << " degrees north on average:" << std::fixed << std::setprecision(1);
+    for (int wall = 0; wall < 4; wall++)
+        std::cout << " " << wallNames[wall] << " " << (double)sums[wall] / buildings;
+    std::cout << ", " << sums[4] << " of " << 4 * city.buildingCount() << " walls get none" << std::endl;
+    std::cout << "Cast " << sums[5] << " rays on " << jobs.Slices(city.buildingCount(), 256) << " slices in " << std::setprecision(2) << seconds * 1000.0
+              << " ms, " << sums[5] / std::max(seconds, 1e-9) / 1e6 << " million rays per second" << std::defaultfloat << std::setprecision(6) << std::endl;
+    return EXIT_SUCCESS;
+}
 
-        // Toggle light
-        if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) {
-            lightOn = !lightOn;
-            glUniform1i(lightOnLoc, lightOn);
+int main(int argc, char** argv) {
+    // Phases of startup up to the first frame, printed once it is presented and kept by benchmarks
+    StartupTimer startup;
+    // Offline mode that cooks source images into DDS files, no window is opened
+    // Usage: --cook <input dir> <output dir> [--force] [--size N]
+    if (argc >= 4 && std::string(argv[1]) == "--cook") {
+        TextureCooker cooker;
+        for (int i = 4; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--force")
+                cooker.force = true;
+            else if (arg == "--size" && i + 1 < argc)
+                cooker.size = std::atoi(argv[++i]);
         }
+        return cooker.CookDirectory(argv[2], argv[3]) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Offline mode that cooks facade images into the pages of one virtual texture file, no window is opened
+    // Usage: --cook-virtual <output.vt> <image> [<image> ...] [--force] [--size N]
+    if (argc >= 4 && std::string(argv[1]) == "--cook-virtual") {
+        TextureCooker cooker;
+        std::vector<std::string> images;
+        for (int i = 3; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--force")
+                cooker.force = true;
+            else if (arg == "--size" && i + 1 < argc)
+                cooker.size = std::atoi(argv[++i]);
+            else
+                images.push_back(arg);
+        }
+        return cooker.CookVirtualTexture(images, argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Offline mode that diffs two benchmark reports and fails if a metric grew by more than the threshold
+    // Usage: --compare-reports <baseline.json> <current.json> [--threshold percent]
+    if (argc >= 4 && std::string(argv[1]) == "--compare-reports") {
+        double threshold = 5.0;
+        if (argc >= 6 && std::string(argv[4]) == "--threshold")
+            threshold = std::atof(argv[5]);
+        BenchmarkReport baseline, current;
+        if (!baseline.Read(argv[2]) || !current.Read(argv[3])) {
+            std::cerr << "Failed to read " << (baseline.metrics.empty() ? argv[2] : argv[3]) << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "Comparing " << current.scene << " against " << baseline.scene << std::endl;
+        size_t regressions = printComparison(baseline, current, threshold);
+        std::cout << regressions << " metrics regressed by more than " << threshold << "%" << std::endl;
+        return regressions > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
 
-        // Render
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_DEPTH_TEST);
-
-        glm::mat4 view = camera.GetViewMatrix();
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::rotate(model, (float)glfwGetTime() * glm::radians(50.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(indices[0]), GL_UNSIGNED_INT, 0);
-
-        // Swap buffers and poll IO events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    // Offline mode that times the CPU kernels on their own at 1, 2, 4 ... cores up to all of them
+    // Usage: --microbench [name filter] [--min-time seconds] [--cores 1,2,8] [--report file.json]
+    if (argc >= 2 && std::string(argv[1]) == "--microbench") {
+        Microbenchmark microbenchmark;
+        microbenchmark.AddEngineKernels();
+        std::string filter, reportPath;
+        std::vector<unsigned int> cores;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--min-time" && i + 1 < argc)
+                microbenchmark.minSeconds = std::max(0.0, std::atof(argv[++i]));
+            else if (arg == "--report" && i + 1 < argc)
+                reportPath = argv[++i];
+            else if (arg == "--cores" && i + 1 < argc) {
+                std::stringstream list(argv[++i]);
+                std::string count;
+                while (std::getline(list, count, ','))
+                    cores.push_back((unsigned int)std::max(1, std::atoi(count.c_str())));
+            }
+            else
+                filter = arg;
+        }
+        if (cores.empty()) {
+            unsigned int all = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned int count = 1; count < all; count *= 2)
+                cores.push_back(count);
+            cores.push_back(all);
+        }
+        std::vector<Microbenchmark::Result> results = microbenchmark.Run(filter, cores);
+        if (results.empty()) {
+            std::cerr << "No kernel matches " << filter << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (!reportPath.empty()) {
+            BenchmarkReport report;
+            report.scene = "microbenchmarks";
+            Microbenchmark::Report(results, report);
+            if (!report.Write(reportPath)) {
+                std::cerr << "Failed to write " << reportPath << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+        return EXIT_SUCCESS;
     }
 
-    // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteProgram(shaderProgram);
+    // Facade images, buildings pick one of them as their texture array layer
+    const char* facadeImages[] = { "res_wall_01_color", "images" };
+    const GLsizei facadeImageCount = sizeof(facadeImages) / sizeof(facadeImages[0]);
+    // Layers of the facade array and texels a side of each, layers past the images repeat them
+    GLsizei facadeCount = facadeImageCount;
+    GLsizei facadeSize = 512;
+    // Streams the mip levels of cooked facades the view needs on the workers, with at most this many megabytes of
+    // them resident, 0 loads every level at startup
+    float textureBudgetMB = 0.0f;
+    // Virtual texture cooked with --cook-virtual the lit facades are paged in from instead of the array, with a cache
+    // of this many megabytes
+    std::string virtualTexturePath;
+    float virtualCacheMB = 64.0f;
+    // Anisotropy of the facade and impostor samplers, 1 filters them trilinear only
+    float anisotropy = 1.0f;
 
-    glfwTerminate();
+    // Generate the surface and buildings of the city
+    CityLayout layout;
+    layout.facadeCount = facadeCount;
+    bool instanced = true;
+    bool culling = true;
+    // Far blocks crossfade to one impostor box each, instanced only
+    LevelOfDetail levelOfDetail;
+    bool lod = true;
+    // Blocks smaller than a baked view draw as a billboard of it
+    bool billboards = true;
+    // Buildings hidden behind nearer ones are culled on the GPU, instanced only
+    bool occlusionCulling = true;
+    // Frustum, level of detail and occlusion of the instanced buildings all decided by one compute pass, none by the CPU
+    bool gpuCulling = false;
+    // The GPU culler's building records are built by a compute shader from the lots instead of uploaded from the CPU
+    bool gpuGenerating = false;
+    // Trees, street lamps and benches scattered around every block, this many to a block, culled by a GPU culler of their own
+    unsigned int propsPerBlock = 0;
+    // Streets, crossings and sidewalks on the ground of the merged city, one mesh per tile of this many blocks square
+    unsigned int roadTileBlocks = 0;
+    // Gable, hip, pyramid and parapet roofs instanced on top of the instanced buildings, one draw per shape
+    bool roofs = false;
+    // Cars driving the streets, moved on the job system every simulation step and drawn from compact records
+    size_t trafficVehicles = 0;
+    // Projected sizes in pixels below which buildings, props and cars are not drawn at all, 0 draws every one
+    float propCullPixels = 0.0f;
+    float vehicleCullPixels = 0.0f;
+    // A --model is drawn meshlet by meshlet, each culled on the GPU for every building, with room for this many MB of records
+    float meshletMB = 0.0f;
+    // A world of tiles streamed in around the camera, each tile a city of the layout above
+    int streamTilesX = 0, streamTilesZ = 0;
+    float tileBudgetMB = 64.0f;
+    float tileRadius = 100.0f;
+    std::string tileDirectory = "tiles";
+    // Pixels a tile's coarse level of block boxes may be off by before its whole city is streamed in, 0 streams only whole cities
+    float tileScreenError = 0.0f;
+    // Seconds of the camera's extrapolated path whose tiles are loaded ahead of time, 0 loads only the tiles in range
+    float tilePrefetchSeconds = 0.0f;
+    // Keeps the tiles in VRAM as meshlets of quantized vertices that the vertex shader decodes, about twice as many in the budget
+    bool packedTiles = false;
+    // Threads of the I/O scheduler the tile files of a folder are read through, 0 reads them on the load jobs instead
+    int ioThreads = 2;
+    // Fetched and generated tiles are kept in this directory across launches, up to this many MB, an empty directory keeps none
+    std::string tileCacheDirectory = "tilecache";
+    float tileCacheMB = 2048.0f;
+    bool cookTiles = false;
+    // Building footprints of a map, GeoJSON or OSM PBF, extruded into the tiles of the --stream world instead of cooking generated ones
+    std::string footprintPath;
+    double metersPerUnit = 10.0;
+    // A scene file written by --save-scene is mapped instead of generating the city
+    std::string scenePath, saveScenePath;
+    std::string modelPath;
+    // Instanced buildings stand on a heightmap terrain instead of the flat ground, generated hills unless an image is given
+    // The square it covers is this many units a side, 0 for 4 times the city's, and its highest ground this high
+    bool terrain = false;
+    std::string terrainPath;
+    float terrainSize = 0.0f;
+    float terrainHeight = 8.0f;
+    // Picks the building under this pixel, from the top left of the view, on the first frame, a right click picks under the cursor
+    glm::ivec2 pickPixel = glm::ivec2(-1);
+    // Instanced buildings recolored every frame like a live occupancy overlay, only their records are uploaded again
+    int liveColors = 0;
+    // Port live metrics of instanced buildings arrive on as UDP datagrams, see LiveDataReceiver.h, 0 for none
+    int liveDataPort = 0;
+    // Port edits of a collaborative session are exchanged on and the "host:port" of every other machine of the session,
+    // see SceneSync.h, 0 for none. Delete removes the picked building, Insert brings back the last removed one and Page
+    // Up and Down raise and lower the picked one
+    int syncPort = 0;
+    std::vector<std::string> syncPeers;
+    // The camera is a sphere that slides along the buildings instead of flying through them, benchmarks keep to their path
+    bool collision = true;
+    // Offline mode that prints how many hours of sun the facades of the city get at a northern latitude
+    bool sunReport = false;
+    float sunLatitude = 40.0f;
+    // Scene meshes are uploaded as 16 byte CompactVertex instead of 20 byte float vertices
+    bool compactVertices = false;
+    // The scene vertex shaders read the heap's vertices from a storage buffer instead of fetching attributes
+    bool vertexPulling = false;
+    // Buildings are drawn as boxes made up by the vertex shader, needs vertex pulling and implies it
+    bool proceduralBoxes = false;
+    // The frame's visible instances are streamed as 28 byte CompactInstance records instead of 48 byte float ones
+    bool compactInstances = false;
+    // Bakes the ambient occlusion of a generated city at startup, scene files have it baked already
+    bool bakeOcclusion = false;
+    // Merged buildings are regrouped into batches of about this many megabytes, 0 keeps the city one mesh
+    float batchMB = 0.0f;
+    // Number of street and window point lights shaded with ClusteredLights, 0 keeps the single light
+    int lightCount = 0;
+    // Draws a cube at every point light in view that covers at least this many pixels, negative draws none
+    float lightMarkerPixels = -1.0f;
+    // Draws a sky from precomputed scattering tables behind the forward frames instead of the clear color
+    bool sky = false;
+    // Moves the sun over the day from --time-of-day's hour instead of keeping it fixed, with the daylight it gives
+    TimeOfDay timeOfDay;
+    bool sunMoves = false;
+    // Lays water around the city on the forward frames that reflects the block billboards, a view at a quarter of the pixels
+    bool water = false;
+    // Rain or snow falling around the camera on the forward frames, ParticleSystem::WEATHER_RAIN or WEATHER_SNOW, and
+    // smoke rising from this many roofs, all of it simulated and drawn on the GPU
+    int weatherKind = ParticleSystem::WEATHER_NONE;
+    size_t smokeChimneys = 0;
+    // Height fog on the forward lit frames that hides this much of the scene per world unit at the ground, 0 draws none
+    // It thins out going up by fogFalloff per unit of height, and buildings it hides entirely are culled
+    float fogDensity = 0.0f;
+    const float fogFalloff = 0.1f;
+    const glm::vec3 fogColor(0.55f, 0.6f, 0.68f);
+    // Starts in deferred shading instead of forward, G switches between them while running
+    bool deferred = false;
+    // Starts with screen space ambient occlusion on deferred frames, O toggles it while running
+    bool ssao = false;
+    // Works out a quarter of the occlusion every frame and reprojects the rest from the frames before
+    bool temporalSsao = false;
+    // Sun shadows from cascades cached between frames, with maps of this many texels a side, 0 turns them off
+    int shadowSize = 0;
+    // Point lights shadowed at once from LightShadows' atlas, and faces of it rendered a frame at most, 0 lights none
+    int lightShadowCount = 0;
+    int lightShadowFaces = 12;
+    // Signs, graffiti and wear projected onto the facades, binned into the clusters of the point lights, 0 none
+    int decalCount = 0;
+    // Camera passes draw reverse-Z with a float depth buffer and no far plane, needs glClipControl
+    bool reverseZ = false;
+    // Draws the scene at a resolution that holds its GPU time at this many milliseconds, scaled up and sharpened by
+    // this much into the window, full resolution always when 0
+    float dynamicResolutionMs = 0.0f;
+    float upscaleSharpness = 0.5f;
+    // Largest scale of each side the dynamic resolution goes up to
+    float dynamicResolutionMaxScale = 1.0f;
+    // Smooths the edges with a multisampled target or an FXAA pass, deferred frames only with FXAA
+    AntiAliasing::Mode antiAliasingMode = AntiAliasing::NONE;
+    // Post effects drawn in one fused pass after the scene, a set of PostProcess::Effect, 0 draws none
+    unsigned int postEffects = 0;
+    // Fog lit by the sun and the point lights from a froxel volume, applied by the post pass, at this density, 0 none
+    float volumetricFogDensity = 0.0f;
+    // Lays down depth with the unlit program before the lit pass shades only what is left visible
+    bool depthPrepass = false;
+    // Shades the sky, what the fog hides and the edges of the screen at 2x2 or 4x4 pixels per fragment where the
+    // driver has NV_shading_rate_image, forward frames only
+    bool variableRateShading = false;
+    // Puts the street address of up to this many of the nearest visible buildings over their roofs, those that
+    // would overlap a nearer one's left out, 0 for none
+    size_t labelCount = 0;
+    // Outlines the leaves of the building quadtree and the bounds of the buildings drawn, debug builds only
+    bool debugLines = false;
+    // Draws every program with its vertex formats and states once at load, so drivers compiling them lazily stall
+    // there instead of in the first frame that needs one
+    bool warmUp = true;
+    // Facades from this layer on are windows made up by the fragment shader, only the layers before it are textures
+    // loaded into the array, the landmarks, 0 textures them all
+    GLsizei proceduralFrom = 0;
+    // Every this many facade layers one is glass, drawn with order-independent transparency, 0 keeps them all opaque
+    int glassEvery = 0;
+    // The glass reflects a grid of this many cube map probes to a side, captured a face a frame, 0 reflects a flat sky
+    int probesPerSide = 0;
+    // Orders the visible buildings or batches front to back, and batches by facade, before they are drawn
+    bool drawSort = true;
+    // Worker threads culling and packing the visible buildings, -1 picks one less than the number of cores
+    int jobThreads = -1;
+    bool linearCulling = false;
+    // Culls the buildings the frustum keeps against boxes of the nearest ones drawn on the CPU, before the GPU sees them
+    bool softwareOcclusion = false;
+    // Skips whole nodes of the building quadtree that the hills of the terrain hide from the camera
+    bool horizonCulling = false;
+    // Culls the buildings through a bounding volume hierarchy instead of the quadtree
+    bool hierarchyCulling = false;
+    // File of the potentially visible sets of a street level camera, baked and written first when it is missing or stale
+    std::string visibilityPath;
+    // Draws the merged city a block at a time, each on the occlusion query of its box from the frame before
+    bool blockQuerying = false;
+    std::string profileOut;
+    bool pipelineStatistics = false;
+    std::string traceOut;
+    // Writes the last 120 frames of the profiler zones, allocations, GL warnings and streaming into hitchDirectory
+    // whenever a frame takes longer than this many milliseconds, 0 for never
+    float hitchMs = 0.0f;
+    std::string hitchDirectory = "hitches";
+    // Writes the input, sizes and live data of every frame into recordSession, or plays such a file back in place of
+    // the window and the clock, so two builds render the same frames
+    std::string recordSession;
+    std::string replaySession;
+    // Messages of the engine below this level are dropped, and a line of code writes at most logRate of them a
+    // second, 0 for no limit
+    LogLevel logLevel = LOG_INFO;
+    int logRate = 10;
+    // Serves frame time histograms, GPU memory, draws, streaming queues and hitches for Prometheus on this TCP port, 0 for none
+    int metricsPort = 0;
+    // Picks the shadows, SSAO, anti-aliasing, resolution scale and level of detail the options leave open from a
+    // calibration of the GPU, to hold this many milliseconds of GPU time a frame, 0 keeps the defaults
+    float autoQualityMs = 0.0f;
+    // Measures the GPU again rather than reading its cached calibration
+    bool recalibrate = false;
+    // Refreshes every present waits for, 0 presents at once and -1 is adaptive vsync, the simulation steps at its own rate
+    int swapInterval = 1;
+    // Frames the GPU may still be working on while the next is recorded, 1 has the least latency and 3 the most throughput
+    int framesInFlight = 2;
+    // Frames per second the render thread is held to, 0 renders as fast as the swap interval lets it
+    double frameRateLimit = 0.0;
+    // Draws only when something changed, input, a resize, live data, traffic or assets still streaming in, and the
+    // city stands still, otherwise the simulation thread sleeps in GLFW and the GPU has nothing to do
+    bool onDemand = false;
+    // Opens a second window with a map of the city from above that follows the camera, drawn by a thread of its own
+    bool overviewWindow = false;
+    // Distance between the eyes in world units, above 0 draws both eyes side by side in one pass for a head mounted
+    // display or a CAVE wall, every building instance twice
+    float stereoSeparation = 0.0f;
+    // Benchmark runs replay a camera path at a fixed timestep for a fixed number of frames
+    bool benchmark = false;
+    std::string benchmarkScene, benchmarkPath;
+    int benchmarkFrames = 0;
+    // Report of a benchmark run written as JSON, and the suite of scenes run one process each with reports compared
+    // against a baseline directory, or against nothing when no baseline is given
+    std::string reportPath;
+    std::string suiteOutput, suiteScenesOnly, suiteBaseline;
+    double suiteThreshold = 5.0;
+    // Batch export renders one still per view of a file into an offscreen target and writes it to the output
+    // directory, the window stays hidden and the program ends after the last image is written
+    std::string viewsPath, viewsOutput;
+    std::string viewFormat = "png";
+    // Size of the images, and of the projection's aspect ratio, the window's starting size unless given
+    int viewWidth = SCR_WIDTH, viewHeight = SCR_HEIGHT;
+    // Renders every view as a poster of this size in tiles of the view size, stitched into one PNG once all are written
+    // The tiles are claimed like views, so nodes of a cluster that all run the export with --claim-views on the same
+    // scene files and output directory share the work, and whichever finds a poster's tiles complete stitches it
+    int posterWidth = 0, posterHeight = 0;
+    // Encodes every frame into an MP4 file or an rtp:// stream through ffmpeg, with this encoder, "auto" for the GPU's
+    // own, at this rate and this many Mbit/s, 0 leaving the bitrate to the encoder
+    std::string videoOutput;
+    std::string videoEncoder = "auto";
+    int videoFps = 60;
+    float videoBitrate = 0.0f;
+    // Runs without a window on a context of this backend, "egl", "osmesa" or "auto", only for benchmarks and exports
+    bool headless = false;
+    std::string headlessBackend = "auto";
+    // EGL device of a headless run, and the number of processes a batch export is split over, one per device and
+    // all of them when 0, a process rendering under --claim-views only takes the views no other process claimed
+    int headlessDevice = 0;
+    int gpus = -1;
+    bool claimViews = false;
+    // Reads the shaders from files in this directory and rebuilds programs and facades whenever their files change
+    bool hotReload = false;
+    std::string shaderDirectory = "shaders";
+    // Asks for a debug context and collects the driver's errors and performance warnings, "sync" reports each inside the call that caused it
+    bool glDebug = false;
+    bool glDebugSync = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--city" && i + 2 < argc) {
+            layout.blocksX = (unsigned int)std::stoul(argv[++i]);
+            layout.blocksZ = (unsigned int)std::stoul(argv[++i]);
+        }
+        else if (arg == "--lots" && i + 1 < argc) {
+            layout.lotsPerSide = (unsigned int)std::stoul(argv[++i]);
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            layout.seed = (unsigned int)std::stoul(argv[++i]);
+        }
+        else if (arg == "--merged") {
+            instanced = false;
+        }
+        else if (arg == "--no-cull") {
+            culling = false;
+        }
+        else if (arg == "--linear-cull") {
+            linearCulling = true;
+        }
+        else if (arg == "--software-occlusion") {
+            softwareOcclusion = true;
+        }
+        else if (arg == "--horizon-cull") {
+            horizonCulling = true;
+        }
+        else if (arg == "--bvh-cull") {
+            hierarchyCulling = true;
+        }
+        else if (arg == "--pvs" && i + 1 < argc) {
+            visibilityPath = argv[++i];
+        }
+        else if (arg == "--block-queries") {
+            blockQuerying = true;
+        }
+        else if (arg == "--lod" && i + 1 < argc) {
+            levelOfDetail.impostorPixels = std::stof(argv[++i]);
+        }
+        else if (arg == "--no-lod") {
+            lod = false;
+        }
+        else if (arg == "--billboard" && i + 1 < argc) {
+            levelOfDetail.billboardPixels = std::stof(argv[++i]);
+        }
+        else if (arg == "--no-billboards") {
+            billboards = false;
+        }
+        else if (arg == "--no-occlusion") {
+            occlusionCulling = false;
+        }
+        else if (arg == "--gpu-cull") {
+            gpuCulling = true;
+        }
+        else if (arg == "--gpu-generate") {
+            gpuGenerating = true;
+        }
+        else if (arg == "--props" && i + 1 < argc) {
+            propsPerBlock = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--roads" && i + 1 < argc) {
+            roadTileBlocks = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--roofs") {
+            roofs = true;
+        }
+        else if (arg == "--traffic" && i + 1 < argc) {
+            trafficVehicles = (size_t)std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--cull-pixels" && i + 1 < argc) {
+            levelOfDetail.cullPixels = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--prop-cull-pixels" && i + 1 < argc) {
+            propCullPixels = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--vehicle-cull-pixels" && i + 1 < argc) {
+            vehicleCullPixels = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--meshlets") {
+            meshletMB = 64.0f;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                meshletMB = std::stof(argv[++i]);
+        }
+        else if (arg == "--stream" && i + 2 < argc) {
+            streamTilesX = std::stoi(argv[++i]);
+            streamTilesZ = std::stoi(argv[++i]);
+        }
+        else if (arg == "--tile-budget" && i + 1 < argc) {
+            tileBudgetMB = std::stof(argv[++i]);
+        }
+        else if (arg == "--tile-radius" && i + 1 < argc) {
+            tileRadius = std::stof(argv[++i]);
+        }
+        else if (arg == "--tile-dir" && i + 1 < argc) {
+            tileDirectory = argv[++i];
+        }
+        else if (arg == "--tile-error" && i + 1 < argc) {
+            tileScreenError = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--tile-packed") {
+            packedTiles = true;
+        }
+        else if (arg == "--io-threads" && i + 1 < argc) {
+            ioThreads = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--tile-prefetch") {
+            tilePrefetchSeconds = 1.5f;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                tilePrefetchSeconds = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--tile-cache" && i + 1 < argc) {
+            tileCacheDirectory = argv[++i];
+        }
+        else if (arg == "--tile-cache-mb" && i + 1 < argc) {
+            tileCacheMB = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--no-tile-cache") {
+            tileCacheDirectory.clear();
+        }
+        else if (arg == "--cook-tiles") {
+            cookTiles = true;
+        }
+        else if (arg == "--import-footprints" && i + 1 < argc) {
+            footprintPath = argv[++i];
+        }
+        else if (arg == "--meters-per-unit" && i + 1 < argc) {
+            metersPerUnit = std::max(1e-3, std::stod(argv[++i]));
+        }
+        else if (arg == "--model" && i + 1 < argc) {
+            modelPath = argv[++i];
+        }
+        else if (arg == "--terrain") {
+            terrain = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                terrainPath = argv[++i];
+        }
+        else if (arg == "--terrain-size" && i + 2 < argc) {
+            terrainSize = std::max(0.0f, std::stof(argv[++i]));
+            terrainHeight = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--pick" && i + 2 < argc) {
+            pickPixel.x = std::stoi(argv[++i]);
+            pickPixel.y = std::stoi(argv[++i]);
+        }
+        else if (arg == "--live-colors" && i + 1 < argc) {
+            liveColors = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--sync" && i + 2 < argc) {
+            syncPort = std::clamp(std::stoi(argv[++i]), 0, 65535);
+            std::string peers = argv[++i];
+            for (size_t start = 0; start < peers.size();) {
+                size_t end = std::min(peers.find(',', start), peers.size());
+                if (end > start)
+                    syncPeers.push_back(peers.substr(start, end - start));
+                start = end + 1;
+            }
+        }
+        else if (arg == "--live-data" && i + 1 < argc) {
+            liveDataPort = std::clamp(std::stoi(argv[++i]), 0, 65535);
+        }
+        else if (arg == "--no-collision") {
+            collision = false;
+        }
+        else if (arg == "--sun-hours") {
+            sunReport = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                sunLatitude = glm::clamp(std::stof(argv[++i]), 0.0f, 90.0f);
+        }
+        else if (arg == "--scene" && i + 1 < argc) {
+            scenePath = argv[++i];
+        }
+        else if (arg == "--save-scene" && i + 1 < argc) {
+            saveScenePath = argv[++i];
+        }
+        else if (arg == "--compact-vertices") {
+            compactVertices = true;
+        }
+        else if (arg == "--vertex-pulling") {
+            vertexPulling = true;
+        }
+        else if (arg == "--procedural-boxes") {
+            proceduralBoxes = vertexPulling = true;
+        }
+        else if (arg == "--compact-instances") {
+            compactInstances = true;
+        }
+        else if (arg == "--bake-ao") {
+            bakeOcclusion = true;
+        }
+        else if (arg == "--batch-mb" && i + 1 < argc) {
+            batchMB = std::stof(argv[++i]);
+        }
+        else if (arg == "--lights" && i + 1 < argc) {
+            lightCount = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--light-markers" && i + 1 < argc) {
+            lightMarkerPixels = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--sky") {
+            sky = true;
+        }
+        else if (arg == "--time-of-day" && i + 1 < argc) {
+            sunMoves = true;
+            timeOfDay.startHour = std::stof(argv[++i]);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                timeOfDay.hoursPerSecond = std::stof(argv[++i]);
+        }
+        else if (arg == "--latitude" && i + 1 < argc) {
+            timeOfDay.latitude = glm::clamp(std::stof(argv[++i]), -90.0f, 90.0f);
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                timeOfDay.day = glm::clamp(std::stoi(argv[++i]), 1, 365);
+        }
+        else if (arg == "--water") {
+            water = true;
+        }
+        else if (arg == "--weather" && i + 1 < argc) {
+            std::string kind = argv[++i];
+            weatherKind = kind == "rain" ? ParticleSystem::WEATHER_RAIN : kind == "snow" ? ParticleSystem::WEATHER_SNOW : ParticleSystem::WEATHER_NONE;
+        }
+        else if (arg == "--smoke" && i + 1 < argc) {
+            smokeChimneys = (size_t)std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--fog" && i + 1 < argc) {
+            fogDensity = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--deferred") {
+            deferred = true;
+        }
+        else if (arg == "--ssao") {
+            ssao = true;
+        }
+        else if (arg == "--ssao-temporal") {
+            temporalSsao = true;
+        }
+        else if (arg == "--depth-prepass") {
+            depthPrepass = true;
+        }
+        else if (arg == "--shading-rate") {
+            variableRateShading = true;
+        }
+        else if (arg == "--labels" && i + 1 < argc) {
+            labelCount = (size_t)std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--debug-lines") {
+            debugLines = true;
+        }
+        else if (arg == "--no-warm-up") {
+            warmUp = false;
+        }
+        else if (arg == "--procedural-facades" && i + 1 < argc) {
+            proceduralFrom = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--glass" && i + 1 < argc) {
+            glassEvery = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--probes" && i + 1 < argc) {
+            probesPerSide = std::clamp(std::atoi(argv[++i]), 0, ReflectionProbes::MAX_PER_SIDE);
+        }
+        else if (arg == "--reverse-z") {
+            reverseZ = true;
+        }
+        else if (arg == "--dynamic-res" && i + 1 < argc) {
+            dynamicResolutionMs = std::stof(argv[++i]);
+        }
+        else if (arg == "--sharpen" && i + 1 < argc) {
+            upscaleSharpness = std::clamp(std::stof(argv[++i]), 0.0f, 1.0f);
+        }
+        else if (arg == "--aa" && i + 1 < argc) {
+            if (!AntiAliasing::Parse(argv[++i], antiAliasingMode))
+                std::cerr << "Unknown --aa mode " << argv[i] << ", expected none, msaa2, msaa4, msaa8 or fxaa" << std::endl;
+        }
+        else if (arg == "--post" && i + 1 < argc) {
+            if (!PostProcess::Parse(argv[++i], postEffects))
+                std::cerr << "Unknown --post effect in " << argv[i] << ", expected a list of fxaa, fog, bloom, tonemap, grade and vignette" << std::endl;
+        }
+        else if (arg == "--volumetric-fog") {
+            volumetricFogDensity = 0.02f;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                volumetricFogDensity = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--no-draw-sort") {
+            drawSort = false;
+        }
+        else if (arg == "--shadows") {
+            shadowSize = 2048;
+        }
+        else if (arg == "--shadow-size" && i + 1 < argc) {
+            shadowSize = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--light-shadows") {
+            lightShadowCount = 128;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                lightShadowCount = std::clamp(std::stoi(argv[++i]), 0, (int)LightShadows::MAX_LIGHTS);
+        }
+        else if (arg == "--light-shadow-faces" && i + 1 < argc) {
+            lightShadowFaces = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--decals" && i + 1 < argc) {
+            decalCount = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--jobs" && i + 1 < argc) {
+            jobThreads = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--swap-interval" && i + 1 < argc) {
+            swapInterval = std::stoi(argv[++i]);
+        }
+        else if (arg == "--frames-in-flight" && i + 1 < argc) {
+            framesInFlight = std::stoi(argv[++i]);
+        }
+        else if (arg == "--on-demand") {
+            onDemand = true;
+        }
+        else if (arg == "--overview") {
+            overviewWindow = true;
+        }
+        else if (arg == "--stereo" && i + 1 < argc) {
+            stereoSeparation = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--fps-limit" && i + 1 < argc) {
+            frameRateLimit = std::max(0.0, std::stod(argv[++i]));
+        }
+        else if (arg == "--profile-out" && i + 1 < argc) {
+            profileOut = argv[++i];
+        }
+        else if (arg == "--trace" && i + 1 < argc) {
+            traceOut = argv[++i];
+        }
+        else if (arg == "--hitch-ms" && i + 1 < argc) {
+            hitchMs = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--hitch-dir" && i + 1 < argc) {
+            hitchDirectory = argv[++i];
+        }
+        else if (arg == "--record-session" && i + 1 < argc) {
+            recordSession = argv[++i];
+        }
+        else if (arg == "--replay-session" && i + 1 < argc) {
+            replaySession = argv[++i];
+        }
+        else if (arg == "--log-level" && i + 1 < argc) {
+            std::string name = argv[++i];
+            if (name == "debug")
+                logLevel = LOG_DEBUG;
+            else if (name == "info")
+                logLevel = LOG_INFO;
+            else if (name == "warning")
+                logLevel = LOG_WARNING;
+            else if (name == "error")
+                logLevel = LOG_ERROR;
+            else
+                std::cerr << "Unknown log level " << name << ", expected debug, info, warning or error" << std::endl;
+        }
+        else if (arg == "--log-rate" && i + 1 < argc) {
+            logRate = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--metrics-port" && i + 1 < argc) {
+            metricsPort = std::stoi(argv[++i]);
+        }
+        else if (arg == "--auto-quality" && i + 1 < argc) {
+            autoQualityMs = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--recalibrate") {
+            recalibrate = true;
+        }
+        else if (arg == "--pipeline-stats") {
+            pipelineStatistics = true;
+        }
+        else if (arg == "--benchmark" && i + 2 < argc) {
+            benchmark = true;
+            benchmarkScene = argv[i + 1];
+            if (!parseScene(argv[++i], layout)) {
+                std::cerr << "Unknown benchmark scene " << argv[i] << std::endl;
+                return EXIT_FAILURE;
+            }
+            benchmarkPath = argv[++i];
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            benchmarkFrames = std::stoi(argv[++i]);
+        }
+        else if (arg == "--report" && i + 1 < argc) {
+            reportPath = argv[++i];
+        }
+        else if (arg == "--benchmark-suite" && i + 1 < argc) {
+            suiteOutput = argv[++i];
+        }
+        else if (arg == "--suite" && i + 1 < argc) {
+            suiteScenesOnly = argv[++i];
+        }
+        else if (arg == "--baseline" && i + 1 < argc) {
+            suiteBaseline = argv[++i];
+        }
+        else if (arg == "--threshold" && i + 1 < argc) {
+            suiteThreshold = std::stod(argv[++i]);
+        }
+        else if (arg == "--render-views" && i + 2 < argc) {
+            viewsPath = argv[++i];
+            viewsOutput = argv[++i];
+        }
+        else if (arg == "--view-size" && i + 2 < argc) {
+            viewWidth = std::max(1, std::stoi(argv[++i]));
+            viewHeight = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--poster" && i + 2 < argc) {
+            posterWidth = std::max(1, std::stoi(argv[++i]));
+            posterHeight = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--view-format" && i + 1 < argc) {
+            viewFormat = argv[++i];
+        }
+        else if (arg == "--video" && i + 1 < argc) {
+            videoOutput = argv[++i];
+        }
+        else if (arg == "--video-encoder" && i + 1 < argc) {
+            videoEncoder = argv[++i];
+        }
+        else if (arg == "--video-fps" && i + 1 < argc) {
+            videoFps = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--video-bitrate" && i + 1 < argc) {
+            videoBitrate = std::max(0.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--headless") {
+            headless = true;
+            if (i + 1 < argc && (std::string(argv[i + 1]) == "egl" || std::string(argv[i + 1]) == "osmesa" || std::string(argv[i + 1]) == "auto"))
+                headlessBackend = argv[++i];
+        }
+        else if (arg == "--gpu" && i + 1 < argc) {
+            headlessDevice = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--gpus" && i + 1 < argc) {
+            gpus = std::max(0, std::stoi(argv[++i]));
+        }
+        else if (arg == "--claim-views") {
+            claimViews = true;
+        }
+        else if (arg == "--no-shader-cache") {
+            ProgramCache::enabled = false;
+        }
+        // Writes the final GLSL of every program built into the directory for the offline SPIR-V compile
+        else if (arg == "--dump-glsl") {
+            SpirvShaders::dumping = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                SpirvShaders::directory = argv[++i];
+        }
+        else if (arg == "--no-spirv") {
+            SpirvShaders::enabled = false;
+        }
+        else if (arg == "--gl-debug") {
+            glDebug = true;
+            if (i + 1 < argc && std::string(argv[i + 1]) == "sync") {
+                glDebugSync = true;
+                i++;
+            }
+        }
+        else if (arg == "--facades" && i + 2 < argc) {
+            facadeCount = std::max(1, std::stoi(argv[++i]));
+            facadeSize = std::max(1, std::stoi(argv[++i]));
+            layout.facadeCount = facadeCount;
+        }
+        else if (arg == "--texture-budget" && i + 1 < argc) {
+            textureBudgetMB = std::stof(argv[++i]);
+        }
+        else if (arg == "--virtual-texture" && i + 1 < argc) {
+            virtualTexturePath = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                virtualCacheMB = std::max(1.0f, std::stof(argv[++i]));
+        }
+        else if (arg == "--anisotropy" && i + 1 < argc) {
+            anisotropy = std::stof(argv[++i]);
+        }
+        else if (arg == "--hot-reload") {
+            hotReload = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                shaderDirectory = argv[++i];
+        }
+    }
+    if (!suiteOutput.empty())
+        return benchmarkSuite(argc, argv, suiteOutput, suiteScenesOnly, suiteBaseline, suiteThreshold);
+    // Offline mode that writes every tile of the --stream world into the tile directory, no window is opened
+    if (cookTiles) {
+        if (streamTilesX <= 0 || streamTilesZ <= 0) {
+            std::cerr << "--cook-tiles needs the world size from --stream" << std::endl;
+            return EXIT_FAILURE;
+        }
+        return TileStreamer::Cook(layout, streamTilesX, streamTilesZ, tileDirectory) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Offline mode that extrudes the footprints of a map into every tile of the --stream world, no window is opened
+    // Stream the result with the same --stream, layout and --tile-dir
+    if (!footprintPath.empty()) {
+        if (streamTilesX <= 0 || streamTilesZ <= 0) {
+            std::cerr << "--import-footprints needs the world size from --stream" << std::endl;
+            return EXIT_FAILURE;
+        }
+        JobSystem importJobs(jobThreads < 0 ? JobSystem::DefaultThreads() : (unsigned int)jobThreads);
+        FootprintImporter importer(importJobs);
+        importer.metersPerUnit = metersPerUnit;
+        if (!importer.Read(footprintPath))
+            return EXIT_FAILURE;
+        return importer.WriteTiles(layout, streamTilesX, streamTilesZ, tileDirectory) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Offline mode that casts the rays for the sun hours of every facade and reports how fast it went, no window is opened
+    if (sunReport)
+        return sunHours(layout, sunLatitude, jobThreads < 0 ? JobSystem::DefaultThreads() : (unsigned int)jobThreads);
+    // Offline mode that generates the city once and writes it as a scene file, --scene maps it back later
+    if (!saveScenePath.empty()) {
+        JobSystem bakeJobs(jobThreads < 0 ? JobSystem::DefaultThreads() : (unsigned int)jobThreads);
+        if (!SceneFile::Write(saveScenePath, CityGenerator(layout), bakeJobs)) {
+            std::cerr << "Failed to write scene " << saveScenePath << std::endl;
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    SceneFile sceneFile;
+    if (!scenePath.empty()) {
+        if (!sceneFile.Open(scenePath)) {
+            std::cerr << "Failed to open scene " << scenePath << std::endl;
+            return EXIT_FAILURE;
+        }
+        layout = sceneFile.layout;
+    }
+    // The streamed world replaces the single city, which is drawn merged so none of the instanced passes are set up
+    bool streaming = streamTilesX > 0 && streamTilesZ > 0;
+    if (streaming)
+        instanced = false;
+    // Tiles stay float vertices, their merged meshes have no record to carry a box in
+    if (streaming)
+        compactVertices = false;
+    // Both eyes come out of the instanced draws, each record read twice and the instance's parity picking the eye, so
+    // only the passes drawing the instanced city from the camera's records are left
+    bool stereo = stereoSeparation > 0.0f;
+    if (stereo && !instanced) {
+        std::cerr << "--stereo needs instanced drawing, the merged and streamed cities are drawn for one eye" << std::endl;
+        stereo = false;
+    }
+    if (stereo) {
+        std::cout << "Billboards, roofs, props, traffic, lights, shadows, glass, sky, water, weather, occlusion culling, "
+            "deferred shading and the post effects are off while both eyes are drawn" << std::endl;
+        billboards = roofs = sky = water = deferred = ssao = false;
+        occlusionCulling = gpuCulling = softwareOcclusion = blockQuerying = proceduralBoxes = false;
+        trafficVehicles = 0;
+        propsPerBlock = 0;
+        lightCount = shadowSize = glassEvery = probesPerSide = 0;
+        lightMarkerPixels = -1.0f;
+        weatherKind = ParticleSystem::WEATHER_NONE;
+        smokeChimneys = 0;
+        meshletMB = 0.0f;
+        postEffects = 0;
+        volumetricFogDensity = 0.0f;
+        antiAliasingMode = AntiAliasing::NONE;
+        dynamicResolutionMs = 0.0f;
+        pickPixel = glm::ivec2(-1);
+    }
+    // Storage buffers in vertex shaders are optional even in GL 4.3, and tiles keep attributes on a heap of their own
+    GLint vertexStorageBlocks = 0;
+    if ((vertexPulling || packedTiles) && GLExt.shaderStorage && (GLExt.major > 4 || (GLExt.major == 4 && GLExt.minor >= 3)))
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexStorageBlocks);
+    if (vertexPulling && (streaming || vertexStorageBlocks <= 0)) {
+        std::cerr << "--vertex-pulling needs GL 4.3 with storage buffers in vertex shaders and the generated city, fetching attributes" << std::endl;
+        vertexPulling = false;
+    }
+    // Packed tiles are pulled from the tile heap by every scene program, which only draws tiles while streaming
+    if (packedTiles && (!streaming || vertexStorageBlocks <= 0)) {
+        std::cerr << "--tile-packed needs --stream and GL 4.3 with storage buffers in vertex shaders, keeping float vertices" << std::endl;
+        packedTiles = false;
+    }
+    // Only the instanced unit building is a plain box, the culling passes write commands for its mesh
+    if (proceduralBoxes && (!vertexPulling || !instanced || !modelPath.empty())) {
+        std::cerr << "--procedural-boxes needs vertex pulling and the instanced boxes, drawing the unit building mesh" << std::endl;
+        proceduralBoxes = false;
+    }
+    if (proceduralBoxes && (occlusionCulling || gpuCulling)) {
+        std::cout << "Occlusion and GPU culling are off while the boxes are procedural" << std::endl;
+        occlusionCulling = gpuCulling = false;
+    }
+    bool batching = !instanced && !streaming && batchMB > 0.0f;
+    // Terrain patches are instance records, the merged city and the tiles have their ground baked into their meshes
+    if (terrain && !instanced) {
+        std::cerr << "--terrain needs instanced drawing, the merged and streamed cities keep the flat ground" << std::endl;
+        terrain = false;
+    }
+    // Records are packed while the frame's instances are streamed, terrain patches have to meet exactly and the culling
+    // passes read float records
+    if (compactInstances && (!instanced || terrain)) {
+        std::cerr << "--compact-instances needs instanced drawing on the flat ground, streaming float records" << std::endl;
+        compactInstances = false;
+    }
+    if (compactInstances && (occlusionCulling || gpuCulling || meshletMB > 0.0f)) {
+        std::cout << "Occlusion, GPU and meshlet culling are off while instance records are compact" << std::endl;
+        occlusionCulling = gpuCulling = false;
+        meshletMB = 0.0f;
+    }
+    // Lights are placed around the generated city, the streamed world has none
+    if (streaming) {
+        lightCount = 0;
+        shadowSize = 0;
+    }
+    if (lightShadowCount > 0 && lightCount <= 0) {
+        std::cerr << "--light-shadows shadows the point lights of --lights, there are none" << std::endl;
+        lightShadowCount = 0;
+    }
+    if (decalCount > 0 && lightCount <= 0) {
+        std::cerr << "--decals are binned into the clusters of --lights, there are none" << std::endl;
+        decalCount = 0;
+    }
+
+    // The views of a batch export, one image each in the order of their times
+    bool exportViews = !viewsPath.empty();
+    CameraPath views;
+    if (exportViews) {
+        if (!views.Load(viewsPath)) {
+            std::cerr << "Failed to load views " << viewsPath << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (viewFormat != "png" && viewFormat != "exr") {
+            std::cerr << "Unknown view format " << viewFormat << ", expected png or exr" << std::endl;
+            return EXIT_FAILURE;
+        }
+        if (posterWidth > 0 && (viewFormat != "png" || stereo)) {
+            std::cerr << "Posters are stitched from PNG tiles of one eye, --poster cannot be combined with --view-format exr or --stereo" << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(viewsOutput, error);
+        if (error) {
+            std::cerr << "Failed to create " << viewsOutput << std::endl;
+            return EXIT_FAILURE;
+        }
+        // Benchmarks time the window's frames, an export has none to time
+        benchmark = false;
+        if (claimViews)
+            std::filesystem::create_directories(std::filesystem::path(viewsOutput) / "claims", error);
+        if (gpus >= 0 && !claimViews) {
+            int processes = gpus > 0 ? gpus : HeadlessContext::DeviceCount();
+            if (processes <= 0) {
+                std::cerr << "No EGL devices to render the views on" << std::endl;
+                return EXIT_FAILURE;
+            }
+            return renderFarm(argc, argv, processes, viewsOutput);
+        }
+    }
+
+    else if (posterWidth > 0) {
+        std::cerr << "--poster needs --render-views" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::unique_ptr<Poster> poster;
+    if (posterWidth > 0)
+        poster = std::make_unique<Poster>(posterWidth, posterHeight, viewWidth, viewHeight);
+
+    // Nothing would ever end a headless run that is not a benchmark or an export
+    if (headless && !benchmark && !exportViews) {
+        std::cerr << "--headless needs --benchmark or --render-views" << std::endl;
+        return EXIT_FAILURE;
+    }
+    // Frames of a headless run and of an export go to an offscreen target of the view size instead of the window
+    const bool offscreen = headless || exportViews;
+    // Messages are printed by a thread of their own from here on
+    Log.level = logLevel;
+    Log.siteRate = (uint32_t)logRate;
+    Log.Start();
+    // The timeline starts here so it shows the startup and the texture decodes too
+    if (!traceOut.empty()) {
+        Tracer.NameThread("main");
+        Tracer.Start();
+    }
+    startup.Mark("options");
+
+    // Shader sources, the scene mapping and the facade images need no context, the workers read them while the
+    // window and context are created. The job system is declared after what its jobs write, so returning early
+    // finishes the jobs before any of it goes
+    // Hot reloading starts each file from the built in source the first time, after that the file is what is built
+    std::string shaderSources[SHADER_FILE_COUNT];
+    auto shaderPath = [&](int file) {
+        return (std::filesystem::path(shaderDirectory) / shaderFileNames[file]).string();
+    };
+    std::vector<TextureLoader::Encoded> facadeBytes(facadeImageCount);
+    JobSystem::Counter shaderReads;
+    JobSystem::Counter assetReads;
+    // One pool of workers for model parsing, culling, record packing, image decoding and tile loading
+    JobSystem jobs(jobThreads < 0 ? JobSystem::DefaultThreads() : (unsigned int)jobThreads);
+    jobs.Submit([&]() {
+        TraceScope scope("shader sources", "startup");
+        const std::string builtIn[SHADER_FILE_COUNT] = { vertexShaderSource, fragmentShaderSource, bindlessFragmentShaderSource,
+            billboardVertexShaderSource, billboardFragmentShaderSource, pickFragmentShaderSource, glassFragmentShaderSource,
+            get_shader_contents("light.vert"), get_shader_contents("light.frag"), frameDataShaderSource };
+        std::copy(builtIn, builtIn + SHADER_FILE_COUNT, shaderSources);
+        if (!hotReload)
+            return;
+        std::error_code error;
+        std::filesystem::create_directories(shaderDirectory, error);
+        for (int file = 0; file < SHADER_FILE_COUNT; file++) {
+            if (!std::filesystem::exists(shaderPath(file))) {
+                std::ofstream out(shaderPath(file), std::ios::binary);
+                out << shaderSources[file];
+            }
+            try {
+                shaderSources[file] = get_file_contents(shaderPath(file).c_str());
+            }
+            catch (int) {
+                std::cerr << "Failed to read " << shaderPath(file) << ", using the built in source" << std::endl;
+            }
+        }
+        std::cout << "Hot reloading the shaders in " << shaderDirectory << std::endl;
+    }, &shaderReads);
+    if (sceneFile.isOpen())
+        jobs.Submit([&]() {
+            TraceScope scope("scene mapping", "startup");
+            sceneFile.Prefetch();
+        }, &assetReads);
+    // Only the source images are read ahead, cooked files and a model's own images go their own ways
+    bool cookedOnDisk = facadeSize == 512;
+    for (GLsizei i = 0; i < facadeImageCount; i++)
+        cookedOnDisk = cookedOnDisk && std::filesystem::exists(std::string("cooked/") + facadeImages[i] + ".dds");
+    if (modelPath.empty() && !cookedOnDisk) {
+        for (GLsizei i = 0; i < facadeImageCount; i++)
+            jobs.Submit([&, i]() {
+                TraceScope scope("facade image", "startup", facadeImages[i]);
+                facadeBytes[i] = TextureLoader::Read(std::string(facadeImages[i]) + ".jpg");
+            }, &assetReads);
+    }
+
+    // Initialize GLFW and GLAD, or a context without any window on a server with no display
+    GLFWwindow* window = nullptr;
+    HeadlessContext headlessContext;
+    headlessContext.debug = glDebug;
+    if (headless) {
+        if (!initHeadlessAndGLAD(headlessContext, headlessBackend, headlessDevice))
+            return EXIT_FAILURE;
+        startup.Mark("context");
+    }
+    else {
+        window = initGLFWandGLAD(benchmark || exportViews, glDebug, startup);
+    }
+    if (glDebug && !GLDebug.Enable(glDebugSync))
+        std::cerr << "GL debug output needs GL 4.3 or KHR_debug" << std::endl;
+    // Every texture drawn is filtered by one of the shared samplers, the performance tier sets their anisotropy
+    Samplers.Create();
+    Samplers.SetAnisotropy(anisotropy);
+    if (anisotropy > 1.0f && Samplers.anisotropy() <= 1.0f)
+        std::cerr << "Anisotropic filtering needs GL 4.6 or EXT_texture_filter_anisotropic, filtering trilinear" << std::endl;
+    // The tier only fills in what the options did not set, a stereo frame has already turned those passes off
+    if (autoQualityMs > 0.0f && stereo) {
+        std::cerr << "--auto-quality keeps the settings of a stereo frame" << std::endl;
+    }
+    else if (autoQualityMs > 0.0f) {
+        GpuCalibration calibration;
+        calibration.Run(recalibrate);
+        int outputWidth = viewWidth, outputHeight = viewHeight;
+        if (window)
+            glfwGetFramebufferSize(window, &outputWidth, &outputHeight);
+        const GpuCalibration::Tier& tier = calibration.Pick(autoQualityMs, outputWidth, outputHeight, deferred);
+        auto given = [&](const char* option) {
+            for (int i = 1; i < argc; i++)
+                if (std::string(argv[i]) == option)
+                    return true;
+            return false;
+        };
+        if (!given("--shadows") && !given("--shadow-size") && !streaming)
+            shadowSize = tier.shadowSize;
+        if (!given("--ssao"))
+            ssao = tier.ssao;
+        if (!given("--aa"))
+            antiAliasingMode = tier.antiAliasing;
+        if (!given("--dynamic-res") && tier.resolutionScale < 1.0f) {
+            dynamicResolutionMs = autoQualityMs;
+            dynamicResolutionMaxScale = tier.resolutionScale;
+        }
+        if (!given("--lod"))
+            levelOfDetail.impostorPixels *= tier.lodBias;
+        if (!given("--billboard"))
+            levelOfDetail.billboardPixels *= tier.lodBias;
+        std::cout << "Quality tier " << tier.name << ", an estimated " << calibration.Estimate(tier, outputWidth, outputHeight, deferred)
+                  << " ms of GPU time for " << autoQualityMs << (calibration.cached ? " from the cached calibration" : "") << std::endl;
+    }
+    // The render thread and the simulation thread hand the context over through these
+    auto makeContextCurrent = [&]() {
+        if (window)
+            glfwMakeContextCurrent(window);
+        else
+            headlessContext.MakeCurrent();
+    };
+    auto releaseContext = [&]() {
+        if (window)
+            glfwMakeContextCurrent(nullptr);
+        else
+            headlessContext.ReleaseCurrent();
+    };
+    // Every program is submitted up front, the driver compiles them while the city and textures are set up
+    // Each comes as an unlit and a lit permutation, toggling the light switches programs instead of testing a uniform
+    // With point lights there is a third, lit and clustered, that replaces the lit one while drawing the city
+    // The fourth fills the G-buffer when the scene is lit with deferred shading
+    // Every lit one samples the sun shadows when they are on, the unlit one also draws into the shadow maps
+    jobs.Wait(shaderReads);
+    Shader::AddInclude(shaderFileNames[FRAME_DATA_INCLUDE], shaderSources[FRAME_DATA_INCLUDE]);
+    // With terrain every scene program places the patches, the depth pre-pass and shadow casters included
+    unsigned int placement = terrain ? (unsigned int)SHADER_TERRAIN : 0u;
+    if (vertexPulling)
+        placement |= SHADER_VERTEX_PULLING | (compactVertices ? (unsigned int)SHADER_COMPACT_VERTICES : 0u);
+    if (proceduralBoxes)
+        placement |= SHADER_PROCEDURAL_BOXES;
+    if (packedTiles)
+        placement |= SHADER_VERTEX_PULLING | SHADER_PACKED_MESHLETS;
+    if (stereo)
+        placement |= SHADER_STEREO;
+    unsigned int lit = placement | SHADER_LIGHTING;
+    if (shadowSize > 0)
+        lit |= SHADER_SHADOWS;
+    // The lit programs look their facade layer, tint and highlights up in the material table where fragment shaders
+    // can read storage buffers, the bindless ones always do
+    bool materialTable = GLExt.shaderStorage && (GLExt.major > 4 || (GLExt.major == 4 && GLExt.minor >= 3));
+    if (materialTable)
+        lit |= SHADER_MATERIALS;
+    // With a virtual texture the lit programs page the facades in from it, the bindless ones are left out
+    std::unique_ptr<VirtualTexture> virtualTexture;
+    if (!virtualTexturePath.empty() && !modelPath.empty())
+        std::cerr << "--virtual-texture pages in the facades of the generated city, a model keeps its own images" << std::endl;
+    else if (!virtualTexturePath.empty()) {
+        virtualTexture = std::make_unique<VirtualTexture>(jobs);
+        if (virtualTexture->Open(virtualTexturePath, (int64_t)(virtualCacheMB * 1024.0f * 1024.0f)))
+            lit |= SHADER_VIRTUAL_TEXTURE;
+        else
+            virtualTexture.reset();
+    }
+    // Glass is told apart by its material and drawn again from the instanced draw commands, the depth pre-pass would
+    // have laid down its depth
+    if (glassEvery > 0 && (!materialTable || !instanced)) {
+        std::cerr << "--glass needs GL 4.3 and instanced drawing, the facades stay opaque" << std::endl;
+        glassEvery = 0;
+    }
+    if (probesPerSide > 0 && glassEvery <= 0) {
+        std::cerr << "--probes needs --glass, nothing reflects them" << std::endl;
+        probesPerSide = 0;
+    }
+    if (glassEvery > 0 && depthPrepass) {
+        std::cout << "The depth pre-pass is off while glass is drawn" << std::endl;
+        depthPrepass = false;
+    }
+    // The forward lit programs leave the glass to its own program, the unlit and deferred frames draw it opaque
+    unsigned int forward = lit | (glassEvery > 0 ? (unsigned int)SHADER_GLASS : 0u) | (fogDensity > 0.0f ? (unsigned int)SHADER_FOG : 0u);
+    // Features of the scene and bindless programs by slot, the slots of the programs that are left out stay 0
+    unsigned int clustered = forward | SHADER_CLUSTERED | (lightShadowCount > 0 ? (unsigned int)SHADER_LIGHT_SHADOWS : 0u)
+        | (decalCount > 0 ? (unsigned int)SHADER_DECALS : 0u);
+    const unsigned int slotFeatures[4] = { placement, forward, clustered, lit | SHADER_DEFERRED };
+    ProgramBuild sceneBuilds[4];
+    ProgramBuild bindlessBuilds[4];
+    for (int i = 0; i < 4; i++) {
+        if (i == 2 && lightCount <= 0)
+            continue;
+        // The G-buffer passes light from one camera, stereo frames stay forward
+        if (i == 3 && stereo)
+            continue;
+        sceneBuilds[i] = submitShaderProgram(shaderSources[SCENE_FRAGMENT].c_str(), slotFeatures[i], shaderSources[SCENE_VERTEX].c_str());
+        if (GLExt.bindlessTexture && !virtualTexture)
+            bindlessBuilds[i] = submitShaderProgram(shaderSources[BINDLESS_FRAGMENT].c_str(), slotFeatures[i], shaderSources[SCENE_VERTEX].c_str());
+    }
+    billboards = billboards && lod && instanced;
+    if (water && !billboards) {
+        std::cerr << "--water reflects the block billboards, which need level of detail and instanced drawing" << std::endl;
+        water = false;
+    }
+    // Impostors stand in for buildings of the forward frames, so they are fogged the same
+    const unsigned int billboardFeatures = fogDensity > 0.0f ? (unsigned int)SHADER_FOG : 0u;
+    ProgramBuild billboardBuild;
+    if (billboards)
+        billboardBuild = submitShaderProgram(shaderSources[BILLBOARD_FRAGMENT].c_str(), billboardFeatures, shaderSources[BILLBOARD_VERTEX].c_str());
+    // Picking numbers the buildings by their index, which batches and tiles no longer keep apart
+    // Only a window or --pick ever picks, a headless run without it builds no ID program
+    bool picking = (instanced || (!batching && !streaming)) && (!offscreen || pickPixel.x >= 0);
+    if (pickPixel.x >= 0 && !picking)
+        std::cerr << "--pick needs the instanced or the merged city, batches and tiles do not number their buildings" << std::endl;
+    ProgramBuild pickBuild;
+    if (picking)
+        pickBuild = submitShaderProgram(shaderSources[PICK_FRAGMENT].c_str(), placement | SHADER_PICKING, shaderSources[SCENE_VERTEX].c_str());
+    const unsigned int glassFeatures = placement | SHADER_MATERIALS | SHADER_GLASS | (probesPerSide > 0 ? (unsigned int)SHADER_PROBES : 0u);
+    ProgramBuild glassBuild;
+    if (glassEvery > 0)
+        glassBuild = submitShaderProgram(shaderSources[GLASS_FRAGMENT].c_str(), glassFeatures, shaderSources[SCENE_VERTEX].c_str());
+    // Markers are drawn where ClusteredLights has binned the point lights
+    if (lightMarkerPixels >= 0.0f && lightCount <= 0) {
+        std::cerr << "--light-markers needs --lights, no markers are drawn" << std::endl;
+        lightMarkerPixels = -1.0f;
+    }
+    ProgramBuild markerBuild;
+    if (lightMarkerPixels >= 0.0f)
+        markerBuild = submitShaderProgram(shaderSources[LIGHT_FRAGMENT].c_str(), SHADER_LIGHT_MARKERS, shaderSources[LIGHT_VERTEX].c_str());
+    startup.Mark("shader submit");
+    // The camera path of a benchmark, "orbit" circles the city instead of reading a file
+    CameraPath cameraPath;
+    // The simulation runs in steps of this many seconds, benchmarks render one frame per step
+    const double simulationStep = 1.0 / 60.0;
+    const int benchmarkWarmup = 30;
+    if (benchmark) {
+        CityGenerator sizing(layout);
+        if (benchmarkPath == "orbit") {
+            float radius = std::max(sizing.halfExtentX(), sizing.halfExtentZ()) + 5.0f;
+            cameraPath.Orbit(glm::vec3(0.0f), radius, layout.maxHeight + 2.0f + (terrain ? terrainHeight : 0.0f), 20.0f);
+        }
+        else if (!cameraPath.Load(benchmarkPath)) {
+            std::cerr << "Failed to load camera path " << benchmarkPath << std::endl;
+            if (window)
+                glfwTerminate();
+            return EXIT_FAILURE;
+        }
+        if (benchmarkFrames <= 0)
+            benchmarkFrames = std::max(1, (int)(cameraPath.duration() / simulationStep + 0.5));
+    }
+    // A session log drives the clock and the input itself, a benchmark and an export have their own
+    SessionLog sessionLog;
+    if (!replaySession.empty()) {
+        if (benchmark || exportViews) {
+            std::cerr << "--replay-session cannot be combined with --benchmark or --render-views" << std::endl;
+            if (window)
+                glfwTerminate();
+            return EXIT_FAILURE;
+        }
+        if (!sessionLog.Load(replaySession)) {
+            if (window)
+                glfwTerminate();
+            return EXIT_FAILURE;
+        }
+        if (sessionLog.step() != simulationStep)
+            std::cerr << "Warning: " << replaySession << " was recorded with steps of " << sessionLog.step() << " s, frames will differ" << std::endl;
+        // The frames are drawn at the recorded sizes, the window is made the size it started with so they fit it
+        if (window && sessionLog.frame(0).windowWidth > 0 && sessionLog.frame(0).windowHeight > 0)
+            glfwSetWindowSize(window, sessionLog.frame(0).windowWidth, sessionLog.frame(0).windowHeight);
+        std::cout << "Replaying " << sessionLog.frameCount() << " frames of " << replaySession << std::endl;
+    }
+    else if (!recordSession.empty() && !benchmark && !exportViews) {
+        if (!sessionLog.Record(recordSession, simulationStep))
+            std::cerr << "Failed to create the session log " << recordSession << std::endl;
+    }
+    const bool replay = sessionLog.replaying();
+    // Benchmarks are not limited by the display refresh or a frame rate
+    FramePacer pacer(benchmark || exportViews ? 0 : swapInterval, benchmark || exportViews ? 0.0 : frameRateLimit);
+    if (window)
+        pacer.Apply();
+
+    // Zones of the frame and of startup, P toggles the overlay, a benchmark keeps every frame
+    Profiler profiler(benchmark ? (size_t)benchmarkFrames : Profiler::HISTORY);
+    bool showProfiler = false;
+    // Shader invocations and clipped primitives per pass, the zones that count them follow each other without overlapping
+    if (pipelineStatistics && !GLExt.pipelineStatistics)
+        std::cerr << "Pipeline statistics need GL 4.6 or ARB_pipeline_statistics_query, measuring times only" << std::endl;
+    profiler.pipelineStatistics = pipelineStatistics && GLExt.pipelineStatistics;
+    // Primitives drawn over the measured frames of a benchmark, one query spans all of them
+    GLuint primitivesQuery = 0;
+    bool countingPrimitives = false;
+    if (benchmark)
+        glGenQueries(1, &primitivesQuery);
+    double lastTitleUpdate = 0.0;
+
+    // A model from an OBJ or glTF file takes the place of the unit building every instance is scaled from
+    ObjModel model;
+    GltfModel gltf;
+    const GLfloat* modelVertices = nullptr;
+    const GLuint* modelIndices = nullptr;
+    GLuint modelVertexCount = 0, modelIndexCount = 0;
+    if (!modelPath.empty() && !instanced) {
+        std::cerr << "--model replaces the unit building of instanced drawing, the merged city keeps its boxes" << std::endl;
+    }
+    else if (!modelPath.empty()) {
+        std::chrono::steady_clock::time_point modelStart = std::chrono::steady_clock::now();
+        std::string extension = std::filesystem::path(modelPath).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        bool loaded;
+        std::string how;
+        if (extension == ".gltf" || extension == ".glb") {
+            loaded = gltf.Load(modelPath);
+            how = gltf.zeroCopyVertices ? "Mapped " : "Converted ";
+            modelVertices = gltf.vertices();
+            modelIndices = gltf.indices();
+            modelVertexCount = gltf.vertexCount();
+            modelIndexCount = gltf.indexCount();
+        }
+        else {
+            loaded = model.Load(modelPath, jobs);
+            how = model.cached ? "Mapped the cache of " : "Parsed ";
+            modelVertices = model.vertices.data();
+            modelIndices = model.indices.data();
+            modelVertexCount = model.vertexCount();
+            modelIndexCount = (GLuint)model.indices.size();
+        }
+        if (loaded) {
+            std::cout << how << modelPath << ", " << modelVertexCount << " vertices and " << modelIndexCount / 3 << " triangles in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - modelStart).count() << " ms" << std::endl;
+        }
+        else {
+            modelIndexCount = 0;
+            std::cerr << "Drawing the buildings as boxes" << std::endl;
+        }
+    }
+    const bool useModel = modelIndexCount > 0;
+    const GLuint unitVertexCount = useModel ? modelVertexCount : CityGenerator::BUILDING_VERTICES;
+    const GLuint unitIndexCount = useModel ? modelIndexCount : CityGenerator::BUILDING_INDICES;
+    // Images a glTF model brings take the place of the facades on its buildings
+    const bool modelImages = useModel && !gltf.images.empty();
+
+    startup.Mark("model");
+    CityGenerator city(layout);
+    if (streaming)
+        std::cout << "Streaming " << streamTilesX << "x" << streamTilesZ << " tiles of " << city.buildingCount() << " buildings" << std::endl;
+    else
+        std::cout << (sceneFile.isOpen() ? "Mapped " : "Generating ") << city.buildingCount() << " buildings ("
+                  << (instanced ? "instanced" : "merged") << ")" << std::endl;
+    // The heightmap is needed before the buildings are placed on it, a heightmap that cannot be read leaves the hills
+    std::unique_ptr<Terrain> terrainMap;
+    if (terrain) {
+        float side = terrainSize > 0.0f ? terrainSize : 8.0f * std::max(city.halfExtentX(), city.halfExtentZ());
+        terrainMap = std::make_unique<Terrain>(side, terrainHeight);
+        if (terrainPath.empty() || !terrainMap->Load(terrainPath))
+            terrainMap->Generate(512, layout.seed);
+        std::cout << "Terrain of " << side << " units a side, up to " << terrainHeight << " high" << std::endl;
+    }
+
+    // Non-instanced draws keep the identity instance transform, their color is set per draw
+    glVertexAttrib3f(4, 0.0f, 0.0f, 0.0f);
+    glVertexAttrib3f(5, 1.0f, 1.0f, 1.0f);
+    glVertexAttrib1f(6, 0.0f);
+    glVertexAttrib1f(7, 0.0f);
+    glVertexAttrib1f(8, 0.0f);
+
+    const GLsizei stride = CityGenerator::VERTEX_FLOATS * sizeof(float);
+    const GLsizei instanceStride = CityGenerator::INSTANCE_FLOATS * sizeof(float);
+    // Scene VAOs read the vertices from one binding and the instance records from another, so switching the records
+    // of a draw only links another region of a buffer to theirs
+    const GLuint vertexBinding = 0, recordBinding = 1;
+    auto formatVertices = [&](VAO& vao, GLuint buffer) {
+        vao.Format(0, 3, GL_FLOAT, GL_FALSE, 0, vertexBinding);
+        vao.Format(2, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float), vertexBinding);
+        vao.LinkBuffer(vertexBinding, buffer, 0, stride);
+    };
+    auto formatRecords = [&](VAO& vao) {
+        vao.Format(4, 3, GL_FLOAT, GL_FALSE, 0, recordBinding);
+        vao.Format(5, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), recordBinding);
+        vao.Format(6, 1, GL_FLOAT, GL_FALSE, 6 * sizeof(float), recordBinding);
+        vao.Format(7, 1, GL_FLOAT, GL_FALSE, 7 * sizeof(float), recordBinding);
+        vao.Format(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), recordBinding);
+        vao.Format(8, 1, GL_FLOAT, GL_FALSE, 11 * sizeof(float), recordBinding);
+        // In stereo every record is drawn as two instances, one per eye
+        vao.Divisor(recordBinding, stereo ? 2 : 1);
+    };
+
+    // The cars drive the flat streets of the one instanced city, their unit vehicle goes into the heap with the unit building
+    if (trafficVehicles > 0 && (!instanced || streaming || terrainMap)) {
+        std::cerr << "--traffic needs instanced drawing of a single city on the flat ground, the streets stay empty" << std::endl;
+        trafficVehicles = 0;
+    }
+    const GLuint vehicleVertices = trafficVehicles > 0 ? TrafficSimulation::VEHICLE_VERTICES : 0;
+    const GLuint vehicleIndices = trafficVehicles > 0 ? TrafficSimulation::VEHICLE_INDICES : 0;
+    // Every scene mesh lives in one vertex and index heap, so the whole scene draws with one VAO bound
+    // Instanced, that is the ground quad and the unit building every instance is scaled from, otherwise the merged city
+    // Indices are relative to each mesh, so 16 bits are enough unless the merged city has more vertices than that
+    // Batches never do, MeshBatcher closes them at 65536 vertices
+    // Terrain adds its whole and quarter patch meshes
+    const GLuint patchVertices = terrainMap ? Terrain::PATCH_VERTICES + Terrain::QUARTER_VERTICES : 0;
+    const GLuint patchIndices = terrainMap ? Terrain::PATCH_INDICES + Terrain::QUARTER_INDICES : 0;
+    // The streets of the merged city add their tiles
+    std::unique_ptr<RoadNetwork> roads;
+    if (roadTileBlocks > 0 && (instanced || streaming))
+        std::cerr << "--roads needs the --merged city of a single layout, the ground stays bare" << std::endl;
+    else if (roadTileBlocks > 0)
+        roads = std::make_unique<RoadNetwork>(city, roadTileBlocks);
+    const GLuint roadVertices = roads ? (GLuint)roads->vertexCount() : 0;
+    const GLuint roadIndices = roads ? (GLuint)roads->indexCount() : 0;
+    // The roofs of the instanced buildings add a mesh per shape
+    if (roofs && (!instanced || streaming || useModel)) {
+        std::cerr << "--roofs needs instanced boxes of a single city, the buildings stay flat topped" << std::endl;
+        roofs = false;
+    }
+    GLuint roofVertices = 0, roofIndices = 0;
+    for (int shape = 0; roofs && shape < RoofLibrary::SHAPE_COUNT; shape++) {
+        roofVertices += RoofLibrary::VertexCount((RoofLibrary::Shape)shape);
+        roofIndices += RoofLibrary::IndexCount((RoofLibrary::Shape)shape);
+    }
+    GpuBufferHeap sceneHeap(compactVertices ? (GLsizei)sizeof(CompactVertex) : stride,
+        (GLuint)(instanced ? CityGenerator::GROUND_VERTICES + unitVertexCount + patchVertices + vehicleVertices + roofVertices : city.vertexCount() + roadVertices),
+        (GLuint)(instanced ? CityGenerator::GROUND_INDICES + unitIndexCount + patchIndices + vehicleIndices + roofIndices : city.indexCount() + roadIndices),
+        EBO::IndexType(instanced ? std::max(unitVertexCount, patchVertices) : batching ? std::min<size_t>(city.vertexCount(), 65536) : city.vertexCount()));
+    uint32_t groundMesh = GpuBufferHeap::INVALID, buildingMesh = GpuBufferHeap::INVALID, cityMesh = GpuBufferHeap::INVALID;
+    uint32_t patchMesh = GpuBufferHeap::INVALID, quarterMesh = GpuBufferHeap::INVALID, vehicleMesh = GpuBufferHeap::INVALID;
+    uint32_t roofMeshes[RoofLibrary::SHAPE_COUNT];
+    std::fill(std::begin(roofMeshes), std::end(roofMeshes), GpuBufferHeap::INVALID);
+    // Compact positions are fractions of each mesh's box, its instance translation and scale turn them back
+    // The unit building spans the unit cube, so its box leaves the building records as they are
+    glm::vec3 groundBoxMin, groundBoxSize, buildingBoxMin, buildingBoxSize, cityBoxMin, cityBoxSize;
+    // Batches of merged buildings, culled by their bounds and drawn with their facade and compact box as constant attributes
+    struct StaticBatch {
+        uint32_t mesh;
+        unsigned int facade;
+        glm::vec3 min, max;
+        glm::vec3 boxMin, boxSize;
+    };
+    std::vector<StaticBatch> staticBatches;
+    // Street tiles, culled by their bounds and drawn a range per kind, with their compact box as constant attributes
+    struct RoadTile {
+        uint32_t mesh;
+        RoadNetwork::Tile ranges;
+        glm::vec3 boxMin, boxSize;
+    };
+    std::vector<RoadTile> roadTiles;
+    std::vector<CompactVertex> packedVertices;
+    auto allocateMesh = [&](const GLfloat* meshVertices, GLuint vertexCount, const GLuint* meshIndices, GLuint indexCount, glm::vec3& boxMin, glm::vec3& boxSize) {
+        boxMin = glm::vec3(0.0f);
+        boxSize = glm::vec3(1.0f);
+        if (!compactVertices)
+            return sceneHeap.Allocate(meshVertices, vertexCount, meshIndices, indexCount);
+        packedVertices.resize(vertexCount);
+        CompactVertex::Pack(meshVertices, vertexCount, meshIndices, indexCount, packedVertices.data(), boxMin, boxSize);
+        return sceneHeap.Allocate(packedVertices.data(), vertexCount, meshIndices, indexCount);
+    };
+    // From a scene file the meshes go from the mapping straight into the heap, the ground is the start of the city block
+    if (instanced && useModel) {
+        GLfloat groundVertices[CityGenerator::GROUND_VERTICES * CityGenerator::VERTEX_FLOATS];
+        GLuint groundIndices[CityGenerator::GROUND_INDICES];
+        city.GenerateGround(groundVertices, groundIndices);
+        groundMesh = allocateMesh(groundVertices, CityGenerator::GROUND_VERTICES, groundIndices, CityGenerator::GROUND_INDICES, groundBoxMin, groundBoxSize);
+        buildingMesh = allocateMesh(modelVertices, unitVertexCount, modelIndices, unitIndexCount, buildingBoxMin, buildingBoxSize);
+    }
+    else if (instanced && sceneFile.isOpen()) {
+        groundMesh = allocateMesh(sceneFile.cityVertices(), CityGenerator::GROUND_VERTICES, sceneFile.cityIndices(), CityGenerator::GROUND_INDICES, groundBoxMin, groundBoxSize);
+        buildingMesh = allocateMesh(sceneFile.unitVertices(), CityGenerator::BUILDING_VERTICES, sceneFile.unitIndices(), CityGenerator::BUILDING_INDICES, buildingBoxMin, buildingBoxSize);
+    }
+    else if (instanced) {
+        GLfloat groundVertices[CityGenerator::GROUND_VERTICES * CityGenerator::VERTEX_FLOATS];
+        GLuint groundIndices[CityGenerator::GROUND_INDICES];
+        city.GenerateGround(groundVertices, groundIndices);
+        GLfloat unitVertices[CityGenerator::BUILDING_VERTICES * CityGenerator::VERTEX_FLOATS];
+        GLuint unitIndices[CityGenerator::BUILDING_INDICES];
+        CityGenerator::GenerateUnitBuilding(unitVertices, unitIndices);
+        groundMesh = allocateMesh(groundVertices, CityGenerator::GROUND_VERTICES, groundIndices, CityGenerator::GROUND_INDICES, groundBoxMin, groundBoxSize);
+        buildingMesh = allocateMesh(unitVertices, CityGenerator::BUILDING_VERTICES, unitIndices, CityGenerator::BUILDING_INDICES, buildingBoxMin, buildingBoxSize);
+    }
+    else {
+        std::vector<GLfloat> vertices;
+        std::vector<GLuint> indices;
+        const GLfloat* cityVertices = sceneFile.isOpen() ? sceneFile.cityVertices() : nullptr;
+        const GLuint* cityIndices = sceneFile.isOpen() ? sceneFile.cityIndices() : nullptr;
+        if (!sceneFile.isOpen()) {
+            vertices.resize(city.vertexCount() * CityGenerator::VERTEX_FLOATS);
+            indices.resize(city.indexCount());
+            city.Generate(vertices.data(), indices.data(), jobs);
+            cityVertices = vertices.data();
+            cityIndices = indices.data();
+        }
+        if (batching) {
+            // The ground stays its own mesh, the buildings are merged by facade into batches of nearby buildings
+            groundMesh = allocateMesh(cityVertices, CityGenerator::GROUND_VERTICES, cityIndices, CityGenerator::GROUND_INDICES, groundBoxMin, groundBoxSize);
+            MeshBatcher batcher(CityGenerator::VERTEX_FLOATS, (size_t)(batchMB * 1024.0f * 1024.0f));
+            for (size_t i = 0; i < city.buildingCount(); i++) {
+                GLuint baseVertex = (GLuint)(CityGenerator::GROUND_VERTICES + i * CityGenerator::BUILDING_VERTICES);
+                batcher.Add(&cityVertices[baseVertex * CityGenerator::VERTEX_FLOATS], CityGenerator::BUILDING_VERTICES,
+                    &cityIndices[CityGenerator::GROUND_INDICES + i * CityGenerator::BUILDING_INDICES], CityGenerator::BUILDING_INDICES, city.building(i).facade, baseVertex);
+            }
+            for (const MeshBatcher::Batch& batch : batcher.Build()) {
+                StaticBatch placed;
+                placed.facade = batch.material;
+                placed.min = batch.min;
+                placed.max = batch.max;
+                placed.mesh = allocateMesh(batch.vertices.data(), (GLuint)(batch.vertices.size() / CityGenerator::VERTEX_FLOATS),
+                    batch.indices.data(), (GLuint)batch.indices.size(), placed.boxMin, placed.boxSize);
+                staticBatches.push_back(placed);
+            }
+            std::cout << "Batched " << city.buildingCount() << " buildings into " << staticBatches.size() << " batches" << std::endl;
+        }
+        else {
+            cityMesh = allocateMesh(cityVertices, (GLuint)city.vertexCount(), cityIndices, (GLuint)city.indexCount(), cityBoxMin, cityBoxSize);
+        }
+    }
+    // Every tile of streets is one mesh of the heap however many roads it has
+    if (roads) {
+        std::vector<GLfloat> tileVertices;
+        std::vector<GLuint> tileIndices;
+        for (size_t t = 0; t < roads->tileCount(); t++) {
+            tileVertices.resize(roads->vertexCount(t) * CityGenerator::VERTEX_FLOATS);
+            tileIndices.resize(roads->indexCount(t));
+            RoadTile tile;
+            tile.ranges = roads->GenerateTile(t, tileVertices.data(), tileIndices.data());
+            tile.mesh = allocateMesh(tileVertices.data(), (GLuint)roads->vertexCount(t), tileIndices.data(), (GLuint)tileIndices.size(), tile.boxMin, tile.boxSize);
+            if (tile.mesh == GpuBufferHeap::INVALID) {
+                std::cerr << "A road tile of " << roads->vertexCount(t) << " vertices does not fit the scene heap, use smaller --roads tiles" << std::endl;
+                break;
+            }
+            roadTiles.push_back(tile);
+        }
+        std::cout << "Laid the streets out in " << roadTiles.size() << " tiles of " << roads->vertexCount() << " vertices" << std::endl;
+    }
+    // The patches span the unit square, so a compact box leaves their records as they are
+    if (terrainMap) {
+        std::vector<GLfloat> gridVertices(Terrain::PATCH_VERTICES * CityGenerator::VERTEX_FLOATS);
+        std::vector<GLuint> gridIndices(Terrain::PATCH_INDICES);
+        glm::vec3 gridBoxMin, gridBoxSize;
+        Terrain::GeneratePatch(Terrain::PATCH_QUADS, gridVertices.data(), gridIndices.data());
+        patchMesh = allocateMesh(gridVertices.data(), Terrain::PATCH_VERTICES, gridIndices.data(), Terrain::PATCH_INDICES, gridBoxMin, gridBoxSize);
+        Terrain::GeneratePatch(Terrain::PATCH_QUADS / 2, gridVertices.data(), gridIndices.data());
+        quarterMesh = allocateMesh(gridVertices.data(), Terrain::QUARTER_VERTICES, gridIndices.data(), Terrain::QUARTER_INDICES, gridBoxMin, gridBoxSize);
+    }
+    // The unit vehicle spans the unit cube like the unit building, so a compact box leaves the car records as they are
+    if (trafficVehicles > 0) {
+        GLfloat carVertices[TrafficSimulation::VEHICLE_VERTICES * CityGenerator::VERTEX_FLOATS];
+        GLuint carIndices[TrafficSimulation::VEHICLE_INDICES];
+        glm::vec3 carBoxMin, carBoxSize;
+        TrafficSimulation::GenerateVehicle(carVertices, carIndices);
+        vehicleMesh = allocateMesh(carVertices, TrafficSimulation::VEHICLE_VERTICES, carIndices, TrafficSimulation::VEHICLE_INDICES, carBoxMin, carBoxSize);
+    }
+    // Every roof shape spans the unit cube as well
+    for (int shape = 0; roofs && shape < RoofLibrary::SHAPE_COUNT; shape++) {
+        GLfloat shapeVertices[RoofLibrary::MAX_VERTICES * CityGenerator::VERTEX_FLOATS];
+        GLuint shapeIndices[RoofLibrary::MAX_INDICES];
+        glm::vec3 shapeBoxMin, shapeBoxSize;
+        RoofLibrary::Generate((RoofLibrary::Shape)shape, shapeVertices, shapeIndices);
+        roofMeshes[shape] = allocateMesh(shapeVertices, RoofLibrary::VertexCount((RoofLibrary::Shape)shape), shapeIndices,
+            RoofLibrary::IndexCount((RoofLibrary::Shape)shape), shapeBoxMin, shapeBoxSize);
+    }
+    packedVertices = std::vector<CompactVertex>();
+    // The merged city has no instance record, its box goes into the constant instance attributes instead
+    if (!instanced) {
+        glVertexAttrib3fv(4, glm::value_ptr(cityBoxMin));
+        glVertexAttrib3fv(5, glm::value_ptr(cityBoxSize));
+    }
+    DrawCommandBuilder drawCommands(CityGenerator::VERTEX_FLOATS);
+    if (stereo)
+        drawCommands.views = 2;
+    RenderQueue renderQueue;
+    VAO sceneVAO;
+    sceneVAO.Bind();
+    sceneVAO.LinkElements(sceneHeap.indexBuffer);
+    // Pulled vertices need no attributes, the VAO only holds the indices and the records
+    if (vertexPulling) {
+        GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuBufferHeap::PULL_BINDING, sceneHeap.vertexBuffer);
+    }
+    else if (compactVertices) {
+        CompactVertex::Link(sceneVAO, vertexBinding, sceneHeap.vertexBuffer);
+    }
+    else {
+        formatVertices(sceneVAO, sceneHeap.vertexBuffer);
+    }
+    // Without instancing the record locations stay disabled and read the constant attributes
+    if (instanced)
+        formatRecords(sceneVAO);
+    sceneVAO.Label("scene");
+    GLDebug.Label(GL_BUFFER, sceneHeap.vertexBuffer, "scene vertices");
+    GLDebug.Label(GL_BUFFER, sceneHeap.indexBuffer, "scene indices");
+    sceneVAO.Unbind();
+    // The frame's visible instances in their compact format, everything else keeps drawing float records
+    VAO compactVAO;
+    if (compactInstances) {
+        compactVAO.Bind();
+        compactVAO.LinkElements(sceneHeap.indexBuffer);
+        if (compactVertices)
+            CompactVertex::Link(compactVAO, vertexBinding, sceneHeap.vertexBuffer);
+        else if (!vertexPulling)
+            formatVertices(compactVAO, sceneHeap.vertexBuffer);
+        CompactInstance::Format(compactVAO, recordBinding);
+        if (stereo)
+            compactVAO.Divisor(recordBinding, 2);
+        compactVAO.Label("compact instances");
+        compactVAO.Unbind();
+    }
+    // The cars are always compact records, written fresh every frame
+    VAO trafficVAO;
+    if (trafficVehicles > 0) {
+        trafficVAO.Bind();
+        trafficVAO.LinkElements(sceneHeap.indexBuffer);
+        if (compactVertices)
+            CompactVertex::Link(trafficVAO, vertexBinding, sceneHeap.vertexBuffer);
+        else if (!vertexPulling)
+            formatVertices(trafficVAO, sceneHeap.vertexBuffer);
+        CompactInstance::Format(trafficVAO, recordBinding);
+        trafficVAO.Label("traffic");
+        trafficVAO.Unbind();
+    }
+    // The roofs too, made up every frame from the records of the buildings drawn
+    VAO roofVAO;
+    if (roofs) {
+        roofVAO.Bind();
+        roofVAO.LinkElements(sceneHeap.indexBuffer);
+        if (compactVertices)
+            CompactVertex::Link(roofVAO, vertexBinding, sceneHeap.vertexBuffer);
+        else if (!vertexPulling)
+            formatVertices(roofVAO, sceneHeap.vertexBuffer);
+        CompactInstance::Format(roofVAO, recordBinding);
+        roofVAO.Label("roofs");
+        roofVAO.Unbind();
+    }
+    GLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    // A translation/scale/layer/fade record per building and per block impostor, the ground gets an identity record in front of them
+    // With compact vertices it is the ground's box instead
+    const GLfloat groundInstance[CityGenerator::INSTANCE_FLOATS] = { groundBoxMin.x, groundBoxMin.y, groundBoxMin.z, groundBoxSize.x, groundBoxSize.y, groundBoxSize.z, 0.0f, 0.0f,
+        CityGenerator::GROUND_COLOR[0], CityGenerator::GROUND_COLOR[1], CityGenerator::GROUND_COLOR[2] };
+    // A scene file has them already, they are packed straight out of the mapping
+    std::vector<GLfloat> generatedInstances, generatedBlockInstances;
+    const GLfloat* instances = nullptr;
+    const GLfloat* blockInstances = nullptr;
+    if (sceneFile.isOpen()) {
+        instances = sceneFile.instances();
+        blockInstances = sceneFile.blockInstances();
+    }
+    else if (instanced) {
+        generatedInstances.resize(city.buildingCount() * CityGenerator::INSTANCE_FLOATS);
+        city.GenerateInstances(generatedInstances.data(), jobs);
+        if (bakeOcclusion) {
+            std::chrono::steady_clock::time_point bakeStart = std::chrono::steady_clock::now();
+            size_t rays = AmbientOcclusion().Bake(city, generatedInstances.data(), jobs);
+            std::cout << "Baked the ambient occlusion of " << city.buildingCount() << " buildings, " << rays << " rays in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count() << " ms" << std::endl;
+        }
+        generatedBlockInstances.resize(city.blockCount() * CityGenerator::INSTANCE_FLOATS);
+        city.GenerateBlockInstances(generatedBlockInstances.data(), jobs);
+        instances = generatedInstances.data();
+        blockInstances = generatedBlockInstances.data();
+    }
+    // On terrain every building stands on the lowest ground of its lot and every block box spans its buildings,
+    // a scene file's records are copied first since its mapping is read only
+    if (terrainMap) {
+        if (sceneFile.isOpen()) {
+            generatedInstances.assign(instances, instances + city.buildingCount() * CityGenerator::INSTANCE_FLOATS);
+            generatedBlockInstances.assign(blockInstances, blockInstances + city.blockCount() * CityGenerator::INSTANCE_FLOATS);
+            instances = generatedInstances.data();
+            blockInstances = generatedBlockInstances.data();
+        }
+        jobs.ParallelFor(city.buildingCount(), JOB_GRAIN, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                GLfloat* record = &generatedInstances[i * CityGenerator::INSTANCE_FLOATS];
+                record[1] += terrainMap->lowest(glm::vec2(record[0], record[2]), glm::vec2(record[0] + record[3], record[2] + record[5]));
+            }
+        });
+        for (size_t block = 0; block < city.blockCount(); block++) {
+            const GLfloat* first = &instances[block * city.lotsPerBlock() * CityGenerator::INSTANCE_FLOATS];
+            float low = first[1], top = first[1] + first[4];
+            for (size_t lot = 1; lot < city.lotsPerBlock(); lot++) {
+                const GLfloat* record = &instances[(block * city.lotsPerBlock() + lot) * CityGenerator::INSTANCE_FLOATS];
+                low = std::min(low, record[1]);
+                top = std::max(top, record[1] + record[4]);
+            }
+            GLfloat* box = &generatedBlockInstances[block * CityGenerator::INSTANCE_FLOATS];
+            box[1] = low;
+            box[4] = top - low;
+        }
+    }
+    // Every building keeps the roof shape its lot's seed and footprint pick
+    std::vector<RoofLibrary::Shape> roofShapes;
+    if (roofs) {
+        roofShapes.resize(city.buildingCount());
+        for (size_t i = 0; i < city.buildingCount(); i++)
+            roofShapes[i] = RoofLibrary::ShapeOf(city.lotSeed(i), instances[i * CityGenerator::INSTANCE_FLOATS + 3], instances[i * CityGenerator::INSTANCE_FLOATS + 5]);
+    }
+    // Edits of single buildings go through here, the buffers holding every record get only the edited ones again
+    // instances follows the records, which are copied out of a scene file's mapping on the first edit
+    InstanceRecords instanceRecords(instances, instances ? city.buildingCount() : 0, CityGenerator::INSTANCE_FLOATS);
+    // Live metrics are received on a thread of their own and drained into the records before every frame
+    std::unique_ptr<LiveDataReceiver> liveData;
+    std::vector<LiveDataReceiver::Update> liveUpdates;
+    // A replay takes the updates of its log, what arrives on the port would make its frames differ
+    if (liveDataPort > 0 && instances && !replay) {
+        liveData = std::make_unique<LiveDataReceiver>((unsigned short)liveDataPort);
+        if (liveData->isOpen()) {
+            liveUpdates.resize(LiveDataReceiver::CAPACITY);
+            std::cout << "Receiving live building metrics on UDP port " << liveDataPort << std::endl;
+        }
+        else
+            liveData.reset();
+    }
+    // Edits of a collaborative session are received on a thread of their own, the simulation thread drains them and
+    // applies them before culling, so a remote edit shows in the next frame drawn
+    std::unique_ptr<SceneSync> sync;
+    if (syncPort > 0 && (!instances || replay)) {
+        std::cerr << "Scene sync needs instanced buildings and cannot be replayed, ignoring --sync" << std::endl;
+    }
+    else if (syncPort > 0) {
+        sync = std::make_unique<SceneSync>((unsigned short)syncPort, syncPeers);
+        if (sync->isOpen())
+            std::cout << "Synchronizing building edits on UDP port " << syncPort << " with " << syncPeers.size() << " peers" << std::endl;
+        else
+            sync.reset();
+    }
+    // Projected size of every block, negative until a visible building of the block asks for it this frame
+    std::vector<float> blockSize(city.blockCount(), -1.0f);
+    std::vector<uint32_t> touchedBlocks;
+    touchedBlocks.reserve(city.blockCount());
+    // Workers pack the records of their share of the visible buildings at the same place in arrays of the render
+    // thread's frame arena, and list the blocks they measured, the render thread copies the slices into the stream after them
+    struct FillSlice {
+        size_t begin = 0;
+        size_t count = 0;
+        std::pair<uint32_t, float>* blocks = nullptr;
+        size_t blockCount = 0;
+    };
+    std::vector<FillSlice> fillSlices(jobs.threadCount() + 1);
+    FrameArena renderArena;
+    // Buildings each culling slice kept
+    std::vector<size_t> cullCounts(jobs.threadCount() + 1);
+    // Records of the visible instances are streamed every frame, the attributes point at the current region
+    // The ground record or the terrain patches come first
+    const size_t groundCapacity = terrainMap ? Terrain::MAX_PATCHES : 1;
+    // Each frame is fenced once, the render thread waits on the fences to bound the frames in flight and the streams
+    // reuse a region once the frame that wrote it is done
+    FrameScheduler frameScheduler(framesInFlight);
+    StreamBuffer instanceStream(GL_ARRAY_BUFFER, (city.buildingCount() + city.blockCount() + groundCapacity) * instanceStride);
+    instanceStream.scheduler = &frameScheduler;
+    GLDebug.Label(GL_BUFFER, instanceStream.ID, "visible instances");
+    // With multi draw indirect the commands are streamed too and the whole pass is a single draw call
+    // There is one command for the ground and one for the buildings, terrain has one for its whole and one for its quarter patches
+    std::unique_ptr<StreamBuffer> indirectStream;
+    if (GLExt.multiDrawIndirect)
+    {
+        indirectStream = std::make_unique<StreamBuffer>(GL_DRAW_INDIRECT_BUFFER, 3 * sizeof(DrawElementsIndirectCommand));
+        indirectStream->scheduler = &frameScheduler;
+    }
+    // Baked views of every block for billboards, as many blocks as an array texture has layers get one
+    std::unique_ptr<ImpostorAtlas> impostors;
+    std::unique_ptr<StreamBuffer> billboardStream;
+    std::vector<GLfloat> billboardRecords;
+    VAO billboardVAO;
+    bool impostorsBaked = false;
+    if (billboards) {
+        GLint maxLayers = 0;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        impostors = std::make_unique<ImpostorAtlas>(32, 8, (GLsizei)std::min<size_t>(city.blockCount(), (size_t)maxLayers));
+        billboardStream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, impostors->atlas.layers * ImpostorAtlas::RECORD_FLOATS * sizeof(float));
+        billboardStream->scheduler = &frameScheduler;
+        billboardRecords.resize(impostors->atlas.layers * ImpostorAtlas::RECORD_FLOATS);
+        // One record per quad, read from binding 0 of a region that moves every frame
+        billboardVAO.Bind();
+        billboardVAO.Format(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        billboardVAO.Format(1, 2, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+        billboardVAO.Format(2, 1, GL_FLOAT, GL_FALSE, 5 * sizeof(float), 0);
+        billboardVAO.Divisor(0, 1);
+        billboardVAO.Unbind();
+        for (GLsizei block = 0; block < impostors->atlas.layers; block++) {
+            const GLfloat* box = &blockInstances[block * CityGenerator::INSTANCE_FLOATS];
+            glm::vec3 min(box[0], box[1], box[2]);
+            ImpostorAtlas::WriteRecord(&billboardRecords[block * ImpostorAtlas::RECORD_FLOATS], min, min + glm::vec3(box[3], box[4], box[5]), block);
+        }
+    }
+    // Every building and block impostor that survives frustum culling is a candidate of the occlusion test,
+    // identified by its building index or by the building count plus its block index
+    std::unique_ptr<OcclusionCuller> occlusion;
+    if (reverseZ && !ReverseDepth::Supported()) {
+        std::cerr << "Reverse-Z needs glClipControl, drawing with the default depth range" << std::endl;
+        reverseZ = false;
+    }
+    std::unique_ptr<ReverseDepth> reverseDepth;
+    if (reverseZ)
+        reverseDepth = std::make_unique<ReverseDepth>();
+    // Offscreen frames draw into a target of the view size instead of the window, EXR keeps values past 1
+    std::unique_ptr<RenderTarget> viewTarget;
+    std::unique_ptr<ImageReadback> readback;
+    if (offscreen)
+        viewTarget = std::make_unique<RenderTarget>(viewWidth, viewHeight, exportViews && viewFormat == "exr" ? GL_RGBA16F : GL_RGBA8);
+    if (exportViews)
+        readback = std::make_unique<ImageReadback>(jobs);
+    // Images of a batch export are numbered in view order, a poster's tiles one after the other
+    const size_t viewImages = poster ? (size_t)poster->tileCount() : 1;
+    auto imageName = [&](size_t index) {
+        return poster ? Poster::TileName(index / viewImages, (int)(index % viewImages)) : Poster::Name(index);
+    };
+    // Screenshots of the window go through a readback of their own, its buffers are only allocated by the first
+    std::unique_ptr<ImageReadback> screenshots;
+    if (!offscreen)
+        screenshots = std::make_unique<ImageReadback>(jobs);
+    // The video keeps the size the frames start with, a resized window is scaled to it
+    std::unique_ptr<VideoEncoder> video;
+    if (!videoOutput.empty()) {
+        int videoWidth = viewWidth, videoHeight = viewHeight;
+        if (!offscreen)
+            glfwGetFramebufferSize(window, &videoWidth, &videoHeight);
+        video = std::make_unique<VideoEncoder>();
+        if (!video->Open(videoOutput, videoWidth, videoHeight, videoFps, videoEncoder, videoBitrate))
+            video.reset();
+    }
+    // Exported views are compared pixel by pixel, so they never change resolution
+    std::unique_ptr<DynamicResolution> dynamicResolution;
+    if (dynamicResolutionMs > 0.0f && exportViews) {
+        std::cerr << "Exported views are drawn at full resolution, ignoring --dynamic-res" << std::endl;
+    }
+    else if (dynamicResolutionMs > 0.0f) {
+        dynamicResolution = std::make_unique<DynamicResolution>(dynamicResolutionMs);
+        dynamicResolution->sharpness = upscaleSharpness;
+        dynamicResolution->maxScale = dynamicResolutionMaxScale;
+    }
+    // The volume is applied by the post pass in place of its fog
+    if (volumetricFogDensity > 0.0f && !(GLExt.computeShader && GLExt.textureStorage)) {
+        std::cerr << "--volumetric-fog needs compute shaders and texture storage, there is no volumetric fog" << std::endl;
+        volumetricFogDensity = 0.0f;
+    }
+    if (volumetricFogDensity > 0.0f)
+        postEffects |= PostProcess::FOG;
+    // FXAA joins the other post effects in their pass instead of filtering in one of its own
+    if (postEffects != 0 && antiAliasingMode == AntiAliasing::FXAA) {
+        postEffects |= PostProcess::FXAA;
+        antiAliasingMode = AntiAliasing::NONE;
+    }
+    if ((postEffects & PostProcess::BLOOM) && !(GLExt.computeShader && GLExt.textureStorage)) {
+        std::cerr << "Bloom needs compute shaders and texture storage, the scene does not bloom" << std::endl;
+        postEffects &= ~(unsigned int)PostProcess::BLOOM;
+    }
+    std::unique_ptr<PostProcess> postProcess;
+    if (postEffects != 0) {
+        postProcess = std::make_unique<PostProcess>(postEffects);
+        postProcess->reverseDepth = reverseZ;
+    }
+    // Its slices are those of the light clusters, which end at 100 like the volume
+    std::unique_ptr<VolumetricFog> volumetricFog;
+    if (volumetricFogDensity > 0.0f) {
+        volumetricFog = std::make_unique<VolumetricFog>(0.1f, 100.0f);
+        volumetricFog->density = volumetricFogDensity;
+        volumetricFog->falloff = fogFalloff;
+        volumetricFog->color = fogColor;
+    }
+    std::unique_ptr<AntiAliasing> antiAliasing;
+    if (antiAliasingMode != AntiAliasing::NONE) {
+        antiAliasing = std::make_unique<AntiAliasing>(antiAliasingMode);
+        antiAliasing->reverseDepth = reverseZ;
+        antiAliasing->resolveDepth = (postEffects & PostProcess::FOG) != 0;
+    }
+    // Set by the render thread once the facades are complete and the impostors baked, exported views wait for it
+    std::atomic<bool> assetsReady{ false };
+    // Meshlets are culled per building already, the occlusion test works on whole buildings and does not combine with them
+    std::unique_ptr<MeshletCuller> meshlets;
+    if (meshletMB > 0.0f && !useModel) {
+        std::cerr << "--meshlets needs a --model to cut, drawing the unit buildings whole" << std::endl;
+    }
+    else if (meshletMB > 0.0f && !MeshletCuller::Supported()) {
+        std::cerr << "Meshlets need compute shaders, storage buffers and multi draw indirect, drawing the model whole" << std::endl;
+    }
+    else if (meshletMB > 0.0f) {
+        std::vector<Meshlet> cut = MeshOptimizer::BuildMeshlets(modelVertices, CityGenerator::VERTEX_FLOATS, modelIndices, modelIndexCount, modelVertexCount);
+        GLuint maxPairs = (GLuint)std::min<double>(meshletMB * 1024.0 * 1024.0 / instanceStride, 0xFFFFFFFFu / CityGenerator::INSTANCE_FLOATS);
+        meshlets = std::make_unique<MeshletCuller>(cut, sceneHeap.mesh(buildingMesh), maxPairs, CityGenerator::INSTANCE_FLOATS);
+        std::cout << "Cut the model into " << cut.size() << " meshlets, room for " << maxPairs << " drawn per frame" << std::endl;
+        if (occlusionCulling)
+            std::cout << "Occlusion culling is off while meshlets are culled" << std::endl;
+        occlusionCulling = false;
+        if (gpuCulling)
+            std::cout << "GPU culling is off while meshlets are culled" << std::endl;
+        gpuCulling = false;
+    }
+    // The whole city stays resident for the GPU culler, the building records kept current like the shadow casters
+    std::unique_ptr<GpuCuller> gpuCuller;
+    std::unique_ptr<VBO> cityRecords, blockRecords;
+    if (gpuCulling && (!instanced || streaming)) {
+        std::cerr << "--gpu-cull needs the instanced path of a single city, culling on the CPU" << std::endl;
+        gpuCulling = false;
+    }
+    else if (gpuCulling && !GpuCuller::Supported()) {
+        std::cerr << "GPU culling needs compute shaders, storage buffers and multi draw indirect, culling on the CPU" << std::endl;
+        gpuCulling = false;
+    }
+    else if (gpuCulling) {
+        gpuCuller = std::make_unique<GpuCuller>((GLuint)city.buildingCount(), (GLuint)city.lotsPerBlock(), CityGenerator::INSTANCE_FLOATS);
+        gpuCuller->reverseDepth = reverseZ;
+        gpuCuller->cullPixels = levelOfDetail.cullPixels;
+        cityRecords = std::make_unique<VBO>(nullptr, (GLsizeiptr)std::max<size_t>(city.buildingCount() * instanceStride, instanceStride), GL_DYNAMIC_DRAW);
+        // Records of a scene file, on terrain or with baked occlusion are what only the CPU knows, so they are uploaded
+        if (gpuGenerating && (sceneFile.isOpen() || terrainMap || bakeOcclusion || !GpuCityGenerator::Supported())) {
+            std::cerr << "--gpu-generate needs a generated city on the flat ground without baked occlusion, uploading the records" << std::endl;
+            gpuGenerating = false;
+        }
+        if (gpuGenerating) {
+            std::chrono::steady_clock::time_point generateStart = std::chrono::steady_clock::now();
+            GpuCityGenerator generator((GLuint)city.buildingCount());
+            generator.SetLots(city);
+            generator.GenerateRecords(cityRecords->ID, 0, generator.lotCount());
+            glFinish();
+            std::cout << "Generated " << generator.lotCount() << " building records on the GPU in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - generateStart).count() << " ms" << std::endl;
+        }
+        else
+            cityRecords->Update(instances, (GLsizeiptr)(city.buildingCount() * instanceStride));
+        cityRecords->Label("city records");
+        blockRecords = std::make_unique<VBO>(blockInstances, (GLsizeiptr)(city.blockCount() * instanceStride));
+        blockRecords->Label("block records");
+        // The culler tests against a pyramid of its own
+        occlusionCulling = false;
+    }
+    // The CPU occlusion test follows the CPU's frustum culling of single buildings, ahead of any test on the GPU
+    std::unique_ptr<SoftwareOcclusion> softwareOccluder;
+    if (softwareOcclusion && (!culling || batching || gpuCulling || streaming))
+        std::cerr << "--software-occlusion needs the CPU to cull single buildings, no batches, GPU culling or tiles" << std::endl;
+    else if (softwareOcclusion)
+        softwareOccluder = std::make_unique<SoftwareOcclusion>(256, 128);
+    // The horizon of the terrain is tested on the nodes of the building quadtree, which the CPU culling then walks
+    if (horizonCulling && (!terrainMap || !culling || batching || gpuCulling)) {
+        std::cerr << "--horizon-cull needs --terrain and the CPU to cull single buildings, no batches or GPU culling" << std::endl;
+        horizonCulling = false;
+    }
+    if (hierarchyCulling && (!culling || batching || gpuCulling || horizonCulling)) {
+        std::cerr << "--bvh-cull needs the CPU to cull single buildings, no batches, GPU culling or --horizon-cull" << std::endl;
+        hierarchyCulling = false;
+    }
+    // Props are tiles of a block each for a second culler, which fades a tile's row of props into its canopy box with
+    // a level of detail of its own, as the props are far smaller than the buildings
+    std::unique_ptr<GpuCuller> propCuller;
+    std::unique_ptr<VBO> propRecords, propTileRecords;
+    LevelOfDetail propDetail;
+    propDetail.impostorPixels = 4.0f * levelOfDetail.impostorPixels;
+    propDetail.fadePixels = 4.0f * levelOfDetail.fadePixels;
+    propDetail.cullPixels = propCullPixels;
+    if (propsPerBlock > 0 && (!gpuCuller || terrainMap)) {
+        std::cerr << "--props needs --gpu-cull on the flat ground, the streets stay empty" << std::endl;
+        propsPerBlock = 0;
+    }
+    else if (propsPerBlock > 0) {
+        PropScatter scatter(city, propsPerBlock);
+        std::vector<GLfloat> props(scatter.propCount() * CityGenerator::INSTANCE_FLOATS);
+        std::vector<GLfloat> tiles(scatter.tileCount() * CityGenerator::INSTANCE_FLOATS);
+        scatter.Generate(props.data());
+        scatter.GenerateTiles(tiles.data());
+        propCuller = std::make_unique<GpuCuller>((GLuint)scatter.propCount(), scatter.perTile, CityGenerator::INSTANCE_FLOATS);
+        propCuller->reverseDepth = reverseZ;
+        propCuller->cullPixels = propDetail.cullPixels;
+        propRecords = std::make_unique<VBO>(props.data(), (GLsizeiptr)(props.size() * sizeof(GLfloat)));
+        propRecords->Label("prop records");
+        propTileRecords = std::make_unique<VBO>(tiles.data(), (GLsizeiptr)(tiles.size() * sizeof(GLfloat)));
+        propTileRecords->Label("prop tile records");
+        std::cout << "Scattered " << scatter.propCount() << " props over " << scatter.tileCount() << " tiles" << std::endl;
+    }
+    // The simulation thread writes the cars into its packet's arena, the render thread copies them into a ring of
+    // two lists, the near cars from the start of its region and the far ones from the middle
+    std::unique_ptr<TrafficSimulation> traffic;
+    std::unique_ptr<StreamBuffer> trafficStream;
+    if (trafficVehicles > 0) {
+        traffic = std::make_unique<TrafficSimulation>(city, trafficVehicles);
+        trafficStream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, (GLsizeiptr)std::max<size_t>(2 * traffic->vehicleCount() * sizeof(CompactInstance), sizeof(CompactInstance)));
+        trafficStream->scheduler = &frameScheduler;
+        GLDebug.Label(GL_BUFFER, trafficStream->ID, "traffic");
+        std::cout << "Drove " << traffic->vehicleCount() << " cars onto " << traffic->segmentCount() << " road segments" << std::endl;
+    }
+    // The roofs are made up from the buildings the CPU lets through, which the GPU culler leaves it none of
+    std::unique_ptr<StreamBuffer> roofStream;
+    if (roofs && gpuCuller) {
+        std::cerr << "--roofs needs the buildings culled on the CPU, the buildings stay flat topped" << std::endl;
+        roofs = false;
+    }
+    else if (roofs) {
+        roofStream = std::make_unique<StreamBuffer>(GL_ARRAY_BUFFER, (GLsizeiptr)std::max<size_t>(city.buildingCount() * sizeof(CompactInstance), sizeof(CompactInstance)));
+        roofStream->scheduler = &frameScheduler;
+        GLDebug.Label(GL_BUFFER, roofStream->ID, "roofs");
+    }
+    if (instanced && occlusionCulling && OcclusionCuller::Supported()) {
+        GLuint candidates = (GLuint)(city.buildingCount() + city.blockCount());
+        occlusion = std::make_unique<OcclusionCuller>(candidates, CityGenerator::INSTANCE_FLOATS, candidates);
+        occlusion->reverseDepth = reverseZ;
+    }
+    // Blocks far enough away and baked already are drawn as billboards, their buildings and box impostors are skipped
+    // The billboards are picked from the blocks the CPU culling saw, so the GPU culler keeps the box impostors instead
+    auto billboarded = [&](uint32_t block, float projectedSize) {
+        return !gpuCuller && impostorsBaked && block < (uint32_t)impostors->atlas.layers && levelOfDetail.Billboard(projectedSize);
+    };
+    // Points the instance attributes of a VAO at the records starting at an offset of a buffer
+    auto linkRecords = [&](VAO& vao, GLuint buffer, GLintptr region) {
+        vao.LinkBuffer(recordBinding, buffer, region, instanceStride);
+    };
+    const GLsizei streamStride = compactInstances ? (GLsizei)sizeof(CompactInstance) : instanceStride;
+    auto linkInstances = [&](GLuint buffer, GLintptr region) {
+        linkRecords(sceneVAO, buffer, region);
+    };
+    auto bindInstances = [&](GLuint baseInstance) {
+        if (compactInstances)
+            compactVAO.LinkBuffer(recordBinding, instanceStream.ID, (GLintptr)(instanceStream.Offset() + baseInstance * streamStride), streamStride);
+        else
+            linkInstances(instanceStream.ID, (GLintptr)(instanceStream.Offset() + baseInstance * instanceStride));
+    };
+
+    // Tiles live in their own heap of the budget's size, with a VAO on it and room for one command per resident tile
+    // The cache and the I/O scheduler are declared first so they outlive the streamer's load jobs
+    std::unique_ptr<ContentCache> tileCache;
+    std::unique_ptr<IoScheduler> tileIo;
+    std::unique_ptr<TileStreamer> tiles;
+    std::unique_ptr<StreamBuffer> tileIndirect;
+    VAO tileVAO;
+    // Packed tiles are drawn by array commands, so they get a builder of their own
+    DrawCommandBuilder tileCommands(CityGenerator::VERTEX_FLOATS);
+    // Tiles are not instanced, their ground and buildings get a record each that moves them to their offset from the
+    // camera and picks the color, rewritten every frame while the meshes never change
+    std::unique_ptr<VBO> tileRecords;
+    std::vector<GLfloat> tileRecordData;
+    if (streaming) {
+        tiles = std::make_unique<TileStreamer>(layout, streamTilesX, streamTilesZ, tileDirectory, (GLsizeiptr)(tileBudgetMB * 1024.0f * 1024.0f), tileRadius, jobs, packedTiles);
+        tiles->maxScreenError = tileScreenError;
+        tiles->prefetchSeconds = tilePrefetchSeconds;
+        if (!tileCacheDirectory.empty()) {
+            tileCache = std::make_unique<ContentCache>(tileCacheDirectory, (uint64_t)((double)tileCacheMB * 1024.0 * 1024.0));
+            tiles->cache = tileCache.get();
+            std::cout << "Tile cache holds " << tileCache->size() / (1024 * 1024) << " MB in " << tileCacheDirectory << std::endl;
+        }
+        if (HttpClient::IsUrl(tileDirectory))
+            std::cout << "Fetching tiles from " << tileDirectory << std::endl;
+        else if (ioThreads > 0) {
+            tileIo = std::make_unique<IoScheduler>((unsigned int)ioThreads);
+            tiles->io = tileIo.get();
+            std::cout << "Reading tiles on " << ioThreads << " I/O threads through " << tileIo->backend() << std::endl;
+        }
+        tileVAO.Bind();
+        // Packed tiles need no attributes and no indices, the scene programs pull the meshlets from the heap
+        if (packedTiles) {
+            GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, GpuBufferHeap::PULL_BINDING, tiles->heap.vertexBuffer);
+            tileCommands.arrays = true;
+            std::cout << "Tiles stay packed in meshlets, " << tiles->maxResident() / TileStreamer::LEVELS << " fit the budget" << std::endl;
+        }
+        else {
+            tileVAO.LinkElements(tiles->heap.indexBuffer);
+            formatVertices(tileVAO, tiles->heap.vertexBuffer);
+        }
+        formatRecords(tileVAO);
+        tileRecordData.resize(TileStreamer::TILE_RECORDS * tiles->maxResident() * CityGenerator::INSTANCE_FLOATS);
+        tileRecords = std::make_unique<VBO>(tileRecordData.data(), (GLsizeiptr)(tileRecordData.size() * sizeof(GLfloat)), GL_DYNAMIC_DRAW);
+        linkRecords(tileVAO, tileRecords->ID, 0);
+        tileVAO.Label("tiles");
+        tileVAO.Unbind();
+        GLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        if (GLExt.multiDrawIndirect) {
+            tileIndirect = std::make_unique<StreamBuffer>(GL_DRAW_INDIRECT_BUFFER, 2 * tiles->maxResident() * sizeof(DrawElementsIndirectCommand));
+            tileIndirect->scheduler = &frameScheduler;
+        }
+    }
+
+    // Every building as a scene entity, their bounds for frustum culling both as a flat array and as a quadtree over the ground
+    // Nothing is destroyed yet, so the dense index of a building stays the index the city gave it
+    float cityHalfSize = std::max(city.halfExtentX(), city.halfExtentZ());
+    SceneStorage buildings;
+    buildings.Reserve(city.buildingCount());
+    Quadtree buildingTree(glm::vec2(-cityHalfSize), 2.0f * cityHalfSize);
+    // The translation, scale and texture layer of an instance record are the corner and size of its building's box and its facade
+    for (size_t i = 0; i < city.buildingCount(); i++) {
+        glm::vec3 min, max;
+        uint32_t facade;
+        if (instances) {
+            const GLfloat* record = &instances[i * CityGenerator::INSTANCE_FLOATS];
+            min = glm::vec3(record[0], record[1], record[2]);
+            max = min + glm::vec3(record[3], record[4], record[5]);
+            facade = (uint32_t)record[6];
+        } else {
+            Building b = city.building(i);
+            min = glm::vec3(b.minX, 0.0f, b.minZ);
+            max = glm::vec3(b.maxX, b.height, b.maxZ);
+            facade = b.facade;
+        }
+        buildings.Create(min, max, facade);
+        buildingTree.Insert((uint32_t)i, min, max);
+    }
+    const BoundingBoxes& buildingBounds = buildings.bounds;
+    // Distance past which the fog lets less than 1/256 of a building through, for an eye at eyeHeight
+    // Looking up to the top of the tallest building goes through the thinnest fog, so nothing is culled that shows
+    float cityTop = 0.0f;
+    for (size_t i = 0; i < city.buildingCount(); i++)
+        cityTop = std::max(cityTop, buildingBounds.maxY[i]);
+    auto fogCutoff = [&](float eyeHeight) {
+        float rise = fogFalloff * (cityTop - eyeHeight);
+        float density = fogDensity * std::exp(-fogFalloff * eyeHeight) * (std::abs(rise) > 1e-4f ? (1.0f - std::exp(-rise)) / rise : 1.0f);
+        return std::log(256.0f) / density;
+    };
+    // The overview window reads the building records from a buffer of the shared context kept current like the
+    // shadow casters, each upload is fenced for its thread and has the tiles of its map under the changed buildings redrawn
+    std::unique_ptr<VBO> overviewRecords;
+    std::unique_ptr<ViewportWindow> overview;
+    if (overviewWindow && (!window || offscreen || benchmark || !instances || tiles)) {
+        std::cerr << "--overview needs a window and the records of a single city, there is no overview" << std::endl;
+        overviewWindow = false;
+    }
+    else if (overviewWindow) {
+        overview = std::make_unique<ViewportWindow>(window, "Overview", 600, 600);
+        overviewRecords = std::make_unique<VBO>(instances, (GLsizeiptr)(city.buildingCount() * instanceStride), GL_DYNAMIC_DRAW);
+        overviewRecords->Label("overview records");
+        overview->Start(overviewRecords->ID, buildingBounds, 2.0f * cityHalfSize, cityTop);
+    }
+    // Sorts and packs the leaves on the workers for the camera's sphere casts
+    buildingTree.Build(jobs);
+    // The hierarchy is built over the same boxes, a building's index is its id
+    std::unique_ptr<BoundingVolumeHierarchy> buildingHierarchy;
+    if (hierarchyCulling) {
+        buildingHierarchy = std::make_unique<BoundingVolumeHierarchy>();
+        buildingHierarchy->Build(buildingBounds, jobs);
+    }
+    // The sets of a street level camera narrow the buildings down before the frustum tests them, on the same terms
+    std::unique_ptr<VisibilitySets> visibilitySets;
+    if (!visibilityPath.empty() && (!culling || batching || gpuCulling || streaming || terrainMap))
+        std::cerr << "--pvs needs the CPU to cull single buildings on the flat ground, no batches, GPU culling or tiles" << std::endl;
+    else if (!visibilityPath.empty()) {
+        visibilitySets = std::make_unique<VisibilitySets>();
+        glm::vec2 regionMin(-city.halfExtentX(), -city.halfExtentZ()), regionMax(city.halfExtentX(), city.halfExtentZ());
+        if (!visibilitySets->Load(visibilityPath, city.buildingCount(), regionMin, regionMax)) {
+            std::chrono::steady_clock::time_point bakeStart = std::chrono::steady_clock::now();
+            size_t rays = visibilitySets->Bake(buildingBounds, regionMin, regionMax, jobs);
+            std::cout << "Baked the visible sets of " << visibilitySets->bakedCount() << " cells, " << rays << " rays in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count() << " ms" << std::endl;
+            if (!visibilitySets->Save(visibilityPath))
+                std::cerr << "Failed to write visible sets " << visibilityPath << std::endl;
+        }
+        std::cout << "Visible sets of " << visibilitySets->cellCount() << " cells in " << visibilitySets->compressedBytes() / 1024 << " KB" << std::endl;
+    }
+    // Boxes around the buildings of every block for their queries, on the merged city the CPU culls
+    std::unique_ptr<BlockQueries> blockQueries;
+    std::vector<uint32_t> visibleBlocks;
+    std::vector<int> blockSeen;
+    if (blockQuerying && (instanced || !culling || batching || streaming || cityMesh == GpuBufferHeap::INVALID))
+        std::cerr << "--block-queries needs the merged city culled on the CPU, no instancing, batches or tiles" << std::endl;
+    else if (blockQuerying) {
+        std::vector<glm::vec3> blockMin(city.blockCount(), glm::vec3(std::numeric_limits<float>::max()));
+        std::vector<glm::vec3> blockMax(city.blockCount(), glm::vec3(-std::numeric_limits<float>::max()));
+        for (size_t i = 0; i < city.buildingCount(); i++) {
+            size_t block = i / city.lotsPerBlock();
+            blockMin[block] = glm::min(blockMin[block], glm::vec3(buildingBounds.minX[i], buildingBounds.minY[i], buildingBounds.minZ[i]));
+            blockMax[block] = glm::max(blockMax[block], glm::vec3(buildingBounds.maxX[i], buildingBounds.maxY[i], buildingBounds.maxZ[i]));
+        }
+        blockQueries = std::make_unique<BlockQueries>(blockMin, blockMax);
+        visibleBlocks.reserve(city.blockCount());
+        blockSeen.assign(city.blockCount(), -1);
+    }
+    // Index ranges of the visible buildings in the merged mesh
+    std::vector<GLsizei> visibleCounts(instanced ? 0 : city.buildingCount(), CityGenerator::BUILDING_INDICES);
+    std::vector<const void*> visibleOffsets(instanced ? 0 : city.buildingCount());
+    std::vector<GLint> visibleBaseVertices(cityMesh == GpuBufferHeap::INVALID ? 0 : city.buildingCount(), cityMesh == GpuBufferHeap::INVALID ? 0 : sceneHeap.mesh(cityMesh).baseVertex);
+
+    startup.Mark("city");
+    // Images are decoded by jobs on the workers and uploaded a few per frame, a placeholder is drawn until then
+    TextureLoader textureLoader(jobs);
+
+    // The facades share one texture array, their images arrive through the loader
+    // Cooked files are used when every facade has one and the GPU can sample BC1, the source images are decoded otherwise
+    // Cook them with --cook . cooked --size 512 so they match the array size, other sizes always decode the sources
+    // A model's own images go through the array, glTF puts the origin of texture coordinates at the top left as the
+    // images are stored, so they are not flipped
+    bool cookedFacades = GLExt.textureS3TC && facadeSize == 512 && !modelImages;
+    for (GLsizei i = 0; i < facadeImageCount; i++)
+        cookedFacades = cookedFacades && std::filesystem::exists(std::string("cooked/") + facadeImages[i] + ".dds");
+    auto facadePath = [&](GLsizei i) {
+        const char* image = facadeImages[i % facadeImageCount];
+        return cookedFacades ? std::string("cooked/") + image + ".dds" : std::string(image) + ".jpg";
+    };
+    // Procedural facades find their windows in the material table, a model keeps its own images
+    // The ground samples layer 0, so at least that one is a texture
+    if (proceduralFrom > 0 && (!materialTable || modelImages)) {
+        std::cerr << "--procedural-facades needs GL 4.3 and the generated buildings, every facade is a texture" << std::endl;
+        proceduralFrom = 0;
+    }
+    const GLsizei textureLayers = proceduralFrom > 0 ? std::min(facadeCount, proceduralFrom) : facadeCount;
+    // Streamed facades release and specify their levels again, the others get immutable storage allocated once
+    bool streamFacades = !modelImages && (!GLExt.bindlessTexture || virtualTexture) && textureBudgetMB > 0.0f && cookedFacades;
+    TextureArray facades(facadeSize, facadeSize, textureLayers, cookedFacades ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_RGBA8, streamFacades);
+    facades.Label("facades");
+
+    // With bindless textures every facade is its own texture, sampled through a handle in the material buffer
+    // The handles freeze their textures, so the array keeps drawing its placeholder until every image is uploaded
+    // Facades past the images repeat them, the cache hands those the texture of their image instead of loading it again
+    TextureCache textureCache(&textureLoader);
+    std::vector<TextureCache::Handle> facadeTextures;
+    // Set once every bindless handle is resident and in the material table
+    bool bindlessFacades = false;
+    // With a texture budget the mip levels of cooked facades are streamed by how close the nearest building is instead
+    std::unique_ptr<TextureStreamer> textureStreamer;
+    jobs.Wait(assetReads);
+    if (modelImages) {
+        for (GLsizei i = 0; i < facadeCount; i++)
+            textureLoader.LoadLayer(facades, i, gltf.images[i % gltf.images.size()], modelPath + " image", false);
+    } else if (GLExt.bindlessTexture && !virtualTexture) {
+        facadeTextures.reserve(textureLayers);
+        for (GLsizei i = 0; i < textureLayers; i++)
+            facadeTextures.push_back(textureCache.Get(facadePath(i), GL_TEXTURE_2D, GL_RGB, GL_UNSIGNED_BYTE));
+    } else if (streamFacades) {
+        std::vector<std::string> paths;
+        for (GLsizei i = 0; i < textureLayers; i++)
+            paths.push_back(facadePath(i));
+        textureStreamer = std::make_unique<TextureStreamer>(facades, std::move(paths), jobs, (int64_t)(textureBudgetMB * 1024.0f * 1024.0f));
+    } else {
+        if (textureBudgetMB > 0.0f)
+            std::cerr << "Facade levels are only streamed from cooked files, loading every level" << std::endl;
+        // Decoded once per image, the layers that repeat it are filled from the same pixels
+        // Source images read while the window was created are decoded from memory
+        for (GLsizei image = 0; image < std::min(textureLayers, facadeImageCount); image++) {
+            std::vector<GLsizei> layers;
+            for (GLsizei i = image; i < textureLayers; i += facadeImageCount)
+                layers.push_back(i);
+            if (!cookedFacades && facadeBytes[image])
+                textureLoader.LoadLayers(facades, layers, facadeBytes[image], facadePath(image), true);
+            else
+                textureLoader.LoadLayers(facades, layers, facadePath(image).c_str(), !cookedFacades);
+        }
+    }
+    facadeBytes.clear();
+    // Benchmarks measure the finished scene, not the placeholder
+    if (benchmark)
+        textureLoader.Finish();
+    startup.Mark("textures");
+    // One material per facade layer, so an instance's layer is also its material
+    // Procedural ones vary their floors and windows by layer, in meters turned into facade texture coordinates
+    MaterialTable materials;
+    // Layer 0 stays opaque, the ground samples it
+    for (GLsizei i = 0; i < facadeCount; i++) {
+        MaterialRecord material;
+        material.layer = (GLfloat)std::min(i, textureLayers - 1);
+        if (i >= textureLayers) {
+            float variation = (float)((i * 7) % 5) / 4.0f;
+            material.windows[0] = (1.8f + 0.8f * variation) * CityGenerator::FACADE_TEXTURE_SCALE;
+            material.windows[1] = (3.0f + 0.6f * variation) * CityGenerator::FACADE_TEXTURE_SCALE;
+            material.windows[2] = 0.6f;
+            material.windows[3] = 0.15f + 0.3f * variation;
+        }
+        if (glassEvery > 0 && i > 0 && i % glassEvery == 0) {
+            const GLfloat glass[4] = { 0.55f, 0.7f, 0.8f, 0.35f };
+            std::copy(glass, glass + 4, material.tint);
+            material.specular = 1.0f;
+        }
+        materials.Add(material);
+    }
+    if (materialTable)
+        materials.Upload();
+
+    // Collects the programs submitted at startup, which by now have usually finished compiling
+    // Indexed by whether the light is on, then the clustered and the deferred one, the bindless ones stay 0 without the extension
+    GLuint scenePrograms[4], bindlessPrograms[4];
+    for (int i = 0; i < 4; i++) {
+        scenePrograms[i] = finishShaderProgram(sceneBuilds[i]);
+        bindlessPrograms[i] = finishShaderProgram(bindlessBuilds[i]);
+    }
+    GLuint billboardProgram = finishShaderProgram(billboardBuild);
+    GLuint pickProgram = finishShaderProgram(pickBuild);
+    GLuint glassProgram = finishShaderProgram(glassBuild);
+    GLuint markerProgram = finishShaderProgram(markerBuild);
+    startup.Mark("programs");
+    // Names of the programs in GPU captures and debug messages, given again whenever hot reloading replaces one
+    auto labelPrograms = [&]() {
+        const char* slotNames[4] = { "unlit", "lit", "clustered", "deferred" };
+        for (int i = 0; i < 4; i++) {
+            GLDebug.Label(GL_PROGRAM, scenePrograms[i], std::string("scene ") + slotNames[i]);
+            GLDebug.Label(GL_PROGRAM, bindlessPrograms[i], std::string("bindless ") + slotNames[i]);
+        }
+        GLDebug.Label(GL_PROGRAM, billboardProgram, "billboards");
+        GLDebug.Label(GL_PROGRAM, pickProgram, "picking");
+        GLDebug.Label(GL_PROGRAM, glassProgram, "glass");
+        GLDebug.Label(GL_PROGRAM, markerProgram, "light markers");
+    };
+    labelPrograms();
+    // The light markers make their cubes from the vertex and instance index, they draw with an empty vertex array
+    VAO markerVAO;
+    if (markerProgram)
+        markerVAO.Label("light markers");
+    // The heightmap stays bound to its unit, each scene program only needs its uniforms once
+    if (terrainMap) {
+        for (GLuint program : { scenePrograms[0], scenePrograms[1], scenePrograms[2], scenePrograms[3],
+            bindlessPrograms[0], bindlessPrograms[1], bindlessPrograms[2], bindlessPrograms[3], pickProgram, glassProgram }) {
+            if (program) {
+                GLState.UseProgram(program);
+                terrainMap->Apply(program);
+            }
+        }
+        GLState.UseProgram(0);
+    }
+    // The lit scene programs sample the virtual texture, its units and layout stay the same for the whole run
+    if (virtualTexture) {
+        for (int i = 1; i < 4; i++) {
+            if (scenePrograms[i]) {
+                GLState.UseProgram(scenePrograms[i]);
+                virtualTexture->Apply(scenePrograms[i]);
+            }
+        }
+        GLState.UseProgram(0);
+    }
+    if (billboardProgram) {
+        GLState.UseProgram(billboardProgram);
+        glUniform1i(glGetUniformLocation(billboardProgram, "views"), impostors->views);
+        GLState.UseProgram(0);
+    }
+    // Picks are drawn only on the frames that ask for one and read back a frame or so later
+    // The instanced buildings are drawn from a copy of all their records, made the first time, behind the ground records
+    std::unique_ptr<ObjectPicker> picker;
+    std::unique_ptr<VBO> pickRecords;
+    if (pickProgram)
+        picker = std::make_unique<ObjectPicker>();
+    // Prints what a finished pick found, IDs count the buildings from 1, and highlights an instanced building
+    // The simulation thread edits the building picked last for a collaborative session
+    size_t highlighted = SIZE_MAX;
+    std::atomic<uint32_t> selectedBuilding{ SceneStorage::INVALID };
+    auto reportPick = [&](GLuint id) {
+        if (id == 0 || id > city.buildingCount()) {
+            std::cout << "Picked nothing but the ground" << std::endl;
+            return;
+        }
+        size_t index = id - 1;
+        if (instances) {
+            if (highlighted != SIZE_MAX)
+                std::copy(CityGenerator::BUILDING_COLOR, CityGenerator::BUILDING_COLOR + 3, instanceRecords.Edit(highlighted) + 8);
+            GLfloat* record = instanceRecords.Edit(index);
+            record[8] = 1.0f;
+            record[9] = 0.8f;
+            record[10] = 0.2f;
+            instances = instanceRecords.data();
+            highlighted = index;
+            selectedBuilding = (uint32_t)index;
+        }
+        glm::vec3 min, size;
+        unsigned int facade;
+        if (instances) {
+            const GLfloat* record = &instances[index * CityGenerator::INSTANCE_FLOATS];
+            min = glm::vec3(record[0], record[1], record[2]);
+            size = glm::vec3(record[3], record[4], record[5]);
+            facade = (unsigned int)record[6];
+        }
+        else {
+            Building b = city.building(index);
+            min = glm::vec3(b.minX, 0.0f, b.minZ);
+            size = glm::vec3(b.maxX - b.minX, b.height, b.maxZ - b.minZ);
+            facade = b.facade;
+        }
+        std::cout << "Picked building " << index << " of block " << index / city.lotsPerBlock() << " at " << min.x + 0.5f * size.x << ", "
+                  << min.z + 0.5f * size.z << ": " << size.x << " x " << size.z << ", " << size.y << " high from " << min.y << ", facade " << facade << std::endl;
+    };
+
+    // Initialize camera just outside the city, its projection keeps the window's starting size
+    Camera camera(glm::vec3(0.0f, 1.0f + (terrainMap ? terrainMap->heightAt(0.0f, city.halfExtentZ() + 5.0f) : 0.0f), city.halfExtentZ() + 5.0f),
+        glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
+    // Each eye gets half of the width, a poster's tiles each show part of the poster's projection
+    float eyeAspect = poster ? (float)poster->width / poster->height : (float)viewWidth / viewHeight * (stereo ? 0.5f : 1.0f);
+    if (reverseZ)
+        camera.SetReverseZPerspective(45.0f, eyeAspect, 0.1f);
+    else
+        camera.SetPerspective(45.0f, eyeAspect, 0.1f, 100.0f);
+    // The render thread works from this copy, the camera itself belongs to the simulation thread
+    const glm::mat4 projection = camera.projection();
+
+    // Street lamps and lit windows, binned into the clusters of this projection every frame
+    // Without a far plane the clusters still end at 100, lights further away add too little to be worth binning
+    std::unique_ptr<ClusteredLights> clusteredLights;
+    if (lightCount > 0 && scenePrograms[2]) {
+        std::vector<GLfloat> lights((size_t)lightCount * CityGenerator::LIGHT_FLOATS);
+        city.GenerateLights(lights.data(), (size_t)lightCount);
+        clusteredLights = std::make_unique<ClusteredLights>(lights.data(), (size_t)lightCount, 0.1f, 100.0f);
+    }
+    // The most important of them cast shadows from tiles of one atlas, the static ones cached until a car drives by
+    std::unique_ptr<LightShadows> lightShadows;
+    if (clusteredLights && lightShadowCount > 0) {
+        lightShadows = std::make_unique<LightShadows>(*clusteredLights, 4096, (unsigned int)lightShadowCount);
+        lightShadows->faceBudget = (unsigned int)lightShadowFaces;
+    }
+    // Decals on the walls share the clusters, their images are generated once
+    std::unique_ptr<DecalLibrary> decalLibrary;
+    if (clusteredLights && decalCount > 0) {
+        std::vector<GLfloat> decals((size_t)decalCount * ClusteredLights::DECAL_FLOATS);
+        DecalLibrary::Scatter(city, decals.data(), (size_t)decalCount);
+        clusteredLights->SetDecals(decals.data(), (size_t)decalCount);
+        decalLibrary = std::make_unique<DecalLibrary>();
+    }
+    // The G-buffer is only allocated by the first deferred frame
+    std::unique_ptr<DeferredRenderer> deferredRenderer;
+    if (scenePrograms[3]) {
+        deferredRenderer = std::make_unique<DeferredRenderer>();
+        deferredRenderer->reverseDepth = reverseZ;
+    }
+    // Glass is only drawn in forward frames, where it blends over the scene's own framebuffer
+    std::unique_ptr<TransparencyPass> transparency;
+    if (glassProgram) {
+        transparency = std::make_unique<TransparencyPass>();
+        transparency->reverseDepth = reverseZ;
+    }
+    // Worked out from the G-buffer, so only deferred frames have it
+    std::unique_ptr<ScreenSpaceOcclusion> screenOcclusion;
+    if (deferredRenderer) {
+        screenOcclusion = std::make_unique<ScreenSpaceOcclusion>();
+        screenOcclusion->reverseDepth = reverseZ;
+    }
+    // Its history outlives the frame, so it is kept apart from the graph's transient targets
+    std::unique_ptr<TemporalCache> occlusionHistory;
+    if (screenOcclusion && temporalSsao) {
+        occlusionHistory = std::make_unique<TemporalCache>(ScreenSpaceOcclusion::FORMAT);
+        occlusionHistory->reverseDepth = reverseZ;
+    }
+    // Built from the depth each forward frame leaves, for the frame after
+    std::unique_ptr<ShadingRateImage> shadingRate;
+    if (variableRateShading && (!GLExt.shadingRateImage || stereo))
+        std::cerr << "--shading-rate needs NV_shading_rate_image and a single view, every pixel is shaded" << std::endl;
+    else if (variableRateShading) {
+        shadingRate = std::make_unique<ShadingRateImage>();
+        shadingRate->reverseDepth = reverseZ;
+    }
+    // Placed from the buildings the CPU kept, so the GPU culling and the streamed or tiled cities go without
+    std::unique_ptr<LabelLayout> labelLayout;
+    std::unique_ptr<LabelRenderer> labelRenderer;
+    if (labelCount > 0 && (!instanced || streaming || tiles || stereo || gpuCulling))
+        std::cerr << "--labels needs the CPU to cull a single instanced city for one view, no labels are drawn" << std::endl;
+    else if (labelCount > 0) {
+        labelLayout = std::make_unique<LabelLayout>(jobs, LabelLayout::Addresses(layout, city.buildingCount()));
+        labelLayout->maxLabels = labelCount;
+        // Room for addresses of up to 24 letters
+        labelRenderer = std::make_unique<LabelRenderer>(labelCount * 24, &frameScheduler);
+    }
+    if (debugLines && !DebugDraw::Enabled) {
+        std::cerr << "--debug-lines is compiled out of release builds" << std::endl;
+        debugLines = false;
+    }
+    if (debugLines)
+        Debug.Init(1 << 16, &frameScheduler);
+    // The passes after the scene, planned every frame from what they read and write. The subsystems' targets are
+    // imported, and the scene's color counts as one resource through every target it moves along. A pass turned off
+    // takes those only it feeds with it, such as the occlusion of a forward frame, and the occlusion's targets are
+    // transient: they come from the pool only while a frame needs them, which waits out a window being dragged to size
+    RenderTargetPool targetPool;
+    RenderGraph frameGraph(targetPool);
+    RenderGraph::Resource gbufferResource = frameGraph.Import("G-buffer");
+    RenderGraph::Resource colorResource = frameGraph.Import("scene color");
+    RenderGraph::Resource bloomResource = frameGraph.Import("bloom chain");
+    RenderGraph::Resource occlusionResource = frameGraph.Create("ssao occlusion", ScreenSpaceOcclusion::FORMAT);
+    RenderGraph::Resource occlusionBlurResource = frameGraph.Create("ssao blur", ScreenSpaceOcclusion::FORMAT);
+    frameGraph.Output(colorResource);
+    RenderGraph::Pass scenePass = frameGraph.AddPass("scene");
+    frameGraph.Write(scenePass, colorResource);
+    frameGraph.Write(scenePass, gbufferResource);
+    RenderGraph::Pass ssaoPass = frameGraph.AddPass("ssao");
+    frameGraph.Read(ssaoPass, gbufferResource);
+    frameGraph.Write(ssaoPass, occlusionResource);
+    frameGraph.Write(ssaoPass, occlusionBlurResource);
+    frameGraph.Read(ssaoPass, occlusionResource);
+    frameGraph.Read(ssaoPass, occlusionBlurResource);
+    RenderGraph::Pass resolvePass = frameGraph.AddPass("deferred resolve");
+    frameGraph.Read(resolvePass, gbufferResource);
+    frameGraph.Read(resolvePass, occlusionResource);
+    frameGraph.Write(resolvePass, colorResource);
+    RenderGraph::Pass antiAliasingPass = frameGraph.AddPass("anti-aliasing");
+    frameGraph.Read(antiAliasingPass, colorResource);
+    frameGraph.Write(antiAliasingPass, colorResource);
+    RenderGraph::Pass bloomPass = frameGraph.AddPass("bloom");
+    frameGraph.Read(bloomPass, colorResource);
+    frameGraph.Write(bloomPass, bloomResource, RenderGraph::IMAGE);
+    RenderGraph::Pass postPass = frameGraph.AddPass("post effects");
+    frameGraph.Read(postPass, colorResource);
+    frameGraph.Read(postPass, bloomResource);
+    frameGraph.Write(postPass, colorResource);
+    RenderGraph::Pass upscalePass = frameGraph.AddPass("upscale");
+    frameGraph.Read(upscalePass, colorResource);
+    frameGraph.Write(upscalePass, colorResource);
+
+    // The sun is fixed to the city, so the cascades are rendered in model space and stay cached while it turns
+    // With the time of day the render thread moves it every frame, and while it keeps moving an interactive run spreads
+    // what follows it over frames: a cascade a frame and the sky's table in bands, the probes already take a face a
+    // frame. Exported images have everything at their own time
+    glm::vec3 sunDirection = glm::normalize(glm::vec3(-0.4f, -1.0f, -0.3f));
+    bool amortizeSun = sunMoves && timeOfDay.hoursPerSecond != 0.0f && !exportViews;
+    std::unique_ptr<SkyRenderer> skyRenderer;
+    if (sky) {
+        skyRenderer = std::make_unique<SkyRenderer>();
+        skyRenderer->reverseDepth = reverseZ;
+        if (amortizeSun)
+            skyRenderer->updateBands = 8;
+    }
+    std::unique_ptr<ShadowCascades> shadows;
+    std::unique_ptr<VBO> shadowCasters;
+    if (shadowSize > 0) {
+        const float splits[ShadowCascades::CASCADES] = { 8.0f, 25.0f, 70.0f };
+        shadows = std::make_unique<ShadowCascades>(shadowSize, glm::radians(45.0f), 800.0f / 600.0f, 0.1f, splits);
+        if (amortizeSun)
+            shadows->sunUpdates = 1;
+    }
+    // The reflection probes see the whole city around them like the cascades do, and draw it the same way
+    std::unique_ptr<ReflectionProbes> reflectionProbes;
+    if (probesPerSide > 0) {
+        glm::vec3 cityMin(std::numeric_limits<float>::max(), 0.0f, std::numeric_limits<float>::max());
+        glm::vec3 cityMax(std::numeric_limits<float>::lowest(), cityTop, std::numeric_limits<float>::lowest());
+        for (size_t i = 0; i < city.buildingCount(); i++) {
+            cityMin = glm::min(cityMin, glm::vec3(buildingBounds.minX[i], 0.0f, buildingBounds.minZ[i]));
+            cityMax = glm::max(cityMax, glm::vec3(buildingBounds.maxX[i], cityTop, buildingBounds.maxZ[i]));
+        }
+        reflectionProbes = std::make_unique<ReflectionProbes>(128, probesPerSide, cityMin, cityMax);
+    }
+    // What the probes see past the buildings in full daylight, the time of day dims it
+    const glm::vec3 probeSky = reflectionProbes ? reflectionProbes->clearColor : glm::vec3(0.0f);
+    // The water is a harbor three times the ground's size around it, a little under it so the two do not fight over depth
+    // Its reflection draws every baked block as a billboard, from a copy of their records that does not move
+    std::unique_ptr<PlanarReflection> planarReflection;
+    std::unique_ptr<VBO> reflectedBillboards;
+    if (water) {
+        glm::vec2 groundCenter(groundBoxMin.x + 0.5f * groundBoxSize.x, groundBoxMin.z + 0.5f * groundBoxSize.z);
+        glm::vec2 waterHalf = 1.5f * glm::vec2(groundBoxSize.x, groundBoxSize.z);
+        planarReflection = std::make_unique<PlanarReflection>(groundBoxMin.y - 0.2f, groundCenter - waterHalf, groundCenter + waterHalf);
+        reflectedBillboards = std::make_unique<VBO>(billboardRecords.data(), (GLsizeiptr)(billboardRecords.size() * sizeof(GLfloat)));
+        GLDebug.Label(GL_BUFFER, reflectedBillboards->ID, "reflected billboards");
+    }
+    // The chimneys are the roofs of buildings picked evenly through the city, which has to be the one drawn, on the flat ground
+    std::unique_ptr<ParticleSystem> particles;
+    if (smokeChimneys > 0 && (!instanced || streaming || terrainMap)) {
+        std::cerr << "--smoke needs instanced drawing of a single city on the flat ground, no chimney smokes" << std::endl;
+        smokeChimneys = 0;
+    }
+    if ((weatherKind != ParticleSystem::WEATHER_NONE || smokeChimneys > 0) && !ParticleSystem::Supported()) {
+        std::cerr << "--weather and --smoke need compute shaders, storage buffers and indirect draws (GL 4.3)" << std::endl;
+        weatherKind = ParticleSystem::WEATHER_NONE;
+        smokeChimneys = 0;
+    }
+    if (weatherKind != ParticleSystem::WEATHER_NONE || smokeChimneys > 0) {
+        std::vector<glm::vec3> chimneys;
+        smokeChimneys = std::min(smokeChimneys, city.buildingCount());
+        for (size_t i = 0; i < smokeChimneys; i++) {
+            Building b = city.building(i * city.buildingCount() / smokeChimneys);
+            chimneys.emplace_back(0.5f * (b.minX + b.maxX), b.height, 0.5f * (b.minZ + b.maxZ));
+        }
+        particles = std::make_unique<ParticleSystem>(1u << 17, chimneys);
+        particles->reverseDepth = reverseZ;
+    }
+    if (shadows || reflectionProbes || lightShadows) {
+        // Instanced buildings cast from every record, not only the ones visible this frame
+        if (instanced) {
+            std::vector<GLfloat> casters(groundInstance, groundInstance + CityGenerator::INSTANCE_FLOATS);
+            casters.insert(casters.end(), instances, instances + city.buildingCount() * CityGenerator::INSTANCE_FLOATS);
+            shadowCasters = std::make_unique<VBO>(casters.data(), (GLsizeiptr)(casters.size() * sizeof(GLfloat)));
+        }
+    }
+    // Draws count instances of the unit building from the records linked, procedural boxes need no vertex or index
+    auto drawUnits = [&](GLsizei count) {
+        if (proceduralBoxes) {
+            glDrawArraysInstanced(GL_TRIANGLES, CityGenerator::PROCEDURAL_BOX_FIRST, CityGenerator::BUILDING_INDICES, count);
+            GLState.CountDraw(count, CityGenerator::BUILDING_INDICES / 3 * count);
+            return;
+        }
+        const DrawCommandBuilder::Mesh& unit = sceneHeap.mesh(buildingMesh);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, unit.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(unit.firstIndex), count, unit.baseVertex);
+        GLState.CountDraw(count, unit.indexCount / 3 * count);
+    };
+    // Draws every static caster into a cascade, with the caster program in use and the light's matrices in the frame data
+    auto drawShadowCasters = [&]() {
+        sceneVAO.Bind();
+        if (instanced) {
+            const DrawCommandBuilder::Mesh& ground = sceneHeap.mesh(groundMesh);
+            linkInstances(shadowCasters->ID, 0);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, ground.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(ground.firstIndex), 1, ground.baseVertex);
+            GLState.CountDraw(1, ground.indexCount / 3);
+            linkInstances(shadowCasters->ID, instanceStride);
+            drawUnits((GLsizei)city.buildingCount());
+        }
+        else if (batching) {
+            const DrawCommandBuilder::Mesh& ground = sceneHeap.mesh(groundMesh);
+            glVertexAttrib3fv(4, glm::value_ptr(groundBoxMin));
+            glVertexAttrib3fv(5, glm::value_ptr(groundBoxSize));
+            glDrawElementsBaseVertex(GL_TRIANGLES, ground.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(ground.firstIndex), ground.baseVertex);
+            GLState.CountDraw(1, ground.indexCount / 3);
+            for (const StaticBatch& batch : staticBatches) {
+                const DrawCommandBuilder::Mesh& range = sceneHeap.mesh(batch.mesh);
+                glVertexAttrib3fv(4, glm::value_ptr(batch.boxMin));
+                glVertexAttrib3fv(5, glm::value_ptr(batch.boxSize));
+                glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(range.firstIndex), range.baseVertex);
+                GLState.CountDraw(1, range.indexCount / 3);
+            }
+        }
+        else {
+            const DrawCommandBuilder::Mesh& cityRange = sceneHeap.mesh(cityMesh);
+            glDrawElementsBaseVertex(GL_TRIANGLES, cityRange.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(cityRange.firstIndex), cityRange.baseVertex);
+            GLState.CountDraw(1, cityRange.indexCount / 3);
+        }
+    };
+
+    // Camera and light values are shared by every program through one uniform buffer, updated once per frame
+    for (GLuint program : { scenePrograms[0], scenePrograms[1], scenePrograms[2], scenePrograms[3],
+        bindlessPrograms[0], bindlessPrograms[1], bindlessPrograms[2], bindlessPrograms[3], billboardProgram, pickProgram, glassProgram, markerProgram })
+        if (program)
+            glUniformBlockBinding(program, glGetUniformBlockIndex(program, "FrameData"), FrameData::BINDING);
+
+    // Every program with the files it is built from, so a changed file rebuilds the ones that use it
+    struct ReloadableProgram {
+        GLuint* program;
+        ShaderFile vertex;
+        ShaderFile fragment;
+        unsigned int features;
+        ProgramBuild build;
+        bool building;
+    };
+    std::vector<ReloadableProgram> reloadablePrograms;
+    // The shader files come first, the facade images follow in the order of their layers
+    std::unique_ptr<FileWatcher> watcher;
+    if (hotReload) {
+        for (int i = 0; i < 4; i++) {
+            if (scenePrograms[i])
+                reloadablePrograms.push_back({ &scenePrograms[i], SCENE_VERTEX, SCENE_FRAGMENT, slotFeatures[i], ProgramBuild(), false });
+            if (bindlessPrograms[i])
+                reloadablePrograms.push_back({ &bindlessPrograms[i], SCENE_VERTEX, BINDLESS_FRAGMENT, slotFeatures[i], ProgramBuild(), false });
+        }
+        if (billboardProgram)
+            reloadablePrograms.push_back({ &billboardProgram, BILLBOARD_VERTEX, BILLBOARD_FRAGMENT, billboardFeatures, ProgramBuild(), false });
+        if (pickProgram)
+            reloadablePrograms.push_back({ &pickProgram, SCENE_VERTEX, PICK_FRAGMENT, placement | SHADER_PICKING, ProgramBuild(), false });
+        if (glassProgram)
+            reloadablePrograms.push_back({ &glassProgram, SCENE_VERTEX, GLASS_FRAGMENT, glassFeatures, ProgramBuild(), false });
+        if (markerProgram)
+            reloadablePrograms.push_back({ &markerProgram, LIGHT_VERTEX, LIGHT_FRAGMENT, SHADER_LIGHT_MARKERS, ProgramBuild(), false });
+        watcher = std::make_unique<FileWatcher>();
+        for (int file = 0; file < SHADER_FILE_COUNT; file++)
+            watcher->Watch(shaderPath(file));
+        for (GLsizei i = 0; i < textureLayers && !modelImages; i++)
+            watcher->Watch(facadePath(i));
+    }
+    FrameData frameData;
+    frameData.projection = projection;
+    // The sky is the color the fog fades to
+    if (fogDensity > 0.0f)
+        glClearColor(fogColor.r, fogColor.g, fogColor.b, 1.0f);
+    frameData.lightPos = glm::vec4(0.0f, 10.0f, 0.0f, 1.0f);
+    frameData.lightColor = glm::vec4(1.0f);
+    UBO frameUBO(sizeof(FrameData));
+    frameUBO.BindBase(FrameData::BINDING);
+    GLDebug.Label(GL_BUFFER, frameUBO.ID, "frame data");
+
+    // The scene programs meet every VAO they draw, the tiles' included so no tile coming in later stalls, and the
+    // opaque, prepass and glass states they draw in. The picking program writes IDs into its own target and is left
+    // to its first pick
+    if (warmUp) {
+        PipelineWarmup warmup(reverseZ);
+        warmup.profiler = &profiler;
+        GLint records = instanced ? (GLint)recordBinding : -1;
+        for (GLuint program : { scenePrograms[0], scenePrograms[1], scenePrograms[2], scenePrograms[3],
+            bindlessPrograms[0], bindlessPrograms[1], bindlessPrograms[2], bindlessPrograms[3] }) {
+            warmup.Draw(program, sceneVAO, records, instanceStride, PipelineWarmup::OPAQUE_DRAW);
+            if (compactInstances)
+                warmup.Draw(program, compactVAO, recordBinding, sizeof(CompactInstance), PipelineWarmup::OPAQUE_DRAW);
+            if (trafficVehicles > 0)
+                warmup.Draw(program, trafficVAO, recordBinding, sizeof(CompactInstance), PipelineWarmup::OPAQUE_DRAW);
+            if (roofs)
+                warmup.Draw(program, roofVAO, recordBinding, sizeof(CompactInstance), PipelineWarmup::OPAQUE_DRAW);
+            if (tiles)
+                warmup.Draw(program, tileVAO, recordBinding, instanceStride, PipelineWarmup::OPAQUE_DRAW);
+        }
+        if (depthPrepass)
+            warmup.Draw(scenePrograms[0], compactInstances ? compactVAO : sceneVAO, records,
+                compactInstances ? (GLsizei)sizeof(CompactInstance) : instanceStride, PipelineWarmup::DEPTH_ONLY);
+        warmup.Draw(glassProgram, compactInstances ? compactVAO : sceneVAO, records,
+            compactInstances ? (GLsizei)sizeof(CompactInstance) : instanceStride, PipelineWarmup::BLENDED);
+        if (billboardProgram)
+            warmup.Draw(billboardProgram, billboardVAO, 0, ImpostorAtlas::RECORD_FLOATS * sizeof(float), PipelineWarmup::OPAQUE_DRAW, GL_TRIANGLE_STRIP, 4);
+        warmup.Draw(markerProgram, markerVAO, -1, 0, PipelineWarmup::OPAQUE_DRAW, GL_TRIANGLE_STRIP, 14);
+        std::cout << "Warm-up: " << warmup.draws() << " draws in " << warmup.milliseconds() << " ms, " << warmup.hitches()
+            << " over " << warmup.hitchMilliseconds << " ms moved out of the frames" << std::endl;
+    }
+
+    // Set initial light state, the program matching it is picked every frame
+    bool lightOn = true;
+    GLuint currentProgram = 0;
+
+    // Frames are rendered on their own thread, which owns the GL context from here until the loop ends
+    // This thread stays the simulation: it polls input, moves the camera, culls and sorts, and hands each frame over
+    // as a packet through a lock-free queue, so a frame stalled on vsync holds up neither input nor the next frame
+    FrameQueue frameQueue;
+    // Set by the render thread while it still has streaming that only later frames finish, which keeps an on demand run drawing
+    std::atomic<bool> renderPending{ false };
+    // The render thread leaves the window title here, GLFW only sets it from the main thread
+    std::mutex titleMutex;
+    std::string windowTitle;
+    // Heap allocations both frame loops make in the measured frames of a benchmark, which should be none, debug builds only
+    std::atomic<uint64_t> steadyAllocations{ 0 };
+    // Only the render thread touches it, from the first frame on
+    std::unique_ptr<HitchDetector> hitchDetector;
+    if (hitchMs > 0.0f)
+        hitchDetector = std::make_unique<HitchDetector>(120, hitchMs, hitchDirectory);
+    // The render thread publishes into it once per frame, the server's own thread answers the scrapes
+    std::unique_ptr<MetricsServer> metricsServer;
+    if (metricsPort > 0) {
+        metricsServer = std::make_unique<MetricsServer>((unsigned short)metricsPort);
+        if (metricsServer->isOpen())
+            std::cout << "Serving metrics on http://localhost:" << metricsPort << "/metrics" << std::endl;
+        else
+            metricsServer.reset();
+    }
+    // The path each subsystem took on this context, given its features and the options, printed once and kept in the
+    // benchmark report so two reports from different machines say why their numbers differ
+    std::vector<BenchmarkReport::Path> renderPaths = {
+        { "context", std::to_string(GLExt.major) + "." + std::to_string(GLExt.minor) },
+        { "buffers", std::string(GLExt.directStateAccess ? "direct state access" : "bound to edit")
+            + (instanceStream.persistent ? ", persistently mapped streams" : ", streams mapped per frame") },
+        { "culling", std::string(meshlets ? "GPU meshlets" : gpuCuller ? "GPU compute" : culling ? "CPU quadtree" : "none")
+            + (occlusion ? ", GPU occlusion" : softwareOccluder ? ", software occlusion" : "") },
+        { "textures", std::string(virtualTexture ? "virtual" : !facadeTextures.empty() ? "bindless" : textureStreamer ? "streamed array" : facades.immutable ? "immutable array" : "array")
+            + (cookedFacades ? " of S3TC" : "") },
+        { "draws", indirectStream && instanced ? "multi draw indirect" : instanced ? "instanced" : batching ? "batched" : "one per building" }
+    };
+    std::cout << "Paths:";
+    for (const BenchmarkReport::Path& path : renderPaths)
+        std::cout << " " << path.subsystem << " " << path.name << (&path != &renderPaths.back() ? ";" : "");
+    std::cout << std::endl;
+    releaseContext();
+    startup.Mark("setup");
+    std::thread renderThread([&]() {
+        Tracer.NameThread("render");
+        makeContextCurrent();
+        uint64_t allocationsBefore = 0;
+        // Streaming of the frame being rendered and the index of the one before it, for the hitch detector
+        HitchDetector::Activity hitchActivity;
+        int previousFrameIndex = 0;
+        while (true) {
+            const FramePacket* packet = frameQueue.Peek();
+            if (!packet) {
+                std::this_thread::yield();
+                continue;
+            }
+            const FramePacket& frame = *packet;
+            // Warm-up frames of a benchmark are rendered but not measured
+            if (benchmark) {
+                profiler.enabled = frame.frameIndex >= benchmarkWarmup;
+                if (frame.frameIndex == benchmarkWarmup) {
+                    GLState.ResetCounters();
+                    glBeginQuery(GL_PRIMITIVES_GENERATED, primitivesQuery);
+                    countingPrimitives = true;
+                    allocationsBefore = AllocationCounter::Thread();
+                }
+            }
+            // The counts of the frame before this one are complete
+            GLState.EndFrame();
+            if (frame.quit) {
+                if (benchmark)
+                    profiler.BeginFrame();
+                if (countingPrimitives) {
+                    glEndQuery(GL_PRIMITIVES_GENERATED);
+                    steadyAllocations += AllocationCounter::Thread() - allocationsBefore;
+                }
+                frameQueue.Release();
+                break;
+            }
+            // Hides the projection of the whole view, a poster tile's frame only shows its part of it
+            const glm::mat4& projection = frame.projection;
+            profiler.BeginFrame();
+            if (hitchDetector && profiler.enabled) {
+                hitchDetector->Record(profiler, (uint64_t)previousFrameIndex, hitchActivity);
+                hitchActivity = HitchDetector::Activity();
+            }
+            // The zones of a frame follow each other, so their GPU times add up to the GPU time of the frame
+            if (metricsServer) {
+                MetricsServer::Sample sample;
+                for (size_t i = 0; i < profiler.zoneCount(); i++) {
+                    if (profiler.zoneName(i) == "frame")
+                        sample.cpuMilliseconds = profiler.LastCpu(i);
+                    float gpu = profiler.LastGpu(i);
+                    if (gpu >= 0.0f)
+                        sample.gpuMilliseconds = std::max(sample.gpuMilliseconds, 0.0f) + gpu;
+                }
+                for (int i = 0; i < GPU_MEMORY_CATEGORIES; i++)
+                    sample.gpuBytes[i] = GpuMemory.bytes((GpuMemoryCategory)i);
+                sample.draws = GLState.lastFrame.draws;
+                sample.instances = GLState.lastFrame.instances;
+                sample.triangles = GLState.lastFrame.triangles;
+                sample.texturesPending = textureLoader.pending();
+                sample.tilesPending = tiles ? tiles->pending() : 0;
+                sample.hitches = hitchDetector ? hitchDetector->hitches() : 0;
+                metricsServer->Publish(sample);
+            }
+            previousFrameIndex = frame.frameIndex;
+            // Waits for the GPU to finish the frame framesInFlight back before recording another
+            size_t throttleZone = profiler.Begin("throttle", false);
+            frameScheduler.BeginFrame();
+            profiler.End(throttleZone);
+
+            // Rebuilds what the changed files belong to between frames, a program is swapped in once the driver has
+            // finished it and only if it linked, the old one keeps drawing until then, or for good if the edit broke it
+            if (watcher) {
+                size_t reloadZone = profiler.Begin("hot reload");
+                for (size_t changed : watcher->Changed()) {
+                    std::string path = watcher->path(changed);
+                    if (changed >= SHADER_FILE_COUNT) {
+                        // Resident handles freeze their textures, only the array can take a new image
+                        if (!facadeTextures.empty()) {
+                            std::cerr << "Bindless facades cannot change while running, restart to see " << path << std::endl;
+                            continue;
+                        }
+                        // The loader decodes it on the workers, a broken image leaves the layer as it was
+                        std::cout << "Reloading " << path << std::endl;
+                        if (textureStreamer)
+                            textureStreamer->Invalidate();
+                        else
+                            textureLoader.LoadLayer(facades, (GLsizei)(changed - SHADER_FILE_COUNT), path.c_str(), !cookedFacades);
+                        impostorsBaked = false;
+                        continue;
+                    }
+                    int file = (int)changed;
+                    try {
+                        shaderSources[file] = get_file_contents(path.c_str());
+                    }
+                    catch (int) {
+                        std::cerr << "Failed to read " << path << std::endl;
+                        continue;
+                    }
+                    std::cout << "Reloading " << path << std::endl;
+                    if (file == FRAME_DATA_INCLUDE)
+                        Shader::AddInclude(shaderFileNames[file], shaderSources[file]);
+                    for (ReloadableProgram& reloadable : reloadablePrograms) {
+                        // Programs whose sources include a changed chunk are rebuilt like the ones of a changed file
+                        std::vector<std::string> includes;
+                        Shader::Preprocess(shaderSources[reloadable.vertex], "", &includes);
+                        Shader::Preprocess(shaderSources[reloadable.fragment], "", &includes);
+                        bool included = std::find(includes.begin(), includes.end(), shaderFileNames[file]) != includes.end();
+                        if (reloadable.vertex != file && reloadable.fragment != file && !included)
+                            continue;
+                        // A rebuild that is still compiling was made from an older source
+                        if (reloadable.building)
+                            GLState.DeleteProgram(finishShaderProgram(reloadable.build));
+                        reloadable.build = submitShaderProgram(shaderSources[reloadable.fragment].c_str(), reloadable.features,
+                            shaderSources[reloadable.vertex].c_str());
+                        reloadable.building = true;
+                    }
+                }
+                for (ReloadableProgram& reloadable : reloadablePrograms) {
+                    if (!reloadable.building || !shaderProgramReady(reloadable.build))
+                        continue;
+                    reloadable.building = false;
+                    GLuint program = finishShaderProgram(reloadable.build);
+                    GLint linked = GL_FALSE;
+                    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+                    if (!linked) {
+                        LOG_MESSAGE(LOG_WARNING, "Keeping the previous program");
+                        GLState.DeleteProgram(program);
+                        continue;
+                    }
+                    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "FrameData"), FrameData::BINDING);
+                    if (reloadable.program == &billboardProgram) {
+                        GLState.UseProgram(program);
+                        glUniform1i(glGetUniformLocation(program, "views"), impostors->views);
+                        GLState.CountUniforms();
+                    }
+                    else if (terrainMap) {
+                        GLState.UseProgram(program);
+                        terrainMap->Apply(program);
+                    }
+                    if (virtualTexture && (reloadable.features & SHADER_VIRTUAL_TEXTURE)) {
+                        GLState.UseProgram(program);
+                        virtualTexture->Apply(program);
+                    }
+                    GLState.DeleteProgram(*reloadable.program);
+                    *reloadable.program = program;
+                    labelPrograms();
+                    // The baked views show the scene programs, the switch below picks the program again and its model location
+                    if (reloadable.fragment != BILLBOARD_FRAGMENT && reloadable.fragment != PICK_FRAGMENT)
+                        impostorsBaked = false;
+                    currentProgram = 0;
+                }
+                profiler.End(reloadZone);
+            }
+
+            // Uploads images the loader has decoded, at most a couple of milliseconds per frame
+            size_t uploadZone = profiler.Begin("texture upload");
+            hitchActivity.texturesUploaded = textureLoader.Upload(2.0);
+            profiler.End(uploadZone);
+            if (hitchDetector)
+                hitchActivity.texturesPending = textureLoader.pending();
+
+            // A facade texel should not get smaller than a pixel on the nearest building, which is where the finest
+            // level is needed, the facade repeats once per unit
+            if (textureStreamer) {
+                size_t streamZone = profiler.Begin("texture streaming");
+                float pixelsPerUnit = projection[1][1] * frame.framebufferHeight / (2.0f * std::max(frame.nearestBuilding, 1e-3f));
+                textureStreamer->Request(TextureStreamer::DemandLevel((float)facadeSize, pixelsPerUnit));
+                textureStreamer->Update();
+                profiler.End(streamZone);
+            }
+
+            // Requests the tiles around the camera and uploads the loaded ones within the same kind of budget
+            if (tiles) {
+                size_t tileZone = profiler.Begin("tile upload");
+                tiles->Update(frame.origin, projection[1][1] * 0.5f * frame.framebufferHeight, frame.front, frame.deltaTime);
+                hitchActivity.tilesUploaded = tiles->Upload(2.0);
+                hitchActivity.tilesPending = tiles->pending();
+                profiler.End(tileZone);
+            }
+
+            // Switches to the bindless program once every facade texture is complete
+            if (bindlessPrograms[0] && !facadeTextures.empty() && !bindlessFacades && textureLoader.pending() == 0) {
+                for (size_t i = 0; i < facadeTextures.size(); i++)
+                    materials.records[i].facade = facadeTextures[i]->MakeResident(Samplers.sampler(SamplerSet::TRILINEAR_REPEAT));
+                materials.Upload();
+                bindlessFacades = true;
+            }
+
+            // Bakes every block's views once the facades are complete, always lit and with the texture path in use
+            if (impostors && !impostorsBaked && textureLoader.pending() == 0 && (!textureStreamer || textureStreamer->settled())) {
+                GLuint bakeProgram = (bindlessFacades ? bindlessPrograms : scenePrograms)[1];
+                GLState.UseProgram(bakeProgram);
+                if (shadows)
+                    shadows->Disable(bakeProgram);
+                GLState.Enable(GL_DEPTH_TEST);
+                facades.Bind();
+                Samplers.Bind(0, SamplerSet::TRILINEAR_REPEAT);
+                sceneVAO.Bind();
+                VBO bakeInstances(instances, city.buildingCount() * CityGenerator::INSTANCE_FLOATS * sizeof(GLfloat));
+                FrameData bakeData = frameData;
+                bakeData.sceneModel = glm::mat4(1.0f);
+                bakeData.fogColor.w = 0.0f;
+                bakeData.fogParams.z = 0.0f;
+                for (GLsizei block = 0; block < impostors->atlas.layers; block++) {
+                    // The records of a block's buildings follow each other
+                    linkInstances(bakeInstances.ID, (GLintptr)(block * city.lotsPerBlock() * instanceStride));
+                    const GLfloat* box = &blockInstances[block * CityGenerator::INSTANCE_FLOATS];
+                    glm::vec3 min(box[0], box[1], box[2]);
+                    impostors->Bake(block, min, min + glm::vec3(box[3], box[4], box[5]), [&](const glm::mat4& bakeProjection, const glm::mat4& bakeView) {
+                        bakeData.projection = bakeProjection;
+                        bakeData.view = bakeView;
+                        bakeData.camMatrix = bakeProjection * bakeView;
+                        frameUBO.Update(&bakeData, sizeof(FrameData));
+                        drawUnits((GLsizei)city.lotsPerBlock());
+                    });
+                }
+                bakeInstances.Delete();
+                impostors->Finish();
+                impostorsBaked = true;
+                // Makes the switch below pick the program again and look up its model location
+                currentProgram = 0;
+            }
+            if (exportViews && !assetsReady && textureLoader.pending() == 0 && (!textureStreamer || textureStreamer->settled()) && (!virtualTexture || virtualTexture->settled())
+                && (!impostors || impostorsBaked))
+                assetsReady = true;
+
+            // The lit or unlit permutation, switching programs only when the light, the shading path or the texture path changed
+            // Unlit frames have nothing to resolve and always draw forward
+            bool deferredFrame = frame.deferred && frame.lightOn && deferredRenderer;
+            unsigned int programSlot = !frame.lightOn ? 0 : deferredFrame ? 3 : clusteredLights ? 2 : 1;
+            GLuint activeProgram = (bindlessFacades ? bindlessPrograms : scenePrograms)[programSlot];
+            if (activeProgram != currentProgram) {
+                GLState.UseProgram(activeProgram);
+                currentProgram = activeProgram;
+            }
+
+            // Live colors shade buildings by a made up occupancy that changes every frame, then the edited records go
+            // to the buffers holding every record in as few uploads as the dirty ranges allow
+            if (instances && liveColors > 0) {
+                for (int i = 0; i < liveColors; i++) {
+                    uint32_t hash = ((uint32_t)frame.frameIndex * (uint32_t)liveColors + (uint32_t)i) * 2654435761u;
+                    hash ^= hash >> 16;
+                    float occupancy = (float)(hash & 0xff) / 255.0f;
+                    GLfloat* record = instanceRecords.Edit(hash % city.buildingCount());
+                    record[8] = 1.0f;
+                    record[9] = 1.0f - 0.7f * occupancy;
+                    record[10] = 1.0f - 0.9f * occupancy;
+                }
+                instances = instanceRecords.data();
+            }
+            // Every update of a frame lands in the same records, a building updated twice is uploaded once
+            // A recording keeps them with the frame, a replay takes them from there
+            size_t updates = 0;
+            const LiveDataReceiver::Update* drained = nullptr;
+            if (liveData) {
+                updates = liveData->Drain(liveUpdates.data(), liveUpdates.size());
+                drained = liveUpdates.data();
+                sessionLog.RecordUpdates(frame.frameIndex, drained, updates);
+            }
+            else if (replay && instances)
+                drained = sessionLog.updates((size_t)frame.frameIndex, updates);
+            for (size_t i = 0; i < updates; i++) {
+                if (drained[i].building >= city.buildingCount())
+                    continue;
+                GLfloat* record = instanceRecords.Edit(drained[i].building);
+                record[8] = -1.0f;
+                record[9] = drained[i].value;
+                record[10] = 0.0f;
+            }
+            if (updates > 0)
+                instances = instanceRecords.data();
+            // Buildings a collaborative session edited take their new boxes and facades, an emptied slot a box of no size
+            for (size_t i = 0; i < frame.editCount; i++) {
+                const SceneSync::Edit& edit = frame.edits[i];
+                GLfloat* record = instanceRecords.Edit(edit.building);
+                glm::vec3 size = edit.max - edit.min;
+                record[0] = edit.min.x;
+                record[1] = edit.min.y;
+                record[2] = edit.min.z;
+                record[3] = size.x;
+                record[4] = size.y;
+                record[5] = size.z;
+                record[6] = (GLfloat)edit.facade;
+            }
+            if (frame.editCount > 0)
+                instances = instanceRecords.data();
+            // The cached light faces still show the buildings as they were
+            if (lightShadows && frame.editCount > 0)
+                lightShadows->Invalidate();
+            if (instanceRecords.dirty()) {
+                const std::vector<InstanceRecords::Range>& dirtyRanges = instanceRecords.Coalesce();
+                if (shadowCasters)
+                    instanceRecords.Upload(*shadowCasters, (GLintptr)instanceStride);
+                if (cityRecords)
+                    instanceRecords.Upload(*cityRecords, 0);
+                if (pickRecords)
+                    instanceRecords.Upload(*pickRecords, (GLintptr)(groundCapacity * instanceStride));
+                if (overviewRecords) {
+                    instanceRecords.Upload(*overviewRecords, 0);
+                    overview->RecordsChanged(dirtyRanges);
+                }
+                instanceRecords.ClearDirty();
+            }
+
+            // Render
+            size_t clearZone = profiler.Begin("clear");
+            if (viewTarget)
+                viewTarget->Bind();
+            // With dynamic resolution the scene is drawn smaller and scaled up before the overlay
+            GLsizei sceneWidth = frame.framebufferWidth, sceneHeight = frame.framebufferHeight;
+            if (dynamicResolution) {
+                dynamicResolution->Begin(frame.framebufferWidth, frame.framebufferHeight);
+                sceneWidth = dynamicResolution->width;
+                sceneHeight = dynamicResolution->height;
+            }
+            // The post effects read the scene from their own target, anti-aliased before they run
+            if (postProcess)
+                postProcess->Begin(sceneWidth, sceneHeight);
+            // The anti-aliasing target goes between the scene and whatever it is drawn into, deferred frames only take FXAA's
+            bool antiAliased = antiAliasing && (!deferredFrame || !antiAliasing->multisampled());
+            if (antiAliased)
+                antiAliasing->Begin(sceneWidth, sceneHeight);
+            frameGraph.Enable(ssaoPass, frame.ssao && screenOcclusion);
+            frameGraph.Enable(resolvePass, deferredFrame);
+            frameGraph.Enable(antiAliasingPass, antiAliased);
+            frameGraph.Enable(bloomPass, postProcess && (postProcess->effects & PostProcess::BLOOM));
+            frameGraph.Enable(postPass, postProcess != nullptr);
+            frameGraph.Enable(upscalePass, dynamicResolution != nullptr);
+            frameGraph.Resize(occlusionResource, ScreenSpaceOcclusion::HalfSize(sceneWidth), ScreenSpaceOcclusion::HalfSize(sceneHeight));
+            frameGraph.Resize(occlusionBlurResource, ScreenSpaceOcclusion::HalfSize(sceneWidth), ScreenSpaceOcclusion::HalfSize(sceneHeight));
+            targetPool.BeginFrame(frame.framebufferWidth, frame.framebufferHeight);
+            frameGraph.Compile();
+            // Forward frames need a float depth buffer of their own, the window's is fixed point, the anti-aliasing and
+            // post effect targets have one
+            if (reverseDepth)
+                reverseDepth->Begin(sceneWidth, sceneHeight, !deferredFrame && !antiAliased && !postProcess);
+            if (deferredFrame) {
+                deferredRenderer->Begin(sceneWidth, sceneHeight);
+            }
+            else {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            }
+            GLState.Enable(GL_DEPTH_TEST);
+            // Keeps each eye in its half, every scene program writes the distance to the middle of the framebuffer
+            if (stereo)
+                GLState.Enable(GL_CLIP_DISTANCE0);
+            // The G-buffer keeps every pixel, its lighting pass has no rate image to coarsen
+            if (shadingRate && !deferredFrame)
+                shadingRate->Begin();
+            profiler.End(clearZone);
+
+            const glm::mat4& view = frame.view;
+            frameData.view = view;
+            frameData.projection = projection;
+            frameData.camMatrix = projection * view;
+            // The left eye half the separation to the left of the camera, so the world moves right in its view
+            if (stereo) {
+                frameData.eyeMatrices[0] = projection * glm::translate(glm::mat4(1.0f), glm::vec3(0.5f * stereoSeparation, 0.0f, 0.0f)) * view;
+                frameData.eyeMatrices[1] = projection * glm::translate(glm::mat4(1.0f), glm::vec3(-0.5f * stereoSeparation, 0.0f, 0.0f)) * view;
+            }
+            // The streamed world is drawn around the camera, which sits at the origin of its view
+            frameData.camPos = tiles ? glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) : glm::vec4(frame.position, 1.0f);
+            // Every program drawing the city reads the model matrix from here, switching programs sets no uniform
+            const glm::mat4& model = frame.model;
+            frameData.sceneModel = model;
+            // Frames without fog have it at density 0, so the fog programs of a deferred or unlit frame leave the color
+            frameData.fogColor = glm::vec4(fogColor, frame.fogDistance > 0.0f ? fogDensity : 0.0f);
+            // Heights that sit on the world's ground are taken relative to the origin the frame is drawn around
+            float groundHeight = (float)-frame.origin.y;
+            frameData.lightPos = glm::vec4(glm::vec3(glm::dvec3(0.0, 10.0, 0.0) - frame.origin), 1.0f);
+            // The sun of the frame's time, the probes see the city in the same daylight and a sky dimmed by it
+            if (sunMoves) {
+                sunDirection = timeOfDay.Direction(frame.time);
+                glm::vec3 daylight = timeOfDay.Color(frame.time);
+                frameData.sunColor = glm::vec4(daylight, 1.0f);
+                if (reflectionProbes)
+                    reflectionProbes->clearColor = probeSky * daylight;
+            }
+            frameData.sunDirection = glm::vec4(glm::normalize(glm::mat3(model) * -sunDirection), 0.0f);
+            frameData.fogParams = glm::vec4(fogFalloff, groundHeight, frame.fogDistance, 0.0f);
+            // The emitters are the only thing the CPU tells the particles, rates in particles per second
+            frameData.weather = glm::vec4((float)weatherKind, weatherKind == ParticleSystem::WEATHER_SNOW ? 1500.0f : 6000.0f, 1.5f, 0.5f);
+            frameData.particleParams = glm::vec4(12.0f, frame.deltaTime, (float)(frame.frameIndex & 0xFFFFFF), groundHeight);
+            frameUBO.Update(&frameData, sizeof(FrameData));
+            // The lit program writes the pages the scene wants while it draws, the feedback has a pixel per block of the scene's
+            if (virtualTexture && frame.lightOn)
+                virtualTexture->Bind(activeProgram, sceneWidth, sceneHeight, frame.frameIndex);
+
+            // Renders a face of a reflection probe with the forward lit program, in model space and without the fog
+            if (reflectionProbes && frame.lightOn && !deferredFrame) {
+                size_t probeZone = profiler.Begin("reflection probes");
+                GLuint captureProgram = (bindlessFacades ? bindlessPrograms : scenePrograms)[1];
+                GLState.UseProgram(captureProgram);
+                if (shadows)
+                    shadows->Disable(captureProgram);
+                facades.Bind();
+                Samplers.Bind(0, SamplerSet::TRILINEAR_REPEAT);
+                FrameData probeData = frameData;
+                probeData.sceneModel = glm::mat4(1.0f);
+                probeData.fogColor.w = 0.0f;
+                probeData.fogParams.z = 0.0f;
+                if (reverseDepth)
+                    reverseDepth->Suspend();
+                reflectionProbes->Update([&](const glm::mat4& probeProjection, const glm::mat4& probeView) {
+                    probeData.projection = probeProjection;
+                    probeData.view = probeView;
+                    probeData.camMatrix = probeProjection * probeView;
+                    probeData.camPos = glm::inverse(probeView)[3];
+                    frameUBO.Update(&probeData, sizeof(FrameData));
+                    drawShadowCasters();
+                });
+                if (reverseDepth)
+                    reverseDepth->Resume();
+                frameUBO.Update(&frameData, sizeof(FrameData));
+                GLState.UseProgram(activeProgram);
+                profiler.End(probeZone);
+            }
+
+            // Draws the billboard of every baked block mirrored in the water into a quarter of the pixels, without the fog
+            // and reading the atlas a few levels coarser, the water only shows the city blurred and rippled
+            if (planarReflection && impostorsBaked && !deferredFrame) {
+                size_t reflectionZone = profiler.Begin("planar reflection");
+                if (reverseDepth)
+                    reverseDepth->Suspend();
+                planarReflection->Begin(sceneWidth, sceneHeight, projection, view, model);
+                FrameData reflectionData = frameData;
+                reflectionData.projection = planarReflection->projection;
+                reflectionData.view = planarReflection->view;
+                reflectionData.camMatrix = planarReflection->projection * planarReflection->view;
+                reflectionData.camPos = glm::vec4(planarReflection->eye, 1.0f);
+                reflectionData.fogColor.w = 0.0f;
+                reflectionData.fogParams.z = 0.0f;
+                frameUBO.Update(&reflectionData, sizeof(FrameData));
+                GLState.UseProgram(billboardProgram);
+                glUniform1f(glGetUniformLocation(billboardProgram, "lodBias"), 2.0f);
+                impostors->atlas.Bind();
+                Samplers.Bind(0, SamplerSet::TRILINEAR_CLAMP);
+                billboardVAO.Bind();
+                billboardVAO.LinkBuffer(0, reflectedBillboards->ID, 0, ImpostorAtlas::RECORD_FLOATS * sizeof(float));
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, impostors->atlas.layers);
+                GLState.CountDraw(impostors->atlas.layers, 2 * impostors->atlas.layers);
+                billboardVAO.Unbind();
+                glUniform1f(glGetUniformLocation(billboardProgram, "lodBias"), 0.0f);
+                GLState.CountUniforms(2);
+                planarReflection->End();
+                if (reverseDepth)
+                    reverseDepth->Resume();
+                frameUBO.Update(&frameData, sizeof(FrameData));
+                GLState.UseProgram(activeProgram);
+                profiler.End(reflectionZone);
+            }
+
+            // Renders the cascades the camera moved out of with the unlit program, then puts the camera's frame data back
+            if (shadows && frame.lightOn) {
+                size_t shadowZone = profiler.Begin("shadows");
+                glm::mat4 toModel = glm::inverse(model);
+                GLuint casterProgram = scenePrograms[0];
+                GLState.UseProgram(casterProgram);
+                FrameData shadowData = frameData;
+                shadowData.sceneModel = glm::mat4(1.0f);
+                // The cascades have orthographic projections of their own and keep the default depth convention
+                if (reverseDepth)
+                    reverseDepth->Suspend();
+                shadows->Update(glm::vec3(toModel * glm::vec4(frame.position, 1.0f)), glm::normalize(glm::mat3(toModel) * frame.front), sunDirection,
+                    [&](const glm::mat4& shadowProjection, const glm::mat4& shadowView) {
+                        shadowData.projection = shadowProjection;
+                        shadowData.view = shadowView;
+                        shadowData.camMatrix = shadowProjection * shadowView;
+                        frameUBO.Update(&shadowData, sizeof(FrameData));
+                        drawShadowCasters();
+                    });
+                if (reverseDepth)
+                    reverseDepth->Resume();
+                frameUBO.Update(&frameData, sizeof(FrameData));
+                GLState.UseProgram(activeProgram);
+                shadows->Apply(activeProgram);
+                profiler.End(shadowZone);
+            }
+
+            // Renders the light faces that are missing or that a car is in like the cascades, before the lights are
+            // binned with the slots they are shadowed from
+            if (lightShadows && frame.lightOn) {
+                size_t lightShadowZone = profiler.Begin("light shadows");
+                for (size_t slice = 0; slice < frame.vehicleSliceCount; slice++) {
+                    const TrafficSimulation::Slice& run = frame.vehicleSlices[slice];
+                    lightShadows->AddDynamic(frame.nearVehicles + run.begin, run.nearCount);
+                    lightShadows->AddDynamic(frame.farVehicles + run.begin, run.farCount);
+                }
+                GLuint casterProgram = scenePrograms[0];
+                GLState.UseProgram(casterProgram);
+                FrameData shadowData = frameData;
+                shadowData.sceneModel = glm::mat4(1.0f);
+                if (reverseDepth)
+                    reverseDepth->Suspend();
+                auto drawCars = [&](GLuint records, GLsizei count) {
+                    const DrawCommandBuilder::Mesh& car = sceneHeap.mesh(vehicleMesh);
+                    trafficVAO.Bind();
+                    trafficVAO.LinkBuffer(recordBinding, records, 0, sizeof(CompactInstance));
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, TrafficSimulation::BODY_INDICES, sceneHeap.indexType, sceneHeap.indexOffset(car.firstIndex), count, car.baseVertex);
+                    GLState.CountDraw(count, TrafficSimulation::BODY_INDICES / 3 * count);
+                };
+                lightShadows->Update(view * model, projection, sceneHeight,
+                    [&](const glm::mat4& shadowProjection, const glm::mat4& shadowView) {
+                        shadowData.projection = shadowProjection;
+                        shadowData.view = shadowView;
+                        shadowData.camMatrix = shadowProjection * shadowView;
+                        frameUBO.Update(&shadowData, sizeof(FrameData));
+                        drawShadowCasters();
+                    }, traffic ? LightShadows::DynamicFunction(drawCars) : nullptr);
+                if (reverseDepth)
+                    reverseDepth->Resume();
+                frameUBO.Update(&frameData, sizeof(FrameData));
+                GLState.UseProgram(activeProgram);
+                profiler.End(lightShadowZone);
+            }
+
+            // The lights turn with the city, so they are binned in view space after the model matrix is known
+            if (clusteredLights && frame.lightOn) {
+                size_t lightZone = profiler.Begin("light binning", false);
+                clusteredLights->Update(view * model, projection, sceneWidth, sceneHeight);
+                if (!deferredFrame) {
+                    clusteredLights->Apply(activeProgram);
+                    if (lightShadows)
+                        lightShadows->Apply(activeProgram);
+                    if (decalLibrary)
+                        decalLibrary->Apply(activeProgram);
+                }
+                profiler.End(lightZone);
+            }
+
+            // Culling and sorting ran on the simulation thread, the packet brings their result
+            profiler.Record("cull", frame.cullMilliseconds);
+            profiler.Record("sort", frame.sortMilliseconds);
+            const uint32_t* visibleBuildings = frame.visibleBuildings;
+            size_t visibleCount = frame.visibleCount;
+
+            // With a depth pre-pass every branch below submits its draws twice, first depth only with the unlit program,
+            // then with the lit one testing for GL_EQUAL, so each visible pixel runs the expensive fragment shader once
+            // Unlit frames gain nothing from it and draw once
+            bool prepassFrame = depthPrepass && frame.lightOn;
+            bool glassFrame = transparency && frame.lightOn && !deferredFrame;
+            const int firstPass = prepassFrame ? 0 : 1;
+            const GLenum depthFunc = reverseDepth ? GL_GREATER : GL_LESS;
+            auto beginPass = [&](int pass) {
+                if (!prepassFrame)
+                    return;
+                GLuint program = pass == 0 ? scenePrograms[0] : activeProgram;
+                GLState.UseProgram(program);
+                GLboolean color = pass == 0 ? GL_FALSE : GL_TRUE;
+                glColorMask(color, color, color, color);
+                glDepthMask(pass == 0 ? GL_TRUE : GL_FALSE);
+                glDepthFunc(pass == 0 ? depthFunc : GL_EQUAL);
+            };
+            auto endPasses = [&]() {
+                if (!prepassFrame)
+                    return;
+                glDepthMask(GL_TRUE);
+                glDepthFunc(depthFunc);
+            };
+            // Streets go on the ground of the merged paths, one draw per kind of every street tile in the frustum
+            auto drawRoads = [&]() {
+                if (roadTiles.empty())
+                    return;
+                Frustum roadFrustum;
+                roadFrustum.Extract(projection * view * model);
+                for (const RoadTile& tile : roadTiles) {
+                    if (!roadFrustum.TestBox(tile.ranges.min, tile.ranges.max))
+                        continue;
+                    const DrawCommandBuilder::Mesh& range = sceneHeap.mesh(tile.mesh);
+                    glVertexAttrib3fv(4, glm::value_ptr(tile.boxMin));
+                    glVertexAttrib3fv(5, glm::value_ptr(tile.boxSize));
+                    for (int kind = 0; kind < RoadNetwork::KIND_COUNT; kind++) {
+                        if (tile.ranges.indexCount[kind] == 0)
+                            continue;
+                        glVertexAttrib3fv(1, RoadNetwork::COLORS[kind]);
+                        glDrawElementsBaseVertex(GL_TRIANGLES, tile.ranges.indexCount[kind], sceneHeap.indexType,
+                            sceneHeap.indexOffset(range.firstIndex + tile.ranges.firstIndex[kind]), range.baseVertex);
+                        GLState.CountDraw(1, tile.ranges.indexCount[kind] / 3);
+                    }
+                }
+                glVertexAttrib3fv(4, glm::value_ptr(cityBoxMin));
+                glVertexAttrib3fv(5, glm::value_ptr(cityBoxSize));
+            };
+
+            size_t sceneZone = profiler.Begin("scene");
+            facades.Bind();
+            Samplers.Bind(0, SamplerSet::TRILINEAR_REPEAT);
+            sceneVAO.Bind();
+            if (tiles) {
+                // Every resident tile inside the frustum, tiles still loading simply are not there yet
+                Frustum frustum;
+                frustum.Extract(projection * view);
+                tileVAO.Bind();
+                tileCommands.Clear();
+                size_t tileCount = tiles->Collect(frustum, frame.origin, tileCommands, tileRecordData.data());
+                tileRecords->Update(tileRecordData.data(), (GLsizeiptr)(tileCount * TileStreamer::TILE_RECORDS * instanceStride));
+                for (int pass = firstPass; pass < 2; pass++) {
+                    beginPass(pass);
+                    tileCommands.Draw(tileIndirect.get(), [&](GLuint baseInstance) {
+                        linkRecords(tileVAO, tileRecords->ID, (GLintptr)(baseInstance * instanceStride));
+                    }, tiles->heap.indexType);
+                }
+                endPasses();
+            }
+            else if (instanced) {
+                // Packs the ground record and the records of the visible buildings straight into this frame's region
+                // Levels of detail are picked in the same pass from the model space camera, once per block with a visible building
+                glm::vec3 modelEye = glm::vec3(glm::inverse(model) * glm::vec4(frame.position, 1.0f));
+                if (lod)
+                    levelOfDetail.SetView(modelEye, projection, (float)viewHeight);
+                // Terrain patches take the place of the ground record, picked from the same camera in model space
+                size_t groundRecords = 1;
+                if (terrainMap) {
+                    Frustum modelFrustum;
+                    modelFrustum.Extract(projection * view * model);
+                    terrainMap->Select(modelEye, modelFrustum);
+                    groundRecords = terrainMap->wholePatches + terrainMap->quarterPatches;
+                }
+                // The workers only read the city and write their own slice, a block is measured again wherever a slice reaches it
+                // Each slice lists a block at most once in a row, so it gets room for as many blocks as it has buildings
+                size_t fillCount = jobs.Slices(visibleCount, JOB_GRAIN);
+                renderArena.Reset();
+                GLfloat* stagedRecords = (GLfloat*)renderArena.Allocate(visibleCount * instanceStride, alignof(GLfloat));
+                GLuint* stagedIds = (GLuint*)renderArena.Allocate(visibleCount * sizeof(GLuint), alignof(GLuint));
+                for (size_t slice = 0; lod && slice < fillCount; slice++) {
+                    size_t length = JobSystem::SliceStart(visibleCount, fillCount, slice + 1) - JobSystem::SliceStart(visibleCount, fillCount, slice);
+                    fillSlices[slice].blocks = (std::pair<uint32_t, float>*)renderArena.Allocate(length * sizeof(std::pair<uint32_t, float>), alignof(std::pair<uint32_t, float>));
+                }
+                jobs.ParallelFor(visibleCount, JOB_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+                    FillSlice& fill = fillSlices[slice];
+                    fill.begin = begin;
+                    fill.count = 0;
+                    fill.blockCount = 0;
+                    uint32_t lastBlock = UINT32_MAX;
+                    float lastSize = 0.0f;
+                    for (size_t i = begin; i < end; i++) {
+                        float blend = 0.0f;
+                        if (lod) {
+                            uint32_t block = visibleBuildings[i] / city.lotsPerBlock();
+                            if (block != lastBlock) {
+                                const GLfloat* box = &blockInstances[block * CityGenerator::INSTANCE_FLOATS];
+                                glm::vec3 min(box[0], box[1], box[2]);
+                                lastSize = levelOfDetail.ProjectedSize(min, min + glm::vec3(box[3], box[4], box[5]));
+                                lastBlock = block;
+                                fill.blocks[fill.blockCount++] = { block, lastSize };
+                            }
+                            blend = billboarded(block, lastSize) ? 1.0f : levelOfDetail.ImpostorBlend(lastSize);
+                        }
+                        if (blend >= 1.0f)
+                            continue;
+                        const GLfloat* source = &instances[visibleBuildings[i] * CityGenerator::INSTANCE_FLOATS];
+                        stagedIds[begin + fill.count] = visibleBuildings[i];
+                        GLfloat* record = &stagedRecords[(begin + fill.count++) * CityGenerator::INSTANCE_FLOATS];
+                        std::copy(source, source + CityGenerator::INSTANCE_FLOATS, record);
+                        record[7] = LevelOfDetail::DetailFade(blend);
+                    }
+                });
+
+                GLfloat* target = (GLfloat*)instanceStream.Map();
+                CompactInstance* compactTarget = compactInstances ? (CompactInstance*)target : nullptr;
+                GLuint* candidateIds = occlusion ? occlusion->MapIds() : nullptr;
+                if (terrainMap)
+                    std::copy(terrainMap->records.begin(), terrainMap->records.end(), target);
+                else if (compactTarget)
+                    CompactInstance::Pack(groundInstance, 1, compactTarget);
+                else
+                    std::copy(groundInstance, groundInstance + CityGenerator::INSTANCE_FLOATS, target);
+                size_t records = groundRecords;
+                for (size_t slice = 0; slice < fillCount; slice++) {
+                    const FillSlice& fill = fillSlices[slice];
+                    if (compactTarget)
+                        CompactInstance::Pack(stagedRecords + fill.begin * CityGenerator::INSTANCE_FLOATS, fill.count, compactTarget + records);
+                    else
+                        std::memcpy(target + records * CityGenerator::INSTANCE_FLOATS, stagedRecords + fill.begin * CityGenerator::INSTANCE_FLOATS,
+                            fill.count * CityGenerator::INSTANCE_FLOATS * sizeof(GLfloat));
+                    if (candidateIds)
+                        std::memcpy(candidateIds + records - groundRecords, stagedIds + fill.begin, fill.count * sizeof(GLuint));
+                    records += fill.count;
+                    for (size_t b = 0; b < fill.blockCount; b++) {
+                        const std::pair<uint32_t, float>& measured = fill.blocks[b];
+                        if (blockSize[measured.first] < 0.0f) {
+                            blockSize[measured.first] = measured.second;
+                            touchedBlocks.push_back(measured.first);
+                        }
+                    }
+                }
+                // Impostors use the unit building too, so they go right after the buildings into the same command
+                // Billboards have their own program and stream
+                GLfloat* billboardTarget = impostorsBaked ? (GLfloat*)billboardStream->Map() : nullptr;
+                size_t billboardCount = 0;
+                for (uint32_t block : touchedBlocks) {
+                    float blend = levelOfDetail.ImpostorBlend(blockSize[block]);
+                    if (billboarded(block, blockSize[block])) {
+                        const GLfloat* source = &billboardRecords[block * ImpostorAtlas::RECORD_FLOATS];
+                        std::copy(source, source + ImpostorAtlas::RECORD_FLOATS, billboardTarget + billboardCount++ * ImpostorAtlas::RECORD_FLOATS);
+                    }
+                    else if (blend > 0.0f) {
+                        const GLfloat* source = &blockInstances[block * CityGenerator::INSTANCE_FLOATS];
+                        if (candidateIds)
+                            candidateIds[records - groundRecords] = (GLuint)city.buildingCount() + block;
+                        GLfloat impostor[CityGenerator::INSTANCE_FLOATS];
+                        GLfloat* record = compactTarget ? impostor : target + records * CityGenerator::INSTANCE_FLOATS;
+                        std::copy(source, source + CityGenerator::INSTANCE_FLOATS, record);
+                        record[7] = LevelOfDetail::ImpostorFade(blend);
+                        if (compactTarget)
+                            CompactInstance::Pack(record, 1, compactTarget + records);
+                        records++;
+                    }
+                    blockSize[block] = -1.0f;
+                }
+                touchedBlocks.clear();
+                instanceStream.Unmap(records * streamStride);
+                if (billboardTarget)
+                    billboardStream->Unmap(billboardCount * ImpostorAtlas::RECORD_FLOATS * sizeof(float));
+                // The slices of the cars close up into one near and one far list
+                size_t nearVehicles = 0, farVehicles = 0;
+                if (traffic) {
+                    CompactInstance* vehicleTarget = (CompactInstance*)trafficStream->Map();
+                    CompactInstance* farTarget = vehicleTarget + traffic->vehicleCount();
+                    for (size_t slice = 0; slice < frame.vehicleSliceCount; slice++) {
+                        const TrafficSimulation::Slice& run = frame.vehicleSlices[slice];
+                        std::copy(frame.nearVehicles + run.begin, frame.nearVehicles + run.begin + run.nearCount, vehicleTarget + nearVehicles);
+                        std::copy(frame.farVehicles + run.begin, frame.farVehicles + run.begin + run.farCount, farTarget + farVehicles);
+                        nearVehicles += run.nearCount;
+                        farVehicles += run.farCount;
+                    }
+                    trafficStream->Unmap(2 * traffic->vehicleCount() * sizeof(CompactInstance));
+                }
+                // A roof on every building record, grouped by shape so each shape is one instanced draw
+                size_t roofCounts[RoofLibrary::SHAPE_COUNT] = {}, roofStarts[RoofLibrary::SHAPE_COUNT];
+                if (roofStream) {
+                    for (size_t slice = 0; slice < fillCount; slice++)
+                        for (size_t i = fillSlices[slice].begin; i < fillSlices[slice].begin + fillSlices[slice].count; i++)
+                            roofCounts[roofShapes[stagedIds[i]]]++;
+                    size_t roofRecords = 0;
+                    for (int shape = 0; shape < RoofLibrary::SHAPE_COUNT; shape++) {
+                        roofStarts[shape] = roofRecords;
+                        roofRecords += roofCounts[shape];
+                    }
+                    CompactInstance* roofTarget = (CompactInstance*)roofStream->Map();
+                    size_t roofNext[RoofLibrary::SHAPE_COUNT];
+                    std::copy(std::begin(roofStarts), std::end(roofStarts), roofNext);
+                    for (size_t slice = 0; slice < fillCount; slice++) {
+                        for (size_t i = fillSlices[slice].begin; i < fillSlices[slice].begin + fillSlices[slice].count; i++) {
+                            RoofLibrary::Shape shape = roofShapes[stagedIds[i]];
+                            GLfloat roof[CityGenerator::INSTANCE_FLOATS];
+                            RoofLibrary::WriteRecord(shape, &stagedRecords[i * CityGenerator::INSTANCE_FLOATS], roof);
+                            CompactInstance::Pack(roof, 1, roofTarget + roofNext[shape]++);
+                        }
+                    }
+                    roofStream->Unmap(roofRecords * sizeof(CompactInstance));
+                }
+
+                // One command per mesh kind, all drawn at once
+                // With occlusion culling the buildings go through its two phases instead: last frame's visible set first,
+                // then whatever the depth those leave behind does not hide
+                drawCommands.Clear();
+                if (terrainMap) {
+                    drawCommands.Add(sceneHeap.mesh(patchMesh), (GLuint)terrainMap->wholePatches, 0);
+                    drawCommands.Add(sceneHeap.mesh(quarterMesh), (GLuint)terrainMap->quarterPatches, (GLuint)terrainMap->wholePatches);
+                }
+                else {
+                    drawCommands.Add(sceneHeap.mesh(groundMesh), 1, 0);
+                }
+                if (meshlets) {
+                    Frustum modelFrustum;
+                    modelFrustum.Extract(projection * view * model);
+                    meshlets->Cull(instanceStream.ID, (GLuint)(instanceStream.Offset() / instanceStride + groundRecords), (GLuint)(records - groundRecords), modelFrustum, modelEye);
+                }
+                else if (!occlusion && !gpuCuller && !proceduralBoxes) {
+                    drawCommands.Add(sceneHeap.mesh(buildingMesh), (GLuint)(records - groundRecords), (GLuint)groundRecords);
+                }
+                if (compactInstances)
+                    compactVAO.Bind();
+                // The occlusion phases only run in the first pass, the shading pass draws what they let through again
+                // Pass 2 draws the same again for the glass, after the phases of both passes
+                auto drawPass = [&](int pass) {
+                    drawCommands.Draw(indirectStream.get(), bindInstances, sceneHeap.indexType);
+                    // The buildings and box impostors behind the ground records, outside the commands since they have no mesh
+                    if (proceduralBoxes && records > groundRecords) {
+                        bindInstances((GLuint)groundRecords);
+                        drawUnits((GLsizei)(records - groundRecords));
+                    }
+                    if (meshlets) {
+                        linkInstances(meshlets->recordBuffer, 0);
+                        meshlets->Draw(sceneHeap.indexType);
+                    }
+                    if (occlusion && pass == firstPass) {
+                        occlusion->Begin(instanceStream.ID, (GLuint)(instanceStream.Offset() / instanceStride + groundRecords), (GLuint)(records - groundRecords), sceneHeap.mesh(buildingMesh));
+                        linkInstances(occlusion->recordBuffer, 0);
+                        occlusion->Draw(0, sceneHeap.indexType);
+                        occlusion->Test(projection * view * model, sceneWidth, sceneHeight);
+                        occlusion->Draw(1, sceneHeap.indexType);
+                    }
+                    else if (occlusion) {
+                        linkInstances(occlusion->recordBuffer, 0);
+                        occlusion->Draw(0, sceneHeap.indexType);
+                        occlusion->Draw(1, sceneHeap.indexType);
+                    }
+                    if (gpuCuller && pass == firstPass) {
+                        gpuCuller->Begin(cityRecords->ID, blockRecords->ID, sceneHeap.mesh(buildingMesh), model, lod ? &levelOfDetail : nullptr, (float)viewHeight);
+                        linkInstances(gpuCuller->recordBuffer, 0);
+                        gpuCuller->Draw(0, sceneHeap.indexType);
+                        gpuCuller->Test(sceneWidth, sceneHeight);
+                        gpuCuller->Draw(1, sceneHeap.indexType);
+                    }
+                    else if (gpuCuller) {
+                        linkInstances(gpuCuller->recordBuffer, 0);
+                        gpuCuller->Draw(0, sceneHeap.indexType);
+                        gpuCuller->Draw(1, sceneHeap.indexType);
+                    }
+                    // The props go through their phases after the buildings, whose depth hides them in the second
+                    if (propCuller && pass == firstPass) {
+                        propCuller->Begin(propRecords->ID, propTileRecords->ID, sceneHeap.mesh(buildingMesh), model, lod ? &propDetail : nullptr, (float)viewHeight);
+                        linkInstances(propCuller->recordBuffer, 0);
+                        propCuller->Draw(0, sceneHeap.indexType);
+                        propCuller->Test(sceneWidth, sceneHeight);
+                        propCuller->Draw(1, sceneHeap.indexType);
+                    }
+                    else if (propCuller) {
+                        linkInstances(propCuller->recordBuffer, 0);
+                        propCuller->Draw(0, sceneHeap.indexType);
+                        propCuller->Draw(1, sceneHeap.indexType);
+                    }
+                    // One instanced draw per vehicle level of detail, the far cars only draw the body of the mesh
+                    if (traffic && nearVehicles + farVehicles > 0) {
+                        const DrawCommandBuilder::Mesh& car = sceneHeap.mesh(vehicleMesh);
+                        trafficVAO.Bind();
+                        if (nearVehicles > 0) {
+                            trafficVAO.LinkBuffer(recordBinding, trafficStream->ID, trafficStream->Offset(), sizeof(CompactInstance));
+                            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, car.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(car.firstIndex), (GLsizei)nearVehicles, car.baseVertex);
+                            GLState.CountDraw(nearVehicles, car.indexCount / 3 * nearVehicles);
+                        }
+                        if (farVehicles > 0) {
+                            trafficVAO.LinkBuffer(recordBinding, trafficStream->ID, (GLintptr)(trafficStream->Offset() + traffic->vehicleCount() * sizeof(CompactInstance)), sizeof(CompactInstance));
+                            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, TrafficSimulation::BODY_INDICES, sceneHeap.indexType, sceneHeap.indexOffset(car.firstIndex), (GLsizei)farVehicles, car.baseVertex);
+                            GLState.CountDraw(farVehicles, TrafficSimulation::BODY_INDICES / 3 * farVehicles);
+                        }
+                        (compactInstances ? compactVAO : sceneVAO).Bind();
+                    }
+                    if (roofStream) {
+                        roofVAO.Bind();
+                        for (int shape = 0; shape < RoofLibrary::SHAPE_COUNT; shape++) {
+                            if (roofCounts[shape] == 0)
+                                continue;
+                            const DrawCommandBuilder::Mesh& roof = sceneHeap.mesh(roofMeshes[shape]);
+                            roofVAO.LinkBuffer(recordBinding, roofStream->ID, (GLintptr)(roofStream->Offset() + roofStarts[shape] * sizeof(CompactInstance)), sizeof(CompactInstance));
+                            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, roof.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(roof.firstIndex), (GLsizei)roofCounts[shape], roof.baseVertex);
+                            GLState.CountDraw(roofCounts[shape], roof.indexCount / 3 * roofCounts[shape]);
+                        }
+                        (compactInstances ? compactVAO : sceneVAO).Bind();
+                    }
+                };
+                for (int pass = firstPass; pass < 2; pass++) {
+                    beginPass(pass);
+                    drawPass(pass);
+                }
+                endPasses();
+
+                // One quad per billboarded block, the program is switched back next frame
+                if (billboardCount > 0) {
+                    // Billboards are baked lit already, the resolve copies them through
+                    if (deferredFrame)
+                        deferredRenderer->DisableNormals();
+                    GLState.UseProgram(billboardProgram);
+                    currentProgram = billboardProgram;
+                    impostors->atlas.Bind();
+                    Samplers.Bind(0, SamplerSet::TRILINEAR_CLAMP);
+                    billboardVAO.Bind();
+                    billboardVAO.LinkBuffer(0, billboardStream->ID, (GLintptr)billboardStream->Offset(), ImpostorAtlas::RECORD_FLOATS * sizeof(float));
+                    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)billboardCount);
+                    GLState.CountDraw(billboardCount, 2 * billboardCount);
+                    billboardVAO.Unbind();
+                }
+                if (billboardTarget)
+                    billboardStream->Fence();
+                if (traffic)
+                    trafficStream->Fence();
+                if (roofStream)
+                    roofStream->Fence();
+
+                // Glass facades in one unsorted pass over everything opaque, the billboards included
+                if (glassFrame) {
+                    size_t glassZone = profiler.Begin("glass");
+                    transparency->Begin(sceneWidth, sceneHeight);
+                    GLState.UseProgram(glassProgram);
+                    currentProgram = glassProgram;
+                    transparency->Apply(glassProgram);
+                    if (reflectionProbes)
+                        reflectionProbes->Apply(glassProgram, glm::vec3(glm::inverse(model) * glm::vec4(frame.position, 1.0f)));
+                    (compactInstances ? compactVAO : sceneVAO).Bind();
+                    drawPass(2);
+                    transparency->Composite();
+                    profiler.End(glassZone);
+                }
+                instanceStream.Fence();
+            }
+            else if (batching) {
+                // One draw per visible batch, each with its facade and, for compact vertices, its box
+                const DrawCommandBuilder::Mesh& ground = sceneHeap.mesh(groundMesh);
+                for (int pass = firstPass; pass < 2; pass++) {
+                    beginPass(pass);
+                    glVertexAttrib3fv(1, CityGenerator::GROUND_COLOR);
+                    glVertexAttrib1f(6, 0.0f);
+                    glVertexAttrib3fv(4, glm::value_ptr(groundBoxMin));
+                    glVertexAttrib3fv(5, glm::value_ptr(groundBoxSize));
+                    glDrawElementsBaseVertex(GL_TRIANGLES, ground.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(ground.firstIndex), ground.baseVertex);
+                    GLState.CountDraw(1, ground.indexCount / 3);
+                    drawRoads();
+                    glVertexAttrib3fv(1, CityGenerator::BUILDING_COLOR);
+                    for (size_t list = 0; list < frame.batchCommandListCount; list++)
+                        frame.batchCommands[list].Execute(GLState);
+                }
+                endPasses();
+            }
+            else if (culling) {
+                const DrawCommandBuilder::Mesh& cityRange = sceneHeap.mesh(cityMesh);
+                // Blocks with a visible building in the order their first one was sorted in, so still front to back
+                visibleBlocks.clear();
+                if (blockQueries) {
+                    for (size_t i = 0; i < visibleCount; i++) {
+                        uint32_t block = visibleBuildings[i] / city.lotsPerBlock();
+                        if (blockSeen[block] != frame.frameIndex) {
+                            blockSeen[block] = frame.frameIndex;
+                            visibleBlocks.push_back(block);
+                        }
+                    }
+                }
+                else {
+                    for (size_t i = 0; i < visibleCount; i++)
+                        visibleOffsets[i] = sceneHeap.indexOffset(cityRange.firstIndex + CityGenerator::GROUND_INDICES + visibleBuildings[i] * CityGenerator::BUILDING_INDICES);
+                }
+                const GLsizei blockIndices = (GLsizei)(city.lotsPerBlock() * CityGenerator::BUILDING_INDICES);
+                for (int pass = firstPass; pass < 2; pass++) {
+                    beginPass(pass);
+                    glVertexAttrib3fv(1, CityGenerator::GROUND_COLOR);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, CityGenerator::GROUND_INDICES, sceneHeap.indexType, sceneHeap.indexOffset(cityRange.firstIndex), cityRange.baseVertex);
+                    GLState.CountDraw(1, CityGenerator::GROUND_INDICES / 3);
+                    drawRoads();
+
+                    glVertexAttrib3fv(1, CityGenerator::BUILDING_COLOR);
+                    if (blockQueries) {
+                        // Every building of a block is one range, which the GPU skips if the block's box was hidden last frame
+                        for (uint32_t block : visibleBlocks) {
+                            blockQueries->BeginDraw(block);
+                            glDrawElementsBaseVertex(GL_TRIANGLES, blockIndices, sceneHeap.indexType,
+                                sceneHeap.indexOffset(cityRange.firstIndex + CityGenerator::GROUND_INDICES + block * blockIndices), cityRange.baseVertex);
+                            blockQueries->EndDraw(block);
+                        }
+                        GLState.CountDraw(visibleBlocks.size(), visibleBlocks.size() * (blockIndices / 3));
+                    }
+                    else {
+                        // Draws the index range of each visible building in the merged mesh
+                        glMultiDrawElementsBaseVertex(GL_TRIANGLES, visibleCounts.data(), sceneHeap.indexType, visibleOffsets.data(), (GLsizei)visibleCount, visibleBaseVertices.data());
+                        GLState.CountDraw(visibleCount, visibleCount * (CityGenerator::BUILDING_INDICES / 3));
+                    }
+                }
+                endPasses();
+                // The boxes are tested against the depth the whole city left, for the next frame's draws
+                if (blockQueries) {
+                    size_t queryZone = profiler.Begin("block queries");
+                    blockQueries->Issue(visibleBlocks.data(), visibleBlocks.size(), projection * view * model, glm::vec3(glm::inverse(model) * glm::vec4(frame.position, 1.0f)));
+                    profiler.End(queryZone);
+                }
+            }
+            else {
+                // The ground quad and then every building in one range, they only differ in color
+                const DrawCommandBuilder::Mesh& cityRange = sceneHeap.mesh(cityMesh);
+                for (int pass = firstPass; pass < 2; pass++) {
+                    beginPass(pass);
+                    glVertexAttrib3fv(1, CityGenerator::GROUND_COLOR);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, CityGenerator::GROUND_INDICES, sceneHeap.indexType, sceneHeap.indexOffset(cityRange.firstIndex), cityRange.baseVertex);
+                    GLState.CountDraw(1, CityGenerator::GROUND_INDICES / 3);
+                    drawRoads();
+                    glVertexAttrib3fv(1, CityGenerator::BUILDING_COLOR);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, cityRange.indexCount - CityGenerator::GROUND_INDICES, sceneHeap.indexType,
+                        sceneHeap.indexOffset(cityRange.firstIndex + CityGenerator::GROUND_INDICES), cityRange.baseVertex);
+                    GLState.CountDraw(1, (cityRange.indexCount - CityGenerator::GROUND_INDICES) / 3);
+                }
+                endPasses();
+            }
+            profiler.End(sceneZone);
+
+            // Reads the pages the scene asked for back and pages in the ones missing, a few a frame
+            if (virtualTexture) {
+                size_t virtualZone = profiler.Begin("virtual texture");
+                virtualTexture->Update();
+                profiler.End(virtualZone);
+            }
+
+            // The water goes under what the scene drew, before the sky would fill it in
+            if (planarReflection && impostorsBaked && !deferredFrame) {
+                size_t waterZone = profiler.Begin("water");
+                planarReflection->Draw(projection * view, model, frame.position, (float)frame.time);
+                profiler.End(waterZone);
+            }
+
+            // The sky fills what the scene left at the far plane, the G-buffer of a deferred frame keeps no color for it
+            // The sun turns with the city, only its elevation remakes the sky's tables, which it changes with the time of day
+            if (skyRenderer && !deferredFrame) {
+                size_t skyZone = profiler.Begin("sky");
+                skyRenderer->Update(glm::mat3(model) * -sunDirection);
+                skyRenderer->Draw(projection, view);
+                profiler.End(skyZone);
+            }
+
+            // The particles collide with the depth of the finished scene and blend over it and the sky
+            if (particles && !deferredFrame) {
+                size_t particleZone = profiler.Begin("particles");
+                particles->Update(sceneWidth, sceneHeight);
+                particles->Draw();
+                profiler.End(particleZone);
+            }
+
+            // One instanced cube per light in view over a forward frame, from the lights binned for it
+            if (markerProgram && clusteredLights && frame.lightOn && !deferredFrame && clusteredLights->visibleLights > 0) {
+                GLState.UseProgram(markerProgram);
+                currentProgram = markerProgram;
+                clusteredLights->Apply(markerProgram);
+                glUniform1f(glGetUniformLocation(markerProgram, "markerSize"), 0.15f);
+                glUniform1f(glGetUniformLocation(markerProgram, "minPixels"), lightMarkerPixels);
+                glUniform1f(glGetUniformLocation(markerProgram, "viewportHeight"), (GLfloat)sceneHeight);
+                GLState.CountUniforms(3);
+                markerVAO.Bind();
+                glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 14, (GLsizei)clusteredLights->visibleLights);
+                GLState.CountDraw(clusteredLights->visibleLights, 12 * clusteredLights->visibleLights);
+                markerVAO.Unbind();
+            }
+
+            // The next frame's rates come from this frame's depth, with the sky and the markers drawn
+            if (shadingRate && !deferredFrame) {
+                size_t rateZone = profiler.Begin("shading rate");
+                shadingRate->End();
+                shadingRate->Build(sceneWidth, sceneHeight, projection, frame.fogDistance);
+                profiler.End(rateZone);
+            }
+            // Over the scene's depth and under the post effects, in pixels of the framebuffer whatever the scene's size
+            if (labelRenderer && !deferredFrame) {
+                size_t labelZone = profiler.Begin("labels");
+                labelRenderer->Draw(*labelLayout, frame.labels, frame.labelCount, frame.framebufferWidth, frame.framebufferHeight);
+                profiler.End(labelZone);
+            }
+            // The quadtree's leaves in blue and the buildings left after culling in green, in model space
+            if (DebugDraw::Enabled && debugLines && !deferredFrame) {
+                size_t debugZone = profiler.Begin("debug lines");
+                // Edits of a collaborative session split the tree's nodes on the simulation thread, the leaves are left out then
+                if (!sync) {
+                    for (const Quadtree::Node& node : buildingTree.nodes)
+                        if (node.firstChild == 0 && node.itemCount > 0)
+                            Debug.Box(node.min, node.max, DebugDraw::Color(0.2f, 0.4f, 1.0f));
+                }
+                for (size_t i = 0; i < frame.visibleCount; i++) {
+                    uint32_t b = frame.visibleBuildings[i];
+                    Debug.Box(glm::vec3(buildingBounds.minX[b], buildingBounds.minY[b], buildingBounds.minZ[b]),
+                        glm::vec3(buildingBounds.maxX[b], buildingBounds.maxY[b], buildingBounds.maxZ[b]), DebugDraw::Color(0.2f, 1.0f, 0.3f));
+                }
+                Debug.Flush(projection * view * model);
+                profiler.End(debugZone);
+            }
+
+            // Reports the pick of an earlier frame once its readback has arrived
+            GLuint pickedId;
+            if (picker && picker->Poll(pickedId))
+                reportPick(pickedId);
+            // Draws the IDs of the picked pixel only, through a projection narrowed to it, the ground or terrain as ID 0
+            // so it hides what it covers, then every building by its index in one draw
+            if (picker && frame.pick.x >= 0 && picker->Begin()) {
+                size_t pickZone = profiler.Begin("picking");
+                FrameData pickData = frameData;
+                pickData.projection = ObjectPicker::PickMatrix(frame.pick.x, frame.pick.y, frame.framebufferWidth, frame.framebufferHeight) * projection;
+                pickData.camMatrix = pickData.projection * view;
+                frameUBO.Update(&pickData, sizeof(FrameData));
+                GLState.UseProgram(pickProgram);
+                currentProgram = pickProgram;
+                GLint firstIdLoc = glGetUniformLocation(pickProgram, "firstId");
+                GLint idTrianglesLoc = glGetUniformLocation(pickProgram, "idTriangles");
+                sceneVAO.Bind();
+                if (instanced) {
+                    // The frame's own records were fenced for reuse already, the ground ones are copied in front of the buildings
+                    if (!pickRecords) {
+                        pickRecords = std::make_unique<VBO>(nullptr, (GLsizeiptr)((groundCapacity + city.buildingCount()) * instanceStride), GL_DYNAMIC_DRAW);
+                        pickRecords->Update(instances, (GLsizeiptr)(city.buildingCount() * instanceStride), (GLintptr)(groundCapacity * instanceStride));
+                        pickRecords->Label("pick records");
+                    }
+                    if (terrainMap)
+                        pickRecords->Update(terrainMap->records.data(), (GLsizeiptr)(terrainMap->records.size() * sizeof(GLfloat)));
+                    else
+                        pickRecords->Update(groundInstance, (GLsizeiptr)instanceStride);
+                    glUniform1i(firstIdLoc, 0);
+                    glUniform1i(idTrianglesLoc, 0);
+                    auto drawRecords = [&](const DrawCommandBuilder::Mesh& mesh, size_t first, size_t count) {
+                        if (count == 0)
+                            return;
+                        linkInstances(pickRecords->ID, (GLintptr)(first * instanceStride));
+                        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, mesh.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(mesh.firstIndex), (GLsizei)count, mesh.baseVertex);
+                        GLState.CountDraw(count, count * (mesh.indexCount / 3));
+                    };
+                    if (terrainMap) {
+                        drawRecords(sceneHeap.mesh(patchMesh), 0, terrainMap->wholePatches);
+                        drawRecords(sceneHeap.mesh(quarterMesh), terrainMap->wholePatches, terrainMap->quarterPatches);
+                    }
+                    else {
+                        drawRecords(sceneHeap.mesh(groundMesh), 0, 1);
+                    }
+                    glUniform1i(firstIdLoc, 1);
+                    linkInstances(pickRecords->ID, (GLintptr)(groundCapacity * instanceStride));
+                    drawUnits((GLsizei)city.buildingCount());
+                    GLState.CountUniforms(4);
+                }
+                else {
+                    // The merged city is numbered by its triangles, every building has the same number behind the ground's
+                    const DrawCommandBuilder::Mesh& cityRange = sceneHeap.mesh(cityMesh);
+                    glUniform1i(firstIdLoc, 1);
+                    glUniform1i(idTrianglesLoc, CityGenerator::BUILDING_INDICES / 3);
+                    glUniform1i(glGetUniformLocation(pickProgram, "skipTriangles"), CityGenerator::GROUND_INDICES / 3);
+                    glDrawElementsBaseVertex(GL_TRIANGLES, cityRange.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(cityRange.firstIndex), cityRange.baseVertex);
+                    GLState.CountDraw(1, cityRange.indexCount / 3);
+                    GLState.CountUniforms(4);
+                }
+                picker->End();
+                frameUBO.Update(&frameData, sizeof(FrameData));
+                profiler.End(pickZone);
+            }
+            if (stereo)
+                GLState.Disable(GL_CLIP_DISTANCE0);
+            // Copies a forward frame's color into the window
+            if (reverseDepth)
+                reverseDepth->End();
+
+            // Lights every pixel of the G-buffer once into the window
+            bool occludedFrame = frameGraph.live(ssaoPass);
+            if (frameGraph.Run(ssaoPass)) {
+                size_t ssaoZone = profiler.Begin("ssao");
+                const GLuint occlusionTextures[2] = { frameGraph.texture(occlusionResource), frameGraph.texture(occlusionBlurResource) };
+                const GLuint occlusionFramebuffers[2] = { frameGraph.framebuffer(occlusionResource), frameGraph.framebuffer(occlusionBlurResource) };
+                if (occlusionHistory)
+                    occlusionHistory->Begin(ScreenSpaceOcclusion::HalfSize(sceneWidth), ScreenSpaceOcclusion::HalfSize(sceneHeight), projection, view * model);
+                screenOcclusion->Compute(*deferredRenderer, projection, occlusionTextures, occlusionFramebuffers, ScreenSpaceOcclusion::HalfSize(sceneWidth), ScreenSpaceOcclusion::HalfSize(sceneHeight),
+                    occlusionHistory.get());
+                profiler.End(ssaoZone);
+            }
+            if (frameGraph.Run(resolvePass)) {
+                size_t resolveZone = profiler.Begin("deferred resolve");
+                deferredRenderer->Resolve(projection, clusteredLights.get(), occludedFrame ? screenOcclusion.get() : nullptr, lightShadows.get(),
+                    decalLibrary.get());
+                profiler.End(resolveZone);
+            }
+            if (frameGraph.Run(antiAliasingPass)) {
+                size_t antiAliasingZone = profiler.Begin(antiAliasing->name());
+                antiAliasing->End();
+                profiler.End(antiAliasingZone);
+            }
+            if (frameGraph.Run(bloomPass)) {
+                size_t bloomZone = profiler.Begin("bloom");
+                postProcess->Bloom();
+                profiler.End(bloomZone);
+            }
+            if (frameGraph.Run(postPass)) {
+                if (volumetricFog) {
+                    size_t fogZone = profiler.Begin("volumetric fog");
+                    volumetricFog->Update(view * model, projection, sunDirection, glm::vec3(frameData.sunColor),
+                        frame.lightOn ? clusteredLights.get() : nullptr, frame.lightOn ? shadows.get() : nullptr);
+                    profiler.End(fogZone);
+                }
+                size_t postZone = profiler.Begin("post effects");
+                postProcess->End(projection, deferredFrame ? deferredRenderer->depth : 0, volumetricFog.get());
+                profiler.End(postZone);
+            }
+            if (frameGraph.Run(upscalePass)) {
+                size_t upscaleZone = profiler.Begin("upscale");
+                dynamicResolution->End();
+                profiler.End(upscaleZone);
+            }
+
+            // Exported views are read back before the overlay, later frames go on while the copy is in flight
+            if (readback) {
+                size_t readbackZone = profiler.Begin("readback");
+                if (frame.image >= 0) {
+                    std::string name = imageName((size_t)frame.image) + "." + viewFormat;
+                    readback->Read(viewTarget->framebuffer, viewTarget->width, viewTarget->height, (std::filesystem::path(viewsOutput) / name).string());
+                }
+                readback->Poll();
+                profiler.End(readbackZone);
+            }
+            // The video gets the frame as shown, without the overlay, the encoder's own time goes with it
+            if (video) {
+                size_t videoZone = profiler.Begin("video capture");
+                if (offscreen)
+                    video->Capture(viewTarget->framebuffer, viewTarget->width, viewTarget->height);
+                else
+                    video->Capture(0, frame.framebufferWidth, frame.framebufferHeight);
+                video->Poll();
+                profiler.End(videoZone);
+                profiler.Record("encode", video->encodeMilliseconds());
+            }
+
+            if (frame.showProfiler) {
+                profiler.DrawOverlay(frame.framebufferWidth, frame.framebufferHeight);
+                GLDebug.DrawOverlay(frame.framebufferWidth, frame.framebufferHeight);
+                GpuMemory.DrawOverlay(frame.framebufferWidth, frame.framebufferHeight);
+            }
+            // A screenshot is the back buffer as shown, overlay included, copied into a pixel buffer that is mapped once
+            // its fence passed a frame or two later and encoded by a job, so the frame waits on neither
+            if (screenshots) {
+                if (frame.screenshot) {
+                    char name[32];
+                    snprintf(name, sizeof(name), "screenshot_%06d.png", frame.frameIndex);
+                    screenshots->Read(0, frame.framebufferWidth, frame.framebufferHeight, name);
+                    Log.Write(LOG_INFO, "Saving %s", name);
+                }
+                screenshots->Poll();
+            }
+            // Averages go to the window title once a second, the simulation thread sets it since GLFW only allows that there
+            if (frame.time - lastTitleUpdate >= 1.0) {
+                AllocationCounter::Allowed formatting;
+                std::lock_guard<std::mutex> lock(titleMutex);
+                windowTitle = "OpenGL 3D Surface with Buildings - " + profiler.Summary() + " | " + GLState.Summary() + " | " + GpuMemory.Summary();
+                std::string debugSummary = GLDebug.Summary();
+                if (!debugSummary.empty())
+                    windowTitle += " | " + debugSummary;
+                if (dynamicResolution)
+                    windowTitle += " | " + std::to_string((int)std::lround(dynamicResolution->scale() * 100.0f)) + "% resolution";
+                lastTitleUpdate = frame.time;
+            }
+
+            // The frame's commands are all recorded, its fence follows them
+            frameScheduler.EndFrame();
+
+            // Holds the frame until it is due, then swaps buffers, the events are polled by the simulation thread
+            size_t paceZone = profiler.Begin("pacing", false);
+            pacer.Wait();
+            profiler.End(paceZone);
+            // Offscreen frames are never shown, so there is nothing to swap
+            size_t swapZone = profiler.Begin("swap");
+            if (!offscreen)
+                glfwSwapBuffers(window);
+            profiler.End(swapZone);
+            profiler.Record("input to present", pacer.Presented(frame.inputTime));
+            if (frame.frameIndex == 0) {
+                startup.FirstFrame();
+                startup.Print();
+            }
+
+            renderPending = textureLoader.pending() > 0 || (textureStreamer && !textureStreamer->settled()) || (virtualTexture && !virtualTexture->settled())
+                || (impostors && !impostorsBaked) || (tiles && tiles->pending() > 0);
+            // The packet can be filled again once its frame is submitted
+            frameQueue.Release();
+        }
+        releaseContext();
+    });
+
+    // The camera moves in fixed steps, frames show it between the states before and after the last step
+    SimulationClock clock(simulationStep);
+    if (benchmark) {
+        CameraPath::Keyframe pose = cameraPath.Sample(0.0f);
+        camera.SetPose(pose.position, pose.yaw, pose.pitch);
+    }
+    Camera previousCamera = camera;
+    // The camera the frames show, it only recomputes its matrices on frames where it moved
+    Camera drawnCamera = camera;
+    // Stereo frames cull from a camera moved back until its frustum holds both eyes'
+    const float stereoBack = stereo ? 0.5f * stereoSeparation / (std::tan(glm::radians(22.5f)) * eyeAspect) : 0.0f;
+    // Keys and mouse motion arrive by callbacks while events are polled, every step takes one snapshot of them
+    Input input(window);
+    double lastFrame = 0.0; // Time of last frame
+    int frameIndex = 0;
+    // Buildings and cars the CPU dropped for their projected size over every frame
+    size_t smallBuildings = 0;
+    size_t smallVehicles = 0;
+    // Image of a batch export the next frame shows, a view or a tile of a view's poster
+    size_t nextView = 0;
+    const size_t imageCount = views.keyframes.size() * viewImages;
+    // Cursor of a right click the next frame picks under, in window coordinates
+    bool clickPending = false;
+    glm::vec2 clickCursor(0.0f);
+    // Set by F12 until the next frame carries it to the render thread
+    bool screenshotPending = false;
+    // A process of a render farm renders a view only if it was the first to create its claim, the creation of a
+    // directory either succeeds for exactly one process or finds it already there
+    auto claim = [&](const std::string& name) {
+        if (!claimViews)
+            return true;
+        std::error_code error;
+        return std::filesystem::create_directory(std::filesystem::path(viewsOutput) / "claims" / name, error);
+    };
+    auto claimView = [&](size_t index) {
+        return claim(imageName(index));
+    };
+
+    // Edits of a collaborative session, this machine's queued by the steps and both theirs and the peers' applied
+    // before culling, and the buildings removed here, which Insert brings back last first
+    std::vector<SceneSync::Edit> localEdits, syncEdits;
+    std::vector<SceneSync::Edit> removedBuildings;
+    auto boundsOf = [&](uint32_t b, glm::vec3& min, glm::vec3& max) {
+        min = glm::vec3(buildingBounds.minX[b], buildingBounds.minY[b], buildingBounds.minZ[b]);
+        max = glm::vec3(buildingBounds.maxX[b], buildingBounds.maxY[b], buildingBounds.maxZ[b]);
+    };
+    // Set by applyEdit when an edit moved or resized a box, so the bounding volume hierarchy is only refit then
+    bool editedBounds = false;
+    // Applies an edit to the scene storage and the quadtree and completes it with every field the building has now,
+    // false for a building the city does not have
+    auto applyEdit = [&](SceneSync::Edit& edit) {
+        if (edit.building >= city.buildingCount())
+            return false;
+        uint32_t b = edit.building;
+        glm::vec3 min, max;
+        boundsOf(b, min, max);
+        glm::vec3 oldMin = min, oldMax = max;
+        if (edit.operation == SceneSync::REMOVE) {
+            // The slot keeps a box of no size on the middle of the footprint, which nothing ever draws or hits
+            min = max = glm::vec3(0.5f * (min.x + max.x), min.y, 0.5f * (min.z + max.z));
+            buildingTree.Remove(b);
+        }
+        else {
+            if (edit.fields & SceneSync::MIN)
+                min = edit.min;
+            if (edit.fields & SceneSync::MAX)
+                max = glm::max(edit.max, min);
+            if (edit.fields & SceneSync::FACADE)
+                buildings.material[b] = edit.facade;
+            buildingTree.Insert(b, min, max);
+            cityTop = std::max(cityTop, max.y);
+        }
+        if (min != oldMin || max != oldMax)
+            editedBounds = true;
+        buildings.SetBounds(b, min, max);
+        edit.fields = SceneSync::ALL_FIELDS;
+        edit.min = min;
+        edit.max = max;
+        edit.facade = buildings.material[b];
+        return true;
+    };
+
+    // The city turns about its center, the streamed world stays put, it is flown over rather than turned, and an on
+    // demand run keeps the city still too, it would never be idle otherwise
+    auto cityModel = [&](double time) {
+        if (tiles || onDemand)
+            return glm::mat4(1.0f);
+        return glm::rotate(glm::mat4(1.0f), (float)std::fmod(time * glm::radians(50.0), 2.0 * glm::pi<double>()), glm::vec3(0.0f, 1.0f, 0.0f));
+    };
+    // Moves the camera's sphere from one point to another in the city's model space, up to the first building in the
+    // way and then along its wall for the rest of the motion, a corner takes a second and third wall
+    // A cast that starts inside a building does not hit it, so a camera the turning city swept into can leave again
+    const float cameraRadius = 0.2f;
+    auto slideCamera = [&](glm::vec3 from, glm::vec3 to) {
+        for (int wall = 0; wall < 3; wall++) {
+            glm::vec3 motion = to - from;
+            float length = glm::length(motion);
+            if (length < 1e-6f)
+                return from;
+            Quadtree::Hit hit;
+            if (!buildingTree.SphereCast(from, motion / length, cameraRadius, length, hit))
+                return to;
+            // Stops a little short so the next cast starts outside the wall
+            from += motion * (std::max(0.0f, hit.distance - 1e-3f) / length);
+            to -= hit.normal * glm::dot(to - from, hit.normal);
+        }
+        return from;
+    };
+
+    // Allocations of the simulation thread before the first measured frame
+    uint64_t simulationAllocationsBefore = 0;
+    // Framebuffer size of the last frame and the frames drawn since anything changed, for the on demand checks
+    int drawnWidth = 0;
+    int drawnHeight = 0;
+    int quietFrames = 0;
+    // Whether a replayed frame took other steps than recorded, which is reported once
+    bool replayDiverged = false;
+    // Main loop, window events are still handled while every packet is waiting to be rendered
+    while (true) {
+        FramePacket* packet = frameQueue.Acquire();
+        if (!packet) {
+            if (window)
+                glfwWaitEventsTimeout(0.001);
+            else
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        // A minimized window is not drawn at all, and on demand neither is a frame that would show the same as the last
+        // Idle time is dropped from the clock, so a key pressed after a while moves the camera a step and not the whole pause
+        // A replay draws every frame of its log, the sizes and steps come from there
+        if (window && !offscreen && !benchmark && !replay) {
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            bool minimized = glfwGetWindowAttrib(window, GLFW_ICONIFIED) || width == 0 || height == 0;
+            if (onDemand && !minimized) {
+                if (!input.Idle() || width != drawnWidth || height != drawnHeight || traffic || renderPending || clickPending || (sunMoves && timeOfDay.hoursPerSecond != 0.0f)
+                    || (liveData && liveData->pending() > 0) || (sync && sync->pending()) || glfwWindowShouldClose(window))
+                    quietFrames = 0;
+                drawnWidth = width;
+                drawnHeight = height;
+            }
+            if ((minimized || (onDemand && quietFrames >= ON_DEMAND_SETTLE_FRAMES)) && !glfwWindowShouldClose(window)) {
+                glfwWaitEventsTimeout(ON_DEMAND_POLL);
+                clock.Skip(glfwGetTime());
+                continue;
+            }
+            quietFrames++;
+        }
+        FramePacket& frame = *packet;
+        frame.frameIndex = frameIndex;
+        if (benchmark && frameIndex == benchmarkWarmup)
+            simulationAllocationsBefore = AllocationCounter::Thread();
+        // Views are claimed only once the assets are complete, until then frames show whichever view is next
+        bool ready = assetsReady;
+        if (exportViews && ready) {
+            while (nextView < imageCount && !claimView(nextView))
+                nextView++;
+        }
+        frame.quit = (window && glfwWindowShouldClose(window)) || (benchmark && frameIndex >= benchmarkWarmup + benchmarkFrames)
+            || (exportViews && nextView >= imageCount) || (replay && (size_t)frameIndex >= sessionLog.frameCount());
+        if (frame.quit) {
+            if (benchmark)
+                steadyAllocations += AllocationCounter::Thread() - simulationAllocationsBefore;
+            frameQueue.Publish();
+            break;
+        }
+
+        // Benchmarks take one step per frame so every run renders the same frames, exports take none and show their views as given
+        // A replay advances to the time the recorded clock had after each frame, which gives the same steps and blend
+        const SessionLog::Frame* logged = replay ? &sessionLog.frame((size_t)frameIndex) : nullptr;
+        double now = logged ? logged->time : benchmark || !window ? frameIndex * simulationStep : glfwGetTime();
+        unsigned int steps = exportViews ? 0 : clock.Advance(now);
+        if (logged && steps != logged->stepCount && !replayDiverged) {
+            std::cerr << "Warning: frame " << frameIndex << " of the replay took " << steps << " steps where the recording took "
+                      << logged->stepCount << ", input is applied up to the recorded steps" << std::endl;
+            replayDiverged = true;
+        }
+        frameIndex++;
+
+        // Input, the first step of a frame gets the mouse motion and key presses since the last one
+        frame.inputTime = FramePacer::Clock::now();
+            for (unsigned int step = 0; step < steps; step++) {
+            // Replayed steps past those recorded for the frame get no input
+            Input::Snapshot tick = !logged ? input.Take() : step < logged->stepCount ? sessionLog.snapshot(logged->firstStep + step) : Input::Snapshot();
+            sessionLog.RecordStep(tick);
+            if (tick.Down(GLFW_KEY_ESCAPE)) {
+                glfwSetWindowShouldClose(window, true);
+            }
+
+            // Camera controls
+            previousCamera = camera;
+            if (benchmark) {
+                CameraPath::Keyframe pose = cameraPath.Sample((float)(clock.stepCount() - steps + step + 1) * (float)simulationStep);
+                camera.SetPose(pose.position, pose.yaw, pose.pitch);
+            }
+            camera.Inputs(tick, (float)simulationStep);
+            if (traffic)
+                traffic->Step(jobs, (float)simulationStep);
+            // The motion of the step is swept against the buildings where the city stands at its end
+            if (collision && !benchmark && !tiles && camera.position() != previousCamera.position()) {
+                glm::mat4 stepModel = cityModel((double)(clock.stepCount() - steps + step + 1) * simulationStep);
+                glm::mat4 toModel = glm::inverse(stepModel);
+                glm::vec3 from = glm::vec3(toModel * glm::vec4(previousCamera.position(), 1.0f));
+                glm::vec3 to = glm::vec3(toModel * glm::vec4(camera.position(), 1.0f));
+                camera.SetPose(glm::vec3(stepModel * glm::vec4(slideCamera(from, to), 1.0f)), camera.yaw(), camera.pitch());
+            }
+
+            // Toggle light
+            if (tick.Pressed(GLFW_KEY_L))
+                lightOn = !lightOn;
+            // Toggle the profiler overlay
+            if (tick.Pressed(GLFW_KEY_P))
+                showProfiler = !showProfiler;
+            // Switch between forward and deferred shading
+            if (tick.Pressed(GLFW_KEY_G))
+                deferred = !deferred;
+            // Toggle screen space ambient occlusion
+            if (tick.Pressed(GLFW_KEY_O))
+                ssao = !ssao;
+            // Save the next frame drawn as a screenshot
+            if (tick.Pressed(GLFW_KEY_F12))
+                screenshotPending = true;
+            // Edit the picked building for everyone in the session, heights change by a tenth
+            uint32_t selected = selectedBuilding.load();
+            if (sync && selected != SceneStorage::INVALID) {
+                SceneSync::Edit edit;
+                edit.building = selected;
+                glm::vec3 min, max;
+                boundsOf(selected, min, max);
+                bool removed = !buildingTree.Contains(selected);
+                if (tick.Pressed(GLFW_KEY_DELETE) && !removed) {
+                    SceneSync::Edit restore;
+                    restore.operation = SceneSync::ADD;
+                    restore.building = selected;
+                    restore.min = min;
+                    restore.max = max;
+                    restore.facade = buildings.material[selected];
+                    removedBuildings.push_back(restore);
+                    edit.operation = SceneSync::REMOVE;
+                    localEdits.push_back(edit);
+                }
+                if ((tick.Pressed(GLFW_KEY_PAGE_UP) || tick.Pressed(GLFW_KEY_PAGE_DOWN)) && !removed) {
+                    edit.fields = SceneSync::MAX;
+                    edit.max = max;
+                    edit.max.y += (tick.Pressed(GLFW_KEY_PAGE_UP) ? 0.1f : -0.1f) * (max.y - min.y);
+                    localEdits.push_back(edit);
+                }
+            }
+            if (sync && tick.Pressed(GLFW_KEY_INSERT) && !removedBuildings.empty()) {
+                localEdits.push_back(removedBuildings.back());
+                removedBuildings.pop_back();
+            }
+            // Pick the building under the cursor
+            if (tick.Clicked(GLFW_MOUSE_BUTTON_RIGHT) && !stereo) {
+                clickPending = true;
+                clickCursor = tick.cursor;
+            }
+        }
+        frame.screenshot = screenshotPending && !offscreen;
+        screenshotPending = false;
+        // Frames are rendered at the first view until the assets are complete, then each view is written once
+        frame.image = -1;
+        double viewTime = 0.0;
+        if (exportViews) {
+            const CameraPath::Keyframe& pose = views.keyframes[nextView / viewImages];
+            camera.SetPose(pose.position, pose.yaw, pose.pitch);
+            previousCamera = camera;
+            viewTime = pose.time;
+            // The culling below and the frame both go by the tile's part of the projection
+            if (poster)
+                drawnCamera.SetSubFrustum(poster->Bounds((int)(nextView % viewImages)));
+            if (ready)
+                frame.image = (int)nextView++;
+        }
+        // The frame shows the camera where it is at the clock's time
+        float alpha = clock.alpha();
+        drawnCamera.SetPose(glm::mix(previousCamera.precisePosition(), camera.precisePosition(), (double)alpha),
+                            glm::mix(previousCamera.yaw(), camera.yaw(), alpha), glm::mix(previousCamera.pitch(), camera.pitch(), alpha));
+        double currentFrame = exportViews ? viewTime : clock.time();
+        float deltaTime = (float)(currentFrame - lastFrame);
+        lastFrame = currentFrame;
+
+        frame.time = currentFrame;
+        frame.deltaTime = deltaTime;
+        if (offscreen) {
+            frame.framebufferWidth = viewWidth;
+            frame.framebufferHeight = viewHeight;
+        }
+        else if (logged) {
+            frame.framebufferWidth = logged->framebufferWidth;
+            frame.framebufferHeight = logged->framebufferHeight;
+        }
+        else {
+            glfwGetFramebufferSize(window, &frame.framebufferWidth, &frame.framebufferHeight);
+        }
+        // The window size only matters for picks, a recording keeps it for every frame
+        int windowWidth = 0, windowHeight = 0;
+        if (logged) {
+            windowWidth = logged->windowWidth;
+            windowHeight = logged->windowHeight;
+        }
+        else if (window && (clickPending || sessionLog.recording()))
+            glfwGetWindowSize(window, &windowWidth, &windowHeight);
+        sessionLog.RecordFrame(clock.time(), frame.framebufferWidth, frame.framebufferHeight, windowWidth, windowHeight);
+        // Picks count pixels from the bottom left of the framebuffer, whose pixels may be smaller than the window's
+        frame.pick = glm::ivec2(-1);
+        if (pickPixel.x >= 0 && frame.frameIndex == 0) {
+            frame.pick = glm::ivec2(pickPixel.x, frame.framebufferHeight - 1 - pickPixel.y);
+        }
+        else if (clickPending) {
+            glm::vec2 scale((float)frame.framebufferWidth / std::max(windowWidth, 1), (float)frame.framebufferHeight / std::max(windowHeight, 1));
+            frame.pick = glm::ivec2(clickCursor * scale);
+            frame.pick.y = frame.framebufferHeight - 1 - frame.pick.y;
+            clickPending = false;
+        }
+        if (frame.pick.x >= frame.framebufferWidth || frame.pick.y < 0 || frame.pick.y >= frame.framebufferHeight)
+            frame.pick = glm::ivec2(-1);
+        frame.position = drawnCamera.position();
+        frame.front = drawnCamera.front();
+        // Tiles are placed around the camera in double on the render thread, so their view leaves the position out
+        frame.view = tiles ? drawnCamera.relativeView() : drawnCamera.view();
+        frame.projection = drawnCamera.projection();
+        frame.origin = tiles ? drawnCamera.precisePosition() : glm::dvec3(0.0);
+        frame.lightOn = lightOn;
+        frame.deferred = deferred;
+        frame.ssao = ssao;
+        frame.showProfiler = showProfiler;
+        frame.model = cityModel(currentFrame);
+        if (overview)
+            overview->Follow(glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f)), glm::mat3(glm::inverse(frame.model)) * frame.front);
+        // The sort keys use the program the render thread will pick
+        bool deferredFrame = deferred && lightOn && deferredRenderer;
+        unsigned int programSlot = !lightOn ? 0 : deferredFrame ? 3 : clusteredLights ? 2 : 1;
+        // Only the forward lit programs draw the fog, the other frames keep the far plane
+        frame.fogDistance = fogDensity > 0.0f && programSlot != 0 && !deferredFrame ? fogCutoff(frame.position.y) : 0.0f;
+        // The fog's cutoff stands in for the far plane, taken in model space like the frustum's
+        auto limitFog = [&](Frustum& frustum) {
+            if (frame.fogDistance <= 0.0f)
+                return;
+            glm::mat4 toModel = glm::inverse(frame.model);
+            frustum.LimitDistance(glm::vec3(toModel * glm::vec4(frame.position, 1.0f)), glm::normalize(glm::mat3(toModel) * frame.front), frame.fogDistance);
+        };
+
+        // Finds the buildings inside the view frustum, the planes are taken in model space so the bounds never change
+        std::chrono::steady_clock::time_point cullStart = std::chrono::steady_clock::now();
+        // The lists come from the packet's arena with room for everything, whatever culling does not fill lists all of it
+        frame.arena.Reset();
+        uint32_t* visibleBuildings = (uint32_t*)frame.arena.Allocate(city.buildingCount() * sizeof(uint32_t), alignof(uint32_t));
+        uint32_t* visibleBatches = (uint32_t*)frame.arena.Allocate(staticBatches.size() * sizeof(uint32_t), alignof(uint32_t));
+        frame.visibleBuildings = visibleBuildings;
+        // The peers' edits and this machine's go into the storage and the quadtree before culling reads them, and into
+        // the arena for the render thread, which uploads only the records they touched
+        frame.edits = nullptr;
+        frame.editCount = 0;
+        if (sync) {
+            sync->Drain(syncEdits);
+            for (const SceneSync::Edit& edit : localEdits)
+                sync->Send(edit);
+            syncEdits.insert(syncEdits.end(), localEdits.begin(), localEdits.end());
+            localEdits.clear();
+            sync->Flush();
+            if (!syncEdits.empty()) {
+                SceneSync::Edit* edits = (SceneSync::Edit*)frame.arena.Allocate(syncEdits.size() * sizeof(SceneSync::Edit), alignof(SceneSync::Edit));
+                editedBounds = false;
+                for (SceneSync::Edit& edit : syncEdits)
+                    if (applyEdit(edit))
+                        edits[frame.editCount++] = edit;
+                frame.edits = edits;
+                // A big batch of edits, such as a peer loading a district, leaves loose bounds all over the quadtree,
+                // which is built again on the workers. The hierarchy has no edits of its own, a big batch that moved
+                // boxes builds it again too and a smaller one refits its nodes around the boxes where they are now
+                bool bigBatch = frame.editCount > city.buildingCount() / 16;
+                if (bigBatch)
+                    buildingTree.Build(jobs);
+                if (buildingHierarchy && editedBounds) {
+                    if (bigBatch)
+                        buildingHierarchy->Build(buildingBounds, jobs);
+                    else
+                        buildingHierarchy->Refit(buildingBounds);
+                }
+            }
+        }
+        // The cars where the clock shows them, written on the workers into the arena in the layout the shader reads
+        if (traffic) {
+            size_t vehicles = traffic->vehicleCount();
+            CompactInstance* nearVehicles = (CompactInstance*)frame.arena.Allocate(vehicles * sizeof(CompactInstance), alignof(CompactInstance));
+            CompactInstance* farVehicles = (CompactInstance*)frame.arena.Allocate(vehicles * sizeof(CompactInstance), alignof(CompactInstance));
+            frame.vehicleSliceCount = traffic->sliceCount(jobs);
+            TrafficSimulation::Slice* vehicleSlices = (TrafficSimulation::Slice*)frame.arena.Allocate(frame.vehicleSliceCount * sizeof(TrafficSimulation::Slice), alignof(TrafficSimulation::Slice));
+            traffic->DropBelow(vehicleCullPixels, drawnCamera.projection(), (float)frame.framebufferHeight);
+            traffic->Write(jobs, alpha, glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f)), nearVehicles, farVehicles, vehicleSlices);
+            for (size_t slice = 0; slice < frame.vehicleSliceCount; slice++)
+                smallVehicles += vehicleSlices[slice].droppedCount;
+            frame.nearVehicles = nearVehicles;
+            frame.farVehicles = farVehicles;
+            frame.vehicleSlices = vehicleSlices;
+        }
+        if ((!culling || batching) && !gpuCulling)
+            std::iota(visibleBuildings, visibleBuildings + city.buildingCount(), 0u);
+        if (!culling || !batching)
+            std::iota(visibleBatches, visibleBatches + staticBatches.size(), 0u);
+        // The GPU culler picks the buildings itself, the CPU lists none of them
+        size_t visibleCount = gpuCulling ? 0 : city.buildingCount();
+        size_t visibleBatchCount = staticBatches.size();
+        if (culling && batching) {
+            Frustum frustum;
+            frustum.Extract(drawnCamera.viewProjection() * frame.model);
+            limitFog(frustum);
+            visibleBatchCount = 0;
+            for (uint32_t b = 0; b < staticBatches.size(); b++)
+                if (frustum.TestBox(staticBatches[b].min, staticBatches[b].max))
+                    visibleBatches[visibleBatchCount++] = b;
+        }
+        else if (culling && !gpuCulling) {
+            Frustum frustum;
+            frustum.Extract((stereo ? drawnCamera.projection() * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -stereoBack)) * drawnCamera.view()
+                : drawnCamera.viewProjection()) * frame.model);
+            limitFog(frustum);
+            size_t cullSlices = jobs.Slices(city.buildingCount(), JOB_GRAIN);
+            // A street level camera only tests the buildings its cell can see at all
+            const std::vector<uint32_t>* potentiallyVisible = visibilitySets ? visibilitySets->Lookup(glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f))) : nullptr;
+            if (potentiallyVisible) {
+                visibleCount = 0;
+                for (uint32_t b : *potentiallyVisible)
+                    if (frustum.TestBox(glm::vec3(buildingBounds.minX[b], buildingBounds.minY[b], buildingBounds.minZ[b]), glm::vec3(buildingBounds.maxX[b], buildingBounds.maxY[b], buildingBounds.maxZ[b])))
+                        visibleBuildings[visibleCount++] = b;
+            }
+            else if (horizonCulling) {
+                // Nodes behind the hills are dropped with everything below them before a single building is tested
+                terrainMap->BuildHorizon(glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f)));
+                visibleCount = buildingTree.QueryFrustum(frustum, visibleBuildings, [&](const glm::vec3& min, const glm::vec3& max) {
+                    return terrainMap->BehindHorizon(min, max);
+                });
+            }
+            else if (buildingHierarchy)
+                visibleCount = buildingHierarchy->QueryFrustum(frustum, visibleBuildings);
+            else if (cullSlices > 1) {
+                // Big cities are tested in slices by the workers, each keeps its buildings at the start of its own range
+                jobs.ParallelFor(city.buildingCount(), JOB_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+                    cullCounts[slice] = frustum.Cull(buildingBounds, begin, end - begin, visibleBuildings + begin);
+                });
+                visibleCount = 0;
+                for (size_t slice = 0; slice < cullSlices; slice++) {
+                    const uint32_t* kept = visibleBuildings + JobSystem::SliceStart(city.buildingCount(), cullSlices, slice);
+                    std::memmove(visibleBuildings + visibleCount, kept, cullCounts[slice] * sizeof(uint32_t));
+                    visibleCount += cullCounts[slice];
+                }
+            }
+            else if (linearCulling)
+                visibleCount = frustum.Cull(buildingBounds, visibleBuildings);
+            else
+                visibleCount = buildingTree.QueryFrustum(frustum, visibleBuildings);
+            // Buildings covering fewer pixels than cullPixels are dropped before anything else looks at them. Where blocks
+            // fade to impostors a block is measured instead, its impostor stands in for its small buildings until it is
+            // too small itself, so the buildings of a block go together
+            if (levelOfDetail.cullPixels > 0.0f) {
+                LevelOfDetail featureSize;
+                featureSize.cullPixels = levelOfDetail.cullPixels;
+                featureSize.SetView(glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f)), drawnCamera.projection(), (float)frame.framebufferHeight);
+                bool byBlock = instanced && lod && blockInstances;
+                size_t kept = 0;
+                for (size_t i = 0; i < visibleCount; i++) {
+                    uint32_t b = visibleBuildings[i];
+                    float size;
+                    if (byBlock) {
+                        const GLfloat* box = &blockInstances[(b / city.lotsPerBlock()) * CityGenerator::INSTANCE_FLOATS];
+                        size = featureSize.ProjectedSize(glm::vec3(box[0], box[1], box[2]), glm::vec3(box[0] + box[3], box[1] + box[4], box[2] + box[5]));
+                    }
+                    else
+                        size = featureSize.ProjectedSize(glm::vec3(buildingBounds.minX[b], buildingBounds.minY[b], buildingBounds.minZ[b]), glm::vec3(buildingBounds.maxX[b], buildingBounds.maxY[b], buildingBounds.maxZ[b]));
+                    if (!featureSize.TooSmall(size))
+                        visibleBuildings[kept++] = b;
+                }
+                smallBuildings += visibleCount - kept;
+                visibleCount = kept;
+            }
+            // The nearest survivors are drawn as occluders and every survivor is tested against them in the same frame
+            if (softwareOccluder) {
+                glm::vec3 modelEye = glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f));
+                softwareOccluder->Render(jobs, drawnCamera.viewProjection() * frame.model, modelEye, buildingBounds, visibleBuildings, visibleCount);
+                visibleCount = softwareOccluder->Cull(jobs, buildingBounds, visibleBuildings, visibleCount);
+            }
+        }
+        frame.visibleCount = visibleCount;
+        // The labels a worker placed for an earlier frame, put where this frame sees them
+        frame.labelCount = 0;
+        if (labelLayout) {
+            glm::mat4 labelMatrix = drawnCamera.viewProjection() * frame.model;
+            glm::vec3 modelEye = glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f));
+            labelLayout->Start(labelMatrix, modelEye, frame.framebufferWidth, frame.framebufferHeight, buildingBounds, visibleBuildings, visibleCount);
+            LabelLayout::Label* labels = (LabelLayout::Label*)frame.arena.Allocate(labelLayout->maxLabels * sizeof(LabelLayout::Label), alignof(LabelLayout::Label));
+            frame.labels = labels;
+            frame.labelCount = labelLayout->Project(labelMatrix, frame.framebufferWidth, frame.framebufferHeight, buildingBounds, labels);
+        }
+        // The texture streamer needs the facades as fine as the nearest building drawn, any building when the GPU culls
+        if (textureStreamer) {
+            glm::vec3 modelEye = glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f));
+            size_t candidates = visibleCount > 0 ? visibleCount : city.buildingCount();
+            float nearest = std::numeric_limits<float>::max();
+            for (size_t i = 0; i < candidates; i++) {
+                uint32_t b = visibleCount > 0 ? visibleBuildings[i] : (uint32_t)i;
+                glm::vec3 min(buildingBounds.minX[b], buildingBounds.minY[b], buildingBounds.minZ[b]);
+                glm::vec3 max(buildingBounds.maxX[b], buildingBounds.maxY[b], buildingBounds.maxZ[b]);
+                nearest = std::min(nearest, RenderQueue::BoxDepth(modelEye, min, max));
+            }
+            frame.nearestBuilding = nearest;
+        }
+        // Flags the buildings that passed, all of them do when culling is off or goes by batches and none when the GPU culls
+        std::fill(buildings.visible.begin(), buildings.visible.end(), (uint8_t)(visibleCount == city.buildingCount()));
+        if (visibleCount < city.buildingCount())
+            for (size_t i = 0; i < visibleCount; i++)
+                buildings.visible[visibleBuildings[i]] = 1;
+        std::chrono::steady_clock::time_point sortStart = std::chrono::steady_clock::now();
+        frame.cullMilliseconds = std::chrono::duration<float, std::milli>(sortStart - cullStart).count();
+        Tracer.Add("cull", "zone", cullStart, sortStart);
+
+        // What survived culling goes through the render queue, batches grouped by facade and everything front to back
+        // within the same state, so early depth testing rejects most of what is hidden behind the first buildings drawn
+        // The merged paths keep the queue's order in the records and ranges they pack below, tiles keep their own
+        if (drawSort && !tiles) {
+            glm::vec3 modelEye = glm::vec3(glm::inverse(frame.model) * glm::vec4(frame.position, 1.0f));
+            renderQueue.Clear();
+            if (batching) {
+                for (size_t i = 0; i < visibleBatchCount; i++) {
+                    const StaticBatch& batch = staticBatches[visibleBatches[i]];
+                    float depth = RenderQueue::BoxDepth(modelEye, batch.min, batch.max);
+                    renderQueue.Add(RenderQueue::Key(RenderQueue::OPAQUE_PASS, programSlot, batch.facade, 0, depth), visibleBatches[i]);
+                }
+            }
+            else if (instanced || culling) {
+                for (size_t i = 0; i < visibleCount; i++) {
+                    uint32_t b = visibleBuildings[i];
+                    glm::vec3 min(buildingBounds.minX[b], buildingBounds.minY[b], buildingBounds.minZ[b]);
+                    glm::vec3 max(buildingBounds.maxX[b], buildingBounds.maxY[b], buildingBounds.maxZ[b]);
+                    renderQueue.Add(RenderQueue::Key(RenderQueue::OPAQUE_PASS, programSlot, 0, 0, RenderQueue::BoxDepth(modelEye, min, max)), b);
+                }
+            }
+            renderQueue.Sort();
+            uint32_t* order = batching ? visibleBatches : visibleBuildings;
+            for (size_t i = 0; i < renderQueue.size(); i++)
+                order[i] = renderQueue.items()[i].draw;
+        }
+        std::chrono::steady_clock::time_point sortEnd = std::chrono::steady_clock::now();
+        frame.sortMilliseconds = std::chrono::duration<float, std::milli>(sortEnd - sortStart).count();
+        Tracer.Add("sort", "zone", sortStart, sortEnd);
+
+        // The batches' draws are recorded in slices by the workers, the render thread only executes the lists in order
+        frame.batchCommands = nullptr;
+        frame.batchCommandListCount = 0;
+        if (batching && visibleBatchCount > 0) {
+            // Facade, box corner and box size, then the draw
+            const size_t commandsPerBatch = 4;
+            size_t recordSlices = jobs.Slices(visibleBatchCount, RECORD_GRAIN);
+            CommandList* lists = (CommandList*)frame.arena.Allocate(recordSlices * sizeof(CommandList), alignof(CommandList));
+            CommandList::Command* commands = (CommandList::Command*)frame.arena.Allocate(visibleBatchCount * commandsPerBatch * sizeof(CommandList::Command), alignof(CommandList::Command));
+            jobs.ParallelFor(visibleBatchCount, RECORD_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+                CommandList* list = &lists[slice];
+                list->Begin(commands + begin * commandsPerBatch, (end - begin) * commandsPerBatch);
+                for (size_t i = begin; i < end; i++) {
+                    const StaticBatch& batch = staticBatches[visibleBatches[i]];
+                    const DrawCommandBuilder::Mesh& range = sceneHeap.mesh(batch.mesh);
+                    GLfloat facade = (GLfloat)batch.facade;
+                    list->VertexAttrib(6, 1, &facade);
+                    list->VertexAttrib(4, 3, glm::value_ptr(batch.boxMin));
+                    list->VertexAttrib(5, 3, glm::value_ptr(batch.boxSize));
+                    list->DrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, sceneHeap.indexType, sceneHeap.indexOffset(range.firstIndex), range.baseVertex);
+                }
+            });
+            frame.batchCommands = lists;
+            frame.batchCommandListCount = recordSlices;
+            Tracer.Add("record", "zone", sortEnd, std::chrono::steady_clock::now());
+        }
+        frameQueue.Publish();
+
+        {
+            std::lock_guard<std::mutex> lock(titleMutex);
+            if (!windowTitle.empty()) {
+                if (window)
+                    glfwSetWindowTitle(window, windowTitle.c_str());
+                windowTitle.clear();
+            }
+        }
+        if (window)
+            glfwPollEvents();
+        if (overview)
+            overview->HideIfClosed();
+    }
+    renderThread.join();
+    if (hitchDetector && hitchDetector->hitches() > 0)
+        std::cout << "Hitches: " << hitchDetector->hitches() << " frames over " << hitchMs << " ms, " << hitchDetector->dumps()
+            << " written to " << hitchDirectory << std::endl;
+    if (metricsServer) {
+        std::cout << "Metrics: " << metricsServer->served() << " scrapes answered" << std::endl;
+        metricsServer.reset();
+    }
+    // Both threads are done writing into the log
+    if (sessionLog.recording())
+        std::cout << "Recorded " << frameIndex << " frames into " << recordSession << std::endl;
+    sessionLog.Close();
+    labelLayout.reset();
+    makeContextCurrent();
+    overview.reset();
+    overviewRecords.reset();
+    if (liveData) {
+        liveData->Delete();
+        std::cout << "Live data: " << liveData->received() << " updates received, " << liveData->dropped() << " dropped" << std::endl;
+    }
+    if (sync) {
+        sync->Delete();
+        std::cout << "Scene sync: " << sync->sent() << " edits sent, " << sync->received() << " received, " << sync->lost() << " datagrams lost" << std::endl;
+    }
+    if (virtualTexture)
+        std::cout << "Virtual texture: " << virtualTexture->uploaded() << " pages paged in, " << virtualTexture->evicted() << " evicted, "
+                  << virtualTexture->residentPages() << " of " << virtualTexture->cachePages() << " cache pages resident" << std::endl;
+    if (levelOfDetail.cullPixels > 0.0f || propCullPixels > 0.0f || vehicleCullPixels > 0.0f) {
+        size_t gpuBuildings = gpuCuller ? gpuCuller->droppedCount() : 0;
+        size_t gpuProps = propCuller ? propCuller->droppedCount() : 0;
+        std::cout << "Small features: " << smallBuildings + gpuBuildings << " buildings, " << gpuProps << " props and "
+                  << smallVehicles << " cars dropped for their projected size over " << frameIndex << " frames" << std::endl;
+    }
+
+    if (benchmark) {
+        BenchmarkReport report;
+        report.scene = benchmarkScene;
+        report.frames = benchmarkFrames;
+        startup.Report(report);
+        for (const BenchmarkReport::Path& path : renderPaths)
+            report.SetPath(path.subsystem, path.name);
+        // The zones of a frame follow each other, so their GPU times add up to the GPU time of the frame
+        double gpuFrame = 0.0;
+        for (size_t i = 0; i < profiler.zoneCount(); i++) {
+            gpuFrame += profiler.GpuStats(i).avg;
+            if (profiler.zoneName(i) != "frame")
+                continue;
+            Profiler::Stats stats = profiler.CpuStats(i);
+            std::cout << "Benchmark: " << stats.count << " frames, frame time min " << stats.min
+                      << " ms, avg " << stats.avg << " ms, p99 " << stats.p99 << " ms" << std::endl;
+            report.Set("cpu_frame_ms_min", stats.min);
+            report.Set("cpu_frame_ms_avg", stats.avg);
+            report.Set("cpu_frame_ms_p99", stats.p99);
+        }
+        GLuint64 primitives = 0;
+        if (countingPrimitives)
+            glGetQueryObjectui64v(primitivesQuery, GL_QUERY_RESULT, &primitives);
+        const GLStateCache::Counters& counts = GLState.total;
+        std::cout << "Benchmark: " << counts.issued / benchmarkFrames << " state changes per frame, "
+                  << counts.skipped / benchmarkFrames << " redundant ones skipped" << std::endl;
+        std::cout << "Benchmark: " << counts.draws / benchmarkFrames << " draw calls of " << counts.instances / benchmarkFrames << " instances and "
+                  << primitives / benchmarkFrames << " triangles per frame, GPU frame time " << gpuFrame << " ms" << std::endl;
+        std::cout << "Benchmark: " << counts.programBinds / benchmarkFrames << " program, " << counts.vertexArrayBinds / benchmarkFrames << " VAO, "
+                  << counts.textureBinds / benchmarkFrames << " texture and " << counts.bufferBinds / benchmarkFrames << " buffer binds, "
+                  << counts.uniforms / benchmarkFrames << " uniforms and " << counts.uploads / benchmarkFrames << " uploads of "
+                  << counts.uploadBytes / benchmarkFrames / 1024 << " KB per frame" << std::endl;
+        std::cout << "Benchmark: " << GpuMemory.Summary() << std::endl;
+        if (AllocationCounter::Enabled) {
+            std::cout << "Benchmark: " << steadyAllocations.load() << " heap allocations in the frame loops of the measured frames" << std::endl;
+            if (steadyAllocations.load() > 0)
+                std::cerr << "ERROR::ALLOCATION::STEADY_FRAMES_ALLOCATED" << std::endl;
+        }
+        // Shader work per pass, overdraw is the fragment shader invocations of the scene per framebuffer pixel
+        int pixelsWide = viewWidth, pixelsHigh = viewHeight;
+        if (!offscreen)
+            glfwGetFramebufferSize(window, &pixelsWide, &pixelsHigh);
+        for (size_t i = 0; i < profiler.zoneCount(); i++) {
+            Profiler::PipelineStats pipeline = profiler.PipelineStatistics(i);
+            // Zones that drew nothing, such as uploads and the swap, are left out
+            if (pipeline.count == 0 || (pipeline.vertices == 0.0 && pipeline.fragments == 0.0))
+                continue;
+            std::string name = profiler.zoneName(i);
+            std::replace(name.begin(), name.end(), ' ', '_');
+            double clipped = std::max(0.0, pipeline.clipperInput - pipeline.clipperOutput);
+            std::cout << "Benchmark: " << profiler.zoneName(i) << " " << (GLuint64)pipeline.vertices << " vertex and "
+                      << (GLuint64)pipeline.fragments << " fragment shader invocations, " << (GLuint64)clipped << " of "
+                      << (GLuint64)pipeline.clipperInput << " primitives clipped per frame" << std::endl;
+            report.Set(name + "_vertex_invocations", pipeline.vertices);
+            report.Set(name + "_clipped_primitives", clipped);
+            report.Set(name + "_fragment_invocations", pipeline.fragments);
+            if (profiler.zoneName(i) == "scene" && pixelsWide > 0 && pixelsHigh > 0) {
+                double overdraw = pipeline.fragments / ((double)pixelsWide * pixelsHigh);
+                std::cout << "Benchmark: scene overdraw " << overdraw << " fragments per pixel" << std::endl;
+                report.Set("overdraw", overdraw);
+            }
+        }
+        // Counts are per frame, the triangles are the ones the GPU drew, including those of commands it wrote itself
+        report.Set("gpu_frame_ms", gpuFrame);
+        report.Set("draw_calls", (double)counts.draws / benchmarkFrames);
+        report.Set("instances", (double)counts.instances / benchmarkFrames);
+        report.Set("triangles", (double)primitives / benchmarkFrames);
+        report.Set("state_changes", (double)counts.issued / benchmarkFrames);
+        report.Set("program_binds", (double)counts.programBinds / benchmarkFrames);
+        report.Set("vao_binds", (double)counts.vertexArrayBinds / benchmarkFrames);
+        report.Set("texture_binds", (double)counts.textureBinds / benchmarkFrames);
+        report.Set("buffer_binds", (double)counts.bufferBinds / benchmarkFrames);
+        report.Set("uniforms", (double)counts.uniforms / benchmarkFrames);
+        report.Set("uploads", (double)counts.uploads / benchmarkFrames);
+        report.Set("upload_kb", counts.uploadBytes / 1024.0 / benchmarkFrames);
+        const double megabyte = 1024.0 * 1024.0;
+        report.Set("vram_mb", GpuMemory.total() / megabyte);
+        for (int category = 0; category < GPU_MEMORY_CATEGORIES; category++)
+            report.Set(std::string("vram_") + GpuMemoryTracker::CategoryName((GpuMemoryCategory)category) + "_mb", GpuMemory.bytes((GpuMemoryCategory)category) / megabyte);
+        if (!reportPath.empty() && !report.Write(reportPath))
+            std::cerr << "Failed to write benchmark report to " << reportPath << std::endl;
+    }
+    if (primitivesQuery)
+        glDeleteQueries(1, &primitivesQuery);
+    // The message IDs the driver reported, most frequent first, a benchmark run shows what its frames set off
+    if (GLDebug.enabled) {
+        std::vector<GLDebugOutput::Count> counts = GLDebug.Counts();
+        std::cout << "GL debug: " << GLDebug.errors() << " errors, " << GLDebug.performanceWarnings() << " performance warnings, "
+                  << counts.size() << " message IDs" << std::endl;
+        for (const GLDebugOutput::Count& count : counts)
+            std::cout << "  " << count.count << "x " << GLDebugOutput::TypeName(count.latest.type) << " " << count.latest.id << ": " << count.latest.text << std::endl;
+    }
+    if (!traceOut.empty() && !Tracer.Write(traceOut.c_str()))
+        std::cerr << "Failed to write trace to " << traceOut << std::endl;
+    if (!profileOut.empty()) {
+        bool json = profileOut.size() >= 5 && profileOut.compare(profileOut.size() - 5, 5, ".json") == 0;
+        if (!(json ? profiler.WriteJSON(profileOut.c_str()) : profiler.WriteCSV(profileOut.c_str())))
+            std::cerr << "Failed to write profile to " << profileOut << std::endl;
+    }
+
+    // Cleanup, the GL objects have to go before the context does so they are deleted here rather than when they go out of scope
+    sceneVAO.Delete();
+    compactVAO.Delete();
+    trafficVAO.Delete();
+    roofVAO.Delete();
+    sceneHeap.Delete();
+    instanceStream.Delete();
+    indirectStream.reset();
+    billboardVAO.Delete();
+    occlusion.reset();
+    blockQueries.reset();
+    gpuCuller.reset();
+    propCuller.reset();
+    propRecords.reset();
+    propTileRecords.reset();
+    traffic.reset();
+    trafficStream.reset();
+    roofStream.reset();
+    cityRecords.reset();
+    blockRecords.reset();
+    meshlets.reset();
+    reverseDepth.reset();
+    if (readback) {
+        readback->Finish();
+        std::cout << "Wrote " << readback->written() << (poster ? " poster tiles to " : " views to ") << viewsOutput;
+        if (readback->failed() > 0)
+            std::cout << ", " << readback->failed() << " failed";
+        std::cout << std::endl;
+    }
+    // Whichever process finds every tile of a poster written stitches it, the last process of a farm to finish finds
+    // them all, since each only looks once its own tiles are written
+    if (poster) {
+        for (size_t view = 0; view < views.keyframes.size(); view++) {
+            if (poster->Complete(viewsOutput, view)) {
+                if (claim(Poster::Name(view) + "_stitch"))
+                    poster->Stitch(viewsOutput, view);
+            }
+            else if (!claimViews)
+                std::cerr << Poster::Name(view) << " is missing tiles, it was not stitched" << std::endl;
+        }
+    }
+    readback.reset();
+    if (screenshots) {
+        screenshots->Finish();
+        if (screenshots->failed() > 0)
+            std::cerr << screenshots->failed() << " screenshots could not be written" << std::endl;
+    }
+    screenshots.reset();
+    if (video) {
+        video->Close();
+        std::cout << "Encoded " << video->written() << " frames";
+        if (video->dropped() > 0)
+            std::cout << ", dropped " << video->dropped();
+        std::cout << std::endl;
+    }
+    video.reset();
+    viewTarget.reset();
+    dynamicResolution.reset();
+    antiAliasing.reset();
+    volumetricFog.reset();
+    postProcess.reset();
+    decalLibrary.reset();
+    lightShadows.reset();
+    clusteredLights.reset();
+    targetPool.Delete();
+    frameScheduler.Delete();
+    occlusionHistory.reset();
+    screenOcclusion.reset();
+    shadingRate.reset();
+    labelRenderer.reset();
+    if (Debug.dropped() > 0)
+        std::cout << "Debug lines: " << Debug.dropped() << " dropped for want of room" << std::endl;
+    Debug.Delete();
+    deferredRenderer.reset();
+    transparency.reset();
+    skyRenderer.reset();
+    reflectionProbes.reset();
+    planarReflection.reset();
+    particles.reset();
+    reflectedBillboards.reset();
+    shadowCasters.reset();
+    shadows.reset();
+    picker.reset();
+    pickRecords.reset();
+    terrainMap.reset();
+    tileVAO.Delete();
+    tileIndirect.reset();
+    tileRecords.reset();
+    tiles.reset();
+    if (tileCache)
+        std::cout << "Tile cache: " << tileCache->hits() << " hits, " << tileCache->misses() << " misses" << std::endl;
+    tileCache.reset();
+    if (tileIo)
+        std::cout << "Tile I/O: " << tileIo->bytesRead() / (1024 * 1024) << " MB read, " << tileIo->coalesced() << " reads merged" << std::endl;
+    tileIo.reset();
+    billboardStream.reset();
+    impostors.reset();
+    watcher.reset();
+    for (ReloadableProgram& reloadable : reloadablePrograms)
+        if (reloadable.building)
+            GLState.DeleteProgram(finishShaderProgram(reloadable.build));
+    frameUBO.Delete();
+    profiler.Delete();
+    textureStreamer.reset();
+    virtualTexture.reset();
+    textureLoader.Delete();
+    jobs.Delete();
+    input.Delete();
+    facades.Delete();
+    facadeTextures.clear();
+    Samplers.Delete();
+    materials.Delete();
+    if (billboardProgram)
+        GLState.DeleteProgram(billboardProgram);
+    if (pickProgram)
+        GLState.DeleteProgram(pickProgram);
+    if (glassProgram)
+        GLState.DeleteProgram(glassProgram);
+    if (markerProgram)
+        GLState.DeleteProgram(markerProgram);
+    for (int i = 0; i < 4; i++) {
+        if (scenePrograms[i])
+            GLState.DeleteProgram(scenePrograms[i]);
+        if (bindlessPrograms[i])
+            GLState.DeleteProgram(bindlessPrograms[i]);
+    }
+
+    GLDebug.Disable();
+    if (window)
+        glfwTerminate();
+    headlessContext.Delete();
+    // Prints what is still queued
+    Log.Stop();
     return 0;
 }
@@ -0,0 +1,140 @@
+#include"MappedFile.h"
+
+#include<utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include<windows.h>
+#else
+#include<fcntl.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<unistd.h>
+#endif
+
+// Unmaps the file unless Close was already called
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+// Takes over the mapping of another file, which is left closed
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+// Unmaps the current file and takes over the mapping of another one
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		bytes = std::exchange(other.bytes, nullptr);
+		length = std::exchange(other.length, 0);
+#ifdef _WIN32
+		file = std::exchange(other.file, nullptr);
+		mapping = std::exchange(other.mapping, nullptr);
+#else
+		file = std::exchange(other.file, -1);
+#endif
+	}
+	return *this;
+}
+
+// Maps a file
+bool MappedFile::Open(const std::string& path, bool sequential)
+{
+	Close();
+#ifdef _WIN32
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE)
+		return false;
+	file = handle;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart <= 0)
+	{
+		Close();
+		return false;
+	}
+	length = (size_t)fileSize.QuadPart;
+	mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping)
+		bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size <= 0)
+	{
+		Close();
+		return false;
+	}
+	length = (size_t)status.st_size;
+	void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file, 0);
+	if (mapped != MAP_FAILED)
+	{
+		bytes = (const unsigned char*)mapped;
+		if (sequential)
+			madvise(mapped, length, MADV_SEQUENTIAL);
+	}
+#endif
+	if (!bytes)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+// Checks if a file is mapped
+bool MappedFile::isOpen() const
+{
+	return bytes != nullptr;
+}
+
+const unsigned char* MappedFile::data() const
+{
+	return bytes;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
+
+// Reads a byte of every page, the sum is kept only so the reads are not optimized away
+void MappedFile::Prefault() const
+{
+	const size_t page = 4096;
+	volatile unsigned char sum = 0;
+	for (size_t at = 0; at < length; at += page)
+		sum += bytes[at];
+	(void)sum;
+}
+
+// Unmaps the file
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (bytes)
+		UnmapViewOfFile(bytes);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file)
+		CloseHandle(file);
+	mapping = nullptr;
+	file = nullptr;
+#else
+	if (bytes)
+		munmap((void*)bytes, length);
+	if (file >= 0)
+		close(file);
+	file = -1;
+#endif
+	bytes = nullptr;
+	length = 0;
+}
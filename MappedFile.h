@@ -0,0 +1,43 @@
+#ifndef MAPPED_FILE_CLASS_H
+#define MAPPED_FILE_CLASS_H
+
+#include<cstddef>
+#include<string>
+
+// Read only memory mapping of a whole file, the pages are read in by the OS as they are touched
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	// Unmaps the file unless Close was already called
+	~MappedFile();
+	// A MappedFile owns its mapping, so it can be moved but not copied
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	// Maps a file, false if it is missing, empty or cannot be mapped, sequential tells the OS it is read front to back
+	bool Open(const std::string& path, bool sequential = true);
+	// Checks if a file is mapped
+	bool isOpen() const;
+	// Start and size of the mapping, valid until Close
+	const unsigned char* data() const;
+	size_t size() const;
+	// Touches every page so the OS reads the file in now, on the thread calling it instead of the first to read each page
+	void Prefault() const;
+
+	// Unmaps the file, does nothing if nothing is mapped
+	void Close();
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#else
+	int file = -1;
+#endif
+};
+
+#endif
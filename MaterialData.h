@@ -0,0 +1,28 @@
+#ifndef MATERIAL_DATA_CLASS_H
+#define MATERIAL_DATA_CLASS_H
+
+#include<glad/glad.h>
+
+// One material of the scene, an array of these fills the shader storage buffer of MaterialTable, 48 bytes each
+// Mirrors the std430 struct "Material" in the shaders, so members must stay in the same order
+// Instances select their material by their layer, so the parameters change without a bind or another draw
+struct MaterialRecord
+{
+	// Binding point of the storage buffer and of every program's Materials block, above the ones the culling passes use
+	static constexpr GLuint BINDING = 6;
+
+	// Resident bindless handle of the facade texture, read as a uvec2 by the shaders, 0 in the texture array path
+	GLuint64 facade = 0;
+	// Layer of the facade texture array the material samples
+	GLfloat layer = 0.0f;
+	// Strength of the highlights of the point lights, the one default.frag uses for its light
+	GLfloat specular = 0.5f;
+	// Multiplies the facade and the instance color, its alpha below 1 makes the material glass
+	GLfloat tint[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	// A grid of windows made up by the fragment shader instead of the facade texture when the cell is wider than 0:
+	// width and height of a cell in facade texture coordinates, the share of the cell that is window and the chance
+	// that a window is lit
+	GLfloat windows[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+};
+
+#endif
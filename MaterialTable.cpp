@@ -0,0 +1,55 @@
+#include"MaterialTable.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+// Deletes the buffer unless Delete was already called
+MaterialTable::~MaterialTable()
+{
+	Delete();
+}
+
+// Adds a material and returns its index
+GLuint MaterialTable::Add(const MaterialRecord& record)
+{
+	records.push_back(record);
+	return (GLuint)(records.size() - 1);
+}
+
+// Copies the records into the buffer and binds it
+void MaterialTable::Upload()
+{
+	GLsizeiptr bytes = (GLsizeiptr)(records.size() * sizeof(MaterialRecord));
+	if (bytes == 0)
+		return;
+	if (ID == 0)
+		glGenBuffers(1, &ID);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, ID);
+	if (bytes > capacity)
+	{
+		glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, records.data(), GL_STATIC_DRAW);
+		capacity = bytes;
+		GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, ID, capacity);
+	}
+	else
+	{
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, bytes, records.data());
+	}
+	GLState.CountUpload(bytes);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, MaterialRecord::BINDING, ID);
+}
+
+// Number of materials
+size_t MaterialTable::size() const
+{
+	return records.size();
+}
+
+// Deletes the buffer
+void MaterialTable::Delete()
+{
+	if (ID != 0)
+		GLState.DeleteBuffers(1, &ID);
+	ID = 0;
+	capacity = 0;
+}
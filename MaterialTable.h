@@ -0,0 +1,40 @@
+#ifndef MATERIAL_TABLE_CLASS_H
+#define MATERIAL_TABLE_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<vector>
+
+#include"MaterialData.h"
+
+// Every material of the scene in one shader storage buffer bound to MaterialRecord::BINDING, read by programs with
+// SHADER_MATERIALS and by the bindless ones. Switching between materials costs no binds and no split draws, an
+// instance's layer is its index into the table.
+class MaterialTable
+{
+public:
+	// Reference ID of the storage buffer, 0 until the first upload
+	GLuint ID = 0;
+	// Materials in the order they were added, changes reach the GPU with the next Upload
+	std::vector<MaterialRecord> records;
+
+	MaterialTable() = default;
+	// Deletes the buffer unless Delete was already called, the context has to still be current
+	~MaterialTable();
+	MaterialTable(const MaterialTable&) = delete;
+	MaterialTable& operator=(const MaterialTable&) = delete;
+
+	// Adds a material and returns its index
+	GLuint Add(const MaterialRecord& record);
+	// Copies the records into the buffer, created or grown as needed, and binds it to MaterialRecord::BINDING
+	void Upload();
+	// Number of materials
+	size_t size() const;
+	// Deletes the buffer, does nothing if it was already deleted
+	void Delete();
+private:
+	// Bytes the buffer was created with
+	GLsizeiptr capacity = 0;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include"MeshBatcher.h"
+
+#include<algorithm>
+#include<cstdint>
+#include<numeric>
+
+// Spreads the lowest 10 bits of a number out to every third bit
+static uint32_t spreadBits(uint32_t x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x030000ff;
+	x = (x | (x << 8)) & 0x0300f00f;
+	x = (x | (x << 4)) & 0x030c30c3;
+	x = (x | (x << 2)) & 0x09249249;
+	return x;
+}
+
+// Constructor that takes the vertex layout and the limits of a batch
+MeshBatcher::MeshBatcher(unsigned int vertexFloats, size_t batchBytes, size_t maxVertices)
+{
+	MeshBatcher::vertexFloats = vertexFloats;
+	MeshBatcher::batchBytes = batchBytes;
+	MeshBatcher::maxVertices = maxVertices;
+}
+
+// Adds a mesh
+void MeshBatcher::Add(const GLfloat* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, unsigned int material, GLuint baseVertex)
+{
+	if (vertexCount == 0)
+		return;
+	Source source = { vertices, vertexCount, indices, indexCount, material, baseVertex, glm::vec3(vertices[0], vertices[1], vertices[2]), glm::vec3(0.0f) };
+	source.max = source.min;
+	for (size_t v = 1; v < vertexCount; v++)
+	{
+		glm::vec3 position(vertices[v * vertexFloats], vertices[v * vertexFloats + 1], vertices[v * vertexFloats + 2]);
+		source.min = glm::min(source.min, position);
+		source.max = glm::max(source.max, position);
+	}
+	sources.push_back(source);
+}
+
+// Merges every mesh added into batches
+std::vector<MeshBatcher::Batch> MeshBatcher::Build() const
+{
+	std::vector<Batch> batches;
+	if (sources.empty())
+		return batches;
+
+	// Morton codes of the mesh centers inside the bounds of everything, neighbours in the code are neighbours in space
+	glm::vec3 min = sources[0].min, max = sources[0].max;
+	for (const Source& source : sources)
+	{
+		min = glm::min(min, source.min);
+		max = glm::max(max, source.max);
+	}
+	glm::vec3 scale = 1023.0f / glm::max(max - min, glm::vec3(1e-6f));
+	std::vector<uint32_t> codes(sources.size());
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		glm::uvec3 cell = glm::uvec3(((sources[i].min + sources[i].max) * 0.5f - min) * scale);
+		codes[i] = spreadBits(cell.x) | (spreadBits(cell.y) << 1) | (spreadBits(cell.z) << 2);
+	}
+	std::vector<size_t> order(sources.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return sources[a].material != sources[b].material ? sources[a].material < sources[b].material : codes[a] < codes[b];
+	});
+
+	const size_t vertexBytes = vertexFloats * sizeof(GLfloat);
+	size_t bytes = 0;
+	for (size_t i : order)
+	{
+		const Source& source = sources[i];
+		size_t sourceBytes = source.vertexCount * vertexBytes + source.indexCount * sizeof(GLuint);
+		bool full = !batches.empty() && (batches.back().vertices.size() / vertexFloats + source.vertexCount > maxVertices || bytes + sourceBytes > batchBytes);
+		if (batches.empty() || batches.back().material != source.material || full)
+		{
+			Batch batch;
+			batch.material = source.material;
+			batch.min = source.min;
+			batch.max = source.max;
+			batch.meshCount = 0;
+			batches.push_back(std::move(batch));
+			bytes = 0;
+		}
+
+		Batch& batch = batches.back();
+		GLuint first = (GLuint)(batch.vertices.size() / vertexFloats);
+		batch.vertices.insert(batch.vertices.end(), source.vertices, source.vertices + source.vertexCount * vertexFloats);
+		for (size_t k = 0; k < source.indexCount; k++)
+			batch.indices.push_back(source.indices[k] - source.baseVertex + first);
+		batch.min = glm::min(batch.min, source.min);
+		batch.max = glm::max(batch.max, source.max);
+		batch.meshCount++;
+		bytes += sourceBytes;
+	}
+	return batches;
+}
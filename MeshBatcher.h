@@ -0,0 +1,58 @@
+#ifndef MESH_BATCHER_CLASS_H
+#define MESH_BATCHER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<vector>
+
+// Merges many small static meshes into a few large batches, so a district of unique buildings draws with dozens of calls
+// instead of one per building. Only meshes of the same material share a batch, and meshes are taken in Morton order
+// of their centers, so every batch covers a compact area and frustum culling still works a batch at a time
+class MeshBatcher
+{
+public:
+	// One merged mesh, indices are relative to its first vertex
+	struct Batch
+	{
+		unsigned int material;
+		// Bounds of every mesh in the batch
+		glm::vec3 min;
+		glm::vec3 max;
+		size_t meshCount;
+		std::vector<GLfloat> vertices;
+		std::vector<GLuint> indices;
+	};
+
+	// Number of floats per vertex, the first three a position
+	unsigned int vertexFloats;
+	// A batch is closed before its vertices and indices grow past this many bytes
+	size_t batchBytes;
+	// A batch is also closed before it has more vertices than this, 65536 keeps 16 bit indices usable
+	size_t maxVertices;
+
+	// Constructor that takes the vertex layout and the limits of a batch
+	MeshBatcher(unsigned int vertexFloats, size_t batchBytes, size_t maxVertices = 65536);
+
+	// Adds a mesh, the arrays are only read by Build and have to stay valid until then
+	// Indices are relative to baseVertex, such as a building inside CityGenerator::Generate's arrays
+	void Add(const GLfloat* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount, unsigned int material, GLuint baseVertex = 0);
+	// Merges every mesh added into batches ordered by material, a mesh larger than the limits gets a batch of its own
+	std::vector<Batch> Build() const;
+private:
+	// A mesh waiting for Build
+	struct Source
+	{
+		const GLfloat* vertices;
+		size_t vertexCount;
+		const GLuint* indices;
+		size_t indexCount;
+		unsigned int material;
+		GLuint baseVertex;
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+	std::vector<Source> sources;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include"MeshCodec.h"
+#include"CityGenerator.h"
+
+#include<algorithm>
+#include<cmath>
+#include<cstdint>
+#include<cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESH_CODEC_SSE2 1
+#include<emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define MESH_CODEC_NEON 1
+#include<arm_neon.h>
+#endif
+
+// Start of every compressed mesh, followed by the vertex count, the index count, the bytes of the indices, the
+// minimum and step of every vertex component, the 16 bit vertices and the index bytes
+static const uint32_t MESH_MAGIC = 0x4853454D; // "MESH"
+static constexpr unsigned int FLOATS = CityGenerator::VERTEX_FLOATS;
+// Quantized values padded after the vertices, so the vector loop may read a whole register past the last vertex
+static constexpr size_t PADDING = 8;
+
+struct MeshHeader
+{
+	uint32_t magic;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t indexBytes;
+	float minimum[FLOATS];
+	float step[FLOATS];
+};
+
+size_t MeshCodec::Bound(size_t vertexCount, size_t indexCount)
+{
+	// A 32 bit difference takes at most 5 bytes of 7 bits
+	return sizeof(MeshHeader) + (vertexCount * FLOATS + PADDING) * sizeof(uint16_t) + indexCount * 5;
+}
+
+// Quantizes every component over its own range, then writes the index differences 7 bits a byte
+std::vector<char> MeshCodec::Encode(const GLfloat* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount)
+{
+	MeshHeader header = {};
+	header.magic = MESH_MAGIC;
+	header.vertexCount = (uint32_t)vertexCount;
+	header.indexCount = (uint32_t)indexCount;
+	float maximum[FLOATS];
+	for (unsigned int c = 0; c < FLOATS; c++)
+	{
+		header.minimum[c] = vertexCount > 0 ? vertices[c] : 0.0f;
+		maximum[c] = header.minimum[c];
+	}
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		for (unsigned int c = 0; c < FLOATS; c++)
+		{
+			header.minimum[c] = std::min(header.minimum[c], vertices[i * FLOATS + c]);
+			maximum[c] = std::max(maximum[c], vertices[i * FLOATS + c]);
+		}
+	}
+	for (unsigned int c = 0; c < FLOATS; c++)
+		header.step[c] = (maximum[c] - header.minimum[c]) / 65535.0f;
+
+	std::vector<char> data(Bound(vertexCount, indexCount));
+	uint16_t* quantized = (uint16_t*)(data.data() + sizeof(MeshHeader));
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		for (unsigned int c = 0; c < FLOATS; c++)
+		{
+			float fraction = header.step[c] > 0.0f ? (vertices[i * FLOATS + c] - header.minimum[c]) / header.step[c] : 0.0f;
+			quantized[i * FLOATS + c] = (uint16_t)std::lround(std::clamp(fraction, 0.0f, 65535.0f));
+		}
+	}
+	std::memset(quantized + vertexCount * FLOATS, 0, PADDING * sizeof(uint16_t));
+
+	unsigned char* out = (unsigned char*)(quantized + vertexCount * FLOATS + PADDING);
+	unsigned char* start = out;
+	uint32_t previous = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		int32_t difference = (int32_t)(indices[i] - previous);
+		uint32_t zigzag = ((uint32_t)difference << 1) ^ (uint32_t)(difference >> 31);
+		while (zigzag >= 0x80)
+		{
+			*out++ = (unsigned char)(zigzag | 0x80);
+			zigzag >>= 7;
+		}
+		*out++ = (unsigned char)zigzag;
+		previous = indices[i];
+	}
+	header.indexBytes = (uint32_t)(out - start);
+	std::memcpy(data.data(), &header, sizeof(header));
+	data.resize((size_t)((char*)out - data.data()));
+	return data;
+}
+
+// Turns the quantized components back into floats, four vertices of five components a round
+static void dequantize(const uint16_t* in, size_t vertexCount, const float* minimum, const float* step, float* out)
+{
+	size_t i = 0;
+#if MESH_CODEC_SSE2 || MESH_CODEC_NEON
+	// Twenty floats make five registers, and the component of every lane comes round again every five floats
+	float scales[4 * FLOATS], offsets[4 * FLOATS];
+	for (unsigned int lane = 0; lane < 4 * FLOATS; lane++)
+	{
+		scales[lane] = step[lane % FLOATS];
+		offsets[lane] = minimum[lane % FLOATS];
+	}
+#endif
+#if MESH_CODEC_SSE2
+	__m128 scale[FLOATS], offset[FLOATS];
+	for (unsigned int r = 0; r < FLOATS; r++)
+	{
+		scale[r] = _mm_loadu_ps(scales + 4 * r);
+		offset[r] = _mm_loadu_ps(offsets + 4 * r);
+	}
+	const __m128i zero = _mm_setzero_si128();
+	// The third load reads four values past the twenty, into the next vertices or the padding
+	for (; i + 4 <= vertexCount; i += 4)
+	{
+		const uint16_t* source = in + i * FLOATS;
+		float* target = out + i * FLOATS;
+		__m128i a = _mm_loadu_si128((const __m128i*)source);
+		__m128i b = _mm_loadu_si128((const __m128i*)(source + 8));
+		__m128i c = _mm_loadu_si128((const __m128i*)(source + 16));
+		__m128i words[FLOATS] = { _mm_unpacklo_epi16(a, zero), _mm_unpackhi_epi16(a, zero), _mm_unpacklo_epi16(b, zero), _mm_unpackhi_epi16(b, zero), _mm_unpacklo_epi16(c, zero) };
+		for (unsigned int r = 0; r < FLOATS; r++)
+			_mm_storeu_ps(target + 4 * r, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(words[r]), scale[r]), offset[r]));
+	}
+#elif MESH_CODEC_NEON
+	float32x4_t scale[FLOATS], offset[FLOATS];
+	for (unsigned int r = 0; r < FLOATS; r++)
+	{
+		scale[r] = vld1q_f32(scales + 4 * r);
+		offset[r] = vld1q_f32(offsets + 4 * r);
+	}
+	for (; i + 4 <= vertexCount; i += 4)
+	{
+		const uint16_t* source = in + i * FLOATS;
+		float* target = out + i * FLOATS;
+		uint16x8_t a = vld1q_u16(source);
+		uint16x8_t b = vld1q_u16(source + 8);
+		uint16x4_t c = vld1_u16(source + 16);
+		uint32x4_t words[FLOATS] = { vmovl_u16(vget_low_u16(a)), vmovl_u16(vget_high_u16(a)), vmovl_u16(vget_low_u16(b)), vmovl_u16(vget_high_u16(b)), vmovl_u16(c) };
+		for (unsigned int r = 0; r < FLOATS; r++)
+			vst1q_f32(target + 4 * r, vmlaq_f32(offset[r], vcvtq_f32_u32(words[r]), scale[r]));
+	}
+#endif
+	for (; i < vertexCount; i++)
+		for (unsigned int c = 0; c < FLOATS; c++)
+			out[i * FLOATS + c] = (float)in[i * FLOATS + c] * step[c] + minimum[c];
+}
+
+// Checks every count against the bytes there are before touching them
+bool MeshCodec::Decode(const char* data, size_t size, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+{
+	MeshHeader header;
+	if (size < sizeof(header))
+		return false;
+	std::memcpy(&header, data, sizeof(header));
+	size_t quantizedBytes = ((size_t)header.vertexCount * FLOATS + PADDING) * sizeof(uint16_t);
+	if (header.magic != MESH_MAGIC || size < sizeof(header) + quantizedBytes + header.indexBytes)
+		return false;
+	const uint16_t* quantized = (const uint16_t*)(data + sizeof(header));
+	vertices.resize((size_t)header.vertexCount * FLOATS);
+	dequantize(quantized, header.vertexCount, header.minimum, header.step, vertices.data());
+
+	indices.resize(header.indexCount);
+	const unsigned char* in = (const unsigned char*)(data + sizeof(header) + quantizedBytes);
+	const unsigned char* end = in + header.indexBytes;
+	uint32_t previous = 0;
+	for (uint32_t i = 0; i < header.indexCount; i++)
+	{
+		uint32_t zigzag = 0;
+		// Most differences fit one byte, the loop only runs for the rest
+		if (in < end && *in < 0x80)
+			zigzag = *in++;
+		else
+		{
+			for (unsigned int shift = 0;; shift += 7)
+			{
+				if (in == end || shift > 28)
+					return false;
+				unsigned char byte = *in++;
+				zigzag |= (uint32_t)(byte & 0x7F) << shift;
+				if (byte < 0x80)
+					break;
+			}
+		}
+		previous += (zigzag >> 1) ^ (0u - (zigzag & 1));
+		indices[i] = previous;
+	}
+	return true;
+}
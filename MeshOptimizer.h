@@ -0,0 +1,57 @@
+#ifndef MESH_OPTIMIZER_CLASS_H
+#define MESH_OPTIMIZER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<vector>
+
+// A run of at most MAX_MESHLET_TRIANGLES triangles over at most MAX_MESHLET_VERTICES vertices, with the bounds that
+// let it be culled on its own: a sphere around it, and a cone around the normals of its triangles that is used
+// like meshoptimizer's, every triangle faces away from an eye e if dot(center - e, coneAxis) >= coneCutoff *
+// length(center - e) + radius. A cutoff of 1 never culls, which is what clusters whose normals spread too far get.
+struct Meshlet
+{
+	// Index range of the triangles in the mesh's index list
+	GLuint firstIndex;
+	GLuint indexCount;
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+// Reorders triangles and vertices of an indexed triangle list for the GPU, without changing what is drawn
+//   vertex cache   Tipsify (Sander, Nehab and Barczak 2007) keeps triangles sharing vertices close together,
+//                  so the post-transform cache shades each vertex about once instead of once per triangle
+//   overdraw       the clusters Tipsify emits are sorted so the ones facing outwards from the mesh center come first,
+//                  which lets the depth test reject the triangles behind them from most viewpoints
+//   vertex fetch   vertices are renumbered in the order the indices first use them, so fetches walk the buffer forwards
+// CityGenerator orders every building it writes with it, so generated, cooked and mapped meshes all arrive optimized
+class MeshOptimizer
+{
+public:
+	// Post-transform cache size the ordering aims for, small enough for every GPU the project runs on
+	static constexpr unsigned int CACHE_SIZE = 16;
+
+	// Runs all three passes in place on vertexCount vertices of floatsPerVertex floats, the first three a position
+	// Indices are relative to baseVertex, so one mesh can be optimized inside a larger buffer
+	static void Optimize(GLfloat* vertices, size_t vertexCount, unsigned int floatsPerVertex, GLuint* indices, size_t indexCount, GLuint baseVertex = 0);
+
+	// Tipsify ordering of the triangles, returns the first triangle of every cluster in the new order
+	static std::vector<size_t> OptimizeVertexCache(GLuint* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE);
+	// Sorts the clusters of OptimizeVertexCache front to back from the outside, keeping the order inside each cluster
+	static void OptimizeOverdraw(const GLfloat* vertices, unsigned int floatsPerVertex, GLuint* indices, size_t indexCount, const std::vector<size_t>& clusters);
+	// Renumbers the vertices in order of first use and moves them to match
+	static void OptimizeVertexFetch(GLfloat* vertices, size_t vertexCount, unsigned int floatsPerVertex, GLuint* indices, size_t indexCount);
+	// Limits of a meshlet, the sizes mesh shaders are fastest with on most GPUs
+	static constexpr unsigned int MAX_MESHLET_VERTICES = 64;
+	static constexpr unsigned int MAX_MESHLET_TRIANGLES = 124;
+	// Cuts the triangles into meshlets in the order the indices list them, which after OptimizeVertexCache keeps
+	// them close together, front faces wind counterclockwise
+	static std::vector<Meshlet> BuildMeshlets(const GLfloat* vertices, unsigned int floatsPerVertex, const GLuint* indices, size_t indexCount, size_t vertexCount);
+	// Average number of vertices a FIFO cache of cacheSize shades per triangle, 0.5 is the best a grid can do and 3 the worst
+	static float CacheMissRatio(const GLuint* indices, size_t indexCount, size_t vertexCount, unsigned int cacheSize = CACHE_SIZE);
+};
+
+#endif
@@ -0,0 +1,234 @@
+#include"MeshletCuller.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLExtensions.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+
+// Invocation x of work group y tests meshlet x of every instance y plus a multiple of the work groups in y
+// Pass 0 counts what every meshlet keeps, pass 1 lays the counts out as instance ranges and pass 2 fills them
+static const char* cullSource = R"(
+#version 430 core
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) readonly buffer Records { float records[]; };
+// Sphere as center and radius, then cone as axis and cutoff
+struct Bounds
+{
+    vec4 sphere;
+    vec4 cone;
+};
+layout(std430, binding = 1) readonly buffer Meshlets { Bounds meshlets[]; };
+layout(std430, binding = 2) buffer Counts { uint counts[]; };
+layout(std430, binding = 3) writeonly buffer Survivors { float survivors[]; };
+// Laid out like DrawElementsIndirectCommand, one per meshlet
+struct Command
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+layout(std430, binding = 4) buffer Commands { Command commands[]; };
+
+uniform uint pass;
+uniform uint firstRecord;
+uniform uint count;
+uniform uint meshletCount;
+uniform uint recordFloats;
+uniform uint maxPairs;
+uniform vec4 planes[6];
+uniform vec3 eye;
+
+// Checks if a meshlet of a record is at least partly inside the frustum and has a triangle facing the eye
+bool visible(uint record, uint meshlet)
+{
+    vec3 offset = vec3(records[record], records[record + 1u], records[record + 2u]);
+    vec3 scale = vec3(records[record + 3u], records[record + 4u], records[record + 5u]);
+    Bounds bounds = meshlets[meshlet];
+    vec3 center = bounds.sphere.xyz * scale + offset;
+    float radius = bounds.sphere.w * max(scale.x, max(scale.y, scale.z));
+    for (int p = 0; p < 6; p++)
+        if (dot(planes[p].xyz, center) + planes[p].w < -radius)
+            return false;
+    // Scaling keeps the side of every triangle's plane the eye is on, so the cone is tested in the mesh's own space
+    vec3 toCenter = bounds.sphere.xyz - (eye - offset) / scale;
+    return dot(toCenter, bounds.cone.xyz) < bounds.cone.w * length(toCenter) + bounds.sphere.w;
+}
+
+void main()
+{
+    uint meshlet = gl_GlobalInvocationID.x;
+    if (pass == 1u)
+    {
+        // Meshlets past the room left keep none of their instances
+        if (gl_GlobalInvocationID.x != 0u || gl_WorkGroupID.y != 0u)
+            return;
+        uint total = 0u;
+        for (uint m = 0u; m < meshletCount; m++)
+        {
+            uint kept = min(counts[m], maxPairs - total);
+            commands[m].instanceCount = kept;
+            commands[m].baseInstance = total;
+            counts[m] = 0u;
+            total += kept;
+        }
+        return;
+    }
+    if (meshlet >= meshletCount)
+        return;
+    for (uint i = gl_WorkGroupID.y; i < count; i += gl_NumWorkGroups.y)
+    {
+        uint record = (firstRecord + i) * recordFloats;
+        if (!visible(record, meshlet))
+            continue;
+        uint slot = atomicAdd(counts[meshlet], 1u);
+        if (pass == 0u || slot >= commands[meshlet].instanceCount)
+            continue;
+        slot += commands[meshlet].baseInstance;
+        for (uint f = 0u; f < recordFloats; f++)
+            survivors[slot * recordFloats + f] = records[record + f];
+    }
+}
+)";
+
+// Checks if the context has what the culler needs
+bool MeshletCuller::Supported()
+{
+	return GLExt.computeShader && GLExt.shaderStorage && GLExt.multiDrawIndirect;
+}
+
+// Constructor that uploads the bounds and commands of every meshlet and builds the program
+MeshletCuller::MeshletCuller(const std::vector<Meshlet>& meshlets, const DrawCommandBuilder::Mesh& mesh, GLuint maxPairs, GLuint recordFloats)
+{
+	MeshletCuller::meshlets = (GLuint)meshlets.size();
+	MeshletCuller::maxPairs = std::max<GLuint>(maxPairs, 1);
+	MeshletCuller::recordFloats = recordFloats;
+
+	glGenBuffers(1, &recordBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, recordBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)MeshletCuller::maxPairs * recordFloats * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, recordBuffer, (int64_t)MeshletCuller::maxPairs * recordFloats * sizeof(float));
+
+	std::vector<glm::vec4> bounds;
+	std::vector<DrawElementsIndirectCommand> commands;
+	for (const Meshlet& meshlet : meshlets)
+	{
+		bounds.push_back(glm::vec4(meshlet.center, meshlet.radius));
+		bounds.push_back(glm::vec4(meshlet.coneAxis, meshlet.coneCutoff));
+		commands.push_back({ meshlet.indexCount, 0, mesh.firstIndex + meshlet.firstIndex, mesh.baseVertex, 0 });
+	}
+	// Storage blocks cannot be empty, a mesh without meshlets still gets one of each
+	bounds.resize(std::max<size_t>(bounds.size(), 2));
+	commands.resize(std::max<size_t>(commands.size(), 1));
+	zeroes.assign(commands.size(), 0u);
+
+	glGenBuffers(1, &boundsBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, boundsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, bounds.size() * sizeof(glm::vec4), bounds.data(), GL_STATIC_DRAW);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, boundsBuffer, (int64_t)(bounds.size() * sizeof(glm::vec4)));
+
+	glGenBuffers(1, &countBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, zeroes.size() * sizeof(GLuint), zeroes.data(), GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, countBuffer, (int64_t)(zeroes.size() * sizeof(GLuint)));
+
+	glGenBuffers(1, &commandBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, commandBuffer, (int64_t)(commands.size() * sizeof(DrawElementsIndirectCommand)));
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	program = Shader::LinkCompute(cullSource);
+	GLState.UseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "meshletCount"), MeshletCuller::meshlets);
+	glUniform1ui(glGetUniformLocation(program, "recordFloats"), recordFloats);
+	glUniform1ui(glGetUniformLocation(program, "maxPairs"), MeshletCuller::maxPairs);
+	GLState.UseProgram(0);
+}
+
+// Deletes the GL objects unless Delete was already called
+MeshletCuller::~MeshletCuller()
+{
+	Delete();
+}
+
+// Runs the three passes over count records
+void MeshletCuller::Cull(GLuint records, GLuint firstRecord, GLuint count, const Frustum& frustum, const glm::vec3& eye)
+{
+	culled = count > 0 && meshlets > 0;
+	if (!culled)
+		return;
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	// The last pass leaves the counts at what it filled, which is not always zero once the room ran out
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, zeroes.size() * sizeof(GLuint), zeroes.data());
+	GLState.CountUpload(zeroes.size() * sizeof(GLuint));
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, records);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, boundsBuffer);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, countBuffer);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, recordBuffer);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, commandBuffer);
+
+	GLState.UseProgram(program);
+	GLint passLoc = glGetUniformLocation(program, "pass");
+	glUniform1ui(glGetUniformLocation(program, "firstRecord"), firstRecord);
+	glUniform1ui(glGetUniformLocation(program, "count"), count);
+	glUniform4fv(glGetUniformLocation(program, "planes"), 6, glm::value_ptr(frustum.planes[0]));
+	glUniform3fv(glGetUniformLocation(program, "eye"), 1, glm::value_ptr(eye));
+	GLState.CountUniforms(4);
+	// Work groups in y are limited to 65535, further instances are looped over
+	GLuint groupsX = (meshlets + 63) / 64;
+	GLuint groupsY = std::min<GLuint>(count, 65535);
+	for (GLuint pass = 0; pass < 3; pass++)
+	{
+		glUniform1ui(passLoc, pass);
+		GLState.CountUniforms();
+		if (pass == 1)
+			glDispatchCompute(1, 1, 1);
+		else
+			glDispatchCompute(groupsX, groupsY, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+	// The survivors are read as instance attributes and the commands by the draw
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+	GLState.UseProgram(previousProgram);
+}
+
+// Draws every meshlet's command, the culled ones have no instances
+void MeshletCuller::Draw(GLenum indexType)
+{
+	if (!culled)
+		return;
+	GLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, nullptr, meshlets, 0);
+	GLState.CountDraw(0, 0);
+	GLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Number of meshlets of the mesh
+GLuint MeshletCuller::meshletCount() const
+{
+	return meshlets;
+}
+
+// Deletes the GL objects
+void MeshletCuller::Delete()
+{
+	GLuint buffers[] = { recordBuffer, boundsBuffer, countBuffer, commandBuffer };
+	for (GLuint buffer : buffers)
+		if (buffer != 0)
+			GLState.DeleteBuffers(1, &buffer);
+	recordBuffer = boundsBuffer = countBuffer = commandBuffer = 0;
+	if (program != 0)
+		GLState.DeleteProgram(program);
+	program = 0;
+	culled = false;
+}
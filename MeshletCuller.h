@@ -0,0 +1,67 @@
+#ifndef MESHLET_CULLER_CLASS_H
+#define MESHLET_CULLER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+
+#include"DrawCommandBuilder.h"
+#include"Frustum.h"
+#include"MeshOptimizer.h"
+
+// Draws a dense unit mesh instanced by a record per building meshlet by meshlet, culled on the GPU with compute shaders.
+// Every pair of a record and a meshlet is tested against the frustum with the meshlet's sphere and against the eye
+// with its normal cone, so the triangles drawn follow what can be seen of every instance rather than all of it.
+// A first pass counts the instances each meshlet keeps, a single invocation turns the counts into the ranges their
+// instances go in, and a last pass copies the records into them. The draw is then one multi draw indirect with a
+// command per meshlet, so nothing is ever read back to the CPU.
+// This does for GL 4.3 what a task shader does with mesh shaders, which the GL core profile does not have.
+class MeshletCuller
+{
+public:
+	// Records the passes let through, point the instance attributes at offset 0 of it when drawing
+	GLuint recordBuffer = 0;
+
+	// Checks if the context has compute shaders, storage buffers and multi draw indirect
+	static bool Supported();
+
+	// Constructor for the meshlets of mesh, whose index ranges are relative to it, and up to maxPairs surviving
+	// pairs per frame of records of recordFloats floats each
+	// The first six floats of every record have to be the translation and scale of the mesh, as CityGenerator writes them
+	MeshletCuller(const std::vector<Meshlet>& meshlets, const DrawCommandBuilder::Mesh& mesh, GLuint maxPairs, GLuint recordFloats);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~MeshletCuller();
+	// A MeshletCuller owns its GL objects, so it cannot be copied
+	MeshletCuller(const MeshletCuller&) = delete;
+	MeshletCuller& operator=(const MeshletCuller&) = delete;
+
+	// Tests every meshlet of count records starting at record firstRecord of a buffer against frustum and eye,
+	// both in the space the records place the mesh in
+	void Cull(GLuint records, GLuint firstRecord, GLuint count, const Frustum& frustum, const glm::vec3& eye);
+	// Draws the meshlets Cull let through, with the mesh's VAO bound and its instance attributes on recordBuffer
+	// indexType is the type of the bound index buffer, such as GpuBufferHeap::indexType
+	void Draw(GLenum indexType = GL_UNSIGNED_INT);
+
+	// Number of meshlets of the mesh
+	GLuint meshletCount() const;
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLuint meshlets = 0;
+	GLuint maxPairs = 0;
+	GLuint recordFloats = 0;
+	// Sphere and cone of every meshlet
+	GLuint boundsBuffer = 0;
+	// Instances every meshlet kept, counted by the first pass and filled by the last
+	GLuint countBuffer = 0;
+	// One DrawElementsIndirectCommand per meshlet
+	GLuint commandBuffer = 0;
+	GLuint program = 0;
+	// The zeroes the counts start every frame at
+	std::vector<GLuint> zeroes;
+	// Whether the last Cull had anything to test
+	bool culled = false;
+};
+
+#endif
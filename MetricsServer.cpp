@@ -0,0 +1,226 @@
+#include"MetricsServer.h"
+
+#include<cstring>
+#include<iostream>
+#include<sstream>
+
+#ifdef _WIN32
+#include<winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET NativeSocket;
+static const intptr_t INVALID_HANDLE = (intptr_t)INVALID_SOCKET;
+static void closeSocket(intptr_t handle) { closesocket((NativeSocket)handle); }
+#else
+#include<netinet/in.h>
+#include<sys/select.h>
+#include<sys/socket.h>
+#include<sys/time.h>
+#include<unistd.h>
+typedef int NativeSocket;
+static const intptr_t INVALID_HANDLE = -1;
+static void closeSocket(intptr_t handle) { close((NativeSocket)handle); }
+#endif
+
+// Frames of 60, 30 and 20 Hz displays fall on either side of a bound
+const double MetricsServer::BUCKET_MILLISECONDS[BUCKETS] = { 4.0, 8.0, 12.0, 16.7, 20.0, 25.0, 33.4, 50.0, 100.0, 250.0 };
+
+// Largest request read, the rest of a longer one is ignored
+static const size_t REQUEST_BYTES = 4096;
+
+// Adds a frame time to its bucket
+void MetricsServer::Histogram::Add(float milliseconds)
+{
+	size_t bucket = 0;
+	while (bucket < BUCKETS && milliseconds > BUCKET_MILLISECONDS[bucket])
+		bucket++;
+	counts[bucket].fetch_add(1, std::memory_order_relaxed);
+	sumMicroseconds.fetch_add((uint64_t)(milliseconds * 1000.0f), std::memory_order_relaxed);
+}
+
+// Constructor that listens on the port and starts the thread
+MetricsServer::MetricsServer(unsigned short port)
+{
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		socket = INVALID_HANDLE;
+		std::cerr << "ERROR::METRICS::WSASTARTUP_FAILED" << std::endl;
+		return;
+	}
+	socket = (intptr_t)::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+#else
+	socket = (intptr_t)::socket(AF_INET, SOCK_STREAM, 0);
+#endif
+	if (socket == INVALID_HANDLE)
+	{
+		std::cerr << "ERROR::METRICS::SOCKET_FAILED" << std::endl;
+		return;
+	}
+	// A restarted engine gets its port back while the connections of the last one are still closing
+	int reuse = 1;
+	setsockopt((NativeSocket)socket, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind((NativeSocket)socket, (const sockaddr*)&address, sizeof(address)) != 0 || listen((NativeSocket)socket, 4) != 0)
+	{
+		std::cerr << "ERROR::METRICS::BIND_FAILED port " << port << std::endl;
+		closeSocket(socket);
+		socket = INVALID_HANDLE;
+		return;
+	}
+	thread = std::thread(&MetricsServer::serve, this);
+}
+
+// Stops the thread unless Delete was already called
+MetricsServer::~MetricsServer()
+{
+	Delete();
+}
+
+// Whether the socket could be bound
+bool MetricsServer::isOpen() const
+{
+	return socket != INVALID_HANDLE;
+}
+
+// A scrape in progress keeps the lock, the frame then leaves the last numbers as they were
+void MetricsServer::Publish(const Sample& sample)
+{
+	frames.fetch_add(1, std::memory_order_relaxed);
+	if (sample.cpuMilliseconds >= 0.0f)
+		cpuFrames.Add(sample.cpuMilliseconds);
+	if (sample.gpuMilliseconds >= 0.0f)
+		gpuFrames.Add(sample.gpuMilliseconds);
+	std::unique_lock<std::mutex> lock(latestMutex, std::try_to_lock);
+	if (lock.owns_lock())
+		latest = sample;
+}
+
+// Requests answered so far
+uint64_t MetricsServer::served() const
+{
+	return servedCount.load(std::memory_order_relaxed);
+}
+
+// Stops the thread and closes the socket
+void MetricsServer::Delete()
+{
+	if (socket == INVALID_HANDLE)
+		return;
+	stopping = true;
+	if (thread.joinable())
+		thread.join();
+	closeSocket(socket);
+	socket = INVALID_HANDLE;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+// Waits for a connection at most 100 ms at a time, so the thread sees a request to stop
+void MetricsServer::serve()
+{
+	while (!stopping)
+	{
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET((NativeSocket)socket, &readable);
+		timeval timeout{ 0, 100000 };
+		if (select((int)socket + 1, &readable, nullptr, nullptr, &timeout) <= 0)
+			continue;
+		intptr_t connection = (intptr_t)accept((NativeSocket)socket, nullptr, nullptr);
+		if (connection == INVALID_HANDLE)
+			continue;
+		answer(connection);
+		closeSocket(connection);
+	}
+}
+
+// Reads the request line, a client that says nothing within a second is dropped
+void MetricsServer::answer(intptr_t connection)
+{
+#ifdef _WIN32
+	DWORD timeout = 1000;
+#else
+	timeval timeout{ 1, 0 };
+#endif
+	setsockopt((NativeSocket)connection, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	char request[REQUEST_BYTES];
+	int bytes = (int)recv((NativeSocket)connection, request, (int)sizeof(request) - 1, 0);
+	if (bytes <= 0)
+		return;
+	request[bytes] = '\0';
+
+	std::string status = "200 OK";
+	std::string body;
+	if (std::strncmp(request, "GET /metrics ", 13) == 0 || std::strncmp(request, "GET / ", 6) == 0)
+		body = text();
+	else
+	{
+		status = "404 Not Found";
+		body = "Only GET /metrics is served\n";
+	}
+	std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: "
+		+ std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+	size_t sent = 0;
+	while (sent < response.size())
+	{
+		int count = (int)send((NativeSocket)connection, response.data() + sent, (int)(response.size() - sent), 0);
+		if (count <= 0)
+			break;
+		sent += (size_t)count;
+	}
+	servedCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Buckets are cumulative in the format, each counts the frames at or below its bound
+static void writeHistogram(std::ostringstream& out, const char* name, const char* help, const std::atomic<uint64_t>* counts,
+	uint64_t sumMicroseconds)
+{
+	out << "# HELP " << name << " " << help << "\n# TYPE " << name << " histogram\n";
+	uint64_t cumulative = 0;
+	for (size_t i = 0; i < MetricsServer::BUCKETS; i++)
+	{
+		cumulative += counts[i].load(std::memory_order_relaxed);
+		out << name << "_bucket{le=\"" << MetricsServer::BUCKET_MILLISECONDS[i] << "\"} " << cumulative << "\n";
+	}
+	cumulative += counts[MetricsServer::BUCKETS].load(std::memory_order_relaxed);
+	out << name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+	out << name << "_sum " << (double)sumMicroseconds / 1000.0 << "\n";
+	out << name << "_count " << cumulative << "\n";
+}
+
+// A gauge or counter with one value
+static void writeValue(std::ostringstream& out, const char* name, const char* type, const char* help, uint64_t value)
+{
+	out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n" << name << " " << value << "\n";
+}
+
+// The whole text of a scrape
+std::string MetricsServer::text()
+{
+	Sample sample;
+	{
+		std::lock_guard<std::mutex> lock(latestMutex);
+		sample = latest;
+	}
+	std::ostringstream out;
+	writeValue(out, "city_frames_total", "counter", "Frames rendered.", frames.load(std::memory_order_relaxed));
+	writeHistogram(out, "city_frame_cpu_milliseconds", "CPU time of the render thread's frames.", cpuFrames.counts,
+		cpuFrames.sumMicroseconds.load(std::memory_order_relaxed));
+	writeHistogram(out, "city_frame_gpu_milliseconds", "GPU time of the frames' profiler zones.", gpuFrames.counts,
+		gpuFrames.sumMicroseconds.load(std::memory_order_relaxed));
+	out << "# HELP city_gpu_memory_bytes Bytes of GPU memory the engine allocated.\n# TYPE city_gpu_memory_bytes gauge\n";
+	for (int i = 0; i < GPU_MEMORY_CATEGORIES; i++)
+		out << "city_gpu_memory_bytes{category=\"" << GpuMemoryTracker::CategoryName((GpuMemoryCategory)i) << "\"} " << sample.gpuBytes[i] << "\n";
+	writeValue(out, "city_draw_calls", "gauge", "Draw calls of the last frame.", sample.draws);
+	writeValue(out, "city_draw_instances", "gauge", "Instances drawn in the last frame.", sample.instances);
+	writeValue(out, "city_draw_triangles", "gauge", "Triangles drawn in the last frame.", sample.triangles);
+	writeValue(out, "city_texture_queue_depth", "gauge", "Images queued, decoding or waiting for upload.", sample.texturesPending);
+	writeValue(out, "city_tile_queue_depth", "gauge", "Tiles loading or waiting for upload.", sample.tilesPending);
+	writeValue(out, "city_hitches_total", "counter", "Frames over the hitch threshold.", sample.hitches);
+	return out.str();
+}
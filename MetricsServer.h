@@ -0,0 +1,85 @@
+#ifndef METRICS_SERVER_CLASS_H
+#define METRICS_SERVER_CLASS_H
+
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<thread>
+
+#include"GpuMemory.h"
+
+// Serves the engine's numbers over HTTP in the Prometheus text format, so a fleet of display machines can be
+// scraped like any other service. GET /metrics answers with histograms of the CPU and GPU frame times, the GPU
+// memory per category, the draws of the last frame, the depth of the streaming queues and the hitches counted.
+// The render thread hands in one Sample per frame: the histograms are atomic counters it adds to and the rest is
+// copied under a lock it only tries to take, so publishing never waits and never allocates. The text is made and
+// sent on a thread of the server's own, one connection at a time.
+class MetricsServer
+{
+public:
+	// Upper bounds of the frame time buckets in milliseconds, one more bucket counts everything above
+	static constexpr size_t BUCKETS = 10;
+	static const double BUCKET_MILLISECONDS[BUCKETS];
+
+	// What the render thread measured in a frame, times are negative when there were none
+	struct Sample
+	{
+		float cpuMilliseconds = -1.0f;
+		float gpuMilliseconds = -1.0f;
+		int64_t gpuBytes[GPU_MEMORY_CATEGORIES] = {};
+		uint64_t draws = 0;
+		uint64_t instances = 0;
+		uint64_t triangles = 0;
+		uint64_t texturesPending = 0;
+		uint64_t tilesPending = 0;
+		uint64_t hitches = 0;
+	};
+
+	// Constructor that listens on the port on every interface and starts the thread, isOpen tells if that worked
+	MetricsServer(unsigned short port);
+	// Stops the thread unless Delete was already called
+	~MetricsServer();
+	// The thread points back at the server, so it can be neither copied nor moved
+	MetricsServer(const MetricsServer&) = delete;
+	MetricsServer& operator=(const MetricsServer&) = delete;
+
+	// Whether the socket could be bound
+	bool isOpen() const;
+	// Render thread: adds a frame to the histograms and makes its numbers the ones served
+	void Publish(const Sample& sample);
+	// Requests answered so far
+	uint64_t served() const;
+
+	// Stops the thread and closes the socket, does nothing if that was already done
+	void Delete();
+private:
+	// Counts per bucket, the last one past every bound, and the sums in microseconds
+	struct Histogram
+	{
+		std::atomic<uint64_t> counts[BUCKETS + 1] = {};
+		std::atomic<uint64_t> sumMicroseconds{ 0 };
+		void Add(float milliseconds);
+	};
+
+	Histogram cpuFrames;
+	Histogram gpuFrames;
+	std::atomic<uint64_t> frames{ 0 };
+	std::mutex latestMutex;
+	Sample latest;
+	std::atomic<uint64_t> servedCount{ 0 };
+	std::atomic<bool> stopping{ false };
+	// Native socket handle, invalid when it could not be opened
+	intptr_t socket;
+	std::thread thread;
+
+	// Loop of the thread, wakes up a few times a second to see if it has to stop
+	void serve();
+	// Answers one connection
+	void answer(intptr_t connection);
+	// The whole text of a scrape
+	std::string text();
+};
+
+#endif
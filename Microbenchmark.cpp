@@ -0,0 +1,333 @@
+#include"Microbenchmark.h"
+#include"CityGenerator.h"
+#include"CompactInstance.h"
+#include"Frustum.h"
+#include"ImageConvert.h"
+#include"InstanceKernels.h"
+#include"MeshOptimizer.h"
+#include"ObjModel.h"
+#include"Quadtree.h"
+
+#include<stb/stb_image.h>
+#include<glm/gtc/matrix_transform.hpp>
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<filesystem>
+#include<fstream>
+#include<iomanip>
+#include<iostream>
+#include<iterator>
+#include<memory>
+
+// Adds a kernel
+void Microbenchmark::Add(const std::string& name, const std::string& unit, bool parallel, Setup setup)
+{
+	kernels.push_back({ name, unit, parallel, std::move(setup) });
+}
+
+// Runs the matching kernels, a parallel kernel's first count is the one its scaling is measured against
+std::vector<Microbenchmark::Result> Microbenchmark::Run(const std::string& filter, const std::vector<unsigned int>& coreCounts) const
+{
+	std::vector<Result> results;
+	for (const Kernel& kernel : kernels)
+	{
+		if (kernel.name.find(filter) == std::string::npos)
+			continue;
+		double baseline = 0.0;
+		for (unsigned int cores : coreCounts)
+		{
+			if (!kernel.parallel && cores != 1)
+				continue;
+			Result result = measure(kernel, cores);
+			if (baseline == 0.0)
+				baseline = result.itemsPerSecondPerCore * (double)result.cores;
+			result.scaling = baseline > 0.0 ? result.itemsPerSecond / baseline : 1.0;
+			std::cout << std::left << std::setw(20) << result.name << std::right << std::setw(3) << result.cores << " cores "
+				<< std::fixed << std::setprecision(3) << std::setw(12) << result.nanosecondsPerIteration / 1e6 << " ms "
+				<< std::setprecision(2) << std::setw(10) << result.itemsPerSecond / 1e6 << " M " << result.unit << "/s "
+				<< std::setw(8) << result.itemsPerSecondPerCore / 1e6 << " M/s per core, x" << result.scaling
+				<< " over " << result.iterations << " iterations" << std::defaultfloat << std::setprecision(6) << std::endl;
+			results.push_back(result);
+		}
+	}
+	return results;
+}
+
+// The first iteration warms the caches and the workers' queues and is not counted
+Microbenchmark::Result Microbenchmark::measure(const Kernel& kernel, unsigned int cores) const
+{
+	JobSystem jobs(cores > 0 ? cores - 1 : 0);
+	Iteration iteration = kernel.setup(jobs);
+	size_t items = iteration();
+	size_t iterations = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	double seconds = 0.0;
+	do
+	{
+		items = iteration();
+		iterations++;
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	} while (seconds < minSeconds);
+
+	Result result;
+	result.name = kernel.name;
+	result.unit = kernel.unit;
+	result.cores = std::max(cores, 1u);
+	result.iterations = iterations;
+	result.nanosecondsPerIteration = seconds * 1e9 / (double)iterations;
+	result.itemsPerSecond = (double)items * (double)iterations / std::max(seconds, 1e-9);
+	result.itemsPerSecondPerCore = result.itemsPerSecond / (double)result.cores;
+	result.scaling = 1.0;
+	return result;
+}
+
+// Puts the results into a report
+void Microbenchmark::Report(const std::vector<Result>& results, BenchmarkReport& report)
+{
+	for (const Result& result : results)
+	{
+		std::string name = result.name;
+		std::replace(name.begin(), name.end(), ' ', '_');
+		report.Set(name + "_" + std::to_string(result.cores) + "c_ns", result.nanosecondsPerIteration);
+	}
+}
+
+// Layout of the city the kernels work on, 16384 buildings
+static CityLayout kernelLayout()
+{
+	CityLayout layout;
+	layout.blocksX = 32;
+	layout.blocksZ = 32;
+	layout.lotsPerSide = 4;
+	layout.maxHeight = 12.0f;
+	layout.facadeCount = 8;
+	return layout;
+}
+
+// A camera at street level in the middle of the city looking along a diagonal, turned by yaw radians
+static Frustum kernelFrustum(float yaw)
+{
+	glm::vec3 eye(0.0f, 1.7f, 0.0f);
+	glm::vec3 front(std::cos(yaw), -0.1f, std::sin(yaw));
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f);
+	Frustum frustum;
+	frustum.Extract(projection * glm::lookAt(eye, eye + front, glm::vec3(0.0f, 1.0f, 0.0f)));
+	return frustum;
+}
+
+// Every kernel keeps its data in a shared_ptr the iteration captures, so the iteration can be copied around freely
+void Microbenchmark::AddEngineKernels()
+{
+	Add("frustum cull", "boxes", true, [](JobSystem& jobs) {
+		CityGenerator city(kernelLayout());
+		auto boxes = std::make_shared<BoundingBoxes>();
+		for (size_t i = 0; i < city.buildingCount(); i++)
+		{
+			Building b = city.building(i);
+			boxes->Add(glm::vec3(b.minX, 0.0f, b.minZ), glm::vec3(b.maxX, b.height, b.maxZ));
+		}
+		auto visible = std::make_shared<std::vector<uint32_t>>(boxes->size());
+		Frustum frustum = kernelFrustum(0.7f);
+		return Iteration([&jobs, boxes, visible, frustum]() {
+			jobs.ParallelFor(boxes->size(), 1024, [&](size_t, size_t begin, size_t end) {
+				frustum.Cull(*boxes, begin, end - begin, visible->data() + begin);
+			});
+			return boxes->size();
+		});
+	});
+
+	Add("quadtree build", "items", false, [](JobSystem&) {
+		CityGenerator city(kernelLayout());
+		auto buildings = std::make_shared<std::vector<Building>>();
+		for (size_t i = 0; i < city.buildingCount(); i++)
+			buildings->push_back(city.building(i));
+		float half = std::max(city.halfExtentX(), city.halfExtentZ());
+		return Iteration([buildings, half]() {
+			Quadtree tree(glm::vec2(-half), 2.0f * half);
+			for (size_t i = 0; i < buildings->size(); i++)
+			{
+				const Building& b = (*buildings)[i];
+				tree.Insert((uint32_t)i, glm::vec3(b.minX, 0.0f, b.minZ), glm::vec3(b.maxX, b.height, b.maxZ));
+			}
+			tree.Build();
+			return buildings->size();
+		});
+	});
+
+	// 256 cameras turning around the middle of the city, each query writes into the slice's own array
+	Add("quadtree query", "queries", true, [](JobSystem& jobs) {
+		CityGenerator city(kernelLayout());
+		float half = std::max(city.halfExtentX(), city.halfExtentZ());
+		auto tree = std::make_shared<Quadtree>(glm::vec2(-half), 2.0f * half);
+		for (size_t i = 0; i < city.buildingCount(); i++)
+		{
+			Building b = city.building(i);
+			tree->Insert((uint32_t)i, glm::vec3(b.minX, 0.0f, b.minZ), glm::vec3(b.maxX, b.height, b.maxZ));
+		}
+		tree->Build();
+		const size_t QUERIES = 256;
+		auto frustums = std::make_shared<std::vector<Frustum>>();
+		for (size_t i = 0; i < QUERIES; i++)
+			frustums->push_back(kernelFrustum(6.2831853f * (float)i / (float)QUERIES));
+		auto results = std::make_shared<std::vector<std::vector<uint32_t>>>(jobs.Slices(QUERIES, 1), std::vector<uint32_t>(city.buildingCount()));
+		return Iteration([&jobs, tree, frustums, results]() {
+			jobs.ParallelFor(frustums->size(), 1, [&](size_t slice, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+					tree->QueryFrustum((*frustums)[i], (*results)[slice].data());
+			});
+			return frustums->size();
+		});
+	});
+
+	Add("city generate", "buildings", true, [](JobSystem& jobs) {
+		auto city = std::make_shared<CityGenerator>(kernelLayout());
+		auto vertices = std::make_shared<std::vector<GLfloat>>(city->vertexCount() * CityGenerator::VERTEX_FLOATS);
+		auto indices = std::make_shared<std::vector<GLuint>>(city->indexCount());
+		return Iteration([&jobs, city, vertices, indices]() {
+			city->Generate(vertices->data(), indices->data(), jobs);
+			return city->buildingCount();
+		});
+	});
+
+	// The merged mesh of a quarter of the city written out as an OBJ file once, parsed without the cache every time
+	Add("obj parse", "bytes", true, [](JobSystem& jobs) {
+		CityLayout layout = kernelLayout();
+		layout.blocksX = layout.blocksZ = 16;
+		CityGenerator city(layout);
+		std::vector<GLfloat> vertices(city.vertexCount() * CityGenerator::VERTEX_FLOATS);
+		std::vector<GLuint> indices(city.indexCount());
+		city.Generate(vertices.data(), indices.data());
+		// The file goes once the last iteration holding its path does
+		std::shared_ptr<std::string> path(new std::string((std::filesystem::temp_directory_path() / "microbenchmark_city.obj").string()),
+			[](std::string* written) {
+				std::error_code error;
+				std::filesystem::remove(*written, error);
+				delete written;
+			});
+		{
+			std::ofstream file(*path, std::ios::binary);
+			for (size_t v = 0; v < city.vertexCount(); v++)
+			{
+				const GLfloat* vertex = &vertices[v * CityGenerator::VERTEX_FLOATS];
+				file << "v " << vertex[0] << " " << vertex[1] << " " << vertex[2] << "\nvt " << vertex[3] << " " << vertex[4] << "\n";
+			}
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+				file << "f " << indices[t] + 1 << "/" << indices[t] + 1 << " " << indices[t + 1] + 1 << "/" << indices[t + 1] + 1
+					<< " " << indices[t + 2] + 1 << "/" << indices[t + 2] + 1 << "\n";
+		}
+		size_t bytes = (size_t)std::filesystem::file_size(*path);
+		return Iteration([&jobs, path, bytes]() {
+			ObjModel model;
+			model.Load(*path, jobs, false);
+			return bytes;
+		});
+	});
+
+	// The optimizer works in place, so each iteration starts from a copy of the unoptimized order
+	Add("mesh optimize", "triangles", false, [](JobSystem&) {
+		CityLayout layout = kernelLayout();
+		layout.blocksX = layout.blocksZ = 8;
+		CityGenerator city(layout);
+		auto vertices = std::make_shared<std::vector<GLfloat>>(city.vertexCount() * CityGenerator::VERTEX_FLOATS);
+		auto indices = std::make_shared<std::vector<GLuint>>(city.indexCount());
+		city.Generate(vertices->data(), indices->data());
+		// Triangles in reverse so there is something to reorder
+		for (size_t t = 0; t < indices->size() / 6; t++)
+			std::swap_ranges(indices->begin() + t * 3, indices->begin() + t * 3 + 3, indices->end() - (t + 1) * 3);
+		auto workVertices = std::make_shared<std::vector<GLfloat>>();
+		auto workIndices = std::make_shared<std::vector<GLuint>>();
+		return Iteration([vertices, indices, workVertices, workIndices]() {
+			*workVertices = *vertices;
+			*workIndices = *indices;
+			MeshOptimizer::Optimize(workVertices->data(), workVertices->size() / CityGenerator::VERTEX_FLOATS, CityGenerator::VERTEX_FLOATS,
+				workIndices->data(), workIndices->size());
+			return workIndices->size() / 3;
+		});
+	});
+
+	// The facade image decoded and widened to RGBA on every core, 16 times per iteration
+	Add("image decode", "pixels", true, [](JobSystem& jobs) {
+		std::ifstream file("res_wall_01_color.jpg", std::ios::binary);
+		auto encoded = std::make_shared<std::vector<unsigned char>>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		int width = 0, height = 0, channels = 0;
+		stbi_info_from_memory(encoded->data(), (int)encoded->size(), &width, &height, &channels);
+		const size_t IMAGES = 16;
+		auto rgba = std::make_shared<std::vector<std::vector<uint8_t>>>(IMAGES, std::vector<uint8_t>((size_t)width * height * 4));
+		return Iteration([&jobs, encoded, rgba, width, height]() {
+			if (encoded->empty())
+				return (size_t)0;
+			jobs.ParallelFor(rgba->size(), 1, [&](size_t, size_t begin, size_t end) {
+				for (size_t i = begin; i < end; i++)
+				{
+					int w, h, n;
+					stbi_uc* pixels = stbi_load_from_memory(encoded->data(), (int)encoded->size(), &w, &h, &n, 0);
+					if (pixels && w == width && h == height)
+						ImageConvert::ToRGBA(pixels, w, h, n, true, (*rgba)[i].data());
+					stbi_image_free(pixels);
+				}
+			});
+			return rgba->size() * (size_t)width * height;
+		});
+	});
+
+	Add("instance pack", "records", true, [](JobSystem& jobs) {
+		CityGenerator city(kernelLayout());
+		auto records = std::make_shared<std::vector<GLfloat>>(city.buildingCount() * CityGenerator::INSTANCE_FLOATS);
+		city.GenerateInstances(records->data());
+		auto packed = std::make_shared<std::vector<CompactInstance>>(city.buildingCount());
+		return Iteration([&jobs, records, packed]() {
+			jobs.ParallelFor(packed->size(), 1024, [&](size_t, size_t begin, size_t end) {
+				CompactInstance::Pack(records->data() + begin * CityGenerator::INSTANCE_FLOATS, end - begin, packed->data() + begin);
+			});
+			return packed->size();
+		});
+	});
+
+	// The same records kept as arrays of each value, packed by the batch kernels
+	Add("instance kernels", "records", true, [](JobSystem& jobs) {
+		CityGenerator city(kernelLayout());
+		std::vector<GLfloat> records(city.buildingCount() * CityGenerator::INSTANCE_FLOATS);
+		city.GenerateInstances(records.data());
+		struct Columns
+		{
+			std::vector<float> values[7];
+			std::vector<uint16_t> layer;
+			std::vector<uint32_t> colors;
+			InstanceKernels::Arrays arrays;
+		};
+		auto columns = std::make_shared<Columns>();
+		size_t count = city.buildingCount();
+		for (std::vector<float>& values : columns->values)
+			values.resize(count);
+		columns->layer.resize(count);
+		columns->colors.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			const GLfloat* record = &records[i * CityGenerator::INSTANCE_FLOATS];
+			columns->values[0][i] = record[0] + 0.5f * record[3];
+			columns->values[1][i] = record[1];
+			columns->values[2][i] = record[2] + 0.5f * record[5];
+			for (int axis = 0; axis < 3; axis++)
+				columns->values[3 + axis][i] = record[3 + axis];
+			columns->values[6][i] = record[7];
+			columns->layer[i] = (uint16_t)record[6];
+			columns->colors[i] = InstanceKernels::PackColor(record + 8);
+		}
+		InstanceKernels::Arrays& arrays = columns->arrays;
+		arrays.x = columns->values[0].data();
+		arrays.y = columns->values[1].data();
+		arrays.z = columns->values[2].data();
+		arrays.width = columns->values[3].data();
+		arrays.height = columns->values[4].data();
+		arrays.depth = columns->values[5].data();
+		arrays.fade = columns->values[6].data();
+		arrays.layer = columns->layer.data();
+		arrays.colors = columns->colors.data();
+		auto packed = std::make_shared<std::vector<CompactInstance>>(count);
+		return Iteration([&jobs, columns, packed]() {
+			InstanceKernels::Pack(jobs, columns->arrays, packed->size(), packed->data());
+			return packed->size();
+		});
+	});
+}
@@ -0,0 +1,68 @@
+#ifndef MICROBENCHMARK_CLASS_H
+#define MICROBENCHMARK_CLASS_H
+
+#include<cstddef>
+#include<functional>
+#include<string>
+#include<vector>
+
+#include"BenchmarkReport.h"
+#include"JobSystem.h"
+
+// Times the CPU kernels of the engine on their own, so a kernel that got slower shows up before it reaches the frame
+// time. A kernel is set up outside the timing and hands back one iteration, which returns the items it processed.
+// Each iteration is repeated until minSeconds have passed. Kernels that split their work over the job system run
+// once per thread count, and report their throughput per core and their speedup over one core next to the time.
+// The results go into a BenchmarkReport, so two builds are compared with --compare-reports like whole frames are.
+class Microbenchmark
+{
+public:
+	// One run of the timed work, returns the items it processed
+	typedef std::function<size_t()> Iteration;
+	// Prepares a kernel for a job system of a given size, the data it makes lives in what the iteration captures
+	typedef std::function<Iteration(JobSystem& jobs)> Setup;
+
+	// One kernel at one thread count
+	struct Result
+	{
+		std::string name;
+		// What an item is, such as boxes or pixels
+		std::string unit;
+		// Threads working on the iterations, the caller included
+		unsigned int cores;
+		size_t iterations;
+		double nanosecondsPerIteration;
+		double itemsPerSecond;
+		double itemsPerSecondPerCore;
+		// Items per second over those of the same kernel on one core, 1 for serial kernels
+		double scaling;
+	};
+
+	// Seconds every kernel is repeated for at each thread count
+	double minSeconds = 0.5;
+
+	// Adds a kernel, parallel ones are run at every thread count and serial ones on one core
+	void Add(const std::string& name, const std::string& unit, bool parallel, Setup setup);
+	// Adds the culling, spatial index, city generation, OBJ parsing, mesh optimization, image decoding and instance
+	// packing kernels of the engine
+	void AddEngineKernels();
+
+	// Runs the kernels whose name contains filter at each count of cores, printing each result as it comes
+	std::vector<Result> Run(const std::string& filter, const std::vector<unsigned int>& coreCounts) const;
+	// Puts the nanoseconds per iteration of every result into a report as <name>_<cores>c_ns
+	static void Report(const std::vector<Result>& results, BenchmarkReport& report);
+private:
+	struct Kernel
+	{
+		std::string name;
+		std::string unit;
+		bool parallel;
+		Setup setup;
+	};
+	std::vector<Kernel> kernels;
+
+	// Times one kernel on a job system of cores - 1 workers
+	Result measure(const Kernel& kernel, unsigned int cores) const;
+};
+
+#endif
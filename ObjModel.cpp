@@ -0,0 +1,439 @@
+#include"ObjModel.h"
+
+#include<algorithm>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<unordered_map>
+#include<glm/glm.hpp>
+
+namespace fs = std::filesystem;
+
+// Cache blocks start at multiples of this, like the blocks of a scene file
+static const uint64_t BLOCK_ALIGNMENT = 16;
+
+// One corner of a face, the position and texture coordinate it uses counting from 0
+// Indices the file wrote relative to the vertices read so far count from the start of the chunk instead, since the
+// chunk does not know how many came before it, they may be below 0 for vertices of earlier chunks
+// A missing texture coordinate is -1 and not relative
+struct ObjCorner
+{
+	int64_t position;
+	int64_t texcoord;
+	bool positionRelative;
+	bool texcoordRelative;
+};
+
+// What one chunk of the file holds
+struct ObjChunk
+{
+	std::vector<float> positions;
+	std::vector<float> texcoords;
+	// Three corners per triangle
+	std::vector<ObjCorner> corners;
+	bool valid = true;
+};
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static const char* skipSpaces(const char* at, const char* end)
+{
+	while (at < end && isSpace(*at))
+		at++;
+	return at;
+}
+
+// Parses a decimal float such as -12, 0.5, .25 or 1.5e-3, false if there is none at the start
+static bool parseFloat(const char*& at, const char* end, float& value)
+{
+	// Powers of ten exact in a double, larger exponents are multiplied together
+	static const double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	const char* p = at;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	bool any = false;
+	for (; p < end && *p >= '0' && *p <= '9'; p++, any = true)
+	{
+		// Digits past the 19th do not fit and only scale the value
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa)
+				digits++;
+		}
+		else
+			exponent++;
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = true)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa)
+					digits++;
+				exponent--;
+			}
+		}
+	}
+	if (!any)
+		return false;
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* e = p + 1;
+		bool negativeExponent = false;
+		if (e < end && (*e == '-' || *e == '+'))
+			negativeExponent = *e++ == '-';
+		if (e < end && *e >= '0' && *e <= '9')
+		{
+			int written = 0;
+			for (; e < end && *e >= '0' && *e <= '9'; e++)
+				written = std::min(written * 10 + (*e - '0'), 1000);
+			exponent += negativeExponent ? -written : written;
+			p = e;
+		}
+	}
+	double result = (double)mantissa;
+	int magnitude = exponent < 0 ? -exponent : exponent;
+	while (magnitude > 0 && result != 0.0)
+	{
+		int step = std::min(magnitude, 22);
+		result = exponent < 0 ? result / powers[step] : result * powers[step];
+		magnitude -= step;
+	}
+	value = (float)(negative ? -result : result);
+	at = p;
+	return true;
+}
+
+// Parses an integer index, false if there is none at the start
+static bool parseIndex(const char*& at, const char* end, int64_t& value)
+{
+	const char* p = at;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	if (p >= end || *p < '0' || *p > '9')
+		return false;
+	int64_t result = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+		result = result * 10 + (*p - '0');
+	value = negative ? -result : result;
+	at = p;
+	return true;
+}
+
+// Turns an index as written, starting at 1 or at -1 for the last one read, into the form ObjCorner stores
+// count is how many the chunk has read so far, false for the invalid index 0
+static bool cornerIndex(int64_t written, size_t count, int64_t& index, bool& relative)
+{
+	relative = written < 0;
+	index = relative ? (int64_t)count + written : written - 1;
+	return written != 0;
+}
+
+// Parses the lines from begin to end
+static void parseChunk(const char* begin, const char* end, ObjChunk& chunk)
+{
+	std::vector<ObjCorner> face;
+	const char* at = begin;
+	while (at < end)
+	{
+		const char* lineEnd = (const char*)memchr(at, '\n', end - at);
+		if (!lineEnd)
+			lineEnd = end;
+		const char* p = skipSpaces(at, lineEnd);
+		at = lineEnd + 1;
+		if (p + 1 >= lineEnd)
+			continue;
+
+		if (p[0] == 'v' && isSpace(p[1]))
+		{
+			float position[3] = { 0.0f, 0.0f, 0.0f };
+			p += 2;
+			for (int i = 0; i < 3; i++)
+			{
+				p = skipSpaces(p, lineEnd);
+				if (!parseFloat(p, lineEnd, position[i]))
+					chunk.valid = false;
+			}
+			chunk.positions.insert(chunk.positions.end(), position, position + 3);
+		}
+		else if (p[0] == 'v' && p[1] == 't' && p + 2 < lineEnd && isSpace(p[2]))
+		{
+			// A third coordinate of 3D textures is ignored
+			float texcoord[2] = { 0.0f, 0.0f };
+			p += 3;
+			for (int i = 0; i < 2; i++)
+			{
+				p = skipSpaces(p, lineEnd);
+				parseFloat(p, lineEnd, texcoord[i]);
+			}
+			chunk.texcoords.insert(chunk.texcoords.end(), texcoord, texcoord + 2);
+		}
+		else if (p[0] == 'f' && isSpace(p[1]))
+		{
+			face.clear();
+			p += 2;
+			for (;;)
+			{
+				p = skipSpaces(p, lineEnd);
+				int64_t written = 0;
+				if (!parseIndex(p, lineEnd, written))
+					break;
+				ObjCorner corner = { 0, -1, false, false };
+				if (!cornerIndex(written, chunk.positions.size() / 3, corner.position, corner.positionRelative))
+					chunk.valid = false;
+				// v/vt, v//vn or v/vt/vn, the normal is skipped
+				if (p < lineEnd && *p == '/')
+				{
+					p++;
+					if (parseIndex(p, lineEnd, written) && !cornerIndex(written, chunk.texcoords.size() / 2, corner.texcoord, corner.texcoordRelative))
+						chunk.valid = false;
+					if (p < lineEnd && *p == '/')
+					{
+						p++;
+						parseIndex(p, lineEnd, written);
+					}
+				}
+				face.push_back(corner);
+			}
+			// A fan around the first corner, which is right for the convex polygons OBJ exporters write
+			for (size_t i = 2; i < face.size(); i++)
+			{
+				chunk.corners.push_back(face[0]);
+				chunk.corners.push_back(face[i - 1]);
+				chunk.corners.push_back(face[i]);
+			}
+		}
+	}
+}
+
+// Loads a model, from its cache when that is newer than the model
+bool ObjModel::Load(const std::string& path, JobSystem& jobs, bool useCache)
+{
+	vertices.clear();
+	indices.clear();
+	cached = false;
+
+	std::error_code error;
+	uint64_t sourceSize = fs::file_size(path, error);
+	if (error)
+	{
+		std::cerr << "Failed to open model " << path << std::endl;
+		return false;
+	}
+	int64_t sourceTime = (int64_t)fs::last_write_time(path, error).time_since_epoch().count();
+	if (useCache && readCache(CachePath(path), sourceSize, sourceTime))
+	{
+		cached = true;
+		return true;
+	}
+
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		std::cerr << "Failed to map model " << path << std::endl;
+		return false;
+	}
+	if (!parse(file, jobs, path))
+		return false;
+	if (useCache && !writeCache(CachePath(path), sourceSize, sourceTime))
+		std::cerr << "Failed to write model cache " << CachePath(path) << std::endl;
+	return true;
+}
+
+// Parses the mapped model into vertices and indices
+bool ObjModel::parse(const MappedFile& file, JobSystem& jobs, const std::string& path)
+{
+	const char* text = (const char*)file.data();
+	const char* textEnd = text + file.size();
+
+	// Chunks start at the line after every CHUNK_BYTES, so a line is never split between two of them
+	std::vector<const char*> starts;
+	starts.push_back(text);
+	for (size_t offset = CHUNK_BYTES; offset < file.size(); offset += CHUNK_BYTES)
+	{
+		// A line longer than a chunk moves the search past its end
+		const char* from = std::max(text + offset, starts.back());
+		const char* lineEnd = (const char*)memchr(from, '\n', textEnd - from);
+		if (!lineEnd || lineEnd + 1 >= textEnd)
+			break;
+		starts.push_back(lineEnd + 1);
+	}
+	starts.push_back(textEnd);
+	std::vector<ObjChunk> chunks(starts.size() - 1);
+	jobs.ParallelFor(chunks.size(), 1, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+			parseChunk(starts[i], starts[i + 1], chunks[i]);
+	});
+
+	// Relative indices become absolute once every chunk knows how many positions and texture coordinates came before it
+	size_t positionCount = 0, texcoordCount = 0, cornerCount = 0;
+	std::vector<size_t> positionBase(chunks.size()), texcoordBase(chunks.size());
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		if (!chunks[i].valid)
+		{
+			std::cerr << "Model " << path << " has a malformed vertex or face" << std::endl;
+			return false;
+		}
+		positionBase[i] = positionCount;
+		texcoordBase[i] = texcoordCount;
+		positionCount += chunks[i].positions.size() / 3;
+		texcoordCount += chunks[i].texcoords.size() / 2;
+		cornerCount += chunks[i].corners.size();
+	}
+	if (cornerCount == 0 || cornerCount / 3 > 0xFFFFFFFFu)
+	{
+		std::cerr << "Model " << path << " has no faces" << std::endl;
+		return false;
+	}
+
+	// Corners sharing a position and texture coordinate become one vertex, the key packs both indices
+	std::unordered_map<uint64_t, GLuint> unique;
+	unique.reserve(cornerCount / 2);
+	indices.reserve(cornerCount);
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		for (const ObjCorner& corner : chunks[i].corners)
+		{
+			int64_t position = corner.position + (corner.positionRelative ? (int64_t)positionBase[i] : 0);
+			int64_t texcoord = corner.texcoord + (corner.texcoordRelative ? (int64_t)texcoordBase[i] : 0);
+			if (position < 0 || position >= (int64_t)positionCount || texcoord < -1 || texcoord >= (int64_t)texcoordCount)
+			{
+				std::cerr << "Model " << path << " has a face using a vertex it does not have" << std::endl;
+				vertices.clear();
+				indices.clear();
+				return false;
+			}
+			uint64_t key = (uint64_t)position << 32 | (uint64_t)(texcoord + 1);
+			auto inserted = unique.emplace(key, (GLuint)unique.size());
+			if (inserted.second)
+			{
+				// Positions and texture coordinates are looked up in the chunk they were read in, the last chunk
+				// starting at or before them, chunks that read none share their start with the next one
+				size_t positionChunk = std::upper_bound(positionBase.begin(), positionBase.end(), (size_t)position) - positionBase.begin() - 1;
+				const float* xyz = &chunks[positionChunk].positions[(position - positionBase[positionChunk]) * 3];
+				float u = 0.0f, v = 0.0f;
+				if (texcoord >= 0)
+				{
+					size_t texcoordChunk = std::upper_bound(texcoordBase.begin(), texcoordBase.end(), (size_t)texcoord) - texcoordBase.begin() - 1;
+					const float* uv = &chunks[texcoordChunk].texcoords[(texcoord - texcoordBase[texcoordChunk]) * 2];
+					u = uv[0];
+					v = uv[1];
+				}
+				const GLfloat vertex[CityGenerator::VERTEX_FLOATS] = { xyz[0], xyz[1], xyz[2], u, v };
+				vertices.insert(vertices.end(), vertex, vertex + CityGenerator::VERTEX_FLOATS);
+			}
+			indices.push_back(inserted.first->second);
+		}
+	}
+	normalize(texcoordCount > 0);
+	return true;
+}
+
+// Fits the vertices into the unit cube and fills in missing texture coordinates
+void ObjModel::normalize(bool hasTexcoords)
+{
+	const unsigned int stride = CityGenerator::VERTEX_FLOATS;
+	glm::vec3 min(vertices[0], vertices[1], vertices[2]), max = min;
+	for (size_t i = 0; i < vertices.size(); i += stride)
+	{
+		glm::vec3 position(vertices[i], vertices[i + 1], vertices[i + 2]);
+		min = glm::min(min, position);
+		max = glm::max(max, position);
+	}
+	// Flat models keep a zero extent instead of dividing by it
+	glm::vec3 extent = max - min;
+	glm::vec3 scale(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+	for (size_t i = 0; i < vertices.size(); i += stride)
+	{
+		for (int axis = 0; axis < 3; axis++)
+			vertices[i + axis] = (vertices[i + axis] - min[axis]) * scale[axis];
+		// Without texture coordinates the facade wraps around the sides like on the unit building, repeating every 2 units
+		if (!hasTexcoords)
+		{
+			vertices[i + 3] = (vertices[i] + vertices[i + 2]) * 0.5f;
+			vertices[i + 4] = vertices[i + 1] * 0.5f;
+		}
+	}
+}
+
+// Number of vertices
+GLuint ObjModel::vertexCount() const
+{
+	return (GLuint)(vertices.size() / CityGenerator::VERTEX_FLOATS);
+}
+
+// File the cache of a model goes to
+std::string ObjModel::CachePath(const std::string& path)
+{
+	return path + ".model";
+}
+
+// Maps the cache and copies its blocks, false if it is missing or made from another version of the model
+bool ObjModel::readCache(const std::string& path, uint64_t sourceSize, int64_t sourceTime)
+{
+	MappedFile file;
+	if (!file.Open(path) || file.size() < sizeof(CacheHeader))
+		return false;
+	const CacheHeader* header = (const CacheHeader*)file.data();
+	bool valid = header->magic == CACHE_MAGIC && header->version == CACHE_VERSION && header->vertexFloats == CityGenerator::VERTEX_FLOATS
+		&& header->sourceSize == sourceSize && header->sourceTime == sourceTime
+		&& header->sizes[0] % (CityGenerator::VERTEX_FLOATS * sizeof(GLfloat)) == 0 && header->sizes[1] % (3 * sizeof(GLuint)) == 0
+		&& header->sizes[0] > 0 && header->sizes[1] > 0;
+	for (int i = 0; valid && i < 2; i++)
+		valid = header->offsets[i] % BLOCK_ALIGNMENT == 0 && header->offsets[i] + header->sizes[i] <= file.size();
+	if (!valid)
+		return false;
+	const GLfloat* vertexData = (const GLfloat*)(file.data() + header->offsets[0]);
+	const GLuint* indexData = (const GLuint*)(file.data() + header->offsets[1]);
+	vertices.assign(vertexData, vertexData + header->sizes[0] / sizeof(GLfloat));
+	indices.assign(indexData, indexData + header->sizes[1] / sizeof(GLuint));
+	// A cache cut short or written by hand must not make drawing read past the vertices
+	GLuint count = vertexCount();
+	for (GLuint index : indices)
+	{
+		if (index >= count)
+		{
+			vertices.clear();
+			indices.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+// Writes the vertices and indices as a cache of the model
+bool ObjModel::writeCache(const std::string& path, uint64_t sourceSize, int64_t sourceTime) const
+{
+	CacheHeader header = {};
+	header.magic = CACHE_MAGIC;
+	header.version = CACHE_VERSION;
+	header.vertexFloats = CityGenerator::VERTEX_FLOATS;
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.sizes[0] = vertices.size() * sizeof(GLfloat);
+	header.sizes[1] = indices.size() * sizeof(GLuint);
+	header.offsets[0] = (sizeof(CacheHeader) + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+	header.offsets[1] = (header.offsets[0] + header.sizes[0] + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	const char padding[BLOCK_ALIGNMENT] = {};
+	file.write((const char*)&header, sizeof(header));
+	file.write(padding, header.offsets[0] - sizeof(header));
+	file.write((const char*)vertices.data(), header.sizes[0]);
+	file.write(padding, header.offsets[1] - header.offsets[0] - header.sizes[0]);
+	file.write((const char*)indices.data(), header.sizes[1]);
+	return (bool)file;
+}
@@ -0,0 +1,67 @@
+#ifndef OBJ_MODEL_CLASS_H
+#define OBJ_MODEL_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+#include"CityGenerator.h"
+#include"JobSystem.h"
+#include"MappedFile.h"
+
+// Mesh read from a Wavefront OBJ file, fitted into the unit cube so it can stand in for the unit building every
+// building instance is scaled from
+// The file is memory mapped and cut into chunks at line ends that the workers parse at the same time, with a float
+// parser of its own instead of streams. Corners that share a position and texture coordinate become one vertex of
+// CityGenerator::VERTEX_FLOATS floats, polygons are split into fans of triangles. Only v, vt and f lines are read,
+// OBJ normals are dropped since the scene's vertex layout has none.
+// The result is cached next to the model in a file laid out like the scene files, a header and 16 byte aligned
+// blocks exactly like the buffers they go into, and the next load maps that instead as long as the model did not change.
+class ObjModel
+{
+public:
+	// Start of every cache file, bumped version numbers are parsed again rather than misread
+	static constexpr uint32_t CACHE_MAGIC = 0x4C444F4D; // "MODL"
+	static constexpr uint32_t CACHE_VERSION = 1;
+	// Bytes of the file every parse job starts with, the chunk then runs to the next line end
+	static constexpr size_t CHUNK_BYTES = 1 << 20;
+
+	// Vertices in the layout of CityGenerator::Generate and the triangles over them
+	std::vector<GLfloat> vertices;
+	std::vector<GLuint> indices;
+	// Set if the last Load came out of the cache
+	bool cached = false;
+
+	// Loads a model, from its cache when that is newer than the model, otherwise parsing it with jobs and writing
+	// the cache, false with the reason on stderr if the file is missing or not a usable model
+	bool Load(const std::string& path, JobSystem& jobs, bool useCache = true);
+	// Number of vertices
+	GLuint vertexCount() const;
+	// File the cache of a model goes to
+	static std::string CachePath(const std::string& path);
+private:
+	// Stored at the start of the cache file
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexFloats;
+		uint32_t reserved;
+		// Size and modification time of the model the cache was made from
+		uint64_t sourceSize;
+		int64_t sourceTime;
+		// Byte offset and size of the vertex and the index block
+		uint64_t offsets[2];
+		uint64_t sizes[2];
+	};
+
+	// Parses the mapped model into vertices and indices
+	bool parse(const MappedFile& file, JobSystem& jobs, const std::string& path);
+	// Fits the vertices into the unit cube and fills in missing texture coordinates
+	void normalize(bool hasTexcoords);
+	bool readCache(const std::string& path, uint64_t sourceSize, int64_t sourceTime);
+	bool writeCache(const std::string& path, uint64_t sourceSize, int64_t sourceTime) const;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include"ObjectPicker.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<glm/gtc/matrix_transform.hpp>
+#include<iostream>
+
+// Constructor that creates the target and the pack buffers
+ObjectPicker::ObjectPicker()
+{
+	glGenRenderbuffers(1, &ids);
+	glBindRenderbuffer(GL_RENDERBUFFER, ids);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_R32UI, 1, 1);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	// Float depth keeps the pass exact under reverse-Z as well
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, 1, 1);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint bound;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, ids);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::OBJECT_PICKER::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, bound);
+
+	for (Slot& slot : slots)
+	{
+		glGenBuffers(1, &slot.buffer);
+		GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLuint), nullptr, GL_STREAM_READ);
+		GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, slot.buffer, sizeof(GLuint));
+	}
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Deletes the GL objects unless Delete was already called
+ObjectPicker::~ObjectPicker()
+{
+	Delete();
+}
+
+// Scales the pixel up to the whole clip space, in clip coordinates so it also works before the perspective divide
+glm::mat4 ObjectPicker::PickMatrix(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	glm::vec2 center(2.0f * (x + 0.5f) / width - 1.0f, 2.0f * (y + 0.5f) / height - 1.0f);
+	return glm::scale(glm::mat4(1.0f), glm::vec3((float)width, (float)height, 1.0f)) * glm::translate(glm::mat4(1.0f), glm::vec3(-center, 0.0f));
+}
+
+// Binds the cleared target
+bool ObjectPicker::Begin()
+{
+	if (slots[next].fence)
+		return false;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, 1, 1);
+	const GLuint none = 0;
+	glClearBufferuiv(GL_COLOR, 0, &none);
+	glDepthMask(GL_TRUE);
+	glClear(GL_DEPTH_BUFFER_BIT);
+	return true;
+}
+
+// Queues the readback of the pixel
+void ObjectPicker::End()
+{
+	Slot& slot = slots[next];
+	next = (next + 1) % SLOTS;
+	// With a pack buffer bound glReadPixels only queues the copy and returns
+	GLint read;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glReadPixels(0, 0, 1, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, read);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Maps the oldest readback once its fence has passed
+bool ObjectPicker::Poll(GLuint& id)
+{
+	Slot& slot = slots[oldest];
+	if (!slot.fence || glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+		return false;
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+	oldest = (oldest + 1) % SLOTS;
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	const GLuint* mapping = (const GLuint*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLuint), GL_MAP_READ_BIT);
+	id = mapping ? *mapping : 0;
+	if (mapping)
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	return mapping != nullptr;
+}
+
+// Deletes the GL objects
+void ObjectPicker::Delete()
+{
+	for (Slot& slot : slots)
+	{
+		if (slot.fence)
+			glDeleteSync(slot.fence);
+		slot.fence = nullptr;
+		if (slot.buffer != 0)
+			GLState.DeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+	}
+	if (ids != 0)
+		glDeleteRenderbuffers(1, &ids);
+	if (depth != 0)
+		glDeleteRenderbuffers(1, &depth);
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = ids = depth = 0;
+}
@@ -0,0 +1,62 @@
+#ifndef OBJECT_PICKER_CLASS_H
+#define OBJECT_PICKER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+// Finds the object under a pixel by drawing object IDs instead of colors, on demand and without stalling
+// Only the picked pixel is drawn: PickMatrix narrows the camera's projection to it, so the pass renders into a 1x1
+// R32UI target with its own depth and the GPU clips away nearly everything it is given. End queues a glReadPixels of
+// the pixel into a pixel pack buffer and fences it, Poll maps the buffer once the fence has passed, which is usually
+// the next frame, so neither the pass nor the readback ever waits for the GPU.
+// ID 0 is what nothing or the ground was drawn at, the IDs of objects are up to the caller.
+class ObjectPicker
+{
+public:
+	// Readbacks that can be in flight at once, a pick while every one is still waiting is dropped
+	static constexpr int SLOTS = 2;
+
+	// ID and depth target of one pixel
+	GLuint framebuffer = 0;
+	GLuint ids = 0;
+	GLuint depth = 0;
+
+	// Constructor that creates the target and the pack buffers
+	ObjectPicker();
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~ObjectPicker();
+	// An ObjectPicker owns its GL objects, so it cannot be copied
+	ObjectPicker(const ObjectPicker&) = delete;
+	ObjectPicker& operator=(const ObjectPicker&) = delete;
+
+	// Maps the pixel x, y, from the bottom left of a view of width by height, onto the whole of the target
+	// Put it in front of the camera's projection for the ID pass
+	static glm::mat4 PickMatrix(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	// Binds the target cleared to ID 0 and the current clear depth, false if every readback is still in flight,
+	// in which case nothing is bound and the pass should be skipped
+	bool Begin();
+	// Queues the readback of the pixel and binds the framebuffer and viewport that were bound before Begin
+	void End();
+	// Checks for the oldest finished readback without waiting, true with the ID drawn at its pixel
+	bool Poll(GLuint& id);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	// One readback, in flight while its fence is set
+	struct Slot
+	{
+		GLuint buffer = 0;
+		GLsync fence = nullptr;
+	};
+	Slot slots[SLOTS];
+	// Slot the next readback goes into and the oldest one still in flight
+	int next = 0;
+	int oldest = 0;
+	// Framebuffer and viewport Begin replaced
+	GLint previous = 0;
+	GLint viewport[4] = { 0, 0, 0, 0 };
+};
+
+#endif
@@ -0,0 +1,255 @@
+#include"OcclusionCuller.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLExtensions.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<string>
+#include<utility>
+#include<vector>
+
+// One invocation per candidate, phase 0 keeps last frame's visible ones and phase 1 tests all of them
+// The declarations come first, then DepthPyramid::TEST_SOURCE and the main function
+static const char* cullSource = R"(
+#version 430 core
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) readonly buffer Records { float records[]; };
+layout(std430, binding = 1) readonly buffer Ids { uint ids[]; };
+layout(std430, binding = 2) buffer Visibility { uint visible[]; };
+layout(std430, binding = 3) writeonly buffer Survivors { float survivors[]; };
+// Laid out like DrawElementsIndirectCommand, one per phase
+struct Command
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+layout(std430, binding = 4) buffer Commands { Command commands[]; };
+
+uniform uint phase;
+uniform uint firstRecord;
+uniform uint count;
+uniform uint recordFloats;
+uniform mat4 matrix;
+
+// Copies a record behind the ones a phase already let through
+void append(uint command, uint record)
+{
+    uint slot = commands[command].baseInstance + atomicAdd(commands[command].instanceCount, 1u);
+    for (uint f = 0u; f < recordFloats; f++)
+        survivors[slot * recordFloats + f] = records[record + f];
+}
+
+)";
+static const char* cullMainSource = R"(
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= count)
+        return;
+    uint id = ids[i];
+    uint record = (firstRecord + i) * recordFloats;
+    bool drawn = visible[id] != 0u;
+    if (phase == 0u)
+    {
+        if (drawn)
+            append(0u, record);
+        return;
+    }
+    vec3 low = vec3(records[record], records[record + 1u], records[record + 2u]);
+    vec3 high = low + vec3(records[record + 3u], records[record + 4u], records[record + 5u]);
+    bool visibleNow = !occluded(matrix, low, high);
+    visible[id] = visibleNow ? 1u : 0u;
+    if (visibleNow && !drawn)
+        append(1u, record);
+}
+)";
+
+// Size of one id region, storage buffer ranges have to start at a multiple of the alignment
+static GLsizeiptr idRegionSize(GLuint maxRecords)
+{
+	GLint alignment = 256;
+	if (GLExt.shaderStorage)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	GLsizeiptr size = std::max<GLsizeiptr>(maxRecords, 1) * sizeof(GLuint);
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+// Checks if the context has what the culler needs
+bool OcclusionCuller::Supported()
+{
+	return GLExt.computeShader && GLExt.shaderStorage && GLExt.multiDrawIndirect;
+}
+
+// Constructor that allocates every buffer and builds both programs
+OcclusionCuller::OcclusionCuller(GLuint maxRecords, GLuint recordFloats, GLuint idCount)
+	: ids(GL_SHADER_STORAGE_BUFFER, idRegionSize(maxRecords))
+{
+	OcclusionCuller::maxRecords = maxRecords;
+	OcclusionCuller::recordFloats = recordFloats;
+
+	// Phase one writes from the start and phase two behind the room phase one could use
+	glGenBuffers(1, &recordBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, recordBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * (GLsizeiptr)std::max<GLuint>(maxRecords, 1) * recordFloats * sizeof(float), nullptr, GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, recordBuffer, 2 * (int64_t)std::max<GLuint>(maxRecords, 1) * recordFloats * sizeof(float));
+
+	// Everything counts as visible before the first test, so the first frame draws it all in phase one
+	std::vector<GLuint> allVisible(std::max<GLuint>(idCount, 1), 1u);
+	glGenBuffers(1, &visibility);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, visibility);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, allVisible.size() * sizeof(GLuint), allVisible.data(), GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, visibility, (int64_t)(allVisible.size() * sizeof(GLuint)));
+
+	glGenBuffers(1, &commandBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, commandBuffer, 2 * sizeof(DrawElementsIndirectCommand));
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	std::string source = std::string(cullSource) + DepthPyramid::TEST_SOURCE + cullMainSource;
+	cullProgram = Shader::LinkCompute(source.c_str());
+	GLState.UseProgram(cullProgram);
+	glUniform1ui(glGetUniformLocation(cullProgram, "recordFloats"), recordFloats);
+	GLState.UseProgram(0);
+}
+
+// Deletes the GL objects unless Delete was already called
+OcclusionCuller::~OcclusionCuller()
+{
+	Delete();
+}
+
+// Takes over the GL objects of another culler, which is left empty
+OcclusionCuller::OcclusionCuller(OcclusionCuller&& other) noexcept
+	: ids(std::move(other.ids)), pyramid(std::move(other.pyramid))
+{
+	take(other);
+}
+
+// Deletes the current GL objects and takes over the ones of another culler
+OcclusionCuller& OcclusionCuller::operator=(OcclusionCuller&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ids = std::move(other.ids);
+		pyramid = std::move(other.pyramid);
+		take(other);
+	}
+	return *this;
+}
+
+// Takes over everything of another culler except its id ring and pyramid
+void OcclusionCuller::take(OcclusionCuller& other)
+{
+	recordBuffer = std::exchange(other.recordBuffer, 0);
+	reverseDepth = other.reverseDepth;
+	maxRecords = other.maxRecords;
+	recordFloats = other.recordFloats;
+	records = other.records;
+	firstRecord = other.firstRecord;
+	count = other.count;
+	visibility = std::exchange(other.visibility, 0);
+	commandBuffer = std::exchange(other.commandBuffer, 0);
+	cullProgram = std::exchange(other.cullProgram, 0);
+}
+
+// Waits until the GPU is done with the next id region
+GLuint* OcclusionCuller::MapIds()
+{
+	return (GLuint*)ids.Map();
+}
+
+// Phase one: keeps the candidates visible last frame
+void OcclusionCuller::Begin(GLuint records, GLuint firstRecord, GLuint count, const DrawCommandBuilder::Mesh& mesh)
+{
+	OcclusionCuller::records = records;
+	OcclusionCuller::firstRecord = firstRecord;
+	OcclusionCuller::count = std::min(count, maxRecords);
+	ids.Unmap(OcclusionCuller::count * sizeof(GLuint));
+
+	// Both commands start out empty, the test program counts their instances up
+	DrawElementsIndirectCommand commands[2];
+	for (GLuint phase = 0; phase < 2; phase++)
+	{
+		commands[phase].count = mesh.indexCount;
+		commands[phase].instanceCount = 0;
+		commands[phase].firstIndex = mesh.firstIndex;
+		commands[phase].baseVertex = mesh.baseVertex;
+		commands[phase].baseInstance = phase * maxRecords;
+	}
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(commands), commands);
+	GLState.CountUpload(sizeof(commands));
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	dispatch(0, glm::mat4(1.0f));
+}
+
+// Draws what a phase let through
+void OcclusionCuller::Draw(int phase, GLenum indexType)
+{
+	GLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)(phase * sizeof(DrawElementsIndirectCommand)), 1, 0);
+	GLState.CountDraw(0, 0);
+	GLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Phase two: builds the pyramid and tests every candidate
+void OcclusionCuller::Test(const glm::mat4& matrix, GLsizei width, GLsizei height)
+{
+	pyramid.reverseDepth = reverseDepth;
+	if (!pyramid.Build(width, height))
+		return;
+	dispatch(1, matrix);
+	pyramid.Unbind();
+	ids.Fence();
+}
+
+// Dispatches the test program for a phase
+void OcclusionCuller::dispatch(GLuint phase, const glm::mat4& matrix)
+{
+	if (count == 0)
+		return;
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, records);
+	GLState.BindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, ids.ID, ids.Offset(), ids.regionSize);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, visibility);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, recordBuffer);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, commandBuffer);
+
+	GLState.UseProgram(cullProgram);
+	glUniform1ui(glGetUniformLocation(cullProgram, "phase"), phase);
+	glUniform1ui(glGetUniformLocation(cullProgram, "firstRecord"), firstRecord);
+	glUniform1ui(glGetUniformLocation(cullProgram, "count"), count);
+	glUniformMatrix4fv(glGetUniformLocation(cullProgram, "matrix"), 1, GL_FALSE, glm::value_ptr(matrix));
+	pyramid.SetUniforms(cullProgram);
+	GLState.CountUniforms(4);
+	glDispatchCompute((count + 63) / 64, 1, 1);
+	// The survivors are read as instance attributes, the counts as draw commands and the visibility by the next dispatch
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	GLState.UseProgram(previousProgram);
+}
+
+// Deletes the GL objects
+void OcclusionCuller::Delete()
+{
+	GLuint buffers[] = { recordBuffer, visibility, commandBuffer };
+	for (GLuint buffer : buffers)
+		if (buffer != 0)
+			GLState.DeleteBuffers(1, &buffer);
+	recordBuffer = visibility = commandBuffer = 0;
+	ids.Delete();
+	pyramid.Delete();
+	if (cullProgram != 0)
+		GLState.DeleteProgram(cullProgram);
+	cullProgram = 0;
+}
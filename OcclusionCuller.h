@@ -0,0 +1,75 @@
+#ifndef OCCLUSION_CULLER_CLASS_H
+#define OCCLUSION_CULLER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+#include"DepthPyramid.h"
+#include"DrawCommandBuilder.h"
+#include"StreamBuffer.h"
+
+// Two phase occlusion culling against a hierarchical depth buffer, tested on the GPU with compute shaders.
+// Phase one draws the candidates that were visible last frame. The depth they leave is reduced into a pyramid
+// where every texel holds the farthest depth below it, and phase two tests every candidate's box against it,
+// drawing the ones that just became visible and keeping every candidate's result for the next frame.
+// Both phases write their survivors into recordBuffer and their instance count into an indirect command,
+// so nothing is ever read back to the CPU.
+class OcclusionCuller
+{
+public:
+	// Records the phases let through, point the instance attributes at offset 0 of it when drawing
+	GLuint recordBuffer = 0;
+	// Set when the depth buffer is reverse-Z, see ReverseDepth.h, before the first Test
+	bool reverseDepth = false;
+
+	// Checks if the context has compute shaders, storage buffers and multi draw indirect
+	static bool Supported();
+
+	// Constructor for up to maxRecords candidates per frame of recordFloats floats each, identified by ids below idCount
+	// The first six floats of every record have to be the translation and scale of its box, as CityGenerator writes them
+	OcclusionCuller(GLuint maxRecords, GLuint recordFloats, GLuint idCount);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~OcclusionCuller();
+	// An OcclusionCuller owns its GL objects, so it can be moved but not copied
+	OcclusionCuller(const OcclusionCuller&) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+	OcclusionCuller(OcclusionCuller&& other) noexcept;
+	OcclusionCuller& operator=(OcclusionCuller&& other) noexcept;
+
+	// Waits until the GPU is done with the next id region and returns where to write the id of every candidate
+	GLuint* MapIds();
+	// Phase one: takes count candidate records of mesh starting at record firstRecord of a buffer and keeps the ones visible last frame
+	void Begin(GLuint records, GLuint firstRecord, GLuint count, const DrawCommandBuilder::Mesh& mesh);
+	// Draws what phase 0 or 1 let through, with the mesh's VAO bound and its instance attributes on recordBuffer
+	// indexType is the type of the bound index buffer, such as GpuBufferHeap::indexType
+	void Draw(int phase, GLenum indexType = GL_UNSIGNED_INT);
+	// Phase two: builds the pyramid from the depth of the current framebuffer, which is width by height,
+	// and tests every candidate with matrix taking its boxes to clip space
+	void Test(const glm::mat4& matrix, GLsizei width, GLsizei height);
+
+	// Deletes the GL objects, does nothing if they were already deleted or moved from
+	void Delete();
+private:
+	GLuint maxRecords = 0;
+	GLuint recordFloats = 0;
+	// Candidates of the current frame
+	GLuint records = 0;
+	GLuint firstRecord = 0;
+	GLuint count = 0;
+	// Id of every candidate, streamed by the CPU
+	StreamBuffer ids;
+	// Whether every id passed the last test
+	GLuint visibility = 0;
+	// One DrawElementsIndirectCommand per phase
+	GLuint commandBuffer = 0;
+	// Pyramid the depth phase one leaves is reduced into
+	DepthPyramid pyramid;
+	GLuint cullProgram = 0;
+
+	// Dispatches the test program for a phase
+	void dispatch(GLuint phase, const glm::mat4& matrix);
+	// Takes over everything of another culler except its id ring and pyramid, which the move operations handle
+	void take(OcclusionCuller& other);
+};
+
+#endif
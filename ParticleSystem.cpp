@@ -0,0 +1,458 @@
+#include"ParticleSystem.h"
+#include"DrawCommandBuilder.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLExtensions.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<string>
+
+// What every program of the particles starts with, the particle layout and the FrameData block
+static const char* particleSource = R"(
+#version 430 core
+// Position and the seconds left to live in w, velocity and the kind in w
+struct Particle
+{
+    vec4 position;
+    vec4 velocity;
+};
+const uint RAIN = 1u;
+const uint SNOW = 2u;
+const uint SMOKE = 3u;
+// Snow that came to rest on something, it stays there and melts
+const uint SETTLED = 4u;
+const float SMOKE_LIFE = 6.0;
+const float SETTLED_LIFE = 4.0;
+// Per frame values shared by every program, laid out like FrameData.h
+layout(std140, binding = 0) uniform FrameData
+{
+    mat4 camMatrix;
+    mat4 view;
+    mat4 projection;
+    vec4 camPos;
+    vec4 lightPos;
+    vec4 lightColor;
+    mat4 sceneModel;
+    vec4 fogColor;
+    vec4 fogParams;
+    vec4 weather;
+    vec4 particleParams;
+    mat4 eyeMatrices[2];
+    vec4 sunDirection;
+    vec4 sunColor;
+};
+)";
+// The counts of both particle buffers as draw commands, then the dispatch of the simulation and in its w the number of
+// particles it moves
+static const char* stateSource = R"(
+struct Command
+{
+    uint count;
+    uint instanceCount;
+    uint first;
+    uint baseInstance;
+};
+layout(std430, binding = 3) buffer State
+{
+    Command commands[2];
+    uvec4 dispatchSize;
+};
+
+uniform uint current;
+uniform uint capacity;
+
+// Mixes the bits of a number so that neighbouring particles get unrelated values
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float random(uint x)
+{
+    return float(hash(x) >> 8) * (1.0 / 16777216.0);
+}
+)";
+// One invocation per particle that may start this frame, weather first and then smoke, appended to the current buffer
+static const char* emitSource = R"(
+layout(local_size_x = 64) in;
+layout(std430, binding = 0) writeonly buffer Particles { Particle particles[]; };
+layout(std430, binding = 2) readonly buffer Chimneys { vec4 chimneys[]; };
+
+uniform uint chimneyCount;
+uniform uint maxEmit;
+
+const float RAIN_FALL = 12.0;
+const float SNOW_FALL = 1.0;
+// Weather starts this far around the camera and this high above it
+const float SPREAD = 25.0;
+const float HEIGHT = 12.0;
+
+// Particles of a rate that start this frame, the fraction of one is left to chance
+uint emitted(float perSecond, uint seed)
+{
+    float count = max(perSecond, 0.0) * particleParams.y;
+    return min(uint(count) + (random(seed) < fract(count) ? 1u : 0u), maxEmit);
+}
+
+void main()
+{
+    uint seed = uint(particleParams.z);
+    uint weatherCount = weather.x > 0.5 ? emitted(weather.y, 2u * seed) : 0u;
+    uint smokeCount = chimneyCount > 0u ? emitted(particleParams.x * float(chimneyCount), 2u * seed + 1u) : 0u;
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= min(weatherCount + smokeCount, maxEmit))
+        return;
+    // The count may run past the capacity, the prepare pass clamps it back
+    uint slot = atomicAdd(commands[current].instanceCount, 1u);
+    if (slot >= capacity)
+        return;
+
+    uint h = hash(i ^ hash(seed + 0x9e3779b9u));
+    vec3 jitter = vec3(random(h + 1u), random(h + 2u), random(h + 3u)) * 2.0 - 1.0;
+    Particle p;
+    if (i < weatherCount)
+    {
+        // Upwind of a box over the camera by as far as the wind carries it before it reaches the camera's height
+        bool snow = weather.x > 1.5;
+        float fall = snow ? SNOW_FALL : RAIN_FALL;
+        float height = HEIGHT + 0.5 * HEIGHT * jitter.y;
+        vec3 start = camPos.xyz + vec3(SPREAD * jitter.x, height, SPREAD * jitter.z);
+        start.xz -= weather.zw * height / fall;
+        // Long enough to reach the ground, the simulation ends it there
+        p.position = vec4(start, (start.y - particleParams.w) / fall + 1.0);
+        p.velocity = vec4(weather.z, -fall * (1.0 + 0.1 * jitter.x), weather.w, float(snow ? SNOW : RAIN));
+    }
+    else
+    {
+        vec3 top = vec3(sceneModel * vec4(chimneys[(i - weatherCount) % chimneyCount].xyz, 1.0));
+        p.position = vec4(top + vec3(0.05 * jitter.x, 0.05, 0.05 * jitter.z), SMOKE_LIFE * (1.0 + 0.2 * jitter.y));
+        p.velocity = vec4(0.2 * jitter.x, 0.8 + 0.2 * jitter.y, 0.2 * jitter.z, float(SMOKE));
+    }
+    particles[slot] = p;
+}
+)";
+// Clamps the count of the current buffer, sizes the simulation's dispatch by it and empties the other buffer
+static const char* prepareSource = R"(
+layout(local_size_x = 1) in;
+
+void main()
+{
+    uint total = min(commands[current].instanceCount, capacity);
+    commands[current].instanceCount = total;
+    dispatchSize = uvec4((total + 63u) / 64u, 1u, 1u, total);
+    commands[1u - current].instanceCount = 0u;
+}
+)";
+// One invocation per particle of the current buffer, the ones still alive are appended to the other
+// The declarations come first, then DepthPyramid::TEST_SOURCE and the main function
+static const char* simulateSource = R"(
+layout(local_size_x = 64) in;
+layout(std430, binding = 0) readonly buffer Particles { Particle particles[]; };
+layout(std430, binding = 1) writeonly buffer Survivors { Particle survivors[]; };
+
+// 0 when there is no depth to collide with
+uniform int collide;
+
+const float SNOW_SWAY = 0.4;
+// How far behind the depth of its pixel a particle still counts as touching the surface, further back it is hidden
+// behind something nearer instead
+const float THICKNESS = 0.4;
+
+// Worked out once per work group
+shared mat4 inverseProjection;
+)";
+static const char* simulateMainSource = R"(
+// Checks if a point in world space is just behind the surface the depth buffer holds at its pixel
+bool hits(vec3 position)
+{
+    vec4 clip = camMatrix * vec4(position, 1.0);
+    if (clip.w <= 0.0)
+        return false;
+    vec3 ndc = clip.xyz / clip.w;
+    if (any(greaterThan(abs(ndc.xy), vec2(1.0))))
+        return false;
+    ivec2 size = textureSize(pyramid, 0);
+    float depth = texelFetch(pyramid, min(ivec2((ndc.xy * 0.5 + 0.5) * vec2(size)), size - 1), 0).r;
+    // Nothing was drawn there
+    if (reverseZ != 0 ? depth <= 0.0 : depth >= 1.0)
+        return false;
+    // clip.w is the distance along the view direction, the surface's comes back through the projection
+    vec4 surface = inverseProjection * vec4(ndc.xy, reverseZ != 0 ? depth : 2.0 * depth - 1.0, 1.0);
+    float surfaceDistance = -surface.z / surface.w;
+    return clip.w > surfaceDistance && clip.w < surfaceDistance + THICKNESS;
+}
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0u)
+        inverseProjection = inverse(projection);
+    barrier();
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= dispatchSize.w)
+        return;
+
+    Particle p = particles[i];
+    float seconds = particleParams.y;
+    uint kind = uint(p.velocity.w + 0.5);
+    p.position.w -= seconds;
+    if (kind == SNOW)
+    {
+        // Flakes drift with the wind and sway around it
+        p.velocity.xz = weather.zw + SNOW_SWAY * vec2(sin(2.3 * p.position.y + p.position.x), cos(1.7 * p.position.y + p.position.z));
+    }
+    else if (kind == SMOKE)
+    {
+        // Smoke slows down as it rises and the wind takes it along
+        p.velocity.xz = mix(p.velocity.xz, weather.zw, min(0.8 * seconds, 1.0));
+        p.velocity.y = mix(p.velocity.y, 0.3, min(0.5 * seconds, 1.0));
+    }
+    if (kind != SETTLED)
+    {
+        vec3 previous = p.position.xyz;
+        p.position.xyz += p.velocity.xyz * seconds;
+        // The ground where nothing on screen shows it
+        if (p.position.y < particleParams.w || (collide != 0 && hits(p.position.xyz)))
+        {
+            p.position.xyz = previous;
+            if (kind == RAIN)
+                return;
+            if (kind == SNOW)
+            {
+                p.velocity = vec4(0.0, 0.0, 0.0, float(SETTLED));
+                p.position.w = min(p.position.w, SETTLED_LIFE);
+            }
+            else
+                p.velocity = vec4(-0.5 * p.velocity.x, abs(p.velocity.y) + 0.5, -0.5 * p.velocity.z, p.velocity.w);
+        }
+    }
+    if (p.position.w <= 0.0)
+        return;
+    survivors[atomicAdd(commands[1u - current].instanceCount, 1u)] = p;
+}
+)";
+// One instance per particle, a quad facing the camera, rain stretched into a streak along its fall
+static const char* drawVertexSource = R"(
+layout(std430, binding = 0) readonly buffer Particles { Particle particles[]; };
+
+out vec2 Corner;
+out vec4 Color;
+out float Streak;
+
+void main()
+{
+    Particle p = particles[gl_InstanceID];
+    uint kind = uint(p.velocity.w + 0.5);
+    vec2 corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0 - 1.0;
+    vec3 right = vec3(view[0][0], view[1][0], view[2][0]);
+    vec3 up = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 position = p.position.xyz;
+    Streak = kind == RAIN ? 1.0 : 0.0;
+    if (kind == RAIN)
+    {
+        // As long as the drop falls in a sixtieth of a second, and as wide as a drop across the view
+        vec3 across = cross(p.velocity.xyz, position - camPos.xyz);
+        position += p.velocity.xyz * (0.5 / 60.0) * corner.y + 0.008 * corner.x * normalize(across + vec3(1e-6));
+        Color = vec4(0.7, 0.75, 0.85, 0.35);
+    }
+    else if (kind == SMOKE)
+    {
+        // Puffs grow and thin out as they age
+        float age = clamp(1.0 - p.position.w / SMOKE_LIFE, 0.0, 1.0);
+        position += (0.12 + 0.6 * age) * (right * corner.x + up * corner.y);
+        Color = vec4(0.35, 0.35, 0.37, 0.4 * (1.0 - age));
+    }
+    else
+    {
+        // Settled flakes fade away as they melt
+        float fade = kind == SETTLED ? clamp(p.position.w / SETTLED_LIFE, 0.0, 1.0) : 1.0;
+        position += 0.025 * (right * corner.x + up * corner.y);
+        Color = vec4(0.95, 0.95, 1.0, 0.9 * fade);
+    }
+    Corner = corner;
+    gl_Position = camMatrix * vec4(position, 1.0);
+}
+)";
+// Round soft particles, streaks soft across only, in premultiplied alpha
+static const char* drawFragmentSource = R"(
+#version 430 core
+in vec2 Corner;
+in vec4 Color;
+in float Streak;
+
+out vec4 FragColor;
+
+void main()
+{
+    float alpha = Color.a * (Streak > 0.5 ? 1.0 - abs(Corner.x) : smoothstep(1.0, 0.3, length(Corner)));
+    FragColor = vec4(Color.rgb * alpha, alpha);
+}
+)";
+
+// Checks if the context has what the particles need
+bool ParticleSystem::Supported()
+{
+	return GLExt.computeShader && GLExt.shaderStorage && GLExt.multiDrawIndirect;
+}
+
+// Constructor that allocates every buffer and builds the programs
+ParticleSystem::ParticleSystem(GLuint capacity, const std::vector<glm::vec3>& chimneys)
+{
+	ParticleSystem::capacity = std::max<GLuint>(capacity, 1);
+	chimneyCount = (GLuint)chimneys.size();
+
+	GLsizeiptr particleBytes = (GLsizeiptr)ParticleSystem::capacity * 2 * sizeof(glm::vec4);
+	glGenBuffers(2, particles);
+	for (GLuint buffer : particles)
+	{
+		GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, particleBytes, nullptr, GL_DYNAMIC_COPY);
+		GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, buffer, (int64_t)particleBytes);
+	}
+
+	// Padded to vec4, the std430 stride of a vec3 array
+	std::vector<glm::vec4> tops;
+	for (const glm::vec3& chimney : chimneys)
+		tops.emplace_back(chimney, 0.0f);
+	if (tops.empty())
+		tops.emplace_back(0.0f);
+	glGenBuffers(1, &chimneyBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, chimneyBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, tops.size() * sizeof(glm::vec4), tops.data(), GL_STATIC_DRAW);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, chimneyBuffer, (int64_t)(tops.size() * sizeof(glm::vec4)));
+
+	// Both buffers start empty, every command draws a quad per particle
+	struct State
+	{
+		DrawArraysIndirectCommand commands[2];
+		GLuint dispatchSize[4];
+	} state = {};
+	for (DrawArraysIndirectCommand& command : state.commands)
+		command.count = 4;
+	glGenBuffers(1, &stateBuffer);
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, stateBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(State), &state, GL_DYNAMIC_COPY);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, stateBuffer, sizeof(State));
+	GLState.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	std::string compute = std::string(particleSource) + stateSource;
+	emitProgram = Shader::LinkCompute((compute + emitSource).c_str());
+	prepareProgram = Shader::LinkCompute((compute + prepareSource).c_str());
+	simulateProgram = Shader::LinkCompute((compute + simulateSource + DepthPyramid::TEST_SOURCE + simulateMainSource).c_str());
+	drawProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, (std::string(particleSource) + drawVertexSource).c_str(), "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, drawFragmentSource, "FRAGMENT") });
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	for (GLuint program : { emitProgram, prepareProgram, simulateProgram })
+	{
+		GLState.UseProgram(program);
+		glUniform1ui(glGetUniformLocation(program, "capacity"), ParticleSystem::capacity);
+	}
+	GLState.UseProgram(emitProgram);
+	glUniform1ui(glGetUniformLocation(emitProgram, "chimneyCount"), chimneyCount);
+	glUniform1ui(glGetUniformLocation(emitProgram, "maxEmit"), MAX_EMIT);
+	GLState.UseProgram(previousProgram);
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+ParticleSystem::~ParticleSystem()
+{
+	Delete();
+}
+
+// Emits, then moves and compacts into the other buffer, which becomes the current one
+void ParticleSystem::Update(GLsizei width, GLsizei height)
+{
+	pyramid.reverseDepth = reverseDepth;
+	bool collide = pyramid.Build(width, height);
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLuint next = 1 - current;
+
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particles[current]);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, particles[next]);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, chimneyBuffer);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, stateBuffer);
+
+	GLState.UseProgram(emitProgram);
+	glUniform1ui(glGetUniformLocation(emitProgram, "current"), current);
+	GLState.CountUniforms(1);
+	glDispatchCompute(MAX_EMIT / 64, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	GLState.UseProgram(prepareProgram);
+	glUniform1ui(glGetUniformLocation(prepareProgram, "current"), current);
+	GLState.CountUniforms(1);
+	glDispatchCompute(1, 1, 1);
+	// The simulation reads its size as a dispatch command and the counts from the storage buffer
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+
+	GLState.UseProgram(simulateProgram);
+	glUniform1ui(glGetUniformLocation(simulateProgram, "current"), current);
+	glUniform1i(glGetUniformLocation(simulateProgram, "collide"), collide ? 1 : 0);
+	GLState.CountUniforms(2);
+	if (collide)
+		pyramid.SetUniforms(simulateProgram);
+	GLState.BindBuffer(GL_DISPATCH_INDIRECT_BUFFER, stateBuffer);
+	glDispatchComputeIndirect((GLintptr)(2 * sizeof(DrawArraysIndirectCommand)));
+	GLState.BindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+	// The survivors are read by the draw's vertex shader and counted in its command
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	if (collide)
+		pyramid.Unbind();
+
+	GLState.UseProgram(previousProgram);
+	current = next;
+}
+
+// Draws the current buffer with its command, blended in premultiplied alpha
+void ParticleSystem::Draw()
+{
+	GLint previousProgram, previousVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	GLboolean depthMask;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+
+	glDepthMask(GL_FALSE);
+	GLState.Enable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	GLState.UseProgram(drawProgram);
+	GLState.BindVertexArray(emptyVAO);
+	GLState.BindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particles[current]);
+	GLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, stateBuffer);
+	glDrawArraysIndirect(GL_TRIANGLE_STRIP, (void*)(current * sizeof(DrawArraysIndirectCommand)));
+	GLState.CountDraw(0, 0);
+	GLState.BindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	GLState.Disable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ZERO);
+	glDepthMask(depthMask);
+
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+}
+
+// Deletes the GL objects
+void ParticleSystem::Delete()
+{
+	GLuint buffers[] = { particles[0], particles[1], chimneyBuffer, stateBuffer };
+	for (GLuint& buffer : buffers)
+		if (buffer != 0)
+			GLState.DeleteBuffers(1, &buffer);
+	for (GLuint program : { emitProgram, prepareProgram, simulateProgram, drawProgram })
+		if (program != 0)
+			GLState.DeleteProgram(program);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	particles[0] = particles[1] = chimneyBuffer = stateBuffer = 0;
+	emitProgram = prepareProgram = simulateProgram = drawProgram = emptyVAO = 0;
+	pyramid.Delete();
+}
@@ -0,0 +1,66 @@
+#ifndef PARTICLE_SYSTEM_CLASS_H
+#define PARTICLE_SYSTEM_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+
+#include"DepthPyramid.h"
+
+// Rain or snow falling around the camera and smoke rising from chimneys, every particle made, moved and drawn on the GPU.
+// Particles live in two storage buffers taken in turns: each frame an emit pass appends the new ones to the current
+// buffer, a one invocation pass turns its count into the dispatch of the simulation, and the simulation moves every
+// particle and appends the ones still alive to the other buffer, which then holds exactly what is drawn. Both counts
+// are the instance counts of indirect draw commands, so nothing is ever read back.
+// Particles collide with the depth buffer of the frame through a DepthPyramid of it: rain stops, snow settles for a
+// while and smoke is pushed back up. The CPU only writes the emitters into FrameData::weather and particleParams.
+class ParticleSystem
+{
+public:
+	// Kinds of weather FrameData::weather.x selects
+	static constexpr int WEATHER_NONE = 0;
+	static constexpr int WEATHER_RAIN = 1;
+	static constexpr int WEATHER_SNOW = 2;
+	// Most particles one frame can start, the emit pass is dispatched for this many
+	static constexpr GLuint MAX_EMIT = 16384;
+
+	// Set when the depth buffer is reverse-Z, see ReverseDepth.h, before the first Update
+	bool reverseDepth = false;
+
+	// Checks if the context has compute shaders, storage buffers and indirect draws and dispatches
+	static bool Supported();
+
+	// Constructor for room for capacity particles and smoke rising from chimneys, the tops of them in model space
+	ParticleSystem(GLuint capacity, const std::vector<glm::vec3>& chimneys);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~ParticleSystem();
+	// A ParticleSystem owns its GL objects, so it cannot be copied
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	// Starts the particles of the emitters in the bound FrameData and moves every particle, colliding with the depth of
+	// the current framebuffer, which is width by height
+	void Update(GLsizei width, GLsizei height);
+	// Draws what the last Update kept alive into the current framebuffer, blended over it without writing depth
+	void Draw();
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLuint capacity = 0;
+	GLuint chimneyCount = 0;
+	// The two particle buffers, current holds the ones drawn and is where the next frame starts its particles
+	GLuint particles[2] = { 0, 0 };
+	GLuint current = 0;
+	GLuint chimneyBuffer = 0;
+	// A DrawArraysIndirectCommand per particle buffer, then the DispatchIndirectCommand of the simulation
+	GLuint stateBuffer = 0;
+	GLuint emitProgram = 0;
+	GLuint prepareProgram = 0;
+	GLuint simulateProgram = 0;
+	GLuint drawProgram = 0;
+	GLuint emptyVAO = 0;
+	DepthPyramid pyramid;
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include"PipelineWarmup.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<chrono>
+#include<iostream>
+#include<vector>
+
+// Constructor that makes the target and the zeroed records
+PipelineWarmup::PipelineWarmup(bool reverseDepth)
+{
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, 1, 1);
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, reverseDepth ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24, 1, 1);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint bound;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &bound);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::PIPELINE_WARMUP::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, bound);
+
+	std::vector<unsigned char> zeros((size_t)RECORD_BYTES, 0);
+	glGenBuffers(1, &records);
+	GLState.BindBuffer(GL_ARRAY_BUFFER, records);
+	glBufferData(GL_ARRAY_BUFFER, RECORD_BYTES, zeros.data(), GL_STATIC_DRAW);
+	GLState.BindBuffer(GL_ARRAY_BUFFER, 0);
+	GpuMemory.Track(GPU_MEMORY_OTHER, GL_BUFFER, records, RECORD_BYTES);
+}
+
+// Deletes the GL objects unless Delete was already called
+PipelineWarmup::~PipelineWarmup()
+{
+	Delete();
+}
+
+// The time runs from the first call to the end of glFinish, drivers that compile on the draw and those that compile
+// on the flush after it are both caught
+float PipelineWarmup::Draw(GLuint program, VAO& vao, GLint recordBinding, GLsizei recordStride, State state, GLenum mode, GLsizei vertices)
+{
+	if (!program)
+		return 0.0f;
+	GLint previousFramebuffer, previousProgram, previousVAO;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean depthMask;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, 1, 1);
+	auto start = std::chrono::steady_clock::now();
+	GLState.Enable(GL_DEPTH_TEST);
+	glDepthMask(state == OPAQUE_DRAW || state == DEPTH_ONLY ? GL_TRUE : GL_FALSE);
+	if (state == DEPTH_ONLY)
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	if (state == BLENDED)
+	{
+		GLState.Enable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	}
+	GLState.UseProgram(program);
+	vao.Bind();
+	if (recordBinding >= 0)
+		vao.LinkBuffer((GLuint)recordBinding, records, 0, recordStride);
+	glDrawArraysInstanced(mode, 0, vertices, 1);
+	GLState.CountDraw(1, 1);
+	glFinish();
+	float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (state == DEPTH_ONLY)
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	if (state == BLENDED)
+	{
+		GLState.Disable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ZERO);
+	}
+	glDepthMask(depthMask);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+
+	drawCount++;
+	totalMilliseconds += milliseconds;
+	if (profiler)
+		profiler->Record("warm-up", milliseconds);
+	if (milliseconds > hitchMilliseconds)
+	{
+		hitchCount++;
+		if (profiler)
+			profiler->Record("hitches avoided", milliseconds);
+	}
+	return milliseconds;
+}
+
+// Deletes the GL objects
+void PipelineWarmup::Delete()
+{
+	if (framebuffer)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (color)
+		glDeleteRenderbuffers(1, &color);
+	if (depth)
+		glDeleteRenderbuffers(1, &depth);
+	if (records)
+		GLState.DeleteBuffers(1, &records);
+	framebuffer = color = depth = records = 0;
+}
@@ -0,0 +1,66 @@
+#ifndef PIPELINE_WARMUP_CLASS_H
+#define PIPELINE_WARMUP_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"Profiler.h"
+#include"VAO.h"
+
+// Draws every program with every vertex format and state it will meet once at load, so the driver compiles or
+// patches them then instead of in the frame that first uses them. Each draw is three vertices of one instance into a
+// 1x1 target of its own and is timed up to a glFinish, the time that would otherwise have been a hitch. Bindings
+// holding per frame records are pointed at a small zeroed buffer first, the frame links its own before drawing again.
+// Only what the target shares with the frame is warmed, its color format and sample count may still differ.
+class PipelineWarmup
+{
+public:
+	// Blending and writes the scene draws with
+	enum State
+	{
+		// Depth tested and written, no blending
+		OPAQUE_DRAW,
+		// Depth only, the color writes off, as a depth prepass lays it down
+		DEPTH_ONLY,
+		// Premultiplied blending over the depth without writing it
+		BLENDED
+	};
+	// Bytes of the zeroed buffer, room for the few records one warm-up draw reads
+	static constexpr GLsizeiptr RECORD_BYTES = 256;
+
+	// A draw taking longer than this many milliseconds counts as a hitch it avoided
+	float hitchMilliseconds = 2.0f;
+	// Profiler every draw's time goes to as "warm-up" and every hitch's as "hitches avoided", nullptr for none
+	Profiler* profiler = nullptr;
+
+	// Constructor that makes the target, with a depth buffer matching a reverse-Z or a standard one
+	PipelineWarmup(bool reverseDepth);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~PipelineWarmup();
+	// A PipelineWarmup owns its GL objects, so it cannot be copied
+	PipelineWarmup(const PipelineWarmup&) = delete;
+	PipelineWarmup& operator=(const PipelineWarmup&) = delete;
+
+	// Draws vertices vertices of mode with program and vao in state, with the zeroed records on recordBinding unless
+	// it is negative, and returns how long it took in milliseconds. The framebuffer, viewport, program, VAO and the
+	// state are put back, the records binding of vao is left on the zeroed buffer
+	float Draw(GLuint program, VAO& vao, GLint recordBinding, GLsizei recordStride, State state, GLenum mode = GL_TRIANGLES, GLsizei vertices = 3);
+
+	// Draws so far, those that took longer than hitchMilliseconds, and their total time
+	size_t draws() const { return drawCount; }
+	size_t hitches() const { return hitchCount; }
+	float milliseconds() const { return totalMilliseconds; }
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLuint framebuffer = 0;
+	GLuint color = 0;
+	GLuint depth = 0;
+	GLuint records = 0;
+	size_t drawCount = 0;
+	size_t hitchCount = 0;
+	float totalMilliseconds = 0.0f;
+};
+
+#endif
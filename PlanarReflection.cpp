@@ -0,0 +1,221 @@
+#include"PlanarReflection.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<cmath>
+#include<iostream>
+#include<glm/gtc/matrix_access.hpp>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+
+// The water's square as a strip of two triangles from gl_VertexID, no vertex buffer needed
+static const char* waterVertexSource = R"(
+#version 330 core
+uniform mat4 viewProjection;
+uniform mat4 model;
+uniform vec2 minCorner;
+uniform vec2 maxCorner;
+uniform float level;
+
+out vec3 WorldPos;
+
+void main()
+{
+    vec2 corner = mix(minCorner, maxCorner, vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)));
+    vec4 world = model * vec4(corner.x, level, corner.y, 1.0);
+    WorldPos = world.xyz;
+    gl_Position = viewProjection * world;
+}
+)";
+// The reflection was drawn with the camera's own x and y, so every pixel of the water looks it up where it stands
+// on the screen, nudged by a few moving waves
+static const char* waterFragmentSource = R"(
+#version 330 core
+uniform sampler2D reflection;
+uniform mat4 model;
+uniform vec3 cameraPosition;
+uniform vec3 waterColor;
+uniform vec4 viewport;
+uniform float time;
+
+in vec3 WorldPos;
+
+out vec4 FragColor;
+
+void main()
+{
+    vec2 waves = vec2(sin(dot(WorldPos.xz, vec2(0.31, 0.17)) + time * 1.7) + sin(dot(WorldPos.xz, vec2(-0.23, 0.41)) + time * 1.3),
+                      cos(dot(WorldPos.xz, vec2(0.19, -0.37)) + time * 1.1) + cos(dot(WorldPos.xz, vec2(0.43, 0.29)) + time * 1.9));
+    vec2 uv = (gl_FragCoord.xy - viewport.xy) / viewport.zw + waves * 0.003;
+    vec3 reflected = texture(reflection, clamp(uv, vec2(0.001), vec2(0.999))).rgb;
+    // Schlick's approximation for water, a mirror at grazing angles and mostly its own color looking down
+    vec3 up = normalize(mat3(model) * vec3(0.0, 1.0, 0.0));
+    float cosView = max(dot(normalize(cameraPosition - WorldPos), up), 0.0);
+    float fresnel = 0.02 + 0.98 * pow(1.0 - cosView, 5.0);
+    FragColor = vec4(mix(waterColor, reflected, fresnel), 1.0);
+}
+)";
+
+// Constructor that builds the water program
+PlanarReflection::PlanarReflection(float level, const glm::vec2& min, const glm::vec2& max)
+	: level(level), min(min), max(max)
+{
+	waterProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, waterVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, waterFragmentSource, "FRAGMENT") });
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(waterProgram);
+	glUniform1i(glGetUniformLocation(waterProgram, "reflection"), TEXTURE_UNIT);
+	GLState.UseProgram(previousProgram);
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+PlanarReflection::~PlanarReflection()
+{
+	Delete();
+}
+
+// Mirrors the camera in the water and binds the target
+void PlanarReflection::Begin(GLsizei width, GLsizei height, const glm::mat4& cameraProjection, const glm::mat4& cameraView, const glm::mat4& model)
+{
+	GLsizei targetWidth = std::max(width / DOWNSCALE, 1);
+	GLsizei targetHeight = std::max(height / DOWNSCALE, 1);
+	if (targetWidth != PlanarReflection::width || targetHeight != PlanarReflection::height || framebuffer == 0)
+		resize(targetWidth, targetHeight);
+
+	// The water's plane in world space, n.p + d = 0 with n of unit length, and the matrix that mirrors points in it
+	glm::vec4 plane = glm::transpose(glm::inverse(model)) * glm::vec4(0.0f, 1.0f, 0.0f, -level);
+	plane /= glm::length(glm::vec3(plane));
+	glm::vec3 normal(plane);
+	glm::mat4 mirror(1.0f);
+	for (int column = 0; column < 3; column++)
+		for (int row = 0; row < 3; row++)
+			mirror[column][row] -= 2.0f * normal[row] * normal[column];
+	mirror[3] = glm::vec4(-2.0f * plane.w * normal, 1.0f);
+	view = cameraView * mirror;
+	eye = glm::vec3(mirror * glm::inverse(cameraView)[3]);
+
+	// Same field of view and aspect as the camera, so the reflection lines up with the screen pixel for pixel
+	float fovy = 2.0f * std::atan(1.0f / cameraProjection[1][1]);
+	float aspect = cameraProjection[1][1] / cameraProjection[0][0];
+	projection = glm::perspective(fovy, aspect, 0.5f, 2000.0f);
+	// Lengyel's oblique near plane: the near plane is swapped for the water's, a little under it so the shore has no
+	// gap, which leaves the far plane skewed but keeps the whole depth range. The mirrored camera has to be under the
+	// water for that, above it the plain projection is kept
+	glm::vec4 clipPlane = glm::transpose(glm::inverse(view)) * (plane + glm::vec4(0.0f, 0.0f, 0.0f, 0.05f));
+	if (clipPlane.w < 0.0f)
+	{
+		glm::vec4 corner = glm::inverse(projection) * glm::vec4(clipPlane.x < 0.0f ? -1.0f : 1.0f, clipPlane.y < 0.0f ? -1.0f : 1.0f, 1.0f, 1.0f);
+		glm::vec4 scaled = clipPlane * (2.0f / glm::dot(clipPlane, corner));
+		projection = glm::row(projection, 2, scaled - glm::row(projection, 3));
+	}
+
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	output = (GLuint)previous;
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, PlanarReflection::width, PlanarReflection::height);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+// Binds the framebuffer and viewport from before Begin
+void PlanarReflection::End()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Draws the water quad, the reflection bound to its unit
+void PlanarReflection::Draw(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition, float time)
+{
+	if (target == 0)
+		return;
+	GLint previousProgram, previousVAO;
+	GLint bound[4];
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glGetIntegerv(GL_VIEWPORT, bound);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, target);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	GLState.UseProgram(waterProgram);
+	GLState.BindVertexArray(emptyVAO);
+	glUniformMatrix4fv(glGetUniformLocation(waterProgram, "viewProjection"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+	glUniformMatrix4fv(glGetUniformLocation(waterProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
+	glUniform2fv(glGetUniformLocation(waterProgram, "minCorner"), 1, glm::value_ptr(min));
+	glUniform2fv(glGetUniformLocation(waterProgram, "maxCorner"), 1, glm::value_ptr(max));
+	glUniform1f(glGetUniformLocation(waterProgram, "level"), level);
+	glUniform3fv(glGetUniformLocation(waterProgram, "cameraPosition"), 1, glm::value_ptr(cameraPosition));
+	glUniform3fv(glGetUniformLocation(waterProgram, "waterColor"), 1, glm::value_ptr(color));
+	glUniform4f(glGetUniformLocation(waterProgram, "viewport"), (GLfloat)bound[0], (GLfloat)bound[1], (GLfloat)bound[2], (GLfloat)bound[3]);
+	glUniform1f(glGetUniformLocation(waterProgram, "time"), time);
+	GLState.CountUniforms(9);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	GLState.CountDraw(1, 2);
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+}
+
+// Reallocates the target for a new size
+void PlanarReflection::resize(GLsizei width, GLsizei height)
+{
+	deleteTarget();
+	PlanarReflection::width = width;
+	PlanarReflection::height = height;
+
+	// Half floats keep the lit windows brighter than white for the bloom, as in the scene's own target
+	glGenTextures(1, &target);
+	GLState.BindTexture(GL_TEXTURE_2D, target);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, target, GpuMemoryTracker::ImageBytes(GL_RGBA16F, width, height));
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::PLANAR_REFLECTION::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previous);
+}
+
+// Deletes the target and its framebuffer
+void PlanarReflection::deleteTarget()
+{
+	if (target != 0)
+		GLState.DeleteTextures(1, &target);
+	if (depthBuffer != 0)
+		glDeleteRenderbuffers(1, &depthBuffer);
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	target = depthBuffer = framebuffer = 0;
+	width = height = 0;
+}
+
+// Deletes the GL objects
+void PlanarReflection::Delete()
+{
+	deleteTarget();
+	if (waterProgram != 0)
+		GLState.DeleteProgram(waterProgram);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	waterProgram = emptyVAO = 0;
+}
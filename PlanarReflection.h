@@ -0,0 +1,70 @@
+#ifndef PLANAR_REFLECTION_CLASS_H
+#define PLANAR_REFLECTION_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+// Water around the city that mirrors it. Between Begin and End the caller draws a second view of the scene into a
+// target of a quarter of the pixels, through the camera mirrored in the water plane and a projection whose near plane
+// is that plane (Lengyel's oblique clipping), so nothing under the water shows up in the reflection. Draw then lays a
+// quad at the water's height over the scene that looks the reflection up at its own pixel, rippled and blended
+// with the water's color by a Fresnel term.
+// The reflected view is meant to be cheap: the caller draws the far field only, such as the block billboards.
+class PlanarReflection
+{
+public:
+	// The reflection is bound to this texture unit while the water is drawn, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 21;
+	// The target is this many times smaller than the framebuffer on each side
+	static constexpr GLsizei DOWNSCALE = 2;
+
+	// Height of the water and the square around the city it covers, in model space
+	float level;
+	glm::vec2 min;
+	glm::vec2 max;
+	// Color of deep water, seen where the reflection is weak
+	glm::vec3 color = glm::vec3(0.04f, 0.09f, 0.12f);
+
+	// Mirrored view and oblique projection of the last Begin, and the mirrored camera position in world space
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::vec3 eye = glm::vec3(0.0f);
+
+	// Constructor for water at level over the square min to max, the target is made by the first Begin
+	PlanarReflection(float level, const glm::vec2& min, const glm::vec2& max);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~PlanarReflection();
+	// A PlanarReflection owns its GL objects, so it cannot be copied
+	PlanarReflection(const PlanarReflection&) = delete;
+	PlanarReflection& operator=(const PlanarReflection&) = delete;
+
+	// Works out the mirrored view for a camera with cameraProjection, cameraView and the city's model matrix, and binds
+	// and clears the target for a framebuffer of width by height. cameraProjection only lends its field of view,
+	// the reflection is drawn with GL's default depth convention and has to be between ReverseDepth's Suspend and Resume
+	void Begin(GLsizei width, GLsizei height, const glm::mat4& cameraProjection, const glm::mat4& cameraView, const glm::mat4& model);
+	// Binds the framebuffer and viewport Begin replaced again
+	void End();
+	// Draws the water into the bound framebuffer with the camera's matrices, depth tested against the scene
+	void Draw(const glm::mat4& viewProjection, const glm::mat4& model, const glm::vec3& cameraPosition, float time);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLuint framebuffer = 0;
+	GLuint target = 0;
+	GLuint depthBuffer = 0;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	GLuint waterProgram = 0;
+	GLuint emptyVAO = 0;
+	// Framebuffer and viewport that were bound at Begin
+	GLuint output = 0;
+	GLint viewport[4] = {};
+
+	// Reallocates the target for a new size
+	void resize(GLsizei width, GLsizei height);
+	// Deletes the target and its framebuffer
+	void deleteTarget();
+};
+
+#endif
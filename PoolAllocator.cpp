@@ -0,0 +1,76 @@
+#include"PoolAllocator.h"
+
+#include<algorithm>
+#include<cstdint>
+#include<new>
+
+// Constructor that rounds the object size up so every object of a chunk stays aligned and can hold a free link
+PoolAllocator::PoolAllocator(size_t objectSize, size_t alignment, size_t objectsPerChunk)
+{
+	PoolAllocator::alignment = std::max(alignment, alignof(FreeObject));
+	size_t size = std::max(objectSize, sizeof(FreeObject));
+	stride = (size + PoolAllocator::alignment - 1) / PoolAllocator::alignment * PoolAllocator::alignment;
+	PoolAllocator::objectsPerChunk = std::max<size_t>(objectsPerChunk, 1);
+}
+
+// Frees every chunk
+PoolAllocator::~PoolAllocator()
+{
+	while (chunks)
+	{
+		Chunk* next = chunks->next;
+		::operator delete(chunks);
+		chunks = next;
+	}
+}
+
+// Takes an object off the free list, growing the pool when it is empty
+void* PoolAllocator::Allocate()
+{
+	if (!freeList)
+		grow();
+	FreeObject* object = freeList;
+	freeList = object->next;
+	liveObjects++;
+	return object;
+}
+
+// Puts the memory of an object back on the free list
+void PoolAllocator::Free(void* object)
+{
+	if (!object)
+		return;
+	FreeObject* freed = (FreeObject*)object;
+	freed->next = freeList;
+	freeList = freed;
+	liveObjects--;
+}
+
+// Objects allocated and not freed yet
+size_t PoolAllocator::live() const
+{
+	return liveObjects;
+}
+
+// Objects the chunks allocated so far can hold
+size_t PoolAllocator::capacity() const
+{
+	return chunkCount * objectsPerChunk;
+}
+
+// Allocates a chunk, the first object starts at the first multiple of the alignment behind the link
+void PoolAllocator::grow()
+{
+	Chunk* chunk = (Chunk*)::operator new(sizeof(Chunk) + alignment + stride * objectsPerChunk);
+	chunk->next = chunks;
+	chunks = chunk;
+	chunkCount++;
+	char* first = (char*)(((uintptr_t)(chunk + 1) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+	// Linked last to first, so the objects are handed out in the order of their addresses
+	for (size_t i = objectsPerChunk; i-- > 0;)
+	{
+		FreeObject* object = (FreeObject*)(first + i * stride);
+		object->next = freeList;
+		freeList = object;
+	}
+}
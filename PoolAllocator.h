@@ -0,0 +1,55 @@
+#ifndef POOL_ALLOCATOR_CLASS_H
+#define POOL_ALLOCATOR_CLASS_H
+
+#include<cstddef>
+
+// Allocator for many objects of one size, such as nodes that come and go every frame
+// Objects are carved out of chunks of objectsPerChunk at a time and freed ones go onto a free list that the next
+// Allocate takes from, so once the pool has held as many objects as it ever holds at once it never touches the heap
+// again. Chunks are only given back when the pool is destroyed. Construct and destroy objects in the memory with
+// placement new and an explicit destructor call. Not thread safe, guard a pool shared by threads with a mutex.
+class PoolAllocator
+{
+public:
+	// Constructor for objects of objectSize bytes at a multiple of alignment, no chunk is allocated until the first object
+	PoolAllocator(size_t objectSize, size_t alignment = alignof(std::max_align_t), size_t objectsPerChunk = 64);
+	// Frees every chunk, objects still allocated are not destroyed
+	~PoolAllocator();
+	// A PoolAllocator owns its chunks, so it cannot be copied
+	PoolAllocator(const PoolAllocator&) = delete;
+	PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+	// Memory for one object
+	void* Allocate();
+	// Puts the memory of an object back on the free list
+	void Free(void* object);
+
+	// Objects allocated and not freed yet
+	size_t live() const;
+	// Objects the chunks allocated so far can hold
+	size_t capacity() const;
+private:
+	// A free object, the link overlays its memory
+	struct FreeObject
+	{
+		FreeObject* next;
+	};
+	// Chunk of objects, the chunks are linked through the first bytes in front of their objects
+	struct Chunk
+	{
+		Chunk* next;
+	};
+
+	size_t stride;
+	size_t alignment;
+	size_t objectsPerChunk;
+	Chunk* chunks = nullptr;
+	FreeObject* freeList = nullptr;
+	size_t liveObjects = 0;
+	size_t chunkCount = 0;
+
+	// Allocates a chunk and puts all of its objects on the free list
+	void grow();
+};
+
+#endif
@@ -0,0 +1,464 @@
+#include"PostProcess.h"
+#include"VolumetricFog.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<string>
+#include<glm/gtc/type_ptr.hpp>
+
+// Full screen triangle, every pixel of the target goes through the effects once
+static const char* postVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+// The effects of the set are defined after the #version line, the ones left out compile to nothing
+static const char* postFragmentSource = R"(
+#version 330 core
+uniform sampler2D scene;
+uniform sampler2D sceneDepth;
+// The inverse of the projection the scene was drawn with, and 1 when it was drawn reverse-Z
+uniform mat4 inverseProjection;
+uniform int reverseZ;
+// Fog color and density
+uniform vec4 fog;
+// Exposure, contrast, saturation and vignette
+uniform vec4 grade;
+#ifdef BLOOM
+// First level of the bloom chain, which the upsampling left holding every level, and how much of it is added
+uniform sampler2D bloomChain;
+uniform float bloomIntensity;
+#endif
+#ifdef VOLUMETRIC
+// Light scattered in and the share of the scene left, summed from the camera up to every slice by VolumetricFog, and
+// the scale and offset that take the log of a view depth to its slice coordinate
+uniform sampler3D fogVolume;
+uniform vec2 fogVolumeScale;
+#endif
+
+out vec4 FragColor;
+
+float luma(vec3 color)
+{
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+#ifdef FXAA
+const float EDGE_THRESHOLD = 1.0 / 8.0;
+const float EDGE_THRESHOLD_MIN = 1.0 / 24.0;
+const float REDUCE_MUL = 1.0 / 8.0;
+const float REDUCE_MIN = 1.0 / 128.0;
+const float SPAN_MAX = 8.0;
+
+// The FXAA of AntiAliasing, blending along the edge the four diagonal neighbours give
+vec3 fxaa(vec2 uv, vec2 texel, vec3 center)
+{
+    float lumaM = luma(center);
+    float lumaNW = luma(textureOffset(scene, uv, ivec2(-1, 1)).rgb);
+    float lumaNE = luma(textureOffset(scene, uv, ivec2(1, 1)).rgb);
+    float lumaSW = luma(textureOffset(scene, uv, ivec2(-1, -1)).rgb);
+    float lumaSE = luma(textureOffset(scene, uv, ivec2(1, -1)).rgb);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+    if (lumaMax - lumaMin < max(EDGE_THRESHOLD_MIN, lumaMax * EDGE_THRESHOLD))
+        return center;
+
+    vec2 direction = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float reduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.25 * REDUCE_MUL, REDUCE_MIN);
+    float scale = 1.0 / (min(abs(direction.x), abs(direction.y)) + reduce);
+    direction = clamp(direction * scale, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texel;
+
+    vec3 near = 0.5 * (texture(scene, uv + direction * (1.0 / 3.0 - 0.5)).rgb + texture(scene, uv + direction * (2.0 / 3.0 - 0.5)).rgb);
+    vec3 far = near * 0.5 + 0.25 * (texture(scene, uv - direction * 0.5).rgb + texture(scene, uv + direction * 0.5).rgb);
+    float lumaFar = luma(far);
+    return lumaFar < lumaMin || lumaFar > lumaMax ? near : far;
+}
+#endif
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(scene, 0));
+    vec2 uv = gl_FragCoord.xy * texel;
+    vec4 center = texture(scene, uv);
+    vec3 color = center.rgb;
+#ifdef FXAA
+    color = fxaa(uv, texel, color);
+#endif
+#ifdef VOLUMETRIC
+    // The froxels lie over the screen as the pixels do, the background takes the last slice
+    float depth = texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r;
+    vec4 view = inverseProjection * vec4(uv * 2.0 - 1.0, reverseZ != 0 ? depth : depth * 2.0 - 1.0, 1.0);
+    float viewDepth = abs(view.w) > 1e-6 ? max(-view.z / view.w, 1e-4) : 1e6;
+    vec4 scattered = texture(fogVolume, vec3(uv, log(viewDepth) * fogVolumeScale.x + fogVolumeScale.y));
+    color = color * scattered.a + scattered.rgb;
+#elif defined(FOG)
+    // Distance from the view space position, the background is at infinity with reverse-Z and fully fogged
+    float depth = texelFetch(sceneDepth, ivec2(gl_FragCoord.xy), 0).r;
+    vec4 view = inverseProjection * vec4(uv * 2.0 - 1.0, reverseZ != 0 ? depth : depth * 2.0 - 1.0, 1.0);
+    float distance = length(view.xyz) / max(abs(view.w), 1e-6);
+    color = mix(fog.rgb, color, exp(-fog.a * distance));
+#endif
+#ifdef BLOOM
+    color += textureLod(bloomChain, uv, 0.0).rgb * bloomIntensity;
+#endif
+#ifdef TONEMAP
+    // Narkowicz's fit of the ACES filmic curve
+    color *= grade.x;
+    color = clamp(color * (2.51 * color + 0.03) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+#endif
+#ifdef GRADE
+    color = max((color - 0.5) * grade.y + 0.5, 0.0);
+    color = mix(vec3(luma(color)), color, grade.z);
+#endif
+#ifdef VIGNETTE
+    vec2 corner = uv - 0.5;
+    color *= 1.0 - grade.w * 2.0 * dot(corner, corner);
+#endif
+    FragColor = vec4(color, center.a);
+}
+)";
+
+// Filters the level below into a level of the bloom chain with 13 taps, four overlapping boxes around the center and
+// a fifth on it, which keeps a single bright pixel from flickering as it moves. The first level is taken from the
+// scene and keeps only what is brighter than the threshold, with a quadratic knee so the cut is not a hard edge.
+static const char* bloomDownsampleSource = R"(
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+uniform sampler2D source;
+uniform int sourceLevel;
+uniform int prefilter;
+// Threshold and knee
+uniform vec2 threshold;
+layout(rgba16f) writeonly uniform image2D destination;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    if (any(greaterThanEqual(pixel, size)))
+        return;
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(size);
+    vec2 texel = 1.0 / vec2(textureSize(source, sourceLevel));
+    float lod = float(sourceLevel);
+#define TAP(x, y) textureLod(source, uv + vec2(x, y) * texel, lod).rgb
+    vec3 color = TAP(0, 0) * 0.125;
+    color += (TAP(-2, 2) + TAP(2, 2) + TAP(-2, -2) + TAP(2, -2)) * 0.03125;
+    color += (TAP(0, 2) + TAP(-2, 0) + TAP(2, 0) + TAP(0, -2)) * 0.0625;
+    color += (TAP(-1, 1) + TAP(1, 1) + TAP(-1, -1) + TAP(1, -1)) * 0.125;
+    if (prefilter != 0)
+    {
+        float brightness = max(color.r, max(color.g, color.b));
+        float soft = clamp(brightness - threshold.x + threshold.y, 0.0, 2.0 * threshold.y);
+        soft = soft * soft / (4.0 * threshold.y + 1e-5);
+        color *= max(soft, brightness - threshold.x) / max(brightness, 1e-5);
+    }
+    imageStore(destination, pixel, vec4(color, 1.0));
+}
+)";
+// Adds the level above, spread by a 3x3 tent, to a level of the bloom chain on the way back up
+static const char* bloomUpsampleSource = R"(
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+uniform sampler2D source;
+uniform int sourceLevel;
+layout(rgba16f) uniform image2D destination;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(destination);
+    if (any(greaterThanEqual(pixel, size)))
+        return;
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(size);
+    vec2 texel = 1.0 / vec2(textureSize(source, sourceLevel));
+    float lod = float(sourceLevel);
+#define TAP(x, y) textureLod(source, uv + vec2(x, y) * texel, lod).rgb
+    vec3 color = TAP(0, 0) * 4.0;
+    color += (TAP(0, 1) + TAP(-1, 0) + TAP(1, 0) + TAP(0, -1)) * 2.0;
+    color += TAP(-1, 1) + TAP(1, 1) + TAP(-1, -1) + TAP(1, -1);
+    imageStore(destination, pixel, imageLoad(destination, pixel) + vec4(color / 16.0, 0.0));
+}
+)";
+
+// Effects by name, in the order their #defines are added
+static const struct { PostProcess::Effect effect; const char* name; const char* define; } effectNames[] = {
+	{ PostProcess::FXAA, "fxaa", "#define FXAA\n" },
+	{ PostProcess::FOG, "fog", "#define FOG\n" },
+	{ PostProcess::BLOOM, "bloom", "#define BLOOM\n" },
+	{ PostProcess::TONEMAP, "tonemap", "#define TONEMAP\n" },
+	{ PostProcess::GRADE, "grade", "#define GRADE\n" },
+	{ PostProcess::VIGNETTE, "vignette", "#define VIGNETTE\n" },
+	{ PostProcess::VOLUMETRIC, nullptr, "#define VOLUMETRIC\n" }
+};
+
+// Parses a list of effect names
+bool PostProcess::Parse(const char* list, unsigned int& effects)
+{
+	unsigned int parsed = 0;
+	const char* name = list;
+	while (*name)
+	{
+		size_t length = std::strcspn(name, ",");
+		bool known = false;
+		for (const auto& entry : effectNames)
+			if (entry.name && std::strlen(entry.name) == length && std::strncmp(name, entry.name, length) == 0)
+			{
+				parsed |= entry.effect;
+				known = true;
+			}
+		if (!known)
+			return false;
+		name += length;
+		if (*name == ',')
+			name++;
+	}
+	effects = parsed;
+	return true;
+}
+
+// Constructor for a set of effects
+PostProcess::PostProcess(unsigned int effects)
+	: effects(effects)
+{
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+PostProcess::~PostProcess()
+{
+	Delete();
+}
+
+// Binds the target in place of the bound framebuffer
+void PostProcess::Begin(GLsizei width, GLsizei height)
+{
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	output = (GLuint)previous;
+	GLenum format = effects & (TONEMAP | BLOOM) ? GL_RGBA16F : GL_RGBA8;
+	if (width != PostProcess::width || height != PostProcess::height || format != colorFormat || framebuffer == 0)
+		resize(width, height, format);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	bloomed = false;
+}
+
+// Goes down the bloom chain from the target's color and back up
+void PostProcess::Bloom()
+{
+	bloomed = true;
+	if (!(effects & BLOOM) || framebuffer == 0)
+		return;
+	if (bloom == 0)
+		resizeBloom();
+	if (downsampleProgram == 0)
+	{
+		downsampleProgram = Shader::LinkCompute(bloomDownsampleSource);
+		upsampleProgram = Shader::LinkCompute(bloomUpsampleSource);
+	}
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, color);
+	GLState.ActiveTexture(GL_TEXTURE0 + BLOOM_TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, bloom);
+
+	// Each level reads the one below it, the first the scene, and is read by the next dispatch
+	auto dispatch = [&](GLsizei level, GLenum access) {
+		glBindImageTexture(0, bloom, level, GL_FALSE, 0, access, GL_RGBA16F);
+		glDispatchCompute((GLuint)(std::max(width / 2 >> level, 1) + 7) / 8, (GLuint)(std::max(height / 2 >> level, 1) + 7) / 8, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	};
+	GLState.UseProgram(downsampleProgram);
+	glUniform2f(glGetUniformLocation(downsampleProgram, "threshold"), bloomThreshold, bloomKnee);
+	GLState.CountUniforms(1);
+	for (GLsizei level = 0; level < bloomLevels; level++)
+	{
+		glUniform1i(glGetUniformLocation(downsampleProgram, "source"), level == 0 ? TEXTURE_UNIT : BLOOM_TEXTURE_UNIT);
+		glUniform1i(glGetUniformLocation(downsampleProgram, "sourceLevel"), std::max(level - 1, 0));
+		glUniform1i(glGetUniformLocation(downsampleProgram, "prefilter"), level == 0 ? 1 : 0);
+		GLState.CountUniforms(3);
+		dispatch(level, GL_WRITE_ONLY);
+	}
+	GLState.UseProgram(upsampleProgram);
+	glUniform1i(glGetUniformLocation(upsampleProgram, "source"), BLOOM_TEXTURE_UNIT);
+	GLState.CountUniforms(1);
+	for (GLsizei level = bloomLevels - 2; level >= 0; level--)
+	{
+		glUniform1i(glGetUniformLocation(upsampleProgram, "sourceLevel"), level + 1);
+		GLState.CountUniforms(1);
+		dispatch(level, GL_READ_WRITE);
+	}
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	GLState.UseProgram(previousProgram);
+}
+
+// Draws the effects into the framebuffer the target replaced
+void PostProcess::End(const glm::mat4& projection, GLuint depth, const VolumetricFog* volume)
+{
+	if (!bloomed)
+		Bloom();
+	GLint previousProgram, previousVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	GLState.Disable(GL_DEPTH_TEST);
+	GLuint effectProgram = program(volume && (effects & FOG) ? effects | VOLUMETRIC : effects);
+	GLState.UseProgram(effectProgram);
+	if (volume && (effects & FOG))
+		volume->Apply(effectProgram);
+	glUniformMatrix4fv(glGetUniformLocation(effectProgram, "inverseProjection"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+	glUniform1i(glGetUniformLocation(effectProgram, "reverseZ"), reverseDepth ? 1 : 0);
+	glUniform4f(glGetUniformLocation(effectProgram, "fog"), fogColor.r, fogColor.g, fogColor.b, fogDensity);
+	glUniform4f(glGetUniformLocation(effectProgram, "grade"), exposure, contrast, saturation, vignette);
+	glUniform1f(glGetUniformLocation(effectProgram, "bloomIntensity"), bloomIntensity);
+	GLState.CountUniforms(5);
+	const GLuint targets[3] = { color, depth != 0 ? depth : PostProcess::depth, bloom };
+	for (GLuint i = 0; i < 3; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, targets[i]);
+	}
+	GLState.BindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+	for (GLuint i = 0; i < 3; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+}
+
+// Gets the program of a set of effects
+GLuint PostProcess::program(unsigned int effects)
+{
+	auto found = programs.find(effects);
+	if (found != programs.end())
+		return found->second;
+
+	std::string source = postFragmentSource;
+	std::string defines;
+	for (const auto& entry : effectNames)
+		if (effects & entry.effect)
+			defines += entry.define;
+	source.insert(source.find('\n', source.find("#version")) + 1, defines);
+
+	GLuint built = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, postVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, source.c_str(), "FRAGMENT") });
+
+	GLState.UseProgram(built);
+	glUniform1i(glGetUniformLocation(built, "scene"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(built, "sceneDepth"), TEXTURE_UNIT + 1);
+	glUniform1i(glGetUniformLocation(built, "bloomChain"), BLOOM_TEXTURE_UNIT);
+	programs[effects] = built;
+	return built;
+}
+
+// Reallocates the target for a new size or color format
+void PostProcess::resize(GLsizei width, GLsizei height, GLenum colorFormat)
+{
+	deleteTarget();
+	PostProcess::width = width;
+	PostProcess::height = height;
+	PostProcess::colorFormat = colorFormat;
+
+	// FXAA samples the color between texels along the edges, the depth is only fetched at its own pixel
+	// Reverse-Z needs a float depth buffer, as in ReverseDepth's own target
+	const GLenum formats[2][3] = {
+		{ colorFormat, GL_RGBA, colorFormat == GL_RGBA16F ? (GLenum)GL_FLOAT : (GLenum)GL_UNSIGNED_BYTE },
+		{ reverseDepth ? (GLenum)GL_DEPTH_COMPONENT32F : (GLenum)GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, reverseDepth ? (GLenum)GL_FLOAT : (GLenum)GL_UNSIGNED_INT }
+	};
+	GLuint* targets[2] = { &color, &depth };
+	for (int i = 0; i < 2; i++)
+	{
+		glGenTextures(1, targets[i]);
+		GLState.BindTexture(GL_TEXTURE_2D, *targets[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, i == 0 ? GL_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, i == 0 ? GL_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, formats[i][0], width, height, 0, formats[i][1], formats[i][2], nullptr);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, *targets[i], GpuMemoryTracker::ImageBytes(formats[i][0], width, height));
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::POST_PROCESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Allocates the bloom chain for the target's size
+void PostProcess::resizeBloom()
+{
+	// Levels stop halving once they would be under 8 texels on a side, a small target keeps at least one
+	GLsizei levelWidth = std::max(width / 2, 1);
+	GLsizei levelHeight = std::max(height / 2, 1);
+	bloomLevels = 1;
+	while (bloomLevels < BLOOM_LEVELS && std::min(levelWidth >> bloomLevels, levelHeight >> bloomLevels) >= 8)
+		bloomLevels++;
+	glGenTextures(1, &bloom);
+	GLState.BindTexture(GL_TEXTURE_2D, bloom);
+	glTexStorage2D(GL_TEXTURE_2D, bloomLevels, GL_RGBA16F, levelWidth, levelHeight);
+	// textureLod picks one level and filters within it
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, bloom, GpuMemoryTracker::ImageBytes(GL_RGBA16F, levelWidth, levelHeight, 1, bloomLevels));
+}
+
+// Deletes the color, depth and framebuffer of the target and the bloom chain
+void PostProcess::deleteTarget()
+{
+	GLuint targets[] = { color, depth, bloom };
+	for (GLuint target : targets)
+		if (target != 0)
+			GLState.DeleteTextures(1, &target);
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	color = depth = bloom = framebuffer = 0;
+	bloomLevels = 0;
+}
+
+// Deletes the GL objects
+void PostProcess::Delete()
+{
+	deleteTarget();
+	for (auto& entry : programs)
+		GLState.DeleteProgram(entry.second);
+	programs.clear();
+	GLuint computePrograms[] = { downsampleProgram, upsampleProgram };
+	for (GLuint computeProgram : computePrograms)
+		if (computeProgram != 0)
+			GLState.DeleteProgram(computeProgram);
+	downsampleProgram = upsampleProgram = 0;
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	emptyVAO = 0;
+}
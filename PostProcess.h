@@ -0,0 +1,114 @@
+#ifndef POST_PROCESS_CLASS_H
+#define POST_PROCESS_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<unordered_map>
+
+class VolumetricFog;
+
+// Post effects fused into one full screen pass, so the scene color is read and the output written once however many
+// are on. Like AntiAliasing's, the target replaces the bound framebuffer between Begin and End, with a depth texture
+// that stands in for ReverseDepth's forward target. Each set of effects is its own permutation of one fragment shader,
+// a #define per effect after the #version line as Shader::Specialize does, built the first time it is drawn with.
+// In order: FXAA on the scene color, fog from the depth, bloom, tonemapping with the exposure, color grading and a vignette.
+// Bloom alone takes passes of its own before the fused one, see Bloom.
+class PostProcess
+{
+public:
+	enum Effect : unsigned int
+	{
+		FXAA = 1 << 0,
+		FOG = 1 << 1,
+		// The target is half float so the lights can go past 1 before they are mapped back
+		TONEMAP = 1 << 2,
+		GRADE = 1 << 3,
+		VIGNETTE = 1 << 4,
+		// Needs compute shaders, and a half float target like TONEMAP so only what is brighter than white blooms
+		BLOOM = 1 << 5,
+		// Takes the fog from a VolumetricFog's volume instead of the color and density, added by End when it is given
+		// one and never parsed
+		VOLUMETRIC = 1 << 6
+	};
+
+	// The scene color is sampled on this texture unit and its depth on the next, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 14;
+	// The bloom chain is sampled on the unit after those two
+	static constexpr GLuint BLOOM_TEXTURE_UNIT = TEXTURE_UNIT + 2;
+	// Levels of the bloom chain at most, the first at half the target's resolution
+	static constexpr GLsizei BLOOM_LEVELS = 6;
+
+	// Effects drawn by the next End, a new set builds its program then
+	unsigned int effects;
+	// Set when the scene is drawn reverse-Z, see ReverseDepth.h, before the first Begin
+	bool reverseDepth = false;
+	// Fog color and how much of the scene it hides per world unit
+	glm::vec3 fogColor = glm::vec3(0.55f, 0.6f, 0.68f);
+	float fogDensity = 0.004f;
+	// Scales the color before it is tonemapped
+	float exposure = 1.0f;
+	// Contrast around middle grey and saturation, 1 leaves them
+	float contrast = 1.05f;
+	float saturation = 1.1f;
+	// How much the corners are darkened, from 0 to 1
+	float vignette = 0.35f;
+	// Brightness from which the scene blooms, the knee that softens the cut, and how much of the bloom is added back
+	float bloomThreshold = 1.0f;
+	float bloomKnee = 0.5f;
+	float bloomIntensity = 0.08f;
+
+	// Parses a comma separated list of "fxaa", "fog", "bloom", "tonemap", "grade" and "vignette", false on any other name
+	static bool Parse(const char* list, unsigned int& effects);
+
+	// Constructor for a set of effects, the target and the program are made by the first Begin and End
+	PostProcess(unsigned int effects);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~PostProcess();
+	// A PostProcess owns its GL objects, so it cannot be copied
+	PostProcess(const PostProcess&) = delete;
+	PostProcess& operator=(const PostProcess&) = delete;
+
+	// Binds a target of width by height in place of the bound framebuffer, reallocated when the size changed
+	void Begin(GLsizei width, GLsizei height);
+	// Blurs what is brighter than the threshold down a chain of half sized levels and back up with compute shaders,
+	// for the next End to add. Called on its own so its cost can be measured apart, End calls it if it was not
+	void Bloom();
+	// Draws the effects from the target into the framebuffer it replaced and binds that again
+	// projection is the one the scene was drawn with, for the fog, and depth a depth texture of the scene to use
+	// instead of the target's, such as the G-buffer's of a deferred frame. With a volume the FOG effect fogs every
+	// pixel with one fetch of it, Updated for the same camera
+	void End(const glm::mat4& projection, GLuint depth = 0, const VolumetricFog* volume = nullptr);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	// Color and depth of the target, both textures sampled by End
+	GLuint framebuffer = 0;
+	GLuint color = 0;
+	GLuint depth = 0;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	GLenum colorFormat = 0;
+	// Framebuffer the target replaced
+	GLuint output = 0;
+	// Bloom chain with its levels and the programs that go down and up it, and whether it was run since Begin
+	GLuint bloom = 0;
+	GLsizei bloomLevels = 0;
+	GLuint downsampleProgram = 0;
+	GLuint upsampleProgram = 0;
+	bool bloomed = false;
+	// Programs by set of effects and the empty VAO their full screen triangle is drawn with
+	std::unordered_map<unsigned int, GLuint> programs;
+	GLuint emptyVAO = 0;
+
+	// Gets the program of a set of effects, building it the first time
+	GLuint program(unsigned int effects);
+	// Reallocates the target for a new size or color format
+	void resize(GLsizei width, GLsizei height, GLenum colorFormat);
+	// Allocates the bloom chain for the target's size
+	void resizeBloom();
+	// Deletes the color, depth and framebuffer of the target and the bloom chain
+	void deleteTarget();
+};
+
+#endif
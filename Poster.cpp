@@ -0,0 +1,117 @@
+#include"Poster.h"
+
+#include<stb/stb_image.h>
+#include<algorithm>
+#include<cstdio>
+#include<cstring>
+#include<filesystem>
+#include<iostream>
+#include<vector>
+
+#include"ImageWriter.h"
+
+// Rows of the poster filtered and deflated together, a band of them is one IDAT chunk
+static const int BAND_ROWS = 64;
+
+Poster::Poster(int width, int height, int tileWidth, int tileHeight)
+	: width(width), height(height), tileWidth(tileWidth), tileHeight(tileHeight)
+{
+	columns = (width + tileWidth - 1) / tileWidth;
+	rows = (height + tileHeight - 1) / tileHeight;
+}
+
+glm::vec4 Poster::Bounds(int tile) const
+{
+	// Pixels count from the top left of the poster, NDC from the bottom left
+	float left = (float)(tile % columns * tileWidth), top = (float)(tile / columns * tileHeight);
+	return glm::vec4(2.0f * left / width - 1.0f, 1.0f - 2.0f * (top + tileHeight) / height,
+		2.0f * (left + tileWidth) / width - 1.0f, 1.0f - 2.0f * top / height);
+}
+
+std::string Poster::Name(size_t view)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "view_%05zu", view);
+	return name;
+}
+
+std::string Poster::TileName(size_t view, int tile)
+{
+	char name[48];
+	snprintf(name, sizeof(name), "view_%05zu_tile_%04d", view, tile);
+	return name;
+}
+
+bool Poster::Complete(const std::string& directory, size_t view) const
+{
+	for (int tile = 0; tile < tileCount(); tile++)
+	{
+		std::error_code error;
+		if (!std::filesystem::exists(std::filesystem::path(directory) / (TileName(view, tile) + ".png"), error))
+			return false;
+	}
+	return true;
+}
+
+bool Poster::Stitch(const std::string& directory, size_t view) const
+{
+	std::string path = (std::filesystem::path(directory) / (Name(view) + ".png")).string();
+	ImageWriter::PNGStream poster;
+	if (!poster.Open(path, width, height))
+		return false;
+	// Tiles are files, top row first, whatever other loads on this thread flip
+	stbi_set_flip_vertically_on_load_thread(0);
+	std::vector<unsigned char*> tiles(columns, nullptr);
+	auto freeTiles = [&]() {
+		for (unsigned char*& tile : tiles)
+		{
+			stbi_image_free(tile);
+			tile = nullptr;
+		}
+	};
+	std::vector<uint8_t> band((size_t)width * 4 * BAND_ROWS);
+	for (int row = 0; row < rows; row++)
+	{
+		for (int column = 0; column < columns; column++)
+		{
+			std::string tilePath = (std::filesystem::path(directory) / (TileName(view, row * columns + column) + ".png")).string();
+			int x, y, channels;
+			tiles[column] = stbi_load(tilePath.c_str(), &x, &y, &channels, 4);
+			if (!tiles[column] || x != tileWidth || y != tileHeight)
+			{
+				std::cerr << "Failed to stitch " << path << ", " << tilePath << " is not a " << tileWidth << " by " << tileHeight << " image" << std::endl;
+				freeTiles();
+				return false;
+			}
+		}
+		// The last row of tiles and the last column are cropped to the poster
+		int rowHeight = std::min(tileHeight, height - row * tileHeight);
+		for (int first = 0; first < rowHeight; first += BAND_ROWS)
+		{
+			int count = std::min(BAND_ROWS, rowHeight - first);
+			for (int y = 0; y < count; y++)
+				for (int column = 0; column < columns; column++)
+				{
+					size_t pixels = (size_t)std::min(tileWidth, width - column * tileWidth);
+					std::memcpy(&band[((size_t)y * width + (size_t)column * tileWidth) * 4],
+						tiles[column] + (size_t)(first + y) * tileWidth * 4, pixels * 4);
+				}
+			if (!poster.Write(band.data(), count))
+			{
+				freeTiles();
+				return false;
+			}
+		}
+		freeTiles();
+	}
+	if (!poster.Close())
+		return false;
+
+	for (int tile = 0; tile < tileCount(); tile++)
+	{
+		std::error_code error;
+		std::filesystem::remove(std::filesystem::path(directory) / (TileName(view, tile) + ".png"), error);
+	}
+	std::cout << "Stitched " << path << ", " << width << " x " << height << " from " << tileCount() << " tiles" << std::endl;
+	return true;
+}
@@ -0,0 +1,43 @@
+#ifndef POSTER_CLASS_H
+#define POSTER_CLASS_H
+
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<string>
+
+// Splits a poster too large for any render target, such as a 40000 by 20000 print, into tiles of the view size and
+// stitches their images back into one PNG. Every tile is drawn through the sub-frustum of the poster's projection it
+// covers, see Camera::SetSubFrustum, so the tiles meet without seams and whatever is sized in pixels is sized for the
+// whole poster. Tiles are numbered row by row from the top left, those of the last column and row reach past the
+// poster's edges and are cropped when stitched. A batch export renders the tiles as images of their own, so the
+// processes of a render farm, on one machine or on the nodes of a cluster sharing the output directory, claim them
+// one at a time and the farm is as fast as its GPUs together.
+class Poster
+{
+public:
+	// Size of the poster and of its tiles, in pixels, and the tiles along each side
+	int width;
+	int height;
+	int tileWidth;
+	int tileHeight;
+	int columns;
+	int rows;
+
+	// Constructor for a poster of width by height split into tiles of tileWidth by tileHeight
+	Poster(int width, int height, int tileWidth, int tileHeight);
+
+	int tileCount() const { return columns * rows; }
+	// Rectangle of the poster's NDC square a tile covers, left, bottom, right and top
+	glm::vec4 Bounds(int tile) const;
+
+	// Names of the poster of a view and of one of its tiles, without extension, the poster is named like a plain view
+	static std::string Name(size_t view);
+	static std::string TileName(size_t view, int tile);
+	// Checks if the image of every tile of a view is in directory, images are only there once completely written
+	bool Complete(const std::string& directory, size_t view) const;
+	// Stitches the tiles of a view into its poster and deletes them, false with a message if a tile cannot be read or
+	// the poster cannot be written. Only one row of tiles is in memory at a time, the poster is streamed to its file
+	bool Stitch(const std::string& directory, size_t view) const;
+};
+
+#endif
@@ -0,0 +1,379 @@
+#include"Profiler.h"
+#include"GLStateCache.h"
+#include"GLDebugOutput.h"
+#include"GLExtensions.h"
+#include"TraceRecorder.h"
+
+#include<algorithm>
+#include<fstream>
+#include<sstream>
+#include<iomanip>
+
+// Id returned by Begin while the profiler is disabled
+static const size_t NO_ZONE = (size_t)-1;
+// Query targets in the order of Profiler::Statistic
+static const GLenum STATISTIC_TARGETS[] = { GL_VERTEX_SHADER_INVOCATIONS_ARB, GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+	GL_CLIPPING_OUTPUT_PRIMITIVES_ARB, GL_FRAGMENT_SHADER_INVOCATIONS_ARB };
+
+// Adds a sample, overwriting the oldest one once the ring is full
+void Profiler::History::Add(float sample, size_t capacity)
+{
+	// The whole ring is reserved up front, so adding samples never allocates after the first
+	if (samples.capacity() < capacity)
+		samples.reserve(capacity);
+	if (samples.size() < capacity)
+		samples.push_back(sample);
+	else
+		samples[next] = sample;
+	next = (next + 1) % capacity;
+}
+
+// The sample before next, which wraps around to the end of the ring
+float Profiler::History::Latest() const
+{
+	return samples[(next + samples.size() - 1) % samples.size()];
+}
+
+// Computes min, avg and p99 over the kept samples
+Profiler::Stats Profiler::History::Compute() const
+{
+	Stats stats;
+	stats.count = samples.size();
+	if (samples.empty())
+		return stats;
+
+	sorted.assign(samples.begin(), samples.end());
+	size_t p99 = std::min(sorted.size() - 1, (size_t)(0.99f * sorted.size()));
+	std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+	stats.p99 = sorted[p99];
+	stats.min = *std::min_element(samples.begin(), samples.end());
+	float sum = 0.0f;
+	for (float sample : samples)
+		sum += sample;
+	stats.avg = sum / samples.size();
+	return stats;
+}
+
+// Constructor that sets how many samples each zone keeps
+Profiler::Profiler(size_t history)
+{
+	Profiler::history = history > 0 ? history : 1;
+}
+
+// Finds a zone by name or creates it
+size_t Profiler::findZone(const char* name, bool gpu)
+{
+	for (size_t i = 0; i < zones.size(); i++)
+	{
+		if (zones[i].name == name)
+			return i;
+	}
+
+	Zone zone;
+	zone.name = name;
+	zone.gpu = gpu;
+	if (gpu)
+		glGenQueries(LATENCY * 2, &zone.queries[0][0]);
+	for (int i = 0; i < LATENCY; i++)
+	{
+		zone.pending[i] = false;
+		zone.statisticsPending[i] = false;
+	}
+	zones.push_back(zone);
+	return zones.size() - 1;
+}
+
+// Starts a new frame and reads the GPU results that are ready
+void Profiler::BeginFrame()
+{
+	if (!enabled)
+		return;
+	if (frameStarted)
+		End(frameZone);
+	// The frame is no debug group, it would stay open over the present
+	frameZone = findZone("frame", false);
+	zones[frameZone].cpuStart = std::chrono::steady_clock::now();
+	frameStarted = true;
+	if (frames++ % CALIBRATION_FRAMES == 0)
+		Tracer.Calibrate();
+
+	// The queries of this slot were issued LATENCY frames ago, results that are still not there get dropped
+	slot = (slot + 1) % LATENCY;
+	for (Zone& zone : zones)
+	{
+		if (!zone.pending[slot])
+			continue;
+		zone.pending[slot] = false;
+		GLint available = 0;
+		glGetQueryObjectiv(zone.queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(zone.queries[slot][0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(zone.queries[slot][1], GL_QUERY_RESULT, &end);
+		zone.gpuHistory.Add((end - start) / 1000000.0f, history);
+		zone.gpuFrame = frames;
+		Tracer.AddGpu(zone.name.c_str(), start, end);
+	}
+	for (Zone& zone : zones)
+	{
+		if (!zone.statisticsPending[slot])
+			continue;
+		zone.statisticsPending[slot] = false;
+		GLint available = 0;
+		glGetQueryObjectiv(zone.statistics[slot][STATISTICS - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+		for (int i = 0; i < STATISTICS; i++)
+		{
+			GLuint64 value = 0;
+			glGetQueryObjectui64v(zone.statistics[slot][i], GL_QUERY_RESULT, &value);
+			zone.statisticsSum[i] += value;
+		}
+		zone.statisticsCount++;
+	}
+}
+
+// Starts a zone and returns its index for End
+size_t Profiler::Begin(const char* name, bool gpu)
+{
+	if (!enabled)
+		return NO_ZONE;
+	size_t index = findZone(name, gpu);
+	Zone& zone = zones[index];
+	// Every zone is a debug group too, so GPU captures show the passes by name
+	GLDebug.PushGroup(name);
+	if (zone.gpu)
+		glQueryCounter(zone.queries[slot][0], GL_TIMESTAMP);
+	if (zone.gpu && pipelineStatistics && GLExt.pipelineStatistics)
+	{
+		if (!zone.hasStatistics)
+		{
+			glGenQueries(LATENCY * STATISTICS, &zone.statistics[0][0]);
+			zone.hasStatistics = true;
+		}
+		for (int i = 0; i < STATISTICS; i++)
+			glBeginQuery(STATISTIC_TARGETS[i], zone.statistics[slot][i]);
+		zone.statisticsPending[slot] = true;
+	}
+	zone.cpuStart = std::chrono::steady_clock::now();
+	return index;
+}
+
+// Ends a zone started with Begin
+void Profiler::End(size_t index)
+{
+	if (index == NO_ZONE || index >= zones.size())
+		return;
+	Zone& zone = zones[index];
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::duration<float, std::milli> elapsed = now - zone.cpuStart;
+	zone.cpu.Add(elapsed.count(), history);
+	zone.cpuFrame = frames;
+	Tracer.Add(zone.name.c_str(), "zone", zone.cpuStart, now);
+	if (zone.gpu)
+	{
+		glQueryCounter(zone.queries[slot][1], GL_TIMESTAMP);
+		zone.pending[slot] = true;
+	}
+	// Begin marked the queries it started, a zone is never ended twice in a frame
+	if (zone.statisticsPending[slot])
+	{
+		for (int i = 0; i < STATISTICS; i++)
+			glEndQuery(STATISTIC_TARGETS[i]);
+	}
+	if (index != frameZone)
+		GLDebug.PopGroup();
+}
+
+// Adds a CPU sample measured elsewhere
+void Profiler::Record(const char* name, float milliseconds)
+{
+	if (!enabled)
+		return;
+	Zone& zone = zones[findZone(name, false)];
+	zone.cpu.Add(milliseconds, history);
+	zone.cpuFrame = frames;
+}
+
+size_t Profiler::zoneCount() const
+{
+	return zones.size();
+}
+
+const std::string& Profiler::zoneName(size_t zone) const
+{
+	return zones[zone].name;
+}
+
+// Statistics of a zone on the CPU
+Profiler::Stats Profiler::CpuStats(size_t zone) const
+{
+	return zones[zone].cpu.Compute();
+}
+
+// Statistics of a zone on the GPU
+Profiler::Stats Profiler::GpuStats(size_t zone) const
+{
+	return zones[zone].gpuHistory.Compute();
+}
+
+// Pipeline statistics of a zone averaged per frame
+Profiler::PipelineStats Profiler::PipelineStatistics(size_t zone) const
+{
+	PipelineStats stats;
+	const Zone& source = zones[zone];
+	stats.count = source.statisticsCount;
+	if (stats.count == 0)
+		return stats;
+	stats.vertices = (double)source.statisticsSum[VERTICES] / stats.count;
+	stats.clipperInput = (double)source.statisticsSum[CLIPPER_INPUT] / stats.count;
+	stats.clipperOutput = (double)source.statisticsSum[CLIPPER_OUTPUT] / stats.count;
+	stats.fragments = (double)source.statisticsSum[FRAGMENTS] / stats.count;
+	return stats;
+}
+
+// BeginFrame ended the frame stamped one less than frames and read the GPU results stamped with it
+float Profiler::LastCpu(size_t zone) const
+{
+	const Zone& source = zones[zone];
+	return !source.cpu.samples.empty() && source.cpuFrame + 1 == frames ? source.cpu.Latest() : -1.0f;
+}
+
+float Profiler::LastGpu(size_t zone) const
+{
+	const Zone& source = zones[zone];
+	return !source.gpuHistory.samples.empty() && source.gpuFrame == frames ? source.gpuHistory.Latest() : -1.0f;
+}
+
+// One line of average times per zone
+std::string Profiler::Summary() const
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(2);
+	for (size_t i = 0; i < zones.size(); i++)
+	{
+		if (i > 0)
+			out << " | ";
+		out << zones[i].name << " " << CpuStats(i).avg;
+		if (zones[i].gpu)
+			out << "/" << GpuStats(i).avg;
+	}
+	out << " ms";
+	return out.str();
+}
+
+// Writes min, avg and p99 of every zone as CSV
+bool Profiler::WriteCSV(const char* path) const
+{
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << "zone,cpu_min,cpu_avg,cpu_p99,gpu_min,gpu_avg,gpu_p99,samples,vertex_invocations,clipper_input,clipper_output,fragment_invocations\n";
+	for (size_t i = 0; i < zones.size(); i++)
+	{
+		Stats cpu = CpuStats(i);
+		Stats gpu = GpuStats(i);
+		PipelineStats pipeline = PipelineStatistics(i);
+		file << zones[i].name << "," << cpu.min << "," << cpu.avg << "," << cpu.p99 << ","
+			<< gpu.min << "," << gpu.avg << "," << gpu.p99 << "," << cpu.count;
+		// Zones without statistics leave their columns empty
+		if (pipeline.count > 0)
+			file << "," << pipeline.vertices << "," << pipeline.clipperInput << "," << pipeline.clipperOutput << "," << pipeline.fragments;
+		else
+			file << ",,,,";
+		file << "\n";
+	}
+	return (bool)file;
+}
+
+// Writes min, avg and p99 of every zone as JSON
+bool Profiler::WriteJSON(const char* path) const
+{
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << "{\n  \"zones\": [\n";
+	for (size_t i = 0; i < zones.size(); i++)
+	{
+		Stats cpu = CpuStats(i);
+		Stats gpu = GpuStats(i);
+		file << "    { \"name\": \"" << zones[i].name << "\", \"samples\": " << cpu.count
+			<< ", \"cpu\": { \"min\": " << cpu.min << ", \"avg\": " << cpu.avg << ", \"p99\": " << cpu.p99 << " }";
+		if (zones[i].gpu)
+			file << ", \"gpu\": { \"min\": " << gpu.min << ", \"avg\": " << gpu.avg << ", \"p99\": " << gpu.p99 << " }";
+		PipelineStats pipeline = PipelineStatistics(i);
+		if (pipeline.count > 0)
+			file << ", \"pipeline\": { \"vertex_invocations\": " << pipeline.vertices << ", \"clipper_input\": " << pipeline.clipperInput
+				<< ", \"clipper_output\": " << pipeline.clipperOutput << ", \"fragment_invocations\": " << pipeline.fragments << " }";
+		file << " }" << (i + 1 < zones.size() ? "," : "") << "\n";
+	}
+	file << "  ]\n}\n";
+	return (bool)file;
+}
+
+// Draws a bar per zone in the top left corner of the framebuffer
+void Profiler::DrawOverlay(int width, int height) const
+{
+	// Scissored clears draw the bars without needing a shader or any geometry
+	GLfloat clearColor[4];
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+	GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+	GLState.Enable(GL_SCISSOR_TEST);
+
+	const float pixelsPerMs = 10.0f;
+	const int barHeight = 5;
+	int y = height - 10;
+	for (size_t i = 0; i < zones.size() && y > 0; i++)
+	{
+		// Every zone gets its own hue, CPU on top and the GPU bar darker right below
+		float r = 0.3f + 0.7f * ((i * 5) % 7) / 6.0f;
+		float g = 0.3f + 0.7f * ((i * 3 + 2) % 5) / 4.0f;
+		float b = 0.3f + 0.7f * ((i * 2 + 1) % 3) / 2.0f;
+		int cpuWidth = std::min(width - 10, (int)(CpuStats(i).avg * pixelsPerMs) + 1);
+		glScissor(10, y - barHeight, cpuWidth, barHeight);
+		glClearColor(r, g, b, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		if (zones[i].gpu)
+		{
+			int gpuWidth = std::min(width - 10, (int)(GpuStats(i).avg * pixelsPerMs) + 1);
+			glScissor(10, y - 2 * barHeight, gpuWidth, barHeight);
+			glClearColor(0.5f * r, 0.5f * g, 0.5f * b, 1.0f);
+			glClear(GL_COLOR_BUFFER_BIT);
+		}
+		y -= 3 * barHeight;
+	}
+	// Marker at 16.6 ms, the budget of a 60 Hz frame
+	glScissor(10 + (int)(16.6f * pixelsPerMs), y, 1, height - 10 - y);
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+	if (!scissor)
+		GLState.Disable(GL_SCISSOR_TEST);
+}
+
+// Deletes every query object
+void Profiler::Delete()
+{
+	for (Zone& zone : zones)
+	{
+		if (zone.gpu)
+			glDeleteQueries(LATENCY * 2, &zone.queries[0][0]);
+		if (zone.hasStatistics)
+			glDeleteQueries(LATENCY * STATISTICS, &zone.statistics[0][0]);
+	}
+	zones.clear();
+}
+
+// Constructor that starts the zone
+ProfileZone::ProfileZone(Profiler& profiler, const char* name, bool gpu) : profiler(profiler)
+{
+	zone = profiler.Begin(name, gpu);
+}
+
+// Destructor that ends the zone
+ProfileZone::~ProfileZone()
+{
+	profiler.End(zone);
+}
@@ -0,0 +1,157 @@
+#ifndef PROFILER_CLASS_H
+#define PROFILER_CLASS_H
+
+#include<glad/glad.h>
+#include<chrono>
+#include<string>
+#include<vector>
+
+// Measures named zones of the frame on the CPU with a high resolution clock and on the GPU with timestamp queries
+// GPU results are read LATENCY frames after they were issued, by then they are ready and reading them never stalls
+// GPU zones can also count vertex and fragment shader invocations and the primitives going in and out of the clipper,
+// zones must not overlap while they do since only one query per statistic can be active
+// While Tracer records, every zone also goes onto its timeline, the GPU zones with their timestamps
+class Profiler
+{
+public:
+	// Frames between issuing a GPU query and reading its result
+	static constexpr int LATENCY = 3;
+	// Default number of samples kept per zone for the statistics
+	static constexpr size_t HISTORY = 256;
+
+	// Statistics over the kept samples of a zone, in milliseconds
+	struct Stats
+	{
+		float min = 0.0f;
+		float avg = 0.0f;
+		float p99 = 0.0f;
+		size_t count = 0;
+	};
+
+	// Pipeline statistics of a zone, averaged per frame over the kept samples
+	struct PipelineStats
+	{
+		double vertices = 0.0;
+		double clipperInput = 0.0;
+		double clipperOutput = 0.0;
+		double fragments = 0.0;
+		size_t count = 0;
+	};
+
+	// Turns measuring on or off, zones cost almost nothing while disabled
+	bool enabled = true;
+	// Counts pipeline statistics in GPU zones, needs GLExt.pipelineStatistics
+	bool pipelineStatistics = false;
+
+	// Constructor that sets how many samples each zone keeps, a benchmark keeps every frame of the run
+	Profiler(size_t history = HISTORY);
+
+	// Starts a new frame, reads the GPU results that are ready and records the CPU time of the previous frame as "frame"
+	void BeginFrame();
+	// Starts a zone and returns its index for End, the zone is created the first time a name is used
+	size_t Begin(const char* name, bool gpu = true);
+	// Ends a zone started with Begin
+	void End(size_t zone);
+	// Adds a CPU sample to a zone that was measured somewhere Begin and End cannot reach, such as another thread
+	void Record(const char* name, float milliseconds);
+
+	// Number of zones used so far and their names
+	size_t zoneCount() const;
+	const std::string& zoneName(size_t zone) const;
+	// Statistics of a zone on the CPU and on the GPU
+	Stats CpuStats(size_t zone) const;
+	Stats GpuStats(size_t zone) const;
+	// Pipeline statistics of a zone, with a count of 0 if none were collected
+	PipelineStats PipelineStatistics(size_t zone) const;
+	// CPU time of a zone in the frame BeginFrame just ended, and its GPU time read by that BeginFrame, which is of the
+	// frame LATENCY before, both negative if the zone had none
+	float LastCpu(size_t zone) const;
+	float LastGpu(size_t zone) const;
+
+	// One line of average times per zone, short enough for a window title
+	std::string Summary() const;
+	// Writes min, avg and p99 of every zone as CSV or JSON, with the pipeline statistics of zones that collected them,
+	// returns false if the file cannot be written
+	bool WriteCSV(const char* path) const;
+	bool WriteJSON(const char* path) const;
+	// Draws a bar per zone in the top left corner of the framebuffer, 10 pixels per millisecond
+	void DrawOverlay(int width, int height) const;
+
+	// Deletes every query object
+	void Delete();
+private:
+	// Ring of the last HISTORY samples of a zone
+	struct History
+	{
+		std::vector<float> samples;
+		size_t next = 0;
+		// Copy Compute partially sorts, kept so computing the statistics does not allocate
+		mutable std::vector<float> sorted;
+
+		void Add(float sample, size_t capacity);
+		Stats Compute() const;
+		// The sample added last, which has to exist
+		float Latest() const;
+	};
+
+	// Order of the pipeline statistics queries of a zone
+	enum Statistic
+	{
+		VERTICES,
+		CLIPPER_INPUT,
+		CLIPPER_OUTPUT,
+		FRAGMENTS,
+		STATISTICS
+	};
+
+	struct Zone
+	{
+		std::string name;
+		bool gpu;
+		History cpu;
+		History gpuHistory;
+		std::chrono::steady_clock::time_point cpuStart;
+		// Value of frames when the last CPU and GPU samples were added
+		size_t cpuFrame = 0;
+		size_t gpuFrame = 0;
+		// Begin and end timestamp queries of the last LATENCY frames
+		GLuint queries[LATENCY][2];
+		bool pending[LATENCY];
+		// Pipeline statistics queries of the last LATENCY frames, created the first time the zone collects them
+		bool hasStatistics = false;
+		GLuint statistics[LATENCY][STATISTICS];
+		bool statisticsPending[LATENCY];
+		// Sums over the frames read so far
+		GLuint64 statisticsSum[STATISTICS] = {};
+		size_t statisticsCount = 0;
+	};
+
+	std::vector<Zone> zones;
+	size_t history;
+	// Slot of the queries issued this frame
+	int slot = 0;
+	bool frameStarted = false;
+	// Frames started, the GPU clock is matched to the CPU clock of the timeline every CALIBRATION_FRAMES of them
+	static constexpr size_t CALIBRATION_FRAMES = 60;
+	size_t frames = 0;
+	// No zone until the first frame starts, so no zone of the startup is taken for it
+	size_t frameZone = (size_t)-1;
+
+	// Finds a zone by name or creates it
+	size_t findZone(const char* name, bool gpu);
+};
+
+// Profiles the scope it lives in
+class ProfileZone
+{
+public:
+	// Constructor that starts the zone
+	ProfileZone(Profiler& profiler, const char* name, bool gpu = true);
+	// Destructor that ends the zone
+	~ProfileZone();
+private:
+	Profiler& profiler;
+	size_t zone;
+};
+
+#endif
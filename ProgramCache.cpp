@@ -0,0 +1,139 @@
+#include"ProgramCache.h"
+#include"GLStateCache.h"
+#include"GLExtensions.h"
+
+#include<filesystem>
+#include<fstream>
+#include<vector>
+#include<cstdio>
+
+namespace fs = std::filesystem;
+
+std::string ProgramCache::directory = "shadercache";
+bool ProgramCache::enabled = true;
+
+// Start of every cache file, followed by the key, the binary format, the binary length and the binary
+static const uint32_t CACHE_MAGIC = 0x42504C47; // "GLPB"
+
+// 64 bit FNV-1a over a string including its terminator, so "ab" + "c" and "a" + "bc" differ
+static uint64_t hashString(uint64_t hash, const char* text)
+{
+	if (!text)
+		text = "";
+	do
+	{
+		hash ^= (unsigned char)*text;
+		hash *= 0x100000001b3ull;
+	} while (*text++);
+	return hash;
+}
+
+// Hash the binaries of these sources are stored under on the current driver
+uint64_t ProgramCache::Key(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hash = hashString(hash, (const char*)glGetString(GL_VENDOR));
+	hash = hashString(hash, (const char*)glGetString(GL_RENDERER));
+	hash = hashString(hash, (const char*)glGetString(GL_VERSION));
+	hash = hashString(hash, vertexSource.c_str());
+	hash = hashString(hash, fragmentSource.c_str());
+	return hash;
+}
+
+// File a key is stored in
+std::string ProgramCache::path(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	return (fs::path(directory) / name).string();
+}
+
+// Creates a program from a cached binary of these sources
+GLuint ProgramCache::Load(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	if (!enabled || !GLExt.programBinary)
+		return 0;
+	uint64_t key = Key(vertexSource, fragmentSource);
+	std::ifstream file(path(key), std::ios::binary);
+	if (!file)
+		return 0;
+
+	uint32_t magic = 0, format = 0, length = 0;
+	uint64_t storedKey = 0;
+	file.read((char*)&magic, sizeof(magic));
+	file.read((char*)&storedKey, sizeof(storedKey));
+	file.read((char*)&format, sizeof(format));
+	file.read((char*)&length, sizeof(length));
+	if (!file || magic != CACHE_MAGIC || storedKey != key || length == 0)
+		return 0;
+	std::vector<char> binary(length);
+	if (!file.read(binary.data(), length))
+		return 0;
+
+	// The driver may still refuse a binary it wrote itself, for example after a silent update
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, (GLenum)format, binary.data(), (GLsizei)length);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		GLState.DeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
+
+// Asks the driver to keep the binary of a program around
+void ProgramCache::PrepareLink(GLuint program)
+{
+	if (enabled && GLExt.programBinary)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+// Writes the binary of a linked program
+bool ProgramCache::Store(GLuint program, const std::string& vertexSource, const std::string& fragmentSource)
+{
+	if (!enabled || !GLExt.programBinary)
+		return false;
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (linked != GL_TRUE || length <= 0)
+		return false;
+	std::vector<char> binary(length);
+	GLenum format = 0;
+	GLsizei written = 0;
+	glGetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0)
+		return false;
+
+	std::error_code error;
+	fs::create_directories(directory, error);
+	uint64_t key = Key(vertexSource, fragmentSource);
+	std::string output = path(key);
+	// Written next to the final name and renamed, so another instance never reads half a file
+	std::string temporary = output + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		uint32_t magic = CACHE_MAGIC, storedFormat = (uint32_t)format, storedLength = (uint32_t)written;
+		file.write((const char*)&magic, sizeof(magic));
+		file.write((const char*)&key, sizeof(key));
+		file.write((const char*)&storedFormat, sizeof(storedFormat));
+		file.write((const char*)&storedLength, sizeof(storedLength));
+		file.write(binary.data(), written);
+		if (!file)
+		{
+			file.close();
+			fs::remove(temporary, error);
+			return false;
+		}
+	}
+	fs::rename(temporary, output, error);
+	if (error)
+	{
+		fs::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,32 @@
+#ifndef PROGRAM_CACHE_CLASS_H
+#define PROGRAM_CACHE_CLASS_H
+
+#include<glad/glad.h>
+#include<string>
+#include<cstdint>
+
+// On disk cache of linked Shader Programs, so a launch only runs the GLSL compiler for sources it has not seen
+// Binaries are keyed by a hash of the sources and of the driver vendor, renderer and version, a driver update
+// simply misses the cache. Everything silently turns into a miss when the driver cannot save programs.
+class ProgramCache
+{
+public:
+	// Directory the binaries are kept in, relative to the working directory
+	static std::string directory;
+	// Turns the cache off, every program is compiled from source
+	static bool enabled;
+
+	// Creates a program from a cached binary of these sources, returns 0 when there is none or the driver rejects it
+	static GLuint Load(const std::string& vertexSource, const std::string& fragmentSource);
+	// Asks the driver to keep the binary of a program around, call it before glLinkProgram
+	static void PrepareLink(GLuint program);
+	// Writes the binary of a linked program, returns false if it could not be saved
+	static bool Store(GLuint program, const std::string& vertexSource, const std::string& fragmentSource);
+	// Hash the binaries of these sources are stored under on the current driver
+	static uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource);
+private:
+	// File a key is stored in
+	static std::string path(uint64_t key);
+};
+
+#endif
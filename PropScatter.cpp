@@ -0,0 +1,162 @@
+#include"PropScatter.h"
+
+#include<algorithm>
+
+// Mixes the bits of a number so that neighbouring props get unrelated values, as CityGenerator does for its lots
+static unsigned int hashProp(unsigned int x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+// Turns a hash into a float between 0 and 1
+static float unitFloat(unsigned int hash)
+{
+	return (hash >> 8) * (1.0f / 16777216.0f);
+}
+
+// Constructor that keeps the city the props are placed around
+PropScatter::PropScatter(const CityGenerator& city, unsigned int perTile)
+	: perTile(std::max(perTile, 1u)), city(city)
+{
+}
+
+size_t PropScatter::propCount() const
+{
+	return tileCount() * perTile;
+}
+
+size_t PropScatter::tileCount() const
+{
+	return city.blockCount();
+}
+
+// Writes one record per prop, tile by tile
+void PropScatter::Generate(GLfloat* props) const
+{
+	size_t tiles = tileCount();
+	for (size_t tile = 0; tile < tiles; tile++)
+		for (unsigned int i = 0; i < perTile; i++)
+			props = writeProp(props, tile, i);
+}
+
+// Writes one record per tile, a low box under the canopies of its sidewalk
+void PropScatter::GenerateTiles(GLfloat* tiles) const
+{
+	size_t count = tileCount();
+	for (size_t tile = 0; tile < count; tile++)
+	{
+		float minX, minZ, maxX, maxZ;
+		sidewalk(tile, minX, minZ, maxX, maxZ);
+		tiles = writeBox(tiles, 0.5f * (minX + maxX), 0.5f * (minZ + maxZ), maxX - minX, 0.3f, maxZ - minZ, CANOPY_COLOR);
+	}
+}
+
+// Corners of the lots of a block, widened by the sidewalk
+void PropScatter::sidewalk(size_t block, float& minX, float& minZ, float& maxX, float& maxZ) const
+{
+	// Footprints are centered on their lots, so the first and last lot of the block give its corners
+	const CityLayout& layout = city.layout;
+	size_t first = block * city.lotsPerBlock();
+	Building low = city.building(first);
+	Building high = city.building(first + city.lotsPerBlock() - 1);
+	float out = 0.3f * layout.streetWidth;
+	minX = 0.5f * (low.minX + low.maxX - layout.lotSize) - out;
+	minZ = 0.5f * (low.minZ + low.maxZ - layout.lotSize) - out;
+	maxX = 0.5f * (high.minX + high.maxX + layout.lotSize) + out;
+	maxZ = 0.5f * (high.minZ + high.maxZ + layout.lotSize) + out;
+}
+
+// Writes the record of one prop of a block
+GLfloat* PropScatter::writeProp(GLfloat* out, size_t block, unsigned int index) const
+{
+	const CityLayout& layout = city.layout;
+	unsigned int hash = hashProp(((unsigned int)block * perTile + index) * 0x9e3779b9U ^ hashProp(layout.seed + 2));
+	float treeHeight = 0.35f + 0.25f * unitFloat(hashProp(hash + 1));
+
+	// Two in five props are yard trees, the others go round the sidewalk at even steps
+	unsigned int yardCount = perTile * 2 / 5;
+	unsigned int streetCount = perTile - yardCount;
+	if (index < streetCount)
+	{
+		float minX, minZ, maxX, maxZ;
+		sidewalk(block, minX, minZ, maxX, maxZ);
+		float width = maxX - minX;
+		float depth = maxZ - minZ;
+		float t = ((float)index + 0.5f) / (float)streetCount * 2.0f * (width + depth);
+		// Walks the sides in turn, along X on the first and third
+		float x, z;
+		bool alongX = true;
+		if (t < width)
+		{
+			x = minX + t;
+			z = minZ;
+		}
+		else if (t < width + depth)
+		{
+			x = maxX;
+			z = minZ + t - width;
+			alongX = false;
+		}
+		else if (t < 2.0f * width + depth)
+		{
+			x = maxX - (t - width - depth);
+			z = maxZ;
+		}
+		else
+		{
+			x = minX;
+			z = maxZ - (t - 2.0f * width - depth);
+			alongX = false;
+		}
+		// A lamp, a tree, a bench and a tree again, benches lie along the street
+		switch (index % 4)
+		{
+		case 0:
+			return writeBox(out, x, z, 0.03f, 0.6f, 0.03f, LAMP_COLOR);
+		case 2:
+			return writeBox(out, x, z, alongX ? 0.25f : 0.08f, 0.06f, alongX ? 0.08f : 0.25f, BENCH_COLOR);
+		default:
+			return writeBox(out, x, z, 0.18f, treeHeight, 0.18f, TREE_COLOR);
+		}
+	}
+
+	// A yard tree stands in the strip between a building and one side of its lot, as wide as the strip allows
+	size_t first = block * city.lotsPerBlock();
+	Building building = city.building(first + hashProp(hash + 2) % city.lotsPerBlock());
+	float lotMinX = 0.5f * (building.minX + building.maxX - layout.lotSize);
+	float lotMinZ = 0.5f * (building.minZ + building.maxZ - layout.lotSize);
+	float lotMaxX = lotMinX + layout.lotSize;
+	float lotMaxZ = lotMinZ + layout.lotSize;
+	unsigned int side = hashProp(hash + 3) % 4;
+	float stripLow = side == 0 ? lotMinZ : side == 1 ? building.maxZ : side == 2 ? lotMinX : building.maxX;
+	float stripHigh = side == 0 ? building.minZ : side == 1 ? lotMaxZ : side == 2 ? building.minX : lotMaxX;
+	float size = std::clamp(0.8f * (stripHigh - stripLow), 0.04f, 0.25f);
+	float across = 0.5f * (stripLow + stripHigh);
+	float along = (side < 2 ? lotMinX : lotMinZ) + 0.5f * size + (layout.lotSize - size) * unitFloat(hashProp(hash + 4));
+	return side < 2 ? writeBox(out, along, across, size, treeHeight, size, TREE_COLOR) : writeBox(out, across, along, size, treeHeight, size, TREE_COLOR);
+}
+
+// Writes a record that scales the unit building into a box centered on x and z
+GLfloat* PropScatter::writeBox(GLfloat* out, float x, float z, float width, float height, float depth, const GLfloat* color)
+{
+	// Translation of the footprint corner and scale of the unit building
+	out[0] = x - 0.5f * width;
+	out[1] = 0.0f;
+	out[2] = z - 0.5f * depth;
+	out[3] = width;
+	out[4] = height;
+	out[5] = depth;
+	// Facade layer 0 like the ground, fully drawn until the level of detail fades it
+	out[6] = 0.0f;
+	out[7] = 0.0f;
+	out[8] = color[0];
+	out[9] = color[1];
+	out[10] = color[2];
+	out[11] = 0.0f;
+	return out + CityGenerator::INSTANCE_FLOATS;
+}
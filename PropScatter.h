@@ -0,0 +1,48 @@
+#ifndef PROP_SCATTER_CLASS_H
+#define PROP_SCATTER_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"CityGenerator.h"
+
+// Places trees, street lamps and benches around the buildings of a generated city, the same seed always gives the
+// same props. Every block is a tile of the same number of props: most stand along the sidewalk around the block at
+// even steps, the rest are trees in the yards the buildings leave free on their lots. Props are records of
+// CityGenerator's layout that scale the unit building into a tinted box, stored tile by tile, so a GpuCuller can
+// take the tiles for blocks: each tile has a record of its own, a low box of canopy color along its sidewalk
+// that stands in for the whole row once it is too small on screen.
+class PropScatter
+{
+public:
+	// Tints of the props, which sample facade layer 0 like the ground
+	static constexpr GLfloat TREE_COLOR[3] = { 0.18f, 0.42f, 0.16f };
+	static constexpr GLfloat LAMP_COLOR[3] = { 0.25f, 0.25f, 0.28f };
+	static constexpr GLfloat BENCH_COLOR[3] = { 0.45f, 0.3f, 0.18f };
+	static constexpr GLfloat CANOPY_COLOR[3] = { 0.16f, 0.36f, 0.14f };
+
+	// Props of every tile
+	unsigned int perTile;
+
+	// Constructor for perTile props around every block of city
+	PropScatter(const CityGenerator& city, unsigned int perTile);
+
+	// Number of props and tiles, tile t holds the perTile props starting at t * perTile
+	size_t propCount() const;
+	size_t tileCount() const;
+	// Writes one record per prop into an array sized by propCount * CityGenerator::INSTANCE_FLOATS
+	void Generate(GLfloat* props) const;
+	// Writes one record per tile into an array sized by tileCount * CityGenerator::INSTANCE_FLOATS
+	void GenerateTiles(GLfloat* tiles) const;
+private:
+	const CityGenerator& city;
+
+	// Corners of the lots of a block, widened by the sidewalk the street props stand on
+	void sidewalk(size_t block, float& minX, float& minZ, float& maxX, float& maxZ) const;
+	// Writes the record of prop index of a block and returns the position right after it
+	GLfloat* writeProp(GLfloat* out, size_t block, unsigned int index) const;
+	// Writes a record that scales the unit building into a box of a color
+	static GLfloat* writeBox(GLfloat* out, float x, float z, float width, float height, float depth, const GLfloat* color);
+};
+
+#endif
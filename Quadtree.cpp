@@ -0,0 +1,696 @@
+#include"Quadtree.h"
+
+#include<algorithm>
+#include<cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUADTREE_SSE 1
+#include<emmintrin.h>
+#endif
+
+// Constructor that covers a square region of the ground plane
+Quadtree::Quadtree(glm::vec2 regionMin, float regionSize, uint32_t leafCapacity, uint32_t maxDepth)
+{
+	Quadtree::regionMin = regionMin;
+	Quadtree::regionSize = regionSize;
+	Quadtree::leafCapacity = leafCapacity;
+	// Traversal stacks are sized for at most 63 levels
+	Quadtree::maxDepth = std::min<uint32_t>(maxDepth, 63);
+	reset();
+}
+
+// Resets the tree to a single empty root
+void Quadtree::reset()
+{
+	nodes.clear();
+	parent.clear();
+	depth.clear();
+	Node root;
+	root.min = glm::vec3(FLT_MAX);
+	root.max = glm::vec3(-FLT_MAX);
+	root.regionX = regionMin.x;
+	root.regionZ = regionMin.y;
+	root.regionSize = regionSize;
+	root.firstChild = 0;
+	root.firstItem = INVALID;
+	root.itemCount = 0;
+	nodes.push_back(root);
+	parent.push_back(INVALID);
+	depth.push_back(0);
+}
+
+// Throws away every node and builds the tree again from all current items
+void Quadtree::Build()
+{
+	reset();
+	for (uint32_t id = 0; id < itemNode.size(); id++)
+	{
+		if (itemNode[id] == INVALID)
+			continue;
+		link(id, findLeaf(0.5f * (itemMin[id].x + itemMax[id].x), 0.5f * (itemMin[id].z + itemMax[id].z)));
+	}
+	pack();
+}
+
+// Packs the boxes of every leaf after Build
+void Quadtree::pack()
+{
+	packedBoxes.Clear();
+	packedIds.clear();
+	packedFirst.assign(nodes.size(), 0);
+	for (uint32_t node = 0; node < nodes.size(); node++)
+	{
+		if (nodes[node].firstChild != 0)
+			continue;
+		packedFirst[node] = (uint32_t)packedIds.size();
+		for (uint32_t item = nodes[node].firstItem; item != INVALID; item = itemNext[item])
+		{
+			packedBoxes.Add(itemMin[item], itemMax[item]);
+			packedIds.push_back(item);
+		}
+	}
+	packed = true;
+}
+
+// Levels the cells of the Morton codes go down to, two bits a level in 32 bit codes
+static constexpr uint32_t MORTON_LEVELS = 16;
+// Items a slice of the parallel build takes at least
+static constexpr size_t BUILD_GRAIN = 4096;
+
+// Builds the same tree with the workers from the items sorted by Morton code
+void Quadtree::Build(JobSystem& jobs)
+{
+	std::vector<uint32_t> items;
+	items.reserve(itemTotal);
+	for (uint32_t id = 0; id < itemNode.size(); id++)
+		if (itemNode[id] != INVALID)
+			items.push_back(id);
+	size_t count = items.size();
+
+	// Every level adds the child index findLeaf picks, the x bit the even one and the z bit the odd one. The cells are
+	// found with its comparisons against the same halved regions the nodes get, rather than by scaling the centre,
+	// so a centre on the border of two cells goes the same way and points outside the region go to the border cells
+	uint32_t levels = std::min(maxDepth, MORTON_LEVELS);
+	std::vector<uint32_t> codes(count);
+	jobs.ParallelFor(count, BUILD_GRAIN, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t id = items[i];
+			float x = 0.5f * (itemMin[id].x + itemMax[id].x);
+			float z = 0.5f * (itemMin[id].z + itemMax[id].z);
+			float cellX = regionMin.x, cellZ = regionMin.y, cellSize = regionSize;
+			uint32_t code = 0;
+			for (uint32_t level = 0; level < levels; level++)
+			{
+				float half = 0.5f * cellSize;
+				uint32_t child = (x >= cellX + half ? 1 : 0) + (z >= cellZ + half ? 2 : 0);
+				code = (code << 2) | child;
+				cellX += (child & 1) ? half : 0.0f;
+				cellZ += (child & 2) ? half : 0.0f;
+				cellSize = half;
+			}
+			codes[i] = code;
+		}
+	});
+	sortByCode(jobs, codes, items, 2 * levels);
+
+	// Nodes are made a level at a time, so the four children of a node are next to each other and every level is one
+	// run of the array. A node splits its run where the two bits of its level change, like split does when it is full
+	reset();
+	std::vector<uint32_t> runBegin(1, 0), runEnd(1, (uint32_t)count);
+	for (uint32_t levelStart = 0, levelEnd = 1; levelStart < levelEnd; levelStart = levelEnd, levelEnd = (uint32_t)nodes.size())
+	{
+		for (uint32_t node = levelStart; node < levelEnd; node++)
+		{
+			if (runEnd[node] - runBegin[node] <= leafCapacity || depth[node] >= levels)
+				continue;
+			uint32_t shift = 2 * (levels - 1 - depth[node]);
+			uint32_t firstChild = (uint32_t)nodes.size();
+			uint32_t begin = runBegin[node];
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				uint32_t end = i == 3 ? runEnd[node] : (uint32_t)(std::partition_point(codes.begin() + begin, codes.begin() + runEnd[node],
+					[&](uint32_t code) { return ((code >> shift) & 3) <= i; }) - codes.begin());
+				const Node& n = nodes[node];
+				float half = 0.5f * n.regionSize;
+				Node child;
+				child.min = glm::vec3(FLT_MAX);
+				child.max = glm::vec3(-FLT_MAX);
+				child.regionX = n.regionX + ((i & 1) ? half : 0.0f);
+				child.regionZ = n.regionZ + ((i & 2) ? half : 0.0f);
+				child.regionSize = half;
+				child.firstChild = 0;
+				child.firstItem = INVALID;
+				child.itemCount = 0;
+				nodes.push_back(child);
+				parent.push_back(node);
+				depth.push_back(depth[node] + 1);
+				runBegin.push_back(begin);
+				runEnd.push_back(end);
+				begin = end;
+			}
+			nodes[node].firstChild = firstChild;
+		}
+	}
+
+	// Each leaf links and bounds its own run, the lists keep the sorted order
+	jobs.ParallelFor(nodes.size(), 64, [&](size_t, size_t begin, size_t end) {
+		for (size_t node = begin; node < end; node++)
+		{
+			Node& n = nodes[node];
+			if (n.firstChild != 0 || runBegin[node] == runEnd[node])
+				continue;
+			n.firstItem = items[runBegin[node]];
+			n.itemCount = runEnd[node] - runBegin[node];
+			for (uint32_t i = runBegin[node]; i < runEnd[node]; i++)
+			{
+				uint32_t id = items[i];
+				itemNode[id] = (uint32_t)node;
+				itemPrev[id] = i > runBegin[node] ? items[i - 1] : INVALID;
+				itemNext[id] = i + 1 < runEnd[node] ? items[i + 1] : INVALID;
+				n.min = glm::min(n.min, itemMin[id]);
+				n.max = glm::max(n.max, itemMax[id]);
+			}
+		}
+	});
+	// Children always come after their parent, so going backwards grows every parent from finished children
+	for (size_t node = nodes.size(); node-- > 1;)
+	{
+		Node& above = nodes[parent[node]];
+		above.min = glm::min(above.min, nodes[node].min);
+		above.max = glm::max(above.max, nodes[node].max);
+	}
+
+	// Leaves still full at the deepest level of the codes split the way Insert splits them
+	bool deeper = false;
+	if (levels < maxDepth)
+	{
+		for (uint32_t node = 0; node < nodes.size(); node++)
+		{
+			if (nodes[node].firstChild == 0 && nodes[node].itemCount > leafCapacity && depth[node] < maxDepth)
+			{
+				split(node);
+				deeper = true;
+			}
+		}
+	}
+	if (deeper)
+	{
+		pack();
+		return;
+	}
+
+	// The runs of the leaves are the packed order already
+	packedIds = items;
+	packedFirst.assign(runBegin.begin(), runBegin.end());
+	packedBoxes.minX.resize(count);
+	packedBoxes.minY.resize(count);
+	packedBoxes.minZ.resize(count);
+	packedBoxes.maxX.resize(count);
+	packedBoxes.maxY.resize(count);
+	packedBoxes.maxZ.resize(count);
+	jobs.ParallelFor(count, BUILD_GRAIN, [&](size_t, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t id = items[i];
+			packedBoxes.minX[i] = itemMin[id].x;
+			packedBoxes.minY[i] = itemMin[id].y;
+			packedBoxes.minZ[i] = itemMin[id].z;
+			packedBoxes.maxX[i] = itemMax[id].x;
+			packedBoxes.maxY[i] = itemMax[id].y;
+			packedBoxes.maxZ[i] = itemMax[id].z;
+		}
+	});
+	packed = true;
+}
+
+// Sorts items by their codes with a radix sort of 8 bits a pass on the workers
+void Quadtree::sortByCode(JobSystem& jobs, std::vector<uint32_t>& codes, std::vector<uint32_t>& items, uint32_t bits)
+{
+	size_t count = codes.size();
+	size_t slices = jobs.Slices(count, BUILD_GRAIN);
+	std::vector<uint32_t> codesOut(count), itemsOut(count);
+	std::vector<size_t> offsets(slices * 256);
+	for (uint32_t shift = 0; shift < bits; shift += 8)
+	{
+		// Every slice counts its digits, then writes them after the same digits of the slices before it, which keeps
+		// the sort stable so the passes of the lower bits hold
+		std::fill(offsets.begin(), offsets.end(), 0);
+		jobs.ParallelFor(count, BUILD_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+			size_t* counts = &offsets[slice * 256];
+			for (size_t i = begin; i < end; i++)
+				counts[(codes[i] >> shift) & 255]++;
+		});
+		size_t total = 0;
+		for (size_t digit = 0; digit < 256; digit++)
+		{
+			for (size_t slice = 0; slice < slices; slice++)
+			{
+				size_t digits = offsets[slice * 256 + digit];
+				offsets[slice * 256 + digit] = total;
+				total += digits;
+			}
+		}
+		jobs.ParallelFor(count, BUILD_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+			size_t* next = &offsets[slice * 256];
+			for (size_t i = begin; i < end; i++)
+			{
+				size_t to = next[(codes[i] >> shift) & 255]++;
+				codesOut[to] = codes[i];
+				itemsOut[to] = items[i];
+			}
+		});
+		codes.swap(codesOut);
+		items.swap(itemsOut);
+	}
+}
+
+// Adds an item or moves an existing one to new bounds
+void Quadtree::Insert(uint32_t id, const glm::vec3& min, const glm::vec3& max)
+{
+	if (id >= itemNode.size())
+	{
+		size_t newSize = std::max<size_t>(id + 1, itemNode.size() * 2);
+		itemMin.resize(newSize);
+		itemMax.resize(newSize);
+		itemNode.resize(newSize, INVALID);
+		itemNext.resize(newSize, INVALID);
+		itemPrev.resize(newSize, INVALID);
+	}
+	if (itemNode[id] != INVALID)
+		Remove(id);
+	packed = false;
+
+	itemMin[id] = min;
+	itemMax[id] = max;
+	link(id, findLeaf(0.5f * (min.x + max.x), 0.5f * (min.z + max.z)));
+	itemTotal++;
+}
+
+// Removes an item, does nothing if it is not stored
+void Quadtree::Remove(uint32_t id)
+{
+	if (!Contains(id))
+		return;
+	// Bounds above the item are not shrunk, they stay correct if a bit loose until the next Build
+	unlink(id);
+	packed = false;
+	itemNode[id] = INVALID;
+	itemTotal--;
+}
+
+// Checks if an item is stored
+bool Quadtree::Contains(uint32_t id) const
+{
+	return id < itemNode.size() && itemNode[id] != INVALID;
+}
+
+size_t Quadtree::size() const
+{
+	return itemTotal;
+}
+
+// Finds the leaf whose region holds a point of the ground plane
+uint32_t Quadtree::findLeaf(float x, float z) const
+{
+	uint32_t node = 0;
+	while (nodes[node].firstChild != 0)
+	{
+		const Node& n = nodes[node];
+		float half = 0.5f * n.regionSize;
+		// Points outside the region go to the closest child
+		uint32_t child = (x >= n.regionX + half ? 1 : 0) + (z >= n.regionZ + half ? 2 : 0);
+		node = n.firstChild + child;
+	}
+	return node;
+}
+
+// Links an item into a leaf, grows the bounds above it and splits the leaf when it is full
+void Quadtree::link(uint32_t id, uint32_t leaf)
+{
+	Node& n = nodes[leaf];
+	itemNode[id] = leaf;
+	itemPrev[id] = INVALID;
+	itemNext[id] = n.firstItem;
+	if (n.firstItem != INVALID)
+		itemPrev[n.firstItem] = id;
+	n.firstItem = id;
+	n.itemCount++;
+
+	for (uint32_t node = leaf; node != INVALID; node = parent[node])
+	{
+		nodes[node].min = glm::min(nodes[node].min, itemMin[id]);
+		nodes[node].max = glm::max(nodes[node].max, itemMax[id]);
+	}
+
+	if (nodes[leaf].itemCount > leafCapacity && depth[leaf] < maxDepth)
+		split(leaf);
+}
+
+// Unlinks an item from its leaf
+void Quadtree::unlink(uint32_t id)
+{
+	Node& n = nodes[itemNode[id]];
+	if (itemPrev[id] != INVALID)
+		itemNext[itemPrev[id]] = itemNext[id];
+	else
+		n.firstItem = itemNext[id];
+	if (itemNext[id] != INVALID)
+		itemPrev[itemNext[id]] = itemPrev[id];
+	n.itemCount--;
+}
+
+// Splits a leaf into four children and moves its items into them
+void Quadtree::split(uint32_t leaf)
+{
+	uint32_t firstChild = (uint32_t)nodes.size();
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		// Reading the leaf again every time since push_back can move the array
+		const Node& n = nodes[leaf];
+		float half = 0.5f * n.regionSize;
+		Node child;
+		child.min = glm::vec3(FLT_MAX);
+		child.max = glm::vec3(-FLT_MAX);
+		child.regionX = n.regionX + ((i & 1) ? half : 0.0f);
+		child.regionZ = n.regionZ + ((i & 2) ? half : 0.0f);
+		child.regionSize = half;
+		child.firstChild = 0;
+		child.firstItem = INVALID;
+		child.itemCount = 0;
+		nodes.push_back(child);
+		parent.push_back(leaf);
+		depth.push_back(depth[leaf] + 1);
+	}
+
+	uint32_t item = nodes[leaf].firstItem;
+	nodes[leaf].firstChild = firstChild;
+	nodes[leaf].firstItem = INVALID;
+	nodes[leaf].itemCount = 0;
+	while (item != INVALID)
+	{
+		uint32_t next = itemNext[item];
+		link(item, findLeaf(0.5f * (itemMin[item].x + itemMax[item].x), 0.5f * (itemMin[item].z + itemMax[item].z)));
+		item = next;
+	}
+}
+
+// Writes every item below a node without testing them
+size_t Quadtree::collect(uint32_t node, uint32_t* result) const
+{
+	size_t count = 0;
+	uint32_t stack[64 * 3];
+	size_t top = 0;
+	stack[top++] = node;
+	while (top > 0)
+	{
+		const Node& n = nodes[stack[--top]];
+		if (n.firstChild != 0)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+				stack[top++] = n.firstChild + i;
+			continue;
+		}
+		for (uint32_t item = n.firstItem; item != INVALID; item = itemNext[item])
+			result[count++] = item;
+	}
+	return count;
+}
+
+// Appends the ids of all items that are at least partly inside the frustum
+void Quadtree::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const
+{
+	size_t start = result.size();
+	result.resize(start + itemTotal);
+	result.resize(start + QueryFrustum(frustum, result.data() + start));
+}
+
+// Same as QueryFrustum but writes into an array with room for every item and returns the count
+size_t Quadtree::QueryFrustum(const Frustum& frustum, uint32_t* result) const
+{
+	return QueryFrustum(frustum, result, nullptr);
+}
+
+// Same with a second test of the nodes, run after the frustum's since that one is cheaper
+size_t Quadtree::QueryFrustum(const Frustum& frustum, uint32_t* result, const std::function<bool(const glm::vec3& min, const glm::vec3& max)>& hidden) const
+{
+	size_t count = 0;
+	// Depth is limited by maxDepth and each level pushes at most 3 more nodes than it pops
+	uint32_t stack[64 * 3];
+	size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		uint32_t index = stack[--top];
+		const Node& n = nodes[index];
+		if (n.min.x > n.max.x || !frustum.TestBox(n.min, n.max))
+			continue;
+		if (hidden && hidden(n.min, n.max))
+			continue;
+		// Everything below a node that is fully inside is visible without further tests
+		if (frustum.ContainsBox(n.min, n.max))
+		{
+			count += collect(index, result + count);
+			continue;
+		}
+		if (n.firstChild != 0)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+				stack[top++] = n.firstChild + i;
+			continue;
+		}
+		for (uint32_t item = n.firstItem; item != INVALID; item = itemNext[item])
+		{
+			if (frustum.TestBox(itemMin[item], itemMax[item]))
+				result[count++] = item;
+		}
+	}
+	return count;
+}
+
+// Squared distance from a point to a box, 0 inside of it
+static float distanceSquared(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 closest = glm::clamp(point, min, max);
+	glm::vec3 offset = point - closest;
+	return glm::dot(offset, offset);
+}
+
+// Appends the ids of all items whose bounds are within radius of center
+void Quadtree::QueryRadius(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const
+{
+	float radiusSquared = radius * radius;
+	uint32_t stack[64 * 3];
+	size_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const Node& n = nodes[stack[--top]];
+		if (n.min.x > n.max.x || distanceSquared(center, n.min, n.max) > radiusSquared)
+			continue;
+		if (n.firstChild != 0)
+		{
+			for (uint32_t i = 0; i < 4; i++)
+				stack[top++] = n.firstChild + i;
+			continue;
+		}
+		for (uint32_t item = n.firstItem; item != INVALID; item = itemNext[item])
+		{
+			if (distanceSquared(center, itemMin[item], itemMax[item]) <= radiusSquared)
+				result.push_back(item);
+		}
+	}
+}
+
+// Distance along a ray to where it enters a box, or FLT_MAX if it misses it
+// A ray starting inside the box enters it at 0 if fromInside is set and misses it otherwise
+static float rayBox(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance, bool fromInside)
+{
+	glm::vec3 t0 = (min - origin) * inverseDirection;
+	glm::vec3 t1 = (max - origin) * inverseDirection;
+	glm::vec3 tNear = glm::min(t0, t1);
+	glm::vec3 tFar = glm::max(t0, t1);
+	float enter = std::max(std::max(tNear.x, tNear.y), tNear.z);
+	float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+	if (enter < 0.0f)
+	{
+		if (!fromInside)
+			return FLT_MAX;
+		enter = 0.0f;
+	}
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+// Normal of the face of a box a ray enters it through, along the axis whose slab it enters last
+static glm::vec3 entryNormal(const glm::vec3& origin, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max)
+{
+	glm::vec3 tNear = glm::min((min - origin) * inverseDirection, (max - origin) * inverseDirection);
+	int axis = tNear.x >= tNear.y && tNear.x >= tNear.z ? 0 : tNear.y >= tNear.z ? 1 : 2;
+	glm::vec3 normal(0.0f);
+	normal[axis] = inverseDirection[axis] > 0.0f ? -1.0f : 1.0f;
+	return normal;
+}
+
+// Finds the closest item whose bounds the ray hits within maxDistance
+uint32_t Quadtree::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance) const
+{
+	Hit hit;
+	if (!cast(origin, direction, 0.0f, maxDistance, false, &hit))
+		return INVALID;
+	if (hitDistance)
+		*hitDistance = hit.distance;
+	return hit.id;
+}
+
+// Same as Raycast with the normal of the face that was hit
+bool Quadtree::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit& hit) const
+{
+	return cast(origin, direction, 0.0f, maxDistance, false, &hit);
+}
+
+// Sweeps a sphere along a ray and finds the closest item it touches
+bool Quadtree::SphereCast(const glm::vec3& origin, const glm::vec3& direction, float radius, float maxDistance, Hit& hit) const
+{
+	return cast(origin, direction, radius, maxDistance, false, &hit);
+}
+
+// Checks if no item is between two points
+bool Quadtree::LineOfSight(const glm::vec3& from, const glm::vec3& to) const
+{
+	return !cast(from, to - from, 0.0f, 1.0f, true, nullptr);
+}
+
+// Casts a sphere, or a ray for radius 0
+bool Quadtree::cast(const glm::vec3& origin, const glm::vec3& direction, float radius, float maxDistance, bool any, Hit* hit) const
+{
+	glm::vec3 inverseDirection = 1.0f / direction;
+	glm::vec3 grow(radius);
+	uint32_t best = INVALID;
+	float bestDistance = maxDistance;
+
+	// Nodes are kept with the distance the ray enters them at, depth is limited by maxDepth and each level pushes
+	// at most 3 more nodes than it pops
+	uint32_t stack[64 * 3];
+	float entered[64 * 3];
+	size_t top = 0;
+	const Node& root = nodes[0];
+	if (root.min.x <= root.max.x)
+	{
+		float t = rayBox(origin, inverseDirection, root.min - grow, root.max + grow, bestDistance, true);
+		if (t != FLT_MAX)
+		{
+			stack[top] = 0;
+			entered[top++] = t;
+		}
+	}
+
+#ifdef QUADTREE_SSE
+	const __m128 originX = _mm_set1_ps(origin.x), originY = _mm_set1_ps(origin.y), originZ = _mm_set1_ps(origin.z);
+	const __m128 inverseX = _mm_set1_ps(inverseDirection.x), inverseY = _mm_set1_ps(inverseDirection.y), inverseZ = _mm_set1_ps(inverseDirection.z);
+	const __m128 growth = _mm_set1_ps(radius);
+	const __m128 zero = _mm_setzero_ps();
+#endif
+
+	while (top > 0)
+	{
+		top--;
+		// Nodes entered after the closest hit so far cannot hold a closer one
+		if (entered[top] > bestDistance)
+			continue;
+		uint32_t index = stack[top];
+		const Node& n = nodes[index];
+		if (n.firstChild != 0)
+		{
+			// The children are pushed farthest first, so the nearest is searched first and its hits prune the others
+			size_t base = top;
+			for (uint32_t i = 0; i < 4; i++)
+			{
+				const Node& child = nodes[n.firstChild + i];
+				if (child.min.x > child.max.x)
+					continue;
+				float t = rayBox(origin, inverseDirection, child.min - grow, child.max + grow, bestDistance, true);
+				if (t == FLT_MAX)
+					continue;
+				size_t slot = top++;
+				for (; slot > base && entered[slot - 1] < t; slot--)
+				{
+					stack[slot] = stack[slot - 1];
+					entered[slot] = entered[slot - 1];
+				}
+				stack[slot] = n.firstChild + i;
+				entered[slot] = t;
+			}
+			continue;
+		}
+
+		if (!packed)
+		{
+			for (uint32_t item = n.firstItem; item != INVALID; item = itemNext[item])
+			{
+				float t = rayBox(origin, inverseDirection, itemMin[item] - grow, itemMax[item] + grow, bestDistance, false);
+				if (t == FLT_MAX || (best != INVALID && t >= bestDistance))
+					continue;
+				if (any)
+					return true;
+				best = item;
+				bestDistance = t;
+			}
+			continue;
+		}
+
+		size_t i = packedFirst[index];
+		size_t end = i + n.itemCount;
+		const BoundingBoxes& boxes = packedBoxes;
+#ifdef QUADTREE_SSE
+		// Slab test of four boxes at once, the lanes that enter a box ahead of the ray and before leaving it hit
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minX.data() + i), growth), originX), inverseX);
+			__m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(boxes.maxX.data() + i), growth), originX), inverseX);
+			__m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minY.data() + i), growth), originY), inverseY);
+			__m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(boxes.maxY.data() + i), growth), originY), inverseY);
+			__m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(boxes.minZ.data() + i), growth), originZ), inverseZ);
+			__m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(boxes.maxZ.data() + i), growth), originZ), inverseZ);
+			__m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_min_ps(z0, z1));
+			__m128 exit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(bestDistance)));
+			int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(enter, zero), _mm_cmple_ps(enter, exit)));
+			if (mask == 0)
+				continue;
+			if (any)
+				return true;
+			float distances[4];
+			_mm_storeu_ps(distances, enter);
+			for (int lane = 0; lane < 4; lane++)
+			{
+				if (((mask >> lane) & 1) && (best == INVALID || distances[lane] < bestDistance))
+				{
+					best = packedIds[i + lane];
+					bestDistance = distances[lane];
+				}
+			}
+		}
+#endif
+		// Scalar path for the remaining boxes, or all of them without SSE
+		for (; i < end; i++)
+		{
+			glm::vec3 min(boxes.minX[i], boxes.minY[i], boxes.minZ[i]);
+			glm::vec3 max(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]);
+			float t = rayBox(origin, inverseDirection, min - grow, max + grow, bestDistance, false);
+			if (t == FLT_MAX || (best != INVALID && t >= bestDistance))
+				continue;
+			if (any)
+				return true;
+			best = packedIds[i];
+			bestDistance = t;
+		}
+	}
+	if (best == INVALID)
+		return false;
+	if (hit)
+	{
+		hit->id = best;
+		hit->distance = bestDistance;
+		hit->normal = entryNormal(origin, inverseDirection, itemMin[best] - grow, itemMax[best] + grow);
+	}
+	return true;
+}
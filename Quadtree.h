@@ -0,0 +1,127 @@
+#ifndef QUADTREE_CLASS_H
+#define QUADTREE_CLASS_H
+
+#include<glm/glm.hpp>
+#include<functional>
+#include<vector>
+#include<cstdint>
+
+#include"Frustum.h"
+#include"JobSystem.h"
+
+// Spatial index over the XZ ground plane, items are boxes identified by a caller chosen id (such as the building index)
+class Quadtree
+{
+public:
+	// Id returned when nothing was found
+	static constexpr uint32_t INVALID = 0xffffffffu;
+
+	// Node of the tree, all nodes live in one array and the four children of a node are stored next to each other
+	struct Node
+	{
+		// Bounds of everything stored below this node, including building heights
+		glm::vec3 min;
+		glm::vec3 max;
+		// Square region of the ground plane this node splits up
+		float regionX, regionZ, regionSize;
+		// Index of the first of the four children, 0 for leaves
+		uint32_t firstChild;
+		// First item of the linked list of items stored at this leaf
+		uint32_t firstItem;
+		uint32_t itemCount;
+	};
+
+	// Closest hit of a cast: the item, how far along the direction it was hit and the normal of the face it hit
+	struct Hit
+	{
+		uint32_t id = INVALID;
+		float distance = 0.0f;
+		glm::vec3 normal = glm::vec3(0.0f);
+	};
+
+	// Flattened nodes, node 0 is the root
+	std::vector<Node> nodes;
+
+	// Constructor that covers a square region of the ground plane, items outside of it end up in the border nodes
+	Quadtree(glm::vec2 regionMin, float regionSize, uint32_t leafCapacity = 16, uint32_t maxDepth = 12);
+
+	// Throws away every node and builds the tree again from all current items, which gives tighter bounds
+	// It also packs the boxes of every leaf next to each other, which casts test four at a time until the next
+	// Insert or Remove
+	void Build();
+	// Builds the same tree with the workers: the items are sorted by the Morton code of the deepest cell their centre
+	// falls in, every node is then a run of that order and its children split it where the code's next two bits change,
+	// so only the nodes are made one level at a time, and the items are linked and packed leaf by leaf in parallel.
+	// The packed items of a leaf are then in Morton order, so neighbouring leaves are next to each other in memory too
+	void Build(JobSystem& jobs);
+	// Adds an item or moves an existing one to new bounds
+	void Insert(uint32_t id, const glm::vec3& min, const glm::vec3& max);
+	// Removes an item, does nothing if it is not stored
+	void Remove(uint32_t id);
+	// Checks if an item is stored
+	bool Contains(uint32_t id) const;
+	// Number of items stored
+	size_t size() const;
+
+	// Appends the ids of all items that are at least partly inside the frustum
+	void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& result) const;
+	// Same as QueryFrustum but writes into an array with room for every item and returns the count
+	size_t QueryFrustum(const Frustum& frustum, uint32_t* result) const;
+	// Same with a second test of every node the frustum keeps, which skips all items below a node it finds hidden without
+	// looking at any of them, such as Terrain::BehindHorizon
+	size_t QueryFrustum(const Frustum& frustum, uint32_t* result, const std::function<bool(const glm::vec3& min, const glm::vec3& max)>& hidden) const;
+	// Appends the ids of all items whose bounds are within radius of center
+	void QueryRadius(const glm::vec3& center, float radius, std::vector<uint32_t>& result) const;
+	// Finds the closest item whose bounds the ray hits within maxDistance, returns INVALID on a miss
+	// Distances are in lengths of direction, and boxes the ray starts inside of are not hit, for every cast below too
+	uint32_t Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float* hitDistance = nullptr) const;
+	// Same as Raycast with the normal of the face that was hit, false on a miss
+	bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, Hit& hit) const;
+	// Sweeps a sphere along a ray and finds the closest item it touches, such as a camera moving through the city
+	// The boxes are grown by the radius, so their edges and corners count as square rather than rounded
+	bool SphereCast(const glm::vec3& origin, const glm::vec3& direction, float radius, float maxDistance, Hit& hit) const;
+	// Checks if no item is between two points, stopping at the first one in the way rather than the closest
+	bool LineOfSight(const glm::vec3& from, const glm::vec3& to) const;
+private:
+	uint32_t leafCapacity;
+	uint32_t maxDepth;
+	glm::vec2 regionMin;
+	float regionSize;
+	size_t itemTotal = 0;
+
+	// Per item data indexed by id
+	std::vector<glm::vec3> itemMin;
+	std::vector<glm::vec3> itemMax;
+	std::vector<uint32_t> itemNode;
+	std::vector<uint32_t> itemNext;
+	std::vector<uint32_t> itemPrev;
+	// Parent of every node and depth, used to grow bounds and limit splitting
+	std::vector<uint32_t> parent;
+	std::vector<uint32_t> depth;
+	// Boxes and ids of the items packed leaf by leaf by Build, and where the items of each node start among them
+	bool packed = false;
+	BoundingBoxes packedBoxes;
+	std::vector<uint32_t> packedIds;
+	std::vector<uint32_t> packedFirst;
+
+	// Resets the tree to a single empty root
+	void reset();
+	// Finds the leaf whose region holds a point of the ground plane
+	uint32_t findLeaf(float x, float z) const;
+	// Links an item into a leaf, grows the bounds above it and splits the leaf when it is full
+	void link(uint32_t id, uint32_t leaf);
+	// Unlinks an item from its leaf
+	void unlink(uint32_t id);
+	// Splits a leaf into four children and moves its items into them
+	void split(uint32_t leaf);
+	// Writes every item below a node without testing them
+	size_t collect(uint32_t node, uint32_t* result) const;
+	// Packs the boxes of every leaf after Build
+	void pack();
+	// Sorts items by their codes with a radix sort of 8 bits a pass on the workers, only over the bits in use
+	static void sortByCode(JobSystem& jobs, std::vector<uint32_t>& codes, std::vector<uint32_t>& items, uint32_t bits);
+	// Casts a sphere, or a ray for radius 0, closest keeps the closest hit in hit and any stops at the first one
+	bool cast(const glm::vec3& origin, const glm::vec3& direction, float radius, float maxDistance, bool any, Hit* hit) const;
+};
+
+#endif
@@ -0,0 +1,273 @@
+#include"ReflectionProbes.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<cmath>
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+
+// Full screen triangle, every texel of a face is filtered once
+static const char* prefilterVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+// Split sum prefiltering with GGX: the mirror direction of every texel is taken as the normal and the view, and the
+// samples are read from a coarser level of the scratch cube map the wider the lobe they stand for
+static const char* prefilterFragmentSource = R"(
+#version 330 core
+uniform samplerCube source;
+uniform int face;
+uniform float roughness;
+// Texels to a side of the face being drawn and of the scratch cube map's top level
+uniform float size;
+uniform float sourceSize;
+
+out vec4 FragColor;
+
+const float PI = 3.14159265;
+const uint SAMPLES = 64u;
+
+// Direction through a point of a face, from -1 to 1 across and down as GL lays the faces out
+vec3 faceDirection(vec2 uv)
+{
+    if (face == 0) return vec3(1.0, -uv.y, -uv.x);
+    if (face == 1) return vec3(-1.0, -uv.y, uv.x);
+    if (face == 2) return vec3(uv.x, 1.0, uv.y);
+    if (face == 3) return vec3(uv.x, -1.0, -uv.y);
+    if (face == 4) return vec3(uv.x, -uv.y, 1.0);
+    return vec3(-uv.x, -uv.y, -1.0);
+}
+
+vec2 hammersley(uint i)
+{
+    uint bits = (i << 16u) | (i >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return vec2(float(i) / float(SAMPLES), float(bits) * 2.3283064365386963e-10);
+}
+
+void main()
+{
+    vec3 normal = normalize(faceDirection(gl_FragCoord.xy / size * 2.0 - 1.0));
+    if (roughness <= 0.0)
+    {
+        FragColor = vec4(textureLod(source, normal, 0.0).rgb, 1.0);
+        return;
+    }
+    vec3 up = abs(normal.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, normal));
+    vec3 bitangent = cross(normal, tangent);
+    float a = roughness * roughness;
+    // Solid angle of a texel of the top level
+    float texelAngle = 4.0 * PI / (6.0 * sourceSize * sourceSize);
+    vec3 sum = vec3(0.0);
+    float weight = 0.0;
+    for (uint i = 0u; i < SAMPLES; i++)
+    {
+        vec2 xi = hammersley(i);
+        float phi = 2.0 * PI * xi.x;
+        float cosTheta = sqrt((1.0 - xi.y) / (1.0 + (a * a - 1.0) * xi.y));
+        float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+        vec3 halfway = tangent * (sinTheta * cos(phi)) + bitangent * (sinTheta * sin(phi)) + normal * cosTheta;
+        vec3 light = 2.0 * dot(normal, halfway) * halfway - normal;
+        float cosLight = dot(normal, light);
+        if (cosLight <= 0.0)
+            continue;
+        // With the view along the normal the sample's density is the distribution over 4
+        float d = cosTheta * cosTheta * (a * a - 1.0) + 1.0;
+        float density = a * a / (PI * d * d) / 4.0;
+        float sampleAngle = 1.0 / (float(SAMPLES) * density + 1e-4);
+        float level = max(0.5 * log2(sampleAngle / texelAngle) + 1.0, 0.0);
+        sum += textureLod(source, light, level).rgb * cosLight;
+        weight += cosLight;
+    }
+    FragColor = vec4(sum / max(weight, 1e-4), 1.0);
+}
+)";
+
+// Views down each face of a cube map in GL's order, +X, -X, +Y, -Y, +Z and -Z, with the up vectors that lay the
+// rendered image out as the face expects
+static const glm::vec3 faceFronts[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+static const glm::vec3 faceUps[6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+
+// Constructor that places the probes, builds the prefilter program and allocates the cube maps
+ReflectionProbes::ReflectionProbes(GLsizei size, int perSide, const glm::vec3& min, const glm::vec3& max)
+	: size(size)
+{
+	perSide = std::clamp(perSide, 1, MAX_PER_SIDE);
+	count = perSide * perSide;
+	// Every probe owns a cell of the grid from the ground to the top of the box, and stands low in it where the
+	// glass that reflects it mostly is
+	glm::vec3 cell = (max - min) / glm::vec3((float)perSide, 1.0f, (float)perSide);
+	for (int z = 0; z < perSide; z++)
+		for (int x = 0; x < perSide; x++)
+		{
+			int i = z * perSide + x;
+			boxMin[i] = min + cell * glm::vec3((float)x, 0.0f, (float)z);
+			boxMax[i] = boxMin[i] + cell;
+			centers[i] = glm::vec3(boxMin[i].x + 0.5f * cell.x, min.y + std::min(20.0f, 0.5f * cell.y), boxMin[i].z + 0.5f * cell.z);
+		}
+	levels = std::min((GLsizei)std::log2((float)size) + 1, (GLsizei)6);
+
+	prefilterProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, prefilterVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, prefilterFragmentSource, "FRAGMENT") });
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(prefilterProgram);
+	glUniform1i(glGetUniformLocation(prefilterProgram, "source"), TEXTURE_UNIT);
+	GLState.UseProgram(previousProgram);
+
+	// Half floats keep the sky and the lit windows brighter than white for the bloom
+	glGenTextures(1, &probes);
+	GLState.BindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, probes);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	for (GLsizei level = 0; level < levels; level++)
+		glTexImage3D(GL_TEXTURE_CUBE_MAP_ARRAY, level, GL_RGBA16F, std::max(size >> level, 1), std::max(size >> level, 1), count * 6, 0, GL_RGBA, GL_FLOAT, nullptr);
+	GLState.BindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, 0);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, probes, GpuMemoryTracker::ImageBytes(GL_RGBA16F, size, size, count * 6, levels));
+
+	// The scratch cube map keeps its full chain so wide lobes can read coarse levels
+	GLsizei scratchLevels = (GLsizei)std::log2((float)size) + 1;
+	glGenTextures(1, &scratch);
+	GLState.BindTexture(GL_TEXTURE_CUBE_MAP, scratch);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, scratchLevels - 1);
+	for (GLsizei level = 0; level < scratchLevels; level++)
+		for (int face = 0; face < 6; face++)
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA16F, std::max(size >> level, 1), std::max(size >> level, 1), 0, GL_RGBA, GL_FLOAT, nullptr);
+	GLState.BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, scratch, GpuMemoryTracker::ImageBytes(GL_RGBA16F, size, size, 6, scratchLevels));
+	// Reflections are looked up across face edges
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glGenFramebuffers(1, &framebuffer);
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+ReflectionProbes::~ReflectionProbes()
+{
+	Delete();
+}
+
+// Renders the next face and prefilters its probe after the last one
+void ReflectionProbes::Update(const std::function<void(const glm::mat4& projection, const glm::mat4& view)>& draw)
+{
+	GLint previousFramebuffer, previousProgram, previousVAO;
+	GLint viewport[4];
+	GLfloat previousClear[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	glGetFloatv(GL_COLOR_CLEAR_VALUE, previousClear);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + nextFace, scratch, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	glViewport(0, 0, size, size);
+	glClearColor(clearColor.r, clearColor.g, clearColor.b, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	const glm::vec3& center = centers[nextProbe];
+	draw(glm::perspective(glm::radians(90.0f), 1.0f, 0.5f, 2000.0f), glm::lookAt(center, center + faceFronts[nextFace], faceUps[nextFace]));
+	glClearColor(previousClear[0], previousClear[1], previousClear[2], previousClear[3]);
+
+	if (++nextFace == 6)
+	{
+		prefilter(nextProbe);
+		ready = std::max(ready, nextProbe + 1);
+		nextFace = 0;
+		nextProbe = (nextProbe + 1) % count;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+}
+
+// Binds the probes that are ready for program
+void ReflectionProbes::Apply(GLuint program, const glm::vec3& eye)
+{
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_CUBE_MAP_ARRAY, probes);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, "probes"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "probeCount"), ready);
+	glUniform1f(glGetUniformLocation(program, "probeLevels"), (GLfloat)levels);
+	glUniform3fv(glGetUniformLocation(program, "probeEye"), 1, glm::value_ptr(eye));
+	glUniform3fv(glGetUniformLocation(program, "probeCenters"), ready, glm::value_ptr(centers[0]));
+	glUniform3fv(glGetUniformLocation(program, "probeMin"), ready, glm::value_ptr(boxMin[0]));
+	glUniform3fv(glGetUniformLocation(program, "probeMax"), ready, glm::value_ptr(boxMax[0]));
+	GLState.CountUniforms(7);
+}
+
+// Filters the scratch cube map into every level of a probe's slice, a roughness per level
+void ReflectionProbes::prefilter(int probe)
+{
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_CUBE_MAP, scratch);
+	glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLState.Disable(GL_DEPTH_TEST);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+	GLState.UseProgram(prefilterProgram);
+	GLState.BindVertexArray(emptyVAO);
+	glUniform1f(glGetUniformLocation(prefilterProgram, "sourceSize"), (GLfloat)size);
+	GLState.CountUniforms(1);
+	for (GLsizei level = 0; level < levels; level++)
+	{
+		GLsizei levelSize = std::max(size >> level, 1);
+		glViewport(0, 0, levelSize, levelSize);
+		glUniform1f(glGetUniformLocation(prefilterProgram, "size"), (GLfloat)levelSize);
+		glUniform1f(glGetUniformLocation(prefilterProgram, "roughness"), levels > 1 ? (GLfloat)level / (GLfloat)(levels - 1) : 0.0f);
+		GLState.CountUniforms(2);
+		for (int face = 0; face < 6; face++)
+		{
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, probes, level, probe * 6 + face);
+			glUniform1i(glGetUniformLocation(prefilterProgram, "face"), face);
+			GLState.CountUniforms(1);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			GLState.CountDraw(1, 1);
+		}
+	}
+	GLState.BindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+}
+
+// Deletes the GL objects
+void ReflectionProbes::Delete()
+{
+	GLuint textures[] = { probes, scratch };
+	for (GLuint texture : textures)
+		if (texture != 0)
+			GLState.DeleteTextures(1, &texture);
+	if (depthBuffer != 0)
+		glDeleteRenderbuffers(1, &depthBuffer);
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (prefilterProgram != 0)
+		GLState.DeleteProgram(prefilterProgram);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	probes = scratch = depthBuffer = framebuffer = prefilterProgram = emptyVAO = 0;
+	ready = 0;
+}
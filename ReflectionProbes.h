@@ -0,0 +1,67 @@
+#ifndef REFLECTION_PROBES_CLASS_H
+#define REFLECTION_PROBES_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<functional>
+
+// Cube maps of the city captured at a grid of fixed points, which the glass facades reflect instead of a flat sky
+// color. Update renders one face a frame, probe after probe, into a scratch cube map, and once a probe's six faces
+// are in prefilters it into its slice of a cube map array, a mip level per roughness from a mirror at the top to
+// fully rough at the bottom. Shading picks the nearest probe and intersects the reflected ray with the probe's box,
+// so what it sees lines up with the buildings around it rather than sitting at infinity.
+// Everything is in the city's model space, where the buildings and the sun stand still.
+class ReflectionProbes
+{
+public:
+	// The cube map array is bound to this texture unit while glass is drawn, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 20;
+	// Probes at most, the grid is at most this many to a side
+	static constexpr int MAX_PROBES = 16;
+	static constexpr int MAX_PER_SIDE = 4;
+
+	// Color the faces are cleared to, what is seen past every building
+	glm::vec3 clearColor = glm::vec3(0.75f, 0.82f, 0.9f);
+
+	// Constructor for perSide by perSide probes of size by size texels a face, spread over the box min to max
+	ReflectionProbes(GLsizei size, int perSide, const glm::vec3& min, const glm::vec3& max);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~ReflectionProbes();
+	// A ReflectionProbes owns its GL objects, so it cannot be copied
+	ReflectionProbes(const ReflectionProbes&) = delete;
+	ReflectionProbes& operator=(const ReflectionProbes&) = delete;
+
+	// Renders the next face, draw is called once with the face's projection and view and has to render the scene in
+	// model space with GL's default depth convention. Prefilters the probe after its last face.
+	// The framebuffer, viewport, clear color, program and VAO in use are restored afterwards
+	void Update(const std::function<void(const glm::mat4& projection, const glm::mat4& view)>& draw);
+	// Binds the probes for program, which has to be in use, with the camera at eye in model space
+	// Probes that were not prefiltered yet are left out, with none the program keeps its flat sky color
+	void Apply(GLuint program, const glm::vec3& eye);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLsizei size;
+	GLsizei levels;
+	int count;
+	// Center and box of every probe
+	glm::vec3 centers[MAX_PROBES];
+	glm::vec3 boxMin[MAX_PROBES];
+	glm::vec3 boxMax[MAX_PROBES];
+	// Probe and face the next Update renders, and how many probes were prefiltered at least once
+	int nextProbe = 0;
+	int nextFace = 0;
+	int ready = 0;
+	GLuint probes = 0;
+	GLuint scratch = 0;
+	GLuint depthBuffer = 0;
+	GLuint framebuffer = 0;
+	GLuint prefilterProgram = 0;
+	GLuint emptyVAO = 0;
+
+	// Filters the scratch cube map into every level of a probe's slice
+	void prefilter(int probe);
+};
+
+#endif
@@ -0,0 +1,164 @@
+#include"RenderGraph.h"
+#include"GLExtensions.h"
+
+// Barrier bit that makes image stores visible to a kind of access
+static GLbitfield barrierFor(RenderGraph::Access access)
+{
+	switch (access)
+	{
+	case RenderGraph::SAMPLED: return GL_TEXTURE_FETCH_BARRIER_BIT;
+	case RenderGraph::ATTACHMENT: return GL_FRAMEBUFFER_BARRIER_BIT;
+	default: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+	}
+}
+
+RenderGraph::RenderGraph(RenderTargetPool& pool)
+	: pool(pool)
+{
+}
+
+RenderGraph::Pass RenderGraph::AddPass(const std::string& name)
+{
+	passes.push_back(PassInfo());
+	passes.back().name = name;
+	return (Pass)(passes.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::Import(const std::string& name)
+{
+	resources.push_back(ResourceInfo());
+	resources.back().name = name;
+	needed.push_back(false);
+	imageWritten.push_back(false);
+	covered.push_back(0);
+	return (Resource)(resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::Create(const std::string& name, GLenum format, GLsizei samples)
+{
+	Resource resource = Import(name);
+	resources[resource].transient = true;
+	resources[resource].key.format = format;
+	resources[resource].key.samples = samples;
+	return resource;
+}
+
+void RenderGraph::Read(Pass pass, Resource resource, Access access)
+{
+	passes[pass].uses.push_back({ resource, access, false });
+}
+
+void RenderGraph::Write(Pass pass, Resource resource, Access access)
+{
+	passes[pass].uses.push_back({ resource, access, true });
+}
+
+void RenderGraph::Output(Resource resource)
+{
+	resources[resource].output = true;
+}
+
+void RenderGraph::Enable(Pass pass, bool enabled)
+{
+	passes[pass].enabled = enabled;
+}
+
+void RenderGraph::Resize(Resource resource, GLsizei width, GLsizei height)
+{
+	resources[resource].key.width = width;
+	resources[resource].key.height = height;
+}
+
+// Culls backwards from the outputs, then goes forwards for the barriers and the spans of the transient textures
+void RenderGraph::Compile()
+{
+	for (size_t r = 0; r < resources.size(); r++)
+	{
+		needed[r] = resources[r].output;
+		imageWritten[r] = false;
+		covered[r] = 0;
+		resources[r].used = false;
+	}
+	culled = 0;
+	for (size_t p = passes.size(); p-- > 0;)
+	{
+		PassInfo& pass = passes[p];
+		pass.live = false;
+		if (pass.enabled)
+			for (const Use& use : pass.uses)
+				if (use.write && needed[use.resource])
+					pass.live = true;
+		if (!pass.live)
+		{
+			culled++;
+			continue;
+		}
+		for (const Use& use : pass.uses)
+			if (!use.write)
+				needed[use.resource] = true;
+	}
+
+	for (size_t p = 0; p < passes.size(); p++)
+	{
+		PassInfo& pass = passes[p];
+		pass.barrier = 0;
+		if (!pass.live)
+			continue;
+		// Any access after image stores waits for them, a write too
+		for (const Use& use : pass.uses)
+			if (imageWritten[use.resource] && !(covered[use.resource] & barrierFor(use.access)))
+				pass.barrier |= barrierFor(use.access);
+		for (size_t r = 0; r < resources.size(); r++)
+			covered[r] |= pass.barrier;
+		for (const Use& use : pass.uses)
+		{
+			ResourceInfo& resource = resources[use.resource];
+			if (use.write && use.access == IMAGE)
+			{
+				imageWritten[use.resource] = true;
+				covered[use.resource] = 0;
+			}
+			if (!resource.transient)
+				continue;
+			if (!resource.used)
+				resource.first = (Pass)p;
+			resource.last = (Pass)p;
+			resource.used = true;
+		}
+	}
+
+	// Resources are handed targets in the order of their first pass, so a target is free again after its last one
+	for (size_t p = 0; p < passes.size(); p++)
+		for (ResourceInfo& resource : resources)
+			if (resource.used && resource.first == (Pass)p)
+				resource.target = pool.Acquire(resource.key, resource.first, resource.last, resource.name);
+}
+
+bool RenderGraph::Run(Pass pass)
+{
+	if (!passes[pass].live)
+		return false;
+	if (passes[pass].barrier != 0)
+		glMemoryBarrier(passes[pass].barrier);
+	return true;
+}
+
+bool RenderGraph::live(Pass pass) const
+{
+	return passes[pass].live;
+}
+
+GLuint RenderGraph::texture(Resource resource) const
+{
+	return resources[resource].used ? pool.target(resources[resource].target).texture : 0;
+}
+
+GLuint RenderGraph::framebuffer(Resource resource) const
+{
+	return resources[resource].used ? pool.target(resources[resource].target).framebuffer : 0;
+}
+
+size_t RenderGraph::culledCount() const
+{
+	return culled;
+}
@@ -0,0 +1,108 @@
+#ifndef RENDER_GRAPH_CLASS_H
+#define RENDER_GRAPH_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+#include"RenderTargetPool.h"
+
+// Plan of a frame's passes from what each of them reads and writes, declared once and compiled every frame
+// Passes run in the order they were added. Compile drops those whose writes nothing later reads and that write none of
+// the outputs, and a pass turned off for the frame counts as dropped, so a pass only feeding it goes too. A write made
+// through image stores is not seen by later reads until a memory barrier, Run issues the one each pass needs.
+// Transient textures are taken from a RenderTargetPool for the span from the first pass using them to the last, so two
+// of them with the same size and format whose spans do not overlap share one texture. Textures a subsystem owns only
+// enter the plan as imported resources.
+// The code of a pass stays where it was, it asks Run whether to go on. Nothing is allocated once the pool is full.
+class RenderGraph
+{
+public:
+	typedef unsigned int Pass;
+	typedef unsigned int Resource;
+	// How a pass touches a resource
+	enum Access
+	{
+		// Read through a sampler or written as a framebuffer attachment, GL orders those by itself
+		SAMPLED,
+		ATTACHMENT,
+		// Read or written with image loads and stores, which need a barrier before anything else reads them
+		IMAGE
+	};
+
+	// Constructor that takes the transient textures from pool, whose BeginFrame comes before every Compile
+	RenderGraph(RenderTargetPool& pool);
+
+	// Adds a pass after the ones added before it
+	Pass AddPass(const std::string& name);
+	// Adds a texture owned elsewhere, such as a subsystem's target
+	Resource Import(const std::string& name);
+	// Adds a texture the graph takes from the pool in an internal format, multisampled with samples above 0, its size is
+	// set by Resize
+	Resource Create(const std::string& name, GLenum format, GLsizei samples = 0);
+	// Declares that a pass reads or writes a resource
+	void Read(Pass pass, Resource resource, Access access = SAMPLED);
+	void Write(Pass pass, Resource resource, Access access = ATTACHMENT);
+	// Marks a resource as read by something outside the graph, such as the window, so its writers are kept
+	void Output(Resource resource);
+
+	// Turns a pass on or off for the frames compiled from now on, passes start on
+	void Enable(Pass pass, bool enabled);
+	// Sets the size of a transient texture for the frames compiled from now on
+	void Resize(Resource resource, GLsizei width, GLsizei height);
+	// Works out the passes of the frame, their barriers and the texture behind every transient resource
+	void Compile();
+	// Issues the barrier of a pass and returns true when it runs this frame, false when it was dropped
+	bool Run(Pass pass);
+
+	// Whether a pass runs this frame
+	bool live(Pass pass) const;
+	// Texture of a transient resource this frame, and a framebuffer with it as its color attachment
+	// While the pool sees the window being resized the texture may be larger than the resource, see RenderTargetPool
+	GLuint texture(Resource resource) const;
+	GLuint framebuffer(Resource resource) const;
+	// Passes dropped in the last compiled frame
+	size_t culledCount() const;
+private:
+	struct Use
+	{
+		Resource resource;
+		Access access;
+		bool write;
+	};
+	struct PassInfo
+	{
+		std::string name;
+		bool enabled = true;
+		std::vector<Use> uses;
+		// Set by Compile
+		bool live = false;
+		GLbitfield barrier = 0;
+	};
+	struct ResourceInfo
+	{
+		std::string name;
+		bool transient = false;
+		bool output = false;
+		RenderTargetPool::Key key;
+		// Set by Compile: whether a live pass uses it, the passes using it first and last and its target in the pool
+		bool used = false;
+		Pass first = 0;
+		Pass last = 0;
+		size_t target = 0;
+	};
+
+	RenderTargetPool& pool;
+	std::vector<PassInfo> passes;
+	std::vector<ResourceInfo> resources;
+	// Resources read by a live pass later on, while Compile goes backwards
+	std::vector<bool> needed;
+	// Resources written with image stores, and the barrier bits issued since, while Compile goes forwards
+	std::vector<bool> imageWritten;
+	std::vector<GLbitfield> covered;
+	size_t culled = 0;
+};
+
+#endif
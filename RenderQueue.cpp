@@ -0,0 +1,81 @@
+#include"RenderQueue.h"
+
+#include<algorithm>
+#include<cstring>
+
+// Bit pattern of a depth, negative depths and NaN count as 0
+static uint64_t depthBits(float depth)
+{
+	if (!(depth > 0.0f))
+		return 0;
+	uint32_t bits;
+	std::memcpy(&bits, &depth, sizeof(bits));
+	return bits;
+}
+
+// Builds the key of a draw
+uint64_t RenderQueue::Key(Pass pass, unsigned int program, unsigned int material, unsigned int vertexArray, float depth)
+{
+	uint64_t state = ((uint64_t)(program & 0x3f) << 24) | ((uint64_t)(material & 0xfff) << 12) | (uint64_t)(vertexArray & 0xfff);
+	uint64_t top = (uint64_t)(pass & 0x3) << 62;
+	if (pass == TRANSPARENT_PASS)
+		return top | ((~depthBits(depth) & 0xffffffffu) << 30) | state;
+	return top | (state << 32) | depthBits(depth);
+}
+
+// Distance from a point to the nearest point of a box
+float RenderQueue::BoxDepth(const glm::vec3& eye, const glm::vec3& min, const glm::vec3& max)
+{
+	return glm::length(glm::clamp(eye, min, max) - eye);
+}
+
+// Removes every draw
+void RenderQueue::Clear()
+{
+	queued.clear();
+}
+
+// Queues a draw
+void RenderQueue::Add(uint64_t key, uint32_t draw)
+{
+	queued.push_back({ key, draw });
+}
+
+// Sorts the draws by key, least significant byte first
+void RenderQueue::Sort()
+{
+	size_t count = queued.size();
+	if (count < 2)
+		return;
+	scratch.resize(count);
+	for (unsigned int shift = 0; shift < 64; shift += 8)
+	{
+		size_t offsets[256] = {};
+		for (const Item& item : queued)
+			offsets[(item.key >> shift) & 0xff]++;
+		// A byte every key shares leaves the order as it is, which is the common case for the state bytes
+		if (offsets[(queued[0].key >> shift) & 0xff] == count)
+			continue;
+		size_t total = 0;
+		for (size_t& offset : offsets)
+		{
+			size_t digitCount = offset;
+			offset = total;
+			total += digitCount;
+		}
+		for (const Item& item : queued)
+			scratch[offsets[(item.key >> shift) & 0xff]++] = item;
+		queued.swap(scratch);
+	}
+}
+
+// The draws in the order they were added, or sorted after Sort
+const std::vector<RenderQueue::Item>& RenderQueue::items() const
+{
+	return queued;
+}
+
+size_t RenderQueue::size() const
+{
+	return queued.size();
+}
@@ -0,0 +1,53 @@
+#ifndef RENDER_QUEUE_CLASS_H
+#define RENDER_QUEUE_CLASS_H
+
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+// Draws of a frame, each tagged with a 64 bit key and sorted by it before they are submitted
+// Opaque keys put the state first, so draws sharing a program, material and vertex array follow each other,
+// and within the same state they go front to back so early depth testing rejects what is behind.
+// Transparent keys put the depth first and invert it, blending needs back to front whatever it costs in state.
+//   opaque       pass:2 program:6 material:12 vertexArray:12 depth:32
+//   transparent  pass:2 ~depth:32 program:6 material:12 vertexArray:12
+// Fields wider than their bits are masked, the depth is the bit pattern of a non negative float, which sorts like the float.
+class RenderQueue
+{
+public:
+	enum Pass
+	{
+		OPAQUE_PASS = 0,
+		TRANSPARENT_PASS = 1
+	};
+
+	// One queued draw, draw is the caller's own index of what to submit
+	struct Item
+	{
+		uint64_t key;
+		uint32_t draw;
+	};
+
+	// Builds the key of a draw, program, material and vertexArray are small ids the caller assigns
+	static uint64_t Key(Pass pass, unsigned int program, unsigned int material, unsigned int vertexArray, float depth);
+	// Distance from a point to the nearest point of a box, 0 inside it, a depth for Key
+	static float BoxDepth(const glm::vec3& eye, const glm::vec3& min, const glm::vec3& max);
+
+	// Removes every draw, the storage is kept for the next frame
+	void Clear();
+	// Queues a draw
+	void Add(uint64_t key, uint32_t draw);
+	// Sorts the draws by key with a radix sort, draws with equal keys keep the order they were added in
+	void Sort();
+
+	// The draws in the order they were added, or sorted after Sort
+	const std::vector<Item>& items() const;
+	size_t size() const;
+private:
+	std::vector<Item> queued;
+	// Second buffer the radix sort scatters into
+	std::vector<Item> scratch;
+};
+
+#endif
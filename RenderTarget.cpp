@@ -0,0 +1,80 @@
+#include"RenderTarget.h"
+#include"GpuMemory.h"
+
+#include<iostream>
+#include<utility>
+
+// Constructor that allocates the renderbuffers and the framebuffer
+RenderTarget::RenderTarget(GLsizei width, GLsizei height, GLenum colorFormat)
+	: width(width), height(height), colorFormat(colorFormat)
+{
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, colorFormat, width, height);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, color, GpuMemoryTracker::ImageBytes(colorFormat, width, height));
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, depth, GpuMemoryTracker::ImageBytes(GL_DEPTH_COMPONENT24, width, height));
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLint previous;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::RENDER_TARGET::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+// Deletes the GL objects unless Delete was already called
+RenderTarget::~RenderTarget()
+{
+	Delete();
+}
+
+// Takes over the GL objects of another target
+RenderTarget::RenderTarget(RenderTarget&& other) noexcept
+	: framebuffer(std::exchange(other.framebuffer, 0)), color(std::exchange(other.color, 0)), depth(std::exchange(other.depth, 0)),
+	width(std::exchange(other.width, 0)), height(std::exchange(other.height, 0)), colorFormat(other.colorFormat)
+{
+}
+
+// Deletes the current GL objects and takes over the ones of another target
+RenderTarget& RenderTarget::operator=(RenderTarget&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		framebuffer = std::exchange(other.framebuffer, 0);
+		color = std::exchange(other.color, 0);
+		depth = std::exchange(other.depth, 0);
+		width = std::exchange(other.width, 0);
+		height = std::exchange(other.height, 0);
+		colorFormat = other.colorFormat;
+	}
+	return *this;
+}
+
+// Binds the framebuffer and sets the viewport to cover it
+void RenderTarget::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glViewport(0, 0, width, height);
+}
+
+// Deletes the GL objects
+void RenderTarget::Delete()
+{
+	GpuMemory.Untrack(GL_RENDERBUFFER, color);
+	GpuMemory.Untrack(GL_RENDERBUFFER, depth);
+	if (color != 0)
+		glDeleteRenderbuffers(1, &color);
+	if (depth != 0)
+		glDeleteRenderbuffers(1, &depth);
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = color = depth = 0;
+}
@@ -0,0 +1,35 @@
+#ifndef RENDER_TARGET_CLASS_H
+#define RENDER_TARGET_CLASS_H
+
+#include<glad/glad.h>
+
+// Offscreen framebuffer of one color and one depth renderbuffer, which frames are drawn into instead of the window
+// when nothing is shown, so their pixels are defined even while the window is hidden or covered
+class RenderTarget
+{
+public:
+	GLuint framebuffer = 0;
+	GLuint color = 0;
+	GLuint depth = 0;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	// Internal format of the color, GL_RGBA8 or a float format such as GL_RGBA16F for values past 1
+	GLenum colorFormat = 0;
+
+	// Constructor that allocates a target of width by height
+	RenderTarget(GLsizei width, GLsizei height, GLenum colorFormat = GL_RGBA8);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~RenderTarget();
+	// A RenderTarget owns its GL objects, so it can be moved but not copied
+	RenderTarget(const RenderTarget&) = delete;
+	RenderTarget& operator=(const RenderTarget&) = delete;
+	RenderTarget(RenderTarget&& other) noexcept;
+	RenderTarget& operator=(RenderTarget&& other) noexcept;
+
+	// Binds the framebuffer and sets the viewport to cover it
+	void Bind();
+	// Deletes the GL objects, does nothing if they were already deleted or moved from
+	void Delete();
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include"RenderTargetPool.h"
+#include"GLDebugOutput.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<algorithm>
+#include<iostream>
+
+// Format and type glTexImage2D takes with the internal formats of render targets
+static void pixelFormat(GLenum internalFormat, GLenum& format, GLenum& type)
+{
+	type = GL_FLOAT;
+	switch (internalFormat)
+	{
+	case GL_R8: format = GL_RED; type = GL_UNSIGNED_BYTE; break;
+	case GL_R16F: case GL_R32F: format = GL_RED; break;
+	case GL_RG8: format = GL_RG; type = GL_UNSIGNED_BYTE; break;
+	case GL_RG16F: case GL_RG32F: format = GL_RG; break;
+	case GL_R11F_G11F_B10F: format = GL_RGB; break;
+	case GL_RGBA8: format = GL_RGBA; type = GL_UNSIGNED_BYTE; break;
+	default: format = GL_RGBA; break;
+	}
+}
+
+static GLsizei roundUp(GLsizei size, GLsizei multiple)
+{
+	return (size + multiple - 1) / multiple * multiple;
+}
+
+// Deletes the targets unless Delete was already called
+RenderTargetPool::~RenderTargetPool()
+{
+	Delete();
+}
+
+// The first frame sets the size without counting as a resize
+void RenderTargetPool::BeginFrame(GLsizei width, GLsizei height)
+{
+	frame++;
+	if ((width != windowWidth || height != windowHeight) && windowWidth != 0)
+		resizedFrame = frame;
+	windowWidth = width;
+	windowHeight = height;
+	for (size_t i = targets.size(); i-- > 0;)
+	{
+		if (targets[i].lastFrame + KEEP_FRAMES < frame)
+		{
+			release(targets[i]);
+			targets.erase(targets.begin() + i);
+		}
+		else
+			targets[i].taken = false;
+	}
+}
+
+// Settled frames take an exact match, a drag the smallest free target that is large enough
+size_t RenderTargetPool::Acquire(const Key& key, uint32_t from, uint32_t until, const std::string& name)
+{
+	bool dragging = resizing();
+	size_t best = targets.size();
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		const Target& target = targets[i];
+		if (target.key.format != key.format || target.key.samples != key.samples || (target.taken && target.busyUntil >= from))
+			continue;
+		bool fits = dragging ? target.key.width >= key.width && target.key.height >= key.height : target.key.width == key.width && target.key.height == key.height;
+		if (!fits)
+			continue;
+		if (best == targets.size() || (int64_t)target.key.width * target.key.height < (int64_t)targets[best].key.width * targets[best].key.height)
+			best = i;
+	}
+	if (best == targets.size())
+	{
+		Target target;
+		target.key = key;
+		if (dragging)
+		{
+			target.key.width = roundUp(key.width, RESIZE_GRANULARITY);
+			target.key.height = roundUp(key.height, RESIZE_GRANULARITY);
+		}
+		GLenum textureTarget = key.samples > 0 ? GL_TEXTURE_2D_MULTISAMPLE : GL_TEXTURE_2D;
+		glGenTextures(1, &target.texture);
+		GLState.BindTexture(textureTarget, target.texture);
+		if (key.samples > 0)
+			glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, key.samples, key.format, target.key.width, target.key.height, GL_TRUE);
+		else
+		{
+			GLenum format, type;
+			pixelFormat(key.format, format, type);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+			glTexImage2D(GL_TEXTURE_2D, 0, key.format, target.key.width, target.key.height, 0, format, type, nullptr);
+		}
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, target.texture, GpuMemoryTracker::ImageBytes(key.format, target.key.width, target.key.height) * std::max(key.samples, 1));
+		GLState.BindTexture(textureTarget, 0);
+		GLDebug.Label(GL_TEXTURE, target.texture, "pooled " + name);
+
+		GLint previousFramebuffer;
+		glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+		glGenFramebuffers(1, &target.framebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureTarget, target.texture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cerr << "ERROR::RENDER_TARGET_POOL::FRAMEBUFFER_INCOMPLETE " << name << std::endl;
+		glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+		targets.push_back(target);
+		allocated++;
+	}
+	Target& target = targets[best];
+	target.taken = true;
+	target.busyUntil = until;
+	target.lastFrame = frame;
+	return best;
+}
+
+const RenderTargetPool::Target& RenderTargetPool::target(size_t index) const
+{
+	return targets[index];
+}
+
+bool RenderTargetPool::resizing() const
+{
+	return resizedFrame != 0 && frame < resizedFrame + SETTLE_FRAMES;
+}
+
+size_t RenderTargetPool::size() const
+{
+	return targets.size();
+}
+
+size_t RenderTargetPool::allocations() const
+{
+	return allocated;
+}
+
+void RenderTargetPool::release(Target& target)
+{
+	if (target.texture != 0)
+		GLState.DeleteTextures(1, &target.texture);
+	if (target.framebuffer != 0)
+		glDeleteFramebuffers(1, &target.framebuffer);
+	target.texture = target.framebuffer = 0;
+}
+
+// Deletes the targets
+void RenderTargetPool::Delete()
+{
+	for (Target& target : targets)
+		release(target);
+	targets.clear();
+}
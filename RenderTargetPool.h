@@ -0,0 +1,81 @@
+#ifndef RENDER_TARGET_POOL_CLASS_H
+#define RENDER_TARGET_POOL_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+// Textures to render into, with a framebuffer each, handed out by size, format and sample count and kept across frames
+// A target is taken for a span of a frame's passes and free again after it, so one texture serves every user whose
+// span does not overlap, in one frame and the next. Targets nobody took for KEEP_FRAMES frames are deleted.
+// While the window is being resized every frame has another size, and allocating exact sizes would make a new set of
+// targets each frame of the drag. Until the size has held still for SETTLE_FRAMES frames a target at least as large
+// does instead, and new ones get room to grow, so users draw into the corner of the size they asked for and have to
+// clamp their fetches to it rather than to the texture. Once settled exact sizes are made again, the large ones go stale.
+class RenderTargetPool
+{
+public:
+	// Frames a target is kept without being taken, and frames the window size has to hold before a drag is over
+	static constexpr uint64_t KEEP_FRAMES = 3;
+	static constexpr uint64_t SETTLE_FRAMES = 10;
+	// Sizes are rounded up to a multiple of this while the window is being resized
+	static constexpr GLsizei RESIZE_GRANULARITY = 128;
+
+	// What a user asks for, samples 0 is a plain GL_TEXTURE_2D and more a GL_TEXTURE_2D_MULTISAMPLE
+	struct Key
+	{
+		GLsizei width = 0;
+		GLsizei height = 0;
+		GLenum format = 0;
+		GLsizei samples = 0;
+	};
+	// A pooled texture, its size may be larger than the key it was taken for
+	struct Target
+	{
+		GLuint texture = 0;
+		GLuint framebuffer = 0;
+		Key key;
+		// Pass after which it is free again this frame, whether it was taken this frame, and the last frame it was
+		uint32_t busyUntil = 0;
+		bool taken = false;
+		uint64_t lastFrame = 0;
+	};
+
+	// Deletes the targets unless Delete was already called, the context has to still be current
+	~RenderTargetPool();
+	// A RenderTargetPool owns its GL objects, so it cannot be copied
+	RenderTargetPool() = default;
+	RenderTargetPool(const RenderTargetPool&) = delete;
+	RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+	// Starts a frame drawn to a window of width by height: stale targets are deleted and the rest are free
+	void BeginFrame(GLsizei width, GLsizei height);
+	// Takes a target fitting key from pass from to pass until, making one if none is free, and returns its index for
+	// target, valid until the next BeginFrame. name labels a new texture in GPU captures
+	size_t Acquire(const Key& key, uint32_t from, uint32_t until, const std::string& name);
+	const Target& target(size_t index) const;
+
+	// Whether the window size changed in the last SETTLE_FRAMES frames
+	bool resizing() const;
+	// Targets alive, and those made since the pool was created
+	size_t size() const;
+	size_t allocations() const;
+
+	// Deletes every target, does nothing for what was already deleted
+	void Delete();
+private:
+	std::vector<Target> targets;
+	uint64_t frame = 0;
+	// Window size of the last frame and the frame it last changed in
+	GLsizei windowWidth = 0;
+	GLsizei windowHeight = 0;
+	uint64_t resizedFrame = 0;
+	size_t allocated = 0;
+
+	// Deletes a target's GL objects
+	static void release(Target& target);
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include"ReverseDepth.h"
+#include"GLExtensions.h"
+#include"GpuMemory.h"
+
+#include<iostream>
+#include<utility>
+
+// Checks if the context has glClipControl
+bool ReverseDepth::Supported()
+{
+	return GLExt.clipControl;
+}
+
+// Constructor, the target is made by the first Begin that draws into it
+ReverseDepth::ReverseDepth()
+{
+}
+
+// Deletes the GL objects unless Delete was already called
+ReverseDepth::~ReverseDepth()
+{
+	Delete();
+}
+
+// Takes over the GL objects of another ReverseDepth
+ReverseDepth::ReverseDepth(ReverseDepth&& other) noexcept
+	: framebuffer(std::exchange(other.framebuffer, 0)), color(std::exchange(other.color, 0)), depth(std::exchange(other.depth, 0)),
+	width(std::exchange(other.width, 0)), height(std::exchange(other.height, 0)), output(std::exchange(other.output, 0)), drawing(std::exchange(other.drawing, false))
+{
+}
+
+// Deletes the current GL objects and takes over the ones of another ReverseDepth
+ReverseDepth& ReverseDepth::operator=(ReverseDepth&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		framebuffer = std::exchange(other.framebuffer, 0);
+		color = std::exchange(other.color, 0);
+		depth = std::exchange(other.depth, 0);
+		width = std::exchange(other.width, 0);
+		height = std::exchange(other.height, 0);
+		output = std::exchange(other.output, 0);
+		drawing = std::exchange(other.drawing, false);
+	}
+	return *this;
+}
+
+// Switches to reverse-Z and binds the target if asked to
+void ReverseDepth::Begin(GLsizei width, GLsizei height, bool target)
+{
+	drawing = target;
+	if (target)
+	{
+		GLint previous;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+		output = (GLuint)previous;
+		if (width != ReverseDepth::width || height != ReverseDepth::height || framebuffer == 0)
+			resize(width, height);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+	Resume();
+}
+
+// Puts GL's default depth convention back
+void ReverseDepth::Suspend()
+{
+	glClipControl(GL_LOWER_LEFT, GL_NEGATIVE_ONE_TO_ONE);
+	glDepthFunc(GL_LESS);
+	glClearDepth(1.0);
+}
+
+// Switches to reverse-Z
+void ReverseDepth::Resume()
+{
+	glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+	glDepthFunc(GL_GREATER);
+	glClearDepth(0.0);
+}
+
+// Puts the default convention back and copies the target into the framebuffer it replaced
+void ReverseDepth::End()
+{
+	Suspend();
+	if (!drawing)
+		return;
+	drawing = false;
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output);
+	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+}
+
+// Reallocates the target for a new size
+void ReverseDepth::resize(GLsizei width, GLsizei height)
+{
+	Delete();
+	ReverseDepth::width = width;
+	ReverseDepth::height = height;
+
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, color, GpuMemoryTracker::ImageBytes(GL_RGBA8, width, height));
+	glGenRenderbuffers(1, &depth);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32F, width, height);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, depth, GpuMemoryTracker::ImageBytes(GL_DEPTH_COMPONENT32F, width, height));
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::REVERSE_DEPTH::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Deletes the GL objects
+void ReverseDepth::Delete()
+{
+	GpuMemory.Untrack(GL_RENDERBUFFER, color);
+	GpuMemory.Untrack(GL_RENDERBUFFER, depth);
+	if (color != 0)
+		glDeleteRenderbuffers(1, &color);
+	if (depth != 0)
+		glDeleteRenderbuffers(1, &depth);
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = color = depth = 0;
+	width = height = 0;
+}
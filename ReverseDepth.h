@@ -0,0 +1,58 @@
+#ifndef REVERSE_DEPTH_CLASS_H
+#define REVERSE_DEPTH_CLASS_H
+
+#include<glad/glad.h>
+
+// Reverse-Z depth for the camera's passes: with glClipControl's GL_ZERO_TO_ONE depth, a projection such as
+// Camera::SetReverseZPerspective that puts the near plane at 1 and infinity at 0, and a 32 bit float depth buffer,
+// the float's exponent cancels the perspective divide and precision stays nearly even out to any distance.
+// Passes that build their own projections, the shadow cascades and the impostor bakes, keep GL's default
+// convention and run between Suspend and Resume. Forward frames are drawn into a float depth target of this class
+// whose color End copies into the framebuffer that was bound before, deferred frames already draw into a G-buffer with float depth.
+class ReverseDepth
+{
+public:
+	// Color and depth of the forward target, made by the first Begin that asks for it
+	GLuint framebuffer = 0;
+	GLuint color = 0;
+	GLuint depth = 0;
+
+	// Checks if the context has glClipControl
+	static bool Supported();
+
+	// Constructor, the target is made by the first Begin that draws into it
+	ReverseDepth();
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~ReverseDepth();
+	// A ReverseDepth owns its GL objects, so it can be moved but not copied
+	ReverseDepth(const ReverseDepth&) = delete;
+	ReverseDepth& operator=(const ReverseDepth&) = delete;
+	ReverseDepth(ReverseDepth&& other) noexcept;
+	ReverseDepth& operator=(ReverseDepth&& other) noexcept;
+
+	// Switches to reverse-Z: depth from 0 to 1, GL_GREATER and a clear depth of 0
+	// With target set the target of width by height replaces the bound framebuffer, reallocated when the size changed
+	void Begin(GLsizei width, GLsizei height, bool target);
+	// Puts GL's default depth convention back for a pass with its own projection, the bound framebuffer stays
+	void Suspend();
+	// Switches back to reverse-Z after Suspend
+	void Resume();
+	// Puts the default convention back and, if Begin bound the target, copies its color into the framebuffer it
+	// replaced and binds that again
+	void End();
+
+	// Deletes the GL objects, does nothing if they were already deleted or moved from
+	void Delete();
+private:
+	GLsizei width = 0;
+	GLsizei height = 0;
+	// Framebuffer the target replaced
+	GLuint output = 0;
+	// Whether the target is bound since Begin
+	bool drawing = false;
+
+	// Reallocates the target for a new size
+	void resize(GLsizei width, GLsizei height);
+};
+
+#endif
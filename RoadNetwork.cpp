@@ -0,0 +1,171 @@
+#include"RoadNetwork.h"
+
+#include<algorithm>
+#include<cfloat>
+
+// Every piece is a quad of four vertices and two triangles
+static constexpr GLuint QUAD_VERTICES = 4;
+static constexpr GLuint QUAD_INDICES = 6;
+// Sidewalks are four strips around the block and four curbs
+static constexpr GLuint SIDEWALK_QUADS = 8;
+
+// Vertices and indices of a tile as they are being written, with the bounds of what was written
+struct QuadWriter
+{
+	GLfloat* vertices;
+	GLuint* indices;
+	GLuint vertexCount;
+	GLuint indexCount;
+	glm::vec3 min;
+	glm::vec3 max;
+
+	// Adds a quad from its corners in counter-clockwise order seen from its front
+	void quad(const glm::vec3 (&corners)[QUAD_VERTICES])
+	{
+		for (GLuint c = 0; c < QUAD_VERTICES; c++)
+		{
+			GLfloat* out = vertices + (size_t)(vertexCount + c) * CityGenerator::VERTEX_FLOATS;
+			out[0] = corners[c].x; out[1] = corners[c].y; out[2] = corners[c].z;
+			// Like the ground, the streets take their look from their color alone
+			out[3] = 0.0f; out[4] = 0.0f;
+			min = glm::min(min, corners[c]);
+			max = glm::max(max, corners[c]);
+		}
+		const GLuint order[QUAD_INDICES] = { 0, 1, 2, 2, 3, 0 };
+		for (GLuint i = 0; i < QUAD_INDICES; i++)
+			indices[indexCount + i] = vertexCount + order[i];
+		vertexCount += QUAD_VERTICES;
+		indexCount += QUAD_INDICES;
+	}
+	// Adds a flat rectangle facing up, wound as CityGenerator's ground quad
+	void flat(float x0, float z0, float x1, float z1, float y)
+	{
+		quad({ glm::vec3(x0, y, z0), glm::vec3(x0, y, z1), glm::vec3(x1, y, z1), glm::vec3(x1, y, z0) });
+	}
+	// Adds an upright face from bottom corner a to b, left to right seen from outside as CityGenerator's walls
+	void wall(float ax, float az, float bx, float bz, float y0, float y1)
+	{
+		quad({ glm::vec3(ax, y0, az), glm::vec3(bx, y0, bz), glm::vec3(bx, y1, bz), glm::vec3(ax, y1, az) });
+	}
+};
+
+// Constructor that stores the city and the size of the tiles
+RoadNetwork::RoadNetwork(const CityGenerator& city, unsigned int tileBlocks)
+	: tileBlocks(std::max(tileBlocks, 1u)), city(city)
+{
+}
+
+size_t RoadNetwork::tilesX() const
+{
+	return (city.layout.blocksX + tileBlocks - 1) / tileBlocks;
+}
+
+size_t RoadNetwork::tileCount() const
+{
+	return tilesX() * ((city.layout.blocksZ + tileBlocks - 1) / tileBlocks);
+}
+
+// Blocks of the tile along an axis, the last tile also owns the crossings on the city's edge
+void RoadNetwork::tileRange(size_t tile, bool alongZ, unsigned int& first, unsigned int& end, unsigned int& crossings) const
+{
+	unsigned int blocks = alongZ ? city.layout.blocksZ : city.layout.blocksX;
+	size_t index = alongZ ? tile / tilesX() : tile % tilesX();
+	first = (unsigned int)index * tileBlocks;
+	end = std::min(first + tileBlocks, blocks);
+	crossings = end - first + (end == blocks ? 1 : 0);
+}
+
+// Streets are laid out as in CityGenerator::building, one in front of every block and one after the last
+float RoadNetwork::streetStart(unsigned int street, bool alongZ) const
+{
+	float blockPitch = city.layout.lotsPerSide * city.layout.lotSize + city.layout.streetWidth;
+	return (alongZ ? -city.halfExtentZ() : -city.halfExtentX()) + street * blockPitch;
+}
+
+// A quad for every crossing and every road leaving it, and SIDEWALK_QUADS for every block
+size_t RoadNetwork::vertexCount(size_t tile) const
+{
+	return indexCount(tile) / QUAD_INDICES * QUAD_VERTICES;
+}
+
+size_t RoadNetwork::indexCount(size_t tile) const
+{
+	unsigned int firstX, endX, crossingsX, firstZ, endZ, crossingsZ;
+	tileRange(tile, false, firstX, endX, crossingsX);
+	tileRange(tile, true, firstZ, endZ, crossingsZ);
+	size_t quads = (size_t)crossingsX * crossingsZ + (size_t)(endX - firstX) * crossingsZ + (size_t)crossingsX * (endZ - firstZ)
+		+ (size_t)(endX - firstX) * (endZ - firstZ) * SIDEWALK_QUADS;
+	return quads * QUAD_INDICES;
+}
+
+size_t RoadNetwork::vertexCount() const
+{
+	size_t count = 0;
+	for (size_t tile = 0; tile < tileCount(); tile++)
+		count += vertexCount(tile);
+	return count;
+}
+
+size_t RoadNetwork::indexCount() const
+{
+	size_t count = 0;
+	for (size_t tile = 0; tile < tileCount(); tile++)
+		count += indexCount(tile);
+	return count;
+}
+
+// Writes the kinds one after the other, so each is one range of the indices
+RoadNetwork::Tile RoadNetwork::GenerateTile(size_t tile, GLfloat* vertices, GLuint* indices) const
+{
+	const CityLayout& layout = city.layout;
+	unsigned int firstX, endX, crossingsX, firstZ, endZ, crossingsZ;
+	tileRange(tile, false, firstX, endX, crossingsX);
+	tileRange(tile, true, firstZ, endZ, crossingsZ);
+	float street = layout.streetWidth;
+	float blockSize = layout.lotsPerSide * layout.lotSize;
+	// As far out from the lots as PropScatter's sidewalk
+	float out = 0.3f * street;
+
+	QuadWriter writer = { vertices, indices, 0, 0, glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+	Tile result;
+	for (int kind = 0; kind < KIND_COUNT; kind++)
+	{
+		result.firstIndex[kind] = writer.indexCount;
+		for (unsigned int z = firstZ; z < firstZ + crossingsZ; z++)
+		{
+			for (unsigned int x = firstX; x < firstX + crossingsX; x++)
+			{
+				float x0 = streetStart(x, false), z0 = streetStart(z, true);
+				if (kind == ROAD)
+				{
+					// Towards the next crossing along +X and along +Z, the sidewalks cover the edges of both
+					if (x < layout.blocksX)
+						writer.flat(x0 + street, z0, x0 + street + blockSize, z0 + street, ROAD_HEIGHT);
+					if (z < layout.blocksZ)
+						writer.flat(x0, z0 + street, x0 + street, z0 + street + blockSize, ROAD_HEIGHT);
+				}
+				else if (kind == CROSSING)
+					writer.flat(x0, z0, x0 + street, z0 + street, ROAD_HEIGHT);
+				else if (x < endX && z < endZ)
+				{
+					// The lots of the block after the crossing, and the sidewalk around them
+					float lotX0 = x0 + street, lotZ0 = z0 + street;
+					float lotX1 = lotX0 + blockSize, lotZ1 = lotZ0 + blockSize;
+					float outX0 = lotX0 - out, outZ0 = lotZ0 - out, outX1 = lotX1 + out, outZ1 = lotZ1 + out;
+					writer.flat(outX0, lotZ1, outX1, outZ1, SIDEWALK_HEIGHT);
+					writer.flat(outX0, outZ0, outX1, lotZ0, SIDEWALK_HEIGHT);
+					writer.flat(outX0, lotZ0, lotX0, lotZ1, SIDEWALK_HEIGHT);
+					writer.flat(lotX1, lotZ0, outX1, lotZ1, SIDEWALK_HEIGHT);
+					writer.wall(outX0, outZ1, outX1, outZ1, 0.0f, SIDEWALK_HEIGHT);
+					writer.wall(outX1, outZ1, outX1, outZ0, 0.0f, SIDEWALK_HEIGHT);
+					writer.wall(outX1, outZ0, outX0, outZ0, 0.0f, SIDEWALK_HEIGHT);
+					writer.wall(outX0, outZ0, outX0, outZ1, 0.0f, SIDEWALK_HEIGHT);
+				}
+			}
+		}
+		result.indexCount[kind] = writer.indexCount - result.firstIndex[kind];
+	}
+	result.min = writer.min;
+	result.max = writer.max;
+	return result;
+}
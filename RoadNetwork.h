@@ -0,0 +1,69 @@
+#ifndef ROAD_NETWORK_CLASS_H
+#define ROAD_NETWORK_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+
+#include"CityGenerator.h"
+
+// Streets of a generated city on top of its ground quad, laid out as the graph TrafficSimulation drives: a crossing
+// wherever two streets meet, including those around the city, and a road between every two neighbouring crossings.
+// Every block gets a raised sidewalk around its lots, the width PropScatter places its street props on, with a curb
+// facing the road. The streets are cut into square tiles of blocks, and all the geometry of a tile is one mesh whose
+// indices are grouped by kind, so a tile draws with one call per kind in the kind's color, however many segments it has.
+// A tile owns the crossings at the corner of each of its blocks nearest the city's minimum, with the roads leaving
+// them towards +X and +Z, and the tiles along the maximum edges own the crossings on that edge too.
+class RoadNetwork
+{
+public:
+	// What each range of a tile's indices is, drawn in the matching color
+	enum Kind
+	{
+		ROAD,
+		CROSSING,
+		SIDEWALK,
+		KIND_COUNT
+	};
+	static constexpr GLfloat COLORS[KIND_COUNT][3] = { { 0.22f, 0.22f, 0.24f }, { 0.27f, 0.27f, 0.29f }, { 0.62f, 0.61f, 0.58f } };
+	// Heights of the road surface and of the sidewalks above the ground, the road is lifted just clear of the ground quad
+	static constexpr float ROAD_HEIGHT = 0.01f;
+	static constexpr float SIDEWALK_HEIGHT = 0.05f;
+
+	// Where a generated tile's kinds are in its indices, and the bounds of everything in it
+	struct Tile
+	{
+		GLuint firstIndex[KIND_COUNT];
+		GLuint indexCount[KIND_COUNT];
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	// Blocks along each side of a tile
+	unsigned int tileBlocks;
+
+	// Constructor for the streets of city in tiles of tileBlocks by tileBlocks blocks
+	RoadNetwork(const CityGenerator& city, unsigned int tileBlocks);
+
+	// Number of tiles, tile t is column t % tilesX() of row t / tilesX()
+	size_t tileCount() const;
+	size_t tilesX() const;
+	// Number of vertices and indices GenerateTile writes for a tile, and for all of them
+	size_t vertexCount(size_t tile) const;
+	size_t indexCount(size_t tile) const;
+	size_t vertexCount() const;
+	size_t indexCount() const;
+
+	// Writes the roads, crossings and sidewalks of a tile into arrays sized by vertexCount(tile) and indexCount(tile),
+	// in CityGenerator's vertex layout with indices counting from the tile's first vertex
+	Tile GenerateTile(size_t tile, GLfloat* vertices, GLuint* indices) const;
+private:
+	const CityGenerator& city;
+
+	// Range of blocks a tile covers along one axis of blocks blocks, and how many crossings it owns along it
+	void tileRange(size_t tile, bool alongZ, unsigned int& first, unsigned int& end, unsigned int& crossings) const;
+	// Start of street number street along X or Z
+	float streetStart(unsigned int street, bool alongZ) const;
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include"RoofLibrary.h"
+
+#include<glm/glm.hpp>
+#include<algorithm>
+
+// Parapet wall thickness as a fraction of the footprint, and how far the hip roofs' ridge stops short of each end
+static constexpr float PARAPET_INSET = 0.06f;
+static constexpr float HIP_INSET = 0.3f;
+
+// Vertices and indices of a shape as they are being written
+struct RoofWriter
+{
+	GLfloat* vertices;
+	GLuint* indices;
+	GLuint vertexCount;
+	GLuint indexCount;
+
+	// Adds a polygon of three or four corners as a fan, wound counter-clockwise seen from the side outward points to
+	void face(const glm::vec3* corners, GLuint count, const glm::vec3& outward)
+	{
+		bool flip = glm::dot(glm::cross(corners[1] - corners[0], corners[2] - corners[0]), outward) < 0.0f;
+		for (GLuint c = 0; c < count; c++)
+		{
+			GLfloat* out = vertices + (size_t)(vertexCount + c) * CityGenerator::VERTEX_FLOATS;
+			out[0] = corners[c].x; out[1] = corners[c].y; out[2] = corners[c].z;
+			// Like the streets, the roofs take their look from their color alone
+			out[3] = 0.0f; out[4] = 0.0f;
+		}
+		for (GLuint c = 1; c + 1 < count; c++)
+		{
+			indices[indexCount++] = vertexCount;
+			indices[indexCount++] = vertexCount + (flip ? c + 1 : c);
+			indices[indexCount++] = vertexCount + (flip ? c : c + 1);
+		}
+		vertexCount += count;
+	}
+	void triangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& outward)
+	{
+		const glm::vec3 corners[3] = { a, b, c };
+		face(corners, 3, outward);
+	}
+	void quad(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c, const glm::vec3& d, const glm::vec3& outward)
+	{
+		const glm::vec3 corners[4] = { a, b, c, d };
+		face(corners, 4, outward);
+	}
+};
+
+// Writes a shape, its ridge along X, swapping X and Z first when it runs along Z
+static void writeShape(RoofLibrary::Shape shape, RoofWriter& writer)
+{
+	bool alongZ = shape == RoofLibrary::GABLE_Z || shape == RoofLibrary::HIP_Z;
+	auto p = [alongZ](float x, float y, float z) { return alongZ ? glm::vec3(z, y, x) : glm::vec3(x, y, z); };
+	if (shape == RoofLibrary::PARAPET)
+	{
+		// Outer and inner face of every side, then the rim between them
+		const float lo = PARAPET_INSET, hi = 1.0f - PARAPET_INSET;
+		const glm::vec2 outer[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+		const glm::vec2 inner[4] = { { lo, lo }, { hi, lo }, { hi, hi }, { lo, hi } };
+		for (int side = 0; side < 4; side++)
+		{
+			const glm::vec2 &a = outer[side], &b = outer[(side + 1) % 4], &ia = inner[side], &ib = inner[(side + 1) % 4];
+			glm::vec2 mid = 0.5f * (a + b) - glm::vec2(0.5f);
+			glm::vec3 out = glm::vec3(mid.x, 0.0f, mid.y);
+			writer.quad(glm::vec3(a.x, 0.0f, a.y), glm::vec3(b.x, 0.0f, b.y), glm::vec3(b.x, 1.0f, b.y), glm::vec3(a.x, 1.0f, a.y), out);
+			writer.quad(glm::vec3(ia.x, 0.0f, ia.y), glm::vec3(ib.x, 0.0f, ib.y), glm::vec3(ib.x, 1.0f, ib.y), glm::vec3(ia.x, 1.0f, ia.y), -out);
+			writer.quad(glm::vec3(a.x, 1.0f, a.y), glm::vec3(b.x, 1.0f, b.y), glm::vec3(ib.x, 1.0f, ib.y), glm::vec3(ia.x, 1.0f, ia.y), glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+	}
+	else if (shape == RoofLibrary::PYRAMID)
+	{
+		glm::vec3 apex(0.5f, 1.0f, 0.5f);
+		writer.triangle(p(0, 0, 0), p(1, 0, 0), apex, glm::vec3(0.0f, 1.0f, -1.0f));
+		writer.triangle(p(1, 0, 0), p(1, 0, 1), apex, glm::vec3(1.0f, 1.0f, 0.0f));
+		writer.triangle(p(1, 0, 1), p(0, 0, 1), apex, glm::vec3(0.0f, 1.0f, 1.0f));
+		writer.triangle(p(0, 0, 1), p(0, 0, 0), apex, glm::vec3(-1.0f, 1.0f, 0.0f));
+	}
+	else
+	{
+		// Two slopes meeting at the ridge and two ends, upright gables or sloped hips
+		float inset = shape == RoofLibrary::HIP_X || shape == RoofLibrary::HIP_Z ? HIP_INSET : 0.0f;
+		glm::vec3 ridge0 = p(inset, 1.0f, 0.5f), ridge1 = p(1.0f - inset, 1.0f, 0.5f);
+		writer.quad(p(0, 0, 0), p(1, 0, 0), ridge1, ridge0, p(0.0f, 1.0f, -1.0f));
+		writer.quad(p(1, 0, 1), p(0, 0, 1), ridge0, ridge1, p(0.0f, 1.0f, 1.0f));
+		writer.triangle(p(0, 0, 1), p(0, 0, 0), ridge0, p(-1.0f, inset > 0.0f ? 1.0f : 0.0f, 0.0f));
+		writer.triangle(p(1, 0, 0), p(1, 0, 1), ridge1, p(1.0f, inset > 0.0f ? 1.0f : 0.0f, 0.0f));
+	}
+}
+
+unsigned int RoofLibrary::VertexCount(Shape shape)
+{
+	// Twelve quads of the parapet, four triangles of the pyramid, two quads and two triangles of the others
+	return shape == PARAPET ? 48 : shape == PYRAMID ? 12 : 14;
+}
+
+unsigned int RoofLibrary::IndexCount(Shape shape)
+{
+	return shape == PARAPET ? 72 : shape == PYRAMID ? 12 : 18;
+}
+
+void RoofLibrary::Generate(Shape shape, GLfloat* vertices, GLuint* indices)
+{
+	RoofWriter writer = { vertices, indices, 0, 0 };
+	writeShape(shape, writer);
+}
+
+// The seed is mixed once more first, the building's height is drawn from its bits as they are
+RoofLibrary::Shape RoofLibrary::ShapeOf(unsigned int seed, float width, float depth)
+{
+	bool alongX = width >= depth;
+	unsigned int mixed = (seed ^ (seed >> 15)) * 0x2c1b3c6dU;
+	switch (mixed >> 30)
+	{
+	case 0:
+		return PARAPET;
+	case 1:
+		return alongX ? GABLE_X : GABLE_Z;
+	case 2:
+		return alongX ? HIP_X : HIP_Z;
+	default:
+		return PYRAMID;
+	}
+}
+
+// Same footprint on top of the building, the fade of the building so both crossfade together
+void RoofLibrary::WriteRecord(Shape shape, const GLfloat* building, GLfloat* roof)
+{
+	bool parapet = shape == PARAPET;
+	roof[0] = building[0];
+	roof[1] = building[1] + building[4];
+	roof[2] = building[2];
+	roof[3] = building[3];
+	roof[4] = parapet ? PARAPET_HEIGHT : PITCH * std::min(building[3], building[5]);
+	roof[5] = building[5];
+	roof[6] = 0.0f;
+	roof[7] = building[7];
+	for (int c = 0; c < 3; c++)
+		roof[8 + c] = parapet ? building[8 + c] : ROOF_COLOR[c];
+	roof[11] = 0.0f;
+}
@@ -0,0 +1,49 @@
+#ifndef ROOF_LIBRARY_CLASS_H
+#define ROOF_LIBRARY_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"CityGenerator.h"
+
+// A few parametric roof meshes put on top of the building boxes, so the skyline varies without a mesh per building
+// Every shape spans the unit cube in CityGenerator's vertex layout like the unit building, so a roof is an instance
+// record of the same layout: the building's footprint for X and Z, its top for the translation's Y and the roof's
+// own height for the Y scale, all stretched in the vertex shader as the boxes are. Records only scale, so the
+// gable and hip roofs come in two meshes each, ridge along X or along Z, and a building gets the one along its
+// longer side. Every building keeps its shape, drawn from its lot's seed, and each shape is one instanced draw.
+class RoofLibrary
+{
+public:
+	enum Shape
+	{
+		// A low wall around the edge of the flat roof the box already has
+		PARAPET,
+		GABLE_X,
+		GABLE_Z,
+		HIP_X,
+		HIP_Z,
+		PYRAMID,
+		SHAPE_COUNT
+	};
+	// Tint of the pitched roofs, the parapet takes the building's
+	static constexpr GLfloat ROOF_COLOR[3] = { 0.55f, 0.3f, 0.24f };
+	// Height of a pitched roof as a fraction of the shorter side of its footprint, and of a parapet in city units
+	static constexpr float PITCH = 0.35f;
+	static constexpr float PARAPET_HEIGHT = 0.12f;
+	// Most vertices and indices of any shape
+	static constexpr unsigned int MAX_VERTICES = 48;
+	static constexpr unsigned int MAX_INDICES = 72;
+
+	// Number of vertices and indices Generate writes for a shape
+	static unsigned int VertexCount(Shape shape);
+	static unsigned int IndexCount(Shape shape);
+	// Writes a shape over the unit cube, its base at Y = 0, into arrays sized by VertexCount and IndexCount
+	static void Generate(Shape shape, GLfloat* vertices, GLuint* indices);
+	// Picks the shape of a building from its lot's seed, such as CityGenerator::lotSeed, and its footprint
+	static Shape ShapeOf(unsigned int seed, float width, float depth);
+	// Writes the record of a building's roof from the building's record, both of CityGenerator's layout
+	static void WriteRecord(Shape shape, const GLfloat* building, GLfloat* roof);
+};
+
+#endif
@@ -0,0 +1,80 @@
+#include"SamplerSet.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+
+#include<algorithm>
+
+SamplerSet Samplers;
+
+// Creates the samplers
+void SamplerSet::Create()
+{
+	if (samplers[0] != 0)
+		return;
+	glGenSamplers(KINDS, samplers);
+	const GLint filters[KINDS][2] = {
+		{ GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR },
+		{ GL_LINEAR_MIPMAP_LINEAR, GL_LINEAR },
+		{ GL_LINEAR, GL_LINEAR },
+		{ GL_NEAREST, GL_NEAREST }
+	};
+	for (int kind = 0; kind < KINDS; kind++)
+	{
+		GLint wrap = kind == TRILINEAR_REPEAT ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+		glSamplerParameteri(samplers[kind], GL_TEXTURE_MIN_FILTER, filters[kind][0]);
+		glSamplerParameteri(samplers[kind], GL_TEXTURE_MAG_FILTER, filters[kind][1]);
+		glSamplerParameteri(samplers[kind], GL_TEXTURE_WRAP_S, wrap);
+		glSamplerParameteri(samplers[kind], GL_TEXTURE_WRAP_T, wrap);
+	}
+	SetAnisotropy(currentAnisotropy);
+}
+
+// Sets the anisotropy of the mipmapped samplers
+void SamplerSet::SetAnisotropy(float anisotropy)
+{
+	currentAnisotropy = std::max(anisotropy, 1.0f);
+	if (!GLExt.anisotropicFilter)
+	{
+		currentAnisotropy = 1.0f;
+		return;
+	}
+	GLfloat maxAnisotropy = 1.0f;
+	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+	currentAnisotropy = std::min(currentAnisotropy, maxAnisotropy);
+	if (samplers[0] == 0)
+		return;
+	glSamplerParameterf(samplers[TRILINEAR_REPEAT], GL_TEXTURE_MAX_ANISOTROPY, currentAnisotropy);
+	glSamplerParameterf(samplers[TRILINEAR_CLAMP], GL_TEXTURE_MAX_ANISOTROPY, currentAnisotropy);
+}
+
+// Anisotropy the mipmapped samplers filter with
+float SamplerSet::anisotropy() const
+{
+	return currentAnisotropy;
+}
+
+// Sampler object of a kind
+GLuint SamplerSet::sampler(Kind kind) const
+{
+	return samplers[kind];
+}
+
+// Binds the sampler of a kind to a texture unit
+void SamplerSet::Bind(GLuint unit, Kind kind)
+{
+	GLState.BindSampler(unit, samplers[kind]);
+}
+
+// Leaves a unit to the parameters of its texture
+void SamplerSet::Unbind(GLuint unit)
+{
+	GLState.BindSampler(unit, 0);
+}
+
+// Deletes the samplers
+void SamplerSet::Delete()
+{
+	if (samplers[0] != 0)
+		GLState.DeleteSamplers(KINDS, samplers);
+	std::fill(samplers, samplers + KINDS, 0u);
+}
@@ -0,0 +1,46 @@
+#ifndef SAMPLER_SET_CLASS_H
+#define SAMPLER_SET_CLASS_H
+
+#include<glad/glad.h>
+
+// A few sampler objects shared by every texture drawn with the same filtering and wrapping, bound to the unit a
+// texture is sampled from. Textures keep GL's default parameters and the sampler bound next to them overrides those,
+// so the filtering quality, anisotropy included, changes for everything at once here instead of texture by texture.
+// Render targets fetch their texels or filter them once in a pass of their own and keep setting their own parameters.
+class SamplerSet
+{
+public:
+	enum Kind
+	{
+		// Mipmapped and repeating, the facades, anisotropic when that is turned on
+		TRILINEAR_REPEAT,
+		// Mipmapped and clamped to the edge, the impostor atlas whose cells must not bleed into each other
+		TRILINEAR_CLAMP,
+		LINEAR_CLAMP,
+		NEAREST_CLAMP,
+		KINDS
+	};
+
+	// Creates the samplers, needs a current context with GLExt loaded
+	void Create();
+	// Sets the anisotropy of the mipmapped samplers, clamped to what the driver allows, 1 turns it off
+	void SetAnisotropy(float anisotropy);
+	// Anisotropy the mipmapped samplers filter with
+	float anisotropy() const;
+	// Sampler object of a kind, for bindless handles that are taken together with one
+	GLuint sampler(Kind kind) const;
+	// Binds the sampler of a kind to a texture unit, given as a number from 0
+	void Bind(GLuint unit, Kind kind);
+	// Leaves a unit to the parameters of its texture again
+	void Unbind(GLuint unit);
+	// Deletes the samplers, does nothing if they were already deleted
+	void Delete();
+private:
+	GLuint samplers[KINDS] = {};
+	float currentAnisotropy = 1.0f;
+};
+
+// The samplers of the one context the engine renders with
+extern SamplerSet Samplers;
+
+#endif
@@ -0,0 +1,200 @@
+#include"SceneFile.h"
+#include"AmbientOcclusion.h"
+
+#include<fstream>
+#include<utility>
+#include<vector>
+
+// Blocks start at multiples of this, enough for any vertex attribute or SIMD load from the mapping
+static const uint64_t BLOCK_ALIGNMENT = 16;
+
+// Unmaps the file unless Close was already called
+SceneFile::~SceneFile()
+{
+	Close();
+}
+
+// Takes over the mapping of another file, which is left closed
+SceneFile::SceneFile(SceneFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+// Unmaps the current file and takes over the mapping of another one
+SceneFile& SceneFile::operator=(SceneFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		layout = other.layout;
+		file = std::move(other.file);
+		header = std::exchange(other.header, nullptr);
+	}
+	return *this;
+}
+
+// Generates a city and writes it as a scene file
+bool SceneFile::Write(const std::string& path, const CityGenerator& city, JobSystem& jobs)
+{
+	std::vector<GLfloat> cityVertices(city.vertexCount() * CityGenerator::VERTEX_FLOATS);
+	std::vector<GLuint> cityIndices(city.indexCount());
+	city.Generate(cityVertices.data(), cityIndices.data(), jobs);
+	std::vector<GLfloat> unitVertices(CityGenerator::BUILDING_VERTICES * CityGenerator::VERTEX_FLOATS);
+	std::vector<GLuint> unitIndices(CityGenerator::BUILDING_INDICES);
+	CityGenerator::GenerateUnitBuilding(unitVertices.data(), unitIndices.data());
+	std::vector<GLfloat> instances(city.buildingCount() * CityGenerator::INSTANCE_FLOATS);
+	city.GenerateInstances(instances.data(), jobs);
+	AmbientOcclusion().Bake(city, instances.data(), jobs);
+	std::vector<GLfloat> blockInstances(city.blockCount() * CityGenerator::INSTANCE_FLOATS);
+	city.GenerateBlockInstances(blockInstances.data(), jobs);
+
+	const void* blocks[BLOCK_COUNT] = { cityVertices.data(), cityIndices.data(), unitVertices.data(), unitIndices.data(), instances.data(), blockInstances.data() };
+	Header header = {};
+	header.magic = MAGIC;
+	header.version = VERSION;
+	header.vertexFloats = CityGenerator::VERTEX_FLOATS;
+	header.instanceFloats = CityGenerator::INSTANCE_FLOATS;
+	header.blocksX = city.layout.blocksX;
+	header.blocksZ = city.layout.blocksZ;
+	header.lotsPerSide = city.layout.lotsPerSide;
+	header.facadeCount = city.layout.facadeCount;
+	header.seed = city.layout.seed;
+	header.lotSize = city.layout.lotSize;
+	header.streetWidth = city.layout.streetWidth;
+	header.minHeight = city.layout.minHeight;
+	header.maxHeight = city.layout.maxHeight;
+	header.lotCoverage = city.layout.lotCoverage;
+	header.sizes[CITY_VERTICES] = cityVertices.size() * sizeof(GLfloat);
+	header.sizes[CITY_INDICES] = cityIndices.size() * sizeof(GLuint);
+	header.sizes[UNIT_VERTICES] = unitVertices.size() * sizeof(GLfloat);
+	header.sizes[UNIT_INDICES] = unitIndices.size() * sizeof(GLuint);
+	header.sizes[INSTANCES] = instances.size() * sizeof(GLfloat);
+	header.sizes[BLOCK_INSTANCES] = blockInstances.size() * sizeof(GLfloat);
+	uint64_t offset = (sizeof(Header) + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+	for (int i = 0; i < BLOCK_COUNT; i++)
+	{
+		header.offsets[i] = offset;
+		offset = (offset + header.sizes[i] + BLOCK_ALIGNMENT - 1) / BLOCK_ALIGNMENT * BLOCK_ALIGNMENT;
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	const char padding[BLOCK_ALIGNMENT] = {};
+	uint64_t written = sizeof(header);
+	for (int i = 0; i < BLOCK_COUNT; i++)
+	{
+		file.write(padding, header.offsets[i] - written);
+		file.write((const char*)blocks[i], header.sizes[i]);
+		written = header.offsets[i] + header.sizes[i];
+	}
+	return (bool)file;
+}
+
+// Maps a scene file
+bool SceneFile::Open(const std::string& path)
+{
+	Close();
+	// Every block is read front to back exactly once, by the driver or the instance packing
+	if (!file.Open(path) || file.size() < sizeof(Header))
+	{
+		Close();
+		return false;
+	}
+	const unsigned char* data = file.data();
+	size_t size = file.size();
+
+	// Only the header is checked, the blocks are trusted to be what the header says
+	header = (const Header*)data;
+	bool valid = header->magic == MAGIC && header->version == VERSION
+		&& header->vertexFloats == CityGenerator::VERTEX_FLOATS && header->instanceFloats == CityGenerator::INSTANCE_FLOATS;
+	for (int i = 0; valid && i < BLOCK_COUNT; i++)
+		valid = header->offsets[i] % BLOCK_ALIGNMENT == 0 && header->offsets[i] + header->sizes[i] <= size;
+	if (valid)
+	{
+		layout.blocksX = header->blocksX;
+		layout.blocksZ = header->blocksZ;
+		layout.lotsPerSide = header->lotsPerSide;
+		layout.facadeCount = header->facadeCount;
+		layout.seed = header->seed;
+		layout.lotSize = header->lotSize;
+		layout.streetWidth = header->streetWidth;
+		layout.minHeight = header->minHeight;
+		layout.maxHeight = header->maxHeight;
+		layout.lotCoverage = header->lotCoverage;
+		// The blocks have to be as large as the layout says, or drawing would read past them
+		CityGenerator city(layout);
+		valid = header->sizes[CITY_VERTICES] == city.vertexCount() * CityGenerator::VERTEX_FLOATS * sizeof(GLfloat)
+			&& header->sizes[CITY_INDICES] == city.indexCount() * sizeof(GLuint)
+			&& header->sizes[UNIT_VERTICES] == CityGenerator::BUILDING_VERTICES * CityGenerator::VERTEX_FLOATS * sizeof(GLfloat)
+			&& header->sizes[UNIT_INDICES] == CityGenerator::BUILDING_INDICES * sizeof(GLuint)
+			&& header->sizes[INSTANCES] == city.buildingCount() * CityGenerator::INSTANCE_FLOATS * sizeof(GLfloat)
+			&& header->sizes[BLOCK_INSTANCES] == city.blockCount() * CityGenerator::INSTANCE_FLOATS * sizeof(GLfloat);
+	}
+	if (!valid)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+// Checks if a file is mapped
+bool SceneFile::isOpen() const
+{
+	return header != nullptr;
+}
+
+// Reads the mapping in
+void SceneFile::Prefetch() const
+{
+	if (isOpen())
+		file.Prefault();
+}
+
+// Start of a block inside the mapping
+const void* SceneFile::block(Block block) const
+{
+	return file.data() + header->offsets[block];
+}
+
+size_t SceneFile::blockSize(Block block) const
+{
+	return (size_t)header->sizes[block];
+}
+
+const GLfloat* SceneFile::cityVertices() const
+{
+	return (const GLfloat*)block(CITY_VERTICES);
+}
+
+const GLuint* SceneFile::cityIndices() const
+{
+	return (const GLuint*)block(CITY_INDICES);
+}
+
+const GLfloat* SceneFile::unitVertices() const
+{
+	return (const GLfloat*)block(UNIT_VERTICES);
+}
+
+const GLuint* SceneFile::unitIndices() const
+{
+	return (const GLuint*)block(UNIT_INDICES);
+}
+
+const GLfloat* SceneFile::instances() const
+{
+	return (const GLfloat*)block(INSTANCES);
+}
+
+const GLfloat* SceneFile::blockInstances() const
+{
+	return (const GLfloat*)block(BLOCK_INSTANCES);
+}
+
+// Unmaps the file
+void SceneFile::Close()
+{
+	file.Close();
+	header = nullptr;
+}
@@ -0,0 +1,106 @@
+#ifndef SCENE_FILE_CLASS_H
+#define SCENE_FILE_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<cstdint>
+#include<string>
+
+#include"CityGenerator.h"
+#include"JobSystem.h"
+#include"MappedFile.h"
+
+// Binary city file that is memory mapped instead of read, every block is laid out exactly like the buffer it goes into
+// so loading is nothing but pointing GL or the instance packing at the mapping, without parsing or copying anything
+//
+// Layout, all little endian: a Header, then each block at the offset the header gives, 16 byte aligned
+//   city vertices       CityGenerator::Generate vertices, the ground quad first, VERTEX_FLOATS floats each
+//   city indices        CityGenerator::Generate indices, relative to the first city vertex
+//   unit vertices       CityGenerator::GenerateUnitBuilding
+//   unit indices
+//   instances           CityGenerator::GenerateInstances, INSTANCE_FLOATS floats per building, ambient occlusion baked
+//   block instances     CityGenerator::GenerateBlockInstances, INSTANCE_FLOATS floats per block
+class SceneFile
+{
+public:
+	// Start of every scene file, bumped version numbers are refused rather than misread
+	static constexpr uint32_t MAGIC = 0x454E4353; // "SCNE"
+	static constexpr uint32_t VERSION = 3;
+
+	// Blocks in the order they follow the header
+	enum Block
+	{
+		CITY_VERTICES,
+		CITY_INDICES,
+		UNIT_VERTICES,
+		UNIT_INDICES,
+		INSTANCES,
+		BLOCK_INSTANCES,
+		BLOCK_COUNT
+	};
+
+	// Layout the city was generated from, read out of the header
+	CityLayout layout;
+
+	SceneFile() = default;
+	// Unmaps the file unless Close was already called
+	~SceneFile();
+	// A SceneFile owns its mapping, so it can be moved but not copied
+	SceneFile(const SceneFile&) = delete;
+	SceneFile& operator=(const SceneFile&) = delete;
+	SceneFile(SceneFile&& other) noexcept;
+	SceneFile& operator=(SceneFile&& other) noexcept;
+
+	// Generates a city, bakes its ambient occlusion with the workers of jobs and writes it as a scene file, false if it
+	// could not be written
+	static bool Write(const std::string& path, const CityGenerator& city, JobSystem& jobs);
+	// Maps a scene file, false if it is missing, truncated, of another version or another vertex layout
+	bool Open(const std::string& path);
+	// Checks if a file is mapped
+	bool isOpen() const;
+	// Reads the whole mapping in, meant for a worker while the window is created so the uploads find it in memory
+	void Prefetch() const;
+
+	// Start of a block inside the mapping and its size in bytes
+	const void* block(Block block) const;
+	size_t blockSize(Block block) const;
+	// The blocks typed, valid until Close
+	const GLfloat* cityVertices() const;
+	const GLuint* cityIndices() const;
+	const GLfloat* unitVertices() const;
+	const GLuint* unitIndices() const;
+	const GLfloat* instances() const;
+	const GLfloat* blockInstances() const;
+
+	// Unmaps the file, does nothing if nothing is mapped
+	void Close();
+private:
+	// Stored at the start of the file
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vertexFloats;
+		uint32_t instanceFloats;
+		// CityLayout field by field, so padding or reordering of the struct never changes the file
+		uint32_t blocksX;
+		uint32_t blocksZ;
+		uint32_t lotsPerSide;
+		uint32_t facadeCount;
+		uint32_t seed;
+		float lotSize;
+		float streetWidth;
+		float minHeight;
+		float maxHeight;
+		float lotCoverage;
+		uint32_t reserved[2];
+		// Byte offset and size of every block
+		uint64_t offsets[BLOCK_COUNT];
+		uint64_t sizes[BLOCK_COUNT];
+	};
+
+	MappedFile file;
+	const Header* header = nullptr;
+};
+
+#endif
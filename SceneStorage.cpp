@@ -0,0 +1,112 @@
+#include"SceneStorage.h"
+
+// Reserves room in every array
+void SceneStorage::Reserve(size_t count)
+{
+	positionX.reserve(count); positionY.reserve(count); positionZ.reserve(count);
+	bounds.minX.reserve(count); bounds.minY.reserve(count); bounds.minZ.reserve(count);
+	bounds.maxX.reserve(count); bounds.maxY.reserve(count); bounds.maxZ.reserve(count);
+	lodState.reserve(count);
+	material.reserve(count);
+	visible.reserve(count);
+	denseSlot.reserve(count);
+}
+
+// Appends a building to every array and gives it a free slot, or a new one
+SceneStorage::Handle SceneStorage::Create(const glm::vec3& min, const glm::vec3& max, uint32_t material)
+{
+	uint32_t index = (uint32_t)denseSlot.size();
+	positionX.push_back(0.5f * (min.x + max.x));
+	positionY.push_back(min.y);
+	positionZ.push_back(0.5f * (min.z + max.z));
+	bounds.Add(min, max);
+	lodState.push_back(0);
+	SceneStorage::material.push_back(material);
+	visible.push_back(0);
+
+	Handle handle;
+	if (freeSlot != INVALID)
+	{
+		handle.slot = freeSlot;
+		freeSlot = slotIndex[freeSlot];
+		slotIndex[handle.slot] = index;
+	}
+	else
+	{
+		handle.slot = (uint32_t)slotIndex.size();
+		slotIndex.push_back(index);
+		slotGeneration.push_back(0);
+	}
+	handle.generation = slotGeneration[handle.slot];
+	denseSlot.push_back(handle.slot);
+	return handle;
+}
+
+// Moves the last building into the hole, then retires the slot so its old handles go stale
+void SceneStorage::Destroy(Handle handle)
+{
+	uint32_t index = Index(handle);
+	if (index == INVALID)
+		return;
+	uint32_t last = (uint32_t)denseSlot.size() - 1;
+	if (index != last)
+	{
+		positionX[index] = positionX[last]; positionY[index] = positionY[last]; positionZ[index] = positionZ[last];
+		bounds.minX[index] = bounds.minX[last]; bounds.minY[index] = bounds.minY[last]; bounds.minZ[index] = bounds.minZ[last];
+		bounds.maxX[index] = bounds.maxX[last]; bounds.maxY[index] = bounds.maxY[last]; bounds.maxZ[index] = bounds.maxZ[last];
+		lodState[index] = lodState[last];
+		material[index] = material[last];
+		visible[index] = visible[last];
+		denseSlot[index] = denseSlot[last];
+		slotIndex[denseSlot[index]] = index;
+	}
+	positionX.pop_back(); positionY.pop_back(); positionZ.pop_back();
+	bounds.minX.pop_back(); bounds.minY.pop_back(); bounds.minZ.pop_back();
+	bounds.maxX.pop_back(); bounds.maxY.pop_back(); bounds.maxZ.pop_back();
+	lodState.pop_back();
+	material.pop_back();
+	visible.pop_back();
+	denseSlot.pop_back();
+
+	slotGeneration[handle.slot]++;
+	slotIndex[handle.slot] = freeSlot;
+	freeSlot = handle.slot;
+}
+
+// A handle is valid while its slot has not been reused since
+bool SceneStorage::Valid(Handle handle) const
+{
+	return handle.slot < slotGeneration.size() && slotGeneration[handle.slot] == handle.generation
+		&& slotIndex[handle.slot] < denseSlot.size() && denseSlot[slotIndex[handle.slot]] == handle.slot;
+}
+
+// Dense index of a building
+uint32_t SceneStorage::Index(Handle handle) const
+{
+	return Valid(handle) ? slotIndex[handle.slot] : INVALID;
+}
+
+// Handle of the building at a dense index
+SceneStorage::Handle SceneStorage::HandleOf(uint32_t index) const
+{
+	Handle handle;
+	handle.slot = denseSlot[index];
+	handle.generation = slotGeneration[handle.slot];
+	return handle;
+}
+
+// Moves a building's box and position
+void SceneStorage::SetBounds(uint32_t index, const glm::vec3& min, const glm::vec3& max)
+{
+	positionX[index] = 0.5f * (min.x + max.x);
+	positionY[index] = min.y;
+	positionZ[index] = 0.5f * (min.z + max.z);
+	bounds.minX[index] = min.x; bounds.minY[index] = min.y; bounds.minZ[index] = min.z;
+	bounds.maxX[index] = max.x; bounds.maxY[index] = max.y; bounds.maxZ[index] = max.z;
+}
+
+// Number of buildings
+size_t SceneStorage::size() const
+{
+	return denseSlot.size();
+}
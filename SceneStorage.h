@@ -0,0 +1,64 @@
+#ifndef SCENE_STORAGE_CLASS_H
+#define SCENE_STORAGE_CLASS_H
+
+#include<glm/glm.hpp>
+#include<vector>
+#include<cstddef>
+#include<cstdint>
+
+#include"Frustum.h"
+
+// Buildings of the scene stored as a structure of arrays, one array per field, so a loop only streams what it reads
+// The arrays stay dense: entity i of every array is the same building, and Destroy moves the last building into the
+// hole. Callers keep a Handle instead of the dense index, which goes through a slot that follows the building when it
+// moves. A slot's generation counts its reuses, so a handle of a destroyed building never finds the one that took
+// its slot. The bounds are a BoundingBoxes, so Frustum::Cull runs on them as they are and writes dense indices.
+class SceneStorage
+{
+public:
+	// Stable name of a building, valid until it is destroyed
+	struct Handle
+	{
+		uint32_t slot = INVALID;
+		uint32_t generation = 0;
+	};
+	// Dense index and slot returned when there is none
+	static constexpr uint32_t INVALID = 0xffffffffu;
+
+	// Ground center of every building
+	std::vector<float> positionX, positionY, positionZ;
+	// Box around every building
+	BoundingBoxes bounds;
+	// Detail level of every building, 0 for the full mesh
+	std::vector<uint8_t> lodState;
+	// Facade texture every building wears
+	std::vector<uint32_t> material;
+	// 1 for the buildings that passed culling in the last frame
+	std::vector<uint8_t> visible;
+
+	// Reserves room for count buildings, so creating that many does not reallocate the arrays
+	void Reserve(size_t count);
+	// Adds a building with the box from min to max standing on the middle of its bottom
+	Handle Create(const glm::vec3& min, const glm::vec3& max, uint32_t material);
+	// Removes a building, the last one moves to its dense index, does nothing for a stale handle
+	void Destroy(Handle handle);
+	// Checks if a handle still names a building
+	bool Valid(Handle handle) const;
+	// Dense index of a building in every array, INVALID for a stale handle
+	uint32_t Index(Handle handle) const;
+	// Handle of the building at a dense index
+	Handle HandleOf(uint32_t index) const;
+	// Moves a building's box and position
+	void SetBounds(uint32_t index, const glm::vec3& min, const glm::vec3& max);
+	// Number of buildings
+	size_t size() const;
+private:
+	// Dense index and generation of every slot, a free slot holds the next free one instead of an index
+	std::vector<uint32_t> slotIndex;
+	std::vector<uint32_t> slotGeneration;
+	// Slot of every dense index
+	std::vector<uint32_t> denseSlot;
+	uint32_t freeSlot = INVALID;
+};
+
+#endif
@@ -0,0 +1,312 @@
+#include"SceneSync.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<memory>
+#include<random>
+
+#ifdef _WIN32
+#include<winsock2.h>
+#include<ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET NativeSocket;
+static const intptr_t INVALID_HANDLE = (intptr_t)INVALID_SOCKET;
+static void closeSocket(intptr_t handle) { closesocket((NativeSocket)handle); }
+#else
+#include<netdb.h>
+#include<netinet/in.h>
+#include<sys/socket.h>
+#include<sys/time.h>
+#include<unistd.h>
+typedef int NativeSocket;
+static const intptr_t INVALID_HANDLE = -1;
+static void closeSocket(intptr_t handle) { close((NativeSocket)handle); }
+#endif
+
+// A datagram starts with the magic number, the sender, its sequence number and the size of the batch it repeats,
+// then that batch and its own
+static const uint32_t MAGIC = 0x4E595343u;
+static const size_t HEADER_BYTES = 4 + 4 + 4 + 2;
+// Largest batch, a datagram holds two of them
+static const size_t BATCH_BYTES = (SceneSync::DATAGRAM_BYTES - HEADER_BYTES) / 2;
+
+// Appends a value as its bytes, little endian on every platform the engine runs on
+template<typename T>
+static void put(std::vector<uint8_t>& out, const T& value)
+{
+	const uint8_t* bytes = (const uint8_t*)&value;
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Reads a value at a cursor, false once the data runs out
+template<typename T>
+static bool get(const uint8_t* data, size_t size, size_t& at, T& value)
+{
+	if (at + sizeof(T) > size)
+		return false;
+	std::memcpy(&value, data + at, sizeof(T));
+	at += sizeof(T);
+	return true;
+}
+
+// Corners go as three floats, whatever padding glm gives a vec3
+static void putVector(std::vector<uint8_t>& out, const glm::vec3& value)
+{
+	put(out, value.x);
+	put(out, value.y);
+	put(out, value.z);
+}
+
+static bool getVector(const uint8_t* data, size_t size, size_t& at, glm::vec3& value)
+{
+	return get(data, size, at, value.x) && get(data, size, at, value.y) && get(data, size, at, value.z);
+}
+
+// Constructor that binds the port, resolves the peers and starts the thread
+SceneSync::SceneSync(unsigned short port, const std::vector<std::string>& peers)
+{
+	self = std::random_device()();
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		socket = INVALID_HANDLE;
+		std::cerr << "ERROR::SCENE_SYNC::WSASTARTUP_FAILED" << std::endl;
+		return;
+	}
+	socket = (intptr_t)::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#else
+	socket = (intptr_t)::socket(AF_INET, SOCK_DGRAM, 0);
+#endif
+	if (socket == INVALID_HANDLE)
+	{
+		std::cerr << "ERROR::SCENE_SYNC::SOCKET_FAILED" << std::endl;
+		return;
+	}
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(port);
+	if (bind((NativeSocket)socket, (const sockaddr*)&address, sizeof(address)) != 0)
+	{
+		std::cerr << "ERROR::SCENE_SYNC::BIND_FAILED port " << port << std::endl;
+		closeSocket(socket);
+		socket = INVALID_HANDLE;
+		return;
+	}
+	// A peer that cannot be resolved is left out, the others still get the edits
+	for (const std::string& peer : peers)
+	{
+		size_t colon = peer.rfind(':');
+		std::string host = colon == std::string::npos ? peer : peer.substr(0, colon);
+		std::string service = colon == std::string::npos ? std::to_string(port) : peer.substr(colon + 1);
+		addrinfo hints{};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_DGRAM;
+		addrinfo* found = nullptr;
+		if (getaddrinfo(host.c_str(), service.c_str(), &hints, &found) != 0 || !found)
+		{
+			std::cerr << "ERROR::SCENE_SYNC::UNKNOWN_PEER " << peer << std::endl;
+			continue;
+		}
+		const uint8_t* bytes = (const uint8_t*)found->ai_addr;
+		peerAddresses.emplace_back(bytes, bytes + found->ai_addrlen);
+		freeaddrinfo(found);
+	}
+	// Receiving gives up every 100 ms, so the thread sees a request to stop without the socket being closed under it
+#ifdef _WIN32
+	DWORD timeout = 100;
+#else
+	timeval timeout{ 0, 100000 };
+#endif
+	setsockopt((NativeSocket)socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	thread = std::thread(&SceneSync::receive, this);
+}
+
+// Stops the thread unless Delete was already called
+SceneSync::~SceneSync()
+{
+	Delete();
+}
+
+// Whether the socket could be bound
+bool SceneSync::isOpen() const
+{
+	return socket != INVALID_HANDLE;
+}
+
+// Queues an edit for the next Flush
+void SceneSync::Send(const Edit& edit)
+{
+	outbox.push_back(edit);
+}
+
+// Packs the queued edits into batches of at most BATCH_BYTES, each sent in a datagram of its own
+void SceneSync::Flush()
+{
+	if (outbox.empty() || socket == INVALID_HANDLE)
+	{
+		outbox.clear();
+		return;
+	}
+	std::vector<uint8_t> batch;
+	batch.reserve(BATCH_BYTES);
+	for (const Edit& edit : outbox)
+	{
+		if (batch.size() + MAX_EDIT_BYTES > BATCH_BYTES)
+		{
+			sendBatch(batch);
+			batch.clear();
+		}
+		Encode(edit, batch);
+	}
+	sendBatch(batch);
+	sentCount.fetch_add(outbox.size(), std::memory_order_relaxed);
+	outbox.clear();
+}
+
+// Swaps the received edits out under the lock, the thread goes on filling the emptied vector
+void SceneSync::Drain(std::vector<Edit>& out)
+{
+	out.clear();
+	if (!inboxPending.load(std::memory_order_acquire))
+		return;
+	std::lock_guard<std::mutex> lock(inboxMutex);
+	out.swap(inbox);
+	inboxPending.store(false, std::memory_order_release);
+}
+
+// Edits may be waiting to be drained
+bool SceneSync::pending() const
+{
+	return inboxPending.load(std::memory_order_acquire);
+}
+
+// Edits sent so far
+uint64_t SceneSync::sent() const
+{
+	return sentCount.load(std::memory_order_relaxed);
+}
+
+// Edits received so far
+uint64_t SceneSync::received() const
+{
+	return receivedCount.load(std::memory_order_relaxed);
+}
+
+// Datagrams of peers lost for good so far
+uint64_t SceneSync::lost() const
+{
+	return lostCount.load(std::memory_order_relaxed);
+}
+
+// Stops the thread and closes the socket
+void SceneSync::Delete()
+{
+	if (socket == INVALID_HANDLE)
+		return;
+	stopping = true;
+	if (thread.joinable())
+		thread.join();
+	closeSocket(socket);
+	socket = INVALID_HANDLE;
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+// Appends the operation byte with the field flags, the building and the flagged fields, the facade as 16 bits
+void SceneSync::Encode(const Edit& edit, std::vector<uint8_t>& batch)
+{
+	uint8_t fields = edit.operation == ADD ? (uint8_t)ALL_FIELDS : edit.operation == REMOVE ? (uint8_t)0 : (uint8_t)(edit.fields & ALL_FIELDS);
+	put(batch, (uint8_t)(edit.operation | fields));
+	put(batch, edit.building);
+	if (fields & MIN)
+		putVector(batch, edit.min);
+	if (fields & MAX)
+		putVector(batch, edit.max);
+	if (fields & FACADE)
+		put(batch, (uint16_t)edit.facade);
+}
+
+// Reads what Encode wrote
+bool SceneSync::Decode(const uint8_t* batch, size_t size, std::vector<Edit>& out)
+{
+	size_t at = 0;
+	while (at < size)
+	{
+		Edit edit;
+		uint8_t operation;
+		if (!get(batch, size, at, operation) || !get(batch, size, at, edit.building) || (operation & 3) > ADD)
+			return false;
+		edit.operation = (Operation)(operation & 3);
+		edit.fields = operation & ALL_FIELDS;
+		uint16_t facade = 0;
+		if ((edit.fields & MIN) && !getVector(batch, size, at, edit.min))
+			return false;
+		if ((edit.fields & MAX) && !getVector(batch, size, at, edit.max))
+			return false;
+		if ((edit.fields & FACADE) && !get(batch, size, at, facade))
+			return false;
+		edit.facade = facade;
+		out.push_back(edit);
+	}
+	return true;
+}
+
+// Sends the header, the previous batch and this one to every peer, then keeps this one for the next datagram
+void SceneSync::sendBatch(const std::vector<uint8_t>& batch)
+{
+	std::vector<uint8_t> datagram;
+	datagram.reserve(HEADER_BYTES + previousBatch.size() + batch.size());
+	put(datagram, MAGIC);
+	put(datagram, self);
+	put(datagram, sequence++);
+	put(datagram, (uint16_t)previousBatch.size());
+	datagram.insert(datagram.end(), previousBatch.begin(), previousBatch.end());
+	datagram.insert(datagram.end(), batch.begin(), batch.end());
+	for (const std::vector<uint8_t>& peer : peerAddresses)
+		sendto((NativeSocket)socket, (const char*)datagram.data(), (int)datagram.size(), 0, (const sockaddr*)peer.data(), (int)peer.size());
+	previousBatch = batch;
+}
+
+// Decodes datagrams in the order of their sequence numbers, the repeated batch fills in for a lost datagram
+void SceneSync::receive()
+{
+	std::unique_ptr<uint8_t[]> datagram(new uint8_t[DATAGRAM_BYTES]);
+	std::vector<Edit> edits;
+	while (!stopping)
+	{
+		int bytes = (int)recv((NativeSocket)socket, (char*)datagram.get(), (int)DATAGRAM_BYTES, 0);
+		if (bytes <= 0)
+			continue;
+		size_t at = 0;
+		uint32_t magic, peer, number;
+		uint16_t previousBytes;
+		if (!get(datagram.get(), (size_t)bytes, at, magic) || !get(datagram.get(), (size_t)bytes, at, peer) || !get(datagram.get(), (size_t)bytes, at, number)
+			|| !get(datagram.get(), (size_t)bytes, at, previousBytes) || magic != MAGIC || peer == self || at + previousBytes > (size_t)bytes)
+			continue;
+		// Sequence numbers wrap around, a datagram that is not ahead of the last one taken was already applied
+		edits.clear();
+		auto last = lastSequence.find(peer);
+		int32_t ahead = last == lastSequence.end() ? 1 : (int32_t)(number - last->second);
+		if (ahead <= 0)
+			continue;
+		bool whole = true;
+		if (ahead >= 2)
+			whole = Decode(datagram.get() + at, previousBytes, edits);
+		if (ahead > 2)
+			lostCount.fetch_add((uint64_t)(ahead - 2), std::memory_order_relaxed);
+		whole = whole && Decode(datagram.get() + at + previousBytes, (size_t)bytes - at - previousBytes, edits);
+		if (!whole)
+			continue;
+		lastSequence[peer] = number;
+		if (edits.empty())
+			continue;
+		receivedCount.fetch_add(edits.size(), std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(inboxMutex);
+		inbox.insert(inbox.end(), edits.begin(), edits.end());
+		inboxPending.store(true, std::memory_order_release);
+	}
+}
@@ -0,0 +1,116 @@
+#ifndef SCENE_SYNC_CLASS_H
+#define SCENE_SYNC_CLASS_H
+
+#include<glm/glm.hpp>
+#include<atomic>
+#include<cstddef>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<unordered_map>
+#include<vector>
+
+// Keeps the buildings of one city in step between the machines of a collaborative session, where several planners
+// edit the same city. An edit adds, removes or changes one building and goes over the wire as a compact delta: an
+// operation byte whose upper bits flag the fields that follow, the building's index, then only those fields. The edits
+// of a frame are batched into UDP datagrams sent to every peer at once, and each datagram repeats the batch before it,
+// so a single lost datagram costs nothing. Edits carry absolute values, so one applied twice does no harm. A thread
+// of the sync's own decodes what arrives and the simulation thread drains it before culling, applying the edits to
+// the scene storage and the quadtree and handing them to the render thread, which only uploads the edited records.
+// The city keeps its building count: removing a building empties its slot and adding one fills a slot again, so the
+// indices of the buildings stay the same on every machine.
+class SceneSync
+{
+public:
+	// What an edit does to its building
+	enum Operation : uint8_t
+	{
+		CHANGE = 0,
+		REMOVE = 1,
+		ADD = 2
+	};
+	// Fields an edit carries, flagged in the upper bits of its operation byte, an add carries all of them
+	enum Field : uint8_t
+	{
+		MIN = 1 << 2,
+		MAX = 1 << 3,
+		FACADE = 1 << 4,
+		ALL_FIELDS = MIN | MAX | FACADE
+	};
+	// One edit of one building, box corners in the city's model space
+	struct Edit
+	{
+		Operation operation = CHANGE;
+		uint8_t fields = 0;
+		uint32_t building = 0;
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		uint32_t facade = 0;
+	};
+	// Largest datagram sent, below the usual path MTU so a batch is never fragmented, and the largest encoded edit
+	static constexpr size_t DATAGRAM_BYTES = 1200;
+	static constexpr size_t MAX_EDIT_BYTES = 1 + 4 + 2 * 12 + 2;
+
+	// Constructor that binds the port on every interface, resolves the peers given as "host:port" and starts the
+	// thread, isOpen tells if that worked
+	SceneSync(unsigned short port, const std::vector<std::string>& peers);
+	// Stops the thread unless Delete was already called
+	~SceneSync();
+	// The thread points back at the sync, so it can be neither copied nor moved
+	SceneSync(const SceneSync&) = delete;
+	SceneSync& operator=(const SceneSync&) = delete;
+
+	// Whether the socket could be bound
+	bool isOpen() const;
+	// Simulation thread: queues an edit made on this machine for the next Flush
+	void Send(const Edit& edit);
+	// Simulation thread: sends the edits queued since the last Flush to every peer, in as few datagrams as hold them
+	void Flush();
+	// Simulation thread: replaces the contents of out with the edits received since the last Drain, oldest first
+	void Drain(std::vector<Edit>& out);
+	// Edits may be waiting to be drained, may be asked from any thread
+	bool pending() const;
+
+	// Edits sent and received so far, and datagrams of peers that were lost together with the one repeating them
+	uint64_t sent() const;
+	uint64_t received() const;
+	uint64_t lost() const;
+
+	// Stops the thread and closes the socket, does nothing if that was already done
+	void Delete();
+
+	// Appends an edit to a batch, with only the fields it flags
+	static void Encode(const Edit& edit, std::vector<uint8_t>& batch);
+	// Decodes the edits of a batch into out, false if the batch is cut short
+	static bool Decode(const uint8_t* batch, size_t size, std::vector<Edit>& out);
+private:
+	// Addresses of the peers as sockaddr_in, kept as bytes so the header needs no socket headers
+	std::vector<std::vector<uint8_t>> peerAddresses;
+	// Random name of this machine, so its own datagrams are known when they come back
+	uint32_t self = 0;
+	// Sequence number of the next datagram and the batch of the last one, which the next one repeats
+	uint32_t sequence = 0;
+	std::vector<uint8_t> previousBatch;
+	std::vector<Edit> outbox;
+
+	std::mutex inboxMutex;
+	std::vector<Edit> inbox;
+	std::atomic<bool> inboxPending{ false };
+	// Sequence of the last datagram taken from every peer, written by the thread only
+	std::unordered_map<uint32_t, uint32_t> lastSequence;
+	std::atomic<uint64_t> sentCount{ 0 };
+	std::atomic<uint64_t> receivedCount{ 0 };
+	std::atomic<uint64_t> lostCount{ 0 };
+	std::atomic<bool> stopping{ false };
+	// Native socket handle, invalid when it could not be opened
+	intptr_t socket;
+	std::thread thread;
+
+	// Sends one batch to every peer, with the batch sent before it
+	void sendBatch(const std::vector<uint8_t>& batch);
+	// Loop of the thread, wakes up a few times a second to see if it has to stop
+	void receive();
+};
+
+#endif
@@ -0,0 +1,311 @@
+#include"ScreenSpaceOcclusion.h"
+#include"TemporalCache.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+#include<iostream>
+
+// Full screen triangle, every half resolution pixel is worked out once
+static const char* fullScreenVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+// Writes the share of the hemisphere above the normal the depth buffer leaves open, and the view depth the blur and
+// the upsample weigh their taps by
+static const char* occlusionFragmentSource = R"(
+#version 330 core
+uniform sampler2D gNormal;
+uniform sampler2D gDepth;
+uniform mat4 projection;
+uniform mat4 inverseProjection;
+// 1 when the scene was drawn reverse-Z, its depth is then already the clip space depth
+uniform int reverseZ;
+uniform float radius;
+uniform float intensity;
+// Half resolution pixels a fragment steps over and the one it starts at, 2 and the phase of a TemporalCache when only
+// a quarter of them are worked out
+uniform int pixelStep;
+uniform ivec2 pixelOffset;
+// Turns the points further every frame, so the history averages different ones
+uniform float rotation;
+
+out vec2 Occlusion;
+
+const int SAMPLES = 12;
+
+vec3 viewPosition(vec2 uv)
+{
+    float depth = texture(gDepth, uv).r;
+    vec4 view = inverseProjection * vec4(uv * 2.0 - 1.0, reverseZ != 0 ? depth : depth * 2.0 - 1.0, 1.0);
+    return view.xyz / view.w;
+}
+
+void main()
+{
+    // The top left of the four full resolution pixels stands for them
+    ivec2 halfPixel = ivec2(gl_FragCoord.xy) * pixelStep + pixelOffset;
+    ivec2 pixel = halfPixel * 2;
+    vec2 uv = (vec2(pixel) + 0.5) / vec2(textureSize(gDepth, 0));
+    vec3 position = viewPosition(uv);
+    vec4 normal = texelFetch(gNormal, pixel, 0);
+    if (normal.w == 0.0)
+    {
+        Occlusion = vec2(1.0, position.z);
+        return;
+    }
+
+    // The same set of points turned by a different angle per pixel, which the blur averages out
+    float angle = rotation + 6.2831853 * fract(52.9829189 * fract(dot(vec2(halfPixel) + 0.5, vec2(0.06711056, 0.00583715))));
+    vec3 n = normalize(normal.xyz);
+    vec3 turn = abs(n.z) < 0.999 ? vec3(cos(angle), sin(angle), 0.0) : vec3(cos(angle), 0.0, sin(angle));
+    vec3 tangent = normalize(turn - n * dot(turn, n));
+    vec3 bitangent = cross(n, tangent);
+
+    float hidden = 0.0;
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        // Cosine weighted over the hemisphere by a Fibonacci spiral, the points crowd towards the pixel
+        float h = (float(i) + 0.5) / float(SAMPLES);
+        float a = float(i) * 2.39996323;
+        vec3 direction = vec3(sqrt(h) * cos(a), sqrt(h) * sin(a), sqrt(1.0 - h));
+        float reach = mix(0.1, 1.0, h * h);
+        vec3 point = position + (tangent * direction.x + bitangent * direction.y + n * direction.z) * radius * reach;
+        vec4 clip = projection * vec4(point, 1.0);
+        float sceneZ = viewPosition(clamp(clip.xy / clip.w * 0.5 + 0.5, 0.0, 1.0)).z;
+        // Surfaces far in front of the point are not its neighbours, they fade out instead of haloing
+        float range = smoothstep(0.0, 1.0, radius / max(abs(position.z - sceneZ), 1e-4));
+        hidden += (sceneZ >= point.z + 0.02 * radius ? 1.0 : 0.0) * range;
+    }
+    Occlusion = vec2(pow(1.0 - hidden / float(SAMPLES), intensity), position.z);
+}
+)";
+// One direction of the separable blur, a 9 tap Gaussian whose taps fade out with the difference of their depth
+static const char* blurFragmentSource = R"(
+#version 330 core
+uniform sampler2D occlusion;
+uniform ivec2 direction;
+// Size of the occlusion, its texture may be larger while the window is being resized
+uniform ivec2 size;
+
+out vec2 Occlusion;
+
+const float WEIGHTS[5] = float[](0.227027, 0.1945946, 0.1216216, 0.054054, 0.016216);
+// How fast a tap fades with its depth difference relative to the center's depth
+const float DEPTH_FALLOFF = 40.0;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 last = size - 1;
+    vec2 center = texelFetch(occlusion, pixel, 0).rg;
+    float sum = center.r * WEIGHTS[0];
+    float total = WEIGHTS[0];
+    for (int i = 1; i < 5; i++)
+    {
+        for (int side = -1; side <= 1; side += 2)
+        {
+            vec2 tap = texelFetch(occlusion, clamp(pixel + direction * i * side, ivec2(0), last), 0).rg;
+            float weight = WEIGHTS[i] * exp(-abs(tap.g - center.g) * DEPTH_FALLOFF / max(abs(center.g), 1e-3));
+            sum += tap.r * weight;
+            total += weight;
+        }
+    }
+    Occlusion = vec2(sum / total, center.g);
+}
+)";
+
+// Constructor that builds the programs
+ScreenSpaceOcclusion::ScreenSpaceOcclusion()
+{
+	occlusionProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, fullScreenVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, occlusionFragmentSource, "FRAGMENT") });
+	blurProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, fullScreenVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, blurFragmentSource, "FRAGMENT") });
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(occlusionProgram);
+	glUniform1i(glGetUniformLocation(occlusionProgram, "gNormal"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(occlusionProgram, "gDepth"), TEXTURE_UNIT + 1);
+	GLState.UseProgram(blurProgram);
+	glUniform1i(glGetUniformLocation(blurProgram, "occlusion"), TEXTURE_UNIT);
+	GLState.UseProgram(previousProgram);
+
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+ScreenSpaceOcclusion::~ScreenSpaceOcclusion()
+{
+	Delete();
+}
+
+GLsizei ScreenSpaceOcclusion::HalfSize(GLsizei size)
+{
+	return (size + 1) / 2;
+}
+
+// Draws into the targets of its own, reallocated when the size changed
+void ScreenSpaceOcclusion::Compute(const DeferredRenderer& gbuffer, GLsizei width, GLsizei height, const glm::mat4& projection, TemporalCache* history)
+{
+	GLsizei halfWidth = HalfSize(width), halfHeight = HalfSize(height);
+	if (halfWidth != ScreenSpaceOcclusion::width || halfHeight != ScreenSpaceOcclusion::height || framebuffers[0] == 0)
+		resize(halfWidth, halfHeight);
+	Compute(gbuffer, projection, targets, framebuffers, halfWidth, halfHeight, history);
+}
+
+// Works out the occlusion at half resolution, or a quarter of it merged into the history, and blurs it across, then down
+void ScreenSpaceOcclusion::Compute(const DeferredRenderer& gbuffer, const glm::mat4& projection, const GLuint (&textures)[2], const GLuint (&textureFramebuffers)[2], GLsizei halfWidth, GLsizei halfHeight, TemporalCache* history)
+{
+	GLint previousFramebuffer, previousProgram, previousVAO;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+	GLState.Disable(GL_DEPTH_TEST);
+	GLState.BindVertexArray(emptyVAO);
+	GLState.UseProgram(occlusionProgram);
+	if (history)
+	{
+		glm::ivec2 phase = history->Phase();
+		glViewport(0, 0, TemporalCache::SparseSize(halfWidth), TemporalCache::SparseSize(halfHeight));
+		glBindFramebuffer(GL_FRAMEBUFFER, history->SparseFramebuffer());
+		glUniform1i(glGetUniformLocation(occlusionProgram, "pixelStep"), 2);
+		glUniform2i(glGetUniformLocation(occlusionProgram, "pixelOffset"), phase.x, phase.y);
+		// The golden angle keeps the turns of consecutive frames far apart
+		glUniform1f(glGetUniformLocation(occlusionProgram, "rotation"), 2.39996323f * (float)(history->Frame() % 64));
+	}
+	else
+	{
+		glViewport(0, 0, halfWidth, halfHeight);
+		glBindFramebuffer(GL_FRAMEBUFFER, textureFramebuffers[0]);
+		glUniform1i(glGetUniformLocation(occlusionProgram, "pixelStep"), 1);
+		glUniform2i(glGetUniformLocation(occlusionProgram, "pixelOffset"), 0, 0);
+		glUniform1f(glGetUniformLocation(occlusionProgram, "rotation"), 0.0f);
+	}
+	GLState.CountUniforms(3);
+	glUniformMatrix4fv(glGetUniformLocation(occlusionProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	glUniformMatrix4fv(glGetUniformLocation(occlusionProgram, "inverseProjection"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+	glUniform1i(glGetUniformLocation(occlusionProgram, "reverseZ"), reverseDepth ? 1 : 0);
+	glUniform1f(glGetUniformLocation(occlusionProgram, "radius"), radius);
+	glUniform1f(glGetUniformLocation(occlusionProgram, "intensity"), intensity);
+	GLState.CountUniforms(5);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, gbuffer.normal);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + 1);
+	GLState.BindTexture(GL_TEXTURE_2D, gbuffer.depth);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	// The blur starts from the history instead, which is kept unblurred so the noise keeps averaging out
+	GLuint unblurred = textures[0];
+	if (history)
+	{
+		unblurred = history->Resolve(gbuffer.depth, 2);
+		glViewport(0, 0, halfWidth, halfHeight);
+	}
+
+	GLState.UseProgram(blurProgram);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLint directionLoc = glGetUniformLocation(blurProgram, "direction");
+	glUniform2i(glGetUniformLocation(blurProgram, "size"), halfWidth, halfHeight);
+	GLState.CountUniforms(1);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, textureFramebuffers[1 - pass]);
+		GLState.BindTexture(GL_TEXTURE_2D, pass == 0 ? unblurred : textures[1]);
+		glUniform2i(directionLoc, 1 - pass, pass);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		GLState.CountDraw(1, 1);
+		GLState.CountUniforms(1);
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	result = textures[0];
+	resultWidth = halfWidth;
+	resultHeight = halfHeight;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+}
+
+// Binds the blurred occlusion for a program
+void ScreenSpaceOcclusion::Apply(GLuint program)
+{
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, result);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, "occlusion"), (GLint)TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "occluded"), 1);
+	glUniform2i(glGetUniformLocation(program, "occlusionSize"), resultWidth, resultHeight);
+	GLState.CountUniforms(3);
+}
+
+// Reallocates the targets for a new half resolution size
+void ScreenSpaceOcclusion::resize(GLsizei width, GLsizei height)
+{
+	deleteTargets();
+	ScreenSpaceOcclusion::width = width;
+	ScreenSpaceOcclusion::height = height;
+
+	// Texels are only ever fetched, never filtered, the depth needs the range of a float
+	glGenTextures(2, targets);
+	glGenFramebuffers(2, framebuffers);
+	for (int i = 0; i < 2; i++)
+	{
+		GLState.BindTexture(GL_TEXTURE_2D, targets[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, FORMAT, width, height, 0, GL_RG, GL_FLOAT, nullptr);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, targets[i], GpuMemoryTracker::ImageBytes(FORMAT, width, height));
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets[i], 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			std::cerr << "ERROR::SSAO::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Deletes the targets and their framebuffers
+void ScreenSpaceOcclusion::deleteTargets()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if (targets[i] != 0)
+			GLState.DeleteTextures(1, &targets[i]);
+		if (framebuffers[i] != 0)
+			glDeleteFramebuffers(1, &framebuffers[i]);
+		targets[i] = framebuffers[i] = 0;
+	}
+	width = height = 0;
+	result = 0;
+}
+
+// Deletes the GL objects
+void ScreenSpaceOcclusion::Delete()
+{
+	deleteTargets();
+	if (occlusionProgram != 0)
+		GLState.DeleteProgram(occlusionProgram);
+	if (blurProgram != 0)
+		GLState.DeleteProgram(blurProgram);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	occlusionProgram = blurProgram = emptyVAO = 0;
+}
@@ -0,0 +1,79 @@
+#ifndef SCREEN_SPACE_OCCLUSION_CLASS_H
+#define SCREEN_SPACE_OCCLUSION_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+#include"DeferredRenderer.h"
+
+class TemporalCache;
+
+// Screen space ambient occlusion for what AmbientOcclusion cannot bake, worked out from the depth and normals of
+// DeferredRenderer's G-buffer at half its resolution. Every half resolution pixel tests a fixed set of points in the
+// hemisphere above its normal against the depth buffer, turned by a per pixel angle, and the noise that leaves is
+// blurred away by two separable passes that weigh their taps by how close their depth is, so edges stay sharp.
+// Resolve then upsamples it with the same depth weights and darkens the ambient light by it.
+// Given a TemporalCache of FORMAT, only a quarter of the half resolution pixels are worked out every frame, each with
+// the points turned a different way, and the blur starts from the history they are merged into.
+class ScreenSpaceOcclusion
+{
+public:
+	// The G-buffer is bound to this texture unit and the one after it while the occlusion is worked out, the result
+	// to this one while it is resolved, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 12;
+
+	// Set when the scene is drawn reverse-Z, see ReverseDepth.h
+	bool reverseDepth = false;
+	// View space distance the points are spread over
+	float radius = 0.5f;
+	// Exponent applied to the share of the sky left, above 1 darkens the creases more
+	float intensity = 1.5f;
+
+	// Constructor that builds the programs, the targets are made by the first Compute
+	ScreenSpaceOcclusion();
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~ScreenSpaceOcclusion();
+	// A ScreenSpaceOcclusion owns its GL objects, so it cannot be copied
+	ScreenSpaceOcclusion(const ScreenSpaceOcclusion&) = delete;
+	ScreenSpaceOcclusion& operator=(const ScreenSpaceOcclusion&) = delete;
+
+	// Internal format of the two targets, occlusion and view depth
+	static constexpr GLenum FORMAT = GL_RG16F;
+	// Size of the targets for a G-buffer side of size
+	static GLsizei HalfSize(GLsizei size);
+
+	// Works out and blurs the occlusion of the G-buffer of gbuffer, width by height, drawn with projection
+	// With a history, which has to be begun for the half resolution size this frame, only its phase is worked out
+	// The framebuffer, viewport, program, VAO and depth test in use are restored afterwards
+	void Compute(const DeferredRenderer& gbuffer, GLsizei width, GLsizei height, const glm::mat4& projection, TemporalCache* history = nullptr);
+	// Same into two targets of FORMAT and HalfSize the caller owns, such as transient textures of a RenderGraph,
+	// textureFramebuffers has one with each texture as its color. The result ends up in the first, which Apply binds
+	void Compute(const DeferredRenderer& gbuffer, const glm::mat4& projection, const GLuint (&textures)[2], const GLuint (&textureFramebuffers)[2], GLsizei halfWidth, GLsizei halfHeight,
+		TemporalCache* history = nullptr);
+	// Binds the result for program's occlusion sampler, sets its occlusionSize and turns its occluded uniform on,
+	// program has to be in use
+	void Apply(GLuint program);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	// Occlusion and view depth at half resolution, the blur goes from the first to the second and back
+	GLuint targets[2] = {};
+	GLuint framebuffers[2] = {};
+	GLsizei width = 0;
+	GLsizei height = 0;
+	// Texture holding the last result, one of targets or the caller's, and the size of the result in it
+	GLuint result = 0;
+	GLsizei resultWidth = 0;
+	GLsizei resultHeight = 0;
+	GLuint occlusionProgram = 0;
+	GLuint blurProgram = 0;
+	GLuint emptyVAO = 0;
+
+	// Reallocates the targets for a new half resolution size
+	void resize(GLsizei width, GLsizei height);
+	// Deletes the targets and their framebuffers
+	void deleteTargets();
+};
+
+#endif
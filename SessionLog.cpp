@@ -0,0 +1,229 @@
+#include"SessionLog.h"
+
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<iterator>
+
+// Bytes in front of a frame record's steps: the tag, the time, the four sizes and the step count
+static const size_t FRAME_HEADER = 1 + sizeof(double) + 4 * sizeof(int32_t) + sizeof(uint32_t);
+
+// Appends a value as its bytes, little endian on every platform the engine runs on
+template<typename T>
+static void put(std::vector<unsigned char>& out, const T& value)
+{
+	const unsigned char* bytes = (const unsigned char*)&value;
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+// Reads a value at a cursor, false once the data runs out
+template<typename T>
+static bool get(const std::vector<char>& data, size_t& at, T& value)
+{
+	if (at + sizeof(T) > data.size())
+		return false;
+	std::memcpy(&value, data.data() + at, sizeof(T));
+	at += sizeof(T);
+	return true;
+}
+
+template<size_t N>
+void SessionLog::putBits(std::vector<unsigned char>& out, const std::bitset<N>& bits)
+{
+	put(out, (uint16_t)bits.count());
+	for (size_t i = 0; i < N; i++)
+		if (bits[i])
+			put(out, (uint16_t)i);
+}
+
+// Reads what putBits wrote, indices out of range make the log broken
+template<size_t N>
+static bool getBits(const std::vector<char>& data, size_t& at, std::bitset<N>& bits)
+{
+	uint16_t count;
+	if (!get(data, at, count))
+		return false;
+	for (uint16_t i = 0; i < count; i++)
+	{
+		uint16_t index;
+		if (!get(data, at, index) || index >= N)
+			return false;
+		bits[index] = true;
+	}
+	return true;
+}
+
+bool SessionLog::Record(const std::string& path, double step)
+{
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+	stepLength = step;
+	std::vector<unsigned char> header;
+	put(header, MAGIC);
+	put(header, VERSION);
+	put(header, step);
+	write(header);
+	return true;
+}
+
+bool SessionLog::Load(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+	{
+		std::cerr << "Could not open the session log " << path << std::endl;
+		return false;
+	}
+	std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	size_t at = 0;
+	uint32_t magic = 0, version = 0;
+	if (!get(data, at, magic) || !get(data, at, version) || !get(data, at, stepLength) || magic != MAGIC || version != VERSION)
+	{
+		std::cerr << path << " is not a session log of version " << VERSION << std::endl;
+		return false;
+	}
+
+	// Updates can come for a frame the file has no record of yet, they are sorted into their frames at the end
+	struct Run
+	{
+		uint32_t frame;
+		size_t first;
+		size_t count;
+	};
+	std::vector<Run> runs;
+	std::vector<LiveDataReceiver::Update> updates;
+	bool broken = false;
+	while (at < data.size() && !broken)
+	{
+		uint8_t tag = (uint8_t)data[at++];
+		if (tag == TAG_FRAME)
+		{
+			Frame frame;
+			int32_t sizes[4];
+			uint32_t steps;
+			broken = !get(data, at, frame.time) || !get(data, at, sizes) || !get(data, at, steps);
+			frame.framebufferWidth = sizes[0];
+			frame.framebufferHeight = sizes[1];
+			frame.windowWidth = sizes[2];
+			frame.windowHeight = sizes[3];
+			frame.firstStep = snapshots.size();
+			frame.stepCount = steps;
+			for (uint32_t s = 0; s < steps && !broken; s++)
+			{
+				Input::Snapshot snapshot;
+				uint8_t buttons, clicked;
+				broken = !getBits(data, at, snapshot.keys) || !getBits(data, at, snapshot.pressed) || !get(data, at, buttons)
+					|| !get(data, at, clicked) || !get(data, at, snapshot.cursor) || !get(data, at, snapshot.mouseDelta);
+				snapshot.buttons = std::bitset<Input::BUTTON_COUNT>(buttons);
+				snapshot.clicked = std::bitset<Input::BUTTON_COUNT>(clicked);
+				snapshots.push_back(snapshot);
+			}
+			if (!broken)
+				frames.push_back(frame);
+		}
+		else if (tag == TAG_UPDATES)
+		{
+			Run run;
+			uint32_t count;
+			broken = !get(data, at, run.frame) || !get(data, at, count) || at + (size_t)count * sizeof(LiveDataReceiver::Update) > data.size();
+			if (broken)
+				break;
+			run.first = updates.size();
+			run.count = count;
+			updates.resize(updates.size() + count);
+			std::memcpy(updates.data() + run.first, data.data() + at, count * sizeof(LiveDataReceiver::Update));
+			at += count * sizeof(LiveDataReceiver::Update);
+			runs.push_back(run);
+		}
+		else
+			broken = true;
+	}
+	// A session cut short, such as by a crash, still plays up to its last whole frame
+	if (broken)
+		std::cerr << path << " ends in a broken record, playing the " << frames.size() << " frames before it" << std::endl;
+
+	// In the order they were drained, the render thread drains each frame once
+	std::stable_sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) { return a.frame < b.frame; });
+	size_t r = 0;
+	for (size_t f = 0; f < frames.size(); f++)
+	{
+		frames[f].firstUpdate = liveUpdates.size();
+		for (; r < runs.size() && runs[r].frame <= f; r++)
+			if (runs[r].frame == f)
+				liveUpdates.insert(liveUpdates.end(), updates.begin() + runs[r].first, updates.begin() + runs[r].first + runs[r].count);
+		frames[f].updateCount = liveUpdates.size() - frames[f].firstUpdate;
+	}
+	if (frames.empty())
+		std::cerr << path << " holds no frames" << std::endl;
+	return !frames.empty();
+}
+
+// The step goes behind the room left for the frame's header
+void SessionLog::RecordStep(const Input::Snapshot& snapshot)
+{
+	if (!file.is_open())
+		return;
+	if (frameRecord.empty())
+		frameRecord.resize(FRAME_HEADER);
+	putBits(frameRecord, snapshot.keys);
+	putBits(frameRecord, snapshot.pressed);
+	put(frameRecord, (uint8_t)snapshot.buttons.to_ulong());
+	put(frameRecord, (uint8_t)snapshot.clicked.to_ulong());
+	put(frameRecord, snapshot.cursor);
+	put(frameRecord, snapshot.mouseDelta);
+	pendingSteps++;
+}
+
+void SessionLog::RecordFrame(double time, int framebufferWidth, int framebufferHeight, int windowWidth, int windowHeight)
+{
+	if (!file.is_open())
+		return;
+	if (frameRecord.empty())
+		frameRecord.resize(FRAME_HEADER);
+	const int32_t sizes[4] = { framebufferWidth, framebufferHeight, windowWidth, windowHeight };
+	unsigned char* header = frameRecord.data();
+	header[0] = TAG_FRAME;
+	std::memcpy(header + 1, &time, sizeof(time));
+	std::memcpy(header + 1 + sizeof(time), sizes, sizeof(sizes));
+	std::memcpy(header + 1 + sizeof(time) + sizeof(sizes), &pendingSteps, sizeof(pendingSteps));
+	write(frameRecord);
+	// Keeps the capacity, recording allocates nothing once the longest frame came by
+	frameRecord.clear();
+	pendingSteps = 0;
+}
+
+void SessionLog::RecordUpdates(int frameIndex, const LiveDataReceiver::Update* updates, size_t count)
+{
+	if (!file.is_open() || count == 0)
+		return;
+	updateRecord.clear();
+	put(updateRecord, (uint8_t)TAG_UPDATES);
+	put(updateRecord, (uint32_t)frameIndex);
+	put(updateRecord, (uint32_t)count);
+	const unsigned char* bytes = (const unsigned char*)updates;
+	updateRecord.insert(updateRecord.end(), bytes, bytes + count * sizeof(LiveDataReceiver::Update));
+	write(updateRecord);
+}
+
+const LiveDataReceiver::Update* SessionLog::updates(size_t frameIndex, size_t& count) const
+{
+	count = 0;
+	if (frameIndex >= frames.size() || frames[frameIndex].updateCount == 0)
+		return nullptr;
+	count = frames[frameIndex].updateCount;
+	return liveUpdates.data() + frames[frameIndex].firstUpdate;
+}
+
+void SessionLog::Close()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (file.is_open())
+		file.close();
+}
+
+void SessionLog::write(const std::vector<unsigned char>& record)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	file.write((const char*)record.data(), (std::streamsize)record.size());
+}
@@ -0,0 +1,101 @@
+#ifndef SESSION_LOG_CLASS_H
+#define SESSION_LOG_CLASS_H
+
+#include<cstddef>
+#include<cstdint>
+#include<fstream>
+#include<mutex>
+#include<string>
+#include<vector>
+
+#include"Input.h"
+#include"LiveDataReceiver.h"
+
+// Records what drives a session into a compact binary file and plays it back, so two builds can render the very
+// same frames and be compared frame for frame. A frame keeps the clock's time after it advanced, which a fresh
+// SimulationClock advanced to reproduces the same steps and blend, every step's input snapshot, and the framebuffer
+// and window size. The live data updates the render thread drained for a frame are kept with its index. Frames come
+// from the simulation thread and updates from the render thread, each side builds its record in a buffer of its own
+// and only the write to the file is under a lock.
+// The file starts with MAGIC, VERSION and the step length, then records of a tag byte and little endian fields.
+class SessionLog
+{
+public:
+	static constexpr uint32_t MAGIC = 0x474F4C53;
+	static constexpr uint32_t VERSION = 1;
+
+	// One frame of the session, its steps and live updates are the counts starting at the firsts
+	struct Frame
+	{
+		double time = 0.0;
+		int framebufferWidth = 0;
+		int framebufferHeight = 0;
+		int windowWidth = 0;
+		int windowHeight = 0;
+		size_t firstStep = 0;
+		size_t stepCount = 0;
+		size_t firstUpdate = 0;
+		size_t updateCount = 0;
+	};
+
+	SessionLog() = default;
+	// A log owns its file, so it cannot be copied
+	SessionLog(const SessionLog&) = delete;
+	SessionLog& operator=(const SessionLog&) = delete;
+
+	// Starts writing a new file for a clock of step seconds, false if it cannot be created
+	bool Record(const std::string& path, double step);
+	// Reads a whole file for playback, false with a message if it cannot be read or is not a log of this version
+	bool Load(const std::string& path);
+	// Whether Record or Load succeeded
+	bool recording() const { return file.is_open(); }
+	bool replaying() const { return !frames.empty(); }
+
+	// Simulation thread: adds the snapshot of one step to the frame being recorded
+	void RecordStep(const Input::Snapshot& snapshot);
+	// Simulation thread: writes the frame with the steps added since the last one
+	void RecordFrame(double time, int framebufferWidth, int framebufferHeight, int windowWidth, int windowHeight);
+	// Render thread: writes the live updates drained while rendering a frame
+	void RecordUpdates(int frameIndex, const LiveDataReceiver::Update* updates, size_t count);
+
+	// Step length of the recorded clock
+	double step() const { return stepLength; }
+	// Frames read by Load and one of them
+	size_t frameCount() const { return frames.size(); }
+	const Frame& frame(size_t index) const { return frames[index]; }
+	// Snapshot of a step, numbered through the whole session
+	const Input::Snapshot& snapshot(size_t step) const { return snapshots[step]; }
+	// Live updates of a frame, nullptr with a count of 0 past the end of the log
+	const LiveDataReceiver::Update* updates(size_t frameIndex, size_t& count) const;
+
+	// Flushes and closes the file being recorded
+	void Close();
+private:
+	// Record tags
+	enum Tag : uint8_t
+	{
+		TAG_FRAME = 1,
+		TAG_UPDATES = 2
+	};
+
+	std::ofstream file;
+	std::mutex mutex;
+	double stepLength = 0.0;
+	// Record being built on the simulation thread with its step count, and the one of the render thread
+	std::vector<unsigned char> frameRecord;
+	uint32_t pendingSteps = 0;
+	std::vector<unsigned char> updateRecord;
+
+	// What Load read
+	std::vector<Frame> frames;
+	std::vector<Input::Snapshot> snapshots;
+	std::vector<LiveDataReceiver::Update> liveUpdates;
+
+	// Appends the bits set in a bitset as a count and the indices
+	template<size_t N>
+	static void putBits(std::vector<unsigned char>& out, const std::bitset<N>& bits);
+	// Writes a finished record under the lock
+	void write(const std::vector<unsigned char>& record);
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include"ShaderPipelines.h"
+#include"shaderClass.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GLDebugOutput.h"
+#include"LogQueue.h"
+
+#include<filesystem>
+
+// Deletes the stages and pipelines unless Delete was already called
+ShaderPipelines::~ShaderPipelines()
+{
+	Delete();
+}
+
+// Pipeline of a vertex and a fragment file for a feature mask
+GLuint ShaderPipelines::Get(const char* vertexFile, const char* fragmentFile, unsigned int features)
+{
+	GLuint vertex = Stage(GL_VERTEX_SHADER, vertexFile, features);
+	GLuint fragment = Stage(GL_FRAGMENT_SHADER, fragmentFile, features);
+	if (vertex == 0 || fragment == 0)
+		return 0;
+	GLuint& pipeline = pipelines[{ vertex, fragment }];
+	if (pipeline == 0)
+	{
+		glGenProgramPipelines(1, &pipeline);
+		glUseProgramStages(pipeline, GL_VERTEX_SHADER_BIT, vertex);
+		glUseProgramStages(pipeline, GL_FRAGMENT_SHADER_BIT, fragment);
+	}
+	return pipeline;
+}
+
+// Separable program of one stage
+GLuint ShaderPipelines::Stage(GLenum stage, const char* file, unsigned int features)
+{
+	StageKey key(stage, file, features);
+	auto it = stages.find(key);
+	if (it == stages.end())
+		it = stages.emplace(key, build(stage, file, features)).first;
+	return it->second;
+}
+
+// Binds a pipeline
+void ShaderPipelines::Bind(GLuint pipeline)
+{
+	GLState.BindProgramPipeline(pipeline);
+}
+
+// Number of stages built
+size_t ShaderPipelines::stageCount() const
+{
+	return stages.size();
+}
+
+// Number of pipelines combined
+size_t ShaderPipelines::pipelineCount() const
+{
+	return pipelines.size();
+}
+
+// Deletes every stage and pipeline
+void ShaderPipelines::Delete()
+{
+	for (auto& pipeline : pipelines)
+		GLState.DeleteProgramPipelines(1, &pipeline.second);
+	pipelines.clear();
+	for (auto& stage : stages)
+		if (stage.second != 0)
+			GLState.DeleteProgram(stage.second);
+	stages.clear();
+}
+
+// Compiles and links the separable program of one stage
+GLuint ShaderPipelines::build(GLenum stage, const std::string& file, unsigned int features)
+{
+	std::string source;
+	try
+	{
+		std::string directory = std::filesystem::path(file).parent_path().string();
+		source = Shader::Specialize(Shader::Preprocess(get_shader_contents(file.c_str()), directory.empty() ? "." : directory), features);
+	}
+	catch (int)
+	{
+		LOG_MESSAGE(LOG_ERROR, "Failed to read %s", file.c_str());
+		return 0;
+	}
+	const char* code = source.c_str();
+	GLuint program = glCreateShaderProgramv(stage, 1, &code);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(program, sizeof(infoLog), nullptr, infoLog);
+		LOG_MESSAGE(LOG_ERROR, "SHADER_STAGE_ERROR for:%s\n%s", file.c_str(), infoLog);
+		GLState.DeleteProgram(program);
+		return 0;
+	}
+	GLDebug.Label(GL_PROGRAM, program, file.c_str());
+	// Per frame values come from the shared uniform buffer, in whichever stage declares them
+	GLuint block = glGetUniformBlockIndex(program, "FrameData");
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(program, block, FrameData::BINDING);
+	return program;
+}
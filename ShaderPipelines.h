@@ -0,0 +1,46 @@
+#ifndef SHADER_PIPELINES_CLASS_H
+#define SHADER_PIPELINES_CLASS_H
+
+#include<glad/glad.h>
+#include<map>
+#include<string>
+#include<tuple>
+#include<utility>
+
+// Vertex and fragment stages built once each as separable programs and combined in program pipelines, so a vertex
+// shader shared by several fragment shaders, or by several permutations of them, is compiled and linked only once
+// instead of once for every pair it is linked into. Sources are read, included and specialized like Shader's.
+// Uniforms belong to the stage that declares them and are set through its program with glProgramUniform, nothing has
+// to be active for that. Stages only match by name, so both have to declare what they pass in the same way.
+// Needs GLExt.separateShaderObjects.
+class ShaderPipelines
+{
+public:
+	// Deletes the stages and pipelines unless Delete was already called, the context has to still be current
+	~ShaderPipelines();
+
+	// Pipeline of a vertex and a fragment file specialized for a feature mask, 0 if a stage does not build
+	// Each stage and the pipeline combining them are built the first time they are asked for
+	GLuint Get(const char* vertexFile, const char* fragmentFile, unsigned int features);
+	// Separable program of one stage, built the first time it is asked for, to set the uniforms it declares
+	GLuint Stage(GLenum stage, const char* file, unsigned int features);
+	// Binds a pipeline through GLState, no program is active afterwards
+	static void Bind(GLuint pipeline);
+
+	// Number of stages built and of pipelines combined from them
+	size_t stageCount() const;
+	size_t pipelineCount() const;
+	// Deletes every stage and pipeline, does nothing if they were already deleted
+	void Delete();
+private:
+	// Stage, file and feature mask
+	typedef std::tuple<GLenum, std::string, unsigned int> StageKey;
+
+	std::map<StageKey, GLuint> stages;
+	std::map<std::pair<GLuint, GLuint>, GLuint> pipelines;
+
+	// Compiles and links the separable program of one stage, 0 on errors, which are printed
+	static GLuint build(GLenum stage, const std::string& file, unsigned int features);
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include"ShadingRateImage.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<string>
+
+// One work group per texel of the rate image and one invocation per pixel of its tile, the nearest view distance of
+// the tile decides its rate. TILE_WIDTH and TILE_HEIGHT are defined in front of the source
+static const char* rateSource = R"(
+layout(local_size_x = TILE_WIDTH, local_size_y = TILE_HEIGHT) in;
+
+uniform sampler2D depth;
+layout(r8ui, binding = 0) writeonly uniform uimage2D rates;
+// projection[2][2] and projection[3][2], the view distance of a depth in NDC is the second over the depth plus the first
+uniform vec2 depthToDistance;
+// 1 for reverse-Z, whose depth is already in NDC and is 0 at infinity
+uniform int reverseZ;
+// Distance past which the fog hides everything, 0 without fog
+uniform float fogDistance;
+// Share of the half diagonal past which the periphery starts
+uniform float periphery;
+
+// Nearest view distance in the tile as float bits, which order like the floats for positive values
+shared uint nearest;
+
+void main()
+{
+    if (gl_LocalInvocationIndex == 0u)
+        nearest = 0x7F800000u;
+    barrier();
+    ivec2 size = textureSize(depth, 0);
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (all(lessThan(pixel, size)))
+    {
+        float d = texelFetch(depth, pixel, 0).r;
+        // The sky is at the cleared depth and adds nothing
+        if (reverseZ != 0 ? d > 0.0 : d < 1.0)
+        {
+            float ndc = reverseZ != 0 ? d : 2.0 * d - 1.0;
+            atomicMin(nearest, floatBitsToUint(max(depthToDistance.y / (ndc + depthToDistance.x), 0.0)));
+        }
+    }
+    barrier();
+    if (gl_LocalInvocationIndex != 0u)
+        return;
+
+    // Sky only, or nothing nearer than where the fog is solid, shades at 4x4, the last stretch into the fog at 2x2
+    float distance = uintBitsToFloat(nearest);
+    uint rate = 0u;
+    if (isinf(distance) || (fogDistance > 0.0 && distance > fogDistance))
+        rate = 2u;
+    else if (fogDistance > 0.0 && distance > 0.5 * fogDistance)
+        rate = 1u;
+    // The edges of the screen, the center of the tile measured against the half diagonal
+    vec2 center = (vec2(gl_WorkGroupID.xy) + 0.5) * vec2(gl_WorkGroupSize.xy) / vec2(size) * 2.0 - 1.0;
+    float radius = length(center) * 0.70710678;
+    if (radius > 0.5 * (periphery + 1.0))
+        rate = 2u;
+    else if (radius > periphery)
+        rate = max(rate, 1u);
+    imageStore(rates, ivec2(gl_WorkGroupID.xy), uvec4(rate));
+}
+)";
+
+// Asks for the tile size and builds the program for it
+ShadingRateImage::ShadingRateImage()
+{
+	glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV, &texelWidth);
+	glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &texelHeight);
+	texelWidth = std::max(texelWidth, 1);
+	texelHeight = std::max(texelHeight, 1);
+
+	std::string source = "#version 430 core\n#define TILE_WIDTH " + std::to_string(texelWidth) + "\n#define TILE_HEIGHT " + std::to_string(texelHeight) + "\n" + rateSource;
+	program = Shader::LinkCompute(source.c_str());
+	GLState.UseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "depth"), TEXTURE_UNIT);
+	GLState.CountUniforms();
+	GLState.UseProgram(0);
+
+	// The palette of the only viewport, by Rate
+	const GLenum palette[RATE_COUNT] = { GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV, GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV,
+		GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV };
+	glShadingRateImagePaletteNV(0, 0, RATE_COUNT, palette);
+	glGenFramebuffers(1, &framebuffer);
+}
+
+// Deletes the GL objects unless Delete was already called
+ShadingRateImage::~ShadingRateImage()
+{
+	Delete();
+}
+
+// Binds the last image and turns the rates on
+void ShadingRateImage::Begin()
+{
+	if (!built)
+		return;
+	glBindShadingRateImageNV(rates);
+	glEnable(GL_SHADING_RATE_IMAGE_NV);
+	enabled = true;
+}
+
+void ShadingRateImage::End()
+{
+	if (!enabled)
+		return;
+	glDisable(GL_SHADING_RATE_IMAGE_NV);
+	enabled = false;
+}
+
+// Copies the depth and reduces every tile of it into a rate
+void ShadingRateImage::Build(GLsizei width, GLsizei height, const glm::mat4& projection, float fogDistance)
+{
+	if (width <= 0 || height <= 0)
+		return;
+	if (width != ShadingRateImage::width || height != ShadingRateImage::height)
+		resize(width, height);
+
+	GLint previousFramebuffer, previousProgram;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	// Same copy as DepthPyramid's, a multisampled depth buffer is blitted one sample per pixel
+	GLint sampleBuffers = 0;
+	glGetIntegerv(GL_SAMPLE_BUFFERS, &sampleBuffers);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	if (sampleBuffers > 0)
+	{
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, previousFramebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthCopy, 0);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, depthCopy);
+	if (sampleBuffers <= 0)
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+	GLState.UseProgram(program);
+	glUniform2f(glGetUniformLocation(program, "depthToDistance"), projection[2][2], projection[3][2]);
+	glUniform1i(glGetUniformLocation(program, "reverseZ"), reverseDepth ? 1 : 0);
+	glUniform1f(glGetUniformLocation(program, "fogDistance"), fogDistance);
+	glUniform1f(glGetUniformLocation(program, "periphery"), periphery);
+	GLState.CountUniforms(4);
+	glBindImageTexture(0, rates, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+	glDispatchCompute((GLuint)((width + texelWidth - 1) / texelWidth), (GLuint)((height + texelHeight - 1) / texelHeight), 1);
+	// The rate image is read by the rasterizer like a texture
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+	built = true;
+
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	GLState.UseProgram(previousProgram);
+}
+
+// Reallocates the depth copy and the rate image, the image covers a partial tile at the right and top edges
+void ShadingRateImage::resize(GLsizei width, GLsizei height)
+{
+	ShadingRateImage::width = width;
+	ShadingRateImage::height = height;
+	End();
+	built = false;
+	if (depthCopy)
+		GLState.DeleteTextures(1, &depthCopy);
+	if (rates)
+		GLState.DeleteTextures(1, &rates);
+
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	glGenTextures(1, &depthCopy);
+	GLState.BindTexture(GL_TEXTURE_2D, depthCopy);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	GLenum depthFormat = reverseDepth ? GL_DEPTH_COMPONENT32F : GL_DEPTH_COMPONENT24;
+	glTexStorage2D(GL_TEXTURE_2D, 1, depthFormat, width, height);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, depthCopy, GpuMemoryTracker::ImageBytes(depthFormat, width, height));
+
+	// The extension only takes immutable R8UI images
+	GLsizei rateWidth = (width + texelWidth - 1) / texelWidth;
+	GLsizei rateHeight = (height + texelHeight - 1) / texelHeight;
+	glGenTextures(1, &rates);
+	GLState.BindTexture(GL_TEXTURE_2D, rates);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_R8UI, rateWidth, rateHeight);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, rates, GpuMemoryTracker::ImageBytes(GL_R8UI, rateWidth, rateHeight));
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	GLState.ActiveTexture(GL_TEXTURE0);
+}
+
+// Deletes the GL objects
+void ShadingRateImage::Delete()
+{
+	End();
+	if (depthCopy)
+		GLState.DeleteTextures(1, &depthCopy);
+	if (rates)
+		GLState.DeleteTextures(1, &rates);
+	if (framebuffer)
+		glDeleteFramebuffers(1, &framebuffer);
+	if (program)
+		GLState.DeleteProgram(program);
+	depthCopy = rates = framebuffer = program = 0;
+	built = false;
+}
@@ -0,0 +1,70 @@
+#ifndef SHADING_RATE_IMAGE_CLASS_H
+#define SHADING_RATE_IMAGE_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+// Variable rate shading with NV_shading_rate_image, so the fragment shaders run once per 2x2 or 4x4 pixels where
+// nobody can tell: tiles that only show sky, tiles whose nearest surface is deep in the fog and the edges of the
+// screen. Build reduces the depth of the framebuffer drawn into the nearest view distance of every tile of the rate
+// image with a compute shader and picks the tile's rate from it, for the frame after, since the rate has to be bound
+// before the scene is drawn. A tile whose nearest surface was one frame further away shades coarsely for one frame.
+// Only with GLExt.shadingRateImage.
+class ShadingRateImage
+{
+public:
+	// Texture unit the depth copy is bound to while Build reads it, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 22;
+	// Palette indices the rate image holds
+	enum Rate : GLuint
+	{
+		FULL_RATE = 0,
+		RATE_2X2 = 1,
+		RATE_4X4 = 2,
+		RATE_COUNT
+	};
+
+	// Set when the depth buffer is reverse-Z, see ReverseDepth.h, before the first Build
+	bool reverseDepth = false;
+	// Share of the half diagonal from the center of the screen past which tiles shade at 2x2, and at 4x4 halfway
+	// from there to the corners, 1 keeps the whole screen at full rate
+	float periphery = 0.7f;
+
+	// Constructor that builds the program and sets the palette, the textures are allocated by the first Build
+	ShadingRateImage();
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~ShadingRateImage();
+	// A ShadingRateImage owns its GL objects, so it cannot be copied
+	ShadingRateImage(const ShadingRateImage&) = delete;
+	ShadingRateImage& operator=(const ShadingRateImage&) = delete;
+
+	// Turns coarse shading on with the last image built, does nothing before the first Build
+	void Begin();
+	// Turns it off again, before passes that need every pixel shaded such as the post effects
+	void End();
+	// Picks the rates of the next frame from the depth of the current framebuffer, which is width by height and was
+	// drawn with projection. fogDistance is where the fog hides everything, 0 without fog. The framebuffer, program
+	// and texture bindings are put back
+	void Build(GLsizei width, GLsizei height, const glm::mat4& projection, float fogDistance);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	// Copy of the depth buffer, the rate image and the framebuffer the copy of a multisampled depth is blitted into
+	GLuint depthCopy = 0;
+	GLuint rates = 0;
+	GLuint framebuffer = 0;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	// Pixels per texel of the rate image, fixed by the hardware
+	GLint texelWidth = 16;
+	GLint texelHeight = 16;
+	GLuint program = 0;
+	bool built = false;
+	bool enabled = false;
+
+	// Reallocates the depth copy and the rate image for a new framebuffer size
+	void resize(GLsizei width, GLsizei height);
+};
+
+#endif
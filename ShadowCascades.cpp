@@ -0,0 +1,249 @@
+#include"ShadowCascades.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<cmath>
+#include<utility>
+
+// How far behind a cascade's sphere, towards the sun, casters are still drawn into it
+static const float CASTER_RANGE = 50.0f;
+
+// Creates a depth array of layers maps compared in hardware, linear filtering blends the four nearest results
+static GLuint createDepthArray(GLsizei size, GLsizei layers)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, layers, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, texture, GpuMemoryTracker::ImageBytes(GL_DEPTH_COMPONENT24, size, size, layers));
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	return texture;
+}
+
+// Constructor that fits a bounding sphere around every slice and creates the cached maps
+ShadowCascades::ShadowCascades(GLsizei size, float fovY, float aspect, float nearPlane, const float splits[CASCADES], float threshold)
+{
+	ShadowCascades::size = size;
+	ShadowCascades::threshold = threshold;
+
+	// The sphere through the far corners of a slice, moved back to the near corners when they would be left out
+	float corner = std::tan(fovY * 0.5f) * std::sqrt(1.0f + aspect * aspect);
+	float sliceNear = nearPlane;
+	for (unsigned int i = 0; i < CASCADES; i++)
+	{
+		float sliceFar = splits[i];
+		float nearHalf = sliceNear * corner, farHalf = sliceFar * corner;
+		float center = (sliceFar * sliceFar + farHalf * farHalf - sliceNear * sliceNear - nearHalf * nearHalf) / (2.0f * (sliceFar - sliceNear));
+		center = std::clamp(center, sliceNear, sliceFar);
+		Cascade& cascade = cascades[i];
+		cascade.sliceCenter = center;
+		cascade.radius = std::max(std::sqrt((sliceFar - center) * (sliceFar - center) + farHalf * farHalf), std::sqrt((center - sliceNear) * (center - sliceNear) + nearHalf * nearHalf));
+		cascade.center = glm::vec3(0.0f);
+		cascade.sun = glm::vec3(0.0f);
+		cascade.valid = false;
+		cascade.projection = glm::mat4(1.0f);
+		cascade.view = glm::mat4(1.0f);
+		ShadowCascades::splits[i] = sliceFar;
+		sliceNear = sliceFar;
+	}
+
+	staticDepth = createDepthArray(size, CASCADES);
+
+	glGenFramebuffers(2, framebuffers);
+}
+
+// Deletes the GL objects unless Delete was already called
+ShadowCascades::~ShadowCascades()
+{
+	Delete();
+}
+
+// Takes over the maps of other cascades
+ShadowCascades::ShadowCascades(ShadowCascades&& other) noexcept
+	: staticDepth(std::exchange(other.staticDepth, 0)), dynamicDepth(std::exchange(other.dynamicDepth, 0)), staticUpdates(other.staticUpdates),
+	sunUpdates(other.sunUpdates), size(other.size), threshold(other.threshold), dynamicDrawn(other.dynamicDrawn)
+{
+	std::copy(other.cascades, other.cascades + CASCADES, cascades);
+	std::copy(other.splits, other.splits + CASCADES, splits);
+	for (int f = 0; f < 2; f++)
+		framebuffers[f] = std::exchange(other.framebuffers[f], 0);
+}
+
+// Deletes the current maps and takes over the ones of other cascades
+ShadowCascades& ShadowCascades::operator=(ShadowCascades&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		staticDepth = std::exchange(other.staticDepth, 0);
+		dynamicDepth = std::exchange(other.dynamicDepth, 0);
+		staticUpdates = other.staticUpdates;
+		sunUpdates = other.sunUpdates;
+		std::copy(other.cascades, other.cascades + CASCADES, cascades);
+		std::copy(other.splits, other.splits + CASCADES, splits);
+		size = other.size;
+		threshold = other.threshold;
+		dynamicDrawn = other.dynamicDrawn;
+		for (int f = 0; f < 2; f++)
+			framebuffers[f] = std::exchange(other.framebuffers[f], 0);
+	}
+	return *this;
+}
+
+// Binds a layer of a depth array to a framebuffer
+void ShadowCascades::bindLayer(int f, GLuint texture, GLint layer)
+{
+	GLenum target = f == 0 ? GL_DRAW_FRAMEBUFFER : GL_READ_FRAMEBUFFER;
+	glBindFramebuffer(target, framebuffers[f]);
+	glFramebufferTextureLayer(target, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+	if (f == 0)
+		glDrawBuffer(GL_NONE);
+	else
+		glReadBuffer(GL_NONE);
+}
+
+// Fits the cascades to a viewer and renders the ones that moved out of their margin
+void ShadowCascades::Update(const glm::vec3& position, const glm::vec3& forward, const glm::vec3& sunDirection, const DrawFunction& drawStatic, const DrawFunction& drawDynamic)
+{
+	GLint previousDraw, previousRead, viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean colorMask[4];
+	glGetBooleanv(GL_COLOR_WRITEMASK, colorMask);
+	glViewport(0, 0, size, size);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	GLState.Enable(GL_DEPTH_TEST);
+	// Slopes facing away from the sun would otherwise shadow themselves
+	GLState.Enable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	glm::vec3 sun = glm::normalize(sunDirection);
+	glm::vec3 up = std::abs(sun.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	staticUpdates = 0;
+	// The cascades that only lag behind the sun take turns, furthest behind first
+	bool render[CASCADES];
+	float lag[CASCADES];
+	unsigned int sunBudget = sunUpdates;
+	for (unsigned int i = 0; i < CASCADES; i++)
+	{
+		const Cascade& cascade = cascades[i];
+		glm::vec3 center = position + forward * cascade.sliceCenter;
+		render[i] = !cascade.valid || glm::length(center - cascade.center) > threshold * cascade.radius;
+		lag[i] = render[i] ? 2.0f : glm::dot(sun, cascade.sun);
+	}
+	while (sunBudget > 0)
+	{
+		unsigned int behind = CASCADES;
+		for (unsigned int i = 0; i < CASCADES; i++)
+			if (!render[i] && lag[i] <= 0.9999f && (behind == CASCADES || lag[i] < lag[behind]))
+				behind = i;
+		if (behind == CASCADES)
+			break;
+		render[behind] = true;
+		sunBudget--;
+	}
+	for (unsigned int i = 0; i < CASCADES; i++)
+	{
+		if (!render[i])
+			continue;
+		Cascade& cascade = cascades[i];
+		glm::vec3 center = position + forward * cascade.sliceCenter;
+
+		// The map covers the sphere grown by the margin, so the slice stays inside it until the next update
+		float extent = cascade.radius * (1.0f + threshold);
+		cascade.center = center;
+		cascade.sun = sun;
+		cascade.valid = true;
+		cascade.view = glm::lookAt(center - sun * (extent + CASTER_RANGE), center, up);
+		cascade.projection = glm::ortho(-extent, extent, -extent, extent, 0.0f, 2.0f * extent + CASTER_RANGE);
+		bindLayer(0, staticDepth, (GLint)i);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		drawStatic(cascade.projection, cascade.view);
+		staticUpdates++;
+	}
+
+	// Dynamic objects go on top of a copy of the cached depth, which stays untouched for the next frame
+	dynamicDrawn = (bool)drawDynamic;
+	if (drawDynamic)
+	{
+		if (dynamicDepth == 0)
+			dynamicDepth = createDepthArray(size, CASCADES);
+		for (unsigned int i = 0; i < CASCADES; i++)
+		{
+			bindLayer(1, staticDepth, (GLint)i);
+			bindLayer(0, dynamicDepth, (GLint)i);
+			glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			drawDynamic(cascades[i].projection, cascades[i].view);
+		}
+	}
+
+	GLState.Disable(GL_POLYGON_OFFSET_FILL);
+	glColorMask(colorMask[0], colorMask[1], colorMask[2], colorMask[3]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+// Forgets every cached cascade
+void ShadowCascades::Invalidate()
+{
+	for (Cascade& cascade : cascades)
+		cascade.valid = false;
+}
+
+// Binds the shadow map and sets the shadow uniforms of the program in use
+void ShadowCascades::Apply(GLuint program)
+{
+	// Clip space of each map to the texture coordinates and depth it is sampled with
+	const glm::mat4 bias = glm::translate(glm::mat4(1.0f), glm::vec3(0.5f)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.5f));
+	glm::mat4 matrices[CASCADES];
+	for (unsigned int i = 0; i < CASCADES; i++)
+		matrices[i] = bias * cascades[i].projection * cascades[i].view;
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, dynamicDrawn ? dynamicDepth : staticDepth);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, "shadowMap"), TEXTURE_UNIT);
+	glUniformMatrix4fv(glGetUniformLocation(program, "shadowMatrices"), CASCADES, GL_FALSE, glm::value_ptr(matrices[0]));
+	GLfloat packedSplits[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	std::copy(splits, splits + std::min(CASCADES, 4u), packedSplits);
+	glUniform4fv(glGetUniformLocation(program, "cascadeSplits"), 1, packedSplits);
+	GLState.CountUniforms(3);
+}
+
+// Sets the uniforms of the program in use so nothing it draws is shadowed
+void ShadowCascades::Disable(GLuint program)
+{
+	// The map stays bound so the sampler still has a texture of its type, no depth is past a split of 0
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, staticDepth);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, "shadowMap"), TEXTURE_UNIT);
+	glUniform4f(glGetUniformLocation(program, "cascadeSplits"), 0.0f, 0.0f, 0.0f, 0.0f);
+	GLState.CountUniforms(2);
+}
+
+// Deletes the GL objects
+void ShadowCascades::Delete()
+{
+	GLuint textures[] = { staticDepth, dynamicDepth };
+	for (GLuint texture : textures)
+		if (texture != 0)
+			GLState.DeleteTextures(1, &texture);
+	staticDepth = dynamicDepth = 0;
+	for (GLuint& framebuffer : framebuffers)
+		if (framebuffer != 0)
+		{
+			glDeleteFramebuffers(1, &framebuffer);
+			framebuffer = 0;
+		}
+}
@@ -0,0 +1,84 @@
+#ifndef SHADOW_CASCADES_CLASS_H
+#define SHADOW_CASCADES_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<functional>
+
+// Cascaded shadow maps for the sun, cached between frames
+// The view frustum is split by distance into CASCADES slices, each covered by an orthographic map along the sun direction
+// that is a little larger than the slice's bounding sphere. A cascade is only rendered again once the camera moved
+// its slice out of that margin or the sun turned, so the static city is drawn into most cascades once in many frames.
+// While the sun keeps turning, as it does with TimeOfDay, at most sunUpdates cascades follow it a frame, the one whose
+// sun is furthest behind first, so the cost of a moving sun is spread over frames instead of redrawing them all at once.
+// Dynamic objects, if there are any, are drawn every frame on top of a copy of the cached static depth.
+class ShadowCascades
+{
+public:
+	static constexpr unsigned int CASCADES = 3;
+	// The shadow map is bound to this texture unit while the scene is drawn, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 8;
+
+	// Depth textures, one layer per cascade, the one to sample is dynamicDepth when a dynamic pass was drawn
+	GLuint staticDepth = 0;
+	GLuint dynamicDepth = 0;
+	// Number of cascades the last Update rendered the static geometry into, for the profiler overlay
+	unsigned int staticUpdates = 0;
+	// Most cascades an Update renders again only because the sun turned, ones the camera moved out of are always rendered
+	unsigned int sunUpdates = CASCADES;
+
+	// Draws geometry into the bound cascade with the given light projection and view, in the space the viewer is given in
+	typedef std::function<void(const glm::mat4& projection, const glm::mat4& view)> DrawFunction;
+
+	// Constructor for maps of size by size texels, for a viewer with a vertical field of view and aspect ratio
+	// splits are the far distances of the cascades, the first starts at nearPlane
+	// A cascade is rendered again once its slice moved further than threshold times its radius
+	ShadowCascades(GLsizei size, float fovY, float aspect, float nearPlane, const float splits[CASCADES], float threshold = 0.25f);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~ShadowCascades();
+	// ShadowCascades owns its GL objects, so it can be moved but not copied
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades& operator=(const ShadowCascades&) = delete;
+	ShadowCascades(ShadowCascades&& other) noexcept;
+	ShadowCascades& operator=(ShadowCascades&& other) noexcept;
+
+	// Fits the cascades to a viewer and renders the ones that moved out of their margin with drawStatic
+	// When drawDynamic is given it is drawn into every cascade on top of the cached static depth
+	// The draw functions get a bound depth only framebuffer, the framebuffer, viewport and color mask are restored afterwards
+	void Update(const glm::vec3& position, const glm::vec3& forward, const glm::vec3& sunDirection, const DrawFunction& drawStatic, const DrawFunction& drawDynamic = nullptr);
+	// Forgets every cached cascade, such as after the static geometry changed
+	void Invalidate();
+	// Binds the shadow map and sets the shadow uniforms of the program in use
+	void Apply(GLuint program);
+	// Sets the uniforms of the program in use so nothing it draws is shadowed, such as for baking impostors
+	void Disable(GLuint program);
+
+	// Deletes the GL objects, does nothing if they were already deleted or moved from
+	void Delete();
+private:
+	// One cached cascade
+	struct Cascade
+	{
+		// Bounding sphere of the cascade's slice of the frustum
+		float sliceCenter;
+		float radius;
+		// Where the map was last rendered from, valid is false until it was
+		glm::vec3 center;
+		glm::vec3 sun;
+		bool valid;
+		// Light projection and view the cached map was rendered with
+		glm::mat4 projection;
+		glm::mat4 view;
+	};
+	Cascade cascades[CASCADES];
+	float splits[CASCADES];
+	GLsizei size = 0;
+	float threshold = 0.0f;
+	bool dynamicDrawn = false;
+	GLuint framebuffers[2] = { 0, 0 };
+
+	// Binds a layer of a depth array to framebuffer f
+	void bindLayer(int f, GLuint texture, GLint layer);
+};
+
+#endif
@@ -0,0 +1,58 @@
+#include"SimulationClock.h"
+
+#include<algorithm>
+
+// Constructor that starts the clock at 0
+SimulationClock::SimulationClock(double step, unsigned int maxSteps)
+{
+	SimulationClock::step = step;
+	SimulationClock::maxSteps = std::max(maxSteps, 1u);
+}
+
+// Moves the clock to now seconds of real time
+unsigned int SimulationClock::Advance(double now)
+{
+	current = now - dropped;
+	unsigned int count = 0;
+	// Compares the same products the caller gets from counting frames, so a frame per step gives an alpha of exactly 0
+	while ((double)steps * step <= current)
+	{
+		if (count == maxSteps)
+		{
+			// Pretends the real time is the one of the last step, everything later starts from there
+			dropped += current - (double)(steps - 1) * step;
+			current = (double)(steps - 1) * step;
+			break;
+		}
+		steps++;
+		count++;
+	}
+	return count;
+}
+
+// Drops the real time since the last Advance
+void SimulationClock::Skip(double now)
+{
+	dropped = now - current;
+}
+
+// Time to render, between the last two steps
+double SimulationClock::time() const
+{
+	return current;
+}
+
+// Where time is between the last two steps
+float SimulationClock::alpha() const
+{
+	if (steps == 0)
+		return 0.0f;
+	double fraction = (current - (double)(steps - 1) * step) / step;
+	return (float)std::min(std::max(fraction, 0.0), 1.0);
+}
+
+// Steps run since the start
+uint64_t SimulationClock::stepCount() const
+{
+	return steps;
+}
@@ -0,0 +1,38 @@
+#ifndef SIMULATION_CLOCK_CLASS_H
+#define SIMULATION_CLOCK_CLASS_H
+
+#include<cstdint>
+
+// Fixed-step clock of the simulation: every step has the same length whatever the frame rate, so motion does not
+// depend on how fast frames render and the same inputs always give the same states
+// Advance runs the simulation just past the real time, a frame is then drawn between the state before the last step
+// and the one after it, blended by alpha, so rendering stays smooth at any rate
+class SimulationClock
+{
+public:
+	// Length of a step in seconds
+	double step;
+	// Most steps one Advance asks for, time beyond them is dropped so a stall does not make every later frame slower
+	unsigned int maxSteps;
+
+	// Constructor that starts the clock at 0
+	SimulationClock(double step, unsigned int maxSteps = 8);
+
+	// Moves the clock to now seconds of real time, returns how many steps the simulation has to run to get past it
+	unsigned int Advance(double now);
+	// Drops the real time since the last Advance up to now, after a pause the simulation goes on from where it stopped
+	void Skip(double now);
+	// Time to render, between the last two steps, it matches the real time except for what stalls dropped
+	double time() const;
+	// Where time is between the state before the last step (0) and the state after it (1)
+	float alpha() const;
+	// Steps run since the start
+	uint64_t stepCount() const;
+private:
+	uint64_t steps = 0;
+	// Seconds dropped by stalls, and the real time of the last Advance without them
+	double dropped = 0.0;
+	double current = 0.0;
+};
+
+#endif
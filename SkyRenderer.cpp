@@ -0,0 +1,470 @@
+#include"SkyRenderer.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<algorithm>
+#include<cmath>
+#include<string>
+#include<glm/gtc/type_ptr.hpp>
+
+// Width and height of the transmittance, multiple scattering and sky view tables
+static const GLsizei tableSizes[3][2] = { { 256, 64 }, { 32, 32 }, { 192, 108 } };
+
+// Full screen triangle the tables are drawn with
+static const char* tableVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+// The atmosphere every table and the sky share, put after their #version line
+static const char* atmosphereSource = R"(
+// Radii of the ground and the top of the atmosphere in km, and the eye a little above the ground
+const float GROUND = 6360.0;
+const float TOP = 6460.0;
+const vec3 EYE = vec3(0.0, GROUND + 0.2, 0.0);
+const float PI = 3.14159265;
+// Scattering and absorption per km at sea level, Rayleigh's thins out over 8 km and Mie's over 1.2, the ozone layer
+// absorbs most around 25 km
+const vec3 RAYLEIGH_SCATTERING = vec3(5.802, 13.558, 33.1) * 1e-3;
+const float MIE_SCATTERING = 3.996e-3;
+const float MIE_ABSORPTION = 4.4e-3;
+const vec3 OZONE_ABSORPTION = vec3(0.650, 1.881, 0.085) * 1e-3;
+const vec3 GROUND_ALBEDO = vec3(0.3);
+
+uniform sampler2D transmittanceTable;
+uniform sampler2D scatteringTable;
+uniform sampler2D skyViewTable;
+// Width and height of the table being drawn
+uniform vec2 tableSize;
+
+// Rayleigh and Mie scattering and the extinction at a position relative to the planet's center
+void medium(vec3 position, out vec3 rayleigh, out float mie, out vec3 extinction)
+{
+    float height = length(position) - GROUND;
+    float mieDensity = exp(-height / 1.2);
+    rayleigh = RAYLEIGH_SCATTERING * exp(-height / 8.0);
+    mie = MIE_SCATTERING * mieDensity;
+    extinction = rayleigh + (MIE_SCATTERING + MIE_ABSORPTION) * mieDensity + OZONE_ABSORPTION * max(0.0, 1.0 - abs(height - 25.0) / 15.0);
+}
+
+// Distance along a ray to the nearest hit ahead with a sphere around the planet's center, -1 when there is none
+float sphere(vec3 origin, vec3 direction, float radius)
+{
+    float b = dot(origin, direction);
+    float discriminant = b * b - dot(origin, origin) + radius * radius;
+    if (discriminant < 0.0)
+        return -1.0;
+    float root = sqrt(discriminant);
+    return -b - root > 0.0 ? -b - root : -b + root > 0.0 ? -b + root : -1.0;
+}
+
+float rayleighPhase(float cosAngle)
+{
+    return 3.0 / (16.0 * PI) * (1.0 + cosAngle * cosAngle);
+}
+
+// Cornette-Shanks with most of the light going on forward
+float miePhase(float cosAngle)
+{
+    const float g = 0.8;
+    return 3.0 / (8.0 * PI) * (1.0 - g * g) * (1.0 + cosAngle * cosAngle) / ((2.0 + g * g) * pow(1.0 + g * g - 2.0 * g * cosAngle, 1.5));
+}
+
+// Where the transmittance and multiple scattering tables keep a position and a sun direction, by the cosine of the
+// sun's zenith angle across and the height up
+vec2 tableCoordinates(vec3 position, vec3 sun)
+{
+    float height = length(position);
+    return vec2(dot(position / height, sun) * 0.5 + 0.5, (height - GROUND) / (TOP - GROUND));
+}
+
+// How far the eye sees past the geometric horizon, the sky view table puts the horizon in its middle
+float horizonDip()
+{
+    float height = length(EYE);
+    return asin(sqrt(height * height - GROUND * GROUND) / height);
+}
+)";
+// How much sunlight is left at a height for a sun angle, marched once up to the top of the atmosphere
+static const char* transmittanceSource = R"(
+out vec4 FragColor;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / tableSize;
+    float cosZenith = uv.x * 2.0 - 1.0;
+    vec3 origin = vec3(0.0, mix(GROUND, TOP, uv.y), 0.0);
+    vec3 direction = vec3(sqrt(max(0.0, 1.0 - cosZenith * cosZenith)), cosZenith, 0.0);
+    if (sphere(origin, direction, GROUND) > 0.0)
+    {
+        FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    const int STEPS = 40;
+    float travel = max(sphere(origin, direction, TOP), 0.0);
+    vec3 depth = vec3(0.0);
+    for (int i = 0; i < STEPS; i++)
+    {
+        vec3 rayleigh, extinction;
+        float mie;
+        medium(origin + direction * travel * (float(i) + 0.5) / float(STEPS), rayleigh, mie, extinction);
+        depth += extinction;
+    }
+    FragColor = vec4(exp(-depth * travel / float(STEPS)), 1.0);
+}
+)";
+// Light scattered more than once, as Hillaire approximates it: the second order scattering from directions all
+// around a point and the share of it that scatters again, summed as a geometric series of further orders
+static const char* scatteringSource = R"(
+out vec4 FragColor;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / tableSize;
+    float sunCos = uv.x * 2.0 - 1.0;
+    vec3 sun = vec3(0.0, sunCos, -sqrt(max(0.0, 1.0 - sunCos * sunCos)));
+    vec3 origin = vec3(0.0, mix(GROUND, TOP, uv.y), 0.0);
+    const int SQRT_SAMPLES = 8;
+    const int STEPS = 20;
+    vec3 luminance = vec3(0.0);
+    vec3 transfer = vec3(0.0);
+    for (int i = 0; i < SQRT_SAMPLES; i++)
+        for (int j = 0; j < SQRT_SAMPLES; j++)
+        {
+            // Half the turns are enough, the sun is in the plane that mirrors the other half
+            float theta = PI * (float(i) + 0.5) / float(SQRT_SAMPLES);
+            float phi = acos(1.0 - 2.0 * (float(j) + 0.5) / float(SQRT_SAMPLES));
+            vec3 direction = vec3(sin(phi) * sin(theta), cos(phi), sin(phi) * cos(theta));
+            float groundDistance = sphere(origin, direction, GROUND);
+            float travel = groundDistance > 0.0 ? groundDistance : max(sphere(origin, direction, TOP), 0.0);
+            float cosAngle = dot(direction, sun);
+            vec3 throughput = vec3(1.0);
+            vec3 rayLuminance = vec3(0.0);
+            vec3 rayTransfer = vec3(0.0);
+            float t = 0.0;
+            for (int k = 0; k < STEPS; k++)
+            {
+                float next = (float(k) + 0.3) / float(STEPS) * travel;
+                float dt = next - t;
+                t = next;
+                vec3 position = origin + direction * t;
+                vec3 rayleigh, extinction;
+                float mie;
+                medium(position, rayleigh, mie, extinction);
+                vec3 stepTransmittance = exp(-dt * extinction);
+                vec3 scattering = rayleigh + vec3(mie);
+                rayTransfer += throughput * (scattering - scattering * stepTransmittance) / extinction;
+                vec3 sunlight = texture(transmittanceTable, tableCoordinates(position, sun)).rgb;
+                vec3 inScattering = (rayleigh * rayleighPhase(cosAngle) + mie * miePhase(cosAngle)) * sunlight;
+                rayLuminance += throughput * (inScattering - inScattering * stepTransmittance) / extinction;
+                throughput *= stepTransmittance;
+            }
+            // The ground reflects what reaches it too
+            if (groundDistance > 0.0)
+            {
+                vec3 up = normalize(origin + direction * groundDistance);
+                vec3 sunlight = texture(transmittanceTable, tableCoordinates(up * GROUND, sun)).rgb;
+                rayLuminance += throughput * sunlight * GROUND_ALBEDO * max(dot(up, sun), 0.0) / PI;
+            }
+            luminance += rayLuminance / float(SQRT_SAMPLES * SQRT_SAMPLES);
+            transfer += rayTransfer / float(SQRT_SAMPLES * SQRT_SAMPLES);
+        }
+    FragColor = vec4(luminance / (1.0 - transfer), 1.0);
+}
+)";
+// Light coming in at the eye from every direction, across by the bearing from the sun's and up by the elevation
+// above the horizon, squeezed towards the horizon where the sky changes fastest
+static const char* skyViewSource = R"(
+uniform float sunElevation;
+
+out vec4 FragColor;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / tableSize;
+    float azimuth = (uv.x - 0.5) * 2.0 * PI;
+    float v = uv.y * 2.0 - 1.0;
+    float elevation = sign(v) * v * v * 0.5 * PI - horizonDip();
+    vec3 direction = vec3(cos(elevation) * sin(azimuth), sin(elevation), -cos(elevation) * cos(azimuth));
+    vec3 sun = vec3(0.0, sin(sunElevation), -cos(sunElevation));
+    float groundDistance = sphere(EYE, direction, GROUND);
+    float travel = groundDistance > 0.0 ? groundDistance : sphere(EYE, direction, TOP);
+    float cosAngle = dot(direction, sun);
+    const int STEPS = 32;
+    vec3 throughput = vec3(1.0);
+    vec3 luminance = vec3(0.0);
+    float t = 0.0;
+    for (int k = 0; k < STEPS; k++)
+    {
+        float next = (float(k) + 0.3) / float(STEPS) * travel;
+        float dt = next - t;
+        t = next;
+        vec3 position = EYE + direction * t;
+        vec3 rayleigh, extinction;
+        float mie;
+        medium(position, rayleigh, mie, extinction);
+        vec3 stepTransmittance = exp(-dt * extinction);
+        vec2 coordinates = tableCoordinates(position, sun);
+        vec3 sunlight = texture(transmittanceTable, coordinates).rgb;
+        vec3 multiple = texture(scatteringTable, coordinates).rgb;
+        vec3 inScattering = rayleigh * (rayleighPhase(cosAngle) * sunlight + multiple) + mie * (miePhase(cosAngle) * sunlight + multiple);
+        luminance += throughput * (inScattering - inScattering * stepTransmittance) / extinction;
+        throughput *= stepTransmittance;
+    }
+    FragColor = vec4(luminance, 1.0);
+}
+)";
+// Full screen triangle at the far plane, with the view ray through each corner
+static const char* skyVertexSource = R"(
+#version 330 core
+uniform mat4 inverseProjection;
+uniform int reverseZ;
+
+out vec3 ViewRay;
+
+void main()
+{
+    vec2 corner = vec2(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1));
+    // The near plane is at 1 with reverse-Z and at -1 otherwise, the far plane where the other is
+    vec4 near = inverseProjection * vec4(corner, reverseZ != 0 ? 1.0 : -1.0, 1.0);
+    ViewRay = near.xyz / near.w;
+    gl_Position = vec4(corner, reverseZ != 0 ? 0.0 : 1.0, 1.0);
+}
+)";
+// One lookup into the sky view table and the sun's disk
+static const char* skySource = R"(
+// Rotation from view to world space, the direction towards the sun and the light's scale
+uniform mat3 toWorld;
+uniform vec3 sun;
+uniform float intensity;
+
+in vec3 ViewRay;
+
+out vec4 FragColor;
+
+// Angular radius of the sun and its brightness over that of the sky
+const float SUN_COS = cos(0.0047);
+const float SUN_RADIANCE = 20.0;
+
+void main()
+{
+    vec3 ray = normalize(toWorld * ViewRay);
+    // Bearing from the sun's, which is straight ahead in the table, any bearing will do with the sun overhead
+    vec2 sunBearing = length(sun.xz) > 1e-4 ? normalize(sun.xz) : vec2(0.0, -1.0);
+    float azimuth = atan(sunBearing.x * ray.z - sunBearing.y * ray.x, dot(sunBearing, ray.xz));
+    float elevation = asin(clamp(ray.y, -1.0, 1.0)) + horizonDip();
+    float v = 0.5 + 0.5 * sign(elevation) * sqrt(min(abs(elevation) * 2.0 / PI, 1.0));
+    vec3 color = texture(skyViewTable, vec2(azimuth / (2.0 * PI) + 0.5, v)).rgb;
+    if (dot(ray, sun) > SUN_COS && sphere(EYE, ray, GROUND) < 0.0)
+        color += texture(transmittanceTable, tableCoordinates(EYE, sun)).rgb * SUN_RADIANCE;
+    FragColor = vec4(color * intensity, 1.0);
+}
+)";
+
+// Links a program whose fragment shader is the atmosphere followed by body, and points its samplers at the tables
+static GLuint buildProgram(const char* vertexSource, const char* body)
+{
+	GLuint program = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, vertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, (std::string("#version 330 core\n") + atmosphereSource + body).c_str(), "FRAGMENT") });
+
+	GLState.UseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "transmittanceTable"), SkyRenderer::TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "scatteringTable"), SkyRenderer::TEXTURE_UNIT + 1);
+	glUniform1i(glGetUniformLocation(program, "skyViewTable"), SkyRenderer::TEXTURE_UNIT + 2);
+	return program;
+}
+
+// Constructor that builds the programs and allocates the tables
+SkyRenderer::SkyRenderer()
+{
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	transmittanceProgram = buildProgram(tableVertexSource, transmittanceSource);
+	scatteringProgram = buildProgram(tableVertexSource, scatteringSource);
+	skyViewProgram = buildProgram(tableVertexSource, skyViewSource);
+	skyProgram = buildProgram(skyVertexSource, skySource);
+	GLState.UseProgram(previousProgram);
+
+	// Every table is filtered, a lookup lands between the texels it was drawn at, the fourth is the sky view table remade
+	GLuint* targets[4] = { &tables[0], &tables[1], &tables[2], &nextSkyView };
+	for (int t = 0; t < 4; t++)
+	{
+		int i = std::min(t, 2);
+		glGenTextures(1, targets[t]);
+		GLState.BindTexture(GL_TEXTURE_2D, *targets[t]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, i == 2 ? GL_REPEAT : GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, tableSizes[i][0], tableSizes[i][1], 0, GL_RGBA, GL_FLOAT, nullptr);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, *targets[t], GpuMemoryTracker::ImageBytes(GL_RGBA16F, tableSizes[i][0], tableSizes[i][1]));
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	glGenFramebuffers(1, &framebuffer);
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+SkyRenderer::~SkyRenderer()
+{
+	Delete();
+}
+
+// Makes the tables the sun's elevation needs, or the next band of a sky view table being remade
+void SkyRenderer::Update(const glm::vec3& sunDirection)
+{
+	sun = glm::normalize(sunDirection);
+	float elevation = std::asin(glm::clamp(sun.y, -1.0f, 1.0f));
+	if (precomputed && nextBand < 0 && std::abs(elevation - tableElevation) < 1e-4f)
+		return;
+
+	GLint previousFramebuffer, previousProgram, previousVAO;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+	GLint scissorBox[4];
+	glGetIntegerv(GL_SCISSOR_BOX, scissorBox);
+	GLState.Disable(GL_DEPTH_TEST);
+	GLState.Enable(GL_SCISSOR_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	GLState.BindVertexArray(emptyVAO);
+
+	// The multiple scattering reads the transmittance and the sky view reads both, the first table is made whole
+	int bands = precomputed ? std::max(1, std::min(updateBands, (int)tableSizes[2][1])) : 1;
+	if (!precomputed)
+	{
+		drawTable(transmittanceProgram, 0, tables[0], 0, tableSizes[0][1]);
+		drawTable(scatteringProgram, 1, tables[1], 0, tableSizes[1][1]);
+		precomputed = true;
+	}
+	// A remake started goes on for the elevation it started with, the next one catches up with the sun
+	if (nextBand < 0)
+	{
+		nextElevation = elevation;
+		nextBand = 0;
+	}
+	GLState.UseProgram(skyViewProgram);
+	glUniform1f(glGetUniformLocation(skyViewProgram, "sunElevation"), nextElevation);
+	GLState.CountUniforms(1);
+	GLsizei rows = tableSizes[2][1];
+	GLsizei first = rows * nextBand / bands;
+	GLsizei last = rows * (nextBand + 1) / bands;
+	drawTable(skyViewProgram, 2, nextSkyView, first, last - first);
+	if (++nextBand >= bands)
+	{
+		std::swap(tables[2], nextSkyView);
+		tableElevation = nextElevation;
+		nextBand = -1;
+	}
+	for (GLuint i = 0; i < 2; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	glScissor(scissorBox[0], scissorBox[1], scissorBox[2], scissorBox[3]);
+	if (!scissor)
+		GLState.Disable(GL_SCISSOR_TEST);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+}
+
+// Draws the sky where the depth buffer is still at the far plane
+void SkyRenderer::Draw(const glm::mat4& projection, const glm::mat4& view)
+{
+	GLint previousProgram, previousVAO, depthFunc;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+	GLboolean depthMask;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMask);
+
+	// The triangle is exactly at the cleared depth, so the comparison has to let equal through
+	glDepthFunc(reverseDepth ? GL_GEQUAL : GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+	GLState.UseProgram(skyProgram);
+	glUniformMatrix4fv(glGetUniformLocation(skyProgram, "inverseProjection"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+	glUniformMatrix3fv(glGetUniformLocation(skyProgram, "toWorld"), 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::mat3(view))));
+	glUniform3fv(glGetUniformLocation(skyProgram, "sun"), 1, glm::value_ptr(sun));
+	glUniform1f(glGetUniformLocation(skyProgram, "intensity"), intensity);
+	glUniform1i(glGetUniformLocation(skyProgram, "reverseZ"), reverseDepth ? 1 : 0);
+	GLState.CountUniforms(5);
+	for (GLuint i = 0; i < 3; i += 2)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, tables[i]);
+	}
+	GLState.BindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+	for (GLuint i = 0; i < 3; i += 2)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	glDepthMask(depthMask);
+	glDepthFunc((GLenum)depthFunc);
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+}
+
+// Draws a full screen triangle with program into target, the tables before it bound for it to read
+// Rows are drawn through the scissor, which Update enabled, every texel of the tables is worked out on its own
+void SkyRenderer::drawTable(GLuint program, int table, GLuint target, GLsizei first, GLsizei rows)
+{
+	for (int i = 0; i < table; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, tables[i]);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target, 0);
+	glViewport(0, 0, tableSizes[table][0], tableSizes[table][1]);
+	glScissor(0, first, tableSizes[table][0], rows);
+	GLState.UseProgram(program);
+	glUniform2f(glGetUniformLocation(program, "tableSize"), (GLfloat)tableSizes[table][0], (GLfloat)tableSizes[table][1]);
+	GLState.CountUniforms(1);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+}
+
+// Deletes the GL objects
+void SkyRenderer::Delete()
+{
+	for (GLuint& table : tables)
+	{
+		if (table != 0)
+			GLState.DeleteTextures(1, &table);
+		table = 0;
+	}
+	if (nextSkyView != 0)
+		GLState.DeleteTextures(1, &nextSkyView);
+	nextSkyView = 0;
+	nextBand = -1;
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	GLuint programs[] = { transmittanceProgram, scatteringProgram, skyViewProgram, skyProgram };
+	for (GLuint program : programs)
+		if (program != 0)
+			GLState.DeleteProgram(program);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	framebuffer = transmittanceProgram = scatteringProgram = skyViewProgram = skyProgram = emptyVAO = 0;
+	precomputed = false;
+}
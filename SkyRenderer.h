@@ -0,0 +1,68 @@
+#ifndef SKY_RENDERER_CLASS_H
+#define SKY_RENDERER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+// Physically based sky from lookup tables in the manner of Hillaire's, so no pixel of the sky marches a ray.
+// A transmittance table of how much sunlight is left at a height and sun angle and a multiple scattering table of the
+// light bounced more than once are made by the first Update, both only depend on the atmosphere. A sky view table of
+// the light coming in from every direction, taken relative to the sun's bearing, depends on the sun's elevation alone
+// and is made again only when that changes, into a second table while the first is still drawn from. A sun that keeps
+// moving, as with TimeOfDay, has it remade a band of rows an Update over updateBands frames, so the cost is spread
+// evenly and the table is swapped in once it is whole. Draw then shades the pixels nothing covered with one lookup each and the
+// sun's disk, as a full screen triangle at the far plane that the depth test keeps behind the scene.
+// Distances are in km for an eye a little above the ground, the city is far too small to change the sky.
+class SkyRenderer
+{
+public:
+	// The transmittance table is bound to this texture unit, the multiple scattering one to the next and the sky view
+	// one to the unit after that, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 17;
+
+	// Set when the scene is drawn reverse-Z, see ReverseDepth.h, the far plane is then at depth 0
+	bool reverseDepth = false;
+	// Scales the light of the sky and the sun, which are worked out for a sun of illuminance 1
+	float intensity = 8.0f;
+	// Updates the sky view table is remade over, 1 remakes it in the Update that finds the elevation changed
+	int updateBands = 1;
+
+	// Constructor that builds the programs and allocates the tables, they are filled by the first Update
+	SkyRenderer();
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~SkyRenderer();
+	// A SkyRenderer owns its GL objects, so it cannot be copied
+	SkyRenderer(const SkyRenderer&) = delete;
+	SkyRenderer& operator=(const SkyRenderer&) = delete;
+
+	// Sets the world space direction towards the sun, remaking the sky view table if its elevation changed
+	// The framebuffer, viewport, program and VAO in use are restored afterwards
+	void Update(const glm::vec3& sunDirection);
+	// Draws the sky behind everything in the bound framebuffer for a camera with projection and view
+	void Draw(const glm::mat4& projection, const glm::mat4& view);
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	// Transmittance, multiple scattering and sky view tables, with the framebuffer they are drawn through
+	GLuint tables[3] = {};
+	GLuint framebuffer = 0;
+	GLuint transmittanceProgram = 0;
+	GLuint scatteringProgram = 0;
+	GLuint skyViewProgram = 0;
+	GLuint skyProgram = 0;
+	GLuint emptyVAO = 0;
+	glm::vec3 sun = glm::vec3(0.0f, 1.0f, 0.0f);
+	// Sky view table being remade, the elevation it is made for and the next band of its rows to draw, -1 when none is
+	GLuint nextSkyView = 0;
+	float nextElevation = 0.0f;
+	int nextBand = -1;
+	// Elevation the sky view table was made for, and whether the first two tables were made yet
+	float tableElevation = -2.0f;
+	bool precomputed = false;
+
+	// Draws a full screen triangle with program into target, a texture the size of table, over rows first to first + rows
+	void drawTable(GLuint program, int table, GLuint target, GLsizei first, GLsizei rows);
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include"SoftwareOcclusion.h"
+
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_OCCLUSION_SSE 1
+#include<emmintrin.h>
+#endif
+
+// The faces of a box as corners going around them, corner bit 0 picks max.x, bit 1 max.y and bit 2 max.z
+static const int BOX_FACES[6][4] = {
+	{ 0, 2, 6, 4 }, { 1, 3, 7, 5 },
+	{ 0, 1, 5, 4 }, { 2, 3, 7, 6 },
+	{ 0, 1, 3, 2 }, { 4, 5, 7, 6 },
+};
+
+// Constructor for a buffer of whole tiles
+SoftwareOcclusion::SoftwareOcclusion(int width, int height)
+{
+	tilesX = std::max(1, (width + TILE_WIDTH - 1) / TILE_WIDTH);
+	tilesY = std::max(1, (height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+	bufferWidth = tilesX * TILE_WIDTH;
+	bufferHeight = tilesY * TILE_HEIGHT;
+	depth.assign((size_t)bufferWidth * bufferHeight, 0.0f);
+	tileFarthest.assign((size_t)tilesX * tilesY, 0.0f);
+}
+
+// Adds the front faces of a box as triangles in pixels
+bool SoftwareOcclusion::addBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& eye)
+{
+	glm::vec3 screen[8];
+	for (int c = 0; c < 8; c++)
+	{
+		glm::vec4 clip = matrix * glm::vec4(c & 1 ? max.x : min.x, c & 2 ? max.y : min.y, c & 4 ? max.z : min.z, 1.0f);
+		if (clip.w < nearPlane)
+			return false;
+		float inverseW = 1.0f / clip.w;
+		screen[c] = glm::vec3((clip.x * inverseW * 0.5f + 0.5f) * bufferWidth, (clip.y * inverseW * 0.5f + 0.5f) * bufferHeight, inverseW);
+	}
+
+	// A face is turned to the eye when the eye is outside the box on its side, which also skips every face of a box
+	// the eye is inside of, a box like that could only hide what is in it
+	const bool facing[6] = { eye.x < min.x, eye.x > max.x, eye.y < min.y, eye.y > max.y, eye.z < min.z, eye.z > max.z };
+	for (int f = 0; f < 6; f++)
+	{
+		if (!facing[f])
+			continue;
+		for (int t = 0; t < 2; t++)
+		{
+			glm::vec3 v[3] = { screen[BOX_FACES[f][0]], screen[BOX_FACES[f][t + 1]], screen[BOX_FACES[f][t + 2]] };
+			float area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+			// Either winding is drawn, so the faces need no consistent order
+			if (area < 0.0f)
+			{
+				std::swap(v[1], v[2]);
+				area = -area;
+			}
+			if (area < 1e-6f)
+				continue;
+
+			Triangle triangle;
+			triangle.minX = std::max(0, (int)std::floor(std::min({ v[0].x, v[1].x, v[2].x })));
+			triangle.maxX = std::min(bufferWidth - 1, (int)std::ceil(std::max({ v[0].x, v[1].x, v[2].x })));
+			triangle.minY = std::max(0, (int)std::floor(std::min({ v[0].y, v[1].y, v[2].y })));
+			triangle.maxY = std::min(bufferHeight - 1, (int)std::ceil(std::max({ v[0].y, v[1].y, v[2].y })));
+			if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+				continue;
+			// Edge i is the one across from vertex i, positive inside, and 1 / w is the vertices' weighted by them
+			triangle.depthX = triangle.depthY = triangle.depth0 = 0.0f;
+			for (int e = 0; e < 3; e++)
+			{
+				const glm::vec3& a = v[(e + 1) % 3];
+				const glm::vec3& b = v[(e + 2) % 3];
+				triangle.edgeX[e] = a.y - b.y;
+				triangle.edgeY[e] = b.x - a.x;
+				triangle.edge0[e] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+				triangle.depthX += triangle.edgeX[e] * v[e].z / area;
+				triangle.depthY += triangle.edgeY[e] * v[e].z / area;
+				triangle.depth0 += triangle.edge0[e] * v[e].z / area;
+			}
+			triangles.push_back(triangle);
+		}
+	}
+	return true;
+}
+
+// Draws the triangles into the rows of one row of tiles, at pixel centers, keeping the nearest depth
+void SoftwareOcclusion::rasterizeRow(int tileRow)
+{
+	const int firstY = tileRow * TILE_HEIGHT;
+	const int endY = firstY + TILE_HEIGHT;
+	float* rows = depth.data() + (size_t)firstY * bufferWidth;
+	std::fill(rows, rows + (size_t)TILE_HEIGHT * bufferWidth, 0.0f);
+
+	for (const Triangle& triangle : triangles)
+	{
+		if (triangle.maxY < firstY || triangle.minY >= endY)
+			continue;
+		int y0 = std::max(triangle.minY, firstY);
+		int y1 = std::min(triangle.maxY, endY - 1);
+		// Rows are a whole number of tiles wide, so four pixels from a multiple of four never run past the end
+		int x0 = triangle.minX & ~3;
+		for (int y = y0; y <= y1; y++)
+		{
+			float py = y + 0.5f;
+			float rowEdge[3];
+			for (int e = 0; e < 3; e++)
+				rowEdge[e] = triangle.edgeY[e] * py + triangle.edge0[e];
+			float rowDepth = triangle.depthY * py + triangle.depth0;
+			float* row = depth.data() + (size_t)y * bufferWidth;
+			int x = x0;
+#ifdef SOFTWARE_OCCLUSION_SSE
+			const __m128 steps = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 edgeX0 = _mm_set1_ps(triangle.edgeX[0]), edgeX1 = _mm_set1_ps(triangle.edgeX[1]), edgeX2 = _mm_set1_ps(triangle.edgeX[2]);
+			const __m128 edgeRow0 = _mm_set1_ps(rowEdge[0]), edgeRow1 = _mm_set1_ps(rowEdge[1]), edgeRow2 = _mm_set1_ps(rowEdge[2]);
+			const __m128 depthX = _mm_set1_ps(triangle.depthX), depthRow = _mm_set1_ps(rowDepth);
+			for (; x <= triangle.maxX; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), steps);
+				__m128 inside = _mm_and_ps(
+					_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX0, px), edgeRow0), zero), _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX1, px), edgeRow1), zero)),
+					_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX2, px), edgeRow2), zero));
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearer = _mm_max_ps(old, _mm_add_ps(_mm_mul_ps(depthX, px), depthRow));
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+			}
+#endif
+			// Scalar path for the pixels left, or all of them without SSE
+			for (; x <= triangle.maxX; x++)
+			{
+				float px = x + 0.5f;
+				if (triangle.edgeX[0] * px + rowEdge[0] >= 0.0f && triangle.edgeX[1] * px + rowEdge[1] >= 0.0f && triangle.edgeX[2] * px + rowEdge[2] >= 0.0f)
+					row[x] = std::max(row[x], triangle.depthX * px + rowDepth);
+			}
+		}
+	}
+
+	for (int tx = 0; tx < tilesX; tx++)
+	{
+		float farthest = rows[tx * TILE_WIDTH];
+		for (int y = 0; y < TILE_HEIGHT; y++)
+			for (int x = 0; x < TILE_WIDTH; x++)
+				farthest = std::min(farthest, rows[(size_t)y * bufferWidth + tx * TILE_WIDTH + x]);
+		tileFarthest[(size_t)tileRow * tilesX + tx] = farthest;
+	}
+}
+
+// Picks the nearest candidates as occluders, sets up their triangles and rasterizes them a row of tiles per slice
+void SoftwareOcclusion::Render(JobSystem& jobs, const glm::mat4& matrix, const glm::vec3& eye, const BoundingBoxes& boxes, const uint32_t* candidates, size_t count)
+{
+	SoftwareOcclusion::matrix = matrix;
+	nearest.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t b = candidates[i];
+		glm::vec3 min(boxes.minX[b], boxes.minY[b], boxes.minZ[b]);
+		glm::vec3 max(boxes.maxX[b], boxes.maxY[b], boxes.maxZ[b]);
+		glm::vec3 offset = glm::clamp(eye, min, max) - eye;
+		nearest[i] = std::make_pair(glm::dot(offset, offset), b);
+	}
+	if (nearest.size() > maxOccluders)
+	{
+		std::nth_element(nearest.begin(), nearest.begin() + maxOccluders, nearest.end());
+		nearest.resize(maxOccluders);
+	}
+
+	triangles.clear();
+	occluders = 0;
+	for (const std::pair<float, uint32_t>& occluder : nearest)
+	{
+		uint32_t b = occluder.second;
+		if (addBox(glm::vec3(boxes.minX[b], boxes.minY[b], boxes.minZ[b]), glm::vec3(boxes.maxX[b], boxes.maxY[b], boxes.maxZ[b]), eye))
+			occluders++;
+	}
+
+	jobs.ParallelFor((size_t)tilesY, 1, [&](size_t, size_t begin, size_t end) {
+		for (size_t row = begin; row < end; row++)
+			rasterizeRow((int)row);
+	});
+}
+
+// Checks the pixels under a box's rectangle for one that is not nearer than the box
+bool SoftwareOcclusion::TestBox(const glm::vec3& min, const glm::vec3& max) const
+{
+	float minW = INFINITY;
+	glm::vec2 low(INFINITY), high(-INFINITY);
+	for (int c = 0; c < 8; c++)
+	{
+		glm::vec4 clip = matrix * glm::vec4(c & 1 ? max.x : min.x, c & 2 ? max.y : min.y, c & 4 ? max.z : min.z, 1.0f);
+		if (clip.w < nearPlane)
+			return true;
+		minW = std::min(minW, clip.w);
+		glm::vec2 screen = (glm::vec2(clip) / clip.w * 0.5f + 0.5f) * glm::vec2((float)bufferWidth, (float)bufferHeight);
+		low = glm::min(low, screen);
+		high = glm::max(high, screen);
+	}
+	int x0 = std::max(0, (int)std::floor(low.x));
+	int x1 = std::min(bufferWidth - 1, (int)std::floor(high.x));
+	int y0 = std::max(0, (int)std::floor(low.y));
+	int y1 = std::min(bufferHeight - 1, (int)std::floor(high.y));
+	// Off the buffer altogether, which the frustum lets through at its edges, the box is kept
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	// w is linear over the box, so its nearest point is a corner
+	const float boxDepth = 1.0f / minW;
+	for (int ty = y0 / TILE_HEIGHT; ty <= y1 / TILE_HEIGHT; ty++)
+	{
+		for (int tx = x0 / TILE_WIDTH; tx <= x1 / TILE_WIDTH; tx++)
+		{
+			// Everything in the tile is nearer than the box
+			if (tileFarthest[(size_t)ty * tilesX + tx] > boxDepth)
+				continue;
+			int firstY = std::max(y0, ty * TILE_HEIGHT), lastY = std::min(y1, ty * TILE_HEIGHT + TILE_HEIGHT - 1);
+			int firstX = std::max(x0, tx * TILE_WIDTH), lastX = std::min(x1, tx * TILE_WIDTH + TILE_WIDTH - 1);
+			for (int y = firstY; y <= lastY; y++)
+			{
+				const float* row = depth.data() + (size_t)y * bufferWidth;
+				for (int x = firstX; x <= lastX; x++)
+					if (row[x] <= boxDepth)
+						return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Tests the candidates in slices, each keeps its survivors at the start of its own range, then closes the gaps
+size_t SoftwareOcclusion::Cull(JobSystem& jobs, const BoundingBoxes& boxes, uint32_t* candidates, size_t count)
+{
+	size_t slices = jobs.Slices(count, TEST_GRAIN);
+	sliceCounts.assign(slices, 0);
+	jobs.ParallelFor(count, TEST_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+		size_t kept = begin;
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t b = candidates[i];
+			if (TestBox(glm::vec3(boxes.minX[b], boxes.minY[b], boxes.minZ[b]), glm::vec3(boxes.maxX[b], boxes.maxY[b], boxes.maxZ[b])))
+				candidates[kept++] = b;
+		}
+		sliceCounts[slice] = kept - begin;
+	});
+	size_t visible = 0;
+	for (size_t slice = 0; slice < slices; slice++)
+	{
+		const uint32_t* kept = candidates + JobSystem::SliceStart(count, slices, slice);
+		std::memmove(candidates + visible, kept, sliceCounts[slice] * sizeof(uint32_t));
+		visible += sliceCounts[slice];
+	}
+	return visible;
+}
+
+// Number of boxes the last Render drew
+size_t SoftwareOcclusion::occluderCount() const
+{
+	return occluders;
+}
+
+// Number of triangles the last Render drew
+size_t SoftwareOcclusion::triangleCount() const
+{
+	return triangles.size();
+}
+
+int SoftwareOcclusion::width() const
+{
+	return bufferWidth;
+}
+
+int SoftwareOcclusion::height() const
+{
+	return bufferHeight;
+}
@@ -0,0 +1,77 @@
+#ifndef SOFTWARE_OCCLUSION_CLASS_H
+#define SOFTWARE_OCCLUSION_CLASS_H
+
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+#include"Frustum.h"
+#include"JobSystem.h"
+
+// Occlusion culling on the CPU, before anything reaches the GPU, for when there is no compute driven Hi-Z
+// The nearest buildings that passed the frustum are drawn as boxes into a small depth buffer, only the faces turned
+// to the eye, and every candidate's box is then tested against it in the same frame. The buffer holds 1 / w, which is
+// linear across a triangle on screen, so the nearest depth wins and 0 means nothing was drawn. It is rasterized four
+// pixels at a time with SSE where there is SSE, by the job system's workers each taking a row of tiles, and every tile
+// keeps the farthest depth in it so a box is usually decided by its tiles alone.
+// Occluders are not clipped: a box reaching behind nearPlane is not drawn, and a box tested there is always kept.
+class SoftwareOcclusion
+{
+public:
+	// Size of the tiles the farthest depth is kept for, a row of tiles is what one worker rasterizes
+	static constexpr int TILE_WIDTH = 8;
+	static constexpr int TILE_HEIGHT = 8;
+	// Smallest number of candidates a worker tests
+	static constexpr size_t TEST_GRAIN = 1024;
+
+	// Most boxes drawn into the buffer each frame, the nearest ones of the candidates
+	size_t maxOccluders = 256;
+	// Clip space w below which a box counts as reaching behind the eye
+	float nearPlane = 0.1f;
+
+	// Constructor for a buffer of width by height pixels, rounded up to whole tiles
+	SoftwareOcclusion(int width, int height);
+
+	// Clears the buffer and draws the boxes of the maxOccluders candidates nearest to eye, with matrix taking the boxes
+	// to clip space and eye in the same space as the boxes
+	void Render(JobSystem& jobs, const glm::mat4& matrix, const glm::vec3& eye, const BoundingBoxes& boxes, const uint32_t* candidates, size_t count);
+	// Keeps the candidates whose box is not hidden behind what Render drew, in their order, and returns how many
+	size_t Cull(JobSystem& jobs, const BoundingBoxes& boxes, uint32_t* candidates, size_t count);
+	// Checks if any part of a box may be in front of what Render drew
+	bool TestBox(const glm::vec3& min, const glm::vec3& max) const;
+
+	// Number of boxes and triangles the last Render drew
+	size_t occluderCount() const;
+	size_t triangleCount() const;
+	int width() const;
+	int height() const;
+private:
+	// A triangle set up for rasterizing: three edge functions and the plane of 1 / w, all in pixels, and its bounds
+	struct Triangle
+	{
+		float edgeX[3], edgeY[3], edge0[3];
+		float depthX, depthY, depth0;
+		int minX, maxX, minY, maxY;
+	};
+
+	int bufferWidth = 0;
+	int bufferHeight = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+	// 1 / w of every pixel, and the smallest of every tile
+	std::vector<float> depth;
+	std::vector<float> tileFarthest;
+	glm::mat4 matrix = glm::mat4(1.0f);
+	std::vector<Triangle> triangles;
+	std::vector<std::pair<float, uint32_t>> nearest;
+	size_t occluders = 0;
+	std::vector<size_t> sliceCounts;
+
+	// Adds the triangles of a box's faces that are turned to eye, unless the box reaches behind nearPlane
+	bool addBox(const glm::vec3& min, const glm::vec3& max, const glm::vec3& eye);
+	// Draws every triangle into one row of tiles and finds the farthest depth of its tiles
+	void rasterizeRow(int tileRow);
+};
+
+#endif
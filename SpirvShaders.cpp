@@ -0,0 +1,100 @@
+#include"SpirvShaders.h"
+#include"GLExtensions.h"
+#include"LogQueue.h"
+
+#include<filesystem>
+#include<fstream>
+#include<vector>
+#include<cstdio>
+
+namespace fs = std::filesystem;
+
+std::string SpirvShaders::directory = "spirv";
+bool SpirvShaders::enabled = true;
+bool SpirvShaders::dumping = false;
+
+// First word of every SPIR-V module
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+// Hash the SPIR-V of a source is stored under
+uint64_t SpirvShaders::Key(const std::string& source)
+{
+	// 64 bit FNV-1a
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (unsigned char c : source)
+	{
+		hash ^= c;
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+// GLSL file of a stage
+std::string SpirvShaders::path(GLenum stage, uint64_t key)
+{
+	// glslangValidator tells the stage by the extension
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.%s", (unsigned long long)key, stage == GL_VERTEX_SHADER ? "vert" : "frag");
+	return (fs::path(directory) / name).string();
+}
+
+// Creates a shader object from the SPIR-V of this source
+GLuint SpirvShaders::Load(GLenum stage, const std::string& source)
+{
+	if (!enabled || !GLExt.spirv)
+		return 0;
+	std::string file = path(stage, Key(source)) + ".spv";
+	std::ifstream in(file, std::ios::binary | std::ios::ate);
+	if (!in)
+		return 0;
+	std::streamsize size = in.tellg();
+	if (size < 20 || size % 4 != 0)
+		return 0;
+	std::vector<uint32_t> words((size_t)size / 4);
+	in.seekg(0);
+	if (!in.read((char*)words.data(), size) || words[0] != SPIRV_MAGIC)
+		return 0;
+
+	GLuint shader = glCreateShader(stage);
+	glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, words.data(), (GLsizei)size);
+	// Nothing is specialized, every permutation was compiled with its own defines
+	glSpecializeShader(shader, "main", 0, nullptr, nullptr);
+	GLint compiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (compiled != GL_TRUE)
+	{
+		char infoLog[512];
+		glGetShaderInfoLog(shader, sizeof(infoLog), nullptr, infoLog);
+		LOG_MESSAGE(LOG_WARNING, "Rejected SPIR-V %s, compiling the GLSL instead\n%s", file.c_str(), infoLog);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+// Creates both stages of a program from SPIR-V or neither
+bool SpirvShaders::Load(const std::string& vertexSource, const std::string& fragmentSource, GLuint& vertexShader, GLuint& fragmentShader)
+{
+	vertexShader = Load(GL_VERTEX_SHADER, vertexSource);
+	fragmentShader = vertexShader ? Load(GL_FRAGMENT_SHADER, fragmentSource) : 0;
+	if (vertexShader && fragmentShader)
+		return true;
+	if (vertexShader)
+		glDeleteShader(vertexShader);
+	vertexShader = fragmentShader = 0;
+	return false;
+}
+
+// Writes the GLSL of both stages when dumping
+bool SpirvShaders::Dump(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	if (!dumping)
+		return false;
+	std::error_code error;
+	fs::create_directories(directory, error);
+	std::ofstream vertex(path(GL_VERTEX_SHADER, Key(vertexSource)), std::ios::binary | std::ios::trunc);
+	vertex << vertexSource;
+	std::ofstream fragment(path(GL_FRAGMENT_SHADER, Key(fragmentSource)), std::ios::binary | std::ios::trunc);
+	fragment << fragmentSource;
+	return vertex && fragment;
+}
@@ -0,0 +1,39 @@
+#ifndef SPIRV_SHADERS_CLASS_H
+#define SPIRV_SHADERS_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<string>
+
+// Shaders compiled to SPIR-V ahead of time and handed to the driver as binaries, which skips its GLSL front end
+// A SPIR-V file is named after a hash of the final GLSL of a stage, includes resolved and features defined, so it
+// always matches the source it came from and an edited shader simply falls back to the GLSL. With dumping on every
+// stage built writes that GLSL next to where its SPIR-V is looked for, and the offline step compiles each file with
+//   glslangValidator -G --auto-map-locations --auto-map-bindings -o <file>.spv <file>
+//   spirv-opt -O <file>.spv -o <file>.spv
+// Feature masks change the inputs and outputs of a shader, so each permutation is its own file rather than one
+// binary with specialization constants. Both stages of a program come from SPIR-V or neither, GL cannot link a mix.
+class SpirvShaders
+{
+public:
+	// Directory the GLSL is dumped to and the SPIR-V read from, relative to the working directory
+	static std::string directory;
+	// Turns SPIR-V off, every shader is compiled from GLSL
+	static bool enabled;
+	// Writes the GLSL of every stage built for the offline step
+	static bool dumping;
+
+	// Creates a shader object from the SPIR-V of this source, returns 0 when there is none or the driver rejects it
+	static GLuint Load(GLenum stage, const std::string& source);
+	// Same for both stages of a program, either both are created or neither
+	static bool Load(const std::string& vertexSource, const std::string& fragmentSource, GLuint& vertexShader, GLuint& fragmentShader);
+	// Writes the GLSL of both stages of a program when dumping, returns false if it could not be written
+	static bool Dump(const std::string& vertexSource, const std::string& fragmentSource);
+	// Hash the SPIR-V of a source is stored under, it does not depend on the driver
+	static uint64_t Key(const std::string& source);
+private:
+	// GLSL file of a stage, its SPIR-V has ".spv" appended
+	static std::string path(GLenum stage, uint64_t key);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include"StartupTimer.h"
+#include"TraceRecorder.h"
+
+#include<iostream>
+#include<string>
+
+// Constructor that starts the first phase
+StartupTimer::StartupTimer()
+{
+	start = last = std::chrono::steady_clock::now();
+}
+
+// Ends the current phase
+void StartupTimer::Mark(const char* name)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	marked.push_back({ name, std::chrono::duration<double, std::milli>(now - last).count() });
+	Tracer.Add(name, "startup", last, now);
+	last = now;
+}
+
+// Notes the first frame
+void StartupTimer::FirstFrame()
+{
+	if (presented)
+		return;
+	firstFrame = std::chrono::steady_clock::now();
+	presented = true;
+}
+
+double StartupTimer::firstFrameMilliseconds() const
+{
+	if (!presented)
+		return -1.0;
+	return std::chrono::duration<double, std::milli>(firstFrame - start).count();
+}
+
+// Prints the phases
+void StartupTimer::Print() const
+{
+	std::cout << "Startup:";
+	for (size_t i = 0; i < marked.size(); i++)
+		std::cout << (i > 0 ? "," : "") << " " << marked[i].name << " " << marked[i].milliseconds << " ms";
+	if (presented)
+		std::cout << ", first frame after " << firstFrameMilliseconds() << " ms";
+	std::cout << std::endl;
+}
+
+// Sets the metrics
+void StartupTimer::Report(BenchmarkReport& report) const
+{
+	for (const Phase& phase : marked)
+	{
+		std::string name = phase.name;
+		for (char& c : name)
+			if (c == ' ')
+				c = '_';
+		report.Set("startup_" + name + "_ms", phase.milliseconds);
+	}
+	if (presented)
+		report.Set("time_to_first_frame_ms", firstFrameMilliseconds());
+}
@@ -0,0 +1,49 @@
+#ifndef STARTUP_TIMER_CLASS_H
+#define STARTUP_TIMER_CLASS_H
+
+#include<chrono>
+#include<cstddef>
+#include<vector>
+
+#include"BenchmarkReport.h"
+
+// Times the phases of startup one after the other from the start of the program to the first frame presented
+// Each Mark ends the phase that ran since the one before, it goes onto the timeline as a zone of the "startup"
+// category so it lines up with the jobs the workers ran meanwhile. Phases are marked on the thread running main,
+// only FirstFrame comes from the render thread and is read once that thread is joined.
+class StartupTimer
+{
+public:
+	// A phase and how long it took
+	struct Phase
+	{
+		const char* name;
+		double milliseconds;
+	};
+
+	// Constructor that starts the first phase
+	StartupTimer();
+
+	// Ends the current phase and starts the next, name has to outlive the timer
+	void Mark(const char* name);
+	// Notes the first frame presented, later calls do nothing
+	void FirstFrame();
+
+	// Phases marked so far
+	const std::vector<Phase>& phases() const { return marked; }
+	// Milliseconds from the start to the first frame, negative until there was one
+	double firstFrameMilliseconds() const;
+
+	// Prints one line with every phase and the time to the first frame
+	void Print() const;
+	// Sets startup_<phase>_ms for each phase and time_to_first_frame_ms, spaces in names become underscores
+	void Report(BenchmarkReport& report) const;
+private:
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point last;
+	std::chrono::steady_clock::time_point firstFrame;
+	bool presented = false;
+	std::vector<Phase> marked;
+};
+
+#endif
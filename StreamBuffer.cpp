@@ -0,0 +1,153 @@
+#include"StreamBuffer.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<utility>
+
+// Constructor that allocates all regions
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr regionSize)
+{
+	StreamBuffer::target = target;
+	StreamBuffer::regionSize = regionSize;
+	persistent = GLExt.bufferStorage;
+
+	glGenBuffers(1, &ID);
+	GLState.BindBuffer(target, ID);
+	if (persistent)
+	{
+		// Immutable storage that stays mapped, with coherent writes the GPU sees them without any flush
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, regionSize * REGIONS, nullptr, flags);
+		mapping = (char*)glMapBufferRange(target, 0, regionSize * REGIONS, flags);
+	}
+	else
+	{
+		glBufferData(target, regionSize * REGIONS, nullptr, GL_STREAM_DRAW);
+	}
+	GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, ID, regionSize * REGIONS);
+}
+
+// Deletes the buffer and its fences unless Delete was already called
+StreamBuffer::~StreamBuffer()
+{
+	Delete();
+}
+
+// Takes over the buffer, mapping and fences of another ring, which is left empty
+StreamBuffer::StreamBuffer(StreamBuffer&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+// Deletes the current buffer and takes over the one of another ring
+StreamBuffer& StreamBuffer::operator=(StreamBuffer&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = std::exchange(other.ID, 0);
+		target = other.target;
+		regionSize = other.regionSize;
+		persistent = other.persistent;
+		scheduler = other.scheduler;
+		region = other.region;
+		mapping = std::exchange(other.mapping, nullptr);
+		for (int i = 0; i < REGIONS; i++)
+		{
+			fences[i] = std::exchange(other.fences[i], nullptr);
+			frames[i] = std::exchange(other.frames[i], 0);
+		}
+	}
+	return *this;
+}
+
+// Waits until the GPU is done with the next region and returns where to write this frame's data
+void* StreamBuffer::Map()
+{
+	if (scheduler && frames[region] != 0)
+	{
+		scheduler->Wait(frames[region]);
+		frames[region] = 0;
+	}
+	if (fences[region])
+	{
+		// Only blocks when the CPU is a whole ring ahead of the GPU
+		GLenum result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+		glDeleteSync(fences[region]);
+		fences[region] = nullptr;
+	}
+
+	if (persistent)
+		return mapping + Offset();
+
+	// The fence already guarantees the GPU is done, so the driver does not need to synchronize again
+	GLState.BindBuffer(target, ID);
+	return glMapBufferRange(target, Offset(), regionSize, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+}
+
+// Finishes writing the region returned by Map
+void StreamBuffer::Unmap(GLsizeiptr bytes)
+{
+	GLState.CountUpload(bytes);
+	if (persistent)
+		return;
+	GLState.BindBuffer(target, ID);
+	if (bytes > 0)
+		glFlushMappedBufferRange(target, 0, bytes);
+	glUnmapBuffer(target);
+}
+
+// Marks the region as in use by the GPU and moves on to the next one
+void StreamBuffer::Fence()
+{
+	if (fences[region])
+		glDeleteSync(fences[region]);
+	fences[region] = nullptr;
+	if (scheduler)
+		frames[region] = scheduler->frame();
+	else
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region = (region + 1) % REGIONS;
+}
+
+// Byte offset of the current region within the buffer
+GLintptr StreamBuffer::Offset() const
+{
+	return region * regionSize;
+}
+
+// Binds the buffer
+void StreamBuffer::Bind()
+{
+	GLState.BindBuffer(target, ID);
+}
+
+// Unbinds the buffer
+void StreamBuffer::Unbind()
+{
+	GLState.BindBuffer(target, 0);
+}
+
+// Deletes the buffer and its fences
+void StreamBuffer::Delete()
+{
+	for (int i = 0; i < REGIONS; i++)
+	{
+		if (fences[i])
+			glDeleteSync(fences[i]);
+		fences[i] = nullptr;
+		frames[i] = 0;
+	}
+	if (ID == 0)
+		return;
+	if (persistent)
+	{
+		GLState.BindBuffer(target, ID);
+		glUnmapBuffer(target);
+	}
+	GLState.DeleteBuffers(1, &ID);
+	ID = 0;
+	mapping = nullptr;
+}
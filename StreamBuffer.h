@@ -0,0 +1,67 @@
+#ifndef STREAM_BUFFER_CLASS_H
+#define STREAM_BUFFER_CLASS_H
+
+#include<glad/glad.h>
+
+#include<cstdint>
+
+#include"FrameScheduler.h"
+#include"GLExtensions.h"
+
+// Ring of buffer regions for data that changes every frame, such as instance transforms or debug lines
+// The CPU writes one region while the GPU may still read the previous ones, fences keep them apart. Given a
+// FrameScheduler the ring fences nothing itself, a region is reused once the scheduler's fence of the frame that
+// last used it has passed, which the frames in flight it allows already guarantee unless a frame goes around the ring
+class StreamBuffer
+{
+public:
+	// Number of regions in the ring, one being written and up to two in flight on the GPU
+	static constexpr int REGIONS = 3;
+
+	// Reference ID of the buffer object
+	GLuint ID = 0;
+	// Bind target, such as GL_ARRAY_BUFFER or GL_UNIFORM_BUFFER
+	GLenum target = 0;
+	// Size in bytes of each region
+	GLsizeiptr regionSize = 0;
+	// True when the buffer stays mapped for its whole life (GL 4.4), otherwise each region is mapped per frame
+	bool persistent = false;
+	// Scheduler whose frame fences recycle the regions, nullptr fences every region on its own
+	FrameScheduler* scheduler = nullptr;
+
+	// Constructor that allocates all regions, regionSize should be a multiple of the alignment the data needs
+	StreamBuffer(GLenum target, GLsizeiptr regionSize);
+	// Deletes the buffer and its fences unless Delete was already called, the context has to still be current
+	~StreamBuffer();
+	// A StreamBuffer owns its buffer, mapping and fences, so it can be moved but not copied
+	StreamBuffer(const StreamBuffer&) = delete;
+	StreamBuffer& operator=(const StreamBuffer&) = delete;
+	StreamBuffer(StreamBuffer&& other) noexcept;
+	StreamBuffer& operator=(StreamBuffer&& other) noexcept;
+
+	// Waits until the GPU is done with the next region and returns where to write this frame's data
+	void* Map();
+	// Finishes writing the region returned by Map, bytes is how much of it was written
+	void Unmap(GLsizeiptr bytes);
+	// Marks the region as in use by the GPU, call right after the last draw reading it
+	void Fence();
+	// Byte offset of the current region within the buffer, to add to attribute pointers or glBindBufferRange
+	GLintptr Offset() const;
+
+	// Binds the buffer
+	void Bind();
+	// Unbinds the buffer
+	void Unbind();
+	// Deletes the buffer and its fences, does nothing if it was already deleted or moved from
+	void Delete();
+private:
+	// Region currently being written
+	int region = 0;
+	// Start of the persistent mapping
+	char* mapping = nullptr;
+	// Fence placed after the last use of each region, or with a scheduler the frame that last used it, 0 for none
+	GLsync fences[REGIONS] = {};
+	uint64_t frames[REGIONS] = {};
+};
+
+#endif
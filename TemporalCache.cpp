@@ -0,0 +1,263 @@
+#include"TemporalCache.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"LogQueue.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+
+// Full screen triangle, every pixel of the history is resolved once
+static const char* resolveVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+// Reprojects a pixel's history bilinearly from the taps that saw the same surface and blends the fresh value into it
+static const char* resolveFragmentSource = R"(
+#version 330 core
+uniform sampler2D sparse;
+uniform sampler2D history;
+uniform sampler2D depth;
+uniform mat4 inverseProjection;
+// From this frame's view space to the clip space and the view space of the frame before
+uniform mat4 reprojection;
+uniform mat4 toPreviousView;
+// 1 when the scene was drawn reverse-Z, its depth is then already the clip space depth
+uniform int reverseZ;
+uniform int depthScale;
+uniform int depthChannel;
+uniform ivec2 phase;
+// Size of the history, 0 when there is none yet
+uniform ivec2 historySize;
+uniform float feedback;
+uniform float depthTolerance;
+
+out vec4 Result;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 depthSize = textureSize(depth, 0);
+    ivec2 depthPixel = min(pixel * depthScale, depthSize - 1);
+    // This frame's value of the block, the pixel's own when it was drawn and its neighbour's otherwise
+    vec4 fresh = texelFetch(sparse, min(pixel / 2, textureSize(sparse, 0) - 1), 0);
+    float d = texelFetch(depth, depthPixel, 0).r;
+    vec2 uv = (vec2(depthPixel) + 0.5) / vec2(depthSize);
+    vec4 view = inverseProjection * vec4(uv * 2.0 - 1.0, reverseZ != 0 ? d : d * 2.0 - 1.0, 1.0);
+    // Reverse-Z without a far plane puts the background at infinity, it has nothing to reproject
+    if (abs(view.w) < 1e-20)
+    {
+        Result = fresh;
+        return;
+    }
+    vec3 viewPos = view.xyz / view.w;
+
+    vec4 clip = reprojection * vec4(viewPos, 1.0);
+    float expected = (toPreviousView * vec4(viewPos, 1.0)).z;
+    vec2 texel = (clip.xy / clip.w * 0.5 + 0.5) * vec2(historySize) - 0.5;
+    ivec2 base = ivec2(floor(texel));
+    vec2 f = texel - vec2(base);
+    vec4 sum = vec4(0.0);
+    float total = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        ivec2 tap = base + ivec2(i & 1, i >> 1);
+        if (clip.w <= 0.0 || any(lessThan(tap, ivec2(0))) || any(greaterThanEqual(tap, historySize)))
+            continue;
+        vec4 value = texelFetch(history, tap, 0);
+        // A tap of another surface, the point was hidden behind it or it has moved away
+        if (abs(value[depthChannel] - expected) > depthTolerance * abs(expected))
+            continue;
+        float weight = ((i & 1) != 0 ? f.x : 1.0 - f.x) * ((i >> 1) != 0 ? f.y : 1.0 - f.y);
+        sum += value * weight;
+        total += weight;
+    }
+
+    vec4 result = fresh;
+    if (total > 0.01)
+    {
+        vec4 previous = sum / total;
+        result = (pixel & 1) == phase ? mix(fresh, previous, feedback) : previous;
+    }
+    result[depthChannel] = viewPos.z;
+    Result = result;
+}
+)";
+
+// Constructor that builds the resolve program
+TemporalCache::TemporalCache(GLenum format)
+	: format(format), depthChannel(format == GL_RG16F || format == GL_RG32F ? 1 : 3)
+{
+	if (format != GL_RG16F && format != GL_RG32F && format != GL_RGBA16F && format != GL_RGBA32F)
+		LOG_MESSAGE(LOG_ERROR, "Temporal cache format %04x is not supported", format);
+
+	resolveProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, resolveVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, resolveFragmentSource, "FRAGMENT") });
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(resolveProgram);
+	glUniform1i(glGetUniformLocation(resolveProgram, "sparse"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(resolveProgram, "history"), TEXTURE_UNIT + 1);
+	glUniform1i(glGetUniformLocation(resolveProgram, "depth"), TEXTURE_UNIT + 2);
+	glUniform1i(glGetUniformLocation(resolveProgram, "depthChannel"), depthChannel);
+	GLState.UseProgram(previousProgram);
+
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+TemporalCache::~TemporalCache()
+{
+	Delete();
+}
+
+GLsizei TemporalCache::SparseSize(GLsizei size)
+{
+	return (size + 1) / 2;
+}
+
+// The camera of the frame before is kept for the reprojection
+void TemporalCache::Begin(GLsizei width, GLsizei height, const glm::mat4& projection, const glm::mat4& viewModel)
+{
+	if (width != TemporalCache::width || height != TemporalCache::height || sparseFramebuffer == 0)
+		resize(width, height);
+	previousProjection = TemporalCache::projection;
+	previousViewModel = TemporalCache::viewModel;
+	TemporalCache::projection = projection;
+	TemporalCache::viewModel = viewModel;
+	frame++;
+}
+
+// The diagonal first, so two frames already cover every row and column
+glm::ivec2 TemporalCache::Phase() const
+{
+	static const glm::ivec2 order[4] = { glm::ivec2(0, 0), glm::ivec2(1, 1), glm::ivec2(1, 0), glm::ivec2(0, 1) };
+	return order[frame % 4];
+}
+
+// Reads one history and writes the other, which the next frame reads
+GLuint TemporalCache::Resolve(GLuint depth, GLint depthScale)
+{
+	GLint previousFramebuffer, previousProgram, previousVAO;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousFramebuffer);
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+	GLState.Disable(GL_DEPTH_TEST);
+	GLState.BindVertexArray(emptyVAO);
+	glViewport(0, 0, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[current]);
+	GLState.UseProgram(resolveProgram);
+	glm::mat4 toPreviousView = previousViewModel * glm::inverse(viewModel);
+	glUniformMatrix4fv(glGetUniformLocation(resolveProgram, "inverseProjection"), 1, GL_FALSE, glm::value_ptr(glm::inverse(projection)));
+	glUniformMatrix4fv(glGetUniformLocation(resolveProgram, "reprojection"), 1, GL_FALSE, glm::value_ptr(previousProjection * toPreviousView));
+	glUniformMatrix4fv(glGetUniformLocation(resolveProgram, "toPreviousView"), 1, GL_FALSE, glm::value_ptr(toPreviousView));
+	glUniform1i(glGetUniformLocation(resolveProgram, "reverseZ"), reverseDepth ? 1 : 0);
+	glUniform1i(glGetUniformLocation(resolveProgram, "depthScale"), depthScale);
+	glm::ivec2 phase = Phase();
+	glUniform2i(glGetUniformLocation(resolveProgram, "phase"), phase.x, phase.y);
+	glUniform2i(glGetUniformLocation(resolveProgram, "historySize"), valid ? width : 0, valid ? height : 0);
+	glUniform1f(glGetUniformLocation(resolveProgram, "feedback"), feedback);
+	glUniform1f(glGetUniformLocation(resolveProgram, "depthTolerance"), depthTolerance);
+	GLState.CountUniforms(9);
+	const GLuint inputs[3] = { sparse, histories[1 - current], depth };
+	for (GLuint i = 0; i < 3; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, inputs[i]);
+	}
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+	for (GLuint i = 0; i < 3; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+	GLuint result = histories[current];
+	current = 1 - current;
+	valid = true;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previousFramebuffer);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+	return result;
+}
+
+// The next Resolve only has the fresh pixels to go by
+void TemporalCache::Reset()
+{
+	valid = false;
+	frame = 0;
+}
+
+// Reallocates the targets for a new size
+void TemporalCache::resize(GLsizei width, GLsizei height)
+{
+	deleteTargets();
+	TemporalCache::width = width;
+	TemporalCache::height = height;
+
+	// Texels are only ever fetched, never filtered, the reprojection weighs the taps itself
+	GLenum pixelFormat = depthChannel == 1 ? GL_RG : GL_RGBA;
+	GLuint* textures[3] = { &sparse, &histories[0], &histories[1] };
+	GLuint* targetFramebuffers[3] = { &sparseFramebuffer, &framebuffers[0], &framebuffers[1] };
+	for (int i = 0; i < 3; i++)
+	{
+		GLsizei targetWidth = i == 0 ? SparseSize(width) : width;
+		GLsizei targetHeight = i == 0 ? SparseSize(height) : height;
+		glGenTextures(1, textures[i]);
+		GLState.BindTexture(GL_TEXTURE_2D, *textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, targetWidth, targetHeight, 0, pixelFormat, GL_FLOAT, nullptr);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, *textures[i], GpuMemoryTracker::ImageBytes(format, targetWidth, targetHeight));
+		glGenFramebuffers(1, targetFramebuffers[i]);
+		glBindFramebuffer(GL_FRAMEBUFFER, *targetFramebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, *textures[i], 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			LOG_MESSAGE(LOG_ERROR, "Temporal cache framebuffer is incomplete");
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	Reset();
+}
+
+// Deletes the targets and their framebuffers
+void TemporalCache::deleteTargets()
+{
+	GLuint* textures[3] = { &sparse, &histories[0], &histories[1] };
+	GLuint* targetFramebuffers[3] = { &sparseFramebuffer, &framebuffers[0], &framebuffers[1] };
+	for (int i = 0; i < 3; i++)
+	{
+		if (*textures[i] != 0)
+			GLState.DeleteTextures(1, textures[i]);
+		if (*targetFramebuffers[i] != 0)
+			glDeleteFramebuffers(1, targetFramebuffers[i]);
+		*textures[i] = *targetFramebuffers[i] = 0;
+	}
+	width = height = 0;
+	valid = false;
+}
+
+// Deletes the GL objects
+void TemporalCache::Delete()
+{
+	deleteTargets();
+	if (resolveProgram != 0)
+		GLState.DeleteProgram(resolveProgram);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	resolveProgram = emptyVAO = 0;
+}
@@ -0,0 +1,90 @@
+#ifndef TEMPORAL_CACHE_CLASS_H
+#define TEMPORAL_CACHE_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+// History of an expensive screen space effect, so it only has to work out a quarter of its pixels every frame. The
+// pixels are split into 2 by 2 blocks and each frame the effect draws one pixel of every block, a different one every
+// frame in a checkerboard order, into a sparse target of a quarter the size. Resolve then reprojects the history of
+// every pixel from where its point was the frame before, with the camera given to the last Begin, and blends the fresh
+// pixels into it. A history tap is rejected when the view depth it recorded differs from the point's, the surface was
+// hidden then, and a pixel left without history takes the fresh value of its block, so it converges over four frames.
+// The effect keeps its value in the first channels of the format and the view depth of the pixel, negative in front of
+// the camera, in the last, which Resolve fills in from the depth buffer.
+class TemporalCache
+{
+public:
+	// The sparse target, the history and the depth buffer are bound to this texture unit and the two after it while
+	// the history is resolved, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 28;
+
+	// Set when the scene is drawn reverse-Z, see ReverseDepth.h
+	bool reverseDepth = false;
+	// Share of a fresh pixel's value that comes from its history, higher is smoother and slower to follow changes
+	float feedback = 0.8f;
+	// Largest difference of the view depth a history tap may have to the point, relative to its depth
+	float depthTolerance = 0.05f;
+
+	// Constructor that builds the resolve program for the history of an internal format, one of GL_RG16F, GL_RG32F,
+	// GL_RGBA16F and GL_RGBA32F. The targets are made by the first Begin
+	TemporalCache(GLenum format);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~TemporalCache();
+	// A TemporalCache owns its GL objects, so it cannot be copied
+	TemporalCache(const TemporalCache&) = delete;
+	TemporalCache& operator=(const TemporalCache&) = delete;
+
+	// Size of the sparse target for a side of size
+	static GLsizei SparseSize(GLsizei size);
+
+	// Starts a frame of width by height pixels seen with projection and viewModel, picks the pixel of every block to
+	// update and reallocates the targets, dropping the history, when the size changed
+	void Begin(GLsizei width, GLsizei height, const glm::mat4& projection, const glm::mat4& viewModel);
+	// Pixel of every block the effect draws this frame, pixel (x, y) of the sparse target stands for pixel
+	// (2x, 2y) + Phase of the full size
+	glm::ivec2 Phase() const;
+	// Frames begun since the history was last dropped, effects that sample randomly can turn their pattern with it
+	unsigned int Frame() const { return frame; }
+	// Framebuffer with the sparse target as its color, SparseSize of the frame's size
+	GLuint SparseFramebuffer() const { return sparseFramebuffer; }
+	// Reprojects the history and blends the sparse target into it, returns the texture of the new history
+	// Every pixel's view depth comes from the top left pixel of the depthScale by depthScale block of depth it covers,
+	// which is the depth buffer the effect was drawn from. The framebuffer, viewport, program, VAO and depth test in
+	// use are restored afterwards
+	GLuint Resolve(GLuint depth, GLint depthScale = 1);
+	// Drops the history, such as after the camera jumped
+	void Reset();
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLenum format;
+	// Channel of the format that holds the view depth
+	int depthChannel;
+	GLsizei width = 0;
+	GLsizei height = 0;
+	// The sparse target, and the two histories of which current is written next and the other read
+	GLuint sparse = 0;
+	GLuint sparseFramebuffer = 0;
+	GLuint histories[2] = {};
+	GLuint framebuffers[2] = {};
+	int current = 0;
+	// Whether the other history holds a frame, and the frames begun since it was dropped
+	bool valid = false;
+	unsigned int frame = 0;
+	// Camera of this frame and of the one before
+	glm::mat4 projection = glm::mat4(1.0f);
+	glm::mat4 viewModel = glm::mat4(1.0f);
+	glm::mat4 previousProjection = glm::mat4(1.0f);
+	glm::mat4 previousViewModel = glm::mat4(1.0f);
+	GLuint resolveProgram = 0;
+	GLuint emptyVAO = 0;
+
+	// Reallocates the targets for a new size
+	void resize(GLsizei width, GLsizei height);
+	// Deletes the targets and their framebuffers
+	void deleteTargets();
+};
+
+#endif
@@ -0,0 +1,451 @@
+#include"Terrain.h"
+#include"CityGenerator.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<glm/gtc/constants.hpp>
+#include<stb/stb_image.h>
+#include<algorithm>
+#include<cfloat>
+#include<cmath>
+#include<iostream>
+
+// Range of a level in sides of its nodes, twice the range of the level below, which leaves every node more than its
+// diagonal between the two ranges to morph in
+static const float RANGE_FACTOR = 3.0f;
+
+// Value of the lattice of a noise octave at a corner, uniform in [0, 1]
+static float latticeValue(int x, int z, unsigned int seed)
+{
+	uint32_t h = (uint32_t)x * 374761393u + (uint32_t)z * 668265263u + seed * 2246822519u;
+	h = (h ^ (h >> 13)) * 1274126177u;
+	h ^= h >> 16;
+	return (float)(h & 0xffffffu) / 16777215.0f;
+}
+
+// Value noise, the lattice blended with smoothstep weights
+static float valueNoise(float x, float z, unsigned int seed)
+{
+	int x0 = (int)std::floor(x), z0 = (int)std::floor(z);
+	float fx = x - (float)x0, fz = z - (float)z0;
+	fx = fx * fx * (3.0f - 2.0f * fx);
+	fz = fz * fz * (3.0f - 2.0f * fz);
+	float top = latticeValue(x0, z0, seed) + (latticeValue(x0 + 1, z0, seed) - latticeValue(x0, z0, seed)) * fx;
+	float bottom = latticeValue(x0, z0 + 1, seed) + (latticeValue(x0 + 1, z0 + 1, seed) - latticeValue(x0, z0 + 1, seed)) * fx;
+	return top + (bottom - top) * fz;
+}
+
+// Constructor that stores the size of the square
+Terrain::Terrain(float size, float height)
+	: size(size), height(height)
+{
+	std::fill(ranges, ranges + MAX_LEVELS, 0.0f);
+}
+
+// Deletes the texture unless Delete was already called
+Terrain::~Terrain()
+{
+	Delete();
+}
+
+// Reads the heightmap from a grayscale image
+bool Terrain::Load(const std::string& path)
+{
+	// The top row stays the first, which is the -Z edge of the square
+	stbi_set_flip_vertically_on_load_thread(false);
+	int channels = 0;
+	stbi_us* pixels = stbi_load_16(path.c_str(), &width, &depth, &channels, 1);
+	if (!pixels)
+	{
+		std::cerr << "Failed to read the heightmap " << path << ": " << stbi_failure_reason() << std::endl;
+		return false;
+	}
+	if (width < 2 || depth < 2)
+	{
+		std::cerr << "The heightmap " << path << " needs at least 2x2 samples" << std::endl;
+		stbi_image_free(pixels);
+		return false;
+	}
+	samples.assign(pixels, pixels + (size_t)width * depth);
+	stbi_image_free(pixels);
+	build();
+	return true;
+}
+
+// Generates rolling hills as the heightmap
+void Terrain::Generate(int resolution, unsigned int seed)
+{
+	width = depth = std::max(resolution, 2);
+	// Six octaves of value noise, the first with four hills across the square, stretched to the full range of samples
+	std::vector<float> heights((size_t)width * depth);
+	for (int z = 0; z < depth; z++)
+		for (int x = 0; x < width; x++)
+		{
+			float value = 0.0f, amplitude = 1.0f, frequency = 4.0f;
+			for (unsigned int octave = 0; octave < 6; octave++)
+			{
+				value += amplitude * valueNoise(x * frequency / width, z * frequency / depth, seed + octave);
+				amplitude *= 0.5f;
+				frequency *= 2.0f;
+			}
+			heights[(size_t)z * width + x] = value;
+		}
+	auto range = std::minmax_element(heights.begin(), heights.end());
+	float low = *range.first, span = std::max(*range.second - *range.first, 1e-6f);
+	samples.resize(heights.size());
+	for (size_t i = 0; i < heights.size(); i++)
+		samples[i] = (uint16_t)std::lround((heights[i] - low) / span * 65535.0f);
+	build();
+}
+
+// Uploads the samples and builds the tree over them
+void Terrain::build()
+{
+	Delete();
+	glGenTextures(1, &texture);
+	GLState.BindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	// Rows of an odd width are not 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width, depth, 0, GL_RED, GL_UNSIGNED_SHORT, samples.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, texture, GpuMemoryTracker::ImageBytes(GL_R16, width, depth, 1));
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+
+	// Levels are added until the finest patches have a quad per texel
+	levels = 1;
+	while (levels < MAX_LEVELS && (PATCH_QUADS << (levels - 1)) < (unsigned int)std::max(width, depth))
+		levels++;
+	for (unsigned int level = 0; level < levels; level++)
+		ranges[level] = RANGE_FACTOR * nodeSize(level);
+
+	// The finest nodes take every texel their filtered surface reaches, the levels above combine four nodes each
+	bounds.assign(levels, std::vector<glm::vec2>());
+	unsigned int count = 1u << (levels - 1);
+	bounds[0].resize((size_t)count * count);
+	for (unsigned int z = 0; z < count; z++)
+		for (unsigned int x = 0; x < count; x++)
+		{
+			int x0 = (int)std::floor((float)x / count * width - 0.5f), x1 = (int)std::ceil((float)(x + 1) / count * width - 0.5f);
+			int z0 = (int)std::floor((float)z / count * depth - 0.5f), z1 = (int)std::ceil((float)(z + 1) / count * depth - 0.5f);
+			glm::vec2 range(sample(x0, z0));
+			for (int tz = z0; tz <= z1; tz++)
+				for (int tx = x0; tx <= x1; tx++)
+				{
+					float value = sample(tx, tz);
+					range = glm::vec2(std::min(range.x, value), std::max(range.y, value));
+				}
+			bounds[0][(size_t)z * count + x] = range;
+		}
+	for (unsigned int level = 1; level < levels; level++)
+	{
+		unsigned int finer = count;
+		count /= 2;
+		bounds[level].resize((size_t)count * count);
+		for (unsigned int z = 0; z < count; z++)
+			for (unsigned int x = 0; x < count; x++)
+			{
+				const std::vector<glm::vec2>& below = bounds[level - 1];
+				glm::vec2 range = below[(size_t)(2 * z) * finer + 2 * x];
+				for (unsigned int child = 1; child < 4; child++)
+				{
+					glm::vec2 other = below[(size_t)(2 * z + (child >> 1)) * finer + 2 * x + (child & 1)];
+					range = glm::vec2(std::min(range.x, other.x), std::max(range.y, other.y));
+				}
+				bounds[level][(size_t)z * count + x] = range;
+			}
+	}
+	buildFloors();
+}
+
+// The filtered surface between four texel centers never dips below the lowest of them, so that is the floor of a
+// cell of level 0, the levels above take the lowest of the up to four cells they cover
+void Terrain::buildFloors()
+{
+	floors.clear();
+	floorWidths.clear();
+	int cellsX = width - 1, cellsZ = depth - 1;
+	std::vector<float> level((size_t)cellsX * cellsZ);
+	for (int z = 0; z < cellsZ; z++)
+		for (int x = 0; x < cellsX; x++)
+			level[(size_t)z * cellsX + x] = std::min(std::min(sample(x, z), sample(x + 1, z)), std::min(sample(x, z + 1), sample(x + 1, z + 1)));
+	floors.push_back(std::move(level));
+	floorWidths.push_back(cellsX);
+	while (cellsX > 1 || cellsZ > 1)
+	{
+		int coarseX = (cellsX + 1) / 2, coarseZ = (cellsZ + 1) / 2;
+		const std::vector<float>& finer = floors.back();
+		std::vector<float> coarse((size_t)coarseX * coarseZ, FLT_MAX);
+		for (int z = 0; z < cellsZ; z++)
+			for (int x = 0; x < cellsX; x++)
+			{
+				float& floor = coarse[(size_t)(z / 2) * coarseX + x / 2];
+				floor = std::min(floor, finer[(size_t)z * cellsX + x]);
+			}
+		floors.push_back(std::move(coarse));
+		floorWidths.push_back(coarseX);
+		cellsX = coarseX;
+		cellsZ = coarseZ;
+	}
+}
+
+// Reads the level whose cells are at least as large as the rectangle, where it covers at most two by two of them
+float Terrain::floorUnder(const glm::vec2& min, const glm::vec2& max) const
+{
+	float x0 = (min.x / size + 0.5f) * width - 0.5f, x1 = (max.x / size + 0.5f) * width - 0.5f;
+	float z0 = (min.y / size + 0.5f) * depth - 0.5f, z1 = (max.y / size + 0.5f) * depth - 0.5f;
+	if (floors.empty() || x0 < 0.0f || z0 < 0.0f || x1 > (float)(width - 1) || z1 > (float)(depth - 1))
+		return -FLT_MAX;
+	unsigned int level = 0;
+	float extent = std::max(x1 - x0, z1 - z0);
+	while (level + 1 < floors.size() && (float)(1u << level) < extent)
+		level++;
+	int first[2] = { std::min((int)x0, width - 2) >> level, std::min((int)z0, depth - 2) >> level };
+	int last[2] = { std::min((int)x1, width - 2) >> level, std::min((int)z1, depth - 2) >> level };
+	float floor = FLT_MAX;
+	for (int z = first[1]; z <= last[1]; z++)
+		for (int x = first[0]; x <= last[0]; x++)
+			floor = std::min(floor, floors[level][(size_t)z * floorWidths[level] + x]);
+	return floor;
+}
+
+// Sample at a texel, clamped to the edges
+float Terrain::sample(int x, int z) const
+{
+	x = std::clamp(x, 0, width - 1);
+	z = std::clamp(z, 0, depth - 1);
+	return samples[(size_t)z * width + x] * (height / 65535.0f);
+}
+
+// Height of the ground at a point, between the four nearest texel centers like GL_LINEAR
+float Terrain::heightAt(float x, float z) const
+{
+	if (samples.empty())
+		return 0.0f;
+	float tx = (x / size + 0.5f) * width - 0.5f, tz = (z / size + 0.5f) * depth - 0.5f;
+	int x0 = (int)std::floor(tx), z0 = (int)std::floor(tz);
+	float fx = tx - (float)x0, fz = tz - (float)z0;
+	float top = sample(x0, z0) + (sample(x0 + 1, z0) - sample(x0, z0)) * fx;
+	float bottom = sample(x0, z0 + 1) + (sample(x0 + 1, z0 + 1) - sample(x0, z0 + 1)) * fx;
+	return top + (bottom - top) * fz;
+}
+
+// Lowest ground under a rectangle, sampled about once per texel
+float Terrain::lowest(const glm::vec2& min, const glm::vec2& max) const
+{
+	glm::vec2 texel(size / width, size / depth);
+	glm::ivec2 steps = glm::clamp(glm::ivec2(glm::ceil((max - min) / texel)), glm::ivec2(1), glm::ivec2(15));
+	float low = heightAt(min.x, min.y);
+	for (int z = 0; z <= steps.y; z++)
+		for (int x = 0; x <= steps.x; x++)
+			low = std::min(low, heightAt(min.x + (max.x - min.x) * x / steps.x, min.y + (max.y - min.y) * z / steps.y));
+	return low;
+}
+
+// Side of the nodes of a level
+float Terrain::nodeSize(unsigned int level) const
+{
+	return size / (float)(1u << (levels - 1 - level));
+}
+
+// Box of a node from its corner, its side and the ground it covers
+void Terrain::nodeBox(unsigned int level, unsigned int x, unsigned int z, glm::vec3& min, glm::vec3& max) const
+{
+	float side = nodeSize(level);
+	const glm::vec2& range = bounds[level][(size_t)z * (1u << (levels - 1 - level)) + x];
+	min = glm::vec3(-0.5f * size + x * side, range.x, -0.5f * size + z * side);
+	max = glm::vec3(min.x + side, range.y, min.z + side);
+}
+
+// Checks if any point of a box is within range of eye
+static bool inRange(const glm::vec3& min, const glm::vec3& max, const glm::vec3& eye, float range)
+{
+	glm::vec3 offset = glm::clamp(eye, min, max) - eye;
+	return glm::dot(offset, offset) <= range * range;
+}
+
+// Picks the patches for a camera at eye
+void Terrain::Select(const glm::vec3& eye, const Frustum& frustum)
+{
+	records.clear();
+	quarters.clear();
+	if (!samples.empty() && !selectNode(levels - 1, 0, 0, eye, frustum))
+	{
+		// Beyond the range of the coarsest level the whole square is one patch
+		glm::vec3 min, max;
+		nodeBox(levels - 1, 0, 0, min, max);
+		if (frustum.TestBox(min, max))
+			addPatch(records, levels - 1, glm::vec2(min.x, min.z), size, PATCH_QUADS);
+	}
+	wholePatches = records.size() / CityGenerator::INSTANCE_FLOATS;
+	quarterPatches = quarters.size() / CityGenerator::INSTANCE_FLOATS;
+	records.insert(records.end(), quarters.begin(), quarters.end());
+}
+
+// Selects a node, its children where the finer range reaches them, or the quarters of it they leave out
+bool Terrain::selectNode(unsigned int level, unsigned int x, unsigned int z, const glm::vec3& eye, const Frustum& frustum)
+{
+	glm::vec3 min, max;
+	nodeBox(level, x, z, min, max);
+	if (!inRange(min, max, eye, ranges[level]))
+		return false;
+	// Out of view it is selected all the same, with nothing to draw
+	if (!frustum.TestBox(min, max))
+		return true;
+	float side = nodeSize(level);
+	if (level == 0 || !inRange(min, max, eye, ranges[level - 1]))
+	{
+		addPatch(records, level, glm::vec2(min.x, min.z), side, PATCH_QUADS);
+		return true;
+	}
+	for (unsigned int child = 0; child < 4; child++)
+	{
+		unsigned int cx = 2 * x + (child & 1), cz = 2 * z + (child >> 1);
+		if (selectNode(level - 1, cx, cz, eye, frustum))
+			continue;
+		glm::vec3 childMin, childMax;
+		nodeBox(level - 1, cx, cz, childMin, childMax);
+		if (frustum.TestBox(childMin, childMax))
+			addPatch(quarters, level, glm::vec2(childMin.x, childMin.z), 0.5f * side, PATCH_QUADS / 2);
+	}
+	return true;
+}
+
+// Writes the record of a patch, nothing once the frame has MAX_PATCHES
+void Terrain::addPatch(std::vector<GLfloat>& target, unsigned int level, const glm::vec2& corner, float side, unsigned int quads)
+{
+	if (records.size() + quarters.size() >= (size_t)MAX_PATCHES * CityGenerator::INSTANCE_FLOATS)
+		return;
+	const GLfloat record[CityGenerator::INSTANCE_FLOATS] = { corner.x, 0.0f, corner.y, side, (GLfloat)quads, side, -1.0f - (GLfloat)level, ranges[level],
+		CityGenerator::GROUND_COLOR[0], CityGenerator::GROUND_COLOR[1], CityGenerator::GROUND_COLOR[2] };
+	target.insert(target.end(), record, record + CityGenerator::INSTANCE_FLOATS);
+}
+
+// Marches every sector outwards ring by ring, each ring a little longer than the sector is wide there, and keeps the
+// steepest slope up to the floor of the ground under it so far. A floor above the eye is steepest seen at the inner
+// edge of the ring and one below it at the outer edge, so every line of sight in the sector beyond the ring that is
+// flatter passes under the ground somewhere in it
+void Terrain::BuildHorizon(const glm::vec3& eye)
+{
+	horizonEye = eye;
+	horizonRings = 0;
+	horizon.clear();
+	if (floors.empty())
+		return;
+	const float sectorWidth = glm::two_pi<float>() / HORIZON_SECTORS;
+	horizonNear = 2.0f * size / (float)std::max(width, depth);
+	horizonGrowth = 1.0f + 2.5f * sectorWidth;
+	float reach = glm::length(glm::abs(glm::vec2(eye.x, eye.z)) + glm::vec2(0.5f * size));
+	if (reach <= horizonNear)
+		return;
+	horizonRings = std::min(MAX_HORIZON_RINGS, (unsigned int)std::ceil(std::log(reach / horizonNear) / std::log(horizonGrowth)));
+	horizon.assign((size_t)HORIZON_SECTORS * horizonRings, -FLT_MAX);
+	// The outer arc of a sector bulges past the box of its corners by this much of its radius
+	const float bulge = 1.0f - std::cos(0.5f * sectorWidth);
+	glm::vec2 center(eye.x, eye.z);
+	for (unsigned int s = 0; s < HORIZON_SECTORS; s++)
+	{
+		glm::vec2 from(std::cos(s * sectorWidth), std::sin(s * sectorWidth));
+		glm::vec2 to(std::cos((s + 1) * sectorWidth), std::sin((s + 1) * sectorWidth));
+		float steepest = -FLT_MAX;
+		for (unsigned int ring = 0; ring < horizonRings; ring++)
+		{
+			float inner = horizonNear * std::pow(horizonGrowth, (float)ring);
+			float outer = inner * horizonGrowth;
+			glm::vec2 min = glm::min(glm::min(from * inner, to * inner), glm::min(from * outer, to * outer)) - outer * bulge;
+			glm::vec2 max = glm::max(glm::max(from * inner, to * inner), glm::max(from * outer, to * outer)) + outer * bulge;
+			float floor = floorUnder(center + min, center + max);
+			if (floor > -FLT_MAX)
+			{
+				float rise = floor - eye.y;
+				steepest = std::max(steepest, rise / (rise > 0.0f ? inner : outer));
+			}
+			horizon[(size_t)s * horizonRings + ring] = steepest;
+		}
+	}
+}
+
+// The top of a box above the eye is seen steepest from its nearest point and below it from its farthest, which has
+// to stay under the horizon of the last ring nearer than the box in every sector the box covers
+bool Terrain::BehindHorizon(const glm::vec3& min, const glm::vec3& max) const
+{
+	if (horizonRings == 0)
+		return false;
+	glm::vec2 eye(horizonEye.x, horizonEye.z), low(min.x, min.z), high(max.x, max.z);
+	float distance = glm::length(glm::clamp(eye, low, high) - eye);
+	if (distance <= horizonNear * horizonGrowth)
+		return false;
+	int ring = std::min((int)horizonRings - 1, (int)std::floor(std::log(distance / horizonNear) / std::log(horizonGrowth)) - 1);
+	while (ring >= 0 && horizonNear * std::pow(horizonGrowth, (float)(ring + 1)) > distance)
+		ring--;
+	if (ring < 0)
+		return false;
+	float farthest = glm::length(glm::max(glm::abs(low - eye), glm::abs(high - eye)));
+	float rise = max.y - horizonEye.y;
+	float slope = rise / (rise > 0.0f ? distance : farthest);
+
+	// The eye is outside the box, so its corners span less than half a turn around the direction of its center
+	const float sectorWidth = glm::two_pi<float>() / HORIZON_SECTORS;
+	glm::vec2 middle = 0.5f * (low + high) - eye;
+	float heading = std::atan2(middle.y, middle.x);
+	float left = 0.0f, right = 0.0f;
+	const glm::vec2 corners[4] = { low, glm::vec2(high.x, low.y), glm::vec2(low.x, high.y), high };
+	for (const glm::vec2& corner : corners)
+	{
+		float angle = std::atan2(corner.y - eye.y, corner.x - eye.x) - heading;
+		if (angle > glm::pi<float>())
+			angle -= glm::two_pi<float>();
+		else if (angle < -glm::pi<float>())
+			angle += glm::two_pi<float>();
+		left = std::min(left, angle);
+		right = std::max(right, angle);
+	}
+	int first = (int)std::floor((heading + left) / sectorWidth), last = (int)std::floor((heading + right) / sectorWidth);
+	for (int s = first; s <= last; s++)
+	{
+		int sector = ((s % (int)HORIZON_SECTORS) + (int)HORIZON_SECTORS) % (int)HORIZON_SECTORS;
+		if (slope >= horizon[(size_t)sector * horizonRings + ring])
+			return false;
+	}
+	return true;
+}
+
+// Binds the heightmap and sets the terrain uniforms of the program in use
+void Terrain::Apply(GLuint program) const
+{
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, texture);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glUniform1i(glGetUniformLocation(program, "heightmap"), TEXTURE_UNIT);
+	glUniform4f(glGetUniformLocation(program, "terrainArea"), -0.5f * size, -0.5f * size, size, height);
+	GLState.CountUniforms(2);
+}
+
+// Writes the flat grid over the unit square, wound like the ground quad
+void Terrain::GeneratePatch(unsigned int quads, GLfloat* vertices, GLuint* indices)
+{
+	for (unsigned int z = 0; z <= quads; z++)
+		for (unsigned int x = 0; x <= quads; x++)
+		{
+			const GLfloat vertex[CityGenerator::VERTEX_FLOATS] = { (GLfloat)x / quads, 0.0f, (GLfloat)z / quads, 0.0f, 0.0f };
+			vertices = std::copy(vertex, vertex + CityGenerator::VERTEX_FLOATS, vertices);
+		}
+	for (unsigned int z = 0; z < quads; z++)
+		for (unsigned int x = 0; x < quads; x++)
+		{
+			GLuint corner = z * (quads + 1) + x;
+			const GLuint quad[6] = { corner, corner + quads + 1, corner + quads + 2, corner + quads + 2, corner + 1, corner };
+			indices = std::copy(quad, quad + 6, indices);
+		}
+}
+
+// Deletes the texture
+void Terrain::Delete()
+{
+	if (texture != 0)
+		GLState.DeleteTextures(1, &texture);
+	texture = 0;
+}
@@ -0,0 +1,131 @@
+#ifndef TERRAIN_CLASS_H
+#define TERRAIN_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+#include"Frustum.h"
+
+// Heightmap ground drawn with continuous distance based levels of detail (CDLOD) in place of the flat ground quad
+// The heightmap covers a square centered on the origin and is sampled in the scene vertex shader, so every patch is
+// the same flat grid mesh moved and scaled by an instance record like a building. A quadtree over the square picks
+// the patches each frame: a node is split while the camera is within the range of the next finer level, so the
+// number of patches only depends on the ranges, never on the size of the square. Over the last part of its range a
+// patch slides its odd vertices onto the grid of the next coarser level, which meets the coarser patches next to it
+// without cracks or popping.
+// Nodes partly in range of a finer level keep drawing their other quarters at their own level, as quarter patches
+// of half as many quads. Patch records are marked by a negative layer and carry the range of their level as fade,
+// the number of quads a side of their mesh as the Y scale, and the ground color.
+// The terrain receives sun shadows but does not cast any, the buildings stand on the lowest point of their lot.
+// From low over the hills it hides what is behind them: a horizon around the eye keeps, for every sector of directions
+// and every ring of distance, the steepest slope the ground nearer than the ring certainly rises to, read off a pyramid
+// of the lowest ground of every cell. A box whose top stays below that slope in every sector it covers cannot be seen.
+class Terrain
+{
+public:
+	// The heightmap is bound to this texture unit while the scene is drawn, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 9;
+	// Quads a side of a whole patch and of a quarter patch, the vertices and indices of their meshes
+	static constexpr unsigned int PATCH_QUADS = 32;
+	static constexpr unsigned int PATCH_VERTICES = (PATCH_QUADS + 1) * (PATCH_QUADS + 1);
+	static constexpr unsigned int PATCH_INDICES = PATCH_QUADS * PATCH_QUADS * 6;
+	static constexpr unsigned int QUARTER_VERTICES = (PATCH_QUADS / 2 + 1) * (PATCH_QUADS / 2 + 1);
+	static constexpr unsigned int QUARTER_INDICES = PATCH_QUADS * PATCH_QUADS / 4 * 6;
+	// Most patches a frame selects, which bounds the vertices drawn whatever the size of the square
+	static constexpr unsigned int MAX_PATCHES = 1024;
+	// Most levels of the quadtree, a heightmap with more texels than the finest patches have quads is not refined further
+	static constexpr unsigned int MAX_LEVELS = 10;
+	// Sectors of directions around the eye the horizon is kept for, and most rings of distance in each
+	static constexpr unsigned int HORIZON_SECTORS = 256;
+	static constexpr unsigned int MAX_HORIZON_RINGS = 192;
+
+	// Side of the square the heightmap covers and the height of its highest samples, in world units
+	float size;
+	float height;
+	// Heightmap texture, GL_R16 with linear filtering
+	GLuint texture = 0;
+	// Instance records of the last Select, the whole patches followed by the quarter patches
+	std::vector<GLfloat> records;
+	size_t wholePatches = 0;
+	size_t quarterPatches = 0;
+
+	// Constructor for a square of the given side and height, Load or Generate give it its heightmap
+	Terrain(float size, float height);
+	// Deletes the texture unless Delete was already called, the context has to still be current
+	~Terrain();
+	// Terrain owns its texture, so it cannot be copied
+	Terrain(const Terrain&) = delete;
+	Terrain& operator=(const Terrain&) = delete;
+
+	// Reads the heightmap from a grayscale image, white is highest and the top row lies towards -Z
+	// False with the reason on stderr if the image cannot be read
+	bool Load(const std::string& path);
+	// Generates rolling hills of resolution by resolution samples as the heightmap
+	void Generate(int resolution, unsigned int seed);
+
+	// Height of the ground at a point, filtered like the vertex shader samples it
+	float heightAt(float x, float z) const;
+	// Lowest ground under a rectangle, where a building standing on it has its foot
+	float lowest(const glm::vec2& min, const glm::vec2& max) const;
+
+	// Picks the patches for a camera at eye, both in the space of the heightmap, and writes their records
+	void Select(const glm::vec3& eye, const Frustum& frustum);
+	// Builds the horizon of the ground seen from eye, in the space of the heightmap
+	void BuildHorizon(const glm::vec3& eye);
+	// Checks if a box is hidden behind the ground in every direction it is seen in from the eye of the last BuildHorizon
+	// Conservative, a box the horizon cannot decide about is not hidden
+	bool BehindHorizon(const glm::vec3& min, const glm::vec3& max) const;
+	// Binds the heightmap and sets the terrain uniforms of the program in use
+	void Apply(GLuint program) const;
+
+	// Writes the flat grid of quads by quads quads over the unit square on the XZ plane
+	static void GeneratePatch(unsigned int quads, GLfloat* vertices, GLuint* indices);
+
+	// Deletes the texture, does nothing if it was already deleted
+	void Delete();
+private:
+	// Heightmap samples, width by depth, row by row from -Z
+	std::vector<uint16_t> samples;
+	int width = 0;
+	int depth = 0;
+	// Quadtree levels, 0 is the finest, and the distance up to which each level is drawn
+	unsigned int levels = 1;
+	float ranges[MAX_LEVELS];
+	// Lowest and highest ground of every node of every level, the finest level first, row by row from -Z
+	std::vector<std::vector<glm::vec2>> bounds;
+	// Quarter patches of the frame being selected, appended to records once the whole patches are written
+	std::vector<GLfloat> quarters;
+	// Lowest ground of every cell of every level, level 0 has a cell between every four neighbouring texel centers and
+	// each level above takes the lowest of four cells, with the number of cells along X of each level
+	std::vector<std::vector<float>> floors;
+	std::vector<int> floorWidths;
+	// Eye of the last BuildHorizon, the radius of its first ring and the growth from one ring to the next
+	glm::vec3 horizonEye = glm::vec3(0.0f);
+	float horizonNear = 0.0f;
+	float horizonGrowth = 1.0f;
+	unsigned int horizonRings = 0;
+	// Steepest slope up from the eye of the ground certainly there within each ring of each sector, sector by sector
+	std::vector<float> horizon;
+
+	// Uploads the samples and builds the tree over them
+	void build();
+	// Selects a node or what of it is out of range of the finer levels, false if it is out of its own range
+	bool selectNode(unsigned int level, unsigned int x, unsigned int z, const glm::vec3& eye, const Frustum& frustum);
+	// Writes the record of a patch at the given corner and side drawn at a level
+	void addPatch(std::vector<GLfloat>& target, unsigned int level, const glm::vec2& corner, float side, unsigned int quads);
+	// Side of the nodes of a level, and the box of the node of a level at x, z, in world units
+	float nodeSize(unsigned int level) const;
+	void nodeBox(unsigned int level, unsigned int x, unsigned int z, glm::vec3& min, glm::vec3& max) const;
+	// Sample at a texel, clamped to the edges like the texture
+	float sample(int x, int z) const;
+	// Builds floors from the samples
+	void buildFloors();
+	// Lowest ground certainly under a rectangle of the XZ plane, -FLT_MAX where it reaches past the texel centers
+	float floorUnder(const glm::vec2& min, const glm::vec2& max) const;
+};
+
+#endif
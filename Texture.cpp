@@ -1,68 +1,150 @@
 #include"Texture.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLDebugOutput.h"
 
-Texture::Texture(const char* image, GLenum texType, GLenum slot, GLenum format, GLenum pixelType)
+#include<iostream>
+#include<utility>
+
+Texture::Texture(const char* image, GLenum texType, GLenum slot, GLenum format, GLenum pixelType, TextureLoader* loader)
 {
 	// Assigns the type of the texture ot the texture object
 	type = texType;
 
-	// Stores the width, height, and the number of color channels of the image
-	int widthImg, heightImg, numColCh;
-	// Flips the image so it appears right side up
-	stbi_set_flip_vertically_on_load(true);
-	// Reads the image from a file and stores it in bytes
-	unsigned char* bytes = stbi_load(image, &widthImg, &heightImg, &numColCh, 0);
-
 	// Generates an OpenGL texture object
 	glGenTextures(1, &ID);
 	// Assigns the texture to a Texture Unit
-	glActiveTexture(slot);
-	glBindTexture(texType, ID);
+	GLState.ActiveTexture(slot);
+	GLState.BindTexture(texType, ID);
+	Label(image);
 
-	// Configures the type of algorithm that is used to make the image smaller or bigger
-	glTexParameteri(texType, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-	glTexParameteri(texType, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	// Filtering and wrapping come from the SamplerSet sampler bound next to it, the texture keeps GL's defaults
 
-	// Configures the way the texture repeats (if it does at all)
-	glTexParameteri(texType, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(texType, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// Leaves decoding and uploading to the loader, the placeholder is drawn meanwhile
+	if (loader)
+	{
+		GLState.BindTexture(texType, 0);
+		TextureLoader::Placeholder(ID, texType);
+		loader->Load(ID, texType, image, GL_RGBA, format, pixelType, true);
+		return;
+	}
 
-	// Extra lines in case you choose to use GL_CLAMP_TO_BORDER
-	// float flatColor[] = {1.0f, 1.0f, 1.0f, 1.0f};
-	// glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, flatColor);
+	// DDS and KTX2 files bring their own mip chain and are uploaded as they are, into storage of exactly those levels
+	if (CompressedImage::IsCompressedFile(image))
+	{
+		CompressedImage compressed;
+		if (compressed.Load(image) && compressed.Supported())
+		{
+			compressed.Upload(texType, compressed.data.data(), GLExt.textureStorage);
+			GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, ID, (int64_t)compressed.byteSize());
+		}
+		else
+			std::cerr << "Failed to load compressed texture " << image << std::endl;
+		GLState.BindTexture(texType, 0);
+		return;
+	}
 
-	// Assigns the image to the OpenGL Texture object
-	glTexImage2D(texType, 0, GL_RGBA, widthImg, heightImg, 0, format, pixelType, bytes);
+	// Stores the width, height, and the number of color channels of the image
+	int widthImg, heightImg, numColCh;
+	// Flips the image so it appears right side up
+	stbi_set_flip_vertically_on_load(true);
+	// Reads the image from a file and stores it in bytes
+	unsigned char* bytes = stbi_load(image, &widthImg, &heightImg, &numColCh, 0);
+
+	// Assigns the image to the OpenGL Texture object, allocated once with its whole mip chain when the driver can
+	if (GLExt.textureStorage && bytes)
+	{
+		glTexStorage2D(texType, GpuMemoryTracker::MipLevels(widthImg, heightImg), GL_RGBA8, widthImg, heightImg);
+		glTexSubImage2D(texType, 0, 0, 0, widthImg, heightImg, format, pixelType, bytes);
+	}
+	else
+		glTexImage2D(texType, 0, GL_RGBA, widthImg, heightImg, 0, format, pixelType, bytes);
 	// Generates MipMaps
 	glGenerateMipmap(texType);
+	if (bytes)
+		GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, ID, GpuMemoryTracker::ImageBytes(GL_RGBA8, widthImg, heightImg, 1, GpuMemoryTracker::MipLevels(widthImg, heightImg)));
 
 	// Deletes the image data as it is already in the OpenGL Texture object
 	stbi_image_free(bytes);
 
 	// Unbinds the OpenGL Texture object so that it can't accidentally be modified
-	glBindTexture(texType, 0);
+	GLState.BindTexture(texType, 0);
+}
+
+// Deletes the texture unless Delete was already called
+Texture::~Texture()
+{
+	Delete();
+}
+
+// Takes over the texture and its handle, the other Texture is left empty
+Texture::Texture(Texture&& other) noexcept
+	: ID(std::exchange(other.ID, 0)), type(other.type), handle(std::exchange(other.handle, 0)), resident(std::exchange(other.resident, false))
+{
+}
+
+// Deletes the current texture and takes over the one of another Texture
+Texture& Texture::operator=(Texture&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = std::exchange(other.ID, 0);
+		type = other.type;
+		handle = std::exchange(other.handle, 0);
+		resident = std::exchange(other.resident, false);
+	}
+	return *this;
 }
 
 void Texture::texUnit(Shader& shader, const char* uniform, GLuint unit)
 {
-	// Gets the location of the uniform
-	GLuint texUni = glGetUniformLocation(shader.ID, uniform);
 	// Shader needs to be activated before changing the value of a uniform
 	shader.Activate();
-	// Sets the value of the uniform
-	glUniform1i(texUni, unit);
+	// Sets the value of the uniform through the location cached by the shader
+	shader.setInt(uniform, unit);
+}
+
+GLuint64 Texture::MakeResident(GLuint sampler)
+{
+	// The handle is taken once, later calls only make it resident again
+	if (handle == 0)
+		handle = sampler ? glGetTextureSamplerHandleARB(ID, sampler) : glGetTextureHandleARB(ID);
+	if (!resident)
+		glMakeTextureHandleResidentARB(handle);
+	resident = true;
+	return handle;
+}
+
+void Texture::MakeNonResident()
+{
+	if (resident)
+		glMakeTextureHandleNonResidentARB(handle);
+	resident = false;
+}
+
+// Names the texture in GPU captures and debug messages
+void Texture::Label(const char* name)
+{
+	GLDebug.Label(GL_TEXTURE, ID, name);
 }
 
 void Texture::Bind()
 {
-	glBindTexture(type, ID);
+	GLState.BindTexture(type, ID);
 }
 
 void Texture::Unbind()
 {
-	glBindTexture(type, 0);
+	GLState.BindTexture(type, 0);
 }
 
 void Texture::Delete()
 {
-	glDeleteTextures(1, &ID);
+	// Resident handles have to be released before the texture goes away
+	MakeNonResident();
+	if (ID != 0)
+		GLState.DeleteTextures(1, &ID);
+	ID = 0;
+	handle = 0;
 }
\ No newline at end of file
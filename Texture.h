@@ -5,21 +5,42 @@
 #include<stb/stb_image.h>
 
 #include"shaderClass.h"
+#include"TextureLoader.h"
+#include"GLExtensions.h"
 
 class Texture
 {
 public:
-	GLuint ID;
+	GLuint ID = 0;
 	GLenum type;
-	Texture(const char* image, GLenum texType, GLenum slot, GLenum format, GLenum pixelType);
+	// Resident bindless handle, 0 until MakeResident is called
+	GLuint64 handle = 0;
+	bool resident = false;
+	// With a loader the image is decoded in the background and the texture shows a placeholder until it is uploaded
+	Texture(const char* image, GLenum texType, GLenum slot, GLenum format, GLenum pixelType, TextureLoader* loader = nullptr);
+	// Deletes the texture unless Delete was already called, the context has to still be current
+	~Texture();
+	// A Texture owns its GL object, so it can be moved but not copied
+	Texture(const Texture&) = delete;
+	Texture& operator=(const Texture&) = delete;
+	Texture(Texture&& other) noexcept;
+	Texture& operator=(Texture&& other) noexcept;
 
 	// Assigns a texture unit to a texture
 	void texUnit(Shader& shader, const char* uniform, GLuint unit);
+	// Takes the bindless handle of the texture and makes it resident, needs GLExt.bindlessTexture
+	// The handle samples with the parameters of sampler, or of the texture itself when it is 0, and the texture can no
+	// longer be changed afterwards, so only call this once its image has been uploaded
+	GLuint64 MakeResident(GLuint sampler = 0);
+	// Lets the driver evict the texture again, the handle stays valid until the texture is deleted
+	void MakeNonResident();
+	// Names the texture in GPU captures and debug messages, the constructor names it after its image
+	void Label(const char* name);
 	// Binds a texture
 	void Bind();
 	// Unbinds a texture
 	void Unbind();
-	// Deletes a texture
+	// Deletes a texture, does nothing if it was already deleted or moved from
 	void Delete();
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include"TextureArray.h"
+
+#include"CompressedImage.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLDebugOutput.h"
+
+#include<stb/stb_image.h>
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+#include<utility>
+
+// Constructor that allocates every layer and level
+TextureArray::TextureArray(GLsizei width, GLsizei height, GLsizei layers, GLenum internalFormat, bool streamed)
+{
+	TextureArray::width = width;
+	TextureArray::height = height;
+	TextureArray::layers = layers;
+	TextureArray::internalFormat = internalFormat;
+	levels = GpuMemoryTracker::MipLevels(width, height);
+
+	glGenTextures(1, &ID);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	// Filtering and wrapping come from the SamplerSet sampler bound next to it
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	immutable = GLExt.textureStorage && !streamed;
+	if (immutable)
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, width, height, layers);
+	for (GLsizei level = 0; level < levels && !immutable; level++)
+	{
+		GLsizei levelWidth = std::max(1, width >> level), levelHeight = std::max(1, height >> level);
+		if (compressed())
+			glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, levelWidth, levelHeight, layers, 0, (GLsizei)(CompressedImage::LevelSize(internalFormat, levelWidth, levelHeight) * layers), nullptr);
+		else
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, levelWidth, levelHeight, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	}
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, ID, GpuMemoryTracker::ImageBytes(internalFormat, width, height, layers, levels));
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	Placeholder();
+}
+
+// Deletes the array unless Delete was already called
+TextureArray::~TextureArray()
+{
+	Delete();
+}
+
+// Takes over the texture of another array, which is left empty
+TextureArray::TextureArray(TextureArray&& other) noexcept
+	: ID(std::exchange(other.ID, 0)), width(other.width), height(other.height), layers(other.layers), levels(other.levels), internalFormat(other.internalFormat), immutable(other.immutable)
+{
+}
+
+// Deletes the current texture and takes over the one of another array
+TextureArray& TextureArray::operator=(TextureArray&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = std::exchange(other.ID, 0);
+		width = other.width;
+		height = other.height;
+		layers = other.layers;
+		levels = other.levels;
+		internalFormat = other.internalFormat;
+		immutable = other.immutable;
+	}
+	return *this;
+}
+
+// Checks if the layers are block compressed
+bool TextureArray::compressed() const
+{
+	return CompressedImage::LevelSize(internalFormat, 4, 4) > 0;
+}
+
+// Fills every layer with a gray placeholder
+void TextureArray::Placeholder()
+{
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	for (GLsizei level = 0; level < levels; level++)
+	{
+		GLsizei levelWidth = std::max(1, width >> level), levelHeight = std::max(1, height >> level);
+		if (compressed())
+		{
+			// Blocks with both end points gray and zero indices decode to plain gray in BC1 to BC3,
+			// other formats just start out as whatever the zeroed blocks decode to
+			size_t size = CompressedImage::LevelSize(internalFormat, levelWidth, levelHeight) * layers;
+			std::vector<unsigned char> blocks(size, 0);
+			size_t blockBytes = CompressedImage::LevelSize(internalFormat, 4, 4);
+			const unsigned char gray[4] = { 0x10, 0x84, 0x10, 0x84 };
+			for (size_t offset = blockBytes - 8; offset + 4 <= size; offset += blockBytes)
+				memcpy(&blocks[offset], gray, 4);
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, levelWidth, levelHeight, layers, internalFormat, (GLsizei)size, blocks.data());
+		}
+		else
+		{
+			std::vector<unsigned char> pixels((size_t)levelWidth * levelHeight * layers * 4, 128);
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, levelWidth, levelHeight, layers, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		}
+	}
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Replaces a layer of an uncompressed array and rebuilds the mip chain
+void TextureArray::SetLayer(GLsizei layer, const unsigned char* rgba)
+{
+	if (compressed() || layer < 0 || layer >= layers)
+		return;
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	GLState.CountUpload((size_t)width * height * 4);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Decodes an image into a layer right away
+bool TextureArray::LoadLayer(GLsizei layer, const char* image, bool flip)
+{
+	if (compressed())
+	{
+		std::cerr << "Compressed texture arrays are filled through TextureLoader::LoadLayer: " << image << std::endl;
+		return false;
+	}
+	stbi_set_flip_vertically_on_load_thread(flip);
+	int imageWidth, imageHeight, channels;
+	unsigned char* bytes = stbi_load(image, &imageWidth, &imageHeight, &channels, 4);
+	if (!bytes)
+	{
+		std::cerr << "Failed to load texture " << image << std::endl;
+		return false;
+	}
+	if (imageWidth == width && imageHeight == height)
+		SetLayer(layer, bytes);
+	else
+		SetLayer(layer, Resize(bytes, imageWidth, imageHeight, width, height).data());
+	stbi_image_free(bytes);
+	return true;
+}
+
+// Resizes an RGBA8 image with bilinear filtering
+std::vector<unsigned char> TextureArray::Resize(const unsigned char* rgba, int width, int height, int newWidth, int newHeight)
+{
+	std::vector<unsigned char> result((size_t)newWidth * newHeight * 4);
+	for (int y = 0; y < newHeight; y++)
+	{
+		// Sample positions at texel centers
+		float sy = std::max(0.0f, (y + 0.5f) * height / newHeight - 0.5f);
+		int y0 = std::min((int)sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+		float fy = sy - y0;
+		for (int x = 0; x < newWidth; x++)
+		{
+			float sx = std::max(0.0f, (x + 0.5f) * width / newWidth - 0.5f);
+			int x0 = std::min((int)sx, width - 1), x1 = std::min(x0 + 1, width - 1);
+			float fx = sx - x0;
+			for (int c = 0; c < 4; c++)
+			{
+				float top = rgba[((size_t)y0 * width + x0) * 4 + c] * (1.0f - fx) + rgba[((size_t)y0 * width + x1) * 4 + c] * fx;
+				float bottom = rgba[((size_t)y1 * width + x0) * 4 + c] * (1.0f - fx) + rgba[((size_t)y1 * width + x1) * 4 + c] * fx;
+				result[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)(top * (1.0f - fy) + bottom * fy + 0.5f);
+			}
+		}
+	}
+	return result;
+}
+
+// Assigns a texture unit to the array
+void TextureArray::texUnit(Shader& shader, const char* uniform, GLuint unit)
+{
+	shader.Activate();
+	shader.setInt(uniform, unit);
+}
+
+// Names the array in GPU captures and debug messages
+void TextureArray::Label(const char* name)
+{
+	GLDebug.Label(GL_TEXTURE, ID, name);
+}
+
+// Binds the array
+void TextureArray::Bind()
+{
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, ID);
+}
+
+// Unbinds the array
+void TextureArray::Unbind()
+{
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Deletes the array
+void TextureArray::Delete()
+{
+	if (ID != 0)
+		GLState.DeleteTextures(1, &ID);
+	ID = 0;
+}
@@ -0,0 +1,61 @@
+#ifndef TEXTURE_ARRAY_CLASS_H
+#define TEXTURE_ARRAY_CLASS_H
+
+#include<glad/glad.h>
+#include<vector>
+
+#include"shaderClass.h"
+
+// Stack of same sized images in one GL_TEXTURE_2D_ARRAY, shaders pick a layer per instance
+// so buildings with different facades are still drawn together with a single bind
+class TextureArray
+{
+public:
+	GLuint ID = 0;
+	// Size of every layer and number of layers
+	GLsizei width;
+	GLsizei height;
+	GLsizei layers;
+	// Number of mip levels allocated, a full chain down to 1x1
+	GLsizei levels;
+	// GL_RGBA8, or a block compressed format whose layers then come from cooked files
+	GLenum internalFormat;
+	// True when the levels were allocated once with immutable storage and can only be filled, not specified again
+	bool immutable = false;
+
+	// Constructor that allocates every layer and level, the layers start out as a placeholder
+	// The storage is immutable where GL allows it unless streamed, streamed arrays release and specify levels again
+	TextureArray(GLsizei width, GLsizei height, GLsizei layers, GLenum internalFormat = GL_RGBA8, bool streamed = false);
+	// Deletes the texture unless Delete was already called, the context has to still be current
+	~TextureArray();
+	// A TextureArray owns its GL object, so it can be moved but not copied
+	TextureArray(const TextureArray&) = delete;
+	TextureArray& operator=(const TextureArray&) = delete;
+	TextureArray(TextureArray&& other) noexcept;
+	TextureArray& operator=(TextureArray&& other) noexcept;
+
+	// Checks if the layers are block compressed
+	bool compressed() const;
+	// Fills every layer with a gray placeholder
+	void Placeholder();
+	// Replaces a layer of an uncompressed array with RGBA8 pixels of the array size and rebuilds the mip chain
+	void SetLayer(GLsizei layer, const unsigned char* rgba);
+	// Decodes an image into a layer right away, images of another size are resized
+	bool LoadLayer(GLsizei layer, const char* image, bool flip = true);
+
+	// Resizes an RGBA8 image with bilinear filtering
+	static std::vector<unsigned char> Resize(const unsigned char* rgba, int width, int height, int newWidth, int newHeight);
+
+	// Assigns a texture unit to the array
+	void texUnit(Shader& shader, const char* uniform, GLuint unit);
+	// Names the array in GPU captures and debug messages
+	void Label(const char* name);
+	// Binds the array
+	void Bind();
+	// Unbinds the array
+	void Unbind();
+	// Deletes the array, does nothing if it was already deleted or moved from
+	void Delete();
+};
+
+#endif
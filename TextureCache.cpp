@@ -0,0 +1,45 @@
+#include"TextureCache.h"
+
+// Constructor for textures decoded by loader
+TextureCache::TextureCache(TextureLoader* loader)
+	: loader(loader)
+{
+}
+
+// Returns the shared texture of an image in a format
+TextureCache::Handle TextureCache::Get(const std::string& image, GLenum texType, GLenum format, GLenum pixelType)
+{
+	Key key(image, texType, format, pixelType);
+	std::weak_ptr<Texture>& entry = textures[key];
+	if (Handle texture = entry.lock())
+	{
+		hitCount++;
+		return texture;
+	}
+	missCount++;
+	Handle texture = std::make_shared<Texture>(image.c_str(), texType, GL_TEXTURE0, format, pixelType, loader);
+	entry = texture;
+	return texture;
+}
+
+// Number of textures alive
+size_t TextureCache::size() const
+{
+	size_t alive = 0;
+	for (const auto& entry : textures)
+		if (!entry.second.expired())
+			alive++;
+	return alive;
+}
+
+// Requests answered with a texture that was alive already
+size_t TextureCache::hits() const
+{
+	return hitCount;
+}
+
+// Requests that loaded their texture
+size_t TextureCache::misses() const
+{
+	return missCount;
+}
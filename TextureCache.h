@@ -0,0 +1,43 @@
+#ifndef TEXTURE_CACHE_CLASS_H
+#define TEXTURE_CACHE_CLASS_H
+
+#include<glad/glad.h>
+#include<map>
+#include<memory>
+#include<string>
+#include<tuple>
+
+#include"Texture.h"
+#include"TextureLoader.h"
+
+// Hands out one shared Texture per image and format, so everything drawn with the same image is decoded and
+// uploaded once and samples the same GPU texture. Handles count the references, the texture is deleted with the last
+// one and asking for it again then loads it anew. The cache only remembers textures, it never keeps them alive.
+class TextureCache
+{
+public:
+	// Shared texture, the context has to still be current when the last handle goes away
+	typedef std::shared_ptr<Texture> Handle;
+
+	// Constructor for textures decoded by loader in the background, or right away without one
+	TextureCache(TextureLoader* loader = nullptr);
+
+	// Returns the texture of an image in this format, loaded the first time it is asked for
+	// Its filtering comes from the SamplerSet sampler it is bound or made resident with
+	Handle Get(const std::string& image, GLenum texType, GLenum format, GLenum pixelType);
+	// Number of textures alive
+	size_t size() const;
+	// Requests answered with a texture that was alive already, and the ones that loaded it
+	size_t hits() const;
+	size_t misses() const;
+private:
+	// Image, type, format and pixel type
+	typedef std::tuple<std::string, GLenum, GLenum, GLenum> Key;
+
+	TextureLoader* loader;
+	std::map<Key, std::weak_ptr<Texture>> textures;
+	size_t hitCount = 0;
+	size_t missCount = 0;
+};
+
+#endif
@@ -0,0 +1,459 @@
+#include"TextureCooker.h"
+#include"AssetDatabase.h"
+#include"ImageWriter.h"
+#include"TextureArray.h"
+#include"VirtualTexture.h"
+
+#include<stb/stb_image.h>
+#include<algorithm>
+#include<atomic>
+#include<cctype>
+#include<cstdint>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+#include<functional>
+#include<iostream>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+namespace fs = std::filesystem;
+
+// Constructor that sets the number of threads
+TextureCooker::TextureCooker(unsigned int threads)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	TextureCooker::threads = threads;
+}
+
+// Packs a color into 5:6:5 bits
+static uint16_t pack565(const int* color)
+{
+	return (uint16_t)(((color[0] * 31 + 127) / 255) << 11 | ((color[1] * 63 + 127) / 255) << 5 | ((color[2] * 31 + 127) / 255));
+}
+
+// Expands 5:6:5 bits back to 8 bits per channel
+static void unpack565(uint16_t packed, int* color)
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Compresses an RGBA8 image into BC1 blocks
+void TextureCooker::EncodeBC1(const unsigned char* rgba, int width, int height, unsigned char* out)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			// Texels past the edge repeat the last row and column
+			int texels[16][3];
+			int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 };
+			for (int i = 0; i < 16; i++)
+			{
+				int x = std::min(bx * 4 + (i & 3), width - 1);
+				int y = std::min(by * 4 + (i >> 2), height - 1);
+				const unsigned char* texel = rgba + ((size_t)y * width + x) * 4;
+				for (int c = 0; c < 3; c++)
+				{
+					texels[i][c] = texel[c];
+					low[c] = std::min(low[c], (int)texel[c]);
+					high[c] = std::max(high[c], (int)texel[c]);
+				}
+			}
+			// Pulls the bounding box in a little, the extremes are usually single outliers
+			for (int c = 0; c < 3; c++)
+			{
+				int inset = (high[c] - low[c]) / 16;
+				low[c] += inset;
+				high[c] -= inset;
+			}
+
+			uint16_t color0 = pack565(high), color1 = pack565(low);
+			if (color0 < color1)
+				std::swap(color0, color1);
+			// color0 > color1 selects the four color mode, equal colors need no indices at all
+			uint32_t indices = 0;
+			if (color0 != color1)
+			{
+				int palette[4][3];
+				unpack565(color0, palette[0]);
+				unpack565(color1, palette[1]);
+				for (int c = 0; c < 3; c++)
+				{
+					palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+					palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+				}
+				for (int i = 0; i < 16; i++)
+				{
+					int best = 0, bestDistance = INT32_MAX;
+					for (int p = 0; p < 4; p++)
+					{
+						int dr = texels[i][0] - palette[p][0], dg = texels[i][1] - palette[p][1], db = texels[i][2] - palette[p][2];
+						int distance = dr * dr + dg * dg + db * db;
+						if (distance < bestDistance)
+						{
+							bestDistance = distance;
+							best = p;
+						}
+					}
+					indices |= (uint32_t)best << (2 * i);
+				}
+			}
+
+			memcpy(out + 0, &color0, 2);
+			memcpy(out + 2, &color1, 2);
+			memcpy(out + 4, &indices, 4);
+			out += 8;
+		}
+	}
+}
+
+// Halves an RGBA8 image with a box filter
+static std::vector<unsigned char> downsample(const std::vector<unsigned char>& source, int width, int height, int& newWidth, int& newHeight)
+{
+	newWidth = std::max(1, width / 2);
+	newHeight = std::max(1, height / 2);
+	std::vector<unsigned char> result((size_t)newWidth * newHeight * 4);
+	for (int y = 0; y < newHeight; y++)
+	{
+		for (int x = 0; x < newWidth; x++)
+		{
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = source[((size_t)y0 * width + x0) * 4 + c] + source[((size_t)y0 * width + x1) * 4 + c]
+					+ source[((size_t)y1 * width + x0) * 4 + c] + source[((size_t)y1 * width + x1) * 4 + c];
+				result[((size_t)y * newWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+			}
+		}
+	}
+	return result;
+}
+
+// Writes a little endian 32 bit integer
+static void write32(std::ofstream& file, uint32_t value)
+{
+	file.write((const char*)&value, 4);
+}
+
+// Cooks one image
+bool TextureCooker::CookFile(const std::string& input, const std::string& output, int size)
+{
+	// OpenGL reads images bottom row first, flipping here is what lets the runtime skip it
+	stbi_set_flip_vertically_on_load_thread(1);
+	int width, height, channels;
+	unsigned char* pixels = stbi_load(input.c_str(), &width, &height, &channels, 4);
+	if (!pixels)
+	{
+		std::cerr << "Failed to read " << input << std::endl;
+		return false;
+	}
+	std::vector<unsigned char> level;
+	if (size > 0 && (width != size || height != size))
+	{
+		level = TextureArray::Resize(pixels, width, height, size, size);
+		width = height = size;
+	}
+	else
+		level.assign(pixels, pixels + (size_t)width * height * 4);
+	stbi_image_free(pixels);
+
+	// Every level down to 1x1, compressed one after the other
+	std::vector<unsigned char> blocks;
+	int levelWidth = width, levelHeight = height;
+	uint32_t levelCount = 0;
+	for (;;)
+	{
+		size_t offset = blocks.size();
+		blocks.resize(offset + (size_t)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * 8);
+		EncodeBC1(level.data(), levelWidth, levelHeight, blocks.data() + offset);
+		levelCount++;
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		level = downsample(level, levelWidth, levelHeight, levelWidth, levelHeight);
+	}
+
+	std::error_code error;
+	fs::path outputPath(output);
+	if (outputPath.has_parent_path())
+		fs::create_directories(outputPath.parent_path(), error);
+	// Written to a temporary name first so a crash never leaves a broken file that looks up to date
+	std::string temporary = output + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		if (!file)
+		{
+			std::cerr << "Failed to write " << output << std::endl;
+			return false;
+		}
+		// DDS header: magic, size, flags (caps, height, width, pixel format, mip count, linear size), then the pixel format
+		file.write("DDS ", 4);
+		write32(file, 124);
+		write32(file, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000);
+		write32(file, (uint32_t)height);
+		write32(file, (uint32_t)width);
+		write32(file, (uint32_t)(((width + 3) / 4) * ((height + 3) / 4) * 8));
+		write32(file, 0);
+		write32(file, levelCount);
+		for (int i = 0; i < 11; i++)
+			write32(file, 0);
+		write32(file, 32);
+		write32(file, 0x4);
+		file.write("DXT1", 4);
+		for (int i = 0; i < 5; i++)
+			write32(file, 0);
+		// Caps: texture, mipmap, complex
+		write32(file, 0x1000 | 0x400000 | 0x8);
+		for (int i = 0; i < 4; i++)
+			write32(file, 0);
+		file.write((const char*)blocks.data(), blocks.size());
+		if (!file)
+		{
+			std::cerr << "Failed to write " << output << std::endl;
+			return false;
+		}
+	}
+	fs::rename(temporary, output, error);
+	if (error)
+	{
+		fs::remove(output, error);
+		fs::rename(temporary, output, error);
+	}
+	return !error;
+}
+
+// Cooks every source image of inputDir into outputDir
+int TextureCooker::CookDirectory(const std::string& inputDir, const std::string& outputDir)
+{
+	std::vector<std::pair<std::string, std::string>> jobs;
+	std::error_code error;
+	for (const fs::directory_entry& entry : fs::directory_iterator(inputDir, error))
+	{
+		if (!entry.is_regular_file())
+			continue;
+		std::string extension = entry.path().extension().string();
+		std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		if (extension != ".jpg" && extension != ".jpeg" && extension != ".png" && extension != ".tga" && extension != ".bmp")
+			continue;
+		std::string input = entry.path().string();
+		std::string output = (fs::path(outputDir) / entry.path().stem()).string() + ".dds";
+		jobs.push_back({ input, output });
+	}
+	if (error)
+	{
+		std::cerr << "Failed to read directory " << inputDir << std::endl;
+		return 1;
+	}
+
+	// Workers take the next image until none are left, and check it themselves so the images that changed are hashed
+	// on every core too
+	AssetDatabase database((fs::path(outputDir) / DATABASE_NAME).string());
+	std::atomic<size_t> next(0);
+	std::atomic<int> failures(0);
+	std::atomic<int> skipped(0);
+	std::mutex printing;
+	auto work = [&]()
+	{
+		for (size_t i = next++; i < jobs.size(); i = next++)
+		{
+			uint64_t key = AssetDatabase::Combine(AssetDatabase::Combine(database.InputHash(jobs[i].first), VERSION), (uint64_t)size);
+			if (!force && database.UpToDate(jobs[i].second, key))
+			{
+				skipped++;
+				continue;
+			}
+			bool cooked = CookFile(jobs[i].first, jobs[i].second, size);
+			if (cooked)
+				database.Record(jobs[i].second, key);
+			else
+				failures++;
+			std::lock_guard<std::mutex> lock(printing);
+			std::cout << (cooked ? "Cooked " : "Failed ") << jobs[i].first << " -> " << jobs[i].second << std::endl;
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < std::min<size_t>(threads, jobs.size()); i++)
+		workers.emplace_back(work);
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+	database.Save();
+	std::cout << jobs.size() - skipped - failures << " images cooked, " << skipped << " up to date, " << failures << " failed" << std::endl;
+	return failures;
+}
+
+// Cooks images into the pages of a virtual texture
+bool TextureCooker::CookVirtualTexture(const std::vector<std::string>& inputs, const std::string& output)
+{
+	const int pageSize = VirtualTexture::PAGE_SIZE, border = VirtualTexture::BORDER, pageTexels = pageSize + 2 * border;
+	int slotSize = size > 0 ? size : 1024;
+	if (inputs.empty() || slotSize < pageSize || (slotSize & (slotSize - 1)) != 0)
+	{
+		std::cerr << "A virtual texture needs images and slots a power of two of at least " << pageSize << " texels" << std::endl;
+		return false;
+	}
+	// Square and a power of two a side, so every level halves it evenly, and at least a texel per slot at the coarsest
+	uint32_t slotsPerSide = 1;
+	while ((size_t)slotsPerSide * slotsPerSide < inputs.size())
+		slotsPerSide *= 2;
+	if (slotsPerSide > (uint32_t)pageSize)
+	{
+		std::cerr << "A virtual texture holds at most " << pageSize * pageSize << " images" << std::endl;
+		return false;
+	}
+	VirtualTexture::Header header;
+	std::memcpy(header.magic, VirtualTexture::MAGIC, 4);
+	header.pageSize = pageSize;
+	header.border = border;
+	header.slotSize = slotSize;
+	header.slotsPerSide = slotsPerSide;
+	header.images = (uint32_t)inputs.size();
+	header.levels = 1;
+	while ((slotsPerSide * (uint32_t)slotSize >> (header.levels - 1)) > (uint32_t)pageSize)
+		header.levels++;
+	if (VirtualTexture::PagesPerSide(header, 0) > (1u << 14))
+	{
+		std::cerr << "A virtual texture is at most " << (pageSize << 14) << " texels a side" << std::endl;
+		return false;
+	}
+	header.pageCount = VirtualTexture::PageIndex(header, header.levels, 0, 0);
+	// The whole file is one artifact of every image in order, so any image changing cooks it again
+	fs::path outputPath(output);
+	AssetDatabase database((outputPath.parent_path() / DATABASE_NAME).string());
+	uint64_t key = AssetDatabase::Combine(AssetDatabase::Combine(0, VERSION), (uint64_t)slotSize);
+	for (const std::string& input : inputs)
+		key = AssetDatabase::Combine(AssetDatabase::Combine(key, input), database.InputHash(input));
+	if (!force && database.UpToDate(output, key))
+	{
+		database.Save();
+		std::cout << output << " is up to date" << std::endl;
+		return true;
+	}
+	// The finer levels have pages inside one slot, the coarser ones have pages spanning several
+	uint32_t slotLevels = 0;
+	while ((slotSize >> slotLevels) >= pageSize)
+		slotLevels++;
+	uint32_t slotCount = slotsPerSide * slotsPerSide;
+
+	std::vector<std::vector<uint8_t>> pages(header.pageCount);
+	std::vector<std::vector<std::vector<unsigned char>>> coarse(slotCount, std::vector<std::vector<unsigned char>>(header.levels - slotLevels));
+	// Cuts a page of a level out of the levels of the slots, border texels come from the slot of the nearest texel
+	// inside the page and wrap around it, since facades repeat
+	auto cutPage = [&](uint32_t level, uint32_t pageX, uint32_t pageY, const std::function<const std::vector<unsigned char>&(uint32_t)>& slotLevel)
+	{
+		int slotSide = slotSize >> level;
+		int left = (int)pageX * pageSize, bottom = (int)pageY * pageSize;
+		std::vector<unsigned char> texels((size_t)pageTexels * pageTexels * 4);
+		for (int y = 0; y < pageTexels; y++)
+		{
+			for (int x = 0; x < pageTexels; x++)
+			{
+				int texelX = left + x - border, texelY = bottom + y - border;
+				int slotX = std::min(std::max(texelX, left), left + pageSize - 1) / slotSide;
+				int slotY = std::min(std::max(texelY, bottom), bottom + pageSize - 1) / slotSide;
+				int localX = ((texelX - slotX * slotSide) % slotSide + slotSide) % slotSide;
+				int localY = ((texelY - slotY * slotSide) % slotSide + slotSide) % slotSide;
+				const std::vector<unsigned char>& source = slotLevel(slotY * slotsPerSide + slotX);
+				std::memcpy(&texels[((size_t)y * pageTexels + x) * 4], &source[((size_t)localY * slotSide + localX) * 4], 4);
+			}
+		}
+		pages[VirtualTexture::PageIndex(header, level, pageX, pageY)] = ImageWriter::EncodePNG(pageTexels, pageTexels, texels.data());
+	};
+
+	// Workers take the next slot until none are left, each writes the pages inside it and keeps its coarse levels
+	std::atomic<uint32_t> next(0);
+	std::atomic<int> failures(0);
+	auto work = [&]()
+	{
+		for (uint32_t slot = next++; slot < slotCount; slot = next++)
+		{
+			const std::string& input = inputs[slot % inputs.size()];
+			stbi_set_flip_vertically_on_load_thread(1);
+			int width, height, channels;
+			unsigned char* pixels = stbi_load(input.c_str(), &width, &height, &channels, 4);
+			if (!pixels)
+			{
+				std::cerr << "Failed to read " << input << std::endl;
+				failures++;
+				continue;
+			}
+			std::vector<unsigned char> level = width == slotSize && height == slotSize ? std::vector<unsigned char>(pixels, pixels + (size_t)slotSize * slotSize * 4)
+				: TextureArray::Resize(pixels, width, height, slotSize, slotSize);
+			stbi_image_free(pixels);
+			uint32_t slotX = slot % slotsPerSide, slotY = slot / slotsPerSide;
+			int levelSide = slotSize;
+			for (uint32_t l = 0; l < header.levels; l++)
+			{
+				if (l < slotLevels)
+				{
+					uint32_t pagesInSlot = (uint32_t)levelSide / pageSize;
+					for (uint32_t y = 0; y < pagesInSlot; y++)
+						for (uint32_t x = 0; x < pagesInSlot; x++)
+							cutPage(l, slotX * pagesInSlot + x, slotY * pagesInSlot + y, [&](uint32_t) -> const std::vector<unsigned char>& { return level; });
+				}
+				else
+					coarse[slot][l - slotLevels] = level;
+				if (l + 1 < header.levels)
+					level = downsample(level, levelSide, levelSide, levelSide, levelSide);
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < std::min<size_t>(threads, slotCount); i++)
+		workers.emplace_back(work);
+	work();
+	for (std::thread& worker : workers)
+		worker.join();
+	if (failures > 0)
+		return false;
+	for (uint32_t l = slotLevels; l < header.levels; l++)
+	{
+		uint32_t side = VirtualTexture::PagesPerSide(header, l);
+		for (uint32_t y = 0; y < side; y++)
+			for (uint32_t x = 0; x < side; x++)
+				cutPage(l, x, y, [&](uint32_t slot) -> const std::vector<unsigned char>& { return coarse[slot][l - slotLevels]; });
+	}
+
+	std::error_code error;
+	if (outputPath.has_parent_path())
+		fs::create_directories(outputPath.parent_path(), error);
+	std::string temporary = output + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		file.write((const char*)&header, sizeof(header));
+		uint64_t offset = sizeof(header) + ((uint64_t)header.pageCount + 1) * sizeof(uint64_t);
+		for (const std::vector<uint8_t>& page : pages)
+		{
+			file.write((const char*)&offset, sizeof(offset));
+			offset += page.size();
+		}
+		file.write((const char*)&offset, sizeof(offset));
+		for (const std::vector<uint8_t>& page : pages)
+			file.write((const char*)page.data(), page.size());
+		if (!file)
+		{
+			std::cerr << "Failed to write " << output << std::endl;
+			return false;
+		}
+	}
+	fs::rename(temporary, output, error);
+	if (error)
+	{
+		fs::remove(output, error);
+		fs::rename(temporary, output, error);
+	}
+	if (!error)
+	{
+		database.Record(output, key);
+		database.Save();
+		std::cout << "Cooked " << inputs.size() << " images into " << header.pageCount << " pages of " << output << std::endl;
+	}
+	return !error;
+}
@@ -0,0 +1,43 @@
+#ifndef TEXTURE_COOKER_CLASS_H
+#define TEXTURE_COOKER_CLASS_H
+
+#include<cstdint>
+#include<string>
+#include<vector>
+
+// Offline conversion of source images (JPG, PNG, TGA, BMP) into DDS files the runtime uploads as they are
+// Output is BC1 with a full box filtered mip chain, flipped bottom row first like OpenGL expects
+// Images too many and too large for the GPU to hold at once are cooked into the pages of a VirtualTexture instead
+// An AssetDatabase next to the outputs records what each was cooked from, so only changed images are cooked again
+class TextureCooker
+{
+public:
+	// Version of the cooked output, raised whenever a change to the cooker changes the bytes it writes so every
+	// artifact is cooked again
+	static constexpr uint64_t VERSION = 1;
+	// Name of the AssetDatabase in the output directory
+	static constexpr const char* DATABASE_NAME = "assets.db";
+
+	// Number of images cooked at once, 0 uses every core
+	unsigned int threads;
+	// Cooks images even when they are up to date
+	bool force = false;
+	// Resizes every image to size x size so they can share a texture array, 0 keeps their own size
+	int size = 0;
+
+	// Constructor that sets the number of threads
+	TextureCooker(unsigned int threads = 0);
+
+	// Cooks every source image of inputDir into outputDir/<name>.dds, returns how many failed
+	// Images whose content, size setting and cooker version are those of their last cook are skipped
+	int CookDirectory(const std::string& inputDir, const std::string& outputDir);
+	// Cooks images into the slots of one VirtualTexture file at output, size texels a side each or 1024 without a size
+	// Returns false if an image cannot be read or the file cannot be written, and skips the cook if no image changed
+	bool CookVirtualTexture(const std::vector<std::string>& inputs, const std::string& output);
+	// Cooks one image, returns false if it cannot be read or the output cannot be written
+	static bool CookFile(const std::string& input, const std::string& output, int size = 0);
+	// Compresses an RGBA8 image into BC1 blocks, out holds one 8 byte block per 4x4 texels
+	static void EncodeBC1(const unsigned char* rgba, int width, int height, unsigned char* out);
+};
+
+#endif
@@ -0,0 +1,490 @@
+#include"TextureLoader.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"ImageConvert.h"
+#include"LogQueue.h"
+#include"TraceRecorder.h"
+
+#include<stb/stb_image.h>
+#include<algorithm>
+#include<chrono>
+#include<cstdint>
+#include<cstring>
+#include<fstream>
+
+// Constructor that decodes on the workers of jobs and creates the upload ring
+TextureLoader::TextureLoader(JobSystem& jobs)
+	: jobs(jobs)
+{
+	if (!GLExt.bufferStorage)
+		return;
+	// Coherent writes from the workers reach the GPU without a flush, the fences keep them apart from its reads
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &ring);
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, SLOT_BYTES * RING_SLOTS, nullptr, flags);
+	ringMapping = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SLOT_BYTES * RING_SLOTS, flags);
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	if (!ringMapping)
+	{
+		GLState.DeleteBuffers(1, &ring);
+		ring = 0;
+		return;
+	}
+	GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, ring, SLOT_BYTES * RING_SLOTS);
+}
+
+// Job that decodes the oldest queued image
+void TextureLoader::decode()
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping || queued.empty())
+			return;
+		job = std::move(queued.front());
+		queued.pop_front();
+	}
+	TraceScope trace("decode texture", "job", job.path);
+
+	if (!job.encoded && CompressedImage::IsCompressedFile(job.path.c_str()))
+	{
+		job.isCompressed = true;
+		if (job.compressed.Load(job.path.c_str()))
+			moveToSlot(job, job.compressed.data.data(), (GLsizeiptr)job.compressed.data.size());
+	}
+	else
+	{
+		// stb_image keeps the channels of the file and leaves the rows as they are, ImageConvert widens and flips
+		// them in one pass. Its flip setting is global, the thread local one keeps workers from changing each other's
+		stbi_set_flip_vertically_on_load_thread(false);
+		unsigned char* pixels = job.encoded
+			? stbi_load_from_memory(job.encoded->data(), (int)job.encoded->size(), &job.width, &job.height, &job.channels, 0)
+			: stbi_load(job.path.c_str(), &job.width, &job.height, &job.channels, 0);
+		// Array layers are always RGBA8 of the array size, images that keep their size go straight into a ring slot
+		bool resize = job.layer >= 0 && (job.width != job.arrayWidth || job.height != job.arrayHeight);
+		GLsizeiptr size = (GLsizeiptr)job.width * job.height * 4;
+		unsigned char* target = pixels && !resize ? acquireSlot(size, job.slot) : nullptr;
+		if (pixels && !target)
+		{
+			job.rgba.resize((size_t)size);
+			target = job.rgba.data();
+		}
+		if (pixels)
+		{
+			ImageConvert::ToRGBA(pixels, job.width, job.height, job.channels, job.flip, target);
+			job.channels = 4;
+		}
+		stbi_image_free(pixels);
+		if (pixels && resize)
+		{
+			job.rgba = TextureArray::Resize(job.rgba.data(), job.width, job.height, job.arrayWidth, job.arrayHeight);
+			moveToSlot(job, job.rgba.data(), (GLsizeiptr)job.rgba.size());
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	decoded.push_back(std::move(job));
+	decodedChanged.notify_all();
+}
+
+// Queues an image to be decoded and uploaded into an existing texture
+void TextureLoader::Load(GLuint texture, GLenum target, const char* path, GLenum internalFormat, GLenum format, GLenum pixelType, bool flip)
+{
+	Job job;
+	job.texture = texture;
+	job.target = target;
+	job.internalFormat = internalFormat;
+	job.format = format;
+	job.pixelType = pixelType;
+	job.path = path;
+	job.flip = flip;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(std::move(job));
+		inFlight++;
+	}
+	jobs.Submit([this] { decode(); }, &decoding);
+}
+
+// Queues an image for one layer of a texture array
+void TextureLoader::LoadLayer(const TextureArray& array, GLsizei layer, const char* path, bool flip)
+{
+	LoadLayers(array, { layer }, path, flip);
+}
+
+// Queues an image for several layers of a texture array
+void TextureLoader::LoadLayers(const TextureArray& array, const std::vector<GLsizei>& layers, const char* path, bool flip)
+{
+	if (layers.empty())
+		return;
+	Job job;
+	job.texture = array.ID;
+	job.target = GL_TEXTURE_2D_ARRAY;
+	job.internalFormat = array.internalFormat;
+	job.format = GL_RGBA;
+	job.pixelType = GL_UNSIGNED_BYTE;
+	job.path = path;
+	job.flip = flip;
+	job.layer = layers[0];
+	job.copies.assign(layers.begin() + 1, layers.end());
+	job.arrayWidth = array.width;
+	job.arrayHeight = array.height;
+	job.arrayLevels = array.levels;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(std::move(job));
+		inFlight++;
+	}
+	jobs.Submit([this] { decode(); }, &decoding);
+}
+
+// Queues an image file in memory for one layer of a texture array
+void TextureLoader::LoadLayer(const TextureArray& array, GLsizei layer, Encoded image, const std::string& name, bool flip)
+{
+	LoadLayers(array, { layer }, std::move(image), name, flip);
+}
+
+// Queues an image file in memory for several layers of a texture array
+void TextureLoader::LoadLayers(const TextureArray& array, const std::vector<GLsizei>& layers, Encoded image, const std::string& name, bool flip)
+{
+	if (layers.empty())
+		return;
+	Job job;
+	job.texture = array.ID;
+	job.target = GL_TEXTURE_2D_ARRAY;
+	job.internalFormat = array.internalFormat;
+	job.format = GL_RGBA;
+	job.pixelType = GL_UNSIGNED_BYTE;
+	job.path = name;
+	job.encoded = std::move(image);
+	job.flip = flip;
+	job.layer = layers[0];
+	job.copies.assign(layers.begin() + 1, layers.end());
+	job.arrayWidth = array.width;
+	job.arrayHeight = array.height;
+	job.arrayLevels = array.levels;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queued.push_back(std::move(job));
+		inFlight++;
+	}
+	jobs.Submit([this] { decode(); }, &decoding);
+}
+
+// Copies bytes into the pixel buffer and leaves it bound
+const unsigned char* TextureLoader::stage(const unsigned char* bytes, GLsizeiptr size)
+{
+	GLState.CountUpload(size);
+	// Orphans the buffer so the copy never waits for the previous upload to be read
+	if (pbo == 0)
+		glGenBuffers(1, &pbo);
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+	if (size > pboSize)
+		pboSize = size;
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, pboSize, nullptr, GL_STREAM_DRAW);
+	GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, pbo, pboSize);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (!mapped)
+	{
+		// Uploads straight from the bytes when the buffer cannot be mapped
+		GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return bytes;
+	}
+	memcpy(mapped, bytes, size);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	return (const unsigned char*)0;
+}
+
+// Binds the ring and returns the offset of the job's slot, or stages its bytes
+const unsigned char* TextureLoader::stage(const Job& job, const unsigned char* bytes, GLsizeiptr size)
+{
+	if (job.slot < 0)
+		return stage(bytes, size);
+	// The job wrote the bytes on its worker, the copy from the slot runs on the GPU's own time
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+	GLState.CountUpload(size);
+	return (const unsigned char*)(uintptr_t)(job.slot * SLOT_BYTES);
+}
+
+// Claims a free ring slot for a job
+unsigned char* TextureLoader::acquireSlot(GLsizeiptr size, GLint& slot)
+{
+	slot = -1;
+	if (size > SLOT_BYTES)
+		return nullptr;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!ringMapping)
+		return nullptr;
+	for (int i = 0; i < RING_SLOTS; i++)
+		if (slots[i] == SLOT_FREE)
+		{
+			slots[i] = SLOT_WRITING;
+			slot = i;
+			return ringMapping + i * SLOT_BYTES;
+		}
+	return nullptr;
+}
+
+// Copies decoded bytes into a ring slot if one is free
+void TextureLoader::moveToSlot(Job& job, const unsigned char* bytes, GLsizeiptr size)
+{
+	unsigned char* target = acquireSlot(size, job.slot);
+	if (!target)
+		return;
+	memcpy(target, bytes, size);
+	// Pixels are only read from the slot from now on, compressed files keep their bytes for their size
+	if (!job.isCompressed)
+		job.rgba.clear();
+}
+
+// Fences the slot of an uploaded job
+void TextureLoader::releaseSlot(Job& job)
+{
+	if (job.slot < 0)
+		return;
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	std::lock_guard<std::mutex> lock(mutex);
+	slotFences[job.slot] = fence;
+	slots[job.slot] = SLOT_UPLOADING;
+	job.slot = -1;
+}
+
+// Frees the slots the GPU is done reading
+void TextureLoader::retireSlots()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int i = 0; i < RING_SLOTS; i++)
+	{
+		if (slots[i] != SLOT_UPLOADING)
+			continue;
+		GLenum result = glClientWaitSync(slotFences[i], 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+			continue;
+		glDeleteSync(slotFences[i]);
+		slotFences[i] = nullptr;
+		slots[i] = SLOT_FREE;
+	}
+}
+
+// Copies a layer of a texture array through the pixel buffer
+void TextureLoader::uploadLayer(Job& job)
+{
+	bool compressedArray = CompressedImage::LevelSize(job.internalFormat, 4, 4) > 0;
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, job.texture);
+	if (job.isCompressed)
+	{
+		const CompressedImage& image = job.compressed;
+		if (image.levels.empty())
+		{
+			GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			return;
+		}
+		if (!compressedArray || image.format != job.internalFormat || image.width != job.arrayWidth || image.height != job.arrayHeight)
+		{
+			LOG_MESSAGE(LOG_WARNING, "Layer %s does not match the format and size of its texture array", job.path.c_str());
+			GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+			return;
+		}
+		const unsigned char* source = stage(job, image.data.data(), (GLsizeiptr)image.data.size());
+		GLsizei levelCount = std::min((GLsizei)image.levels.size(), job.arrayLevels);
+		for (GLsizei layer = -1; layer < (GLsizei)job.copies.size(); layer++)
+			for (GLsizei i = 0; i < levelCount; i++)
+			{
+				const CompressedImage::Level& level = image.levels[i];
+				glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer < 0 ? job.layer : job.copies[layer], level.width, level.height, 1, image.format, (GLsizei)level.size, source + level.offset);
+			}
+	}
+	else if (job.rgba.empty() && job.slot < 0)
+	{
+		LOG_MESSAGE(LOG_ERROR, "Failed to load texture %s", job.path.c_str());
+	}
+	else if (compressedArray)
+	{
+		LOG_MESSAGE(LOG_WARNING, "Layer %s has to be cooked to fill a compressed texture array", job.path.c_str());
+	}
+	else
+	{
+		const unsigned char* source = stage(job, job.rgba.data(), (GLsizeiptr)job.arrayWidth * job.arrayHeight * 4);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, job.layer, job.arrayWidth, job.arrayHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, source);
+		for (GLsizei copy : job.copies)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, copy, job.arrayWidth, job.arrayHeight, 1, GL_RGBA, GL_UNSIGNED_BYTE, source);
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// Copies the blocks of a compressed file into its texture through the pixel buffer
+void TextureLoader::uploadCompressed(Job& job)
+{
+	const CompressedImage& image = job.compressed;
+	if (image.levels.empty())
+		return;
+	if (!image.Supported())
+	{
+		LOG_MESSAGE(LOG_WARNING, "Compressed format of %s is not supported by this GPU, keeping the placeholder", job.path.c_str());
+		return;
+	}
+
+	const unsigned char* source = stage(job, image.data.data(), (GLsizeiptr)image.data.size());
+
+	// The mip chain comes from the file, nothing is generated
+	GLState.BindTexture(job.target, job.texture);
+	image.Upload(job.target, source);
+	GLState.BindTexture(job.target, 0);
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, job.texture, (int64_t)image.byteSize());
+}
+
+// Copies one decoded image into its texture through the pixel buffer
+void TextureLoader::upload(Job& job)
+{
+	if (job.layer >= 0)
+	{
+		uploadLayer(job);
+		return;
+	}
+	if (job.isCompressed)
+	{
+		uploadCompressed(job);
+		return;
+	}
+	if (job.rgba.empty() && job.slot < 0)
+	{
+		LOG_MESSAGE(LOG_ERROR, "Failed to load texture %s", job.path.c_str());
+		return;
+	}
+
+	// Decoded images are RGBA8 whatever the file held, so rows are always a multiple of four bytes
+	const unsigned char* source = stage(job, job.rgba.data(), (GLsizeiptr)job.width * job.height * 4);
+	GLState.BindTexture(job.target, job.texture);
+	glTexImage2D(job.target, 0, job.internalFormat, job.width, job.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, source);
+	glGenerateMipmap(job.target);
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, job.texture, GpuMemoryTracker::ImageBytes(job.internalFormat, job.width, job.height, 1, GpuMemoryTracker::MipLevels(job.width, job.height)));
+	GLState.BindTexture(job.target, 0);
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	job.rgba.clear();
+}
+
+// Uploads decoded images until the budget is used up
+size_t TextureLoader::Upload(double budgetMs)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t count = 0;
+	retireSlots();
+	for (;;)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (decoded.empty())
+				break;
+			job = std::move(decoded.front());
+			decoded.pop_front();
+		}
+		upload(job);
+		releaseSlot(job);
+		count++;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			inFlight--;
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budgetMs)
+			break;
+	}
+	return count;
+}
+
+// Blocks until every queued image has been decoded and uploaded
+void TextureLoader::Finish()
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			decodedChanged.wait(lock, [this] { return inFlight == 0 || !decoded.empty(); });
+			if (inFlight == 0)
+				return;
+		}
+		Upload(1e9);
+	}
+}
+
+// Number of images queued, being decoded or waiting for upload
+size_t TextureLoader::pending()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return inFlight;
+}
+
+// Reads an image file into memory
+TextureLoader::Encoded TextureLoader::Read(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file)
+		return nullptr;
+	std::streamsize size = file.tellg();
+	file.seekg(0);
+	auto bytes = std::make_shared<std::vector<unsigned char>>((size_t)std::max<std::streamsize>(size, 0));
+	if (!file.read((char*)bytes->data(), size))
+		return nullptr;
+	return bytes;
+}
+
+// Fills a texture with a small gray checker pattern
+void TextureLoader::Placeholder(GLuint texture, GLenum target)
+{
+	const unsigned char pixels[] =
+	{
+		160, 160, 160, 255,   96,  96,  96, 255,
+		 96,  96,  96, 255,  160, 160, 160, 255
+	};
+	GLState.BindTexture(target, texture);
+	glTexImage2D(target, 0, GL_RGBA, 2, 2, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glGenerateMipmap(target);
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, texture, GpuMemoryTracker::ImageBytes(GL_RGBA8, 2, 2, 1, 2));
+	GLState.BindTexture(target, 0);
+}
+
+// Waits for the decode jobs and deletes the upload buffer
+void TextureLoader::Delete()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	// Jobs that did not start yet return at once
+	jobs.Wait(decoding);
+
+	decoded.clear();
+	queued.clear();
+	inFlight = 0;
+
+	if (pbo != 0)
+		GLState.DeleteBuffers(1, &pbo);
+	pbo = 0;
+	pboSize = 0;
+
+	for (int i = 0; i < RING_SLOTS; i++)
+	{
+		if (slotFences[i])
+			glDeleteSync(slotFences[i]);
+		slotFences[i] = nullptr;
+		slots[i] = SLOT_FREE;
+	}
+	if (ring != 0)
+	{
+		GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, ring);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		GLState.DeleteBuffers(1, &ring);
+	}
+	ring = 0;
+	ringMapping = nullptr;
+}
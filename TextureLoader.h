@@ -0,0 +1,139 @@
+#ifndef TEXTURE_LOADER_CLASS_H
+#define TEXTURE_LOADER_CLASS_H
+
+#include<glad/glad.h>
+#include<condition_variable>
+#include<deque>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<vector>
+
+#include"CompressedImage.h"
+#include"JobSystem.h"
+#include"TextureArray.h"
+
+// Decodes images as jobs of the engine's job system and uploads them on the GL thread a few at a time
+// Textures handed to Load keep a placeholder until their image has been uploaded
+// DDS and KTX2 files are read as they are and uploaded with their own mip chain
+// Images already in memory, such as the PNG and JPEG files embedded in a model, are decoded the same way
+// With GL 4.4 buffer storage the jobs write their pixels straight into a persistently mapped ring of pixel buffer
+// slots, so the GL thread only issues the copy from the slot and the GPU transfers it while rendering goes on
+// Fences hand the slots back once the GPU has read them, images that find no free slot or do not fit one are
+// copied into a plain pixel buffer on the GL thread as before
+class TextureLoader
+{
+public:
+	// Bytes of an image file in memory, shared with the job that decodes them
+	typedef std::shared_ptr<const std::vector<unsigned char>> Encoded;
+
+	// Slots in the upload ring and the bytes each holds, enough for a 2048 x 1024 RGBA8 image
+	static constexpr int RING_SLOTS = 4;
+	static constexpr GLsizeiptr SLOT_BYTES = 8 << 20;
+
+	// Constructor that decodes on the workers of jobs, which has to outlive the loader
+	// Call with the context current and GLExt loaded, it creates the upload ring
+	TextureLoader(JobSystem& jobs);
+
+	// Queues an image to be decoded and uploaded into an existing texture, it is always uploaded as RGBA8 bytes
+	void Load(GLuint texture, GLenum target, const char* path, GLenum internalFormat, GLenum format, GLenum pixelType, bool flip);
+	// Queues an image for one layer of a texture array, it is resized to the array size
+	// Compressed arrays take DDS or KTX2 files of exactly their format and size
+	void LoadLayer(const TextureArray& array, GLsizei layer, const char* path, bool flip);
+	// Same for an image several layers repeat, it is decoded once and uploaded into each of them
+	void LoadLayers(const TextureArray& array, const std::vector<GLsizei>& layers, const char* path, bool flip);
+	// Same for an image file in memory, name stands in for the path in messages
+	void LoadLayer(const TextureArray& array, GLsizei layer, Encoded image, const std::string& name, bool flip);
+	void LoadLayers(const TextureArray& array, const std::vector<GLsizei>& layers, Encoded image, const std::string& name, bool flip);
+	// Reads an image file into memory on any thread, without a context, nullptr if it cannot be read
+	static Encoded Read(const std::string& path);
+	// Uploads decoded images until budgetMs milliseconds have passed, at least one if any is ready, returns how many
+	// Call once per frame on the GL thread
+	size_t Upload(double budgetMs);
+	// Blocks until every queued image has been decoded and uploaded
+	void Finish();
+	// Number of images queued, being decoded or waiting for upload
+	size_t pending();
+
+	// Fills a texture with a small gray checker pattern so it can be drawn before its image is there
+	static void Placeholder(GLuint texture, GLenum target);
+
+	// Waits for the decode jobs that started and deletes the upload buffer, images not uploaded yet are thrown away
+	void Delete();
+private:
+	// One image going through the loader
+	struct Job
+	{
+		GLuint texture;
+		GLenum target;
+		GLenum internalFormat;
+		GLenum format;
+		GLenum pixelType;
+		std::string path;
+		// Set for images in memory, which are never DDS or KTX2
+		Encoded encoded;
+		bool flip;
+		int width = 0;
+		int height = 0;
+		int channels = 0;
+		// Decoded RGBA8 pixels flipped as asked, resized to the array size for layers, empty if decoding failed
+		std::vector<unsigned char> rgba;
+		// Ring slot the pixels or blocks were written to, -1 when they stay in rgba or compressed
+		GLint slot = -1;
+		// Set instead of rgba for DDS and KTX2 files
+		bool isCompressed = false;
+		CompressedImage compressed;
+		// Layer of a texture array, -1 for plain textures, with the array's layout
+		// Further layers of the same image are filled from the same pixels
+		GLint layer = -1;
+		std::vector<GLsizei> copies;
+		GLsizei arrayWidth = 0;
+		GLsizei arrayHeight = 0;
+		GLsizei arrayLevels = 0;
+	};
+
+	JobSystem& jobs;
+	// Counts the decode jobs submitted, one for every image queued
+	JobSystem::Counter decoding;
+	std::mutex mutex;
+	// Wakes Finish when images are decoded
+	std::condition_variable decodedChanged;
+	std::deque<Job> queued;
+	std::deque<Job> decoded;
+	size_t inFlight = 0;
+	bool stopping = false;
+
+	// Pixel buffer the images are copied into before being uploaded, grown to the largest image
+	GLuint pbo = 0;
+	GLsizeiptr pboSize = 0;
+
+	// Persistently mapped ring the jobs write into, guarded by mutex, and the fence of each slot the GPU reads
+	enum SlotState { SLOT_FREE, SLOT_WRITING, SLOT_UPLOADING };
+	GLuint ring = 0;
+	unsigned char* ringMapping = nullptr;
+	SlotState slots[RING_SLOTS] = {};
+	GLsync slotFences[RING_SLOTS] = {};
+
+	// Job that decodes the oldest queued image, there is one for every image so it may find the queue empty
+	void decode();
+	// Copies one decoded image into its texture through the pixel buffer
+	void upload(Job& job);
+	// Same for the blocks of a DDS or KTX2 file
+	void uploadCompressed(Job& job);
+	// Same for a layer of a texture array
+	void uploadLayer(Job& job);
+	// Copies bytes into the pixel buffer and leaves it bound, returns the pointer to pass to GL
+	// which is the start of the buffer, or the bytes themselves if the buffer cannot be mapped
+	const unsigned char* stage(const unsigned char* bytes, GLsizeiptr size);
+	// Same for the bytes of a job, which are already in place if the job wrote them to a ring slot
+	const unsigned char* stage(const Job& job, const unsigned char* bytes, GLsizeiptr size);
+	// Claims a free ring slot of at least size bytes for a job, returns where to write or nullptr if none is free
+	unsigned char* acquireSlot(GLsizeiptr size, GLint& slot);
+	// Copies bytes a job decoded into a ring slot if one is free, so the GL thread does not have to
+	void moveToSlot(Job& job, const unsigned char* bytes, GLsizeiptr size);
+	// Fences the slot of an uploaded job, and frees the slots whose fence the GPU has passed
+	void releaseSlot(Job& job);
+	void retireSlots();
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include"TextureStreamer.h"
+
+#include"CompressedImage.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"LogQueue.h"
+#include"TraceRecorder.h"
+
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<utility>
+
+// Constructor that releases every level but the coarsest
+TextureStreamer::TextureStreamer(TextureArray& array, std::vector<std::string> paths, JobSystem& jobs, int64_t budgetBytes)
+	: array(array), paths(std::move(paths)), jobs(jobs)
+{
+	// The finest level whose chain down to 1x1 still fits, the coarsest one always does
+	budgetLevel = array.levels - 1;
+	for (GLsizei level = array.levels - 2; level >= 0; level--)
+	{
+		int64_t bytes = GpuMemoryTracker::ImageBytes(array.internalFormat, std::max(1, array.width >> level), std::max(1, array.height >> level), array.layers, array.levels - level);
+		if (bytes > budgetBytes)
+			break;
+		budgetLevel = level;
+	}
+	wanted = array.levels - 1;
+	resident = array.levels;
+	if (!array.compressed())
+		LOG_MESSAGE(LOG_WARNING, "Only compressed texture arrays can stream their levels from cooked files");
+	if (array.immutable)
+		LOG_MESSAGE(LOG_WARNING, "Texture arrays have to be created as streamed to release their levels, they keep their memory");
+
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, array.ID);
+	clamp();
+	for (GLsizei level = 0; level < array.levels - 1; level++)
+		specify(level, nullptr);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Waits for the loads in flight unless Delete was already called
+TextureStreamer::~TextureStreamer()
+{
+	Delete();
+}
+
+// Finest level whose texels are no smaller than a pixel
+GLsizei TextureStreamer::DemandLevel(float texelsPerUnit, float pixelsPerUnit)
+{
+	if (pixelsPerUnit <= 0.0f)
+		return 0;
+	return (GLsizei)std::max(0.0f, std::floor(std::log2(texelsPerUnit / pixelsPerUnit)));
+}
+
+// Sets the finest level wanted
+void TextureStreamer::Request(GLsizei level)
+{
+	wanted = std::min(std::max(level, budgetLevel), array.levels - 1);
+}
+
+// Finishes a load, starts the next one or evicts
+void TextureStreamer::Update()
+{
+	if (inFlight)
+	{
+		if (!loading.Done())
+			return;
+		inFlight = false;
+		if (failed)
+		{
+			// The levels resident stay usable, only finer ones are never read
+			broken = true;
+			loaded.clear();
+			return;
+		}
+		// Coarse to fine, so every level specified keeps the chain below the base level complete
+		GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		GLState.BindTexture(GL_TEXTURE_2D_ARRAY, array.ID);
+		for (GLsizei level = loadEnd - 1; level >= loadFirst; level--)
+			specify(level, loaded[level - loadFirst].data());
+		resident = std::min(resident, loadFirst);
+		clamp();
+		GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		loaded.clear();
+		return;
+	}
+	if (broken || paths.empty())
+		return;
+
+	if (wanted < resident || invalidated)
+	{
+		coarserFrames = 0;
+		loadFirst = std::min(wanted, resident);
+		loadEnd = invalidated ? array.levels : resident;
+		invalidated = false;
+		loaded.resize(loadEnd - loadFirst);
+		for (GLsizei level = loadFirst; level < loadEnd; level++)
+			loaded[level - loadFirst].resize(levelBytes(level));
+		failed = false;
+		inFlight = true;
+		for (GLsizei layer = 0; layer < array.layers; layer++)
+			jobs.Submit([this, layer] { loadLayer(layer); }, &loading);
+		return;
+	}
+	if (wanted == resident || ++coarserFrames < EVICT_FRAMES)
+	{
+		if (wanted == resident)
+			coarserFrames = 0;
+		return;
+	}
+	// Sampling moves to the coarser level before the finer ones lose their texels
+	coarserFrames = 0;
+	GLsizei finest = resident;
+	resident = wanted;
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, array.ID);
+	clamp();
+	for (GLsizei level = finest; level < resident; level++)
+		specify(level, nullptr);
+	GLState.BindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Reads every resident level again
+void TextureStreamer::Invalidate()
+{
+	invalidated = true;
+	broken = false;
+}
+
+// Checks if no load is in flight and every wanted level is resident
+bool TextureStreamer::settled() const
+{
+	return !inFlight && !invalidated && (resident <= wanted || broken);
+}
+
+// Finest level resident
+GLsizei TextureStreamer::residentLevel() const
+{
+	return resident;
+}
+
+// Bytes of the levels resident
+int64_t TextureStreamer::residentBytes() const
+{
+	GLsizei base = std::min(resident, array.levels - 1);
+	return GpuMemoryTracker::ImageBytes(array.internalFormat, std::max(1, array.width >> base), std::max(1, array.height >> base), array.layers, array.levels - base);
+}
+
+// Waits for the loads in flight
+void TextureStreamer::Delete()
+{
+	if (!inFlight)
+		return;
+	jobs.Wait(loading);
+	inFlight = false;
+	loaded.clear();
+}
+
+// Reads the levels being loaded of one layer from its file
+void TextureStreamer::loadLayer(GLsizei layer)
+{
+	const std::string& path = paths[layer % paths.size()];
+	TraceScope trace("stream texture", "job", path);
+	CompressedImage image;
+	if (!image.Load(path.c_str()))
+	{
+		failed = true;
+		return;
+	}
+	if (image.format != array.internalFormat || image.width != array.width || image.height != array.height || (GLsizei)image.levels.size() < loadEnd)
+	{
+		LOG_MESSAGE(LOG_WARNING, "Layer %s does not match the format, size and levels of its texture array", path.c_str());
+		failed = true;
+		return;
+	}
+	for (GLsizei level = loadFirst; level < loadEnd; level++)
+	{
+		const CompressedImage::Level& source = image.levels[level];
+		std::vector<unsigned char>& target = loaded[level - loadFirst];
+		if (source.size * array.layers != target.size())
+		{
+			failed = true;
+			return;
+		}
+		std::memcpy(target.data() + layer * source.size, image.data.data() + source.offset, source.size);
+	}
+}
+
+// Bytes of one level of every layer
+size_t TextureStreamer::levelBytes(GLsizei level) const
+{
+	return CompressedImage::LevelSize(array.internalFormat, std::max(1, array.width >> level), std::max(1, array.height >> level)) * array.layers;
+}
+
+// Specifies a level of every layer of the bound array
+void TextureStreamer::specify(GLsizei level, const unsigned char* blocks)
+{
+	// Immutable levels are only filled, releasing them just leaves them unsampled
+	if (array.immutable)
+	{
+		if (blocks)
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, std::max(1, array.width >> level), std::max(1, array.height >> level), array.layers, array.internalFormat, (GLsizei)levelBytes(level), blocks);
+		return;
+	}
+	if (blocks)
+		glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.internalFormat, std::max(1, array.width >> level), std::max(1, array.height >> level), array.layers, 0, (GLsizei)levelBytes(level), blocks);
+	else
+		glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, array.internalFormat, 0, 0, 0, 0, 0, nullptr);
+}
+
+// Clamps sampling of the bound array to the resident levels
+void TextureStreamer::clamp()
+{
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, std::min(resident, array.levels - 1));
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, array.ID, residentBytes());
+}
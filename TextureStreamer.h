@@ -0,0 +1,88 @@
+#ifndef TEXTURE_STREAMER_CLASS_H
+#define TEXTURE_STREAMER_CLASS_H
+
+#include<glad/glad.h>
+#include<atomic>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+#include"JobSystem.h"
+#include"TextureArray.h"
+
+// Keeps only the mip levels of a compressed texture array that the view needs resident, read from the cooked files of
+// its layers on the workers of the job system. Every frame the caller requests the finest level the nearest surface
+// using the array needs, from the size of a texel on screen, and the streamer loads the finer levels that are missing
+// or evicts the ones no longer needed, never going finer than the levels that fit into a budget of bytes.
+// Levels are the same for every layer of an array, so the array's GL_TEXTURE_BASE_LEVEL clamps sampling to the
+// finest resident one while the levels above it are specified with no texels, which releases their memory.
+class TextureStreamer
+{
+public:
+	// Frames the demand has to stay coarser before the finer levels are evicted, so they are not dropped and read
+	// again while the camera moves back and forth around a boundary
+	static constexpr int EVICT_FRAMES = 120;
+
+	// Constructor for a compressed array whose layers come from paths, one DDS or KTX2 file each of exactly its format
+	// and size, with at most budgetBytes of levels resident. Every level is released, the coarsest keeps the
+	// array's placeholder until the first Update starts loading
+	TextureStreamer(TextureArray& array, std::vector<std::string> paths, JobSystem& jobs, int64_t budgetBytes);
+	// Waits for the loads in flight unless Delete was already called
+	~TextureStreamer();
+	// A TextureStreamer refers to its array and its jobs, so it cannot be copied
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// Finest mip level that shows texelsPerUnit texels per unit of a surface at pixelsPerUnit pixels per unit on screen
+	static GLsizei DemandLevel(float texelsPerUnit, float pixelsPerUnit);
+
+	// Sets the finest level wanted, clamped to the levels of the array and the budget
+	void Request(GLsizei level);
+	// Uploads a finished load and clamps the array to it, starts loading the levels that are missing or evicts the
+	// ones no longer wanted. Call once per frame on the GL thread
+	void Update();
+	// Reads every resident level again, after the files of the layers changed
+	void Invalidate();
+	// Checks if no load is in flight and every wanted level is resident
+	bool settled() const;
+	// Finest level resident, the array's level count while only the placeholder is
+	GLsizei residentLevel() const;
+	// Bytes of the levels resident
+	int64_t residentBytes() const;
+
+	// Waits for the loads in flight, does nothing if they were already waited for
+	void Delete();
+private:
+	TextureArray& array;
+	std::vector<std::string> paths;
+	JobSystem& jobs;
+	// Finest level that fits into the budget
+	GLsizei budgetLevel = 0;
+	GLsizei wanted = 0;
+	GLsizei resident = 0;
+	// Frames the demand has been coarser than the resident levels
+	int coarserFrames = 0;
+
+	// Levels from loadFirst to loadEnd being read, one job per layer writes its blocks into every level's slice of loaded
+	JobSystem::Counter loading;
+	bool inFlight = false;
+	GLsizei loadFirst = 0;
+	GLsizei loadEnd = 0;
+	std::vector<std::vector<unsigned char>> loaded;
+	std::atomic<bool> failed{ false };
+	// Set once a file could not be used, the levels resident then stay as they are
+	bool broken = false;
+	// Set by Invalidate until the next load reads every level again
+	bool invalidated = false;
+
+	// Reads the levels being loaded of one layer from its file, on a worker
+	void loadLayer(GLsizei layer);
+	// Bytes of one level of every layer
+	size_t levelBytes(GLsizei level) const;
+	// Specifies a level of every layer with blocks, or with no texels when blocks is null
+	void specify(GLsizei level, const unsigned char* blocks);
+	// Clamps sampling to the resident levels and reports their size
+	void clamp();
+};
+
+#endif
@@ -0,0 +1,786 @@
+#include"TileStreamer.h"
+#include"LogQueue.h"
+#include"MeshCodec.h"
+#include"TraceRecorder.h"
+
+#include<glm/gtc/constants.hpp>
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstring>
+#include<filesystem>
+#include<fstream>
+
+namespace fs = std::filesystem;
+
+// Start of every tile file, followed by the floats per vertex, the vertex count, the index count and the data
+static const uint32_t TILE_MAGIC = 0x4F4C4954; // "TILO"
+// Start of the files of the earlier format, whose vertices are in world space instead of around the tile's center
+static const uint32_t WORLD_TILE_MAGIC = 0x454C4954; // "TILE"
+// Start of the compressed files, whose last header word is the bytes of the MeshCodec data instead of the index count
+static const uint32_t PACKED_TILE_MAGIC = 0x5A4C4954; // "TILZ"
+
+// Number of tiles of a layout that fit into a budget, at least one
+// Packed tiles are measured by encoding one, every tile of a layout comes out within a few chunks of the others
+static GLuint tilesInBudget(const CityLayout& layout, GLsizeiptr budgetBytes, bool packed = false)
+{
+	CityGenerator city(layout);
+	GLsizeiptr tileBytes = (GLsizeiptr)(city.vertexCount() * CityGenerator::VERTEX_FLOATS * sizeof(GLfloat) + city.indexCount() * EBO::IndexSize(EBO::IndexType(city.vertexCount())));
+	if (packed)
+	{
+		std::vector<GLfloat> vertices(city.vertexCount() * CityGenerator::VERTEX_FLOATS);
+		std::vector<GLuint> indices(city.indexCount());
+		city.Generate(vertices.data(), indices.data());
+		GpuMeshCodec::Encoded encoded = GpuMeshCodec::Encode(vertices.data(), city.vertexCount(), indices.data(), indices.size(), CityGenerator::GROUND_INDICES);
+		tileBytes = (GLsizeiptr)encoded.chunks() * GpuMeshCodec::CHUNK_BYTES;
+	}
+	return (GLuint)std::max<GLsizeiptr>(budgetBytes / tileBytes, 1);
+}
+
+// Constructor that sizes the heap to budgetBytes and loads tiles on the workers of jobs
+// A packed heap is the whole budget in chunks, the tiles take as many as their meshlets need
+TileStreamer::TileStreamer(const CityLayout& tileLayout, int tilesX, int tilesZ, const std::string& directory, GLsizeiptr budgetBytes, float loadRadius, JobSystem& jobs, bool packed)
+	: packed(packed),
+	heap(packed ? GpuBufferHeap(GpuMeshCodec::CHUNK_BYTES, (GLuint)(budgetBytes / GpuMeshCodec::CHUNK_BYTES), 0)
+		: GpuBufferHeap(CityGenerator::VERTEX_FLOATS * sizeof(GLfloat),
+			tilesInBudget(tileLayout, budgetBytes) * (GLuint)CityGenerator(tileLayout).vertexCount(),
+			tilesInBudget(tileLayout, budgetBytes) * (GLuint)CityGenerator(tileLayout).indexCount(),
+			EBO::IndexType(CityGenerator(tileLayout).vertexCount()))),
+	jobs(jobs)
+{
+	TileStreamer::tileLayout = tileLayout;
+	TileStreamer::tilesX = tilesX;
+	TileStreamer::tilesZ = tilesZ;
+	TileStreamer::directory = directory;
+	TileStreamer::loadRadius = loadRadius;
+	CityGenerator city(tileLayout);
+	tileSize = glm::vec2(2.0f * city.halfExtentX(), 2.0f * city.halfExtentZ());
+	// The coarse level of a tile takes a slot of its own, its mesh only a sliver of the heap
+	tileCapacity = LEVELS * tilesInBudget(tileLayout, budgetBytes, packed);
+	tileVertices = (GLuint)city.vertexCount();
+	tileIndices = (GLuint)city.indexCount();
+}
+
+// Waits for the load jobs and deletes the heap unless Delete was already called
+TileStreamer::~TileStreamer()
+{
+	Delete();
+}
+
+// Key of a level of a tile in the maps, tiles are counted from 0 so the level fits below z
+uint64_t TileStreamer::key(int x, int z, int level)
+{
+	return ((uint64_t)(uint32_t)x << 32) | ((uint64_t)(uint32_t)z << 1) | (uint64_t)level;
+}
+
+// Center of a tile on the ground, in double so tiles far from the origin keep their place to the millimeter
+glm::dvec3 TileStreamer::center(const glm::vec2& tileSize, int tilesX, int tilesZ, int x, int z)
+{
+	return glm::dvec3((x - 0.5 * (tilesX - 1)) * tileSize.x, 0.0, (z - 0.5 * (tilesZ - 1)) * tileSize.y);
+}
+
+glm::dvec3 TileStreamer::center(int x, int z) const
+{
+	return center(tileSize, tilesX, tilesZ, x, z);
+}
+
+// File a level of a tile is read from, the whole city keeps the name it always had
+std::string TileStreamer::path(const std::string& directory, int x, int z, int level)
+{
+	return directory + "/" + fileName(x, z, level);
+}
+
+std::string TileStreamer::fileName(int x, int z, int level)
+{
+	return "tile_" + std::to_string(x) + "_" + std::to_string(z) + (level > 0 ? "_lod" + std::to_string(level) : std::string()) + ".bin";
+}
+
+// Checks if a tile is close enough to the camera to be loaded
+bool TileStreamer::inRange(int x, int z) const
+{
+	return inRange(x, z, camera);
+}
+
+bool TileStreamer::inRange(int x, int z, const glm::dvec3& from) const
+{
+	glm::dvec3 offset = center(x, z) - from;
+	return offset.x * offset.x + offset.z * offset.z <= (double)loadRadius * loadRadius;
+}
+
+// Level of a tile the screen-space error asks for from the camera
+int TileStreamer::wantedLevel(int x, int z) const
+{
+	return wantedLevel(x, z, camera);
+}
+
+// A block box is off from its buildings by at most the spread of their heights, or the lot it fills in between them
+int TileStreamer::wantedLevel(int x, int z, const glm::dvec3& from) const
+{
+	if (maxScreenError <= 0.0f)
+		return 0;
+	float coarseError = std::max(tileLayout.maxHeight - tileLayout.minHeight, tileLayout.lotSize);
+	// Measured to the nearest point of the tile's ground, so a tile the camera is over counts as right in front of it
+	glm::dvec3 offset = center(x, z) - from;
+	double dx = std::max(std::abs(offset.x) - 0.5 * tileSize.x, 0.0);
+	double dz = std::max(std::abs(offset.z) - 0.5 * tileSize.y, 0.0);
+	double distance = std::max(std::sqrt(dx * dx + dz * dz + from.y * from.y), 1e-3);
+	return coarseError * pixelsPerUnit / distance > maxScreenError ? 0 : 1;
+}
+
+// The coarse level is needed anywhere in range, the whole city only where the coarse level is off by too much
+// Tiles needed now go by their distance, the ones only on the path by how soon it gets there
+bool TileStreamer::prioritize(Job& job) const
+{
+	if (inRange(job.x, job.z) && (job.level > 0 || wantedLevel(job.x, job.z) == 0))
+	{
+		glm::dvec3 offset = center(job.x, job.z) - camera;
+		job.prefetch = false;
+		job.priority = offset.x * offset.x + offset.z * offset.z;
+		return true;
+	}
+	auto ahead = predicted.find(key(job.x, job.z, job.level));
+	if (ahead == predicted.end())
+		return false;
+	job.prefetch = true;
+	job.priority = ahead->second;
+	return true;
+}
+
+// Smooths the camera's motion and walks the path it extrapolates to, turning at the rate the camera turns
+void TileStreamer::predict(const glm::vec3& front, float deltaTime)
+{
+	predicted.clear();
+	bool looking = glm::dot(front, front) > 0.0f;
+	float yaw = looking ? std::atan2(front.z, front.x) : 0.0f;
+	if (moved && looking && deltaTime > 0.0f)
+	{
+		// The motion of a single frame jitters with its time, so it only moves the estimate part of the way
+		const float smoothing = 0.25f;
+		velocity = glm::mix(velocity, (camera - lastCamera) / (double)deltaTime, (double)smoothing);
+		float turn = std::remainder(yaw - lastYaw, 2.0f * glm::pi<float>());
+		turnRate = glm::mix(turnRate, turn / deltaTime, smoothing);
+	}
+	moved = looking;
+	lastCamera = camera;
+	lastYaw = yaw;
+	if (prefetchSeconds <= 0.0f || !looking)
+		return;
+
+	// A path steps half a tile at a time and ends a few load radii out, so a jump of the camera does not queue half the
+	// world before its velocity settles again
+	double speed = glm::length(velocity);
+	double step = 0.5 * std::min(tileSize.x, tileSize.y);
+	double length = std::min(speed * prefetchSeconds, 4.0 * loadRadius);
+	if (length < step)
+		return;
+	int steps = std::min((int)std::ceil(length / step), 64);
+	double seconds = length / speed / steps;
+	glm::dvec3 position = camera;
+	for (int i = 1; i <= steps; i++)
+	{
+		double time = seconds * i;
+		float angle = turnRate * (float)time;
+		double c = std::cos(angle), s = std::sin(angle);
+		glm::dvec3 moving(velocity.x * c - velocity.z * s, velocity.y, velocity.x * s + velocity.z * c);
+		position += moving * seconds;
+		// Where the camera will look then, only the tiles in front of it are worth loading early
+		glm::dvec2 facing(front.x * c - front.z * s, front.x * s + front.z * c);
+		facing /= std::max(glm::length(facing), 1e-6);
+		double margin = 0.5 * glm::length(glm::dvec2(tileSize));
+
+		int firstX = std::max(0, (int)std::floor((position.x - loadRadius) / tileSize.x + 0.5 * (tilesX - 1)));
+		int lastX = std::min(tilesX - 1, (int)std::ceil((position.x + loadRadius) / tileSize.x + 0.5 * (tilesX - 1)));
+		int firstZ = std::max(0, (int)std::floor((position.z - loadRadius) / tileSize.y + 0.5 * (tilesZ - 1)));
+		int lastZ = std::min(tilesZ - 1, (int)std::ceil((position.z + loadRadius) / tileSize.y + 0.5 * (tilesZ - 1)));
+		for (int z = firstZ; z <= lastZ; z++)
+		{
+			for (int x = firstX; x <= lastX; x++)
+			{
+				glm::dvec3 offset = center(x, z) - position;
+				if (!inRange(x, z, position) || glm::dot(glm::dvec2(offset.x, offset.z), facing) < -margin)
+					continue;
+				// The levels it will want from there that are not needed now, the earliest time the path gets there is kept
+				int finest = wantedLevel(x, z, position), now = inRange(x, z) ? wantedLevel(x, z) : LEVELS;
+				for (int level = maxScreenError > 0.0f ? LEVELS - 1 : 0; level >= finest; level--)
+					if (level < now)
+						predicted.emplace(key(x, z, level), time);
+			}
+		}
+	}
+}
+
+// Reads a level from the folder or from the server, with a connection no other job is using
+bool TileStreamer::read(Job& job, int level)
+{
+	if (!HttpClient::IsUrl(directory))
+		return ReadTile(path(directory, job.x, job.z, level), center(job.x, job.z), job.vertices, job.indices);
+	// What an earlier launch fetched is mapped off the local disk instead
+	std::string url = directory + "/" + fileName(job.x, job.z, level);
+	MappedFile cached;
+	if (cache && cache->Read(url, cached) && decode((const char*)cached.data(), cached.size(), center(job.x, job.z), job.vertices, job.indices))
+		return true;
+	std::unique_ptr<HttpClient> client;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!clients.empty())
+		{
+			client = std::move(clients.back());
+			clients.pop_back();
+		}
+	}
+	if (!client)
+		client = std::make_unique<HttpClient>(directory);
+	std::vector<char> data;
+	bool fetched = FetchTile(*client, fileName(job.x, job.z, level), data) && decode(data.data(), data.size(), center(job.x, job.z), job.vertices, job.indices);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		clients.push_back(std::move(client));
+	}
+	if (fetched && cache)
+		cache->Write(url, std::move(data));
+	return fetched;
+}
+
+// Every field of the layout goes into the key, bump the version whenever the generator changes what it writes
+std::string TileStreamer::generatedKey(const Job& job) const
+{
+	const CityLayout& l = tileLayout;
+	return "generated/1/" + std::to_string(l.blocksX) + "/" + std::to_string(l.blocksZ) + "/" + std::to_string(l.lotsPerSide) + "/"
+		+ std::to_string(l.lotSize) + "/" + std::to_string(l.streetWidth) + "/" + std::to_string(l.minHeight) + "/" + std::to_string(l.maxHeight) + "/"
+		+ std::to_string(l.lotCoverage) + "/" + std::to_string(l.facadeCount) + "/" + std::to_string(l.seed) + "/" + fileName(job.x, job.z, job.loadedLevel);
+}
+
+// Job that loads the first queued tile
+void TileStreamer::load()
+{
+	Job job;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (stopping || queued.empty())
+			return;
+		job = std::move(queued.front());
+		queued.pop_front();
+	}
+	finish(job, nullptr);
+}
+
+// Decodes, reads or generates the mesh of a tile and hands it to the GL thread
+void TileStreamer::finish(Job& job, const std::vector<char>* file)
+{
+	TraceScope trace("load tile", "job", Tracer.recording() ? std::to_string(job.x) + " " + std::to_string(job.z) + " " + std::to_string(job.level) : std::string());
+
+	// Tiles that were never cooked come out of the generator, which gives the same mesh the file would hold
+	// Files of any size are read, only one that could never fit the heap or its index type is generated again
+	// Tiles cooked without a coarse level, such as imported footprints, are loaded whole at every distance
+	job.loadedLevel = job.level;
+	bool found = file ? decode(file->data(), file->size(), center(job.x, job.z), job.vertices, job.indices) : read(job, job.level);
+	if (!found && job.level > 0 && read(job, 0))
+	{
+		found = true;
+		job.loadedLevel = 0;
+	}
+	size_t vertexCount = job.vertices.size() / CityGenerator::VERTEX_FLOATS;
+	bool fits = vertexCount <= (size_t)tileCapacity * tileVertices && job.indices.size() <= (size_t)tileCapacity * tileIndices
+		&& job.indices.size() >= CityGenerator::GROUND_INDICES && (heap.indexType == GL_UNSIGNED_INT || vertexCount <= 65536);
+	// What an earlier launch generated is mapped off the local disk instead
+	if (!found || !fits)
+	{
+		job.loadedLevel = job.level;
+		MappedFile cached;
+		if (!cache || !cache->Read(generatedKey(job), cached) || !decode((const char*)cached.data(), cached.size(), center(job.x, job.z), job.vertices, job.indices))
+		{
+			generate(tileLayout, job);
+			if (cache)
+				cache->Write(generatedKey(job), encode(job.vertices, job.indices));
+		}
+	}
+	// Encoding is the rest of the work on the tile, done here so the GL thread only copies the words
+	if (packed)
+		job.encoded = GpuMeshCodec::Encode(job.vertices.data(), job.vertices.size() / CityGenerator::VERTEX_FLOATS, job.indices.data(), job.indices.size(), CityGenerator::GROUND_INDICES);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	loaded.push_back(std::move(job));
+}
+
+// Writes the ground and buildings of a tile around its center, where the generator puts every city
+void TileStreamer::generate(const CityLayout& tileLayout, Job& job)
+{
+	// Neighbouring tiles get unrelated seeds, the same tile always gets the same one
+	CityLayout layout = tileLayout;
+	layout.seed = tileLayout.seed ^ ((uint32_t)job.x * 0x9e3779b9U + (uint32_t)job.z * 0x85ebca6bU);
+	CityGenerator city(layout);
+	if (job.loadedLevel > 0)
+	{
+		job.vertices.resize((CityGenerator::GROUND_VERTICES + city.blockCount() * CityGenerator::BUILDING_VERTICES) * CityGenerator::VERTEX_FLOATS);
+		job.indices.resize(CityGenerator::GROUND_INDICES + city.blockCount() * CityGenerator::BUILDING_INDICES);
+		city.GenerateImpostors(job.vertices.data(), job.indices.data());
+		return;
+	}
+	job.vertices.resize(city.vertexCount() * CityGenerator::VERTEX_FLOATS);
+	job.indices.resize(city.indexCount());
+	city.Generate(job.vertices.data(), job.indices.data());
+}
+
+// Queues the missing tiles around the camera nearest first, then those on its path, and drops queued ones that are no
+// longer needed
+void TileStreamer::Update(const glm::dvec3& camera, float pixelsPerUnit, const glm::vec3& front, float deltaTime)
+{
+	TileStreamer::camera = camera;
+	TileStreamer::pixelsPerUnit = pixelsPerUnit;
+	predict(front, deltaTime);
+
+	// Only the tiles inside the square around the load circle can be in range
+	int firstX = std::max(0, (int)std::floor((camera.x - loadRadius) / tileSize.x + 0.5 * (tilesX - 1)));
+	int lastX = std::min(tilesX - 1, (int)std::ceil((camera.x + loadRadius) / tileSize.x + 0.5 * (tilesX - 1)));
+	int firstZ = std::max(0, (int)std::floor((camera.z - loadRadius) / tileSize.y + 0.5 * (tilesZ - 1)));
+	int lastZ = std::min(tilesZ - 1, (int)std::ceil((camera.z + loadRadius) / tileSize.y + 0.5 * (tilesZ - 1)));
+	std::vector<Job> wanted;
+	for (int z = firstZ; z <= lastZ; z++)
+	{
+		for (int x = firstX; x <= lastX; x++)
+		{
+			if (!inRange(x, z))
+				continue;
+			// The coarse level only when there is a screen-space error to allow, the whole city only where it is exceeded,
+			// unless the coarse level already turned out to be the whole city
+			int finest = wantedLevel(x, z);
+			for (int level = maxScreenError > 0.0f ? LEVELS - 1 : 0; level >= finest; level--)
+			{
+				auto coarse = resident.find(key(x, z, LEVELS - 1));
+				if (level == 0 && coarse != resident.end() && coarse->second.whole)
+					continue;
+				uint64_t k = key(x, z, level);
+				if (resident.count(k) == 0 && requested.count(k) == 0)
+				{
+					Job job;
+					job.x = x;
+					job.z = z;
+					job.level = level;
+					wanted.push_back(std::move(job));
+				}
+			}
+		}
+	}
+	// Tiles on the path are queued as the level they will be seen at from there
+	for (const auto& ahead : predicted)
+	{
+		// Keys hold the tile's position and level bit for bit, the grid never has negative positions
+		Job job;
+		job.x = (int)(ahead.first >> 32);
+		job.z = (int)((uint32_t)ahead.first >> 1);
+		job.level = (int)(ahead.first & 1);
+		auto coarse = resident.find(key(job.x, job.z, LEVELS - 1));
+		if (job.level == 0 && coarse != resident.end() && coarse->second.whole)
+			continue;
+		if (resident.count(ahead.first) == 0 && requested.count(ahead.first) == 0)
+			wanted.push_back(std::move(job));
+	}
+
+	if (io && !HttpClient::IsUrl(directory))
+	{
+		readThroughIo(wanted);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// Tiles the camera flew away from before a job got to them are not loaded at all, their jobs find nothing to do
+		for (auto it = queued.begin(); it != queued.end();)
+		{
+			if (prioritize(*it))
+			{
+				++it;
+				continue;
+			}
+			requested.erase(key(it->x, it->z, it->level));
+			it = queued.erase(it);
+		}
+		for (Job& job : wanted)
+		{
+			prioritize(job);
+			requested.insert(key(job.x, job.z, job.level));
+			queued.push_back(std::move(job));
+		}
+		// The whole queue is sorted again as the camera moves. Every tile needed now goes before any on the path, and
+		// every coarse tile before any whole one, so the whole range is covered before the near tiles are refined
+		std::sort(queued.begin(), queued.end(), [](const Job& a, const Job& b) {
+			if (a.prefetch != b.prefetch)
+				return !a.prefetch;
+			return a.level != b.level ? a.level > b.level : a.priority < b.priority;
+		});
+	}
+	// Every job takes whichever tile is first in the queue when it starts
+	for (size_t i = 0; i < wanted.size(); i++)
+		jobs.Submit([this] { load(); }, &loading);
+}
+
+// Coarse levels needed now go first, so the whole range is covered before it is refined, and tiles on the path last
+IoScheduler::Priority TileStreamer::ioPriority(const Job& job)
+{
+	if (job.prefetch)
+		return IoScheduler::PREFETCH;
+	return job.level > 0 ? IoScheduler::URGENT : IoScheduler::NORMAL;
+}
+
+// The scheduler sorts the reads, every frame they get the class and order the camera gives them now
+void TileStreamer::readThroughIo(std::vector<Job>& wanted)
+{
+	// A read nobody needs any more is canceled, one already handed to a job is dropped by Upload instead
+	for (auto it = reading.begin(); it != reading.end();)
+	{
+		if (prioritize(it->second))
+		{
+			io->Reprioritize(it->second.ticket, ioPriority(it->second), it->second.priority);
+			++it;
+		}
+		else if (io->Cancel(it->second.ticket))
+		{
+			requested.erase(it->first);
+			it = reading.erase(it);
+		}
+		else
+			++it;
+	}
+	for (Job& job : wanted)
+	{
+		prioritize(job);
+		// The job decodes what was read, or falls back to reading another level or generating the tile like load does
+		Job tile = job;
+		job.ticket = io->Read(path(directory, job.x, job.z, job.level), 0, 0, ioPriority(job), job.priority,
+			[this, tile](bool ok, std::vector<char> bytes) {
+				jobs.Submit([this, tile, ok, bytes = std::move(bytes)]() mutable {
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						if (stopping)
+							return;
+					}
+					finish(tile, ok ? &bytes : nullptr);
+				}, &loading);
+			});
+		if (job.ticket == 0)
+			continue;
+		uint64_t k = key(job.x, job.z, job.level);
+		requested.insert(k);
+		reading[k] = std::move(job);
+	}
+}
+
+// Frees the tile that was drawn longest ago, except tiles drawn this frame
+bool TileStreamer::evict()
+{
+	auto oldest = resident.end();
+	for (auto it = resident.begin(); it != resident.end(); ++it)
+		if (it->second.lastUsed < frame && (oldest == resident.end() || it->second.lastUsed < oldest->second.lastUsed))
+			oldest = it;
+	if (oldest == resident.end())
+		return false;
+	heap.Free(oldest->second.mesh);
+	resident.erase(oldest);
+	return true;
+}
+
+// Uploads loaded tiles until budgetMs milliseconds have passed, at least one if any is ready
+size_t TileStreamer::Upload(double budgetMs)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t count = 0;
+	for (;;)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (loaded.empty())
+				break;
+			job = std::move(loaded.front());
+			loaded.pop_front();
+		}
+		uint64_t k = key(job.x, job.z, job.level);
+		reading.erase(k);
+
+		// Loaded after the camera left or came too close for it, uploading it would only push out a tile that is still needed
+		if (!prioritize(job))
+		{
+			requested.erase(k);
+			continue;
+		}
+
+		GLuint vertexCount = (GLuint)(job.vertices.size() / CityGenerator::VERTEX_FLOATS);
+		GLuint indexCount = (GLuint)job.indices.size();
+		// Cooked tiles smaller than generated ones would fit more of them than Collect has commands for
+		// A tile that is only on the camera's path takes free room and never pushes out another, it is dropped instead
+		// and loaded again once it is needed, off the cache when there is one
+		// A packed tile is its chunks without any index
+		bool room = true;
+		while (resident.size() >= tileCapacity && room)
+			room = !job.prefetch && evict();
+		auto allocate = [&]() {
+			return packed ? heap.Allocate(job.encoded.words.data(), job.encoded.chunks(), nullptr, 0)
+				: heap.Allocate(job.vertices.data(), vertexCount, job.indices.data(), indexCount);
+		};
+		uint32_t mesh = room ? allocate() : GpuBufferHeap::INVALID;
+		while (mesh == GpuBufferHeap::INVALID && !job.prefetch && evict())
+			mesh = allocate();
+		if (mesh == GpuBufferHeap::INVALID && job.prefetch)
+		{
+			requested.erase(k);
+			continue;
+		}
+		if (mesh == GpuBufferHeap::INVALID)
+		{
+			// Every resident tile is on screen, the tile waits until one of them is not
+			std::lock_guard<std::mutex> lock(mutex);
+			loaded.push_front(std::move(job));
+			break;
+		}
+
+		// The bounds come from the mesh so cooked files can hold any buildings
+		Tile tile;
+		tile.x = job.x;
+		tile.z = job.z;
+		tile.level = job.level;
+		tile.whole = job.loadedLevel == 0;
+		tile.mesh = mesh;
+		tile.meshlets = job.encoded.meshlets;
+		tile.groundMeshlets = job.encoded.splitMeshlets;
+		tile.center = center(job.x, job.z);
+		tile.min = glm::vec3(job.vertices[0], job.vertices[1], job.vertices[2]);
+		tile.max = tile.min;
+		for (size_t i = 0; i < job.vertices.size(); i += CityGenerator::VERTEX_FLOATS)
+		{
+			glm::vec3 position(job.vertices[i], job.vertices[i + 1], job.vertices[i + 2]);
+			tile.min = glm::min(tile.min, position);
+			tile.max = glm::max(tile.max, position);
+		}
+		// Counts as used so the next upload of this frame does not evict it again
+		tile.lastUsed = frame;
+		resident[k] = tile;
+		requested.erase(k);
+		count++;
+
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if (elapsed.count() >= budgetMs)
+			break;
+	}
+	return count;
+}
+
+// Writes a record that moves a tile by offset in the color of its ground or buildings
+GLfloat* TileStreamer::writeRecord(GLfloat* out, const glm::vec3& offset, const GLfloat* color)
+{
+	const GLfloat record[CityGenerator::INSTANCE_FLOATS] = {
+		offset.x, offset.y, offset.z, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, color[0], color[1], color[2], 0.0f };
+	std::copy(record, record + CityGenerator::INSTANCE_FLOATS, out);
+	return out + CityGenerator::INSTANCE_FLOATS;
+}
+
+// Adds the ground and building commands of every resident tile at least partly inside the frustum
+size_t TileStreamer::Collect(const Frustum& frustum, const glm::dvec3& camera, DrawCommandBuilder& commands, GLfloat* records)
+{
+	frame++;
+	size_t count = 0;
+	for (auto& entry : resident)
+	{
+		// A level is left out while the other level of its tile is resident and wanted instead
+		int wanted = wantedLevel(entry.second.x, entry.second.z);
+		if (entry.second.level != wanted && resident.count(key(entry.second.x, entry.second.z, wanted)) != 0)
+			continue;
+		// The offset is taken in double and only the small difference goes to float, so far tiles do not jitter
+		glm::vec3 offset = glm::vec3(entry.second.center - camera);
+		if (!frustum.TestBox(entry.second.min + offset, entry.second.max + offset))
+			continue;
+		entry.second.lastUsed = frame;
+		// Every tile starts with its ground quad, which gets the ground's instance record instead of the buildings'
+		const DrawCommandBuilder::Mesh& mesh = heap.mesh(entry.second.mesh);
+		DrawCommandBuilder::Mesh ground = { mesh.firstIndex, CityGenerator::GROUND_INDICES, mesh.baseVertex, CityGenerator::GROUND_VERTICES };
+		DrawCommandBuilder::Mesh buildings = { mesh.firstIndex + CityGenerator::GROUND_INDICES, mesh.indexCount - CityGenerator::GROUND_INDICES, mesh.baseVertex, mesh.vertexCount };
+		// A packed tile draws the corners of its ground meshlets and of the rest, the chunk of its grid is never drawn
+		if (packed)
+		{
+			const Tile& tile = entry.second;
+			ground = { GpuMeshCodec::Encoded::firstSlot(mesh.baseVertex, 0), tile.groundMeshlets * GpuMeshCodec::MESHLET_SLOTS, 0, 0 };
+			buildings = { GpuMeshCodec::Encoded::firstSlot(mesh.baseVertex, tile.groundMeshlets),
+				(tile.meshlets - tile.groundMeshlets) * GpuMeshCodec::MESHLET_SLOTS, 0, 0 };
+		}
+		records = writeRecord(records, offset, CityGenerator::GROUND_COLOR);
+		records = writeRecord(records, offset, CityGenerator::BUILDING_COLOR);
+		commands.Add(ground, 1, (GLuint)(TILE_RECORDS * count));
+		commands.Add(buildings, 1, (GLuint)(TILE_RECORDS * count + 1));
+		count++;
+	}
+	return count;
+}
+
+// Most tiles the heap can hold at once
+size_t TileStreamer::maxResident() const
+{
+	return tileCapacity;
+}
+
+// Number of tiles in the heap
+size_t TileStreamer::residentCount() const
+{
+	return resident.size();
+}
+
+// Number of tiles queued, being loaded or waiting for upload
+size_t TileStreamer::pending() const
+{
+	return requested.size();
+}
+
+// Number of tile levels on the extrapolated path this frame
+size_t TileStreamer::prefetched() const
+{
+	return predicted.size();
+}
+
+// Writes the mesh of every tile of a grid into directory
+int TileStreamer::Cook(const CityLayout& tileLayout, int tilesX, int tilesZ, const std::string& directory)
+{
+	std::error_code error;
+	fs::create_directories(directory, error);
+	int failed = 0;
+	for (int z = 0; z < tilesZ; z++)
+	{
+		for (int x = 0; x < tilesX; x++)
+		{
+			for (int level = 0; level < LEVELS; level++)
+			{
+				Job job;
+				job.x = x;
+				job.z = z;
+				job.level = job.loadedLevel = level;
+				generate(tileLayout, job);
+				if (!WriteTile(path(directory, x, z, level), job.vertices, job.indices))
+				{
+					LOG_MESSAGE(LOG_ERROR, "Failed to write tile %s", path(directory, x, z, level).c_str());
+					failed++;
+				}
+			}
+		}
+	}
+	return failed;
+}
+
+// Writes one tile file
+bool TileStreamer::WriteTile(const std::string& path, const std::vector<GLfloat>& vertices, const std::vector<GLuint>& indices)
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	std::vector<char> data = encode(vertices, indices);
+	file.write(data.data(), (std::streamsize)data.size());
+	return (bool)file;
+}
+
+// The header followed by the compressed vertices and indices, as WriteTile writes them
+std::vector<char> TileStreamer::encode(const std::vector<GLfloat>& vertices, const std::vector<GLuint>& indices)
+{
+	std::vector<char> packed = MeshCodec::Encode(vertices.data(), vertices.size() / CityGenerator::VERTEX_FLOATS, indices.data(), indices.size());
+	uint32_t header[4] = { PACKED_TILE_MAGIC, CityGenerator::VERTEX_FLOATS, (uint32_t)(vertices.size() / CityGenerator::VERTEX_FLOATS), (uint32_t)packed.size() };
+	std::vector<char> data(sizeof(header) + packed.size());
+	std::memcpy(data.data(), header, sizeof(header));
+	std::memcpy(data.data() + sizeof(header), packed.data(), packed.size());
+	return data;
+}
+
+// Checks the header of a tile file and returns the bytes of data following it, 0 if the header does not fit the vertex layout
+static size_t tileBytes(const uint32_t (&header)[4])
+{
+	if ((header[0] != TILE_MAGIC && header[0] != WORLD_TILE_MAGIC && header[0] != PACKED_TILE_MAGIC) || header[1] != CityGenerator::VERTEX_FLOATS || header[2] == 0)
+		return 0;
+	if (header[0] == PACKED_TILE_MAGIC)
+		return header[3];
+	return (size_t)header[2] * CityGenerator::VERTEX_FLOATS * sizeof(GLfloat) + (size_t)header[3] * sizeof(GLuint);
+}
+
+// Reads a tile file written by WriteTile
+bool TileStreamer::ReadTile(const std::string& path, const glm::dvec3& center, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	uint32_t header[4] = {};
+	file.read((char*)header, sizeof(header));
+	if (!file || tileBytes(header) == 0)
+		return false;
+	std::vector<char> data(sizeof(header) + tileBytes(header));
+	std::memcpy(data.data(), header, sizeof(header));
+	file.read(data.data() + sizeof(header), (std::streamsize)(data.size() - sizeof(header)));
+	return file && decode(data.data(), data.size(), center, vertices, indices);
+}
+
+// Fetches the header first, a tile in another vertex layout is turned down before its data is downloaded
+bool TileStreamer::FetchTile(HttpClient& client, const std::string& name, std::vector<char>& data)
+{
+	uint32_t header[4] = {};
+	if (!client.Get(name, data, 0, sizeof(header)) || data.size() < sizeof(header))
+		return false;
+	std::memcpy(header, data.data(), sizeof(header));
+	if (tileBytes(header) == 0)
+		return false;
+	// A server without ranges sent the whole file already
+	if (client.status() != 200)
+	{
+		std::vector<char> rest;
+		if (!client.Get(name, rest, sizeof(header), tileBytes(header)))
+			return false;
+		if (client.status() == 200)
+			data = std::move(rest);
+		else
+			data.insert(data.end(), rest.begin(), rest.end());
+	}
+	return data.size() >= sizeof(header) + tileBytes(header);
+}
+
+// Reads a tile from the bytes of its file, which may be a mapping or a download
+bool TileStreamer::decode(const char* data, size_t size, const glm::dvec3& center, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices)
+{
+	uint32_t header[4] = {};
+	if (size < sizeof(header))
+		return false;
+	std::memcpy(header, data, sizeof(header));
+	if (tileBytes(header) == 0 || size < sizeof(header) + tileBytes(header))
+		return false;
+	if (header[0] == PACKED_TILE_MAGIC)
+		return MeshCodec::Decode(data + sizeof(header), header[3], vertices, indices) && vertices.size() == (size_t)header[2] * CityGenerator::VERTEX_FLOATS;
+	bool world = header[0] == WORLD_TILE_MAGIC;
+	vertices.resize((size_t)header[2] * CityGenerator::VERTEX_FLOATS);
+	indices.resize(header[3]);
+	const char* source = data + sizeof(header);
+	std::memcpy(vertices.data(), source, vertices.size() * sizeof(GLfloat));
+	std::memcpy(indices.data(), source + vertices.size() * sizeof(GLfloat), indices.size() * sizeof(GLuint));
+	if (world)
+	{
+		for (size_t i = 0; i < vertices.size(); i += CityGenerator::VERTEX_FLOATS)
+		{
+			vertices[i] = (GLfloat)(vertices[i] - center.x);
+			vertices[i + 2] = (GLfloat)(vertices[i + 2] - center.z);
+		}
+	}
+	return true;
+}
+
+// Waits for the load jobs and deletes the heap
+void TileStreamer::Delete()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	// Reads that can no longer be canceled are waited for, the jobs they hand their bytes to return at once
+	if (io && !reading.empty())
+	{
+		for (const auto& tile : reading)
+			io->Cancel(tile.second.ticket);
+		io->Flush();
+	}
+	// Jobs that did not start yet return at once
+	jobs.Wait(loading);
+
+	queued.clear();
+	loaded.clear();
+	reading.clear();
+	clients.clear();
+	requested.clear();
+	predicted.clear();
+	resident.clear();
+	heap.Delete();
+}
@@ -0,0 +1,236 @@
+#ifndef TILE_STREAMER_CLASS_H
+#define TILE_STREAMER_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstdint>
+#include<deque>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<unordered_map>
+#include<unordered_set>
+#include<vector>
+
+#include"CityGenerator.h"
+#include"DrawCommandBuilder.h"
+#include"ContentCache.h"
+#include"Frustum.h"
+#include"GpuBufferHeap.h"
+#include"GpuMeshCodec.h"
+#include"HttpClient.h"
+#include"IoScheduler.h"
+#include"JobSystem.h"
+
+// Splits a world far larger than GPU memory into a grid of tiles, each one a city of its own
+// Tiles near the camera are read from disk by jobs of the engine's job system, or generated when no file was cooked for them,
+// and uploaded on the GL thread a few per frame into a heap of fixed size. When the heap is full the tiles
+// that were drawn longest ago make room, so the heap size is the VRAM budget of the whole world
+// Files may hold any mesh that starts with the ground quad, such as footprints of a map, as long as it fits the heap
+// A directory that is an http:// url is a server the files are fetched from instead, over one kept alive connection
+// per worker, the header of a file first and the rest with a range request once the header checks out
+// With a screen-space error allowed, every tile comes in two levels like the nodes of a hierarchical level of detail:
+// a coarse one of its ground and one box per block, loaded first for every tile in range, and its whole city, loaded
+// only where the coarse one would be off by more pixels than allowed. What is resident then follows what the screen
+// can show instead of the load radius alone
+// Tiles ahead of a fast camera are prefetched too: the path it will take is extrapolated from its recent velocity and
+// turning, and the tiles in range of that path and in front of where it will look are queued behind every tile needed
+// now. The queue is sorted again every frame, so a prefetched tile moves up once it is needed and waits while it is not
+// Given an IoScheduler, the files of a folder are read through it instead, with the same order as its priorities, and
+// the jobs only decode what it read
+// A packed streamer keeps its tiles in the heap as GpuMeshCodec meshlets, which the load jobs encode and the vertex
+// shader decodes, so the same budget holds about twice as many tiles. Its commands draw without indices
+class TileStreamer
+{
+public:
+	// Layout of every tile, each one gets its own seed from its position
+	CityLayout tileLayout;
+	// Number of tiles along X and Z, the grid is centered on the origin
+	int tilesX;
+	int tilesZ;
+	// Size of a tile along X and Z, the ground quads of neighbouring tiles meet at their edges
+	glm::vec2 tileSize;
+	// Tiles whose center is closer to the camera than this are loaded
+	float loadRadius;
+	// Where cooked tile files are read from, a folder or an http:// url
+	std::string directory;
+	// Pixels the coarse level of a tile may be off by before its whole city is loaded and drawn instead, 0 only ever
+	// loads the whole cities
+	float maxScreenError = 0.0f;
+	// Seconds of the camera's extrapolated path whose tiles are prefetched, 0 prefetches none
+	float prefetchSeconds = 0.0f;
+	// Level 0 of a tile is its whole city, level 1 its ground with the box impostor of every block
+	static constexpr int LEVELS = 2;
+	// Where fetched and generated tiles are kept across launches, so they come off the local disk next time, null for
+	// none, it has to outlive the streamer. Tiles read from a folder are on the local disk already and are not kept
+	ContentCache* cache = nullptr;
+	// Where the files of a folder are read through, the coarse levels needed now as URGENT, the whole cities as NORMAL
+	// and the tiles on the camera's path as PREFETCH, null reads them on the load jobs. It has to outlive the streamer
+	IoScheduler* io = nullptr;
+	// Whether the heap holds GpuMeshCodec streams, one chunk a vertex and no indices, set by the constructor
+	bool packed;
+	// Vertices and indices of the resident tiles
+	GpuBufferHeap heap;
+
+	// Constructor that sizes the heap to budgetBytes and loads tiles on the workers of jobs, which has to outlive it
+	// With packed the tiles are kept as meshlets, to be drawn by vertex shaders built with SHADER_PACKED_MESHLETS
+	TileStreamer(const CityLayout& tileLayout, int tilesX, int tilesZ, const std::string& directory, GLsizeiptr budgetBytes, float loadRadius, JobSystem& jobs, bool packed = false);
+	// Waits for the load jobs and deletes the heap unless Delete was already called, the context has to still be current
+	~TileStreamer();
+
+	// Queues the missing tiles around the camera nearest first and drops queued ones that fell out of range or no longer
+	// need their level, pixelsPerUnit is how many pixels a unit covers one unit away, projection[1][1] * viewportHeight / 2
+	// front is where the camera looks and deltaTime the seconds since the last Update, which give the path the tiles are
+	// prefetched along, without them none are
+	void Update(const glm::dvec3& camera, float pixelsPerUnit, const glm::vec3& front = glm::vec3(0.0f), float deltaTime = 0.0f);
+	// Uploads loaded tiles until budgetMs milliseconds have passed, at least one if any is ready, returns how many
+	// Call once per frame on the GL thread
+	size_t Upload(double budgetMs);
+	// Instance records Collect writes per tile, the ground's and the buildings', which differ only in color
+	static constexpr size_t TILE_RECORDS = 2;
+
+	// Adds two commands for every resident tile at least partly inside the frustum and marks them as used this frame
+	// The commands of a packed streamer are for a builder with arrays set, whose vertex IDs are the meshlets' corners
+	// Of a tile with both levels resident only the one its screen-space error asks for is drawn
+	// The frustum and the records are relative to camera: tile i of the frame draws its ground quad with record
+	// TILE_RECORDS * i and its buildings with the one after, written into records, which has room for TILE_RECORDS *
+	// maxResident records of CityGenerator::INSTANCE_FLOATS floats
+	size_t Collect(const Frustum& frustum, const glm::dvec3& camera, DrawCommandBuilder& commands, GLfloat* records);
+
+	// Most tiles the heap can hold at once, each level counting as a tile, Collect adds at most twice as many commands
+	size_t maxResident() const;
+	// Number of tiles in the heap
+	size_t residentCount() const;
+	// Number of tiles queued, being loaded or waiting for upload
+	size_t pending() const;
+	// Number of tile levels on the extrapolated path this frame that are not needed yet, resident or not
+	size_t prefetched() const;
+
+	// Writes both levels of every tile of a grid into directory, returns how many files could not be written
+	// Needs no GL context, the streamer reads the files back when it is created with the same layout and grid
+	static int Cook(const CityLayout& tileLayout, int tilesX, int tilesZ, const std::string& directory);
+	// Writes one tile file, a header followed by the vertices and indices compressed by MeshCodec, around the tile's center
+	static bool WriteTile(const std::string& path, const std::vector<GLfloat>& vertices, const std::vector<GLuint>& indices);
+	// Reads a tile file written by WriteTile, false if it is missing or does not match the vertex layout
+	// Uncompressed files of the earlier formats are read too, those holding world positions are moved around center
+	static bool ReadTile(const std::string& path, const glm::dvec3& center, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices);
+	// Fetches the bytes of a tile file from the server of client into data, name is its path below the client's base
+	// path, false if it is missing or its header does not match the vertex layout
+	static bool FetchTile(HttpClient& client, const std::string& name, std::vector<char>& data);
+	// File a level of a tile is read from, and its name within the directory
+	static std::string path(const std::string& directory, int x, int z, int level = 0);
+	static std::string fileName(int x, int z, int level = 0);
+	// Center of a tile on the ground, which its mesh is stored around
+	static glm::dvec3 center(const glm::vec2& tileSize, int tilesX, int tilesZ, int x, int z);
+
+	// Waits for the load jobs that started and deletes the heap, tiles not uploaded yet are thrown away
+	void Delete();
+private:
+	// A level of a tile in the heap, its bounds around its center
+	struct Tile
+	{
+		int x;
+		int z;
+		int level;
+		// Whether the mesh is the whole city, which a coarse level falls back to when only that was cooked
+		bool whole;
+		uint32_t mesh;
+		// Meshlets of a packed tile and how many of them are its ground
+		uint32_t meshlets;
+		uint32_t groundMeshlets;
+		glm::dvec3 center;
+		glm::vec3 min;
+		glm::vec3 max;
+		// Frame the tile was last drawn or uploaded in
+		uint64_t lastUsed;
+	};
+	// One tile going through the streamer
+	struct Job
+	{
+		int x = 0;
+		int z = 0;
+		// Level asked for and level the mesh turned out to be
+		int level = 0;
+		int loadedLevel = 0;
+		// Whether the tile is only on the camera's path, and its place in the queue, lower first: its squared distance
+		// to the camera, or the seconds until the path reaches it
+		bool prefetch = false;
+		double priority = 0.0;
+		// Read of its file through the IoScheduler
+		uint64_t ticket = 0;
+		std::vector<GLfloat> vertices;
+		std::vector<GLuint> indices;
+		// The mesh encoded for a packed streamer
+		GpuMeshCodec::Encoded encoded;
+	};
+
+	// Tiles the heap holds and the size of each
+	GLuint tileCapacity = 0;
+	GLuint tileVertices = 0;
+	GLuint tileIndices = 0;
+	std::unordered_map<uint64_t, Tile> resident;
+	// Tiles that are queued, being loaded or waiting for upload, only touched by the GL thread
+	std::unordered_set<uint64_t> requested;
+	uint64_t frame = 0;
+	glm::dvec3 camera = glm::dvec3(0.0);
+	float pixelsPerUnit = 0.0f;
+	// Camera of the last Update and how fast it moves and turns, smoothed over a few frames
+	bool moved = false;
+	glm::dvec3 lastCamera = glm::dvec3(0.0);
+	float lastYaw = 0.0f;
+	glm::dvec3 velocity = glm::dvec3(0.0);
+	float turnRate = 0.0f;
+	// Levels of the tiles on the extrapolated path this frame with the seconds until the path reaches them
+	std::unordered_map<uint64_t, double> predicted;
+
+	JobSystem& jobs;
+	// Counts the load jobs submitted, one for every tile queued
+	JobSystem::Counter loading;
+	std::mutex mutex;
+	std::deque<Job> queued;
+	std::deque<Job> loaded;
+	// Tiles whose file is being read through io, by key, only touched by the GL thread
+	std::unordered_map<uint64_t, Job> reading;
+	// Connections to the server not in use by a job right now
+	std::vector<std::unique_ptr<HttpClient>> clients;
+	bool stopping = false;
+
+	// Job that loads the first queued tile, there is one for every tile so it may find the queue empty
+	void load();
+	// Makes the mesh of a tile out of the bytes of its file read through io, or reads or generates it when there are
+	// none, and hands it to the GL thread
+	void finish(Job& job, const std::vector<char>* file);
+	// Queues the file of a tile with io, and keeps the class and order of the queued ones up to date
+	void readThroughIo(std::vector<Job>& wanted);
+	// Class a tile's file is read in
+	static IoScheduler::Priority ioPriority(const Job& job);
+	// Reads a level of a tile from the directory into job, false if it is not there
+	bool read(Job& job, int level);
+	// Writes the ground and buildings of a tile around its center, or the block boxes for the coarse level
+	static void generate(const CityLayout& tileLayout, Job& job);
+	// Reads a tile from the bytes of its file, and writes those bytes for a tile
+	static bool decode(const char* data, size_t size, const glm::dvec3& center, std::vector<GLfloat>& vertices, std::vector<GLuint>& indices);
+	static std::vector<char> encode(const std::vector<GLfloat>& vertices, const std::vector<GLuint>& indices);
+	// Key a generated level of a tile is cached under, which changes with anything in the layout
+	std::string generatedKey(const Job& job) const;
+	glm::dvec3 center(int x, int z) const;
+	// Writes a record that moves a tile by offset in the color of its ground or buildings, returns the position after it
+	static GLfloat* writeRecord(GLfloat* out, const glm::vec3& offset, const GLfloat* color);
+	// Checks if a tile is close enough to the camera, or to another point of view, to be loaded
+	bool inRange(int x, int z) const;
+	bool inRange(int x, int z, const glm::dvec3& from) const;
+	// Level of a tile the screen-space error asks for seen from the camera or another point, 0 whenever the coarse level
+	// would be off by too many pixels
+	int wantedLevel(int x, int z) const;
+	int wantedLevel(int x, int z, const glm::dvec3& from) const;
+	// Checks if a queued or loaded level of a tile is still needed, now or on the camera's path, and sets its priority
+	bool prioritize(Job& job) const;
+	// Smooths the camera's motion and fills predicted with the tiles along the path it extrapolates to
+	void predict(const glm::vec3& front, float deltaTime);
+	// Frees the tile that was drawn longest ago, except tiles drawn this frame, false if there is none
+	bool evict();
+	// Key of a level of a tile in the maps
+	static uint64_t key(int x, int z, int level);
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include"TimeOfDay.h"
+
+#include<algorithm>
+#include<cmath>
+
+static const float PI = 3.14159265f;
+// Optical depth of the air straight up for red, green and blue, blue is scattered away first
+static const glm::vec3 EXTINCTION = glm::vec3(0.09f, 0.14f, 0.3f);
+// Share of the daylight that comes from the sky rather than the sun at noon, and the moonlight left at night
+static const glm::vec3 SKY_LIGHT = glm::vec3(0.3f, 0.33f, 0.4f);
+static const glm::vec3 NIGHT_LIGHT = glm::vec3(0.05f, 0.06f, 0.1f);
+
+// Hour of the day at a time of the clock
+float TimeOfDay::Hour(double time) const
+{
+	double hour = std::fmod((double)startHour + time * hoursPerSecond, 24.0);
+	return (float)(hour < 0.0 ? hour + 24.0 : hour);
+}
+
+// Sunlight falls away from the sun
+glm::vec3 TimeOfDay::Direction(double time) const
+{
+	return -toSun(time);
+}
+
+// Daylight of the sun's elevation at a time of the clock
+glm::vec3 TimeOfDay::Color(double time) const
+{
+	return Daylight(toSun(time).y);
+}
+
+// Sunlight dimmed by the air mass it comes through, Kasten and Young's, fading out over the twilight while the sky's
+// light fades more slowly
+glm::vec3 TimeOfDay::Daylight(float sinElevation)
+{
+	float elevation = std::asin(glm::clamp(sinElevation, -1.0f, 1.0f)) * 180.0f / PI;
+	float airMass = 1.0f / (std::max(sinElevation, 0.0f) + 0.50572f * std::pow(std::max(elevation, 0.0f) + 6.07995f, -1.6364f));
+	glm::vec3 sun = glm::exp(-EXTINCTION * (airMass - 1.0f)) * glm::smoothstep(-0.02f, 0.02f, sinElevation);
+	glm::vec3 sky = SKY_LIGHT * glm::smoothstep(-0.12f, 0.1f, sinElevation);
+	return glm::max((sun + sky) / (glm::vec3(1.0f) + SKY_LIGHT), NIGHT_LIGHT);
+}
+
+// The sun's hour angle turns 15 degrees an hour from the south at noon, its declination follows the seasons
+glm::vec3 TimeOfDay::toSun(double time) const
+{
+	float hourAngle = (Hour(time) - 12.0f) * PI / 12.0f;
+	float declination = glm::radians(23.44f) * std::sin(2.0f * PI * (284.0f + (float)day) / 365.0f);
+	float phi = glm::radians(latitude);
+	float up = std::sin(phi) * std::sin(declination) + std::cos(phi) * std::cos(declination) * std::cos(hourAngle);
+	float east = -std::cos(declination) * std::sin(hourAngle);
+	float north = std::cos(phi) * std::sin(declination) - std::sin(phi) * std::cos(declination) * std::cos(hourAngle);
+	return glm::normalize(glm::vec3(east, up, -north));
+}
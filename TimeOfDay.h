@@ -0,0 +1,36 @@
+#ifndef TIME_OF_DAY_CLASS_H
+#define TIME_OF_DAY_CLASS_H
+
+#include<glm/glm.hpp>
+
+// Moves the sun over the city's sky as the hours of a day go by, from the sun's declination on a day of the year and
+// the latitude of the city. The city's x is east and its -z north, so the sun is given in the city's model space, where
+// the cascades and the probes are rendered. Everything is a function of the clock's time, so a recording, a benchmark
+// or a poster's tiles get the same sun again. The light it gives is the transmittance of the air along the sun's path
+// through it, scaled to 1 with the sun straight overhead, so the city keeps its look at noon and fades to a dim
+// moonlight at night.
+class TimeOfDay
+{
+public:
+	// Hour the clock starts at, 0 to 24 in the city's solar time, and how many hours pass every second of the clock
+	float startHour = 10.0f;
+	float hoursPerSecond = 0.0f;
+	// Latitude of the city in degrees, north positive, and the day of the year, 1 the first of January
+	float latitude = 45.0f;
+	int day = 172;
+
+	// Hour of the day at time seconds of the clock, wrapped to 0 to 24
+	float Hour(double time) const;
+	// Direction the sunlight falls in, away from the sun, in the city's model space
+	glm::vec3 Direction(double time) const;
+	// Color of the daylight the lit facades are scaled by, 1 at the zenith
+	glm::vec3 Color(double time) const;
+
+	// Daylight for a sun whose direction towards it rises by sinElevation, the sine of its elevation
+	static glm::vec3 Daylight(float sinElevation);
+private:
+	// Unit direction towards the sun at time seconds of the clock
+	glm::vec3 toSun(double time) const;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include"TraceRecorder.h"
+
+#include<algorithm>
+#include<fstream>
+#include<iomanip>
+
+TraceRecorder Tracer;
+
+// Track of the calling thread, -1 until its first event, track 0 is the GPU
+static thread_local int threadTrack = -1;
+
+// Writes text as a JSON string
+static void writeString(std::ofstream& file, const std::string& text)
+{
+	file << '"';
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			file << '\\' << c;
+		else if ((unsigned char)c < 0x20)
+			file << ' ';
+		else
+			file << c;
+	}
+	file << '"';
+}
+
+// Starts recording
+void TraceRecorder::Start()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	events.clear();
+	dropped = 0;
+	origin = std::chrono::steady_clock::now();
+	calibrated = false;
+	if (threadNames.empty())
+		threadNames.push_back("GPU");
+	active = true;
+}
+
+bool TraceRecorder::recording() const
+{
+	return active.load(std::memory_order_relaxed);
+}
+
+// Track of the calling thread
+int TraceRecorder::thread()
+{
+	if (threadTrack < 0)
+	{
+		threadTrack = (int)threadNames.size();
+		threadNames.push_back("thread " + std::to_string(threadTrack));
+	}
+	return threadTrack;
+}
+
+// Names the track of the calling thread
+void TraceRecorder::NameThread(const std::string& name)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (threadNames.empty())
+		threadNames.push_back("GPU");
+	threadNames[thread()] = name;
+}
+
+double TraceRecorder::microseconds(std::chrono::steady_clock::time_point time) const
+{
+	return std::chrono::duration<double, std::micro>(time - origin).count();
+}
+
+void TraceRecorder::add(Event event)
+{
+	if (events.size() >= MAX_EVENTS)
+	{
+		dropped++;
+		return;
+	}
+	events.push_back(std::move(event));
+}
+
+// Adds a zone of the calling thread
+void TraceRecorder::Add(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+	std::chrono::steady_clock::time_point end, const std::string& detail)
+{
+	if (!recording())
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	// Zones that started before recording did are cut at its start
+	if (end < origin)
+		return;
+	Event event;
+	event.name = name;
+	event.category = category;
+	event.detail = detail;
+	event.start = std::max(0.0, microseconds(start));
+	event.duration = microseconds(end) - event.start;
+	event.thread = thread();
+	add(std::move(event));
+}
+
+// Adds a zone of the GPU track
+void TraceRecorder::AddGpu(const char* name, GLuint64 start, GLuint64 end)
+{
+	if (!recording())
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!calibrated)
+		return;
+	Event event;
+	event.name = name;
+	event.category = "gpu";
+	event.start = ((int64_t)start + gpuOffset) / 1000.0;
+	event.duration = (double)(end - start) / 1000.0;
+	event.thread = 0;
+	if (event.start < 0.0)
+		return;
+	add(std::move(event));
+}
+
+// Measures the offset of the GPU clock to the CPU clock
+void TraceRecorder::Calibrate()
+{
+	if (!recording())
+		return;
+	// GL_TIMESTAMP read this way is the GPU clock once the commands so far reached it, without waiting for them to
+	// finish, taken between two CPU readings whose middle is the best guess of when it was sampled
+	std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+	GLint64 gpu = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpu);
+	std::chrono::steady_clock::time_point after = std::chrono::steady_clock::now();
+	if (gpu == 0)
+		return;
+	std::lock_guard<std::mutex> lock(mutex);
+	int64_t cpu = std::chrono::duration_cast<std::chrono::nanoseconds>(before - origin + (after - before) / 2).count();
+	gpuOffset = cpu - gpu;
+	calibrated = true;
+}
+
+// Writes the events as a trace event JSON file
+bool TraceRecorder::Write(const char* path)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::ofstream file(path);
+	if (!file)
+		return false;
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":" << dropped << "},\"traceEvents\":[\n";
+	// Names of the tracks, the GPU first, then the threads in the order they recorded something
+	for (size_t i = 0; i < threadNames.size(); i++)
+	{
+		file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"name\":";
+		writeString(file, threadNames[i]);
+		file << "}},\n";
+		file << "{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":1,\"tid\":" << i << ",\"args\":{\"sort_index\":" << i << "}},\n";
+	}
+	file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":1,\"args\":{\"name\":\"OpenGL\"}}";
+	for (const Event& event : events)
+	{
+		file << ",\n{\"ph\":\"X\",\"name\":";
+		writeString(file, event.name);
+		file << ",\"cat\":\"" << event.category << "\",\"pid\":1,\"tid\":" << event.thread
+			<< ",\"ts\":" << event.start << ",\"dur\":" << event.duration;
+		if (!event.detail.empty())
+		{
+			file << ",\"args\":{\"detail\":";
+			writeString(file, event.detail);
+			file << "}";
+		}
+		file << "}";
+	}
+	file << "\n]}\n";
+	return (bool)file;
+}
+
+// Constructor that starts the zone
+TraceScope::TraceScope(const char* name, const char* category, const std::string& detail) : name(name), category(category)
+{
+	active = Tracer.recording();
+	if (!active)
+		return;
+	TraceScope::detail = detail;
+	start = std::chrono::steady_clock::now();
+}
+
+// Destructor that adds the zone
+TraceScope::~TraceScope()
+{
+	if (active)
+		Tracer.Add(name, category, start, std::chrono::steady_clock::now(), detail);
+}
@@ -0,0 +1,86 @@
+#ifndef TRACE_RECORDER_CLASS_H
+#define TRACE_RECORDER_CLASS_H
+
+#include<glad/glad.h>
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<vector>
+
+// Records a timeline of CPU zones of every thread and GPU zones and writes it in Chrome's trace event format,
+// which chrome://tracing, Perfetto and speedscope open
+// Threads add their events under a lock, each gets a track of its own named after it. GPU timestamps are moved
+// onto the CPU clock with an offset measured by Calibrate, so passes line up with the CPU work that issued them.
+class TraceRecorder
+{
+public:
+	// Most events kept, later ones are counted and dropped so a long run cannot eat all memory
+	static constexpr size_t MAX_EVENTS = 4000000;
+
+	// Starts recording, events before it are not kept
+	void Start();
+	// Checks if events are recorded, cheap enough to ask before every event
+	bool recording() const;
+
+	// Names the track of the calling thread
+	void NameThread(const std::string& name);
+	// Adds a zone of the calling thread, detail shows up as an argument of the event
+	void Add(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+		std::chrono::steady_clock::time_point end, const std::string& detail = std::string());
+	// Adds a zone of the GPU track, start and end are GL_TIMESTAMP nanoseconds
+	void AddGpu(const char* name, GLuint64 start, GLuint64 end);
+	// Measures the offset of the GPU clock to the CPU clock, on the GL thread, reads the GPU clock without waiting
+	void Calibrate();
+
+	// Writes the events as a trace event JSON file, returns false if the file cannot be written
+	bool Write(const char* path);
+private:
+	struct Event
+	{
+		std::string name;
+		const char* category;
+		std::string detail;
+		// Microseconds since Start
+		double start;
+		double duration;
+		int thread;
+	};
+
+	std::atomic<bool> active{ false };
+	std::mutex mutex;
+	std::vector<Event> events;
+	std::vector<std::string> threadNames;
+	size_t dropped = 0;
+	std::chrono::steady_clock::time_point origin;
+	// CPU nanoseconds since origin minus GPU nanoseconds, 0 until the first calibration
+	int64_t gpuOffset = 0;
+	bool calibrated = false;
+
+	// Track of the calling thread, with the lock held
+	int thread();
+	double microseconds(std::chrono::steady_clock::time_point time) const;
+	void add(Event event);
+};
+
+// The one timeline of the program
+extern TraceRecorder Tracer;
+
+// Adds the scope it lives in to the timeline, does nothing while not recording
+class TraceScope
+{
+public:
+	// Constructor that starts the zone, name and category must outlive the scope
+	TraceScope(const char* name, const char* category = "job", const std::string& detail = std::string());
+	// Destructor that adds the zone
+	~TraceScope();
+private:
+	const char* name;
+	const char* category;
+	std::string detail;
+	bool active;
+	std::chrono::steady_clock::time_point start;
+};
+
+#endif
@@ -0,0 +1,329 @@
+#include"TrafficSimulation.h"
+#include"InstanceKernels.h"
+
+#include<algorithm>
+#include<cfloat>
+#include<utility>
+
+// Size of every car, the gap it keeps to the one ahead, how fast it speeds up and the range of top speeds, in city units
+static constexpr float VEHICLE_LENGTH = 0.45f;
+static constexpr float VEHICLE_WIDTH = 0.2f;
+static constexpr float VEHICLE_HEIGHT = 0.2f;
+static constexpr float VEHICLE_GAP = 0.2f;
+static constexpr float ACCELERATION = 2.0f;
+static constexpr float MIN_TOP_SPEED = 1.5f;
+static constexpr float MAX_TOP_SPEED = 3.0f;
+// Paints the cars are sprayed with, tints of facade layer 0 like the ground
+static const GLfloat PAINTS[6][3] = {
+	{ 0.8f, 0.1f, 0.1f }, { 0.1f, 0.25f, 0.7f }, { 0.9f, 0.9f, 0.9f }, { 0.15f, 0.15f, 0.15f }, { 0.9f, 0.75f, 0.1f }, { 0.5f, 0.5f, 0.55f }
+};
+
+// Mixes the bits of a number so that neighbouring vehicles get unrelated values, as CityGenerator does for its lots
+static uint32_t hashVehicle(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352dU;
+	x ^= x >> 15;
+	x *= 0x846ca68bU;
+	x ^= x >> 16;
+	return x;
+}
+
+// Turns a hash into a float between 0 and 1
+static float unitFloat(uint32_t hash)
+{
+	return (hash >> 8) * (1.0f / 16777216.0f);
+}
+
+// Constructor that lays the segments along the middle of every street and spreads the vehicles evenly over them
+TrafficSimulation::TrafficSimulation(const CityGenerator& city, size_t count)
+	: lane(0.25f * city.layout.streetWidth), seed(hashVehicle(city.layout.seed + 3))
+{
+	// Crossings are where the middles of the streets meet, one more than there are blocks along each axis
+	const CityLayout& layout = city.layout;
+	float blockPitch = layout.lotsPerSide * layout.lotSize + layout.streetWidth;
+	uint32_t nodesX = layout.blocksX + 1;
+	uint32_t nodesZ = layout.blocksZ + 1;
+	auto node = [&](uint32_t x, uint32_t z) {
+		return glm::vec2(-city.halfExtentX() + 0.5f * layout.streetWidth + x * blockPitch, -city.halfExtentZ() + 0.5f * layout.streetWidth + z * blockPitch);
+	};
+	exits.assign((size_t)nodesX * nodesZ * 4, UINT32_MAX);
+	const int steps[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+	for (uint32_t z = 0; z < nodesZ; z++)
+		for (uint32_t x = 0; x < nodesX; x++)
+			for (int k = 0; k < 4; k++)
+			{
+				int toX = (int)x + steps[k][0];
+				int toZ = (int)z + steps[k][1];
+				if (toX < 0 || toZ < 0 || toX >= (int)nodesX || toZ >= (int)nodesZ)
+					continue;
+				Segment road;
+				road.start = node(x, z);
+				road.direction = glm::vec2((float)steps[k][0], (float)steps[k][1]);
+				road.length = blockPitch;
+				road.endNode = (uint32_t)toZ * nodesX + (uint32_t)toX;
+				exits[((size_t)z * nodesX + x) * 4 + k] = (uint32_t)segments.size();
+				segments.push_back(road);
+			}
+
+	// At most every other car length of every segment is taken, so the traffic keeps flowing
+	size_t perSegment = (size_t)(blockPitch / (2.0f * (VEHICLE_LENGTH + VEHICLE_GAP)));
+	count = std::min(count, perSegment * segments.size());
+	segment.resize(count);
+	offset.resize(count);
+	speed.resize(count);
+	topSpeed.resize(count);
+	next.resize(count);
+	paint.resize(count);
+	startOffset.resize(count);
+	startPosition.resize(count);
+	sortedSegment.resize(count);
+	sortedOffset.resize(count);
+	sortedSpeed.resize(count);
+	sortedTopSpeed.resize(count);
+	sortedNext.resize(count);
+	sortedPaint.resize(count);
+	sortedStart.resize(count);
+	sortedStartOffset.resize(count);
+	segmentStart.assign(segments.size() + 1, 0);
+	fill.resize(segments.size());
+	// Vehicle v is number v / segments on segment v % segments, the segments' first cars are at their far ends
+	for (size_t v = 0; v < count; v++)
+	{
+		uint32_t road = (uint32_t)(v % segments.size());
+		size_t place = v / segments.size();
+		uint32_t hash = hashVehicle((uint32_t)v * 0x9e3779b9U ^ seed);
+		segment[v] = road;
+		offset[v] = segments[road].length * (1.0f - ((float)place + 0.5f) / (float)perSegment);
+		topSpeed[v] = MIN_TOP_SPEED + (MAX_TOP_SPEED - MIN_TOP_SPEED) * unitFloat(hash);
+		speed[v] = 0.0f;
+		paint[v] = hashVehicle(hash + 1) % 6;
+		next[v] = pickExit(road, hashVehicle(hash + 2));
+		startOffset[v] = offset[v];
+		startPosition[v] = position(road, offset[v]);
+	}
+	regroup();
+}
+
+size_t TrafficSimulation::vehicleCount() const
+{
+	return segment.size();
+}
+
+size_t TrafficSimulation::segmentCount() const
+{
+	return segments.size();
+}
+
+size_t TrafficSimulation::sliceCount(const JobSystem& jobs) const
+{
+	return jobs.Slices(vehicleCount(), WRITE_GRAIN);
+}
+
+// Moves every segment on side by side, then the vehicles that left theirs into the next
+void TrafficSimulation::Step(JobSystem& jobs, float seconds)
+{
+	size_t count = vehicleCount();
+	if (count == 0 || seconds <= 0.0f)
+		return;
+	jobs.ParallelFor(count, WRITE_GRAIN, [&](size_t, size_t begin, size_t end) {
+		for (size_t v = begin; v < end; v++)
+		{
+			startOffset[v] = offset[v];
+			startPosition[v] = position(segment[v], offset[v]);
+		}
+	});
+	// A segment only writes its own vehicles, the first one looks at where the next segment's last one started the step
+	jobs.ParallelFor(segments.size(), 64, [&](size_t, size_t begin, size_t end) {
+		for (size_t s = begin; s < end; s++)
+			for (uint32_t v = segmentStart[s]; v < segmentStart[s + 1]; v++)
+			{
+				float limit;
+				if (v > segmentStart[s])
+					limit = offset[v - 1] - VEHICLE_LENGTH - VEHICLE_GAP;
+				else
+				{
+					uint32_t ahead = next[v];
+					float tail = segmentStart[ahead + 1] > segmentStart[ahead] ? startOffset[segmentStart[ahead + 1] - 1] : segments[ahead].length;
+					limit = segments[s].length + tail - VEHICLE_LENGTH - VEHICLE_GAP;
+				}
+				speed[v] = std::min(speed[v] + ACCELERATION * seconds, topSpeed[v]);
+				float reach = offset[v] + speed[v] * seconds;
+				if (reach > limit)
+				{
+					reach = std::max(limit, offset[v]);
+					speed[v] = (reach - offset[v]) / seconds;
+				}
+				offset[v] = reach;
+			}
+	});
+	regroup();
+}
+
+// Distance at which the diameter of a car's bounding sphere shrinks to pixels
+void TrafficSimulation::DropBelow(float pixels, const glm::mat4& projection, float viewportHeight)
+{
+	float diameter = glm::length(glm::vec3(VEHICLE_LENGTH, VEHICLE_HEIGHT, VEHICLE_WIDTH));
+	// projection[1][1] is the cotangent of half the vertical field of view
+	dropDistance = pixels > 0.0f ? diameter * projection[1][1] * 0.5f * viewportHeight / pixels : 0.0f;
+}
+
+// Writes a record of every vehicle, slice by slice
+void TrafficSimulation::Write(JobSystem& jobs, float alpha, const glm::vec3& eye, CompactInstance* near, CompactInstance* far, Slice* slices) const
+{
+	float nearSquared = nearDistance * nearDistance;
+	float dropSquared = dropDistance > 0.0f ? dropDistance * dropDistance : FLT_MAX;
+	// Paints as the records hold them, worked out once
+	static const uint32_t paintColors[6] = { InstanceKernels::PackColor(PAINTS[0]), InstanceKernels::PackColor(PAINTS[1]),
+		InstanceKernels::PackColor(PAINTS[2]), InstanceKernels::PackColor(PAINTS[3]), InstanceKernels::PackColor(PAINTS[4]),
+		InstanceKernels::PackColor(PAINTS[5]) };
+	jobs.ParallelFor(vehicleCount(), WRITE_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+		Slice& run = slices[slice];
+		run.begin = (uint32_t)begin;
+		run.nearCount = 0;
+		run.farCount = 0;
+		run.droppedCount = 0;
+		// The cars of a chunk are staged as arrays of their values, the near and the far ones apart, and packed together
+		// A car is a quarter turn from the x axis when its street runs along z
+		struct Staged
+		{
+			float x[WRITE_CHUNK];
+			float z[WRITE_CHUNK];
+			uint8_t turns[WRITE_CHUNK];
+			uint32_t colors[WRITE_CHUNK];
+			uint32_t count;
+		};
+		Staged staged[2];
+		InstanceKernels::Arrays arrays[2];
+		for (int list = 0; list < 2; list++)
+		{
+			arrays[list].x = staged[list].x;
+			arrays[list].z = staged[list].z;
+			arrays[list].turns = staged[list].turns;
+			arrays[list].colors = staged[list].colors;
+			arrays[list].size = glm::vec3(VEHICLE_LENGTH, VEHICLE_HEIGHT, VEHICLE_WIDTH);
+		}
+		for (size_t chunk = begin; chunk < end; chunk += WRITE_CHUNK)
+		{
+			staged[0].count = staged[1].count = 0;
+			for (size_t v = chunk; v < std::min(end, chunk + WRITE_CHUNK); v++)
+			{
+				glm::vec2 center = glm::mix(startPosition[v], position(segment[v], offset[v]), alpha);
+				glm::vec3 toEye = glm::vec3(center.x, 0.0f, center.y) - eye;
+				float distanceSquared = glm::dot(toEye, toEye);
+				if (distanceSquared > dropSquared)
+				{
+					run.droppedCount++;
+					continue;
+				}
+				Staged& list = staged[distanceSquared < nearSquared ? 0 : 1];
+				list.x[list.count] = center.x;
+				list.z[list.count] = center.y;
+				list.turns[list.count] = segments[segment[v]].direction.x != 0.0f ? 0 : 1;
+				list.colors[list.count++] = paintColors[paint[v]];
+			}
+			InstanceKernels::Pack(arrays[0], 0, staged[0].count, near + begin + run.nearCount);
+			InstanceKernels::Pack(arrays[1], 0, staged[1].count, far + begin + run.farCount);
+			run.nearCount += staged[0].count;
+			run.farCount += staged[1].count;
+		}
+	});
+}
+
+// Writes a body of half the unit cube's height and a narrower cabin on top of it
+void TrafficSimulation::GenerateVehicle(GLfloat* vertices, GLuint* indices)
+{
+	CityGenerator::GenerateUnitBuilding(vertices, indices);
+	GLfloat* cabin = vertices + CityGenerator::BUILDING_VERTICES * CityGenerator::VERTEX_FLOATS;
+	CityGenerator::GenerateUnitBuilding(cabin, indices + CityGenerator::BUILDING_INDICES);
+	for (unsigned int i = 0; i < CityGenerator::BUILDING_VERTICES; i++)
+	{
+		GLfloat* body = vertices + i * CityGenerator::VERTEX_FLOATS;
+		body[1] *= 0.5f;
+		GLfloat* top = cabin + i * CityGenerator::VERTEX_FLOATS;
+		top[0] = 0.15f + 0.7f * top[0];
+		top[1] = 0.5f + 0.5f * top[1];
+		top[2] = 0.15f + 0.7f * top[2];
+	}
+	for (unsigned int i = 0; i < CityGenerator::BUILDING_INDICES; i++)
+		indices[CityGenerator::BUILDING_INDICES + i] += CityGenerator::BUILDING_VERTICES;
+}
+
+// Position on the lane to the right of the segment's direction, a quarter of a street from its middle
+glm::vec2 TrafficSimulation::position(uint32_t segment, float distance) const
+{
+	const Segment& road = segments[segment];
+	glm::vec2 right(-road.direction.y, road.direction.x);
+	return road.start + road.direction * distance + right * lane;
+}
+
+// Picks any exit of the crossing at the end of a segment but the one going back
+uint32_t TrafficSimulation::pickExit(uint32_t from, uint32_t hash) const
+{
+	const Segment& road = segments[from];
+	const uint32_t* choices = &exits[(size_t)road.endNode * 4];
+	uint32_t candidates[4];
+	uint32_t count = 0;
+	for (int k = 0; k < 4; k++)
+		if (choices[k] != UINT32_MAX && segments[choices[k]].direction != -road.direction)
+			candidates[count++] = choices[k];
+	return count > 0 ? candidates[hash % count] : from;
+}
+
+// Moves the vehicles past their segment's end on, then sorts them by segment and every segment from the front
+void TrafficSimulation::regroup()
+{
+	size_t count = vehicleCount();
+	for (size_t v = 0; v < count; v++)
+		while (offset[v] >= segments[segment[v]].length)
+		{
+			offset[v] -= segments[segment[v]].length;
+			segment[v] = next[v];
+			next[v] = pickExit(segment[v], hashVehicle((uint32_t)v * 0x85ebca6bU ^ seed ^ ++turns));
+		}
+
+	// Counting sort by segment, which keeps the order the cars had within it
+	std::fill(fill.begin(), fill.end(), 0u);
+	for (size_t v = 0; v < count; v++)
+		fill[segment[v]]++;
+	segmentStart[0] = 0;
+	for (size_t s = 0; s < segments.size(); s++)
+	{
+		segmentStart[s + 1] = segmentStart[s] + fill[s];
+		fill[s] = segmentStart[s];
+	}
+	for (size_t v = 0; v < count; v++)
+	{
+		uint32_t slot = fill[segment[v]]++;
+		sortedSegment[slot] = segment[v];
+		sortedOffset[slot] = offset[v];
+		sortedSpeed[slot] = speed[v];
+		sortedTopSpeed[slot] = topSpeed[v];
+		sortedNext[slot] = next[v];
+		sortedPaint[slot] = paint[v];
+		sortedStart[slot] = startPosition[v];
+		sortedStartOffset[slot] = startOffset[v];
+	}
+	segment.swap(sortedSegment);
+	offset.swap(sortedOffset);
+	speed.swap(sortedSpeed);
+	topSpeed.swap(sortedTopSpeed);
+	next.swap(sortedNext);
+	paint.swap(sortedPaint);
+	startPosition.swap(sortedStart);
+	startOffset.swap(sortedStartOffset);
+
+	// Cars that just turned in came in anywhere, an insertion sort puts them behind the ones already driving
+	for (size_t s = 0; s < segments.size(); s++)
+		for (uint32_t v = segmentStart[s] + 1; v < segmentStart[s + 1]; v++)
+			for (uint32_t w = v; w > segmentStart[s] && offset[w - 1] < offset[w]; w--)
+			{
+				std::swap(offset[w - 1], offset[w]);
+				std::swap(speed[w - 1], speed[w]);
+				std::swap(topSpeed[w - 1], topSpeed[w]);
+				std::swap(next[w - 1], next[w]);
+				std::swap(paint[w - 1], paint[w]);
+				std::swap(startPosition[w - 1], startPosition[w]);
+				std::swap(startOffset[w - 1], startOffset[w]);
+			}
+}
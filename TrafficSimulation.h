@@ -0,0 +1,119 @@
+#ifndef TRAFFIC_SIMULATION_CLASS_H
+#define TRAFFIC_SIMULATION_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+#include"CityGenerator.h"
+#include"CompactInstance.h"
+#include"JobSystem.h"
+
+// Cars driving the streets of a generated city, on the right hand lane of every street between two crossings.
+// Vehicles are stored as arrays of each of their values, sorted by the road segment they are on and within it from
+// the front, so Step can move the segments on the job system's workers side by side: every car speeds up towards its
+// own top speed and keeps its distance to the car ahead, the first of a segment to the last car of the segment it
+// turns into next. Cars past the end of their segment are then moved into the next one on the calling thread, and
+// turn at random at every crossing, the same seed always gives the same traffic.
+// Write turns every car into a compact record of the unit vehicle mesh, in model space between the state before the
+// last step and the one after it, split by the distance to the camera into a near list and a far one that draws
+// only the body of the mesh. The cars are staged a chunk at a time as arrays of their values that InstanceKernels packs.
+class TrafficSimulation
+{
+public:
+	// The unit vehicle GenerateVehicle writes, a body with a cabin on top, the body alone is its first BODY_INDICES
+	static constexpr unsigned int VEHICLE_VERTICES = 2 * CityGenerator::BUILDING_VERTICES;
+	static constexpr unsigned int VEHICLE_INDICES = 2 * CityGenerator::BUILDING_INDICES;
+	static constexpr unsigned int BODY_INDICES = CityGenerator::BUILDING_INDICES;
+	// Smallest number of vehicles a slice of Write's loop gets
+	static constexpr size_t WRITE_GRAIN = 1024;
+	// Vehicles Write stages at once before InstanceKernels packs them
+	static constexpr size_t WRITE_CHUNK = 256;
+
+	// Records Write put into one slice of each list, starting at begin
+	struct Slice
+	{
+		uint32_t begin;
+		uint32_t nearCount;
+		uint32_t farCount;
+		// Vehicles of the slice that were too far away to be written
+		uint32_t droppedCount;
+	};
+
+	// Vehicles closer to the camera than this are drawn with their cabin
+	float nearDistance = 30.0f;
+	// Vehicles farther from the camera than this are not written at all, 0 writes every one
+	float dropDistance = 0.0f;
+
+	// Constructor that lays out the road graph of city and spreads count vehicles over it
+	TrafficSimulation(const CityGenerator& city, size_t count);
+
+	// Number of vehicles and of directed road segments
+	size_t vehicleCount() const;
+	size_t segmentCount() const;
+	// Number of slices Write splits the vehicles into on jobs
+	size_t sliceCount(const JobSystem& jobs) const;
+
+	// Sets dropDistance to where a car's bounding sphere covers pixels on screen, for a camera with projection and a
+	// viewport viewportHeight pixels high, as LevelOfDetail::ProjectedSize measures it; 0 pixels drops none
+	void DropBelow(float pixels, const glm::mat4& projection, float viewportHeight);
+	// Moves every vehicle on by seconds
+	void Step(JobSystem& jobs, float seconds);
+	// Writes a record of every vehicle at alpha between the last two steps into near or far, both sized by
+	// vehicleCount, in one run per slice that slices describes, sized by sliceCount. eye is the camera in model space
+	void Write(JobSystem& jobs, float alpha, const glm::vec3& eye, CompactInstance* near, CompactInstance* far, Slice* slices) const;
+
+	// Writes the unit vehicle, VEHICLE_VERTICES vertices and VEHICLE_INDICES indices spanning the unit cube
+	static void GenerateVehicle(GLfloat* vertices, GLuint* indices);
+private:
+	// A street between two crossings driven one way, on the lane to the right of its direction
+	struct Segment
+	{
+		glm::vec2 start;
+		glm::vec2 direction;
+		float length;
+		uint32_t endNode;
+	};
+	std::vector<Segment> segments;
+	// Distance of the lanes from the middle of their street
+	float lane;
+	// Segments leaving every crossing, at most four each, UINT32_MAX where there are fewer
+	std::vector<uint32_t> exits;
+
+	// Every vehicle's segment, distance along it, speed, top speed, the segment it turns into next and its paint,
+	// and where it was at the start of the last step
+	std::vector<uint32_t> segment;
+	std::vector<float> offset;
+	std::vector<float> speed;
+	std::vector<float> topSpeed;
+	std::vector<uint32_t> next;
+	std::vector<uint32_t> paint;
+	std::vector<float> startOffset;
+	std::vector<glm::vec2> startPosition;
+	// Vehicles of segment s are the ones from segmentStart[s] to segmentStart[s + 1]
+	std::vector<uint32_t> segmentStart;
+	// Same arrays again that moving vehicles between segments sorts into, kept so Step allocates nothing
+	std::vector<uint32_t> sortedSegment;
+	std::vector<float> sortedOffset;
+	std::vector<float> sortedSpeed;
+	std::vector<float> sortedTopSpeed;
+	std::vector<uint32_t> sortedNext;
+	std::vector<uint32_t> sortedPaint;
+	std::vector<glm::vec2> sortedStart;
+	std::vector<float> sortedStartOffset;
+	std::vector<uint32_t> fill;
+	uint32_t seed;
+	// Counts the turns taken, so the same car picks a different way the next time it reaches a crossing
+	uint32_t turns = 0;
+
+	// Position of a vehicle on the lane of a segment at a distance along it
+	glm::vec2 position(uint32_t segment, float distance) const;
+	// Picks the segment a vehicle turns into at the end of one, any exit of its crossing but the way back
+	uint32_t pickExit(uint32_t from, uint32_t hash) const;
+	// Moves the vehicles past the end of their segment into the next one and sorts every segment from the front
+	void regroup();
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include"TransformHierarchy.h"
+
+#include<algorithm>
+#include<cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SSE 1
+#include<xmmintrin.h>
+#endif
+
+// Multiplies two column major matrices, out may not be one of them
+static inline void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+#ifdef TRANSFORM_SSE
+	// Every column of the product is the columns of a weighted by one column of b, four floats per instruction
+	const __m128 a0 = _mm_loadu_ps(&a[0][0]);
+	const __m128 a1 = _mm_loadu_ps(&a[1][0]);
+	const __m128 a2 = _mm_loadu_ps(&a[2][0]);
+	const __m128 a3 = _mm_loadu_ps(&a[3][0]);
+	for (int j = 0; j < 4; j++)
+	{
+		__m128 column = _mm_add_ps
+		(
+			_mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(b[j][0])), _mm_mul_ps(a1, _mm_set1_ps(b[j][1]))),
+			_mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(b[j][2])), _mm_mul_ps(a3, _mm_set1_ps(b[j][3])))
+		);
+		_mm_storeu_ps(&out[j][0], column);
+	}
+#else
+	out = a * b;
+#endif
+}
+
+// Reserves room in every array
+void TransformHierarchy::Reserve(size_t count)
+{
+	nodeParent.reserve(count);
+	nodeDepth.reserve(count);
+	nodeIndex.reserve(count);
+	parent.reserve(count);
+	local.reserve(count);
+	world.reserve(count);
+	dirty.reserve(count);
+}
+
+// Appends a node behind the sorted ones, Update sorts it in
+uint32_t TransformHierarchy::Add(uint32_t parentNode, const glm::mat4& localMatrix)
+{
+	uint32_t id = (uint32_t)nodeParent.size();
+	uint32_t index = (uint32_t)parent.size();
+	nodeParent.push_back(parentNode);
+	nodeDepth.push_back(parentNode == NONE ? 0 : nodeDepth[parentNode] + 1);
+	nodeIndex.push_back(index);
+	parent.push_back(parentNode == NONE ? NONE : nodeIndex[parentNode]);
+	local.push_back(localMatrix);
+	world.push_back(localMatrix);
+	dirty.push_back(1);
+	sorted = false;
+	anyDirty = true;
+	return id;
+}
+
+// Sets the transform of a node relative to its parent
+void TransformHierarchy::SetLocal(uint32_t node, const glm::mat4& localMatrix)
+{
+	uint32_t index = nodeIndex[node];
+	local[index] = localMatrix;
+	dirty[index] = 1;
+	anyDirty = true;
+}
+
+// Transform of a node relative to its parent
+const glm::mat4& TransformHierarchy::Local(uint32_t node) const
+{
+	return local[nodeIndex[node]];
+}
+
+// Transform of a node in the world as of the last Update
+const glm::mat4& TransformHierarchy::World(uint32_t node) const
+{
+	return world[nodeIndex[node]];
+}
+
+// Parent of a node
+uint32_t TransformHierarchy::Parent(uint32_t node) const
+{
+	return nodeParent[node];
+}
+
+// Sorts the nodes by depth, keeping the order they were added in within a depth
+void TransformHierarchy::sort()
+{
+	uint32_t depths = 0;
+	for (uint32_t depth : nodeDepth)
+		depths = std::max(depths, depth + 1);
+	levelStart.assign((size_t)depths + 1, 0);
+	for (uint32_t depth : nodeDepth)
+		levelStart[(size_t)depth + 1]++;
+	for (size_t d = 1; d < levelStart.size(); d++)
+		levelStart[d] += levelStart[d - 1];
+
+	std::vector<uint32_t> fill(levelStart.begin(), levelStart.end() - 1);
+	std::vector<glm::mat4> sortedLocal(local.size());
+	std::vector<glm::mat4> sortedWorld(world.size());
+	std::vector<uint8_t> sortedDirty(dirty.size());
+	for (uint32_t id = 0; id < (uint32_t)nodeParent.size(); id++)
+	{
+		uint32_t from = nodeIndex[id];
+		uint32_t to = fill[nodeDepth[id]]++;
+		sortedLocal[to] = local[from];
+		sortedWorld[to] = world[from];
+		sortedDirty[to] = dirty[from];
+		nodeIndex[id] = to;
+	}
+	local.swap(sortedLocal);
+	world.swap(sortedWorld);
+	dirty.swap(sortedDirty);
+	// Parents are looked up by id, they may have moved as well
+	for (uint32_t id = 0; id < (uint32_t)nodeParent.size(); id++)
+		parent[nodeIndex[id]] = nodeParent[id] == NONE ? NONE : nodeIndex[nodeParent[id]];
+	sorted = true;
+}
+
+// Recomputes the nodes of one depth whose own matrix or whose parent's world matrix changed
+size_t TransformHierarchy::updateRange(size_t begin, size_t end)
+{
+	// The parent's flag is final once its depth is done, so a dirty subtree passes its flag on a depth at a time
+	size_t count = 0;
+	for (size_t i = begin; i < end; i++)
+	{
+		uint32_t p = parent[i];
+		if (!(dirty[i] | dirty[p]))
+			continue;
+		dirty[i] = 1;
+		multiply(world[p], local[i], world[i]);
+		count++;
+	}
+	return count;
+}
+
+// Recomputes the world matrices depth by depth, the roots first
+size_t TransformHierarchy::Update(JobSystem& jobs)
+{
+	if (!anyDirty)
+		return 0;
+	if (!sorted)
+		sort();
+
+	size_t count = 0;
+	for (size_t i = levelStart[0]; i < levelStart[1]; i++)
+	{
+		if (!dirty[i])
+			continue;
+		world[i] = local[i];
+		count++;
+	}
+	for (size_t d = 1; d + 1 < levelStart.size(); d++)
+	{
+		size_t begin = levelStart[d], end = levelStart[d + 1];
+		if (end - begin < 2 * UPDATE_GRAIN)
+		{
+			count += updateRange(begin, end);
+			continue;
+		}
+		// Nodes of one depth only read the depth above, so the workers take slices of it side by side
+		sliceCounts.assign(jobs.Slices(end - begin, UPDATE_GRAIN), 0);
+		jobs.ParallelFor(end - begin, UPDATE_GRAIN, [&](size_t slice, size_t sliceBegin, size_t sliceEnd) {
+			sliceCounts[slice] = updateRange(begin + sliceBegin, begin + sliceEnd);
+		});
+		for (size_t sliceCount : sliceCounts)
+			count += sliceCount;
+	}
+	std::memset(dirty.data(), 0, dirty.size());
+	anyDirty = false;
+	return count;
+}
+
+// Removes every node
+void TransformHierarchy::Clear()
+{
+	nodeParent.clear();
+	nodeDepth.clear();
+	nodeIndex.clear();
+	parent.clear();
+	local.clear();
+	world.clear();
+	dirty.clear();
+	levelStart.clear();
+	sorted = true;
+	anyDirty = false;
+}
+
+// Number of nodes
+size_t TransformHierarchy::size() const
+{
+	return nodeParent.size();
+}
+
+// Number of depths, as of the last Update
+size_t TransformHierarchy::depthCount() const
+{
+	return levelStart.empty() ? 0 : levelStart.size() - 1;
+}
@@ -0,0 +1,68 @@
+#ifndef TRANSFORM_HIERARCHY_CLASS_H
+#define TRANSFORM_HIERARCHY_CLASS_H
+
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<vector>
+
+#include"JobSystem.h"
+
+// Parent and child transforms, such as the signs, antennas and rooftop units attached to a building
+// Nodes are stored breadth-first in flat arrays: every node of one depth comes before every node of the next, so a
+// parent's world matrix is always final before its children read it and a whole depth can be updated in any order.
+// Changing a node's local matrix marks it dirty, and Update recomputes the world matrices of the dirty nodes and of
+// everything below them, a depth at a time, with four wide SSE multiplies where there is SSE and the nodes of large
+// depths split over the job system's workers. Nodes keep the id Add gave them while the storage is sorted around them.
+class TransformHierarchy
+{
+public:
+	// Parent of a root node
+	static constexpr uint32_t NONE = 0xffffffffu;
+	// Smallest number of nodes of one depth a worker gets
+	static constexpr size_t UPDATE_GRAIN = 4096;
+
+	// Reserves room for count nodes, so adding that many does not reallocate the arrays
+	void Reserve(size_t count);
+	// Adds a node below parent, or a root with NONE, and returns its id, the parent has to be added first
+	// Its world matrix is valid after the next Update
+	uint32_t Add(uint32_t parent, const glm::mat4& local);
+	// Sets the transform of a node relative to its parent and marks it and everything below it for the next Update
+	void SetLocal(uint32_t node, const glm::mat4& local);
+	// Transform of a node relative to its parent
+	const glm::mat4& Local(uint32_t node) const;
+	// Transform of a node in the world as of the last Update
+	const glm::mat4& World(uint32_t node) const;
+	// Parent of a node, NONE for a root
+	uint32_t Parent(uint32_t node) const;
+	// Recomputes the world matrices of the dirty subtrees, returns how many were recomputed
+	size_t Update(JobSystem& jobs);
+	// Removes every node
+	void Clear();
+	// Number of nodes and of depths
+	size_t size() const;
+	size_t depthCount() const;
+private:
+	// Parent, depth and breadth-first index of every node id
+	std::vector<uint32_t> nodeParent;
+	std::vector<uint32_t> nodeDepth;
+	std::vector<uint32_t> nodeIndex;
+	// Breadth-first arrays, nodes added since the last Update are at the end until it sorts them in
+	std::vector<uint32_t> parent;
+	std::vector<glm::mat4> local;
+	std::vector<glm::mat4> world;
+	std::vector<uint8_t> dirty;
+	// Nodes of depth d are the ones from levelStart[d] to levelStart[d + 1]
+	std::vector<uint32_t> levelStart;
+	// Recomputed nodes counted by each slice of a depth
+	std::vector<size_t> sliceCounts;
+	bool sorted = true;
+	bool anyDirty = false;
+
+	// Puts the nodes in breadth-first order again after nodes were added
+	void sort();
+	// Recomputes the dirty nodes from begin to end of one depth below the roots, returns how many
+	size_t updateRange(size_t begin, size_t end);
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include"TransparencyPass.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<iostream>
+
+// Full screen triangle, every pixel the glass covered is blended once
+static const char* compositeVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+static const char* compositeFragmentSource = R"(
+#version 330 core
+uniform sampler2D accumulation;
+uniform sampler2D weights;
+
+out vec4 FragColor;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 sum = texelFetch(accumulation, pixel, 0);
+    // Alpha is how much of the scene still shows through, all of it where no glass was drawn
+    if (sum.a >= 1.0)
+        discard;
+    FragColor = vec4(sum.rgb / max(texelFetch(weights, pixel, 0).r, 1e-5), 1.0 - sum.a);
+}
+)";
+
+// Constructor that builds the composite program
+TransparencyPass::TransparencyPass()
+{
+	compositeProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, compositeVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, compositeFragmentSource, "FRAGMENT") });
+
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(compositeProgram);
+	glUniform1i(glGetUniformLocation(compositeProgram, "accumulation"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(compositeProgram, "weights"), TEXTURE_UNIT + 1);
+	GLState.UseProgram(previousProgram);
+
+	glGenVertexArrays(1, &emptyVAO);
+}
+
+// Deletes the GL objects unless Delete was already called
+TransparencyPass::~TransparencyPass()
+{
+	Delete();
+}
+
+// Copies the opaque depth, binds and clears the targets and sets up the blending
+void TransparencyPass::Begin(GLsizei width, GLsizei height)
+{
+	if (width != TransparencyPass::width || height != TransparencyPass::height || framebuffer == 0)
+		resize(width, height);
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	output = (GLuint)previous;
+	depthTest = glIsEnabled(GL_DEPTH_TEST);
+
+	// Copied the way DepthPyramid does, a multisampled framebuffer is blitted from since it cannot be copied
+	GLint sampleBuffers = 0;
+	glGetIntegerv(GL_SAMPLE_BUFFERS, &sampleBuffers);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	if (sampleBuffers > 0)
+	{
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, output);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, opaqueDepth, 0);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+		GLState.BindTexture(GL_TEXTURE_2D, opaqueDepth);
+	}
+	else
+	{
+		GLState.BindTexture(GL_TEXTURE_2D, opaqueDepth);
+		glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	const GLenum attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, attachments);
+	const GLfloat clearSum[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const GLfloat clearWeight[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, clearSum);
+	glClearBufferfv(GL_COLOR, 1, clearWeight);
+
+	// Colors and weights add up, the alpha multiplies by what every fragment lets through
+	GLState.Disable(GL_DEPTH_TEST);
+	GLState.Enable(GL_BLEND);
+	glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// Sets the uniforms of the glass program in use
+void TransparencyPass::Apply(GLuint program)
+{
+	glUniform1i(glGetUniformLocation(program, "opaqueDepth"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "reverseZ"), reverseDepth ? 1 : 0);
+	GLState.CountUniforms(2);
+}
+
+// Blends the glass over the framebuffer bound at Begin
+void TransparencyPass::Composite()
+{
+	GLint previousProgram, previousVAO;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, output);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState.UseProgram(compositeProgram);
+	const GLuint targets[2] = { accumulation, weights };
+	for (GLuint i = 0; i < 2; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, targets[i]);
+	}
+	GLState.BindVertexArray(emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	GLState.CountDraw(1, 1);
+	for (GLuint i = 0; i < 2; i++)
+	{
+		GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + i);
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	GLState.Disable(GL_BLEND);
+	glBlendFunc(GL_ONE, GL_ZERO);
+	GLState.BindVertexArray(previousVAO);
+	GLState.UseProgram(previousProgram);
+	if (depthTest)
+		GLState.Enable(GL_DEPTH_TEST);
+}
+
+// Reallocates the targets and the depth copy for a new framebuffer size
+void TransparencyPass::resize(GLsizei width, GLsizei height)
+{
+	deleteTargets();
+	TransparencyPass::width = width;
+	TransparencyPass::height = height;
+
+	// Texels are only ever fetched at their own pixel, the depth copy keeps the format of a reverse-Z float depth buffer
+	const GLenum formats[3][3] = {
+		{ GL_RGBA16F, GL_RGBA, GL_FLOAT },
+		{ GL_R16F, GL_RED, GL_FLOAT },
+		{ reverseDepth ? (GLenum)GL_DEPTH_COMPONENT32F : (GLenum)GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, reverseDepth ? (GLenum)GL_FLOAT : (GLenum)GL_UNSIGNED_INT }
+	};
+	GLuint* targets[3] = { &accumulation, &weights, &opaqueDepth };
+	for (int i = 0; i < 3; i++)
+	{
+		glGenTextures(1, targets[i]);
+		GLState.BindTexture(GL_TEXTURE_2D, *targets[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+		glTexImage2D(GL_TEXTURE_2D, 0, formats[i][0], width, height, 0, formats[i][1], formats[i][2], nullptr);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, *targets[i], GpuMemoryTracker::ImageBytes(formats[i][0], width, height));
+	}
+	GLState.BindTexture(GL_TEXTURE_2D, 0);
+
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weights, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::TRANSPARENCY::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, (GLuint)previous);
+}
+
+// Deletes the targets and the framebuffer
+void TransparencyPass::deleteTargets()
+{
+	GLuint targets[] = { accumulation, weights, opaqueDepth };
+	for (GLuint target : targets)
+		if (target != 0)
+			GLState.DeleteTextures(1, &target);
+	accumulation = weights = opaqueDepth = 0;
+	if (framebuffer != 0)
+		glDeleteFramebuffers(1, &framebuffer);
+	framebuffer = 0;
+	width = height = 0;
+}
+
+// Deletes the GL objects
+void TransparencyPass::Delete()
+{
+	deleteTargets();
+	if (compositeProgram != 0)
+		GLState.DeleteProgram(compositeProgram);
+	if (emptyVAO != 0)
+		GLState.DeleteVertexArrays(1, &emptyVAO);
+	compositeProgram = emptyVAO = 0;
+}
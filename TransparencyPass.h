@@ -0,0 +1,58 @@
+#ifndef TRANSPARENCY_PASS_CLASS_H
+#define TRANSPARENCY_PASS_CLASS_H
+
+#include<glad/glad.h>
+
+// Weighted blended order-independent transparency for the glass facades of the forward frames
+// Begin copies the opaque depth and switches to two float targets that glass is drawn into in any order: the first
+// sums each fragment's premultiplied color by a weight that favours near fragments, its alpha keeps the product of
+// (1 - alpha), how much of the opaque scene still shows through, and the second sums the weights. One
+// glBlendFuncSeparate does both, so it runs on GL 3.3 without per target blending. Composite then blends the
+// weighted average color over the framebuffer bound at Begin with a full screen triangle.
+// The glass is tested against the copied depth in its fragment shader, see Apply, the targets have no depth buffer.
+class TransparencyPass
+{
+public:
+	// The opaque depth is bound to this texture unit while glass is drawn, clear of the facades and the lights
+	static constexpr GLuint TEXTURE_UNIT = 5;
+
+	// Set when the scene is drawn reverse-Z, see ReverseDepth.h, before the first Begin
+	bool reverseDepth = false;
+
+	// Constructor that builds the composite program, the targets are made by the first Begin
+	TransparencyPass();
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~TransparencyPass();
+	// A TransparencyPass owns its GL objects, so it can be neither copied nor moved
+	TransparencyPass(const TransparencyPass&) = delete;
+	TransparencyPass& operator=(const TransparencyPass&) = delete;
+
+	// Copies the depth of the framebuffer being drawn, which is width by height, binds and clears the targets and
+	// sets up the blending, the caller then draws the glass with a program Apply was called for
+	void Begin(GLsizei width, GLsizei height);
+	// Sets the opaqueDepth and reverseZ uniforms of the glass program in use
+	void Apply(GLuint program);
+	// Blends the glass over the framebuffer that was bound at Begin and puts back the state Begin changed
+	void Composite();
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	GLsizei width = 0;
+	GLsizei height = 0;
+	GLuint framebuffer = 0;
+	GLuint accumulation = 0;
+	GLuint weights = 0;
+	GLuint opaqueDepth = 0;
+	GLuint compositeProgram = 0;
+	GLuint emptyVAO = 0;
+	// Framebuffer that was bound at Begin and whether it had depth testing on
+	GLuint output = 0;
+	GLboolean depthTest = GL_FALSE;
+
+	// Reallocates the targets and the depth copy for a new framebuffer size
+	void resize(GLsizei width, GLsizei height);
+	// Deletes the targets and the framebuffer
+	void deleteTargets();
+};
+
+#endif
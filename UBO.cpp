@@ -0,0 +1,71 @@
+#include"UBO.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+// Constructor that generates a Uniform Buffer Object of a given size
+UBO::UBO(GLsizeiptr size, const void* data, GLenum usage)
+{
+	glGenBuffers(1, &ID);
+	GLState.BindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferData(GL_UNIFORM_BUFFER, size, data, usage);
+	GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, ID, size);
+}
+
+// Deletes the buffer unless Delete was already called
+UBO::~UBO()
+{
+	Delete();
+}
+
+// Takes over the buffer of another UBO, which is left empty
+UBO::UBO(UBO&& other) noexcept
+	: ID(other.ID)
+{
+	other.ID = 0;
+}
+
+// Deletes the current buffer and takes over the one of another UBO
+UBO& UBO::operator=(UBO&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
+}
+
+// Overwrites part of the UBO with new data
+void UBO::Update(const void* data, GLsizeiptr size, GLintptr offset)
+{
+	GLState.BindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	GLState.CountUpload(size);
+}
+
+// Attaches the whole UBO to a binding point shared by every Shader Program
+void UBO::BindBase(GLuint binding)
+{
+	GLState.BindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+}
+
+// Binds the UBO
+void UBO::Bind()
+{
+	GLState.BindBuffer(GL_UNIFORM_BUFFER, ID);
+}
+
+// Unbinds the UBO
+void UBO::Unbind()
+{
+	GLState.BindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// Deletes the UBO
+void UBO::Delete()
+{
+	if (ID != 0)
+		GLState.DeleteBuffers(1, &ID);
+	ID = 0;
+}
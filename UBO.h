@@ -0,0 +1,33 @@
+#ifndef UBO_CLASS_H
+#define UBO_CLASS_H
+
+#include<glad/glad.h>
+
+class UBO
+{
+public:
+	// Reference ID of the Uniform Buffer Object
+	GLuint ID = 0;
+	// Constructor that generates a Uniform Buffer Object of a given size, data can be left null to fill it later
+	UBO(GLsizeiptr size, const void* data = nullptr, GLenum usage = GL_DYNAMIC_DRAW);
+	// Deletes the buffer unless Delete was already called, the context has to still be current
+	~UBO();
+	// A UBO owns its GL object, so it can be moved but not copied
+	UBO(const UBO&) = delete;
+	UBO& operator=(const UBO&) = delete;
+	UBO(UBO&& other) noexcept;
+	UBO& operator=(UBO&& other) noexcept;
+
+	// Overwrites part of the UBO with new data
+	void Update(const void* data, GLsizeiptr size, GLintptr offset = 0);
+	// Attaches the whole UBO to a binding point shared by every Shader Program
+	void BindBase(GLuint binding);
+	// Binds the UBO
+	void Bind();
+	// Unbinds the UBO
+	void Unbind();
+	// Deletes the UBO, does nothing if it was already deleted or moved from
+	void Delete();
+};
+
+#endif
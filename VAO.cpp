@@ -1,34 +1,139 @@
 #include"VAO.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GLDebugOutput.h"
+
+#include<algorithm>
 
 // Constructor that generates a VAO ID
 VAO::VAO()
 {
-	glGenVertexArrays(1, &ID);
+	if (GLExt.directStateAccess)
+		glCreateVertexArrays(1, &ID);
+	else
+		glGenVertexArrays(1, &ID);
+}
+
+// Deletes the vertex array unless Delete was already called
+VAO::~VAO()
+{
+	Delete();
+}
+
+// Takes over the vertex array of another VAO, which is left empty
+VAO::VAO(VAO&& other) noexcept
+	: ID(other.ID)
+{
+	std::copy(other.attributes, other.attributes + ATTRIBUTES, attributes);
+	std::copy(other.divisors, other.divisors + ATTRIBUTES, divisors);
+	other.ID = 0;
+}
+
+// Deletes the current vertex array and takes over the one of another VAO
+VAO& VAO::operator=(VAO&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		std::copy(other.attributes, other.attributes + ATTRIBUTES, attributes);
+		std::copy(other.divisors, other.divisors + ATTRIBUTES, divisors);
+		other.ID = 0;
+	}
+	return *this;
 }
 
-// Links a VBO Attribute such as a position or color to the VAO
-void VAO::LinkAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset)
+// Sets the format of an attribute location
+void VAO::Format(GLuint layout, GLuint numComponents, GLenum type, GLboolean normalized, GLuint relativeOffset, GLuint binding)
 {
-	VBO.Bind();
-	glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
-	glEnableVertexAttribArray(layout);
-	VBO.Unbind();
+	attributes[layout] = { numComponents, type, normalized, relativeOffset, binding };
+	if (GLExt.directStateAccess)
+	{
+		glVertexArrayAttribFormat(ID, layout, numComponents, type, normalized, relativeOffset);
+		glVertexArrayAttribBinding(ID, layout, binding);
+		glEnableVertexArrayAttrib(ID, layout);
+	}
+	else if (GLExt.vertexAttribBinding)
+	{
+		glVertexAttribFormat(layout, numComponents, type, normalized, relativeOffset);
+		glVertexAttribBinding(layout, binding);
+		glEnableVertexAttribArray(layout);
+	}
+}
+
+// Sets how often a binding advances
+void VAO::Divisor(GLuint binding, GLuint divisor)
+{
+	divisors[binding] = divisor;
+	if (GLExt.directStateAccess)
+		glVertexArrayBindingDivisor(ID, binding, divisor);
+	else if (GLExt.vertexAttribBinding)
+		glVertexBindingDivisor(binding, divisor);
+}
+
+// Links a buffer to a binding
+void VAO::LinkBuffer(GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride)
+{
+	if (GLExt.directStateAccess)
+	{
+		glVertexArrayVertexBuffer(ID, binding, buffer, offset, stride);
+		return;
+	}
+	if (GLExt.vertexAttribBinding)
+	{
+		glBindVertexBuffer(binding, buffer, offset, stride);
+		return;
+	}
+	// Every attribute of the binding points into the buffer on its own
+	GLState.BindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (GLuint layout = 0; layout < ATTRIBUTES; layout++)
+	{
+		const Attribute& attribute = attributes[layout];
+		if (attribute.components == 0 || attribute.binding != binding)
+			continue;
+		glVertexAttribPointer(layout, attribute.components, attribute.type, attribute.normalized, stride, (void*)(offset + attribute.offset));
+		glEnableVertexAttribArray(layout);
+		glVertexAttribDivisor(layout, divisors[binding]);
+	}
+	GLState.BindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Links the index buffer the VAO draws with
+void VAO::LinkElements(GLuint buffer)
+{
+	if (GLExt.directStateAccess)
+	{
+		GLState.VertexArrayElementBuffer(ID, buffer);
+		return;
+	}
+	GLState.BindVertexArray(ID);
+	GLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+}
+
+// Names the vertex array in GPU captures and debug messages
+void VAO::Label(const char* name)
+{
+	if (!GLExt.directStateAccess)
+		GLState.BindVertexArray(ID);
+	GLDebug.Label(GL_VERTEX_ARRAY, ID, name);
 }
 
 // Binds the VAO
 void VAO::Bind()
 {
-	glBindVertexArray(ID);
+	GLState.BindVertexArray(ID);
 }
 
 // Unbinds the VAO
 void VAO::Unbind()
 {
-	glBindVertexArray(0);
+	GLState.BindVertexArray(0);
 }
 
 // Deletes the VAO
 void VAO::Delete()
 {
-	glDeleteVertexArrays(1, &ID);
-}
\ No newline at end of file
+	if (ID != 0)
+		GLState.DeleteVertexArrays(1, &ID);
+	ID = 0;
+}
@@ -2,24 +2,64 @@
 #define VAO_CLASS_H
 
 #include<glad/glad.h>
-#include"VBO.h"
 
+// A vertex format: which attribute locations read which components at which offset of which buffer binding.
+// The format is set once and meshes sharing it only link their buffers to the bindings, so one VAO serves every mesh
+// of a format, and with a buffer heap holding all of them nothing changes between draws at all.
+// With GLExt.vertexAttribBinding that is glVertexAttribFormat and glBindVertexBuffer, without it the VAO remembers
+// the format and linking a buffer sets the pointers of every attribute of that binding the GL 3.3 way.
 class VAO
 {
 public:
+	// Attribute locations and buffer bindings a VAO keeps track of, both from 0
+	static constexpr GLuint ATTRIBUTES = 16;
+
 	// ID reference for the Vertex Array Object
-	GLuint ID;
-	// Constructor that generates a VAO ID
+	GLuint ID = 0;
+	// Constructor that generates a VAO ID, created right away with GLExt.directStateAccess
 	VAO();
+	// Deletes the vertex array unless Delete was already called, the context has to still be current
+	~VAO();
+	// A VAO owns its GL object, so it can be moved but not copied
+	VAO(const VAO&) = delete;
+	VAO& operator=(const VAO&) = delete;
+	VAO(VAO&& other) noexcept;
+	VAO& operator=(VAO&& other) noexcept;
+
+	// The calls below change the VAO by name with GLExt.directStateAccess, otherwise it has to be bound first
 
-	// Links a VBO Attribute such as a position or color to the VAO
-	void LinkAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset);
+	// Sets the format of an attribute location, read at an offset of each vertex of a buffer binding
+	// Integer types normalized reach the shader as fractions of their type's range, such as GL_UNSIGNED_SHORT
+	// positions inside a bounding box or GL_INT_2_10_10_10_REV normals
+	void Format(GLuint layout, GLuint numComponents, GLenum type, GLboolean normalized, GLuint relativeOffset, GLuint binding);
+	// A divisor of 1 or more makes a binding advance once per that many instances instead of per vertex
+	void Divisor(GLuint binding, GLuint divisor);
+	// Links a buffer to a binding, its vertices starting at an offset and a stride apart, which has to be the real one
+	// Call it after the formats and divisors of the binding, it is all that changes to draw another buffer or region,
+	// such as a StreamBuffer region whose offset changes every frame
+	void LinkBuffer(GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride);
+	// Links the index buffer the VAO draws with, through GLState
+	void LinkElements(GLuint buffer);
+	// Names the vertex array in GPU captures and debug messages, binds it unless it was created by name since it only becomes an object once bound
+	void Label(const char* name);
 	// Binds the VAO
 	void Bind();
 	// Unbinds the VAO
 	void Unbind();
-	// Deletes the VAO
+	// Deletes the VAO, does nothing if it was already deleted or moved from
 	void Delete();
+private:
+	// Format of an attribute location, remembered for drivers without separate formats, unused with no components
+	struct Attribute
+	{
+		GLuint components = 0;
+		GLenum type = GL_FLOAT;
+		GLboolean normalized = GL_FALSE;
+		GLuint offset = 0;
+		GLuint binding = 0;
+	};
+	Attribute attributes[ATTRIBUTES];
+	GLuint divisors[ATTRIBUTES] = {};
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,27 +1,87 @@
 #include"VBO.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"GLDebugOutput.h"
 
 // Constructor that generates a Vertex Buffer Object and links it to vertices
-VBO::VBO(GLfloat* vertices, GLsizeiptr size)
+VBO::VBO(const GLfloat* vertices, GLsizeiptr size, GLenum usage)
 {
-	glGenBuffers(1, &ID);
-	glBindBuffer(GL_ARRAY_BUFFER, ID);
-	glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+	// Immutable storage keeps Update working on every buffer, the usage only decides where the memory is counted
+	if (GLExt.directStateAccess)
+	{
+		glCreateBuffers(1, &ID);
+		glNamedBufferStorage(ID, size, vertices, GL_DYNAMIC_STORAGE_BIT);
+	}
+	else
+	{
+		glGenBuffers(1, &ID);
+		GLState.BindBuffer(GL_ARRAY_BUFFER, ID);
+		glBufferData(GL_ARRAY_BUFFER, size, vertices, usage);
+	}
+	GpuMemory.Track(usage == GL_STATIC_DRAW ? GPU_MEMORY_GEOMETRY : GPU_MEMORY_STREAMING, GL_BUFFER, ID, size);
+}
+
+// Deletes the buffer unless Delete was already called
+VBO::~VBO()
+{
+	Delete();
+}
+
+// Takes over the buffer of another VBO, which is left empty
+VBO::VBO(VBO&& other) noexcept
+	: ID(other.ID)
+{
+	other.ID = 0;
+}
+
+// Deletes the current buffer and takes over the one of another VBO
+VBO& VBO::operator=(VBO&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
+}
+
+// Overwrites part of the VBO with new data
+void VBO::Update(const GLfloat* vertices, GLsizeiptr size, GLintptr offset)
+{
+	if (GLExt.directStateAccess)
+		glNamedBufferSubData(ID, offset, size, vertices);
+	else
+	{
+		GLState.BindBuffer(GL_ARRAY_BUFFER, ID);
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, vertices);
+	}
+	GLState.CountUpload(size);
+}
+
+// Names the buffer in GPU captures and debug messages
+void VBO::Label(const char* name)
+{
+	GLDebug.Label(GL_BUFFER, ID, name);
 }
 
 // Binds the VBO
 void VBO::Bind()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	GLState.BindBuffer(GL_ARRAY_BUFFER, ID);
 }
 
 // Unbinds the VBO
 void VBO::Unbind()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	GLState.BindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 // Deletes the VBO
 void VBO::Delete()
 {
-	glDeleteBuffers(1, &ID);
-}
\ No newline at end of file
+	if (ID != 0)
+		GLState.DeleteBuffers(1, &ID);
+	ID = 0;
+}
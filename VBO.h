@@ -7,15 +7,27 @@ class VBO
 {
 public:
 	// Reference ID of the Vertex Buffer Object
-	GLuint ID;
+	GLuint ID = 0;
 	// Constructor that generates a Vertex Buffer Object and links it to vertices
-	VBO(GLfloat* vertices, GLsizeiptr size);
+	VBO(const GLfloat* vertices, GLsizeiptr size, GLenum usage = GL_STATIC_DRAW);
+	// Deletes the buffer unless Delete was already called, the context has to still be current
+	~VBO();
+	// A VBO owns its GL object, so it can be moved but not copied
+	VBO(const VBO&) = delete;
+	VBO& operator=(const VBO&) = delete;
+	VBO(VBO&& other) noexcept;
+	VBO& operator=(VBO&& other) noexcept;
 
+	// Overwrites part of the VBO with new data
+	void Update(const GLfloat* vertices, GLsizeiptr size, GLintptr offset = 0);
+
+	// Names the buffer in GPU captures and debug messages
+	void Label(const char* name);
 	// Binds the VBO
 	void Bind();
 	// Unbinds the VBO
 	void Unbind();
-	// Deletes the VBO
+	// Deletes the VBO, does nothing if it was already deleted or moved from
 	void Delete();
 };
 
@@ -0,0 +1,323 @@
+#include"VideoEncoder.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+
+#include<algorithm>
+#include<cctype>
+#include<chrono>
+#include<cstring>
+#include<iostream>
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+static const char* NULL_DEVICE = "NUL";
+static const char* WRITE_MODE = "wb";
+#else
+#include<csignal>
+static const char* NULL_DEVICE = "/dev/null";
+static const char* WRITE_MODE = "w";
+#endif
+
+std::string VideoEncoder::program = "ffmpeg";
+
+// Quotes an argument for the shell popen runs commands with
+static std::string quote(const std::string& arg)
+{
+#ifdef _WIN32
+	return "\"" + arg + "\"";
+#else
+	std::string quoted = "'";
+	for (char c : arg)
+		quoted += c == '\'' ? std::string("'\\''") : std::string(1, c);
+	return quoted + "'";
+#endif
+}
+
+// Closes the video unless Close was already called
+VideoEncoder::~VideoEncoder()
+{
+	Close();
+}
+
+// The encoder is named after the GPU vendor, so the frames are encoded by the GPU that drew them
+std::string VideoEncoder::pick(const std::string& preferred)
+{
+	std::string wanted = preferred;
+	if (wanted == "auto")
+	{
+		std::string vendor = (const char*)glGetString(GL_VENDOR);
+		std::transform(vendor.begin(), vendor.end(), vendor.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+		bool intel = vendor.find("intel") != std::string::npos;
+		bool amd = vendor.find("amd") != std::string::npos || vendor.find("ati ") != std::string::npos;
+		if (vendor.find("nvidia") != std::string::npos)
+			wanted = "nvenc";
+#ifdef _WIN32
+		else if (intel)
+			wanted = "qsv";
+		else if (amd)
+			wanted = "amf";
+#else
+		else if (intel || amd)
+			wanted = "vaapi";
+#endif
+		else
+			wanted = "software";
+	}
+	std::string name = wanted == "software" ? "libx264" : "h264_" + wanted;
+
+	// ffmpeg lists every encoder it was built with, one a line with its name after the flags
+	std::string listed;
+	if (FILE* list = popen((quote(program) + " -hide_banner -encoders 2>" + NULL_DEVICE).c_str(), "r"))
+	{
+		char buffer[4096];
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), list)) > 0)
+			listed.append(buffer, read);
+		pclose(list);
+	}
+	if (name != "libx264" && listed.find(" " + name + " ") == std::string::npos)
+	{
+		std::cerr << "ffmpeg has no " << name << " encoder, encoding the video in software" << std::endl;
+		name = "libx264";
+	}
+	return name;
+}
+
+// Starts ffmpeg and the writer, the GL objects follow once the process runs
+bool VideoEncoder::Open(const std::string& output, GLsizei width, GLsizei height, int fps, const std::string& preferred, float bitrate)
+{
+	this->width = std::max<GLsizei>(2, width & ~1);
+	this->height = std::max<GLsizei>(2, height & ~1);
+	this->fps = std::max(1, fps);
+	encoder = pick(preferred);
+	streaming = output.compare(0, 6, "rtp://") == 0;
+
+	std::string command = quote(program) + " -hide_banner -loglevel error -y";
+	if (encoder == "h264_vaapi")
+		command += " -vaapi_device /dev/dri/renderD128";
+	command += " -f rawvideo -pix_fmt rgba -s " + std::to_string(this->width) + "x" + std::to_string(this->height)
+		+ " -r " + std::to_string(this->fps) + " -i -";
+	// NVENC converts the RGBA it is handed on the GPU, VAAPI and QSV take NV12 surfaces, the rest planar 4:2:0
+	if (encoder == "h264_vaapi")
+		command += " -vf format=nv12,hwupload";
+	else if (encoder == "h264_qsv")
+		command += " -vf format=nv12";
+	else if (encoder != "h264_nvenc")
+		command += " -pix_fmt yuv420p";
+	command += " -c:v " + encoder;
+	if (encoder == "h264_nvenc")
+		command += streaming ? " -preset p1 -tune ull -zerolatency 1" : " -preset p5";
+	else if (encoder == "libx264")
+		command += streaming ? " -preset veryfast -tune zerolatency" : " -preset medium";
+	else if (encoder == "h264_qsv" && streaming)
+		command += " -async_depth 1";
+	if (bitrate > 0.0f)
+		command += " -b:v " + std::to_string((int)(bitrate * 1000.0f)) + "k";
+	// A stream has no B-frames to wait for and a key frame every second for receivers joining late, its SDP describes
+	// it to them
+	if (streaming)
+		command += " -bf 0 -g " + std::to_string(this->fps) + " -an -f rtp -sdp_file video.sdp " + quote(output);
+	else
+		command += " -movflags +faststart " + quote(output);
+
+#ifndef _WIN32
+	// A write to an ffmpeg that quit fails rather than ending the process
+	signal(SIGPIPE, SIG_IGN);
+#endif
+	pipe = popen(command.c_str(), WRITE_MODE);
+	if (!pipe)
+	{
+		std::cerr << "Could not start " << program << " to encode " << output << std::endl;
+		return false;
+	}
+
+	glGenRenderbuffers(1, &color);
+	glBindRenderbuffer(GL_RENDERBUFFER, color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, this->width, this->height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	GpuMemory.Track(GPU_MEMORY_TARGETS, GL_RENDERBUFFER, color, (int64_t)this->width * this->height * 4);
+	GLint previous;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+	GLsizeiptr size = (GLsizeiptr)this->width * this->height * 4;
+	for (Slot& slot : slots)
+	{
+		glGenBuffers(1, &slot.buffer);
+		GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+		GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, slot.buffer, size);
+	}
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	frames.assign(FRAMES, std::vector<uint8_t>((size_t)size));
+	spare.clear();
+	for (size_t i = 0; i < FRAMES; i++)
+		spare.push_back(i);
+	closing = false;
+	writer = std::thread([this]() { run(); });
+	std::cout << "Encoding " << this->width << "x" << this->height << " at " << this->fps << " fps with " << encoder << " into " << output
+		<< (streaming ? ", receivers open video.sdp" : "") << std::endl;
+	return true;
+}
+
+// The blit scales a framebuffer of another size and turns it upside down in one go
+void VideoEncoder::Capture(GLuint source, GLsizei sourceWidth, GLsizei sourceHeight)
+{
+	if (!pipe)
+		return;
+	Slot& slot = slots[next];
+	next = (next + 1) % SLOTS;
+	if (slot.fence)
+		complete(slot, true);
+
+	GLint previousRead, previousDraw;
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previousRead);
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previousDraw);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+	glReadBuffer(source == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+	bool scaled = sourceWidth != width || sourceHeight != height;
+	glBlitFramebuffer(0, 0, sourceWidth, sourceHeight, 0, height, width, 0, GL_COLOR_BUFFER_BIT, scaled ? GL_LINEAR : GL_NEAREST);
+
+	// With a pack buffer bound glReadPixels only queues the copy and returns
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+	glReadBuffer(GL_COLOR_ATTACHMENT0);
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, previousRead);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousDraw);
+	slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+// Oldest first, so the frames reach the writer in order
+void VideoEncoder::Poll()
+{
+	for (int i = 0; i < SLOTS; i++)
+	{
+		Slot& slot = slots[(next + i) % SLOTS];
+		if (!slot.fence)
+			continue;
+		complete(slot, false);
+		// A later read cannot be queued before one still on the GPU
+		if (slot.fence)
+			break;
+	}
+}
+
+// Copies the pixels of a finished read into a free frame
+void VideoEncoder::complete(Slot& slot, bool wait)
+{
+	GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0);
+	while (wait && result == GL_TIMEOUT_EXPIRED)
+		result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+	if (result == GL_TIMEOUT_EXPIRED)
+		return;
+	glDeleteSync(slot.fence);
+	slot.fence = nullptr;
+
+	size_t frame;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (spare.empty() && streaming)
+		{
+			droppedCount++;
+			return;
+		}
+		freed.wait(lock, [&]() { return !spare.empty(); });
+		frame = spare.back();
+		spare.pop_back();
+	}
+	std::vector<uint8_t>& pixels = frames[frame];
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+	void* mapping = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)pixels.size(), GL_MAP_READ_BIT);
+	if (mapping)
+	{
+		std::memcpy(pixels.data(), mapping, pixels.size());
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	std::lock_guard<std::mutex> lock(mutex);
+	if (mapping)
+		queued.push_back(frame);
+	else
+	{
+		spare.push_back(frame);
+		droppedCount++;
+	}
+	wake.notify_one();
+}
+
+// A write blocks while ffmpeg is still encoding earlier frames, the time it takes is what the encoder costs
+void VideoEncoder::run()
+{
+	bool broken = false;
+	for (;;)
+	{
+		size_t frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [&]() { return !queued.empty() || closing; });
+			if (queued.empty())
+				return;
+			frame = queued.front();
+			queued.pop_front();
+		}
+		if (!broken)
+		{
+			auto start = std::chrono::steady_clock::now();
+			broken = fwrite(frames[frame].data(), 1, frames[frame].size(), pipe) != frames[frame].size();
+			lastWrite.store(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+			if (broken)
+				std::cerr << program << " stopped taking frames, the rest of the video is dropped" << std::endl;
+		}
+		if (broken)
+			droppedCount++;
+		else
+			writtenCount++;
+		std::lock_guard<std::mutex> lock(mutex);
+		spare.push_back(frame);
+		freed.notify_one();
+	}
+}
+
+// The reads still on the GPU are waited for, the writer drains the queue before it stops
+void VideoEncoder::Close()
+{
+	if (!pipe)
+		return;
+	for (int i = 0; i < SLOTS; i++)
+	{
+		Slot& slot = slots[(next + i) % SLOTS];
+		if (slot.fence)
+			complete(slot, true);
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	wake.notify_one();
+	writer.join();
+	int status = pclose(pipe);
+	pipe = nullptr;
+	if (status != 0)
+		std::cerr << program << " failed to finish the video" << std::endl;
+
+	for (Slot& slot : slots)
+	{
+		GLState.DeleteBuffers(1, &slot.buffer);
+		slot.buffer = 0;
+	}
+	GpuMemory.Untrack(GL_RENDERBUFFER, color);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &color);
+	framebuffer = color = 0;
+	frames.clear();
+	queued.clear();
+	spare.clear();
+}
@@ -0,0 +1,105 @@
+#ifndef VIDEO_ENCODER_CLASS_H
+#define VIDEO_ENCODER_CLASS_H
+
+#include<glad/glad.h>
+#include<atomic>
+#include<condition_variable>
+#include<cstdint>
+#include<cstdio>
+#include<deque>
+#include<mutex>
+#include<string>
+#include<thread>
+#include<vector>
+
+// Encodes the frames the render thread draws into an H.264 video, an MP4 file or a low latency RTP stream a WebRTC
+// gateway can take up, with the GPU's own encoder where ffmpeg has one for it. Capture blits the final frame into a
+// target of the video's size, flipped so its rows come top first as encoders want them, and starts an asynchronous
+// glReadPixels into a ring of pixel pack buffers like ImageReadback does. Poll copies the finished reads into frames
+// a thread of the encoder's own writes into ffmpeg's standard input in order. A file gets every frame, waiting for
+// a free one when ffmpeg falls behind. A stream drops the frame instead, so latency never builds up.
+class VideoEncoder
+{
+public:
+	// Pixel buffers in the ring, and frames waiting for ffmpeg or being written
+	static constexpr int SLOTS = 3;
+	static constexpr int FRAMES = 4;
+
+	// Program started to encode, found on the PATH unless it has a directory
+	static std::string program;
+
+	// Size and rate of the video, its sides rounded down to even numbers as 4:2:0 chroma needs
+	GLsizei width = 0;
+	GLsizei height = 0;
+	int fps = 0;
+	// ffmpeg encoder the video goes through, such as "h264_nvenc", and whether the output is a stream
+	std::string encoder;
+	bool streaming = false;
+
+	// Constructor, nothing runs until Open
+	VideoEncoder() = default;
+	// Closes the video unless Close was already called, the context has to still be current
+	~VideoEncoder();
+	// A VideoEncoder owns its process, thread and GL objects, so it cannot be copied
+	VideoEncoder(const VideoEncoder&) = delete;
+	VideoEncoder& operator=(const VideoEncoder&) = delete;
+
+	// Starts ffmpeg encoding into output, a path such as "flight.mp4" or a URL such as "rtp://127.0.0.1:5004", with
+	// "auto" picking the GPU's encoder from the GL vendor, or "nvenc", "vaapi", "qsv", "amf" or "software"
+	// bitrate is in Mbit/s, 0 leaves it to the encoder. Needs a current context, false with a message if ffmpeg
+	// cannot be started
+	bool Open(const std::string& output, GLsizei width, GLsizei height, int fps, const std::string& preferred, float bitrate);
+	bool isOpen() const { return pipe != nullptr; }
+
+	// Render thread: blits the color of the source framebuffer of sourceWidth by sourceHeight into the video's target and
+	// starts reading it back
+	void Capture(GLuint source, GLsizei sourceWidth, GLsizei sourceHeight);
+	// Render thread: hands every read the GPU has finished to the writer, waits only for a free frame of a file
+	void Poll();
+
+	// Milliseconds ffmpeg took to take the last frame written, which it only does once it encoded the ones before
+	float encodeMilliseconds() const { return lastWrite.load(std::memory_order_relaxed); }
+	// Frames written to ffmpeg and frames a stream dropped, so far
+	size_t written() const { return writtenCount.load(); }
+	size_t dropped() const { return droppedCount.load(); }
+
+	// Writes the frames still in flight, closes ffmpeg's input and waits for it to finish the file
+	void Close();
+private:
+	// A read in flight, or a free buffer when fence is null
+	struct Slot
+	{
+		GLuint buffer = 0;
+		GLsync fence = nullptr;
+	};
+
+	FILE* pipe = nullptr;
+	// Target of the video's size the frames are blitted into
+	GLuint color = 0;
+	GLuint framebuffer = 0;
+	Slot slots[SLOTS];
+	int next = 0;
+
+	std::thread writer;
+	std::mutex mutex;
+	// Wakes the writer for a frame and the render thread for a free one
+	std::condition_variable wake;
+	std::condition_variable freed;
+	// Frames allocated once, waiting in order to be written and free to be filled
+	std::vector<std::vector<uint8_t>> frames;
+	std::deque<size_t> queued;
+	std::vector<size_t> spare;
+	bool closing = false;
+	std::atomic<float> lastWrite{ 0.0f };
+	std::atomic<size_t> writtenCount{ 0 };
+	std::atomic<size_t> droppedCount{ 0 };
+
+	// Picks the encoder for preferred among those ffmpeg lists, software when it has none for the GPU
+	static std::string pick(const std::string& preferred);
+	// Copies the pixels of a finished read into a free frame and queues it, waiting for the GPU with wait set
+	void complete(Slot& slot, bool wait);
+	// Writer thread: writes the queued frames until Close
+	void run();
+};
+
+#endif
@@ -0,0 +1,430 @@
+#include"ViewportWindow.h"
+#include"CityGenerator.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/matrix_transform.hpp>
+#include<glm/gtc/type_ptr.hpp>
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<iostream>
+#include<utility>
+
+// A record is three texels of the buffer texture
+static_assert(CityGenerator::INSTANCE_FLOATS == 12, "the overview reads a record as three RGBA32F texels");
+// A tile is a bit of a mask
+static_assert(ViewportWindow::GRID * ViewportWindow::GRID <= 64, "the tiles have to fit a uint64_t");
+
+// Unit box placed by the record of the building the instance draws, shaded by the side it is on
+static const char* overviewVertexSource = R"(
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in float aShade;
+layout(location = 2) in uint aBuilding;
+uniform samplerBuffer records;
+uniform mat4 viewProjection;
+out vec3 color;
+void main()
+{
+    int texel = int(aBuilding) * 3;
+    // Translation and scale, then layer and fade, then color and occlusion, see CityGenerator.h
+    vec4 first = texelFetch(records, texel);
+    vec4 second = texelFetch(records, texel + 1);
+    vec4 third = texelFetch(records, texel + 2);
+    color = third.rgb;
+    // A live metric shows from blue to red, as in the main window
+    if (color.r < 0.0) {
+        float ramp = clamp(color.g, 0.0, 1.0) * 4.0;
+        color = clamp(vec3(ramp - 2.0, ramp < 2.0 ? ramp : 4.0 - ramp, 2.0 - ramp), 0.0, 1.0);
+    }
+    color *= aShade;
+    gl_Position = viewProjection * vec4(aPos * vec3(first.w, second.xy) + first.xyz, 1.0);
+}
+)";
+static const char* overviewFragmentSource = R"(
+#version 330 core
+in vec3 color;
+out vec4 FragColor;
+void main()
+{
+    FragColor = vec4(color, 1.0);
+}
+)";
+
+// Full screen triangle over the window, looking up each pixel's point of the city in the map and drawing the camera
+// as an arrow over it, a fixed number of pixels large whatever the zoom
+static const char* mapVertexSource = R"(
+#version 330 core
+void main()
+{
+    gl_Position = vec4(float((gl_VertexID & 1) * 4 - 1), float((gl_VertexID & 2) * 2 - 1), 0.0, 1.0);
+}
+)";
+static const char* mapFragmentSource = R"(
+#version 330 core
+uniform sampler2D map;
+// X and Z of the bottom left corner of the window, then the model units a pixel is wide, the same both ways
+uniform vec4 view;
+// X and Z of the camera, then the direction it looks in
+uniform vec4 marker;
+// X and Z of the map's corner at -X and +Z, then its size
+uniform vec4 mapArea;
+out vec4 FragColor;
+void main()
+{
+    // Up the window is -Z
+    vec2 point = vec2(view.x + gl_FragCoord.x * view.z, view.y - gl_FragCoord.y * view.w);
+    vec2 uv = vec2(point.x - mapArea.x, mapArea.y - point.y) / mapArea.zw;
+    vec3 color = texture(map, uv).rgb;
+    // Around the city is the color the empty map is cleared to
+    if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))
+        color = vec3(0.12, 0.13, 0.15);
+    // The arrow in pixels, along the direction and across it
+    vec2 offset = (point - marker.xy) / view.z;
+    float along = dot(offset, marker.zw);
+    float across = abs(marker.z * offset.y - marker.w * offset.x);
+    if (along > -6.0 && along < 10.0 && across < (10.0 - along) * 0.5)
+        color = vec3(1.0, 0.85, 0.1);
+    FragColor = vec4(color, 1.0);
+}
+)";
+
+// Adds the four corners of a face of the unit box as two triangles, each vertex a position and a shade
+static void addFace(std::vector<GLfloat>& vertices, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d, float shade)
+{
+	for (const glm::vec3& corner : { a, b, c, a, c, d })
+	{
+		vertices.insert(vertices.end(), { corner.x, corner.y, corner.z });
+		vertices.push_back(shade);
+	}
+}
+
+// Constructor that makes the window in the share group of share
+ViewportWindow::ViewportWindow(GLFWwindow* share, const char* title, int width, int height)
+{
+	window = glfwCreateWindow(width, height, title, nullptr, share);
+	if (!window)
+	{
+		std::cerr << "ERROR::VIEWPORT_WINDOW::CREATE_FAILED" << std::endl;
+		return;
+	}
+	glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+	glfwSetWindowUserPointer(window, this);
+	glfwSetScrollCallback(window, scrollCallback);
+	glfwSetFramebufferSizeCallback(window, resizeCallback);
+}
+
+// Stops the thread and destroys the window unless Delete was already called
+ViewportWindow::~ViewportWindow()
+{
+	Delete();
+}
+
+// Every tile starts out to be drawn, the records are fenced like any later change
+void ViewportWindow::Start(GLuint records, const BoundingBoxes& bounds, float span, float top)
+{
+	if (!window || thread.joinable())
+		return;
+	ViewportWindow::records = records;
+	ViewportWindow::bounds = &bounds;
+	ViewportWindow::span = span;
+	ViewportWindow::top = top;
+	visible.resize(bounds.size());
+	// A square map over the footprint of the city, the tiles a building's footprint touches are drawn again with it
+	mapMin = glm::vec2(0.0f);
+	mapMax = glm::vec2(0.0f);
+	if (bounds.size() > 0)
+	{
+		mapMin = glm::vec2(*std::min_element(bounds.minX.begin(), bounds.minX.end()), *std::min_element(bounds.minZ.begin(), bounds.minZ.end()));
+		mapMax = glm::vec2(*std::max_element(bounds.maxX.begin(), bounds.maxX.end()), *std::max_element(bounds.maxZ.begin(), bounds.maxZ.end()));
+	}
+	float side = std::max(std::max(mapMax.x - mapMin.x, mapMax.y - mapMin.y), 1.0f);
+	glm::vec2 center = 0.5f * (mapMin + mapMax);
+	mapMin = center - 0.5f * side;
+	mapMax = center + 0.5f * side;
+	float tileSide = side / (float)GRID;
+	buildingTiles.resize(bounds.size());
+	for (size_t i = 0; i < bounds.size(); i++)
+	{
+		// Columns count from -X, rows from +Z
+		int firstColumn = std::clamp((int)((bounds.minX[i] - mapMin.x) / tileSide), 0, GRID - 1);
+		int lastColumn = std::clamp((int)((bounds.maxX[i] - mapMin.x) / tileSide), 0, GRID - 1);
+		int firstRow = std::clamp((int)((mapMax.y - bounds.maxZ[i]) / tileSide), 0, GRID - 1);
+		int lastRow = std::clamp((int)((mapMax.y - bounds.minZ[i]) / tileSide), 0, GRID - 1);
+		uint64_t tiles = 0;
+		for (int row = firstRow; row <= lastRow; row++)
+			for (int column = firstColumn; column <= lastColumn; column++)
+				tiles |= 1ull << (row * GRID + column);
+		buildingTiles[i] = tiles;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		dirtyTiles = ~0ull;
+	}
+	RecordsChanged({});
+	thread = std::thread(&ViewportWindow::render, this);
+}
+
+// Only a camera that moved or turned asks for another frame
+void ViewportWindow::Follow(const glm::vec3& point, const glm::vec3& front)
+{
+	glm::vec2 heading(front.x, front.z);
+	heading = glm::length(heading) > 1e-6f ? glm::normalize(heading) : glm::vec2(0.0f, -1.0f);
+	std::lock_guard<std::mutex> lock(mutex);
+	if (point == focus && heading == direction)
+		return;
+	focus = point;
+	direction = heading;
+	dirty = true;
+	changed.notify_one();
+}
+
+// Fences are shared by the contexts of a group, a later fence covers the commands of the one it replaces
+void ViewportWindow::RecordsChanged(const std::vector<InstanceRecords::Range>& ranges)
+{
+	uint64_t tiles = 0;
+	for (const InstanceRecords::Range& range : ranges)
+		for (uint32_t i = range.first; i < range.first + range.count && i < buildingTiles.size(); i++)
+			tiles |= buildingTiles[i];
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	// The other context only sees the fence once the commands up to it were sent
+	glFlush();
+	std::lock_guard<std::mutex> lock(mutex);
+	if (recordsFence)
+		glDeleteSync(recordsFence);
+	recordsFence = fence;
+	dirtyTiles |= tiles;
+	dirty = true;
+	changed.notify_one();
+}
+
+void ViewportWindow::HideIfClosed()
+{
+	if (!window || hidden || !glfwWindowShouldClose(window))
+		return;
+	glfwHideWindow(window);
+	hidden = true;
+}
+
+void ViewportWindow::render()
+{
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(1);
+
+	GLuint boxProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, overviewVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, overviewFragmentSource, "FRAGMENT") });
+	glUseProgram(boxProgram);
+	glUniform1i(glGetUniformLocation(boxProgram, "records"), 0);
+	GLint viewProjectionLocation = glGetUniformLocation(boxProgram, "viewProjection");
+	GLuint mapProgram = Shader::LinkProgram({
+		Shader::CompileStage(GL_VERTEX_SHADER, mapVertexSource, "VERTEX"),
+		Shader::CompileStage(GL_FRAGMENT_SHADER, mapFragmentSource, "FRAGMENT") });
+	glUseProgram(mapProgram);
+	glUniform1i(glGetUniformLocation(mapProgram, "map"), 1);
+	GLint viewLocation = glGetUniformLocation(mapProgram, "view");
+	GLint markerLocation = glGetUniformLocation(mapProgram, "marker");
+	GLint mapAreaLocation = glGetUniformLocation(mapProgram, "mapArea");
+
+	// The records are read where the main context keeps them, only the texture over them is this thread's
+	GLuint recordTexture;
+	glGenTextures(1, &recordTexture);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, recordTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, records);
+
+	// The map of the whole city, mipmapped since the window usually shows more of it than it has pixels for
+	const GLsizei mapPixels = GRID * TILE_PIXELS;
+	GLuint mapTexture, mapDepth, mapFramebuffer;
+	glGenTextures(1, &mapTexture);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, mapTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, mapPixels, mapPixels, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glActiveTexture(GL_TEXTURE0);
+	glGenRenderbuffers(1, &mapDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, mapDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mapPixels, mapPixels);
+	glGenFramebuffers(1, &mapFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, mapFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mapTexture, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mapDepth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cerr << "ERROR::VIEWPORT_WINDOW::FRAMEBUFFER_INCOMPLETE" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	std::vector<GLfloat> box;
+	addFace(box, { 0, 1, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 1, 0 }, 1.0f);
+	addFace(box, { 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 }, 0.8f);
+	addFace(box, { 0, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 1, 0, 0 }, 0.8f);
+	addFace(box, { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 1 }, { 0, 1, 0 }, 0.65f);
+	addFace(box, { 1, 0, 0 }, { 1, 1, 0 }, { 1, 1, 1 }, { 1, 0, 1 }, 0.65f);
+	GLuint vertexArrays[2], buffers[2];
+	glGenVertexArrays(2, vertexArrays);
+	glGenBuffers(2, buffers);
+	glBindVertexArray(vertexArrays[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(box.size() * sizeof(GLfloat)), box.data(), GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (void*)0);
+	glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	// The culled buildings, one index per instance
+	glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+	glVertexAttribIPointer(2, 1, GL_UNSIGNED_INT, sizeof(uint32_t), (void*)0);
+	glVertexAttribDivisor(2, 1);
+	glEnableVertexAttribArray(2);
+	glClearColor(0.12f, 0.13f, 0.15f, 1.0f);
+
+	// The lowest foot, so the far plane is below every building
+	float bottom = 0.0f;
+	for (float y : bounds->minY)
+		bottom = std::min(bottom, y);
+	glm::vec2 tileSize = (mapMax - mapMin) / (float)GRID;
+	// Tiles still to draw, taken from the requests of the other threads
+	uint64_t pending = 0;
+	while (!stopping && !glfwWindowShouldClose(window))
+	{
+		glm::vec3 point;
+		glm::vec2 heading;
+		float viewSpan;
+		int width, height;
+		GLsync fence;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			// Wakes now and then without a change, to see a request to close, unless tiles are left from the last frame
+			if (pending == 0 && !changed.wait_for(lock, std::chrono::milliseconds(100), [&]() { return dirty || stopping; }))
+				continue;
+			if (stopping)
+				continue;
+			point = focus;
+			heading = direction;
+			viewSpan = span;
+			width = framebufferWidth;
+			height = framebufferHeight;
+			fence = std::exchange(recordsFence, nullptr);
+			pending |= std::exchange(dirtyTiles, 0);
+			dirty = false;
+		}
+		if (fence)
+		{
+			glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fence);
+		}
+
+		// A few of the changed tiles a frame, each only draws the buildings over it
+		if (pending != 0)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, mapFramebuffer);
+			glEnable(GL_DEPTH_TEST);
+			glEnable(GL_SCISSOR_TEST);
+			glUseProgram(boxProgram);
+			glBindVertexArray(vertexArrays[0]);
+			// Bound again, which is what makes the other context's writes to the records visible here
+			glBindTexture(GL_TEXTURE_BUFFER, recordTexture);
+			for (int drawn = 0; drawn < TILES_PER_FRAME && pending != 0; drawn++)
+			{
+				int tile = 0;
+				while (!(pending & (1ull << tile)))
+					tile++;
+				pending &= ~(1ull << tile);
+				int column = tile % GRID, row = tile / GRID;
+				// Rows go from the far edge of the map, +Z, towards -Z, up the texture as up the window
+				float left = mapMin.x + column * tileSize.x;
+				float farEdge = mapMax.y - row * tileSize.y;
+				glm::mat4 viewProjection = glm::ortho(left, left + tileSize.x, -farEdge, -farEdge + tileSize.y, 0.0f, top + 2.0f - bottom)
+					* glm::lookAt(glm::vec3(0.0f, top + 1.0f, 0.0f), glm::vec3(0.0f, bottom, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+				Frustum frustum;
+				frustum.Extract(viewProjection);
+				size_t count = frustum.Cull(*bounds, visible.data());
+				glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+				glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(count * sizeof(uint32_t)), visible.data(), GL_STREAM_DRAW);
+				glViewport(column * TILE_PIXELS, row * TILE_PIXELS, TILE_PIXELS, TILE_PIXELS);
+				glScissor(column * TILE_PIXELS, row * TILE_PIXELS, TILE_PIXELS, TILE_PIXELS);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				glUniformMatrix4fv(viewProjectionLocation, 1, GL_FALSE, glm::value_ptr(viewProjection));
+				glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)(box.size() / 4), (GLsizei)count);
+			}
+			glDisable(GL_SCISSOR_TEST);
+			glDisable(GL_DEPTH_TEST);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glActiveTexture(GL_TEXTURE1);
+			glGenerateMipmap(GL_TEXTURE_2D);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		// Minimized, nothing to draw into until the next size
+		if (width == 0 || height == 0)
+			continue;
+
+		// The window shows the map around the point, the marker on top of it, one triangle for both
+		float halfHeight = 0.5f * viewSpan;
+		float halfWidth = halfHeight * (float)width / (float)height;
+		glViewport(0, 0, width, height);
+		glUseProgram(mapProgram);
+		glUniform4f(viewLocation, point.x - halfWidth, point.z + halfHeight, 2.0f * halfWidth / (float)width, 2.0f * halfHeight / (float)height);
+		glUniform4f(markerLocation, point.x, point.z, heading.x, heading.y);
+		glUniform4f(mapAreaLocation, mapMin.x, mapMax.y, mapMax.x - mapMin.x, mapMax.y - mapMin.y);
+		glBindVertexArray(vertexArrays[1]);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glfwSwapBuffers(window);
+	}
+
+	glDeleteVertexArrays(2, vertexArrays);
+	glDeleteBuffers(2, buffers);
+	glDeleteFramebuffers(1, &mapFramebuffer);
+	glDeleteRenderbuffers(1, &mapDepth);
+	glDeleteTextures(1, &mapTexture);
+	glDeleteTextures(1, &recordTexture);
+	glDeleteProgram(boxProgram);
+	glDeleteProgram(mapProgram);
+	glfwMakeContextCurrent(nullptr);
+}
+
+// Runs on the main thread inside glfwPollEvents, a notch zooms by a tenth
+void ViewportWindow::scrollCallback(GLFWwindow* window, double /*x*/, double y)
+{
+	ViewportWindow* viewport = (ViewportWindow*)glfwGetWindowUserPointer(window);
+	std::lock_guard<std::mutex> lock(viewport->mutex);
+	viewport->span = std::max(viewport->span * std::pow(0.9f, (float)y), 1.0f);
+	viewport->dirty = true;
+	viewport->changed.notify_one();
+}
+
+// Runs on the main thread inside glfwPollEvents
+void ViewportWindow::resizeCallback(GLFWwindow* window, int width, int height)
+{
+	ViewportWindow* viewport = (ViewportWindow*)glfwGetWindowUserPointer(window);
+	std::lock_guard<std::mutex> lock(viewport->mutex);
+	viewport->framebufferWidth = width;
+	viewport->framebufferHeight = height;
+	viewport->dirty = true;
+	viewport->changed.notify_one();
+}
+
+// Stops the thread and destroys the window, a context of the group has to be current for the last fence
+void ViewportWindow::Delete()
+{
+	if (thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		changed.notify_one();
+		thread.join();
+	}
+	if (recordsFence)
+	{
+		glDeleteSync(recordsFence);
+		recordsFence = nullptr;
+	}
+	if (window)
+	{
+		glfwDestroyWindow(window);
+		window = nullptr;
+	}
+}
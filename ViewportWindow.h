@@ -0,0 +1,100 @@
+#ifndef VIEWPORT_WINDOW_CLASS_H
+#define VIEWPORT_WINDOW_CLASS_H
+
+#include<glad/glad.h>
+#include<GLFW/glfw3.h>
+#include<glm/glm.hpp>
+#include<atomic>
+#include<condition_variable>
+#include<cstdint>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+#include"Frustum.h"
+#include"InstanceRecords.h"
+
+// A second window that shows the city from above, such as an overview map beside the street view on another display
+// Its context is in the share group of the main one, so it draws from the building records the main context uploaded
+// instead of a copy, read through a buffer texture. Everything else it makes itself, vertex arrays and framebuffers
+// are not shared. It renders on a thread of its own with its own swap interval, so neither window's vsync holds up the
+// other, and it has its own camera, looking straight down at the point it follows.
+// The city is drawn once into a map texture of GRID by GRID tiles, each culled on its own, and a tile is only drawn
+// again when the records of a building over it changed, a few tiles a frame. A frame of the window is then a single
+// triangle that looks the map up around the point and puts an arrow where the camera is, and it is only drawn when
+// the camera, the map, the zoom or the size changed. The scroll wheel zooms it.
+// GLFW only allows windows to be made, shown and destroyed on the main thread, the constructor, HideIfClosed and
+// Delete have to be called there, Follow and RecordsChanged from any thread.
+class ViewportWindow
+{
+public:
+	// The window, nullptr if it could not be made
+	GLFWwindow* window = nullptr;
+
+	// Constructor that makes the window, sharing the objects of the context of share, which has to be current
+	ViewportWindow(GLFWwindow* share, const char* title, int width, int height);
+	// Stops the thread and destroys the window unless Delete was already called
+	~ViewportWindow();
+	// The thread points back at the window, so it can be neither copied nor moved
+	ViewportWindow(const ViewportWindow&) = delete;
+	ViewportWindow& operator=(const ViewportWindow&) = delete;
+
+	// Tiles of the map along each side, and the pixels of a tile along each side
+	static constexpr int GRID = 8;
+	static constexpr GLsizei TILE_PIXELS = 256;
+	// Most tiles drawn in one frame, a change to every building takes GRID * GRID / TILES_PER_FRAME frames to show
+	static constexpr int TILES_PER_FRAME = 4;
+
+	// Starts the thread drawing the boxes of bounds colored by records, a buffer of CityGenerator's instance records
+	// in the same order, which has to outlive the thread. span is the width in model units seen at first and top the
+	// height of the highest roof. The context of the main window has to be current, it wrote the records
+	void Start(GLuint records, const BoundingBoxes& bounds, float span, float top);
+	// Centers the view on a point in model space, the camera of the main window, whose arrow points along front
+	void Follow(const glm::vec3& point, const glm::vec3& front);
+	// Fences the commands that wrote the records so far in the calling thread's context, the thread waits for them
+	// before it draws again, and has the tiles under the buildings of the ranges drawn again
+	void RecordsChanged(const std::vector<InstanceRecords::Range>& ranges);
+	// Hides the window once it was asked to close, the thread has stopped drawing it by then
+	void HideIfClosed();
+
+	// Stops the thread, deleting its GL objects, and destroys the window, does nothing if that was already done
+	void Delete();
+private:
+	std::thread thread;
+	std::atomic<bool> stopping{ false };
+	bool hidden = false;
+	const BoundingBoxes* bounds = nullptr;
+	GLuint records = 0;
+	float top = 0.0f;
+
+	// Guards what the other threads hand over, the thread waits on changed until there is something to draw
+	std::mutex mutex;
+	std::condition_variable changed;
+	glm::vec3 focus = glm::vec3(0.0f);
+	glm::vec2 direction = glm::vec2(0.0f, -1.0f);
+	float span = 1.0f;
+	// Size of the framebuffer, which only the main thread may ask GLFW for
+	int framebufferWidth = 0;
+	int framebufferHeight = 0;
+	// Fence of the last records written, nullptr once the thread waited for it
+	GLsync recordsFence = nullptr;
+	bool dirty = true;
+	// Tiles to draw again, bit row * GRID + column
+	uint64_t dirtyTiles = 0;
+
+	// Corners of the map in X and Z, the -X and -Z one and the +X and +Z one
+	glm::vec2 mapMin = glm::vec2(0.0f);
+	glm::vec2 mapMax = glm::vec2(0.0f);
+	// Tiles each building's footprint touches
+	std::vector<uint64_t> buildingTiles;
+
+	// Buildings left by the thread's culling
+	std::vector<uint32_t> visible;
+
+	// Loop of the thread, the window's context is current on it for its whole life
+	void render();
+	static void scrollCallback(GLFWwindow* window, double x, double y);
+	static void resizeCallback(GLFWwindow* window, int width, int height);
+};
+
+#endif
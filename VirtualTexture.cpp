@@ -0,0 +1,507 @@
+#include"VirtualTexture.h"
+
+#include"GLDebugOutput.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"LogQueue.h"
+#include"TextureCooker.h"
+#include"TraceRecorder.h"
+
+#include<stb/stb_image.h>
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<functional>
+#include<iostream>
+#include<utility>
+
+const char VirtualTexture::MAGIC[4] = { 'N', 'Y', 'V', 'T' };
+
+// Feedback texels no page was asked for in, the clear value
+static const uint32_t NO_REQUEST = UINT32_MAX;
+// Entries no page is resident for yet, their level is past every level
+static const uint32_t NO_ENTRY = 0xFFu << 16;
+
+// Level an indirection entry points at
+static uint32_t entryLevel(uint32_t entry)
+{
+	return (entry >> 16) & 0xFF;
+}
+
+// Constructor, nothing is loaded until Open
+VirtualTexture::VirtualTexture(JobSystem& jobs)
+	: jobs(jobs)
+{
+}
+
+// Waits for the loads unless Delete was already called
+VirtualTexture::~VirtualTexture()
+{
+	Delete();
+}
+
+// Pages a side of a level
+uint32_t VirtualTexture::PagesPerSide(const Header& header, uint32_t level)
+{
+	return std::max(1u, (header.slotsPerSide * header.slotSize >> level) / header.pageSize);
+}
+
+// Index in the file of a page, after every page of the finer levels
+uint32_t VirtualTexture::PageIndex(const Header& header, uint32_t level, uint32_t x, uint32_t y)
+{
+	uint32_t index = 0;
+	for (uint32_t finer = 0; finer < level; finer++)
+		index += PagesPerSide(header, finer) * PagesPerSide(header, finer);
+	return index + y * PagesPerSide(header, level) + x;
+}
+
+// Maps the file, checks its layout and creates the textures with the coarsest page resident
+bool VirtualTexture::Open(const std::string& path, int64_t cacheBytes)
+{
+	if (!GLExt.computeShader)
+	{
+		std::cerr << "ERROR::VIRTUAL_TEXTURE::NEEDS_GL_4_3 the feedback is written with image stores" << std::endl;
+		return false;
+	}
+	// Pages are read in whatever order the view asks for them
+	if (!file.Open(path, false) || file.size() < sizeof(Header))
+	{
+		std::cerr << "ERROR::VIRTUAL_TEXTURE::FILE_NOT_READ " << path << std::endl;
+		return false;
+	}
+	std::memcpy(&header, file.data(), sizeof(Header));
+	bool valid = std::memcmp(header.magic, MAGIC, 4) == 0 && header.pageSize == PAGE_SIZE && header.border == BORDER
+		&& header.levels > 0 && header.levels <= 15 && header.images > 0 && header.slotsPerSide > 0
+		&& (uint64_t)header.slotsPerSide * header.slotSize == (uint64_t)PAGE_SIZE << (header.levels - 1)
+		&& PagesPerSide(header, 0) <= (1u << 14) && header.pageCount == PageIndex(header, header.levels, 0, 0);
+	size_t tableEnd = sizeof(Header) + ((size_t)header.pageCount + 1) * sizeof(uint64_t);
+	valid = valid && file.size() >= tableEnd;
+	if (valid)
+	{
+		offsets = (const uint64_t*)(file.data() + sizeof(Header));
+		valid = offsets[header.pageCount] <= file.size();
+		for (uint32_t i = 0; valid && i < header.pageCount; i++)
+			valid = offsets[i] >= tableEnd && offsets[i] <= offsets[i + 1];
+	}
+	if (!valid)
+	{
+		std::cerr << "ERROR::VIRTUAL_TEXTURE::NOT_A_VIRTUAL_TEXTURE " << path << std::endl;
+		file.Close();
+		offsets = nullptr;
+		return false;
+	}
+
+	// The cache is as many pages a side as fit the budget, a page's place in it has to fit the indirection's 8 bits
+	pageTexels = PAGE_SIZE + 2 * BORDER;
+	cacheFormat = GLExt.textureS3TC ? GL_COMPRESSED_RGBA_S3TC_DXT1_EXT : GL_RGBA8;
+	int64_t pageBytes = GpuMemoryTracker::ImageBytes(cacheFormat, pageTexels, pageTexels, 1, 1);
+	GLint maxSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+	cacheSide = (int)std::sqrt((double)std::max<int64_t>(cacheBytes / pageBytes, 1));
+	cacheSide = std::max(2, std::min({ cacheSide, 256, (int)maxSize / pageTexels }));
+	slots.assign((size_t)cacheSide * cacheSide, Slot());
+
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	glGenTextures(1, &cache);
+	GLState.BindTexture(GL_TEXTURE_2D, cache);
+	GLsizei cacheTexels = cacheSide * pageTexels;
+	if (GLExt.textureStorage)
+		glTexStorage2D(GL_TEXTURE_2D, 1, cacheFormat, cacheTexels, cacheTexels);
+	else
+		glTexImage2D(GL_TEXTURE_2D, 0, cacheFormat, cacheTexels, cacheTexels, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, cache, pageBytes * (int64_t)slots.size());
+	GLDebug.Label(GL_TEXTURE, cache, "virtual texture cache");
+
+	// Integer texels are never filtered, every level is fetched by its own texel
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + 1);
+	glGenTextures(1, &indirection);
+	GLState.BindTexture(GL_TEXTURE_2D, indirection);
+	entries.resize(header.levels);
+	dirtyLevels.assign(header.levels, true);
+	int64_t indirectionBytes = 0;
+	for (uint32_t level = 0; level < header.levels; level++)
+	{
+		GLsizei side = (GLsizei)PagesPerSide(header, level);
+		entries[level].assign((size_t)side * side, NO_ENTRY);
+		glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGBA8UI, side, side, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+		indirectionBytes += (int64_t)side * side * 4;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)header.levels - 1);
+	GpuMemory.Track(GPU_MEMORY_TEXTURES, GL_TEXTURE, indirection, indirectionBytes);
+	GLDebug.Label(GL_TEXTURE, indirection, "virtual texture indirection");
+	GLState.ActiveTexture(GL_TEXTURE0);
+
+	// Every lookup ends at the coarsest page, so it is there before the first frame and stays
+	Loaded top = load(PageKey(header.levels - 1, 0, 0));
+	if (top.texels.empty() || !upload(top))
+	{
+		std::cerr << "ERROR::VIRTUAL_TEXTURE::COARSEST_PAGE_NOT_READ " << path << std::endl;
+		Delete();
+		return false;
+	}
+	slots[resident.begin()->second].lastUsed = UINT32_MAX;
+	Update();
+	std::cout << "Virtual texture " << path << ": " << header.images << " images of " << header.slotSize << " texels, "
+		<< header.pageCount << " pages in " << header.levels << " levels, cache of " << slots.size() << " pages" << std::endl;
+	return true;
+}
+
+// Points the program's samplers at the units and gives it the layout
+void VirtualTexture::Apply(GLuint program)
+{
+	glUniform1i(glGetUniformLocation(program, "virtualCache"), TEXTURE_UNIT);
+	glUniform1i(glGetUniformLocation(program, "virtualIndirection"), TEXTURE_UNIT + 1);
+	glUniform4f(glGetUniformLocation(program, "virtualLayout"), (float)header.slotsPerSide, (float)header.slotSize, (float)header.images, (float)header.levels);
+	float cacheTexels = (float)(cacheSide * pageTexels);
+	glUniform4f(glGetUniformLocation(program, "virtualPages"), (float)PAGE_SIZE, (float)BORDER, cacheTexels, cacheTexels);
+	GLState.CountUniforms(4);
+}
+
+// Sizes the feedback and binds everything the program samples and writes
+void VirtualTexture::Bind(GLuint program, GLsizei width, GLsizei height, uint64_t frameIndex)
+{
+	if (!cache)
+		return;
+	GLsizei wide = std::max(1, (width + FEEDBACK_SCALE - 1) / FEEDBACK_SCALE);
+	GLsizei high = std::max(1, (height + FEEDBACK_SCALE - 1) / FEEDBACK_SCALE);
+	if (wide != feedbackWidth || high != feedbackHeight)
+	{
+		// Reads in flight keep their own size, only the image is made again
+		if (feedback != 0)
+			GLState.DeleteTextures(1, &feedback);
+		glGenTextures(1, &feedback);
+		GLState.BindTexture(GL_TEXTURE_2D, feedback);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, wide, high, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		GLState.BindTexture(GL_TEXTURE_2D, 0);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, feedback, (int64_t)wide * high * 4);
+		GLDebug.Label(GL_TEXTURE, feedback, "virtual texture feedback");
+		if (feedbackFramebuffer == 0)
+			glGenFramebuffers(1, &feedbackFramebuffer);
+		GLint previous;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, feedbackFramebuffer);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedback, 0);
+		const GLuint none[4] = { NO_REQUEST, NO_REQUEST, NO_REQUEST, NO_REQUEST };
+		glClearBufferuiv(GL_COLOR, 0, none);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+		feedbackWidth = wide;
+		feedbackHeight = high;
+	}
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, cache);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + 1);
+	GLState.BindTexture(GL_TEXTURE_2D, indirection);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	glBindImageTexture(IMAGE_UNIT, feedback, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+	// Frames go through the 64 pixels of a block in a scattered order, 3 and 5 are odd so every pixel comes up once
+	int turn = (int)(frameIndex & 63);
+	glUniform2i(glGetUniformLocation(program, "virtualCell"), (turn * 3) & 7, ((turn >> 3) * 5 + turn) & 7);
+	GLState.CountUniforms(1);
+}
+
+// Reads the feedback back, requests its pages and fills the cache
+void VirtualTexture::Update()
+{
+	if (!cache)
+		return;
+	frame++;
+	if (feedback != 0)
+	{
+		// Skips this frame's feedback rather than wait when every buffer is still in flight
+		Readback& readback = readbacks[nextReadback];
+		if (!readback.fence)
+		{
+			nextReadback = (nextReadback + 1) % READBACKS;
+			readback.width = feedbackWidth;
+			readback.height = feedbackHeight;
+			GLsizeiptr size = (GLsizeiptr)feedbackWidth * feedbackHeight * sizeof(uint32_t);
+			if (readback.buffer == 0)
+				glGenBuffers(1, &readback.buffer);
+			GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+			if (size > readback.capacity)
+			{
+				glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+				GpuMemory.Track(GPU_MEMORY_STREAMING, GL_BUFFER, readback.buffer, size);
+				readback.capacity = size;
+			}
+			// The image stores of the scene have to land before the framebuffer reads and clears the image
+			glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+			GLint previous;
+			glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, feedbackFramebuffer);
+			glReadBuffer(GL_COLOR_ATTACHMENT0);
+			glPixelStorei(GL_PACK_ALIGNMENT, 4);
+			glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+			GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		}
+		GLint previous;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, feedbackFramebuffer);
+		const GLuint none[4] = { NO_REQUEST, NO_REQUEST, NO_REQUEST, NO_REQUEST };
+		glClearBufferuiv(GL_COLOR, 0, none);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous);
+	}
+
+	// Oldest read first, coarse pages before fine ones since the keys start with the level
+	for (int i = 0; i < READBACKS; i++)
+	{
+		Readback& readback = readbacks[(nextReadback + i) % READBACKS];
+		if (readback.fence)
+		{
+			complete(readback, false);
+			if (!readback.fence)
+				missing = false;
+		}
+	}
+	std::sort(requests.begin(), requests.end(), std::greater<uint32_t>());
+	requests.erase(std::unique(requests.begin(), requests.end()), requests.end());
+	for (uint32_t key : requests)
+		request(key);
+	requests.clear();
+
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		for (Loaded& page : finished)
+			ready.push_back(std::move(page));
+		finished.clear();
+	}
+	size_t taken = 0;
+	size_t uploads = 0;
+	for (; taken < ready.size() && uploads < UPLOADS_PER_FRAME; taken++)
+	{
+		const Loaded& page = ready[taken];
+		if (page.texels.empty())
+		{
+			unreadable.insert(page.key);
+			loading.erase(page.key);
+			LOG_MESSAGE(LOG_WARNING, "Virtual texture page %08x could not be read", page.key);
+			continue;
+		}
+		// Every slot holds a page of this frame, the rest waits for the next one
+		if (!upload(page))
+			break;
+		loading.erase(page.key);
+		uploads++;
+	}
+	ready.erase(ready.begin(), ready.begin() + taken);
+
+	bool dirty = false;
+	for (uint32_t level = 0; level < header.levels; level++)
+		dirty = dirty || dirtyLevels[level];
+	if (!dirty)
+		return;
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT + 1);
+	GLState.BindTexture(GL_TEXTURE_2D, indirection);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	for (uint32_t level = 0; level < header.levels; level++)
+	{
+		if (!dirtyLevels[level])
+			continue;
+		GLsizei side = (GLsizei)PagesPerSide(header, level);
+		glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, side, side, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, entries[level].data());
+		GLState.CountUpload(entries[level].size() * sizeof(uint32_t));
+		dirtyLevels[level] = false;
+	}
+	GLState.ActiveTexture(GL_TEXTURE0);
+}
+
+// Checks if the feedback found every page it asked for and none is loading
+bool VirtualTexture::settled() const
+{
+	return loading.empty() && (!missing || feedback == 0);
+}
+
+// Waits for the loads and deletes the textures
+void VirtualTexture::Delete()
+{
+	jobs.Wait(loads);
+	finished.clear();
+	ready.clear();
+	loading.clear();
+	resident.clear();
+	for (Readback& readback : readbacks)
+	{
+		if (readback.fence)
+			glDeleteSync(readback.fence);
+		readback.fence = nullptr;
+		if (readback.buffer != 0)
+			GLState.DeleteBuffers(1, &readback.buffer);
+		readback.capacity = 0;
+	}
+	if (feedbackFramebuffer != 0)
+		glDeleteFramebuffers(1, &feedbackFramebuffer);
+	feedbackFramebuffer = 0;
+	for (GLuint* texture : { &cache, &indirection, &feedback })
+	{
+		if (*texture != 0)
+			GLState.DeleteTextures(1, texture);
+		*texture = 0;
+	}
+	feedbackWidth = feedbackHeight = 0;
+	file.Close();
+	offsets = nullptr;
+}
+
+// Decodes a page bottom row first as the cache is laid out, and compresses it like the cache is
+VirtualTexture::Loaded VirtualTexture::load(uint32_t key) const
+{
+	TraceScope trace("virtual texture page", "job");
+	Loaded page;
+	page.key = key;
+	uint32_t index = PageIndex(header, key >> 28, key & 0x3FFF, (key >> 14) & 0x3FFF);
+	stbi_set_flip_vertically_on_load_thread(1);
+	int width, height, channels;
+	unsigned char* pixels = stbi_load_from_memory(file.data() + offsets[index], (int)(offsets[index + 1] - offsets[index]), &width, &height, &channels, 4);
+	if (!pixels)
+		return page;
+	if (width == pageTexels && height == pageTexels)
+	{
+		if (cacheFormat == GL_RGBA8)
+			page.texels.assign(pixels, pixels + (size_t)width * height * 4);
+		else
+		{
+			page.texels.resize((size_t)(width / 4) * (height / 4) * 8);
+			TextureCooker::EncodeBC1(pixels, width, height, page.texels.data());
+		}
+	}
+	stbi_image_free(pixels);
+	return page;
+}
+
+// Collects the pages a finished read asks for
+void VirtualTexture::complete(Readback& readback, bool wait)
+{
+	GLenum result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000 : 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+		return;
+	glDeleteSync(readback.fence);
+	readback.fence = nullptr;
+	size_t count = (size_t)readback.width * readback.height;
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+	const uint32_t* keys = (const uint32_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)(count * sizeof(uint32_t)), GL_MAP_READ_BIT);
+	if (keys)
+	{
+		for (size_t i = 0; i < count; i++)
+			if (keys[i] != NO_REQUEST)
+				requests.push_back(keys[i]);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	GLState.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+// Marks the page and its ancestors used, coarsest first so a page never loads before what stands in for it
+void VirtualTexture::request(uint32_t key)
+{
+	uint32_t level = key >> 28, x = key & 0x3FFF, y = (key >> 14) & 0x3FFF;
+	if (level >= header.levels || x >= PagesPerSide(header, level) || y >= PagesPerSide(header, level))
+		return;
+	for (uint32_t ancestor = header.levels; ancestor-- > level;)
+	{
+		uint32_t shift = ancestor - level;
+		uint32_t page = PageKey(ancestor, x >> shift, y >> shift);
+		auto found = resident.find(page);
+		if (found != resident.end())
+		{
+			Slot& slot = slots[found->second];
+			if (slot.lastUsed != UINT32_MAX)
+				slot.lastUsed = frame;
+			continue;
+		}
+		if (unreadable.count(page))
+			continue;
+		missing = true;
+		if (loading.size() >= MAX_LOADS || loading.count(page))
+			continue;
+		loading.insert(page);
+		jobs.Submit([this, page]() {
+			Loaded loaded = load(page);
+			std::lock_guard<std::mutex> lock(finishedMutex);
+			finished.push_back(std::move(loaded));
+		}, &loads);
+	}
+}
+
+// Copies a page into the slot used longest ago, evicting the page there
+bool VirtualTexture::upload(const Loaded& page)
+{
+	size_t victim = slots.size();
+	for (size_t i = 0; i < slots.size(); i++)
+		if (slots[i].lastUsed < frame && (victim == slots.size() || slots[i].lastUsed < slots[victim].lastUsed))
+			victim = i;
+	if (victim == slots.size())
+		return false;
+
+	Slot& slot = slots[victim];
+	if (slot.key != UINT32_MAX)
+	{
+		// What pointed at the evicted page points at its nearest resident ancestor instead
+		uint32_t level = slot.key >> 28, x = slot.key & 0x3FFF, y = (slot.key >> 14) & 0x3FFF;
+		resident.erase(slot.key);
+		point(slot.key, ancestorEntry(level + 1, x >> 1, y >> 1));
+		evictCount++;
+	}
+	int column = (int)(victim % cacheSide), row = (int)(victim / cacheSide);
+	GLState.BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_2D, cache);
+	if (cacheFormat == GL_RGBA8)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, column * pageTexels, row * pageTexels, pageTexels, pageTexels, GL_RGBA, GL_UNSIGNED_BYTE, page.texels.data());
+	}
+	else
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, column * pageTexels, row * pageTexels, pageTexels, pageTexels, cacheFormat, (GLsizei)page.texels.size(), page.texels.data());
+	GLState.ActiveTexture(GL_TEXTURE0);
+	GLState.CountUpload(page.texels.size());
+	slot.key = page.key;
+	slot.lastUsed = frame;
+	resident[page.key] = (uint32_t)victim;
+	point(page.key, (uint32_t)column | (uint32_t)row << 8 | (page.key >> 28) << 16 | 0xFFu << 24);
+	uploadCount++;
+	return true;
+}
+
+// Replaces the entries of the page's region that point at its level or coarser, the finer pages resident keep theirs
+void VirtualTexture::point(uint32_t key, uint32_t entry)
+{
+	uint32_t level = key >> 28, x = key & 0x3FFF, y = (key >> 14) & 0x3FFF;
+	for (uint32_t finer = 0; finer <= level; finer++)
+	{
+		uint32_t shift = level - finer, side = PagesPerSide(header, finer);
+		std::vector<uint32_t>& texels = entries[finer];
+		for (uint32_t row = y << shift; row < (y + 1) << shift; row++)
+			for (uint32_t column = x << shift; column < (x + 1) << shift; column++)
+			{
+				uint32_t& texel = texels[(size_t)row * side + column];
+				if (entryLevel(texel) >= level)
+					texel = entry;
+			}
+		dirtyLevels[finer] = true;
+	}
+}
+
+// Walks up from a page to the first one resident
+uint32_t VirtualTexture::ancestorEntry(uint32_t level, uint32_t x, uint32_t y) const
+{
+	for (; level < header.levels; level++, x >>= 1, y >>= 1)
+	{
+		auto found = resident.find(PageKey(level, x, y));
+		if (found != resident.end())
+			return (found->second % cacheSide) | (found->second / cacheSide) << 8 | level << 16 | 0xFFu << 24;
+	}
+	return NO_ENTRY;
+}
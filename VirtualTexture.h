@@ -0,0 +1,178 @@
+#ifndef VIRTUAL_TEXTURE_CLASS_H
+#define VIRTUAL_TEXTURE_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+#include<cstdint>
+#include<mutex>
+#include<string>
+#include<unordered_map>
+#include<unordered_set>
+#include<vector>
+
+#include"JobSystem.h"
+#include"MappedFile.h"
+
+// Sparse virtual texture for facade imagery that is unique per facade and far larger than the GPU holds, such as a
+// district textured from photogrammetry. TextureCooker lays the images out as slots of one huge texture, cuts its
+// mip chain into pages of PAGE_SIZE texels with a border around each and stores every page as a PNG in one tiled file.
+// While drawing, the lit scene programs write the page each pixel wants into a feedback image of an eighth of the
+// resolution, one pixel of every 8x8 block and a different one each frame. Update reads it back through a ring of pixel
+// pack buffers like ImageReadback does, loads the missing pages and their coarser ancestors on the workers of the job
+// system, transcodes them to BC1 and copies a few per frame into a physical cache texture, evicting the pages used
+// longest ago. An indirection texture with a texel per page and a mip level per level of the virtual texture tells the
+// shader where in the cache a page is, or its nearest resident ancestor, so sampling never waits for a page. The single
+// page of the coarsest level is loaded when the file is opened and never evicted.
+class VirtualTexture
+{
+public:
+	// Texels a side of a page inside its border, and of the border repeating its neighbours so filtering never
+	// reaches into another page of the cache
+	static constexpr int PAGE_SIZE = 128;
+	static constexpr int BORDER = 4;
+	// Units of the cache and of the indirection, and the image unit of the feedback
+	static constexpr GLuint TEXTURE_UNIT = 18;
+	static constexpr GLuint IMAGE_UNIT = 0;
+	// The feedback has a pixel for this many pixels a side of the frame
+	static constexpr int FEEDBACK_SCALE = 8;
+	// Pixel buffers the feedback is read back through, pages loading at once and pages copied into the cache a frame
+	static constexpr int READBACKS = 3;
+	static constexpr size_t MAX_LOADS = 32;
+	static constexpr size_t UPLOADS_PER_FRAME = 8;
+
+	// Start of a file, followed by pageCount + 1 offsets from the start of the file, the last one its end, then the pages
+	// as PNG images of PAGE_SIZE + 2 * BORDER texels a side. Pages go level by level from the finest, rows of a level
+	// bottom first. Image i fills slot i of slotsPerSide * slotsPerSide from the bottom left, slots past the images
+	// repeat them
+	struct Header
+	{
+		char magic[4];
+		uint32_t pageSize;
+		uint32_t border;
+		uint32_t slotSize;
+		uint32_t slotsPerSide;
+		uint32_t images;
+		uint32_t levels;
+		uint32_t pageCount;
+	};
+	static const char MAGIC[4];
+
+	// Constructor, nothing is loaded until Open
+	VirtualTexture(JobSystem& jobs);
+	// Waits for the loads and deletes the textures unless Delete was already called, the context has to still be current
+	~VirtualTexture();
+	// A VirtualTexture is referenced by the jobs it submitted, so it can neither be copied nor moved
+	VirtualTexture(const VirtualTexture&) = delete;
+	VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+	// Maps a cooked file and creates a cache of about cacheBytes, false with a message if the file is not a virtual
+	// texture or the GL version cannot write the feedback. Needs a current context
+	bool Open(const std::string& path, int64_t cacheBytes);
+	bool isOpen() const { return cache != 0; }
+
+	// Points the samplers and the layout uniforms of a program built with SHADER_VIRTUAL_TEXTURE at the textures, once
+	void Apply(GLuint program);
+	// Render thread, before the scene: sizes the feedback for a frame of width by height, binds the cache, the
+	// indirection and the feedback and tells the program in use which pixel of the blocks writes this frame
+	void Bind(GLuint program, GLsizei width, GLsizei height, uint64_t frameIndex);
+	// Render thread, after the scene: starts reading the feedback back and clears it, requests the pages of the reads
+	// that finished, copies loaded pages into the cache and uploads the changed levels of the indirection
+	void Update();
+	// Checks if the last feedback read back asked for no page missing from the cache and none is loading, also when
+	// nothing wrote any feedback yet
+	bool settled() const;
+
+	// Pages in the cache and pages it has room for, and pages copied into it and evicted from it so far
+	size_t residentPages() const { return resident.size(); }
+	size_t cachePages() const { return slots.size(); }
+	size_t uploaded() const { return uploadCount; }
+	size_t evicted() const { return evictCount; }
+
+	// Waits for the loads and deletes the textures, does nothing if that was already done
+	void Delete();
+
+	// Pages a side of a level of the virtual texture a header describes
+	static uint32_t PagesPerSide(const Header& header, uint32_t level);
+	// Index in the file of a page of a level
+	static uint32_t PageIndex(const Header& header, uint32_t level, uint32_t x, uint32_t y);
+	// Key of a page as the feedback writes it, its level in the top 4 bits and its row and column in 14 bits each
+	static uint32_t PageKey(uint32_t level, uint32_t x, uint32_t y) { return level << 28 | y << 14 | x; }
+private:
+	// A page of the physical cache and the last frame one of its texels was asked for
+	struct Slot
+	{
+		uint32_t key = UINT32_MAX;
+		uint32_t lastUsed = 0;
+	};
+	// A feedback read in flight, or a free buffer when fence is null
+	struct Readback
+	{
+		GLuint buffer = 0;
+		GLsizeiptr capacity = 0;
+		GLsync fence = nullptr;
+		GLsizei width = 0;
+		GLsizei height = 0;
+	};
+	// A page a job decoded, empty when it could not be read
+	struct Loaded
+	{
+		uint32_t key = 0;
+		std::vector<unsigned char> texels;
+	};
+
+	JobSystem& jobs;
+	MappedFile file;
+	Header header = {};
+	// Offsets of the pages, in the mapping
+	const uint64_t* offsets = nullptr;
+
+	GLuint cache = 0;
+	GLuint indirection = 0;
+	GLenum cacheFormat = GL_RGBA8;
+	// Pages a side of the cache and texels a side of a page with its border
+	int cacheSide = 0;
+	int pageTexels = 0;
+	// Feedback image and the framebuffer it is cleared and read through
+	GLuint feedback = 0;
+	GLuint feedbackFramebuffer = 0;
+	GLsizei feedbackWidth = 0;
+	GLsizei feedbackHeight = 0;
+	Readback readbacks[READBACKS];
+	int nextReadback = 0;
+	uint32_t frame = 1;
+
+	std::vector<Slot> slots;
+	// Cache slot of every resident page by key, the pages loading or loaded and waiting for a slot, and the pages the
+	// file could not give, which are not asked for again
+	std::unordered_map<uint32_t, uint32_t> resident;
+	std::unordered_set<uint32_t> loading;
+	std::unordered_set<uint32_t> unreadable;
+	// Indirection entries of every level as RGBA8UI texels: cache column, cache row, level of the page pointed at, 255
+	std::vector<std::vector<uint32_t>> entries;
+	std::vector<bool> dirtyLevels;
+	// Pages asked for by the last feedback, kept to reuse their memory, and whether one of them was not resident
+	std::vector<uint32_t> requests;
+	bool missing = true;
+
+	JobSystem::Counter loads;
+	std::mutex finishedMutex;
+	std::vector<Loaded> finished;
+	std::vector<Loaded> ready;
+	size_t uploadCount = 0;
+	size_t evictCount = 0;
+
+	// Reads a page from the file and decodes it into the format of the cache, on a worker
+	Loaded load(uint32_t key) const;
+	// Copies the feedback of a finished read into requests, waiting for the GPU with wait set
+	void complete(Readback& readback, bool wait);
+	// Marks a page and its ancestors used this frame and starts loading the ones that are missing
+	void request(uint32_t key);
+	// Copies a loaded page into the slot used longest ago, false if every slot was used this frame
+	bool upload(const Loaded& page);
+	// Points the entries of a page's region at the page, where no finer page is resident, or at what replaces it
+	void point(uint32_t key, uint32_t entry);
+	// Entry of the nearest resident page at or above a page
+	uint32_t ancestorEntry(uint32_t level, uint32_t x, uint32_t y) const;
+};
+
+#endif
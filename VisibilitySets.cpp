@@ -0,0 +1,229 @@
+#include"VisibilitySets.h"
+#include"Quadtree.h"
+
+#include<algorithm>
+#include<cmath>
+#include<fstream>
+
+// Start of every file, followed by the box count, the cells along X and Z, the region, cell size and eye height and
+// the sizes of the arrays, then the arrays
+static const uint32_t VISIBILITY_MAGIC = 0x30535650; // "PVS0"
+
+// Cells a worker is handed at least, each casts a few thousand rays
+static const size_t BAKE_GRAIN = 16;
+
+// Number of cells along one axis, at least one
+int VisibilitySets::cellsAlong(float extent) const
+{
+	return std::max(1, (int)std::ceil(extent / cellSize));
+}
+
+// Writes runs of empty words as their count, each followed by the count of the words that are not and those words
+void VisibilitySets::encode(const std::vector<uint32_t>& bits, std::vector<uint32_t>& out)
+{
+	size_t i = 0;
+	while (i < bits.size())
+	{
+		size_t empty = i;
+		while (i < bits.size() && bits[i] == 0)
+			i++;
+		if (i == bits.size())
+			break;
+		size_t literal = i;
+		while (i < bits.size() && bits[i] != 0)
+			i++;
+		out.push_back((uint32_t)(literal - empty));
+		out.push_back((uint32_t)(i - literal));
+		out.insert(out.end(), bits.begin() + literal, bits.begin() + i);
+	}
+}
+
+// Casts the rays of every cell against a tree of the boxes, a slice of cells per worker
+size_t VisibilitySets::Bake(const BoundingBoxes& boxes, const glm::vec2& min, const glm::vec2& max, JobSystem& jobs)
+{
+	regionMin = min;
+	cellsX = cellsAlong(max.x - min.x);
+	cellsZ = cellsAlong(max.y - min.y);
+	boxCount = (uint32_t)boxes.size();
+	currentCell = -1;
+
+	float half = 0.5f * std::max(max.x - min.x, max.y - min.y);
+	glm::vec2 center = 0.5f * (min + max);
+	Quadtree tree(center - glm::vec2(half), 2.0f * half);
+	for (uint32_t i = 0; i < boxCount; i++)
+		tree.Insert(i, glm::vec3(boxes.minX[i], boxes.minY[i], boxes.minZ[i]), glm::vec3(boxes.maxX[i], boxes.maxY[i], boxes.maxZ[i]));
+	tree.Build();
+	float reach = glm::length(max - min);
+
+	// Directions over the sky by a spherical Fibonacci spiral as AmbientOcclusion casts them, from the horizon up,
+	// with most of them near the horizon where a street level camera sees the farthest
+	glm::vec3 directions[RAYS];
+	for (int r = 0; r < RAYS; r++)
+	{
+		float y = 1.0f - std::sqrt(1.0f - (r + 0.5f) / RAYS);
+		float radius = std::sqrt(1.0f - y * y);
+		float angle = r * 2.39996323f;
+		directions[r] = glm::vec3(radius * std::cos(angle), y, radius * std::sin(angle));
+	}
+
+	const size_t cells = (size_t)cellsX * cellsZ;
+	const size_t setWords = (boxCount + 31) / 32;
+	std::vector<std::vector<uint32_t>> encoded(cells);
+	baked.assign(cells, 0);
+	std::vector<size_t> sliceRays(jobs.Slices(cells, BAKE_GRAIN), 0);
+	jobs.ParallelFor(cells, BAKE_GRAIN, [&](size_t slice, size_t begin, size_t end) {
+		std::vector<uint32_t> bits(setWords);
+		std::vector<uint32_t> containing;
+		for (size_t c = begin; c < end; c++)
+		{
+			glm::vec2 cellMin = regionMin + cellSize * glm::vec2((float)(c % cellsX), (float)(c / cellsX));
+			const glm::vec2 offsets[SAMPLE_POINTS] = { glm::vec2(0.1f, 0.1f), glm::vec2(0.9f, 0.1f), glm::vec2(0.1f, 0.9f), glm::vec2(0.9f, 0.9f), glm::vec2(0.5f, 0.5f) };
+			std::fill(bits.begin(), bits.end(), 0u);
+			bool any = false;
+			for (int p = 0; p < SAMPLE_POINTS; p++)
+			{
+				for (int h = 0; h < SAMPLE_HEIGHTS; h++)
+				{
+					glm::vec2 ground = cellMin + cellSize * offsets[p];
+					glm::vec3 point(ground.x, eyeHeight * (h + 1) / SAMPLE_HEIGHTS, ground.y);
+					// A point inside a building is no place a camera can be, and would see through its walls
+					containing.clear();
+					tree.QueryRadius(point, 0.0f, containing);
+					bool inside = false;
+					for (uint32_t b : containing)
+						inside = inside || (point.x > boxes.minX[b] && point.x < boxes.maxX[b] && point.y > boxes.minY[b] && point.y < boxes.maxY[b] && point.z > boxes.minZ[b] && point.z < boxes.maxZ[b]);
+					if (inside)
+						continue;
+					any = true;
+					// Every point turns the spiral by its own angle, so the points fill the gaps between each other's rays
+					float turn = (p * SAMPLE_HEIGHTS + h) * 2.39996323f / (SAMPLE_POINTS * SAMPLE_HEIGHTS);
+					float cosTurn = std::cos(turn), sinTurn = std::sin(turn);
+					for (int r = 0; r < RAYS; r++)
+					{
+						const glm::vec3& d = directions[r];
+						glm::vec3 direction(d.x * cosTurn - d.z * sinTurn, d.y, d.x * sinTurn + d.z * cosTurn);
+						uint32_t hit = tree.Raycast(point, direction, reach);
+						if (hit != Quadtree::INVALID)
+							bits[hit / 32] |= 1u << (hit % 32);
+					}
+					sliceRays[slice] += RAYS;
+				}
+			}
+			if (!any)
+				continue;
+			baked[c] = 1;
+			encode(bits, encoded[c]);
+		}
+	});
+
+	cellStart.assign(cells + 1, 0);
+	for (size_t c = 0; c < cells; c++)
+		cellStart[c + 1] = cellStart[c] + (uint32_t)encoded[c].size();
+	words.clear();
+	words.reserve(cellStart[cells]);
+	for (const std::vector<uint32_t>& set : encoded)
+		words.insert(words.end(), set.begin(), set.end());
+
+	size_t rays = 0;
+	for (size_t sliceCount : sliceRays)
+		rays += sliceCount;
+	return rays;
+}
+
+// Writes a header followed by the arrays
+bool VisibilitySets::Save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	uint32_t header[6] = { VISIBILITY_MAGIC, boxCount, (uint32_t)cellsX, (uint32_t)cellsZ, (uint32_t)baked.size(), (uint32_t)words.size() };
+	float region[4] = { regionMin.x, regionMin.y, cellSize, eyeHeight };
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)region, sizeof(region));
+	file.write((const char*)baked.data(), baked.size());
+	file.write((const char*)cellStart.data(), cellStart.size() * sizeof(uint32_t));
+	file.write((const char*)words.data(), words.size() * sizeof(uint32_t));
+	return (bool)file;
+}
+
+// Reads a file written by Save, if it matches the boxes, the region and the cell settings
+bool VisibilitySets::Load(const std::string& path, size_t boxCount, const glm::vec2& min, const glm::vec2& max)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	uint32_t header[6] = {};
+	float region[4] = {};
+	file.read((char*)header, sizeof(header));
+	file.read((char*)region, sizeof(region));
+	if (!file || header[0] != VISIBILITY_MAGIC || header[1] != boxCount || (int)header[2] != cellsAlong(max.x - min.x) || (int)header[3] != cellsAlong(max.y - min.y)
+		|| header[4] != header[2] * header[3] || region[0] != min.x || region[1] != min.y || region[2] != cellSize || region[3] != eyeHeight)
+		return false;
+	baked.resize(header[4]);
+	cellStart.resize((size_t)header[4] + 1);
+	words.resize(header[5]);
+	file.read((char*)baked.data(), baked.size());
+	file.read((char*)cellStart.data(), cellStart.size() * sizeof(uint32_t));
+	file.read((char*)words.data(), words.size() * sizeof(uint32_t));
+	if (!file || cellStart.back() != words.size())
+		return false;
+	VisibilitySets::boxCount = header[1];
+	cellsX = (int)header[2];
+	cellsZ = (int)header[3];
+	regionMin = min;
+	currentCell = -1;
+	return true;
+}
+
+// Decodes the set of the point's cell unless it is the one decoded last
+const std::vector<uint32_t>* VisibilitySets::Lookup(const glm::vec3& point)
+{
+	if (point.y > eyeHeight || cellsX == 0)
+		return nullptr;
+	int x = (int)std::floor((point.x - regionMin.x) / cellSize);
+	int z = (int)std::floor((point.z - regionMin.y) / cellSize);
+	if (x < 0 || x >= cellsX || z < 0 || z >= cellsZ)
+		return nullptr;
+	int cell = z * cellsX + x;
+	if (!baked[cell])
+		return nullptr;
+	if (cell == currentCell)
+		return &current;
+
+	current.clear();
+	uint32_t word = 0;
+	for (uint32_t i = cellStart[cell]; i < cellStart[cell + 1];)
+	{
+		word += words[i];
+		uint32_t literals = words[i + 1];
+		for (uint32_t l = 0; l < literals; l++, word++)
+		{
+			for (uint32_t bits = words[i + 2 + l]; bits != 0; bits &= bits - 1)
+			{
+				uint32_t bit = 0;
+				while (!(bits & (1u << bit)))
+					bit++;
+				current.push_back(word * 32 + bit);
+			}
+		}
+		i += 2 + literals;
+	}
+	currentCell = cell;
+	return &current;
+}
+
+// Number of cells
+size_t VisibilitySets::cellCount() const
+{
+	return baked.size();
+}
+
+// Number of cells that have a set
+size_t VisibilitySets::bakedCount() const
+{
+	return (size_t)std::count(baked.begin(), baked.end(), (uint8_t)1);
+}
+
+// Bytes the encoded sets take
+size_t VisibilitySets::compressedBytes() const
+{
+	return words.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,71 @@
+#ifndef VISIBILITY_SETS_CLASS_H
+#define VISIBILITY_SETS_CLASS_H
+
+#include<glm/glm.hpp>
+#include<cstddef>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+#include"Frustum.h"
+#include"JobSystem.h"
+
+// Potentially visible sets of a street level camera, baked once so culling at runtime starts from a few blocks
+// The ground is split into square cells up to eyeHeight, and points of every cell not inside a building cast rays over
+// the sky against a Quadtree of the boxes, each point along a spiral turned a little from the others', so between
+// them a cell looks in RAYS times as many directions. Every box a ray hits first is in the cell's set. The sets are
+// bitsets over the boxes, run length encoded as runs of empty words followed by the words that are not, which keeps
+// them small since the boxes of a block are numbered next to each other. A camera above eyeHeight, outside the cells
+// or in a cell no point could be baked for gets no set and is culled as usual.
+// Rays only sample the view, so a box seen through a gap narrower than the rays are apart may be missing from a set.
+class VisibilitySets
+{
+public:
+	// Rays cast from every point of a cell
+	static constexpr int RAYS = 256;
+	// Points of a cell on the ground: its corners, drawn in a little, and its center, each at SAMPLE_HEIGHTS heights
+	static constexpr int SAMPLE_POINTS = 5;
+	static constexpr int SAMPLE_HEIGHTS = 2;
+
+	// Size of a cell along X and Z
+	float cellSize = 4.0f;
+	// Height of the navigable space above the ground, cameras above it get no set
+	float eyeHeight = 3.0f;
+
+	// Bakes the sets of every cell of the region from min to max on the ground for the boxes, with the cells split over
+	// the workers of jobs, and returns the number of rays cast
+	size_t Bake(const BoundingBoxes& boxes, const glm::vec2& min, const glm::vec2& max, JobSystem& jobs);
+	// Writes the sets to a file, false if it could not be written
+	bool Save(const std::string& path) const;
+	// Reads the sets of a file, false if it is missing or was baked for a different number of boxes or region
+	bool Load(const std::string& path, size_t boxCount, const glm::vec2& min, const glm::vec2& max);
+
+	// Boxes that may be seen from a point, nullptr when it gets no set
+	// The set is decoded when the point moves into another cell and kept until then
+	const std::vector<uint32_t>* Lookup(const glm::vec3& point);
+
+	// Number of cells, of the baked ones and the bytes their sets take
+	size_t cellCount() const;
+	size_t bakedCount() const;
+	size_t compressedBytes() const;
+private:
+	glm::vec2 regionMin = glm::vec2(0.0f);
+	int cellsX = 0;
+	int cellsZ = 0;
+	uint32_t boxCount = 0;
+	// 1 for every cell that has a set
+	std::vector<uint8_t> baked;
+	// Sets of cell c are encoded from cellStart[c] to cellStart[c + 1] of words
+	std::vector<uint32_t> cellStart;
+	std::vector<uint32_t> words;
+	// The decoded set of the cell the last Lookup was in
+	int currentCell = -1;
+	std::vector<uint32_t> current;
+
+	// Number of cells a region is split into along one axis
+	int cellsAlong(float extent) const;
+	// Appends the run length encoding of a bitset
+	static void encode(const std::vector<uint32_t>& bits, std::vector<uint32_t>& out);
+};
+
+#endif
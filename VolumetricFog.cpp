@@ -0,0 +1,242 @@
+#include"VolumetricFog.h"
+#include"ShadowCascades.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GpuMemory.h"
+#include"shaderClass.h"
+
+#include<glm/gtc/type_ptr.hpp>
+#include<cmath>
+
+// Light every froxel scatters towards the camera and how much it dims what is behind it, both per unit of length
+static const char* scatterSource = R"(
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+layout(rgba16f) writeonly uniform image3D scattering;
+uniform mat4 projection;
+uniform mat4 viewToModel;
+// Near and far plane of the slices
+uniform vec2 depthRange;
+// Way the sunlight travels and its color, in the space of the lights
+uniform vec3 sunDirection;
+uniform vec3 sunColor;
+// Density, falloff, base height and anisotropy of the fog, its color, the ambient share and the point light scale
+uniform vec4 medium;
+uniform vec3 fogColor;
+uniform float ambient;
+uniform float lightScale;
+// 1 when the clusters and the sun's cascades are bound
+uniform int clustered;
+uniform int shadowed;
+
+// Point lights binned by ClusteredLights, see ClusteredLights.h for the layout of the buffers
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterSize;
+// Sun shadows from ShadowCascades, the cascade is picked by the view depth
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 shadowMatrices[3];
+uniform vec4 cascadeSplits;
+
+// Henyey-Greenstein phase function, the share of the light turned by an angle of the given cosine
+float phase(float cosine, float g)
+{
+    float denominator = 1.0 + g * g - 2.0 * g * cosine;
+    return (1.0 - g * g) / (12.5663706 * denominator * sqrt(denominator));
+}
+
+float sunShadow(vec3 modelPos, float depth)
+{
+    if (shadowed == 0 || depth >= cascadeSplits.z)
+        return 1.0;
+    int cascade = depth < cascadeSplits.x ? 0 : (depth < cascadeSplits.y ? 1 : 2);
+    vec4 coord = shadowMatrices[cascade] * vec4(modelPos, 1.0);
+    return texture(shadowMap, vec4(coord.xy, float(cascade), coord.z));
+}
+
+void main()
+{
+    ivec3 froxel = ivec3(gl_GlobalInvocationID);
+    ivec3 size = imageSize(scattering);
+    if (any(greaterThanEqual(froxel, size)))
+        return;
+    // The center of the froxel, the projection may be off center
+    vec2 ndc = (vec2(froxel.xy) + 0.5) / vec2(size.xy) * 2.0 - 1.0;
+    float depth = depthRange.x * pow(depthRange.y / depthRange.x, (float(froxel.z) + 0.5) / float(size.z));
+    vec3 viewPos = vec3((ndc + vec2(projection[2][0], projection[2][1])) / vec2(projection[0][0], projection[1][1]) * depth, -depth);
+    vec3 modelPos = (viewToModel * vec4(viewPos, 1.0)).xyz;
+    vec3 eye = (viewToModel * vec4(0.0, 0.0, 0.0, 1.0)).xyz;
+    float extinction = medium.x * exp(-medium.y * (modelPos.y - medium.z));
+
+    // The sun scatters mostly onwards along its way, the ambient light evenly
+    vec3 light = sunColor * phase(dot(normalize(modelPos - eye), -sunDirection), medium.w) * sunShadow(modelPos, depth);
+    light += sunColor * ambient * 0.0795775;
+    if (clustered != 0)
+    {
+        // The froxels of a cluster share its lights, the grids are laid over each other exactly
+        ivec3 cluster = froxel * clusterSize / size;
+        uvec2 range = texelFetch(clusterGrid, (cluster.z * clusterSize.y + cluster.y) * clusterSize.x + cluster.x).xy;
+        for (uint i = 0u; i < range.y; i++)
+        {
+            int index = int(texelFetch(clusterIndices, int(range.x + i)).x);
+            vec4 position = texelFetch(clusterLights, index * 2);
+            vec3 toLight = position.xyz - viewPos;
+            float falloff = clamp(1.0 - length(toLight) / position.w, 0.0, 1.0);
+            light += texelFetch(clusterLights, index * 2 + 1).rgb * falloff * falloff * lightScale * 0.0795775;
+        }
+    }
+    imageStore(scattering, froxel, vec4(fogColor * light * extinction, extinction));
+}
+)";
+// Sums the froxels of a column front to back, every slice keeps the light scattered in up to its far end and the
+// share of what is behind it that still gets through
+static const char* integrateSource = R"(
+#version 430 core
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(rgba16f) readonly uniform image3D scattering;
+layout(rgba16f) writeonly uniform image3D integrated;
+uniform mat4 projection;
+uniform vec2 depthRange;
+
+void main()
+{
+    ivec3 size = imageSize(scattering);
+    ivec2 column = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(column, size.xy)))
+        return;
+    // Length of the column's ray per unit of view depth
+    vec2 ndc = (vec2(column) + 0.5) / vec2(size.xy) * 2.0 - 1.0;
+    float stretch = length(vec3((ndc + vec2(projection[2][0], projection[2][1])) / vec2(projection[0][0], projection[1][1]), 1.0));
+    vec3 light = vec3(0.0);
+    float transmittance = 1.0;
+    float start = 0.0;
+    for (int z = 0; z < size.z; z++)
+    {
+        float end = depthRange.x * pow(depthRange.y / depthRange.x, float(z + 1) / float(size.z));
+        vec4 froxel = imageLoad(scattering, ivec3(column, z));
+        float extinction = max(froxel.a, 1e-6);
+        float through = exp(-extinction * (end - start) * stretch);
+        // The scattering integrated over the slice with the light it loses on the way, so thick slices do not glow
+        light += transmittance * froxel.rgb * (1.0 - through) / extinction;
+        transmittance *= through;
+        imageStore(integrated, ivec3(column, z), vec4(light, transmittance));
+        start = end;
+    }
+}
+)";
+
+// Constructor that builds the programs and the volumes
+VolumetricFog::VolumetricFog(float nearPlane, float farPlane)
+	: nearPlane(nearPlane), farPlane(farPlane)
+{
+	scatterProgram = Shader::LinkCompute(scatterSource);
+	integrateProgram = Shader::LinkCompute(integrateSource);
+
+	// Samplers of different types must not share a unit even while there are no lights or shadows
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+	GLState.UseProgram(scatterProgram);
+	const char* clusterNames[3] = { "clusterLights", "clusterGrid", "clusterIndices" };
+	for (GLuint i = 0; i < 3; i++)
+		glUniform1i(glGetUniformLocation(scatterProgram, clusterNames[i]), (GLint)(ClusteredLights::TEXTURE_UNIT + i));
+	glUniform1i(glGetUniformLocation(scatterProgram, "shadowMap"), ShadowCascades::TEXTURE_UNIT);
+	GLState.UseProgram(previousProgram);
+
+	// The summed volume is filtered between froxels when it is applied, the scattering only loaded by the sum
+	GLuint* volumes[2] = { &scattering, &integrated };
+	for (int i = 0; i < 2; i++)
+	{
+		glGenTextures(1, volumes[i]);
+		GLState.BindTexture(GL_TEXTURE_3D, *volumes[i]);
+		glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA16F, FROXELS_X, FROXELS_Y, FROXELS_Z);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		GpuMemory.Track(GPU_MEMORY_TARGETS, GL_TEXTURE, *volumes[i], GpuMemoryTracker::ImageBytes(GL_RGBA16F, FROXELS_X, FROXELS_Y, FROXELS_Z));
+	}
+	GLState.BindTexture(GL_TEXTURE_3D, 0);
+}
+
+// Deletes the GL objects unless Delete was already called
+VolumetricFog::~VolumetricFog()
+{
+	Delete();
+}
+
+// Scatters into every froxel, then sums the columns
+void VolumetricFog::Update(const glm::mat4& viewModel, const glm::mat4& projection, const glm::vec3& sunDirection, const glm::vec3& sunColor,
+	ClusteredLights* lights, ShadowCascades* shadows)
+{
+	GLint previousProgram;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+
+	GLState.UseProgram(scatterProgram);
+	glUniformMatrix4fv(glGetUniformLocation(scatterProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	glUniformMatrix4fv(glGetUniformLocation(scatterProgram, "viewToModel"), 1, GL_FALSE, glm::value_ptr(glm::inverse(viewModel)));
+	glUniform2f(glGetUniformLocation(scatterProgram, "depthRange"), nearPlane, farPlane);
+	glUniform3fv(glGetUniformLocation(scatterProgram, "sunDirection"), 1, glm::value_ptr(glm::normalize(sunDirection)));
+	glUniform3fv(glGetUniformLocation(scatterProgram, "sunColor"), 1, glm::value_ptr(sunColor));
+	glUniform4f(glGetUniformLocation(scatterProgram, "medium"), density, falloff, baseHeight, anisotropy);
+	glUniform3fv(glGetUniformLocation(scatterProgram, "fogColor"), 1, glm::value_ptr(color));
+	glUniform1f(glGetUniformLocation(scatterProgram, "ambient"), ambient);
+	glUniform1f(glGetUniformLocation(scatterProgram, "lightScale"), lightScale);
+	glUniform1i(glGetUniformLocation(scatterProgram, "clustered"), lights ? 1 : 0);
+	glUniform1i(glGetUniformLocation(scatterProgram, "shadowed"), shadows ? 1 : 0);
+	GLState.CountUniforms(11);
+	if (lights)
+		lights->Apply(scatterProgram);
+	if (shadows)
+		shadows->Apply(scatterProgram);
+	glBindImageTexture(0, scattering, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glUniform1i(glGetUniformLocation(scatterProgram, "scattering"), 0);
+	glDispatchCompute((FROXELS_X + 7) / 8, (FROXELS_Y + 7) / 8, FROXELS_Z);
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+	GLState.UseProgram(integrateProgram);
+	glUniformMatrix4fv(glGetUniformLocation(integrateProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	glUniform2f(glGetUniformLocation(integrateProgram, "depthRange"), nearPlane, farPlane);
+	glUniform1i(glGetUniformLocation(integrateProgram, "scattering"), 0);
+	glUniform1i(glGetUniformLocation(integrateProgram, "integrated"), 1);
+	GLState.CountUniforms(4);
+	glBindImageTexture(0, scattering, 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA16F);
+	glBindImageTexture(1, integrated, 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+	glDispatchCompute((FROXELS_X + 7) / 8, (FROXELS_Y + 7) / 8, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+	glBindImageTexture(1, 0, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA16F);
+
+	GLState.UseProgram(previousProgram);
+}
+
+// The slice coordinate is the log of the depth scaled to the slices, half a slice back since every slice holds the sum
+// up to its far end
+void VolumetricFog::Apply(GLuint program) const
+{
+	GLState.ActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+	GLState.BindTexture(GL_TEXTURE_3D, integrated);
+	GLState.ActiveTexture(GL_TEXTURE0);
+	float scale = 1.0f / std::log(farPlane / nearPlane);
+	glUniform1i(glGetUniformLocation(program, "fogVolume"), (GLint)TEXTURE_UNIT);
+	glUniform2f(glGetUniformLocation(program, "fogVolumeScale"), scale, -std::log(nearPlane) * scale - 0.5f / (float)FROXELS_Z);
+	GLState.CountUniforms(2);
+}
+
+// Deletes the GL objects
+void VolumetricFog::Delete()
+{
+	GLuint* volumes[2] = { &scattering, &integrated };
+	for (GLuint* volume : volumes)
+		if (*volume != 0)
+		{
+			GLState.DeleteTextures(1, volume);
+			*volume = 0;
+		}
+	if (scatterProgram != 0)
+		GLState.DeleteProgram(scatterProgram);
+	if (integrateProgram != 0)
+		GLState.DeleteProgram(integrateProgram);
+	scatterProgram = integrateProgram = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef VOLUMETRIC_FOG_CLASS_H
+#define VOLUMETRIC_FOG_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+
+#include"ClusteredLights.h"
+
+class ShadowCascades;
+
+// Height fog lit by the sun and the point lights, with the shafts the buildings cut out of it, without marching rays
+// per pixel. The view frustum is split into a low resolution grid of froxels laid over ClusteredLights' clusters, a
+// whole number of froxels to a cluster along every axis with the same exponential slices, so a froxel finds its
+// lights in the one cluster around it. A compute pass works out the light every froxel scatters towards the camera,
+// the sun through ShadowCascades and the point lights of its cluster, and a second one sums the froxels of every
+// column front to back into the light scattered in and the share of the scene left in front of each slice.
+// The post pass then fogs a pixel with one fetch of that volume at its depth, see PostProcess::VOLUMETRIC.
+// Both passes are compute shaders, so it needs GL 4.3 and texture storage.
+class VolumetricFog
+{
+public:
+	// Froxels a side, FROXELS_PER_TILE to a cluster across and FROXELS_PER_SLICE deep
+	static constexpr unsigned int FROXELS_PER_TILE = 8;
+	static constexpr unsigned int FROXELS_PER_SLICE = 2;
+	static constexpr unsigned int FROXELS_X = ClusteredLights::TILES_X * FROXELS_PER_TILE;
+	static constexpr unsigned int FROXELS_Y = ClusteredLights::TILES_Y * FROXELS_PER_TILE;
+	static constexpr unsigned int FROXELS_Z = ClusteredLights::SLICES * FROXELS_PER_SLICE;
+	// The summed volume is bound to this texture unit while it is applied, clear of every other pass
+	static constexpr GLuint TEXTURE_UNIT = 31;
+
+	// Color the fog scatters, how much of the light it scatters per unit at the base height, how fast that thins out
+	// per unit of height above it, and the base height in the space of the lights
+	glm::vec3 color = glm::vec3(0.55f, 0.6f, 0.68f);
+	float density = 0.03f;
+	float falloff = 0.1f;
+	float baseHeight = 0.0f;
+	// How much the fog scatters forward, 0 evenly and towards 1 only along the light, which makes the shafts stand out
+	// against the sun
+	float anisotropy = 0.6f;
+	// Light that reaches the fog from everywhere, as a share of the sun's color, and the scale of the point lights
+	float ambient = 0.15f;
+	float lightScale = 1.0f;
+
+	// Constructor for a frustum from nearPlane to farPlane, the same as the clusters' so the slices line up. The
+	// volumes are made here, the fog past farPlane is that of the last slice
+	VolumetricFog(float nearPlane, float farPlane);
+	// Deletes the GL objects unless Delete was already called, the context has to still be current
+	~VolumetricFog();
+	// A VolumetricFog owns its GL objects, so it cannot be copied
+	VolumetricFog(const VolumetricFog&) = delete;
+	VolumetricFog& operator=(const VolumetricFog&) = delete;
+
+	// Works out the volume for a camera, viewModel takes the space of the lights and the shadows to view space
+	// sunDirection is the way the sunlight travels in that space and sunColor its color. lights are the clusters Updated
+	// for the same camera and shadows the sun's cascades, either may be null. The program in use is restored afterwards
+	void Update(const glm::mat4& viewModel, const glm::mat4& projection, const glm::vec3& sunDirection, const glm::vec3& sunColor,
+		ClusteredLights* lights, ShadowCascades* shadows);
+	// Binds the summed volume and sets the fogVolume sampler and the fogVolumeScale that turns a view depth into its
+	// slice coordinate, of the program in use
+	void Apply(GLuint program) const;
+
+	// Deletes the GL objects, does nothing if they were already deleted
+	void Delete();
+private:
+	float nearPlane;
+	float farPlane;
+	// Light scattered and extinction of every froxel, and the sums of every column up to each slice
+	GLuint scattering = 0;
+	GLuint integrated = 0;
+	GLuint scatterProgram = 0;
+	GLuint integrateProgram = 0;
+};
+
+#endif
@@ -1,5 +1,14 @@
 #version 330 core
 
+// Specialized by Shader::Specialize, LIGHTING, TEXTURE and SPECULAR are defined for the features the program has
+// Strengths of the ambient and specular terms, a permutation can define its own before this point
+#ifndef AMBIENT_STRENGTH
+#define AMBIENT_STRENGTH 0.20f
+#endif
+#ifndef SPECULAR_STRENGTH
+#define SPECULAR_STRENGTH 0.50f
+#endif
+
 // Outputs colors in RGBA
 out vec4 FragColor;
 
@@ -15,30 +24,38 @@ in vec3 crntPos;
 
 // Gets the Texture Unit from the main function
 uniform sampler2D tex0;
-// Gets the color of the light from the main function
-uniform vec4 lightColor;
-// Gets the position of the light from the main function
-uniform vec3 lightPos;
-// Gets the position of the camera from the main function
-uniform vec3 camPos;
+// Gets the camera and light from the main function
+#include "frame_data.glsl"
 
 void main()
 {
+#ifdef TEXTURE
+	vec4 baseColor = texture(tex0, texCoord);
+#else
+	vec4 baseColor = vec4(color, 1.0f);
+#endif
+
+#ifdef LIGHTING
 	// ambient lighting
-	float ambient = 0.20f;
+	float ambient = AMBIENT_STRENGTH;
 
 	// diffuse lighting
 	vec3 normal = normalize(Normal);
-	vec3 lightDirection = normalize(lightPos - crntPos);
+	vec3 lightDirection = normalize(lightPos.xyz - crntPos);
 	float diffuse = max(dot(normal, lightDirection), 0.0f);
 
+	float light = diffuse + ambient;
+#ifdef SPECULAR
 	// specular lighting
-	float specularLight = 0.50f;
-	vec3 viewDirection = normalize(camPos - crntPos);
+	vec3 viewDirection = normalize(camPos.xyz - crntPos);
 	vec3 reflectionDirection = reflect(-lightDirection, normal);
 	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 8);
-	float specular = specAmount * specularLight;
+	light += specAmount * SPECULAR_STRENGTH;
+#endif
 
 	// outputs final color
-	FragColor = texture(tex0, texCoord) * lightColor * (diffuse + ambient + specular);
+	FragColor = baseColor * lightColor * light;
+#else
+	FragColor = baseColor;
+#endif
 }
\ No newline at end of file
@@ -19,8 +19,7 @@ out vec3 Normal;
 // Outputs the current position for the Fragment Shader
 out vec3 crntPos;
 
-// Imports the camera matrix from the main function
-uniform mat4 camMatrix;
+#include "frame_data.glsl"
 // Imports the model matrix from the main function
 uniform mat4 model;
 
@@ -0,0 +1,27 @@
+// Per frame values shared by every program, laid out like FrameData.h
+layout (std140) uniform FrameData
+{
+	mat4 camMatrix;
+	mat4 view;
+	mat4 projection;
+	vec4 camPos;
+	vec4 lightPos;
+	vec4 lightColor;
+	mat4 sceneModel;
+	vec4 fogColor;
+	vec4 fogParams;
+	vec4 weather;
+	vec4 particleParams;
+	mat4 eyeMatrices[2];
+	vec4 sunDirection;
+	vec4 sunColor;
+};
+
+// Height fog over a color seen along a ray from the camera in world space, the density is averaged along the ray
+// since it falls off exponentially with height
+vec3 heightFog(vec3 color, vec3 ray)
+{
+	float rise = fogParams.x * ray.y;
+	float density = fogColor.w * exp(-fogParams.x * (camPos.y - fogParams.y)) * (abs(rise) > 1e-4 ? (1.0 - exp(-rise)) / rise : 1.0);
+	return mix(fogColor.rgb, color, exp(-density * length(ray)));
+}
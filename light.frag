@@ -2,9 +2,16 @@
 
 out vec4 FragColor;
 
-uniform vec4 lightColor;
+#ifdef LIGHT_MARKERS
+in vec3 markerColor;
+#endif
+#include "frame_data.glsl"
 
 void main()
 {
+#ifdef LIGHT_MARKERS
+	FragColor = vec4(markerColor, 1.0f);
+#else
 	FragColor = lightColor;
+#endif
 }
\ No newline at end of file
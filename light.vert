@@ -1,11 +1,35 @@
 #version 330 core
 
+#ifdef LIGHT_MARKERS
+// Lights in view written by ClusteredLights, two texels each: view space position and radius, then color
+uniform samplerBuffer clusterLights;
+// Half the side of a marker in world units, and the fewest pixels of framebuffer height it has to cover to be drawn
+uniform float markerSize;
+uniform float minPixels;
+uniform float viewportHeight;
+
+out vec3 markerColor;
+#else
 layout (location = 0) in vec3 aPos;
 
 uniform mat4 model;
-uniform mat4 camMatrix;
+#endif
+#include "frame_data.glsl"
 
 void main()
 {
+#ifdef LIGHT_MARKERS
+	// Corners of a cube as one triangle strip of 14 vertices, no vertex buffer needed
+	vec3 corner = vec3((0x287A >> gl_VertexID) & 1, (0x02AF >> gl_VertexID) & 1, (0x31E3 >> gl_VertexID) & 1) * 2.0f - 1.0f;
+	vec4 light = texelFetch(clusterLights, gl_InstanceID * 2);
+	markerColor = texelFetch(clusterLights, gl_InstanceID * 2 + 1).rgb;
+	// Markers too small to see collapse outside the clip volume and rasterize nothing
+	float pixels = markerSize * projection[1][1] * viewportHeight / max(-light.z, 1e-4f);
+	if (pixels < minPixels)
+		gl_Position = vec4(2.0f, 2.0f, 2.0f, 1.0f);
+	else
+		gl_Position = projection * vec4(light.xyz + corner * markerSize, 1.0f);
+#else
 	gl_Position = camMatrix * model * vec4(aPos, 1.0f);
+#endif
 }
\ No newline at end of file
@@ -1,4 +1,16 @@
 #include"shaderClass.h"
+#include"ProgramCache.h"
+#include"SpirvShaders.h"
+#include"GLExtensions.h"
+#include"GLStateCache.h"
+#include"GLDebugOutput.h"
+#include"LogQueue.h"
+#include"EmbeddedShaders.h"
+
+#include<algorithm>
+#include<filesystem>
+#include<utility>
+#include<glm/gtc/type_ptr.hpp>
 
 // Reads a text file and outputs a string with everything in the text file
 std::string get_file_contents(const char* filename)
@@ -17,61 +29,402 @@ std::string get_file_contents(const char* filename)
 	throw(errno);
 }
 
+// Reads a shader file from the embedded sources or from disk
+std::string get_shader_contents(const char* filename)
+{
+	const EmbeddedShader* embedded = nullptr;
+	std::string name = std::filesystem::path(filename).lexically_normal().generic_string();
+	for (const EmbeddedShader& shader : embeddedShaders)
+		if (name == shader.name)
+			embedded = &shader;
+#ifdef NDEBUG
+	if (embedded)
+		return embedded->source;
+#endif
+	try
+	{
+		return get_file_contents(filename);
+	}
+	catch (int error)
+	{
+		if (!embedded)
+			throw(error);
+	}
+	return embedded->source;
+}
+
+// Chunks registered with AddInclude by name
+static std::unordered_map<std::string, std::string>& registeredIncludes()
+{
+	static std::unordered_map<std::string, std::string> includes;
+	return includes;
+}
+
+// Directory the chunks included by a shader file are looked up in
+static std::string includeDirectory(const char* file)
+{
+	std::string directory = std::filesystem::path(file).parent_path().string();
+	return directory.empty() ? std::string(".") : directory;
+}
+
 // Constructor that build the Shader Program from 2 different shaders
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
-{
-	// Read vertexFile and fragmentFile and store the strings
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
-
-	// Convert the shader source strings into character arrays
-	const char* vertexSource = vertexCode.c_str();
-	const char* fragmentSource = fragmentCode.c_str();
-
-	// Create Vertex Shader Object and get its reference
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	// Attach Vertex Shader source to the Vertex Shader Object
-	glShaderSource(vertexShader, 1, &vertexSource, NULL);
-	// Compile the Vertex Shader into machine code
-	glCompileShader(vertexShader);
-	// Checks if Shader compiled succesfully
-	compileErrors(vertexShader, "VERTEX");
-
-	// Create Fragment Shader Object and get its reference
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	// Attach Fragment Shader source to the Fragment Shader Object
-	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-	// Compile the Vertex Shader into machine code
-	glCompileShader(fragmentShader);
-	// Checks if Shader compiled succesfully
-	compileErrors(fragmentShader, "FRAGMENT");
+Shader::Shader(const char* vertexFile, const char* fragmentFile, unsigned int features, bool async)
+{
+	Shader::features = features;
+	// Read vertexFile and fragmentFile, resolve their includes and store the strings, specialized for the features
+	sourceFiles = { vertexFile, fragmentFile };
+	std::vector<std::string> vertexIncludes, fragmentIncludes;
+	vertexCode = Specialize(Preprocess(get_shader_contents(vertexFile), includeDirectory(vertexFile), &vertexIncludes), features);
+	fragmentCode = Specialize(Preprocess(get_shader_contents(fragmentFile), includeDirectory(fragmentFile), &fragmentIncludes), features);
+	for (const std::vector<std::string>* includes : { &vertexIncludes, &fragmentIncludes })
+		for (const std::string& include : *includes)
+			if (std::find(sourceFiles.begin(), sourceFiles.end(), include) == sourceFiles.end())
+				sourceFiles.push_back(include);
+
+	SpirvShaders::Dump(vertexCode, fragmentCode);
+	// A binary linked by an earlier launch on the same driver skips compiling altogether
+	ID = ProgramCache::Load(vertexCode, fragmentCode);
+	if (ID == 0)
+		submit();
+	Label((std::string(vertexFile) + " " + fragmentFile).c_str());
+	// Asking for the result right away waits for the compiler, async programs are asked later
+	if (vertexShader && async)
+		return;
+	pending = true;
+	finish();
+}
+
+// Adds the #define of every feature in the mask after the #version line of a source
+std::string Shader::Specialize(const std::string& source, unsigned int features)
+{
+	static const struct { unsigned int feature; const char* define; int version; } defines[] =
+	{
+		{ SHADER_LIGHTING, "#define LIGHTING\n", 0 },
+		{ SHADER_TEXTURE, "#define TEXTURE\n", 0 },
+		{ SHADER_SPECULAR, "#define SPECULAR\n", 0 },
+		{ SHADER_CLUSTERED, "#define CLUSTERED\n", 0 },
+		{ SHADER_DEFERRED, "#define DEFERRED\n", 0 },
+		{ SHADER_SHADOWS, "#define SHADOWS\n", 0 },
+		{ SHADER_TERRAIN, "#define TERRAIN\n", 0 },
+		{ SHADER_PICKING, "#define PICKING\n", 0 },
+		{ SHADER_VERTEX_PULLING, "#define VERTEX_PULLING\n", 430 },
+		{ SHADER_COMPACT_VERTICES, "#define COMPACT_VERTICES\n", 0 },
+		{ SHADER_PROCEDURAL_BOXES, "#define PROCEDURAL_BOXES\n", 0 },
+		{ SHADER_MATERIALS, "#define MATERIALS\n", 430 },
+		{ SHADER_GLASS, "#define GLASS\n", 0 },
+		{ SHADER_LIGHT_MARKERS, "#define LIGHT_MARKERS\n", 0 },
+		{ SHADER_FOG, "#define FOG\n", 0 },
+		{ SHADER_PROBES, "#define PROBES\n", 0 },
+		{ SHADER_STEREO, "#define STEREO\n", 0 },
+		{ SHADER_VIRTUAL_TEXTURE, "#define VIRTUAL_TEXTURE\n", 430 },
+		{ SHADER_LIGHT_SHADOWS, "#define LIGHT_SHADOWS\n", 0 },
+		{ SHADER_DECALS, "#define DECALS\n", 0 },
+		{ SHADER_PACKED_MESHLETS, "#define PACKED_MESHLETS\n", 430 },
+	};
+	std::string block;
+	int required = 0;
+	for (const auto& define : defines)
+		if (features & define.feature)
+		{
+			block += define.define;
+			required = std::max(required, define.version);
+		}
+	if (block.empty())
+		return source;
+
+	// #version has to stay the first statement, the defines go on the line after it
+	std::string result = source;
+	size_t insert = 0;
+	size_t version = result.find("#version");
+	if (version != std::string::npos)
+	{
+		size_t number = result.find_first_of("0123456789", version);
+		size_t numberEnd = result.find_first_not_of("0123456789", number);
+		if (number != std::string::npos && numberEnd != std::string::npos && std::stoi(result.substr(number, numberEnd - number)) < required)
+			result.replace(number, numberEnd - number, std::to_string(required));
+		size_t lineEnd = result.find('\n', version);
+		insert = lineEnd == std::string::npos ? result.size() : lineEnd + 1;
+	}
+	if (insert == result.size() && (result.empty() || result.back() != '\n'))
+		block.insert(0, "\n");
+	result.insert(insert, block);
+	return result;
+}
+
+// Replaces every #include line with its chunk
+std::string Shader::Preprocess(const std::string& source, const std::string& directory, std::vector<std::string>* included)
+{
+	std::vector<std::string> seen;
+	if (!included)
+		included = &seen;
+	std::string result;
+	result.reserve(source.size());
+	size_t start = 0;
+	while (start < source.size())
+	{
+		size_t end = source.find('\n', start);
+		end = end == std::string::npos ? source.size() : end + 1;
+		size_t first = source.find_first_not_of(" \t", start);
+		size_t open = source.find('"', start);
+		size_t close = open < end ? source.find('"', open + 1) : std::string::npos;
+		if (first >= end || source.compare(first, 8, "#include") != 0 || close >= end)
+		{
+			result.append(source, start, end - start);
+			start = end;
+			continue;
+		}
+		start = end;
+		std::string name = source.substr(open + 1, close - open - 1);
+
+		// The path of a file keeps chunks of the same name in different directories apart
+		std::string path = directory.empty() ? std::string() : (std::filesystem::path(directory) / name).lexically_normal().string();
+		std::string chunk;
+		std::string chunkDirectory = directory;
+		bool found = false;
+		if (!path.empty())
+		{
+			try
+			{
+				chunk = get_shader_contents(path.c_str());
+				chunkDirectory = includeDirectory(path.c_str());
+				found = true;
+			}
+			catch (int)
+			{
+			}
+		}
+		if (!found)
+		{
+			path = name;
+			auto registered = registeredIncludes().find(name);
+			if (registered != registeredIncludes().end())
+			{
+				chunk = registered->second;
+				found = true;
+			}
+		}
+		if (!found)
+		{
+			// Left as it is, the compiler then reports the line
+			LOG_MESSAGE(LOG_ERROR, "Shader include %s not found", name.c_str());
+			result += "#include \"" + name + "\"\n";
+			continue;
+		}
+		if (std::find(included->begin(), included->end(), path) != included->end())
+		{
+			result += "\n";
+			continue;
+		}
+		included->push_back(path);
+		result += Preprocess(chunk, chunkDirectory, included);
+		if (result.empty() || result.back() != '\n')
+			result += '\n';
+	}
+	return result;
+}
+
+// Registers the source of a chunk that is not kept in a file
+void Shader::AddInclude(const std::string& name, const std::string& source)
+{
+	registeredIncludes()[name] = source;
+}
+
+// Files the program was built from
+const std::vector<std::string>& Shader::files() const
+{
+	return sourceFiles;
+}
+
+// Checks if the program has finished compiling and linking without waiting for the driver
+bool Shader::Ready()
+{
+	if (!pending)
+		return true;
+	// Without the extension every status query waits, so the program is reported ready and Finish does the waiting
+	if (GLExt.parallelShaderCompile)
+	{
+		GLint completed = GL_FALSE;
+		glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+		if (completed == GL_FALSE)
+			return false;
+	}
+	finish();
+	return true;
+}
+
+// Waits for the compiler and finishes setting up the program
+void Shader::Finish()
+{
+	if (pending)
+		finish();
+}
+
+// Hands both shaders and the link to the driver without asking for any results
+void Shader::submit()
+{
+	// SPIR-V compiled offline from these exact sources skips the GLSL compiler
+	if (!SpirvShaders::Load(vertexCode, fragmentCode, vertexShader, fragmentShader))
+	{
+		// Convert the shader source strings into character arrays
+		const char* vertexSource = vertexCode.c_str();
+		const char* fragmentSource = fragmentCode.c_str();
+
+		// Create Vertex Shader Object and get its reference
+		vertexShader = glCreateShader(GL_VERTEX_SHADER);
+		// Attach Vertex Shader source to the Vertex Shader Object
+		glShaderSource(vertexShader, 1, &vertexSource, NULL);
+		// Compile the Vertex Shader into machine code
+		glCompileShader(vertexShader);
+
+		// Create Fragment Shader Object and get its reference
+		fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+		// Attach Fragment Shader source to the Fragment Shader Object
+		glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+		// Compile the Vertex Shader into machine code
+		glCompileShader(fragmentShader);
+	}
 
 	// Create Shader Program Object and get its reference
 	ID = glCreateProgram();
 	// Attach the Vertex and Fragment Shaders to the Shader Program
 	glAttachShader(ID, vertexShader);
 	glAttachShader(ID, fragmentShader);
-	// Wrap-up/Link all the shaders together into the Shader Program
+	// Lets the driver keep the binary so it can be cached
+	ProgramCache::PrepareLink(ID);
+	// Wrap-up/Link all the shaders together into the Shader Program, linking does not have to wait for the compiles
 	glLinkProgram(ID);
-	// Checks if Shaders linked succesfully
-	compileErrors(ID, "PROGRAM");
+}
+
+// Checks the results of submit, caches the program and reads its uniforms
+void Shader::finish()
+{
+	pending = false;
+	if (vertexShader)
+	{
+		// Checks if Shaders compiled and linked succesfully
+		compileErrors(vertexShader, "VERTEX");
+		compileErrors(fragmentShader, "FRAGMENT");
+		compileErrors(ID, "PROGRAM");
+		// Saves the linked program for the next launch
+		ProgramCache::Store(ID, vertexCode, fragmentCode);
+
+		// Delete the now useless Vertex and Fragment Shader objects
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		vertexShader = fragmentShader = 0;
+	}
+	vertexCode.clear();
+	fragmentCode.clear();
+
+	// Looks up every uniform location once so it never has to be asked for again
+	reflectUniforms();
+	// Per frame values come from the shared uniform buffer
+	BindUniformBlock("FrameData", FrameData::BINDING);
+}
+
+// Compiles one stage of a pass that builds its program itself
+GLuint Shader::CompileStage(GLenum type, const char* source, const char* name)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, nullptr);
+	glCompileShader(shader);
+	GLint success;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (success == GL_FALSE)
+	{
+		char infoLog[1024];
+		glGetShaderInfoLog(shader, 1024, NULL, infoLog);
+		LOG_MESSAGE(LOG_ERROR, "SHADER_COMPILATION_ERROR for:%s\n%s", name, infoLog);
+	}
+	return shader;
+}
 
-	// Delete the now useless Vertex and Fragment Shader objects
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+// Links the stages of such a pass, which are not needed once the program is linked
+GLuint Shader::LinkProgram(std::initializer_list<GLuint> stages)
+{
+	GLuint program = glCreateProgram();
+	for (GLuint stage : stages)
+		if (stage != 0)
+			glAttachShader(program, stage);
+	glLinkProgram(program);
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (success == GL_FALSE)
+	{
+		char infoLog[1024];
+		glGetProgramInfoLog(program, 1024, NULL, infoLog);
+		LOG_MESSAGE(LOG_ERROR, "SHADER_LINKING_ERROR for:PROGRAM\n%s", infoLog);
+	}
+	for (GLuint stage : stages)
+		if (stage != 0)
+			glDeleteShader(stage);
+	return program;
+}
+
+// Builds a compute program
+GLuint Shader::LinkCompute(const char* source)
+{
+	return LinkProgram({ CompileStage(GL_COMPUTE_SHADER, source, "COMPUTE") });
+}
 
+// Names the program in GPU captures and debug messages
+void Shader::Label(const char* name)
+{
+	GLDebug.Label(GL_PROGRAM, ID, name);
 }
 
 // Activates the Shader Program
 void Shader::Activate()
 {
-	glUseProgram(ID);
+	GLState.UseProgram(ID);
 }
 
 // Deletes the Shader Program
 void Shader::Delete()
 {
-	glDeleteProgram(ID);
+	// An async program may still hold its shader objects
+	if (vertexShader)
+		glDeleteShader(vertexShader);
+	if (fragmentShader)
+		glDeleteShader(fragmentShader);
+	vertexShader = fragmentShader = 0;
+	pending = false;
+	if (ID != 0)
+		GLState.DeleteProgram(ID);
+	ID = 0;
+	uniforms.clear();
+	sourceFiles.clear();
+}
+
+// Deletes the program unless Delete was already called
+Shader::~Shader()
+{
+	Delete();
+}
+
+// Takes over the program of another Shader, which is left empty
+Shader::Shader(Shader&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+// Deletes the current program and takes over the one of another Shader
+Shader& Shader::operator=(Shader&& other) noexcept
+{
+	if (this != &other)
+	{
+		Delete();
+		ID = std::exchange(other.ID, 0);
+		features = other.features;
+		uniforms = std::move(other.uniforms);
+		sourceFiles = std::move(other.sourceFiles);
+		vertexCode = std::move(other.vertexCode);
+		fragmentCode = std::move(other.fragmentCode);
+		vertexShader = std::exchange(other.vertexShader, 0);
+		fragmentShader = std::exchange(other.fragmentShader, 0);
+		pending = std::exchange(other.pending, false);
+	}
+	return *this;
 }
 
 // Checks if the different Shaders have compiled properly
@@ -87,7 +440,7 @@ void Shader::compileErrors(unsigned int shader, const char* type)
 		if (hasCompiled == GL_FALSE)
 		{
 			glGetShaderInfoLog(shader, 1024, NULL, infoLog);
-			std::cout << "SHADER_COMPILATION_ERROR for:" << type << "\n" << infoLog << std::endl;
+			LOG_MESSAGE(LOG_ERROR, "SHADER_COMPILATION_ERROR for:%s\n%s", type, infoLog);
 		}
 	}
 	else
@@ -96,7 +449,144 @@ void Shader::compileErrors(unsigned int shader, const char* type)
 		if (hasCompiled == GL_FALSE)
 		{
 			glGetProgramInfoLog(shader, 1024, NULL, infoLog);
-			std::cout << "SHADER_LINKING_ERROR for:" << type << "\n" << infoLog << std::endl;
+			LOG_MESSAGE(LOG_ERROR, "SHADER_LINKING_ERROR for:%s\n%s", type, infoLog);
 		}
 	}
-}
\ No newline at end of file
+}
+
+// Fills the uniform table from the linked program
+void Shader::reflectUniforms()
+{
+	uniforms.clear();
+	GLint count = 0;
+	GLint maxLength = 0;
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<GLchar> name(std::max(maxLength, 1));
+	for (GLint i = 0; i < count; i++)
+	{
+		UniformInfo info;
+		GLsizei length = 0;
+		glGetActiveUniform(ID, (GLuint)i, (GLsizei)name.size(), &length, &info.size, &info.type, name.data());
+		info.name.assign(name.data(), length);
+		info.location = glGetUniformLocation(ID, info.name.c_str());
+		// Members of uniform blocks have no location
+		if (info.location < 0)
+			continue;
+		// Arrays are reported as "name[0]", they can also be found by their plain name
+		size_t bracket = info.name.find("[0]");
+		if (bracket != std::string::npos)
+		{
+			UniformInfo plain = info;
+			plain.name.erase(bracket);
+			uniforms.push_back(plain);
+		}
+		uniforms.push_back(info);
+	}
+	std::sort(uniforms.begin(), uniforms.end(), [](const UniformInfo& a, const UniformInfo& b) { return a.name < b.name; });
+}
+
+// Attaches a uniform block of the program to a binding point
+void Shader::BindUniformBlock(const char* name, GLuint binding)
+{
+	GLuint block = glGetUniformBlockIndex(ID, name);
+	if (block != GL_INVALID_INDEX)
+		glUniformBlockBinding(ID, block, binding);
+}
+
+// Gets the cached location of a uniform, -1 if the program has no such active uniform
+GLint Shader::Uniform(const char* name) const
+{
+	auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name, [](const UniformInfo& info, const char* name) { return info.name.compare(name) < 0; });
+	if (it == uniforms.end() || it->name != name)
+		return -1;
+	return it->location;
+}
+
+// Sets uniforms of the Shader Program, which has to be active
+void Shader::setInt(GLint location, GLint value)
+{
+	glUniform1i(location, value);
+	GLState.CountUniforms();
+}
+
+void Shader::setFloat(GLint location, GLfloat value)
+{
+	glUniform1f(location, value);
+	GLState.CountUniforms();
+}
+
+void Shader::setVec3(GLint location, const glm::vec3& value)
+{
+	glUniform3fv(location, 1, glm::value_ptr(value));
+	GLState.CountUniforms();
+}
+
+void Shader::setVec4(GLint location, const glm::vec4& value)
+{
+	glUniform4fv(location, 1, glm::value_ptr(value));
+	GLState.CountUniforms();
+}
+
+void Shader::setMat4(GLint location, const glm::mat4& value)
+{
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+	GLState.CountUniforms();
+}
+
+void Shader::setInt(const char* name, GLint value)
+{
+	setInt(Uniform(name), value);
+}
+
+void Shader::setFloat(const char* name, GLfloat value)
+{
+	setFloat(Uniform(name), value);
+}
+
+void Shader::setVec3(const char* name, const glm::vec3& value)
+{
+	setVec3(Uniform(name), value);
+}
+
+void Shader::setVec4(const char* name, const glm::vec4& value)
+{
+	setVec4(Uniform(name), value);
+}
+
+void Shader::setMat4(const char* name, const glm::mat4& value)
+{
+	setMat4(Uniform(name), value);
+}
+
+// Constructor that stores the shader files
+ShaderPermutations::ShaderPermutations(const char* vertexFile, const char* fragmentFile)
+{
+	ShaderPermutations::vertexFile = vertexFile;
+	ShaderPermutations::fragmentFile = fragmentFile;
+}
+
+// Gets the program for a feature mask, compiling it if this is the first time it is asked for
+Shader& ShaderPermutations::Get(unsigned int features)
+{
+	auto it = programs.find(features);
+	if (it == programs.end())
+		it = programs.emplace(features, Shader(vertexFile.c_str(), fragmentFile.c_str(), features)).first;
+	it->second.Finish();
+	return it->second;
+}
+
+// Starts compiling the programs for several masks without waiting
+void ShaderPermutations::Prepare(const std::vector<unsigned int>& featureSets)
+{
+	for (unsigned int features : featureSets)
+		if (programs.find(features) == programs.end())
+			programs.emplace(features, Shader(vertexFile.c_str(), fragmentFile.c_str(), features, true));
+}
+
+// Deletes every program built so far
+void ShaderPermutations::Delete()
+{
+	// Each program deletes itself, including async ones still compiling
+	programs.clear();
+}
@@ -2,30 +2,191 @@
 #define SHADER_CLASS_H
 
 #include<glad/glad.h>
+#include<initializer_list>
 #include<string>
 #include<fstream>
 #include<sstream>
 #include<iostream>
 #include<cerrno>
+#include<vector>
+#include<unordered_map>
+#include<glm/glm.hpp>
+
+#include"FrameData.h"
 
 std::string get_file_contents(const char* filename);
+// Reads a shader file, from the sources of EmbeddedShaders.h or from disk, throws errno like get_file_contents if neither has it
+// Release builds take the embedded source and only read files that were not embedded, so they need no shader files
+// Development builds read the file first, so an edited shader is picked up without rebuilding
+std::string get_shader_contents(const char* filename);
+
+// Features a Shader Program can be specialized for, each set bit adds its #define right after the #version line
+// so the shaders pick their branch at compile time instead of testing a uniform in every fragment
+enum ShaderFeature : unsigned int
+{
+	SHADER_LIGHTING = 1 << 0,
+	SHADER_TEXTURE = 1 << 1,
+	SHADER_SPECULAR = 1 << 2,
+	SHADER_ALL = SHADER_LIGHTING | SHADER_TEXTURE | SHADER_SPECULAR,
+	// Point lights binned by ClusteredLights instead of the single light of FrameData, only the scene shaders of Main have it
+	SHADER_CLUSTERED = 1 << 3,
+	// Writes albedo and normal into the G-buffer of DeferredRenderer instead of a lit color
+	SHADER_DEFERRED = 1 << 4,
+	// Darkens what the sun does not reach, using the cached cascades of ShadowCascades
+	SHADER_SHADOWS = 1 << 5,
+	// Places the patches of Terrain on its heightmap, the records with a negative layer are patches
+	SHADER_TERRAIN = 1 << 6,
+	// Hands the instance to the fragment shader of ObjectPicker's ID pass
+	SHADER_PICKING = 1 << 7,
+	// Reads the vertices from a storage buffer by gl_VertexID instead of from attributes, needs GLSL 4.30
+	SHADER_VERTEX_PULLING = 1 << 8,
+	// The pulled vertices are CompactVertex instead of CityGenerator's floats
+	SHADER_COMPACT_VERTICES = 1 << 9,
+	// Vertex IDs from PROCEDURAL_BOX_FIRST on are the corners of CityGenerator's unit building, made up without any
+	// buffer, only together with SHADER_VERTEX_PULLING which leaves no attribute to fetch for them
+	SHADER_PROCEDURAL_BOXES = 1 << 10,
+	// Facade layer, tint and highlight strength come from the instance's entry in MaterialTable, needs GLSL 4.30
+	SHADER_MATERIALS = 1 << 11,
+	// Materials that are not opaque are left to TransparencyPass, only with SHADER_MATERIALS
+	SHADER_GLASS = 1 << 12,
+	// light.vert and light.frag draw a cube for every light ClusteredLights has in view in one instanced call,
+	// instead of one cube placed by the model uniform
+	SHADER_LIGHT_MARKERS = 1 << 13,
+	// Height fog from the values of FrameData over the lit color, Main's scene and billboard shaders have it
+	SHADER_FOG = 1 << 14,
+	// The glass reflects the nearest of ReflectionProbes' cube maps instead of a flat sky color
+	SHADER_PROBES = 1 << 15,
+	// Instances come in pairs, the even one drawn by the left eye matrix of FrameData into the left half of the
+	// framebuffer and the odd one by the right into the right half, only the scene shaders of Main have it
+	SHADER_STEREO = 1 << 16,
+	// Main's scene shader samples the facades from VirtualTexture's page cache and writes the pages it wants into its
+	// feedback image, needs GLSL 4.30 for the image store
+	SHADER_VIRTUAL_TEXTURE = 1 << 17,
+	// The clustered point lights are shadowed from LightShadows' atlas, only together with SHADER_CLUSTERED
+	SHADER_LIGHT_SHADOWS = 1 << 18,
+	// The decals binned into the clusters are projected onto the fragment's color, only together with SHADER_CLUSTERED
+	SHADER_DECALS = 1 << 19,
+	// The pulled vertices are GpuMeshCodec meshlets decoded by vertex ID, only together with SHADER_VERTEX_PULLING
+	SHADER_PACKED_MESHLETS = 1 << 20
+};
 
 class Shader
 {
 public:
 	// Reference ID of the Shader Program
-	GLuint ID;
+	GLuint ID = 0;
+	// Features the program was specialized for
+	unsigned int features = 0;
 	// Constructor that build the Shader Program from 2 different shaders
-	Shader(const char* vertexFile, const char* fragmentFile);
+	// Async programs return while the driver is still compiling, check Ready or call Finish before using them
+	Shader(const char* vertexFile, const char* fragmentFile, unsigned int features = SHADER_ALL, bool async = false);
+	// Deletes the program unless Delete was already called, the context has to still be current
+	~Shader();
+	// A Shader owns its program, so it can be moved but not copied
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+	Shader(Shader&& other) noexcept;
+	Shader& operator=(Shader&& other) noexcept;
+
+	// Adds the #define of every feature in the mask after the #version line of a source
+	// Features that need a newer GLSL raise the #version to theirs, keeping its profile
+	static std::string Specialize(const std::string& source, unsigned int features);
+	// Replaces every #include "name" line with the chunk of that name, chunks can include further chunks
+	// A chunk is the shader file of that name in directory, read with get_shader_contents, or the one registered with
+	// AddInclude when directory is empty or has no such file. Every name is appended to included, a chunk already in it is left out so each one comes once.
+	// The program cache is keyed by the expanded source, so its hash changes exactly when one of the chunks does
+	static std::string Preprocess(const std::string& source, const std::string& directory, std::vector<std::string>* included = nullptr);
+	// Registers the source of a chunk that is not kept in a file, or replaces it
+	static void AddInclude(const std::string& name, const std::string& source);
+	// Compiles one stage of a pass built outside the Shader class and logs its errors under name
+	static GLuint CompileStage(GLenum type, const char* source, const char* name);
+	// Links the compiled stages into a program, logs its errors and deletes the stages, stages that are 0 are left out
+	static GLuint LinkProgram(std::initializer_list<GLuint> stages);
+	// Compiles and links a program of one compute stage
+	static GLuint LinkCompute(const char* source);
 
+	// Files the program was built from, the two shaders first and then every chunk they include, for hot reloading
+	const std::vector<std::string>& files() const;
+
+	// Checks if an async program has finished compiling and linking, never waits with KHR_parallel_shader_compile
+	bool Ready();
+	// Waits until an async program is compiled and linked
+	void Finish();
+
+	// Names the program in GPU captures and debug messages, the constructor names it after its files
+	void Label(const char* name);
 	// Activates the Shader Program
 	void Activate();
-	// Deletes the Shader Program
+	// Deletes the Shader Program, does nothing if it was already deleted or moved from
 	void Delete();
+
+	// Attaches a uniform block of the program to a binding point, does nothing if the program has no such block
+	void BindUniformBlock(const char* name, GLuint binding);
+
+	// Gets the cached location of a uniform, -1 if the program has no such active uniform
+	GLint Uniform(const char* name) const;
+
+	// Sets uniforms of the Shader Program, which has to be active
+	// Hot paths should get the location once with Uniform and use the overloads taking it
+	void setInt(GLint location, GLint value);
+	void setFloat(GLint location, GLfloat value);
+	void setVec3(GLint location, const glm::vec3& value);
+	void setVec4(GLint location, const glm::vec4& value);
+	void setMat4(GLint location, const glm::mat4& value);
+	void setInt(const char* name, GLint value);
+	void setFloat(const char* name, GLfloat value);
+	void setVec3(const char* name, const glm::vec3& value);
+	void setVec4(const char* name, const glm::vec4& value);
+	void setMat4(const char* name, const glm::mat4& value);
 private:
+	// Active uniform of the linked program
+	struct UniformInfo
+	{
+		std::string name;
+		GLint location;
+		GLenum type;
+		GLint size;
+	};
+	// Every active uniform sorted by name, filled once after linking
+	std::vector<UniformInfo> uniforms;
+	// Shader files and the chunks they include
+	std::vector<std::string> sourceFiles;
+
+	// Sources and shader objects kept until an async program is finished
+	std::string vertexCode;
+	std::string fragmentCode;
+	GLuint vertexShader = 0;
+	GLuint fragmentShader = 0;
+	bool pending = false;
+
+	// Hands both shaders and the link to the driver without asking for any results
+	void submit();
+	// Checks the results of submit, caches the program and reads its uniforms
+	void finish();
 	// Checks if the different Shaders have compiled properly
 	void compileErrors(unsigned int shader, const char* type);
+	// Fills the uniform table from the linked program
+	void reflectUniforms();
 };
 
 
+// Every specialization of one pair of shader files, built the first time each feature mask is asked for
+class ShaderPermutations
+{
+public:
+	// Constructor that stores the shader files, nothing is compiled yet
+	ShaderPermutations(const char* vertexFile, const char* fragmentFile);
+
+	// Gets the program for a feature mask, compiling it if this is the first time it is asked for
+	Shader& Get(unsigned int features);
+	// Starts compiling the programs for several masks without waiting, Get finishes them when they are used
+	void Prepare(const std::vector<unsigned int>& featureSets);
+	// Deletes every program built so far
+	void Delete();
+private:
+	std::string vertexFile;
+	std::string fragmentFile;
+	std::unordered_map<unsigned int, Shader> programs;
+};
+
 #endif
\ No newline at end of file